@@ -76,6 +76,20 @@ public:
 	
 	T operator()(index_t i) const { return cast(i) * mRec; }
 
+	/// Map array of positions to indices
+	void operator()(index_t * dst, const T * x, unsigned len) const {
+		for(unsigned i=0; i<len; ++i) dst[i] = cast(x[i]*mMul);
+	}
+
+	/// Map array of positions to indices and fractions, e.g., for ipl::linear
+	void operator()(index_t * dst, T * frac, const T * x, unsigned len) const {
+		for(unsigned i=0; i<len; ++i){
+			T f = x[i]*mMul;
+			dst[i] = cast(f);
+			frac[i] = f - cast(dst[i]);
+		}
+	}
+
 	void max(index_t idxMax, const T& posMax){ mMul=idxMax/posMax; mRec=1/mMul; }
 
 private:
@@ -88,8 +102,19 @@ private:
 
 
 
-#define L1 for(int i=0;i<count();++i)
-#define L2 int n=minCount(v); for(int i=0;i<n;++i)
+// Loops over elements of this slice, e, and another slice, v, with u its
+// element. Unit strides get loops over plain pointers, which compilers
+// vectorize without having to prove anything about the stride.
+#define L1(x) {\
+	const int n_=count(), s_=S; T * const b_=B;\
+	if(1==s_)	{ for(int i=0;i<n_;++i){ T& e=b_[i]; x } }\
+	else		{ for(int i=0;i<n_;++i){ T& e=b_[i*s_]; x } }\
+}
+#define L2(x) {\
+	const int n_=minCount(v), s_=S, t_=v.stride(); T * const b_=B; U * const c_=&v[0];\
+	if(1==s_ && 1==t_)	{ for(int i=0;i<n_;++i){ T& e=b_[i]; U& u=c_[i]; x } }\
+	else				{ for(int i=0;i<n_;++i){ T& e=b_[i*s_]; U& u=c_[i*t_]; x } }\
+}
 
 
 /// Uniformly strided section of an array
@@ -118,63 +143,63 @@ public:
 	T& operator[](int i) const { return B[i*S]; }
 
 	template <class Gen>
-	const Slice& operator  = (const Gen& v) const { L1{ (*this)[i] =v(); } return *this; }
-	const Slice& operator  = (const   T& v) const { L1{ (*this)[i] =v  ; } return *this; }
+	const Slice& operator  = (const Gen& v) const { L1( e =v(); ) return *this; }
+	const Slice& operator  = (const   T& v) const { const T w=v; L1( e=w; ) return *this; }
 
 	template <class Gen>
-	bool operator == (const Gen& v) const { L1{ if(v() != (*this)[i]) return false; } return true; }
-	bool operator == (const   T& v) const { L1{ if(v   != (*this)[i]) return false; } return true; }
+	bool operator == (const Gen& v) const { L1( if(v() != e) return false; ) return true; }
+	bool operator == (const   T& v) const { const T w=v; L1( if(w != e) return false; ) return true; }
 
 	template <class U>
-	const Slice& operator += (const Slice<U>& v) const { L2{ (*this)[i]+=T(v[i]); } return *this; }
+	const Slice& operator += (const Slice<U>& v) const { L2( e+=T(u); ) return *this; }
 
 	template <class Gen>
-	const Slice& operator += (const Gen& v) const { L1{ (*this)[i]+=v(); } return *this; }
-	const Slice& operator += (const   T& v) const { L1{ (*this)[i]+=v  ; } return *this; }
+	const Slice& operator += (const Gen& v) const { L1( e+=v(); ) return *this; }
+	const Slice& operator += (const   T& v) const { const T w=v; L1( e+=w; ) return *this; }
 
 	template <class U>
-	const Slice& operator -= (const Slice<U>& v) const { L2{ (*this)[i]-=T(v[i]); } return *this; }
+	const Slice& operator -= (const Slice<U>& v) const { L2( e-=T(u); ) return *this; }
 
 	template <class Gen>
-	const Slice& operator -= (const Gen& v) const { L1{ (*this)[i]-=v(); } return *this; }
-	const Slice& operator -= (const   T& v) const { L1{ (*this)[i]-=v  ; } return *this; }
+	const Slice& operator -= (const Gen& v) const { L1( e-=v(); ) return *this; }
+	const Slice& operator -= (const   T& v) const { const T w=v; L1( e-=w; ) return *this; }
 
 	template <class U>
-	const Slice& operator *= (const Slice<U>& v) const { L2{ (*this)[i]*=T(v[i]); } return *this; }
+	const Slice& operator *= (const Slice<U>& v) const { L2( e*=T(u); ) return *this; }
 
 	template <class Gen>
-	const Slice& operator *= (const Gen& v) const { L1{ (*this)[i]*=v(); } return *this; }
-	const Slice& operator *= (const   T& v) const { L1{ (*this)[i]*=v  ; } return *this; }
+	const Slice& operator *= (const Gen& v) const { L1( e*=v(); ) return *this; }
+	const Slice& operator *= (const   T& v) const { const T w=v; L1( e*=w; ) return *this; }
 
 	template <class U>
-	const Slice& operator /= (const Slice<U>& v) const { L2{ (*this)[i]/=T(v[i]); } return *this; }
+	const Slice& operator /= (const Slice<U>& v) const { L2( e/=T(u); ) return *this; }
 
 	template <class Gen>
-	const Slice& operator /= (const Gen& v) const { L1{ (*this)[i]/=v(); } return *this; }
-	const Slice& operator /= (const   T& v) const { L1{ (*this)[i]/=v  ; } return *this; }
+	const Slice& operator /= (const Gen& v) const { L1( e/=v(); ) return *this; }
+	const Slice& operator /= (const   T& v) const { const T w=v; L1( e/=w; ) return *this; }
 
 	/// Copy elements from another slice.
 	
 	/// Source elements are statically cast to the type of the destination slice.
 	///
 	template <class U>
-	const Slice& copy(const Slice<U>& v) const { L2{ (*this)[i]=v[i]; } return *this; }
+	const Slice& copy(const Slice<U>& v) const { L2( e=u; ) return *this; }
 
 	/// Apply filter in-place
 	template <class Fil>
-	const Slice& filter(const Fil& v) const { L1{ (*this)[i]=v((*this)[i]); } return *this; }
+	const Slice& filter(const Fil& v) const { L1( e=v(e); ) return *this; }
 	
 	/// Apply C-style unary function in-place, x = func(x, a1)
 	template <class R, class X, class A1>
 	const Slice& filter(R (* const func)(X, A1), const A1& a1){
-		L1{ (*this)[i] = func((*this)[i], a1); }
+		L1( e = func(e, a1); )
 		return *this;
 	}
 
 	/// Apply C-style binary function in-place, x = func(x, a1, a2)
 	template <class R, class X, class A1, class A2>
 	const Slice& filter(R (* const func)(X, A1,A2), const A1& a1, const A2& a2){
-		L1{ (*this)[i] = func((*this)[i], a1,a2); }
+		L1( e = func(e, a1,a2); )
 		return *this;
 	}
 
@@ -190,7 +215,7 @@ public:
 	/// Swaps elements
 	template <class U>
 	const Slice& swap(const Slice<U>& v) const {
-		L2{ T t=(*this)[i]; (*this)[i]=v[i]; v[i]=t; }
+		L2( T t=e; e=u; u=t; )
 		return *this;
 	}
 	
@@ -198,7 +223,7 @@ public:
 	T mean() const { return sum()/C; }
 
 	/// Returns sum of elements in slice
-	T sum() const { T r=T(0); L1{ r+=(*this)[i]; } return r; }
+	T sum() const { T r=T(0); L1( r+=e; ) return r; }
 
 	int count() const { return C; }
 	int offset() const { return B-A; }
@@ -212,7 +237,8 @@ public:
 protected:
 	T * A, * B;		// absolute, relative pointers
 	int C,S;	// count, stride
-	int minCount(const Slice& o) const { return count()<o.count() ? count() : o.count(); }
+	template <class U>
+	int minCount(const Slice<U>& o) const { return count()<o.count() ? count() : o.count(); }
 };
 
 #undef L1
@@ -5,14 +5,114 @@
 	See COPYRIGHT file for authors and license information
 
 	File Description:
-	Interface for and default implementation of memory allocator
+	Interface for and default implementation of memory allocator,
+	preallocated memory pools and arenas, and accounting of allocations
 */
 
-#include <cstddef> // ptrdiff_t
+#include <stdio.h>
+#include <atomic>
+#include <cstddef> // ptrdiff_t, max_align_t
+#include <cstdint> // uintptr_t
 #include <cstdlib> // size_t
+#include <new>
+
+#ifndef GAM_MEMORY_TAGS
+	#define GAM_MEMORY_TAGS 256 // maximum number of distinct allocation tags
+#endif
 
 namespace gam{
 
+/// Memory allocated under one tag
+struct MemoryStats{
+	const char * tag;					///< Tag name
+	unsigned long long allocations;		///< Number of allocations
+	unsigned long long deallocations;	///< Number of deallocations
+	unsigned long long bytes;			///< Bytes allocated in total
+	long long live;						///< Bytes allocated and not yet freed
+	long long peak;						///< Maximum of live bytes
+};
+
+
+/// Start recording allocations
+
+/// Allocations by Allocator, AlignedAllocator (and allocAligned()) and
+/// ArenaAllocator, which back Gamma's containers, are counted under the
+/// tag of the calling thread's innermost MemoryTag scope, or "untagged".
+/// Aligned and arena allocations are credited to their tag when freed;
+/// Allocator frees are credited to the tag current when freeing, so objects
+/// should be destroyed in the scope they were created in. Memory allocated
+/// before recording started is not counted when freed, except for Allocator
+/// frees, which cannot tell. When not recording, allocators pay one relaxed
+/// atomic load.
+void memoryTrackingStart();
+
+/// Stop recording allocations; recorded statistics are kept
+void memoryTrackingStop();
+
+/// Get whether allocations are being recorded
+bool memoryTracking();
+
+/// Zero statistics of all tags
+void memoryTrackingClear();
+
+/// Get statistics of tags
+
+/// \param[out] stats	array to write statistics of each tag with allocations to
+/// \param[in]  max		maximum number of statistics to write
+/// \returns number of statistics written
+unsigned memoryStats(MemoryStats * stats, unsigned max);
+
+/// Get statistics of one tag; zero if it has no allocations
+MemoryStats memoryStats(const char * tag);
+
+/// Print a table of statistics of all tags
+void memoryReport(FILE * fp=stdout);
+
+
+/// Tags allocations on the calling thread over its lifetime
+
+/// For example, to find the cost of one voice,
+/// \code
+///	memoryTrackingStart();
+///	{	MemoryTag tag("voice");
+///		voice = new Voice;
+///	}
+///	printf("%lld bytes\n", memoryStats("voice").live);
+/// \endcode
+/// Tags with the same name are the same tag. Scopes may be nested; the
+/// previous tag is restored on destruction.
+class MemoryTag{
+public:
+	/// \param[in] name	tag name; must remain valid while recording
+	explicit MemoryTag(const char * name): mPrev(current()){ current() = name; }
+	~MemoryTag(){ current() = mPrev; }
+
+	/// Get tag of calling thread or NULL if untagged
+	static const char *& current(){
+		thread_local const char * t = 0;
+		return t;
+	}
+
+private:
+	const char * mPrev;
+	MemoryTag(const MemoryTag&);
+	MemoryTag& operator=(const MemoryTag&);
+};
+
+/// Record an allocation under the calling thread's tag
+
+/// \returns ID of tag to pass to memoryRecordFree or 0 if not recording
+unsigned memoryRecordAlloc(std::size_t bytes);
+
+/// Record a deallocation
+
+/// \param[in] tag		ID from memoryRecordAlloc; 0 does nothing
+/// \param[in] bytes	number of bytes, as allocated
+void memoryRecordFree(unsigned tag, std::size_t bytes);
+
+/// Record a deallocation under the calling thread's tag, if recording
+void memoryRecordFree(std::size_t bytes);
+
 
 template <class T> class Allocator;
 
@@ -47,10 +147,14 @@ public:
 	const_pointer address(const_reference x) const { return &x; }
 
 	pointer allocate(size_type n){
+		if(memoryTracking()) memoryRecordAlloc(n * sizeof(T));
 		return reinterpret_cast<pointer>(::operator new(n * sizeof(T)));
 	}
 
-	void deallocate(pointer p, size_type /*n*/){ ::operator delete(p); }
+	void deallocate(pointer p, size_type n){
+		if(memoryTracking()) memoryRecordFree(n * sizeof(T));
+		::operator delete(p);
+	}
 
 	size_type max_size() const {
 		return static_cast<size_type>(-1) / sizeof(T);
@@ -67,6 +171,451 @@ template <class T1, class T2>
 bool operator!=(const Allocator<T1>&, const Allocator<T2>&){ return false; }
 
 
+
+/// Allocate memory aligned to a boundary
+
+/// \param[in] bytes		number of bytes
+/// \param[in] align		alignment, in bytes; a power of two
+/// \param[in] hugePages	whether blocks of at least hugePageSize() bytes
+///							are mapped from the system with huge pages
+///							requested, where supported
+/// \returns memory to release with freeAligned() or NULL on failure
+void * allocAligned(std::size_t bytes, std::size_t align=64, bool hugePages=false);
+
+/// Release memory from allocAligned()
+void freeAligned(void * p);
+
+/// Returns size, in bytes, from which allocAligned() maps huge pages
+std::size_t hugePageSize();
+
+
+/// Allocator of memory aligned to a boundary
+
+/// This can be used as the allocator of containers, such as Array, ArrayPow2
+/// and Ring, so that their elements start on a cache line for aligned SIMD
+/// loads and no element straddles two lines. When huge pages are requested,
+/// large blocks, such as long delay lines or sample buffers, are mapped
+/// directly from the system with huge pages to cut TLB misses; smaller ones
+/// come from the heap.
+///
+/// \tparam T			element type
+/// \tparam Align		alignment, in bytes; a power of two
+/// \tparam HugePages	whether to map large blocks with huge pages
+template <class T, std::size_t Align=64, bool HugePages=false>
+class AlignedAllocator{
+public:
+	typedef std::size_t		size_type;
+	typedef std::ptrdiff_t	difference_type;
+	typedef T*				pointer;
+	typedef const T*		const_pointer;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef T				value_type;
+	template <class U> struct rebind { typedef AlignedAllocator<U,Align,HugePages> other; };
+
+public:
+	explicit AlignedAllocator(){}
+	explicit AlignedAllocator(const AlignedAllocator&){}
+	template <class U> explicit AlignedAllocator(const AlignedAllocator<U,Align,HugePages>&){}
+	~AlignedAllocator(){}
+
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n){
+		return static_cast<pointer>(allocAligned(n * sizeof(T), Align, HugePages));
+	}
+
+	void deallocate(pointer p, size_type /*n*/){ freeAligned(p); }
+
+	size_type max_size() const {
+		return static_cast<size_type>(-1) / sizeof(T);
+	}
+
+	void construct(pointer p, const T& val){ new(p) T(val); }
+	void destroy(pointer p){ p->~T(); }
+};
+
+/// Aligned allocator mapping large blocks with huge pages
+template <class T, std::size_t Align=64>
+using HugePageAllocator = AlignedAllocator<T, Align, true>;
+
+template <class T1, class T2, std::size_t A, bool H>
+bool operator==(const AlignedAllocator<T1,A,H>&, const AlignedAllocator<T2,A,H>&){ return true; }
+
+template <class T1, class T2, std::size_t A, bool H>
+bool operator!=(const AlignedAllocator<T1,A,H>&, const AlignedAllocator<T2,A,H>&){ return false; }
+
+
+
+/// Fixed-size block memory pool
+
+/// All memory is allocated upon construction, so allocation and deallocation
+/// never call into the system heap. Free blocks are kept on a lock-free 
+/// stack whose head carries a version tag to avoid the ABA problem, so both
+/// allocation and deallocation are safe from any thread.
+class MemoryPool{
+public:
+
+	/// \param[in] blockSize	size, in bytes, of each block
+	/// \param[in] numBlocks	number of blocks to preallocate
+	MemoryPool(std::size_t blockSize, std::size_t numBlocks);
+
+	~MemoryPool(){ ::operator delete(mMem); }
+
+	/// Get a free block or NULL if the pool is exhausted
+	void * allocate();
+
+	/// Return a block previously obtained from allocate()
+	void deallocate(void * p);
+
+	/// Returns whether a pointer lies within this pool's memory
+	bool owns(const void * p) const {
+		return p >= mMem && p < mMem + mBlockSize*mCapacity;
+	}
+
+	std::size_t blockSize() const { return mBlockSize; }	///< Get block size, in bytes
+	std::size_t capacity() const { return mCapacity; }		///< Get total number of blocks
+	std::size_t used() const { return mUsed.load(std::memory_order_relaxed); } ///< Get number of blocks in use
+	std::size_t peak() const { return mPeak.load(std::memory_order_relaxed); } ///< Get maximum number of blocks in use at once
+	std::size_t failures() const { return mFailures.load(std::memory_order_relaxed); } ///< Get number of allocations that failed due to exhaustion
+
+private:
+	char * mMem;
+	std::size_t mBlockSize, mCapacity;
+	std::atomic<unsigned long long> mHead;	// tag (high 32 bits), block index + 1 (low 32 bits)
+	std::atomic<std::size_t> mUsed, mPeak, mFailures;
+
+	// Index of next free block + 1 is stored in first word of free blocks
+	unsigned& link(std::size_t i){ return *reinterpret_cast<unsigned *>(mMem + i*mBlockSize); }
+
+	MemoryPool(const MemoryPool&);
+	MemoryPool& operator=(const MemoryPool&);
+};
+
+
+inline MemoryPool::MemoryPool(std::size_t blockSize, std::size_t numBlocks)
+:	mMem(0), mCapacity(numBlocks), mHead(0), mUsed(0), mPeak(0), mFailures(0)
+{
+	static const std::size_t align = alignof(std::max_align_t);
+	if(blockSize < sizeof(unsigned)) blockSize = sizeof(unsigned);
+	mBlockSize = (blockSize + align-1) & ~(align-1);
+	mMem = static_cast<char *>(::operator new(mBlockSize * mCapacity));
+
+	// Link all blocks into free list
+	for(std::size_t i=0; i<mCapacity; ++i){
+		link(i) = (i+1 < mCapacity) ? unsigned(i+2) : 0;
+	}
+	mHead.store(mCapacity ? 1 : 0);
+}
+
+inline void * MemoryPool::allocate(){
+	unsigned long long h = mHead.load(std::memory_order_acquire);
+	unsigned idx;
+	do{
+		idx = unsigned(h);
+		if(!idx){
+			mFailures.fetch_add(1, std::memory_order_relaxed);
+			return 0;
+		}
+	} while(!mHead.compare_exchange_weak(h,
+		(((h>>32) + 1) << 32) | link(idx-1),
+		std::memory_order_acquire, std::memory_order_acquire)
+	);
+
+	std::size_t u = mUsed.fetch_add(1, std::memory_order_relaxed) + 1;
+	std::size_t p = mPeak.load(std::memory_order_relaxed);
+	while(u > p && !mPeak.compare_exchange_weak(p, u, std::memory_order_relaxed)){}
+	return mMem + (idx-1)*mBlockSize;
+}
+
+inline void MemoryPool::deallocate(void * ptr){
+	unsigned idx = unsigned((static_cast<char *>(ptr) - mMem) / mBlockSize) + 1;
+	unsigned long long h = mHead.load(std::memory_order_relaxed);
+	do{
+		link(idx-1) = unsigned(h);
+	} while(!mHead.compare_exchange_weak(h,
+		(((h>>32) + 1) << 32) | idx,
+		std::memory_order_release, std::memory_order_relaxed)
+	);
+	mUsed.fetch_sub(1, std::memory_order_relaxed);
+}
+
+
+
+/// Linear memory arena
+
+/// All memory is allocated upon construction. Slices are handed out one after
+/// another from the start of the block, each aligned to a cache line, so
+/// objects built together, such as the delay lines of a voice, lie close
+/// together in memory. Slices are not freed one by one; reset() releases all
+/// of them at once in constant time, e.g. when a voice is recycled. Owners of
+/// slices must get new ones after a reset. The generation number counts the
+/// resets so owners can tell whether their slices are still valid.
+///
+/// Unlike MemoryPool, an arena is meant to be used from one thread only.
+///
+/// Live arenas are listed in a fixed table of MAX_REGISTERED entries so that
+/// ArenaAllocator can tell arena memory from heap memory by its address.
+class MemoryArena{
+public:
+
+	enum{ MAX_REGISTERED = 256 };
+
+	/// \param[in] bytes	size, in bytes, of memory to preallocate
+	/// \param[in] align	alignment, in bytes, of slices; a power of two
+	MemoryArena(std::size_t bytes, std::size_t align=64);
+
+	~MemoryArena(){ unregister(); ::operator delete(mMem); }
+
+	/// Get a slice of memory or NULL if the arena is exhausted
+	void * allocate(std::size_t bytes);
+
+	/// Get a slice of memory for n elements or NULL if the arena is exhausted
+
+	/// Elements are not constructed.
+	template <class T>
+	T * allocate(std::size_t n){ return static_cast<T *>(allocate(n*sizeof(T))); }
+
+	/// Release all slices
+	void reset(){ mUsed = 0; ++mGeneration; }
+
+
+	/// Returns arena that ArenaAllocator allocates from on calling thread
+
+	/// This is NULL unless a Scope is active on the thread.
+	///
+	static MemoryArena *& current(){
+		thread_local MemoryArena * a = 0;
+		return a;
+	}
+
+	/// Makes an arena current on the calling thread for the lifetime of the scope
+
+	/// Scopes may be nested; the previous arena is restored on destruction.
+	///
+	class Scope{
+	public:
+		explicit Scope(MemoryArena& a): mPrev(current()){ current() = &a; }
+		~Scope(){ current() = mPrev; }
+	private:
+		MemoryArena * mPrev;
+		Scope(const Scope&);
+		Scope& operator=(const Scope&);
+	};
+
+	/// Returns whether a pointer lies within this arena's memory
+	bool owns(const void * p) const {
+		return p >= mBase && p < mBase + mCapacity;
+	}
+
+	/// Returns whether a pointer lies within the memory of any registered arena
+
+	/// This reads only the registry, never the memory pointed to, so it may be
+	/// called with slices handed out before a reset. It is lock-free.
+	static bool ownedByAny(const void * p);
+
+	/// Returns whether the arena is listed in the registry
+
+	/// This is false only if MAX_REGISTERED arenas were alive at construction.
+	/// ArenaAllocator then allocates from the heap instead of the arena.
+	bool registered() const { return mSlot >= 0; }
+
+	std::size_t capacity() const { return mCapacity; }	///< Get size, in bytes
+	std::size_t used() const { return mUsed; }			///< Get number of bytes in use
+	std::size_t peak() const { return mPeak; }			///< Get maximum number of bytes in use at once
+	std::size_t failures() const { return mFailures; }	///< Get number of allocations that failed due to exhaustion
+	unsigned generation() const { return mGeneration; }	///< Get number of resets
+
+private:
+	// Address range [begin, end) of a registered arena; begin is 0 if free
+	struct Range{
+		std::atomic<std::uintptr_t> begin, end;
+	};
+	static Range * registry(){
+		static Range r[MAX_REGISTERED];
+		return r;
+	}
+	static std::atomic<int>& registrySize(){
+		static std::atomic<int> n(0);
+		return n;
+	}
+
+	char * mMem, * mBase;
+	std::size_t mCapacity, mAlign, mUsed, mPeak, mFailures;
+	unsigned mGeneration;
+	int mSlot;
+
+	void unregister();
+	MemoryArena(const MemoryArena&);
+	MemoryArena& operator=(const MemoryArena&);
+};
+
+
+inline MemoryArena::MemoryArena(std::size_t bytes, std::size_t align)
+:	mMem(0), mBase(0), mAlign(align), mUsed(0), mPeak(0), mFailures(0), mGeneration(0)
+{
+	if(mAlign < alignof(std::max_align_t)) mAlign = alignof(std::max_align_t);
+	mCapacity = (bytes + mAlign-1) & ~(mAlign-1);
+	mMem = static_cast<char *>(::operator new(mCapacity + mAlign));
+	const std::size_t a = reinterpret_cast<std::size_t>(mMem);
+	mBase = mMem + (((a + mAlign-1) & ~(mAlign-1)) - a);
+
+	// Claim a free slot, then publish the end of the range
+	const std::uintptr_t b = reinterpret_cast<std::uintptr_t>(mBase);
+	mSlot = -1;
+	Range * r = registry();
+	for(int i=0; i<MAX_REGISTERED; ++i){
+		std::uintptr_t free = 0;
+		if(r[i].begin.compare_exchange_strong(free, b)){
+			r[i].end.store(b + mCapacity, std::memory_order_release);
+			mSlot = i;
+			int n = registrySize().load();
+			while(n <= i && !registrySize().compare_exchange_weak(n, i+1)){}
+			break;
+		}
+	}
+}
+
+inline void MemoryArena::unregister(){
+	if(mSlot < 0) return;
+	Range& r = registry()[mSlot];
+	r.end.store(0);
+	r.begin.store(0);
+	mSlot = -1;
+}
+
+inline bool MemoryArena::ownedByAny(const void * ptr){
+	const std::uintptr_t p = reinterpret_cast<std::uintptr_t>(ptr);
+	const Range * r = registry();
+	const int n = registrySize().load(std::memory_order_acquire);
+	for(int i=0; i<n; ++i){
+		const std::uintptr_t b = r[i].begin.load(std::memory_order_acquire);
+		if(b && p >= b && p < r[i].end.load(std::memory_order_acquire)
+			&& b == r[i].begin.load(std::memory_order_acquire)
+		) return true;
+	}
+	return false;
+}
+
+inline void * MemoryArena::allocate(std::size_t bytes){
+	bytes = (bytes + mAlign-1) & ~(mAlign-1);
+	if(bytes > mCapacity - mUsed){
+		++mFailures;
+		return 0;
+	}
+	void * p = mBase + mUsed;
+	mUsed += bytes;
+	if(mUsed > mPeak) mPeak = mUsed;
+	return p;
+}
+
+
+/// Allocator of memory from the current arena of the calling thread
+
+/// This can be used as the allocator of containers, such as Array, Ring and
+/// DelayN, so that all the memory of an object, such as a voice, comes from
+/// one preallocated MemoryArena:
+/// \code
+///	MemoryArena arena(1<<20);
+///	{	MemoryArena::Scope s(arena);
+///		voice = new Voice; // containers of voice allocate from arena
+///	}
+///	...
+///	delete voice;
+///	arena.reset(); // all memory of voice released at once
+/// \endcode
+/// While a MemoryArena::Scope is active, allocations take slices of its
+/// arena and never touch the heap; they fail, returning NULL, when the arena
+/// is exhausted. Without a scope, memory comes from the heap. Deallocating
+/// arena memory does nothing, as it is released by MemoryArena::reset(), so
+/// containers may be destroyed before or after the reset, but not after the
+/// arena is destroyed. Arena memory is told from heap memory by address, with
+/// MemoryArena::ownedByAny(), so nothing is read from slices that a reset may
+/// have handed out again. Only heap allocations are recorded by memory
+/// tracking; arena slices are part of the arena's preallocated memory.
+///
+/// \tparam T	element type
+template <class T>
+class ArenaAllocator{
+public:
+	typedef std::size_t		size_type;
+	typedef std::ptrdiff_t	difference_type;
+	typedef T*				pointer;
+	typedef const T*		const_pointer;
+	typedef T&				reference;
+	typedef const T&		const_reference;
+	typedef T				value_type;
+	template <class U> struct rebind { typedef ArenaAllocator<U> other; };
+
+public:
+	explicit ArenaAllocator(){}
+	explicit ArenaAllocator(const ArenaAllocator&){}
+	template <class U> explicit ArenaAllocator(const ArenaAllocator<U>&){}
+	~ArenaAllocator(){}
+
+	pointer address(reference x) const { return &x; }
+	const_pointer address(const_reference x) const { return &x; }
+
+	pointer allocate(size_type n){
+		MemoryArena * a = MemoryArena::current();
+		if(a && a->registered()){
+			return static_cast<pointer>(a->allocate(n * sizeof(T)));
+		}
+		const size_type bytes = n * sizeof(T) + HEADER;
+		char * m = static_cast<char *>(::operator new(bytes, std::nothrow));
+		if(!m) return 0;
+		Header& h = *reinterpret_cast<Header *>(m);
+		h.tag = memoryTracking() ? memoryRecordAlloc(bytes) : 0;
+		return reinterpret_cast<pointer>(m + HEADER);
+	}
+
+	void deallocate(pointer p, size_type n){
+		if(!p || MemoryArena::ownedByAny(p)) return;
+		char * m = reinterpret_cast<char *>(p) - HEADER;
+		const Header& h = *reinterpret_cast<Header *>(m);
+		if(h.tag) memoryRecordFree(h.tag, n * sizeof(T) + HEADER);
+		::operator delete(m);
+	}
+
+	size_type max_size() const {
+		return static_cast<size_type>(-1) / sizeof(T);
+	}
+
+	void construct(pointer p, const T& val){ new(p) T(val); }
+	void destroy(pointer p){ p->~T(); }
+
+private:
+	// Memory tag of heap allocations is stored before elements, keeping
+	// elements on a cache line
+	struct Header{
+		unsigned tag;
+	};
+	enum{ HEADER = 64 };
+};
+
+template <class T1, class T2>
+bool operator==(const ArenaAllocator<T1>&, const ArenaAllocator<T2>&){ return true; }
+
+template <class T1, class T2>
+bool operator!=(const ArenaAllocator<T1>&, const ArenaAllocator<T2>&){ return false; }
+
+
+
+
+// Implementation
+
+inline std::atomic<bool>& memoryTrackingState(){
+	static std::atomic<bool> s(false);
+	return s;
+}
+
+inline bool memoryTracking(){
+	return memoryTrackingState().load(std::memory_order_relaxed);
+}
+
+
+
 /*
 template <class T, class Alloc=Allocator<T> >
 class Buffer : private Alloc{
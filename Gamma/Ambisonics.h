@@ -0,0 +1,177 @@
+#ifndef GAMMA_AMBISONICS_H_INC
+#define GAMMA_AMBISONICS_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File Description:
+	Higher-order Ambisonics encoding and decoding
+*/
+
+#include <vector>
+
+namespace gam{
+
+/// \addtogroup Spatial
+/// @{
+
+/// These represent a sound field in a bus of spherical harmonic channels
+/// (B-format), so that any number of sources can be mixed into the bus and
+/// any number of speakers fed from it. The cost of encoding grows with the
+/// number of sources times the number of channels and the cost of decoding
+/// with the number of channels times the number of speakers, rather than with
+/// sources times speakers as with per-speaker gains and delays.
+///
+/// Channels are in ACN order with SN3D normalization (AmbiX). An order N bus
+/// has (N+1)^2 channels, e.g., 16 for third order and 36 for fifth order.
+/// Directions are vectors in the Ambisonics convention: x to the front, y to
+/// the left and z up. They need not be unit length.
+
+
+/// Get number of channels of a bus of a given order
+inline unsigned ambiChannels(unsigned order){ return (order+1)*(order+1); }
+
+/// Compute real spherical harmonics in a direction
+
+/// \param[out] Y		ambiChannels(order) harmonics, in ACN order with SN3D
+///						normalization
+/// \param[in]  order	highest order of harmonics
+/// \param[in]  x		front component of direction
+/// \param[in]  y		left component of direction
+/// \param[in]  z		up component of direction
+void sphericalHarmonics(float * Y, unsigned order, float x, float y, float z);
+
+
+/// Ambisonics encoder accumulating sources into a bus
+
+/// Each source has the gains of the spherical harmonics in its direction.
+/// When a direction changes, the gains glide to their new values over the
+/// next processed block.
+class AmbiEncoder{
+public:
+
+	/// \param[in] order		order of bus
+	/// \param[in] numSources	number of sources
+	AmbiEncoder(unsigned order=1, unsigned numSources=1);
+
+
+	/// Set order of bus; gains jump to those of the new order
+	AmbiEncoder& order(unsigned v);
+
+	/// Get order of bus
+	unsigned order() const { return mOrder; }
+
+	/// Get number of channels of bus
+	unsigned channels() const { return ambiChannels(mOrder); }
+
+	/// Set number of sources; new sources are to the front
+	AmbiEncoder& numSources(unsigned n);
+
+	/// Get number of sources
+	unsigned numSources() const { return mNumSrc; }
+
+	/// Set direction of a source
+	AmbiEncoder& dir(unsigned i, float x, float y, float z);
+
+	/// Get gain of a source in a channel
+	float gain(unsigned i, unsigned ch) const { return mTarget[i*channels() + ch]; }
+
+
+	/// Add sources to a bus
+
+	/// \param[in]     src	input buffer of each source
+	/// \param[in,out] bus	buffer of each channel; sources are added to it
+	/// \param[in]     n	number of samples
+	void process(const float * const * src, float * const * bus, unsigned n);
+
+private:
+	unsigned mOrder, mNumSrc;
+	std::vector<float> mGain;	// current gains, by source, then channel
+	std::vector<float> mTarget;	// gains of directions
+	std::vector<char> mGlide;	// whether a source's gains are gliding
+	std::vector<float> mDir;	// source directions
+};
+
+
+/// Ambisonics decoder feeding speakers from a bus
+
+/// The decoding matrix is computed from the speaker directions once, when
+/// processing after a change, and the bus is then multiplied by it a block
+/// at a time.
+///
+/// The sampling decoder projects the bus onto the speaker directions. It is
+/// exact for regular layouts, such as the vertices of platonic solids, with
+/// enough speakers for the order. The mode-matching decoder inverts the
+/// encoding of the speaker directions in the least-squares sense, which
+/// accounts for irregular layouts. It needs at least as many speakers as
+/// channels. Max-rE weighting of the orders concentrates the energy in the
+/// speakers closest to a source, which narrows the spread of sources, while
+/// keeping the overall energy the same.
+class AmbiDecoder{
+public:
+
+	/// Method of computing decoding matrix
+	enum Method{
+		SAMPLING,		/**< Projection onto speaker directions */
+		MODE_MATCHING	/**< Pseudo-inverse of speaker encoding */
+	};
+
+	/// \param[in] order		order of bus
+	/// \param[in] numSpeakers	number of speakers
+	AmbiDecoder(unsigned order=1, unsigned numSpeakers=4);
+
+
+	/// Set order of bus
+	AmbiDecoder& order(unsigned v);
+
+	/// Get order of bus
+	unsigned order() const { return mOrder; }
+
+	/// Get number of channels of bus
+	unsigned channels() const { return ambiChannels(mOrder); }
+
+	/// Set number of speakers; new speakers are to the front
+	AmbiDecoder& numSpeakers(unsigned n);
+
+	/// Get number of speakers
+	unsigned numSpeakers() const { return mNumSpk; }
+
+	/// Set direction of a speaker
+	AmbiDecoder& speaker(unsigned i, float x, float y, float z);
+
+	/// Set method of computing decoding matrix
+	AmbiDecoder& method(Method v){ mMethod=v; mDirty=true; return *this; }
+
+	/// Set whether to apply max-rE weights to the orders
+	AmbiDecoder& maxRE(bool v){ mMaxRE=v; mDirty=true; return *this; }
+
+
+	/// Compute decoding matrix
+
+	/// This is called by process() after any change.
+	void update();
+
+	/// Get coefficient of decoding matrix from a channel to a speaker
+	float coef(unsigned spk, unsigned ch) const { return mCoef[spk*channels() + ch]; }
+
+
+	/// Decode bus to speakers
+
+	/// \param[in]  bus	buffer of each channel
+	/// \param[out] out	buffer of each speaker
+	/// \param[in]  n	number of samples
+	void process(const float * const * bus, float * const * out, unsigned n);
+
+private:
+	unsigned mOrder, mNumSpk;
+	std::vector<float> mX, mY, mZ;	// speaker directions
+	std::vector<float> mCoef;		// matrix, by speaker, then channel
+	Method mMethod;
+	bool mMaxRE, mDirty;
+};
+
+/// @}
+
+} // gam::
+
+#endif
@@ -4,7 +4,12 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <atomic>
+#include <cmath>
+#include <vector>
+#include "Gamma/DFT.h"
 #include "Gamma/Filter.h"
+#include "Gamma/Oscillator.h"
 
 namespace gam{
 
@@ -42,6 +47,547 @@ public:
 
 
 
+/// Envelope followers of many channels with decimated metering output
+
+/// This follows the amplitude envelopes of a group of channels, such as the
+/// channels of the buses of a mixer. Each channel has separate attack and
+/// release times: the envelope moves 60 dB closer to a rising input within
+/// the attack time and to a falling input within the release time. Channels
+/// are filtered eight at a time in lock-step, which the compiler maps onto
+/// SIMD registers.
+///
+/// Every decimation period, the peak envelope of each channel over the
+/// period is written to a meter that another thread, such as a user
+/// interface, can read without locks. Only meter() and meterCount() are safe
+/// to call from other threads.
+/// \ingroup Analysis
+class EnvFollowBank : public DomainObserver{
+public:
+
+	/// \param[in] channels		number of channels
+	/// \param[in] attack		attack time, in domain units
+	/// \param[in] release		release time, in domain units
+	/// \param[in] decimation	samples per meter value
+	EnvFollowBank(unsigned channels=0, float attack=0.001, float release=0.3, unsigned decimation=512);
+
+
+	/// Set number of channels and zero all envelopes and meters
+
+	/// This allocates memory and must not be called while other threads are
+	/// reading the meters.
+	EnvFollowBank& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return mChannels; }
+
+	/// Set attack time of a channel
+	EnvFollowBank& attack(unsigned c, float v);
+
+	/// Set attack time of all channels
+	EnvFollowBank& attack(float v);
+
+	/// Set release time of a channel
+	EnvFollowBank& release(unsigned c, float v);
+
+	/// Set release time of all channels
+	EnvFollowBank& release(float v);
+
+	/// Set number of samples per meter value
+	EnvFollowBank& decimation(unsigned v){
+		mDecim = v ? v : 1;
+		if(mPhase >= mDecim) mPhase = 0;
+		return *this;
+	}
+
+	/// Get number of samples per meter value
+	unsigned decimation() const { return mDecim; }
+
+
+	/// Filter a block of all channels
+
+	/// \param[in]  in	channel c's sample i is at in[c*n + i]
+	/// \param[out] out	envelopes laid out as input or NULL to only meter
+	/// \param[in]  n		number of samples
+	void process(const float * in, float * out, unsigned n);
+
+	/// Returns current envelope of a channel
+	float value(unsigned c) const { return mEnv[c]; }
+
+	/// Zero envelopes and peaks over the current decimation period
+	void reset();
+
+
+	/// Returns last meter value of a channel; safe from any thread
+	float meter(unsigned c) const { return mMeter[c].load(std::memory_order_relaxed); }
+
+	/// Returns number of meter values written; safe from any thread
+
+	/// A reader may compare this to a previous count to see whether the
+	/// meters have been updated.
+	uint32_t meterCount() const { return mMeterCount.load(std::memory_order_acquire); }
+
+	void onDomainChange(double r);
+
+private:
+	enum{ LANES = 8 };
+	unsigned mChannels;
+	unsigned mDecim, mPhase;			// decimation period and samples into it
+	std::vector<float> mAtk, mRel;		// times in domain units
+	std::vector<float> mCAtk, mCRel;	// coefficients
+	std::vector<float> mEnv, mPeak;		// padded to a multiple of lanes
+	std::vector<std::atomic<float> > mMeter;
+	std::atomic<uint32_t> mMeterCount;
+
+	void publish();
+};
+
+
+
+/// Fundamental frequency estimator
+
+/// This estimates the fundamental frequency of a monophonic signal once per
+/// hop using the YIN algorithm. The difference function of the last window
+/// is found from a cross-correlation done with RFFT, in O(n log n) rather
+/// than O(n^2) time, and then normalized by its cumulative mean. The period
+/// is the first dip of this below the threshold, refined by parabolic
+/// interpolation. If there is none, the signal is considered unvoiced.
+///
+/// Lags up to half the window size are searched, so the window should span
+/// at least two periods of the lowest frequency of interest. The window
+/// size should be a power of two.
+/// \ingroup Analysis
+class PitchYIN : public DomainObserver{
+public:
+
+	/// \param[in] winSize	analysis window size, in samples
+	/// \param[in] hopSize	number of samples between estimates
+	PitchYIN(unsigned winSize=2048, unsigned hopSize=512);
+
+	PitchYIN(const PitchYIN&) = delete;
+	PitchYIN& operator= (const PitchYIN&) = delete;
+
+
+	/// Set window and hop sizes, in samples; allocates memory
+	PitchYIN& resize(unsigned winSize, unsigned hopSize);
+
+	/// Set range of frequencies searched
+	PitchYIN& range(float minFreq, float maxFreq){
+		mMinFreq = minFreq; mMaxFreq = maxFreq; return *this;
+	}
+
+	/// Set threshold of normalized difference below which a lag is a period
+
+	/// Lower values reject more noisy signals, but also more periodic ones.
+	///
+	PitchYIN& threshold(float v){ mThresh = v; return *this; }
+
+	unsigned sizeWin() const { return mWin.sizeWin(); }
+	unsigned sizeHop() const { return mWin.sizeHop(); }
+
+
+	/// Input next sample; returns true when a new estimate was made
+	bool operator()(float in){
+		if(mWin(&mX[0], in)){
+			analyze(&mX[0]);
+			return true;
+		}
+		return false;
+	}
+
+	/// Estimate the frequency of a window of sizeWin() samples, oldest first
+
+	/// \returns the estimated frequency, or 0 if unvoiced
+	///
+	float analyze(const float * win);
+
+	/// Returns last frequency estimate, or 0 if unvoiced
+	float freq() const { return mFreq; }
+
+	/// Returns one minus the normalized difference at the estimated period
+
+	/// This is near 1 for periodic signals and near 0 for noise.
+	///
+	float clarity() const { return mClarity; }
+
+	/// Returns whether the last window was considered periodic
+	bool voiced() const { return mFreq > 0.f; }
+
+private:
+	SlidingWindow<float> mWin;
+	RFFT<float> mFFT;
+	std::vector<float> mX, mA, mS;	// window, correlation, spectrum
+	std::vector<float> mD;			// normalized difference
+	float mMinFreq, mMaxFreq, mThresh;
+	float mFreq, mClarity;
+};
+
+
+
+/// Onset detector using spectral flux
+
+/// This detects note onsets from the frames of an existing STFT, so it needs
+/// no transform of its own. The flux of a frame is the mean rise of the
+/// log-compressed bin magnitudes since the previous frame. An onset is a
+/// peak of flux above an adaptive threshold, which is a multiple of the
+/// median flux over several past frames plus an offset. Peaks are found one
+/// frame late, and their times are refined between frames by parabolic
+/// interpolation. A smooth window, such as HANN, gives the most accurate
+/// times.
+///
+/// Pass every frame of the STFT, for instance:
+/// \code
+///	if(stft(in) && onset(stft)) trigger(onset.time());
+/// \endcode
+/// \ingroup Analysis
+class OnsetDetector{
+public:
+
+	/// \param[in] medianLen	number of past frames the threshold follows
+	/// \param[in] ratio		threshold as multiple of median flux
+	/// \param[in] offset		amount added to threshold
+	OnsetDetector(unsigned medianLen=11, float ratio=1.5, float offset=0.005);
+
+
+	/// Set number of past frames the threshold follows
+	OnsetDetector& medianLength(unsigned v);
+
+	/// Set threshold as multiple of median flux
+	OnsetDetector& ratio(float v){ mRatio=v; return *this; }
+
+	/// Set amount added to threshold
+	OnsetDetector& offset(float v){ mOffset=v; return *this; }
+
+	/// Set magnitude compression; flux is taken of log(1 + v * magnitude)
+	OnsetDetector& compression(float v){ mGamma=v; return *this; }
+
+
+	/// Analyze next frame of an STFT; returns true if an onset was detected
+
+	/// The spectrum may be in any format and split or not. If the number of
+	/// bins changes, memory is allocated and the detector is reset.
+	bool operator()(const STFT& stft);
+
+	/// Returns time of last onset, in domain units
+
+	/// Time is measured from the first sample passed to the STFT, to the
+	/// center of the (interpolated) window where flux peaked.
+	double time() const { return mTime; }
+
+	/// Returns flux of last onset over its threshold
+	float strength() const { return mStrength; }
+
+	/// Returns flux of last frame analyzed
+	float flux() const { return mFlux[2]; }
+
+	/// Returns number of frames analyzed
+	uint64_t frames() const { return mFrames; }
+
+	/// Forget past frames
+	void reset();
+
+private:
+	std::vector<float> mMag, mPrev;		// compressed magnitudes
+	std::vector<float> mHist, mSort;	// past flux values, scratch
+	unsigned mHistTap;
+	float mRatio, mOffset, mGamma;
+	float mFlux[3];						// flux of last three frames
+	float mThresh;						// threshold of middle frame
+	uint64_t mFrames;
+	double mTime;
+	float mStrength;
+
+	float median();
+};
+
+
+
+/// Sinusoidal partial tracker over STFT frames
+
+/// This finds the peaks of each STFT frame, estimates a sinusoid from each
+/// and continues partials from frame to frame for resynthesis, e.g., by a
+/// SineBank. Peaks are strict local maxima of magnitude, found several bins
+/// at a time by arr::maxima, and above an amplitude threshold. Frequency
+/// and amplitude are refined by parabolic interpolation of log magnitudes.
+/// Only the largest peaks are kept if there are more than partials.
+///
+/// Partials are kept in a fixed number of slots. Starting from the loudest,
+/// each partial takes the nearest unclaimed peak within a maximum
+/// deviation, or else ends. Remaining peaks start partials in free slots.
+/// So slot i holds one continuous partial for as long as it lasts, which
+/// lets a SineBank keep the phase of its partial i. Apart from the first
+/// frame of a new size, no memory is allocated.
+/// \ingroup Analysis
+class PartialTracker{
+public:
+
+	/// \param[in] maxPartials	number of partial slots
+	PartialTracker(unsigned maxPartials=64);
+
+
+	/// Set number of partial slots and end all partials; allocates memory
+	PartialTracker& maxPartials(unsigned n);
+
+	/// Set amplitude below which peaks are ignored
+	PartialTracker& threshold(float v){ mThresh=v; return *this; }
+
+	/// Set largest change of frequency between frames, in bins
+	PartialTracker& maxDeviation(float v){ mMaxDev=v; return *this; }
+
+
+	/// Analyze next frame of an STFT
+
+	/// The spectrum may be in any format and split or not.
+	///
+	void operator()(const STFT& stft);
+
+	/// Get number of partial slots
+	unsigned size() const { return unsigned(mFrq.size()); }
+
+	/// Returns whether slot i holds a partial
+	bool active(unsigned i) const { return mAmp[i] > 0.f; }
+
+	/// Get frequency of partial in slot i
+	float freq(unsigned i) const { return mFrq[i]; }
+
+	/// Get amplitude of partial in slot i, or 0 if none
+	float amp(unsigned i) const { return mAmp[i]; }
+
+	/// Get number of frames partial in slot i has lasted
+	unsigned age(unsigned i) const { return mAge[i]; }
+
+	/// End all partials
+	void reset();
+
+	/// Set partials of a SineBank from the slots
+
+	/// Continuing partials keep their phase. New partials start at zero
+	/// phase and ended partials are silenced. The bank is enlarged to
+	/// size() partials if smaller.
+	template <class Td>
+	void apply(SineBank<Td>& bank) const {
+		if(bank.size() < size()) bank.resize(size());
+		for(unsigned i=0; i<size(); ++i){
+			if(active(i)){
+				if(bank.amp(i) == 0.f || mAge[i] == 1) bank.set(i, mFrq[i], mAmp[i]);
+				else{ bank.freq(i, mFrq[i]); bank.amp(i, mAmp[i]); }
+			}
+			else if(bank.amp(i) != 0.f) bank.amp(i, 0.f);
+		}
+	}
+
+private:
+	struct Peak{ float frq, amp; bool claimed; };
+	std::vector<float> mFrq, mAmp;		// per slot
+	std::vector<unsigned> mAge, mOrder;
+	std::vector<float> mMag;			// magnitudes of a frame
+	std::vector<unsigned> mIdx;			// bins of maxima
+	std::vector<Peak> mPeaks;			// ascending in frequency
+	float mThresh, mMaxDev;
+};
+
+
+
+/// Loudness meter following ITU-R BS.1770 and EBU R128
+
+/// This measures the loudness of a group of channels, such as those of an
+/// output bus, in LUFS (loudness units relative to full scale). Each channel
+/// is K-weighted by a two-section BiquadCascade, then its power is summed,
+/// with a weight per channel, over steps of 100 ms. Momentary (400 ms) and
+/// short-term (3 s) loudness are kept by sliding sums over the steps, so
+/// each step costs the same however long the meter runs. Integrated loudness
+/// uses the absolute (-70 LUFS) and relative (-10 LU) gates of R128 over
+/// 400 ms blocks overlapping by 75%. The blocks are tallied in 0.1 LU bins,
+/// which bound memory and the cost of gating.
+///
+/// After each step, the loudness values are written to meters that another
+/// thread, such as a user interface, can read without locks. Only the meter
+/// accessors are safe to call from other threads. Loudness is negative
+/// infinity until enough input has been measured.
+/// \ingroup Analysis
+class LoudnessMeter : public DomainObserver{
+public:
+
+	/// \param[in] channels	number of channels
+	LoudnessMeter(unsigned channels=2);
+
+
+	/// Set number of channels and reset; allocates memory
+	LoudnessMeter& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return unsigned(mWeight.size()); }
+
+	/// Set weight of a channel's power
+
+	/// BS.1770 uses 1 for front channels and 1.41 for surround channels. The
+	/// low-frequency effects channel should be given 0.
+	LoudnessMeter& weight(unsigned c, float v){ mWeight[c] = v; return *this; }
+
+	/// Measure a block of all channels
+
+	/// \param[in] in	channel c's sample i is at in[c*n + i]
+	/// \param[in] n	number of samples
+	void process(const float * in, unsigned n);
+
+	/// Forget all input measured
+	void reset();
+
+
+	/// Returns momentary loudness, over last 400 ms; safe from any thread
+	float momentary() const { return mMomentary.load(std::memory_order_relaxed); }
+
+	/// Returns short-term loudness, over last 3 s; safe from any thread
+	float shortTerm() const { return mShortTerm.load(std::memory_order_relaxed); }
+
+	/// Returns gated loudness since last reset; safe from any thread
+	float integrated() const { return mIntegrated.load(std::memory_order_relaxed); }
+
+	/// Returns number of 100 ms steps measured; safe from any thread
+
+	/// A reader may compare this to a previous count to see whether the
+	/// meters have been updated.
+	uint32_t meterCount() const { return mMeterCount.load(std::memory_order_acquire); }
+
+	void onDomainChange(double r);
+
+private:
+	enum{ STEPS_M = 4, STEPS_S = 30, BINS = 800 };	// bins span [-70, 10) LUFS
+	std::vector<BiquadCascade<2, Domain1> > mKWeight;
+	std::vector<float> mWeight;
+	std::vector<double> mAcc;		// power of each channel in current step
+	unsigned mStep, mPhase;			// samples per step and into current step
+	double mPow[STEPS_S];			// weighted power of recent steps
+	double mSumM, mSumS;			// sliding sums of recent powers
+	unsigned mTap;
+	uint32_t mSteps;
+	std::vector<uint32_t> mBinCount;	// gating blocks per loudness bin
+	std::vector<double> mBinPow;		// summed power of blocks per bin
+	std::atomic<float> mMomentary, mShortTerm, mIntegrated;
+	std::atomic<uint32_t> mMeterCount;
+
+	void endStep();
+	float gated() const;
+};
+
+
+
+/// Impulse response measurement with an exponential sine sweep
+
+/// This measures the impulse response of a system, such as a room heard
+/// through a loudspeaker and microphone, by playing an exponential sine
+/// sweep (Farina, 2000) into it, recording its response and deconvolving.
+/// The sweep rises by a constant number of octaves per second, so after
+/// deconvolution the harmonic distortion of the system lands before the
+/// linear response rather than on it.
+///
+/// resize() generates the sweep and the spectrum of its inverse filter, the
+/// time-reversed sweep with amplitude in proportion to its frequency, and
+/// allocates the recording and a transform buffer. process() plays and
+/// records a block without allocating, so it is called from the audio
+/// callback:
+/// \code
+///	meas.process(io.outBuffer(0), io.inBuffer(0), io.framesPerBuffer());
+/// \endcode
+/// When done() is true, deconvolve() finds the response with one forward
+/// and one inverse RFFT of the recording. Its output and input are aligned
+/// by sample, so the response is delayed by the round-trip latency of the
+/// audio device. It can be passed directly to Convolver::ir().
+/// \ingroup Analysis
+class SweepMeasure : public DomainObserver{
+public:
+
+	/// \param[in] freq1	start frequency of sweep, in Hz
+	/// \param[in] freq2	end frequency of sweep, in Hz
+	/// \param[in] length	length of sweep, in seconds
+	/// \param[in] tail		length of recording after sweep (and of response), in seconds
+	/// \param[in] amp		amplitude of sweep
+	SweepMeasure(float freq1=20, float freq2=20000, float length=5, float tail=2, float amp=0.5);
+
+	SweepMeasure(const SweepMeasure&) = delete;
+	SweepMeasure& operator= (const SweepMeasure&) = delete;
+
+
+	/// Set sweep and recording lengths; allocates memory and stops measuring
+
+	/// \see SweepMeasure()
+	///
+	SweepMeasure& resize(float freq1, float freq2, float length, float tail, float amp=0.5);
+
+	float freq1() const { return mFreq1; }
+	float freq2() const { return mFreq2; }
+
+	/// Get number of samples of sweep
+	unsigned sweepSize() const { return mSweep.size(); }
+
+	/// Get number of samples recorded, the sweep plus tail
+	unsigned recordSize() const { return mRec.size(); }
+
+	/// Get number of samples of impulse response returned by deconvolve()
+	unsigned irSize() const { return recordSize() - sweepSize(); }
+
+	/// Get sweep samples
+	const float * sweep() const { return mSweep.data(); }
+
+	/// Get recording samples
+	const float * recording() const { return mRec.data(); }
+
+	/// Get number of samples played and recorded since start(); safe from any thread
+	unsigned position() const { return mPos.load(std::memory_order_acquire); }
+
+	/// Get whether the whole recording has been made; safe from any thread
+	bool done() const { return position() >= recordSize(); }
+
+	/// Get number of samples before linear response of k-th harmonic response
+
+	/// The response of the k-th harmonic starts this many samples before the
+	/// pointer returned by deconvolve(), which is valid for offsets up to
+	/// sweepSize()-1.
+	float harmonicOffset(unsigned k) const { return mRate * std::log(float(k)); }
+
+
+	/// Clear recording and start measuring
+
+	/// Call this from the audio thread or while process() is not called.
+	///
+	void start();
+
+	/// Play and record a block
+
+	/// Samples after the sweep, and all samples when not measuring, are zero.
+	/// \param[out] out	output block, sent to the system; may equal in
+	/// \param[in]  in	input block, recorded from the system
+	/// \param[in]  n	number of samples
+	/// \returns whether still measuring
+	bool process(float * out, const float * in, unsigned n);
+
+	/// Deconvolve recording
+
+	/// \returns irSize() samples of impulse response, stored internally
+	/// until the next call
+	const float * deconvolve(){ return deconvolve(mRec.data(), recordSize()); }
+
+	/// Deconvolve an external recording of the sweep
+
+	/// \param[in] rec	recording starting where the sweep does
+	/// \param[in] len	number of samples; samples past recordSize() are ignored
+	/// \returns irSize() samples of impulse response, stored internally
+	/// until the next call
+	const float * deconvolve(const float * rec, unsigned len);
+
+	void onDomainChange(double r);
+
+private:
+	RFFT<float> mFFT;
+	std::vector<float> mSweep, mRec;
+	std::vector<float> mInv;	// inverse filter spectrum, scaled by 1/N
+	std::vector<float> mBuf;	// transform buffer
+	std::atomic<unsigned> mPos;
+	float mFreq1, mFreq2, mLength, mTail, mAmp;
+	float mRate;				// sweep time constant, in samples
+};
+
+
+
 /// Silence detector
 
 /// This returns true if the magnitude of the input signal remains less than
@@ -79,6 +625,23 @@ public:
 		return false;
 	}
 
+	/// Detect silence in a block of input
+
+	/// This gives the same result as detecting silence in each sample, but
+	/// only scans back from the end of the block to its last loud sample,
+	/// several samples at a time for float.
+	/// \param[in] input		The input signal
+	/// \param[in] n			Number of samples
+	/// \param[in] threshold	Magnitude below which a signal is considered silent
+	/// \returns true if silence was detected at the end of the block
+	template <typename T>
+	bool operator()(const T * input, unsigned n, const T& threshold=T(0.001)){
+		const unsigned quiet = arr::tailBelowNorm(input, n, threshold);
+		if(quiet < n) mNumSilent = quiet;
+		else mNumSilent += n;
+		return done();
+	}
+
 	/// Returns true if silence is being detected
 	bool done() const { return mNumSilent >= mCount; }
 
@@ -88,6 +651,88 @@ private:
 
 
 
+/// Gates of many channels emitting threshold-crossing events
+
+/// This detects when the magnitude of each of a group of channels, such as
+/// piezo trigger inputs, rises to a threshold and when it later falls below
+/// a lower release threshold for a hold time. Each crossing is pushed as a
+/// timestamped Event onto a lock-free queue, which one other thread, or a
+/// Scheduler ControlFunc, can drain. The events of a block are ordered by
+/// channel, then time. Channels whose gates are closed are scanned several
+/// samples at a time by arr::headBelowNorm, so idle channels cost little.
+/// \ingroup Analysis
+class ThresholdBank : public DomainObserver{
+public:
+
+	/// Threshold crossing of a channel
+	struct Event{
+		uint64_t time;		///< Sample index since construction or reset
+		float level;		///< Magnitude of crossing sample
+		uint32_t channel;	///< Channel index
+		bool open;			///< True if gate opened, false if it closed
+	};
+
+	/// \param[in] channels		number of channels
+	/// \param[in] thresh		magnitude opening gates
+	/// \param[in] hold			time, in domain units, below release threshold closing gates
+	/// \param[in] queueSize	capacity of event queue
+	ThresholdBank(unsigned channels=0, float thresh=0.1, float hold=0.05, unsigned queueSize=1024);
+
+
+	/// Set number of channels and close all gates; allocates memory
+	ThresholdBank& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return unsigned(mOpen.size()); }
+
+	/// Set magnitude opening gate of a channel
+	ThresholdBank& threshold(unsigned c, float v){ mThresh[c] = v; return *this; }
+
+	/// Set magnitude opening gates of all channels
+	ThresholdBank& threshold(float v);
+
+	/// Set release threshold as a fraction of the opening threshold
+	ThresholdBank& release(float v){ mRelease = v; return *this; }
+
+	/// Set time, in domain units, below release threshold that closes a gate
+	ThresholdBank& hold(float v){ mHoldTime = v; onDomainChange(1); return *this; }
+
+
+	/// Detect crossings in a block of all channels
+
+	/// \param[in] in	channel c's sample i is at in[c*n + i]
+	/// \param[in] n	number of samples
+	void process(const float * in, unsigned n);
+
+	/// Returns whether gate of a channel is open
+	bool open(unsigned c) const { return mOpen[c] != 0; }
+
+	/// Pop oldest event (consumer thread); returns false if none
+	bool pop(Event& e){ return mEvents.pop(e); }
+
+	/// Get queue of events; one thread may consume from it
+	SPSCQueue<Event>& events(){ return mEvents; }
+
+	/// Close all gates and restart time at zero
+
+	/// This must not be called while another thread is consuming events.
+	///
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	std::vector<float> mThresh;
+	std::vector<unsigned> mQuiet;		// samples below release threshold
+	std::vector<char> mOpen;
+	SPSCQueue<Event> mEvents;
+	uint64_t mTime;
+	float mRelease, mHoldTime;
+	unsigned mHold;						// hold time in samples
+};
+
+
+
 /// Compares signal magnitude to a threshold
 
 /// This filter compares the input magnitude to a threshold and returns 1 if 
@@ -137,6 +782,17 @@ public:
 		return pzc + nzc;
 	}
 
+	/// Count zero crossings, of either direction, in a block
+
+	/// For float, signs of several samples are compared at a time.
+	///
+	unsigned operator()(const Tv * input, unsigned n){
+		if(!n) return 0;
+		const unsigned c = arr::zeroCross(input, n, mPrev);
+		mPrev = input[n-1];
+		return c;
+	}
+
 private:
 	Tv mPrev;
 };
@@ -182,6 +838,27 @@ public:
 		return mRate;
 	}
 
+	/// Input a block of samples and return current zero-crossing rate
+
+	/// This gives the same rate as inputting each sample in turn.
+	///
+	float operator()(const Tv * input, unsigned n){
+		while(n){
+			unsigned m = mCount < mWinSize ? mWinSize - mCount : 1;
+			if(m > n) m = n;
+			mCrosses += mDetector(input, m);
+			mCount += m;
+			input += m;
+			n -= m;
+			if(mCount >= mWinSize){
+				mRate = float(mCrosses) / mWinSize;
+				mCrosses = 0;
+				mCount = 0;
+			}
+		}
+		return mRate;
+	}
+
 private:
 	ZeroCross<Tv> mDetector;
 	float mRate;
@@ -0,0 +1,120 @@
+#ifndef GAMMA_ASYNCSTFT_H_INC
+#define GAMMA_ASYNCSTFT_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Short-time Fourier transform processed on a worker thread
+*/
+
+#include <atomic>
+#include <vector>
+#include "Gamma/DFT.h"
+#include "Gamma/Thread.h"
+
+namespace gam{
+
+/// Short-time Fourier transform with frames processed on a worker thread
+
+/// A large-window STFT does a large transform every hop, so the audio
+/// callbacks in which a hop lands cost much more than the others. This
+/// hands each completed input window to a worker thread, which performs the
+/// forward transform, onFrame(), the inverse transform and overlap-add. The
+/// audio thread only copies samples, and takes the output of a frame one
+/// hop after handing it off. The output is that of the STFT delayed by
+/// exactly sizeHop() samples; latency() gives the total delay.
+///
+/// If a frame is not finished when due, the audio thread waits for it and
+/// counts a missed deadline. Until start() is called, frames are processed
+/// on the calling thread with the same latency, which suits offline
+/// rendering.
+///
+/// Subclasses override onFrame() to process spectra, and must call stop()
+/// in their destructor so the worker does not call into a destroyed object.
+///
+/// \ingroup Spectral
+class AsyncSTFT{
+public:
+
+	/// \see STFT::STFT
+	AsyncSTFT(unsigned winSize=8192, unsigned hopSize=2048, unsigned padSize=0,
+		WindowType winType = HANN,
+		SpectralType specType = MAG_PHASE,
+		unsigned numAux=0
+	);
+
+	virtual ~AsyncSTFT();
+
+
+	/// Process a spectral frame; called on the worker thread
+	virtual void onFrame(STFT& stft){ (void)stft; }
+
+
+	/// Input next sample and get next output sample
+	float operator()(float input);
+
+	/// Process a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  len	number of samples
+	void operator()(float * dst, const float * src, unsigned len);
+
+
+	/// Start the worker thread
+
+	/// \returns whether the thread was started
+	///
+	bool start();
+
+	/// Stop the worker thread, finishing any pending frame
+	void stop();
+
+	/// Set window and zero-padding size, in samples
+
+	/// This stops the worker thread, allocates memory and resets the
+	/// input and output.
+	AsyncSTFT& resize(unsigned winSize, unsigned padSize);
+
+	/// Set hop size, in samples
+
+	/// \see resize
+	///
+	AsyncSTFT& sizeHop(unsigned size);
+
+
+	/// Get the transform used by the worker thread
+
+	/// Settings other than sizes may be changed while the worker is stopped.
+	///
+	STFT& stft(){ return mSTFT; }
+
+	/// Get delay from input to output, in samples
+	unsigned latency() const { return mSTFT.sizeWin() - 1 + mHop; }
+
+	/// Get number of frames not finished by their deadline
+	unsigned misses() const { return mMisses.load(std::memory_order_relaxed); }
+
+private:
+	STFT mSTFT;
+	unsigned mHop;
+	std::vector<float> mRing;		// last sizeWin() input samples
+	std::vector<float> mFrameIn;	// input window handed to worker
+	std::vector<float> mFrameOut;	// output of worker, sizeWin() samples
+	std::vector<float> mPlay;		// output hop being played
+	unsigned mTapW, mHopCnt;
+	Thread mThread;
+	std::atomic<unsigned> mPosted, mDone;	// frames posted and finished
+	std::atomic<unsigned> mMisses;
+	std::atomic<bool> mRunning;
+
+	void hop();
+	void processFrame();
+	void reset();
+	static void * cWorkerFunc(void * user);
+};
+
+} // gam::
+
+#endif
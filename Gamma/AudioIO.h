@@ -12,6 +12,7 @@
 
 #include <string>
 #include <vector>
+#include "Gamma/pstdint.h"
 
 namespace gam{
 
@@ -84,6 +85,20 @@ public:
 	/// Constructor
 	AudioIOData(void * user);
 
+	/// Construct as a view of another object's buffers with separate output
+
+	/// The view shares the input and bus buffers of the source, but has its 
+	/// own frame counter and temporary buffer and writes output into 
+	/// 'bufOut' which must hold channelsOut() x framesPerBuffer() samples.
+	/// This allows part of a block to be computed on another thread.
+	AudioIOData(const AudioIOData& src, float * bufOut);
+
+	/// Update input and bus buffers of a view from its source
+
+	/// This must be called on a view before each block, since an AudioIO in
+	/// non-interleaved mode may point its input buffer at host memory.
+	void updateView(const AudioIOData& src){ mBufI = src.mBufI; mBufB = src.mBufB; }
+
 	virtual ~AudioIOData();
 
 
@@ -166,6 +181,7 @@ protected:
 	float *mBufI, *mBufO, *mBufB;	// input, output, and aux buffers
 	float * mBufT;					// temporary one channel buffer
 	int mNumI, mNumO, mNumB;		// input, output, and aux channels
+	bool mIsView;					// whether buffers (except temp) are borrowed
 public:
 	float mGain, mGainPrev;
 };
@@ -182,10 +198,100 @@ public:
 };
 
 
+/// Histogram of time spans with bins spaced by octaves
+
+/// \ingroup io
+struct AudioTimeHistogram{
+	enum{ NUM_BINS = 24, MIN_BITS = 10 };
+
+	uint64_t count;				///< Number of spans
+	uint64_t total;				///< Sum of spans, in nanoseconds
+	uint64_t max;				///< Longest span, in nanoseconds
+	uint32_t bins[NUM_BINS];	///< Number of spans per range
+
+	AudioTimeHistogram(){ reset(); }
+
+	/// Clear all statistics
+	void reset();
+
+	/// Get mean span, in nanoseconds
+	double mean() const { return count ? double(total)/count : 0.; }
+
+	/// Get span, in nanoseconds, that a fraction of spans do not exceed
+
+	/// The result is an upper bound given by the edge of a histogram bin.
+	///
+	double percentile(double frac) const;
+
+	/// Get histogram bin of a span in nanoseconds
+	static unsigned bin(uint64_t dt){
+		unsigned i = 0;
+		for(uint64_t t = dt>>MIN_BITS; t && i < NUM_BINS-1; t>>=1) ++i;
+		return i;
+	}
+
+	/// Get start of histogram bin, in nanoseconds
+	static uint64_t binStart(unsigned i){ return i ? uint64_t(1)<<(i+MIN_BITS-1) : 0; }
+};
+
+
+/// Timing and xrun statistics of audio callbacks
+
+/// \ingroup io
+struct AudioTelemetry{
+	AudioTimeHistogram jitter;	///< Deviation of callback start from one period after previous start
+	AudioTimeHistogram duration;///< Time spent in callback
+	AudioTimeHistogram margin;	///< Time left in period after callback; zero when late
+	uint64_t blocks;			///< Number of callbacks
+	uint64_t late;				///< Number of callbacks taking longer than a period
+	uint64_t inputUnderflows;	///< Number of blocks with input underflow
+	uint64_t inputOverflows;	///< Number of blocks with input overflow (lost input)
+	uint64_t outputUnderflows;	///< Number of blocks with output underflow (gap in output)
+	uint64_t outputOverflows;	///< Number of blocks with output overflow
+	double period;				///< Period of callbacks, in seconds
+
+	AudioTelemetry(){ reset(); }
+
+	/// Clear all statistics
+	void reset();
+
+	/// Get total number of xruns
+	uint64_t xruns() const { return inputUnderflows + inputOverflows + outputUnderflows + outputOverflows; }
+
+	/// Print summary to stdout
+	void print() const;
+};
+
+
 /// Audio input/output streaming
 class AudioIO : public AudioIOData {
 public:
 
+	/// Sample format of host buffers
+	enum SampleFormat{
+		FLOAT32,	/**< 32-bit float */
+		INT16,		/**< 16-bit integer */
+		INT24,		/**< Packed 24-bit integer */
+		INT32		/**< 32-bit integer */
+	};
+
+	/// Backend driving the callbacks
+
+	/// The headless backends need no device and run the callbacks on their
+	/// own thread once started, or on the calling thread with render(). Input
+	/// is silent and output is discarded after the usual gain, NaN zeroing 
+	/// and clipping. Telemetry is recorded as with a device and stream time
+	/// counts the frames processed.
+	enum Backend{
+		DEVICE,		/**< Audio device through PortAudio */
+		OFFLINE,	/**< No device; blocks are processed as fast as possible */
+		SIMULATED,	/**< No device; blocks start one period apart as with a device and
+						 blocks finishing after their deadline are counted as output
+						 underflows */
+		JACK,		/**< JACK client with zero-copy port buffers (GAM_AUDIO_IO_JACK) */
+		ALSA		/**< ALSA device in mmap mode (GAM_AUDIO_IO_ALSA) */
+	};
+
 	/// Creates AudioIO using default I/O devices.
 
 	/// \param[in] framesPerBuf		Number of sample frames to process per callback
@@ -220,12 +326,17 @@ public:
 	bool autoZeroOut() const { return mAutoZeroOut; }
 	int channels(bool forOutput) const;
 	bool clipOut() const { return mClipOut; }	///< Returns clipOut setting
+	bool flushDenormals() const { return mFlushDenormals; }	///< Returns whether denormals are flushed to zero in callback
 	double cpu() const;							///< Returns current CPU usage of audio thread
 	bool supportsFPS(double fps) const;			///< Return true if fps supported, otherwise false
 	bool zeroNANs() const;						///< Returns whether to zero NANs in output buffer going to DAC
+	bool nonInterleaved() const;				///< Returns whether stream uses non-interleaved host buffers
+	SampleFormat deviceFormat() const;			///< Returns sample format of host buffers
+	Backend backend() const;					///< Returns backend driving the callbacks
 	
 	void processAudio();						///< Call callback manually
 	bool open();								///< Opens audio device.
+	bool open(Backend b);						///< Opens stream with specified backend.
 	bool close();								///< Closes audio device. Will stop active IO.
 	bool start();								///< Starts the audio IO.  Will open audio device if necessary.
 	bool stop();								///< Stops the audio IO.
@@ -243,6 +354,13 @@ public:
 	void channelsOut(int n){channels(n,true);}	///< Set number of output channels
 	void channelsBus(int num);					///< Set number of bus channels
 	void clipOut(bool v){ mClipOut=v; }			///< Set whether to clip output between -1 and 1
+
+	/// Set whether to flush denormals to zero while processing audio
+
+	/// This is on by default and applies to the callback thread and any
+	/// parallel worker threads. \see DenormalGuard
+	void flushDenormals(bool v){ mFlushDenormals=v; }
+
 	void device(const AudioDevice& v);			///< Set input/output device (must be duplex)	
 	void deviceIn(const AudioDevice& v);		///< Set input device
 	void deviceOut(const AudioDevice& v);		///< Set output device
@@ -250,6 +368,78 @@ public:
 	void framesPerBuffer(int n);				///< Set number of frames per processing buffer
 	void zeroNANs(bool v){ mZeroNANs=v; }		///< Set whether to zero NANs in output buffer going to DAC
 
+	/// Set whether to open the stream with non-interleaved host buffers
+
+	/// In this mode, in() and out() point directly at the host's buffers when
+	/// they are contiguous and there are no virtual channels, otherwise data
+	/// is copied per channel. Either way, no (de)interleaving is done. This
+	/// can only be set while the stream is closed.
+	void nonInterleaved(bool v);
+
+	/// Set sample format of host buffers
+
+	/// Integer samples are converted to and from the float I/O buffers in
+	/// the same pass as (de)interleaving, with TPDF dither added to 16-bit
+	/// output. This can only be set while the stream is closed.
+	void deviceFormat(SampleFormat v);
+
+	/// Set backend driving the callbacks
+
+	/// The JACK and ALSA backends bypass PortAudio and must be enabled at 
+	/// build time. They open as many device channels as are requested (ALSA
+	/// may open fewer) and take the block size and rate of the server or 
+	/// device when these differ from the stream's. JACK ports are connected
+	/// to physical ports on start. The ALSA device runs in a ring of two 
+	/// blocks on a real-time thread using the stream's sample format and
+	/// layout. If the server shuts the client down or the device cannot be
+	/// restarted after an xrun, the callbacks stop and the next start()
+	/// reopens the stream. This can only be set while the stream is closed.
+	void backend(Backend v);
+
+	/// Set JACK client name or ALSA device name (e.g., "hw:0") of native backends
+
+	/// The defaults are "Gamma" and "default". This can only be set while 
+	/// the stream is closed.
+	void nativeDevice(const std::string& name);
+
+	/// Process blocks on the calling thread with a headless backend
+
+	/// The stream is opened if needed and must not be running. With the 
+	/// SIMULATED backend this takes as long as the blocks would last in real
+	/// time.
+	/// \returns whether blocks were processed
+	bool render(uint64_t numBlocks);
+
+	/// Set number of threads used to run appended callbacks in parallel
+
+	/// When more than one thread is used, each AudioCallback added with
+	/// append() or prepend() renders into its own output and bus buffers,
+	/// which are summed into the stream's buffers in callback order. The
+	/// callback function still runs first on the audio thread. Callbacks 
+	/// therefore see zeroed output and bus buffers rather than the output of
+	/// earlier callbacks and must not share mutable state. Worker threads get
+	/// real-time priority when permitted and busy-wait between blocks so that 
+	/// no system calls are made from the audio thread. This can only be set
+	/// while the stream is not running.
+	///
+	/// \param[in] numThreads	total number of threads, including the audio thread
+	/// \param[in] pin			whether to pin workers to their own processors, if 
+	///							there are enough
+	AudioIO& parallel(unsigned numThreads, bool pin=true);
+
+	/// Get number of threads used to run appended callbacks
+	unsigned threads() const;
+
+	/// Get timing and xrun statistics of callbacks
+
+	/// Statistics are collected by the audio thread without locks, so this 
+	/// can be called from any thread, e.g., to monitor when the buffer size
+	/// should be raised. The copy is consistent across all statistics.
+	void telemetry(AudioTelemetry& dst) const;
+
+	/// Clear timing and xrun statistics at the start of the next callback
+	void resetTelemetry();
+
 	void print();								///< Prints info about current i/o devices to stdout.
 
 	static const char * errorText(int errNum);		// Returns error string.
@@ -259,6 +449,7 @@ private:
 	bool mZeroNANs;			// whether to zero NANs
 	bool mClipOut;			// whether to clip output between -1 and 1
 	bool mAutoZeroOut;		// whether to automatically zero output buffers each block
+	bool mFlushDenormals;	// whether to flush denormals to zero in callback
 	std::vector<AudioCallback *> mAudioCallbacks;
 
 	void init();			//
@@ -0,0 +1,162 @@
+#ifndef GAMMA_BLOCK_H_INC
+#define GAMMA_BLOCK_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Uniform block processing of unit generators
+*/
+
+#include <utility>
+
+namespace gam{
+
+/// Way in which a unit processes or generates a block of samples
+
+/// Units take blocks in one of two ways. Processors with a process(in, out, n)
+/// method follow the convention of delays and envelope followers, while those
+/// with an operator()(out, in, n) follow that of filters and effects.
+/// Generators take blocks with generate(out, n) or operator()(out, n). Units
+/// without a block method are looped sample by sample.
+enum BlockMethod{
+	BLOCK_PER_SAMPLE,	/**< out[i] = u(in[i]) or out[i] = u() */
+	BLOCK_PROCESS,		/**< u.process(in, out, n) or u.generate(out, n) */
+	BLOCK_CALL			/**< u(out, in, n) or u(out, n) */
+};
+
+
+namespace{
+
+	template <unsigned N> struct BlockRank : BlockRank<N-1>{};
+	template <> struct BlockRank<0>{};
+
+	template <BlockMethod M>
+	struct BlockTag{ static const BlockMethod value = M; };
+
+	template <class U, class T>
+	auto blockMethod(BlockRank<2>)
+		-> decltype(std::declval<U&>().process((const T *)0, (T *)0, 0u), BlockTag<BLOCK_PROCESS>());
+
+	template <class U, class T>
+	auto blockMethod(BlockRank<1>)
+		-> decltype(std::declval<U&>()((T *)0, (const T *)0, 0u), BlockTag<BLOCK_CALL>());
+
+	template <class U, class T>
+	BlockTag<BLOCK_PER_SAMPLE> blockMethod(BlockRank<0>);
+
+	template <class U, class T>
+	auto generateMethod(BlockRank<2>)
+		-> decltype(std::declval<U&>().generate((T *)0, 0u), BlockTag<BLOCK_PROCESS>());
+
+	template <class U, class T>
+	auto generateMethod(BlockRank<1>)
+		-> decltype(std::declval<U&>()((T *)0, 0u), BlockTag<BLOCK_CALL>());
+
+	template <class U, class T>
+	BlockTag<BLOCK_PER_SAMPLE> generateMethod(BlockRank<0>);
+
+	template <class U, class T>
+	void processBlock(U& u, const T * in, T * out, unsigned n, BlockTag<BLOCK_PROCESS>){
+		u.process(in, out, n);
+	}
+
+	template <class U, class T>
+	void processBlock(U& u, const T * in, T * out, unsigned n, BlockTag<BLOCK_CALL>){
+		u(out, in, n);
+	}
+
+	template <class U, class T>
+	void processBlock(U& u, const T * in, T * out, unsigned n, BlockTag<BLOCK_PER_SAMPLE>){
+		for(unsigned i=0; i<n; ++i) out[i] = u(in[i]);
+	}
+
+	template <class U, class T>
+	void generateBlock(U& u, T * out, unsigned n, BlockTag<BLOCK_PROCESS>){
+		u.generate(out, n);
+	}
+
+	template <class U, class T>
+	void generateBlock(U& u, T * out, unsigned n, BlockTag<BLOCK_CALL>){
+		u(out, n);
+	}
+
+	template <class U, class T>
+	void generateBlock(U& u, T * out, unsigned n, BlockTag<BLOCK_PER_SAMPLE>){
+		for(unsigned i=0; i<n; ++i) out[i] = u();
+	}
+
+	template <class T>
+	void processSeriesTail(T *, unsigned){}
+
+	template <class T, class U, class... Us>
+	void processSeriesTail(T * io, unsigned n, U& u, Us&... us);
+}
+
+
+/// Block method used by process() for a unit and sample type
+template <class U, class T>
+struct ProcessMethod{
+	static const BlockMethod value = decltype(blockMethod<U,T>(BlockRank<2>()))::value;
+};
+
+/// Block method used by generate() for a unit and sample type
+template <class U, class T>
+struct GenerateMethod{
+	static const BlockMethod value = decltype(generateMethod<U,T>(BlockRank<2>()))::value;
+};
+
+
+/// Process a block of samples with a unit
+
+/// The unit's own block method is used if it has one (see BlockMethod), so
+/// optimized block implementations can be added to a class without any
+/// change to callers. Most units allow 'in' to equal 'out'.
+///
+/// \param[in] u		unit
+/// \param[in] in		input samples
+/// \param[out] out	output samples
+/// \param[in] n		number of samples
+template <class U, class T>
+inline void process(U& u, const T * in, T * out, unsigned n){
+	processBlock(u, in, out, n, BlockTag<ProcessMethod<U,T>::value>());
+}
+
+/// Generate a block of samples with a unit
+
+/// This calls u.generate(out, n) or u(out, n) if there is one, otherwise
+/// out[i] = u() is looped.
+template <class U, class T>
+inline void generate(U& u, T * out, unsigned n){
+	generateBlock(u, out, n, BlockTag<GenerateMethod<U,T>::value>());
+}
+
+/// Process a block through a series of units
+
+/// The first unit processes 'in' into 'out' and each following unit
+/// processes 'out' in place.
+template <class T, class U, class... Us>
+inline void processSeries(const T * in, T * out, unsigned n, U& u, Us&... us){
+	process(u, in, out, n);
+	processSeriesTail(out, n, us...);
+}
+
+/// Generate a block with a unit and process it through a series of units
+template <class T, class G, class... Us>
+inline void generateSeries(T * out, unsigned n, G& g, Us&... us){
+	generate(g, out, n);
+	processSeriesTail(out, n, us...);
+}
+
+
+namespace{
+	template <class T, class U, class... Us>
+	void processSeriesTail(T * io, unsigned n, U& u, Us&... us){
+		process(u, (const T *)io, io, n);
+		processSeriesTail(io, n, us...);
+	}
+}
+
+} // gam::
+
+#endif
@@ -0,0 +1,138 @@
+#ifndef GAMMA_CPU_H_INC
+#define GAMMA_CPU_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Runtime detection of CPU features and dispatch of SIMD kernels
+*/
+
+#include <atomic>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+	#define GAM_CPU_X86
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#define GAM_CPU_NEON
+#endif
+
+// Marks a function to be compiled for an instruction set beyond that of the
+// build, so that it can be dispatched to at runtime. MSVC needs no marking.
+#if defined(GAM_CPU_X86) && (defined(__GNUC__) || defined(__clang__))
+	#define GAM_TARGET_AVX2 __attribute__((target("avx2,fma,f16c")))
+	#define GAM_TARGET_AVX512 __attribute__((target("avx512f,avx2,fma,f16c")))
+#else
+	#define GAM_TARGET_AVX2
+	#define GAM_TARGET_AVX512
+#endif
+
+namespace gam{
+
+/// CPU features relevant to SIMD kernels
+enum CPUFeature{
+	CPU_SSE2	= 1<<0,
+	CPU_SSE41	= 1<<1,
+	CPU_AVX		= 1<<2,
+	CPU_AVX2	= 1<<3,		/**< AVX2, FMA3 and F16C */
+	CPU_AVX512	= 1<<4,		/**< AVX-512 Foundation */
+	CPU_NEON	= 1<<5
+};
+
+/// SIMD code path of dispatched kernels
+enum SIMDPath{
+	SIMD_SCALAR,		/**< Portable scalar code */
+	SIMD_SSE2,			/**< SSE2 (x86) */
+	SIMD_AVX2,			/**< AVX2, FMA3 and F16C (x86) */
+	SIMD_AVX512,		/**< AVX-512F (x86) */
+	SIMD_NEON			/**< NEON (ARM) */
+};
+
+
+/// Get features of the CPU, as bits of CPUFeature
+
+/// Features needing operating system support, such as the wide registers of
+/// AVX, are only reported when the OS saves them on context switches.
+unsigned cpuFeatures();
+
+/// Get whether a SIMD path runs on this CPU and was compiled in
+bool simdSupported(SIMDPath p);
+
+/// Get best SIMD path of this CPU
+SIMDPath simdBest();
+
+/// Get SIMD path used by dispatched kernels
+
+/// On first use, this is the path named by the environment variable
+/// GAMMA_SIMD (scalar, sse2, avx2, avx512 or neon), if set, and otherwise
+/// the best path of the CPU. Requesting an unsupported path gives the best
+/// supported path below it.
+SIMDPath simdPath();
+
+/// Set SIMD path used by dispatched kernels, returning the path set
+
+/// This is meant for testing and benchmarking. Kernels rebind on their next
+/// call; calls already running finish on their old path.
+SIMDPath simdPath(SIMDPath p);
+
+/// Get name of a SIMD path
+const char * simdPathName(SIMDPath p);
+
+/// Parse name of a SIMD path, returning false if unknown
+bool simdPathFromName(SIMDPath& p, const char * name);
+
+
+/// Get count of changes of the SIMD path, used by SIMDDispatch
+std::atomic<unsigned>& simdEpoch();
+
+
+/// Function pointer bound to the current SIMD path
+
+/// A kernel provides one implementation per path it has; null entries fall
+/// back to the next lower path on the same architecture and finally to the
+/// scalar implementation. Binding happens on the first call and again after
+/// the path is changed with simdPath(SIMDPath), costing one atomic load per
+/// call otherwise.
+template <class F>
+class SIMDDispatch{
+public:
+
+	/// \param[in] scalar	scalar implementation (required)
+	/// \param[in] sse2		SSE2 implementation
+	/// \param[in] avx2		AVX2 implementation
+	/// \param[in] avx512	AVX-512 implementation
+	/// \param[in] neon		NEON implementation
+	SIMDDispatch(F scalar, F sse2=0, F avx2=0, F avx512=0, F neon=0)
+	:	mBound(0), mEpoch(0)
+	{
+		mF[SIMD_SCALAR] = scalar; mF[SIMD_SSE2] = sse2; mF[SIMD_AVX2] = avx2;
+		mF[SIMD_AVX512] = avx512; mF[SIMD_NEON] = neon;
+	}
+
+	/// Get implementation for the current path
+	F operator()(){
+		unsigned e = simdEpoch().load(std::memory_order_acquire);
+		if(mEpoch.load(std::memory_order_acquire) != e + 1) bind(e);
+		return mBound.load(std::memory_order_relaxed);
+	}
+
+	/// Get implementation that would be used for a path
+	F on(SIMDPath p) const {
+		if(p == SIMD_NEON) return mF[SIMD_NEON] ? mF[SIMD_NEON] : mF[SIMD_SCALAR];
+		for(int k=p; k>SIMD_SCALAR; --k){ if(mF[k]) return mF[k]; }
+		return mF[SIMD_SCALAR];
+	}
+
+private:
+	F mF[5];
+	std::atomic<F> mBound;
+	std::atomic<unsigned> mEpoch; // epoch bound plus one, 0 if unbound
+
+	void bind(unsigned e){
+		mBound.store(on(simdPath()), std::memory_order_relaxed);
+		mEpoch.store(e + 1, std::memory_order_release);
+	}
+};
+
+} // gam::
+
+#endif
@@ -0,0 +1,251 @@
+#ifndef GAMMA_CHAIN_H_INC
+#define GAMMA_CHAIN_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Expression templates fusing chains of unit generators into one loop
+*/
+
+#include <type_traits>
+#include <utility>
+#include "Gamma/Block.h"
+#include "Gamma/Domain.h"
+
+namespace gam{
+
+/// Base of unit generator expressions
+
+/// Expressions are built from existing units with the operators >>, * and +.
+/// 'a >> b' feeds the output of a into b. 'a * b' and 'a + b' combine the
+/// outputs of a and b, feeding each the input of the expression if it takes
+/// one or else generating from it, so 'lpf * env' is a gain-enveloped filter.
+/// Either operand of * and + may also be a number. For example,
+///
+///		auto voice = osc >> lpf * env >> pan;
+///		voice.generate(out, n);	// or out[i] = voice()
+///
+/// Expressions hold references to their units, which must outlive them. A
+/// unit with a domain (a DomainObserver) may appear on both sides of an
+/// operator; other units, such as Pan, need an expression on the other side.
+///
+/// The block methods call the whole chain once per sample in a single loop,
+/// rather than one loop per unit with a buffer between each. Units are still
+/// called through their references; the loop only writes a local buffer,
+/// which cannot alias any unit, so output stores do not force unit state to
+/// be reloaded. Whether that state stays in registers across samples depends
+/// on the compiler inlining every unit.
+template <class D>
+class UnitExpr{
+public:
+
+	/// Generate a block
+	template <class T>
+	void generate(T * out, unsigned n){
+		D& d = static_cast<D&>(*this);
+		while(n){
+			const unsigned m = n < B ? n : B;
+			T buf[B];
+			for(unsigned i=0; i<m; ++i) buf[i] = d();
+			for(unsigned i=0; i<m; ++i) out[i] = buf[i];
+			out += m; n -= m;
+		}
+	}
+
+	/// Process a block; 'in' may equal 'out'
+	template <class Ti, class To>
+	void process(const Ti * in, To * out, unsigned n){
+		D& d = static_cast<D&>(*this);
+		while(n){
+			const unsigned m = n < B ? n : B;
+			To buf[B];
+			for(unsigned i=0; i<m; ++i) buf[i] = d(in[i]);
+			for(unsigned i=0; i<m; ++i) out[i] = buf[i];
+			in += m; out += m; n -= m;
+		}
+	}
+
+private:
+	enum{ B = 64 };
+};
+
+
+/// Reference to a unit in an expression
+template <class U>
+class UnitRef : public UnitExpr<UnitRef<U> >{
+public:
+	explicit UnitRef(U& u): mU(u){}
+
+	template <class... X>
+	auto operator()(const X&... x) -> decltype(std::declval<U&>()(x...)){ return mU(x...); }
+
+private:
+	U& mU;
+};
+
+
+/// Constant in an expression
+template <class T>
+class UnitConst : public UnitExpr<UnitConst<T> >{
+public:
+	explicit UnitConst(T v): mV(v){}
+
+	template <class... X>
+	T operator()(const X&...) const { return mV; }
+
+private:
+	T mV;
+};
+
+
+namespace{
+
+	template <unsigned N> struct ChainRank : ChainRank<N-1>{};
+	template <> struct ChainRank<0>{};
+
+	// Call with the input if the unit takes it, otherwise generate
+	template <class U, class... X>
+	auto chainFeed(U& u, ChainRank<1>, const X&... x) -> decltype(u(x...)){ return u(x...); }
+
+	template <class U, class... X>
+	auto chainFeed(U& u, ChainRank<0>, const X&...) -> decltype(u()){ return u(); }
+}
+
+
+/// Output of one expression fed into another
+template <class A, class B>
+class UnitSeries : public UnitExpr<UnitSeries<A,B> >{
+public:
+	UnitSeries(const A& a, const B& b): mA(a), mB(b){}
+
+	template <class... X>
+	auto operator()(const X&... x) -> decltype(std::declval<B&>()(std::declval<A&>()(x...))){
+		return mB(mA(x...));
+	}
+
+private:
+	A mA; B mB;
+};
+
+
+/// Product of the outputs of two expressions
+template <class A, class B>
+class UnitProduct : public UnitExpr<UnitProduct<A,B> >{
+public:
+	UnitProduct(const A& a, const B& b): mA(a), mB(b){}
+
+	template <class... X>
+	auto operator()(const X&... x) -> decltype(
+		chainFeed(std::declval<A&>(), ChainRank<1>(), x...) * chainFeed(std::declval<B&>(), ChainRank<1>(), x...)
+	){
+		return chainFeed(mA, ChainRank<1>(), x...) * chainFeed(mB, ChainRank<1>(), x...);
+	}
+
+private:
+	A mA; B mB;
+};
+
+
+/// Sum of the outputs of two expressions
+template <class A, class B>
+class UnitSum : public UnitExpr<UnitSum<A,B> >{
+public:
+	UnitSum(const A& a, const B& b): mA(a), mB(b){}
+
+	template <class... X>
+	auto operator()(const X&... x) -> decltype(
+		chainFeed(std::declval<A&>(), ChainRank<1>(), x...) + chainFeed(std::declval<B&>(), ChainRank<1>(), x...)
+	){
+		return chainFeed(mA, ChainRank<1>(), x...) + chainFeed(mB, ChainRank<1>(), x...);
+	}
+
+private:
+	A mA; B mB;
+};
+
+
+/// Make an expression from a unit
+template <class U>
+UnitRef<U> unit(U& u){ return UnitRef<U>(u); }
+
+
+namespace{
+
+	template <class T>
+	struct IsUnitExpr{
+		template <class D> static std::true_type test(const UnitExpr<D> *);
+		static std::false_type test(...);
+		enum{ value = decltype(test((const T *)0))::value };
+	};
+
+	// Maps an operand to an expression
+	template <class T,
+		int K = IsUnitExpr<T>::value ? 0 : std::is_arithmetic<T>::value ? 1 : 2>
+	struct ChainOperand{
+		typedef T type;
+		static const T& make(const T& v){ return v; }
+	};
+
+	template <class T>
+	struct ChainOperand<T,1>{
+		typedef UnitConst<T> type;
+		static type make(T v){ return type(v); }
+	};
+
+	template <class T>
+	struct ChainOperand<T,2>{
+		typedef UnitRef<T> type;
+		static type make(T& v){ return type(v); }
+	};
+
+	// Whether operands make an expression: at least one is an expression or
+	// a unit with a domain and the other is an expression, unit or, if
+	// allowed, number. Units are referenced, so they must be lvalues.
+	template <class A, class B, bool Numbers=true>
+	struct ChainOperands{
+		typedef typename std::decay<A>::type Ta;
+		typedef typename std::decay<B>::type Tb;
+		enum{
+			unitA = IsUnitExpr<Ta>::value || std::is_base_of<DomainObserver, Ta>::value,
+			unitB = IsUnitExpr<Tb>::value || std::is_base_of<DomainObserver, Tb>::value,
+			numA = Numbers && std::is_arithmetic<Ta>::value,
+			numB = Numbers && std::is_arithmetic<Tb>::value,
+			okA = !std::is_arithmetic<Ta>::value ? IsUnitExpr<Ta>::value || std::is_lvalue_reference<A>::value : numA,
+			okB = !std::is_arithmetic<Tb>::value ? IsUnitExpr<Tb>::value || std::is_lvalue_reference<B>::value : numB,
+			anyExpr = IsUnitExpr<Ta>::value || IsUnitExpr<Tb>::value,
+			value = okA && okB && (anyExpr || (unitA && unitB) || (unitA && numB) || (unitB && numA))
+		};
+		typedef typename ChainOperand<Ta>::type Ea;
+		typedef typename ChainOperand<Tb>::type Eb;
+	};
+}
+
+
+/// Feed output of a into b
+template <class A, class B, class O = ChainOperands<A,B,false> >
+typename std::enable_if<O::value, UnitSeries<typename O::Ea, typename O::Eb> >::type
+operator >> (A&& a, B&& b){
+	return UnitSeries<typename O::Ea, typename O::Eb>(
+		ChainOperand<typename O::Ta>::make(a), ChainOperand<typename O::Tb>::make(b));
+}
+
+/// Multiply outputs of a and b
+template <class A, class B, class O = ChainOperands<A,B> >
+typename std::enable_if<O::value, UnitProduct<typename O::Ea, typename O::Eb> >::type
+operator * (A&& a, B&& b){
+	return UnitProduct<typename O::Ea, typename O::Eb>(
+		ChainOperand<typename O::Ta>::make(a), ChainOperand<typename O::Tb>::make(b));
+}
+
+/// Add outputs of a and b
+template <class A, class B, class O = ChainOperands<A,B> >
+typename std::enable_if<O::value, UnitSum<typename O::Ea, typename O::Eb> >::type
+operator + (A&& a, B&& b){
+	return UnitSum<typename O::Ea, typename O::Eb>(
+		ChainOperand<typename O::Ta>::make(a), ChainOperand<typename O::Tb>::make(b));
+}
+
+} // gam::
+
+#endif
@@ -19,4 +19,15 @@
 
 #endif
 
+// Common float and double instantiations of unit generators are compiled once
+// into lib<name>_instances (make instances). Defining GAM_EXTERN_TEMPLATES
+// declares them extern so translation units do not instantiate them again.
+// GCC still inlines a member of such a class only if its declaration in the
+// class is inline, so per-sample members must be declared inline there.
+#if defined(GAM_INSTANTIATE_TEMPLATES)
+	#define GAM_EXTERN_TEMPLATE template
+#elif defined(GAM_EXTERN_TEMPLATES)
+	#define GAM_EXTERN_TEMPLATE extern template
+#endif
+
 #endif
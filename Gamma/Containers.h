@@ -10,8 +10,10 @@
 
 /// \defgroup Containers
 
+#include <atomic>
 #include <vector>
 #include <map>
+#include <utility>
 #include "Gamma/Allocator.h"
 #include "Gamma/Conversion.h"
 #include "Gamma/mem.h"
@@ -64,11 +66,76 @@ struct SizeArray{
 };
 
 
+/// Non-owning view of a contiguous sequence of elements
+
+/// This is a pointer and size pair that can be passed by value wherever a
+/// function only needs to access elements, without copying them or taking
+/// part in their ownership. The viewed memory must persist as long as the
+/// view is used.
+///
+/// \tparam T	element type; use const T for a read-only view
+/// \ingroup Containers
+template <class T>
+class ArrayView{
+public:
+	typedef T value_type;
+
+	/// Construct an empty view
+	ArrayView(): mElems(0), mSize(0){}
+
+	/// Construct from pointer and number of elements
+	ArrayView(T * src, uint32_t size): mElems(src), mSize(size){}
+
+	/// Construct from any array providing elems() and size(), or from a view of non-const elements
+	template <class Arr>
+	ArrayView(Arr& src): mElems(src.elems()), mSize(src.size()){}
+
+	template <class Arr>
+	ArrayView(const Arr& src): mElems(src.elems()), mSize(src.size()){}
+
+	/// Construct from std::vector
+	template <class U, class Alloc>
+	ArrayView(std::vector<U,Alloc>& src)
+	:	mElems(src.empty() ? 0 : &src[0]), mSize(src.size()){}
+
+	template <class U, class Alloc>
+	ArrayView(const std::vector<U,Alloc>& src)
+	:	mElems(src.empty() ? 0 : &src[0]), mSize(src.size()){}
+
+	T& operator[](uint32_t i) const { return mElems[i]; }
+
+	T * elems() const { return mElems; }		///< Get pointer to elements
+	uint32_t size() const { return mSize; }		///< Returns number of elements
+	bool empty() const { return 0 == mSize; }	///< Returns whether there are no elements
+
+	T * begin() const { return mElems; }
+	T * end() const { return mElems + mSize; }
+
+	/// Returns view of a range of elements
+
+	/// \param[in] start	index of first element
+	/// \param[in] len		number of elements, clipped to the end of this view
+	ArrayView slice(uint32_t start, uint32_t len) const {
+		if(start > mSize) start = mSize;
+		if(len > mSize - start) len = mSize - start;
+		return ArrayView(mElems + start, len);
+	}
+
+private:
+	T * mElems;
+	uint32_t mSize;
+};
+
+
 /// Abstract base class for array types
 
 /// When the array is resized, if the elements are class-types, then their
 /// default constructors are called and if the elements are non-class-types,
-/// then they are left uninitialized.
+/// then they are left uninitialized. Internally allocated elements can be
+/// shared between arrays with source() and are freed when the last array
+/// referencing them releases them. Their reference count is atomic and stored
+/// in the same memory block, so arrays can be created, shared and destroyed
+/// on any thread.
 ///
 /// \tparam T	array element type
 /// \tparam S	size functor (\see SizeArrayPow2, SizeArray)
@@ -112,10 +179,23 @@ public:
 	/// \param[in] src		array to copy
 	explicit ArrayBase(const ArrayBase<T,S,A>& src);
 
+	/// Construct by taking over the elements of another array
+
+	/// No elements are copied and the source array is left empty.
+	///
+	ArrayBase(ArrayBase<T,S,A>&& src);
+
 
 	virtual ~ArrayBase();
 
 
+	/// Take over the elements of another array
+
+	/// The current elements are released as by clear(). No elements are 
+	/// copied and the source array is left empty.
+	ArrayBase& operator=(ArrayBase<T,S,A>&& src);
+
+
 	/// Get write reference to element
 	T& operator[](uint32_t i);
 
@@ -175,37 +255,57 @@ public:
 	void resize(uint32_t newSize, const T& c=T());
 
 	/// Sets source of array elements to another array
+
+	/// If the other array manages its elements, they are shared and freed
+	/// once no array references them.
 	void source(ArrayBase<T,S,A>& src);
 
 	/// Sets source of array elements to another array
 
+	/// The memory is always managed externally and must persist as long as
+	/// it is referenced.
+	///
 	/// \param[in] src			C array to reference
 	/// \param[in] size			size of array, in elements
-	/// \param[in] unmanaged	whether the array memory shall be managed externally
+	/// \param[in] unmanaged	unused; kept for compatibility
 	void source(T * src, uint32_t size, bool unmanaged=false);
 
 	/// Called whenever the size changes
 	virtual void onResize(){}
 
-	/// Returns number of pointers to memory address being managed
-	static int references(T* m){
-		typename RefCount::const_iterator it = refCount().find(m);
-		return it != refCount().end() ? it->second : 0;
+	/// Returns number of arrays sharing our elements, or 0 if they are not managed
+	int references() const {
+		return mRefs ? mRefs->load(std::memory_order_acquire) : 0;
 	}
 
+	/// Returns bytes of heap memory allocated for managed elements
+
+	/// The reference count stored with the elements is included. Elements
+	/// referenced from external memory are not counted, and elements shared
+	/// with other arrays are counted by each of them.
+	std::size_t sizeInBytes() const { return mRefs ? blockSize(size())*sizeof(T) : 0; }
+
 protected:
+	typedef std::atomic<int> Refs;
+
 	T * mElems = 0;
 	S mSize{0};
+	Refs * mRefs = 0;	// count of arrays sharing managed elements, or NULL
 
-	typedef std::map<T *, int> RefCount;
+	// The reference count is stored after the elements in the same block,
+	// so the elements keep the alignment of the allocator.
+	static uint32_t refsOffset(uint32_t n){
+		return (n*sizeof(T) + alignof(Refs)-1) & ~uint32_t(alignof(Refs)-1);
+	}
 
-	static RefCount& refCount(){
-		static RefCount * o = new RefCount;
-		return *o;
+	// Returns number of elements to allocate for n elements and count
+	static uint32_t blockSize(uint32_t n){
+		return (refsOffset(n) + sizeof(Refs) + sizeof(T)-1) / sizeof(T);
 	}
 
-	// Is memory being managed (allocated/freed) automatically?
-	static bool managing(T* m){ return references(m) != 0; }
+	static Refs * refsOf(T * block, uint32_t n){
+		return reinterpret_cast<Refs *>(reinterpret_cast<char *>(block) + refsOffset(n));
+	}
 
 private: ArrayBase& operator=(const ArrayBase& v);
 };
@@ -225,9 +325,12 @@ public:
 	Array(T * src, uint32_t size): Base(src, size){}
 	Array(): Base(){}
 	explicit Array(const Array& src): Base(src){}
+	Array(Array&& src): Base(std::move(src)){}
 
 	virtual ~Array(){}
 
+	Array& operator=(Array&& src){ Base::operator=(std::move(src)); return *this; }
+
 private: Array& operator=(const Array& v);
 };
 
@@ -246,9 +349,12 @@ public:
 	ArrayPow2(T * src, uint32_t size): Base(src, size){}
 	ArrayPow2(): Base(){}
 	explicit ArrayPow2(const ArrayPow2& src): Base(src){}
+	ArrayPow2(ArrayPow2&& src): Base(std::move(src)){}
 
 	virtual ~ArrayPow2(){}
 
+	ArrayPow2& operator=(ArrayPow2&& src){ Base::operator=(std::move(src)); return *this; }
+
 	uint32_t fracBits() const;				///< Returns number of bits in fraction (32 - bits())
 	float fraction(uint32_t phase) const;	///< Get floating-point fractional part of fixed-point phase
 	uint32_t index(uint32_t phase) const;	///< Get integer part of fixed-point phase
@@ -319,6 +425,12 @@ public:
 	uint32_t indexPrev(uint32_t ago) const;	///< Returns absolute index of a previously written element
 
 	void operator()(const T& v);	///< Write new element
+
+	/// Write block of new elements
+
+	/// This is equivalent to writing each element in turn. If more elements
+	/// than the size of the ring are given, only the last are copied.
+	void write(const T * src, uint32_t len);
 	void pos(uint32_t index);		///< Set absolute buffer index of writer
 	void reset();					///< Reset write position to beginning
 	void writeClip(const T& v);		///< Writes element unless at end of buffer
@@ -344,7 +456,7 @@ public:
 	/// @param[in]	size		Number of elements in ring.
 	/// @param[in]	value		Initial value of all elements.
 	explicit DoubleRing(uint32_t size=0, const T& value=T())
-	:	Ring<T>(size, value), mRead(size)
+	:	Ring<T,A>(size, value), mRead(size)
 	{}
 
 	/// Returns reference to the reading buffer
@@ -378,6 +490,98 @@ protected:
 
 
 
+/// Ring buffer whose most recent elements are always contiguous
+
+/// Each element is stored twice, a ring size apart, so that any number of
+/// the most recently written elements, up to the size of the ring, can be 
+/// accessed in order from a single pointer without copying. This suits 
+/// analyses that read overlapping windows from a stream on each hop.
+///
+/// \tparam T	array element type
+/// \tparam A	memory allocator
+/// \ingroup Containers
+template <class T, class A=gam::Allocator<T> >
+class MirrorRing{
+public:
+
+	/// \param[in]	size		Number of elements in ring.
+	/// \param[in]	value		Initial value of all elements.
+	explicit MirrorRing(uint32_t size=0, const T& value=T())
+	:	mSize(0), mPos(0)
+	{	resize(size, value); }
+
+	/// Returns number of elements in ring
+	uint32_t size() const { return mSize; }
+
+	/// Returns absolute index of next element to be written
+	uint32_t pos() const { return mPos; }
+
+	/// Returns pointer to the last 'len' elements written, oldest first
+
+	/// The pointer stays valid until the next write. 'len' must not exceed
+	/// the size of the ring.
+	const T * latest(uint32_t len) const { return mBuf.elems() + mPos + mSize - len; }
+
+	/// Returns pointer to all elements, oldest first
+	const T * read() const { return latest(mSize); }
+
+	/// Returns reference to element 'ago' indices behind front
+	const T& read(uint32_t ago) const { return latest(ago+1)[0]; }
+
+	/// Returns reference to frontmost (newest) element
+	const T& readFront() const { return read(0); }
+
+	/// Returns reference to backmost (oldest) element
+	const T& readBack() const { return read()[0]; }
+
+	/// Write new element
+	void operator()(const T& v){
+		mBuf[mPos] = v;
+		mBuf[mPos + mSize] = v;
+		if(++mPos == mSize) mPos = 0;
+	}
+
+	/// Write block of new elements
+
+	/// This is equivalent to writing each element in turn. If more elements
+	/// than the size of the ring are given, only the last are copied.
+	void write(const T * src, uint32_t len){
+		if(!mSize) return;
+		if(len > mSize){
+			mPos = (mPos + len - mSize) % mSize;
+			src += len - mSize;
+			len = mSize;
+		}
+		while(len){
+			uint32_t n = scl::min(len, mSize - mPos);
+			T * dst = mBuf.elems() + mPos;
+			for(uint32_t i=0; i<n; ++i){
+				dst[i] = src[i];
+				dst[i + mSize] = src[i];
+			}
+			src += n; len -= n;
+			mPos += n; if(mPos == mSize) mPos = 0;
+		}
+	}
+
+	/// Resize ring, setting all elements to value
+	void resize(uint32_t size, const T& value=T()){
+		mBuf.resize(2*size);
+		mSize = mBuf.size()/2;
+		mBuf.assign(value);
+		mPos = 0;
+	}
+
+	/// Reset write position to beginning
+	void reset(){ mPos = 0; }
+
+private:
+	Array<T,A> mBuf;
+	uint32_t mSize, mPos;
+};
+
+
+
 /// N-element delay
 
 /// Specialized Ring that provides a simple N-element delay.
@@ -406,6 +610,134 @@ struct DelayN: public Ring<T,A>{
 };
 
 
+/// Bounded, wait-free single-producer/single-consumer queue
+
+/// This is a fixed-capacity FIFO that is safe to use between exactly one 
+/// writing thread and exactly one reading thread without any locks. No 
+/// memory is allocated after resize() so push and pop can be called from a 
+/// real-time thread. When the queue is full, push() fails and an overflow 
+/// count is incremented.
+///
+/// \tparam T	element type
+/// \tparam A	memory allocator
+/// \ingroup Containers
+template <class T, class A=gam::Allocator<T> >
+class SPSCQueue{
+public:
+
+	/// \param[in] capacity	maximum number of elements (rounded up to a power of 2)
+	explicit SPSCQueue(uint32_t capacity=0);
+
+	/// Push element onto back of queue (producer thread)
+
+	/// \returns true on success or false if the queue is full
+	///
+	bool push(const T& v);
+
+	/// Pop element from front of queue (consumer thread)
+
+	/// \returns true on success or false if the queue is empty
+	///
+	bool pop(T& v);
+
+	/// Get pointer to front element or NULL if empty (consumer thread)
+	T * front();
+
+	/// Remove front element, if any (consumer thread)
+	void pop();
+
+	bool empty() const;				///< Returns whether queue is empty
+	bool full() const;				///< Returns whether queue is full
+	uint32_t size() const;			///< Returns number of elements in queue
+	uint32_t capacity() const;		///< Returns maximum number of elements
+
+	/// Returns number of failed pushes due to a full queue
+	uint32_t overflows() const { return mOverflows.load(std::memory_order_relaxed); }
+
+	/// Reset overflow count to zero
+	void resetOverflows(){ mOverflows.store(0, std::memory_order_relaxed); }
+
+	/// Set capacity and empty the queue
+
+	/// This allocates memory and must not be called while other threads are
+	/// accessing the queue.
+	void resize(uint32_t capacity);
+
+protected:
+	Array<T,A> mBuf;
+	uint32_t mMask;
+	std::atomic<uint32_t> mWrite;		// total pushes, written by producer
+	std::atomic<uint32_t> mRead;		// total pops, written by consumer
+	std::atomic<uint32_t> mOverflows;
+};
+
+
+/// Bounded, lock-free multiple-producer/single-consumer queue
+
+/// This is a fixed-capacity FIFO that any number of threads may push onto
+/// while exactly one thread pops, without any locks. Each slot carries a
+/// sequence number so producers claim slots with a single atomic increment
+/// and the consumer never waits on a producer that has not finished writing;
+/// such an element simply appears on a later pop. No memory is allocated
+/// after resize(). When the queue is full, push() fails and an overflow count
+/// is incremented.
+///
+/// \tparam T	element type; must be default constructible and assignable
+/// \ingroup Containers
+template <class T>
+class MPSCQueue{
+public:
+
+	/// \param[in] capacity	maximum number of elements (rounded up to a power of 2)
+	explicit MPSCQueue(uint32_t capacity=0);
+
+	~MPSCQueue(){ delete[] mCells; }
+
+	/// Push element onto back of queue (any thread)
+
+	/// \returns true on success or false if the queue is full
+	///
+	bool push(const T& v);
+
+	/// Pop element from front of queue (consumer thread)
+
+	/// \returns true on success or false if the queue is empty
+	///
+	bool pop(T& v);
+
+	bool empty() const;				///< Returns whether queue is empty
+	uint32_t size() const;			///< Returns approximate number of elements in queue
+	uint32_t capacity() const { return mMask ? mMask+1 : 0; } ///< Returns maximum number of elements
+
+	/// Returns number of failed pushes due to a full queue
+	uint32_t overflows() const { return mOverflows.load(std::memory_order_relaxed); }
+
+	/// Reset overflow count to zero
+	void resetOverflows(){ mOverflows.store(0, std::memory_order_relaxed); }
+
+	/// Set capacity and empty the queue
+
+	/// This allocates memory and must not be called while other threads are
+	/// accessing the queue.
+	void resize(uint32_t capacity);
+
+protected:
+	struct Cell{
+		std::atomic<uint32_t> seq;	// write count when free, write count + 1 when full
+		T value;
+	};
+
+	Cell * mCells;
+	uint32_t mMask;
+	std::atomic<uint32_t> mWrite;		// total slots claimed by producers
+	std::atomic<uint32_t> mRead;		// total pops, written by consumer
+	std::atomic<uint32_t> mOverflows;
+
+	MPSCQueue(const MPSCQueue&);
+	MPSCQueue& operator=(const MPSCQueue&);
+};
+
+
 
 // Implementation_______________________________________________________________
 
@@ -419,6 +751,11 @@ template <class T, class S, class A>
 ArrayBase<T,S,A>::ArrayBase(const ArrayBase<T,S,A>& src)
 {	resize(src.size()); assign(src); }
 
+template <class T, class S, class A>
+ArrayBase<T,S,A>::ArrayBase(ArrayBase<T,S,A>&& src)
+:	mElems(src.mElems), mSize(src.mSize), mRefs(src.mRefs)
+{	src.mElems = 0; src.mSize(0); src.mRefs = 0; }
+
 template <class T, class S, class A>
 ArrayBase<T,S,A>::ArrayBase(uint32_t sz)
 {	resize(sz); }
@@ -434,6 +771,20 @@ ArrayBase<T,S,A>::ArrayBase(T * src, uint32_t sz)
 template <class T, class S, class A>
 ArrayBase<T,S,A>::~ArrayBase(){ clear(); }
 
+template <class T, class S, class A>
+ArrayBase<T,S,A>& ArrayBase<T,S,A>::operator=(ArrayBase<T,S,A>&& src){
+	if(&src != this){
+		clear();
+		mElems = src.mElems;
+		mSize = src.mSize;
+		mRefs = src.mRefs;
+		src.mElems = 0; src.mSize(0); src.mRefs = 0;
+		src.onResize();
+		onResize();
+	}
+	return *this;
+}
+
 template <class T, class S, class A>
 ArrayBase<T,S,A>& ArrayBase<T,S,A>::assign(const T& v){
 	return assign(v, size());
@@ -472,43 +823,42 @@ template <class T, class S, class A>
 inline const T * ArrayBase<T,S,A>::elems() const { return mElems; }
 
 template <class T, class S, class A>
-void ArrayBase<T,S,A>::clear(){ //printf("ArrayBase::clear(): mElems=%p\n", mElems);
+void ArrayBase<T,S,A>::clear(){
 
 	// We will only attempt to deallocate the data if it exists and is being 
 	// managed (reference counted) by ArrayBase.
-	if(mElems && managing(mElems)){
-		int& c = refCount()[mElems];
-		--c;
-		if(0 == c){
-			refCount().erase(mElems);
+	if(mElems && mRefs){
+		if(1 == mRefs->fetch_sub(1, std::memory_order_acq_rel)){
 			for(uint32_t i=0; i<size(); ++i) A::destroy(mElems+i);
-			A::deallocate(mElems, size());
+			A::deallocate(mElems, blockSize(size()));
 		}
-		mElems=0; mSize(0);
+		mElems=0; mSize(0); mRefs=0;
 	}
 }
 
 template <class T, class S, class A>
 void ArrayBase<T,S,A>::own(){
-	T * oldElems = elems();
-
-	// If we are not the sole owner, do nothing...
-	if(!isSoleOwner()){
-		uint32_t oldSize = size();
-		clear();
-		resize(oldSize);
-		for(uint32_t i=0; i<size(); ++i) A::construct(mElems+i, oldElems[i]);
+	// If we are not the sole owner, copy elements into new memory
+	if(mElems && !isSoleOwner()){
+		uint32_t n = size();
+		T * newElems = A::allocate(blockSize(n));
+		if(newElems){
+			for(uint32_t i=0; i<n; ++i) A::construct(newElems+i, mElems[i]);
+			Refs * refs = new(refsOf(newElems, n)) Refs(1);
+			clear();
+			mElems = newElems; mRefs = refs; mSize(n);
+		}
 	}
 }
 
 template <class T, class S, class A>
 bool ArrayBase<T,S,A>::isSoleOwner() const {
-	return references((T*)elems()) == 1;
+	return references() == 1;
 }
 
 template <class T, class S, class A>
 bool ArrayBase<T,S,A>::usingExternalSource() const {
-	return elems() && !managing((T*)elems());
+	return elems() && !mRefs;
 }
 
 template <class T, class S, class A>
@@ -527,7 +877,7 @@ void ArrayBase<T,S,A>::resize(uint32_t newSize, const T& c){
 
 	if(newSize != size()){
 
-		T * newElems = A::allocate(newSize);
+		T * newElems = A::allocate(blockSize(newSize));
 
 		// If successful allocation...
 		if(newElems){
@@ -544,10 +894,10 @@ void ArrayBase<T,S,A>::resize(uint32_t newSize, const T& c){
 				A::construct(newElems+i, c);
 			}
 
+			Refs * refs = new(refsOf(newElems, newSize)) Refs(1);
 			clear();
 			mElems = newElems;
-
-			refCount()[mElems] = 1;
+			mRefs = refs;
 			mSize(newSize);
 			onResize();
 		}
@@ -560,19 +910,22 @@ inline uint32_t ArrayBase<T,S,A>::size() const { return mSize(); }
 
 template <class T, class S, class A>
 void ArrayBase<T,S,A>::source(ArrayBase<T,S,A>& src){
-	source(src.elems(), src.size());
+	if(src.mElems == mElems) return; // check for self assignment
+	Refs * refs = src.mRefs;
+	if(refs) refs->fetch_add(1, std::memory_order_relaxed);
+	clear();
+	mElems = src.mElems;
+	mRefs = refs;
+	mSize(src.size());
+	onResize();
 }
 
 template <class T, class S, class A>
-void ArrayBase<T,S,A>::source(T * src, uint32_t size, bool unmanaged){
+void ArrayBase<T,S,A>::source(T * src, uint32_t size, bool /*unmanaged*/){
 	if(src == mElems) return; // check for self assignment
-	if(false==unmanaged){
-		clear();
-		if(managing(src)){
-			++refCount()[src];
-		}
-	}
+	clear();
 	mElems = src;
+	mRefs = 0;
 	mSize(size);
 	onResize();
 }
@@ -615,6 +968,24 @@ inline void Ring<T,A>::operator()(const T& v){
 	(*this)[pos()] = v;		// write new element
 }
 
+template<class T, class A>
+void Ring<T,A>::write(const T * src, uint32_t len){
+	if(!size()) return;
+	if(len > size()){
+		mPos = (mPos + len - size()) % size();
+		src += len - size();
+		len = size();
+	}
+	while(len){
+		incPos();
+		uint32_t n = scl::min(len, size() - mPos);
+		T * dst = elems() + mPos;
+		for(uint32_t i=0; i<n; ++i) dst[i] = src[i];
+		src += n; len -= n;
+		mPos += n - 1;
+	}
+}
+
 template<class T, class A>
 void Ring<T,A>::read(T * dst, uint32_t len, int32_t delay) const{
 	// pos() points to most recently written slot
@@ -673,5 +1044,141 @@ inline void Ring<T,A>::writeClip(const T& v){
 	}
 }
 
+
+//---- SPSCQueue
+
+template<class T, class A>
+SPSCQueue<T,A>::SPSCQueue(uint32_t cap)
+:	mMask(0), mWrite(0), mRead(0), mOverflows(0)
+{	resize(cap); }
+
+template<class T, class A>
+void SPSCQueue<T,A>::resize(uint32_t cap){
+	cap = cap ? scl::ceilPow2(cap) : 0;
+	mBuf.resize(cap);
+	mMask = cap ? cap-1 : 0;
+	mWrite.store(0, std::memory_order_relaxed);
+	mRead.store(0, std::memory_order_relaxed);
+	resetOverflows();
+}
+
+template<class T, class A>
+inline uint32_t SPSCQueue<T,A>::capacity() const { return mBuf.size(); }
+
+template<class T, class A>
+inline uint32_t SPSCQueue<T,A>::size() const {
+	return mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire);
+}
+
+template<class T, class A>
+inline bool SPSCQueue<T,A>::empty() const { return 0 == size(); }
+
+template<class T, class A>
+inline bool SPSCQueue<T,A>::full() const { return size() >= capacity(); }
+
+template<class T, class A>
+inline bool SPSCQueue<T,A>::push(const T& v){
+	uint32_t w = mWrite.load(std::memory_order_relaxed);
+	if(w - mRead.load(std::memory_order_acquire) >= capacity()){
+		mOverflows.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	mBuf[w & mMask] = v;
+	mWrite.store(w+1, std::memory_order_release);
+	return true;
+}
+
+template<class T, class A>
+inline T * SPSCQueue<T,A>::front(){
+	uint32_t r = mRead.load(std::memory_order_relaxed);
+	if(r == mWrite.load(std::memory_order_acquire)) return 0;
+	return &mBuf[r & mMask];
+}
+
+template<class T, class A>
+inline void SPSCQueue<T,A>::pop(){
+	uint32_t r = mRead.load(std::memory_order_relaxed);
+	if(r != mWrite.load(std::memory_order_acquire)){
+		mRead.store(r+1, std::memory_order_release);
+	}
+}
+
+template<class T, class A>
+inline bool SPSCQueue<T,A>::pop(T& v){
+	T * f = front();
+	if(!f) return false;
+	v = *f;
+	pop();
+	return true;
+}
+
+
+//---- MPSCQueue
+
+template<class T>
+MPSCQueue<T>::MPSCQueue(uint32_t cap)
+:	mCells(0), mMask(0), mWrite(0), mRead(0), mOverflows(0)
+{	resize(cap); }
+
+template<class T>
+void MPSCQueue<T>::resize(uint32_t cap){
+	cap = cap ? scl::ceilPow2(cap) : 0;
+	delete[] mCells;
+	mCells = cap ? new Cell[cap] : 0;
+	for(uint32_t i=0; i<cap; ++i) mCells[i].seq.store(i, std::memory_order_relaxed);
+	mMask = cap ? cap-1 : 0;
+	mWrite.store(0, std::memory_order_relaxed);
+	mRead.store(0, std::memory_order_relaxed);
+	resetOverflows();
+}
+
+template<class T>
+inline uint32_t MPSCQueue<T>::size() const {
+	uint32_t n = mWrite.load(std::memory_order_acquire) - mRead.load(std::memory_order_acquire);
+	return n < capacity() ? n : capacity();
+}
+
+template<class T>
+inline bool MPSCQueue<T>::empty() const { return 0 == size(); }
+
+template<class T>
+bool MPSCQueue<T>::push(const T& v){
+	if(!mCells){
+		mOverflows.fetch_add(1, std::memory_order_relaxed);
+		return false;
+	}
+	uint32_t w = mWrite.load(std::memory_order_relaxed);
+	for(;;){
+		Cell& c = mCells[w & mMask];
+		const int32_t dif = int32_t(c.seq.load(std::memory_order_acquire) - w);
+		if(0 == dif){
+			if(mWrite.compare_exchange_weak(w, w+1, std::memory_order_relaxed)){
+				c.value = v;
+				c.seq.store(w+1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if(dif < 0){ // slot not yet popped since last lap
+			mOverflows.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else{
+			w = mWrite.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<class T>
+bool MPSCQueue<T>::pop(T& v){
+	if(!mCells) return false;
+	const uint32_t r = mRead.load(std::memory_order_relaxed);
+	Cell& c = mCells[r & mMask];
+	if(c.seq.load(std::memory_order_acquire) != r+1) return false;
+	v = c.value;
+	c.seq.store(r + mMask + 1, std::memory_order_release);
+	mRead.store(r+1, std::memory_order_release);
+	return true;
+}
+
 } // gam::
 #endif
@@ -65,6 +65,12 @@ uint32_t floatExponent(float v);
 /// Returns mantissa field as float between [0, 1).
 float floatMantissa(float v);
 
+/// Convert float to bits of half-precision (IEEE 754 binary16) float
+
+/// Values are rounded to nearest even; values too large become infinity.
+///
+uint16_t floatToHalf(float v);
+
 /// Cast float to int
 
 /// Reliable up to 2^24 (16777216)
@@ -83,6 +89,9 @@ uint32_t floatToUInt(float v);
 ///	Note: the fraction only has 24-bits of precision.
 float fraction(uint32_t bits, uint32_t phase);
 
+/// Convert bits of half-precision (IEEE 754 binary16) float to float
+float halfToFloat(uint16_t h);
+
 /// Convert 16-bit signed integer to floating point in [-1, 1)
 float intToUnit(int16_t v);
 
@@ -129,6 +138,76 @@ uint32_t unitToUInt2(float u);
 /// Convert unit float in [0,1) to 8-bit unsigned int in [0, 256).
 uint8_t unitToUInt8(float u);
 
+/// Convert floating point in [-1, 1) to 16-bit signed integer
+
+/// Values are rounded and clipped to the range of the integer.
+///
+int16_t unitToInt(float u);
+
+
+// Array versions, for converting blocks. These give the same results as the
+// scalar functions applied to each element and are branch-free so that they
+// vectorize. Destination and source may be the same array when their
+// elements have the same size.
+
+/// Array version of castIntRound
+void castIntRound(int32_t * dst, const double * src, unsigned len);
+
+/// Array version of castIntRound on floats
+void castIntRound(int32_t * dst, const float * src, unsigned len);
+
+/// Array version of castIntTrunc on floats
+void castIntTrunc(int32_t * dst, const float * src, unsigned len);
+
+/// Array version of floatToUInt, reliable up to 2^24
+void floatToUInt(uint32_t * dst, const float * src, unsigned len);
+
+/// Array version of punUF
+void punUF(float * dst, const uint32_t * src, unsigned len);
+
+/// Array version of uintToUnit<float>
+void uintToUnit(float * dst, const uint32_t * src, unsigned len);
+
+/// Array version of uintToUnitS<float>
+void uintToUnitS(float * dst, const uint32_t * src, unsigned len);
+
+/// Convert unit phases to 32-bit fixed-point phases, as Accum
+
+/// Phases are wrapped, so that 1.25 and -0.75 both become 2^30.
+///
+void unitToPhase(uint32_t * dst, const double * src, unsigned len);
+
+
+/// Half-precision (IEEE 754 binary16) floating-point number
+
+/// This is a storage type that halves the memory of float data. It converts
+/// to and from float, in which all arithmetic is done.
+struct Half{
+	Half(): bits(0){}
+	Half(float v): bits(floatToHalf(v)){}
+	operator float() const { return halfToFloat(bits); }
+	uint16_t bits;
+};
+
+/// 16-bit fixed-point sample in [-1, 1)
+
+/// This is a storage type that halves the memory of float samples. It
+/// converts to and from float, in which all arithmetic is done.
+struct Sample16{
+	Sample16(): value(0){}
+	Sample16(float v): value(unitToInt(v)){}
+	operator float() const { return intToUnit(value); }
+	int16_t value;
+};
+
+/// Type to compute with for values stored as T
+
+/// This is T except for storage types, such as Half and Sample16, which are
+/// computed with as float.
+template <class T> struct ComputeType{ typedef T type; };
+template <> struct ComputeType<Half>{ typedef float type; };
+template <> struct ComputeType<Sample16>{ typedef float type; };
+
 
 
 // Implementation
@@ -193,6 +272,30 @@ effective  precision
 
 */
 
+inline uint16_t floatToHalf(float v){
+	const uint32_t x = punFU(v);
+	const uint32_t s = (x >> 16) & 0x8000;
+	const uint32_t a = x & 0x7fffffff;
+	if(a >= 0x7f800000) return uint16_t(s | 0x7c00 | (a > 0x7f800000 ? 0x200 : 0)); // inf, nan
+	if(a >= 0x477ff000) return uint16_t(s | 0x7c00); // rounds past largest half
+	if(a < 0x38800000){ // subnormal half; let the FPU round by adding 0.5
+		return uint16_t(s | (punFU(punUF(a) + 0.5f) - 0x3f000000));
+	}
+	// rebias exponent and round mantissa to nearest even
+	return uint16_t(s | ((a + 0xc8000fff + ((a >> 13) & 1)) >> 13));
+}
+
+inline float halfToFloat(uint16_t h){
+	const uint32_t s = uint32_t(h & 0x8000) << 16;
+	const uint32_t e = (h >> 10) & 0x1f;
+	const uint32_t m = h & 0x3ff;
+	if(0 == e){ // zero or subnormal
+		return punUF(s | punFU(float(m) * (1.f/16777216.f)));
+	}
+	if(31 == e) return punUF(s | 0x7f800000 | (m << 13));
+	return punUF(s | ((e + 112) << 23) | (m << 13));
+}
+
 inline uint32_t floatExponent(float v){
 	return punFU(v) >> 23 & 0xff;
 }
@@ -244,6 +347,11 @@ inline uint32_t unitToUInt2(float v){
 //	return punFU(v) << 12;
 //}
 
+inline int16_t unitToInt(float u){
+	const float v = u * 32768.f;
+	return int16_t(v >= 32767.f ? 32767 : v > -32768.f ? castIntRound(v) : -32768);
+}
+
 inline uint8_t unitToUInt8(float u){
 	++u;
 	return uint8_t((punFU(u) >> 15) & MaskFrac<float>());
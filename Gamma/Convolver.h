@@ -0,0 +1,275 @@
+#ifndef GAMMA_CONVOLVER_H_INC
+#define GAMMA_CONVOLVER_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Block-based convolution of signals with long impulse responses
+*/
+
+#include <atomic>
+#include <vector>
+#include "Gamma/FFT.h"
+#include "Gamma/Thread.h"
+
+namespace gam{
+
+/// Uniformly partitioned FFT convolver
+
+/// This convolves a signal with an impulse response (IR) one block at a time
+/// using uniformly partitioned overlap-save. The IR is split into partitions
+/// of the block size whose spectra are multiplied with a frequency-domain
+/// delay line of past input spectra. The latency is zero beyond the block
+/// itself, so the block size is normally set to
+/// AudioIOData::framesPerBuffer(). The cost per block is one forward and
+/// one inverse FFT of twice the block size plus a complex multiply-accumulate
+/// over each partition.
+///
+/// All memory is allocated by resize(); ir() and process() do not allocate
+/// and so are safe to call from the audio thread, but not concurrently.
+/// One instance handles one channel.
+class Convolver{
+public:
+
+	/// \param[in] blockSize	number of samples per processing block
+	/// \param[in] maxIRSize	maximum number of samples in impulse response
+	Convolver(unsigned blockSize=0, unsigned maxIRSize=0);
+
+
+	/// Get number of samples per processing block
+	unsigned blockSize() const { return mBlockSize; }
+
+	/// Get maximum number of impulse response samples
+	unsigned maxIRSize() const { return mMaxParts * mBlockSize; }
+
+	/// Get number of partitions of current impulse response
+	unsigned partitions() const { return mParts; }
+
+
+	/// Set block size and maximum impulse response size
+
+	/// This allocates memory, clears the impulse response and resets the
+	/// input history.
+	void resize(unsigned blockSize, unsigned maxIRSize);
+
+	/// Set impulse response
+
+	/// Responses longer than maxIRSize() are truncated. The input history
+	/// is kept, so the response can be changed while running.
+	/// \param[in] src	impulse response samples
+	/// \param[in] len	number of samples
+	/// \param[in] gain	gain applied to response
+	/// \returns false if the response was truncated
+	bool ir(const float * src, unsigned len, float gain=1.f);
+
+	/// Use impulse response of another convolver
+
+	/// The partition spectra of src are read in place, so convolvers of many
+	/// channels with the same response store and transform it once. src must
+	/// have the same block size and outlive its use; it is truncated to
+	/// maxIRSize() of this. While sharing, the own response is not used.
+	/// \param[in] src	convolver whose response to use or 0 for own
+	void share(const Convolver * src){ mShared = src; }
+
+	/// Convolve one block of input
+
+	/// \param[out] dst	output block of blockSize() samples
+	/// \param[in]  src	input block of blockSize() samples; may equal dst
+	void process(float * dst, const float * src);
+
+	/// Clear input history
+	void reset();
+
+private:
+	RFFT<float> mFFT;
+	const Convolver * mShared;	// convolver whose response is used, if not this
+	unsigned mBlockSize, mMaxParts, mParts;
+	unsigned mHead;			// delay line slot of newest input spectrum
+	std::vector<float> mH;		// IR partition spectra
+	std::vector<float> mX;		// ring of input spectra (delay line)
+	std::vector<float> mPrev;	// previous input block
+	std::vector<float> mBuf;	// transform buffer
+	std::vector<const float *> mHs, mXs;
+
+	unsigned specSize() const { return 2*mBlockSize + 2; }
+};
+
+
+
+/// Non-uniformly partitioned FFT convolver with background tail processing
+
+/// This splits a long impulse response into a head, convolved on the calling
+/// (audio) thread with partitions of the block size, and a tail, convolved
+/// with much larger partitions on a lower-priority background thread. The
+/// head covers the first two tail blocks of the response, so the background
+/// thread has one whole tail block of time to finish each tail partition
+/// before its output is due. The result has the zero latency of a uniform
+/// Convolver of the block size, but the cost per sample of its delay line
+/// shrinks from maxIRSize/blockSize to about
+/// 2*tailBlockSize/blockSize + maxIRSize/tailBlockSize partitions.
+///
+/// When a tail block is due and the background thread has not finished it,
+/// the audio thread waits and counts a missed deadline. Without a
+/// background thread, tail blocks are processed on the calling thread at the
+/// start of each tail block, which suits offline rendering.
+class NonUniformConvolver{
+public:
+
+	/// \param[in] blockSize		number of samples per processing block
+	/// \param[in] maxIRSize		maximum number of samples in impulse response
+	/// \param[in] tailBlockSize	samples per tail partition, a multiple of
+	///							blockSize; if 0, one is chosen to minimize cost
+	/// \param[in] background		whether to process the tail on a background thread
+	NonUniformConvolver(
+		unsigned blockSize=0, unsigned maxIRSize=0,
+		unsigned tailBlockSize=0, bool background=true
+	);
+
+	~NonUniformConvolver();
+
+
+	/// Get number of samples per processing block
+	unsigned blockSize() const { return mHead.blockSize(); }
+
+	/// Get number of samples per tail partition
+	unsigned tailBlockSize() const { return mTail.blockSize(); }
+
+	/// Get maximum number of impulse response samples
+	unsigned maxIRSize() const { return mHead.maxIRSize() + mTail.maxIRSize(); }
+
+	/// Get number of tail blocks not finished by their deadline
+	unsigned misses() const { return mMisses.load(std::memory_order_relaxed); }
+
+
+	/// Set block sizes and maximum impulse response size
+
+	/// This allocates memory, clears the impulse response and starts or
+	/// stops the background thread.
+	/// \see NonUniformConvolver()
+	void resize(unsigned blockSize, unsigned maxIRSize, unsigned tailBlockSize=0, bool background=true);
+
+	/// Set impulse response
+
+	/// This waits for a pending tail block and recomputes the partition
+	/// spectra, but does not allocate.
+	/// \returns false if the response was truncated
+	/// \see Convolver::ir
+	bool ir(const float * src, unsigned len, float gain=1.f);
+
+	/// Convolve one block of input
+
+	/// \param[out] dst	output block of blockSize() samples
+	/// \param[in]  src	input block of blockSize() samples; may equal dst
+	void process(float * dst, const float * src);
+
+	/// Clear input history
+	void reset();
+
+private:
+	Convolver mHead, mTail;
+	std::vector<float> mTailIn, mTailOut;	// double buffers of tail blocks
+	unsigned mPos;							// position in current tail block
+	unsigned mSlot;							// half of buffers used by audio thread
+	unsigned mJobSlot;						// half of buffers used by tail job
+	Thread mThread;
+	std::atomic<unsigned> mPosted, mDone;	// tail jobs posted and finished
+	std::atomic<unsigned> mMisses;
+	std::atomic<bool> mRunning;
+
+	void runTail();
+	bool waitTail();				// returns whether it had to wait
+	void stopThread();
+	static void * cTailFunc(void * user);
+};
+
+/// FIR filter with direct and FFT convolution paths
+
+/// This filters a signal with an arbitrary finite impulse response (kernel)
+/// sample by sample or in blocks of any size, without latency. Kernels up to
+/// a threshold length are run in direct form over a linear history buffer:
+/// block loops run over outputs innermost so that they vectorize, and single
+/// samples use a dot product split over independent partial sums. Longer
+/// kernels are split into a head, whose taps are run in direct form, and a
+/// tail, convolved with a uniform Convolver whose block is the head length.
+/// The tail starts one block into the kernel, so its block latency is hidden
+/// and the result is exact.
+///
+/// The best threshold depends on the machine; the benchmark in
+/// examples/filter/firBench.cpp prints the crossover point of the two
+/// paths. All memory is allocated by resize(); kernel() and filtering do not
+/// allocate.
+class FIR{
+public:
+
+	/// \param[in] maxSize		maximum number of kernel coefficients
+	/// \param[in] threshold	maximum kernel size run in direct form; longer
+	///							kernels use the FFT for all but threshold
+	///							(rounded down to a power of two) taps
+	FIR(unsigned maxSize=0, unsigned threshold=defaultThreshold);
+
+	/// Default maximum kernel size run in direct form
+	static const unsigned defaultThreshold = 192;
+
+
+	/// Get number of kernel coefficients
+	unsigned size() const { return mLen; }
+
+	/// Get maximum number of kernel coefficients
+	unsigned maxSize() const { return mMaxSize; }
+
+	/// Get maximum kernel size run in direct form
+	unsigned threshold() const { return mThreshold; }
+
+	/// Get whether the current kernel uses the FFT path
+	bool usesFFT() const { return mLen > mDirect; }
+
+
+	/// Set maximum kernel size and direct form threshold
+
+	/// This allocates memory, clears the kernel and resets the history.
+	///
+	void resize(unsigned maxSize, unsigned threshold=defaultThreshold);
+
+	/// Set kernel
+
+	/// Kernels longer than maxSize() are truncated. The history is kept, so
+	/// the kernel can be changed while running.
+	/// \param[in] h		kernel coefficients, h[0] applied to the newest input
+	/// \param[in] len		number of coefficients
+	/// \returns false if the kernel was truncated
+	bool kernel(const float * h, unsigned len);
+
+	/// Filter next sample
+	float operator()(float in);
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(float * dst, const float * src, unsigned n);
+
+	/// Clear history
+	void reset();
+
+private:
+	enum{ BLOCK = 64 };
+	unsigned mMaxSize, mThreshold, mLen;
+	unsigned mDirect;			// number of taps run in direct form
+	unsigned mHead;				// taps run in direct form when using the FFT
+	std::vector<float> mRev;	// direct form taps, reversed
+	std::vector<float> mHist;	// linear history of inputs
+	unsigned mPos;				// position of next input in history
+	Convolver mTail;
+	std::vector<float> mTailIn, mTailOut;
+	unsigned mTailPos;			// position in current tail block
+
+	void shift();				// move newest inputs to start of history
+	unsigned room() const { return unsigned(mHist.size()) - mPos; }
+};
+
+
+} // gam::
+
+#endif
@@ -0,0 +1,91 @@
+#ifndef GAMMA_CROSSOVER_H_INC
+#define GAMMA_CROSSOVER_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Multichannel Linkwitz-Riley crossover splitting signals into bands
+*/
+
+#include <vector>
+#include "Gamma/Domain.h"
+
+namespace gam{
+
+/// Multichannel fourth-order Linkwitz-Riley crossover
+
+/// The input is split at the lowest frequency into a low band and a high
+/// part, which is split again at the next frequency, and so on. Each split
+/// is a pair of Butterworth low-passes and a pair of high-passes, whose sum
+/// is an all-pass. Each band but the last also runs through the all-passes
+/// of the splits above its own, so that all bands have the same phase and
+/// their sum has a flat magnitude response.
+///
+/// Channels are filtered in groups of eight, each section stepping all
+/// channels of a group at once. The compiler does not vectorize this
+/// recursion, so sections run in explicit SSE2 or AVX2 kernels chosen at
+/// runtime with simdPath() (see CPU.h), with a scalar fallback.
+///
+/// \ingroup Filter
+class Crossover : public DomainObserver{
+public:
+
+	/// \param[in] bands	number of bands
+	/// \param[in] channels	number of channels
+	Crossover(unsigned bands=2, unsigned channels=1);
+
+
+	/// Set number of bands; allocates memory, keeps frequencies and resets
+
+	/// New split frequencies are an octave above the last.
+	///
+	Crossover& bands(unsigned n);
+
+	/// Set number of channels; allocates memory and resets
+	Crossover& channels(unsigned n);
+
+	/// Set frequency of a split, in Hz; splits must be in ascending order
+
+	/// Split k is between bands k and k+1.
+	///
+	Crossover& freq(unsigned k, float hz);
+
+	unsigned bands() const { return unsigned(mFreq.size()) + 1; }	///< Get number of bands
+	unsigned channels() const { return mChannels; }					///< Get number of channels
+	float freq(unsigned k) const { return mFreq[k]; }				///< Get frequency of a split
+
+
+	/// Split a block of all channels into bands
+
+	/// \param[out] dst	output buffer of band b and channel c at
+	///					dst[b*channels() + c]
+	/// \param[in]  src	input buffer of each channel; may equal any dst of
+	///					its channel
+	/// \param[in]  n	number of samples
+	void process(float * const * dst, const float * const * src, unsigned n);
+
+	/// Zero filter states
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	enum{ BLOCK = 64, LANES = 8 };
+	struct Split{
+		float lo[5], hi[5], ap[5];	// a0, a1, a2, b1, b2 of sections
+	};
+	unsigned mChannels;
+	std::vector<float> mFreq;
+	std::vector<Split> mSplit;
+	std::vector<float> mState;	// per group, 2 states times LANES per section
+	unsigned mSections;			// per group
+	float mRem[BLOCK*LANES], mLow[BLOCK*LANES];	// sample major
+
+	void design(unsigned k);
+	void resize();
+};
+
+} // gam::
+
+#endif
@@ -4,6 +4,8 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <memory>				// shared_ptr
+#include <vector>
 #include "Gamma/mem.h"			// *Ring functions
 #include "Gamma/tbl.h"			// WindowType
 #include "Gamma/Domain.h"
@@ -29,6 +31,11 @@ enum SpectralType{
 
 /// Sliding window for analysis
 
+/// Samples are written into a ring buffer that is mirrored, so the window is
+/// always available contiguously, oldest sample first, without moving samples
+/// on each hop. A hop costs one write per input sample plus any copy of the
+/// window the caller requests.
+///
 ///\ingroup Spectral
 ///
 template <class T=gam::real>
@@ -40,16 +47,26 @@ public:
 	void resize(unsigned winSize, unsigned hopSize);
 	void sizeHop(unsigned size);
 	void sizeWin(unsigned size);
+
+	/// Preallocate memory for window sizes up to a maximum
+
+	/// Setting the window size within the maximum does not allocate memory.
+	///
+	void reserve(unsigned maxWinSize);
 	
 	unsigned sizeHop() const;
 	unsigned sizeWin() const;
+
+	/// Returns bytes of heap memory allocated for sample buffer
+	std::size_t sizeInBytes() const {
+		return mBuf ? 2*scl::max(mCapWin, sizeWin())*sizeof(T) : 0; }
 	
-	/// Returns pointer to internal sample window
+	/// Returns pointer to internal sample window, oldest sample first
 	
 	/// The samples returned cannot be modified directly since they point to an
-	/// internal delay line.
-	const T * window();
-	const T * operator()();
+	/// internal delay line. They are valid until the next input.
+	const T * window() const;
+	const T * operator()() const;
 	
 	/// Returns true when sample window is ready to be processed
 	bool operator()(T input);
@@ -60,19 +77,22 @@ public:
 	/// 'dst' must have a size of at least sizeWin().
 	bool operator()(T * dst, T input);
 
-protected:
-	void slide();	// Slides samples in window left by hop num samples
-	// After processing the window samples, a call to slide() must be made
-	// to prepare for the next window.
+	/// Returns true when sample window is ready to be processed.
+
+	/// Upon returning true, the window multiplied by 'weights' is written
+	/// into 'dst' in one pass. 'dst' and 'weights' must have a size of at
+	/// least sizeWin().
+	bool operator()(T * dst, T input, const T * weights);
 
 protected:
-	T * mBuf;
+	T * mBuf;			// ring of 2 x window size; second half mirrors first
 	unsigned mSizeWin, mSizeHop;
+	unsigned mCapWin;	// reserved window size
 	unsigned mTapW;	// current index to write to
 	unsigned mHopCnt;	// counts samples for hop
-	
-private:
-	unsigned hopStart() const;
+
+	// Write sample to ring; returns true at the end of a hop
+	bool write(T input);
 };
 
 
@@ -111,6 +131,12 @@ public:
 	unsigned sizeDFT() const;	///< Get size of transform, in samples
 	Domain& domainFreq();		///< Get frequency domain
 
+	/// Get bytes of heap memory allocated for buffers
+
+	/// FFT plans and window tables, which are shared, are not counted.
+	///
+	virtual std::size_t sizeInBytes() const;
+
 
 	/// Set number of real-valued auxiliary buffers
 
@@ -123,7 +149,8 @@ public:
 	/// Copy one component of the bins to an auxiliary buffer
 
 	/// This method performs a deinterleaving copy of one component of the bins,
-	/// such as magnitude or phase, into an auxiliary buffer.
+	/// such as magnitude or phase, into an auxiliary buffer. If bins are
+	/// split into arrays, the array of the component is copied.
 	/// \param[in] binComp		bin component;
 	///								0 for real/mag or
 	///								1 for imag/phase/freq
@@ -133,7 +160,8 @@ public:
 	/// Copy an auxiliary buffer to one component of the bins
 
 	/// This method performs an interleaving copy of an auxiliary buffer to one 
-	/// component of the bins, such as magnitude or phase.
+	/// component of the bins, such as magnitude or phase. If bins are split
+	/// into arrays, the buffer is copied to the array of the component.
 	/// \param[in] auxNum		auxiliary buffer number
 	/// \param[in] binComp		bin component;
 	///								0 for real/mag or
@@ -149,11 +177,13 @@ public:
 
 protected:
 	unsigned mSizeDFT, mNumAux;
+	unsigned mCapDFT;	// reserved transform size
 	union{
 		T * mBuf;		// FFT buffer
 		Complex<T> * mBins;
 	};
 	T * mAux;		// aux buffers
+	T * mSplit;		// bin components as separate arrays, if split
 	Domain mDomFreq;
 
 	T normForward() const;	// get norm factor for forward transform values
@@ -189,12 +219,78 @@ public:
 	/// Set format of spectrum data
 	DFT& spectrumType(SpectralType v);
 
+	/// Get format of spectrum data
+	SpectralType spectrumType() const { return mSpctFormat; }
+
 	/// Set whether to use precise (but slower) for converting to polar
 	DFT& precise(bool whether);
 
+	/// Set whether to keep spectral frames split into arrays of bin components
+
+	/// When true, forward() also copies each frame into two arrays of
+	/// numBins() elements, one per bin component (see binComp()), and
+	/// inverse() takes the frame from them rather than from bins(). Per-bin
+	/// processing of the arrays is contiguous, so loops over them can be
+	/// vectorized by the compiler. copyBinsToAux(), copyAuxToBins(),
+	/// spctToPolar() and spctToRect() operate on the arrays. This allocates
+	/// memory.
+	DFT& splitBins(bool whether);
+
+	/// Get whether spectral frames are split into arrays of bin components
+	bool splitBins() const { return mSplit != 0; }
+
+	/// Get array of one component of the bins, if split
+
+	/// \param[in] comp	0 for real/mag or 1 for imag/phase/freq
+	///
+	float * binComp(unsigned comp){ return mSplit + numBins()*comp; }
+	const float * binComp(unsigned comp) const { return mSplit + numBins()*comp; }
+
+	/// Set magnitude threshold of active bins
+
+	/// When positive, each forward transform lists the bins with magnitudes at
+	/// or above the threshold and zeroes all other bins. Only the listed bins
+	/// are converted to and from polar form, and inverse transforms take only
+	/// the listed bins from the spectrum, so, apart from the FFT itself, a
+	/// sparse spectrum costs in proportion to its active bins. Spectral
+	/// effects can loop over activeBins() rather than all bins:
+	/// \code
+	///	for(unsigned j=0; j<stft.numActiveBins(); ++j){
+	///		unsigned k = stft.activeBins()[j];
+	///		...
+	///	}
+	/// \endcode
+	/// Bins not listed are zero in inverse transforms, even if modified. With
+	/// the MAG_FREQ format, all bins are still converted, since frequencies
+	/// are estimated from phase differences of every bin. A threshold of 0,
+	/// the default, turns the list off. This allocates memory unless the
+	/// list is already on.
+	DFT& activeThreshold(float v);
+
+	/// Get magnitude threshold of active bins
+	float activeThreshold() const { return mActiveThresh; }
+
+	/// Get indices of active bins, in ascending order
+	const unsigned * activeBins() const { return mActive.data(); }
+
+	/// Get number of active bins
+	unsigned numActiveBins() const { return mNumActive; }
+
 	/// Set size parameters of transform
+
+	/// This allocates memory unless the sizes are within those passed to
+	/// reserve().
 	void resize(unsigned windowSize, unsigned padSize);
 
+	/// Preallocate memory for window and zero-padding sizes up to a maximum
+
+	/// FFT plans are built and held for power-of-two transform sizes up to
+	/// the maximum and for the maximum itself. After this, resize() to window
+	/// and padding sizes within the maximums whose sum is one of these sizes
+	/// neither allocates nor locks, so it can be called from the audio
+	/// thread. Other transform sizes lock and build a plan.
+	void reserve(unsigned maxWinSize, unsigned maxPadSize);
+
 	/// Get frequency resolution of analysis.
 	
 	/// This returns the sample rate over the window size.
@@ -248,10 +344,24 @@ public:
 
 	void onDomainChange(double r);
 	void print(FILE * fp=stdout, const char * append="\n");
+	std::size_t sizeInBytes() const;
 	
 protected:
+	void forwardBins();		// transform and convert window into bins
+	void splitFrame();		// copy bins into component arrays, if split
+	void forwardActive();	// list active bins and convert only those
+	void inverseActive();	// copy active bins into inverse buffer
+	void resizeActive();	// size active bin buffers to bin capacity
+
+	// Get component of frame from split arrays, if split, or else bins
+	float * frameComp(unsigned comp, unsigned& stride){
+		stride = mSplit ? 1 : 2;
+		return mSplit ? binComp(comp) : mBuf + comp;
+	}
+
 	unsigned mSizeWin;				// samples in analysis window
 	unsigned mSizeHop;				// samples between forward transforms (= winSize() for DFT)
+	unsigned mCapWin, mCapPad;		// reserved window and padding sizes
 	SpectralType mSpctFormat;		// format of spectrum
 	RFFT<float> mFFT;
 	Domain mDomHop;
@@ -261,6 +371,12 @@ protected:
 	float * mBufInv;		// Pointer to inverse sample buffer
 	unsigned mTapW, mTapR;	// DFT i/o read/write taps
 	bool mPrecise;
+
+	// Active bins
+	float mActiveThresh;
+	std::vector<unsigned> mActive;	// indices of active bins
+	std::vector<float> mLevels;		// squared magnitudes, then packed bins
+	unsigned mNumActive;
 };
 
 
@@ -310,8 +426,21 @@ public:
 
 
 	/// Set window and zero-padding size, in samples
+
+	/// \see DFT::resize
+	///
 	void resize(unsigned winSize, unsigned padSize);
 
+	/// Preallocate memory for window and zero-padding sizes up to a maximum
+
+	/// Forward windows come from a table shared by all STFTs of the same
+	/// window type and size. Tables of the current window type are built and
+	/// held for power-of-two window sizes up to the maximum and for the
+	/// maximum itself; resize() to other window sizes, or windowType() to
+	/// another type, locks to look up the table.
+	/// \see DFT::reserve
+	void reserve(unsigned maxWinSize, unsigned maxPadSize);
+
 	/// Whether to apply a triangular window to inverse transform samples
 	STFT& inverseWindowing(bool v){
 		mWindowInverse=v; computeInvWinMul(); return *this; }
@@ -325,6 +454,9 @@ public:
 	/// Set window type
 	STFT& windowType(WindowType type);
 
+	/// Get mean value of forward window
+	float windowMean() const { return 1.f / mFwdWinMul; }
+
 
 	double unitsHop();
 	
@@ -342,12 +474,19 @@ public:
 	STFT& resetPhases();
 	
 	void print(FILE * fp=stdout, const char * append="\n");	
+	std::size_t sizeInBytes() const;
 
 protected:
 	void computeInvWinMul();	// compute inverse normalization factor (due to overlap-add)
 
+	// Window samples into forward buffer, rotating and zero-padding them
+	void windowFrame(const float * src);
+
+	struct Window{ WindowType type; unsigned size; const float * samples; float mean; };
+
 	SlidingWindow<float> mSlide;
-	float * mFwdWin;			// forward transform window
+	const float * mFwdWin;		// forward transform window (shared)
+	std::vector<Window> mWindows;	// shared windows held by reserve()
 	float * mPhases;			// copy of current phases (mag-freq mode)
 	double * mAccums;			// phase accumulators (mag-freq mode)
 	WindowType mWinType;		// type of analysis window used
@@ -374,41 +513,167 @@ public:
 	/// \param[in] binLo	lower closed endpoint of frequency interval
 	/// \param[in] binHi	upper open endpoint of frequency interval
 	SlidingDFT(unsigned sizeDFT, unsigned binLo, unsigned binHi);
+
+	~SlidingDFT();
 	
 	/// Input next sample and perform forward transform
-	void forward(T input);
+
+	/// The transform is updated in binComp() on every sample, but copied
+	/// into bins() only when a frame of sizeDFT() samples completes.
+	/// \returns true when bins() were updated
+	bool forward(T input);
+
+	/// Input a block of samples, performing a forward transform for each
+
+	/// The bins hold the transform after the last sample. This is much 
+	/// faster than calling forward(T) for each sample since the bins are 
+	/// updated in SIMD vectors, for float, over the whole block.
+	void forward(const T * src, unsigned len);
 	
 	/// Set endpoints of frequency interval
 	SlidingDFT& interval(unsigned binLo, unsigned binHi);
 
 	/// Resize transform
 	void resize(unsigned sizeDFT, unsigned binLo, unsigned binHi);
+
+	/// Get array of real (0) or imaginary (1) parts of bins
+
+	/// Arrays have numBins() elements, of which those in the frequency
+	/// interval are updated.
+	T * binComp(unsigned comp){ return mState + this->numBins()*comp; }
 		
 protected:
 	unsigned mBinLo, mBinHi;
-	DelayN<T> mDelay;
-	//T * mBufI;				// alias to imaginaries
-	Complex<T> mF1;
-	Complex<T> mFL;
-	//double mC0, mS0;		// phasor rotators
-	//double mCL, mSL;		// low bin phasor
+	T * mHist;				// circular buffer of last sizeDFT() inputs
+	unsigned mTap;			// index of oldest input in history
+	T * mState;				// bin real parts, then imaginary parts
+	T * mCoef;				// bin rotations, laid out as mState
 	T mNorm;				// fwd transform normalization
+
+	void copyToBins();
+
+	static void resonate(float * zr, float * zi, const float * wr, const float * wi, unsigned num, const float * src, unsigned len){
+		arr::resonate(zr, zi, wr, wi, num, src, len);
+	}
+
+	template <class U>
+	static void resonate(U * zr, U * zi, const U * wr, const U * wi, unsigned num, const U * src, unsigned len){
+		for(unsigned k=0; k<num; ++k){
+			for(unsigned j=0; j<len; ++j){
+				U t = zr[k]*wr[k] - zi[k]*wi[k] + src[j];
+				zi[k] = zr[k]*wi[k] + zi[k]*wr[k];
+				zr[k] = t;
+			}
+		}
+	}
 };
 
 
 
+/// Constant-Q transform
+
+/// This computes a spectrum whose bins are spaced evenly in octaves and
+/// have a constant ratio of center frequency to bandwidth, as used for
+/// musical analysis. Following Brown and Puckette, one real FFT of each
+/// frame is multiplied by a precomputed spectral kernel per bin. The kernel
+/// of a bin is the spectrum of a Hann-windowed complex sinusoid whose length
+/// is inversely proportional to its frequency, centered in the frame. Only
+/// the run of FFT bins where it is non-negligible is kept, so each bin costs
+/// a few short dot products. The FFT size is the power of two that fits the
+/// longest kernel, of the lowest bin.
+///
+/// Kernels are built once for each configuration and sample rate and shared
+/// by all transforms using it. They are freed with the last transform using
+/// them.
+///
+/// \ingroup Spectral
+class ConstantQ : public DomainObserver{
+public:
+
+	/// \param[in] minFreq		center frequency of lowest bin
+	/// \param[in] numBins		number of bins
+	/// \param[in] binsPerOctave	number of bins per octave
+	/// \param[in] hopSize		number of samples between frames
+	ConstantQ(float minFreq=55, unsigned numBins=84, unsigned binsPerOctave=12, unsigned hopSize=512);
+
+
+	/// Set bin layout; builds kernels if none are cached
+	ConstantQ& set(float minFreq, unsigned numBins, unsigned binsPerOctave);
+
+	/// Set number of samples between frames
+	ConstantQ& sizeHop(unsigned v){ mHop = v; mSlide.sizeHop(v); return *this; }
+
+	/// Set magnitude below which kernel values are dropped, relative to peak
+
+	/// Lower values are more accurate but cost more. This rebuilds kernels
+	/// if none are cached.
+	ConstantQ& kernelThreshold(float v){ mThresh = v; build(); return *this; }
+
+
+	unsigned numBins() const { return mNumBins; }				///< Get number of bins
+	unsigned binsPerOctave() const { return mBinsPerOctave; }	///< Get number of bins per octave
+	unsigned sizeFFT() const { return mSlide.sizeWin(); }		///< Get size of frame, in samples
+	unsigned sizeHop() const { return mSlide.sizeHop(); }		///< Get number of samples between frames
+
+	/// Get center frequency of bin k
+	float freq(unsigned k) const { return float(mMinFreq * ::pow(2., double(k)/mBinsPerOctave)); }
+
+	/// Get bins of last frame
+
+	/// The magnitude of a bin is the amplitude of a sinusoid at its center
+	/// frequency.
+	const Complex<float> * bins() const { return &mBins[0]; }
+
+	/// Get bin k of last frame
+	const Complex<float>& bin(unsigned k) const { return mBins[k]; }
+
+
+	/// Input next sample; returns true when a new frame was computed
+	bool operator()(float input){
+		if(mSlide(&mFrame[0], input)){
+			forward(&mFrame[0]);
+			return true;
+		}
+		return false;
+	}
+
+	/// Transform a frame of sizeFFT() samples, oldest first
+	void forward(const float * src);
+
+	void onDomainChange(double r);
+
+	/// Get number of kernel sets in use by all transforms
+	static unsigned cachedKernels();
+
+	struct Kernel;
+
+private:
+	SlidingWindow<float> mSlide;
+	RFFT<float> mFFT;
+	std::shared_ptr<const Kernel> mKernel;
+	std::vector<float> mFrame, mBuf, mRe, mIm;
+	std::vector<Complex<float> > mBins;
+	double mMinFreq;
+	unsigned mNumBins, mBinsPerOctave;
+	unsigned mHop;			// hop size as set, before limiting to frame size
+	float mThresh;
+
+	void build();
+};
+
+
 
 // Implementation_______________________________________________________________
 template<class T>
 SlidingWindow<T>::SlidingWindow(unsigned winSize, unsigned hopSize)
-:	mBuf(0), mSizeWin(0), mSizeHop(0), mTapW(0), mHopCnt(0)
+:	mBuf(0), mSizeWin(0), mSizeHop(0), mCapWin(0), mTapW(0), mHopCnt(0)
 {
 	resize(winSize, hopSize);
 }
 
 template<class T>
 SlidingWindow<T>::~SlidingWindow(){
-	mem::free(mBuf);
+	mem::freeAligned(mBuf);
 }
 
 template<class T>
@@ -419,16 +684,29 @@ void SlidingWindow<T>::resize(unsigned winSize, unsigned hopSize){
 
 template<class T>
 void SlidingWindow<T>::sizeWin(unsigned size){
-	if(mem::resize(mBuf, sizeWin(), size)){
+	if(0 == size) return;
+	unsigned oldAlloc = 2*scl::max(mCapWin, sizeWin());
+	unsigned newAlloc = 2*scl::max(mCapWin, size);
+	if(mem::resizeAligned(mBuf, oldAlloc, newAlloc) || size != sizeWin()){
 		mSizeWin = size;
-		mem::deepZero(mBuf, sizeWin());
-		//mTapW = hopStart();	// for single-buffer slide mode
-		mTapW = 0;				// for single-buffer rotate mode
+		mem::deepZero(mBuf, 2*sizeWin());
+		mTapW = 0;
 		mHopCnt = 0;
 		sizeHop(mSizeHop);		// ensures hop size <= win size
 	}
 }
 
+template<class T>
+void SlidingWindow<T>::reserve(unsigned maxWinSize){
+	unsigned oldAlloc = 2*scl::max(mCapWin, sizeWin());
+	mCapWin = scl::max(maxWinSize, sizeWin());
+	if(mem::resizeAligned(mBuf, oldAlloc, 2*mCapWin)){
+		mem::deepZero(mBuf, 2*sizeWin());
+		mTapW = 0;
+		mHopCnt = 0;
+	}
+}
+
 template<class T>
 void SlidingWindow<T>::sizeHop(unsigned size){
 	mSizeHop = scl::clip<unsigned>(size, sizeWin(), 1);
@@ -441,68 +719,63 @@ template<class T>
 inline unsigned SlidingWindow<T>::sizeWin() const { return mSizeWin; }
 
 template<class T>
-inline const T * SlidingWindow<T>::window(){ return mBuf; }
+inline const T * SlidingWindow<T>::window() const { return mBuf + mTapW; }
 
 template<class T>
-inline const T * SlidingWindow<T>::operator()(){ return mBuf; }
+inline const T * SlidingWindow<T>::operator()() const { return window(); }
 
 template<class T>
-inline bool SlidingWindow<T>::operator()(T input){
-
-// faster, but requires explicit call to slide() by user which is error prone
-//	mBuf[mTapW] = input;
-//	
-//	if(++mTapW == sizeWin()){
-//		mTapW = hopStart();
-//		return true;
-//	}
-//	return false;
-	
+inline bool SlidingWindow<T>::write(T input){
 	mBuf[mTapW] = input;
-	
-	if(++mTapW >= sizeHop()){
-		mTapW = 0;
-		mem::rotateLeft(sizeHop(), mBuf, sizeWin());
+	mBuf[mTapW + sizeWin()] = input;
+	if(++mTapW == sizeWin()) mTapW = 0; // increment tap and modulo window size
+
+	if(++mHopCnt >= sizeHop()){
+		mHopCnt = 0;
 		return true;
 	}
 	return false;
 }
 
 template<class T>
-inline bool SlidingWindow<T>::operator()(T * output, T input){
-	mBuf[mTapW] = input;
-	if(++mTapW == sizeWin()) mTapW = 0; // increment tap and modulo window size
+inline bool SlidingWindow<T>::operator()(T input){
+	return write(input);
+}
 
-	if(++mHopCnt == sizeHop()){
-		mem::copyAllFromRing(mBuf, sizeWin(), mTapW, output);
-		mHopCnt = 0;
+template<class T>
+inline bool SlidingWindow<T>::operator()(T * output, T input){
+	if(write(input)){
+		mem::deepCopy(output, window(), sizeWin());
 		return true;
 	}
 	return false;
 }
 
 template<class T>
-void SlidingWindow<T>::slide(){
-	mem::deepMove(mBuf, mBuf + sizeHop(), hopStart());
+inline bool SlidingWindow<T>::operator()(T * output, T input, const T * weights){
+	if(write(input)){
+		const T * src = window();
+		for(unsigned i=0; i<sizeWin(); ++i) output[i] = src[i] * weights[i];
+		return true;
+	}
+	return false;
 }
 
-template<class T>
-inline unsigned SlidingWindow<T>::hopStart() const { return sizeWin() - sizeHop(); }
-
 
 
 
 template<class T>
 DFTBase<T>::DFTBase()
-:	mSizeDFT(0), mNumAux(0), mBuf(0), mAux(0)
+:	mSizeDFT(0), mNumAux(0), mCapDFT(0), mBuf(0), mAux(0), mSplit(0)
 {
 	onDomainChange(1);
 }
 
 template<class T>
 DFTBase<T>::~DFTBase(){ //printf("~DFTBase\n");
-	mem::free(mBuf);
-	mem::free(mAux);
+	mem::freeAligned(mBuf);
+	mem::freeAligned(mAux);
+	mem::freeAligned(mSplit);
 }
 
 template<class T>
@@ -514,6 +787,13 @@ inline double DFTBase<T>::binFreq() const { return spu() / sizeDFT(); }
 template<class T>
 unsigned DFTBase<T>::numAux() const { return mNumAux; }
 
+template<class T>
+std::size_t DFTBase<T>::sizeInBytes() const {
+	if(!mBuf) return 0;
+	const std::size_t frq = scl::max(mCapDFT, sizeDFT()) + 2;
+	return (frq*2 + mNumAux*(frq>>1) + (mSplit ? frq : 0)) * sizeof(T);
+}
+
 template<class T>
 unsigned DFTBase<T>::numBins() const { return (sizeDFT() + 2)>>1; }
 
@@ -528,7 +808,8 @@ T DFTBase<T>::normForward() const { return T(2) / T(sizeDFT()); }
 
 template<class T>
 void DFTBase<T>::numAux(unsigned num){
-	if(mem::resize(mAux, mNumAux * numBins(), num * numBins())){
+	unsigned bins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
+	if(mem::resizeAligned(mAux, mNumAux * bins, num * bins)){
 		mNumAux = num;
 		zeroAux();
 	}
@@ -537,6 +818,10 @@ void DFTBase<T>::numAux(unsigned num){
 template<class T>
 void DFTBase<T>::copyBinsToAux(unsigned binComp, unsigned auxNum){
 	T * auxBuf = aux(auxNum);
+	if(mSplit){
+		mem::deepCopy(auxBuf, mSplit + numBins()*binComp, numBins());
+		return;
+	}
 	for(unsigned k=0; k<numBins(); ++k)
 		auxBuf[k] = bin(k)[binComp];
 }
@@ -544,6 +829,10 @@ void DFTBase<T>::copyBinsToAux(unsigned binComp, unsigned auxNum){
 template<class T>
 void DFTBase<T>::copyAuxToBins(unsigned auxNum, unsigned binComp){
 	T * auxBuf = aux(auxNum);
+	if(mSplit){
+		mem::deepCopy(mSplit + numBins()*binComp, auxBuf, numBins());
+		return;
+	}
 	for(unsigned k=0; k<numBins(); ++k)
 		bin(k)[binComp] = auxBuf[k];
 }
@@ -607,8 +896,8 @@ inline bool DFT::inverseOnNext(){ return mTapR == (sizeHop() - 1); }
 
 
 inline bool STFT::operator()(float input){
-	if(mSlide(bufFwdPos(), input)){
-		forward();
+	if(mSlide(input)){
+		forward(mSlide.window());
 		return true;
 	}
 	return false;
@@ -623,22 +912,36 @@ inline double * STFT::accumPhases(){ return mAccums; }
 
 template<class T>
 SlidingDFT<T>::SlidingDFT(unsigned sizeDFT, unsigned binLo, unsigned binHi)
-	: DFTBase<T>(), mBinLo(0), mBinHi(0), mDelay(0)
+	: DFTBase<T>(), mBinLo(0), mBinHi(0), mHist(0), mTap(0), mState(0), mCoef(0)
 {
 	resize(sizeDFT, binLo, binHi);
 }
 
+template<class T>
+SlidingDFT<T>::~SlidingDFT(){
+	mem::free(mHist);
+	mem::free(mState);
+	mem::free(mCoef);
+}
+
 template<class T>
 void SlidingDFT<T>::resize(unsigned sizeDFT, unsigned binLo, unsigned binHi){
+	unsigned oldBins = this->numBins();
+
 	// may be able to keep these smaller?
-	mem::resize(this->mBuf, this->mSizeDFT + 2, sizeDFT + 2);
+	mem::resizeAligned(this->mBuf, this->mSizeDFT + 2, sizeDFT + 2);
 	mem::deepZero(this->mBuf, sizeDFT + 2);
 
-	mDelay.resize(sizeDFT);
-	mDelay.assign(T(0));
+	mem::resize(mHist, this->mSizeDFT, sizeDFT);
+	mem::deepZero(mHist, sizeDFT);
+	mTap = 0;
 
 	this->mSizeDFT = sizeDFT;
 
+	mem::resize(mState, oldBins*2, this->numBins()*2);
+	mem::resize(mCoef, oldBins*2, this->numBins()*2);
+	mem::deepZero(mState, this->numBins()*2);
+
 	interval(binLo, binHi);
 
 	//this->onSyncChange();
@@ -646,32 +949,80 @@ void SlidingDFT<T>::resize(unsigned sizeDFT, unsigned binLo, unsigned binHi){
 
 template<class T>
 SlidingDFT<T>& SlidingDFT<T>::interval(unsigned binLo, unsigned binHi){
-	mBinLo = binLo;
-	mBinHi = binHi;
+	mBinHi = scl::min(binHi, this->numBins());
+	mBinLo = scl::min(binLo, mBinHi);
 	
 	double theta = M_2PI / this->sizeDFT();
+	for(unsigned k=mBinLo; k<mBinHi; ++k){
+		mCoef[k] = T(::cos(theta*k));
+		mCoef[k + this->numBins()] = T(::sin(theta*k));
+	}
 
-	mF1.fromPhase(theta);
-	mFL.fromPhase(theta*mBinLo);
 	mNorm = T(2) / T(this->sizeDFT());
 	return *this;
 }
 
-//
 template<class T>
-inline void SlidingDFT<T>::forward(T input){
-	T dif = (input - mDelay(input)) * mNorm;	// ffd comb zeroes
-												// difference between temporal 'frames'
-	Complex<T> c = mFL;							// phasor at low bin
+inline bool SlidingDFT<T>::forward(T input){
+	const unsigned N = this->sizeDFT();
+	const unsigned nb = this->numBins();
+	if(0 == N) return false;
+
+	T dif = (input - mHist[mTap]) * mNorm;
+	mHist[mTap] = input;
+
+	resonate(
+		mState + mBinLo, mState + nb + mBinLo,
+		mCoef  + mBinLo, mCoef  + nb + mBinLo,
+		mBinHi - mBinLo, &dif, 1
+	);
 
-	// apply complex resonators:
-	// multiply freq samples by 1st harmonic (shift time signal)
-	// add time sample to all bins (set time sample at n=0)
-	
+	if(++mTap != N) return false;
+	mTap = 0;
+	copyToBins();
+	return true;
+}
+
+template<class T>
+void SlidingDFT<T>::forward(const T * src, unsigned len){
+	const unsigned N = this->sizeDFT();
+	const unsigned nb = this->numBins();
+	if(0 == N) return;
+
+	// Differences between temporal 'frames' (ffd comb zeroes), computed in 
+	// chunks that are contiguous in the history
+	T dif[64];
+	while(len){
+		unsigned n = scl::min(scl::min(len, 64u), N - mTap);
+		T * hist = mHist + mTap;
+		for(unsigned j=0; j<n; ++j){
+			dif[j] = (src[j] - hist[j]) * mNorm;
+			hist[j] = src[j];
+		}
+		mTap += n;
+		if(mTap == N) mTap = 0;
+
+		// apply complex resonators:
+		// multiply freq samples by 1st harmonic (shift time signal)
+		// add time sample to all bins (set time sample at n=0)
+		resonate(
+			mState + mBinLo, mState + nb + mBinLo,
+			mCoef  + mBinLo, mCoef  + nb + mBinLo,
+			mBinHi - mBinLo, dif, n
+		);
+
+		src += n;
+		len -= n;
+	}
+
+	copyToBins();
+}
+
+template<class T>
+void SlidingDFT<T>::copyToBins(){
+	const unsigned nb = this->numBins();
 	for(unsigned k=mBinLo; k<mBinHi; ++k){
-		Complex<T>& b = this->bins(k);
-		b = b*c + dif;
-		c *= mF1;
+		this->mBins[k](mState[k], mState[k + nb]);
 	}
 }
 
@@ -4,9 +4,12 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <algorithm> // copy
+#include <vector>
 #include "Gamma/ipl.h"
 #include "Gamma/scl.h"
 #include "Gamma/tbl.h"
+#include "Gamma/Block.h"
 #include "Gamma/Containers.h"
 #include "Gamma/Domain.h"
 #include "Gamma/Strategy.h"
@@ -60,19 +63,33 @@ public:
 	Delay(float maxDelay, float delay);
 
 
-	void delay(float v);						///< Set delay length
-	void delaySamples(uint32_t v);				///< Set delay length in samples
-	void delaySamplesR(float v);				///< Set delay length in samples (real-valued)
-	void delayUnit(float u);					///< Set delay as (0, 1) of buffer size
-	void freq(float v);							///< Set natural frequency (1/delay())
+	inline void delay(float v);					///< Set delay length
+	inline void delaySamples(uint32_t v);		///< Set delay length in samples
+	inline void delaySamplesR(float v);			///< Set delay length in samples (real-valued)
+	inline void delayUnit(float u);				///< Set delay as (0, 1) of buffer size
+	inline void freq(float v);					///< Set natural frequency (1/delay())
 	void ipolType(ipl::Type v){mIpol.type(v);}	///< Set interpolation type
 	void maxDelay(float v, bool setDelay=true);	///< Set maximum delay length
 
-	Tv operator()(const Tv& v);					///< Returns next filtered value
-	Tv operator()() const;						///< Reads delayed element from buffer
-	Tv read(float ago) const;					///< Returns element 'ago' units ago
+	/// Set memory arena to take the buffer from
+
+	/// The buffer is taken from the arena from now on, including when the
+	/// maximum delay or sampling rate changes, and falls back to the heap
+	/// when the arena is exhausted. Constructing with no delay, then setting
+	/// the arena and maximum delay, avoids allocating from the heap at all.
+	/// After the arena is reset, setting the maximum delay takes a new buffer
+	/// from it. Elements are zeroed when taken from the arena.
+	/// \param[in] v	memory arena or NULL to take the buffer from the heap
+	void arena(MemoryArena * v);
+
+	/// Get memory arena the buffer is taken from
+	MemoryArena * arena() const { return mArena; }
+
+	inline Tv operator()(const Tv& v);			///< Returns next filtered value
+	inline Tv operator()() const;				///< Reads delayed element from buffer
+	inline Tv read(float ago) const;			///< Returns element 'ago' units ago
 	template <template <class> class InterpolationStrategy> Tv read(float ago) const;
-	void write(const Tv& v);					///< Writes new element into buffer
+	inline void write(const Tv& v);				///< Writes new element into buffer
 
 	/// Copy delay elements to another array
 
@@ -83,15 +100,52 @@ public:
 	template <class V>
 	void read(V * dst, unsigned len, unsigned end=0) const;
 
+	/// Filter a block of samples with the current delay
+
+	/// This gives the same output as calling operator()(const Tv&) on each
+	/// sample. When the delay is a whole number of samples and the
+	/// interpolation is truncating, rounding, linear or cubic, the block is
+	/// written and read as at most two contiguous spans on each side of the
+	/// wrap point of the buffer, with no interpolation, so a long fixed delay
+	/// costs about a copy.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
+	/// Filter a block of samples with a delay per sample
+
+	/// This gives the same output as setting delay() to each delay, then
+	/// calling operator()(const Tv&), on each sample. The current delay is
+	/// not changed.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  delays	delay lengths of each sample
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, const float * delays, unsigned n);
+
 	float delay() const;						///< Get current delay length
 	uint32_t delaySamples() const;				///< Get current delay length in samples
 	float delaySamplesR() const;				///< Get current delay length in samples (real-valued)
 	float delayUnit() const;					///< Get unit delay (relative to max delay)
-	uint32_t delayIndex(uint32_t delay) const;	///< Get index of delayed element	
+	inline uint32_t delayIndex(uint32_t delay) const;	///< Get index of delayed element	
 	float freq() const { return 1.f/delay(); }	///< Get frequency of delay line
-	uint32_t indexBack() const;					///< Get index of backmost element
+	inline uint32_t indexBack() const;			///< Get index of backmost element
 	float maxDelay() const;						///< Get maximum delay length units
 
+	/// Save or restore buffer and taps with a StateWriter or StateReader
+
+	/// The buffer size must match that of the saved delay line.
+	///
+	template <class Archive>
+	void state(Archive& ar){
+		uint32_t n = this->size();
+		ar(n).check(n == this->size());
+		if(!ar.ok()) return;
+		ar(mDelayLength)(mPhase).array(this->elems(), n);
+		if(Archive::loading) delay(mDelayLength);
+	}
+
 	virtual void onResize();
 	void onDomainChange(double r);
 
@@ -106,10 +160,40 @@ protected:
 	uint32_t mPhase;				// write tap
 	uint32_t mPhaseInc;				// phase increment
 	uint32_t mDelay;				// read tap as delay from write tap
+	MemoryArena * mArena;			// memory arena or NULL for heap
+	unsigned mArenaGen;				// generation of arena buffer is from
 
-	void incPhase();				// increment phase
+	bool fromArena(unsigned size, bool move=false); // take buffer from arena if possible
+	inline void incPhase();			// increment phase
 	void refreshDelayFactor();
-	uint32_t delayFToI(float v) const; // convert f.p. delay to fixed-point
+	inline uint32_t delayFToI(float v) const; // convert f.p. delay to fixed-point
+
+	// Get number of samples that can be read before writing any of them and
+	// give the same values as reading and writing a sample at a time
+	unsigned readSpan(uint32_t minDelay, uint32_t maxDelay) const;
+
+	// Read samples from write tap on with current delay or a fixed-point
+	// delay per sample
+	void readSpan(Tv * dst, const uint32_t * delays, unsigned n) const;
+
+	// Write samples and advance write tap
+	void writeSpan(const Tv * src, unsigned n);
+
+private:
+	// Block loops are run with the interpolation strategy resolved once,
+	// through these function objects
+	template <class S> void processIpol(const S& ipol, const Tv * in, Tv * out, const float * delays, unsigned n);
+	template <class S> void readSpanIpol(const S& ipol, Tv * dst, const uint32_t * delays, unsigned n) const;
+
+	struct ProcessFunc{
+		Delay& d; const Tv * in; Tv * out; const float * delays; unsigned n;
+		template <class S> void operator()(const S& s) const { d.processIpol(s, in, out, delays, n); }
+	};
+
+	struct ReadSpanFunc{
+		const Delay& d; Tv * dst; const uint32_t * delays; unsigned n;
+		template <class S> void operator()(const S& s) const { d.readSpanIpol(s, dst, delays, n); }
+	};
 };
 
 
@@ -154,8 +238,120 @@ public:
 	/// Set number of read taps
 	void taps(unsigned numTaps){ mDelays.resize(numTaps); }
 
+
+	/// Write a block of samples and read all taps on each sample
+
+	/// The outputs are the same as reading every tap and then writing on each
+	/// sample. They are a dense matrix with a row of samples per tap, such as
+	/// for the sources of a panner. With truncating or linear interpolation,
+	/// each tap is gathered a row at a time with its integer offset and
+	/// fractional weight computed once per block.
+	///
+	/// \param[in]  in	input samples
+	/// \param[out] out	tap matrix; sample i of tap t is at out[t*n + i]
+	/// \param[in]  n	number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
 protected:
 	std::vector<unsigned> mDelays;
+	std::vector<Tv> mSeq;	// gathered elements of a tap
+};
+
+
+
+/// Multichannel delay line storing frames interleaved
+
+/// All channels share one ring buffer of interleaved frames and one write
+/// index, while each channel reads at its own delay. Compared to one Delay
+/// per channel, a sample period advances one index instead of Nch, and a
+/// frame is written with one contiguous store instead of Nch scattered ones.
+/// When all channels have the same whole-sample delay, frames are read
+/// contiguously too and blocks are filtered as copies of spans of frames;
+/// otherwise, each channel reads its element of the delayed frames with
+/// linear interpolation.
+///
+/// \tparam Nch	Number of channels
+/// \tparam Tv	Value (sample) type
+/// \tparam Td	Domain type
+/// \ingroup Delay
+template <unsigned Nch, class Tv = gam::real, class Td = DomainObserver>
+class DelayMC : public Td{
+public:
+
+	/// Default constructor. Does not allocate memory.
+	DelayMC();
+
+	/// \param[in]	maxDelay	Maximum delay length
+	/// \param[in]	delay		Delay length of all channels
+	DelayMC(float maxDelay, float delay);
+
+
+	void delay(float v);					///< Set delay length of all channels
+	void delay(float v, unsigned chan);		///< Set delay length of a channel
+	void maxDelay(float v);					///< Set maximum delay length
+
+	const float * delays() const { return mDelays; }			///< Get delay lengths of channels
+	float maxDelay() const { return mMaxDelay; }				///< Get maximum delay length
+	unsigned channels() const { return Nch; }					///< Get number of channels
+	unsigned sizeFrames() const { return mBuf.size()/Nch; }		///< Get number of frames in buffer
+
+	/// Filter a frame
+
+	/// The delayed frame is read, then the input frame written.
+	/// \param[out] out	output frame of Nch samples; may equal in
+	/// \param[in]  in	input frame of Nch samples
+	void operator()(Tv * out, const Tv * in);
+
+	void read(Tv * out) const;					///< Read delayed frame
+	Tv read(unsigned chan, float ago) const;	///< Read element of a channel 'ago' units ago
+	void write(const Tv * in);					///< Write frame
+
+	/// Filter a block of interleaved frames
+
+	/// This gives the same output as calling operator()(Tv *, const Tv *) on
+	/// each frame.
+	/// \param[in]  in			input frames
+	/// \param[out] out		output frames; may equal in
+	/// \param[in]  numFrames	number of frames
+	void process(const Tv * in, Tv * out, unsigned numFrames);
+
+	/// Filter a block of channels
+
+	/// \param[in]  in			input samples of each channel
+	/// \param[out] out		output samples of each channel; may equal in
+	/// \param[in]  numFrames	number of frames
+	void process(const Tv * const * in, Tv * const * out, unsigned numFrames);
+
+	/// Zero all elements
+	void zero();
+
+	/// Save or restore buffer and delays with a StateWriter or StateReader
+
+	/// The buffer size must match that of the saved delay line.
+	///
+	template <class Archive>
+	void state(Archive& ar){
+		uint32_t n = uint32_t(mBuf.size());
+		ar(n).check(n == mBuf.size());
+		if(!ar.ok()) return;
+		ar(mWrite).array(mDelays, Nch).array(mBuf.data(), n);
+		if(Archive::loading) for(unsigned c=0; c<Nch; ++c) delay(mDelays[c], c);
+	}
+
+	void onDomainChange(double r);
+
+protected:
+	std::vector<Tv> mBuf;		// interleaved frames
+	uint32_t mMask;				// number of frames minus one
+	uint32_t mWrite;			// index of next frame to write
+	float mMaxDelay;			// maximum delay length
+	float mDelays[Nch];			// delay lengths
+	uint32_t mDelayI[Nch];		// whole samples of delays
+	float mDelayF[Nch];			// fractions of delays
+	bool mUniform;				// whether channels share a whole-sample delay
+
+	void refreshDelay(unsigned chan);
+	void refreshUniform();
 };
 
 
@@ -291,30 +487,51 @@ public:
 	/// The default end value of 0.001 (-60 dB) is the reverberation time of 
 	/// the filter.  Setting the decay amount effects only the feedback value.
 	/// The decay must be updated whenever the delay length of the filter changes.
-	void decay(float units, float end = 0.001f);
+	inline void decay(float units, float end = 0.001f);
 
 	/// Sets feedback to argument and feedforward to argument negated
-	void allPass(const Tp& v);
+	inline void allPass(const Tp& v);
 
-	void fbk(const Tp& v);					///< Set feedback amount, in (-1, 1)
-	void ffd(const Tp& v);					///< Set feedforward amount [-1, 1]
+	inline void fbk(const Tp& v);			///< Set feedback amount, in (-1, 1)
+	inline void ffd(const Tp& v);			///< Set feedforward amount [-1, 1]
 	void feeds(const Tp& fwd, const Tp& bwd){ ffd(fwd); fbk(bwd); }
 
-	void set(float delay, const Tp& ffd, const Tp& fbk); ///< Set several parameters
+	inline void set(float delay, const Tp& ffd, const Tp& fbk); ///< Set several parameters
 
-	Tv operator()();
-	Tv operator()(const Tv& i0);				///< Returns next filtered value
-	Tv operator()(const Tv& i0, const Tv& oN);	///< Circulate filter with ffd & fbk
-	Tv circulateFbk(const Tv& i0, const Tv& oN);///< Circulate filter with fbk only	
+	inline Tv operator()();
+	inline Tv operator()(const Tv& i0);			///< Returns next filtered value
+	inline Tv operator()(const Tv& i0, const Tv& oN);	///< Circulate filter with ffd & fbk
+	inline Tv circulateFbk(const Tv& i0, const Tv& oN);///< Circulate filter with fbk only	
 
 	/// Filters sample (feedback only).
-	Tv nextFbk(const Tv& i0);
+	inline Tv nextFbk(const Tv& i0);
+
+	/// Filter a block of samples with the current delay
+
+	/// This gives the same output as calling operator()(const Tv&) on each
+	/// sample. The block is split into spans no longer than the delay, so
+	/// that a span is read, then fed back and written, each in a tight loop.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
+	/// Filter a block of samples with a delay per sample
+
+	/// This gives the same output as setting delay() to each delay, then
+	/// calling operator()(const Tv&), on each sample. The current delay is
+	/// not changed.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  delays	delay lengths of each sample
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, const float * delays, unsigned n);
 	
-	float norm() const;				///< Get unity gain scale factor
-	float normFbk() const;			///< Get unity gain scale factor due to feedback
-	float normFfd() const;			///< Get unity gain scale factor due to feedforward
-	Tp ffd() const;					///< Get feedforward amount
-	Tp fbk() const;					///< Get feedback amount
+	inline float norm() const;		///< Get unity gain scale factor
+	inline float normFbk() const;	///< Get unity gain scale factor due to feedback
+	inline float normFfd() const;	///< Get unity gain scale factor due to feedforward
+	inline Tp ffd() const;			///< Get feedforward amount
+	inline Tp fbk() const;			///< Get feedback amount
 
 protected:
 	Tp mFFD, mFBK;
@@ -328,7 +545,7 @@ protected:
 #define TM1 template <class Tv, template <class> class Ti, class Td>
 #define TM2 Tv,Ti,Td
 
-#define DELAY_INIT mMaxDelay(0), mDelayFactor(0), mDelayLength(0), mPhase(0), mPhaseInc(0), mDelay(0)
+#define DELAY_INIT mMaxDelay(0), mDelayFactor(0), mDelayLength(0), mPhase(0), mPhaseInc(0), mDelay(0), mArena(0), mArenaGen(0)
 
 TM1 Delay<TM2>::Delay()
 :	DELAY_INIT
@@ -370,11 +587,46 @@ TM1 void Delay<TM2>::maxDelay(float length, bool setDelay){
 
 		// This will trigger onResize() -> onDomainChange(double r) calls ONLY if
 		// the size changes to prevent infinite recursion.
-		this->resize(maxDelayInSamples);
+		if(!fromArena(maxDelayInSamples)) this->resize(maxDelayInSamples);
 	}
 	if(setDelay) delay(length);
 }
 
+TM1 bool Delay<TM2>::fromArena(unsigned size, bool move){
+	if(!mArena || !size) return false;
+	size = SizeArrayPow2::convert(size);
+
+	// Keep a buffer of the same size from the current generation of the
+	// arena or, unless moving, from the heap
+	if(size == this->size()){
+		if(mArena->owns(this->elems())){
+			if(mArenaGen == mArena->generation()) return true;
+		}
+		else if(!move) return false;
+	}
+
+	Tv * p = mArena->allocate<Tv>(size);
+	if(!p) return false;
+	for(unsigned i=0; i<size; ++i) new(p+i) Tv(0);
+	mArenaGen = mArena->generation();
+	this->source(p, size);
+	return true;
+}
+
+TM1 void Delay<TM2>::arena(MemoryArena * v){
+	if(v == mArena) return;
+	mArena = v;
+	if(v){
+		if(Td::domain() && Td::domain()->hasBeenSet()) fromArena(unsigned(mMaxDelay * Td::spu()), true);
+	}
+	else if(this->usingExternalSource()){
+		// Move elements to the heap
+		ArrayPow2<Tv> buf(this->size());
+		for(unsigned i=0; i<buf.size(); ++i) buf[i] = (*this)[i];
+		this->source(buf);
+	}
+}
+
 TM1 inline Tv Delay<TM2>::operator()() const {
 	return mIpol(*this, mPhase - mDelay);
 }
@@ -405,7 +657,7 @@ TM1 void Delay<TM2>::onResize(){ //printf("Delay::onResize %d elements\n", this-
 }
 
 TM1 void Delay<TM2>::onDomainChange(double /*r*/){ //printf("Delay::onDomainChange\n");
-	if(this->usingExternalSource()){
+	if(this->usingExternalSource() && !mArena){
 		mMaxDelay = float(this->size() * Td::ups());
 	}
 	else{
@@ -435,6 +687,123 @@ void Delay<TM2>::read(V * dst, unsigned len, unsigned end) const {
 	}
 }
 
+TM1 void Delay<TM2>::process(const Tv * in, Tv * out, unsigned n){
+	const unsigned fbits = this->fracBits();
+
+	// Fractional delays need interpolation, as do whole ones with
+	// interpolators that keep state or mix neighbors at a fraction of zero
+	const ipl::Type type = mIpol.type();
+	const bool exact = ipl::TRUNC == type || ipl::ROUND == type
+		|| ipl::LINEAR == type || ipl::CUBIC == type;
+	if(!exact || (mDelay & (this->oneIndex()-1))){
+		const ProcessFunc f = {*this, in, out, NULL, n};
+		ipl::apply(mIpol, f);
+		return;
+	}
+
+	Tv * buf = this->elems();
+	const unsigned N = this->size(), mask = N-1;
+	const unsigned d = mDelay >> fbits;
+	unsigned w = this->index(mPhase);
+	mPhase += n * mPhaseInc;
+
+	// A delay of zero reads the oldest element, where the input goes
+	if(!d){
+		for(unsigned i=0; i<n; ++i){
+			const Tv v = in[i];
+			out[i] = buf[w];
+			buf[w] = v;
+			w = (w+1) & mask;
+		}
+		return;
+	}
+
+	/* The write span [w, w+m) and read span [w-d, w-d+m) must not overlap,
+	so that writing first gives the same result as reading first, which also
+	allows filtering in place. This holds for spans up to the delay and up
+	to the buffer size minus the delay. */
+	const unsigned span = d < N-d ? d : N-d;
+
+	while(n){
+		const unsigned m = n < span ? n : span;
+
+		// Write
+		unsigned m1 = N - w < m ? N - w : m;
+		std::copy(in, in+m1, buf+w);
+		std::copy(in+m1, in+m, buf);
+
+		// Read
+		const unsigned r = (w - d) & mask;
+		m1 = N - r < m ? N - r : m;
+		std::copy(buf+r, buf+r+m1, out);
+		std::copy(buf, buf+m-m1, out+m1);
+
+		w = (w + m) & mask;
+		in += m; out += m; n -= m;
+	}
+}
+
+TM1 void Delay<TM2>::process(const Tv * in, Tv * out, const float * delays, unsigned n){
+	const ProcessFunc f = {*this, in, out, delays, n};
+	ipl::apply(mIpol, f);
+}
+
+TM1 template <class S>
+void Delay<TM2>::processIpol(const S& ipol, const Tv * in, Tv * out, const float * delays, unsigned n){
+	const unsigned fbits = this->fracBits();
+	for(unsigned i=0; i<n; ++i){
+		const Tv v = in[i];
+		out[i] = ipol(*this, mPhase - (delays ? delayFToI(delays[i]) : mDelay));
+		tbl::put(this->elems(), fbits, mPhase, v);
+		mPhase += mPhaseInc;
+	}
+}
+
+TM1 unsigned Delay<TM2>::readSpan(uint32_t minDelay, uint32_t maxDelay) const {
+	/* Reads near the delay must come from before the span and reads near the
+	back of the buffer must not wrap onto the span. The interpolators up to
+	cubic read at most one element back and two ahead of the delay. */
+	if(mIpol.type() > ipl::ALLPASS) return 1;
+	const unsigned fbits = this->fracBits();
+	const unsigned kmin = minDelay >> fbits, kmax = maxDelay >> fbits;
+	if(kmin < 3 || kmax + 3 > this->size()) return 1;
+	return kmin - 2;
+}
+
+TM1 void Delay<TM2>::readSpan(Tv * dst, const uint32_t * delays, unsigned n) const {
+	const ReadSpanFunc f = {*this, dst, delays, n};
+	ipl::apply(mIpol, f);
+}
+
+TM1 template <class S>
+void Delay<TM2>::readSpanIpol(const S& ipol, Tv * dst, const uint32_t * delays, unsigned n) const {
+	uint32_t p = mPhase;
+	if(delays){
+		for(unsigned i=0; i<n; ++i){
+			dst[i] = ipol(*this, p - delays[i]);
+			p += mPhaseInc;
+		}
+	}
+	else{
+		p -= mDelay;
+		for(unsigned i=0; i<n; ++i){
+			dst[i] = ipol(*this, p);
+			p += mPhaseInc;
+		}
+	}
+}
+
+TM1 void Delay<TM2>::writeSpan(const Tv * src, unsigned n){
+	Tv * buf = this->elems();
+	const unsigned mask = this->size()-1;
+	unsigned w = this->index(mPhase);
+	for(unsigned i=0; i<n; ++i){
+		buf[w] = src[i];
+		w = (w+1) & mask;
+	}
+	mPhase += n * mPhaseInc;
+}
+
 TM1 void Delay<TM2>::refreshDelayFactor(){ mDelayFactor = 1.0f/maxDelay(); }
 
 TM1 inline void Delay<TM2>::write(const Tv& v){
@@ -503,6 +872,76 @@ TM1 void Delay<TM2>::print(){
 #undef TM2
 
 
+#define TM1 template <class Tv, template <class> class Si, class Td>
+#define TM2 Tv,Si,Td
+TM1 void Multitap<TM2>::process(const Tv * in, Tv * out, unsigned n){
+	const unsigned T = taps();
+	const bool lin = this->mIpol.type() == ipl::LINEAR;
+	const Tv * buf = this->elems();
+	const unsigned N = this->size(), mask = N-1;
+	const unsigned w = this->index(this->mPhase);
+
+	/* A tap k elements back reads element i-k of the input or, before the
+	block, of the buffer. Linear interpolation also reads the next element,
+	so it needs k > 1, else it would read an element yet to be written. */
+	bool gather = lin || this->mIpol.type() == ipl::TRUNC;
+	for(unsigned t=0; t<T && gather; ++t){
+		const unsigned k = (w - this->index(this->mPhase - mDelays[t])) & mask;
+		gather = k > unsigned(lin);
+	}
+
+	if(!gather){
+		for(unsigned i=0; i<n; ++i){
+			for(unsigned t=0; t<T; ++t) out[t*n + i] = read(t);
+			this->write(in[i]);
+		}
+		return;
+	}
+
+	const unsigned len = n + lin; // elements read by a row
+	if(mSeq.size() < len) mSeq.resize(len);
+
+	for(unsigned t=0; t<T; ++t){
+		const uint32_t p = this->mPhase - mDelays[t];
+		const unsigned k = (w - this->index(p)) & mask;
+		const float f = this->fraction(p);
+		const unsigned r = (w - k) & mask;
+		const Tv * s = buf + r;
+
+		// Gather elements unless the row is within the buffer
+		if(k < len || N - r < len){
+			Tv * g = &mSeq[0];
+			const unsigned m = k < len ? k : len;	// from buffer
+			const unsigned m1 = N - r < m ? N - r : m;
+			std::copy(s, s+m1, g);
+			std::copy(buf, buf+(m-m1), g+m1);
+			std::copy(in, in+(len-m), g+m);
+			s = g;
+		}
+
+		Tv * o = out + t*n;
+		if(lin){
+			for(unsigned i=0; i<n; ++i) o[i] = ipl::linear(f, s[i], s[i+1]);
+		}
+		else{
+			std::copy(s, s+n, o);
+		}
+	}
+
+	// Write block
+	Tv * dst = this->elems();
+	for(unsigned i=0; i<n;){
+		const unsigned wi = (w + i) & mask;
+		const unsigned m = N - wi < n - i ? N - wi : n - i;
+		std::copy(in+i, in+i+m, dst+wi);
+		i += m;
+	}
+	this->mPhase += n * this->mPhaseInc;
+}
+#undef TM1
+#undef TM2
+
+
 
 
 #define TM1 template<class Tv, template<class> class Si, class Tp, class Td>
@@ -540,6 +979,42 @@ TM1 inline Tv Comb<TM2>::circulateFbk(const Tv& i0, const Tv& oN){
 TM1 inline Tv Comb<TM2>::nextFbk(const Tv& i0){
 	return circulateFbk(i0, (*this)()); }
 
+TM1 void Comb<TM2>::process(const Tv * in, Tv * out, unsigned n){
+	process(in, out, NULL, n);
+}
+
+TM1 void Comb<TM2>::process(const Tv * in, Tv * out, const float * delays, unsigned n){
+	enum{ B = 64 };
+	const Tp fb = mFBK, ff = mFFD;
+	Tv o[B], t[B];
+	uint32_t D[B];
+
+	while(n){
+		const unsigned m = n < B ? n : B;
+		uint32_t dmin = this->mDelay, dmax = this->mDelay;
+		if(delays){
+			dmin = ~uint32_t(0); dmax = 0;
+			for(unsigned i=0; i<m; ++i){
+				D[i] = this->delayFToI(delays[i]);
+				if(D[i] < dmin) dmin = D[i];
+				if(D[i] > dmax) dmax = D[i];
+			}
+			delays += m;
+		}
+		const unsigned span = this->readSpan(dmin, dmax);
+
+		for(unsigned j=0; j<m; j+=span){
+			const unsigned l = m-j < span ? m-j : span;
+			this->readSpan(o, delays ? D+j : NULL, l);
+			for(unsigned i=0; i<l; ++i) t[i] = in[i] + o[i] * fb;
+			this->writeSpan(t, l);
+			for(unsigned i=0; i<l; ++i) out[i] = o[i] + t[i] * ff;
+			in += l; out += l;
+		}
+		n -= m;
+	}
+}
+
 TM1 inline void Comb<TM2>::decay(float units, float end){
 	mFBK = pow(end, this->delay() / scl::abs(units));
 	if(units < 0.f) mFBK = -mFBK;
@@ -559,5 +1034,164 @@ TM1 inline float Comb<TM2>::normFfd() const { return 1.f/(1.f + scl::abs(ffd()))
 #undef TM1
 #undef TM2
 
+#define TM1 template <unsigned Nch, class Tv, class Td>
+#define TM2 Nch,Tv,Td
+
+TM1 DelayMC<TM2>::DelayMC()
+:	mMask(0), mWrite(0), mMaxDelay(0), mUniform(true)
+{
+	for(unsigned c=0; c<Nch; ++c){ mDelays[c]=0; mDelayI[c]=0; mDelayF[c]=0; }
+}
+
+TM1 DelayMC<TM2>::DelayMC(float maxDly, float dly)
+:	mMask(0), mWrite(0), mMaxDelay(0), mUniform(true)
+{
+	for(unsigned c=0; c<Nch; ++c){ mDelays[c]=dly; mDelayI[c]=0; mDelayF[c]=0; }
+	maxDelay(maxDly);
+}
+
+TM1 void DelayMC<TM2>::maxDelay(float v){
+	mMaxDelay = v;
+	onDomainChange(1);
+}
+
+TM1 void DelayMC<TM2>::onDomainChange(double /*r*/){
+	if(!(Td::domain() && Td::domain()->hasBeenSet())) return;
+
+	// Room for the maximum delay and the element after it for interpolation
+	const uint32_t frames = scl::ceilPow2(uint32_t(mMaxDelay * Td::spu()) + 2);
+	if(frames*Nch != mBuf.size()){
+		mBuf.assign(frames*Nch, Tv(0));
+		mMask = frames-1;
+		mWrite = 0;
+	}
+	for(unsigned c=0; c<Nch; ++c) refreshDelay(c);
+	refreshUniform();
+}
+
+TM1 void DelayMC<TM2>::refreshDelay(unsigned c){
+	float d = mDelays[c] * float(Td::spu());
+	const float dmax = float(mBuf.size() ? mMask-1 : 0);
+	if(d < 0.f) d = 0.f;
+	if(d > dmax) d = dmax;
+	mDelayI[c] = uint32_t(d);
+	mDelayF[c] = d - float(mDelayI[c]);
+}
+
+TM1 void DelayMC<TM2>::refreshUniform(){
+	mUniform = true;
+	for(unsigned c=0; c<Nch; ++c){
+		if(mDelayI[c] != mDelayI[0] || mDelayF[c] != 0.f) mUniform = false;
+	}
+}
+
+TM1 void DelayMC<TM2>::delay(float v){
+	for(unsigned c=0; c<Nch; ++c){ mDelays[c] = v; refreshDelay(c); }
+	refreshUniform();
+}
+
+TM1 void DelayMC<TM2>::delay(float v, unsigned chan){
+	mDelays[chan] = v;
+	refreshDelay(chan);
+	refreshUniform();
+}
+
+TM1 void DelayMC<TM2>::zero(){
+	std::fill(mBuf.begin(), mBuf.end(), Tv(0));
+}
+
+TM1 inline void DelayMC<TM2>::read(Tv * out) const {
+	const Tv * buf = &mBuf[0];
+	if(mUniform){
+		const Tv * r = buf + ((mWrite - mDelayI[0]) & mMask)*Nch;
+		for(unsigned c=0; c<Nch; ++c) out[c] = r[c];
+		return;
+	}
+	for(unsigned c=0; c<Nch; ++c){
+		const uint32_t i = mWrite - mDelayI[c];
+		const Tv v0 = buf[( i    & mMask)*Nch + c];
+		const Tv v1 = buf[((i-1) & mMask)*Nch + c];
+		out[c] = v0 + (v1 - v0) * mDelayF[c];
+	}
+}
+
+TM1 inline Tv DelayMC<TM2>::read(unsigned chan, float ago) const {
+	float d = ago * float(Td::spu());
+	const uint32_t di = uint32_t(d);
+	const float f = d - float(di);
+	const uint32_t i = mWrite - di;
+	const Tv v0 = mBuf[( i    & mMask)*Nch + chan];
+	const Tv v1 = mBuf[((i-1) & mMask)*Nch + chan];
+	return v0 + (v1 - v0) * f;
+}
+
+TM1 inline void DelayMC<TM2>::write(const Tv * in){
+	Tv * w = &mBuf[(mWrite & mMask)*Nch];
+	for(unsigned c=0; c<Nch; ++c) w[c] = in[c];
+	++mWrite;
+}
+
+TM1 inline void DelayMC<TM2>::operator()(Tv * out, const Tv * in){
+	Tv t[Nch];
+	read(t);
+	write(in);
+	for(unsigned c=0; c<Nch; ++c) out[c] = t[c];
+}
+
+TM1 void DelayMC<TM2>::process(const Tv * in, Tv * out, unsigned n){
+	const unsigned N = mMask+1;
+	const unsigned d = mDelayI[0];
+
+	if(!mUniform || !d){
+		for(unsigned i=0; i<n; ++i) (*this)(out + i*Nch, in + i*Nch);
+		return;
+	}
+
+	/* As in Delay::process, spans of frames up to the delay and up to the
+	buffer size minus the delay are written and then read as copies. */
+	Tv * buf = &mBuf[0];
+	const unsigned span = d < N-d ? d : N-d;
+
+	while(n){
+		const unsigned m = n < span ? n : span;
+		const unsigned w = mWrite & mMask;
+
+		unsigned m1 = N - w < m ? N - w : m;
+		std::copy(in, in + m1*Nch, buf + w*Nch);
+		std::copy(in + m1*Nch, in + m*Nch, buf);
+
+		const unsigned r = (w - d) & mMask;
+		m1 = N - r < m ? N - r : m;
+		std::copy(buf + r*Nch, buf + (r+m1)*Nch, out);
+		std::copy(buf, buf + (m-m1)*Nch, out + m1*Nch);
+
+		mWrite += m;
+		in += m*Nch; out += m*Nch; n -= m;
+	}
+}
+
+TM1 void DelayMC<TM2>::process(const Tv * const * in, Tv * const * out, unsigned n){
+	Tv fi[Nch], fo[Nch];
+	for(unsigned i=0; i<n; ++i){
+		for(unsigned c=0; c<Nch; ++c) fi[c] = in[c][i];
+		(*this)(fo, fi);
+		for(unsigned c=0; c<Nch; ++c) out[c][i] = fo[c];
+	}
+}
+
+#undef TM1
+#undef TM2
+
+#ifdef GAM_EXTERN_TEMPLATE
+GAM_EXTERN_TEMPLATE class Delay<float, ipl::Linear>;
+GAM_EXTERN_TEMPLATE class Delay<double, ipl::Linear>;
+GAM_EXTERN_TEMPLATE class Delay<float, ipl::Cubic>;
+GAM_EXTERN_TEMPLATE class Delay<double, ipl::Cubic>;
+GAM_EXTERN_TEMPLATE class Multitap<float, ipl::Linear>;
+GAM_EXTERN_TEMPLATE class Multitap<double, ipl::Linear>;
+GAM_EXTERN_TEMPLATE class Comb<float, ipl::Linear, float>;
+GAM_EXTERN_TEMPLATE class Comb<double, ipl::Linear, double>;
+#endif
+
 } // gam::
 #endif
@@ -0,0 +1,105 @@
+#ifndef GAMMA_DENORMAL_H_INC
+#define GAMMA_DENORMAL_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Control of denormal floating-point handling on the calling thread
+*/
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define GAM_DENORMAL_SSE 1
+#elif defined(__aarch64__) || (defined(__arm__) && defined(__ARM_FP))
+	#define GAM_DENORMAL_ARM 1
+#endif
+
+namespace gam{
+
+/// Scoped flushing of denormal floats to zero on the calling thread
+
+/// Recursive filters, such as combs, biquads and one-poles, decay into
+/// denormal (subnormal) numbers when their input falls silent. Arithmetic
+/// on denormals can be many times slower than on normal numbers.
+/// While in scope, this sets the flush-to-zero and denormals-are-zero modes
+/// of the FPU (MXCSR on x86, FPCR on ARM) so denormal results and operands
+/// are treated as zero. The previous mode is restored on destruction.
+///
+/// The mode is per thread; each audio, worker or render thread needs a guard.
+/// On unsupported architectures, this does nothing.
+class DenormalGuard{
+public:
+
+	/// \param[in] flush	whether to flush denormals to zero
+	explicit DenormalGuard(bool flush = true)
+	:	mPrev(mode())
+	{	flushToZero(flush); }
+
+	~DenormalGuard(){ mode(mPrev); }
+
+
+	/// Set whether denormals are flushed to zero on the calling thread
+
+	/// \returns whether the mode can be set on this architecture
+	///
+	static bool flushToZero(bool v){
+		#if GAM_DENORMAL_SSE
+		mode(v ? (mode() | FLAGS) : (mode() & ~FLAGS));
+		return true;
+		#elif GAM_DENORMAL_ARM
+		mode(v ? (mode() | FLAGS) : (mode() & ~FLAGS));
+		return true;
+		#else
+		(void)v;
+		return false;
+		#endif
+	}
+
+	/// Whether denormals are flushed to zero on the calling thread
+	static bool flushToZero(){ return FLAGS && (mode() & FLAGS) == FLAGS; }
+
+private:
+	typedef unsigned long long Mode;
+
+	#if GAM_DENORMAL_SSE
+	static const Mode FLAGS = 0x8040; // FTZ (bit 15) | DAZ (bit 6)
+	#elif GAM_DENORMAL_ARM
+	static const Mode FLAGS = 1 << 24; // FZ
+	#else
+	static const Mode FLAGS = 0;
+	#endif
+
+	static Mode mode(){
+		#if GAM_DENORMAL_SSE
+		return _mm_getcsr();
+		#elif defined(__aarch64__)
+		Mode v; __asm__ __volatile__("mrs %0, fpcr" : "=r"(v)); return v;
+		#elif GAM_DENORMAL_ARM
+		unsigned v; __asm__ __volatile__("vmrs %0, fpscr" : "=r"(v)); return v;
+		#else
+		return 0;
+		#endif
+	}
+
+	static void mode(Mode v){
+		#if GAM_DENORMAL_SSE
+		_mm_setcsr((unsigned)v);
+		#elif defined(__aarch64__)
+		__asm__ __volatile__("msr fpcr, %0" : : "r"(v));
+		#elif GAM_DENORMAL_ARM
+		unsigned u = (unsigned)v; __asm__ __volatile__("vmsr fpscr, %0" : : "r"(u));
+		#else
+		(void)v;
+		#endif
+	}
+
+	Mode mPrev;
+
+	DenormalGuard(const DenormalGuard&);
+	DenormalGuard& operator=(const DenormalGuard&);
+};
+
+} // gam::
+
+#endif
@@ -5,6 +5,7 @@
 	See COPYRIGHT file for authors and license information */
 
 #include <stdio.h>
+#include <atomic>
 #include "Gamma/Node.h"
 
 namespace gam{
@@ -35,13 +36,40 @@ public:
 
 
 
+/// Domain with a samples/unit fixed at compile time
+
+/// This can be used in place of DomainObserver when the sample rate is known
+/// when compiling. Objects then carry no vtable pointer or observer links
+/// and conversions between units and samples fold into constants, e.g.,
+/// Sine<float, FixedDomain<48000> >. Like Domain1, it is never notified.
+template <unsigned SPU>
+class FixedDomain{
+public:
+
+	static constexpr double spu(){ return double(SPU); }		///< Get samples/unit
+	static constexpr double ups(){ return 1./double(SPU); }	///< Get units/sample
+	const FixedDomain * domain() const	///< Get pointer to my subject domain (myself)
+		{return this;}
+
+	bool hasBeenSet() const { return true; }
+
+	void onDomainChange(double /*ratioSPU*/){}
+
+	void spu(double /*val*/){}			///< Set samples/unit (no effect)
+	void ups(double /*val*/){}			///< Set units/sample (no effect)
+};
+
+
+
 /// Domain observer
 
 /// This observer will attempt to copy its local variables from the default
 /// subject upon construction. If the default subject has not been constructed, 
 /// it will use its default values of 1. 
 /// This class has a reference to a subject and its own local scaling factors.
-/// By default, the reference subject is Domain::master.
+/// By default, the reference subject is Domain::current(), which is
+/// Domain::master() unless a DomainScope is active on the constructing thread.
+/// Observers may be constructed, attached and destroyed on any thread.
 class DomainObserver : public Node2<DomainObserver> {
 public:
 
@@ -50,7 +78,7 @@ public:
 	/// Copy constructor
 	
 	/// If the argument has a subject, then attach this as an observer to the
-	/// same subject. Otherwise, attach as observer of Domain::master().
+	/// same subject. Otherwise, attach as observer of Domain::current().
 	DomainObserver(const DomainObserver& rhs);
 
 	virtual ~DomainObserver();
@@ -71,12 +99,27 @@ public:
 	/// detached.
 	void domain(Domain& src);
 
+	/// Returns whether this is notified of changes to its subject
+	bool observing() const { return mObserving; }
+
+	/// Bring state up to date with a deferred change of samples/unit
+
+	/// If the subject's samples/unit differs from the one last passed to
+	/// onDomainChange(), onDomainChange() is called with their ratio. Any
+	/// number of deferred changes result in a single call.
+	/// \returns whether onDomainChange() was called
+	bool syncDomain();
+
 	DomainObserver& operator= (const DomainObserver& rhs);
 
 private:
 	friend class Domain;
 
 	Domain * mSubject;	// Pointer to my subject
+	double mSyncedSPU;	// Samples/unit last passed on through onDomainChange
+	bool mObserving;	// Whether linked into subject's observer list
+
+	void detach();
 };
 
 
@@ -84,6 +127,18 @@ private:
 
 
 /// Domain subject
+
+/// The list of observers is guarded by a spin lock held only while linking,
+/// unlinking or notifying, so observers can be created and destroyed on
+/// several threads at once. Observers may attach to and detach from the domain
+/// notifying them. Changing the samples/unit must not overlap with destroying
+/// its observers on other threads, as they unlink only after their derived
+/// parts are gone. When the samples/unit is set once before creating objects,
+/// fixed() lets observers read it without being linked into the list at all.
+/// With deferred(true), a change of samples/unit does not notify observers
+/// at once. They are instead brought up to date in batches of a chosen size
+/// by syncObservers(), e.g., one batch per audio block, or individually by
+/// their syncDomain(). Either must run on the thread that uses the observers.
 class Domain{
 public:
 
@@ -103,18 +158,108 @@ public:
 	double spu() const;					///< Returns samples/unit, i.e. sample rate
 	double ups() const;					///< Returns units/sample, i.e. sample interval
 
+	/// Set whether the samples/unit is fixed
+
+	/// Observers attached to a fixed domain take its samples/unit, but are
+	/// not linked into its list of observers. Attaching and destroying them
+	/// then writes no shared state. They are not notified if the samples/unit
+	/// later changes. Observers attached before fixing are still notified.
+	Domain& fixed(bool v){ mFixed = v; return *this; }
+
+	/// Returns whether the samples/unit is fixed
+	bool fixed() const { return mFixed; }
+
+	/// Set whether observers are notified of changes only by syncObservers()
+	Domain& deferred(bool v){ mDeferred = v; return *this; }
+
+	/// Returns whether observer notification is deferred
+	bool deferred() const { return mDeferred; }
+
+	/// Bring up to date at most maxCount observers with deferred changes
+	void syncObservers(unsigned maxCount = ~0u);
+
+	/// Returns whether some observers may not be up to date
+	bool pending() const { return mPending != NULL; }
+
 	void print(FILE * fp = stdout) const;
 
 	/// Master domain. By default, all observers will be attached to this.
 	static Domain& master();
 
+	/// Domain new observers attach to on the calling thread
+
+	/// This is the domain of the innermost DomainScope on the calling thread,
+	/// or master() if there is none.
+	static Domain& current();
+
 protected:
 	double mSPU, mUPS;
 	DomainObserver * mHeadObserver;	// Head of observer doubly-linked list
+	DomainObserver * mPending;		// Next observer syncObservers() visits
 	bool mHasBeenSet;
+	bool mDeferred;
+	std::atomic<bool> mFixed;
+	mutable std::atomic_flag mListLock;
 
 friend class DomainObserver;
+	class ListLock;
 	void attach(DomainObserver& obs);
+	void detach(DomainObserver& obs);
+};
+
+
+/// Domain running at a fraction of the rate of another domain
+
+/// This observes a parent domain, by default Domain::current(), and sets its
+/// own samples/unit to that of the parent divided by a block size. Objects
+/// attached to it, such as envelopes and LFOs, then advance one sample per
+/// block of the parent, so a modulation network can be run once per audio
+/// block without changing its code. Use ControlRamp to bring values back to
+/// the parent rate.
+class ControlDomain : public Domain, public DomainObserver{
+public:
+
+	/// \param[in] blockSize	number of parent samples per control sample
+	ControlDomain(unsigned blockSize=64);
+
+	/// \param[in] parent		domain to run at a fraction of
+	/// \param[in] blockSize	number of parent samples per control sample
+	ControlDomain(Domain& parent, unsigned blockSize=64);
+
+	/// Set number of parent samples per control sample
+	ControlDomain& blockSize(unsigned v);
+
+	/// Get number of parent samples per control sample
+	unsigned blockSize() const { return mBlockSize; }
+
+	using Domain::spu;
+	using Domain::ups;
+
+	void onDomainChange(double r);
+
+private:
+	unsigned mBlockSize;
+};
+
+
+/// Scoped change of the current domain of a thread
+
+/// While an instance exists, observers default-constructed on its thread
+/// attach to its domain rather than Domain::master(). This lets subgraphs
+/// be built at different rates, e.g., by parallel jobs rendering at
+/// different sample rates, without passing a domain to every object.
+/// Scopes nest and must be destroyed in reverse order of construction on
+/// the thread that made them.
+class DomainScope{
+public:
+	explicit DomainScope(Domain& d);
+	~DomainScope();
+
+	DomainScope(const DomainScope&) = delete;
+	DomainScope& operator= (const DomainScope&) = delete;
+
+private:
+	Domain * mPrev;
 };
 
 
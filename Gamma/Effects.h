@@ -4,6 +4,8 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <limits>
+#include "Gamma/Block.h"
 #include "Gamma/Delay.h"
 #include "Gamma/Envelope.h"
 #include "Gamma/Filter.h"
@@ -41,6 +43,31 @@ public:
 		return (mDepth*mod)*car + car;
 	}
 
+	/// Modulate amplitude of a block of carrier by modulator
+
+	/// \param[out] dst	output samples; may equal car or mod
+	/// \param[in]  car	carrier samples
+	/// \param[in]  mod	modulator samples
+	/// \param[in]  n		number of samples
+	template <class Tv>
+	void operator()(Tv * dst, const Tv * car, const Tv * mod, unsigned n){
+		const Tp d = mDepth;
+		for(unsigned i=0; i<n; ++i) dst[i] = (d*mod[i])*car[i] + car[i];
+	}
+
+	/// Ring modulate a block of carrier by modulator
+
+	/// This is the product of carrier and modulator, without the carrier.
+	/// \param[out] dst	output samples; may equal car or mod
+	/// \param[in]  car	carrier samples
+	/// \param[in]  mod	modulator samples
+	/// \param[in]  n		number of samples
+	template <class Tv>
+	void ring(Tv * dst, const Tv * car, const Tv * mod, unsigned n){
+		const Tp d = mDepth;
+		for(unsigned i=0; i<n; ++i) dst[i] = (d*mod[i])*car[i];
+	}
+
 private:
 	Tp mDepth;
 };
@@ -60,6 +87,23 @@ public:
 	
 	/// Return filtered sample
 	float operator()(float i0){ return bq0(i0) + bq1(i0) + bq2(i0); }
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(float * dst, const float * src, unsigned n){
+		float t0[64], t1[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			bq0(t0, src, m);
+			bq1(t1, src, m);
+			bq2(dst, src, m);
+			for(unsigned i=0; i<m; ++i) dst[i] += t0[i] + t1[i];
+			src += m; dst += m; n -= m;
+		}
+	}
 	
 	Biquad<> bq0, bq1, bq2;
 };
@@ -139,6 +183,10 @@ public:
 /// This filter applies a Chebyshev polynomial to generate the 2nd through Nth 
 /// cosine harmonics of the input signal which is presumed to be a unity gain 
 /// sinusoid.
+///
+/// When the coefficients are static, bake() stores the weighted series in a
+/// table which the block operator then reads with linear interpolation. To
+/// suppress aliasing, run the block operator through Oversample::block().
 ///\ingroup Filter
 template <unsigned N, class T=gam::real> 
 class ChebyN{
@@ -149,6 +197,22 @@ public:
 	
 	/// Returns filtered sample
 	T operator()(T i0) const { return i0*c[0] + wet(i0); }
+
+	/// Filter a block of samples
+
+	/// The series is summed by arr::chebyshev, which is vectorized for
+	/// floats. If a table has been baked, it is read instead, with inputs
+	/// clipped to [-1, 1].
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(T * dst, const T * src, unsigned n) const {
+		if(!mTable.empty()){ lookup(dst, src, n); return; }
+		T a[N+1];
+		a[0] = T(0);
+		for(unsigned i=0; i<N; ++i) a[i+1] = c[i];
+		arr::chebyshev(dst, src, n, a, N+1);
+	}
 	
 	/// Returns cosine overtones of sinusoidal input
 	T wet(T i0) const {
@@ -185,6 +249,39 @@ public:
 		for(unsigned i=0; i<N; ++i) c[i] = T(0);
 		return *this;
 	}
+
+	/// Store weighted series in table for block operator
+
+	/// This must be called again after changing the coefficients.
+	/// \param[in] size	number of table intervals over [-1, 1]; 0 removes table
+	ChebyN& bake(unsigned size=1024){
+		if(!size){ mTable.clear(); return *this; }
+		mTable.resize(size+2);
+		for(unsigned i=0; i<=size; ++i){
+			mTable[i] = (*this)(T(2*double(i)/size - 1));
+		}
+		mTable[size+1] = mTable[size]; // guard for x = 1
+		return *this;
+	}
+
+	/// Returns whether the block operator reads a baked table
+	bool baked() const { return !mTable.empty(); }
+
+private:
+	std::vector<T> mTable;
+
+	void lookup(T * dst, const T * src, unsigned n) const {
+		const T scale = T(0.5) * T(mTable.size()-2);
+		const T * tbl = &mTable[0];
+		for(unsigned i=0; i<n; ++i){
+			T x = src[i];
+			x = x < T(-1) ? T(-1) : (x > T(1) ? T(1) : x);
+			T p = (x + T(1)) * scale;
+			unsigned j = unsigned(p);
+			T f = p - T(j);
+			dst[i] = tbl[j] + (tbl[j+1] - tbl[j]) * f;
+		}
+	}
 };
 
 
@@ -239,6 +336,38 @@ public:
 		o1=comb1(i1); o2=comb2(i2);
 	}
 	
+	/// Filter a block of samples (mono-mono)
+
+	/// This gives the same output as calling operator()(const T&) on each
+	/// sample. The delays of a block are generated first, then each comb
+	/// filters the block with them.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  n		number of samples
+	void process(const T * in, T * out, unsigned n){
+		T o1[B], o2[B];
+		while(n){
+			const unsigned m = modulateBlock(n);
+			comb1.process(in, o1, mDelays[0], m);
+			comb2.process(in, o2, mDelays[1], m);
+			for(unsigned i=0; i<m; ++i) out[i] = (o1[i] + o2[i]) * 0.5f;
+			in += m; out += m; n -= m;
+		}
+	}
+
+	/// Filter a block of samples (stereo-stereo)
+
+	/// This gives the same output as calling operator()(const T&, const T&,
+	/// T&, T&) on each sample.
+	void process(const T * in1, const T * in2, T * out1, T * out2, unsigned n){
+		while(n){
+			const unsigned m = modulateBlock(n);
+			comb1.process(in1, out1, mDelays[0], m);
+			comb2.process(in2, out2, mDelays[1], m);
+			in1 += m; in2 += m; out1 += m; out2 += m; n -= m;
+		}
+	}
+
 	/// Perform delay modulation step (must manually step comb filters after use!)
 	void modulate(){
 		comb1.delay(mDelay + mod.val.r);
@@ -250,7 +379,145 @@ public:
 	CSine<double> mod;						///< Modulator
 
 private:
+	enum{ B = 64 };
 	float mDelay; // Delay interval
+	float mDelays[2][B]; // delays of comb filters over block
+
+	// Generate delays of up to a block, leaving combs at the last ones
+	unsigned modulateBlock(unsigned n){
+		const unsigned m = n < B ? n : B;
+		for(unsigned i=0; i<m; ++i){
+			mDelays[0][i] = mDelay + mod.val.r;
+			mDelays[1][i] = mDelay + mod.val.i;
+			mod();
+		}
+		comb1.delay(mDelays[0][m-1]);
+		comb2.delay(mDelays[1][m-1]);
+		return m;
+	}
+};
+
+
+
+/// Bank of feed-forward compressor/expanders
+
+/// Each channel has its own static curve and attack and release times. Its
+/// gain is computed from its own peak level, the largest peak of all
+/// channels (when linked) or an external sidechain. Levels and gains are
+/// converted with the fast base-2 logarithm and exponential, so curves are
+/// accurate to about 0.5 dB. Channels are processed in groups of eight
+/// lanes, so that the gain computer and smoothing vectorize.
+///
+/// Times are in domain units and levels in dB.
+///\ingroup Effects
+class CompressorBank : public DomainObserver{
+public:
+
+	/// \param[in] channels	number of channels
+	/// \param[in] threshold	level above which to compress, in dB
+	/// \param[in] ratio		input over output level change above threshold
+	/// \param[in] attack		time to react to 63% of a gain decrease
+	/// \param[in] release		time to react to 63% of a gain increase
+	CompressorBank(unsigned channels=1, float threshold=-20, float ratio=4, float attack=0.005, float release=0.1);
+
+
+	/// Set number of channels and reset; allocates memory
+
+	/// New channels copy the parameters of the last channel.
+	///
+	CompressorBank& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return mChannels; }
+
+	/// Set threshold of a channel, in dB
+	CompressorBank& threshold(unsigned c, float dB){ mThresh[c] = dB * cDBToLog2; return *this; }
+
+	/// Set ratio of a channel above threshold; 1 is no compression
+	CompressorBank& ratio(unsigned c, float v){ mSlope[c] = 1.f/v - 1.f; return *this; }
+
+	/// Set width of soft knee of a channel, centered on threshold, in dB
+	CompressorBank& knee(unsigned c, float dB);
+
+	/// Set expansion ratio of a channel below threshold; 1 is no expansion
+	CompressorBank& expandRatio(unsigned c, float v){ mExpand[c] = v - 1.f; return *this; }
+
+	/// Set largest attenuation of a channel, in dB
+	CompressorBank& range(unsigned c, float dB){ mRange[c] = -std::fabs(dB) * cDBToLog2; return *this; }
+
+	/// Set gain of a channel applied after compression, in dB
+	CompressorBank& makeup(unsigned c, float dB){ mMakeup[c] = dB * cDBToLog2; return *this; }
+
+	/// Set attack time of a channel
+	CompressorBank& attack(unsigned c, float v);
+
+	/// Set release time of a channel
+	CompressorBank& release(unsigned c, float v);
+
+	/// Set threshold of all channels, in dB
+	CompressorBank& threshold(float dB){ for(unsigned c=0; c<mChannels; ++c) threshold(c,dB); return *this; }
+
+	/// Set ratio of all channels
+	CompressorBank& ratio(float v){ for(unsigned c=0; c<mChannels; ++c) ratio(c,v); return *this; }
+
+	/// Set knee width of all channels, in dB
+	CompressorBank& knee(float dB){ for(unsigned c=0; c<mChannels; ++c) knee(c,dB); return *this; }
+
+	/// Set expansion ratio of all channels
+	CompressorBank& expandRatio(float v){ for(unsigned c=0; c<mChannels; ++c) expandRatio(c,v); return *this; }
+
+	/// Set largest attenuation of all channels, in dB
+	CompressorBank& range(float dB){ for(unsigned c=0; c<mChannels; ++c) range(c,dB); return *this; }
+
+	/// Set makeup gain of all channels, in dB
+	CompressorBank& makeup(float dB){ for(unsigned c=0; c<mChannels; ++c) makeup(c,dB); return *this; }
+
+	/// Set attack time of all channels
+	CompressorBank& attack(float v){ for(unsigned c=0; c<mChannels; ++c) attack(c,v); return *this; }
+
+	/// Set release time of all channels
+	CompressorBank& release(float v){ for(unsigned c=0; c<mChannels; ++c) release(c,v); return *this; }
+
+	/// Set whether all channels are driven by their largest peak
+	CompressorBank& link(bool v){ mLink = v; return *this; }
+
+	/// Get whether channels are linked
+	bool link() const { return mLink; }
+
+	/// Get gain of a channel after last sample, excluding makeup, in dB
+	float gain(unsigned c) const { return mGain[c] * cLog2ToDB; }
+
+
+	/// Compress a block of all channels
+
+	/// \param[in]  in		channel c's sample i is at in[c*n + i]
+	/// \param[out] out	output laid out as input; may equal in
+	/// \param[in]  n		number of samples
+	/// \param[in]  side	sidechain laid out as input, or NULL to use input
+	void process(const float * in, float * out, unsigned n, const float * side=NULL);
+
+	/// Compress one sample of a single channel bank
+	float operator()(float in){ float y; process(&in, &y, 1); return y; }
+
+	/// Restore unity gain
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	enum{ BLOCK = 64, LANES = 8 };
+	static const float cDBToLog2, cLog2ToDB;
+	unsigned mChannels;
+	bool mLink;
+	// Per channel, padded to a multiple of LANES; levels in log2 units
+	std::vector<float> mThresh, mSlope, mExpand, mKnee, mKneeHalf, mKneeScale;
+	std::vector<float> mRange, mMakeup, mAtk, mRel, mCAtk, mCRel, mGain;
+	float mPeak[BLOCK];
+	float mBuf[(BLOCK+1)*LANES];		// previous gains, then levels and gains, sample major
+
+	static float coef(double samples){
+		return samples > 1. ? float(1. - std::exp(-1. / samples)) : 1.f;
+	}
 };
 
 
@@ -270,7 +537,43 @@ public:
 	T operator()(T in){
 		return (hil(in) * mod()).r;
 	}
-	
+
+	/// Frequency shift a block of input
+
+	/// The modulator is run as four phasors, each four samples apart, so
+	/// that the complex multiplies of neighboring samples are independent.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(T * dst, const T * src, unsigned n){
+		T re[64], im[64];
+		const Complex<T> w = mod.inc();
+		Complex<double> w2(w.r, w.i); w2 *= w2;
+		const Complex<T> w4(w2.r*w2.r - w2.i*w2.i, 2.*w2.r*w2.i);
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			hil(re, im, src, m);
+
+			// Phasors of next four samples
+			T vr[4], vi[4];
+			Complex<T> v = mod.val;
+			for(unsigned k=0; k<4; ++k){ vr[k] = v.r; vi[k] = v.i; v *= w; }
+
+			unsigned i = 0;
+			for(; i+4<=m; i+=4){
+				for(unsigned k=0; k<4; ++k){
+					dst[i+k] = re[i+k]*vr[k] - im[i+k]*vi[k];
+					T r = vr[k]*w4.r - vi[k]*w4.i;
+					vi[k] = vr[k]*w4.i + vi[k]*w4.r;
+					vr[k] = r;
+				}
+			}
+			mod.val(vr[0], vi[0]);
+			for(; i<m; ++i) dst[i] = (Complex<T>(re[i], im[i]) * mod()).r;
+			src += m; dst += m; n -= m;
+		}
+	}
+
 	/// Set frequency shift amount
 	FreqShift& freq(T v){ mod.freq(v); return *this; }
 
@@ -280,6 +583,95 @@ public:
 
 
 
+/// Brickwall lookahead limiter with linked channels
+
+/// Output never exceeds the threshold (to within rounding). The input is
+/// delayed by the lookahead, and the gain falls ahead of each peak so that
+/// the peak passes at the threshold. All channels share one gain, taken from
+/// the highest absolute sample across them, so the stereo (or spatial) image
+/// does not shift.
+///
+/// The required gain of each sample is the threshold over its peak. A
+/// sliding minimum of it over the lookahead window, kept in a monotonic
+/// queue in O(1) time per sample, is released with a one-pole envelope and
+/// then averaged over the window for a smooth attack. The peak across
+/// channels and the channel gains run over whole blocks, which the
+/// compiler vectorizes, so the limiter is cheap enough to put on each of
+/// many output channels.
+///
+/// Memory is only allocated by channels(), lookahead() and on changes of
+/// the sampling rate.
+/// \ingroup Effects
+class Limiter : public DomainObserver{
+public:
+
+	/// \param[in] channels	number of linked channels
+	/// \param[in] threshold	maximum output amplitude
+	/// \param[in] lookahead	lookahead time, in domain units
+	/// \param[in] release		time, in domain units, to recover 63% of gain
+	Limiter(unsigned channels=1, float threshold=1, float lookahead=0.005, float release=0.05);
+
+
+	/// Set number of channels and reset; allocates memory
+	Limiter& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return mChannels; }
+
+	/// Set maximum output amplitude
+	Limiter& threshold(float v){ mThresh = v; return *this; }
+
+	/// Set lookahead time, in domain units, and reset; allocates memory
+	Limiter& lookahead(float v);
+
+	/// Set release time, in domain units
+	Limiter& release(float v);
+
+	/// Get delay of output, in samples
+	unsigned latency() const { return mWin - 1; }
+
+	/// Get gain applied to last output sample
+	float gain() const { return mGain; }
+
+
+	/// Limit a block of all channels
+
+	/// \param[in]  in		channel c's sample i is at in[c*n + i]
+	/// \param[out] out	output laid out as input; may equal in
+	/// \param[in]  n		number of samples
+	void process(const float * in, float * out, unsigned n);
+
+	/// Limit one sample of a single channel limiter
+	float operator()(float in){ float y; process(&in, &y, 1); return y; }
+
+	/// Zero delay lines and restore unity gain
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	enum{ BLOCK = 64 };
+	unsigned mChannels;
+	float mThresh, mLook, mRel;			// lookahead and release in domain units
+	float mCRel;						// release coefficient
+	unsigned mWin;						// window of lookahead plus current sample
+	std::vector<float> mDelay;			// ring of each channel, mMask+1 samples
+	unsigned mMask, mPos;
+	std::vector<float> mQVal;			// monotonic queue of required gains
+	std::vector<uint64_t> mQIdx;		// and their sample indices
+	unsigned mQHead, mQSize;
+	uint64_t mIdx;						// samples processed
+	std::vector<float> mBox;			// released gains of window, for average
+	unsigned mBoxPos;
+	double mBoxSum;
+	float mEnv, mGain;
+	float mPeak[BLOCK], mBlockGain[BLOCK];
+
+	void resize();
+};
+
+
+
 /// Saw oscillator with sweepable filter.
 class MonoSynth{
 public:
@@ -411,9 +803,95 @@ public:
 
 
 
+/// Bank of Karplus-Strong plucked strings
+
+/// This renders many strings at once. The delay lines of all strings share
+/// one arena and one write position. Each sample, the loops of several
+/// strings are run side by side across arrays, so the allpass interpolation
+/// and loop filters vectorize. A string whose output stays below the sleep
+/// level for a whole period is put to sleep and costs nothing until plucked
+/// again.
+///
+/// Each loop has an integer delay, a first order allpass that tunes to a
+/// fraction of a sample (ipl::allpass) and a two-point loop filter whose
+/// brightness sets the mix of its taps.
+///
+/// Memory is only allocated by strings() and on changes of the sampling rate.
+/// \ingroup Oscillator
+class PluckBank : public DomainObserver{
+public:
+
+	/// \param[in] strings	number of strings
+	/// \param[in] minFreq	lowest frequency of any string
+	PluckBank(unsigned strings=0, float minFreq=20);
+
+
+	/// Set number of strings and silence all; allocates memory
+	PluckBank& strings(unsigned n);
+
+	/// Get number of strings
+	unsigned strings() const { return unsigned(mFreq.size()); }
+
+	/// Set frequency of a string, bounded below by the minimum frequency
+	PluckBank& freq(unsigned s, float v);
+
+	/// Set time, in domain units, for a string to decay by 60 dB
+	PluckBank& decay(unsigned s, float v);
+
+	/// Set brightness of a string, in [0, 1]; 1 passes all frequencies
+	PluckBank& brightness(unsigned s, float v);
+
+	/// Set magnitude under which a string goes to sleep
+	PluckBank& sleepLevel(float v){ mSleep = v; return *this; }
+
+	/// Excite a string with a burst of noise filling its loop
+	PluckBank& pluck(unsigned s, float amp=1);
+
+	/// Silence all strings
+	void reset();
+
+
+	/// Render a block of all strings mixed together
+
+	/// \param[out] dst	output samples
+	/// \param[in]  n	number of samples
+	void operator()(float * dst, unsigned n);
+
+	/// Returns whether a string is awake
+	bool active(unsigned s) const { return mAwake[s] != 0; }
+
+	/// Returns number of awake strings
+	unsigned active() const;
+
+	void onDomainChange(double r);
+
+	enum{ LANES = 8 };
+
+private:
+	std::vector<float> mArena;		// delay lines of strings, mCap samples each
+	std::vector<float> mFreq, mDecay, mBright;
+	std::vector<unsigned> mDelay;	// integer part of loop delay
+	std::vector<float> mFrac, mGain, mH0, mH1;
+	std::vector<float> mAP, mZ;		// allpass and loop filter states
+	std::vector<unsigned> mQuiet;	// samples below sleep level
+	std::vector<char> mAwake;
+	std::vector<unsigned> mIDs;		// awake strings of current block
+	NoiseWhite<> mNoise;
+	float mMinFreq, mSleep;
+	unsigned mCap, mPos;
+
+	void tune(unsigned s);
+	void clear(unsigned s);
+	template <unsigned L> void render(const unsigned * ids, float * dst, unsigned n);
+};
+
+
+
 /// Downsamples and quantizes amplitudes
 
-/// This effect is also known as a bitcrusher.
+/// This effect is also known as a bitcrusher. Input is scaled by a gain,
+/// held, quantized and then clipped, so that, as the last stage of a chain,
+/// the block operator makes a single pass over the buffer.
 ///\ingroup Effects
 template <class T=gam::real>
 class Quantizer : public DomainObserver{
@@ -425,22 +903,59 @@ public:
 	void freq(double value);	///< Set freqency of sequence quantization
 	void period(double value);	///< Set period of sequence quantization
 	void step(T value);			///< Set amplitude quantization amount
+	void gain(T value){ mGain=value; }	///< Set gain applied to input
+	void clip(T value){ mClip=value; }	///< Set magnitude outputs are clipped to; 0 turns clipping off
 
 	T operator()(T input);		///< Return next filtered sample
+
+	/// Filter a block of samples
+
+	/// This gives the same output as calling operator()(T) on each sample.
+	/// When the sequence is not downsampled, the gain, quantization and
+	/// clipping are done in a loop that vectorizes.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(T * dst, const T * src, unsigned n);
 	
 	virtual void onDomainChange(double r);
 
 private:
 	T mHeld;
 	double mCount, mSamples, mPeriod;
-	T mStep, mStepRec;
+	T mStep, mStepRec, mGain, mClip;
 	bool mDoStep;
+
+	T shape(T v) const {
+		v *= mGain;
+		if(mDoStep) v = scl::round(v, mStep, mStepRec);
+		if(mClip > T(0)) v = v > mClip ? mClip : (v < -mClip ? -mClip : v);
+		return v;
+	}
+
+	// Same as shape(), but branch-free, with rounding that vectorizes
+	template <bool Step, bool Clip>
+	void shape(T * dst, const T * src, unsigned n) const {
+		const T big = T(1) / std::numeric_limits<T>::epsilon(); // values this large are integers
+		const T g = mGain, r = mStepRec, s = mStep, c = mClip;
+		for(unsigned i=0; i<n; ++i){
+			T v = src[i] * g;
+			if(Step){
+				T a = std::fabs(v * r);
+				a = a < big ? (a + big) - big : a;
+				v = std::copysign(a, v) * s;
+			}
+			if(Clip) v = v > c ? c : (v < -c ? -c : v);
+			dst[i] = v;
+		}
+	}
 };
 
 template<class T>
 Quantizer<T>::Quantizer(double freq, T step)
-:	mPeriod(1./freq)
+:	mHeld(0), mCount(0), mGain(1), mClip(0)
 {
+	this->period(1./freq);
 	this->step(step);
 }
 
@@ -465,11 +980,25 @@ template<class T>
 inline T Quantizer<T>::operator()(T vi){
 	if(++mCount >= mSamples){
 		mCount -= mSamples;
-		mHeld = mDoStep ? scl::round(vi, mStep, mStepRec) : vi;
+		mHeld = shape(vi);
 	}
 	return mHeld;
 }
 
+template<class T>
+void Quantizer<T>::operator()(T * dst, const T * src, unsigned n){
+	if(mSamples > 1.){
+		for(unsigned i=0; i<n; ++i) dst[i] = (*this)(src[i]);
+		return;
+	}
+	if(!n) return;
+	// Every sample is held
+	const bool c = mClip > T(0);
+	if(mDoStep)	c ? shape<true,true>(dst, src, n) : shape<true,false>(dst, src, n);
+	else		c ? shape<false,true>(dst, src, n) : shape<false,false>(dst, src, n);
+	mHeld = dst[n-1];
+}
+
 template<class T>
 void Quantizer<T>::onDomainChange(double r){
 	period(mPeriod);
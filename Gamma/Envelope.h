@@ -4,10 +4,13 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <atomic>
 #include <cfloat> /* DBL_MAX, FLT_MAX */
+#include <vector>
 #include "Gamma/gen.h"
 #include "Gamma/ipl.h"
 #include "Gamma/scl.h"
+#include "Gamma/Block.h"
 #include "Gamma/Domain.h"
 #include "Gamma/Strategy.h"
 
@@ -50,13 +53,27 @@ public:
 	/// \param[in] end		end value
 	Curve(Tp length, Tp curve, Tv start=Tv(1), Tv end=Tv(0));
 
-	bool done() const;				///< Returns whether curve has gone past end value
+	inline bool done() const;		///< Returns whether curve has gone past end value
 	Tv end() const { return mEnd; }	///< Get end value
-	Tv value() const;				///< Get current value
+	inline Tv value() const;		///< Get current value
+
+	inline Tv operator()();			///< Generates next value
+
+	/// Generate a block of values
+
+	/// This runs the recurrence as four independent ones, each stepping four
+	/// samples at a time, so that the multiplies of neighboring samples do
+	/// not wait on each other.
+	void operator()(Tv * dst, unsigned n);
+
+	/// Advance a number of samples without generating values
+
+	/// This gives the state after n calls of operator()() in constant time,
+	/// e.g., to start rendering part way through the curve.
+	Curve& advance(uint64_t n);
 
-	Tv operator()();				///< Generates next value
 	Curve& reset(Tv start=Tv(0));	///< Reset envelope
-	Curve& value(const Tv& v);		///< Set value
+	inline Curve& value(const Tv& v);	///< Set value
 
 	/// Set length and curvature
 	
@@ -66,6 +83,24 @@ public:
 	/// \param[in] end		end value
 	Curve& set(Tp length, Tp curve, Tv start=Tv(0), Tv end=Tv(1));
 
+	/// Set from precomputed shape
+
+	/// This gives the same curve as set(length, curve, start, end) without
+	/// any calls of transcendental functions, for retriggering with shapes
+	/// kept from an earlier call of shape().
+	/// \param[in] mul		per-sample multiplier, exp(rate)
+	/// \param[in] denom	1 - exp(curve)
+	/// \param[in] start	start value
+	/// \param[in] end		end value
+	inline Curve& setShape(Tp mul, Tp denom, Tv start, Tv end);
+
+	/// Adjust curvature of a non-zero length curve away from a line
+
+	/// \param[in]     length	length of curve in samples
+	/// \param[in,out] curve	curvature passed to set(); the one used on return
+	/// \param[out]    rate		curvature per sample
+	static void shape(Tp length, Tp& curve, Tp& rate);
+
 protected:
 	Tv mEnd, mA, mB;
 	Tp mMul;
@@ -128,6 +163,21 @@ public:
 	/// Generate next value
 	Tv operator()();
 
+	/// Generate a block of values
+
+	/// This gives the same values as calling operator()() on each sample.
+	/// The samples left in the current segment are generated as one run of
+	/// its curve and sustained or finished levels are filled in, so that
+	/// the stage is only checked between runs.
+	void operator()(Tv * dst, unsigned n);
+
+	/// Advance a number of samples without generating values
+
+	/// This gives the state after n calls of operator()(). Each segment is
+	/// jumped over in constant time, so the cost only grows with the number
+	/// of segments passed.
+	void advance(uint64_t n);
+
 	/// Release the envelope
 	void release();
 
@@ -293,7 +343,20 @@ protected:
 	int mSustain;		// index of sustain point
 	int mLoop;
 
+	// Shapes of segments from their last start, so that restarting a
+	// segment only recomputes the exponentials whose inputs have changed
+	Tp mShapeCrv[N], mShapeDenom[N];	// adjusted curvature and 1 - e^c
+	Tp mShapeRate[N], mShapeMul[N];		// curvature per sample and e^(c/len)
+
 	void setLen(int i){ mLen=unsigned(mLengths[i]*Td::spu()); }
+
+	// Mark shapes as not computed; adjusted curvatures are never zero
+	void clearShapes(){
+		for(int i=0; i<N; ++i) mShapeCrv[i] = mShapeRate[i] = mShapeDenom[i] = mShapeMul[i] = Tp(0);
+	}
+
+	// Start current segment of current length
+	void startSegment(Tv start, Tv end);
 };
 
 
@@ -426,6 +489,203 @@ protected:
 
 
 
+/// Bank of ADSR envelopes for many voices
+
+/// Each voice has the same segments and stages as an ADSR envelope, but
+/// the parameters, curves, stages and positions of all voices are stored in
+/// arrays rather than in an object per voice. A block of all voices is
+/// generated in one pass, voice by voice, each voice in runs of its current
+/// segment as with Env::operator()(Tv *, unsigned). Gates are queued with
+/// sample offsets into the next block and applied at those samples. The
+/// queue is allocated by voices() and maxGates(), so gates can be queued
+/// and blocks generated on the audio thread.
+///
+/// Voices start finished, at zero. Opening a gate restarts the attack from
+/// zero, as ADSR::reset(), and closing it releases from the current value,
+/// as ADSR::release().
+/// \ingroup Envelope
+class EnvelopeBank : public DomainObserver{
+public:
+
+	/// \param[in] voices		number of voices
+	EnvelopeBank(unsigned voices=0);
+
+
+	/// Set number of voices; new voices are finished
+	EnvelopeBank& voices(unsigned n);
+
+	/// Get number of voices
+	unsigned voices() const { return mStage.size(); }
+
+	/// Set maximum number of gates queued for a block
+
+	/// Gates beyond this are dropped. Setting the number of voices raises it
+	/// to at least two gates per voice.
+	EnvelopeBank& maxGates(unsigned n);
+
+	/// Get number of gates dropped because the queue was full
+	unsigned gatesDropped() const { return mDropped; }
+
+	/// Set attack length of a voice
+	EnvelopeBank& attack(unsigned v, float len){ mLens[3*v]=len; return *this; }
+
+	/// Set decay length of a voice
+	EnvelopeBank& decay(unsigned v, float len){ mLens[3*v+1]=len; return *this; }
+
+	/// Set sustain level of a voice (as factor of amplitude)
+	EnvelopeBank& sustain(unsigned v, float lvl){ mSus[v]=lvl; return *this; }
+
+	/// Set release length of a voice
+	EnvelopeBank& release(unsigned v, float len){ mLens[3*v+2]=len; return *this; }
+
+	/// Set amplitude of a voice
+	EnvelopeBank& amp(unsigned v, float a){ mAmp[v]=a; return *this; }
+
+	/// Set curvature of all segments of a voice
+	EnvelopeBank& curve(unsigned v, float c){ mCrv[v]=c; return *this; }
+
+	/// Set all parameters of a voice
+	EnvelopeBank& set(unsigned v, float att, float dec, float sus, float rel, float amp=1, float crv=-4);
+
+
+	/// Open gate of a voice at a sample offset into the next block
+	EnvelopeBank& gateOn(unsigned v, unsigned offset=0);
+
+	/// Close gate of a voice at a sample offset into the next block
+	EnvelopeBank& gateOff(unsigned v, unsigned offset=0);
+
+
+	/// Generate a block of all voices
+
+	/// \param[out] out	voice v's sample i is at out[v*n + i]
+	/// \param[in]  n		number of samples
+	void process(float * out, unsigned n);
+
+
+	/// Get current value of a voice
+	float value(unsigned v) const { return mA[v] - mB[v]; }
+
+	/// Get current stage of a voice (0 = attack, 1 = decay or sustain, 2 = release)
+	int stage(unsigned v) const { return mStage[v]; }
+
+	/// Returns whether a voice is done
+	bool done(unsigned v) const { return mStage[v] == 3; }
+
+	/// Returns whether a voice is released
+	bool released(unsigned v) const { return mReleased[v]; }
+
+private:
+	struct Event{ unsigned offset, voice; bool on; };
+
+	std::vector<float> mLens;		// attack, decay and release length by voice
+	std::vector<float> mSus, mAmp, mCrv;
+	std::vector<float> mA, mB, mMul;	// curves of current segments; value is A - B
+	std::vector<unsigned> mPos, mLen;	// position in and length of segments
+	std::vector<signed char> mStage;
+	std::vector<char> mReleased;
+	std::vector<Event> mEvents;		// sorted by voice, then offset
+	unsigned mMaxGates, mDropped;
+
+	void push(const Event& e);
+	float level(unsigned v, int i) const;
+	void segment(unsigned v, float start);
+	float next(unsigned v);
+	void run(unsigned v, float * dst, unsigned n);
+};
+
+
+
+/// Envelope of any number of breakpoints with random access
+
+/// The breakpoints are stored in one array sorted by time, with each one
+/// holding the curvature of the segment from it to the next, as Curve, so
+/// that envelopes with thousands of points, such as automation lanes, can be
+/// built at run time. The segment at a time is found by binary search, or
+/// from a cursor at the current segment when moving forward, so value() can
+/// evaluate any time directly and seek() can start rendering anywhere, e.g.,
+/// to render parts of a piece in parallel. Blocks are rendered one segment at
+/// a time with the recurrence of Curve, or as lines for segments of nearly
+/// zero curvature.
+///
+/// Before the first breakpoint the level is that of the first point and after
+/// the last it is that of the last point.
+/// \ingroup Envelope
+class BreakpointEnv : public DomainObserver{
+public:
+
+	BreakpointEnv();
+
+
+	/// Add breakpoint
+
+	/// \param[in] time		time of breakpoint, in domain units
+	/// \param[in] level	level at breakpoint
+	/// \param[in] curve	curvature of segment to next breakpoint
+	///						(see Curve); 0 is a line
+	BreakpointEnv& add(double time, float level, float curve=0);
+
+	/// Remove all breakpoints
+	BreakpointEnv& clear();
+
+	/// Get number of breakpoints
+	unsigned size() const { return mPoints.size(); }
+
+	/// Get time of a breakpoint
+	double time(unsigned i) const { return mPoints[i].time; }
+
+	/// Get level of a breakpoint
+	float level(unsigned i) const { return mPoints[i].level; }
+
+	/// Get curvature of segment from a breakpoint
+	float curve(unsigned i) const { return mPoints[i].curve; }
+
+	/// Get time of last breakpoint
+	double length() const { return mPoints.empty() ? 0. : mPoints.back().time; }
+
+	/// Get index of last breakpoint at or before a time; 0 if before first
+	unsigned find(double time) const { return find(time, 0); }
+
+	/// Get level at a time, in domain units
+	float value(double time) const;
+
+
+	/// Set time of next sample, in domain units
+	BreakpointEnv& seek(double time);
+
+	/// Get time of next sample, in domain units
+	double position() const { return mPos * ups(); }
+
+	/// Returns whether the last breakpoint has been passed
+	bool done() const { return mPoints.empty() || position() >= length(); }
+
+	/// Generate next value
+	float operator()();
+
+	/// Generate a block of values
+	void operator()(float * dst, unsigned n);
+
+	void onDomainChange(double r);
+
+private:
+	struct Point{
+		double time;
+		float level, curve;
+	};
+
+	std::vector<Point> mPoints;
+	Curve<float,float> mCurve;	// current segment, if curved
+	float mLineStart, mInc;		// current segment, if a line
+	double mPos;				// time of next sample, in samples
+	unsigned mSeg;				// cursor at current segment
+	unsigned mRemain;			// samples left of curve in segment
+	bool mArmed;				// whether curve is at position
+	bool mLine;
+
+	unsigned find(double time, unsigned hint) const;
+};
+
+
+
 /// Exponentially decaying curve
 
 /// This envelope exponentially decays towards zero starting from an initial
@@ -447,7 +707,10 @@ public:
 	bool done(T thresh=T(0.001)) const; ///< Returns whether value is below threshold
 	T value() const;		///< Returns current value
 
-	T operator()();			///< Generate next sample
+	inline T operator()();	///< Generate next sample
+
+	/// Advance a number of samples in constant time, as n calls of operator()()
+	void advance(uint64_t n);
 	
 	void decay(T v);		///< Set number of units for curve to decay -60 dB
 
@@ -511,6 +774,63 @@ protected:
 
 
 
+/// Bank of gates for many channels
+
+/// Each channel behaves as a Gate<float>, but the thresholds, delays and
+/// states of all channels are stored in arrays. Each channel of a block is
+/// processed in runs of loud and quiet samples, with the gate filled in over
+/// each run, so that the state is only updated where the input crosses the
+/// threshold rather than tested every sample.
+/// \ingroup Envelope
+class GateBank : public DomainObserver{
+public:
+
+	/// \param[in] channels		number of channels
+	/// \param[in] closingDelay	units to wait before closing while under threshold
+	/// \param[in] threshold		threshold below which gates close
+	GateBank(unsigned channels=0, float closingDelay=0, float threshold=0.001);
+
+
+	/// Set number of channels; new channels are open
+	GateBank& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return mThresh.size(); }
+
+	/// Set closing delay of a channel
+	GateBank& delay(unsigned c, float v);
+
+	/// Set closing delay of all channels
+	GateBank& delay(float v);
+
+	/// Set threshold of a channel
+	GateBank& threshold(unsigned c, float v){ mThresh[c]=v; return *this; }
+
+	/// Set threshold of all channels
+	GateBank& threshold(float v);
+
+
+	/// Filter a block of all channels
+
+	/// \param[in]  in	channel c's sample i is at in[c*n + i]
+	/// \param[out] out	gates, 1 if open or 0 if closed, laid out as input
+	/// \param[in]  n		number of samples
+	void process(const float * in, float * out, unsigned n);
+
+	/// Check whether gate of a channel is closed
+	bool done(unsigned c) const { return mGate[c] == 0.f; }
+
+	void onDomainChange(double r);
+
+private:
+	std::vector<float> mDelay, mThresh;
+	std::vector<float> mLimit;	// closing delays in samples
+	std::vector<float> mRemain;	// samples left until closing
+	std::vector<float> mGate;	// last gate values
+};
+
+
+
 /// Interpolation envelope segment
 
 /// \ingroup Envelope Interpolation
@@ -557,6 +877,11 @@ public:
 		return mIpl(f);
 	}
 
+	/// Advance a number of samples in constant time, as n calls of operator()()
+	void advance(uint64_t n){
+		if(!done()) mAcc.val += mAcc.add * Tp(n);
+	}
+
 	/// Generates a new end point from a generator when the segment end is reached
 	
 	/// This can be used to upsample and interpolate a lower-rate signal,
@@ -625,6 +950,11 @@ public:
 		if(done()) return mVal0;
 		return ipl::linear(scl::min(mCurve(), T(1)), mVal1, mVal0);
 	}
+
+	/// Advance a number of samples in constant time, as n calls of operator()()
+	void advance(uint64_t n){
+		if(!done()) mCurve.advance(n);
+	}
 	
 	/// Set new end value.  Start value is set to current value.
 	void operator= (T v){
@@ -656,6 +986,297 @@ protected:
 
 
 
+/// Bank of exponential segments for many channels
+
+/// Each channel behaves as a SegExp<float>, but the curves and states of all
+/// channels are stored in arrays. New targets can be given per sample, e.g.,
+/// from a GateBank, and a channel restarts its segment, as SegExp::operator=,
+/// when its target changes. Between changes, each segment is generated as
+/// one run of interleaved recurrences, without per-sample tests of whether
+/// it is done, so that a many-channel gain smoother runs in tight loops.
+///
+/// Channels start at zero.
+/// \ingroup Envelope Interpolation
+class SegExpBank : public DomainObserver{
+public:
+
+	/// \param[in] channels	number of channels
+	/// \param[in] len		length of segments in domain units
+	/// \param[in] crv		curvature of segments
+	SegExpBank(unsigned channels=0, float len=0.01, float crv=-3);
+
+
+	/// Set number of channels; new channels are at zero
+	SegExpBank& channels(unsigned n);
+
+	/// Get number of channels
+	unsigned channels() const { return mLen.size(); }
+
+	/// Set length and curvature of segments of a channel
+	SegExpBank& set(unsigned c, float len, float crv);
+
+	/// Set length and curvature of segments of all channels
+	SegExpBank& set(float len, float crv);
+
+	/// Set new end value of a channel; start value is set to current value
+	SegExpBank& target(unsigned c, float v);
+
+
+	/// Generate a block of all channels
+
+	/// \param[out] out	channel c's sample i is at out[c*n + i]
+	/// \param[in]  n		number of samples
+	void process(float * out, unsigned n){ process(NULL, out, n); }
+
+	/// Generate a block of all channels following per-sample targets
+
+	/// \param[in]  targets	end values laid out as output; NULL for none
+	/// \param[out] out		channel c's sample i is at out[c*n + i]
+	/// \param[in]  n			number of samples
+	void process(const float * targets, float * out, unsigned n);
+
+	/// Get current value of a channel
+	float value(unsigned c) const;
+
+	/// Returns whether the segment of a channel is done
+	bool done(unsigned c) const { return mA[c] - mB[c] >= 1.f; }
+
+	void onDomainChange(double r);
+
+private:
+	std::vector<float> mLen, mCrv;
+	std::vector<float> mA, mB0, mMul;	// curves in [0,1]; value is A - B
+	std::vector<float> mB, mVal1, mVal0;
+
+	void design(unsigned c);
+	void run(unsigned c, float * dst, unsigned n);
+};
+
+
+
+/// Linear ramp bringing control-rate values to audio rate
+
+/// Each new target is reached in a fixed number of samples, normally the
+/// block size of a ControlDomain, by adding a constant increment per sample.
+/// Setting a target once per block from a value computed at control rate
+/// gives a continuous, piecewise linear signal at audio rate.
+///
+/// \ingroup Envelope Interpolation
+template <class T=gam::real>
+class ControlRamp{
+public:
+
+	/// \param[in] length	number of samples to reach each target
+	/// \param[in] value	initial value
+	ControlRamp(unsigned length=64, T value=T(0))
+	:	mVal(value), mTarget(value), mInc(0), mLen(length ? length : 1), mCount(0)
+	{}
+
+	/// Set number of samples to reach each target
+	ControlRamp& length(unsigned v){ mLen = v ? v : 1; return *this; }
+
+	/// Set new target to ramp to from current value
+	ControlRamp& target(T v){
+		mTarget = v;
+		mInc = (v - mVal) / T(mLen);
+		mCount = mLen;
+		return *this;
+	}
+
+	/// Jump to value
+	ControlRamp& value(T v){ mVal = mTarget = v; mCount = 0; return *this; }
+
+	/// Get current value
+	T value() const { return mVal; }
+
+	/// Returns whether target has been reached
+	bool done() const { return 0 == mCount; }
+
+	/// Generate next value
+	T operator()(){
+		if(mCount){
+			mVal = (--mCount) ? mVal + mInc : mTarget;
+		}
+		return mVal;
+	}
+
+	/// Generate a block of values
+	void operator()(T * dst, unsigned n){
+		unsigned i = 0;
+		const unsigned m = mCount < n ? mCount : n;
+		if(m){
+			// Values of the rest of the ramp are computed from its start so
+			// that they do not depend on each other
+			const T v0 = mVal;
+			for(; i<m; ++i) dst[i] = v0 + mInc * T(i+1);
+			mCount -= m;
+			mVal = mCount ? dst[m-1] : mTarget;
+			if(!mCount) dst[m-1] = mTarget;
+		}
+		for(; i<n; ++i) dst[i] = mVal;
+	}
+
+private:
+	T mVal, mTarget, mInc;
+	unsigned mLen, mCount;
+};
+
+
+
+/// Parameter smoothed towards a target set from any thread
+
+/// The target is stored atomically, so that a control thread can set it
+/// while the audio thread reads it, without locks. The audio thread reads
+/// the target once per sample or once per block and ramps the value to it,
+/// so that parameter changes of unit generators, such as Biquad::freq()
+/// or Osc::freq(), are free of zipper noise. A linear ramp reaches each new
+/// target in a fixed time and an exponential ramp gets 60 dB closer to it
+/// in that time. To set a parameter once per block,
+/// \code
+///	// control thread
+///	cutoff = 2000;
+///	// audio thread
+///	filter.freq(cutoff.next(io.framesPerBuffer()));
+/// \endcode
+///
+/// Only the target setters are safe to call from other threads.
+///
+/// \tparam T	value type, float or double
+/// \ingroup Envelope Interpolation
+template <class T=float, class Td=DomainObserver>
+class SmoothedParam : public Td{
+public:
+
+	/// Shape of ramp to target
+	enum Mode{
+		LINEAR,		/**< Reach target in smoothing time */
+		EXPONENTIAL	/**< Approach target 60 dB in smoothing time */
+	};
+
+	/// \param[in] value	initial value and target
+	/// \param[in] time		smoothing time, in domain units
+	/// \param[in] mode		shape of ramp
+	SmoothedParam(T value=T(0), T time=T(0.02), Mode mode=LINEAR)
+	:	mTarget(value), mVal(value), mEnd(value), mInc(0), mCount(0),
+		mTime(time), mMode(mode)
+	{
+		onDomainChange(1);
+	}
+
+	SmoothedParam(const SmoothedParam& v)
+	:	Td(v), mTarget(v.target()), mVal(v.mVal), mEnd(v.mEnd), mInc(v.mInc),
+		mCount(v.mCount), mTime(v.mTime), mMode(v.mMode), mLen(v.mLen), mMul(v.mMul)
+	{}
+
+
+	/// Set target; safe from any thread
+	void target(T v){ mTarget.store(v, std::memory_order_relaxed); }
+
+	/// Set target; safe from any thread
+	SmoothedParam& operator= (T v){ target(v); return *this; }
+
+	/// Get target; safe from any thread
+	T target() const { return mTarget.load(std::memory_order_relaxed); }
+
+
+	/// Set smoothing time, in domain units
+	SmoothedParam& time(T v){ mTime=v; onDomainChange(1); return *this; }
+
+	/// Set shape of ramp
+	SmoothedParam& mode(Mode v){ mMode=v; restart(); return *this; }
+
+	/// Jump to target
+	SmoothedParam& finish(){ poll(); mVal=mEnd; mCount=0; return *this; }
+
+	/// Get current value
+	T value() const { return mVal; }
+
+	/// Returns whether value is moving towards target
+	bool ramping() const { return mVal != mEnd || mVal != target(); }
+
+
+	/// Generate next value
+	T operator()(){
+		poll();
+		return step();
+	}
+
+	/// Generate a block of values, reading the target once
+	void operator()(T * dst, unsigned n){
+		poll();
+		for(unsigned i=0; i<n; ++i) dst[i] = step();
+	}
+
+	/// Advance a block of samples, reading the target once
+
+	/// \returns value at end of block
+	T next(unsigned n){
+		poll();
+		if(mVal == mEnd) return mVal;
+		if(LINEAR == mMode){
+			const unsigned k = n < mCount ? n : mCount;
+			mCount -= k;
+			mVal = mCount ? mVal + mInc * T(k) : mEnd;
+		}
+		else{
+			mVal = settle(mEnd + (mVal - mEnd) * T(std::pow(double(mMul), double(n))));
+		}
+		return mVal;
+	}
+
+	void onDomainChange(double /*r*/){
+		const double len = mTime * Td::spu();
+		mLen = len >= 1. ? unsigned(len + 0.5) : 1;
+		mMul = T(scl::t60(len >= 1. ? len : 1.));
+		restart();
+	}
+
+private:
+	std::atomic<T> mTarget;
+	T mVal, mEnd, mInc;		// current value, end of ramp and increment
+	unsigned mCount;		// samples left of linear ramp
+	T mTime;
+	Mode mMode;
+	unsigned mLen;			// samples of linear ramp
+	T mMul;					// exponential ramp coefficient
+
+	// Start ramp if target has changed
+	void poll(){
+		const T v = target();
+		if(v != mEnd){
+			mEnd = v;
+			restart();
+		}
+	}
+
+	// Start linear ramp from current value
+	void restart(){
+		mCount = mLen;
+		mInc = (mEnd - mVal) / T(mLen);
+	}
+
+	T step(){
+		if(mVal != mEnd){
+			if(LINEAR == mMode){
+				mVal = (--mCount) ? mVal + mInc : mEnd;
+			}
+			else{
+				mVal = settle(mEnd + (mVal - mEnd) * mMul);
+			}
+		}
+		return mVal;
+	}
+
+	// Snap to end once the difference is too small to hear, avoiding
+	// denormals
+	T settle(T v) const {
+		const T d = v - mEnd;
+		return (d < T(1e-7) + T(1e-6)*scl::abs(mEnd) && d > -T(1e-7) - T(1e-6)*scl::abs(mEnd)) ? mEnd : v;
+	}
+};
+
+
+
 // Implementation_______________________________________________________________
 
 template <class Tv,class Tp>
@@ -691,9 +1312,24 @@ namespace{
 }
 
 template <class Tv,class Tp>
-Curve<Tv,Tp>& Curve<Tv,Tp>::set(Tp len, Tp crv, Tv start, Tv end){
+void Curve<Tv,Tp>::shape(Tp len, Tp& crv, Tp& rate){
 	static const Tp EPS = eps<Tp>();
 
+	// Avoid discontinuity when curve = 0 (a line)
+	if(crv < EPS && crv > -EPS){
+		crv = crv < Tp(0) ? -EPS : EPS;
+	}
+	
+	rate = crv / len;
+	
+	if(rate < EPS && rate > -EPS){
+		rate = rate < Tp(0) ? -EPS : EPS;
+		crv = rate * len;
+	}
+}
+
+template <class Tv,class Tp>
+Curve<Tv,Tp>& Curve<Tv,Tp>::set(Tp len, Tp crv, Tv start, Tv end){
 	if(len == Tp(0)){ // if length is 0, return end value immediately
 		mEnd = end;
 		mMul = maxReal<Tp>();
@@ -702,17 +1338,8 @@ Curve<Tv,Tp>& Curve<Tv,Tp>::set(Tp len, Tp crv, Tv start, Tv end){
 		return *this;
 	}
 
-	// Avoid discontinuity when curve = 0 (a line)
-	if(crv < EPS && crv > -EPS){
-		crv = crv < Tp(0) ? -EPS : EPS;
-	}
-	
-	Tp crvOverLen = crv / len;
-	
-	if(crvOverLen < EPS && crvOverLen > -EPS){
-		crvOverLen = crvOverLen < Tp(0) ? -EPS : EPS;
-		crv = crvOverLen * len;
-	}
+	Tp crvOverLen;
+	shape(len, crv, crvOverLen);
 
 	/*
 	This algorithm uses an exponential curve in [0,1] to linearly interpolate
@@ -721,15 +1348,20 @@ Curve<Tv,Tp>& Curve<Tv,Tp>::set(Tp len, Tp crv, Tv start, Tv end){
 	    1 - e^(cx)
 	y = ---------- * (end-start) + start
 	     1 - e^c
-
+	
 	     delta             delta
 	  = ------- + start - ------- e^(cx) 
 	    1 - e^c           1 - e^c
 	*/
 
+	return setShape(exp(crvOverLen), Tp(1) - exp(crv), start, end);
+}
+
+template <class Tv,class Tp>
+inline Curve<Tv,Tp>& Curve<Tv,Tp>::setShape(Tp mul, Tp denom, Tv start, Tv end){
 	mEnd = end;
-	mMul = exp(crvOverLen);
-	mA = (end-start) / (Tp(1) - exp(crv));
+	mMul = mul;
+	mA = (end-start) / denom;
 	mB = mA / mMul;
 	mA+= start;
 	return *this;
@@ -752,6 +1384,39 @@ inline Tv Curve<Tv,Tp>::operator()(){
 	return value();
 }
 
+template <class Tv,class Tp>
+void Curve<Tv,Tp>::operator()(Tv * dst, unsigned n){
+	Tv b = mB;
+	unsigned i = 0;
+	if(n >= 8){
+		const Tp mul2 = mMul*mMul, mul4 = mul2*mul2;
+		Tv b0 = b*mMul;
+		Tv b1 = b0*mMul;
+		Tv b2 = b1*mMul;
+		Tv b3 = b2*mMul;
+		for(; i+4<=n; i+=4){
+			dst[i  ] = mA - b0;
+			dst[i+1] = mA - b1;
+			dst[i+2] = mA - b2;
+			dst[i+3] = mA - b3;
+			b = b3;
+			b0 *= mul4; b1 *= mul4; b2 *= mul4; b3 *= mul4;
+		}
+	}
+	for(; i<n; ++i){
+		b *= mMul;
+		dst[i] = mA - b;
+	}
+	mB = b;
+}
+
+template <class Tv,class Tp>
+Curve<Tv,Tp>& Curve<Tv,Tp>::advance(uint64_t n){
+	// A zero-length curve has an infinite multiplier and stays at its end
+	if(mB != Tv(0)) mB *= Tp(std::pow(double(mMul), double(n)));
+	return *this;
+}
+
 
 
 template <int N,class Tv,class Tp,class Td>
@@ -763,6 +1428,7 @@ Env<N,Tv,Tp,Td>::Env()
 		mLevels[i] = Tv();
 	}
 	mLevels[N] = Tv();
+	clearShapes();
 	reset();
 }
 
@@ -773,6 +1439,7 @@ Env<N,Tv,Tp,Td>::Env(Tp lvl1, Tp len1, Tp lvl2)
 	levels(lvl1,lvl2);
 	lengths()[0] = len1;
 	curve(-4);
+	clearShapes();
 	reset();
 }
 
@@ -783,6 +1450,7 @@ Env<N,Tv,Tp,Td>::Env(Tp lvl1, Tp len1, Tp lvl2, Tp len2, Tp lvl3)
 	levels(lvl1,lvl2,lvl3);
 	lengths(len1,len2);
 	curve(-4);
+	clearShapes();
 	reset();
 }
 
@@ -793,6 +1461,7 @@ Env<N,Tv,Tp,Td>::Env(Tp lvl1, Tp len1, Tp lvl2, Tp len2, Tp lvl3, Tp len3, Tp lv
 	levels(lvl1,lvl2,lvl3,lvl4);
 	lengths(len1,len2,len3);
 	curve(-4);
+	clearShapes();
 	reset();
 }
 
@@ -820,7 +1489,7 @@ inline Tv Env<N,Tv,Tp,Td>::operator()(){
 			int nextStage = mStage+1;
 			// If looping, ensure we wrap back around to first level
 			if(mLoop && (nextStage==size())) nextStage = 0;
-			mCurve.set(Tp(mLen), mCurves[mStage], mLevels[mStage], mLevels[nextStage]);
+			startSegment(mLevels[mStage], mLevels[nextStage]);
 
 			// Immediately return start level of new stage
 			return (*this)();
@@ -831,6 +1500,71 @@ inline Tv Env<N,Tv,Tp,Td>::operator()(){
 	return mLevels[mStage];
 }	
 
+template <int N,class Tv,class Tp,class Td>
+void Env<N,Tv,Tp,Td>::operator()(Tv * dst, unsigned n){
+	while(n){
+		// Sustained or done; the level holds until a release or reset
+		if(sustained() || (mPos >= mLen && done())){
+			const Tv v = mLevels[mStage];
+			for(unsigned i=0; i<n; ++i) dst[i] = v;
+			return;
+		}
+
+		// Rest of current segment
+		else if(mPos < mLen){
+			const unsigned m = mLen - mPos < n ? mLen - mPos : n;
+			mCurve(dst, m);
+			mPos += m;
+			dst += m; n -= m;
+		}
+
+		// Start of next segment
+		else{
+			*dst++ = (*this)();
+			--n;
+		}
+	}
+}
+
+template <int N,class Tv,class Tp,class Td>
+void Env<N,Tv,Tp,Td>::advance(uint64_t n){
+	while(n){
+		if(sustained() || (mPos >= mLen && done())) return;
+
+		else if(mPos < mLen){
+			const unsigned m = uint64_t(mLen - mPos) < n ? mLen - mPos : unsigned(n);
+			mCurve.advance(m);
+			mPos += m;
+			n -= m;
+		}
+
+		else{
+			(*this)();
+			--n;
+		}
+	}
+}
+
+template <int N,class Tv,class Tp,class Td>
+void Env<N,Tv,Tp,Td>::startSegment(Tv start, Tv end){
+	if(0 == mLen){
+		mCurve.set(Tp(0), mCurves[mStage], start, end);
+		return;
+	}
+
+	Tp crv = mCurves[mStage], rate;
+	mCurve.shape(Tp(mLen), crv, rate);
+	if(crv != mShapeCrv[mStage]){
+		mShapeCrv[mStage] = crv;
+		mShapeDenom[mStage] = Tp(1) - exp(crv);
+	}
+	if(rate != mShapeRate[mStage]){
+		mShapeRate[mStage] = rate;
+		mShapeMul[mStage] = exp(rate);
+	}
+	mCurve.setShape(mShapeMul[mStage], mShapeDenom[mStage], start, end);
+}
+
 template <int N,class Tv,class Tp,class Td>
 void Env<N,Tv,Tp,Td>::release(){
 
@@ -844,7 +1578,7 @@ void Env<N,Tv,Tp,Td>::release(){
 	if(!done()){
 		mPos = 0;
 		setLen(mStage);
-		mCurve.set(Tp(mLen), mCurves[mStage], curVal, mLevels[mStage+1]);
+		startSegment(curVal, mLevels[mStage+1]);
 	}
 }
 
@@ -863,7 +1597,7 @@ void Env<N,Tv,Tp,Td>::resetSoft(){
 	mPos = 0;
 	mStage = 0;
 	setLen(mStage);
-	mCurve.set(Tp(mLen), mCurves[mStage], curVal, mLevels[mStage+1]);
+	startSegment(curVal, mLevels[mStage+1]);
 	mSustain = scl::abs(mSustain);
 }
 
@@ -923,6 +1657,11 @@ inline T Decay<T,Td>::operator()(){
 	return o;
 }
 
+template <class T, class Td>
+void Decay<T,Td>::advance(uint64_t n){
+	mVal *= T(std::pow(double(mMul), double(n)));
+}
+
 template <class T, class Td>
 void Decay<T,Td>::decay(T v){
 	mDcy = v;
@@ -951,5 +1690,22 @@ template <class T, class Td>
 void Decay<T,Td>::onDomainChange(double /*r*/){ decay(mDcy); }
 
 
+#ifdef GAM_EXTERN_TEMPLATE
+GAM_EXTERN_TEMPLATE class Curve<float, float>;
+GAM_EXTERN_TEMPLATE class Curve<double, double>;
+GAM_EXTERN_TEMPLATE class AD<float, float>;
+GAM_EXTERN_TEMPLATE class AD<double, double>;
+GAM_EXTERN_TEMPLATE class ADSR<float, float>;
+GAM_EXTERN_TEMPLATE class ADSR<double, double>;
+GAM_EXTERN_TEMPLATE class Decay<float>;
+GAM_EXTERN_TEMPLATE class Decay<double>;
+GAM_EXTERN_TEMPLATE class Gate<float>;
+GAM_EXTERN_TEMPLATE class Gate<double>;
+GAM_EXTERN_TEMPLATE class SegExp<float>;
+GAM_EXTERN_TEMPLATE class SegExp<double>;
+GAM_EXTERN_TEMPLATE class SmoothedParam<float>;
+GAM_EXTERN_TEMPLATE class SmoothedParam<double>;
+#endif
+
 } // gam::
 #endif
@@ -1,6 +1,7 @@
 #ifndef GAMMA_FFT_H_INC
 #define GAMMA_FFT_H_INC
 
+#include <initializer_list>
 
 namespace gam{
 
@@ -14,7 +15,8 @@ class CFFT{
 public:
 
 	/// \param[in] size		size of complex input sequence; 
-	///						most efficient when a product of small primes
+	///						most efficient when a power of two (vectorized)
+	///						or a product of small primes
 	CFFT(int size=0);
 	
 	~CFFT();
@@ -41,8 +43,31 @@ public:
 	void inverse(ComplexType<T> * buf){ inverse((T*)buf); }
 
 	/// Set size of transform
+
+	/// This does not lock or allocate if the size was reserved.
+	///
 	void resize(int n);
 
+	/// Hold plans and work memory for sizes up to a maximum
+
+	/// The transform keeps plans of every power-of-two size up to maxSize and
+	/// of maxSize itself, so that resize() to any of these sizes does not lock
+	/// or allocate. This itself locks and allocates.
+	void reserve(int maxSize);
+
+	/// Build plans of transform sizes ahead of time
+
+	/// Twiddle factors are computed once per size and precision and shared 
+	/// by all transforms of that size. Calling this at startup avoids 
+	/// computing them later when constructing or resizing a transform.
+	static void prewarm(std::initializer_list<int> sizes);
+
+	/// Get number of plans built for this precision
+
+	/// Plans are shared, so this is the number of sizes used.
+	///
+	static int plans();
+
 private:
 	class Impl; Impl * mImpl;
 };
@@ -58,7 +83,8 @@ class RFFT{
 public:
 
 	/// \param[in] size		size of real input sequence; 
-	///						most efficient when a product of small primes
+	///						most efficient when a power of two (vectorized)
+	///						or a product of small primes
 	RFFT(int size=0);
 	
 	~RFFT();
@@ -90,9 +116,47 @@ public:
 	///									output is [x0, x1, x2, ..., x(n)  ].
 	void inverse(T * buf, bool complexBuf=false);
 
+	/// Perform real-to-complex forward transforms of multiple channels in-place
+
+	/// Channels of float are transformed together in the lanes of SIMD 
+	/// vectors, which is faster than transforming each at small sizes. The
+	/// first call allocates a work buffer.
+	/// \param[in,out]	bufs		channel buffers, each formatted as in forward()
+	/// \param[in]		numChans	number of channels
+	/// \param[in]		complexBuf	\see forward()
+	/// \param[in]		normalize	\see forward()
+	/// \param[in]		nrmGain		\see forward()
+	void forwardBatch(T * const * bufs, int numChans, bool complexBuf=false, bool normalize=true, T nrmGain=1.);
+
+	/// Perform complex-to-real inverse transforms of multiple channels in-place
+
+	/// \see forwardBatch(), inverse()
+	///
+	void inverseBatch(T * const * bufs, int numChans, bool complexBuf=false);
+
 	/// Set size of transform
+
+	/// \see CFFT::resize
+	///
 	void resize(int n);
-	
+
+	/// Hold plans and work memory for sizes up to a maximum
+
+	/// \see CFFT::reserve
+	///
+	void reserve(int maxSize);
+
+	/// Build plans of transform sizes ahead of time
+
+	/// \see CFFT::prewarm
+	///
+	static void prewarm(std::initializer_list<int> sizes);
+
+	/// Get number of plans built for this precision
+
+	/// Plans are shared, so this is the number of sizes used.
+	///
+	static int plans();
 
 private:
 	class Impl; Impl * mImpl;
@@ -4,8 +4,10 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include "Gamma/arr.h"
 #include "Gamma/ipl.h"
 #include "Gamma/scl.h"
+#include "Gamma/Block.h"
 #include "Gamma/Containers.h"
 #include "Gamma/Domain.h"
 #include "Gamma/Types.h"
@@ -52,6 +54,85 @@ inline T freqToRad(T freq, double ups){ return scl::clip(freq * ups, 0.499) * M_
 
 
 
+/// Linear ramp of a set of filter coefficients toward their targets
+
+/// This lets a filter glide to a new setting over a number of samples by
+/// adding precomputed per-sample deltas to its coefficients, so the costly
+/// design formulas run once per target instead of once per sample. The
+/// coefficients are passed by reference, in the same order to every call.
+/// They are set exactly to their targets once the ramp ends.
+///
+/// \tparam M	number of coefficients
+/// \tparam Tp	coefficient type
+template <unsigned M, class Tp=gam::real>
+class CoefRamp{
+public:
+
+	CoefRamp(): mCount(0){}
+
+	/// Start ramp
+
+	/// \param[in] n		number of steps to reach the targets; 0 jumps to them
+	/// \param[in] from	coefficients to start from
+	/// \param[in,out] c	targets on entry, set to 'from' on exit if n > 0
+	template <class... Ts>
+	void start(unsigned n, const Tp * from, Ts&... c){
+		static_assert(sizeof...(Ts) == M, "Wrong number of coefficients");
+		Tp * p[M] = {&c...};
+		mCount = n;
+		if(!n) return;
+		const Tp r = Tp(1)/Tp(n);
+		for(unsigned k=0; k<M; ++k){
+			mEnd[k] = *p[k];
+			mD[k] = (mEnd[k] - from[k]) * r;
+			*p[k] = from[k];
+		}
+	}
+
+	/// Move coefficients one step toward their targets
+	template <class... Ts>
+	void step(Ts&... c){
+		static_assert(sizeof...(Ts) == M, "Wrong number of coefficients");
+		if(!mCount) return;
+		Tp * p[M] = {&c...};
+		if(--mCount)	for(unsigned k=0; k<M; ++k) *p[k] += mD[k];
+		else			for(unsigned k=0; k<M; ++k) *p[k] = mEnd[k];
+	}
+
+	/// Account for m steps taken on copies of the coefficients
+
+	/// The copies should have had delta(k) added m times, where m does not
+	/// exceed remaining(). They are set to their targets if the ramp ends.
+	template <class... Ts>
+	void advance(unsigned m, Ts&... c){
+		static_assert(sizeof...(Ts) == M, "Wrong number of coefficients");
+		Tp * p[M] = {&c...};
+		if(m >= mCount){
+			for(unsigned k=0; k<M; ++k) *p[k] = mEnd[k];
+			mCount = 0;
+		}
+		else mCount -= m;
+	}
+
+	/// Stop ramp, leaving coefficients where they are
+	void stop(){ mCount = 0; }
+
+	/// Get number of steps left
+	unsigned remaining() const { return mCount; }
+
+	/// Get whether ramp is running
+	bool active() const { return mCount != 0; }
+
+	/// Get per-step change of a coefficient
+	Tp delta(unsigned k) const { return mD[k]; }
+
+private:
+	Tp mD[M], mEnd[M];
+	unsigned mCount;
+};
+
+
+
 /// First-order all-pass filter
 
 /// This filter has the transfer function H(z) = (a + z^-1) / (1 + a z^-1).
@@ -74,16 +155,23 @@ public:
 	/// \param[in]	frq		Center frequency
 	AllPass1(Tp frq = Tp(1000));
 
-	void freq (Tp v);		///< Set cutoff frequency
-	void freqF(Tp v);		///< Faster, but slightly less accurate than freq()	
+	inline void freq (Tp v);	///< Set cutoff frequency
+	inline void freqF(Tp v);	///< Faster, but slightly less accurate than freq()	
 	void zero(){ d1=Tv(0); }
 	
-	Tv operator()(Tv in);	///< Filters sample
+	inline Tv operator()(Tv in);	///< Filters sample
 	
-	Tv high(Tv in);			///< High-pass filters sample
-	Tv low (Tv in);			///< Low-pass filters sample
+	inline Tv high(Tv in);	///< High-pass filters sample
+	inline Tv low (Tv in);	///< Low-pass filters sample
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n);
 	
-	Tp freq();				///< Get current cutoff frequency
+	inline Tp freq();		///< Get current cutoff frequency
 	
 	void onDomainChange(double r);
 	
@@ -131,22 +219,70 @@ public:
 	/// Set feedforward (a) and feedback (b) coefficients directly
 	void coef(Tp a0, Tp a1, Tp a2, Tp b1, Tp b2);
 
+	/// Set coefficients from an array, such as a table from biquadCoefs()
 
-	void freq(Tp v);					///< Set center frequency
-	void res(Tp v);						///< Set resonance (Q)
-	void level(Tp v);					///< Set level (PEAKING, LOW_SHELF, HIGH_SHELF types only)
-	void set(Tp frq, Tp res);			///< Set filter center frequency and resonance
+	/// The parameters are not updated, so a change of the domain's rate
+	/// recomputes the coefficients from the last set parameters.
+	/// \param[in] c	coefficients a0, a1, a2, b1, b2
+	/// \param[in] n	number of samples to glide to them over
+	template <class T>
+	void coefs(const T * c, unsigned n=0){
+		glide(n, [&](){ mA[0]=c[0]; mA[1]=c[1]; mA[2]=c[2]; mB[1]=c[3]; mB[2]=c[4]; });
+	}
+
+
+	inline void freq(Tp v);				///< Set center frequency
+	inline void res(Tp v);				///< Set resonance (Q)
+	inline void level(Tp v);			///< Set level (PEAKING, LOW_SHELF, HIGH_SHELF types only)
+	inline void set(Tp frq, Tp res);	///< Set filter center frequency and resonance
 	void set(Tp frq, Tp res, FilterType type);	///< Set all filter params
-	void type(FilterType type);			///< Set type of filter
+	inline void type(FilterType type);	///< Set type of filter
 	void zero();						///< Zero internal delays
 
-	Tv operator()(Tv in);				///< Filter next sample
-	Tv nextBP(Tv in);					///< Optimized for band-pass types
+	/// Glide to a center frequency over n samples
+
+	/// The coefficients are computed once for the new frequency and moved
+	/// linearly from their current values by the next n filtered samples.
+	/// This is much cheaper than setting the frequency every sample, as when
+	/// following an envelope, and, for glides of up to a few dozen samples,
+	/// sounds alike. Setting any parameter without a glide stops the glide.
+	void freq(Tp v, unsigned n){ glide(n, [&](){ freq(v); }); }
+	void res(Tp v, unsigned n){ glide(n, [&](){ res(v); }); }		///< Glide to a resonance over n samples
+	void level(Tp v, unsigned n){ glide(n, [&](){ level(v); }); }	///< Glide to a level over n samples
+
+	inline Tv operator()(Tv in);		///< Filter next sample
+	inline Tv nextBP(Tv in);			///< Optimized for band-pass types
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n);
+
+	/// Filter a block while sweeping the center frequency
+
+	/// This is the same as glide to 'frq' over the block, then filter it.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	/// \param[in]  frq	center frequency reached at the end of the block
+	void operator()(Tv * dst, const Tv * src, unsigned n, Tp frq){
+		freq(frq, n);
+		(*this)(dst, src, n);
+	}
 	
 	Tp freq() const;					///< Get center frequency
 	Tp res() const;						///< Get resonance (Q)
 	Tp level() const;					///< Get level
 	FilterType type() const;			///< Get filter type
+
+	/// Save or restore coefficients, delays and parameters with a StateWriter or StateReader
+	template <class Archive>
+	void state(Archive& ar){
+		ar.array(mA,3).array(mB,3)(d1)(d2)(mFreq)(mResRecip)(mLevel)(mType)(mReal)(mImag)(mAlpha)(mBeta);
+		if(Archive::loading) mRamp.stop();
+	}
 	
 	void onDomainChange(double r);
 
@@ -160,8 +296,346 @@ protected:
 	Tp mReal, mImag;	// real, imag components of center frequency
 	Tp mAlpha, mBeta;
 	Tp mFrqToRad;
+	CoefRamp<5,Tp> mRamp;
+
+	inline void resRecip(Tp v);
+
+	// Apply a setter and ramp from the old coefficients to the new ones
+	template <class Set>
+	void glide(unsigned n, Set set){
+		const Tp c[5] = {mA[0], mA[1], mA[2], mB[1], mB[2]};
+		set();
+		mRamp.start(n, c, mA[0], mA[1], mA[2], mB[1], mB[2]);
+	}
+};
+
+
+
+/// Biquad filter holding only its per-sample state
+
+/// A Biquad keeps its design parameters, domain links and glide ramp next to
+/// the coefficients and delays it actually touches per sample. This keeps
+/// just the latter, 28 bytes with floats, so that arrays of thousands of
+/// voices stay in cache. The coefficients are designed elsewhere, e.g. by a
+/// Biquad or biquadCoefs(), and copied in with coefs() when they change.
+///
+/// \tparam Tv	Value (sample) type
+/// \tparam Tp	Parameter type
+/// \ingroup Filter
+template <class Tv=gam::real, class Tp=gam::real>
+struct BiquadState{
+	Tp a0, a1, a2;	///< Feedforward coefficients
+	Tp b1, b2;		///< Feedback coefficients
+	Tv d1, d2;		///< Inner sample delays
+
+	/// Pass input through unchanged until coefficients are set
+	BiquadState(): a0(1), a1(0), a2(0), b1(0), b2(0), d1(0), d2(0){}
+
+	/// Set coefficients from an array a0, a1, a2, b1, b2
+	template <class T>
+	BiquadState& coefs(const T * c){
+		a0=c[0]; a1=c[1]; a2=c[2]; b1=c[3]; b2=c[4];
+		return *this;
+	}
+
+	/// Set coefficients to those of a Biquad
+	template <class T, class Td>
+	BiquadState& coefs(const Biquad<T,Tp,Td>& src){
+		a0=src.a()[0]; a1=src.a()[1]; a2=src.a()[2]; b1=src.b()[1]; b2=src.b()[2];
+		return *this;
+	}
+
+	/// Zero internal delays
+	void zero(){ d1=d2=Tv(0); }
+
+	/// Filter next sample
+	Tv operator()(Tv i0){
+		// Direct form II, as Biquad
+		i0 = i0 - d1*b1 - d2*b2;
+		Tv o0 = i0*a0 + d1*a1 + d2*a2;
+		d2 = d1; d1 = i0;
+		return o0;
+	}
+
+	/// Filter a block of samples; dst may equal src
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		Tv s1=d1, s2=d2;
+		for(unsigned i=0; i<n; ++i){
+			Tv i0 = src[i] - s1*b1 - s2*b2;
+			dst[i] = i0*a0 + s1*a1 + s2*a2;
+			s2 = s1; s1 = i0;
+		}
+		d1=s1; d2=s2;
+	}
+};
+
+
+
+/// Bank of biquad filters running in lock-step over N channels
+
+/// This filters N independent channels with a biquad per channel, as Biquad,
+/// each with its own coefficients. The states and coefficients of all
+/// channels are stored lane by lane so that each step of the difference
+/// equation is one fixed-length loop over channels, which the compiler maps
+/// onto SIMD registers (e.g., N=4 is one SSE/NEON vector, N=8 one AVX
+/// vector). Channel counts that are a multiple of the vector width give the
+/// best performance.
+///
+/// \tparam N	Number of channels
+/// \tparam Td	Domain observer type
+/// \ingroup Filter
+template <unsigned N, class Td=DomainObserver>
+class BiquadN : public Td{
+public:
+
+	/// \param[in]	frq		Center frequency of all channels
+	/// \param[in]	res		Resonance (Q) of all channels
+	/// \param[in]	type	Type of filter of all channels
+	BiquadN(float frq = 1000, float res = 0.707, FilterType type = LOW_PASS){
+		for(unsigned k=0; k<N; ++k){ mFreq[k] = frq; mDesign[k].set(frq, res, type); }
+		zero();
+		onDomainChange(1);
+	}
+
+
+	/// Set center frequency, resonance and type of a channel
+	void set(unsigned k, float frq, float res, FilterType type){
+		mFreq[k] = frq;
+		mDesign[k].set(frq * Td::ups(), res, type);
+		update(k);
+	}
+
+	void freq(unsigned k, float v){ mFreq[k] = v; mDesign[k].freq(v * Td::ups()); update(k); }	///< Set center frequency of a channel
+	void res(unsigned k, float v){ mDesign[k].res(v); update(k); }		///< Set resonance (Q) of a channel
+	void level(unsigned k, float v){ mDesign[k].level(v); update(k); }	///< Set level of a channel (PEAKING, LOW_SHELF, HIGH_SHELF types only)
+	void type(unsigned k, FilterType v){ mDesign[k].type(v); update(k); }	///< Set type of filter of a channel
+
+	/// Set feedforward (a) and feedback (b) coefficients of a channel directly
+	void coef(unsigned k, float a0, float a1, float a2, float b1, float b2){
+		mDesign[k].coef(a0, a1, a2, b1, b2);
+		update(k);
+	}
+
+	/// Zero internal delays
+	void zero(){ for(unsigned k=0; k<N; ++k) d1[k] = d2[k] = 0.f; }
+
+	float freq(unsigned k) const { return mFreq[k]; }				///< Get center frequency of a channel
+	float res(unsigned k) const { return mDesign[k].res(); }		///< Get resonance (Q) of a channel
+	float level(unsigned k) const { return mDesign[k].level(); }	///< Get level of a channel
+	FilterType type(unsigned k) const { return mDesign[k].type(); }	///< Get filter type of a channel
+
 
-	void resRecip(Tp v);
+	/// Filter next frame of N channel samples in place
+	void operator()(float * io){ (*this)(io, io, 1); }
+
+	/// Filter n interleaved frames of N channel samples
+
+	/// \param[out] dst	output frames; may equal src
+	/// \param[in]  src	input frames
+	/// \param[in]  n	number of frames
+	void operator()(float * dst, const float * src, unsigned n){
+		float a0[N], a1[N], a2[N], b1[N], b2[N], s1[N], s2[N];
+		load(a0, a1, a2, b1, b2, s1, s2);
+		for(unsigned j=0; j<n; ++j){
+			float x[N];
+			for(unsigned k=0; k<N; ++k) x[k] = src[k];
+			step(dst, x, a0, a1, a2, b1, b2, s1, s2);
+			src += N; dst += N;
+		}
+		store(s1, s2);
+	}
+
+	/// Filter n frames of N separate channel buffers
+
+	/// \param[out] dst	output buffer of each channel; may equal src
+	/// \param[in]  src	input buffer of each channel
+	/// \param[in]  n	number of frames
+	void operator()(float * const * dst, const float * const * src, unsigned n){
+		float a0[N], a1[N], a2[N], b1[N], b2[N], s1[N], s2[N];
+		load(a0, a1, a2, b1, b2, s1, s2);
+		for(unsigned j=0; j<n; ++j){
+			float x[N], y[N];
+			for(unsigned k=0; k<N; ++k) x[k] = src[k][j];
+			step(y, x, a0, a1, a2, b1, b2, s1, s2);
+			for(unsigned k=0; k<N; ++k) dst[k][j] = y[k];
+		}
+		store(s1, s2);
+	}
+
+	void onDomainChange(double /*r*/){
+		for(unsigned k=0; k<N; ++k) freq(k, mFreq[k]);
+	}
+
+private:
+	Biquad<float, float, Domain1> mDesign[N];	// coefficient design per channel
+	float mA0[N], mA1[N], mA2[N], mB1[N], mB2[N];
+	float d1[N], d2[N];
+	float mFreq[N];
+
+	void update(unsigned k){
+		mA0[k] = mDesign[k].a()[0]; mA1[k] = mDesign[k].a()[1]; mA2[k] = mDesign[k].a()[2];
+		mB1[k] = mDesign[k].b()[1]; mB2[k] = mDesign[k].b()[2];
+	}
+
+	// Copy coefficients and states to locals so they can live in registers
+	void load(float * a0, float * a1, float * a2, float * b1, float * b2, float * s1, float * s2) const {
+		for(unsigned k=0; k<N; ++k){
+			a0[k] = mA0[k]; a1[k] = mA1[k]; a2[k] = mA2[k]; b1[k] = mB1[k]; b2[k] = mB2[k];
+			s1[k] = d1[k]; s2[k] = d2[k];
+		}
+	}
+
+	void store(const float * s1, const float * s2){
+		for(unsigned k=0; k<N; ++k){ d1[k] = s1[k]; d2[k] = s2[k]; }
+	}
+
+	// Direct form II, as Biquad
+	static void step(float * y, const float * x,
+		const float * a0, const float * a1, const float * a2, const float * b1, const float * b2,
+		float * s1, float * s2
+	){
+		for(unsigned k=0; k<N; ++k){
+			float i0 = x[k] - s1[k]*b1[k] - s2[k]*b2[k];
+			y[k] = i0*a0[k] + s1[k]*a1[k] + s2[k]*a2[k];
+			s2[k] = s1[k]; s1[k] = i0;
+		}
+	}
+};
+
+
+
+/// Cascade of N biquad sections filtering blocks of samples
+
+/// This runs a block through N second-order sections in series, as a chain
+/// of N Biquads, for building high-order equalizers and crossovers. Each
+/// section uses the transposed direct form II, so its two states and five
+/// coefficients stay in registers while it runs over a sub-block, and the
+/// sections are processed in pairs to halve the passes over the sub-block.
+/// Sub-blocks are small enough to stay in the L1 cache.
+///
+/// Coefficients set between calls take effect at the start of the next
+/// block. A section's states carry over a coefficient change, which the
+/// transposed form tolerates with only small transients.
+///
+/// \tparam N	Number of sections
+/// \tparam Td	Domain observer type
+/// \ingroup Filter
+template <unsigned N, class Td=DomainObserver>
+class BiquadCascade : public Td{
+public:
+
+	/// \param[in]	frq		Center frequency of all sections
+	/// \param[in]	res		Resonance (Q) of all sections
+	/// \param[in]	type	Type of filter of all sections
+	BiquadCascade(float frq = 1000, float res = 0.707, FilterType type = LOW_PASS){
+		for(unsigned k=0; k<N; ++k){ mFreq[k] = frq; mDesign[k].set(frq, res, type); }
+		zero();
+		onDomainChange(1);
+	}
+
+
+	/// Set center frequency, resonance and type of a section
+	void set(unsigned k, float frq, float res, FilterType type){
+		mFreq[k] = frq;
+		mDesign[k].set(frq * Td::ups(), res, type);
+		update(k);
+	}
+
+	void freq(unsigned k, float v){ mFreq[k] = v; mDesign[k].freq(v * Td::ups()); update(k); }	///< Set center frequency of a section
+	void res(unsigned k, float v){ mDesign[k].res(v); update(k); }		///< Set resonance (Q) of a section
+	void level(unsigned k, float v){ mDesign[k].level(v); update(k); }	///< Set level of a section (PEAKING, LOW_SHELF, HIGH_SHELF types only)
+	void type(unsigned k, FilterType v){ mDesign[k].type(v); update(k); }	///< Set type of filter of a section
+
+	/// Set feedforward (a) and feedback (b) coefficients of a section directly
+	void coef(unsigned k, float a0, float a1, float a2, float b1, float b2){
+		mDesign[k].coef(a0, a1, a2, b1, b2);
+		update(k);
+	}
+
+	/// Set coefficients of all sections from an array
+
+	/// \param[in] c	5*N coefficients ordered a0, a1, a2, b1, b2 per section
+	void coefs(const float * c){
+		for(unsigned k=0; k<N; ++k, c+=5) coef(k, c[0], c[1], c[2], c[3], c[4]);
+	}
+
+	/// Zero internal delays
+	void zero(){ for(unsigned k=0; k<N; ++k) mS[k][0] = mS[k][1] = 0.f; }
+
+	float freq(unsigned k) const { return mFreq[k]; }				///< Get center frequency of a section
+	float res(unsigned k) const { return mDesign[k].res(); }		///< Get resonance (Q) of a section
+	float level(unsigned k) const { return mDesign[k].level(); }	///< Get level of a section
+	FilterType type(unsigned k) const { return mDesign[k].type(); }	///< Get filter type of a section
+
+	/// Get coefficients of a section, ordered a0, a1, a2, b1, b2
+	const float * coef(unsigned k) const { return mC[k]; }
+
+
+	/// Filter next sample
+	float operator()(float in){
+		for(unsigned k=0; k<N; ++k) in = step(in, mC[k], mS[k][0], mS[k][1]);
+		return in;
+	}
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n	number of samples
+	void operator()(float * dst, const float * src, unsigned n){
+		while(n){
+			const unsigned m = n < BLOCK ? n : BLOCK;
+			const float * in = src;
+			unsigned k = 0;
+			for(; k+1<N; k+=2){ pair(dst, in, m, k); in = dst; }
+			if(k<N) single(dst, in, m, k);
+			src += m; dst += m; n -= m;
+		}
+	}
+
+	/// Filter a block of samples in place
+	void operator()(float * io, unsigned n){ (*this)(io, io, n); }
+
+	void onDomainChange(double /*r*/){
+		for(unsigned k=0; k<N; ++k) freq(k, mFreq[k]);
+	}
+
+private:
+	enum{ BLOCK = 256 };
+	Biquad<float, float, Domain1> mDesign[N];	// coefficient design per section
+	float mC[N][5];		// a0, a1, a2, b1, b2 per section
+	float mS[N][2];		// transposed direct form II states per section
+	float mFreq[N];
+
+	void update(unsigned k){
+		const float * a = mDesign[k].a(), * b = mDesign[k].b();
+		mC[k][0] = a[0]; mC[k][1] = a[1]; mC[k][2] = a[2];
+		mC[k][3] = b[1]; mC[k][4] = b[2];
+	}
+
+	// Transposed direct form II
+	static float step(float x, const float * c, float& s1, float& s2){
+		float y = c[0]*x + s1;
+		s1 = c[1]*x - c[3]*y + s2;
+		s2 = c[2]*x - c[4]*y;
+		return y;
+	}
+
+	void single(float * dst, const float * src, unsigned m, unsigned k){
+		const float c[5] = {mC[k][0], mC[k][1], mC[k][2], mC[k][3], mC[k][4]};
+		float s1 = mS[k][0], s2 = mS[k][1];
+		for(unsigned i=0; i<m; ++i) dst[i] = step(src[i], c, s1, s2);
+		mS[k][0] = s1; mS[k][1] = s2;
+	}
+
+	// Run sections k and k+1 in one pass
+	void pair(float * dst, const float * src, unsigned m, unsigned k){
+		const float c[5] = {mC[k  ][0], mC[k  ][1], mC[k  ][2], mC[k  ][3], mC[k  ][4]};
+		const float d[5] = {mC[k+1][0], mC[k+1][1], mC[k+1][2], mC[k+1][3], mC[k+1][4]};
+		float s1 = mS[k][0], s2 = mS[k][1], t1 = mS[k+1][0], t2 = mS[k+1][1];
+		for(unsigned i=0; i<m; ++i) dst[i] = step(step(src[i], c, s1, s2), d, t1, t2);
+		mS[k][0] = s1; mS[k][1] = s2; mS[k+1][0] = t1; mS[k+1][1] = t2;
+	}
 };
 
 
@@ -191,6 +665,22 @@ public:
 		return o0;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		const Tp b1 = mB1;
+		Tv s = d1;
+		for(unsigned i=0; i<n; ++i){
+			Tv t = src[i] + s*b1;
+			dst[i] = t - s;
+			s = t;
+		}
+		d1 = s;
+	}
+
 	/// Set bandwidth of pole
 	void width(Tp v){
 		mWidth = v;
@@ -231,6 +721,22 @@ public:
 		return o0;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		const Tp b1 = mB1;
+		Tv s = d1;
+		for(unsigned i=0; i<n; ++i){
+			Tv t = src[i] + s*b1;
+			dst[i] = t + s;
+			s = t;
+		}
+		d1 = s;
+	}
+
 	/// Set bandwidth of pole
 	void width(Tp v){
 		Base::width(v);
@@ -267,6 +773,20 @@ public:
 
 	/// Zero delay elements
 	void zero(){ d2=d1=Tv(0); }
+
+	/// Set coefficients from an array, such as a table from resonCoefs()
+
+	/// The parameters are not updated, so a change of the domain's rate
+	/// recomputes the coefficients from the last set parameters.
+	/// \param[in] c	3 coefficients
+	/// \param[in] n	number of samples to glide to them over
+	template <class T>
+	void coefs(const T * c, unsigned n=0){
+		glide(n, [&](){ mC[0]=c[0]; mC[1]=c[1]; mC[2]=c[2]; });
+	}
+
+	/// Get array of 3 coefficients
+	const Tp * coefs() const { return mC; }
 	
 	void onDomainChange(double r){ freq(mFreq); width(mWidth); }
 
@@ -274,7 +794,39 @@ protected:
 
 	Filter2(Tp frq, Tp wid)
 	:	mFreq(frq), mWidth(wid)
-	{	zero(); }
+	{	mC[0] = Tp(1); zero(); }
+
+	// Apply a setter and ramp from the old coefficients to the new ones
+	template <class Set>
+	void glide(unsigned n, Set set){
+		const Tp c[3] = {mC[0], mC[1], mC[2]};
+		set();
+		mRamp.start(n, c, mC[0], mC[1], mC[2]);
+	}
+
+	// Move coefficients one step along a glide
+	void step(){ mRamp.step(mC[0], mC[1], mC[2]); }
+
+	// Filter a block, following any glide; eq(in, c0, c1, c2, d1, d2) is the
+	// difference equation
+	template <class Eq>
+	void block(Tv * dst, const Tv * src, unsigned n, Eq eq){
+		Tp c0=mC[0], c1=mC[1], c2=mC[2];
+		Tv s1=d1, s2=d2;
+		unsigned i = 0;
+		const unsigned m = mRamp.remaining() < n ? mRamp.remaining() : n;
+		if(m){
+			const Tp dc0=mRamp.delta(0), dc1=mRamp.delta(1), dc2=mRamp.delta(2);
+			for(; i<m; ++i){
+				c0+=dc0; c1+=dc1; c2+=dc2;
+				dst[i] = eq(src[i], c0, c1, c2, s1, s2);
+			}
+			mRamp.advance(m, c0, c1, c2);
+			mC[0]=c0; mC[1]=c1; mC[2]=c2;
+		}
+		for(; i<n; ++i) dst[i] = eq(src[i], c0, c1, c2, s1, s2);
+		d1=s1; d2=s2;
+	}
 
 	void freqRef(Tp& v){
 		mFreq = v;		
@@ -284,7 +836,7 @@ protected:
 		computeCoef1();
 	}
 	
-	void computeCoef1(){ mC[1] = Tp(2) * mRad * mCos; }
+	void computeCoef1(){ mC[1] = Tp(2) * mRad * mCos; mRamp.stop(); }
 	void delay(Tv v){ d2=d1; d1=v; }
 	Tp& gain(){ return mC[0]; }
 	
@@ -292,6 +844,7 @@ protected:
 	Tp mC[3];			// coefficients
 	Tp mCos, mRad;
 	Tv d2, d1;			// 2- and 1-sample delays
+	CoefRamp<3,Tp> mRamp;
 };
 
 
@@ -324,14 +877,50 @@ public:
 	AllPass2(Tp frq = Tp(1000), Tp wid = Tp(100))
 	:	Base(frq, wid){}
 
+	using Filter2<Tv,Tp,Td>::freq;
+	using Filter2<Tv,Tp,Td>::width;
+
+	/// Glide to a center frequency over n samples, as Biquad::freq(v, n)
+	void freq(Tp v, unsigned n){ this->glide(n, [&](){ freq(v); }); }
+
+	/// Glide to a bandwidth over n samples
+	void width(Tp v, unsigned n){ this->glide(n, [&](){ width(v); }); }
+
 	/// Filter sample
 	Tv operator()(Tv in){
+		this->step();
 		Tv  t = in + d1*mC[1] + d2*mC[2];
 		Tv o0 = d2 - d1*mC[1] -  t*mC[2];
 		this->delay(t);
 		return o0;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		this->block(dst, src, n, [](Tv in, Tp, Tp c1, Tp c2, Tv& s1, Tv& s2){
+			Tv t = in + s1*c1 + s2*c2;
+			Tv o0 = s2 - s1*c1 - t*c2;
+			s2 = s1; s1 = t;
+			return o0;
+		});
+	}
+
+	/// Filter a block while sweeping the center frequency
+
+	/// This is the same as glide to 'frq' over the block, then filter it.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	/// \param[in]  frq	center frequency reached at the end of the block
+	void operator()(Tv * dst, const Tv * src, unsigned n, Tp frq){
+		freq(frq, n);
+		(*this)(dst, src, n);
+	}
+
 protected:
 	INHERIT_FILTER2;
 };
@@ -362,14 +951,47 @@ public:
 	/// Set bandwidth
 	void width(Tp v){ Base::width(v); computeGain(); }
 
+	/// Glide to a center frequency over n samples, as Biquad::freq(v, n)
+	void freq(Tp v, unsigned n){ this->glide(n, [&](){ freq(v); }); }
+
+	/// Glide to a bandwidth over n samples
+	void width(Tp v, unsigned n){ this->glide(n, [&](){ width(v); }); }
+
 	/// Filter sample
 	Tv operator()(Tv in){
+		this->step();
 		Tv t = in * gain();
 		Tv o0 = t - d1*mC[1] - d2*mC[2];
 		this->delay(t);
 		return o0;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		this->block(dst, src, n, [](Tv in, Tp c0, Tp c1, Tp c2, Tv& s1, Tv& s2){
+			Tv t = in * c0;
+			Tv o0 = t - s1*c1 - s2*c2;
+			s2 = s1; s1 = t;
+			return o0;
+		});
+	}
+
+	/// Filter a block while sweeping the center frequency
+
+	/// This is the same as glide to 'frq' over the block, then filter it.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	/// \param[in]  frq	center frequency reached at the end of the block
+	void operator()(Tv * dst, const Tv * src, unsigned n, Tp frq){
+		freq(frq, n);
+		(*this)(dst, src, n);
+	}
+
 	void onDomainChange(double r){ freq(mFreq); width(mWidth); }
 
 protected:
@@ -411,13 +1033,48 @@ public:
 
 	void set(Tp frq, Tp wid){ Base::width(wid); freq(frq); }
 
+	/// Glide to a center frequency over n samples, as Biquad::freq(v, n)
+	void freq(Tp v, unsigned n){ this->glide(n, [&](){ freq(v); }); }
+
+	/// Glide to a bandwidth over n samples
+	void width(Tp v, unsigned n){ this->glide(n, [&](){ width(v); }); }
+
+	/// Glide to a center frequency and bandwidth over n samples
+	void set(Tp frq, Tp wid, unsigned n){ this->glide(n, [&](){ set(frq, wid); }); }
+
 	/// Filter sample
 	Tv operator()(Tv in){
+		this->step();
 		Tv t = in * gain() + d1*mC[1] + d2*mC[2];
 		this->delay(t);
 		return t;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		this->block(dst, src, n, [](Tv in, Tp c0, Tp c1, Tp c2, Tv& s1, Tv& s2){
+			Tv t = in * c0 + s1*c1 + s2*c2;
+			s2 = s1; s1 = t;
+			return t;
+		});
+	}
+
+	/// Filter a block while sweeping the center frequency
+
+	/// This is the same as glide to 'frq' over the block, then filter it.
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	/// \param[in]  frq	center frequency reached at the end of the block
+	void operator()(Tv * dst, const Tv * src, unsigned n, Tp frq){
+		freq(frq, n);
+		(*this)(dst, src, n);
+	}
+
 	void onDomainChange(double r){ freq(mFreq); width(mWidth); }
 
 protected:
@@ -441,37 +1098,87 @@ protected:
 /// harmonic conjugate. The input and output of the Hilbert transform, comprise
 /// the real and imaginary components of a complex (analytic) signal.
 ///
+/// The transform is made of two branches of six first-order all-pass
+/// sections. The block version runs the sections as a wavefront, each one
+/// sample behind the one before it, so that all twelve sections are updated
+/// at once in SIMD lanes rather than as two chains of six dependent steps.
+/// The output is the same as that of the per-sample version.
+///
 /// \tparam Tv	Value (sample) type
 /// \tparam Tp	Parameter type
 /// \ingroup Filter
 template <class Tv=gam::real, class Tp=gam::real>
 class Hilbert {
 public:
-	#define SR 44100.
-	Hilbert()
-	:	cf0(   5.4135/SR), cf1(  41.118 /SR), cf2(  167.3595/SR),	/* for SR=44100 */
-		cf3( 671.3715/SR), cf4(2694.363 /SR), cf5(11976.867 /SR),
-		sf0(  18.786 /SR), sf1(  83.5065/SR), sf2(  335.1345/SR), 
-		sf3(1344.4065/SR), sf4(5471.871 /SR), sf5(41551.671 /SR)
-	{}
-	#undef SR
+	Hilbert(){
+		// Pole frequencies for SR=44100, in order applied
+		static const double frqs[12] = {
+			11976.867, 2694.363, 671.3715, 167.3595, 41.118, 5.4135,
+			41551.671, 5471.871, 1344.4065, 335.1345, 83.5065, 18.786
+		};
+		for(unsigned k=0; k<12; ++k){
+			// as AllPass1::freq
+			mC[k] = tan(freqToRad(Tp(frqs[k]/44100.), 1.) - M_PI_4);
+		}
+		zero();
+	}
 
 	/// Convert input from real to complex
 	Complex<Tv> operator()(Tv in){
-		return Complex<Tv>(
-			 cf0(cf1(cf2(cf3(cf4(cf5(in)))))),
-			-sf0(sf1(sf2(sf3(sf4(sf5(in))))))
-		);
+		Tv r = in, i = in;
+		for(unsigned k=0; k<6; ++k){
+			r = section(r, mC[k  ], mD[k  ]);
+			i = section(i, mC[k+6], mD[k+6]);
+		}
+		return Complex<Tv>(r, -i);
 	}
-	
-	void zero()
-	{
-		cf0.zero(); cf1.zero(); cf2.zero(); cf3.zero(); cf4.zero(); cf5.zero();
-		sf0.zero(); sf1.zero(); sf2.zero(); sf3.zero(); sf4.zero(); sf5.zero();
+
+	/// Convert a block of input from real to complex
+
+	/// \param[out] re		real parts of output; may equal src
+	/// \param[out] im		imaginary parts of output; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * re, Tv * im, const Tv * src, unsigned n){
+		block(re, im, src, n, mC, mD);
+		for(unsigned i=0; i<n; ++i) im[i] = -im[i];
 	}
+	
+	void zero(){ for(unsigned k=0; k<12; ++k) mD[k] = Tv(0); }
 
 protected:
-	AllPass1<Tv, Tp, Domain1> cf0,cf1,cf2,cf3,cf4,cf5, sf0,sf1,sf2,sf3,sf4,sf5;
+	Tp mC[12];	// all-pass coefficients of real, then imaginary branch
+	Tv mD[12];	// all-pass delays
+
+	// as AllPass1
+	static Tv section(Tv i0, Tp c, Tv& d1){
+		i0 -= d1 * c;
+		Tv o0 = i0 * c + d1;
+		d1 = i0;
+		return o0;
+	}
+
+	static void block(float * re, float * im, const float * src, unsigned n, const float * c, float * d){
+		arr::allPassChains(re, im, src, n, c, d);
+	}
+
+	// As arr::allPassChains
+	template <class V, class P>
+	static void block(V * re, V * im, const V * src, unsigned n, const P * c, V * d){
+		const unsigned S = 6;
+		V y[2*S];
+		for(unsigned k=0; k<2*S; ++k) y[k] = V(0);
+		for(unsigned t=0; t<n+S-1; ++t){
+			const V x = t<n ? src[t] : V(0);
+			for(unsigned j=S; j-->0;){
+				if(t >= j && t-j < n){
+					y[j  ] = section(j ? y[j-1] : x, c[j  ], d[j  ]);
+					y[S+j] = section(j ? y[S+j-1] : x, c[S+j], d[S+j]);
+				}
+			}
+			if(t >= S-1){ re[t-(S-1)] = y[S-1]; im[t-(S-1)] = y[2*S-1]; }
+		}
+	}
 };
 
 
@@ -496,6 +1203,18 @@ public:
 	Tv operator()(Tv in) const {
 		return mo[0] = mo[0]*mb[0] + in;
 	}
+
+	/// Filter a block of input values
+
+	/// \param[out] dst	output values; may equal src
+	/// \param[in]  src	input values
+	/// \param[in]  n		number of values
+	void operator()(Tv * dst, const Tv * src, unsigned n) const {
+		const Tp b = mb[0];
+		Tv o = mo[0];
+		for(unsigned i=0; i<n; ++i) dst[i] = o = o*b + src[i];
+		mo[0] = o;
+	}
 	
 	Integrator& leak(Tp v){ mb[0]=v; return *this; }
 	Integrator& zero(){ mo[0]=Tv(0); return *this; }
@@ -520,6 +1239,21 @@ public:
 		mPrev = in;
 		return res;
 	}
+
+	/// Difference a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(T * dst, const T * src, unsigned n){
+		T prev = mPrev;
+		for(unsigned i=0; i<n; ++i){
+			T in = src[i];
+			dst[i] = in - prev;
+			prev = in;
+		}
+		mPrev = prev;
+	}
 private:
 	T mPrev = T(0);
 };
@@ -532,7 +1266,8 @@ private:
 /// is a rectangular window with a magnitude equal to the inverse of the kernel
 /// size. Due to the symmetry of the window, the moving average filter can be
 /// implemented efficiently using a single delay line with O(1) processing time
-/// complexity.
+/// complexity. The running sum is recomputed from the delay line each time it
+/// wraps around, so rounding errors cannot accumulate over long runs.
 /// \ingroup Filter
 template <class Tv=gam::real>
 class MovingAvg : public DelayN<Tv>{
@@ -547,16 +1282,54 @@ public:
 	:	Base(size), mSum(0), mRSize(0)
 	{	onResize(); }
 
-	MovingAvg& operator=(const Tv& v){ DelayN<Tv>::operator=(v); return *this; }
+	MovingAvg& operator=(const Tv& v){ DelayN<Tv>::operator=(v); resync(); return *this; }
 	
 	Tv operator()(Tv in){
 		mSum += in - Base::operator()(in);
+		if(this->reachedEnd()) resync();
 		return mSum * mRSize;
 	}
 
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n){
+		const unsigned size = Base::size();
+		Tv * ring = this->elems();
+		Tv sum = mSum;
+		const Tv scale = Tv(mRSize);
+		while(n){
+			// Run up to end of ring without index wrapping
+			unsigned i0 = this->pos() + 1;
+			if(i0 >= size) i0 = 0;
+			unsigned m = size - i0;
+			if(m > n) m = n;
+			Tv * r = ring + i0;
+			for(unsigned i=0; i<m; ++i){
+				Tv in = src[i];
+				sum += in - r[i];
+				r[i] = in;
+				dst[i] = sum * scale;
+			}
+			this->pos(i0 + m - 1);
+			if(this->reachedEnd()){ mSum = sum; resync(); sum = mSum; }
+			src += m; dst += m; n -= m;
+		}
+		mSum = sum;
+	}
+
+	/// Recompute running sum from the delay line
+	void resync(){
+		Tv sum = Tv(0);
+		for(unsigned i=0; i<Base::size(); ++i) sum += (*this)[i];
+		mSum = sum;
+	}
+
 	virtual void onResize(){
 		mRSize = 1./Base::size();
-		//printf("mRSize = %g\n", mRSize);
+		resync();
 	}
 
 protected:
@@ -568,6 +1341,116 @@ protected:
 
 
 
+/// Bank of cascaded moving average filters running over N channels
+
+/// This filters N channels of interleaved frames with K moving averages of
+/// the same size in series per channel. One stage has a rectangular kernel;
+/// each further stage convolves it with another rectangle, so that for K=3
+/// or 4 the kernel is close to a Gaussian with a standard deviation of
+/// size*sqrt(K/12). The running sums of all channels are updated in one
+/// fixed-length loop per stage, which the compiler maps onto SIMD registers.
+/// Blocks are processed up to the end of the delay lines at a time, so there
+/// is no index wrapping per sample. The sums are recomputed from the delay
+/// lines each time they wrap around to bound rounding errors.
+///
+/// \tparam N	Number of channels
+/// \tparam K	Number of cascaded stages
+/// \ingroup Filter
+template <unsigned N, unsigned K=1>
+class MovingAvgN{
+public:
+
+	/// \param[in] size		Kernel size of each stage, greater than 0
+	explicit MovingAvgN(unsigned size=1){ resize(size); }
+
+
+	/// Get kernel size of each stage
+	unsigned size() const { return mSize; }
+
+	/// Get group delay, in samples
+	double delay() const { return K*(mSize-1)*0.5; }
+
+	/// Set kernel size of each stage and zero delays
+
+	/// This allocates memory and so should not be done on the audio thread.
+	///
+	void resize(unsigned size){
+		mSize = size < 1 ? 1 : size;
+		mScale = 1.f/mSize;
+		for(unsigned s=0; s<K; ++s) mRing[s].resize(mSize*N);
+		zero();
+	}
+
+	/// Zero internal delays
+	void zero(){
+		for(unsigned s=0; s<K; ++s){
+			mRing[s].assign(0.f);
+			for(unsigned k=0; k<N; ++k) mSum[s][k] = 0.f;
+		}
+		mPos = 0;
+	}
+
+	/// Filter n interleaved frames of N channels
+
+	/// \param[out] dst	output frames; may equal src
+	/// \param[in]  src	input frames
+	/// \param[in]  n	number of frames
+	void operator()(float * dst, const float * src, unsigned n){
+		const float scale = mScale;
+		while(n){
+			unsigned m = mSize - mPos;
+			if(m > n) m = n;
+
+			// Keep sums in locals so they are not reloaded after ring writes
+			float sums[K][N];
+			for(unsigned s=0; s<K; ++s) for(unsigned k=0; k<N; ++k) sums[s][k] = mSum[s][k];
+			for(unsigned j=0; j<m; ++j){
+				float x[N];
+				for(unsigned k=0; k<N; ++k) x[k] = src[k];
+				for(unsigned s=0; s<K; ++s){
+					float * r = mRing[s].elems() + (mPos+j)*N;
+					float * sum = sums[s];
+					for(unsigned k=0; k<N; ++k){
+						sum[k] += x[k] - r[k];
+						r[k] = x[k];
+						x[k] = sum[k] * scale;
+					}
+				}
+				for(unsigned k=0; k<N; ++k) dst[k] = x[k];
+				src += N; dst += N;
+			}
+			for(unsigned s=0; s<K; ++s) for(unsigned k=0; k<N; ++k) mSum[s][k] = sums[s][k];
+
+			mPos += m; n -= m;
+			if(mPos == mSize){ mPos = 0; resync(); }
+		}
+	}
+
+	/// Recompute running sums from the delay lines
+	void resync(){
+		for(unsigned s=0; s<K; ++s){
+			double sum[N];
+			for(unsigned k=0; k<N; ++k) sum[k] = 0.;
+			const float * r = mRing[s].elems();
+			for(unsigned j=0; j<mSize; ++j, r+=N){
+				for(unsigned k=0; k<N; ++k) sum[k] += r[k];
+			}
+			for(unsigned k=0; k<N; ++k) mSum[s][k] = float(sum[k]);
+		}
+	}
+
+private:
+	Array<float> mRing[K];	// last size() inputs of each stage, as frames
+	float mSum[K][N];		// running sum of each stage
+	unsigned mSize, mPos;	// kernel size, next frame to write
+	float mScale;
+
+	MovingAvgN(const MovingAvgN&);
+	MovingAvgN& operator=(const MovingAvgN&);
+};
+
+
+
 /// One-pole filter
 
 /// This filter uses a single pole at either DC or Nyquist to create a low-pass
@@ -586,9 +1469,11 @@ public:
 	OnePole(Tp freq = Tp(1000), const Tv& stored = Tv(0));
 
 	const Tp& freq() const { return mFreq; }	///< Get cutoff frequency
+	const Tp& a0() const { return mA0; }		///< Get feedforward coefficient
+	const Tp& b1() const { return mB1; }		///< Get feedback coefficient
 
-	void type(FilterType type);			///< Set type of filter (gam::LOW_PASS or gam::HIGH_PASS)
-	void freq(Tp val);					///< Set cutoff frequency (-3 dB bandwidth of pole)
+	inline void type(FilterType type);	///< Set type of filter (gam::LOW_PASS or gam::HIGH_PASS)
+	inline void freq(Tp val);			///< Set cutoff frequency (-3 dB bandwidth of pole)
 
 	/// Set lag length of low-pass response (AKA tau)
 
@@ -597,21 +1482,31 @@ public:
 	///						the lag length. Must be greater than 0.
 	void lag(Tp length, Tp thresh=Tp(0.001));
 
-	void smooth(Tp val);				///< Set smoothing coefficient directly
+	inline void smooth(Tp val);			///< Set smoothing coefficient directly
 	void zero(){ o1=0; }				///< Zero internal delay
 	void reset(Tv v = Tv(0)){ o1=mStored=v; }
 
-	const Tv& operator()();				///< Returns filtered output using stored value
-	const Tv& operator()(Tv in);		///< Returns filtered output from input value
+	inline const Tv& operator()();		///< Returns filtered output using stored value
+	inline const Tv& operator()(Tv in);	///< Returns filtered output from input value
+
+	/// Filter a block of samples
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n		number of samples
+	void operator()(Tv * dst, const Tv * src, unsigned n);
+
+	/// Generate a block of outputs moving towards the stored value
+	void operator()(Tv * dst, unsigned n);
 
 	void operator  = (Tv val);			///< Stores input value for operator()
 	void operator *= (Tv val);			///< Multiplies stored value by value
 
-	const Tv& last() const;				///< Returns last output
-	const Tv& stored() const;			///< Returns stored value
-	Tv& stored();						///< Returns stored value
+	inline const Tv& last() const;		///< Returns last output
+	inline const Tv& stored() const;	///< Returns stored value
+	inline Tv& stored();				///< Returns stored value
 
-	bool zeroing(Tv eps=0.0001) const;	///< Returns whether the filter is outputting zeros
+	inline bool zeroing(Tv eps=0.0001) const;	///< Returns whether the filter is outputting zeros
 	
 	void onDomainChange(double r);
 
@@ -623,6 +1518,121 @@ protected:
 
 
 
+/// Bank of one-pole filters running in lock-step over N lanes
+
+/// This filters N independent lanes with a one-pole filter per lane, as
+/// OnePole, each with its own coefficients. It is meant for smoothing many
+/// parameters at once, such as the controls of a voice: each lane moves
+/// towards its own stored value. Coefficients, stored values and outputs are
+/// kept lane by lane so that each step is one fixed-length loop over lanes,
+/// which the compiler maps onto SIMD registers.
+///
+/// \tparam N	Number of lanes
+/// \tparam Td	Domain observer type
+/// \ingroup Filter
+template <unsigned N, class Td=DomainObserver>
+class OnePoleN : public Td{
+public:
+
+	/// \param[in]	frq		Smoothing frequency of all lanes
+	OnePoleN(float frq = 1000){
+		for(unsigned k=0; k<N; ++k){ mFreq[k] = frq; mLag[k] = 0; mStored[k] = mO1[k] = 0.f; }
+		onDomainChange(1);
+	}
+
+
+	/// Set type of filter of a lane (gam::LOW_PASS or gam::HIGH_PASS)
+	void type(unsigned k, FilterType v){ mDesign[k].type(v); mLag[k] = 0; freq(k, mFreq[k]); }
+
+	/// Set cutoff frequency of a lane
+	void freq(unsigned k, float v){
+		mFreq[k] = v; mLag[k] = 0;
+		mDesign[k].freq(v * Td::ups());
+		update(k);
+	}
+
+	/// Set cutoff frequency of all lanes
+	void freq(float v){ for(unsigned k=0; k<N; ++k) freq(k, v); }
+
+	/// Set lag length of low-pass response of a lane, as OnePole::lag
+	void lag(unsigned k, float length, float thresh = 0.001f){
+		mFreq[k] = length; mLag[k] = thresh;
+		mDesign[k].lag(length * Td::spu(), thresh);
+		update(k);
+	}
+
+	/// Set lag length of low-pass response of all lanes
+	void lag(float length, float thresh = 0.001f){ for(unsigned k=0; k<N; ++k) lag(k, length, thresh); }
+
+	/// Set stored value of a lane
+	void stored(unsigned k, float v){ mStored[k] = v; }
+
+	/// Set stored value and output of a lane
+	void reset(unsigned k, float v = 0.f){ mStored[k] = mO1[k] = v; }
+
+	/// Zero internal delays
+	void zero(){ for(unsigned k=0; k<N; ++k) mO1[k] = 0.f; }
+
+	float stored(unsigned k) const { return mStored[k]; }	///< Get stored value of a lane
+	float last(unsigned k) const { return mO1[k]; }		///< Get last output of a lane
+	const float * last() const { return mO1; }			///< Get last outputs of all lanes
+
+
+	/// Move all lanes one sample towards their stored values
+
+	/// \returns the outputs of all lanes
+	const float * operator()(){
+		for(unsigned k=0; k<N; ++k) mO1[k] = mO1[k]*mB1[k] + mStored[k]*mA0[k];
+		return mO1;
+	}
+
+	/// Generate n interleaved frames of N lanes moving towards the stored values
+	void operator()(float * dst, unsigned n){
+		float b1[N], in[N], o[N];
+		for(unsigned k=0; k<N; ++k){ b1[k] = mB1[k]; in[k] = mStored[k]*mA0[k]; o[k] = mO1[k]; }
+		for(unsigned j=0; j<n; ++j){
+			for(unsigned k=0; k<N; ++k) dst[k] = o[k] = o[k]*b1[k] + in[k];
+			dst += N;
+		}
+		for(unsigned k=0; k<N; ++k) mO1[k] = o[k];
+	}
+
+	/// Filter n interleaved frames of N lanes
+
+	/// \param[out] dst	output frames; may equal src
+	/// \param[in]  src	input frames
+	/// \param[in]  n	number of frames
+	void operator()(float * dst, const float * src, unsigned n){
+		float a0[N], b1[N], o[N];
+		for(unsigned k=0; k<N; ++k){ a0[k] = mA0[k]; b1[k] = mB1[k]; o[k] = mO1[k]; }
+		for(unsigned j=0; j<n; ++j){
+			for(unsigned k=0; k<N; ++k) dst[k] = o[k] = o[k]*b1[k] + src[k]*a0[k];
+			src += N; dst += N;
+		}
+		for(unsigned k=0; k<N; ++k) mO1[k] = o[k];
+	}
+
+	void onDomainChange(double /*r*/){
+		for(unsigned k=0; k<N; ++k){
+			if(mLag[k] > 0) lag(k, mFreq[k], mLag[k]);
+			else freq(k, mFreq[k]);
+		}
+	}
+
+private:
+	OnePole<float, float, Domain1> mDesign[N];	// coefficient design per lane
+	float mA0[N], mB1[N];
+	float mStored[N], mO1[N];
+	float mFreq[N];		// cutoff frequency or lag length
+	float mLag[N];		// lag threshold or 0 if frequency was set
+
+	void update(unsigned k){
+		mA0[k] = mDesign[k].a0(); mB1[k] = mDesign[k].b1();
+	}
+};
+
+
+
 
 // Implementation_______________________________________________________________
 
@@ -664,6 +1674,18 @@ inline Tv AllPass1<Tv,Tp,Td>::operator()(Tv i0){
 	return o0;
 }
 
+template <class Tv, class Tp, class Td> 
+void AllPass1<Tv,Tp,Td>::operator()(Tv * dst, const Tv * src, unsigned n){
+	const Tp k = c;
+	Tv s = d1;
+	for(unsigned i=0; i<n; ++i){
+		Tv i0 = src[i] - s * k;
+		dst[i] = i0 * k + s;
+		s = i0;
+	}
+	d1 = s;
+}
+
 template <class Tv, class Tp, class Td>
 inline Tv AllPass1<Tv,Tp,Td>::high(Tv i0){ return (i0 - operator()(i0)) * Tv(0.5); }
 
@@ -720,6 +1742,7 @@ void Biquad<Tv,Tp,Td>::zero(){ d1=d2=Tv(0); }
 
 template <class Tv, class Tp, class Td>
 void Biquad<Tv,Tp,Td>::coef(Tp a0, Tp a1, Tp a2, Tp b1, Tp b2){
+	mRamp.stop();
 	mA[0]=a0; mA[1]=a1; mA[2]=a2; mB[1]=b1; mB[2]=b2;
 }
 
@@ -792,6 +1815,7 @@ inline void Biquad<Tv,Tp,Td>::res(Tp v){
 template <class Tv, class Tp, class Td>
 inline void Biquad<Tv,Tp,Td>::type(FilterType typeA){
 	mType = typeA;
+	mRamp.stop();
 	
 	switch(mType){
 	case LOW_PASS:
@@ -859,6 +1883,7 @@ inline void Biquad<Tv,Tp,Td>::type(FilterType typeA){
 
 template <class Tv, class Tp, class Td>
 inline Tv Biquad<Tv,Tp,Td>::operator()(Tv i0){
+	mRamp.step(mA[0], mA[1], mA[2], mB[1], mB[2]);
 	// Direct form II
 	i0 = i0 - d1*mB[1] - d2*mB[2];
 	Tv o0 = i0*mA[0] + d1*mA[1] + d2*mA[2];
@@ -868,12 +1893,42 @@ inline Tv Biquad<Tv,Tp,Td>::operator()(Tv i0){
 
 template <class Tv, class Tp, class Td>
 inline Tv Biquad<Tv,Tp,Td>::nextBP(Tv i0){
+	mRamp.step(mA[0], mA[1], mA[2], mB[1], mB[2]);
 	i0 = i0 - d1*mB[1] - d2*mB[2];	
 	Tv o0 = (i0 - d2)*mA[0];
 	d2 = d1; d1 = i0;
 	return o0;
 }
 
+template <class Tv, class Tp, class Td>
+void Biquad<Tv,Tp,Td>::operator()(Tv * dst, const Tv * src, unsigned n){
+	Tp a0=mA[0], a1=mA[1], a2=mA[2], b1=mB[1], b2=mB[2];
+	Tv s1=d1, s2=d2;
+	unsigned i = 0;
+
+	// Glide, then run with fixed coefficients
+	const unsigned m = mRamp.remaining() < n ? mRamp.remaining() : n;
+	if(m){
+		const Tp da0=mRamp.delta(0), da1=mRamp.delta(1), da2=mRamp.delta(2);
+		const Tp db1=mRamp.delta(3), db2=mRamp.delta(4);
+		for(; i<m; ++i){
+			a0+=da0; a1+=da1; a2+=da2; b1+=db1; b2+=db2;
+			Tv i0 = src[i] - s1*b1 - s2*b2;
+			dst[i] = i0*a0 + s1*a1 + s2*a2;
+			s2 = s1; s1 = i0;
+		}
+		mRamp.advance(m, a0, a1, a2, b1, b2);
+		mA[0]=a0; mA[1]=a1; mA[2]=a2; mB[1]=b1; mB[2]=b2;
+	}
+
+	for(; i<n; ++i){
+		Tv i0 = src[i] - s1*b1 - s2*b2;
+		dst[i] = i0*a0 + s1*a1 + s2*a2;
+		s2 = s1; s1 = i0;
+	}
+	d1=s1; d2=s2;
+}
+
 
 //---- OnePole
 template <class Tv, class Tp, class Td>
@@ -960,6 +2015,23 @@ inline const Tv& OnePole<Tv,Tp,Td>::operator()(Tv in){
 	return o1;
 }
 
+template <class Tv, class Tp, class Td>
+void OnePole<Tv,Tp,Td>::operator()(Tv * dst, const Tv * src, unsigned n){
+	const Tp a0 = mA0, b1 = mB1;
+	Tv o = o1;
+	for(unsigned i=0; i<n; ++i) dst[i] = o = o*b1 + src[i]*a0;
+	o1 = o;
+}
+
+template <class Tv, class Tp, class Td>
+void OnePole<Tv,Tp,Td>::operator()(Tv * dst, unsigned n){
+	const Tp b1 = mB1;
+	const Tv in = mStored*mA0;
+	Tv o = o1;
+	for(unsigned i=0; i<n; ++i) dst[i] = o = o*b1 + in;
+	o1 = o;
+}
+
 template <class Tv, class Tp, class Td>
 inline void OnePole<Tv,Tp,Td>::operator  = (Tv v){ mStored  = v; }
 
@@ -979,5 +2051,29 @@ template <class Tv, class Tp, class Td>
 inline bool OnePole<Tv,Tp,Td>::zeroing(Tv eps) const {
 	return scl::abs(o1) < eps && mStored == Tv(0);
 }
+
+#ifdef GAM_EXTERN_TEMPLATE
+GAM_EXTERN_TEMPLATE class AllPass1<float, float>;
+GAM_EXTERN_TEMPLATE class AllPass1<double, double>;
+GAM_EXTERN_TEMPLATE class Biquad<float, float>;
+GAM_EXTERN_TEMPLATE class Biquad<double, double>;
+GAM_EXTERN_TEMPLATE class BlockDC<float, float>;
+GAM_EXTERN_TEMPLATE class BlockDC<double, double>;
+GAM_EXTERN_TEMPLATE class BlockNyq<float, float>;
+GAM_EXTERN_TEMPLATE class BlockNyq<double, double>;
+GAM_EXTERN_TEMPLATE class Filter2<float, float>;
+GAM_EXTERN_TEMPLATE class Filter2<double, double>;
+GAM_EXTERN_TEMPLATE class AllPass2<float, float>;
+GAM_EXTERN_TEMPLATE class AllPass2<double, double>;
+GAM_EXTERN_TEMPLATE class Notch<float, float>;
+GAM_EXTERN_TEMPLATE class Notch<double, double>;
+GAM_EXTERN_TEMPLATE class Reson<float, float>;
+GAM_EXTERN_TEMPLATE class Reson<double, double>;
+GAM_EXTERN_TEMPLATE class Hilbert<float, float>;
+GAM_EXTERN_TEMPLATE class Hilbert<double, double>;
+GAM_EXTERN_TEMPLATE class OnePole<float, float>;
+GAM_EXTERN_TEMPLATE class OnePole<double, double>;
+#endif
+
 } // gam::
 #endif
@@ -0,0 +1,93 @@
+#ifndef GAMMA_FILTERDESIGN_H_INC
+#define GAMMA_FILTERDESIGN_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Batched coefficient design for tables of second-order filters
+*/
+
+#include "Gamma/Filter.h"
+
+namespace gam{
+
+/// \addtogroup Filter
+/// @{
+
+/// These compute the coefficients of many filters in one pass, without
+/// instantiating them, using the same formulas as the filters' setters. The
+/// results can be stored, e.g. as formant tables for morphing between
+/// vowels, and loaded with the filters' coefs() methods. Frequencies and
+/// bandwidths are in Hz and 'ups' is the sampling interval (1 / rate) the
+/// coefficients are for. Parameter arrays may be NULL for their defaults.
+
+
+/// Compute coefficients of biquad filters, as Biquad
+
+/// \param[out] coefs	5 coefficients per filter (a0, a1, a2, b1, b2),
+///						for Biquad::coefs and BiquadCascade::coefs
+/// \param[in]  frq		center frequencies
+/// \param[in]  res		resonances (Q); NULL for 0.707
+/// \param[in]  level	levels (PEAKING, LOW_SHELF, HIGH_SHELF types only);
+///						NULL for 1
+/// \param[in]  n		number of filters
+/// \param[in]  type	type of all filters
+/// \param[in]  ups		sampling interval
+void biquadCoefs(
+	float * coefs, const float * frq, const float * res, const float * level,
+	unsigned n, FilterType type, double ups
+);
+
+/// Compute frequency response of a cascade of biquad filters
+
+/// The sine and cosine of each frequency are computed once and shared by
+/// all sections, whose responses are evaluated over blocks of frequencies
+/// in loops that vectorize. This suits plotting the responses of equalizers
+/// at many frequencies.
+///
+/// \param[out] mag	magnitudes at each frequency
+/// \param[out] phs	phases, in radians, at each frequency; may be NULL
+/// \param[in]  coefs	5 coefficients per section, as from biquadCoefs or
+///						BiquadCascade::coef
+/// \param[in]  sections	number of sections in series
+/// \param[in]  frq		frequencies
+/// \param[in]  n		number of frequencies
+/// \param[in]  ups		sampling interval
+void biquadResponse(
+	float * mag, float * phs, const float * coefs, unsigned sections,
+	const float * frq, unsigned n, double ups
+);
+
+/// Compute coefficients of two-pole resonators, as Reson
+
+/// \param[out] coefs	3 coefficients per filter, for Reson::coefs
+/// \param[in]  frq		center frequencies
+/// \param[in]  wid		bandwidths
+/// \param[in]  n		number of filters
+/// \param[in]  ups		sampling interval
+void resonCoefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups);
+
+/// Compute coefficients of two-zero notches, as Notch
+
+/// \param[out] coefs	3 coefficients per filter, for Notch::coefs
+/// \param[in]  frq		center frequencies
+/// \param[in]  wid		bandwidths
+/// \param[in]  n		number of filters
+/// \param[in]  ups		sampling interval
+void notchCoefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups);
+
+/// Compute coefficients of second-order all-pass filters, as AllPass2
+
+/// \param[out] coefs	3 coefficients per filter, for AllPass2::coefs
+/// \param[in]  frq		center frequencies
+/// \param[in]  wid		bandwidths
+/// \param[in]  n		number of filters
+/// \param[in]  ups		sampling interval
+void allPass2Coefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups);
+
+/// @}
+
+} // gam::
+
+#endif
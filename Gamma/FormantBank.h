@@ -0,0 +1,109 @@
+#ifndef GAMMA_FORMANTBANK_H_INC
+#define GAMMA_FORMANTBANK_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Formant filters of many voices morphing between vowels
+*/
+
+#include <vector>
+#include "Gamma/Domain.h"
+#include "Gamma/FormantData.h"
+
+namespace gam{
+
+/// Formant filters of many voices morphing between vowels
+
+/// Each voice runs its input through a band-pass biquad per formant of a
+/// Vowel, scaled by the formant's amplitude, and sums them. The coefficients
+/// of all vowels are designed once, with biquadCoefs(), per change of rate
+/// or resonance. A vowel between two phonemes is a linear blend of their
+/// coefficients, which stays stable since the stable feedback coefficients
+/// of a biquad form a convex region. Setting a vowel costs a few
+/// multiply-adds, so vowels can be changed every block; the coefficients
+/// glide linearly to the new vowel over the next block processed.
+///
+/// Voices are filtered in groups of eight, each formant stepping all voices
+/// of a group in SIMD registers, as Crossover.
+///
+/// \ingroup Filter
+class FormantBank : public DomainObserver{
+public:
+
+	enum{ FORMANTS = 3 };	///< Number of formants of a vowel
+
+	/// \param[in] voices	number of voices
+	/// \param[in] res		resonance (Q) of formant filters
+	FormantBank(unsigned voices=1, float res=12.5);
+
+
+	/// Set number of voices; allocates memory and resets
+	FormantBank& voices(unsigned n);
+
+	/// Set resonance (Q) of formant filters
+	FormantBank& res(float q);
+
+	/// Set vowel of a voice between two phonemes
+
+	/// \param[in] v		voice
+	/// \param[in] type		voice type of formant data
+	/// \param[in] a		phoneme at mix 0
+	/// \param[in] b		phoneme at mix 1
+	/// \param[in] mix		blend from a to b, in [0, 1]
+	FormantBank& vowel(unsigned v, Vowel::Voice type, Vowel::Phoneme a, Vowel::Phoneme b, float mix);
+
+	/// Set vowel of a voice
+	FormantBank& vowel(unsigned v, Vowel::Voice type, Vowel::Phoneme p){
+		return vowel(v, type, p, p, 0.f);
+	}
+
+	unsigned voices() const { return mVoices; }	///< Get number of voices
+	float res() const { return mRes; }			///< Get resonance (Q) of formant filters
+
+	/// Get coefficients of a vowel
+
+	/// \returns 5 coefficients (a0, a1, a2, b1, b2) per formant, with the
+	/// feedforward ones scaled by the formant's amplitude
+	const float * coefs(Vowel::Voice type, Vowel::Phoneme p) const {
+		return &mTable[(type*Vowel::NUM_PHONEMES + p) * 5*FORMANTS];
+	}
+
+
+	/// Filter a block of all voices
+
+	/// \param[out] dst	output buffer of each voice; may equal its src
+	/// \param[in]  src	input buffer of each voice
+	/// \param[in]  n	number of samples
+	void process(float * const * dst, const float * const * src, unsigned n);
+
+	/// Zero filter states
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	enum{ BLOCK = 64, LANES = 8, GROUP = 5*FORMANTS*LANES };
+	struct Selection{
+		Vowel::Voice type;
+		Vowel::Phoneme a, b;
+		float mix;
+	};
+	unsigned mVoices;
+	float mRes;
+	std::vector<float> mTable;		// coefficients by voice type, phoneme, formant
+	std::vector<Selection> mSel;	// vowel of each voice
+	std::vector<char> mFresh;		// whether a voice has not been given a vowel
+	// Per group, by formant, coefficient, then lane
+	std::vector<float> mCur, mTar;
+	std::vector<float> mState;		// per group, by formant, 2 states times LANES
+	float mX[BLOCK*LANES], mY[BLOCK*LANES];	// sample major
+
+	void design();
+	void target(unsigned v);
+};
+
+} // gam::
+
+#endif
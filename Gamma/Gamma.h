@@ -43,25 +43,50 @@
 	// System/Utility
 	#include "Gamma/AudioIO.h"
 	#include "Gamma/Conversion.h"
+	#include "Gamma/CPU.h"
+	#include "Gamma/Denormal.h"
 	#include "Gamma/Print.h"
+	#include "Gamma/RTCheck.h"
+	#include "Gamma/State.h"
+	#include "Gamma/Trace.h"
 	#include "Gamma/TransferFunc.h"
 
 	// Generators/Filters
 	#include "Gamma/Access.h"
+	#include "Gamma/Ambisonics.h"
+	#include "Gamma/AsyncSTFT.h"
+	#include "Gamma/Block.h"
+	#include "Gamma/Chain.h"
+	#include "Gamma/Convolver.h"
+	#include "Gamma/Crossover.h"
 	#include "Gamma/Delay.h"
 	#include "Gamma/DFT.h"
 	#include "Gamma/Domain.h"
 	#include "Gamma/Envelope.h"
 	#include "Gamma/FFT.h"
 	#include "Gamma/Filter.h"
+	#include "Gamma/FilterDesign.h"
+	#include "Gamma/FormantBank.h"
 	#include "Gamma/FormantData.h"
+	#include "Gamma/GammatoneBank.h"
+	#include "Gamma/Granular.h"
+	#include "Gamma/LinearPhaseEQ.h"
+	#include "Gamma/MDCT.h"
 	#include "Gamma/Noise.h"
 	#include "Gamma/Oscillator.h"
+	#include "Gamma/Oversample.h"
+	#include "Gamma/PeakCache.h"
+	#include "Gamma/PhaseVocoder.h"
+	#include "Gamma/SampleCache.h"
 	#include "Gamma/SamplePlayer.h"
+	#include "Gamma/SamplerEngine.h"
 	#include "Gamma/Spatial.h"
 	#include "Gamma/Recorder.h"
+	#include "Gamma/Resample.h"
 	#include "Gamma/SoundFile.h"
+	#include "Gamma/TableCache.h"
 	#include "Gamma/UnitMaps.h"
+	#include "Gamma/Wavetable.h"
 
 	// Composite Objects
 	#include "Gamma/Analysis.h"
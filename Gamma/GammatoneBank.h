@@ -0,0 +1,93 @@
+#ifndef GAMMA_GAMMATONEBANK_H_INC
+#define GAMMA_GAMMATONEBANK_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Gammatone auditory filterbank
+*/
+
+#include <vector>
+#include "Gamma/Domain.h"
+
+namespace gam{
+
+/// Gammatone auditory filterbank
+
+/// Each band is a cascade of complex one-pole sections at its center
+/// frequency, the complex form of Reson, whose impulse response approximates
+/// a gammatone of the order of the cascade. Bandwidths follow the equivalent
+/// rectangular bandwidth (ERB) of the ear, 1.019 ERB per band, and bands are
+/// by default spaced evenly in ERB rate. The output of a band is the real
+/// part of its complex output, and its envelope the magnitude, both with
+/// unity gain at the center frequency.
+///
+/// All bands filter the same input, so the bank steps eight bands at a time
+/// in SIMD registers, as FormantBank. Envelopes can be output averaged over
+/// a number of samples, e.g. for a cochleagram, in which case the bands'
+/// filtered outputs can be skipped.
+///
+/// \ingroup Filter
+class GammatoneBank : public DomainObserver{
+public:
+
+	enum{ MAX_ORDER = 8 };	///< Maximum order of bands
+
+	/// \param[in] bands	number of bands
+	/// \param[in] lo		center frequency of lowest band
+	/// \param[in] hi		center frequency of highest band
+	/// \param[in] order	order of bands, in [1, MAX_ORDER]
+	GammatoneBank(unsigned bands=64, float lo=50, float hi=8000, unsigned order=4);
+
+
+	/// Set bands spaced evenly in ERB rate; allocates memory and resets
+	GammatoneBank& bands(unsigned n, float lo, float hi);
+
+	/// Set center frequency of a band
+	GammatoneBank& freq(unsigned band, float frq);
+
+	/// Set order of bands; resets
+	GammatoneBank& order(unsigned n);
+
+	/// Set number of samples averaged per envelope value
+	GammatoneBank& decimation(unsigned n);
+
+	unsigned bands() const { return unsigned(mFreqs.size()); }	///< Get number of bands
+	float freq(unsigned band) const { return mFreqs[band]; }	///< Get center frequency of a band
+	unsigned order() const { return mOrder; }					///< Get order of bands
+	unsigned decimation() const { return mDecim; }				///< Get samples per envelope value
+
+	/// Get equivalent rectangular bandwidth of the ear at a frequency, in Hz
+	static float erb(float frq){ return 24.7f * (4.37e-3f*frq + 1.f); }
+
+
+	/// Filter a block of input through all bands
+
+	/// \param[out] dst	output buffer of each band or NULL for none
+	/// \param[in]  src	input samples
+	/// \param[in]  n	number of samples
+	/// \param[out] env	envelope buffer of each band or NULL for none
+	/// \returns number of envelope values written per band
+	unsigned process(float * const * dst, const float * src, unsigned n, float * const * env=NULL);
+
+	/// Zero filter states and envelope averages
+	void reset();
+
+	void onDomainChange(double r);
+
+private:
+	enum{ BLOCK = 64, LANES = 8, COEFS = 3*LANES };
+	std::vector<float> mFreqs;
+	unsigned mOrder, mDecim, mEnvCount;
+	std::vector<float> mCoef;		// per group, pole real, pole imag, gain by lane
+	std::vector<float> mState;		// per group, by section, real then imag by lane
+	std::vector<float> mEnvSum;		// per group, by lane
+	float mY[BLOCK*LANES], mE[BLOCK*LANES];	// sample major
+
+	void design(unsigned band);
+};
+
+} // gam::
+
+#endif
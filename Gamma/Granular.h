@@ -0,0 +1,111 @@
+#ifndef GAMMA_GRANULAR_H_INC
+#define GAMMA_GRANULAR_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Granular synthesis of many grains over a shared sample buffer
+*/
+
+#include <vector>
+#include "Gamma/Domain.h"
+#include "Gamma/tbl.h"
+
+namespace gam{
+
+/// Cloud of grains read from a shared sample buffer
+
+/// Grains are windowed, resampled and panned excerpts of one source buffer.
+/// Each grain is a record of a few numbers held in arrays that are shared by
+/// the cloud, as are the source and one window table, so thousands of grains
+/// can play at once without allocating or constructing objects. Grains are
+/// rendered one after another over the whole block in SIMD batches (AVX2 or
+/// AVX-512 gathers when available, see simdPath()) and are removed once their
+/// window ends.
+///
+/// A grain may start at any sample of a block by passing its offset in
+/// samples from the start of the next rendered block. Source samples are
+/// linearly interpolated and the window is looked up without interpolation.
+///
+/// \ingroup Oscillator
+class GrainCloud : public DomainObserver{
+public:
+
+	/// \param[in] maxGrains	maximum number of grains playing at once
+	/// \param[in] winType		window applied to grains
+	/// \param[in] winSize		size of window table
+	GrainCloud(unsigned maxGrains=16384, WindowType winType=HANN, unsigned winSize=2048);
+
+
+	/// Set source samples
+
+	/// The buffer is not copied and must outlive the grains reading it.
+	/// Grains playing are stopped.
+	///
+	/// \param[in] src		source samples
+	/// \param[in] frames	number of source samples
+	/// \param[in] fps		sampling rate of source; if 0, that of the domain
+	GrainCloud& source(const float * src, unsigned frames, double fps=0);
+
+	/// Set window applied to grains
+	GrainCloud& window(WindowType type);
+
+	/// Set maximum number of grains; allocates memory and stops all grains
+	GrainCloud& maxGrains(unsigned n);
+
+
+	/// Start a grain
+
+	/// Grains are shortened so that they do not read outside the source.
+	///
+	/// \param[in] pos		start position in source, in samples
+	/// \param[in] dur		duration, in domain units
+	/// \param[in] rate		playback rate; negative rates read backwards
+	/// \param[in] amp		amplitude
+	/// \param[in] pan		stereo position, in [-1, 1]
+	/// \param[in] offset	onset, in samples from start of next block rendered
+	/// \returns false if the maximum number of grains are playing or the
+	/// grain would be empty
+	bool grain(float pos, float dur, float rate=1, float amp=1, float pan=0, unsigned offset=0);
+
+	/// Stop all grains
+	void reset(){ mCount = 0; }
+
+
+	/// Add a block of all grains to stereo outputs
+
+	/// \param[in,out] outL	left output samples
+	/// \param[in,out] outR	right output samples
+	/// \param[in]     n	number of samples
+	void render(float * outL, float * outR, unsigned n);
+
+	/// Get number of grains playing or waiting to start
+	unsigned size() const { return mCount; }
+
+	/// Get maximum number of grains
+	unsigned maxGrains() const { return unsigned(mLeft.size()); }
+
+private:
+	const float * mSrc;
+	unsigned mFrames;
+	double mSrcFPS;
+	std::vector<float> mWin;		// window with guard point
+	unsigned mCount;
+
+	// Grain records
+	std::vector<int> mBase;			// source index read position is relative to
+	std::vector<float> mPos;		// read position relative to base, >= 0
+	std::vector<float> mRate;		// read increment
+	std::vector<float> mPhase;		// window table position
+	std::vector<float> mPhaseInc;	// window table increment
+	std::vector<float> mGainL, mGainR;
+	std::vector<unsigned> mLeft;	// samples left to play
+	std::vector<unsigned> mOffset;	// samples until start, from start of next block
+
+	void remove(unsigned i);
+};
+
+} // gam::
+
+#endif
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <algorithm>
+#include <vector>
 #include "Gamma/Filter.h"
 #include "Gamma/Noise.h"
 #include "Gamma/Spatial.h"
@@ -15,6 +16,39 @@ float headShadow(const Vec3& earDir, const Vec3& srcDir){
 	return earDir.dot(srcDir)*0.25+0.75;
 }
 
+/// Table of ear filter coefficients over directions
+
+/// This holds the coefficients of the direction-dependent ear filters of
+/// HRFilter, designed once on a grid of azimuths and elevations, so that
+/// moving a source only takes a lookup of the nearest direction instead of
+/// designing four biquads per ear. One table can be shared by any number of
+/// filters running at the sampling rate it was made for.
+class HRTable{
+public:
+
+	/// \param[in] azimuths		number of azimuths, evenly spaced around the head
+	/// \param[in] elevations	number of elevations, from below to above the head
+	/// \param[in] ups			sampling interval the filters are designed for
+	HRTable(unsigned azimuths=72, unsigned elevations=37, double ups=1./44100);
+
+	/// Get coefficients nearest a direction
+
+	/// \param[in] right	component of unit direction along head's right vector
+	/// \param[in] up		component of unit direction along head's up vector
+	/// \param[in] back		component of unit direction along head's back vector
+	/// \returns 5 coefficients of each of the four sections, as Biquad::coefs
+	const float * coefs(float right, float up, float back) const;
+
+	unsigned azimuths() const { return mAz; }		///< Get number of azimuths
+	unsigned elevations() const { return mEl; }		///< Get number of elevations
+
+private:
+	std::vector<float> mCoefs;	// cells by elevation, then azimuth
+	unsigned mAz, mEl;
+};
+
+
+
 /// Head-related filter
 
 /// This is a parametric HRTF based largely on:
@@ -27,16 +61,34 @@ float headShadow(const Vec3& earDir, const Vec3& srcDir){
 /// Applied Acoustics, 129, 239-247.
 ///
 /// Default distances are assumed to be in meters.
+///
+/// By default, setting the position redesigns the filters at once. With a
+/// control period, positions are taken at most once per period and the
+/// filter coefficients, delays and gains glide to their new values over the
+/// period, so a source can be moved every block of a head tracker without
+/// designing filters per block or zipper noise.
 class HRFilter{
 public:
 
-	HRFilter(){}
+	HRFilter(){ for(int i=0; i<16; ++i) mPose[i] = i%5 ? 0.f : 1.f; }
 
 	Dist<3>& dist(){ return mDist; }
 
 	/// Set ear distance (measured from center of head)
 	HRFilter& earDist(float v){ mEarDist = v; return *this; }
 
+	/// Set control period, in samples
+
+	/// \param[in] n	number of samples between updates of the position;
+	///					0 updates at every call of pos()
+	HRFilter& controlPeriod(unsigned n){ mPeriod = n; mCount = 0; return *this; }
+
+	/// Get control period, in samples
+	unsigned controlPeriod() const { return mPeriod; }
+
+	/// Set table of ear filter coefficients to look up; NULL designs filters
+	HRFilter& table(const HRTable * v){ mTable = v; return *this; }
+
 	/// Set position of source
 
 	/// @param[in] sourcePos	Position of sound source
@@ -45,86 +97,41 @@ public:
 	///							with column-major layout.
 	template <class Vec3, class Mat4>
 	HRFilter& pos(const Vec3& sourcePos, const Mat4& headPose){
-		Vec3 Ur(headPose[ 0], headPose[ 1], headPose[ 2]);
-		Vec3 Uu(headPose[ 4], headPose[ 5], headPose[ 6]);
-		Vec3 Ub(headPose[ 8], headPose[ 9], headPose[10]); // pose stores back vector since right-handed
-		
-		//auto earR = Ur*mEarDist;
-		//auto headToSrc = sourcePos - Vec3(headPose[12], headPose[13], headPose[14]);
-		//const auto& S = headToSrc;
-
-		mDist.near(mEarDist);
-		//mDist.dist(0, (S + earR).mag()); // left channel
-		//mDist.dist(1, (S - earR).mag()); // right channel
-		mDist.dist(2, mRoomSize); // diameter of room
-
-		for(int i=0; i<2; ++i){
-			auto& e = mEarFilters[i];
-			auto earVec = Ur*(i==0?-mEarDist:mEarDist);
-			auto earToSource = sourcePos - (Vec3(headPose[12], headPose[13], headPose[14]) + earVec);
-			auto dist = earToSource.mag() + 1e-8;
-			mDist.dist(i, dist);
-			auto Su = earToSource / dist; // ear to source direction vector
-
-			float rightness = Su.dot(Ur); // how much source is to right of ear, in [-1,1]
-			float pinnaStrength = std::abs(rightness)*0.5+0.5;
-
-			//float hsLvl = Su.dot(Ub)*-0.15 + 0.85; // [0.7, 1] -> [back,front]
-			float hsLvl = Su.dot(Ub)*-0.25 + 0.75; // [0.5, 1] -> [back,front]
-			e.backShelf.level(hsLvl);
-	
-			// Pinna filtering
-			auto elVec = Su - (Ur*rightness); // projection of source dir onto up-back plane
-			elVec.normalize();
-			float srcUp = Uu.dot(elVec); // how much source is up, [-1,1], sine of elevation angle
-			float pinnaFrq1 = srcUp*2000. + 8000.; // [6k, 10k] -> [front, above]
-			//float pinnaFrq1 = std::max(srcUp, 0.f)*4000. + 6000.;
-			// Notch weak above, and strong in front (-10 dB / 0.3)
-			// Following a half-period raised cosine
-			float pinnaLvl1 = srcUp*srcUp*0.7+0.3; // [0.3, 1]
-			pinnaLvl1 = (pinnaLvl1-1.)*pinnaStrength + 1.;
-			e.pinnaNotch1.set(pinnaFrq1, 24./1., gam::PEAKING);
-			e.pinnaNotch1.level(pinnaLvl1);
-
-			float srcB = Ub.dot(elVec);
-			float pinnaFrq2 = srcB*1000. + 10000.; // [9k, 11k] -> [front, above, behind]
-			// Notch weak above, and strong in front (-10 dB / 0.3)
-			// Following a half-period raised cosine
-			float pinnaLvl2 = srcUp*srcUp*0.8+0.2; // [0.2, 1]
-			pinnaLvl2 = (pinnaLvl2-1.)*pinnaStrength + 1.;
-			e.pinnaNotch2.set(pinnaFrq2, 48./1., gam::PEAKING);
-			e.pinnaNotch2.level(pinnaLvl2);
-
-			float above = srcUp>0. ? srcUp : 0.;
-			//e.pinnaPeak2.level(srcUp*srcUp*1.+1.);
-			e.pinnaPeak2.level(above + 1.);
-
-			e.shadow = (i==0?-rightness:rightness)*0.25+0.75;
-		}
-		
-		//mShadows[0] = headShadow(-Ur, (S + earR).normalize()); // left
-		//mShadows[1] = headShadow( Ur, (S - earR).normalize()); // right
-
-		/* Torso filtering (only useful if body orientation available!)
-		mTorsoAmt = al::abs(srcUp)*0.1;
-		mTorsoDelay = 1./1000. * mTorsoAmt/0.3;
-		//*/
-
-		//printf("front/back high-shelf level: %f\n", mBackShelf.level());
-		//printf("pinna notch 1: %.2f Hz @ %.2f\n", mPinnaNotch1.freq(), mPinnaNotch1.level());
-		//printf("pinna notch 2: %.2f Hz @ %.2f\n", mPinnaNotch2.freq(), mPinnaNotch2.level());
-		//printf("head shadow on left ear: %f\n", headShadow(-Ur, (S + earR).normalize()));
+		for(int i=0; i<3; ++i) mSrc[i] = sourcePos[i];
+		for(int i=0; i<16; ++i) mPose[i] = headPose[i];
+		if(mPeriod)	mPending = true;
+		else		update(0);
 		return *this;
 	}
 
 	/// Return spatialized sample as (left, right, room)
 	float3 operator()(float src){
+		if(mPeriod){
+			if(!mCount){
+				if(mPending){ mPending = false; update(mPeriod); }
+				mCount = mPeriod;
+			}
+			--mCount;
+		}
 		//src += mDist.delayLine().read(mTorsoDelay) * mTorsoAmt;
 		auto res = mDist(src);
 		for(int i=0;i<2;++i) res[i] = mEarFilters[i](res[i]);
 		return res;
 	}
 
+	/// Compute frequencies and levels of the ear filter sections
+
+	/// \param[out] frq		center frequencies of the four sections
+	/// \param[out] lvl		levels of the four sections
+	/// \param[in]  right	component of unit ear to source direction along
+	///						head's right vector
+	/// \param[in]  up		component along head's up vector
+	/// \param[in]  back	component along head's back vector
+	/// \param[in]  stride	distance between outputs of consecutive sections
+	static void earParams(
+		float * frq, float * lvl, float right, float up, float back, unsigned stride=1
+	);
+
 public:
 	Dist<2+1> mDist;
 
@@ -133,8 +140,10 @@ public:
 			backShelf {4000, 0.707, gam::HIGH_SHELF},
 			pinnaPeak1{4000, 1.000, gam::PEAKING}, // concha resonance
 			pinnaPeak2{8000, 4.000, gam::PEAKING}, // for above localization
-			pinnaNotch1, pinnaNotch2;
+			pinnaNotch1{8000, 24.0, gam::PEAKING},
+			pinnaNotch2{10000, 48.0, gam::PEAKING};
 		float shadow = 1.; // TODO: should be LPF
+		CoefRamp<1,float> shadowRamp;
 
 		EarFilter(){
 			pinnaPeak1.level(2); 
@@ -146,6 +155,7 @@ public:
 			s = pinnaNotch2(s);
 			//s = pinnaPeak1(s); // not convinced this helps
 			s = pinnaPeak2(s);
+			shadowRamp.step(shadow);
 			return s * shadow;
 		}
 	};
@@ -155,6 +165,16 @@ public:
 	float mTorsoAmt=0., mTorsoDelay=0.;
 	float mEarDist = 0.07; // about half the average bitragion breadth
 	float mRoomSize = 3;
+
+private:
+	float mSrc[3] = {0,0,0};	// source position
+	float mPose[16];			// head pose
+	const HRTable * mTable = NULL;
+	unsigned mPeriod = 0, mCount = 0;
+	bool mPending = false;
+
+	// Set filters from position, gliding over n samples
+	void update(unsigned n);
 };
 
 
@@ -217,6 +237,113 @@ private:
 	NoiseBinary<RNGMulLinCon> mNoise{1e-20, 17};
 };
 
+
+/// Scene with a runtime number of sources, rendered in blocks
+
+/// This spatializes sources with the same model as HRFilter and HRScene, but
+/// for scenes with many (e.g., hundreds of) moving sources. The source
+/// parameters are kept as arrays, one element per source, and all sources are
+/// updated in one batch when rendering the next block after a change. The
+/// delays of all sources are stored in one shared buffer, and the ear
+/// filters of all sources run together, one ear channel per SIMD lane, over
+/// blocks of samples.
+///
+/// Distances are in meters and source inputs get the same inaudible noise as
+/// HRScene to keep the filters from producing denormals.
+class HRBatchScene : public DomainObserver{
+public:
+
+	/// \param[in] numSources	number of sources
+	/// \param[in] maxDelay		maximum delay from a source to an ear, in seconds
+	HRBatchScene(unsigned numSources=0, float maxDelay=0.2);
+
+
+	/// Set number of sources; positions of new sources are at the origin
+	HRBatchScene& numSources(unsigned n);
+
+	/// Get number of sources
+	unsigned numSources() const { return mNumSrc; }
+
+	/// Set position of a source
+	HRBatchScene& pos(unsigned i, float x, float y, float z);
+
+	/// Set positions of sources from arrays of coordinates
+	HRBatchScene& pos(const float * x, const float * y, const float * z);
+
+	/// Set head pose
+
+	/// \param[in] m	4x4 matrix, right-handed and indexable with
+	///					column-major layout
+	template <class Mat4>
+	HRBatchScene& headPose(const Mat4& m){
+		for(int i=0; i<16; ++i) mPose[i] = m[i];
+		mDirty = true;
+		return *this;
+	}
+
+	/// Set ear distance (measured from center of head)
+	HRBatchScene& earDist(float v){ mEarDist=v; mDirty=true; return *this; }
+
+	/// Set far clipping distance
+	HRBatchScene& far(float v){ mFar=v; mDirty=true; return *this; }
+
+	/// Set decay of room reverberation
+	HRBatchScene& reverbDecay(float v){ for(auto& r:mReverbs) r.decay(v); return *this; }
+	/// Set damping of room reverberation
+	HRBatchScene& reverbDamping(float v){ for(auto& r:mReverbs) r.damping(v); return *this; }
+	/// Set attenuation of wall reflections
+	HRBatchScene& wallAtten(float v){ mWallAtten=v; return *this; }
+
+	/// Compute filters of all sources from their positions
+
+	/// This is called by process() after any change.
+	void update();
+
+	/// Render a block
+
+	/// \param[in]  src		input buffer of each source
+	/// \param[out] outL	left output
+	/// \param[out] outR	right output
+	/// \param[in]  n		number of samples
+	void process(const float * const * src, float * outL, float * outR, unsigned n);
+
+	/// Get distance from a source to an ear (0 = left, 1 = right)
+	float dist(unsigned i, unsigned ear) const { return mDist[ear*mPad + i]; }
+
+	void onDomainChange(double r){ mDirty = true; }
+
+private:
+	enum{ BLOCK = 32, SECTIONS = 4, ROW_PAD = 16 };	// pad rows to avoid cache set conflicts
+
+	unsigned mNumSrc, mPad;		// sources, sources rounded up to 8
+	float mMaxDelay;
+	std::vector<float> mX, mY, mZ;	// source positions
+	float mPose[16];
+	float mEarDist = 0.07, mFar = 0.5, mNear = 0.07, mRoomSize = 3;
+	float mWallAtten = 0.1;
+	bool mDirty = true;
+
+	// Ear channels are left ears of all sources, then right ears
+	std::vector<float> mDist, mDelay;		// distance, delay in samples
+	std::vector<float> mLPA0, mLPB1, mLP;	// distance low-pass
+	std::vector<float> mCoef;				// biquad coefs by section, coef, then channel
+	std::vector<float> mState;				// biquad states by section, state, then channel
+	std::vector<float> mFrames;				// block of frames of channels
+	std::vector<float> mParams;				// filter parameters of channels for update
+
+	// Delay lines of sources, then of sum of sources for room
+	std::vector<float> mArena;
+	unsigned mMask, mPos;
+
+	float mRoomDelay, mRoomAmp, mRoomA0, mRoomB1, mRoomLP;
+
+	ReverbMS<> mReverbs[2];
+	NoiseBinary<RNGMulLinCon> mNoise{1e-20, 17};
+
+	float inverse(float dist) const;
+	void render(const float * const * src, unsigned off, float * outL, float * outR, unsigned n);
+};
+
 } // gam::
 
 #endif
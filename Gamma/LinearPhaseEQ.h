@@ -0,0 +1,130 @@
+#ifndef GAMMA_LINEAR_PHASE_EQ_H_INC
+#define GAMMA_LINEAR_PHASE_EQ_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Multichannel linear-phase equalizer applied by FFT convolution
+*/
+
+#include <atomic>
+#include <vector>
+#include "Gamma/Containers.h"
+#include "Gamma/Convolver.h"
+#include "Gamma/Domain.h"
+#include "Gamma/FFT.h"
+#include "Gamma/Filter.h"
+#include "Gamma/Thread.h"
+
+namespace gam{
+
+/// Multichannel linear-phase equalizer
+
+/// Bands take the same parameters as Biquad, typically PEAKING, LOW_SHELF
+/// and HIGH_SHELF types, and the equalizer has the magnitude response of
+/// the cascade of those biquads, but no phase distortion. The response is
+/// sampled, made zero-phase, delayed by half the kernel size and windowed
+/// into a symmetric FIR kernel, which all channels apply with a uniformly
+/// partitioned Convolver sharing its partition spectra. The delay is
+/// latency() samples; the kernel size sets the frequency resolution, about
+/// 2 / kernelSize of the sampling rate.
+///
+/// Band changes are queued without locking, so they may be made from any
+/// thread, including the audio thread. A background thread collects them,
+/// designs the new kernel and hands it to process(), which switches to it at
+/// a block boundary. Without a background thread, process() designs the
+/// kernel itself when bands have changed, which suits offline rendering.
+///
+/// \ingroup Filter
+class LinearPhaseEQ : public DomainObserver{
+public:
+
+	enum{ MAX_BANDS = 16 };
+
+	/// \param[in] channels		number of channels
+	/// \param[in] blockSize	number of samples per processing block
+	/// \param[in] kernelSize	size of FIR kernel, a power of two
+	/// \param[in] background	whether to design kernels on a background thread
+	LinearPhaseEQ(unsigned channels=0, unsigned blockSize=0, unsigned kernelSize=4096, bool background=true);
+
+	~LinearPhaseEQ();
+
+
+	/// Set sizes; allocates memory, keeps bands and resets input history
+
+	/// \see LinearPhaseEQ()
+	///
+	void resize(unsigned channels, unsigned blockSize, unsigned kernelSize=4096, bool background=true);
+
+	/// Set a band
+
+	/// \param[in] k		band index, less than MAX_BANDS
+	/// \param[in] type		filter type, as Biquad
+	/// \param[in] frq		center frequency
+	/// \param[in] res		resonance (Q)
+	/// \param[in] level	level (PEAKING, LOW_SHELF, HIGH_SHELF types only)
+	/// \returns false if the band index is invalid or the change queue is full
+	bool band(unsigned k, FilterType type, float frq, float res=0.707f, float level=1.f);
+
+	/// Remove a band
+	bool removeBand(unsigned k);
+
+	/// Filter one block of all channels
+
+	/// \param[out] dst	output blocks of blockSize() samples for each channel
+	/// \param[in]  src	input blocks of blockSize() samples for each channel;
+	///					may equal dst
+	void process(float * const * dst, const float * const * src);
+
+	/// Clear input history
+	void reset();
+
+
+	unsigned channels() const { return unsigned(mChans.size()); }	///< Get number of channels
+	unsigned blockSize() const { return mBlockSize; }		///< Get number of samples per block
+	unsigned kernelSize() const { return mKernelSize; }		///< Get size of FIR kernel
+	unsigned latency() const { return mKernelSize/2; }		///< Get delay, in samples
+
+	/// Get number of kernels designed and switched to
+	unsigned designs() const { return mApplied.load(std::memory_order_acquire); }
+
+	/// Get whether band changes are not yet applied
+	bool pending() const;
+
+	/// Get kernel in use, kernelSize() samples
+	const float * kernel() const { return &mKernel[mApplied.load(std::memory_order_acquire) & 1][0]; }
+
+	void onDomainChange(double r);
+
+private:
+	struct Band{
+		FilterType type;
+		float frq, res, level;
+		unsigned index;
+		bool on;
+	};
+
+	std::vector<Convolver> mChans;
+	Convolver mKernels[2];			// spectra of kernels, shared by channels
+	std::vector<float> mKernel[2];
+	unsigned mBlockSize, mKernelSize;
+	std::atomic<unsigned> mDesigned, mApplied;	// kernels designed and switched to
+	MPSCQueue<Band> mChanges;
+	Band mBands[MAX_BANDS];			// owned by designer
+	std::atomic<double> mUps;
+	std::atomic<bool> mRedesign;	// rate changed
+	RFFT<float> mFFT;
+	std::vector<float> mBuf, mWin;
+	Thread mThread;
+	std::atomic<bool> mRunning;
+
+	bool collect();
+	void design(unsigned slot);
+	void stopThread();
+	static void * cDesignFunc(void * user);
+};
+
+} // gam::
+
+#endif
@@ -0,0 +1,171 @@
+#ifndef GAMMA_MDCT_H_INC
+#define GAMMA_MDCT_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Critically sampled cosine transforms computed with shared FFT plans
+*/
+
+#include <vector>
+#include "Gamma/FFT.h"
+
+namespace gam{
+
+
+/// Discrete cosine transform (DCT-II and its inverse, DCT-III)
+
+/// The forward transform of N samples is
+/// \code
+///	X[k] = sum_n x[n] cos(pi/N (n + 1/2) k),	k = 0, ..., N-1
+/// \endcode
+/// and the inverse is the scaled DCT-III that recovers x exactly. Both are
+/// computed with a real FFT of size N, whose plan is shared with all other
+/// transforms of that size, plus one pass of twiddle multiplications.
+/// Sizes must be even; powers of two are fastest.
+///
+/// \ingroup Spectral
+template <class T=float>
+class DCT{
+public:
+
+	/// \param[in] size		number of samples, an even number
+	DCT(unsigned size=0);
+
+
+	/// Perform forward transform (DCT-II) in-place
+	void forward(T * buf);
+
+	/// Perform inverse transform (scaled DCT-III) in-place
+	void inverse(T * buf);
+
+	/// Set number of samples; allocates memory
+	void resize(unsigned size);
+
+	/// Get number of samples
+	unsigned size() const { return mSize; }
+
+private:
+	RFFT<T> mFFT;
+	std::vector<T> mCos, mSin;	// post-twiddles, k = 0, ..., N/2
+	std::vector<T> mBuf;
+	unsigned mSize;
+};
+
+
+
+/// Modified discrete cosine transform
+
+/// The MDCT turns a frame of sizeWin() = 2M samples into M = numCoefs()
+/// coefficients,
+/// \code
+///	X[k] = sum_n w[n] x[n] cos(pi/M (n + 1/2 + M/2)(k + 1/2)),	k = 0, ..., M-1
+/// \endcode
+/// where w is the window. Frames hop by M samples, so the transform is
+/// critically sampled: a signal needs as many coefficients as samples, a
+/// fraction of an overlapping STFT's spectrum. The inverse transform is
+/// windowed by w again and overlap-added; the time-domain aliasing of
+/// consecutive frames cancels, so an unmodified signal is reconstructed
+/// exactly. This requires a window with w[n]^2 + w[n+M]^2 = 1, such as the
+/// sine and Kaiser-Bessel-derived windows provided.
+///
+/// Each transform folds the frame into M samples, multiplies by pre-twiddles,
+/// performs a complex FFT of size M/2, whose plan is shared with all other
+/// transforms of that size, and multiplies by post-twiddles. The twiddle
+/// loops run over contiguous arrays, so the compiler vectorizes them.
+///
+/// As with STFT, samples can be streamed through one at a time:
+/// \code
+///	if(mdct(in)){ ... modify mdct.coefs() ... }
+///	out = mdct();
+/// \endcode
+/// The output is the input delayed by sizeWin() samples.
+///
+/// \ingroup Spectral
+template <class T=float>
+class MDCT{
+public:
+
+	/// \param[in] numCoefs		number of coefficients, M, a multiple of 2;
+	///							powers of two are fastest
+	MDCT(unsigned numCoefs=512);
+
+
+	/// Input next time-domain sample
+
+	/// \returns whether a new frame of coefficients is available
+	///
+	bool operator()(T input);
+
+	/// Get next time-domain sample from inverse transforms
+
+	/// The inverse transform of the current coefficients is performed every
+	/// sizeHop() samples.
+	T operator()();
+
+	/// Perform forward transform of sizeWin() samples into coefs()
+
+	/// If 'src' is 0, then the transform is performed on the internal window
+	/// of the most recent input samples.
+	void forward(const T * src=0);
+
+	/// Perform inverse transform of coefs() and overlap-add
+
+	/// The sizeHop() samples completed by this frame are written into 'dst';
+	/// if 'dst' is 0, they are held in the internal output buffer.
+	void inverse(T * dst=0);
+
+	/// Perform unwindowed inverse transform of coefs() into sizeWin() samples
+
+	/// The result contains the time-domain aliasing that overlap-add
+	/// cancels, scaled so that overlap-adding windowed frames reconstructs
+	/// the signal.
+	void inverseFrame(T * dst);
+
+
+	/// Set number of coefficients; allocates memory and clears history
+	void resize(unsigned numCoefs);
+
+	/// Use sine window (the default)
+	MDCT& windowSine();
+
+	/// Use Kaiser-Bessel-derived window
+
+	/// \param[in] alpha	Kaiser parameter; larger values attenuate more
+	///						away from the main lobe, but widen it
+	MDCT& windowKBD(double alpha=4.);
+
+	/// Clear coefficients and input and overlap-add history
+	void reset();
+
+
+	T * coefs(){ return &mCoefs[0]; }				///< Get coefficients
+	const T * coefs() const { return &mCoefs[0]; }	///< Get coefficients
+	const T * window() const { return &mWin[0]; }	///< Get window of sizeWin() samples
+
+	unsigned numCoefs() const { return mM; }		///< Get number of coefficients
+	unsigned sizeHop() const { return mM; }			///< Get number of samples between frames
+	unsigned sizeWin() const { return 2*mM; }		///< Get number of samples in frame
+
+private:
+	CFFT<T> mFFT;
+	std::vector<T> mWin;				// analysis/synthesis window, 2M
+	std::vector<T> mPreCos, mPreSin;	// pre-twiddles, M/2
+	std::vector<T> mPostCos, mPostSin;	// post-twiddles, M/2
+	std::vector<T> mCoefs;				// M
+	std::vector<T> mIn;					// input window, 2M, oldest first
+	std::vector<T> mFrame;				// time-domain frame, 2M
+	std::vector<T> mOLA;				// overlap-add tail, M
+	std::vector<T> mOut;				// completed output samples, M
+	std::vector<T> mRe, mIm;			// split folded samples, M/2
+	std::vector<T> mCpx;				// interleaved FFT buffer, M
+	unsigned mM;
+	unsigned mTapIn, mTapOut;
+
+	void dct4(const T * src, T * dst, T scale);
+};
+
+} // gam::
+
+#endif
@@ -41,6 +41,11 @@ public:
 
 
 /// Triply-linked node
+
+/// Each node also links back to its left sibling, with the first child
+/// linking back to the last, so that adding and removing nodes, along with
+/// their descendents, takes constant time regardless of the number of
+/// siblings. Traversals are iterative.
 template <class T>
 class Node3{
 public:
@@ -48,9 +53,10 @@ public:
 	T * parent;		///< Parent node
 	T * child;		///< Child node
 	T * sibling;	///< Right sibling
+	T * prev;		///< Left sibling or, if first child, last sibling
 
 	Node3()
-	:	parent(0), child(0), sibling(0)
+	:	parent(0), child(0), sibling(0), prev(0)
 	{}
 	
 //	const T * parent() const { return mParent; }
@@ -61,62 +67,57 @@ public:
 //	T * child(){ return mChild; }
 //	T * sibling(){ return mSibling; }
 
-	/// Add node as my first child
+	/// Add node, with its descendents, as my first child
 	void addFirstChild(T * newChild){
 		newChild->removeFromParent();
 		newChild->parent = self();
 		newChild->sibling = child;
+		if(child){
+			newChild->prev = child->prev;
+			child->prev = newChild;
+		}
+		else{
+			newChild->prev = newChild;
+		}
 		child = newChild;
 	}
 
-	/// Add node as my last child
+	/// Add node, with its descendents, as my last child
 	void addLastChild(T * newChild){
 		newChild->removeFromParent();
 		newChild->parent = self();
 		if(!child){	// No children, so make first child
 			child = newChild;
+			newChild->prev = newChild;
 		}
 		else{		// Have children, so add to end of children
-			lastChild()->sibling = newChild;
+			T * last = child->prev;
+			last->sibling = newChild;
+			newChild->prev = last;
+			child->prev = newChild;
 		}
 	}
 	
 	/// Remove self from parent leaving my own descendent tree intact
 	void removeFromParent(){
-
-		if(parent && parent->child){
-
-			// re-patch parent's child?
-			if(parent->child == self()){
-				// I'm my parent's first child 
-				// - remove my reference, but keep the sibling list healthy
+		if(parent){
+			T * first = parent->child;
+			if(first == self()){
+				// I'm my parent's first child; my prev is the last child
 				parent->child = sibling;
+				if(sibling) sibling->prev = prev;
 			}
-			
-			// re-patch the sibling chain?
 			else{
-				// I must be one of parent->child's siblings
-				T * temp = parent->child;
-				while(temp->sibling){
-					if(temp->sibling == self()) {
-						// I'm temp's sibling
-						// - remove my reference, keep the sibling list healthy
-						temp->sibling = this->sibling; 
-						break; 
-					}
-					temp = temp->sibling;
-				}
+				prev->sibling = sibling;
+				if(sibling)	sibling->prev = prev;
+				else		first->prev = prev; // I was the last child
 			}
-			
-			parent=0; sibling=0; // no more parent or sibling, but child is still valid
+			parent=0; sibling=0; prev=0; // child is still valid
 		}
 	}
 
-	T * lastChild(){
-		T * n = child;
-		while(n->sibling) n = n->sibling;
-		return n;
-	}
+	/// Returns last child or 0 if none
+	T * lastChild(){ return child ? child->prev : 0; }
 
 	/// Returns next node using depth-first traversal
 	
@@ -4,6 +4,7 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include "Gamma/Containers.h"
 #include "Gamma/rnd.h"
 #include "Gamma/scl.h"
 
@@ -39,6 +40,20 @@ public:
 		val = scl::clip(val + rnd::uniS_float(rng) * step, max, min);
 		return val;
 	}
+
+	/// Generate a block of values, as operator()() on each sample
+	void operator()(float * dst, unsigned n){
+		uint32_t u[64];
+		for(unsigned i=0; i<n; i+=64){
+			const unsigned m = n-i < 64 ? n-i : 64;
+			rnd::uints(rng, u, m);
+			float v = val;
+			for(unsigned j=0; j<m; ++j){
+				dst[i+j] = v = scl::clip(v + uintToUnitS<float>(u[j]) * step, max, min);
+			}
+			val = v;
+		}
+	}
 	
 	/// Set seed value of RNG
 	void seed(uint32_t v){ rng = v; }
@@ -67,6 +82,12 @@ public:
 	
 	/// Generate next value
 	float operator()();
+
+	/// Generate a block of values, as operator()() on each sample
+
+	/// The random numbers of each run of samples are generated at once, and
+	/// the octaves are summed over the run (Voss-McCartney).
+	void operator()(float * dst, unsigned n);
 	
 	/// Set seed of RNG
 	void seed(uint32_t v){ rng = v; }
@@ -98,6 +119,16 @@ public:
 	/// Generate next value
 	float operator()(){ return rnd::uniS_float(rng); }
 
+	/// Generate a block of values, as operator()() on each sample
+	void operator()(float * dst, unsigned n){
+		uint32_t u[64];
+		for(unsigned i=0; i<n; i+=64){
+			const unsigned m = n-i < 64 ? n-i : 64;
+			rnd::uints(rng, u, m);
+			for(unsigned j=0; j<m; ++j) dst[i+j] = uintToUnitS<float>(u[j]);
+		}
+	}
+
 	/// Set seed of RNG
 	void seed(uint32_t v){ rng = v; }
 	
@@ -130,6 +161,20 @@ public:
 		return diff;
 	}
 
+	/// Generate a block of values, as operator()() on each sample
+	void operator()(float * dst, unsigned n){
+		uint32_t u[64];
+		float curr[65];
+		for(unsigned i=0; i<n; i+=64){
+			const unsigned m = n-i < 64 ? n-i : 64;
+			rnd::uints(rng, u, m);
+			curr[0] = mPrev;
+			for(unsigned j=0; j<m; ++j) curr[j+1] = punUF(Expo1<float>() | (u[j]>>9));
+			for(unsigned j=0; j<m; ++j) dst[i+j] = curr[j+1] - curr[j];
+			mPrev = curr[m];
+		}
+	}
+
 	/// Set seed of RNG
 	void seed(uint32_t v){ rng = v; mPrev = 1.5f; }
 	
@@ -161,6 +206,17 @@ public:
 		return punUF((rng()&0x80000000) ^ punFU(amp));
 	}
 
+	/// Generate a block of values, as operator()() on each sample
+	void operator()(float * dst, unsigned n){
+		uint32_t u[64];
+		const uint32_t a = punFU(amp);
+		for(unsigned i=0; i<n; i+=64){
+			const unsigned m = n-i < 64 ? n-i : 64;
+			rnd::uints(rng, u, m);
+			for(unsigned j=0; j<m; ++j) dst[i+j] = punUF((u[j]&0x80000000) ^ a);
+		}
+	}
+
 	/// Set seed of RNG
 	void seed(uint32_t v){ rng = v; }
 
@@ -169,6 +225,95 @@ public:
 };
 
 
+/// Noise played from a table shared between objects
+
+/// This loops a long table of noise, played from a random offset at some
+/// rate, so that each sample costs a single table read rather than random
+/// numbers and filtering. The table is made once per color, size and seed
+/// by shaping the spectrum of random phases with an inverse real FFT, so
+/// that it is band-limited, has an exact spectral slope and loops without
+/// a seam. Tables are kept in TableCache<float>::get() and shared by all
+/// objects asking for the same one.
+/// \ingroup Noise
+class NoiseTable{
+public:
+	typedef float value_type;
+
+	/// Spectrum of table
+	enum Color{
+		WHITE,		/**< Flat power spectrum */
+		PINK,		/**< Power spectrum of 1/f */
+		BROWN,		/**< Power spectrum of 1/f^2 */
+		VIOLET		/**< Power spectrum of f^2 */
+	};
+
+	/// \param[in] color	spectrum of table
+	/// \param[in] size		number of table elements; must be a power of two
+	/// \param[in] seed		seed of table; objects with the same seed share it
+	NoiseTable(Color color=PINK, unsigned size=1<<18, uint32_t seed=1);
+
+
+	/// Set playback rate, in table elements per sample
+
+	/// Negative rates play the table backwards. Rates are clipped to
+	/// within half the table size, beyond which the increment would wrap.
+	NoiseTable& rate(float v){
+		const double lim = 2147483647.;
+		const double inc = scl::clip(double(v) * mTable.oneIndex(), lim, -lim);
+		mInc = uint32_t(int32_t(inc));
+		return *this;
+	}
+
+	/// Set position within table, in [0, 1)
+	NoiseTable& offset(float v){ mPhase = uint32_t(scl::wrap(v) * 4294967296.); return *this; }
+
+	/// Jump to a random offset and set a random rate
+
+	/// \param[in] rng		random number generator
+	/// \param[in] spread	maximum deviation of rate from 1
+	template <class RNG>
+	NoiseTable& randomize(RNG& rng, float spread=0){
+		mPhase = rng();
+		return rate(1.f + rnd::uniS_float(rng) * spread);
+	}
+
+	/// Get shared table
+	const ArrayPow2<float>& table() const { return mTable; }
+
+
+	/// Generate next value
+	float operator()(){
+		const float v = mTable.atPhase(mPhase);
+		mPhase += mInc;
+		return v;
+	}
+
+	/// Generate a block of values
+	void operator()(float * dst, unsigned n){
+		const float * t = mTable.elems();
+		const uint32_t shift = mTable.fracBits(), inc = mInc;
+		uint32_t phs = mPhase;
+		for(unsigned i=0; i<n; ++i){
+			dst[i] = t[phs >> shift];
+			phs += inc;
+		}
+		mPhase = phs;
+	}
+
+	/// Fill a table with noise shaped in frequency
+
+	/// \param[out] dst		table
+	/// \param[in]  len		size of table; must be even
+	/// \param[in]  params	exponent of power spectrum and seed
+	static void generate(float * dst, unsigned len, const double * params);
+
+private:
+	ArrayPow2<float> mTable;
+	uint32_t mPhase, mInc;
+};
+
+
+
 // Implementation_______________________________________________________________
 
 template<class T>
@@ -207,6 +352,33 @@ inline float NoisePink<T>::operator()(){
 	return (mRunningSum + rnd::uniS_float(rng)) * 0.083333333f;
 }
 
+template<class T>
+void NoisePink<T>::operator()(float * dst, unsigned n){
+	uint32_t u[128]; // an octave and a white random per sample
+	for(unsigned i=0; i<n;){
+		// Runs end before the sample wrapping the phasor, which adds no octave
+		unsigned m = n-i < 64 ? n-i : 64;
+		const unsigned toWrap = 2047 - mPhase;
+		if(toWrap < m) m = toWrap;
+		if(0 == m){
+			dst[i++] = (*this)();
+			continue;
+		}
+
+		rnd::uints(rng, u, 2*m);
+		float sum = mRunningSum;
+		for(unsigned j=0; j<m; ++j){
+			const uint32_t k = scl::trailingZeroes(++mPhase);
+			const float r = uintToUnitS<float>(u[2*j]);
+			sum += r - mOctave[k];
+			mOctave[k] = r;
+			dst[i+j] = (sum + uintToUnitS<float>(u[2*j+1])) * 0.083333333f;
+		}
+		mRunningSum = sum;
+		i += m;
+	}
+}
+
 
 /*
 ////////////////////////////////////////////////////////////////////////////////
@@ -4,10 +4,13 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <vector>
+#include "Gamma/arr.h"
 #include "Gamma/gen.h"
 #include "Gamma/scl.h"
 #include "Gamma/tbl.h"
 #include "Gamma/Strategy.h"
+#include "Gamma/Block.h"
 #include "Gamma/Domain.h"
 #include "Gamma/Types.h"
 
@@ -40,38 +43,88 @@ public:
 	Accum(float frq=440, float phs=0);
 
 
-	void freq(float v);				///< Set frequency
-	void freqI(uint32_t v);			///< Set fixed-point frequency
-	void freqAdd(float v);			///< Add value to frequency for 1 sample
-	void freqMul(float v);			///< Multiply frequency by value for 1 sample
-	void phase(float v);			///< Set phase from [0, 1) of one period
+	inline void freq(float v);		///< Set frequency
+	inline void freqI(uint32_t v);	///< Set fixed-point frequency
+	inline void freqAdd(float v);	///< Add value to frequency for 1 sample
+	inline void freqMul(float v);	///< Multiply frequency by value for 1 sample
+	inline void phase(float v);		///< Set phase from [0, 1) of one period
 	void phaseMax();				///< Set phase to maximum value
-	void phaseAdd(float v);			///< Add value to phase [0, 1)
-	void period(float v);			///< Set period length
+	inline void phaseAdd(float v);	///< Add value to phase [0, 1)
+	inline void period(float v);	///< Set period length
 
 	void reset(){ mPhaseI=0; mSp.reset(); }	///< Reset phase accumulator
 	void finish(){ phaseMax(); }	///< Set phase to end (maximum value)
 
 	Sp& phsInc(){ return mSp; }		///< Get phase increment strategy
 
-	bool done() const;				///< Returns true if done cycling
-	bool cycled() const;			///< Returns whether phase cycled on last iteration
+	inline bool done() const;		///< Returns true if done cycling
+	inline bool cycled() const;		///< Returns whether phase cycled on last iteration
 
-	float freq() const;				///< Get frequency
-	uint32_t freqI() const;			///< Get fixed-point frequency
-	float freqUnit() const;			///< Get frequency in [0, 1)
-	float period() const;			///< Get period
-	float phase() const;			///< Get phase in [0, 1)
-	uint32_t phaseI() const;		///< Get fixed-point phase
+	inline float freq() const;		///< Get frequency
+	inline uint32_t freqI() const;	///< Get fixed-point frequency
+	inline float freqUnit() const;	///< Get frequency in [0, 1)
+	inline float period() const;	///< Get period
+	inline float phase() const;		///< Get phase in [0, 1)
+	inline uint32_t phaseI() const;	///< Get fixed-point phase
 
 	/// Iterates accumulator; \returns true on phase wrap, false otherwise
-	bool operator()();
+	inline bool operator()();
 
-	uint32_t nextPhase();			///< Increment phase and return updated phase
-	uint32_t nextPhase(float freqOffset);
-	uint32_t cycles();				///< Get 1 to 0 transitions of all accumulator bits
-	bool cycle();
-	bool once();
+	inline uint32_t nextPhase();	///< Increment phase and return updated phase
+	inline uint32_t nextPhase(float freqOffset);
+
+	/// Increment phase over a block
+
+	/// This is equivalent to calling nextPhase() n times, but keeps the
+	/// phase in a register so the loop can be vectorized.
+	/// \param[out] dst	phases before each increment
+	/// \param[in]  n		number of samples
+	inline void nextPhases(uint32_t * dst, unsigned n);
+
+	/// Increment phase over a block with per-sample frequency offsets
+
+	/// \param[out] dst			phases before each increment
+	/// \param[in]  freqOffset	frequency offsets, one per sample
+	/// \param[in]  n			number of samples
+	inline void nextPhases(uint32_t * dst, const float * freqOffset, unsigned n);
+
+	/// Increment phase over a block and find where it cycled
+
+	/// Sample i is reported when cycle() would have returned true on its
+	/// call, i.e. its increment took the MSB of the phase from 1 to 0. The
+	/// offsets are gathered from the phases without branching, so
+	/// retriggering, syncing or scheduling can act on a few events per block
+	/// rather than test every sample.
+	/// \param[out] dst		phases before each increment
+	/// \param[in]  n		number of samples
+	/// \param[out] cycles	offsets of samples that cycled, in increasing order; must hold n
+	/// \returns number of samples that cycled
+	inline unsigned nextPhases(uint32_t * dst, unsigned n, unsigned * cycles);
+
+	/// Increment phase over a block, resetting it at sample offsets
+
+	/// This hard-syncs the accumulator, e.g. to the cycles of another one
+	/// found by nextPhases: the phase of each sample at a reset offset is 0,
+	/// as by calling phase(0) before its call to nextPhase().
+	/// \param[out] dst			phases before each increment
+	/// \param[in]  n			number of samples
+	/// \param[in]  resets		offsets of samples to reset, in increasing order
+	/// \param[in]  numResets	number of offsets
+	inline void syncPhases(uint32_t * dst, unsigned n, const unsigned * resets, unsigned numResets);
+
+	/// Increment phase n times, as n calls to nextPhase()
+	inline void skip(unsigned n);
+
+	/// Advance phase n samples, as n calls to nextPhase()
+
+	/// With the looping strategy, the phase is jumped in constant time, so
+	/// rendering can start anywhere in a long piece. Other strategies are
+	/// stepped through one sample at a time.
+	void advance(uint64_t n){ advance(mSp, n); }
+
+	inline uint32_t cycles();		///< Get 1 to 0 transitions of all accumulator bits
+	inline bool cycle();
+	inline bool once();
 
 	/// Returns sequence of 32 triggers based on a pattern of bits
 
@@ -89,7 +142,14 @@ public:
 	///		1	. . . /		5	. / . /		9	/ . . /		d	/ / . /
 	///		2	. . / .		6	. / / .		a	/ . / .		e	/ / / .
 	///		3	. . / /		7	. / / /		b	/ . / /		f	/ / / /			\endverbatim
-	bool seq(uint32_t pattern);
+	inline bool seq(uint32_t pattern);
+
+	/// Save or restore phase and frequency with a StateWriter or StateReader
+	template <class Archive>
+	void state(Archive& ar){
+		ar(mFreq)(mPhaseI);
+		if(Archive::loading) freq(mFreq);
+	}
 
 	void onDomainChange(double r);
 
@@ -101,9 +161,23 @@ private:
 	uint32_t mFreqI;	// Current fixed-point frequency
 	Sp mSp;
 
-	uint32_t mapFreq(float v) const;
+	inline uint32_t mapFreq(float v) const;
+
+	template <class S>
+	void advance(S& /*sp*/, uint64_t n){
+		uint32_t p = mPhaseI;
+		for(uint64_t i=0; i<n; ++i) mSp(p, mFreqI);
+		mPhaseI = p;
+	}
+	void advance(phsInc::Loop& /*sp*/, uint64_t n){
+		mPhaseI += uint32_t(mFreqI * n); // exact modulo 2^32
+	}
 };
 
+// Defines a block version of a single-sample waveform method
+#define GAM_OSC_BLOCK(name)\
+	void name(float * dst, unsigned n){ for(unsigned i=0; i<n; ++i) dst[i] = name(); }
+
 #define ACCUM_INHERIT\
 	using Accum<Sp,Td>::phaseI;\
 	using Accum<Sp,Td>::freqI;\
@@ -128,6 +202,17 @@ public:
 		this->nextPhase();
 		return r;
 	}
+
+	/// Generate a block of n samples
+	void operator()(float * dst, unsigned n){
+		uint32_t phs[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, m);
+			for(unsigned i=0; i<m; ++i) dst[i] = float(phs[i]/4294967296.);
+			dst += m; n -= m;
+		}
+	}
 };
 
 
@@ -237,11 +322,74 @@ public:
 		return r;
 	}
 
+	/// Generate a block of n samples
+
+	/// Phases are accumulated in chunks separately from the table lookups so
+	/// both loops are free of the per-sample dependency chain.
+	void operator()(Tv * dst, unsigned n){
+		uint32_t phs[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, m);
+			atPhaseI(dst, phs, m);
+			dst += m; n -= m;
+		}
+	}
+
+	/// Generate a block of n samples with per-sample frequency offsets
+	void operator()(Tv * dst, const float * freqOffset, unsigned n){
+		uint32_t phs[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, freqOffset, m);
+			atPhaseI(dst, phs, m);
+			dst += m; freqOffset += m; n -= m;
+		}
+	}
+
+	/// Generate a block of n samples hard-synced at sample offsets
+
+	/// \param[out] dst			output samples
+	/// \param[in]  n			number of samples
+	/// \param[in]  resets		offsets of samples to start at phase 0, in
+	///							increasing order, e.g. cycles found by
+	///							Accum::nextPhases of a sync oscillator
+	/// \param[in]  numResets	number of offsets
+	void operator()(Tv * dst, unsigned n, const unsigned * resets, unsigned numResets){
+		uint32_t phs[64];
+		unsigned rel[64];
+		unsigned i=0, r=0;
+		while(i<n){
+			unsigned m = n-i < 64 ? n-i : 64;
+			unsigned k=0;
+			for(; r<numResets && resets[r] < i+m; ++r){
+				if(resets[r] >= i && k < 64) rel[k++] = resets[r] - i;
+			}
+			this->syncPhases(phs, m, rel, k);
+			atPhaseI(dst + i, phs, m);
+			i += m;
+		}
+	}
+
 	/// Get current value
 	Tv val() const { return atPhaseI(this->phaseI()); }
 
 	/// Get table value at fixed-point phase
 	Tv atPhaseI(uint32_t v) const { return mIpol(table(), v); }
+
+	/// Get table values at a block of fixed-point phases
+	void atPhaseI(Tv * dst, const uint32_t * phs, unsigned n) const {
+		// Looking up into a local buffer that cannot alias the table lets
+		// the compiler use gathers.
+		const ArrayPow2<Tv>& tbl = table();
+		Tv buf[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			for(unsigned i=0; i<m; ++i) buf[i] = mIpol(tbl, phs[i]);
+			for(unsigned i=0; i<m; ++i) dst[i] = buf[i];
+			dst += m; phs += m; n -= m;
+		}
+	}
 	
 	/// Add sine to table
 	
@@ -267,6 +415,59 @@ protected:
 
 
 
+/// Table oscillator holding only its per-sample state
+
+/// An Osc keeps its domain links, frequency in Hz and table header next to
+/// the fixed-point phase and increment it touches per sample. This keeps
+/// just the latter, 8 bytes, so that arrays of thousands of voices stay in
+/// cache. The table, usually shared by all voices, is passed to each call.
+///
+/// \tparam Tv	Table element type
+/// \tparam Si	Interpolation strategy
+/// \ingroup Oscillator
+template <class Tv = gam::real, template<class> class Si = ipl::Linear>
+struct OscState{
+	uint32_t phase;	///< Fixed-point phase
+	uint32_t inc;	///< Fixed-point phase increment
+
+	/// \param[in] phs		fixed-point phase
+	/// \param[in] frq		fixed-point phase increment
+	OscState(uint32_t phs=0, uint32_t frq=0): phase(phs), inc(frq){}
+
+	/// Set frequency
+
+	/// \param[in] frq		frequency
+	/// \param[in] ups		units per sample of domain, e.g. Domain::master().ups()
+	OscState& freq(float frq, double ups){
+		inc = castIntRound(frq * ups * 4294967296.);
+		return *this;
+	}
+
+	/// Set phase and frequency to those of an oscillator
+	template <class Sp, class Td>
+	OscState& set(const Accum<Sp,Td>& src){
+		phase = src.phaseI(); inc = src.freqI();
+		return *this;
+	}
+
+	/// Generate next sample from table
+	Tv operator()(const ArrayPow2<Tv>& table){
+		Tv r = Si<Tv>()(table, phase);
+		phase += inc;
+		return r;
+	}
+
+	/// Generate a block of n samples from table
+	void operator()(Tv * dst, unsigned n, const ArrayPow2<Tv>& table){
+		const Si<Tv> ipol;
+		uint32_t p = phase;
+		for(unsigned i=0; i<n; ++i){ dst[i] = ipol(table, p); p += inc; }
+		phase = p;
+	}
+};
+
+
+
 /// Complex sinusoid oscillator
 
 /// This oscillator outputs a (decaying) complex sinusoid whose real and
@@ -312,6 +513,7 @@ public:
 	Tv amp() const {return mAmp;}		///< Get amplitude
 	Tv decay() const {return mDcy60;}	///< Get decay length
 	Tv freq() const {return mFreq;}		///< Get frequency
+	const complex& inc() const {return mInc;}	///< Get rotation per sample
 
 	void onDomainChange(double r);
 
@@ -566,6 +768,308 @@ private:
 
 
 
+/// Bank of sinusoids for additive synthesis
+
+/// This is a dynamically-sized bank of (decaying) sinusoids, as SineD, whose
+/// recursion states and coefficients are stored as structure-of-arrays.
+/// Partials are updated several at a time in SIMD vectors by
+/// arr::addTwoPoleBank, so rendering by block is many times faster than
+/// with an array of SineD objects. Changing the frequency, amplitude or
+/// decay of a partial does not reset its phase.
+///
+/// Samples are single precision, so the frequencies of very low partials
+/// are slightly rounded.
+///
+/// \tparam Td	Domain type
+/// \ingroup Oscillator
+/// \sa SineD, SineDs
+template <class Td = DomainObserver>
+class SineBank : public Td{
+public:
+
+	/// \param[in]	num		Number of partials, initially silent
+	SineBank(unsigned num=0){ resize(num); }
+
+
+	/// Get number of partials
+	unsigned size() const { return unsigned(mY1.size()); }
+
+	/// Set number of partials
+
+	/// Existing partials are kept and new ones are silent.
+	///
+	void resize(unsigned num){
+		unsigned old = size();
+		mY1.resize(num, 0.f); mY2.resize(num, 0.f);
+		mC1.resize(num, 2.f); mC2.resize(num, -1.f);
+		mW.resize(num, 0.f); mR.resize(num, 1.f);
+		mFrq.resize(num, 0.f); mAmp.resize(num, 0.f); mDcy.resize(num, -1.f);
+		for(unsigned i=old; i<num; ++i) set(i, 0.f, 0.f);
+	}
+
+
+	/// Get frequency of partial i
+	float freq(unsigned i) const { return mFrq[i]; }
+
+	/// Get amplitude partial i was last set to
+	float amp(unsigned i) const { return mAmp[i]; }
+
+	/// Get T60 decay length of partial i
+	float decay(unsigned i) const { return mDcy[i]; }
+
+
+	/// Set all parameters of partial i and restart it
+
+	/// \param[in] i		index of partial
+	/// \param[in] frq		Frequency
+	/// \param[in] amp		Amplitude
+	/// \param[in] dcy		T60 decay length (negative == no decay)
+	/// \param[in] phs		Phase in [0, 1)
+	void set(unsigned i, float frq, float amp=1, float dcy=-1, float phs=0){
+		mFrq[i] = frq; mAmp[i] = amp; mDcy[i] = dcy;
+		coefs(i);
+		double w = mW[i], r = mR[i], p = phs*M_2PI;
+		mY1[i] = float(::sin(p - w) * amp / r);
+		mY2[i] = float(::sin(p - 2.*w) * amp / (r*r));
+	}
+
+	/// Set frequency of partial i keeping its phase and amplitude
+	void freq(unsigned i, float v){ mFrq[i] = v; retune(i); }
+
+	/// Set amplitude of partial i keeping its phase
+
+	/// The current (possibly decayed) amplitude is scaled by the ratio of
+	/// the new to the previous amplitude.
+	void amp(unsigned i, float v){
+		if(mAmp[i] != 0.f){
+			float s = v/mAmp[i];
+			mY1[i] *= s; mY2[i] *= s;
+			mAmp[i] = v;
+		}
+		else set(i, mFrq[i], v, mDcy[i]);
+	}
+
+	/// Set T60 decay length of partial i keeping its phase
+	void decay(unsigned i, float v){ mDcy[i] = v; retune(i); }
+
+
+	/// Generate next sum of all partials
+	float operator()(){
+		float r = 0.f;
+		if(size()) arr::addTwoPoleBank(&r, &mY1[0], &mY2[0], &mC1[0], &mC2[0], size(), 1);
+		return r;
+	}
+
+	/// Generate block of n sums of all partials
+	void operator()(float * dst, unsigned n){
+		for(unsigned j=0; j<n; ++j) dst[j] = 0.f;
+		if(size()) arr::addTwoPoleBank(dst, &mY1[0], &mY2[0], &mC1[0], &mC2[0], size(), n);
+	}
+
+
+	void onDomainChange(double /*ratio*/){
+		for(unsigned i=0; i<size(); ++i) retune(i);
+	}
+
+private:
+	std::vector<float> mY1, mY2, mC1, mC2;	// states and coefficients
+	std::vector<float> mW, mR;				// radian frequencies and radii of coefficients
+	std::vector<float> mFrq, mAmp, mDcy;
+
+	void coefs(unsigned i){
+		double w = mFrq[i] * Td::ups() * M_2PI;
+		double r = mDcy[i] > 0.f ? scl::radius60(mDcy[i], Td::ups()) : 1.;
+		mW[i] = float(w); mR[i] = float(r);
+		mC1[i] = float(2.*r*::cos(w));
+		mC2[i] = float(-r*r);
+	}
+
+	// Recompute coefficients and match the state to the new ones. With
+	// y1 = A sin(p) and y2 = A sin(p-w)/r, A cos(p) is recovered from the
+	// old coefficients.
+	void retune(unsigned i){
+		double w = mW[i], r = mR[i], sw = ::sin(w);
+		if(scl::abs(sw) < 1e-6){ set(i, mFrq[i], mAmp[i], mDcy[i]); return; }
+		double y1 = mY1[i];
+		double ac = (y1*::cos(w) - r*mY2[i]) / sw;
+		coefs(i);
+		w = mW[i]; r = mR[i];
+		mY2[i] = float((y1*::cos(w) - ac*::sin(w)) / r);
+	}
+};
+
+
+
+/// Bank of complex resonators for modal synthesis
+
+/// This is a dynamically-sized bank of (decaying) complex phasors, as CSine,
+/// stored as structure-of-arrays. Each mode rotates its phasor and adds its
+/// input gain times a shared input signal, so the bank can be struck by
+/// excite() or driven by an excitation block. The output is the sum of the
+/// imaginary parts of all phasors. Modes are updated several at a time in
+/// SIMD vectors by arr::addResonatorBank.
+///
+/// The bank falls asleep when, at the end of a block with no input, all
+/// modes have decayed below a threshold. A sleeping bank outputs zeros
+/// without updating any mode until it is excited or receives nonzero input.
+///
+/// \tparam Td	Domain type
+/// \ingroup Oscillator
+/// \sa CSine, SineBank
+template <class Td = DomainObserver>
+class CSineBank : public Td{
+public:
+
+	/// \param[in]	num		Number of modes, initially silent
+	CSineBank(unsigned num=0): mThresh(1e-5f), mAsleep(true){ resize(num); }
+
+
+	/// Get number of modes
+	unsigned size() const { return unsigned(mZr.size()); }
+
+	/// Set number of modes
+
+	/// Existing modes are kept and new ones are silent.
+	///
+	void resize(unsigned num){
+		mZr.resize(num, 0.f); mZi.resize(num, 0.f);
+		mWr.resize(num, 1.f); mWi.resize(num, 0.f); mG.resize(num, 0.f);
+		mFrq.resize(num, 0.f); mAmp.resize(num, 0.f); mDcy.resize(num, -1.f);
+	}
+
+
+	/// Get frequency of mode i
+	float freq(unsigned i) const { return mFrq[i]; }
+
+	/// Get amplitude of mode i
+	float amp(unsigned i) const { return mAmp[i]; }
+
+	/// Get T60 decay length of mode i
+	float decay(unsigned i) const { return mDcy[i]; }
+
+	/// Whether the bank is asleep
+	bool asleep() const { return mAsleep; }
+
+
+	/// Set parameters of mode i without changing its state
+
+	/// \param[in] i		index of mode
+	/// \param[in] frq		Frequency
+	/// \param[in] amp		Amplitude; the gain of input and of excite()
+	/// \param[in] dcy		T60 decay length (negative == no decay)
+	void set(unsigned i, float frq, float amp=1, float dcy=-1){
+		mFrq[i] = frq; mAmp[i] = mG[i] = amp; mDcy[i] = dcy;
+		coefs(i);
+	}
+
+	/// Set frequency of mode i
+	void freq(unsigned i, float v){ mFrq[i] = v; coefs(i); }
+
+	/// Set amplitude of mode i, scaling its current state
+	void amp(unsigned i, float v){
+		if(mAmp[i] != 0.f){ float s = v/mAmp[i]; mZr[i] *= s; mZi[i] *= s; }
+		mAmp[i] = mG[i] = v;
+	}
+
+	/// Set T60 decay length of mode i
+	void decay(unsigned i, float v){ mDcy[i] = v; coefs(i); }
+
+	/// Set amplitude below which modes count as decayed
+	void threshold(float v){ mThresh = v; }
+
+
+	/// Add a phasor of the mode's amplitude to mode i
+
+	/// The next output of the mode starts at the given phase.
+	/// \param[in] i		index of mode
+	/// \param[in] phs		Phase in [0, 1)
+	void excite(unsigned i, float phs=0){
+		// Add A e^(i p) / w so it is rotated to A e^(i p) by the next sample
+		double p = phs*M_2PI, wr = mWr[i], wi = mWi[i];
+		double a = mAmp[i] / (wr*wr + wi*wi), c = ::cos(p), s = ::sin(p);
+		mZr[i] += float((c*wr + s*wi) * a);
+		mZi[i] += float((s*wr - c*wi) * a);
+		mAsleep = false;
+	}
+
+	/// Clear the states of all modes and fall asleep
+	void reset(){
+		for(unsigned i=0; i<size(); ++i) mZr[i] = mZi[i] = 0.f;
+		mAsleep = true;
+	}
+
+
+	/// Generate next sum of all modes driven by an input sample
+
+	/// This does not put the bank to sleep.
+	///
+	float operator()(float in=0.f){
+		if(in != 0.f) mAsleep = false;
+		float r = 0.f;
+		if(!mAsleep && size()) arr::addResonatorBank(&r, &mZr[0], &mZi[0], &mWr[0], &mWi[0], &mG[0], size(), &in, 1);
+		return r;
+	}
+
+	/// Generate block of n sums of all modes
+	void operator()(float * dst, unsigned n){ (*this)(dst, 0, n); }
+
+	/// Generate block of n sums of all modes driven by an input block
+
+	/// \param[out] dst	output block; may equal src
+	/// \param[in]  src	input block or 0 for no input
+	/// \param[in]  n	number of samples
+	void operator()(float * dst, const float * src, unsigned n){
+		bool silent = true;
+		if(src) for(unsigned j=0; j<n; ++j) if(src[j] != 0.f){ silent = false; break; }
+		if(!silent) mAsleep = false;
+		if(mAsleep || !size()){
+			for(unsigned j=0; j<n; ++j) dst[j] = 0.f;
+			return;
+		}
+
+		// src is copied first as dst may equal it
+		float in[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			if(!silent) for(unsigned j=0; j<m; ++j) in[j] = src[j];
+			for(unsigned j=0; j<m; ++j) dst[j] = 0.f;
+			arr::addResonatorBank(dst, &mZr[0], &mZi[0], &mWr[0], &mWi[0], &mG[0], size(), silent ? 0 : in, m);
+			dst += m; n -= m;
+			if(src) src += m;
+		}
+		if(silent) sleepIfDecayed();
+	}
+
+
+	void onDomainChange(double /*ratio*/){
+		for(unsigned i=0; i<size(); ++i) coefs(i);
+	}
+
+private:
+	std::vector<float> mZr, mZi;		// phasors
+	std::vector<float> mWr, mWi, mG;	// rotations and input gains
+	std::vector<float> mFrq, mAmp, mDcy;
+	float mThresh;
+	bool mAsleep;
+
+	void coefs(unsigned i){
+		double w = mFrq[i] * Td::ups() * M_2PI;
+		double r = mDcy[i] > 0.f ? scl::radius60(mDcy[i], Td::ups()) : 1.;
+		mWr[i] = float(r*::cos(w));
+		mWi[i] = float(r*::sin(w));
+	}
+
+	void sleepIfDecayed(){
+		const float t = mThresh*mThresh;
+		for(unsigned i=0; i<size(); ++i){
+			if(mZr[i]*mZr[i] + mZi[i]*mZi[i] >= t) return;
+		}
+		reset();
+	}
+};
+
+
+
 /// Swept sinusoid with Gaussian envelope
 
 /// This generates a sinusoid with a linear frequency sweep and Gaussian
@@ -661,11 +1165,18 @@ protected:
 /// an accumulator through mathematical functions. The resulting waveforms are
 /// non-band-limited.
 ///
+/// The block versions of the waveforms are evaluated according to a control
+/// rate strategy. With ctlRate::Decimate, waveforms are only evaluated every
+/// few samples and interpolated in between, which makes modulators running
+/// by block much cheaper. The single-sample versions are always evaluated
+/// every sample.
+///
 /// \tparam Sp	Phase increment strategy (e.g., phsInc::Loop, phsInc::Oneshot)
 /// \tparam Td	Domain type
+/// \tparam Sr	Control rate strategy of block generation (e.g., ctlRate::Audio, ctlRate::Decimate)
 /// \ingroup Oscillator 
 /// \sa Osc, TableSine, CSine, Sine, SineR
-template <class Sp = phsInc::Loop, class Td = DomainObserver>
+template <class Sp = phsInc::Loop, class Td = DomainObserver, class Sr = ctlRate::Audio>
 class LFO : public Accum<Sp,Td>{
 public:
 
@@ -727,10 +1238,36 @@ public:
 	float sineT9();
 	float sineP9();
 
+	/// \name Block generation
+	/// Each waveform has a version that fills a block of n samples, e.g.,
+	/// tri(dst, n). It is faster than calling the single-sample version in
+	/// a loop from outside the object since the phase stays in a register.
+	/// When decimating, only one waveform should be generated by block
+	/// since the interpolation history is shared.
+	///@{
+	#define GAM_LFO_BLOCK(name)\
+		void name(float * dst, unsigned n){\
+			mRate(dst, n, [this](){ return name(); }, [this](unsigned k){ this->skip(k); });\
+		}
+	GAM_LFO_BLOCK(cos) GAM_LFO_BLOCK(down) GAM_LFO_BLOCK(even3) GAM_LFO_BLOCK(even5) GAM_LFO_BLOCK(imp)
+	GAM_LFO_BLOCK(line2) GAM_LFO_BLOCK(para) GAM_LFO_BLOCK(pulse) GAM_LFO_BLOCK(pulseRange) GAM_LFO_BLOCK(sinPara)
+	GAM_LFO_BLOCK(stair) GAM_LFO_BLOCK(sqr) GAM_LFO_BLOCK(tri) GAM_LFO_BLOCK(up) GAM_LFO_BLOCK(up2)
+	GAM_LFO_BLOCK(S1) GAM_LFO_BLOCK(C2) GAM_LFO_BLOCK(S3) GAM_LFO_BLOCK(C4) GAM_LFO_BLOCK(S5)
+	GAM_LFO_BLOCK(cosU) GAM_LFO_BLOCK(downU) GAM_LFO_BLOCK(hann) GAM_LFO_BLOCK(impU) GAM_LFO_BLOCK(line2U)
+	GAM_LFO_BLOCK(paraU) GAM_LFO_BLOCK(pulseU) GAM_LFO_BLOCK(stairU) GAM_LFO_BLOCK(sqrU) GAM_LFO_BLOCK(triU)
+	GAM_LFO_BLOCK(upU) GAM_LFO_BLOCK(up2U)
+	GAM_LFO_BLOCK(patU) GAM_LFO_BLOCK(sineT9) GAM_LFO_BLOCK(sineP9)
+	#undef GAM_LFO_BLOCK
+	///@}
+
+	/// Get control rate strategy
+	Sr& ctlRate(){ return mRate; }
+
 	ACCUM_INHERIT
 private:
 	typedef Accum<Sp,Td> Base;
 	uint32_t mMod;			// Modifier parameter
+	Sr mRate;
 };
 
 
@@ -770,6 +1307,14 @@ public:
 	float tri();			///< Triangle
 	float pulse();			///< Pulse
 
+	/// \name Block generation
+	/// Each waveform has a version that fills a block of n samples, e.g.,
+	/// sqr(dst, n).
+	///@{
+	GAM_OSC_BLOCK(up) GAM_OSC_BLOCK(down) GAM_OSC_BLOCK(sqr)
+	GAM_OSC_BLOCK(para) GAM_OSC_BLOCK(tri) GAM_OSC_BLOCK(pulse)
+	///@}
+
 	void onDomainChange(double r);
 
 private:
@@ -802,17 +1347,28 @@ public:
 	Buzz(Tv frq=440, Tv phase=0, Tv harmonics=8);
 	virtual ~Buzz(){}
 
-	void antialias();			///< Adjust number of harmonics to prevent aliasing
-	void harmonics(Tv num);		///< Set number of harmonics
-	void harmonicsMax();		///< Set number of harmonics to fill Nyquist range
+	inline void antialias();	///< Adjust number of harmonics to prevent aliasing
+	inline void harmonics(Tv num);	///< Set number of harmonics
+	inline void harmonicsMax();	///< Set number of harmonics to fill Nyquist range
 	void normalize(bool v);		///< Whether to normalize amplitude
 
-	Tv operator()();			///< Returns next sample of all harmonic impulse
-	Tv odd();					///< Returns next sample of odd harmonic impulse
-	Tv saw(Tv intg=0.999);		///< Returns next sample of saw waveform
-	Tv square(Tv intg=0.999);	///< Returns next sample of square waveform
+	inline Tv operator()();		///< Returns next sample of all harmonic impulse
+	inline Tv odd();			///< Returns next sample of odd harmonic impulse
+	inline Tv saw(Tv intg=0.999);	///< Returns next sample of saw waveform
+	inline Tv square(Tv intg=0.999);	///< Returns next sample of square waveform
+
+	/// \name Block generation
+	/// These fill a block of n samples. They evaluate the closed forms with
+	/// branch-free polynomial sines (of scl::sinP9 accuracy) and a select at
+	/// the singular points, so the loops vectorize.
+	///@{
+	void operator()(Tv * dst, unsigned n);
+	void odd(Tv * dst, unsigned n);
+	void saw(Tv * dst, unsigned n, Tv intg=0.999);
+	void square(Tv * dst, unsigned n, Tv intg=0.999);
+	///@}
 	
-	Tv maxHarmonics() const;	///< Get number of harmonics below Nyquist based on current settings
+	inline Tv maxHarmonics() const;	///< Get number of harmonics below Nyquist based on current settings
 
 	void onDomainChange(double r);
 
@@ -824,7 +1380,7 @@ protected:
 	Tv mSPU_2;			// cached local
 	Tv mPrev;			// previous output for integration
 	bool mNormalize;
-	void setAmp();
+	inline void setAmp();
 private: typedef AccumPhase<Tv,Td> Base;
 };
 
@@ -885,6 +1441,9 @@ struct Saw : public Impulse<Tv,Td> {
 	/// \param[in] itg		Leaky integration factor
 	///
 	Tv operator()(Tv itg=0.999){ return Impulse<Tv,Td>::saw(itg); }
+
+	/// Generate block of n samples
+	void operator()(Tv * dst, unsigned n, Tv itg=0.999){ Impulse<Tv,Td>::saw(dst, n, itg); }
 };
 
 
@@ -912,6 +1471,9 @@ struct Square : public Impulse<Tv,Td> {
 	/// \param[in] itg		Leaky integration factor
 	///
 	Tv operator()(Tv itg=0.999){ return Impulse<Tv,Td>::square(itg); }
+
+	/// Generate block of n samples
+	void operator()(Tv * dst, unsigned n, Tv itg=0.999){ Impulse<Tv,Td>::square(dst, n, itg); }
 };
 
 
@@ -937,19 +1499,25 @@ public:
 	/// \param[in]	harmonics	Number of harmonics
 	DSF(Tv frq=440, Tv freqRatio=1, Tv ampRatio=0.5, Tv harmonics=8);
 	
-	Tv operator()();			///< Generate next sample
+	inline Tv operator()();		///< Generate next sample
+
+	/// Generate block of n samples
+
+	/// This uses branch-free polynomial sines of scl::sinP9 accuracy so the
+	/// evaluation of the closed form vectorizes.
+	void operator()(Tv * dst, unsigned n);
 	
-	void ampRatio(Tv v);		///< Set amplitude ratio of partials
-	void antialias();			///< Adjust harmonics so partials do not alias
-	void freq(Tv v);			///< Set frequency of fundamental
-	void freqRatio(Tv v);		///< Set frequency ratio of partials
-	void harmonics(Tv v);		///< Set number of harmonics
-	void harmonicsMax();		///< Set number of harmonics to fill Nyquist range
-
-	Tv ampRatio() const;		///< Get amplitude ratio
-	Tv freqRatio() const;		///< Get frequency ratio
-	Tv harmonics() const;		///< Get current number of harmonics
-	Tv maxHarmonics() const;	///< Get maximum number of harmonics for current settings
+	inline void ampRatio(Tv v);	///< Set amplitude ratio of partials
+	inline void antialias();	///< Adjust harmonics so partials do not alias
+	inline void freq(Tv v);		///< Set frequency of fundamental
+	inline void freqRatio(Tv v);	///< Set frequency ratio of partials
+	inline void harmonics(Tv v);	///< Set number of harmonics
+	inline void harmonicsMax();	///< Set number of harmonics to fill Nyquist range
+
+	inline Tv ampRatio() const;	///< Get amplitude ratio
+	inline Tv freqRatio() const;	///< Get frequency ratio
+	inline Tv harmonics() const;	///< Get current number of harmonics
+	inline Tv maxHarmonics() const;	///< Get maximum number of harmonics for current settings
 	
 	void onDomainChange(double r);
 
@@ -962,8 +1530,8 @@ protected:
 	Tv mBeta, mBetaInc;		// "detune" accumulator
 	Tv mAPow, mASqP1;		// cached vars
 	
-	void updateAPow();
-	void updateBetaInc();
+	inline void updateAPow();
+	inline void updateBetaInc();
 };
 
 
@@ -1044,6 +1612,15 @@ inline double mapIF(uint32_t v){
 	//return uintToUnit<float>(v); // not enough precision
 }
 
+// Branch-free sin(pi x); x is wrapped into [-1, 1] by rounding to the
+// nearest even integer so loops of it vectorize.
+template <class T>
+inline T sinPi(T x){
+	T h = x * T(0.5);
+	x -= T(2) * T(int32_t(h + (h < T(0) ? T(-0.5) : T(0.5))));
+	return scl::sinP9(x);
+}
+
 };
 
 
@@ -1118,6 +1695,61 @@ template<class Sp, class Td> inline uint32_t Accum<Sp,Td>::nextPhase(){
 	return p;
 }
 
+template<class Sp, class Td>
+inline void Accum<Sp,Td>::skip(unsigned n){
+	uint32_t p = mPhaseI;
+	for(unsigned i=0; i<n; ++i) mSp(p, mFreqI);
+	mPhaseI = p;
+}
+
+template<class Sp, class Td>
+inline void Accum<Sp,Td>::nextPhases(uint32_t * dst, unsigned n){
+	uint32_t p = mPhaseI;
+	const uint32_t inc = mFreqI;
+	for(unsigned i=0; i<n; ++i){
+		dst[i] = p;
+		mSp(p, inc);
+	}
+	mPhaseI = p;
+}
+
+template<class Sp, class Td>
+inline void Accum<Sp,Td>::nextPhases(uint32_t * dst, const float * frqOffset, unsigned n){
+	uint32_t p = mPhaseI;
+	const uint32_t inc = mFreqI;
+	for(unsigned i=0; i<n; ++i){
+		dst[i] = p;
+		mSp(p, inc + mapFreq(frqOffset[i]));
+	}
+	mPhaseI = p;
+}
+
+template<class Sp, class Td>
+inline unsigned Accum<Sp,Td>::nextPhases(uint32_t * dst, unsigned n, unsigned * cycles){
+	if(!n) return 0;
+	nextPhases(dst, n);
+	unsigned k=0;
+	for(unsigned i=0; i<n-1; ++i){
+		cycles[k] = i;
+		k += (dst[i] & ~dst[i+1]) >> 31;
+	}
+	cycles[k] = n-1;
+	k += (dst[n-1] & ~mPhaseI) >> 31;
+	return k;
+}
+
+template<class Sp, class Td>
+inline void Accum<Sp,Td>::syncPhases(uint32_t * dst, unsigned n, const unsigned * resets, unsigned numResets){
+	unsigned i=0;
+	for(unsigned r=0; r<numResets && resets[r]<n; ++r){
+		if(resets[r] < i) continue;
+		nextPhases(dst + i, resets[r] - i);
+		mPhaseI = 0;
+		i = resets[r];
+	}
+	nextPhases(dst + i, n - i);
+}
+
 template<class Sp, class Td> inline bool Accum<Sp,Td>::operator()(){ return cycle(); }
 
 template<class Sp, class Td> inline bool Accum<Sp,Td>::cycle(){ return (cycles() & 0x80000000) != 0; }
@@ -1285,24 +1917,24 @@ template<class Tv, class Td> void CSine<Tv, Td>::onDomainChange(double /*r*/){
 
 
 //---- LFO
-#define TLFO LFO<Sp,Td>
-template<class Sp, class Td> TLFO::LFO(): Base(){ mod(0.5); }
-template<class Sp, class Td> TLFO::LFO(double f, double p, double m): Base(f, p){ mod(m); }
+#define TLFO LFO<Sp,Td,Sr>
+template<class Sp, class Td, class Sr> TLFO::LFO(): Base(){ mod(0.5); }
+template<class Sp, class Td, class Sr> TLFO::LFO(double f, double p, double m): Base(f, p){ mod(m); }
 
-template<class Sp, class Td> inline TLFO& TLFO::set(float f, float p, float m){
+template<class Sp, class Td, class Sr> inline TLFO& TLFO::set(float f, float p, float m){
 	this->freq(f);
 	this->phase(p);
 	return mod(m);
 }
-template<class Sp, class Td> inline TLFO& TLFO::mod(double v){
+template<class Sp, class Td, class Sr> inline TLFO& TLFO::mod(double v){
 	return modI(castIntRound(v*4294967296.));
 }
-template<class Sp, class Td> inline TLFO& TLFO::modI(uint32_t v){
+template<class Sp, class Td, class Sr> inline TLFO& TLFO::modI(uint32_t v){
 	mMod=v;
 	return *this;
 }
 
-template<class Sp, class Td> inline float TLFO::line2(){
+template<class Sp, class Td, class Sr> inline float TLFO::line2(){
 	uint32_t m = scl::clip<uint32_t>(mMod, 0xffefffff, 512); // avoid div by zero
 
 	/* Starts at 1
@@ -1319,9 +1951,9 @@ template<class Sp, class Td> inline float TLFO::line2(){
 	return r;
 }
 
-template<class Sp, class Td> inline float TLFO::line2U(){ return line2()*0.5f+0.5f; }
+template<class Sp, class Td, class Sr> inline float TLFO::line2U(){ return line2()*0.5f+0.5f; }
 
-#define DEF(name, exp) template<class Sp, class Td> inline float TLFO::name{ float r = exp; return r; }
+#define DEF(name, exp) template<class Sp, class Td, class Sr> inline float TLFO::name{ float r = exp; return r; }
 //DEF(cos(),		tri(); r *= 0.5f * r*r - 1.5f)
 //DEF(cos(),		up(); r=scl::abs(r*r) )//r = -1.f - scl::pow2(2.f*r)*(scl::abs(r)-1.5f) )
 DEF(cos(),		up(); r = -1.f - r*r*(4.f*scl::abs(r)-6.f) )
@@ -1613,8 +2245,46 @@ template<class Tv, class Td> inline Tv Buzz<Tv,Td>::odd(){
 	
 	return result;
 }
+
+template<class Tv, class Td> void Buzz<Tv, Td>::operator()(Tv * dst, unsigned n){
+	const Tv amp = mAmp, peak = Tv(2) * mN * mAmp, np = mN + Tv(0.5);
+	for(unsigned i=0; i<n; ++i) dst[i] = this->nextPhase() * Tv(M_1_PI);
+	for(unsigned i=0; i<n; ++i){
+		Tv t = dst[i];
+		Tv denom = scl::sinP9(t * Tv(0.5));
+		bool sing = scl::abs(denom) < Tv(EPS);
+		Tv r = (sinPi(t * np) - denom) / (sing ? Tv(1) : denom) * amp;
+		dst[i] = sing ? peak : r;
+	}
+}
+
+template<class Tv, class Td> void Buzz<Tv,Td>::odd(Tv * dst, unsigned n){
+	const Tv n2 = scl::roundAway(mN*0.5) * 2;
+	const Tv n2frac = ((mN + mNFrac) - (n2-1));
+	const Tv A = n2 / (n2 + n2frac), gain = Tv(1) / (n2 + n2frac);
+	for(unsigned i=0; i<n; ++i) dst[i] = this->nextPhase() * Tv(M_1_PI);
+	for(unsigned i=0; i<n; ++i){
+		Tv t = dst[i];
+		Tv denom = scl::sinP9(t);
+		bool sing = scl::abs(denom) < Tv(EPS);
+		Tv r = sinPi(n2 * t) / (sing ? Tv(1) : denom) * gain;
+		dst[i] = sing ? (scl::abs(t) < Tv(0.5) ? A : -A) : r;
+	}
+}
 #undef EPS
 
+template<class Tv, class Td>
+void Buzz<Tv,Td>::saw(Tv * dst, unsigned n, Tv b){
+	(*this)(dst, n);
+	for(unsigned i=0; i<n; ++i) dst[i] = mPrev = dst[i] + b*mPrev;
+}
+
+template<class Tv, class Td>
+void Buzz<Tv,Td>::square(Tv * dst, unsigned n, Tv b){
+	odd(dst, n);
+	for(unsigned i=0; i<n; ++i) dst[i] = mPrev = dst[i] + b*mPrev;
+}
+
 template<class Tv, class Td>
 inline Tv Buzz<Tv,Td>::saw(Tv b){ return mPrev=(*this)() + b*mPrev; }
 
@@ -1693,7 +2363,7 @@ template<class Tv, class Td> inline Tv DSF<Tv,Td>::harmonics() const {
 }
 
 template<class Tv, class Td> inline Tv DSF<Tv,Td>::maxHarmonics() const {
-	return scl::floor((Tv(this->spu()) * Tv(0.5)/this->freq() - Tv(1))/freqRatio() + Tv(1));
+	return scl::floor((Tv(this->spu()) * Tv(0.5)/Base::freq() - Tv(1))/freqRatio() + Tv(1));
 }
 
 template<class Tv, class Td> inline void DSF<Tv,Td>::updateAPow(){
@@ -1731,11 +2401,58 @@ template<class Tv, class Td> inline Tv DSF<Tv,Td>::operator()(){
 #undef SIN
 #undef COS
 
+template<class Tv, class Td> void DSF<Tv,Td>::operator()(Tv * dst, unsigned n){
+	Tv beta[64];
+	while(n){
+		const unsigned m = n < 64 ? n : 64;
+		for(unsigned i=0; i<m; ++i){
+			mBeta = scl::wrapPhase(mBeta);
+			dst[i] = Base::nextPhase() * Tv(M_1_PI);
+			beta[i] = mBeta * Tv(M_1_PI);
+			mBeta += mBetaInc;
+		}
+		const Tv a = mA, aPow = mAPow, aSqP1 = mASqP1, N = mN;
+		for(unsigned i=0; i<m; ++i){
+			Tv t = dst[i], b = beta[i];
+			Tv tn = t + N * b;
+			Tv r = sinPi(t) - a * sinPi(t - b) - aPow * (sinPi(tn) - a * sinPi(tn - b));
+			dst[i] = r / (aSqP1 - Tv(2) * a * sinPi(b + Tv(0.5)));
+		}
+		dst += m; n -= m;
+	}
+}
+
 template<class Tv, class Td> void DSF<Tv,Td>::onDomainChange(double r){
 	Base::onDomainChange(r);
 	freq(Base::freq());
 	harmonics(mNDesired);
 }
 
+#ifdef GAM_EXTERN_TEMPLATE
+GAM_EXTERN_TEMPLATE class Accum<>;
+GAM_EXTERN_TEMPLATE class Sweep<>;
+GAM_EXTERN_TEMPLATE class LFO<>;
+GAM_EXTERN_TEMPLATE class Osc<float>;
+GAM_EXTERN_TEMPLATE class Osc<double>;
+GAM_EXTERN_TEMPLATE class Sine<float>;
+GAM_EXTERN_TEMPLATE class Sine<double>;
+GAM_EXTERN_TEMPLATE class SineR<float>;
+GAM_EXTERN_TEMPLATE class SineR<double>;
+GAM_EXTERN_TEMPLATE class SineD<float>;
+GAM_EXTERN_TEMPLATE class SineD<double>;
+GAM_EXTERN_TEMPLATE class CSine<float>;
+GAM_EXTERN_TEMPLATE class CSine<double>;
+GAM_EXTERN_TEMPLATE class Buzz<float>;
+GAM_EXTERN_TEMPLATE class Buzz<double>;
+GAM_EXTERN_TEMPLATE struct Impulse<float>;
+GAM_EXTERN_TEMPLATE struct Impulse<double>;
+GAM_EXTERN_TEMPLATE struct Saw<float>;
+GAM_EXTERN_TEMPLATE struct Saw<double>;
+GAM_EXTERN_TEMPLATE struct Square<float>;
+GAM_EXTERN_TEMPLATE struct Square<double>;
+GAM_EXTERN_TEMPLATE class DSF<float>;
+GAM_EXTERN_TEMPLATE class DSF<double>;
+#endif
+
 } // gam::
 #endif
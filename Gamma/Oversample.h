@@ -0,0 +1,194 @@
+#ifndef GAMMA_OVERSAMPLE_H_INC
+#define GAMMA_OVERSAMPLE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Polyphase half-band resampling and oversampled processing of generators
+*/
+
+#include <vector>
+#include "Gamma/Domain.h"
+
+namespace gam{
+
+/// Polyphase half-band filter for 2x upsampling and downsampling
+
+/// This is a linear-phase, Kaiser-windowed half-band FIR filter evaluated in
+/// polyphase form. Every other coefficient of a half-band filter is zero, so
+/// a 2x up- or downsampler costs one FIR of half the filter length per
+/// low-rate sample. The filter loops run over blocks of outputs so that they
+/// vectorize. up() and down() keep separate states, so one object can handle
+/// both directions of one oversampling stage.
+///
+/// Memory is only allocated by the constructor and design().
+class HalfBand{
+public:
+
+	/// \param[in] taps		number of nonzero coefficients on each side of
+	///						the center; the filter has 4*taps-1 coefficients
+	HalfBand(unsigned taps=12);
+
+
+	/// Get number of nonzero coefficients on each side of center
+	unsigned taps() const { return unsigned(mCoef.size()/2); }
+
+	/// Get group delay in samples of the higher rate
+	unsigned latency() const { return 2*taps()-1; }
+
+
+	/// Compute filter coefficients and clear states
+	void design(unsigned taps);
+
+	/// Upsample by 2
+
+	/// \param[out] dst	2*n output samples
+	/// \param[in]  src	n input samples
+	/// \param[in]  n	number of input samples
+	void up(float * dst, const float * src, unsigned n);
+
+	/// Downsample by 2
+
+	/// \param[out] dst	n output samples; may equal src
+	/// \param[in]  src	2*n input samples
+	/// \param[in]  n	number of output samples
+	void down(float * dst, const float * src, unsigned n);
+
+	/// Clear filter states
+	void reset();
+
+private:
+	enum{ BLOCK = 64 };
+	std::vector<float> mCoef;		// coefficients of filtering branch
+	std::vector<float> mUp;			// history and block of upsampler input
+	std::vector<float> mDnE, mDnO;	// histories and blocks of even and odd downsampler inputs
+};
+
+
+
+/// Runs a generator or process at a multiple of the sampling rate
+
+/// This upsamples its input (if any) by N through a cascade of HalfBand
+/// stages, runs a per-sample generator or function at N times the sampling
+/// rate and downsamples the result back through a matching cascade. This
+/// suppresses aliasing from nonlinear processes such as feedback FM, DSF or
+/// waveshaping. The oversampled objects should be attached to domain() so
+/// their frequencies are in terms of the oversampled rate. The first stage,
+/// closest to the base rate, has the steepest filter; later stages have
+/// wider transition bands and so use shorter filters.
+///
+/// \tparam N	oversampling factor; 2, 4 or 8
+template <unsigned N>
+class Oversample : public DomainObserver{
+public:
+
+	/// \param[in] taps		nonzero coefficients per side of first stage filter
+	Oversample(unsigned taps=12)
+	:	mDomain(1)
+	{
+		static_assert(N==2 || N==4 || N==8, "Oversampling factor must be 2, 4 or 8");
+		for(unsigned s=0; s<STAGES; ++s){
+			unsigned t = taps >> s;
+			mStages[s].design(t < 3 ? 3 : t);
+		}
+		onDomainChange(1);
+	}
+
+
+	/// Get oversampled domain to attach generators to
+	Domain& domain(){ return mDomain; }
+
+	/// Get latency in samples of the base rate, up and down
+	double latency() const {
+		double l = 0;
+		for(unsigned s=0; s<STAGES; ++s) l += 2.*mStages[s].latency() / (2<<s);
+		return l;
+	}
+
+
+	/// Generate n samples from a generator run at N times the rate
+
+	/// \param[out] dst	output samples
+	/// \param[in]  n	number of output samples
+	/// \param[in]  gen	generator called as gen() N*n times
+	template <class Gen>
+	void operator()(float * dst, unsigned n, Gen& gen){
+		while(n){
+			unsigned m = n < BLOCK ? n : BLOCK;
+			for(unsigned i=0; i<m*N; ++i) mBuf[i] = gen();
+			down(dst, m);
+			dst += m; n -= m;
+		}
+	}
+
+	/// Process n samples through a function run at N times the rate
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n	number of samples
+	/// \param[in]  func	function called as func(x) N*n times
+	template <class Func>
+	void operator()(float * dst, const float * src, unsigned n, Func& func){
+		while(n){
+			unsigned m = n < BLOCK ? n : BLOCK;
+			up(src, m);
+			for(unsigned i=0; i<m*N; ++i) mBuf[i] = func(mBuf[i]);
+			down(dst, m);
+			src += m; dst += m; n -= m;
+		}
+	}
+
+	/// Process n samples through a block function run at N times the rate
+
+	/// \param[out] dst	output samples; may equal src
+	/// \param[in]  src	input samples
+	/// \param[in]  n	number of samples
+	/// \param[in]  func	function called as func(dst, src, len), in place,
+	///					on blocks of upsampled samples
+	template <class Func>
+	void block(float * dst, const float * src, unsigned n, Func& func){
+		while(n){
+			unsigned m = n < BLOCK ? n : BLOCK;
+			up(src, m);
+			func(mBuf, mBuf, m*N);
+			down(dst, m);
+			src += m; dst += m; n -= m;
+		}
+	}
+
+	/// Clear filter states
+	void reset(){ for(unsigned s=0; s<STAGES; ++s) mStages[s].reset(); }
+
+	void onDomainChange(double /*r*/){ mDomain.spu(spu()*N); }
+
+private:
+	enum{ STAGES = N==2 ? 1 : (N==4 ? 2 : 3), BLOCK = 64 };
+	HalfBand mStages[STAGES];	// stage s converts between rates 2^s and 2^(s+1)
+	Domain mDomain;
+	float mBuf[BLOCK*N], mTmp[BLOCK*N];
+
+	// Upsample m samples of src into mBuf
+	void up(const float * src, unsigned m){
+		const float * in = src;
+		for(unsigned s=0; s<STAGES; ++s){
+			float * out = ((STAGES-1-s)&1) ? mTmp : mBuf;
+			mStages[s].up(out, in, m<<s);
+			in = out;
+		}
+	}
+
+	// Downsample m*N samples of mBuf into dst
+	void down(float * dst, unsigned m){
+		float * in = mBuf;
+		for(unsigned s=STAGES; s-->0;){
+			float * out = s ? (in == mBuf ? mTmp : mBuf) : dst;
+			mStages[s].down(out, in, m<<s);
+			in = out;
+		}
+	}
+};
+
+} // gam::
+
+#endif
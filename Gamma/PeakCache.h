@@ -0,0 +1,142 @@
+#ifndef GAMMA_PEAKCACHE_H_INC
+#define GAMMA_PEAKCACHE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Multiresolution min/max/RMS overview of a sound for waveform display
+*/
+
+#include <string>
+#include <vector>
+
+namespace gam{
+
+/// Multiresolution min/max/RMS overview of a sound for waveform display
+
+/// Frames are summarized in bins of 256, 4096 and 65536 frames, one level
+/// per bin size, so a view can draw from the coarsest level with at least
+/// one bin per pixel instead of reading the sound. Levels are built in one
+/// streaming pass as frames are written, e.g. from the disk thread of a
+/// SoundFileStreamWriter (see SoundFileStreamWriter::peaks), from frames
+/// read out of a Recorder or from a sound file with readPeaks().
+///
+/// The cache is saved to a compact sidecar file storing 16-bit values, so
+/// peaks are quantized to 1/32767 and clipped to [-1, 1]. Each level is
+/// stored contiguously, so zooming can read just the bins it shows with
+/// read().
+///
+/// \ingroup Analysis
+class PeakCache{
+public:
+
+	enum{ LEVELS = 3 };	///< Number of levels
+
+	/// Peak values of a bin of a channel
+	struct Peak{
+		float min;	///< Minimum sample
+		float max;	///< Maximum sample
+		float rms;	///< Root mean square of samples
+	};
+
+
+	/// \param[in] channels	number of channels
+	PeakCache(int channels=1);
+
+
+	/// Set number of channels; clears the cache
+	PeakCache& channels(int n);
+
+	/// Remove all frames
+	void clear();
+
+	/// Add interleaved frames
+	void write(const float * src, int numFrames);
+
+	/// Add bins of frames not filling a whole bin
+
+	/// Call this after the last write so the end of the sound is included.
+	/// Writing more frames afterwards continues the partial bins.
+	void finish();
+
+	/// Append another cache of the following frames
+
+	/// Its channels must match and the frames in this one must fill whole
+	/// bins of the last level. This joins caches of consecutive segments of a
+	/// sound built in parallel.
+	/// \returns false if the caches cannot be joined
+	bool append(const PeakCache& src);
+
+
+	int channels() const { return mChans; }				///< Get number of channels
+	long long frames() const { return mFrames; }		///< Get number of frames written
+
+	/// Get number of bins of a level, including partial bins after finish()
+	int bins(int level) const { return mChans ? int(mLevels[level].size() / mChans) : 0; }
+
+	/// Get peak of a bin of a channel
+	const Peak& peak(int level, int bin, int chan=0) const {
+		return mLevels[level][bin*mChans + chan];
+	}
+
+	/// Get peak of a frame range of a channel
+
+	/// Bins of the coarsest levels fitting the range are combined, so the
+	/// range is extended out to the closest boundaries of bins of level 0,
+	/// or of the finest level loaded if level 0 was not.
+	Peak range(long long begin, long long end, int chan=0) const;
+
+	/// Get number of frames summarized by a bin of a level
+	static int binFrames(int level){ return 256 << (4*level); }
+
+	/// Get coarsest level with at least one bin per a number of frames
+
+	/// \param[in] framesPerPixel	number of frames drawn per pixel
+	static int level(double framesPerPixel);
+
+
+	/// Save to sidecar file
+
+	/// \returns whether the file was written
+	bool save(const std::string& path) const;
+
+	/// Load from sidecar file written by save()
+
+	/// \param[in] path		path of file
+	/// \param[in] level		level to load or -1 for all; others are left empty
+	/// \returns whether the file was read; an invalid file clears the cache
+	bool load(const std::string& path, int level=-1);
+
+	/// Read bins of a level from sidecar file without loading the rest
+
+	/// \param[out] dst		numBins x channels peaks, channels interleaved
+	/// \param[in] path		path of file
+	/// \param[in] level		level to read
+	/// \param[in] bin		first bin
+	/// \param[in] numBins	number of bins
+	/// \returns number of bins read
+	static int read(Peak * dst, const std::string& path, int level, int bin, int numBins);
+
+private:
+	struct Acc{
+		float min, max;
+		double sumSq;
+		long long n;	// number of frames
+	};
+
+	int mChans;
+	long long mFrames;
+	std::vector<Peak> mLevels[LEVELS];	// bin major, channels interleaved
+	std::vector<Acc> mAcc[LEVELS];		// partial bin of each level, by channel
+	bool mFinished;						// whether partial bins were added
+
+	void unfinish();
+	void emit(int level, const Acc * acc);
+	static void resetAcc(Acc& a);
+	static void addAcc(Acc& a, const Acc& b);
+};
+
+} // gam::
+
+#endif
@@ -0,0 +1,136 @@
+#ifndef GAMMA_PHASE_VOCODER_H_INC
+#define GAMMA_PHASE_VOCODER_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Phase vocoder for pitch shifting and time stretching of STFT frames
+*/
+
+#include <atomic>
+#include <vector>
+#include "Gamma/AsyncSTFT.h"
+#include "Gamma/DFT.h"
+
+namespace gam{
+
+/// Phase vocoder for pitch shifting and time stretching
+
+/// This resynthesizes magnitude/phase frames of an STFT with new phases so
+/// that each partial keeps its frequency while the bins are moved (pitch
+/// shifting) or the frames are further apart in the output than in the
+/// input (time stretching). Per frame, the phase difference to the previous
+/// frame is unwrapped into the frequency of each bin, the bins are shifted
+/// and scaled, and the frequencies are accumulated into output phases. The
+/// per-bin loops run in SIMD batches (AVX2 or AVX-512 when available, see
+/// simdPath()).
+///
+/// Frames must be in MAG_PHASE format. The vocoder processes the current
+/// frame of an STFT in place, between its forward and inverse transforms:
+///
+///		if(stft(in)){ vocoder(stft); }
+///		out = stft();
+///
+/// A streaming STFT analyzes its input a hop apart, so it can only be pitch
+/// shifted. To stretch a sound held in a buffer by a factor r, analyze
+/// windows taken every sizeHop()/r samples and play one hop of each inverse:
+///
+///		stft.forward(src + pos); pos += stft.sizeHop() / r;
+///		vocoder.stretch(r)(stft);
+///		stft.inverse(out);
+///
+/// Settings may be changed from another thread than the one processing
+/// frames; they take effect on the next frame.
+///
+/// \ingroup Spectral
+class PhaseVocoder{
+public:
+
+	/// How output phases of neighboring bins are related
+	enum PhaseLocking{
+		LOCK_NONE,		/**< Each bin accumulates its own phase */
+		LOCK_IDENTITY	/**< Bins around a peak keep their analysis phase
+							 offsets to the peak (less phasiness) */
+	};
+
+	/// \param[in] numBins	number of bins of frames to process
+	explicit PhaseVocoder(unsigned numBins=0);
+
+
+	/// Set pitch shift ratio; 2 is an octave up
+	PhaseVocoder& pitch(float ratio){ mPitch.store(ratio, std::memory_order_relaxed); return *this; }
+
+	/// Set time stretch ratio of output to input hop; 2 is twice as long
+	PhaseVocoder& stretch(float ratio){ mStretch.store(ratio, std::memory_order_relaxed); return *this; }
+
+	/// Set phase locking
+	PhaseVocoder& phaseLocking(PhaseLocking v){ mLocking.store(v, std::memory_order_relaxed); return *this; }
+
+	/// Set output phases of next frame to its analysis phases
+
+	/// Call on transients to keep them from smearing.
+	///
+	PhaseVocoder& resetPhases(){ mResetPhases.store(true, std::memory_order_relaxed); return *this; }
+
+	/// Set number of bins; allocates memory and resets phases
+	PhaseVocoder& resize(unsigned numBins);
+
+
+	float pitch() const { return mPitch.load(std::memory_order_relaxed); }
+	float stretch() const { return mStretch.load(std::memory_order_relaxed); }
+	PhaseLocking phaseLocking() const { return mLocking.load(std::memory_order_relaxed); }
+	unsigned numBins() const { return unsigned(mPrev.size()); }
+
+
+	/// Process current frame of an STFT in MAG_PHASE format
+
+	/// If the STFT does not have numBins() bins, the vocoder is resized.
+	///
+	void operator()(STFT& stft);
+
+private:
+	std::atomic<float> mPitch, mStretch;
+	std::atomic<PhaseLocking> mLocking;
+	std::atomic<bool> mResetPhases;
+	bool mFirst;					// no previous frame to take differences to
+	std::vector<float> mMag, mPhs;	// analysis frame
+	std::vector<float> mPrev;		// previous analysis phases
+	std::vector<float> mAdv;		// phase advances per output hop
+	std::vector<float> mOutMag, mOutAdv, mOutPhs;	// shifted frame
+	std::vector<float> mAccum;		// output phases
+	std::vector<unsigned> mPeaks;
+
+	void shift(float ratio, float binAdv);
+	void lock();
+};
+
+
+/// Phase vocoder pitch shifter running on an AsyncSTFT worker thread
+
+/// \ingroup Spectral
+class AsyncPhaseVocoder : public AsyncSTFT{
+public:
+
+	/// \see STFT::STFT
+	AsyncPhaseVocoder(unsigned winSize=2048, unsigned hopSize=512, unsigned padSize=0,
+		WindowType winType = HANN
+	)
+	:	AsyncSTFT(winSize, hopSize, padSize, winType, MAG_PHASE),
+		mVocoder(stft().numBins())
+	{}
+
+	~AsyncPhaseVocoder(){ stop(); }
+
+	/// Get phase vocoder
+	PhaseVocoder& vocoder(){ return mVocoder; }
+
+	void onFrame(STFT& s){ mVocoder(s); }
+
+private:
+	PhaseVocoder mVocoder;
+};
+
+} // gam::
+
+#endif
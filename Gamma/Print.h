@@ -52,6 +52,81 @@ void err(const char * msg, const char * src="", bool exits=true);
 void warn(const char * msg, const char * src="");
 
 
+/// Message queued by errRT() and warnRT()
+
+/// Only pointers are stored, so the source, format and string arguments must
+/// remain valid until printed; string literals are best.
+struct LogRecord{
+	enum{ MAX_ARGS = 4 };
+	enum Type{ INT, UINT, FLOAT, STRING, POINTER };
+	union Arg{ long long i; unsigned long long u; double f; const char * s; const void * p; };
+
+	const char * src;
+	const char * fmt;
+	bool error;
+	bool fatal;				///< Exit after printing
+	unsigned char numArgs;
+	unsigned char types[MAX_ARGS];
+	Arg args[MAX_ARGS];
+
+	/// Append an argument
+	void arg(int v){ add(INT).i = v; }
+	void arg(long v){ add(INT).i = v; }
+	void arg(long long v){ add(INT).i = v; }
+	void arg(unsigned v){ add(UINT).u = v; }
+	void arg(unsigned long v){ add(UINT).u = v; }
+	void arg(unsigned long long v){ add(UINT).u = v; }
+	void arg(double v){ add(FLOAT).f = v; }
+	void arg(const char * v){ add(STRING).s = v; }
+	void arg(const void * v){ add(POINTER).p = v; }
+
+private:
+	Arg& add(Type t){ types[numArgs] = t; return args[numArgs++]; }
+};
+
+/// Queue a message for printing, returning false if the queue is full
+
+/// This is used by errRT() and warnRT().
+bool logPush(const LogRecord& r);
+
+/// Queue an error message from a real-time thread
+
+/// The message is formatted as by printf with up to LogRecord::MAX_ARGS
+/// numeric, string or pointer arguments. It is printed to stderr later by
+/// the thread started with logStart() or by a call to logFlush(), and when
+/// the program exits. This never locks, allocates or makes system calls, so
+/// it is safe to call from an audio callback. Unlike err(), it never exits.
+/// \returns false if the queue was full and the message was dropped
+template <class... Args>
+bool errRT(const char * src, const char * fmt, const Args&... args);
+
+/// Queue a warning message from a real-time thread; see errRT()
+template <class... Args>
+bool warnRT(const char * src, const char * fmt, const Args&... args);
+
+/// Queue a fatal error message from a real-time thread
+
+/// This is like errRT(), but the thread printing the message then ends the
+/// program with std::_Exit(EXIT_FAILURE). Destructors and exit handlers are
+/// not run, as the real-time thread may still be running.
+template <class... Args>
+bool fatalRT(const char * src, const char * fmt, const Args&... args);
+
+/// Start thread printing queued messages to stderr
+
+/// Calling this again only changes the polling period.
+/// \param[in] period	seconds between checks for messages
+void logStart(double period=0.05);
+
+/// Print queued messages from the calling thread, returning how many
+
+/// If a message was queued by fatalRT(), this exits after printing it.
+unsigned logFlush(FILE * fp=stderr);
+
+/// Get number of messages dropped because the queue was full
+unsigned logDropped();
+
+
 
 
 // Implementation
@@ -76,6 +151,35 @@ void print2D(T* pix, unsigned nx, unsigned ny, FILE * fp){
 	}
 }
 
+template <class... Args>
+bool logRT(bool error, bool fatal, const char * src, const char * fmt, const Args&... args){
+	static_assert(sizeof...(Args) <= LogRecord::MAX_ARGS, "too many arguments to log");
+	LogRecord r;
+	r.src = src;
+	r.fmt = fmt;
+	r.error = error;
+	r.fatal = fatal;
+	r.numArgs = 0;
+	int expand[] = {0, (r.arg(args), 0)...};
+	(void)expand;
+	return logPush(r);
+}
+
+template <class... Args>
+bool errRT(const char * src, const char * fmt, const Args&... args){
+	return logRT(true, false, src, fmt, args...);
+}
+
+template <class... Args>
+bool warnRT(const char * src, const char * fmt, const Args&... args){
+	return logRT(false, false, src, fmt, args...);
+}
+
+template <class... Args>
+bool fatalRT(const char * src, const char * fmt, const Args&... args){
+	return logRT(true, true, src, fmt, args...);
+}
+
 } // gam::
 
 #endif
@@ -0,0 +1,79 @@
+#ifndef GAMMA_RT_CHECK_H_INC
+#define GAMMA_RT_CHECK_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Detection of heap allocations and blocking locks on real-time threads
+*/
+
+namespace gam{
+
+/// Kind of operation not real-time safe
+enum RTViolation{
+	RT_ALLOC,	/**< Heap allocation (malloc, new, ...) */
+	RT_FREE,	/**< Heap deallocation (free, delete, ...) */
+	RT_LOCK,	/**< Blocking mutex lock */
+	RT_VIOLATIONS
+};
+
+/// Function called on a violation, on the violating thread
+typedef void (*RTViolationHandler)(RTViolation type, void * user);
+
+
+/// Marks calling thread as real-time over its lifetime
+
+/// AudioIO marks its audio callback and worker threads, and Scheduler marks
+/// update() and its worker threads. Scopes may be nested; a scope
+/// constructed with false unmarks the thread, for instance around an
+/// allocation known to happen only once.
+///
+/// When Gamma is built with the GAM_RT_CHECK flag (make RT_CHECK=1) on
+/// glibc, malloc, calloc, realloc, free, the aligned allocators (and so
+/// operator new and delete) and pthread_mutex_lock are intercepted, and
+/// calls made from a marked thread are reported. Otherwise only violations
+/// reported with rtViolation() are. Each report calls the handler, by
+/// default printing the call stack to stderr for the first few violations.
+class RTScope{
+public:
+	/// \param[in] realtime	whether to mark or unmark calling thread
+	explicit RTScope(bool realtime=true);
+	~RTScope();
+
+private:
+	bool mPrev;
+	RTScope(const RTScope&);
+	RTScope& operator=(const RTScope&);
+};
+
+/// Get whether calling thread is marked real-time
+bool rtThread();
+
+/// Report a violation if calling thread is marked real-time
+void rtViolation(RTViolation type);
+
+/// Get number of violations of a kind, on all threads
+unsigned long long rtViolations(RTViolation type);
+
+/// Get number of violations of all kinds, on all threads
+unsigned long long rtViolations();
+
+/// Zero violation counts
+void rtViolationsClear();
+
+/// Set function called on violations; NULL restores the default
+void rtViolationHandler(RTViolationHandler h, void * user=0);
+
+/// Print call stack of calling thread to stderr, if supported
+void rtPrintStack();
+
+/// Get whether allocations and locks are intercepted (built with GAM_RT_CHECK)
+bool rtCheckIntercepts();
+
+/// Get name of violation kind
+const char * rtViolationName(RTViolation type);
+
+} // gam::
+
+#endif
@@ -4,11 +4,18 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <atomic>
 #include <vector>
 
 namespace gam{
 
 /// Sound recorder
+
+/// This is a single-producer, single-consumer ring buffer of interleaved 
+/// frames. One (audio) thread writes and another (lower priority) thread 
+/// reads. When the buffer is full, newly written frames are dropped and 
+/// counted rather than overwriting unread frames. One frame of the buffer is
+/// kept free to tell a full buffer from an empty one.
 class Recorder {
 public:
 
@@ -23,18 +30,33 @@ public:
 	int channels() const { return mChans; }
 	
 	/// Get number of multi-channel recording frames
-	int frames() const { return size()/channels(); }
+	int frames() const { return channels() ? size()/channels() : 0; }
 
 	/// Get total number of samples (frames x channels) in buffer
 	int size() const { return mRing.size(); }
 
+	/// Get number of frames dropped because the buffer was full
+	unsigned dropped() const { return mDropped.load(std::memory_order_relaxed); }
+
 	/// Write sample into ring buffer without advancing write tap
 	void overwrite(float v, int chan){
-		mRing[mIW+chan] = v;
+		mRing[mIW.load(std::memory_order_relaxed)+chan] = v;
 	}
 
-	// Advance write tap by one frame
-	void advance(){ if((mIW+=channels()) >= (int)mRing.size()) mIW=0; }
+	/// Advance write tap by one frame
+
+	/// If the buffer is full, the frame is dropped and false is returned.
+	///
+	bool advance(){
+		int iw = mIW.load(std::memory_order_relaxed) + channels();
+		if(iw >= size()) iw = 0;
+		if(iw != mIR.load(std::memory_order_acquire)){
+			mIW.store(iw, std::memory_order_release);
+			return true;
+		}
+		mDropped.store(dropped()+1, std::memory_order_relaxed);
+		return false;
+	}
 
 	/// Write sample into ring buffer and advance write tap
 	void write(float v, int chan=0){
@@ -54,8 +76,29 @@ public:
 
 	/// \param[in] src			a block of channel-interleaved frames
 	/// \param[in] numFrames	number of frames to write
+	/// \returns number of frames written; the rest are dropped
 	int write(const float * src, int numFrames);
 
+	/// Get number of frames that can be written without dropping any
+	int writable() const;
+
+	/// Get unread frames without copying (from lower priority thread)
+
+	/// The unread frames are returned as up to two contiguous regions of
+	/// channel-interleaved frames; the second is non-empty only when the 
+	/// unread frames wrap around the end of the ring buffer. The frames
+	/// remain valid until passed to release().
+	///
+	/// \param[out] buf1		first region
+	/// \param[out] frames1		number of frames in first region
+	/// \param[out] buf2		second region
+	/// \param[out] frames2		number of frames in second region
+	/// \returns total number of unread frames
+	int peek(const float *& buf1, int& frames1, const float *& buf2, int& frames2) const;
+
+	/// Mark frames as read, making their space available to the writer
+	void release(int numFrames);
+
 	/// Empty buffer of most recently written samples
 
 	/// Returns number of frames copied to buffer. If the number of 
@@ -64,7 +107,7 @@ public:
 	/// This should be called from a lower priority thread.
 	int read(float *& buf);
 
-	/// Resize buffers
+	/// Resize buffers (not thread safe)
 	
 	/// \param[in] chans	number of channels
 	/// \param[in] frames	number of (multi-)channel frames
@@ -72,8 +115,9 @@ public:
 
 protected:
 	int mChans;	// no. of interleaved channels
-	int mIW;	// index of next sample to write
-	int mIR;	// start index for reading
+	std::atomic<int> mIW;	// index of next sample to write; set by writer
+	std::atomic<int> mIR;	// start index for reading; set by reader
+	std::atomic<unsigned> mDropped;	// set by writer
 	std::vector<float> mRing;
 	std::vector<float> mRead;
 };
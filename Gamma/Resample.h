@@ -0,0 +1,122 @@
+#ifndef GAMMA_RESAMPLE_H_INC
+#define GAMMA_RESAMPLE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Band-limited windowed-sinc interpolation and sample rate conversion
+*/
+
+#include <vector>
+
+namespace gam{
+
+/// Polyphase bank of windowed-sinc interpolation kernels
+
+/// This holds a Kaiser-windowed sinc kernel sampled at phases+1 fractional
+/// offsets between 0 and 1. A sample between two input samples is the dot
+/// product of the neighboring inputs with the kernel linearly interpolated
+/// between the two closest phases. The bank is computed once and is shared
+/// by all objects interpolating with the same parameters.
+///
+/// A cutoff below 1 scales the kernel for lowpass filtering below the
+/// Nyquist frequency, as needed when lowering the sample rate. The kernel
+/// is then stretched so it keeps the same number of zero crossings.
+///
+/// Memory is only allocated by the constructor.
+class SincBank{
+public:
+
+	/// Maximum number of taps on each side; kernels needing more are truncated
+	enum{ MAX_HALF = 64 };
+
+	/// \param[in] zeros	number of zero crossings on each side of center
+	/// \param[in] phases	number of fractional offsets kernels are computed at
+	/// \param[in] cutoff	cutoff frequency, as a fraction of Nyquist, in (0, 1]
+	SincBank(unsigned zeros=16, unsigned phases=256, float cutoff=0.92f);
+
+
+	/// Get shared bank with default parameters
+	static const SincBank& get();
+
+
+	/// Get number of taps, or inputs, on each side of the interpolated sample
+	unsigned half() const { return mHalf; }
+
+	/// Get number of taps of each kernel
+	unsigned taps() const { return 2*mHalf; }
+
+	/// Get number of fractional offsets
+	unsigned phases() const { return mPhases; }
+
+	/// Get cutoff frequency, as a fraction of Nyquist
+	float cutoff() const { return mCutoff; }
+
+	/// Get kernel closest below a fractional offset
+
+	/// \param[in]  frac	fractional offset in [0, 1)
+	/// \param[out] diff	difference to next kernel
+	/// \param[out] mix		amount of next kernel
+	/// \returns taps() coefficients applied to inputs src[1-half()] ... src[half()]
+	const float * kernel(double frac, const float *& diff, float& mix) const {
+		double p = frac * mPhases;
+		unsigned i = unsigned(p);
+		if(i >= mPhases) i = mPhases-1;
+		mix = float(p - i);
+		diff = &mDiff[i*mStride];
+		return &mRow[i*mStride];
+	}
+
+	/// Interpolate between inputs
+
+	/// \param[in] src		pointer to sample before interpolated point; inputs
+	///						src[1-half()] through src[half()] are read
+	/// \param[in] frac		fractional offset past src[0], in [0, 1)
+	float operator()(const float * src, double frac) const;
+
+	/// Interpolate between inputs of any type
+	template <class T>
+	T operator()(const T * src, double frac) const {
+		const float * d; float f;
+		const float * k = kernel(frac, d, f);
+		src += 1 - int(mHalf);
+		T sum = T(0);
+		for(unsigned i=0; i<taps(); ++i) sum += src[i] * (k[i] + f*d[i]);
+		return sum;
+	}
+
+private:
+	std::vector<float> mRow;	// kernels, one row of mStride per phase
+	std::vector<float> mDiff;	// differences between neighboring rows
+	unsigned mHalf, mPhases, mStride;
+	float mCutoff;
+};
+
+
+/// Convert sample rate of a buffer with windowed-sinc interpolation
+
+/// This resamples a whole buffer at once, for instance when loading a file
+/// recorded at a different rate than the session's. When lowering the rate
+/// the kernel cutoff is lowered by the same ratio to prevent aliasing.
+/// Inputs past either end are treated as zero.
+///
+/// \param[out] dst		output buffer
+/// \param[in]  dstLen	number of output samples
+/// \param[in]  src		input buffer
+/// \param[in]  srcLen	number of input samples
+/// \param[in]  ratio	ratio of output rate to input rate
+/// \param[in]  zeros	number of zero crossings on each side of kernel center
+void resample(
+	float * dst, unsigned dstLen, const float * src, unsigned srcLen,
+	double ratio, unsigned zeros=16
+);
+
+/// Get number of samples a buffer has after converting its rate
+inline unsigned resampleLength(unsigned srcLen, double ratio){
+	return unsigned(srcLen * ratio + 0.5);
+}
+
+} // gam::
+
+#endif
@@ -0,0 +1,378 @@
+#ifndef GAMMA_SAMPLECACHE_H_INC
+#define GAMMA_SAMPLECACHE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Shared, reference-counted cache of sound file samples
+*/
+
+#include <condition_variable>
+#include <deque>
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+#include "Gamma/ipl.h"
+#include "Gamma/SamplePlayer.h"
+#include "Gamma/SoundFile.h"
+#include "Gamma/Thread.h"
+
+#ifndef GAM_SAMPLE_CACHE_BUDGET
+#define GAM_SAMPLE_CACHE_BUDGET (256*1024*1024)
+#endif
+
+namespace gam{
+
+
+/// Cache of sound file samples shared between sample players
+
+/// Samples are keyed by file path and frame rate. Players given the same key
+/// reference a single deinterleaved buffer, so many voices playing one file
+/// cost one load and one copy in memory. Files can be requested ahead of
+/// time to be decoded on a background thread.
+///
+/// When the cached samples exceed the memory budget, the least recently used
+/// entries not referenced by any player are evicted.
+///
+/// Apart from the background loader, the cache must be accessed from the
+/// same thread that sets up the players (array reference counts are not
+/// thread-safe).
+///
+/// \tparam T	sample type
+/// \ingroup Containers
+template <class T = float>
+class SampleCache{
+public:
+
+	/// \param[in] budgetBytes	maximum memory, in bytes, of unreferenced samples to keep
+	explicit SampleCache(size_t budgetBytes = GAM_SAMPLE_CACHE_BUDGET);
+
+	~SampleCache();
+
+
+	/// Get process-wide cache
+	static SampleCache& get(){
+		static SampleCache * o = new SampleCache;
+		return *o;
+	}
+
+
+	/// Set memory budget, in bytes, evicting entries as needed
+	SampleCache& budget(size_t bytes){ mBudget = bytes; evict(); return *this; }
+
+	/// Get memory budget, in bytes
+	size_t budget() const { return mBudget; }
+
+	/// Get memory, in bytes, of samples held in the cache
+	size_t bytes() const;
+
+	/// Get number of cached entries, including any still loading
+	int size() const;
+
+
+	/// Request a file be loaded on the background thread
+
+	/// \param[in] path			path to sound file
+	/// \param[in] frameRate	frame rate to resample to or 0 to keep the file's rate
+	void request(const char * path, double frameRate = 0);
+
+	/// Whether samples are available without waiting
+	bool ready(const char * path, double frameRate = 0) const;
+
+	/// Set a player's buffer to cached samples
+
+	/// If the samples are not yet cached and 'wait' is true, then they are
+	/// loaded on the calling thread. If 'wait' is false, the file is requested
+	/// for background loading and the call returns immediately.
+	///
+	/// \param[out] player		player to set buffer of
+	/// \param[in] path			path to sound file
+	/// \param[in] frameRate	frame rate to resample to or 0 to keep the file's rate
+	/// \param[in] wait			whether to wait for samples to load
+	/// \returns whether the player's buffer was set
+	bool buffer(SamplePlayer<T>& player, const char * path, double frameRate = 0, bool wait = true);
+
+	/// Evict least recently used entries until within budget
+
+	/// Entries referenced by players are never evicted.
+	///
+	void evict();
+
+	/// Remove all entries not referenced by players
+	void clear();
+
+private:
+	enum State{ QUEUED, LOADING, LOADED, READY, FAILED };
+	typedef std::pair<std::string, double> Key;
+
+	struct Entry{
+		std::vector<T> interleaved;	// decoded by loader, pending deinterleaving
+		Array<T> samples;			// deinterleaved, shared with players
+		double frameRate = 0;
+		int channels = 1;
+		int frames = 0;
+		State state = QUEUED;
+		unsigned long long lastUse = 0;
+	};
+
+	typedef std::map<Key, Entry *> Entries;
+
+	Entries mEntries;
+	std::deque<Key> mQueue;
+	mutable std::mutex mMutex;
+	std::condition_variable mCond;
+	Thread mThread;
+	bool mRunning = false;
+	bool mStarted = false;
+	size_t mBudget;
+	size_t mBytes = 0;
+	unsigned long long mClock = 0;
+
+	Entry * find(const Key& k) const;
+	Entry * insert(const Key& k);
+	static bool decode(Entry& e, const Key& k);
+	void finish(Entry& e);
+	static void * cLoadFunc(void * user);
+
+	SampleCache(const SampleCache&);
+	SampleCache& operator=(const SampleCache&);
+};
+
+
+
+
+// Implementation_______________________________________________________________
+
+#define PRE template <class T>
+#define CLS SampleCache<T>
+
+PRE CLS::SampleCache(size_t budgetBytes)
+:	mBudget(budgetBytes)
+{}
+
+PRE CLS::~SampleCache(){
+	if(mStarted){
+		{	std::lock_guard<std::mutex> lock(mMutex);
+			mRunning = false;
+		}
+		mCond.notify_all();
+		mThread.join();
+	}
+	for(auto& kv : mEntries) delete kv.second;
+}
+
+PRE size_t CLS::bytes() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return mBytes;
+}
+
+PRE int CLS::size() const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	return int(mEntries.size());
+}
+
+PRE typename CLS::Entry * CLS::find(const Key& k) const {
+	auto it = mEntries.find(k);
+	return it != mEntries.end() ? it->second : NULL;
+}
+
+PRE typename CLS::Entry * CLS::insert(const Key& k){
+	Entry * e = new Entry;
+	mEntries[k] = e;
+	return e;
+}
+
+PRE void CLS::request(const char * path, double frameRate){
+	Key k(path, frameRate);
+	{	std::lock_guard<std::mutex> lock(mMutex);
+		if(find(k)) return;
+		insert(k);
+		mQueue.push_back(k);
+		if(!mStarted){
+			mRunning = mStarted = true;
+			mThread.start(cLoadFunc, this);
+		}
+	}
+	mCond.notify_one();
+}
+
+PRE bool CLS::ready(const char * path, double frameRate) const {
+	std::lock_guard<std::mutex> lock(mMutex);
+	Entry * e = find(Key(path, frameRate));
+	return e && (e->state == LOADED || e->state == READY);
+}
+
+PRE bool CLS::buffer(SamplePlayer<T>& player, const char * path, double frameRate, bool wait){
+	Key k(path, frameRate);
+	Entry * e;
+	bool loadHere = false;
+
+	{	std::unique_lock<std::mutex> lock(mMutex);
+		e = find(k);
+		if(!e){
+			if(!wait){
+				lock.unlock();
+				request(path, frameRate);
+				return false;
+			}
+			e = insert(k);
+		}
+
+		if(e->state == QUEUED && wait){
+			// Take load over from the background thread; it skips entries
+			// no longer queued.
+			e->state = LOADING;
+			loadHere = true;
+		}
+		else if(e->state == QUEUED || e->state == LOADING){
+			if(!wait) return false;
+			mCond.wait(lock, [e]{ return e->state != QUEUED && e->state != LOADING; });
+		}
+	}
+
+	if(loadHere){
+		bool ok = decode(*e, k);
+		std::lock_guard<std::mutex> lock(mMutex);
+		e->state = ok ? LOADED : FAILED;
+	}
+
+	if(e->state == FAILED){
+		{	std::lock_guard<std::mutex> lock(mMutex);
+			mEntries.erase(k);
+		}
+		delete e;
+		fprintf(stderr,
+			"gam::SampleCache: couldn't load sound file \"%s\"\n",
+			path);
+		return false;
+	}
+
+	if(e->state == LOADED) finish(*e);
+
+	e->lastUse = ++mClock;
+	player.buffer(e->samples, e->frameRate, e->channels);
+	evict();
+	return true;
+}
+
+PRE void CLS::finish(Entry& e){
+	// The loader no longer touches the samples of a loaded entry
+	e.samples.resize(e.frames * e.channels);
+	if(e.samples.size()){
+		if(1 == e.channels)
+			mem::deepCopy(e.samples.elems(), &e.interleaved[0], e.frames);
+		else
+			mem::deinterleave(e.samples.elems(), &e.interleaved[0], e.frames, e.channels);
+	}
+	std::vector<T>().swap(e.interleaved);
+	std::lock_guard<std::mutex> lock(mMutex);
+	mBytes += e.samples.size() * sizeof(T);
+	e.state = READY;
+}
+
+PRE void CLS::evict(){
+	std::lock_guard<std::mutex> lock(mMutex);
+	while(mBytes > mBudget){
+		typename Entries::iterator lru = mEntries.end();
+		for(auto it = mEntries.begin(); it != mEntries.end(); ++it){
+			Entry& e = *it->second;
+			if(e.state == READY && e.samples.isSoleOwner()
+				&& (lru == mEntries.end() || e.lastUse < lru->second->lastUse)
+			){
+				lru = it;
+			}
+		}
+		if(lru == mEntries.end()) break; // everything is in use
+		mBytes -= lru->second->samples.size() * sizeof(T);
+		delete lru->second;
+		mEntries.erase(lru);
+	}
+}
+
+PRE void CLS::clear(){
+	size_t b = mBudget;
+	mBudget = 0;
+	evict();
+	mBudget = b;
+}
+
+PRE bool CLS::decode(Entry& e, const Key& k){
+	SoundFile sf(k.first);
+	if(!sf.openRead()) return false;
+
+	std::vector<T> buf;
+	int chans = sf.channels();
+	int frames = sf.frames();
+	double srcRate = sf.frameRate();
+	sf.readAll(buf);
+	sf.close();
+	buf.resize(frames * chans);
+
+	double dstRate = k.second > 0 ? k.second : srcRate;
+
+	if(dstRate != srcRate && frames > 1){
+		// Resample each channel with cubic interpolation
+		double step = srcRate / dstRate;
+		int dstFrames = int((frames - 1) / step) + 1;
+		e.interleaved.resize(dstFrames * chans);
+		const T * s = &buf[0];
+		for(int i=0; i<dstFrames; ++i){
+			double pos = i * step;
+			int i1 = int(pos);
+			double f = pos - i1;
+			int i0 = i1>0 ? i1-1 : 0;
+			int i2 = i1+1<frames ? i1+1 : frames-1;
+			int i3 = i1+2<frames ? i1+2 : frames-1;
+			for(int c=0; c<chans; ++c){
+				e.interleaved[i*chans + c] = T(ipl::cubic(f,
+					double(s[i0*chans+c]), double(s[i1*chans+c]),
+					double(s[i2*chans+c]), double(s[i3*chans+c])
+				));
+			}
+		}
+		frames = dstFrames;
+	}
+	else{
+		e.interleaved.swap(buf);
+	}
+
+	e.frameRate = dstRate;
+	e.channels = chans;
+	e.frames = frames;
+	return true;
+}
+
+PRE void * CLS::cLoadFunc(void * user){
+	CLS& c = *static_cast<CLS *>(user);
+	std::unique_lock<std::mutex> lock(c.mMutex);
+
+	while(true){
+		c.mCond.wait(lock, [&c]{ return !c.mRunning || !c.mQueue.empty(); });
+		if(!c.mRunning) break;
+
+		Key k = c.mQueue.front();
+		c.mQueue.pop_front();
+
+		Entry * e = c.find(k);
+		if(!e || e->state != QUEUED) continue;
+		e->state = LOADING;
+
+		lock.unlock();
+		bool ok = decode(*e, k);
+		lock.lock();
+
+		e->state = ok ? LOADED : FAILED;
+		c.mCond.notify_all();
+	}
+	return NULL;
+}
+
+#undef PRE
+#undef CLS
+
+} // gam::
+
+#endif
@@ -5,15 +5,258 @@
 	See COPYRIGHT file for authors and license information */
 
 #include <stdio.h>
+#include <atomic>
+#include <memory>	// shared_ptr
+#include <string>
+#include <thread>	// hardware_concurrency
+#include <type_traits>
+#include <vector>
 #include "Gamma/Containers.h"	// Array
+#include "Gamma/Conversion.h"	// ComputeType
 #include "Gamma/ipl.h"
+#include "Gamma/Resample.h"
 #include "Gamma/scl.h"
 #include "Gamma/SoundFile.h"
 #include "Gamma/Strategy.h"
 #include "Gamma/Domain.h"
+#include "Gamma/Thread.h"
+#include "Gamma/Timer.h"
 
 namespace gam{
 
+/// Streams deinterleaved frames of a sound file from disk
+
+/// The first frames of the file, the head, are kept in memory by the owner.
+/// The remaining frames are split into windows of equal length. A prefetch
+/// thread reads windows into one of two buffers, while the audio thread 
+/// reads from the other and requests the next window in the direction of 
+/// playback. Buffers are handed over between threads without locks.
+///
+/// \tparam T	Value (sample) type; storage types are read from file as float
+template <class T>
+class SampleStream{
+public:
+	typedef typename ComputeType<T>::type Tv;
+
+	enum{ MARGIN = 4 };	// extra frames on each side of a window for interpolation
+
+	SampleStream();
+	~SampleStream(){ close(); }
+
+	/// Open sound file, read its head and start prefetch thread
+
+	/// \param[in]  path			path to sound file
+	/// \param[in]  headFrames		number of frames to keep in memory
+	/// \param[in]  windowFrames	number of frames in each streamed window
+	/// \param[out] head			deinterleaved samples of head
+	/// \returns whether the sound file was opened
+	bool open(const char * path, int headFrames, int windowFrames, Array<T>& head);
+
+	/// Stop prefetch thread and close sound file
+	void close();
+
+	int frames() const { return mFrames; }				///< Get number of frames in file
+	int channels() const { return mChans; }				///< Get number of channels
+	double frameRate() const { return mFrameRate; }		///< Get frame rate of file
+	int headFrames() const { return mHead; }			///< Get number of frames in head
+	int windowFrames() const { return mWindow; }		///< Get number of frames in a window
+	unsigned underruns() const { return mUnderruns; }	///< Get number of reads of frames not yet loaded
+
+	/// Get first frame index not read from the head by a player
+	int headEnd() const { return mHead < mFrames ? mHead - 2 : mFrames; }
+
+	/// Get buffer holding a frame (audio thread only)
+
+	/// \param[in]  frame	frame index
+	/// \param[in]  dir		direction of playback, +1 or -1
+	/// \param[out] base	frame index of first sample in buffer
+	/// \param[out] stride	number of samples per channel in buffer
+	/// \returns deinterleaved buffer or NULL if the frame is not loaded yet
+	const T * window(int frame, int dir, int& base, int& stride);
+
+private:
+	SoundFile mFile;			// used by prefetch thread after open
+	std::vector<T> mBuf[2];		// deinterleaved windows with margins
+	std::vector<Tv> mScratch;	// interleaved frames read from file
+	std::atomic<int> mStart[2];	// first frame of window in buffers; -1 if invalid
+	std::atomic<int> mUse;		// buffer read by audio thread
+	std::atomic<int> mLoad;		// buffer being filled by prefetch thread
+	std::atomic<int> mReq;		// requested window start; -1 if none
+	std::atomic<bool> mRunning;
+	Thread mThread;
+	double mFrameRate;
+	int mFrames, mChans, mHead, mWindow;
+
+	// Audio thread state
+	int mCur, mCurStart, mLastReq;
+	unsigned mUnderruns;
+
+	bool claim(int start);
+	void request(int start){ mLastReq = start; mReq.store(start, std::memory_order_release); }
+	void fill(int buf, int start);
+	static void * cPrefetchFunc(void * user);
+};
+
+
+namespace{
+
+	// Read all samples of a file, deinterleaved unless 'inter'
+	template <class T>
+	int readSamples(SoundFile& sf, T * dst, bool inter, std::true_type){
+		return inter ? sf.readAll(dst) : sf.readAllD(dst);
+	}
+
+	// Read all samples of a file into a storage type, converting from float
+	template <class T>
+	int readSamples(SoundFile& sf, T * dst, bool inter, std::false_type){
+		const int chans = sf.channels(), frames = sf.frames(), N = 4096;
+		std::vector<float> buf(N * chans);
+		sf.seek(0, SEEK_SET);
+		int done = 0;
+		while(done < frames){
+			const int n = sf.read(&buf[0], frames-done < N ? frames-done : N);
+			if(n <= 0) break;
+			if(inter){
+				T * d = dst + done*chans;
+				for(int i=0; i<n*chans; ++i) d[i] = T(buf[i]);
+			}
+			else for(int c=0; c<chans; ++c){
+				T * d = dst + c*frames + done;
+				for(int i=0; i<n; ++i) d[i] = T(buf[i*chans + c]);
+			}
+			done += n;
+		}
+		return done;
+	}
+
+	// Get samples of a file mapping as T or NULL if they are not
+	template <class T>
+	T * mappedSamples(const SoundFileMap& m){ return m.template data<T>(); }
+
+	template <>
+	inline Sample16 * mappedSamples<Sample16>(const SoundFileMap& m){
+		return reinterpret_cast<Sample16 *>(m.data<short>());
+	}
+
+	template <>
+	inline Half * mappedSamples<Half>(const SoundFileMap&){ return 0; }
+
+	// Read all samples of a sound file into an array, deinterleaved unless 'inter'
+	template <class T>
+	bool loadSamples(const char * path, Array<T>& dst, double& frmRate, int& chans, bool inter=false){
+		SoundFile sf(path);
+		if(!sf.openRead()) return false;
+		dst.resize(sf.samples());
+		readSamples(sf, dst.elems(), inter, std::is_same<T, typename ComputeType<T>::type>());
+		frmRate = sf.frameRate();
+		chans = sf.channels();
+		sf.close();
+		return true;
+	}
+
+	// Band-limit and resample channels into a new array of the same layout
+	template <class T>
+	void resampleSamples(Array<T>& dst, const T * src, unsigned srcFrames, int chans, double ratio, bool inter=false){
+		const unsigned dstFrames = resampleLength(srcFrames, ratio);
+		std::vector<float> x(srcFrames), y(dstFrames);
+		Array<T> out(dstFrames * chans);
+		// Stride between frames and offset between channels
+		const unsigned srcStr = inter ? chans : 1, srcOff = inter ? 1 : srcFrames;
+		const unsigned dstStr = inter ? chans : 1, dstOff = inter ? 1 : dstFrames;
+		for(int c=0; c<chans; ++c){
+			for(unsigned i=0; i<srcFrames; ++i) x[i] = float(src[srcOff*c + srcStr*i]);
+			gam::resample(dstFrames ? &y[0] : 0, dstFrames, srcFrames ? &x[0] : 0, srcFrames, ratio);
+			for(unsigned i=0; i<dstFrames; ++i) out[dstOff*c + dstStr*i] = T(y[i]);
+		}
+		dst = std::move(out);
+	}
+
+	// Number of frames on each side of a read used by an interpolation strategy
+	template <class Ipl>
+	int iplReach(const Ipl&){ return 2; }
+
+	template <class Tv>
+	int iplReach(const ipl::Sinc<Tv>& s){ return s.bank().half(); }
+
+	// Interpolate n channels of interleaved frames at frame i plus fraction f,
+	// wrapping neighbors within frames [0, last]. Other strategies than the
+	// ones below read through a window gathered for each channel.
+	template <class Ipl, class T, class Tv>
+	void iplFrame(const Ipl& s, Tv * dst, const T * src, int chans, int n, int i, double f, int last){
+		Tv w[ipl::Sinc<Tv>::MAX_TAPS];
+		const int H = iplReach(s), N = last+1;
+		for(int c=0; c<n; ++c){
+			for(int k=0; k<2*H; ++k){
+				const int j = ((i-H+1+k) % N + N) % N;
+				w[k] = Tv(src[j*chans + c]);
+			}
+			dst[c] = s(w, H-1, f, 2*H-1);
+		}
+	}
+
+	template <class T, class Tv>
+	void iplFrame(const ipl::Trunc<Tv>&, Tv * dst, const T * src, int chans, int n, int i, double, int){
+		const T * s0 = src + i*chans;
+		for(int c=0; c<n; ++c) dst[c] = Tv(s0[c]);
+	}
+
+	template <class T, class Tv>
+	void iplFrame(const ipl::Round<Tv>&, Tv * dst, const T * src, int chans, int n, int i, double f, int last){
+		const T * s0 = src + i*chans;
+		const T * s1 = src + acc::Wrap::mapP1(i+1, last, 0)*chans;
+		for(int c=0; c<n; ++c) dst[c] = ipl::nearest(f, Tv(s0[c]), Tv(s1[c]));
+	}
+
+	template <class T, class Tv>
+	void iplFrame(const ipl::Linear<Tv>&, Tv * dst, const T * src, int chans, int n, int i, double f, int last){
+		const T * s0 = src + i*chans;
+		const T * s1 = src + acc::Wrap::mapP1(i+1, last, 0)*chans;
+		for(int c=0; c<n; ++c) dst[c] = ipl::linear(f, Tv(s0[c]), Tv(s1[c]));
+	}
+
+	template <class T, class Tv>
+	void iplFrame(const ipl::Cubic<Tv>&, Tv * dst, const T * src, int chans, int n, int i, double f, int last){
+		const T * sm1= src + acc::Wrap::mapM1(i-1, last, 0)*chans;
+		const T * s0 = src + i*chans;
+		const T * s1 = src + acc::Wrap::mapP1(i+1, last, 0)*chans;
+		const T * s2 = src + acc::Wrap::map  (i+2, last, 0)*chans;
+		for(int c=0; c<n; ++c) dst[c] = ipl::cubic(f, Tv(sm1[c]), Tv(s0[c]), Tv(s1[c]), Tv(s2[c]));
+	}
+
+	// Reads interleaved frames with the strategy resolved by ipl::apply
+	template <class T, class Tv>
+	struct FrameRead{
+		Tv * dst; const T * src; int chans, n, i; double f; int last;
+
+		template <class Ipl>
+		void operator()(const Ipl& s) const { iplFrame(s, dst, src, chans, n, i, f, last); }
+	};
+
+	// Interpolate at a stream of positions with the block kernels of a
+	// strategy (see ipl::linear); returns false for strategies without them
+	template <class Ipl, class T, class Tv>
+	bool iplBlock(const Ipl&, Tv *, const T *, const index_t *, const float *, unsigned){ return false; }
+
+	template <class T, class Tv>
+	bool iplBlock(const ipl::Linear<Tv>& s, Tv * dst, const T * src, const index_t * idx, const float * frac, unsigned n){
+		s(dst, src, idx, frac, n); return true;
+	}
+
+	template <class T, class Tv>
+	bool iplBlock(const ipl::Cubic<Tv>& s, Tv * dst, const T * src, const index_t * idx, const float * frac, unsigned n){
+		s(dst, src, idx, frac, n); return true;
+	}
+
+	// Reads a stream of positions with the strategy resolved by ipl::apply
+	template <class T, class Tv>
+	struct BlockRead{
+		Tv * dst; const T * src; const index_t * idx; const float * frac; unsigned n; bool * done;
+
+		template <class Ipl>
+		void operator()(const Ipl& s) const { *done = iplBlock(s, dst, src, idx, frac, n); }
+	};
+}
+
 /// Sample buffer player
 
 /// This streams a sequence of frames from a n-channel buffer according to a 
@@ -22,6 +265,15 @@ namespace gam{
 ///	The number of frames in the sample should not exceed 2^32. This equates
 ///	to 27 hours at 44.1 kHz.
 ///
+/// Samples can be kept in a storage type, Sample16 or Half, to halve the
+/// memory and bandwidth of float samples. They are converted to float as
+/// they are interpolated, so reads return float.
+///
+/// Multichannel samples are stored deinterleaved by default. They can
+/// instead be stored as interleaved frames, see interleaved(), so that the
+/// channels of a frame and its neighbors are adjacent in memory and
+/// readFrame() interpolates them together.
+///
 /// \tparam T	Value (sample) type
 /// \tparam Si	Interpolation strategy
 /// \tparam Sp	Phase increment strategy
@@ -35,6 +287,8 @@ public:
 	using Array<T>::size;
 	using Array<T>::elems;
 
+	typedef typename ComputeType<T>::type Tv;	///< Type of samples read
+
 
 	SamplePlayer();
 
@@ -54,19 +308,71 @@ public:
 
 	/// Load a sound file into internal sample buffer
 	
+	/// \param[in] pathToSoundFile	Path to sound file
+	/// \param[in] frmRate			Frame rate to convert samples to, with
+	///								resample(), or 0 to keep the file's rate
+	/// \param[in] interleave		Whether to store frames interleaved
 	/// \returns whether the sound file loaded properly
-	///
-	bool load(const char * pathToSoundFile);
+	bool load(const char * pathToSoundFile, double frmRate=0, bool interleave=false);
+
+	/// Stream a sound file from disk
+
+	/// Only the first 'headFrames' frames are loaded into the internal buffer.
+	/// The rest are read on a prefetch thread in windows of 'windowFrames'
+	/// frames ahead of the playback position. Reads of frames that are not
+	/// loaded in time return zero and are counted by stream()->underruns().
+	/// A window should hold more frames than are played in one audio block.
+	/// Copies of this player share the stream, so they should not play at 
+	/// the same time.
+	/// \returns whether the sound file opened properly
+	bool stream(const char * pathToSoundFile, int headFrames=65536, int windowFrames=65536);
+
+	/// Get sound file stream or NULL if not streaming
+	const SampleStream<T> * stream() const { return mStream.get(); }
+
+	/// Play samples directly from a memory-mapped sound file
+
+	/// This plays from the page cache without loading or decoding. It works 
+	/// for mono WAV files with samples of the player's type: 32-bit float
+	/// for float or 16-bit integer for short or Sample16. Since the player needs 
+	/// deinterleaved samples, multichannel files must be loaded instead.
+	/// \returns whether the sound file mapped properly
+	bool map(const char * pathToSoundFile, SoundFileMap::Access access = SoundFileMap::SEQUENTIAL);
 
 
 	/// Increment read tap
 	void advance();
 
+	/// Increment read tap a number of frames at once
+
+	/// The position is jumped in constant time, e.g., to skip ahead when 
+	/// starting playback part way through a render. Looping, one-shot, n-shot
+	/// and ping-pong strategies end where n calls of advance() would.
+	void advance(uint64_t n);
+
 	/// Returns sample at current position on specified channel and increments phase
-	T operator()(int channel=0);
+	Tv operator()(int channel=0);
+
+	/// Generate samples of a channel, incrementing phase after each
+
+	/// This gives the same samples as calling operator()(channel) n times.
+	/// With linear or cubic interpolation, samples in memory are interpolated
+	/// a block at a time by the SIMD kernels of ipl::linear and ipl::cubic,
+	/// which also convert Sample16 and Half. Other strategies, streamed and
+	/// interleaved samples, and reads whose neighbors wrap around the ends of
+	/// the buffer are interpolated one at a time.
+	/// \param[out] dst		n samples
+	/// \param[in] n			number of samples
+	/// \param[in] channel	channel to read
+	void operator()(Tv * dst, unsigned n, int channel=0);
 
 	/// Returns sample at current position on specified channel (without incrementing phase)
-	T read(int channel) const;
+	Tv read(int channel) const;
+
+	/// Read all channels at current position (without incrementing phase)
+
+	/// \param[out] dst	channels() samples of frame
+	void readFrame(Tv * dst) const;
 
 	/// Set sample buffer reference
 	
@@ -77,6 +383,24 @@ public:
 	/// \param[in] chans	Number of channels in sample buffer
 	void buffer(Array<T>& src, double frmRate, int chans);
 
+	/// Set sample buffer by taking over an array
+
+	/// The array elements become owned by this player without being copied.
+	///
+	/// \param[in] src		Sample buffer (if multichannel, must be deinterleaved)
+	/// \param[in] frmRate	Frame rate of sample buffer
+	/// \param[in] chans	Number of channels in sample buffer
+	void buffer(Array<T>&& src, double frmRate, int chans);
+
+	/// Set sample buffer reference
+
+	/// The viewed memory must persist as long as it is used by this player.
+	///
+	/// \param[in] src		View of samples (if multichannel, must be deinterleaved)
+	/// \param[in] frmRate	Frame rate of sample buffer
+	/// \param[in] chans	Number of channels in sample buffer
+	void buffer(ArrayView<T> src, double frmRate, int chans);
+
 	/// Set sample buffer reference
 	
 	/// \param[in] src		C array of samples (if multichannel, must be deinterleaved)
@@ -93,6 +417,30 @@ public:
 	///						samples, sample rate, and channel count
 	void buffer(SamplePlayer& src);
 
+	/// Convert frames to another frame rate
+
+	/// This replaces the buffer with one holding the frames band-limited and
+	/// resampled to the new rate, for instance the rate of the audio domain.
+	/// Players sharing the old buffer keep it. Streamed and memory-mapped
+	/// files cannot be converted. This allocates memory and so should not be
+	/// called on the audio thread.
+	/// \param[in] frmRate	new frame rate
+	void resample(double frmRate);
+
+	/// Set whether frames are stored interleaved
+
+	/// This converts the buffer between deinterleaved and interleaved frames.
+	/// As with resample(), players sharing the old buffer keep it and this
+	/// allocates memory. Buffers set by buffer() are taken as deinterleaved.
+	/// Streamed files and memory-mapped files are read in place and keep
+	/// their layout; mapped files are mono, which has the same layout either
+	/// way.
+	/// \returns whether frames are now stored as requested
+	bool interleaved(bool v);
+
+	/// Get whether frames are stored interleaved
+	bool interleaved() const { return mInterleaved; }
+
 	void free();							///< Free sample buffer (if owner)
 
 	void freq(double v){ rate(v); }			///< Set frequency if sample buffer is a wavetable
@@ -124,7 +472,7 @@ public:
 	bool done() const;
 
 	int channels() const { return mChans; }	///< Get number of channels
-	int frames() const { return size()/channels(); } ///< Get number of frames (samples divided by channels)
+	int frames() const { return mStream ? mStream->frames() : size()/channels(); } ///< Get number of frames (samples divided by channels)
 	double frameRate() const { return mFrameRate; } ///< Get frame rate of sample buffer
 	double freq() const { return rate(); }	///< Get frequency if sample buffer is a wavetable
 	double max() const { return mMax; }		///< Get playback interval maximum frame (open)
@@ -139,7 +487,7 @@ public:
 	void onDomainChange(double r){ frameRate(mFrameRate); }
 
 protected:
-	Si<T> mIpol;
+	Si<Tv> mIpol;
 	Sp mPhsInc;
 
 	double mPos, mInc;			// real index position and increment
@@ -147,15 +495,130 @@ protected:
 	int mChans;					// number of channels
 	double mRate;				// playback rate factor
 	double mMin, mMax;			// [min, max) playback interval, in frames
+	bool mInterleaved;			// whether frames are interleaved in buffer
+	std::shared_ptr<SampleStream<T> > mStream;	// frames after head, if streaming
+	std::shared_ptr<SoundFileMap> mMap;			// file mapping of samples, if mapped
 	
 	void frameRate(double v){
 		mFrameRate = v;
 		rate(mRate);
 	}
 
+	// Get number of frames in internal buffer
+	int framesInBuffer() const { return size()/channels(); }
+
 	T& sample(int idx, int chan){
-		return (*this)[frames()*chan + idx];
+		return mInterleaved ? (*this)[channels()*idx + chan] : (*this)[framesInBuffer()*chan + idx];
 	}
+
+	Tv readStream(int posi, int channel) const;
+};
+
+
+/// Sound files loaded in parallel into shared sample buffers
+
+/// Files are decoded by a pool of threads, so a large library loads in a
+/// fraction of the time of calling SamplePlayer::load for each file. Loading
+/// runs in the background while players already use the library: a player
+/// assigned a sample that has not finished loading plays a silent
+/// placeholder, so playback can start at once. Loaded samples are shared
+/// with players without copying and are kept until the library is
+/// destroyed.
+///
+/// \code
+///	SampleLibrary<> lib;
+///	lib.load(paths);
+///	while(!lib.done()){ printf("%3.0f%%\r", lib.progress()*100); sleepSec(0.1); }
+///	...
+///	lib.assign(player, 17);	// from any thread, e.g. on note-on
+/// \endcode
+///
+/// \tparam T	Value (sample) type
+template <class T = float>
+class SampleLibrary{
+public:
+
+	/// \param[in] capacity	maximum number of samples
+	/// \param[in] threads		number of loading threads; if 0, one per core
+	explicit SampleLibrary(unsigned capacity=4096, unsigned threads=0);
+
+	/// Stops loading; samples assigned to players remain valid
+	~SampleLibrary();
+
+
+	/// Start loading sound files
+
+	/// This returns immediately; files are loaded on background threads in
+	/// the order given. It may be called while earlier files are loading,
+	/// but only from one thread at a time. Each file is converted to
+	/// the frame rate 'frmRate' unless it is 0.
+	/// \returns index of first file or capacity() if the paths do not fit
+	unsigned load(const std::vector<std::string>& paths, double frmRate=0);
+
+	/// Start loading a sound file
+
+	/// \returns index of file or capacity() if the library is full
+	unsigned load(const char * path, double frmRate=0);
+
+	/// Block until all files started loading are finished
+	void wait();
+
+
+	/// Set player to play a sample
+
+	/// If the sample has not finished loading or failed to load, the player
+	/// is given a silent placeholder. This does not allocate, so it can be
+	/// called from the audio thread.
+	/// \returns whether the sample is loaded
+	template <template<class> class Si, class Sp>
+	bool assign(SamplePlayer<T,Si,Sp>& player, unsigned i);
+
+	/// Get whether a sample has finished loading successfully
+	bool ready(unsigned i) const { return i < size() && READY == mEntries[i]->state.load(std::memory_order_acquire); }
+
+	/// Get whether a sample failed to load
+	bool failed(unsigned i) const { return i < size() && FAILED == mEntries[i]->state.load(std::memory_order_acquire); }
+
+	/// Get path of a sample
+	const char * path(unsigned i) const { return i < size() ? mEntries[i]->path.c_str() : ""; }
+
+	unsigned size() const { return mSize.load(std::memory_order_acquire); }	///< Get number of files started loading
+	unsigned capacity() const { return mEntries.size(); }	///< Get maximum number of files
+	unsigned loaded() const { return mLoaded.load(std::memory_order_acquire); }	///< Get number of files finished loading or failed
+	unsigned failures() const { return mFailures.load(std::memory_order_relaxed); }	///< Get number of files that failed to load
+	bool done() const { return loaded() == size(); }		///< Get whether all files are finished
+
+	/// Get fraction of files finished, in [0, 1]
+	double progress() const { return size() ? double(loaded())/size() : 1.; }
+
+private:
+	enum{ PENDING=0, READY, FAILED };
+
+	struct Entry{
+		std::string path;
+		double targetRate;		// frame rate to convert to, or 0
+		Array<T> data;			// written by loader before state is READY
+		double frameRate;
+		int channels;
+		std::atomic<int> state;
+	};
+
+	std::vector<Entry *> mEntries;	// preallocated so readers never see reallocation
+	std::atomic<unsigned> mSize;	// entries published for loading
+	std::atomic<unsigned> mNext;	// next entry to be claimed by a loader
+	std::atomic<unsigned> mLoaded;
+	std::atomic<unsigned> mFailures;
+	std::atomic<bool> mRunning;
+	std::atomic<unsigned> mActive;	// loaders running
+	std::vector<Thread *> mThreads;
+	unsigned mMaxThreads;
+	Array<T> mSilence;
+
+	void startThreads();
+	static void * cLoadFunc(void * user);
+
+	SampleLibrary(const SampleLibrary&);
+	SampleLibrary& operator=(const SampleLibrary&);
 };
 
 
@@ -167,43 +630,40 @@ PRE CLS::SamplePlayer()
 :	Array<T>(defaultArray<T>(), 1),
 	mPos(0), mInc(0),
 	mFrameRate(1), mChans(1),
-	mRate(1), mMin(0), mMax(1)
+	mRate(1), mMin(0), mMax(1), mInterleaved(false)
 {}
 
 
 PRE CLS::SamplePlayer(SamplePlayer<T>& src, double rate)
-:	mPos(0), mInc(1), mRate(rate)
+:	mPos(0), mInc(1), mRate(rate), mInterleaved(false)
 {
 	buffer(src);
 }
 
 PRE CLS::SamplePlayer(Array<T>& src, double smpRate, double rate)
-:	mPos(0), mInc(1), mRate(rate)
+:	mPos(0), mInc(1), mRate(rate), mInterleaved(false)
 {
 	buffer(src, smpRate, 1);
 }
 
 
 PRE CLS::SamplePlayer(const char * path, double rate)
-:	Array<T>(), mPos(0), mInc(1), mChans(1), mRate(rate), mMin(0), mMax(1)
+:	Array<T>(), mPos(0), mInc(1), mChans(1), mRate(rate), mMin(0), mMax(1), mInterleaved(false)
 {	
 	if(!load(path)){
 		this->source(defaultArray<T>(), 1);
 	}
 }
 
-PRE bool CLS::load(const char * pathToSoundFile){
-	SoundFile sf(pathToSoundFile);
-	
-	if(sf.openRead()){
-		Array<T>::resize(sf.samples());
-		sf.readAllD(elems());
-		frameRate(sf.frameRate());
-		mChans = sf.channels();
-		mMin = 0;
-		mMax = frames();
-		mPos = 0;
-		sf.close();
+PRE bool CLS::load(const char * pathToSoundFile, double frmRate, bool interleave){
+	Array<T> data;
+	double fileRate;
+	int chans;
+
+	if(loadSamples(pathToSoundFile, data, fileRate, chans, interleave)){
+		buffer(std::move(data), fileRate, chans);
+		mInterleaved = interleave;
+		if(frmRate > 0.) resample(frmRate);
 		return true;
 	}
 
@@ -219,40 +679,211 @@ PRE inline void CLS::advance(){
 	mPos = mPhsInc(pos(), mInc, max(), min()); // update read position, in frames
 }
 
-PRE inline T CLS::operator()(int channel){
-	T r = read(channel);
+PRE inline void CLS::advance(uint64_t n){
+	mPos = mPhsInc.skip(pos(), mInc, n, max(), min());
+}
+
+PRE inline typename CLS::Tv CLS::operator()(int channel){
+	Tv r = read(channel);
 	advance();
 	return r;
 }
 
-PRE inline T CLS::read(int channel) const {
+PRE void CLS::operator()(Tv * dst, unsigned n, int channel){
+	const int N = framesInBuffer();
+	bool block = false;
+	if(!mStream && !mInterleaved && N >= 4){
+		const BlockRead<T,Tv> probe = {dst, elems(), 0, 0, 0, &block};
+		ipl::apply(mIpol, probe);
+	}
+	if(!block){
+		for(unsigned i=0; i<n; ++i) dst[i] = (*this)(channel);
+		return;
+	}
+
+	enum{ M = 64 };
+	index_t idx[M]; float frac[M];
+	unsigned wrap[M]; Tv wrapped[M];
+	const int offset = channel*N;
+	while(n){
+		const unsigned m = n < unsigned(M) ? n : unsigned(M);
+		unsigned nw = 0;
+		for(unsigned i=0; i<m; ++i){
+			const int posi = int(pos());
+			if(posi >= 1 && posi < N-2){
+				idx[i] = posi + offset;
+				frac[i] = float(pos() - posi);
+			}
+			else{	// neighbors wrap, so read at an in-bounds dummy position
+				idx[i] = offset + 1;
+				frac[i] = 0.f;
+				wrap[nw] = i;
+				wrapped[nw++] = read(channel);
+			}
+			advance();
+		}
+		const BlockRead<T,Tv> r = {dst, elems(), idx, frac, m, &block};
+		ipl::apply(mIpol, r);
+		for(unsigned k=0; k<nw; ++k) dst[wrap[k]] = wrapped[k];
+		dst += m;
+		n -= m;
+	}
+}
+
+PRE bool CLS::stream(const char * pathToSoundFile, int headFrames, int windowFrames){
+	std::shared_ptr<SampleStream<T> > s(new SampleStream<T>);
+
+	if(s->open(pathToSoundFile, headFrames, windowFrames, *this)){
+		mStream = s;
+		frameRate(s->frameRate());
+		mChans = s->channels();
+		mMin = 0;
+		mMax = frames();
+		mPos = 0;
+		return true;
+	}
+
+	fprintf(stderr, 
+		"gam::SamplePlayer: couldn't stream sound file \"%s\"\n",
+		pathToSoundFile);
+
+	return false;
+}
+
+PRE bool CLS::map(const char * pathToSoundFile, SoundFileMap::Access access){
+	std::shared_ptr<SoundFileMap> m(new SoundFileMap);
+
+	if(m->open(pathToSoundFile, access)){
+		T * data = mappedSamples<T>(*m);
+		if(1 == m->channels() && data){
+			buffer(data, m->frames(), m->frameRate(), 1);
+			mMap = m;
+			return true;
+		}
+		fprintf(stderr, 
+			"gam::SamplePlayer: sound file \"%s\" must be mono with samples of player's type to map\n",
+			pathToSoundFile);
+		return false;
+	}
+
+	fprintf(stderr, 
+		"gam::SamplePlayer: couldn't map sound file \"%s\"\n",
+		pathToSoundFile);
+
+	return false;
+}
+
+PRE inline typename CLS::Tv CLS::read(int channel) const {
 	int posi = int(pos());
-	int Nframes= frames();
+	if(mStream && posi >= mStream->headEnd()) return readStream(posi, channel);
+	int Nframes= framesInBuffer();
+	if(mInterleaved){
+		Tv v;
+		const FrameRead<T,Tv> f = {&v, elems()+channel, mChans, 1, posi, pos()-posi, Nframes-1};
+		ipl::apply(mIpol, f);
+		return v;
+	}
 	int offset = channel*Nframes;
 	return mIpol(elems(), posi+offset, pos()-posi, offset+Nframes-1, offset);
 }
 
+PRE void CLS::readFrame(Tv * dst) const {
+	if(mInterleaved){
+		const int posi = int(pos());
+		const FrameRead<T,Tv> f = {dst, elems(), mChans, mChans, posi, pos()-posi, framesInBuffer()-1};
+		ipl::apply(mIpol, f);
+	}
+	else{
+		for(int c=0; c<mChans; ++c) dst[c] = read(c);
+	}
+}
+
+PRE typename CLS::Tv CLS::readStream(int posi, int channel) const {
+	int base, stride;
+	const T * w = mStream->window(posi, rate() < 0. ? -1 : 1, base, stride);
+	if(!w) return Tv(0);
+	int offset = channel*stride;
+	return mIpol(w, posi-base+offset, pos()-posi, offset+stride-1, offset);
+}
+
 
 PRE void CLS::buffer(Array<T>& src, double frmRate, int chans){
+	mStream.reset();
+	mMap.reset();
 	mPos = 0;
 	this->source(src);
 	frameRate(frmRate);	// sets mFrameRate, mRate, and mInc
 	mChans = chans;
+	mInterleaved = false;
+	mMin = 0;
+	mMax = frames();
+}
+
+PRE void CLS::buffer(Array<T>&& src, double frmRate, int chans){
+	mStream.reset();
+	mMap.reset();
+	mPos = 0;
+	Array<T>::operator=(std::move(src));
+	frameRate(frmRate);	// sets mFrameRate, mRate, and mInc
+	mChans = chans;
+	mInterleaved = false;
 	mMin = 0;
 	mMax = frames();
 }
 
+PRE void CLS::buffer(ArrayView<T> src, double frmRate, int chans){
+	buffer(src.elems(), src.size()/chans, frmRate, chans);
+}
+
 PRE void CLS::buffer(T * src, int numFrms, double frmRate, int chans){
+	mStream.reset();
+	mMap.reset();
 	mPos = 0;
 	this->source(src, numFrms*chans, true);
 	frameRate(frmRate);	// sets mFrameRate, mRate, and mInc
 	mChans = chans;
+	mInterleaved = false;
 	mMin = 0;
 	mMax = frames();
 }
 
 PRE void CLS::buffer(SamplePlayer& src){
 	buffer(src, src.frameRate(), src.channels());
+	mStream = src.mStream;
+	mMap = src.mMap;
+	mInterleaved = src.mInterleaved;
+	mMax = frames();
+}
+
+PRE void CLS::resample(double frmRate){
+	if(frmRate <= 0. || frmRate == frameRate() || mStream || mMap || !framesInBuffer()) return;
+
+	const unsigned srcFrames = framesInBuffer();
+	Array<T> out;
+	resampleSamples(out, elems(), srcFrames, channels(), frmRate / frameRate(), mInterleaved);
+
+	const unsigned dstFrames = out.size() / channels();
+	const double scale = double(dstFrames) / srcFrames;
+	Array<T>::operator=(std::move(out));
+	mMin *= scale;
+	mMax = mMax * scale < dstFrames ? mMax * scale : dstFrames;
+	mPos *= scale;
+	frameRate(frmRate);
+}
+
+PRE bool CLS::interleaved(bool v){
+	if(v == mInterleaved) return true;
+	if(mStream) return false;
+	if(channels() > 1){
+		if(mMap) return false;
+		const unsigned frames = framesInBuffer();
+		Array<T> out(frames * channels());
+		if(v)	mem::interleave  (out.elems(), elems(), frames, channels());
+		else	mem::deinterleave(out.elems(), elems(), frames, channels());
+		Array<T>::operator=(std::move(out));
+	}
+	mInterleaved = v;
+	return true;
 }
 
 PRE inline void CLS::pos(double v){	mPos = v; }
@@ -263,7 +894,7 @@ PRE void CLS::min(double v){ mMin = scl::clip<double>(v, mMax, 0.); }
 
 PRE void CLS::max(double v){ mMax = scl::clip<double>(v, frames(), mMin); }
 
-PRE void CLS::free(){ this->freeElements(); }
+PRE void CLS::free(){ mStream.reset(); mMap.reset(); this->clear(); }
 
 PRE inline void CLS::rate(double v){
 	mRate = v;
@@ -310,19 +941,19 @@ PRE void CLS::fade(int fadeOutFrames, int fadeInFrames){
 		for(int c=0; c<channels(); ++c){
 			amp = 0.;
 			for(int i=0; i<fadeInFrames; ++i){
-				sample(i,c) *= amp;
+				sample(i,c) = T(Tv(sample(i,c)) * amp);
 				amp += slope;	
 			}
 		}
 	}
 
-	if(fadeOutFrames > 0){
+	if(fadeOutFrames > 0 && !mStream){	// end of a stream is not in memory
 		double amp;
 		double slope =-1./(fadeOutFrames-1);
 		for(int c=0; c<channels(); ++c){
 			amp = 1;
 			for(int i=frames()-1-fadeOutFrames; i<frames(); ++i){
-				sample(i,c) *= amp;
+				sample(i,c) = T(Tv(sample(i,c)) * amp);
 				amp += slope;	
 			}
 		}
@@ -340,6 +971,257 @@ PRE inline double CLS::phase() const { return mPos/frames(); }
 #undef PRE
 #undef CLS
 
+
+template <class T>
+SampleStream<T>::SampleStream()
+:	mUse(-1), mLoad(-1), mReq(-1), mRunning(false),
+	mFrameRate(1), mFrames(0), mChans(0), mHead(0), mWindow(0),
+	mCur(-1), mCurStart(-1), mLastReq(-1), mUnderruns(0)
+{
+	mStart[0] = mStart[1] = -1;
+}
+
+template <class T>
+bool SampleStream<T>::open(const char * path, int headFrames, int windowFrames, Array<T>& head){
+	close();
+	if(!mFile.openRead(path)) return false;
+
+	mFrames = mFile.frames();
+	mChans = mFile.channels();
+	mFrameRate = mFile.frameRate();
+	mWindow = windowFrames < MARGIN ? MARGIN : windowFrames;
+	mHead = scl::clip<int>(headFrames, mFrames, MARGIN);
+
+	// Read head
+	mScratch.resize((mWindow + 2*MARGIN > mHead ? mWindow + 2*MARGIN : mHead) * mChans);
+	head.resize(mHead * mChans);
+	mFile.seek(0, SEEK_SET);
+	int n = mFile.read(&mScratch[0], mHead);
+	for(int i=n*mChans; i<mHead*mChans; ++i) mScratch[i] = Tv(0);
+	for(int c=0; c<mChans; ++c){
+		for(int i=0; i<mHead; ++i) head[c*mHead + i] = T(mScratch[i*mChans + c]);
+	}
+
+	mStart[0] = mStart[1] = -1;
+	mUse = mLoad = -1;
+	mCur = mCurStart = mLastReq = -1;
+	mUnderruns = 0;
+
+	if(mHead >= mFrames){	// whole file fits in head
+		mFile.close();
+		return true;
+	}
+
+	mBuf[0].assign((mWindow + 2*MARGIN) * mChans, T(0));
+	mBuf[1] = mBuf[0];
+	request(mHead);
+	mRunning = true;
+	mThread.start(cPrefetchFunc, this);
+	return true;
+}
+
+template <class T>
+void SampleStream<T>::close(){
+	if(mRunning){
+		mRunning = false;
+		mThread.join();
+	}
+	if(mFile.opened()) mFile.close();
+}
+
+template <class T>
+inline const T * SampleStream<T>::window(int frame, int dir, int& base, int& stride){
+	// Frames just before the end of the head are in the first window's margin
+	int s = frame < mHead ? mHead : mHead + ((frame - mHead)/mWindow)*mWindow;
+	if(s != mCurStart && !claim(s)){
+		if(s != mLastReq) request(s);
+		++mUnderruns;
+		return 0;
+	}
+
+	// Prefetch next window in direction of playback
+	int next = s + (dir < 0 ? -mWindow : mWindow);
+	if(next != mLastReq && next >= mHead && next < mFrames) request(next);
+
+	base = s - MARGIN;
+	stride = mWindow + 2*MARGIN;
+	return &mBuf[mCur][0];
+}
+
+// The audio thread sets mUse then checks mLoad while the prefetch thread sets 
+// mLoad then checks mUse. With sequentially consistent ordering, at most one 
+// of them gets a buffer.
+template <class T>
+bool SampleStream<T>::claim(int start){
+	for(int b=0; b<2; ++b){
+		if(mStart[b].load(std::memory_order_acquire) != start) continue;
+		mUse.store(b);
+		if(mLoad.load() != b && mStart[b].load(std::memory_order_acquire) == start){
+			mCur = b;
+			mCurStart = start;
+			return true;
+		}
+	}
+	mUse.store(-1);
+	mCur = mCurStart = -1;
+	return false;
+}
+
+template <class T>
+void SampleStream<T>::fill(int buf, int start){
+	const int stride = mWindow + 2*MARGIN;
+	int beg = start - MARGIN;
+	int end = start + mWindow + MARGIN;
+	int lo = beg < 0 ? 0 : beg;
+	int hi = end > mFrames ? mFrames : end;
+
+	mFile.seek(lo, SEEK_SET);
+	int n = mFile.read(&mScratch[0], hi - lo);
+	if(n < 0) n = 0;
+
+	T * dst = &mBuf[buf][0];
+	for(int c=0; c<mChans; ++c){
+		T * d = dst + c*stride;
+		for(int i=0; i<stride; ++i){
+			int j = beg + i - lo;	// frame in scratch
+			d[i] = T((j >= 0 && j < n) ? mScratch[j*mChans + c] : Tv(0));
+		}
+	}
+}
+
+template <class T>
+void * SampleStream<T>::cPrefetchFunc(void * user){
+	SampleStream& s = *static_cast<SampleStream *>(user);
+	while(s.mRunning.load(std::memory_order_acquire)){
+		int start = s.mReq.exchange(-1, std::memory_order_acq_rel);
+		if(start < 0){
+			::gam::sleepSec(0.001);
+			continue;
+		}
+		if(start == s.mStart[0].load(std::memory_order_relaxed)
+		|| start == s.mStart[1].load(std::memory_order_relaxed)) continue;
+
+		// Get a buffer the audio thread is not using
+		int b;
+		for(;;){
+			b = s.mUse.load() == 0 ? 1 : 0;
+			s.mLoad.store(b);
+			if(s.mUse.load() != b) break;
+		}
+		s.mStart[b].store(-1, std::memory_order_release);
+		s.fill(b, start);
+		s.mStart[b].store(start, std::memory_order_release);
+		s.mLoad.store(-1);
+	}
+	return NULL;
+}
+
+
+template <class T>
+SampleLibrary<T>::SampleLibrary(unsigned capacity, unsigned threads)
+:	mEntries(capacity, (Entry *)0), mSize(0), mNext(0), mLoaded(0), mFailures(0),
+	mRunning(true), mActive(0), mMaxThreads(threads), mSilence(1, T(0))
+{
+	if(0 == mMaxThreads) mMaxThreads = std::thread::hardware_concurrency();
+	if(0 == mMaxThreads) mMaxThreads = 1;
+}
+
+template <class T>
+SampleLibrary<T>::~SampleLibrary(){
+	mRunning.store(false, std::memory_order_release);
+	wait();
+	for(unsigned i=0; i<mEntries.size(); ++i) delete mEntries[i];
+}
+
+template <class T>
+unsigned SampleLibrary<T>::load(const std::vector<std::string>& paths, double frmRate){
+	const unsigned first = size();
+	if(paths.size() > capacity() - first) return capacity();
+	for(unsigned i=0; i<paths.size(); ++i){
+		Entry * e = new Entry;
+		e->path = paths[i];
+		e->targetRate = frmRate;
+		e->frameRate = 1;
+		e->channels = 1;
+		e->state.store(PENDING, std::memory_order_relaxed);
+		mEntries[first + i] = e;
+	}
+	mSize.store(first + paths.size(), std::memory_order_release);
+	startThreads();
+	return first;
+}
+
+template <class T>
+unsigned SampleLibrary<T>::load(const char * path, double frmRate){
+	return load(std::vector<std::string>(1, path), frmRate);
+}
+
+template <class T>
+void SampleLibrary<T>::startThreads(){
+	// Loaders exit when no files are left, so start more up to the maximum
+	const unsigned pending = size() - mNext.load(std::memory_order_acquire);
+	const unsigned active = mActive.load(std::memory_order_acquire);
+	const unsigned idle = active < mMaxThreads ? mMaxThreads - active : 0;
+	const unsigned n = pending < idle ? pending : idle;
+	mActive.fetch_add(n, std::memory_order_acq_rel);
+	for(unsigned i=0; i<n; ++i) mThreads.push_back(new Thread(cLoadFunc, this));
+}
+
+template <class T>
+void SampleLibrary<T>::wait(){
+	for(unsigned i=0; i<mThreads.size(); ++i){
+		mThreads[i]->join();
+		delete mThreads[i];
+	}
+	mThreads.clear();
+}
+
+template <class T>
+void * SampleLibrary<T>::cLoadFunc(void * user){
+	SampleLibrary& L = *static_cast<SampleLibrary *>(user);
+	while(L.mRunning.load(std::memory_order_acquire)){
+		unsigned i = L.mNext.load(std::memory_order_relaxed);
+		bool claimed = false;
+		while(i < L.size() && !(claimed = L.mNext.compare_exchange_weak(i, i+1, std::memory_order_acq_rel))){}
+		if(!claimed){
+			// Exit unless files were added after we stopped counting as active
+			L.mActive.fetch_sub(1, std::memory_order_acq_rel);
+			if(L.mNext.load(std::memory_order_acquire) >= L.size()) return NULL;
+			L.mActive.fetch_add(1, std::memory_order_acq_rel);
+			continue;
+		}
+		Entry& e = *L.mEntries[i];
+		int state = FAILED;
+		if(loadSamples(e.path.c_str(), e.data, e.frameRate, e.channels)){
+			if(e.targetRate > 0. && e.targetRate != e.frameRate && e.data.size()){
+				resampleSamples(e.data, e.data.elems(), e.data.size()/e.channels, e.channels, e.targetRate/e.frameRate);
+				e.frameRate = e.targetRate;
+			}
+			state = READY;
+		}
+		else{
+			fprintf(stderr, "gam::SampleLibrary: couldn't load sound file \"%s\"\n", e.path.c_str());
+			L.mFailures.fetch_add(1, std::memory_order_relaxed);
+		}
+		e.state.store(state, std::memory_order_release);
+		L.mLoaded.fetch_add(1, std::memory_order_release);
+	}
+	L.mActive.fetch_sub(1, std::memory_order_acq_rel);
+	return NULL;
+}
+
+template <class T>
+template <template<class> class Si, class Sp>
+bool SampleLibrary<T>::assign(SamplePlayer<T,Si,Sp>& player, unsigned i){
+	if(ready(i)){
+		Entry& e = *mEntries[i];
+		player.buffer(e.data, e.frameRate, e.channels);
+		return true;
+	}
+	player.buffer(mSilence, player.spu(), 1);
+	return false;
+}
+
 } // gam::
 
 #endif
@@ -0,0 +1,192 @@
+#ifndef GAMMA_SAMPLER_ENGINE_H_INC
+#define GAMMA_SAMPLER_ENGINE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Playback of many sample voices over shared sample buffers
+*/
+
+#include <vector>
+#include "Gamma/Containers.h"
+#include "Gamma/Domain.h"
+#include "Gamma/ipl.h"
+
+namespace gam{
+
+/// Many sample playback voices rendered in batches
+
+/// This plays hundreds to thousands of voices from a set of shared sample
+/// buffers, as many SamplePlayers would, but each voice is a record of a few
+/// numbers held in arrays shared by the engine, as in GrainCloud. Voices are
+/// rendered one after another over the whole block in SIMD batches (AVX2 or
+/// AVX-512 gathers when available, see simdPath()) and mixed into stereo
+/// outputs with their gain and pan. One-shot voices are removed once they
+/// pass the end of their interval; looping voices wrap within it.
+///
+/// Samples are registered once and shared with the engine's voices, for
+/// instance from a SampleCache through a player:
+/// \code
+///	SamplePlayer<> player;
+///	SampleCache<>::get().buffer(player, "snare.wav", 44100);
+///	unsigned snare = engine.sample(player);
+///	...
+///	engine.play(snare, 1.f, 0.5f, -0.3f); // on note-on
+/// \endcode
+///
+/// Interpolation is set for all voices at once. Reads of neighbors beyond
+/// the ends of a buffer are clamped to them. Only the first two channels of
+/// a sample are played, one to each output; mono samples are panned.
+/// Starting, stopping and changing voices and rendering do not allocate.
+///
+/// \ingroup Oscillator
+class SamplerEngine : public DomainObserver{
+public:
+
+	/// \param[in] maxVoices	maximum number of voices playing at once
+	/// \param[in] maxSamples	maximum number of sample buffers
+	SamplerEngine(unsigned maxVoices=1024, unsigned maxSamples=256);
+
+
+	/// Set maximum numbers of voices and samples
+
+	/// This allocates memory, stops all voices and removes all samples.
+	///
+	SamplerEngine& resize(unsigned maxVoices, unsigned maxSamples);
+
+	/// Set interpolation of all voices: TRUNC, LINEAR or CUBIC
+
+	/// ROUND is played as TRUNC and ALLPASS as LINEAR.
+	///
+	SamplerEngine& ipolType(ipl::Type v);
+
+	/// Get interpolation of all voices
+	ipl::Type ipolType() const { return mIpol; }
+
+
+	/// Add a sample buffer
+
+	/// The elements of src are shared, as by SamplePlayer::buffer(), and so
+	/// stay valid, and a SampleCache does not evict them, until resize() or
+	/// destruction of the engine.
+	///
+	/// \param[in] src		samples, deinterleaved if multichannel
+	/// \param[in] frmRate	frame rate of samples
+	/// \param[in] chans	number of channels
+	/// \returns index of sample or maxSamples() if there is no room
+	unsigned sample(Array<float>& src, double frmRate, int chans=1);
+
+	/// Add the sample buffer of a player
+
+	/// The player's frame rate and channels are used. Its frames must be
+	/// deinterleaved and not streamed, as sample(Array<float>&, double, int).
+	/// \returns index of sample or maxSamples() if there is no room or the
+	/// player's buffer cannot be used
+	template <class Player>
+	unsigned sample(Player& src){
+		if(src.stream() || (src.interleaved() && src.channels() > 1)) return maxSamples();
+		return sample(src, src.frameRate(), src.channels());
+	}
+
+	/// Get number of frames of a sample
+	unsigned frames(unsigned smp) const { return mFrames[smp]; }
+
+	/// Get number of samples added
+	unsigned samples() const { return mSamples; }
+
+	/// Get maximum number of samples
+	unsigned maxSamples() const { return unsigned(mData.size()); }
+
+
+	/// Start a voice
+
+	/// The voice plays the whole sample; forwards from the start, or for
+	/// negative rates backwards from the last frame.
+	///
+	/// \param[in] smp		index of sample
+	/// \param[in] rate		playback rate; negative rates play backwards
+	/// \param[in] amp		amplitude
+	/// \param[in] pan		stereo position, in [-1, 1]
+	/// \param[in] loop		whether to loop the sample
+	/// \param[in] offset	onset, in samples from start of next block rendered
+	/// \returns identifier of voice or maxVoices() if all voices are
+	/// playing or the sample is not valid. Identifiers of voices are reused
+	/// once they end.
+	unsigned play(unsigned smp, float rate=1, float amp=1, float pan=0, bool loop=false, unsigned offset=0);
+
+	/// Stop a voice
+	void stop(unsigned id);
+
+	/// Stop all voices
+	void reset();
+
+	/// Get whether a voice is playing or waiting to start
+	bool active(unsigned id) const { return id < maxVoices() && mSlot[id] != NONE; }
+
+	/// Set playback rate of a voice
+	SamplerEngine& rate(unsigned id, float v);
+
+	/// Set amplitude and stereo position, in [-1, 1], of a voice
+	SamplerEngine& gain(unsigned id, float amp, float pan=0);
+
+	/// Set whether a voice loops
+	SamplerEngine& loop(unsigned id, bool v);
+
+	/// Set interval of sample played by a voice, in frames [begin, end)
+	SamplerEngine& interval(unsigned id, double begin, double end);
+
+	/// Set position of a voice, in frames
+	SamplerEngine& pos(unsigned id, double v);
+
+	/// Get position of a voice, in frames, or 0 if it is not active
+	double pos(unsigned id) const { return active(id) ? mPos[mSlot[id]] : 0.; }
+
+	/// Get number of voices playing or waiting to start
+	unsigned voices() const { return mCount; }
+
+	/// Get maximum number of voices
+	unsigned maxVoices() const { return unsigned(mSlot.size()); }
+
+
+	/// Add a block of all voices to stereo outputs
+
+	/// \param[in,out] outL	left output samples
+	/// \param[in,out] outR	right output samples
+	/// \param[in]     n	number of samples
+	void render(float * outL, float * outR, unsigned n);
+
+	void onDomainChange(double r);
+
+private:
+	enum{ NONE = ~0u };
+
+	// Samples
+	std::vector<Array<float> > mData;
+	std::vector<unsigned> mFrames;
+	std::vector<int> mChans;
+	std::vector<double> mFPS;
+	std::vector<float> mSrcInc;		// frames of sample per domain sample
+	unsigned mSamples;
+	ipl::Type mIpol;
+
+	// Voice records, in slots [0, mCount)
+	std::vector<double> mPos;		// read position, in frames
+	std::vector<double> mBegin, mEnd;	// interval played
+	std::vector<float> mRate;
+	std::vector<float> mGainL, mGainR;
+	std::vector<unsigned> mSmp;
+	std::vector<unsigned> mOffset;	// samples until start, from start of next block
+	std::vector<unsigned char> mLoop;
+	std::vector<unsigned> mId;		// identifier of voice in slot
+	std::vector<unsigned> mSlot;	// slot of voice identifier, or NONE
+	std::vector<unsigned> mFree;	// stack of free identifiers
+	unsigned mCount;
+
+	void remove(unsigned slot);
+	void renderRun(unsigned slot, double pos, double inc, float * outL, float * outR, unsigned n);
+};
+
+} // gam::
+
+#endif
@@ -1,39 +1,98 @@
 #ifndef INC_GAM_SCHEDULER_H
 #define INC_GAM_SCHEDULER_H
 
+#include <atomic>
+#include <cstddef> // max_align_t
 #include <cstdlib> // exit
 #include <cstring> // memcpy, size_t
-#include <queue>
-#include <list>
-
+#include <new>
+#include <string>
+#include <type_traits>
+#include <typeindex>
+#include <typeinfo>
+#include <utility> // forward, move
+#include <map>
+#include <mutex>
+#include <vector>
+
+#include "Gamma/Containers.h"
 #include "Gamma/Node.h"
 #include "Gamma/Print.h"
+#include "Gamma/SoundFile.h"
+#include "Gamma/State.h"
 #include "Gamma/Thread.h"
+#include "Gamma/Timer.h"
 
 namespace gam{
 
 class Scheduler;
+class BlockGroup;
 
 #ifndef GAM_FUNC_MAX_DATA_SIZE
 	#define GAM_FUNC_MAX_DATA_SIZE 64
 #endif
 
+// Size and number of blocks in the shared pool for oversized Func data
+#ifndef GAM_FUNC_POOL_BLOCK_SIZE
+	#define GAM_FUNC_POOL_BLOCK_SIZE 512
+#endif
+#ifndef GAM_FUNC_POOL_BLOCKS
+	#define GAM_FUNC_POOL_BLOCKS 256
+#endif
+
+// Seconds without a block after which parallel workers sleep between polls
+#ifndef GAM_SCHEDULER_WORKER_IDLE
+	#define GAM_SCHEDULER_WORKER_IDLE 0.1
+#endif
+
+// Default capacity of lock-free queues between low and high priority threads
+#ifndef GAM_SCHEDULER_QUEUE_SIZE
+	#define GAM_SCHEDULER_QUEUE_SIZE 1024
+#endif
+
+// Maximum number of GraphReaders of a Scheduler existing at once
+#ifndef GAM_SCHEDULER_GRAPH_READERS
+	#define GAM_SCHEDULER_GRAPH_READERS 8
+#endif
+
+// Minimum number of frames passed between stages of non-real-time rendering
+#ifndef GAM_SCHEDULER_NRT_BLOCK_FRAMES
+	#define GAM_SCHEDULER_NRT_BLOCK_FRAMES 8192
+#endif
+
 
 /// Deferrable function
+
+/// A Func stores a callable object, such as a function with bound arguments
+/// or a lambda, so that it can be called later, possibly from another thread.
+/// Callables up to GAM_FUNC_MAX_DATA_SIZE bytes are stored within the object.
+/// Larger ones, up to GAM_FUNC_POOL_BLOCK_SIZE bytes, are stored in a shared 
+/// lock-free pool (or the heap, if the pool is exhausted). Storing anything 
+/// larger is a compile-time error. Move-only callables are supported, 
+/// however, a Func holding one can only be moved, not copied.
 class Func{
 public:
 	typedef void (* func_t)(void * data);
 
+	/// Construct empty function
+	Func(): mOps(0){}
+
+	/// Construct from a callable object taking no arguments
+	template <class F, class = typename std::enable_if<
+		!std::is_pointer<typename std::decay<F>::type>::value &&
+		!std::is_same<typename std::decay<F>::type, Func>::value
+	>::type>
+	Func(F&& f){
+		assign(std::forward<F>(f));
+	}
+
 	template <class R>
 	Func(R (*fnc)()){
 		struct Data{
 			R (*fnc)();
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				d.fnc();
-			}
+			void operator()(){ fnc(); }
 		} data = {fnc};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class R, class A, class L>
@@ -41,12 +100,9 @@ public:
 		struct Data{
 			R (*fnc)(A);
 			L l;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				d.fnc(d.l);
-			}
+			void operator()(){ fnc(l); }
 		} data = {fnc,l};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class R, class A, class B, class L, class M>
@@ -54,12 +110,9 @@ public:
 		struct Data{
 			R (*fnc)(A,B);
 			L l; M m;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				d.fnc(d.l,d.m);
-			}
+			void operator()(){ fnc(l,m); }
 		} data = {fnc,l,m};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class R, class A, class B, class C, class L, class M, class N>
@@ -67,12 +120,9 @@ public:
 		struct Data{
 			R (*fnc)(A,B,C);
 			L l; M m; N n;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				d.fnc(d.l,d.m,d.n);
-			}
+			void operator()(){ fnc(l,m,n); }
 		} data = {fnc,l,m,n};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class R, class A, class B, class C, class D, class L, class M, class N, class O>
@@ -80,12 +130,9 @@ public:
 		struct Data{
 			R (*fnc)(A,B,C,D);
 			L l; M m; N n; O o;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				d.fnc(d.l,d.m,d.n,d.o);
-			}
+			void operator()(){ fnc(l,m,n,o); }
 		} data = {fnc,l,m,n,o};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 
@@ -94,12 +141,9 @@ public:
 		struct Data{
 			Obj1& obj;
 			R (Obj2::*mth)();
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				(d.obj.*d.mth)();
-			}
+			void operator()(){ (obj.*mth)(); }
 		} data = {obj,mth};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class Obj1, class Obj2, class R, class A, class L>
@@ -108,12 +152,9 @@ public:
 			Obj1& obj;
 			R (Obj2::*mth)(A);
 			L l;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				(d.obj.*d.mth)(d.l);
-			}
+			void operator()(){ (obj.*mth)(l); }
 		} data = {obj,mth,l};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class Obj1, class Obj2, class R, class A, class B, class L, class M>
@@ -122,12 +163,9 @@ public:
 			Obj1& obj;
 			R (Obj2::*mth)(A,B);
 			L l; M m;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				(d.obj.*d.mth)(d.l,d.m);
-			}
+			void operator()(){ (obj.*mth)(l,m); }
 		} data = {obj,mth,l,m};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class Obj1, class Obj2, class R, class A, class B, class C, class L, class M, class N>
@@ -136,12 +174,9 @@ public:
 			Obj1& obj;
 			R (Obj2::*mth)(A,B,C);
 			L l; M m; N n;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				(d.obj.*d.mth)(d.l,d.m,d.n);
-			}
+			void operator()(){ (obj.*mth)(l,m,n); }
 		} data = {obj,mth,l,m,n};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
 	}
 
 	template <class Obj1, class Obj2, class R, class A, class B, class C, class D, class L, class M, class N, class O>
@@ -150,40 +185,87 @@ public:
 			Obj1& obj;
 			R (Obj2::*mth)(A,B,C,D);
 			L l; M m; N n; O o;
-			static void call(void * data){
-				Data& d = *(Data *)data;
-				(d.obj.*d.mth)(d.l,d.m,d.n,d.o);
-			}
+			void operator()(){ (obj.*mth)(l,m,n,o); }
 		} data = {obj,mth,l,m,n,o};
-		set(Data::call, (void *)&data, sizeof(Data));
+		assign(data);
+	}
+
+	/// Copy function; the source must not hold a move-only callable
+	Func(const Func& f): mOps(0){ copyFrom(f); }
+
+	/// Move function leaving the source empty
+	Func(Func&& f): mOps(0){ moveFrom(f); }
+
+	~Func(){ clear(); }
+
+	Func& operator= (const Func& f){
+		if(this != &f){ clear(); copyFrom(f); }
+		return *this;
+	}
+
+	Func& operator= (Func&& f){
+		if(this != &f){ clear(); moveFrom(f); }
+		return *this;
 	}
 
 	/// Execute stored function
-	void operator()(){ mFunc(mData); }
+	void operator()(){ if(mOps) mOps->call(target()); }
+
+	/// Returns whether a callable is stored
+	bool empty() const { return 0 == mOps; }
+
+	/// Returns whether the stored callable can be copied
+	bool copyable() const { return !mOps || mOps->copy; }
+
+	/// Returns whether the stored callable is in the shared pool or heap
+	bool external() const { return mOps && !mOps->internal; }
+
+	/// Destroy stored callable
+	void clear(){
+		if(mOps){ mOps->destroy(mData); mOps=0; }
+	}
+
+	/// Get pointer to stored callable's data
+	const char * data() const { return static_cast<const char *>(target()); }
+
+	/// Get first pointer in stored data, i.e. the object of a method call
+	const void * obj() const { return mOps ? *static_cast<void * const *>(target()) : 0; }
 
-	const char * data() const { return mData; }
-	const void * obj() const { return mObj; }
+	/// Get shared memory pool used for callables too large to store internally
+	static MemoryPool& pool(){
+		static MemoryPool * p = new MemoryPool(GAM_FUNC_POOL_BLOCK_SIZE, GAM_FUNC_POOL_BLOCKS);
+		return *p;
+	}
 
 private:
+
+	// Type-specific operations on storage (mData)
+	struct Ops{
+		void (* call)(void * target);
+		void (* copy)(void * dst, const void * src); // NULL if move-only
+		void (* move)(void * dst, void * src);
+		void (* destroy)(void * storage);
+		bool internal;
+	};
+
+	template <class F, bool Internal>
+	struct OpsFor;
+
 	union{
 		char mData[GAM_FUNC_MAX_DATA_SIZE];
-		void * mObj;
+		void * mExternal;
+		std::max_align_t mAlign;
 	};
-	func_t mFunc;
-
-	void set(func_t f, void * data, int size){
-		mFunc = f;
-		#ifndef NDEBUG
-		if(size > GAM_FUNC_MAX_DATA_SIZE){
-			fprintf(stderr, "Func maximum data size exceeded. "
-				"Attempt to use %d bytes with maximum size set to %d.\n",
-				size, GAM_FUNC_MAX_DATA_SIZE);
-			std::exit(-1);
-		}
-		#endif
-		std::memcpy(mData, data, size);
-		//printf("Func::set() with %d bytes\n", size);		
-	}
+	const Ops * mOps;
+
+	void * target(){ return (mOps && !mOps->internal) ? mExternal : mData; }
+	const void * target() const { return (mOps && !mOps->internal) ? mExternal : mData; }
+
+	template <class F>
+	void assign(F&& f);
+
+	void copyFrom(const Func& f);
+	void moveFrom(Func& f);
 };
 
 
@@ -194,8 +276,8 @@ struct SchedulerAudioIOData{
 	SchedulerAudioIOData()
 	:	buffersIn(NULL), buffersOut(NULL),
 		framesPerSecond(1), framesPerBuffer(0), channelsIn(0), channelsOut(0),
-		startFrame(0),
-		mUserData(NULL), mUserDataTypeID(0)
+		startFrame(0), skipping(false),
+		mUserData(NULL), mUserDataTypeID(0), mBuses(NULL), mNumBuses(0)
 	{}
 
 
@@ -206,6 +288,7 @@ struct SchedulerAudioIOData{
 	unsigned channelsIn;		///< Number of input channels
 	unsigned channelsOut;		///< Number of output channels
 	unsigned startFrame;		///< Start frame to begin processing
+	bool skipping;				///< Whether output is discarded while fast-forwarding (see Scheduler::skipNRT)
 
 
 	/// Set user data
@@ -222,6 +305,16 @@ struct SchedulerAudioIOData{
 	double secondsPerBuffer() const{
 		return framesPerBuffer / framesPerSecond; }
 
+	/// Get non-interleaved buffer of a temporary bus channel
+
+	/// \param[in] id		bus ID returned by Scheduler::addBus
+	/// \param[in] chan	channel of bus
+	/// \returns NULL if no node in the tree uses the bus
+	float * bus(unsigned id, unsigned chan=0) const {
+		float * b = id < mNumBuses ? mBuses[id] : NULL;
+		return b ? b + chan*framesPerBuffer : NULL;
+	}
+
 
 	/// Map external to internal audio I/O data
 
@@ -237,11 +330,19 @@ struct SchedulerAudioIOData{
 
 	/// Unmap audio I/O data (must be matched with a call to mapAudioIOData)
 
+	/// The mapped data must be of type TAudioIOData; see validAudioIOData().
 	/// \tparam TAudioIOData	A class with the same interface as gam::AudioIOData
 	///
 	template <class TAudioIOData>
 	TAudioIOData& unmapAudioIOData();
 
+	/// Check that audio I/O data of type TAudioIOData is mapped
+
+	/// If not, a fatal error is queued with fatalRT(), so the program exits
+	/// from the thread printing the log rather than the audio thread.
+	template <class TAudioIOData>
+	bool validAudioIOData() const;
+
 private:
 	template <class T>
 	static std::size_t typeID(){
@@ -249,8 +350,53 @@ private:
 		return std::size_t(&x);
 	}
 
+	friend class Scheduler;
 	void * mUserData;				// User data (usually other audio I/O data)
 	std::size_t mUserDataTypeID;	// Use for safe casting
+	float * const * mBuses;			// buffer of each temporary bus, set by Scheduler
+	unsigned mNumBuses;
+};
+
+
+
+/// Histogram of processing times of a ProcessNode
+
+/// Bin i > 0 counts calls taking [2^(i+6), 2^(i+7)) nanoseconds, bin 0 counts
+/// shorter calls and the last bin also counts all longer calls.
+struct ProcessProfile{
+	enum{ NUM_BINS = 16, MIN_BITS = 7 };
+
+	uint64_t calls;				///< Number of calls
+	uint64_t total;				///< Total processing time, in nanoseconds
+	uint64_t max;				///< Longest processing time, in nanoseconds
+	uint32_t bins[NUM_BINS];	///< Number of calls per time range
+
+	ProcessProfile(){ reset(); }
+
+	/// Add call taking dt nanoseconds
+	void add(uint64_t dt){
+		unsigned i = 0;
+		for(uint64_t t = dt>>MIN_BITS; t && i < NUM_BINS-1; t>>=1) ++i;
+		++bins[i];
+		++calls;
+		total += dt;
+		if(dt > max) max = dt;
+	}
+
+	/// Clear all statistics
+	void reset();
+
+	/// Get mean processing time, in nanoseconds
+	double mean() const { return calls ? double(total)/calls : 0.; }
+
+	/// Get time, in nanoseconds, under which a fraction of calls completed
+	
+	/// The result is an upper bound given by the edge of a histogram bin.
+	///
+	double percentile(double frac) const;
+
+	/// Get start time of histogram bin, in nanoseconds
+	static uint64_t binStart(unsigned i){ return i ? uint64_t(1)<<(i+MIN_BITS-1) : 0; }
 };
 
 
@@ -259,6 +405,8 @@ private:
 class ProcessNode : public Node3<ProcessNode>{
 public:
 
+	enum{ MAX_BUSES = 4 };	///< Maximum number of buses a node can use
+
 	ProcessNode(double delay=0.);
 
 	virtual ~ProcessNode();
@@ -270,6 +418,34 @@ public:
 	/// Called whenever this node is "reset"
 	virtual void onReset(){}
 
+	/// Called instead of onProcessNode when node is shed due to overload
+
+	/// Override to render at reduced quality, e.g., a reverb tail through a
+	/// cheaper filter. Descendents are skipped either way.
+	virtual void onShed(SchedulerAudioIOData& io){}
+
+	/// Called instead of onProcessNode while fast-forwarding (see Scheduler::skipNRT)
+
+	/// Override to advance the node's state over the frames from
+	/// io.startFrame to the end of the block without producing output, e.g.
+	/// with Accum::advance, and return true. The state must end up exactly as
+	/// if the block had been processed, so segments rendered after skipping
+	/// join seamlessly. Only the state of the node is kept, not its output,
+	/// so a node whose output is read by another node that is processed
+	/// (e.g. an effect on a bus) must not skip. Return false (default) to be
+	/// processed as usual, with the output discarded.
+	virtual bool onSkip(SchedulerAudioIOData& io){ return false; }
+
+	/// Called to save state for a warm restart (see Scheduler::saveState)
+
+	/// Write what onLoadState needs to continue where the node left off,
+	/// e.g. through the state() functions of its unit generators. This is
+	/// called from the audio thread, so it must not allocate or lock.
+	virtual void onSaveState(StateWriter& w){}
+
+	/// Called to restore state written by onSaveState (see Scheduler::loadState)
+	virtual void onLoadState(StateReader& r){}
+
 
 	/// Set starting time offset, in seconds
 	ProcessNode& dt(double v){ mDelay=v; return *this; }
@@ -285,10 +461,69 @@ public:
 
 	ProcessNode& reset();
 
+
+	/// Set an object whose completion makes this node idle
+
+	/// After each call of onProcessNode, the object's done() is checked,
+	/// e.g., of an envelope or a SilenceDetect on the output, and once it
+	/// returns true the node becomes idle. An idle node is freed, or put to
+	/// sleep if it does not free on idle, so that it and its descendents
+	/// stop being processed without calling free() by hand. The object must
+	/// live as long as the node, typically as a member of it.
+	template <class T>
+	ProcessNode& idleWhenDone(const T& obj){
+		mIdleObj = &obj;
+		mIdleTest = &isDone<T>;
+		return *this;
+	}
+
+	/// Declare that node reads or writes a temporary bus of its scheduler
+
+	/// The bus buffer is then available from bus() while processing. A node
+	/// can use up to MAX_BUSES buses; further calls are ignored. This must be
+	/// called before the node is added to a scheduler or be followed by
+	/// Scheduler::treeChanged().
+	///
+	/// \param[in] id	bus ID returned by Scheduler::addBus
+	ProcessNode& useBus(unsigned id);
+
+	/// Get buffer of a temporary bus channel while processing
+
+	/// \returns NULL if not called from onProcessNode or the bus is not used
+	float * bus(unsigned id, unsigned chan=0) const {
+		return mIO ? mIO->bus(id, chan) : NULL;
+	}
+
+	/// Set whether node is freed, rather than put to sleep, when idle (default true)
+	ProcessNode& freeOnIdle(bool v){ mFreeOnIdle=v; return *this; }
+
+	/// Set priority for shedding under overload (default 0)
+
+	/// When its scheduler has an overload budget (see
+	/// Scheduler::overloadBudget), a node with negative priority is shed,
+	/// along with its descendents, once the time spent in the block passes
+	/// the budget for priority -1, half of it for -2, a quarter for -3 and
+	/// so on. Nodes with priority 0 or more are always processed. Pads and
+	/// reverb tails are typical candidates.
+	ProcessNode& priority(int v){ mPriority=v; return *this; }
+
+	/// Get priority for shedding under overload
+	int priority() const { return mPriority; }
+
+	/// Put node to sleep, skipping it and its descendents until woken
+	ProcessNode& sleep();
+
+	/// Wake sleeping node
+	ProcessNode& wake();
+
 	bool deletable() const { return mDeletable; }
 	bool done() const { return DONE==mStatus; }
 	bool active() const { return ACTIVE==mStatus; }
 	bool inactive() const { return INACTIVE==mStatus; }
+	bool sleeping() const { return SLEEPING==mStatus; }
+
+	/// Get processing time statistics (HPT only; see Scheduler::profile)
+	const ProcessProfile& profile() const { return mProfile; }
 
 	void print();
 
@@ -298,18 +533,150 @@ protected:
 	enum{
 		INACTIVE=0,		// node and descendents are not executed
 		ACTIVE,			// node and descendents are executed
-		DONE			// processing done, node and descendents can be removed
+		DONE,			// processing done, node and descendents can be removed
+		SLEEPING		// idle; node and descendents are not executed until woken
 	};
 	
 	int mStatus;
 	double mDelay;
+	unsigned mFrameOffset;	// frames to skip on next update, set by Scheduler
+	unsigned mOrderIndex;	// position in Scheduler's execution order
+	unsigned mBuses[MAX_BUSES];	// IDs of temporary buses used
+	unsigned mNumBuses;
+	const SchedulerAudioIOData * mIO;	// I/O data of current process call
 	bool mDeletable;
+	MemoryPool * mPool;		// pool memory was allocated from, if any
+	ProcessProfile mProfile;	// written only from thread processing node
+	const void * mIdleObj;		// object whose completion makes node idle
+	bool (* mIdleTest)(const void * obj);
+	bool mFreeOnIdle;
+	int mPriority;
+	BlockGroup * mBlockGroup;	// this node if it is a BlockGroup, else NULL
+
+	template <class T>
+	static bool isDone(const void * obj){ return static_cast<const T *>(obj)->done(); }
+
+	// Destroy and free dynamically allocated node
+	static void destroy(ProcessNode * v);
+
+	// Destroy node and its deletable descendents iteratively, detaching
+	// descendents owned elsewhere
+	static void destroyTree(ProcessNode * v);
+
+	// Call my own processing algorithm, onProcess(), after any start delay.
+	// Returns whether descendents are to be executed.
+	bool update(SchedulerAudioIOData& io, bool profile=false);
+
+	// Call onProcess() from a frame if active; returns whether still active
+	bool process(SchedulerAudioIOData& io, int frameStart=0, bool profile=false);
+};
 
-	// Call my own processing algorithm, onProcess()
-	ProcessNode * update(const ProcessNode * top, SchedulerAudioIOData& io);
 
-	// Process all descendents recursively
-	ProcessNode * process(const ProcessNode * top, SchedulerAudioIOData& io, int frameStart=0);
+
+/// Processing time statistics of the nodes of a Scheduler at some instant
+class ProfileSnapshot{
+public:
+
+	struct Entry{
+		const ProcessNode * node;	///< Node address, for identification only
+		const char * type;			///< Implementation-defined type name
+		ProcessProfile profile;		///< Processing time statistics
+	};
+
+	ProfileSnapshot(): mTruncated(false){}
+
+	/// Get statistics of nodes
+	const std::vector<Entry>& entries() const { return mEntries; }
+
+	/// Whether some nodes were left out due to the snapshot capacity
+	bool truncated() const { return mTruncated; }
+
+	/// Get total processing time of all nodes, in nanoseconds
+	uint64_t total() const;
+
+	/// Sort entries by descending total processing time
+	ProfileSnapshot& sort();
+
+	/// Print nodes with the largest total processing times
+	void print(unsigned topN=10) const;
+
+private:
+	friend class Scheduler;
+	std::vector<Entry> mEntries;
+	bool mTruncated;
+};
+
+
+
+/// Structure and status of the nodes of a Scheduler at some instant
+
+/// Snapshots are published by the audio thread and read through a
+/// GraphReader. A published snapshot is never modified.
+class GraphSnapshot{
+public:
+
+	/// Status of a node
+	enum Status{
+		INACTIVE=0,		/**< Node and descendents are not executed */
+		ACTIVE,			/**< Node and descendents are executed */
+		DONE,			/**< Node is about to be removed */
+		SLEEPING		/**< Node and descendents are idle until woken */
+	};
+
+	struct Entry{
+		const ProcessNode * node;	///< Node address, for identification only
+		const char * type;			///< Implementation-defined type name
+		int parent;					///< Index of parent or -1 if a child of the scheduler
+		unsigned end;				///< Index following the node's descendents
+		unsigned depth;				///< Depth in tree; 0 for children of the scheduler
+		int status;					///< Status of node
+		int priority;				///< Priority for shedding under overload
+	};
+
+	/// Get number of nodes, in execution order
+	unsigned size() const { return mSize; }
+
+	/// Get node by index in execution order
+	const Entry& operator[](unsigned i) const { return mEntries[i]; }
+
+	/// Whether some nodes were left out due to the snapshot capacity
+	bool truncated() const { return mTruncated; }
+
+	/// Get number of snapshots published up to this one
+	uint64_t version() const { return mVersion; }
+
+	/// Get scheduler time, in frames, at which snapshot was taken
+	uint64_t frame() const { return mFrame; }
+
+	/// Print nodes as indented tree
+	void print() const;
+
+private:
+	friend class Scheduler;
+	std::vector<Entry> mEntries;	// sized to capacity
+	unsigned mSize;
+	bool mTruncated;
+	uint64_t mVersion, mFrame;
+	uint64_t mRetired;				// epoch at which snapshot was replaced
+
+	GraphSnapshot(unsigned capacity)
+	:	mEntries(capacity), mSize(0), mTruncated(false), mVersion(0), mFrame(0), mRetired(0){}
+};
+
+
+
+/// Overload statistics of a Scheduler
+struct SchedulerOverload{
+	uint64_t blocks;		///< Number of blocks processed
+	uint64_t late;			///< Number of blocks taking longer than a block period
+	uint64_t shedBlocks;	///< Number of blocks in which nodes were shed
+	uint64_t shedNodes;		///< Number of times a node was shed
+	float load;				///< Fraction of block period taken by last block
+
+	SchedulerOverload(){ reset(); }
+
+	/// Clear all statistics
+	void reset(){ blocks = late = shedBlocks = shedNodes = 0; load = 0.f; }
 };
 
 
@@ -323,16 +690,86 @@ public:
 
 private:
 	void onProcessNode(SchedulerAudioIOData& io){
-		onProcess(io.unmapAudioIOData<TAudioIOData>());
+		if(io.validAudioIOData<TAudioIOData>()) onProcess(io.unmapAudioIOData<TAudioIOData>());
 	}
 };
 
 
+/// Subgraph processed at a multiple of the scheduler's block size
+
+/// The descendents of a group are processed once every factor() scheduler
+/// blocks on a block of factor() times the size, so heavy subgraphs pay the
+/// per-block overhead less often while the rest of the graph, e.g. live
+/// input monitoring, runs at the small block size of the audio callback.
+/// The group collects the input of factor() blocks, processes it in the
+/// scheduler block given by phase() and plays the output over the following
+/// blocks, so its output is a fixed latency() behind the rest of the graph.
+/// The processing of a group block falls in one callback; groups with
+/// different phases spread the load over the callbacks. Blocks in which the
+/// group is inactive or shed still count, with silent input, so the group
+/// keeps its phase.
+///
+/// Nodes in a group must use SchedulerAudioIOData directly, as the user
+/// data is NULL within the group (so Process nodes cannot be used), and its
+/// temporary buses are not available. Buffers are allocated in the first
+/// block and when the block size or number of channels changes.
+///
+///	\code
+///	BlockGroup& pads = scheduler.add<BlockGroup>(8);
+///	scheduler.add<Pad>(pads, 440.f);
+///	\endcode
+class BlockGroup : public ProcessNode{
+public:
+
+	/// \param[in] factor	number of scheduler blocks per group block
+	/// \param[in] phase	scheduler block, in [0, factor), of group blocks in
+	///						which the group is processed
+	explicit BlockGroup(unsigned factor=8, unsigned phase=0);
+
+	/// Get number of scheduler blocks per group block
+	unsigned factor() const { return mFactor; }
+
+	/// Get scheduler block of group blocks in which the group is processed
+	unsigned phase() const { return mPhase; }
+
+	/// Get delay of group output, in frames, for a scheduler block size
+	unsigned latency(unsigned framesPerBuffer) const { return (mFactor + mPhase) * framesPerBuffer; }
+
+	/// Clear buffers; subclasses overriding onReset must call this
+	void onReset();
+
+private:
+	friend class Scheduler;
+	unsigned mFactor, mPhase;
+	uint64_t mCount;				// scheduler blocks since reset
+	bool mPlaying;					// whether a group block has been output
+	std::vector<float> mIn, mOut;	// two input group blocks, one output
+	SchedulerAudioIOData mGroupIO;
+
+	// Collect input of a scheduler block; returns whether group block is due
+	bool begin(const SchedulerAudioIOData& io);
+
+	// Add output to a scheduler block
+	void end(SchedulerAudioIOData& io);
+
+	// Advance a scheduler block in which the group is shed or skipped,
+	// recording silent input so group blocks stay in phase
+	void skip(SchedulerAudioIOData& io);
+};
+
+
+
 /// A function that can be delayed and/or repeated periodically
 class ControlFunc{
 public:
 	ControlFunc(const Func& f, double dt=0)
-	:	mFunc(f), mDelay(dt), mPeriod(0), mObjDel(0)
+	:	mFunc(f), mDelay(dt), mPeriod(0), mObjDel(0),
+		mTime(0), mTick(0), mNext(0), mPooled(false)
+	{}
+
+	ControlFunc(Func&& f, double dt=0)
+	:	mFunc(std::move(f)), mDelay(dt), mPeriod(0), mObjDel(0),
+		mTime(0), mTick(0), mNext(0), mPooled(false)
 	{}
 	
 	ControlFunc& dt(double v){ mDelay=v; return *this; }
@@ -342,10 +779,105 @@ public:
 
 protected:
 	friend class Scheduler;
+	friend class ControlFuncWheel;
 	Func mFunc;
 	double mDelay;
 	double mPeriod;
 	int mObjDel;
+	double mTime;			// absolute time of next call, in seconds
+	uint64_t mTick;			// absolute block of next call
+	ControlFunc * mNext;	// next function in wheel slot
+	bool mPooled;			// whether memory is from Scheduler's pool
+};
+
+
+
+/// Hierarchical timing wheel of ControlFuncs
+
+/// Functions are stored in intrusive lists in slots indexed by the block 
+/// (tick) on which they expire. The first level resolves single ticks and 
+/// each successive level resolves coarser spans that are cascaded down as 
+/// time advances. Inserting and expiring are O(1) so the cost per tick is 
+/// proportional to the number of expired functions rather than the number 
+/// pending.
+class ControlFuncWheel{
+public:
+
+	ControlFuncWheel();
+
+	/// Insert function to expire on its absolute tick, ControlFunc::mTick
+	void insert(ControlFunc * f);
+
+	/// Remove and return list of functions expiring on current tick, then advance one tick
+	ControlFunc * advance();
+
+	/// Get current tick
+	uint64_t tick() const { return mTick; }
+
+	/// Returns number of pending functions
+	unsigned size() const { return mSize; }
+
+private:
+	enum{
+		BITS0 = 8, SIZE0 = 1<<BITS0,	// first level
+		BITS  = 6, SIZE  = 1<<BITS,		// higher levels
+		LEVELS = 4,						// total number of levels
+		RANGE_BITS = BITS0 + BITS*(LEVELS-1)
+	};
+
+	ControlFunc * mLevel0[SIZE0];
+	ControlFunc * mLevels[LEVELS-1][SIZE];
+	uint64_t mTick;
+	unsigned mSize;
+
+	void cascade(int level);
+};
+
+
+
+/// Fixed-size control message sent to a Scheduler from any thread
+
+/// Messages carry a handler, the object it acts on and a few numeric
+/// arguments, so they can be queued without allocating. For example, a
+/// network thread receiving OSC could send
+///
+///		void setFreq(void * voice, const ControlMessage& m){
+///			static_cast<Voice *>(voice)->freq(m.args[0], m.frame);
+///		}
+///		...
+///		scheduler.send(ControlMessage(setFreq, &voice).arg(440));
+///
+/// The handler's argument is not accessed by the scheduler, so it need not
+/// be a node of the scheduler.
+struct ControlMessage{
+	enum{ MAX_ARGS = 4 };
+
+	typedef void (* Handler)(void * target, const ControlMessage& m);
+
+	Handler handler;		///< Function called by the audio thread
+	void * target;			///< First argument passed to handler
+	double time;			///< Scheduler time to apply at, in seconds; 0 for next block
+	unsigned frame;			///< Frame offset into block when applied, set by Scheduler
+	unsigned numArgs;		///< Number of arguments
+	float args[MAX_ARGS];	///< Arguments
+
+	/// \param[in] h		function called by the audio thread
+	/// \param[in] target	first argument passed to handler
+	/// \param[in] time	scheduler time, in seconds, to apply at
+	ControlMessage(Handler h=0, void * target=0, double time=0)
+	:	handler(h), target(target), time(time), frame(0), numArgs(0)
+	{
+		for(int i=0; i<MAX_ARGS; ++i) args[i]=0.f;
+	}
+
+	/// Append an argument; arguments past MAX_ARGS are ignored
+	ControlMessage& arg(float v){
+		if(numArgs < MAX_ARGS) args[numArgs++] = v;
+		return *this;
+	}
+
+	/// Set scheduler time to apply at, in seconds
+	ControlMessage& at(double t){ time=t; return *this; }
 };
 
 
@@ -358,8 +890,7 @@ protected:
 class Scheduler : public ProcessNode{
 public:
 
-	typedef std::queue<ProcessNode *> FreeList;
-	typedef std::list<ControlFunc> Funcs;
+	typedef SPSCQueue<ProcessNode *> FreeList;
 
 	Scheduler();
 	~Scheduler();
@@ -370,55 +901,122 @@ public:
 	
 	/// Check free list for finished events and reclaim their memory
 	
+	/// This also resubmits nodes and functions that were added while their
+	/// queue to the audio thread was full.
 	/// \returns number of events deleted
 	///
 	int reclaim();
 
+	/// Set capacity of graph command and free list queues
+
+	/// This allocates memory and must be called before the scheduler is
+	/// started or while no other threads are accessing it.
+	Scheduler& queueSize(unsigned n);
+
+	/// Get capacity of graph command queue
+	unsigned queueSize() const { return mAddCommands.capacity(); }
+
+	/// Set maximum number of nodes processed
+
+	/// This allocates the processing order of the tree, so that the audio
+	/// thread does not. If the tree grows larger, the subtrees of the root
+	/// from the first that does not fit on are not processed until there is
+	/// room. This must be called before the scheduler is started or while no
+	/// other threads are accessing it.
+	Scheduler& maxNodes(unsigned n);
+
+	/// Get maximum number of nodes processed
+	unsigned maxNodes() const { return mMaxNodes; }
+
+	/// Returns number of commands that could not be queued immediately
+
+	/// Commands that overflow the queue are held by the adding thread and 
+	/// resubmitted on its next call to add(). A non-zero count indicates that
+	/// the queue size should be increased.
+	unsigned commandOverflows() const { return mAddCommands.overflows(); }
+
+	/// Get current time of scheduler, in seconds
+	double time() const { return mTime; }
+
 	/// Get internal audio I/O data structure
 	const SchedulerAudioIOData& io() const { return mIO; }
 	SchedulerAudioIOData& io(){ return mIO; }
 	
 
+	/// Preallocate memory for a number of processes of a particular type
+
+	/// Subsequent calls to add<AProcess>() will construct objects in this
+	/// memory rather than allocating from the heap. Memory is returned to the 
+	/// pool when the object is reclaimed. If the pool is exhausted, objects are 
+	/// allocated from the heap as usual and the pool's failure count is 
+	/// incremented. This should be called before the scheduler is started.
+	///
+	/// \tparam AProcess	process type
+	/// \param[in] num		number of objects to preallocate
+	template <class AProcess>
+	Scheduler& reserve(unsigned num){
+		MemoryPool *& p = mPools[typeID<AProcess>()];
+		if(!p) p = new MemoryPool(sizeof(AProcess), num);
+		return *this;
+	}
+
+	/// Get memory pool for a process type or NULL if none has been reserved
+
+	/// The pool's counters (used, peak, failures) can be used to determine an
+	/// adequate size to reserve.
+	template <class AProcess>
+	const MemoryPool * pool() const {
+		Pools::const_iterator it = mPools.find(typeID<AProcess>());
+		return it != mPools.end() ? it->second : 0;
+	}
+
 	/// Add dynamically allocated process as first child of root node
 	template <class AProcess>
 	AProcess& add(){
-		AProcess * v = new AProcess;
+		AProcess * v = create<AProcess>();
 		cmdAdd(v); return *v;
 	}
 
+	// Nodes derived from ProcessNode are parents, see add(ProcessNode&)
 	template <class AProcess, class A>
-	AProcess& add(const A& a){
-		AProcess * v = new AProcess(a);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a){
+		AProcess * v = create<AProcess>(a);
 		cmdAdd(v); return *v;
 	}
 
 	template <class AProcess, class A, class B>
-	AProcess& add(const A& a, const B& b){
-		AProcess * v = new AProcess(a,b);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a, const B& b){
+		AProcess * v = create<AProcess>(a,b);
 		cmdAdd(v); return *v;
 	}
 
 	template <class AProcess, class A, class B, class C>
-	AProcess& add(const A& a, const B& b, const C& c){
-		AProcess * v = new AProcess(a,b,c);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a, const B& b, const C& c){
+		AProcess * v = create<AProcess>(a,b,c);
 		cmdAdd(v); return *v;
 	}
 
 	template <class AProcess, class A, class B, class C, class D>
-	AProcess& add(const A& a, const B& b, const C& c, const D& d){
-		AProcess * v = new AProcess(a,b,c,d);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a, const B& b, const C& c, const D& d){
+		AProcess * v = create<AProcess>(a,b,c,d);
 		cmdAdd(v); return *v;
 	}
 
 	template <class AProcess, class A, class B, class C, class D, class E>
-	AProcess& add(const A& a, const B& b, const C& c, const D& d, const E& e){
-		AProcess * v = new AProcess(a,b,c,d,e);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a, const B& b, const C& c, const D& d, const E& e){
+		AProcess * v = create<AProcess>(a,b,c,d,e);
 		cmdAdd(v); return *v;
 	}
 
 	template <class AProcess, class A, class B, class C, class D, class E, class F>
-	AProcess& add(const A& a, const B& b, const C& c, const D& d, const E& e, const F& f){
-		AProcess * v = new AProcess(a,b,c,d,e,f);
+	typename std::enable_if<!std::is_base_of<ProcessNode, A>::value, AProcess&>::type
+	add(const A& a, const B& b, const C& c, const D& d, const E& e, const F& f){
+		AProcess * v = create<AProcess>(a,b,c,d,e,f);
 		cmdAdd(v); return *v;
 	}
 
@@ -426,22 +1024,130 @@ public:
 	/// Add dynamically allocated process as first child of specified node
 	template <class AProcess>
 	AProcess& add(ProcessNode& parent){
-		AProcess * v = new AProcess;
+		AProcess * v = create<AProcess>();
 		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
 		return *v;
 	}
 
+	/// Add dynamically allocated process, constructed with arguments, as first child of specified node
+	template <class AProcess, class A>
+	AProcess& add(ProcessNode& parent, const A& a){
+		AProcess * v = create<AProcess>(a);
+		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
+		return *v;
+	}
 
-	/// Add deferred function call
-	ControlFunc& add(const Func& f){
-		mFuncs.push_back(f);
-		return mFuncs.back();
+	template <class AProcess, class A, class B>
+	AProcess& add(ProcessNode& parent, const A& a, const B& b){
+		AProcess * v = create<AProcess>(a,b);
+		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
+		return *v;
+	}
+
+	template <class AProcess, class A, class B, class C>
+	AProcess& add(ProcessNode& parent, const A& a, const B& b, const C& c){
+		AProcess * v = create<AProcess>(a,b,c);
+		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
+		return *v;
 	}
 
+	template <class AProcess, class A, class B, class C, class D>
+	AProcess& add(ProcessNode& parent, const A& a, const B& b, const C& c, const D& d){
+		AProcess * v = create<AProcess>(a,b,c,d);
+		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
+		return *v;
+	}
+
+	template <class AProcess, class A, class B, class C, class D, class E>
+	AProcess& add(ProcessNode& parent, const A& a, const B& b, const C& c, const D& d, const E& e){
+		AProcess * v = create<AProcess>(a,b,c,d,e);
+		pushCommand(Command::ADD_FIRST_CHILD, &parent, v);
+		return *v;
+	}
+
+
+	/// Add deferred function call
+
+	/// This may be called from a single thread other than the audio thread.
+	/// The function is handed to the audio thread as soon as it is added, so
+	/// no reference to it is returned; its delay and period are set through
+	/// add(f, delay, period) instead. Function objects are allocated from a
+	/// preallocated pool and scheduled using a timing wheel, so each block
+	/// costs time proportional only to the number of calls made.
+	void add(Func f);
+
+	/// Add deferred function call with delay and period, in seconds
+	void add(Func f, double delay, double period=0);
+
+	/// Send control message to be applied by the audio thread
+
+	/// This may be called from any number of threads at once, such as
+	/// network threads receiving controller data. It never locks or
+	/// allocates. Messages are applied at the start of Scheduler::update in
+	/// the order they are due, with ControlMessage::frame set to the offset
+	/// of their time into the block so handlers can apply them
+	/// sample-accurately. Messages due in a later block are held by the
+	/// audio thread in a time-ordered queue with the capacity of
+	/// controlQueueSize(); while that is full, newer messages wait in the
+	/// send queue.
+	///
+	/// \returns false if the send queue is full and the message was dropped
+	bool send(const ControlMessage& m){ return mMessages.push(m); }
+
+	/// Set capacity of control message queues
+
+	/// This allocates memory and must be called before the scheduler is
+	/// started or while no other threads are accessing it.
+	Scheduler& controlQueueSize(unsigned n);
+
+	/// Get capacity of control message send queue
+	unsigned controlQueueSize() const { return mMessages.capacity(); }
+
+	/// Returns number of control messages dropped due to a full send queue
+	unsigned controlOverflows() const { return mMessages.overflows(); }
+
+	/// Create a temporary bus for routing audio between nodes
+
+	/// A bus is a block buffer that the nodes declaring it with
+	/// ProcessNode::useBus read and write, e.g., voices adding into an effect
+	/// send processed after them. Buses own no memory. When the execution
+	/// order is compiled, a bus is live from the first to the last node
+	/// using it, in execution order, and buses whose live ranges do not
+	/// overlap share buffers from a pool, so memory depends on the number of
+	/// buses live at once rather than on the size of the graph. A bus is
+	/// zeroed before its first node each block, so its contents do not carry
+	/// over between blocks. With parallel processing buses do not share
+	/// buffers, and all subtrees of the root from the first to the last using
+	/// a bus are processed in one job, in order, so a bus is never written
+	/// and read from several threads at once. This should be called before
+	/// the scheduler is started.
+	///
+	/// \param[in] channels	number of channels
+	/// \returns bus ID
+	unsigned addBus(unsigned channels=1);
+
+	/// Get number of channel buffers in bus pool, as of last compile (HPT only)
+	unsigned busPoolChannels() const { return mBusPoolChannels; }
+
+	/// Notify scheduler that the tree was edited directly
+
+	/// Nodes are executed from a contiguous array holding the order of the
+	/// tree, which the scheduler recompiles after its own edits. If nodes are
+	/// added to or removed from the tree in the audio thread by other means,
+	/// e.g. ProcessNode::addFirstChild from a process callback, this must be
+	/// called afterwards. The change takes effect from the next block.
+	Scheduler& treeChanged(){ mOrderChanged=true; return *this; }
+
 	/// Execute all audio processes in execution tree
 
-	/// This should be called at the audio block rate. 
-	/// The latency of events will be determined by the block size.
+	/// This should be called at the audio block rate. Nodes are executed by a
+	/// linear scan over the compiled execution order, skipping the
+	/// descendents of inactive nodes.
+	/// Processes with a start delay (see ProcessNode::dt) are held in a 
+	/// time-ordered queue and begin at their exact frame within the block,
+	/// so onset timing does not depend on the block size. The delay is
+	/// measured from the start of the block in which the process is first
+	/// seen by the scheduler.
 	void update();
 
 	/// Map external audio I/O and then update
@@ -457,30 +1163,245 @@ public:
 	/// Set time period between low-priority actions
 	Scheduler& period(float v);
 
+	/// Set number of threads used to process subtrees of the root in parallel
+
+	/// When more than one thread is used, the children of the root node 
+	/// (along with their descendents) are partitioned into a fixed number of 
+	/// jobs. Each job renders into its own output bus using a view of the 
+	/// mapped audio I/O data. The buses are summed into the output in job 
+	/// order so the result does not depend on thread timing. Worker threads 
+	/// wait between blocks without being woken, so no system calls are made
+	/// from the audio thread: they spin, then yield, and once no block has
+	/// come for GAM_SCHEDULER_WORKER_IDLE seconds, e.g. while the stream is
+	/// stopped, they sleep a millisecond at a time. Processes in different
+	/// subtrees must not share mutable state.
+	/// This should be called before the scheduler is started.
+	///
+	/// \tparam TAudioIOData	type of audio I/O data mapped to the scheduler.
+	///						It must have a constructor 
+	///						TAudioIOData(const TAudioIOData& src, float * bufOut) 
+	///						creating a view of 'src' with a separate output buffer.
+	/// \param[in] numThreads	total number of threads, including the audio thread
+	/// \param[in] numJobs		number of partitions; if 0, then 4 per thread
+	template <class TAudioIOData>
+	Scheduler& parallel(unsigned numThreads, unsigned numJobs=0){
+		mViewCreate = ViewOps<TAudioIOData>::create;
+		mViewMap = ViewOps<TAudioIOData>::map;
+		mViewDestroy = ViewOps<TAudioIOData>::destroy;
+		return parallel(numThreads, numJobs);
+	}
+
+	/// Set number of threads used to process subtrees of the root in parallel
+	
+	/// This version is for processes that only use SchedulerAudioIOData 
+	/// directly through ProcessNode::onProcessNode.
+	Scheduler& parallel(unsigned numThreads, unsigned numJobs=0);
+
+	/// Get number of threads used for processing
+	unsigned threads() const { return mWorkers.size() + 1; }
+
+	/// Set whether to profile the processing time of each node
+
+	/// When enabled, every call to ProcessNode::onProcessNode is timed with
+	/// timeNow() and added to the node's ProcessProfile histogram.
+	///
+	/// \param[in] v			whether to profile
+	/// \param[in] maxNodes	maximum number of nodes in a snapshot
+	Scheduler& profile(bool v, unsigned maxNodes = GAM_SCHEDULER_QUEUE_SIZE);
+
+	/// Get whether nodes are being profiled
+	bool profiling() const { return mProfiling.load(std::memory_order_relaxed); }
+
+	/// Get snapshot of node processing times (LPT only)
+
+	/// Snapshots are taken by the HPT at the end of a block after being
+	/// requested by this function, so the first call only makes a request.
+	/// Returns true if a new snapshot was copied into the argument.
+	bool profile(ProfileSnapshot& dst);
+
+	/// Set whether to publish snapshots of the graph for other threads
+
+	/// When enabled, the audio thread copies the structure and status of the
+	/// tree into an immutable GraphSnapshot after each block in which the
+	/// tree was edited or a node changed status. It is published through an
+	/// atomic pointer, so threads reading it with a GraphReader never lock
+	/// or wait on the audio thread. Replaced snapshots are reclaimed by the
+	/// LPT once no reader can still hold them and are then reused, so the
+	/// audio thread never allocates. If readers hold all snapshots, the
+	/// audio thread publishes later. This allocates memory and must be
+	/// called before the scheduler is started or while no other threads are
+	/// accessing it.
+	///
+	/// \param[in] v			whether to publish snapshots
+	/// \param[in] maxNodes	maximum number of nodes in a snapshot
+	Scheduler& graphSnapshots(bool v, unsigned maxNodes = GAM_SCHEDULER_QUEUE_SIZE);
+
+	/// Register a node type for saving and restoring state
+
+	/// Nodes of registered types are written by saveState() and recreated by
+	/// loadState(), default-constructed (from the type's pool, if reserved)
+	/// and given their state through ProcessNode::onLoadState. Nodes of
+	/// other types are left out along with their descendents. This should
+	/// be called before the scheduler is started.
+	///
+	/// \tparam AProcess	default-constructible process type
+	/// \param[in] name	name identifying the type in state files
+	template <class AProcess>
+	Scheduler& stateType(const std::string& name){
+		mStateNames[std::type_index(typeid(AProcess))] = name;
+		mStateFactories[name] = &makeNode<AProcess>;
+		return *this;
+	}
+
+	/// Set capacity of state captured by saveState()
+
+	/// This allocates memory and must be called before the scheduler is
+	/// started or while no save is pending.
+	///
+	/// \param[in] bytes	capacity, in bytes; 0 disables saving
+	Scheduler& stateCapacity(size_t bytes);
+
+	/// Save state of graph to a file for a warm restart
+
+	/// The audio thread captures the tree and each node's state (see
+	/// ProcessNode::onSaveState) at the end of the next block into a buffer
+	/// of stateCapacity() bytes, so the state is consistent across nodes and
+	/// nothing is allocated. The LPT then writes it to the file on its next
+	/// reclaim(), replacing the file only once complete. The capture costs
+	/// the audio thread a copy of the state, e.g. of every delay line saved.
+	/// This may be called from one thread other than the audio thread.
+	///
+	/// \returns false if a save is pending or no capacity was set
+	bool saveState(const std::string& path);
+
+	/// Get number of state files written
+	unsigned statesSaved() const { return mStatesSaved.load(std::memory_order_relaxed); }
+
+	/// Get number of saves failed for lack of capacity or file errors
+	unsigned stateSaveFailures() const { return mStateFailures.load(std::memory_order_relaxed); }
+
+	/// Restore nodes from a file written by saveState()
+
+	/// The file is memory-mapped and each node of a registered type is
+	/// recreated in the same place in the tree with its state, status and
+	/// priority, so reverb tails and delay lines continue where they were
+	/// saved. Restored trees are added as children of the root, as by add(),
+	/// so this may be called from the thread adding nodes. A node whose
+	/// onLoadState fails its StateReader is not restored, nor are its
+	/// descendents.
+	///
+	/// \returns number of nodes restored or -1 if the file is not valid
+	int loadState(const std::string& path);
+
+	/// Set fraction of block period processing may take before shedding nodes
+
+	/// update() measures the time since it started against the block
+	/// period. Once it passes the budget, nodes of negative priority are shed
+	/// (see ProcessNode::priority): they and their descendents are skipped
+	/// and ProcessNode::onShed is called instead of onProcessNode, so an
+	/// overloaded block degrades gracefully rather than missing its deadline.
+	/// Nodes are shed individually as time runs out, so the budget should
+	/// leave room for the nodes that are always processed. Shedding happens
+	/// only in the block that is overloaded and never while recording with
+	/// recordNRT. A budget of 0 (default) turns shedding off.
+	///
+	/// \param[in] frac	fraction of block period, e.g. 0.7
+	Scheduler& overloadBudget(float frac){ mBudget.store(frac, std::memory_order_relaxed); return *this; }
+
+	/// Get fraction of block period processing may take before shedding nodes
+	float overloadBudget() const { return mBudget.load(std::memory_order_relaxed); }
+
+	/// Get overload statistics; may be called from any thread
+	void overload(SchedulerOverload& dst) const;
+
+	/// Clear overload statistics
+	void resetOverload();
+
 	/// Start scheduler
+
+	/// This starts the low-priority thread, which reclaims memory of freed
+	/// nodes every period().
 	void start();
 
 	/// Stop scheduler
+
+	/// This waits for the low-priority thread to finish, after which
+	/// reclaim() may be called from the calling thread.
 	void stop();
 
 	/// Record output to sound file in non-real-time
 
+	/// Rendering is pipelined across three threads: the calling thread
+	/// processes the graph, a second converts blocks to interleaved samples
+	/// of the file encoding and a third writes them to disk. Stages exchange
+	/// double-buffered blocks of at least GAM_SCHEDULER_NRT_BLOCK_FRAMES
+	/// frames.
+	///
 	/// \param[in] soundFilePath	path to sound file
 	/// \param[in] durSec			duration, in seconds, of recording
-	//void recordNRT(GAM_SCHEDULER_IO_DATA& io, const char * soundFilePath, double durSec);
-	void recordNRT(const char * soundFilePath, double durSec);
+	/// \param[in] encoding		sample encoding of sound file
+	/// \returns render speed as a multiple of real-time or 0 if the file could
+	/// not be opened
+	double recordNRT(const char * soundFilePath, double durSec,
+		SoundFile::EncodingType encoding = SoundFile::FLOAT);
 
 	/// Record output to sound file in non-real-time
 
 	/// \param[in] aio				audio i/o data to map to internal audio i/o data
 	/// \param[in] soundFilePath	path to sound file
 	/// \param[in] durSec			duration, in seconds, of recording
+	/// \param[in] encoding		sample encoding of sound file
+	/// \returns render speed as a multiple of real-time
 	template <class TAudioIOData>
-	void recordNRT(TAudioIOData& aio, const char * soundFilePath, double durSec){
+	double recordNRT(TAudioIOData& aio, const char * soundFilePath, double durSec,
+		SoundFile::EncodingType encoding = SoundFile::FLOAT
+	){
 		io().mapAudioIOData(aio);
-		recordNRT(soundFilePath, durSec);
+		return recordNRT(soundFilePath, durSec, encoding);
 	}
 
+	/// Function adding a piece to a scheduler, from its start, for recordNRT
+	typedef void (* NRTScore)(Scheduler& s, void * user);
+
+	/// Record a piece to sound file in time-parallel segments
+
+	/// The piece is split into one segment per thread. Each thread builds
+	/// the piece in a scheduler of its own with score(), fast-forwards it to
+	/// the start of its segment with skipNRT() and records the segment as
+	/// the single-threaded recordNRT. Segments are joined into the file in
+	/// order as they finish. As every node is either processed or skipped
+	/// exactly (see ProcessNode::onSkip), the file is sample for sample the
+	/// one the single-threaded recordNRT would write; the speedup depends on
+	/// how cheaply the nodes skip.
+	///
+	/// This scheduler's io() gives the frame rate, block size and number of
+	/// channels. The segment schedulers get audio buffers of their own, so
+	/// their nodes must use SchedulerAudioIOData rather than mapped audio
+	/// I/O data, and the score must not change io() other than by adding
+	/// buses. The score is called concurrently from several threads.
+	///
+	/// \param[in] soundFilePath	path to sound file
+	/// \param[in] durSec			duration, in seconds, of recording
+	/// \param[in] score			function adding the piece to a scheduler
+	/// \param[in] user				user data passed to score
+	/// \param[in] threads			number of threads (segments) to record with
+	/// \param[in] encoding			sample encoding of sound file
+	/// \returns render speed as a multiple of real-time or 0 if the file could
+	/// not be written
+	double recordNRT(const char * soundFilePath, double durSec,
+		NRTScore score, void * user, unsigned threads,
+		SoundFile::EncodingType encoding = SoundFile::FLOAT);
+
+	/// Advance in non-real-time without keeping output
+
+	/// Blocks are processed as by recordNRT, running control functions,
+	/// events and messages, but with SchedulerAudioIOData::skipping set, so
+	/// nodes can skip their work through ProcessNode::onSkip.
+	///
+	/// \param[in] durSec			duration, in seconds, to advance
+	/// \returns duration advanced, in whole blocks
+	double skipNRT(double durSec);
+
 //	void print(){
 //		printf("%d events\n", (int)events().size());
 //		Events::iterator it = events().begin();
@@ -506,34 +1427,197 @@ protected:
 			REMOVE_CHILD
 		};
 		
-		//double time;
 		Type type;
 		ProcessNode * object;
 		ProcessNode * other;
+	};
+
+	// A command to be executed at an absolute frame in the future
+	struct Event{
+		uint64_t frame;
+		Command command;
 
-//		struct Compare{
-//			bool operator()(const Command& a, const Command& b){
-//				return a.time < b.time;
-//			}
-//		};
+		// For min-heap ordering on frame
+		struct Later{
+			bool operator()(const Event& a, const Event& b) const {
+				return a.frame > b.frame;
+			}
+		};
 	};
 
-//	std::priority_queue<Command, std::vector<Command>, Command::Compare> 
-//		mCommandQueue;
+	// A control message to be applied at an absolute frame
+	struct TimedMessage{
+		uint64_t frame;
+		uint64_t order;		// arrival order, for messages due on same frame
+		ControlMessage message;
+
+		// For min-heap ordering on frame, then arrival
+		struct Later{
+			bool operator()(const TimedMessage& a, const TimedMessage& b) const {
+				return a.frame != b.frame ? a.frame > b.frame : a.order > b.order;
+			}
+		};
+	};
 
 	// LPT:  low-priority thread
 	// HPT: high-priority thread
-	std::queue<Command> mAddCommands;	// items newly allocated in LPT to be added to tree in HPT
+	SPSCQueue<Command> mAddCommands;	// items newly allocated in LPT to be added to tree in HPT
+	std::vector<Command> mPendingCommands; // LPT backlog when mAddCommands is full
 	FreeList mFreeList;		// items removed from tree in HPT to be deleted in LPT
-	Funcs mFuncs;
+	std::vector<Event> mEvents;	// HPT-only min-heap of future commands (capacity is preallocated)
+	typedef std::map<std::size_t, MemoryPool *> Pools;
+	Pools mPools;			// per-type node memory, keyed by type ID
+	MemoryPool mFuncPool;			// memory for ControlFuncs
+	SPSCQueue<ControlFunc *> mAddFuncs;	// new functions from LPT to HPT
+	std::vector<ControlFunc *> mPendingFuncs; // LPT backlog when mAddFuncs is full
+	std::mutex mPendingMutex;		// guards backlogs and pushes, from add() and reclaim()
+	std::atomic<unsigned> mNumPending;	// items in backlogs
+	ControlFuncWheel mFuncWheel;	// HPT-only scheduled functions
+	MPSCQueue<ControlMessage> mMessages;	// control messages from any thread to HPT
+	std::vector<TimedMessage> mTimedMessages; // HPT-only min-heap of received messages
+	uint64_t mMessageCount;	// HPT-only count of received messages
 	Thread mLPThread;		// low-priority thread for garbage collection, etc.
 	float mPeriod;
 	double mTime;			// scheduler's time, in seconds
+	uint64_t mFrame;		// scheduler's time, in frames
 	SchedulerAudioIOData mIO;
-	bool mRunning;
+	std::atomic<bool> mRunning;	// whether LPT is running
 	
 	static void * cLPThreadFunc(void * user);
 
+	// Compiled execution order of the tree: nodes in depth-first order, each
+	// with the index following its subtree so inactive subtrees can be skipped
+	struct Step{
+		ProcessNode * node;
+		unsigned end;
+	};
+
+	std::vector<Step> mOrder;	// HPT-only; first step is the scheduler itself
+	unsigned mMaxNodes;			// nodes reserved in order, besides the scheduler
+	bool mOrderChanged;			// whether tree was edited since last compile
+	bool mOrderFull;			// whether subtrees were left out of order
+
+	// Temporary buses; all but mBusChannels are HPT-only
+	struct BusRange{ unsigned first, last, buffer; };	// steps using a bus
+	struct BusBuffer{ unsigned channels, last, offset; };	// buffer in pool
+	struct BusClear{ unsigned offset, size; };	// pool samples to zero before a step
+	std::vector<unsigned> mBusChannels;	// channels of each bus, by ID
+	std::vector<float *> mBusPtrs;		// buffer of each bus, by ID
+	std::vector<BusRange> mBusRanges;
+	std::vector<unsigned> mBusSorted;	// bus IDs by first step
+	std::vector<BusBuffer> mBusBuffers;
+	std::vector<BusClear> mBusClears;	// ordered by step
+	std::vector<unsigned> mBusClearStart;	// first clear of each step, plus end
+	std::vector<float> mBusPool;
+	unsigned mBusFrames;				// block size buffers were assigned for
+	unsigned mBusPoolChannels;
+
+	// Parallel processing of root subtrees
+	struct Job{
+		SchedulerAudioIOData io;
+		void * view;			// external audio I/O view rendering into bus
+		unsigned begin, end;	// range of subtrees in mRoots
+	};
+
+	template <class TAudioIOData>
+	struct ViewOps{
+		static void * create(void * src, float * bufOut){
+			return new TAudioIOData(*static_cast<TAudioIOData *>(src), bufOut);
+		}
+		static void map(SchedulerAudioIOData& io, void * view, void * src){
+			TAudioIOData * v = static_cast<TAudioIOData *>(view);
+			v->updateView(*static_cast<TAudioIOData *>(src));
+			io.userData(v);
+		}
+		static void destroy(void * view){
+			delete static_cast<TAudioIOData *>(view);
+		}
+	};
+
+	std::vector<Job> mJobs;
+	std::vector<float> mBuses;			// one non-interleaved output bus per job
+	std::vector<unsigned> mRoots;		// order indices of subtrees of root
+	std::vector<unsigned char> mRootJoined;	// whether subtree shares a bus with previous one
+	std::vector<Thread *> mWorkers;
+	std::atomic<unsigned> mGeneration;	// incremented for each new block of jobs
+	std::atomic<unsigned> mJobNext;		// index of next job to claim
+	std::atomic<unsigned> mJobsDone;
+	std::atomic<bool> mWorkersRunning;
+
+	// Overload shedding
+	std::atomic<float> mBudget;			// fraction of block period
+	nsec_t mBlockStart, mBudgetNSec;	// start and budget of current update, 0 if not shedding
+	std::atomic<uint64_t> mBlocks, mLate, mShedBlocks, mShedNodes;
+	std::atomic<float> mLoad;
+	std::atomic<bool> mShedding;		// whether nodes were shed in current block
+
+	enum{ PROFILE_IDLE=0, PROFILE_REQUESTED, PROFILE_READY };
+	std::atomic<bool> mProfiling;
+	std::atomic<int> mProfileState;	// owner of mProfileEntries: LPT if not REQUESTED
+	std::vector<ProfileSnapshot::Entry> mProfileEntries;
+	unsigned mProfileCount;			// valid entries, set by HPT
+	bool mProfileTruncated;			// whether nodes did not fit, set by HPT
+
+	// Graph snapshots; each is free (owned by HPT), current (mGraph), or
+	// retired (owned by LPT until no reader can hold it)
+	enum{ GRAPH_SNAPSHOTS = 3 };
+	std::vector<GraphSnapshot *> mGraphSnapshots;	// all snapshots, for deletion
+	SPSCQueue<GraphSnapshot *> mGraphFree;		// reclaimed snapshots from LPT to HPT
+	SPSCQueue<GraphSnapshot *> mGraphRetired;	// replaced snapshots from HPT to LPT
+	std::vector<GraphSnapshot *> mGraphReclaim;	// LPT-only retired snapshots not yet free
+	std::atomic<GraphSnapshot *> mGraph;		// current snapshot
+	std::atomic<uint64_t> mGraphEpoch;			// incremented on each publish
+	std::atomic<uint64_t> mGraphReaders[GAM_SCHEDULER_GRAPH_READERS]; // epoch of each reader, 0 if none
+	std::atomic<bool> mGraphPublishing;
+	bool mGraphChanged;				// HPT-only; whether tree changed since last publish
+	uint64_t mGraphVersion;			// HPT-only
+	friend class GraphReader;
+	template <class V, unsigned M> friend class VoicePool;
+
+	// State saving for warm restarts
+	enum{ STATE_IDLE=0, STATE_REQUESTED, STATE_CAPTURED, STATE_FAILED };
+	typedef ProcessNode * (* StateFactory)(Scheduler& s);
+	std::map<std::type_index, std::string> mStateNames;
+	std::map<std::string, StateFactory> mStateFactories;
+	StateWriter mStateBuf;			// owned by HPT while REQUESTED, else LPT
+	std::string mStatePath;
+	std::atomic<int> mStateState;
+	std::atomic<unsigned> mStatesSaved, mStateFailures;
+
+	void * mViewSource;					// external audio I/O data views were made from
+	void * (* mViewCreate)(void * src, float * bufOut);
+	void (* mViewMap)(SchedulerAudioIOData& io, void * view, void * src);
+	void (* mViewDestroy)(void * view);
+
+	static void * cWorkerFunc(void * user);
+	void stopWorkers();
+	void hpResizeJobs();
+	void hpProcessParallel();
+	void hpRunJobs();
+	void runJob(Job& j);
+
+	template <class T>
+	static std::size_t typeID(){
+		static int x;
+		return std::size_t(&x);
+	}
+
+	// Construct new process, from type's pool if available
+	template <class AProcess, class... Args>
+	AProcess * create(const Args&... args){
+		MemoryPool * p = 0;
+		void * mem = 0;
+		Pools::iterator it = mPools.find(typeID<AProcess>());
+		if(it != mPools.end()){
+			p = it->second;
+			mem = p->allocate();
+			if(!mem) p = 0;
+		}
+		AProcess * v = mem ? new(mem) AProcess(args...) : new AProcess(args...);
+		v->mPool = p;
+		return v;
+	}
+
 	void pushCommand(Command::Type c, ProcessNode * object, ProcessNode * other);
 	void cmdAdd(ProcessNode * v);
 
@@ -542,12 +1626,66 @@ protected:
 	// processing within nodes (i.e., from the audio thread).
 	void hpUpdateTree();
 
+	// Execute a command, starting the node at a frame offset into the block
+	void hpExecute(Command& c, unsigned frameOffset);
+
+	// Rebuild execution order from tree, if edited
+	void hpUpdateOrder(){
+		if(mOrderChanged || (mBusFrames != io().framesPerBuffer && !mBusChannels.empty())){
+			hpCompileOrder();
+		}
+	}
+	void hpCompileOrder();
+
+	// Assign pool buffers to buses by liveness in execution order
+	void hpAssignBuses();
+	void hpClearBuses(unsigned begin, unsigned end);
+
+	// Execute steps [begin, end) of execution order
+	void hpRun(unsigned begin, unsigned end, SchedulerAudioIOData& io, bool profile);
+
+	// Shed node if over budget for its priority; returns whether shed
+	bool hpShed(ProcessNode& n, SchedulerAudioIOData& io);
+
+	// Run subtree of group at step i, if a group block is due
+	void hpRunGroup(BlockGroup& g, unsigned i, SchedulerAudioIOData& io, bool profile);
+
 	void hpUpdateControlFuncs(double dt);
+
+	// Apply control messages due in the current block
+	void hpUpdateMessages();
+	void destroy(ControlFunc * f);
+	using ProcessNode::destroy;
 	
 	// Moves branches marked as being done to a free list for cleanup by a 
 	// lower priority thread.
 	void hpUpdateFreeList();
 
+	// Resolves delayed commands adding to nodes about to be removed
+	void hpCancelEvents();
+
+	// Copies node profiles into snapshot, if requested
+	void hpUpdateProfile();
+
+	// Publishes graph snapshot, if tree or node status changed
+	void hpUpdateGraph();
+
+	// Frees retired graph snapshots no reader can hold
+	void lpReclaimGraph();
+
+	// Resubmits backlogged commands and functions, preserving order; the
+	// caller holds mPendingMutex
+	void lpFlushPending();
+
+	// Writes tree and node states into state buffer, if requested
+	void hpCaptureState();
+
+	// Writes captured state to file
+	void lpWriteState();
+
+	template <class AProcess>
+	static ProcessNode * makeNode(Scheduler& s){ return s.create<AProcess>(); }
+
 	// TODO: are these needed???
 	// Reclaims memory and returns number of events playing
 	bool check();
@@ -555,9 +1693,236 @@ protected:
 
 
 
+/// Read access to the latest graph snapshot of a Scheduler
+
+/// A reader holds the GraphSnapshot current at its construction, which stays
+/// valid and unchanged until the reader is destroyed. Readers may be used
+/// from any thread other than the audio thread and never lock or wait. At
+/// most GAM_SCHEDULER_GRAPH_READERS readers may exist at once; further ones
+/// are empty, as are readers made before the first snapshot is published.
+/// Readers should be short-lived, as a held snapshot cannot be reused.
+///
+/// \code
+///	GraphReader g(scheduler);
+///	if(g) for(unsigned i=0; i<g->size(); ++i) ...
+/// \endcode
+class GraphReader{
+public:
+
+	GraphReader(Scheduler& s);
+	~GraphReader();
+
+	/// Get snapshot or NULL if none
+	const GraphSnapshot * get() const { return mSnapshot; }
+
+	const GraphSnapshot * operator->() const { return mSnapshot; }
+	const GraphSnapshot& operator*() const { return *mSnapshot; }
+
+	/// Whether a snapshot is held
+	explicit operator bool() const { return mSnapshot != NULL; }
+
+private:
+	Scheduler& mScheduler;
+	int mSlot;
+	const GraphSnapshot * mSnapshot;
+
+	GraphReader(const GraphReader&);
+	GraphReader& operator=(const GraphReader&);
+};
+
+
+
+/// Fixed set of preallocated voices handed out on note-on
+
+/// The pool adds N voices to a scheduler once, where they sleep until used.
+/// noteOn() restarts a sleeping voice or, if all are playing, steals one
+/// according to the policy. A voice goes back to sleep when the object it
+/// passed to ProcessNode::idleWhenDone() is done. Notes therefore never
+/// allocate or change the graph, and at most N voices are processed per
+/// block.
+///
+/// Voices are restarted with ProcessNode::reset(), so Voice must restart
+/// its envelopes in onReset() and call idleWhenDone() in its constructor.
+/// For STEAL_QUIETEST, Voice may have a member 'float level() const' giving
+/// its current loudness; without one the oldest voice is stolen.
+///
+/// noteOn() must be called from the thread running the scheduler, e.g.,
+/// from a function added with Scheduler::add(Func). The pool must be
+/// destroyed before its scheduler, and the scheduler's queue size should be
+/// at least N so that all voices are added on the first block.
+///
+/// \tparam Voice	voice type, derived from ProcessNode
+/// \tparam N		number of voices
+template <class Voice, unsigned N>
+class VoicePool{
+public:
+
+	/// Policy for choosing a voice when all are playing
+	enum Steal{
+		STEAL_NONE,			/**< Drop the note */
+		STEAL_OLDEST,		/**< Steal the voice started longest ago */
+		STEAL_QUIETEST,		/**< Steal the voice with the lowest level() */
+		STEAL_SAME_PITCH	/**< Retrigger the voice playing the key, else steal the oldest */
+	};
+
+	/// \param[in] s		scheduler to add voices to
+	/// \param[in] steal	stealing policy
+	VoicePool(Scheduler& s, Steal steal=STEAL_OLDEST);
+
+	/// Frees all voices
+	~VoicePool();
+
+
+	/// Start a note
+
+	/// \param[in] key	key identifying the note, e.g., its MIDI pitch
+	/// \returns voice for setting note parameters or NULL if the note was
+	/// dropped
+	Voice * noteOn(float key);
+
+	/// Get most recently started playing voice with a key or NULL if none
+	Voice * voice(float key);
+
+	/// Get voice by index
+	Voice& operator[](unsigned i){ return *mSlots[i].voice; }
+
+	/// Get key of last note started on a voice
+	float key(unsigned i) const { return mSlots[i].key; }
+
+	/// Get whether a voice is playing
+	bool playing(unsigned i) const { return mSlots[i].voice->active(); }
+
+	/// Get number of playing voices
+	unsigned playing() const;
+
+	/// Set stealing policy
+	VoicePool& steal(Steal v){ mSteal=v; return *this; }
+
+	/// Get stealing policy
+	Steal steal() const { return mSteal; }
+
+	/// Get number of notes that stole a playing voice
+	unsigned steals() const { return mSteals; }
+
+	/// Get number of notes dropped because all voices were playing
+	unsigned drops() const { return mDrops; }
+
+	/// Get number of voices
+	static unsigned size(){ return N; }
+
+private:
+	struct Slot{
+		Voice * voice;
+		float key;
+		uint64_t stamp;		// order in which notes started
+	};
+
+	Slot mSlots[N];
+	Steal mSteal;
+	uint64_t mStamp;
+	unsigned mSteals, mDrops;
+
+	int findPlaying(float key) const;
+	int findFree() const;
+	int findVictim() const;
+
+	template <class V>
+	static auto level(const V& v, int) -> decltype(float(v.level())){ return v.level(); }
+	template <class V>
+	static float level(const V&, long){ return 0.f; }
+};
+
+
 
 // IMPLEMENTATION ______________________________________________________________
 
+template <class F, bool Internal>
+struct Func::OpsFor{
+	static F * get(void * storage){
+		return Internal ? static_cast<F *>(storage) : *static_cast<F **>(storage);
+	}
+	static void call(void * target){ (*static_cast<F *>(target))(); }
+	static void copy(void * dst, const void * src){
+		copy(dst, *get(const_cast<void *>(src)), std::integral_constant<bool, Internal>());
+	}
+	static void copy(void * dst, const F& f, std::true_type){ new(dst) F(f); }
+	static void copy(void * dst, const F& f, std::false_type){
+		*static_cast<void **>(dst) = new(allocate()) F(f);
+	}
+	static void move(void * dst, void * src){
+		if(Internal){
+			new(dst) F(std::move(*get(src)));
+			get(src)->~F();
+		}
+		else{
+			*static_cast<void **>(dst) = *static_cast<void **>(src);
+		}
+	}
+	static void destroy(void * storage){
+		F * f = get(storage);
+		f->~F();
+		if(!Internal) deallocate(f);
+	}
+	static void * allocate(){
+		void * p = Func::pool().allocate();
+		return p ? p : ::operator new(GAM_FUNC_POOL_BLOCK_SIZE);
+	}
+	static void deallocate(void * p){
+		if(Func::pool().owns(p))	Func::pool().deallocate(p);
+		else						::operator delete(p);
+	}
+	template <class T>
+	static typename std::enable_if<std::is_copy_constructible<T>::value, void (*)(void *, const void *)>::type
+	copier(){ return &OpsFor::copy; }
+	template <class T>
+	static typename std::enable_if<!std::is_copy_constructible<T>::value, void (*)(void *, const void *)>::type
+	copier(){ return 0; }
+
+	static const Ops * ops(){
+		static const Ops o = { call, copier<F>(), move, destroy, Internal };
+		return &o;
+	}
+};
+
+template <class F>
+void Func::assign(F&& f){
+	typedef typename std::decay<F>::type T;
+	static_assert(sizeof(T) <= GAM_FUNC_POOL_BLOCK_SIZE,
+		"Func callable exceeds GAM_FUNC_POOL_BLOCK_SIZE");
+	static_assert(alignof(T) <= alignof(std::max_align_t),
+		"Func callable is over-aligned");
+	static const bool internal = sizeof(T) <= GAM_FUNC_MAX_DATA_SIZE
+		&& std::is_nothrow_move_constructible<T>::value;
+	if(internal){
+		new(mData) T(std::forward<F>(f));
+		mOps = OpsFor<T, true>::ops();
+	}
+	else{
+		mExternal = new(OpsFor<T, false>::allocate()) T(std::forward<F>(f));
+		mOps = OpsFor<T, false>::ops();
+	}
+}
+
+inline void Func::copyFrom(const Func& f){
+	if(f.mOps){
+		if(f.mOps->copy){
+			f.mOps->copy(mData, f.mData);
+			mOps = f.mOps;
+		}
+		else{
+			warnRT("gam::Func", "attempt to copy a move-only callable; result is empty");
+		}
+	}
+}
+
+inline void Func::moveFrom(Func& f){
+	if(f.mOps){
+		f.mOps->move(mData, f.mData);
+		mOps = f.mOps;
+		f.mOps = 0;
+	}
+}
+
 template <class TAudioIOData>
 void SchedulerAudioIOData::mapAudioIOData(TAudioIOData& externalIO){
 	userData(&externalIO);
@@ -570,31 +1935,130 @@ void SchedulerAudioIOData::mapAudioIOData(TAudioIOData& externalIO){
 }
 
 template <class TAudioIOData>
-TAudioIOData& SchedulerAudioIOData::unmapAudioIOData(){
+bool SchedulerAudioIOData::validAudioIOData() const {
+	// Both errors are fatal, but this is called on the audio thread, so the
+	// logger thread exits after printing the message
 	if(!mUserData /*|| !audioIODataType<TAudioIOData>(false)*/){
-		gam::err(
-			"member 'userData' is NULL. Did you make a matching call to mapAudioIOData?",
-			"gam::SchedulerAudioIOData::unmapAudioIOData()"
+		fatalRT(
+			"gam::SchedulerAudioIOData::unmapAudioIOData()",
+			"member 'userData' is NULL. Did you make a matching call to mapAudioIOData?"
 		);
+		return false;
 	}
 	else if(typeID<TAudioIOData>() != mUserDataTypeID){
-		gam::err(
-			"Type mismatch between member 'userData' and template parameter.",
-			"gam::SchedulerAudioIOData::unmapAudioIOData()"
+		fatalRT(
+			"gam::SchedulerAudioIOData::unmapAudioIOData()",
+			"Type mismatch between member 'userData' and template parameter."
 		);
+		return false;
 	}
+	return true;
+}
+
+template <class TAudioIOData>
+TAudioIOData& SchedulerAudioIOData::unmapAudioIOData(){
 	TAudioIOData& res = *(TAudioIOData *)mUserData;
 	res.frame(startFrame);
 	return res;
 }
 
 
+template <class Voice, unsigned N>
+VoicePool<Voice,N>::VoicePool(Scheduler& s, Steal steal)
+:	mSteal(steal), mStamp(0), mSteals(0), mDrops(0)
+{
+	static_assert(std::is_base_of<ProcessNode, Voice>::value, "Voice must derive from ProcessNode");
+	s.reserve<Voice>(N);
+	// Voices are put to sleep before they are handed to the audio thread,
+	// which would otherwise free one seen done before it was configured
+	for(unsigned i=0; i<N; ++i){
+		Voice * v = s.create<Voice>();
+		v->freeOnIdle(false).sleep();
+		mSlots[i].voice = v;
+		mSlots[i].key = 0;
+		mSlots[i].stamp = 0;
+	}
+	for(unsigned i=0; i<N; ++i) s.cmdAdd(mSlots[i].voice);
+}
+
+template <class Voice, unsigned N>
+VoicePool<Voice,N>::~VoicePool(){
+	for(unsigned i=0; i<N; ++i) mSlots[i].voice->free();
+}
+
+template <class Voice, unsigned N>
+Voice * VoicePool<Voice,N>::noteOn(float k){
+	int i = STEAL_SAME_PITCH == mSteal ? findPlaying(k) : -1;
+	if(i < 0) i = findFree();
+	if(i < 0){
+		if(STEAL_NONE == mSteal){ ++mDrops; return 0; }
+		i = findVictim();
+		++mSteals;
+	}
+	Slot& sl = mSlots[i];
+	sl.key = k;
+	sl.stamp = ++mStamp;
+	sl.voice->reset();
+	sl.voice->wake();
+	return sl.voice;
+}
+
+template <class Voice, unsigned N>
+Voice * VoicePool<Voice,N>::voice(float k){
+	int i = findPlaying(k);
+	return i >= 0 ? mSlots[i].voice : 0;
+}
+
+template <class Voice, unsigned N>
+unsigned VoicePool<Voice,N>::playing() const {
+	unsigned n = 0;
+	for(unsigned i=0; i<N; ++i) n += playing(i);
+	return n;
+}
+
+template <class Voice, unsigned N>
+int VoicePool<Voice,N>::findPlaying(float k) const {
+	int res = -1;
+	for(unsigned i=0; i<N; ++i){
+		if(playing(i) && mSlots[i].key == k && (res < 0 || mSlots[i].stamp > mSlots[res].stamp)) res = i;
+	}
+	return res;
+}
+
+template <class Voice, unsigned N>
+int VoicePool<Voice,N>::findFree() const {
+	for(unsigned i=0; i<N; ++i){
+		if(mSlots[i].voice->sleeping()) return i;
+	}
+	return -1;
+}
+
+template <class Voice, unsigned N>
+int VoicePool<Voice,N>::findVictim() const {
+	int res = 0;
+	float resLevel = level(*mSlots[0].voice, 0);
+	for(unsigned i=1; i<N; ++i){
+		const Slot& sl = mSlots[i];
+		if(STEAL_QUIETEST == mSteal){
+			float l = level(*sl.voice, 0);
+			if(l < resLevel || (l == resLevel && sl.stamp < mSlots[res].stamp)){
+				res = i; resLevel = l;
+			}
+		}
+		else if(sl.stamp < mSlots[res].stamp){
+			res = i;
+		}
+	}
+	return res;
+}
+
 template <class TAudioIOData>
 void Scheduler::audioCB(TAudioIOData& aio){
 	if(!aio.user()){
-		gam::err(
-			"AudioIOData user data is NULL. Should be the address of the Scheduler.",
-			"gam::Scheduler::audioCB()");
+		errRT(
+			"gam::Scheduler::audioCB()",
+			"AudioIOData user data is NULL. Should be the address of the Scheduler.");
+		return;
 	}
 	Scheduler& s = *(Scheduler*)aio.user();
 	s.update(aio);
@@ -4,14 +4,20 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <atomic>
 #include <string>
 #include <vector>
 #include <stdio.h>
+#include "Gamma/Containers.h"
 #include "Gamma/mem.h"
+#include "Gamma/Recorder.h"
+#include "Gamma/Thread.h"
 
 namespace gam{
-	
-	
+
+class PeakCache;
+
+
 /// Class for reading and writing sound file data
 class SoundFile{
 public:
@@ -103,6 +109,12 @@ public:
 	template<class T>
 	int readAllD(T * dst);
 
+	/// Copy all contents of file into float array deinterleaved. Returns number of frames read.
+
+	/// Integer PCM samples are converted and deinterleaved in a single pass
+	/// over small blocks, so no memory is allocated for the whole file.
+	int readAllD(float * dst);
+
 	/// Write interleaved frames from array to file
 
 	/// From the libsndfile docs:\n
@@ -115,6 +127,15 @@ public:
 	template<class T>
 	int write(const std::vector<T>& src);
 
+	/// Set whether to add TPDF dither when writing floats to a 16-bit file
+
+	/// Dither is on by default. It applies to write(const float *, int).
+	///
+	SoundFile& dither(bool v){ mDither=v; return *this; }
+
+	/// Get whether TPDF dither is added when writing floats to a 16-bit file
+	bool dither() const { return mDither; }
+
 	// Sound file properties
 	bool opened() const;						///< Returns whether the sound file is open
 	EncodingType encoding() const;				///< Get encoding type
@@ -140,9 +161,243 @@ public:
 private:
 	class Impl; Impl * mImpl;
 	std::string mPath;
+	bool mDither = true;
+	uint32_t mDitherState = 1;
+};
+
+
+
+/// Read-only memory map of an uncompressed sound file
+
+/// The sample data of a WAV file with 16-bit integer or 32-bit float samples
+/// is mapped into memory and exposed directly, so no samples are decoded or 
+/// copied and pages are loaded lazily from the page cache. The mapping is 
+/// private: writing to samples copies the touched pages and never changes 
+/// the file. Samples are interleaved, as stored in the file.
+class SoundFileMap{
+public:
+
+	/// Expected access pattern
+	enum Access{
+		NORMAL = 0,	/**< No particular pattern */
+		SEQUENTIAL,	/**< Frames will be read in order */
+		RANDOM,		/**< Frames will be read in random order */
+		WILLNEED,	/**< Frames will be read soon; start loading them */
+		DONTNEED	/**< Frames will not be read soon */
+	};
+
+	SoundFileMap(): mData(0), mMapping(0), mMapSize(0), mHandle(0),
+		mEncoding(SoundFile::PCM_16), mChans(0), mFrames(0), mFrameRate(0){}
+
+	/// The destructor will unmap the file
+	~SoundFileMap(){ close(); }
+
+	/// Map samples of a sound file into memory
+
+	/// \returns true on success or false if the file could not be mapped or
+	/// is not a WAV file with 16-bit integer or 32-bit float samples
+	bool open(const std::string& path, Access access=NORMAL);
+
+	/// Unmap file
+	void close();
+
+	/// Give hint on how a range of frames will be accessed
+
+	/// \param[in] access		access pattern
+	/// \param[in] frame		first frame of range
+	/// \param[in] numFrames	number of frames in range; -1 for all after first
+	/// \returns whether the hint was given (hints are not supported on all 
+	/// platforms)
+	bool advise(Access access, int frame=0, int numFrames=-1);
+
+	bool opened() const { return 0 != mData; }	///< Returns whether a file is mapped
+	SoundFile::EncodingType encoding() const { return mEncoding; } ///< Get encoding type, PCM_16 or FLOAT
+	double frameRate() const { return mFrameRate; }	///< Get frames/second
+	int frames() const { return mFrames; }			///< Get number of frames
+	int channels() const { return mChans; }			///< Get number of channels
+	int samples() const { return mFrames*mChans; }	///< Get number of samples ( = frames x channels)
+
+	/// Get interleaved samples
+
+	/// \returns the samples or NULL if T does not match the encoding
+	/// (float for FLOAT and short for PCM_16)
+	template <class T>
+	T * data() const {
+		return matches(static_cast<T *>(0)) ? static_cast<T *>(mData) : 0;
+	}
+
+	/// Reference interleaved samples from an array without copying
+
+	/// \returns false if T does not match the encoding
+	template <class T, class S, class A>
+	bool view(ArrayBase<T,S,A>& dst) const {
+		T * d = data<T>();
+		if(d) dst.source(d, samples(), true);
+		return 0 != d;
+	}
+
+private:
+	void * mData;		// first sample
+	void * mMapping;	// start of mapped region
+	size_t mMapSize;
+	void * mHandle;		// platform file handle, if needed
+	SoundFile::EncodingType mEncoding;
+	int mChans, mFrames;
+	double mFrameRate;
+
+	bool matches(const float *) const { return SoundFile::FLOAT == mEncoding; }
+	bool matches(const short *) const { return SoundFile::PCM_16 == mEncoding; }
+	template <class T>
+	bool matches(const T *) const { return false; }
+
+	SoundFileMap(const SoundFileMap&);
+	SoundFileMap& operator=(const SoundFileMap&);
+};
+
+
+
+/// Writes a sound file from a real-time thread without blocking
+
+/// Frames written from the audio thread go into a lock-free ring buffer that
+/// a dedicated thread drains to the file in whole chunks. The ring is a 
+/// multiple of the chunk size, so chunks stay aligned in memory and in the
+/// file. If the ring is full, frames are dropped and counted as overruns.
+/// Configure the file through file() before calling open().
+class SoundFileStreamWriter{
+public:
+
+	/// \param[in] bufferFrames	capacity of ring buffer, in frames
+	/// \param[in] chunkFrames		number of frames written to disk at a time
+	SoundFileStreamWriter(int bufferFrames=65536, int chunkFrames=4096);
+
+	/// The destructor will flush and close the file if it's open
+	~SoundFileStreamWriter();
+
+
+	/// Set buffering depth (only while closed)
+
+	/// The capacity is rounded up to a whole number of chunks, and to at
+	/// least two, so one chunk can be written while the next fills; see
+	/// bufferFrames(). Chunks of less than one frame are made one frame.
+	/// \param[in] bufferFrames	capacity of ring buffer, in frames
+	/// \param[in] chunkFrames		number of frames written to disk at a time
+	SoundFileStreamWriter& buffering(int bufferFrames, int chunkFrames);
+
+	/// Set cache to build peaks of frames as written to disk (only while closed)
+
+	/// The channels of the cache are set on open and its partial bins are
+	/// added on close, so an overview of a long recording is ready as soon as
+	/// the file is. Peaks are built on the disk thread. Pass NULL to stop.
+	SoundFileStreamWriter& peaks(PeakCache * cache);
+
+	/// Open file for writing and start disk thread
+
+	/// The number of channels and frame rate of file() must be set first.
+	/// \returns true on success and false otherwise.
+	bool open();
+	bool open(const std::string& path);
+
+	/// Write remaining frames, stop disk thread and close file
+	bool close();
+
+	/// Write interleaved frames (from audio thread)
+
+	/// \returns number of frames buffered; the rest are dropped
+	int write(const float * src, int numFrames);
+
+	/// Write non-interleaved frames, e.g. from AudioIOData (from audio thread)
+
+	/// \param[in] src			numFrames x channels samples, one channel after another
+	/// \param[in] numFrames	number of frames
+	/// \returns number of frames buffered; the rest are dropped
+	int writeNonInterleaved(const float * src, int numFrames);
+
+	bool opened() const { return mFile.opened(); }	///< Returns whether the file is open
+	unsigned overruns() const { return mRing.dropped(); } ///< Get number of frames dropped
+	int writable() const { return mRing.writable(); }	///< Get number of frames that can be written without dropping
+	long long framesWritten() const { return mWritten.load(std::memory_order_relaxed); } ///< Get frames written to disk
+	int bufferFrames() const { return mBufferFrames; }	///< Get capacity of ring buffer, in frames
+	int chunkFrames() const { return mChunkFrames; }	///< Get frames written to disk at a time
+
+	/// Get sound file to set format, channels, etc.
+	SoundFile& file(){ return mFile; }
+
+private:
+	SoundFile mFile;
+	Recorder mRing;
+	Thread mThread;
+	PeakCache * mPeaks;
+	std::atomic<bool> mRunning;
+	std::atomic<long long> mWritten;
+	int mBufferFrames, mChunkFrames;
+
+	int drain(bool all);
+	static void * cDiskFunc(void * user);
 };
 
 
+/// Build peak cache of a sound file
+
+/// Segments of the file are read in parallel by separate threads, each
+/// opening the file itself, and their peaks are joined in order.
+/// \param[out] dst		cache to build
+/// \param[in] path		path of sound file
+/// \param[in] threads	number of threads to read with
+/// \returns whether the file was read
+bool readPeaks(PeakCache& dst, const std::string& path, int threads=1);
+
+
+/// Processes the frames of a sound file for processFile()
+
+/// A processor is copied, in the state it was given, once per chunk of the
+/// file, so it should hold its unit generators by value.
+class FileProcessor{
+public:
+
+	/// How chunks are joined
+	enum Handoff{
+		WARM_UP = 0,	/**< Run over frames preceding chunk, discarding output; for any processor whose memory fades */
+		OVERLAP_ADD		/**< Continue past chunk with zeros and add tail to next chunk; exact for linear processors */
+	};
+
+	virtual ~FileProcessor(){}
+
+	/// Process interleaved frames in place
+	virtual void onProcess(float * frames, int numFrames, int channels) = 0;
+
+	/// Get copy of this processor
+	virtual FileProcessor * clone() const = 0;
+};
+
+
+/// Process a sound file in parallel chunks
+
+/// The file is split into chunks processed concurrently by separate threads,
+/// each reading the file itself with its own copy of the processor. State is
+/// handed from one chunk to the next with 'overlap' frames, which should
+/// cover the memory of the processor (e.g., the length of an FIR, or the
+/// time for IIR filters and reverbs to decay below the noise floor):
+/// WARM_UP runs the copy over the frames preceding the chunk first, while
+/// OVERLAP_ADD adds the response of a chunk that rings past its end, with a
+/// zero input, to the following chunk. Chunks are written in order through a
+/// SoundFileStreamWriter as they complete, and at most two per thread are
+/// held in memory. The output has the format and length of the source.
+///
+/// \param[in] dst			path of file to write
+/// \param[in] src			path of file to read
+/// \param[in] proc			processor copied for each chunk
+/// \param[in] overlap		number of frames handing over state between chunks
+/// \param[in] handoff		how chunks are joined
+/// \param[in] threads		number of threads to process with
+/// \param[in] chunkFrames	number of frames per chunk
+/// \returns whether the file was processed
+bool processFile(
+	const std::string& dst, const std::string& src, const FileProcessor& proc,
+	int overlap, FileProcessor::Handoff handoff = FileProcessor::WARM_UP,
+	int threads=1, int chunkFrames=262144
+);
+
+
 
 
 // Implementation_______________________________________________________________
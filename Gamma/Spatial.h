@@ -9,8 +9,10 @@
 */
 
 #include <initializer_list>
+#include <vector>
 #include "Gamma/scl.h"
 #include "Gamma/Types.h"
+#include "Gamma/Block.h"
 #include "Gamma/Delay.h"
 #include "Gamma/Filter.h"
 
@@ -41,6 +43,9 @@ public:
 	/// Get filter gain
 	float gain() const { return mA0; }
 
+	/// Get coefficients of y[n] = c0 (x[n] + c1 x[n-1]) + c2 y[n-1]
+	void coefs(float * c) const { c[0]=mA0; c[1]=0.f; c[2]=0.f; }
+
 private:
 	float mA0=0.f;
 };
@@ -72,6 +77,9 @@ public:
 		return mA0 / (1.f - scl::abs(mB1));
 	}
 
+	/// Get coefficients of y[n] = c0 (x[n] + c1 x[n-1]) + c2 y[n-1]
+	void coefs(float * c) const { c[0]=mA0; c[1]=0.f; c[2]=mB1; }
+
 private:
 	float mA0=0.f, mB1=0.f;
 	T mO1=T(0);
@@ -107,6 +115,9 @@ public:
 		return 2.f * mA0 / (mB1 + 1.f);
 	}
 
+	/// Get coefficients of y[n] = c0 (x[n] + c1 x[n-1]) + c2 y[n-1]
+	void coefs(float * c) const { c[0]=mA0; c[1]=1.f; c[2]=-mB1; }
+
 private:
 	float mA0=0.f, mB1=0.f;
 	T mI1=T(0), mO1=T(0);
@@ -139,6 +150,16 @@ public:
 	/// Filter next sample
 	Tv operator()(Tv in);
 
+	/// Filter a block of samples
+
+	/// This gives the same output as calling operator()(Tv) on each sample.
+	/// The block is split into spans no longer than the delay, so that a span
+	/// is read, then filtered and written, each in a tight loop.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
 
 	/// Get decay length
 	float decay() const { return mDecay; }
@@ -218,6 +239,84 @@ enum ReverbFlavor{
 };
 
 
+/// Feedback matrix of ReverbFDN
+enum FDNMatrix{
+	HADAMARD,	/**< Hadamard; each line feeds all lines with equal magnitude */
+	HOUSEHOLDER	/**< Householder reflection; lines mostly feed themselves */
+};
+
+
+/// Filter frames of lanes through comb loop filters
+
+/// Each lane k runs y[n] = c0 (x[n] + c1 x[n-1]) + c2 y[n-1] on the samples
+/// X[i*lanes + k] and replaces them with in[i] + y[n], the next comb inputs.
+/// This form covers the loop filters of ReverbMS.
+///
+/// \param[in,out] X		frames of lanes
+/// \param[in]     lanes	number of lanes; a multiple of 8
+/// \param[in]     in		input of each frame
+/// \param[in]     n		number of frames
+/// \param[in]     coefs	lanes coefficients c0, then c1, then c2
+/// \param[in,out] state	lanes previous inputs x[n-1], then outputs y[n-1]
+void combLoopLanes(
+	float * X, unsigned lanes, const float * in, unsigned n,
+	const float * coefs, float * state
+);
+
+template <class T>
+void combLoopLanes(
+	T * X, unsigned lanes, const T * in, unsigned n,
+	const float * coefs, T * state
+){
+	const float * c0 = coefs, * c1 = c0 + lanes, * c2 = c1 + lanes;
+	T * x1 = state, * y1 = x1 + lanes;
+	for(unsigned i=0; i<n; ++i){
+		T * v = X + i*lanes;
+		for(unsigned k=0; k<lanes; ++k){
+			T y = (v[k] + c1[k]*x1[k])*c0[k] + y1[k]*c2[k];
+			x1[k] = v[k];
+			y1[k] = y;
+			v[k] = in[i] + y;
+		}
+	}
+}
+
+
+/// Filter rows of samples through loop filters
+
+/// Row k runs y[n] = c0 (x[n] + c1 x[n-1]) + c2 y[n-1] in place on the
+/// samples Y[k*stride + i], as the lines of ReverbFDN. The rows are filtered
+/// four at a time in SIMD registers, transposing blocks of four samples.
+///
+/// \param[in,out] Y		rows of samples
+/// \param[in]     stride	distance between rows
+/// \param[in]     rows		number of rows; a multiple of 4
+/// \param[in]     n		number of samples of each row
+/// \param[in]     coefs	rows coefficients c0, then c1, then c2
+/// \param[in,out] state	rows previous inputs x[n-1], then outputs y[n-1]
+void loopFilterRows(
+	float * Y, unsigned stride, unsigned rows, unsigned n,
+	const float * coefs, float * state
+);
+
+template <class T>
+void loopFilterRows(
+	T * Y, unsigned stride, unsigned rows, unsigned n,
+	const float * coefs, T * state
+){
+	const float * c0 = coefs, * c1 = c0 + rows, * c2 = c1 + rows;
+	T * x1 = state, * y1 = x1 + rows;
+	for(unsigned i=0; i<n; ++i){
+		for(unsigned k=0; k<rows; ++k){
+			const T v = Y[k*stride + i];
+			y1[k] = (v + c1[k]*x1[k])*c0[k] + y1[k]*c2[k];
+			x1[k] = v;
+			Y[k*stride + i] = y1[k];
+		}
+	}
+}
+
+
 /// Schroeder reverberator
 
 /// This simulates the late reflections in a reverberant space using an
@@ -229,9 +328,16 @@ enum ReverbFlavor{
 /// very metallic sounding responses due to the fixed resonances of the comb 
 /// filters.
 ///
+/// All delay lines are stored in one buffer, each as a ring as long as its
+/// delay. The loop filter coefficients and states of the combs are stored
+/// lane by lane, so that the block process() updates all combs at once with
+/// SIMD instructions, after copying each comb's span of the block out of its
+/// ring. The allpasses are filtered over contiguous spans of their rings.
+///
 /// \tparam Tv			Value (sample) type
-/// \tparam LoopFilter	Filter to insert in comb feedback loop
-/// \tparam Si			Interpolation strategy
+/// \tparam LoopFilter	Filter to insert in comb feedback loop; must provide
+///						gain(), damping() and coefs(), as Loop1P
+/// \tparam Si			Not used; delays are a whole number of samples
 /// \tparam Td			Domain type
 /// \ingroup Spatial
 template<
@@ -243,10 +349,8 @@ template<
 class ReverbMS : public Td {
 public:
 
-	typedef std::vector<Echo<Tv, Si, LoopFilter, Domain1>> Combs;
-	typedef std::vector<Comb<Tv, Si, float, Domain1>> Allpasses;
-
 	ReverbMS();
+	virtual ~ReverbMS(){}
 
 
 	/// Resize delay lines based on a particular flavor of reverb
@@ -279,24 +383,214 @@ public:
 	/// Filter next sample
 	Tv operator()(Tv in);
 
+	/// Filter a block of samples
+
+	/// This gives the same output as calling operator()(Tv) on each sample.
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples; may equal in
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
 	/// Get sum of comb delay taps
+
+	/// \param[in] delays	samples ago to read from each comb, in [1, delay]
 	Tv read(std::initializer_list<unsigned> delays) const;
 
+	/// Zero delay lines and loop filter states
+	void zero();
+
+	/// Save or restore delay lines and loop filters with a StateWriter or StateReader
+
+	/// When restoring, the reverb is left unchanged if the archive fails or
+	/// its layout is inconsistent.
+	template <class Archive>
+	void state(Archive& ar){
+		if(!Archive::loading){
+			ar(mDecay)(mApFbk)(mNC)(mNA)(mLanes)(mBuf)(mLen)(mBase)(mPos)(mLoops)(mCoef)(mState);
+			return;
+		}
+		float dcy = 0, apFbk = 0;
+		unsigned nc = 0, na = 0, lanes = 0;
+		std::vector<Tv> buf, st;
+		std::vector<unsigned> len, base, pos;
+		std::vector<LoopFilter<Tv> > loops;
+		std::vector<float> coef;
+		ar(dcy)(apFbk)(nc)(na)(lanes)(buf)(len)(base)(pos)(loops)(coef)(st);
+		bool valid = lanes == (nc + VEC-1)/VEC*VEC
+			&& len.size() == nc + na && base.size() == len.size() && pos.size() == len.size()
+			&& loops.size() == nc && coef.size() == 3*lanes && st.size() == 2*lanes;
+		for(unsigned i=0; valid && i<len.size(); ++i){
+			valid = len[i] && pos[i] < len[i] && base[i] <= buf.size() && len[i] <= buf.size() - base[i];
+		}
+		if(!ar.check(valid).ok()) return;
+		mDecay = dcy; mApFbk = apFbk;
+		mNC = nc; mNA = na; mLanes = lanes;
+		mBuf.swap(buf); mLen.swap(len); mBase.swap(base); mPos.swap(pos);
+		mLoops.swap(loops); mCoef.swap(coef); mState.swap(st);
+		mScratch.assign(BLOCK*mLanes, Tv(0));
+	}
 
 	/// Get decay length
 	float decay() const { return mDecay; }
 
-	Combs& combs(){ return mCombs; }
-	Allpasses& allpasses(){ return mAllpasses; }
+	unsigned numCombs() const { return mNC; }		///< Get number of combs
+	unsigned numAllpasses() const { return mNA; }	///< Get number of allpasses
+	unsigned combDelay(unsigned i) const { return mLen[i]; }		///< Get delay of a comb, in samples
+	unsigned allpassDelay(unsigned i) const { return mLen[mNC+i]; }	///< Get delay of an allpass, in samples
+
+	/// Get bytes of heap memory allocated for delay lines and loop states
+	std::size_t sizeInBytes() const;
 
 	void print() const;
 
 private:
+	enum{ BLOCK = 64, VEC = 8 };
 	float mDecay;
-	Combs mCombs;
-	Allpasses mAllpasses;
+	float mApFbk;						// allpass feedback (negated feedforward)
+	unsigned mNC, mNA, mLanes;			// combs, allpasses, combs rounded up to VEC
+	std::vector<Tv> mBuf;				// rings of combs, then allpasses
+	std::vector<unsigned> mLen, mBase, mPos;	// ring length, offset in mBuf and read/write index of each line
+	std::vector<LoopFilter<Tv> > mLoops;	// designers of comb loop filters
+	std::vector<float> mCoef;			// comb loop coefs c0, c1, c2 by lane
+	std::vector<Tv> mState;				// comb loop x[n-1], y[n-1] by lane
+	std::vector<Tv> mScratch;			// comb samples of a block, frames of mLanes
+
+	void layout(std::initializer_list<unsigned> delays, unsigned first, unsigned count);
+	void updateCoefs();
+
+	virtual void onDomainChange(double r){
+		decay(decay());
+	}
+};
+
+
+
+/// Feedback delay network reverberator
+
+/// This simulates late reflections with N delay lines whose outputs are
+/// damped by loop filters, mixed by an orthogonal feedback matrix and fed back
+/// into their inputs along with the input signal. Since the matrix mixes every
+/// line into every other, the echo density grows much faster than with
+/// parallel combs, and the tails are smooth with fewer lines.
+///
+/// The delays are spread geometrically between a minimum and maximum and
+/// rounded to distinct primes. Each line's delay can be swept by a sine LFO,
+/// read with the interpolation strategy Si, to blur the resonances of the
+/// network.
+///
+/// All lines are stored as rings in one buffer, each padded to a multiple of
+/// 8 samples. The block process() reads all lines for up to 64 samples at
+/// once, which is possible as long as the shortest delay is longer than the
+/// block, then applies the loop filters, the matrix butterflies and the
+/// writes over whole blocks, so that each stage vectorizes over time.
+///
+/// \tparam Tv			Value (sample) type
+/// \tparam N			Number of delay lines; a power of two, at least 4
+/// \tparam LoopFilter	Filter to insert in each line's feedback loop; must
+///						provide gain(), damping() and coefs(), as Loop1P
+/// \tparam Si			Interpolation strategy for modulated delays
+/// \tparam Td			Domain type
+/// \ingroup Spatial
+template<
+	typename Tv = gam::real,
+	unsigned N = 8,
+	template<typename> class LoopFilter = Loop1P,
+	template<typename> class Si = ipl::Linear,
+	class Td = DomainObserver
+>
+class ReverbFDN : public Td {
+public:
+
+	ReverbFDN();
+	virtual ~ReverbFDN(){}
+
+
+	/// Set range of delays
+
+	/// \param[in] minDelay	delay of shortest line, in domain units
+	/// \param[in] maxDelay	delay of longest line, in domain units
+	ReverbFDN& delays(float minDelay, float maxDelay);
+
+	/// Set decay length, in domain units
+	ReverbFDN& decay(float v);
+
+	/// Set damping factor
+	ReverbFDN& damping(float v);
+
+	/// Set feedback matrix
+	ReverbFDN& matrix(FDNMatrix v){ mMatrix=v; return *this; }
+
+	/// Set delay modulation
+
+	/// Changing the depth may zero the delay lines.
+	/// \param[in] depth	depth of delay sweep, in domain units
+	/// \param[in] rate		frequency of delay sweep, in Hz
+	ReverbFDN& modulate(float depth, float rate);
+
+	/// Filter next sample
+	Tv operator()(Tv in);
+
+	/// Filter next sample into left and right outputs
+	void operator()(Tv in, Tv& outL, Tv& outR);
+
+	/// Filter a block of samples
+
+	/// \param[in]  in		input samples
+	/// \param[out] out	output samples (sum of left and right); may equal in
+	/// \param[in]  n		number of samples
+	void process(const Tv * in, Tv * out, unsigned n);
+
+	/// Filter a block of samples into left and right outputs
+
+	/// The even lines feed the left output and the odd lines the right.
+	/// Without modulation, this gives the same output as calling operator()
+	/// on each sample, at a fraction of the cost. With modulation, the delays
+	/// are swept linearly between LFO values at the ends of each block.
+	void process(const Tv * in, Tv * outL, Tv * outR, unsigned n);
+
+	/// Zero delay lines and loop filter states
+	void zero();
+
+
+	/// Get decay length
+	float decay() const { return mDecay; }
+
+	/// Get delay of a line, in samples
+	unsigned delay(unsigned i) const { return mDelay[i]; }
+
+	/// Get number of delay lines
+	static unsigned size(){ return N; }
+
+	/// Get bytes of heap memory allocated for delay lines
+
+	/// As for all sizeInBytes() methods, reserved capacity is counted and the
+	/// object itself is not.
+	std::size_t sizeInBytes() const { return mBuf.capacity()*sizeof(Tv); }
+
+	void print() const;
+
+private:
+	enum{ BLOCK = 64 };
+	static_assert(N >= 4 && (N & (N-1)) == 0, "Number of lines must be a power of two, at least 4");
+
+	float mMinDelay, mMaxDelay, mDecay, mDepth, mRate;
+	FDNMatrix mMatrix;
+	unsigned mBlock;					// samples that can be read before writing
+	unsigned mDelay[N], mLen[N], mBase[N], mPos[N];	// delay, ring length, offset in mBuf and write index of each line
+	float mPhase[N];					// LFO phases in [0, 1)
+	std::vector<Tv> mBuf;				// rings of lines
+	LoopFilter<Tv> mLoops[N];			// designers of loop filters
+	float mC0[N], mC1[N], mC2[N];		// loop coefs, as LoopFilter::coefs
+	Tv mX1[N], mY1[N];					// loop states
+	Tv mY[N * BLOCK];					// line samples of a block, one row per line
+	Si<Tv> mIpol;
+
+	void layout();
+	void run(const Tv * in, Tv * outL, Tv * outR, unsigned n);
+	static bool isPrime(unsigned v);
 
 	virtual void onDomainChange(double r){
+		layout();
 		decay(decay());
 	}
 };
@@ -336,6 +630,15 @@ public:
 	/// Set distance from source to a destination, in meters
 	Dist& dist(int dest, float d);
 
+	/// Glide to a distance from source to a destination over n samples
+
+	/// The delay and amplitude move linearly from their current values to
+	/// those of the new distance over the next n filtered samples. Updating
+	/// moving sources this way at a control rate avoids the clicks of
+	/// jumping delays. The air absorption filter is set at once. Setting a
+	/// distance without a glide stops the glide.
+	Dist& dist(int dest, float d, unsigned n);
+
 	/// Set distance vector from source to a destination, in meters
 	Dist& dist(int dest, float x, float y, float z=0);
 
@@ -362,6 +665,7 @@ private:
 	float mDly[Ndest];
 	float mAmp[Ndest];
 	OnePole<T> mLPF[Ndest];
+	CoefRamp<2,float> mRamp[Ndest];	// delay and amplitude glides
 
 	void setRollOff();
 	float inverse(float dist) const;
@@ -369,6 +673,248 @@ private:
 
 
 
+/// Early reflections of a shoebox room by the image-source method
+
+/// Each reflection path of a source is the straight line from an image of the
+/// source, mirrored across the walls, to an ear of the listener. Its delay is
+/// the travel time of the path and its gain the product of the gains of the
+/// walls it hits with the inverse distance law. The images of all reflection
+/// orders up to a maximum are computed once per change of room and cached as a
+/// mirror sign, offset and wall gain per axis, so a moved source only updates
+/// the distances of its own paths. The paths are rendered as a sparse
+/// multitap over a delay buffer per source, each path gliding to its new delay
+/// and gain over the next samples after a change.
+///
+/// The room spans from the origin to its dimensions along x (right), y (front)
+/// and z (up), in meters. The ears are on the x axis of the listener. The
+/// direct sound is not included.
+class EarlyReflections : public DomainObserver{
+public:
+
+	/// Walls of room
+	enum Wall{
+		LEFT, RIGHT, BACK, FRONT, FLOOR, CEILING
+	};
+
+	/// \param[in] numSources	number of sources
+	/// \param[in] order		maximum number of reflections of a path
+	EarlyReflections(unsigned numSources=1, unsigned order=2);
+
+
+	/// Set number of sources; positions of new sources are at the origin
+	EarlyReflections& numSources(unsigned n);
+
+	/// Get number of sources
+	unsigned numSources() const { return mNumSrc; }
+
+	/// Set maximum number of reflections of a path
+	EarlyReflections& order(unsigned v){ mOrder=v; mRoomDirty=true; return *this; }
+
+	/// Get maximum number of reflections of a path
+	unsigned order() const { return mOrder; }
+
+	/// Set dimensions of room
+	EarlyReflections& room(float x, float y, float z);
+
+	/// Set gain of a wall's reflections
+	EarlyReflections& wallGain(Wall w, float v){ mWallGain[w]=v; mRoomDirty=true; return *this; }
+
+	/// Set gain of reflections of all walls
+	EarlyReflections& wallGain(float v);
+
+	/// Set speed of sound
+	EarlyReflections& speedOfSound(float v){ mSpeed=v; mRoomDirty=true; return *this; }
+
+	/// Set near clipping distance of inverse distance law
+	EarlyReflections& near(float v){ mNear=v; mAllDirty=true; return *this; }
+
+	/// Set ear distance (measured from center of head)
+	EarlyReflections& earDist(float v){ mEarDist=v; mAllDirty=true; return *this; }
+
+	/// Set position of listener
+	EarlyReflections& listener(float x, float y, float z);
+
+	/// Set position of a source
+	EarlyReflections& pos(unsigned i, float x, float y, float z);
+
+	/// Set number of samples paths glide over after a change
+	EarlyReflections& glide(unsigned n){ mGlide = n ? n : 1; return *this; }
+
+
+	/// Compute reflection paths after changes
+
+	/// This is called by process() after any change. Changes of the room
+	/// recompute the images and all paths; changes of positions recompute
+	/// the paths of the sources moved.
+	void update();
+
+	/// Get number of reflection paths of a source to each ear
+	unsigned paths() const { return mImgGain.size(); }
+
+	/// Get delay of a path in samples, as of the last update (0 = left, 1 = right)
+	float pathDelay(unsigned src, unsigned path, unsigned ear) const {
+		return mTarget[tapIndex(src, path, ear)];
+	}
+
+	/// Get gain of a path, as of the last update (0 = left, 1 = right)
+	float pathGain(unsigned src, unsigned path, unsigned ear) const {
+		return mTarget[tapIndex(src, path, ear) + 1];
+	}
+
+
+	/// Add reflections of sources to outputs
+
+	/// \param[in]     src	input buffer of each source
+	/// \param[in,out] outL	left output; reflections are added to it
+	/// \param[in,out] outR	right output; reflections are added to it
+	/// \param[in]     n	number of samples
+	void process(const float * const * src, float * outL, float * outR, unsigned n);
+
+	void onDomainChange(double r){ mRoomDirty = true; }
+
+private:
+	enum{ BLOCK = 64 };
+
+	unsigned mNumSrc, mOrder, mGlide;
+	float mRoom[3], mLis[3], mWallGain[6];
+	float mSpeed, mNear, mEarDist;
+	bool mRoomDirty, mAllDirty;
+
+	// Images of a source, by axis, then image: x = sign * source x + offset
+	std::vector<float> mImgSign, mImgOff;
+	std::vector<float> mImgGain;		// product of wall gains
+
+	std::vector<float> mX, mY, mZ;		// source positions
+	std::vector<char> mDirty;			// whether a source's paths are out of date
+	std::vector<char> mFresh;			// whether a source's paths have not been rendered
+
+	// Taps as (delay, gain) by source, ear, then path
+	std::vector<float> mCurrent, mTarget;
+	std::vector<unsigned> mRemain;		// samples of glide left per source
+
+	std::vector<float> mBuffers;		// delay buffer per source, mirrored
+	unsigned mSize, mPos;				// buffer size (power of 2), write position
+
+	unsigned tapIndex(unsigned src, unsigned path, unsigned ear) const {
+		return 2*((src*2 + ear)*paths() + path);
+	}
+	void images();
+	void updatePaths(unsigned src);
+	void render(const float * const * src, unsigned off, float * outL, float * outR, unsigned n);
+};
+
+
+
+/// Vector-base amplitude panner for arrays of speakers
+
+/// Each source is panned to the three speakers whose spherical triangle
+/// contains its direction. The gains are the direction multiplied by the
+/// inverse of the matrix of the speakers' directions, normalized to constant
+/// power (Pulkki, 1997). The speakers are triangulated by their convex hull
+/// once per change of layout, and the inverse matrices are stored with the
+/// triangles. Parts of the sphere the layout does not enclose, such as below
+/// a dome, and faces of the hull with more than three speakers, such as the
+/// top ring of a dome without a top speaker, get imaginary speakers whose
+/// signals are discarded. A horizontal ring thus pans between pairs.
+///
+/// The triangle of a moved source is looked for first in the one it was in,
+/// then in the one of its cell in a grid of directions, and only then among
+/// all triangles. After a move, gains glide linearly over a number of
+/// samples. They are applied per source and speaker to whole blocks, so a
+/// source costs three multiply-adds per sample when not gliding.
+///
+/// Directions are vectors with x to the right, y to the front and z up, or
+/// azimuth and elevation in degrees, with azimuth counterclockwise from the
+/// front.
+class VBAP{
+public:
+
+	/// \param[in] numSources	number of sources
+	VBAP(unsigned numSources=1);
+
+
+	/// Set number of sources; directions of new sources are to the front
+	VBAP& numSources(unsigned n);
+
+	/// Get number of sources
+	unsigned numSources() const { return mNumSrc; }
+
+	/// Add a speaker; at least three are needed
+	VBAP& addSpeaker(float azimuth, float elevation=0);
+
+	/// Remove all speakers
+	VBAP& clearSpeakers();
+
+	/// Get number of speakers, not counting imaginary ones
+	unsigned numSpeakers() const { return mNumReal; }
+
+	/// Set direction of a source as a vector
+	VBAP& pos(unsigned src, float x, float y, float z);
+
+	/// Set direction of a source as azimuth and elevation, in degrees
+	VBAP& direction(unsigned src, float azimuth, float elevation=0);
+
+	/// Set number of samples gains glide over after a move
+	VBAP& glide(unsigned n){ mGlide = n ? n : 1; return *this; }
+
+
+	/// Triangulate speakers and pan sources after changes
+
+	/// This is called by process() after any change. Changes of the speakers
+	/// triangulate them again, which allocates memory and takes time growing
+	/// with the fourth power of their number, and so should not be done on
+	/// the audio thread. Moves of sources find their triangles.
+	void update();
+
+	/// Get number of triangles of speakers, as of the last update
+	unsigned triangles() const { return mTri.size()/3; }
+
+	/// Get number of imaginary speakers, as of the last update
+	unsigned numImaginary() const { return mSpk.size()/3 - mNumReal; }
+
+	/// Get gain of a source to a speaker, as of the last update
+	float gain(unsigned src, unsigned spk) const;
+
+
+	/// Add sources to speaker outputs
+
+	/// \param[in]     src	input buffer of each source
+	/// \param[in,out] out	output buffer of each speaker; sources are added to it
+	/// \param[in]     n	number of samples
+	void process(const float * const * src, float * const * out, unsigned n);
+
+private:
+	enum{
+		SLOTS = 6,				// speakers of a source, gliding from one triangle to another
+		GRID_AZ = 36, GRID_EL = 18
+	};
+
+	std::vector<float> mSpk;			// speaker directions, real then imaginary
+	unsigned mNumReal;
+	std::vector<unsigned> mTri;			// speakers of each triangle
+	std::vector<float> mInv;			// inverse matrix of each triangle
+	std::vector<unsigned> mGrid;		// triangle of center of each grid cell
+	bool mLayoutDirty;
+
+	unsigned mNumSrc, mGlide;
+	std::vector<float> mDir;			// source directions
+	std::vector<char> mDirty;			// whether a source's gains are out of date
+	std::vector<char> mFresh;			// whether a source has not been rendered
+	std::vector<unsigned> mLast;		// triangle a source was last found in
+	std::vector<unsigned> mSlots;		// number of speakers of each source
+	std::vector<unsigned> mSlotSpk;		// speakers by source, then slot
+	std::vector<float> mCur, mTar;		// gains by source, then slot
+	std::vector<unsigned> mRemain;		// samples of glide left per source
+
+	void triangulate();
+	unsigned findTriangle(const float * dir, unsigned hint, float * g) const;
+	float tryTriangle(unsigned t, const float * dir, float * g) const;
+	void updateSource(unsigned src);
+	void settle(unsigned src);
+};
+
+
+
 // Implementation_______________________________________________________________
 
 namespace{
@@ -414,6 +960,23 @@ inline Tv Echo<TARG>::operator()(Tv in){
 	return Delay<Tv,Si,Td>::operator()(in + echo);
 }
 
+template<TDEC>
+void Echo<TARG>::process(const Tv * in, Tv * out, unsigned n){
+	enum{ B = 64 };
+	unsigned span = this->readSpan(this->mDelay, this->mDelay);
+	if(span > B) span = B;
+	Tv o[B], t[B];
+
+	while(n){
+		const unsigned m = n < span ? n : span;
+		this->readSpan(o, NULL, m);
+		for(unsigned i=0; i<m; ++i) t[i] = in[i] + mFilter(o[i]);
+		this->writeSpan(t, m);
+		std::copy(o, o+m, out);
+		in += m; out += m; n -= m;
+	}
+}
+
 
 
 template<TDEC>
@@ -478,35 +1041,61 @@ inline Complex<Tv> EchoCSine<TARG>::operator()(Tv v){
 #define TARG Tv,LoopFilter,Si,Td
 
 template<TDEC>
-ReverbMS<TARG>::ReverbMS(){
+ReverbMS<TARG>::ReverbMS()
+:	mDecay(1), mApFbk(0.71f), mNC(0), mNA(0), mLanes(0)
+{
 	decay(1);
 }
 
+// Replace lengths of 'count' lines from 'first' and lay out all rings again
 template<TDEC>
-ReverbMS<TARG>& ReverbMS<TARG>::resizeComb(std::initializer_list<unsigned> delays){
-	if(delays.size() != mCombs.size()){
-		mCombs.resize(delays.size());
-	}
-	for(unsigned i=0; i<mCombs.size(); ++i){
+void ReverbMS<TARG>::layout(std::initializer_list<unsigned> delays, unsigned first, unsigned count){
+	std::vector<unsigned> len(mLen);
+	len.erase(len.begin()+first, len.begin()+first+count);
+	for(unsigned i=0; i<delays.size(); ++i){
 		unsigned d = delays.begin()[i];
-		mCombs[i].maxDelay(d);
-		mCombs[i].delay(d);
+		len.insert(len.begin()+first+i, d ? d : 1);
+	}
+	mLen = len;
+
+	const unsigned N = mLen.size();
+	mBase.resize(N);
+	mPos.assign(N, 0);
+	unsigned total = 0;
+	for(unsigned i=0; i<N; ++i){ mBase[i] = total; total += mLen[i]; }
+	mBuf.assign(total, Tv(0));
+
+	mLanes = (mNC + VEC-1)/VEC*VEC;
+	mCoef.assign(3*mLanes, 0.f);
+	mState.assign(2*mLanes, Tv(0));
+	mScratch.assign(BLOCK*mLanes, Tv(0));
+}
+
+template<TDEC>
+void ReverbMS<TARG>::updateCoefs(){
+	for(unsigned k=0; k<mNC; ++k){
+		float c[3];
+		mLoops[k].coefs(c);
+		for(unsigned j=0; j<3; ++j) mCoef[j*mLanes + k] = c[j];
 	}
+}
+
+template<TDEC>
+ReverbMS<TARG>& ReverbMS<TARG>::resizeComb(std::initializer_list<unsigned> delays){
+	const unsigned old = mNC;
+	mNC = delays.size();
+	mLoops.resize(mNC);
+	layout(delays, 0, old);
 	decay(decay());
 	return *this;
 }
 
 template<TDEC>
 ReverbMS<TARG>& ReverbMS<TARG>::resizeAllpass(std::initializer_list<unsigned> delays){
-	if(delays.size() != mAllpasses.size()){
-		mAllpasses.resize(delays.size());
-	}
-	for(unsigned i=0; i<mAllpasses.size(); ++i){
-		unsigned d = delays.begin()[i];
-		mAllpasses[i].maxDelay(d);
-		mAllpasses[i].delay(d);
-		mAllpasses[i].allPass(0.71); // all use the same feedback amount
-	}
+	const unsigned old = mNA;
+	mNA = delays.size();
+	layout(delays, mNC, old);
+	updateCoefs();
 	return *this;
 }
 
@@ -540,53 +1129,415 @@ template<TDEC>
 ReverbMS<TARG>& ReverbMS<TARG>::decay(float v){
 	mDecay = v;
 	float decaySamples = v * Td::spu();
-	for(unsigned i=0; i<mCombs.size(); ++i) mCombs[i].decay(decaySamples);
+	for(unsigned i=0; i<mNC; ++i) mLoops[i].gain(decayToFbk(decaySamples, float(mLen[i])));
+	updateCoefs();
 	return *this;
 }
 
 template<TDEC>
 ReverbMS<TARG>& ReverbMS<TARG>::damping(float v){
-	for(unsigned i=0; i<mCombs.size(); ++i) mCombs[i].damping(v);
+	for(unsigned i=0; i<mNC; ++i) mLoops[i].damping(v);
+	updateCoefs();
 	return *this;
 }
 
+template<TDEC>
+void ReverbMS<TARG>::zero(){
+	for(auto& v : mBuf) v = Tv(0);
+	for(auto& v : mState) v = Tv(0);
+}
+
 template<TDEC>
 inline Tv ReverbMS<TARG>::operator()(Tv in){
+	Tv * buf = &mBuf[0];
 
 	// Series allpasses
-	for(unsigned i=0; i<mAllpasses.size(); ++i){
-		in = mAllpasses[i](in);
+	for(unsigned j=mNC; j<mNC+mNA; ++j){
+		Tv& r = buf[mBase[j] + mPos[j]];
+		Tv t = in + r * mApFbk;
+		in = r - t * mApFbk;
+		r = t;
+		if(++mPos[j] == mLen[j]) mPos[j] = 0;
 	}
 
 	// Parallel combs
+	const float * c0 = &mCoef[0], * c1 = c0 + mLanes, * c2 = c1 + mLanes;
+	Tv * x1 = &mState[0], * y1 = x1 + mLanes;
 	Tv res = Tv(0);
-	for(unsigned i=0; i<mCombs.size(); ++i){
-		res += mCombs[i](in);
+	for(unsigned k=0; k<mNC; ++k){
+		Tv& r = buf[mBase[k] + mPos[k]];
+		const Tv v = r;
+		res += v;
+		y1[k] = (v + c1[k]*x1[k])*c0[k] + y1[k]*c2[k];
+		x1[k] = v;
+		r = in + y1[k];
+		if(++mPos[k] == mLen[k]) mPos[k] = 0;
 	}
 
 	return res;
 }
 
+template<TDEC>
+void ReverbMS<TARG>::process(const Tv * in, Tv * out, unsigned n){
+	if(!mNC){
+		for(unsigned i=0; i<n; ++i) out[i] = (*this)(in[i]);
+		return;
+	}
+
+	Tv * buf = &mBuf[0];
+	Tv * X = &mScratch[0];
+	const unsigned L = mLanes;
+
+	while(n){
+		const unsigned m = n < BLOCK ? n : BLOCK;
+		Tv x[BLOCK], acc[BLOCK];
+		for(unsigned i=0; i<m; ++i){ x[i] = in[i]; acc[i] = Tv(0); }
+
+		// Series allpasses, over contiguous spans of each ring
+		const float g = mApFbk;
+		for(unsigned j=mNC; j<mNC+mNA; ++j){
+			Tv * r = buf + mBase[j];
+			const unsigned len = mLen[j];
+			unsigned p = mPos[j];
+			for(unsigned i=0; i<m;){
+				const unsigned s = len - p < m - i ? len - p : m - i;
+				Tv * rp = r + p;
+				Tv * xp = x + i;
+				for(unsigned t=0; t<s; ++t){
+					Tv t0 = xp[t] + rp[t] * g;
+					xp[t] = rp[t] - t0 * g;
+					rp[t] = t0;
+				}
+				i += s; p += s;
+				if(p == len) p = 0;
+			}
+			mPos[j] = p;
+		}
+
+		// Copy comb outputs into frames of lanes
+		for(unsigned k=0; k<mNC; ++k){
+			const Tv * r = buf + mBase[k];
+			const unsigned len = mLen[k];
+			unsigned p = mPos[k];
+			for(unsigned i=0; i<m;){
+				const unsigned s = len - p < m - i ? len - p : m - i;
+				const Tv * rp = r + p;
+				Tv * a = acc + i;
+				Tv * v = X + i*L + k;
+				for(unsigned t=0; t<s; ++t){
+					v[t*L] = rp[t];
+					a[t] += rp[t];
+				}
+				i += s; p += s;
+				if(p == len) p = 0;
+			}
+		}
+
+		// Run loop filters of all combs one frame at a time
+		combLoopLanes(X, L, x, m, &mCoef[0], &mState[0]);
+
+		// Write comb inputs back into rings
+		for(unsigned k=0; k<mNC; ++k){
+			Tv * r = buf + mBase[k];
+			const unsigned len = mLen[k];
+			unsigned p = mPos[k];
+			for(unsigned i=0; i<m;){
+				const unsigned s = len - p < m - i ? len - p : m - i;
+				Tv * rp = r + p;
+				const Tv * v = X + i*L + k;
+				for(unsigned t=0; t<s; ++t) rp[t] = v[t*L];
+				i += s; p += s;
+				if(p == len) p = 0;
+			}
+			mPos[k] = p;
+		}
+
+		for(unsigned i=0; i<m; ++i) out[i] = acc[i];
+		in += m; out += m; n -= m;
+	}
+}
+
 template<TDEC>
 inline Tv ReverbMS<TARG>::read(std::initializer_list<unsigned> delays) const {
 	Tv res = Tv(0);
-	for(unsigned i=0; i<mCombs.size(); ++i){
-		res += mCombs[i].read(delays.begin()[i]);
+	for(unsigned i=0; i<mNC; ++i){
+		const unsigned len = mLen[i];
+		res += mBuf[mBase[i] + (mPos[i] + len - delays.begin()[i] % len) % len];
 	}
 	return res;
 }
 
+template<TDEC>
+std::size_t ReverbMS<TARG>::sizeInBytes() const {
+	return mBuf.capacity()*sizeof(Tv) + mState.capacity()*sizeof(Tv) + mScratch.capacity()*sizeof(Tv)
+		+ (mLen.capacity() + mBase.capacity() + mPos.capacity())*sizeof(unsigned)
+		+ mLoops.capacity()*sizeof(LoopFilter<Tv>) + mCoef.capacity()*sizeof(float);
+}
+
 template<TDEC>
 void ReverbMS<TARG>::print() const {
-	unsigned Nc = mCombs.size();
-	unsigned Na = mAllpasses.size();
 	printf("comb delays = {");
-	for(unsigned i=0; i<Nc; ++i)
-		printf("%u%s", mCombs[i].delaySamples(), i!=(Nc-1)?", ":"");
+	for(unsigned i=0; i<mNC; ++i)
+		printf("%u%s", combDelay(i), i!=(mNC-1)?", ":"");
 	printf("} samples\n");
 	printf("allpass delays = {");
-	for(unsigned i=0; i<Na; ++i)
-		printf("%u%s", mAllpasses[i].delaySamples(), i!=(Na-1)?", ":"");
+	for(unsigned i=0; i<mNA; ++i)
+		printf("%u%s", allpassDelay(i), i!=(mNA-1)?", ":"");
+	printf("} samples\n");
+}
+
+#undef TDEC
+#undef TARG
+
+#define TDEC\
+	typename Tv,\
+	unsigned N,\
+	template<typename> class LoopFilter,\
+	template<typename> class Si,\
+	class Td
+
+#define TARG Tv,N,LoopFilter,Si,Td
+
+template<TDEC>
+ReverbFDN<TARG>::ReverbFDN()
+:	mMinDelay(0.03f), mMaxDelay(0.1f), mDecay(1), mDepth(0), mRate(0.5f),
+	mMatrix(HADAMARD), mBlock(1)
+{
+	for(unsigned k=0; k<N; ++k) mPhase[k] = float(k)/N;
+	layout();
+	decay(1);
+}
+
+template<TDEC>
+bool ReverbFDN<TARG>::isPrime(unsigned v){
+	if(v < 2) return false;
+	for(unsigned d=2; d*d<=v; ++d) if(v % d == 0) return false;
+	return true;
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::layout(){
+	const double spu = Td::spu();
+	const unsigned margin = unsigned(std::ceil(mDepth * spu)) + 4;
+	unsigned total = 0, prev = 0;
+	for(unsigned k=0; k<N; ++k){
+		double d = mMinDelay * std::pow(double(mMaxDelay)/mMinDelay, double(k)/(N-1)) * spu;
+		unsigned v = unsigned(d + 0.5);
+		if(v <= prev) v = prev + 1;
+		while(!isPrime(v)) ++v;
+		mDelay[k] = prev = v;
+		mLen[k] = (v + margin + 7) / 8 * 8;
+		mBase[k] = total;
+		mPos[k] = 0;
+		total += mLen[k];
+	}
+	mBuf.assign(total, Tv(0));
+
+	// Reads of a block must not reach samples written in the block
+	const int b = int(mDelay[0]) - int(margin);
+	mBlock = b < 1 ? 1 : (b > int(BLOCK) ? unsigned(BLOCK) : unsigned(b));
+	zero();
+}
+
+template<TDEC>
+ReverbFDN<TARG>& ReverbFDN<TARG>::delays(float minDelay, float maxDelay){
+	mMinDelay = minDelay > 0.f ? minDelay : 1e-4f;
+	mMaxDelay = maxDelay > mMinDelay ? maxDelay : mMinDelay;
+	layout();
+	return decay(decay());
+}
+
+template<TDEC>
+ReverbFDN<TARG>& ReverbFDN<TARG>::modulate(float depth, float rate){
+	mRate = rate;
+	if(depth < 0.f) depth = 0.f;
+	const float old = mDepth;
+	mDepth = depth;
+	if(unsigned(std::ceil(depth * Td::spu())) > unsigned(std::ceil(old * Td::spu()))){
+		layout();
+	}
+	return *this;
+}
+
+template<TDEC>
+ReverbFDN<TARG>& ReverbFDN<TARG>::decay(float v){
+	mDecay = v;
+	float decaySamples = v * Td::spu();
+	for(unsigned k=0; k<N; ++k){
+		mLoops[k].gain(decayToFbk(decaySamples, float(mDelay[k])));
+		float c[3];
+		mLoops[k].coefs(c);
+		mC0[k] = c[0]; mC1[k] = c[1]; mC2[k] = c[2];
+	}
+	return *this;
+}
+
+template<TDEC>
+ReverbFDN<TARG>& ReverbFDN<TARG>::damping(float v){
+	for(unsigned k=0; k<N; ++k){
+		mLoops[k].damping(v);
+		float c[3];
+		mLoops[k].coefs(c);
+		mC0[k] = c[0]; mC1[k] = c[1]; mC2[k] = c[2];
+	}
+	return *this;
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::zero(){
+	for(auto& v : mBuf) v = Tv(0);
+	for(unsigned k=0; k<N; ++k) mX1[k] = mY1[k] = Tv(0);
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::run(const Tv * in, Tv * outL, Tv * outR, unsigned m){
+	Tv * Y = mY;
+	const unsigned B = BLOCK;
+
+	// Read line outputs
+	const double depth = mDepth * Td::spu();
+	const float inc = mRate * Td::ups();
+	for(unsigned k=0; k<N; ++k){
+		const Tv * r = &mBuf[mBase[k]];
+		const unsigned L = mLen[k];
+		Tv * y = Y + k*B;
+		if(depth == 0.){
+			unsigned p = (mPos[k] + L - mDelay[k]) % L;
+			for(unsigned i=0; i<m;){
+				const unsigned s = L - p < m - i ? L - p : m - i;
+				const Tv * rp = r + p;
+				Tv * yp = y + i;
+				for(unsigned t=0; t<s; ++t) yp[t] = rp[t];
+				i += s; p += s;
+				if(p == L) p = 0;
+			}
+		}
+		else{
+			// Sweep delay linearly between the LFO values at the block ends
+			float u = mPhase[k] + m*inc;
+			u -= std::floor(u);
+			const double lfo0 = scl::sinFast(4.f*mPhase[k] - 2.f);
+			const double lfo1 = scl::sinFast(4.f*u - 2.f);
+			mPhase[k] = u;
+			double pos = double(mPos[k]) - (mDelay[k] + depth * lfo0);
+			const double step = 1. - depth * (lfo1 - lfo0) / m;
+			if(pos < 0.) pos += L;
+			for(unsigned i=0; i<m; ++i){
+				if(pos >= L) pos -= L;
+				const index_t iInt = index_t(pos);
+				y[i] = mIpol(acc::Wrap(), r, iInt, pos - iInt, L-1);
+				pos += step;
+			}
+		}
+	}
+
+	// Even lines to left, odd lines to right
+	for(unsigned i=0; i<m; ++i){ outL[i] = Y[i]; outR[i] = Y[B+i]; }
+	for(unsigned k=2; k<N; k+=2){
+		const Tv * yl = Y + k*B, * yr = yl + B;
+		for(unsigned i=0; i<m; ++i){ outL[i] += yl[i]; outR[i] += yr[i]; }
+	}
+
+	// Loop filters
+	float coefs[3*N];
+	Tv state[2*N];
+	for(unsigned k=0; k<N; ++k){
+		coefs[k] = mC0[k]; coefs[N+k] = mC1[k]; coefs[2*N+k] = mC2[k];
+		state[k] = mX1[k]; state[N+k] = mY1[k];
+	}
+	loopFilterRows(Y, B, N, m, coefs, state);
+	for(unsigned k=0; k<N; ++k){ mX1[k] = state[k]; mY1[k] = state[N+k]; }
+
+	// Feedback matrix
+	float scale = 1.f;
+	if(HADAMARD == mMatrix){
+		// Fast Walsh-Hadamard transform; butterflies of rows
+		for(unsigned h=1; h<N; h*=2){
+			for(unsigned j=0; j<N; j+=2*h){
+				for(unsigned q=j; q<j+h; ++q){
+					Tv * a = Y + q*B, * b = a + h*B;
+					for(unsigned i=0; i<m; ++i){
+						Tv t = a[i];
+						a[i] = t + b[i];
+						b[i] = t - b[i];
+					}
+				}
+			}
+		}
+		scale = 1.f/std::sqrt(float(N));
+	}
+	else{
+		Tv sum[BLOCK];
+		for(unsigned i=0; i<m; ++i) sum[i] = Y[i];
+		for(unsigned k=1; k<N; ++k){
+			const Tv * y = Y + k*B;
+			for(unsigned i=0; i<m; ++i) sum[i] += y[i];
+		}
+		for(unsigned i=0; i<m; ++i) sum[i] *= -2.f/N;
+		for(unsigned k=0; k<N; ++k){
+			Tv * y = Y + k*B;
+			for(unsigned i=0; i<m; ++i) y[i] += sum[i];
+		}
+	}
+
+	// Add input and write lines
+	const float inGain = 1.f/std::sqrt(float(N));
+	for(unsigned k=0; k<N; ++k){
+		Tv * r = &mBuf[mBase[k]];
+		const unsigned L = mLen[k];
+		const Tv * y = Y + k*B;
+		unsigned p = mPos[k];
+		for(unsigned i=0; i<m;){
+			const unsigned s = L - p < m - i ? L - p : m - i;
+			Tv * rp = r + p;
+			const Tv * yp = y + i, * ip = in + i;
+			for(unsigned t=0; t<s; ++t) rp[t] = yp[t]*scale + ip[t]*inGain;
+			i += s; p += s;
+			if(p == L) p = 0;
+		}
+		mPos[k] = p;
+	}
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::process(const Tv * in, Tv * outL, Tv * outR, unsigned n){
+	Tv x[BLOCK];
+	while(n){
+		const unsigned m = n < mBlock ? n : mBlock;
+		for(unsigned i=0; i<m; ++i) x[i] = in[i];
+		run(x, outL, outR, m);
+		in += m; outL += m; outR += m; n -= m;
+	}
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::process(const Tv * in, Tv * out, unsigned n){
+	Tv x[BLOCK], l[BLOCK], r[BLOCK];
+	while(n){
+		const unsigned m = n < mBlock ? n : mBlock;
+		for(unsigned i=0; i<m; ++i) x[i] = in[i];
+		run(x, l, r, m);
+		for(unsigned i=0; i<m; ++i) out[i] = l[i] + r[i];
+		in += m; out += m; n -= m;
+	}
+}
+
+template<TDEC>
+inline void ReverbFDN<TARG>::operator()(Tv in, Tv& outL, Tv& outR){
+	run(&in, &outL, &outR, 1);
+}
+
+template<TDEC>
+inline Tv ReverbFDN<TARG>::operator()(Tv in){
+	Tv l, r;
+	run(&in, &l, &r, 1);
+	return l + r;
+}
+
+template<TDEC>
+void ReverbFDN<TARG>::print() const {
+	printf("delays = {");
+	for(unsigned k=0; k<N; ++k) printf("%u%s", mDelay[k], k!=(N-1)?", ":"");
 	printf("} samples\n");
 }
 
@@ -610,6 +1561,7 @@ Dist<TARG>::Dist(float maxDelay, float near, float far)
 
 template<TDEC>
 Dist<TARG>& Dist<TARG>::dist(int dest, float d){
+	mRamp[dest].stop();
 	mDist[dest]= d;
 	mAmp[dest] = inverse(d);
 	mDly[dest] = d * mInvSpeedOfSound;
@@ -617,6 +1569,14 @@ Dist<TARG>& Dist<TARG>::dist(int dest, float d){
 	return *this;
 }
 
+template<TDEC>
+Dist<TARG>& Dist<TARG>::dist(int dest, float d, unsigned n){
+	const float from[2] = {mDly[dest], mAmp[dest]};
+	dist(dest, d);
+	mRamp[dest].start(n, from, mDly[dest], mAmp[dest]);
+	return *this;
+}
+
 template<TDEC>
 Dist<TARG>& Dist<TARG>::dist(int dest, float x, float y, float z){
 	float d = sqrt(x*x+y*y+z*z);
@@ -634,8 +1594,10 @@ template<TDEC>
 inline Vec<Ndest, T> Dist<TARG>::operator()(T in){
 	mDelay.write(in);
 	Vec<Ndest, T> res;
-	for(int i=0; i<Ndest; ++i)
+	for(int i=0; i<Ndest; ++i){
+		mRamp[i].step(mDly[i], mAmp[i]);
 		res[i] = mLPF[i](mDelay.read(mDly[i])) * mAmp[i];
+	}
 	return res;
 }
 
@@ -0,0 +1,191 @@
+#ifndef GAMMA_STATE_H_INC
+#define GAMMA_STATE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Binary archives of the internal state of processing objects
+*/
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace gam{
+
+/// Writes the internal state of objects into a binary archive
+
+/// Objects supporting archives, e.g. Accum, Biquad, Delay and ReverbMS, have
+/// a member template
+/// \code
+///	template <class Archive> void state(Archive& ar);
+/// \endcode
+/// passing their members to the archive, which is a StateWriter when saving
+/// and a StateReader when restoring, so one function serves both ways.
+/// Values are stored raw in native byte order, so archives are meant for
+/// restarting on the same machine rather than for exchange.
+///
+/// A writer with a fixed capacity never allocates, so it can be filled from
+/// the audio thread; writes that do not fit fail the archive.
+///
+/// \ingroup Containers
+class StateWriter{
+public:
+
+	static const bool loading = false;	///< Whether archive restores objects
+
+	/// \param[in] capacity	fixed capacity, in bytes, or 0 to grow as needed
+	StateWriter(size_t capacity=0);
+
+
+	/// Write value of trivially copyable type
+	template <class T>
+	StateWriter& operator()(const T& v){
+		static_assert(std::is_trivially_copyable<T>::value, "type must be trivially copyable");
+		return bytes(&v, sizeof(T));
+	}
+
+	/// Write vector, preceded by its size
+	template <class T>
+	StateWriter& operator()(const std::vector<T>& v){
+		(*this)(uint64_t(v.size()));
+		return array(v.data(), v.size());
+	}
+
+	/// Write array of n elements
+	template <class T>
+	StateWriter& array(const T * src, size_t n){
+		static_assert(std::is_trivially_copyable<T>::value, "type must be trivially copyable");
+		return bytes(src, n*sizeof(T));
+	}
+
+	/// Write raw bytes
+	StateWriter& bytes(const void * src, size_t n);
+
+	/// Fail archive if condition is false (no-op, as for StateReader)
+	StateWriter& check(bool /*cond*/){ return *this; }
+
+	/// Overwrite a value written earlier at a byte offset
+	template <class T>
+	void patch(size_t pos, const T& v){
+		if(pos + sizeof(T) <= mSize) std::memcpy(&mBuf[pos], &v, sizeof(T));
+	}
+
+	/// Remove all bytes and clear failure
+	void clear(){ mSize=0; mOk=true; }
+
+	const char * data() const { return mBuf.data(); }	///< Get bytes written
+	size_t size() const { return mSize; }				///< Get number of bytes written
+	size_t capacity() const { return mBuf.size(); }		///< Get number of bytes allocated
+	bool ok() const { return mOk; }						///< Get whether all writes succeeded
+
+	/// Write bytes to a file
+
+	/// The bytes are written to a temporary file that then replaces the file
+	/// at the path, so a crash while saving never leaves a partial archive.
+	/// \returns whether the file was written
+	bool save(const std::string& path) const;
+
+private:
+	std::vector<char> mBuf;
+	size_t mSize;
+	bool mFixed, mOk;
+};
+
+
+
+/// Reads the internal state of objects from a binary archive
+
+/// Archives are read from memory or memory-mapped from a file, in which case
+/// restoring, e.g., a long delay line copies straight from the file's pages.
+/// Reads past the end, or of a size or check that does not match, fail the
+/// archive and leave the destination unchanged; later reads do nothing. An
+/// object is restored from the state of one configured the same way, e.g.
+/// a Delay of the same buffer size.
+///
+/// \ingroup Containers
+class StateReader{
+public:
+
+	static const bool loading = true;	///< Whether archive restores objects
+
+	/// Empty archive
+	StateReader();
+
+	/// \param[in] src		archive bytes; must outlive reader
+	/// \param[in] size		number of bytes
+	StateReader(const void * src, size_t size);
+
+	~StateReader();
+
+
+	/// Map file into memory and read from its start
+
+	/// \returns whether the file was mapped
+	bool map(const std::string& path);
+
+	/// Read value of trivially copyable type
+	template <class T>
+	StateReader& operator()(T& v){
+		static_assert(std::is_trivially_copyable<T>::value, "type must be trivially copyable");
+		return bytes(&v, sizeof(T));
+	}
+
+	/// Read vector, resizing it to the stored size
+	template <class T>
+	StateReader& operator()(std::vector<T>& v){
+		uint64_t n = 0;
+		(*this)(n).check(n <= remaining() / (sizeof(T) ? sizeof(T) : 1));
+		if(!mOk) return *this;
+		v.resize(size_t(n));
+		return array(v.data(), v.size());
+	}
+
+	/// Read array of n elements
+	template <class T>
+	StateReader& array(T * dst, size_t n){
+		static_assert(std::is_trivially_copyable<T>::value, "type must be trivially copyable");
+		return bytes(dst, n*sizeof(T));
+	}
+
+	/// Read raw bytes
+	StateReader& bytes(void * dst, size_t n){
+		const void * src = view(n);
+		if(src && n) std::memcpy(dst, src, n);
+		return *this;
+	}
+
+	/// Get pointer to next n bytes and skip them, or NULL if past the end
+	const void * view(size_t n){
+		check(mOk && n <= remaining());
+		if(!mOk) return NULL;
+		const char * p = mData + mPos;
+		mPos += n;
+		return p;
+	}
+
+	/// Fail archive if condition is false
+	StateReader& check(bool cond){ if(!cond) mOk=false; return *this; }
+
+	size_t size() const { return mSize; }				///< Get number of bytes in archive
+	size_t remaining() const { return mSize - mPos; }	///< Get number of bytes not read
+	bool ok() const { return mOk; }						///< Get whether all reads succeeded
+
+private:
+	const char * mData;
+	size_t mSize, mPos;
+	bool mOk;
+	void * mMap;		// mapped file or NULL
+	size_t mMapSize;
+
+	void unmap();
+	StateReader(const StateReader&);
+	StateReader& operator=(const StateReader&);
+};
+
+} // gam::
+
+#endif
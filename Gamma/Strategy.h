@@ -7,6 +7,7 @@
 #include "Gamma/Access.h"
 #include "Gamma/Containers.h"
 #include "Gamma/ipl.h"
+#include "Gamma/Resample.h"
 #include "Gamma/scl.h"
 
 namespace gam{
@@ -49,12 +50,13 @@ struct Trunc{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
-		return src[iInt];
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+		return T(src[iInt]);
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 	}
 };
@@ -85,16 +87,17 @@ struct Round{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return ipl::nearest(
 			iFrac,
-			src[iInt],
-			src[acc.mapP1(iInt+1, max, min)]
+			T(src[iInt]),
+			T(src[acc.mapP1(iInt+1, max, min)])
 		);
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 	}
 };
@@ -126,12 +129,13 @@ struct Mean2{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
-		return (src[iInt] + src[acc.mapP1(iInt+1, max, min)])*0.5;
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+		return (T(src[iInt]) + T(src[acc.mapP1(iInt+1, max, min)]))*0.5;
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 	}
 };
@@ -165,19 +169,29 @@ struct Linear{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return ipl::linear(
 			iFrac,
-			src[iInt],
-			src[acc.mapP1(iInt+1, max, min)]
+			T(src[iInt]),
+			T(src[acc.mapP1(iInt+1, max, min)])
 		);
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 		// TODO: wrapping access maybe not correct for one-shot playback
 	}
+
+	/// Interpolate array at a stream of integer and fractional indices
+
+	/// Elements iInt[i] and iInt[i]+1 must be in bounds (\sa ipl::linear).
+	///
+	template <class S>
+	void operator()(T * dst, const S * src, const index_t * iInt, const float * iFrac, unsigned len) const{
+		ipl::linear(dst, src, iInt, iFrac, len);
+	}
 };
 
 
@@ -223,20 +237,30 @@ struct Cubic{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return ipl::cubic(
 			iFrac,
-			src[acc.mapM1(iInt-1, max, min)],
-			src[iInt],
-			src[acc.mapP1(iInt+1, max, min)],
-			src[acc.map  (iInt+2, max, min)]
+			T(src[acc.mapM1(iInt-1, max, min)]),
+			T(src[iInt]),
+			T(src[acc.mapP1(iInt+1, max, min)]),
+			T(src[acc.map  (iInt+2, max, min)])
 		);
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 	}
+
+	/// Interpolate array at a stream of integer and fractional indices
+
+	/// Elements iInt[i]-1 through iInt[i]+2 must be in bounds (\sa ipl::cubic).
+	///
+	template <class S>
+	void operator()(T * dst, const S * src, const index_t * iInt, const float * iFrac, unsigned len) const{
+		ipl::cubic(dst, src, iInt, iFrac, len);
+	}
 /*
 	// TODO: is it worth trying to support strided arrays?
 	template <class AccessStrategy>
@@ -288,17 +312,18 @@ struct AllPass{
 	/// \param[in] iFrac		fractional part of index, in [0, 1)
 	/// \param[in] max			maximum index for accessing
 	/// \param[in] min			minimum index for accessing
-	template <class AccessStrategy>
-	T operator()(const AccessStrategy& acc, const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return ipl::allpass(
 			iFrac,
-			src[iInt],
-			src[acc.mapP1(iInt+1, max, min)],
+			T(src[iInt]),
+			T(src[acc.mapP1(iInt+1, max, min)]),
 			prev
 		);
 	}
 
-	T operator()(const T * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
 		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
 	}
 	
@@ -306,8 +331,99 @@ struct AllPass{
 };
 
 
+/// Windowed-sinc random-access interpolation strategy
+
+/// This interpolates with the kernels of a SincBank, reading half() inputs on
+/// each side of the interpolated point. It is band-limited, so it avoids the
+/// imaging of cheaper strategies when pitching up or down a sample. Its
+/// kernel does not narrow when reading faster than the source rate, so
+/// buffers to be played much faster should be converted with resample()
+/// first. Reads near the bounds of the array go through the access strategy.
+///
+/// \ingroup Strategy, ipl
+template <class T>
+struct Sinc{
+
+	enum{ MAX_TAPS = 2*SincBank::MAX_HALF };	// maximum kernel length for reads near bounds
+
+	Sinc(const SincBank& b = SincBank::get()): mBank(&b){}
+
+	ipl::Type type() const { return SINC; }
+	void type(ipl::Type v){}
+
+	/// Set kernel bank; must persist with the strategy
+	void bank(const SincBank& b){ mBank = &b; }
+
+	/// Get kernel bank
+	const SincBank& bank() const { return *mBank; }
+
+	/// Return interpolated element from power-of-2 array
+	T operator()(const ArrayPow2<T>& a, uint32_t phase) const{
+		T buf[MAX_TAPS];
+		const int H = mBank->half();
+		const uint32_t m = a.size() - 1;
+		const uint32_t i = a.index(phase);
+		for(int k=0; k<2*H; ++k) buf[k] = a[(i + 1 - H + k) & m];
+		return (*mBank)(buf + H - 1, a.fraction(phase));
+	}
+
+	/// Return interpolated element from array
+
+	/// \tparam AccessStrategy	access strategy type (\sa access)
+	///
+	/// \param[in] acc			access strategy
+	/// \param[in] src			source array
+	/// \param[in] iInt			integer part of index
+	/// \param[in] iFrac		fractional part of index, in [0, 1)
+	/// \param[in] max			maximum index for accessing
+	/// \param[in] min			minimum index for accessing
+	template <class AccessStrategy, class S>
+	T operator()(const AccessStrategy& acc, const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+		const index_t H = mBank->half();
+		if(iInt - H + 1 >= min && iInt + H <= max){
+			return inBounds(src + iInt, iFrac);
+		}
+
+		// Gather neighbors through the access strategy
+		T buf[MAX_TAPS];
+		for(index_t k=0; k<2*H; ++k){
+			index_t j = iInt - H + 1 + k;
+			while(j < min || j > max){
+				index_t mj = acc.map(j, max, min);
+				if(mj == j) break;
+				j = mj;
+			}
+			buf[k] = (j < min || j > max) ? T(0) : T(src[j]);
+		}
+		return (*mBank)(buf + H - 1, iFrac);
+	}
+
+	template <class S>
+	T operator()(const S * src, index_t iInt, double iFrac, index_t max, index_t min=0) const{
+		return (*this)(acc::Wrap(), src, iInt, iFrac, max, min);
+	}
+
+private:
+	const SincBank * mBank;
+
+	// Interpolate around src[0]; other storage types are converted first
+	T inBounds(const T * src, double frac) const { return (*mBank)(src, frac); }
+
+	template <class S>
+	T inBounds(const S * src, double frac) const {
+		T buf[MAX_TAPS];
+		const index_t H = mBank->half();
+		for(index_t k=0; k<2*H; ++k) buf[k] = T(src[k+1-H]);
+		return (*mBank)(buf + H - 1, frac);
+	}
+};
+
+
 /// Dynamically switchable random-access interpolation strategy
 
+/// Each call switches on the type, so block loops should resolve the type
+/// once with apply().
+///
 /// \ingroup Strategy, ipl
 template <class T>
 struct Switchable{
@@ -317,6 +433,22 @@ struct Switchable{
 	ipl::Type type() const { return mType; }
 	void type(ipl::Type v){ mType=v; }
 
+	/// Call a function object with the strategy of the current type
+
+	/// The function object has a call operator templated on the strategy,
+	/// typically running a block loop, which then inlines the strategy as
+	/// with a fixed one.
+	template <class F>
+	void apply(const F& f) const {
+		switch(mType){
+			case ROUND:		f(round); break;
+			case LINEAR:	f(linear); break;
+			case CUBIC:		f(cubic); break;
+			case ALLPASS:	f(allpass); break;
+			default:		f(trunc);
+		}
+	}
+
 	/// Return interpolated element from power-of-2 array
 	T operator()(const ArrayPow2<T>& a, uint32_t phase) const{		
 		switch(mType){
@@ -358,6 +490,17 @@ protected:
 	AllPass<T> allpass;
 };
 
+
+/// Call a function object with an interpolation strategy
+
+/// A Switchable strategy is resolved to the strategy of its current type.
+///
+template <class S, class F>
+inline void apply(const S& s, const F& f){ f(s); }
+
+template <class T, class F>
+inline void apply(const Switchable<T>& s, const F& f){ s.apply(f); }
+
 } // ipl::
 
 
@@ -467,6 +610,7 @@ namespace iplSeq{
 //	uint32_t operator()(uint32_t& pos, uint32_t inc);	// fixed-point tap increment
 //	bool done(uint32_t pos);							// fixed-point tap done reading
 //	T operator()(T v, T max, T min);					// float tap post increment check
+//	T skip(T v, T inc, uint64_t n, T max, T min);		// float tap after n increments
 //	void reset();										// reset internal state, if any
 
 /// \defgroup phsInc Phase Increment Strategies
@@ -492,6 +636,9 @@ namespace phsInc{
 		
 		template <class T>
 		T operator()(T v, T inc, T max, T min){ return scl::wrap(v+inc, max, min); }
+
+		template <class T>
+		T skip(T v, T inc, uint64_t n, T max, T min){ return scl::wrap(v+inc*T(n), max, min); }
 	};
 
 
@@ -569,6 +716,15 @@ namespace phsInc{
 		
 		template <class T>
 		T operator()(T v, T inc, T max, T min){ return incClip(v,inc,max,min); }
+
+		template <class T>
+		T skip(T v, T inc, uint64_t n, T max, T min){
+			if(inc < T(0)) return v+inc*T(n) < min ? min : v+inc*T(n);
+			if(inc == T(0) || v+inc >= max) return v;
+			// Stop at last increment before max
+			uint64_t last = uint64_t(std::ceil((max-v)/inc)) - 1;
+			return v + inc*T(last < n ? last : n);
+		}
 	};
 
 
@@ -596,9 +752,33 @@ namespace phsInc{
 		
 		template <class T>
 		T operator()(T v, T inc, T max, T min){
-			v += inc;
-			if(v >= max || v < min) ++mCount;
-			return mCount < mRepeats ? scl::wrap(v, max, min) : incClip(v, inc, max, min);
+			if(mCount >= mRepeats) return incClip(v, inc, max, min);
+			T res = v + inc;
+			if(res >= max || res < min){
+				if(++mCount >= mRepeats) return v; // hold at last position
+				return scl::wrap(res, max, min);
+			}
+			return res;
+		}
+
+		template <class T>
+		T skip(T v, T inc, uint64_t n, T max, T min){
+			if(inc < T(0)){ // repeats counted backwards; step through them
+				for(uint64_t i=0; i<n; ++i) v = (*this)(v, inc, max, min);
+				return v;
+			}
+			if(mCount >= mRepeats || inc == T(0)) return v;
+			const T len = max - min;
+			const T end = v - min + inc*T(n);	// unwrapped offset from min
+			const uint32_t left = mRepeats - mCount;
+			if(end < len*T(left)){
+				mCount += uint32_t(end/len);
+				return scl::wrap(min + end, max, min);
+			}
+			// Stop at last increment before final repeat ends
+			uint64_t last = uint64_t(std::ceil((len*T(left) - (v-min))/inc)) - 1;
+			mCount = mRepeats;
+			return scl::wrap(v + inc*T(last), max, min);
 		}
 		
 		/// Set number of repetitions
@@ -636,6 +816,16 @@ namespace phsInc{
 			dir ^= n!=0;
 			return v;
 		}
+
+		template <class T>
+		T skip(T v, T inc, uint64_t n, T max, T min){
+			// Unfold into one period of a triangle, moving forward
+			const T len = max - min;
+			T u = dir ? len*T(2) - (v-min) : v-min;
+			u = scl::wrap(u + inc*T(n), len*T(2), T(0));
+			dir = u >= len;
+			return dir ? min + len*T(2) - u : min + u;
+		}
 		
 		uint32_t dir;
 	};
@@ -721,5 +911,79 @@ namespace phsInc{
 
 namespace tap = phsInc;
 
+
+
+/// Control rate strategies
+
+// The expected interface is:
+//	template <class T, class Gen, class Skip>
+//	void operator()(T * dst, unsigned n, Gen gen, Skip skip);
+//		fill block from generator; gen() returns the next sample and
+//		skip(k) advances the generator k samples without output
+//	void reset();	// restart, discarding any history
+
+/// \defgroup ctlRate Control Rate Strategies
+namespace ctlRate{
+
+	/// Evaluate generator every sample
+
+	/// \ingroup Strategy, ctlRate
+	struct Audio{
+		template <class T, class Gen, class Skip>
+		void operator()(T * dst, unsigned n, Gen gen, Skip){
+			for(unsigned i=0; i<n; ++i) dst[i] = gen();
+		}
+		void reset(){}
+	};
+
+	/// Evaluate generator every K samples and interpolate in between
+
+	/// The generator runs ahead of the output by the interpolation window so
+	/// that output samples at multiples of K are exact. Parameter changes are
+	/// therefore delayed by up to K (linear) or 2K (cubic) samples.
+	///
+	/// \tparam K	decimation factor
+	/// \tparam Si	sequence interpolation strategy (e.g., iplSeq::Linear, iplSeq::Cubic)
+	/// \ingroup Strategy, ctlRate
+	template <unsigned K, template<class> class Si = iplSeq::Linear>
+	struct Decimate{
+		Decimate(): mCount(0), mPrimed(false){}
+
+		template <class T, class Gen, class Skip>
+		void operator()(T * dst, unsigned n, Gen gen, Skip skip){
+			if(!mPrimed){
+				// Fill history so the current segment starts at the first value
+				mIpl.set(next(gen, skip));
+				for(unsigned k=0; k<sizeof(mIpl.v)/sizeof(mIpl.v[0])/2; ++k) mIpl.push(next(gen, skip));
+				mCount = 0;
+				mPrimed = true;
+			}
+			while(n){
+				if(mCount == K){ mIpl.push(next(gen, skip)); mCount = 0; }
+				unsigned m = K - mCount;
+				if(m > n) m = n;
+				const Si<float> ipl = mIpl; // local copy so the segment vectorizes
+				for(unsigned i=0; i<m; ++i) dst[i] = T(ipl(float(mCount + i) * (1.f/K)));
+				mCount += m; dst += m; n -= m;
+			}
+		}
+
+		void reset(){ mPrimed = false; }
+
+	private:
+		Si<float> mIpl;
+		unsigned mCount;
+		bool mPrimed;
+
+		template <class Gen, class Skip>
+		static float next(Gen& gen, Skip& skip){
+			float v = gen();
+			skip(K-1);
+			return v;
+		}
+	};
+
+} // ctlRate::
+
 } // gam::
 #endif
@@ -0,0 +1,314 @@
+#ifndef GAMMA_TABLECACHE_H_INC
+#define GAMMA_TABLECACHE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Shared cache of generated waveform and window tables
+*/
+
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <mutex>
+#include <string>
+#include <tuple>
+#include <vector>
+#include "Gamma/Containers.h"
+#include "Gamma/tbl.h"
+
+namespace gam{
+
+
+/// Cache of generated tables shared between objects
+
+/// Tables are keyed by generator name, size and generator parameters, so
+/// every object asking for the same table references one array, generated
+/// on first use. Tables can be handed to objects that reference arrays, such
+/// as Osc, through their source() method or an array constructor.
+///
+/// The whole cache can be saved to a binary file and read back with a single
+/// read, so processes using many tables can skip generating them at startup.
+///
+/// The returned arrays are shared and must not be modified. The cache must be
+/// accessed from the same thread that sets up objects using its tables
+/// (array reference counts are not thread-safe).
+///
+/// \tparam T	element type
+/// \ingroup Containers
+template <class T = float>
+class TableCache{
+public:
+
+	/// Function filling dst with len values from an array of parameters
+	typedef void (* Generator)(T * dst, unsigned len, const double * params);
+
+	TableCache(){}
+
+	~TableCache(){ clear(); }
+
+
+	/// Get process-wide cache
+	static TableCache& get(){
+		static TableCache * o = new TableCache;
+		return *o;
+	}
+
+
+	/// Get table, generating it on first use
+
+	/// \param[in] name			name identifying the generator
+	/// \param[in] gen			generator to fill a new table with
+	/// \param[in] size			number of elements
+	/// \param[in] params		generator parameters
+	/// \param[in] numParams	number of generator parameters
+	Array<T>& table(
+		const char * name, Generator gen, unsigned size,
+		const double * params=0, unsigned numParams=0
+	){
+		return *static_cast<Array<T> *>(find(name, gen, size, params, numParams, false));
+	}
+
+	/// Get table, filling it with a callable object on first use
+
+	/// This is for tables derived from data rather than computed from a few
+	/// parameters, e.g. the mipmaps of a set of wavetables. The parameters
+	/// should identify the data.
+	///
+	/// \param[in] name			name identifying the data
+	/// \param[in] size			number of elements
+	/// \param[in] fill			called as fill(T * dst, unsigned len) with zeroed table
+	/// \param[in] params		parameters identifying table
+	/// \param[in] numParams	number of parameters
+	template <class Fill>
+	Array<T>& tableWith(
+		const char * name, unsigned size, Fill fill,
+		const double * params=0, unsigned numParams=0
+	){
+		return *static_cast<Array<T> *>(find(name, fill, size, params, numParams, false));
+	}
+
+	/// Get table with a power-of-two size, generating it on first use
+
+	/// \param[in] name			name identifying the generator
+	/// \param[in] gen			generator to fill a new table with
+	/// \param[in] size			number of elements; must be a power of two
+	/// \param[in] params		generator parameters
+	/// \param[in] numParams	number of generator parameters
+	ArrayPow2<T>& tablePow2(
+		const char * name, Generator gen, unsigned size,
+		const double * params=0, unsigned numParams=0
+	){
+		return *static_cast<ArrayPow2<T> *>(find(name, gen, size, params, numParams, true));
+	}
+
+	/// Get window, as tbl::window
+	Array<T>& window(WindowType type, unsigned size){
+		double p = type;
+		return table("window", genWindow, size, &p, 1);
+	}
+
+	/// Get single cycle of a band-limited waveform, as addWave
+
+	/// \param[in] type		waveform type
+	/// \param[in] size		number of elements; must be a power of two
+	/// \param[in] numh		number of harmonics
+	ArrayPow2<T>& wave(WaveformType type, unsigned size, int numh=32){
+		double p[2] = {double(type), double(numh)};
+		return tablePow2("wave", genWave, size, p, 2);
+	}
+
+
+	/// Get number of cached tables
+	int size() const {
+		std::lock_guard<std::mutex> lock(mMutex);
+		return int(mEntries.size());
+	}
+
+	/// Remove all tables
+
+	/// Objects still referencing tables keep their memory.
+	///
+	void clear(){
+		std::lock_guard<std::mutex> lock(mMutex);
+		for(auto& kv : mEntries) destroy(kv.second, std::get<2>(kv.first));
+		mEntries.clear();
+	}
+
+
+	/// Save all tables to a binary file
+
+	/// \returns whether the file was written
+	bool save(const char * path) const;
+
+	/// Add tables from a file written by save()
+
+	/// Tables already in the cache are kept.
+	/// \returns whether the file was read
+	bool load(const char * path);
+
+private:
+	typedef std::tuple<std::string, unsigned, bool, std::vector<double> > Key;
+	typedef std::map<Key, void *> Entries;	// Array or ArrayPow2 by key
+
+	Entries mEntries;
+	mutable std::mutex mMutex;
+
+	void * find(const char * name, Generator gen, unsigned size, const double * params, unsigned numParams, bool pow2){
+		return find(name, [gen, params](T * dst, unsigned len){ if(gen) gen(dst, len, params); },
+			size, params, numParams, pow2);
+	}
+
+	template <class Fill>
+	void * find(const char * name, Fill fill, unsigned size, const double * params, unsigned numParams, bool pow2){
+		Key k(name, size, pow2, std::vector<double>(params, params+numParams));
+		std::lock_guard<std::mutex> lock(mMutex);
+		void *& e = mEntries[k];
+		if(!e){
+			T * elems = create(e, size, pow2);
+			size = sizeOf(e, pow2);
+			for(unsigned i=0; i<size; ++i) elems[i] = T(0);
+			fill(elems, size);
+		}
+		return e;
+	}
+
+	// Allocate array and return its elements
+	static T * create(void *& e, unsigned size, bool pow2){
+		if(pow2){ ArrayPow2<T> * a = new ArrayPow2<T>(size); e = a; return a->elems(); }
+		Array<T> * a = new Array<T>(size); e = a; return a->elems();
+	}
+
+	static void destroy(void * e, bool pow2){
+		if(pow2) delete static_cast<ArrayPow2<T> *>(e);
+		else delete static_cast<Array<T> *>(e);
+	}
+
+	static unsigned sizeOf(void * e, bool pow2){
+		return pow2 ? static_cast<ArrayPow2<T> *>(e)->size() : static_cast<Array<T> *>(e)->size();
+	}
+
+	static T * elemsOf(void * e, bool pow2){
+		return pow2 ? static_cast<ArrayPow2<T> *>(e)->elems() : static_cast<Array<T> *>(e)->elems();
+	}
+
+	static void genWindow(T * dst, unsigned len, const double * p){
+		tbl::window(dst, len, WindowType(int(p[0])));
+	}
+
+	static void genWave(T * dst, unsigned len, const double * p){
+		addWave(dst, len, WaveformType(int(p[0])), int(p[1]));
+	}
+
+	TableCache(const TableCache&);
+	TableCache& operator=(const TableCache&);
+};
+
+
+
+
+// Implementation_______________________________________________________________
+
+/*
+File format, in native byte order:
+	"GAMTBL1" and sizeof(T) as a byte, number of tables (uint32)
+	per table: name length (uint32), name, size (uint32), power-of-two flag
+	(uint8), number of parameters (uint32), parameters (double), elements (T)
+*/
+
+#define PRE template <class T>
+#define CLS TableCache<T>
+
+PRE bool CLS::save(const char * path) const {
+	std::vector<char> buf;
+	auto put = [&buf](const void * src, size_t bytes){
+		const char * c = static_cast<const char *>(src);
+		buf.insert(buf.end(), c, c + bytes);
+	};
+
+	{	std::lock_guard<std::mutex> lock(mMutex);
+		char magic[8] = {'G','A','M','T','B','L','1', char(sizeof(T))};
+		uint32_t n = uint32_t(mEntries.size());
+		put(magic, 8); put(&n, 4);
+		for(auto& kv : mEntries){
+			const std::string& name = std::get<0>(kv.first);
+			const std::vector<double>& p = std::get<3>(kv.first);
+			bool pow2 = std::get<2>(kv.first);
+			uint32_t len = uint32_t(name.size()), size = sizeOf(kv.second, pow2), np = uint32_t(p.size());
+			uint8_t flag = pow2;
+			put(&len, 4); put(name.data(), len);
+			put(&size, 4); put(&flag, 1);
+			put(&np, 4); if(np) put(&p[0], np*sizeof(double));
+			put(elemsOf(kv.second, pow2), size*sizeof(T));
+		}
+	}
+
+	FILE * f = fopen(path, "wb");
+	bool ok = f && fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+	if(f) ok = (fclose(f) == 0) && ok;
+	if(!ok) fprintf(stderr, "gam::TableCache: couldn't write \"%s\"\n", path);
+	return ok;
+}
+
+PRE bool CLS::load(const char * path){
+	FILE * f = fopen(path, "rb");
+	if(!f){
+		fprintf(stderr, "gam::TableCache: couldn't open \"%s\"\n", path);
+		return false;
+	}
+	std::vector<char> buf;
+	fseek(f, 0, SEEK_END);
+	long bytes = ftell(f);
+	fseek(f, 0, SEEK_SET);
+	if(bytes > 0){
+		buf.resize(bytes);
+		if(fread(&buf[0], 1, bytes, f) != size_t(bytes)) buf.clear();
+	}
+	fclose(f);
+
+	size_t pos = 0;
+	auto remain = [&buf, &pos](){ return buf.size() - pos; };
+	auto get = [&buf, &pos](void * dst, size_t n){
+		if(n > buf.size() - pos) return false;
+		if(n) std::memcpy(dst, &buf[pos], n);
+		pos += n;
+		return true;
+	};
+
+	char magic[8];
+	uint32_t n = 0;
+	bool ok = get(magic, 8) && !std::memcmp(magic, "GAMTBL1", 7)
+		&& magic[7] == char(sizeof(T)) && get(&n, 4);
+
+	// Counts are checked against the bytes left before anything is sized
+	// from them, and power-of-two tables must have a power-of-two size
+	std::lock_guard<std::mutex> lock(mMutex);
+	for(uint32_t t=0; ok && t<n; ++t){
+		uint32_t len, size, np;
+		uint8_t flag;
+		ok = get(&len, 4) && len <= remain();
+		if(!ok) break;
+		std::string name(len ? &buf[pos] : "", len); pos += len;
+		ok = get(&size, 4) && get(&flag, 1) && get(&np, 4)
+			&& np <= remain()/sizeof(double)
+			&& size <= (remain() - np*sizeof(double))/sizeof(T)
+			&& (!flag || (size && !(size & (size-1))));
+		if(!ok) break;
+		std::vector<double> p(np);
+		get(np ? &p[0] : 0, np*sizeof(double));
+		void *& e = mEntries[Key(name, size, flag != 0, p)];
+		if(e) pos += size*sizeof(T); // keep existing table
+		else get(create(e, size, flag != 0), size*sizeof(T));
+	}
+
+	if(!ok) fprintf(stderr, "gam::TableCache: \"%s\" is not a valid table file\n", path);
+	return ok;
+}
+
+#undef PRE
+#undef CLS
+
+} // gam::
+
+#endif
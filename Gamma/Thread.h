@@ -10,11 +10,17 @@
 #define GAM_USE_PTHREAD		(GAM_OSX || GAM_LINUX)
 #define GAM_USE_WINTHREAD	(GAM_WINDOWS)
 
+#include <cstddef>
+
 #if GAM_USE_STD_THREAD
 	#include <thread>
-#elif GAM_USE_PTHREAD
+#endif
+
+#if GAM_OSX || GAM_LINUX
 	#include <pthread.h>
-#elif GAM_USE_WINTHREAD
+	#include <sched.h>
+	#include <sys/mman.h>
+#elif GAM_WINDOWS
 	#define WIN32_LEAN_AND_MEAN
 	#include <windows.h>
 	#ifdef far
@@ -40,12 +46,18 @@ public:
 		typedef HANDLE		Handle;
 	#endif
 
+	/// Real-time scheduling policy
+	enum Policy{
+		FIFO,		/**< Run until blocked or preempted by a higher priority */
+		ROUND_ROBIN	/**< As FIFO, but take turns with threads of equal priority */
+	};
+
 	Thread()
-	:	mHandle(0), mJoinOnDestroy(false)
+	:	mHandle(), mJoinOnDestroy(false)
 	{}
 	
 	Thread(Function func, void * user = NULL)
-	:	mHandle(0), mJoinOnDestroy(false)
+	:	mHandle(), mJoinOnDestroy(false)
 	{	start(func, user); }
 
 	~Thread(){
@@ -67,6 +79,31 @@ public:
 	/// A false return value indicates a problem with the call.
 	bool join();
 
+	/// Give the thread real-time scheduling priority
+
+	/// This may require privileges (e.g., RLIMIT_RTPRIO on Linux). On Windows 
+	/// the thread gets time-critical priority and the policy is ignored.
+	/// \param[in] priority	priority within range of real-time policy, in [0, 1]
+	/// \param[in] policy		scheduling policy
+	/// \returns whether the priority was set
+	bool realtime(float priority = 0.9f, Policy policy = FIFO);
+
+	/// Restrict the thread to run on a single processor
+
+	/// \param[in] cpu		index of processor
+	/// \returns whether the affinity was set (not supported on macOS)
+	bool affinity(int cpu);
+
+	/// Give the calling thread real-time scheduling priority
+
+	/// On Windows, the thread joins the MMCSS "Pro Audio" task, falling back
+	/// to time-critical priority if MMCSS is unavailable.
+	/// \see realtime(float, Policy)
+	static bool realtimeCurrent(float priority = 0.9f, Policy policy = FIFO);
+
+	/// Restrict the calling thread to run on a single processor
+	static bool affinityCurrent(int cpu);
+
 
 	/// Set whether thread will automatically join upon destruction
 	Thread& joinOnDestroy(bool v){ mJoinOnDestroy=v; return *this; }
@@ -74,24 +111,150 @@ public:
 protected:
 	Handle mHandle;
 	bool mJoinOnDestroy;
+
+	#if GAM_OSX || GAM_LINUX
+	static bool realtime(pthread_t h, float priority, Policy policy);
+	static bool affinity(pthread_t h, int cpu);
+	#elif GAM_WINDOWS
+	static bool realtime(HANDLE h);
+	static bool affinity(HANDLE h, int cpu);
+	#endif
 };
 
 
+/// Lock all current and future memory of the process into RAM
+
+/// This keeps page faults from interrupting real-time threads. It may 
+/// require privileges (e.g., RLIMIT_MEMLOCK on Linux). Not supported on 
+/// Windows, where memory ranges must be locked individually.
+/// \returns whether memory was locked
+bool lockMemory();
+
+/// Lock a range of memory into RAM and fault in its pages
+
+/// \returns whether memory was locked
+bool lockMemory(void * buf, size_t bytes);
+
+/// Touch every page of a buffer so it is mapped before real-time use
+
+/// Contents of the buffer are unchanged.
+///
+void prefault(void * buf, size_t bytes);
+
+/// Touch pages of the calling thread's stack so it is mapped before real-time use
+template <size_t Bytes = 65536>
+void prefaultStack(){
+	volatile char buf[Bytes];
+	for(size_t i=0; i<Bytes; i+=4096) buf[i] = 0;
+	(void)buf[0];
+}
+
+
 
 
 // Implementation
 
+#if GAM_OSX || GAM_LINUX
+
+inline bool Thread::realtime(pthread_t h, float priority, Policy policy){
+	int pol = ROUND_ROBIN == policy ? SCHED_RR : SCHED_FIFO;
+	int lo = sched_get_priority_min(pol);
+	int hi = sched_get_priority_max(pol);
+	sched_param param;
+	param.sched_priority = lo + int((hi-lo)*priority);
+	return 0 == pthread_setschedparam(h, pol, &param);
+}
+
+inline bool Thread::affinity(pthread_t h, int cpu){
+	#if GAM_LINUX
+	cpu_set_t set;
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	return 0 == pthread_setaffinity_np(h, sizeof(set), &set);
+	#else
+	return false; // macOS only has affinity tags, which are hints
+	#endif
+}
+
+inline bool Thread::realtimeCurrent(float priority, Policy policy){
+	return realtime(pthread_self(), priority, policy);
+}
+
+inline bool Thread::affinityCurrent(int cpu){ return affinity(pthread_self(), cpu); }
+
+inline bool lockMemory(){ return 0 == mlockall(MCL_CURRENT | MCL_FUTURE); }
+
+inline bool lockMemory(void * buf, size_t bytes){
+	bool res = 0 == mlock(buf, bytes);
+	prefault(buf, bytes);
+	return res;
+}
+
+#elif GAM_WINDOWS
+
+inline bool Thread::realtime(HANDLE h){
+	return 0 != SetThreadPriority(h, THREAD_PRIORITY_TIME_CRITICAL);
+}
+
+inline bool Thread::affinity(HANDLE h, int cpu){
+	return 0 != SetThreadAffinityMask(h, DWORD_PTR(1) << cpu);
+}
+
+inline bool Thread::realtimeCurrent(float priority, Policy policy){
+	// Load avrt.dll at run time so no import library is needed
+	typedef HANDLE (WINAPI * SetTask)(LPCSTR, LPDWORD);
+	static HMODULE avrt = LoadLibraryA("avrt.dll");
+	SetTask setTask = avrt ? (SetTask)GetProcAddress(avrt, "AvSetMmThreadCharacteristicsA") : NULL;
+	DWORD taskIndex = 0;
+	if(setTask && setTask("Pro Audio", &taskIndex)) return true;
+	return realtime(GetCurrentThread());
+}
+
+inline bool Thread::affinityCurrent(int cpu){ return affinity(GetCurrentThread(), cpu); }
+
+inline bool lockMemory(){ return false; }
+
+inline bool lockMemory(void * buf, size_t bytes){
+	bool res = 0 != VirtualLock(buf, bytes);
+	prefault(buf, bytes);
+	return res;
+}
+
+#endif
+
+inline void prefault(void * buf, size_t bytes){
+	volatile char * p = (volatile char *)buf;
+	for(size_t i=0; i<bytes; i+=4096) p[i] = p[i];
+	if(bytes) p[bytes-1] = p[bytes-1];
+}
+
+
 #if GAM_USE_STD_THREAD
 
 inline bool Thread::start(Thread::Function func, void * user){
+	if(mHandle.joinable()) return false;
 	mHandle = std::thread(func, user);
+	return true;
 }
 
 inline bool Thread::join(){
+	if(!mHandle.joinable()) return false;
 	mHandle.join();
 	return true;
 }
 
+inline bool Thread::realtime(float priority, Policy policy){
+	#if GAM_WINDOWS
+	return mHandle.joinable() && realtime(mHandle.native_handle());
+	#else
+	return mHandle.joinable() && realtime(mHandle.native_handle(), priority, policy);
+	#endif
+}
+
+inline bool Thread::affinity(int cpu){
+	return mHandle.joinable() && affinity(mHandle.native_handle(), cpu);
+}
+
 #elif GAM_USE_PTHREAD
 
 inline bool Thread::start(Thread::Function func, void * user){
@@ -107,6 +270,12 @@ inline bool Thread::join(){
 	return false;
 }
 
+inline bool Thread::realtime(float priority, Policy policy){
+	return mHandle && realtime(mHandle, priority, policy);
+}
+
+inline bool Thread::affinity(int cpu){ return mHandle && affinity(mHandle, cpu); }
+
 
 #elif GAM_USE_WINTHREAD
 
@@ -150,6 +319,12 @@ inline bool Thread::join(){
 	return false;
 }
 
+inline bool Thread::realtime(float priority, Policy policy){
+	return mHandle && realtime(mHandle);
+}
+
+inline bool Thread::affinity(int cpu){ return mHandle && affinity(mHandle, cpu); }
+
 #endif
 
 } // gam::
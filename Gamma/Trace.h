@@ -0,0 +1,138 @@
+#ifndef GAMMA_TRACE_H_INC
+#define GAMMA_TRACE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Timeline tracing of processing into per-thread buffers, written as
+	Chrome trace JSON
+*/
+
+#include <stdio.h>
+#include <atomic>
+#include "Gamma/Timer.h"
+
+#ifndef GAM_TRACE_BUFFER_SIZE
+	#define GAM_TRACE_BUFFER_SIZE 16384 // events kept per thread; power of two
+#endif
+
+namespace gam{
+
+/// Event in a trace
+struct TraceEvent{
+	const char * name;	///< Name; must remain valid until written
+	const void * id;	///< Object the event is about, if any
+	nsec_t begin;		///< Start time, from timeNow()
+	nsec_t dur;			///< Duration in nsec or -1 for an instant
+};
+
+
+/// Start recording trace events
+
+/// Events are recorded into a ring buffer per thread holding the last
+/// GAM_TRACE_BUFFER_SIZE-1 events. Recording never locks or allocates, except
+/// for the first event of a thread, which takes a buffer reserved with
+/// traceReserve() or else locks and allocates one. When not tracing,
+/// recording costs one relaxed atomic load.
+///
+/// Gamma records the audio callbacks of AudioIO, the phases of
+/// Scheduler::update and Scheduler::reclaim.
+///
+/// \param[in] nodes	also record a span for each node a Scheduler processes
+void traceStart(bool nodes=false);
+
+/// Preallocate buffers for the first events of threads
+
+/// Call this from a control thread before tracing threads that must not
+/// lock or allocate, such as audio threads. Buffers are reserved until there
+/// are at least 'threads' unclaimed ones.
+void traceReserve(unsigned threads);
+
+/// Stop recording trace events; recorded events are kept
+void traceStop();
+
+/// Get whether trace events are being recorded
+bool tracing();
+
+/// Get whether spans of Scheduler nodes are being recorded
+bool tracingNodes();
+
+/// Discard all recorded events
+void traceClear();
+
+/// Name calling thread in traces
+
+/// \param[in] name	thread name; must remain valid until written
+void traceThread(const char * name);
+
+/// Record a span of time on calling thread
+void traceSpan(const char * name, nsec_t begin, nsec_t end, const void * id=0);
+
+/// Record an instant on calling thread
+void traceInstant(const char * name, const void * id=0);
+
+/// Write recorded events as Chrome trace JSON
+
+/// The output can be opened in Perfetto (ui.perfetto.dev) or
+/// chrome://tracing. Times are in microseconds from the earliest event.
+/// Events may be recorded while writing.
+/// \returns number of events written
+unsigned traceWrite(FILE * fp);
+
+/// Write recorded events as Chrome trace JSON to a file
+
+/// \returns whether the file could be written
+bool traceWrite(const char * path);
+
+
+/// Records a span over its lifetime
+
+/// For example,
+///
+///		void Synth::onAudio(AudioIOData& io){
+///			TraceScope trace("Synth::onAudio");
+///			...
+///		}
+class TraceScope{
+public:
+	/// \param[in] name	span name; must remain valid until written
+	/// \param[in] id	object the span is about, if any
+	explicit TraceScope(const char * name, const void * id=0)
+	:	mName(name), mID(id), mBegin(tracing() ? timeNow() : 0)
+	{}
+
+	~TraceScope(){ if(mBegin) traceSpan(mName, mBegin, timeNow(), mID); }
+
+private:
+	const char * mName;
+	const void * mID;
+	nsec_t mBegin;			// 0 if not tracing when constructed
+
+	TraceScope(const TraceScope&);
+	TraceScope& operator=(const TraceScope&);
+};
+
+
+
+
+// Implementation
+
+enum{ TRACE_ON = 1, TRACE_NODES = 2 };
+
+inline std::atomic<unsigned>& traceState(){
+	static std::atomic<unsigned> s(0);
+	return s;
+}
+
+inline bool tracing(){
+	return traceState().load(std::memory_order_relaxed) & TRACE_ON;
+}
+
+inline bool tracingNodes(){
+	return traceState().load(std::memory_order_relaxed) & TRACE_NODES;
+}
+
+} // gam::
+
+#endif
@@ -81,6 +81,34 @@ public:
 		return (X/Y) * mGain; // H(z) = Y(z)/X(z)
 	}
 
+	/// Compute frequency responses at evenly spaced unit frequencies
+
+	/// This gives the same responses as calling operator()(double) at
+	/// frequencies f0, f0+df, ..., but rotates a phasor per delay unit
+	/// instead of computing a sine and cosine per frequency. Phasors are
+	/// stepped eight frequencies at a time in loops that vectorize and are
+	/// recomputed every 256 frequencies to bound rounding drift.
+	///
+	/// \param[out] H	n responses
+	/// \param[in]  f0	first unit frequency
+	/// \param[in]  df	unit frequency increment
+	/// \param[in]  n	number of frequencies
+	void operator()(Complex * H, double f0, double df, unsigned n){
+		double xr[BLOCK], xi[BLOCK], yr[BLOCK], yi[BLOCK];
+		for(unsigned k0=0; k0<n; k0+=BLOCK){
+			const unsigned m = n-k0 < BLOCK ? n-k0 : unsigned(BLOCK);
+			for(unsigned k=0; k<m; ++k){ xr[k] = xi[k] = yi[k] = 0.; yr[k] = 1.; }
+			const double f = f0 + k0*df;
+			for(unsigned i=0; i<mx.size(); ++i) accum(xr, xi, mx[i], mx[i].c, f, df, m);
+			for(unsigned i=0; i<my.size(); ++i) accum(yr, yi, my[i], -my[i].c, f, df, m);
+			for(unsigned k=0; k<m; ++k){
+				// X/Y = X conj(Y) / |Y|^2
+				const double s = mGain / (yr[k]*yr[k] + yi[k]*yi[k]);
+				H[k0+k] = Complex((xr[k]*yr[k] + xi[k]*yi[k]) * s, (xi[k]*yr[k] - xr[k]*yi[k]) * s);
+			}
+		}
+	}
+
 	/// Returns frequency response at coordinate on z-plane
 	Complex operator()(Complex z){
 		Complex X(0,0), Y(1,0);
@@ -90,8 +118,29 @@ public:
 	}
 
 protected:
+	enum{ BLOCK = 256, LANES = 8 };
 	std::vector<DelayUnit> mx, my;
 	double mGain;
+
+	// Add c e^(i 2pi (f + k df) d) for k in [0, m)
+	static void accum(double * re, double * im, const DelayUnit& u, double c, double f, double df, unsigned m){
+		double pr[LANES], pi[LANES];
+		for(unsigned j=0; j<LANES; ++j){
+			const double phs = M_2PI * (f + j*df) * u.d;
+			pr[j] = c*std::cos(phs); pi[j] = c*std::sin(phs);
+		}
+		const double step = M_2PI * LANES * df * u.d;
+		const double rr = std::cos(step), ri = std::sin(step);
+		unsigned k=0;
+		for(; k+LANES<=m; k+=LANES){
+			for(unsigned j=0; j<LANES; ++j){
+				re[k+j] += pr[j]; im[k+j] += pi[j];
+				const double t = pr[j]*rr - pi[j]*ri;
+				pi[j] = pr[j]*ri + pi[j]*rr; pr[j] = t;
+			}
+		}
+		for(unsigned j=0; k<m; ++k, ++j){ re[k] += pr[j]; im[k] += pi[j]; }
+	}
 };
 
 } // gam::
@@ -65,7 +65,7 @@ public:
 		T elems[2];			///< Component 2-vector
 	};
 
-	Complex(const Complex& v): r(v.r), i(v.i){}
+	Complex(const Complex& v) = default;
 	Complex(const Polar<T>& v){ *this = v; }
 	Complex(const T& r=T(0), const T& i=T(0)): r(r), i(i){}
 	Complex(const T& m, const T& p, int fromPolar){ (*this) = Polar<T>(m,p); }
@@ -238,7 +238,7 @@ public:
 
 	bool operator !=(const Vec& v){ IT(N){ if((*this)[i] == v[i]) return false; } return true; }
 	bool operator !=(const   T& v){ IT(N){ if((*this)[i] == v   ) return false; } return true; }
-	Vec& operator = (const Vec& v){ IT(N) (*this)[i] = v[i]; return *this; }
+	Vec& operator = (const Vec& v) = default;
 	Vec& operator = (const   T& v){ IT(N) (*this)[i] = v; return *this; }
 	bool operator ==(const Vec& v){ IT(N){ if((*this)[i] != v[i]) return false; } return true; }
 	bool operator ==(const   T& v){ IT(N){ if((*this)[i] != v   ) return false; } return true; }
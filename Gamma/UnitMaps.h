@@ -161,15 +161,16 @@ class CSinTable{
 public:
 	typedef TablePow2<B, TComplex> Arc;
 
-	CSinTable(){ init(); }
+	/// The shared tables are computed by the first instance constructed
+	CSinTable(){ arcs(); }
 	
 	/// Get sinusoidal value at unit phase. No bounds checking is performed.
-	TComplex operator()(double phase){
+	TComplex operator()(double phase) const {
 		return (*this)(uint32_t(phase * 4294967296.));
 	}
 	
 	/// Get value from fixed-point phase in interval [0, 2^(B*D))
-	TComplex operator()(uint32_t p){
+	TComplex operator()(uint32_t p) const {
 
 		p >>= shift();
 
@@ -189,31 +190,32 @@ public:
 private:
 	enum{ M = Arc::N };
 
-	// Get pointer to complex arc tables
-	static Arc * arcs(){
-		static Arc tables[D]; // higher index = finer resolution
-		return tables;
-	}
-	
-	static Arc& arc(unsigned res){ return arcs()[res]; }
-	
-	static void init(){
-		static bool tabulate=true;
-		if(tabulate){
-			tabulate=false;
+	// Complex arc tables; higher index = finer resolution
+	struct Arcs{
+		Arc tables[D];
+
+		Arcs(){
 			unsigned long long N = M;
-			
 			for(unsigned j=0; j<D; ++j){		// iterate resolution (course to fine)
 				for(unsigned i=0; i<M; ++i){	// iterate arc of unit circle
 					double p = (i*M_PI)/(N>>1);
-					arc(j)[i].real() = cos(p);
-					arc(j)[i].imag() = sin(p);
+					tables[j][i].real() = cos(p);
+					tables[j][i].imag() = sin(p);
 				}
 				N *= M;
 			}
-			
 		}
+	};
+
+	// One process-wide set of tables, built on first use. Initialization of
+	// a function-local static is thread-safe, so instances can be made from
+	// any thread.
+	static const Arcs& arcs(){
+		static const Arcs a;
+		return a;
 	}
+
+	static const Arc& arc(unsigned res){ return arcs().tables[res]; }
 };
 
 
@@ -246,13 +248,35 @@ public:
 	UnitMapper(T max, T min=0., T p1=1., MapType type = MAP_POW, bool clip=true);
 
 
-	/// Set all attributes
+	/// Set all attributes; rebuilds the table, if any
 	UnitMapper& set(T max, T min=0., T p1=1., MapType type = MAP_POW, bool clip=true);
-	
+
+	/// Tabulate mapping to avoid evaluating pow or exp2; allocates memory
+
+	/// The mapping is sampled at size+1 evenly spaced unit values and
+	/// linearly interpolated, so MAP_POW and MAP_EXP2 cost about as much as
+	/// MAP_LIN; the error shrinks with the square of the size. Tabulated
+	/// mappings always clip. MAP_LIN is computed directly, as it costs no
+	/// more than the table, but the size is kept so that the table is built
+	/// once set() changes to another type. A size of 0 removes the table.
+	/// Call again after changing attributes directly, rather than with set().
+	UnitMapper& table(unsigned size);
+
+	/// Get number of table intervals; 0 if not tabulated
+	unsigned tableSize() const { return mTableSize; }
+
 	T map(T unit);			///< Map a unit value
 	T unmap(T value);		///< Unmap a value to a unit value
-	
+
+	/// Map an array of unit values; out may equal in
+	void map(T * out, const T * in, unsigned n);
+
 private:
+	std::vector<T> mTable;
+	T mTableScale;
+	unsigned mTableSize;
+
+	T mapTable(T u) const;
 	T mapLin (T u);
 	T mapPow (T u);	// Map normal directly using power function
 	T mapExp2(T u);	// Map normal directly using exponentiation function
@@ -266,11 +290,15 @@ private:
 
 // Implementation ______________________________________________________________
 
-template <class T> UnitMapper<T>::UnitMapper(){
+template <class T> UnitMapper<T>::UnitMapper()
+:	mTableScale(0), mTableSize(0)
+{
 	set(T(1));
 }
 
-template <class T> UnitMapper<T>::UnitMapper(T max, T min, T p1, MapType type, bool clip){
+template <class T> UnitMapper<T>::UnitMapper(T max, T min, T p1, MapType type, bool clip)
+:	mTableScale(0), mTableSize(0)
+{
 	set(max, min, p1, type, clip);
 }
 
@@ -280,15 +308,48 @@ template <class T> UnitMapper<T>& UnitMapper<T>::set(T max, T min, T p1, MapType
 	this->p1 = p1;
 	this->type = type;
 	this->clip = clip;
+	return table(tableSize());
+}
+
+template <class T> UnitMapper<T>& UnitMapper<T>::table(unsigned size){
+	std::vector<T> t;
+	if(size && type != MAP_LIN){
+		mTable.clear();
+		const bool c = clip;
+		clip = true;
+		t.resize(size+1);
+		for(unsigned i=0; i<=size; ++i) t[i] = map(T(i) / T(size));
+		clip = c;
+	}
+	mTable.swap(t);
+	mTableScale = T(size);
+	mTableSize = size;
 	return *this;
 }
 
+template <class T> inline T UnitMapper<T>::mapTable(T u) const {
+	const T x = scl::clip(u) * mTableScale;
+	unsigned i = unsigned(x);
+	if(i >= mTable.size()-1) i = unsigned(mTable.size()-2);
+	const T * t = &mTable[i];
+	return t[0] + (x - T(i)) * (t[1] - t[0]);
+}
+
+template <class T> void UnitMapper<T>::map(T * out, const T * in, unsigned n){
+	if(!mTable.empty()){
+		for(unsigned i=0; i<n; ++i) out[i] = mapTable(in[i]);
+	}
+	else{
+		for(unsigned i=0; i<n; ++i) out[i] = map(in[i]);
+	}
+}
+
 template <class T> inline T UnitMapper<T>::map(T u){
+	if(!mTable.empty()) return mapTable(u);
 	switch(type){
-	case MAP_LIN:	return mapLin(u);
 	case MAP_POW:	return mapPow(u);
 	case MAP_EXP2:	return mapExp2(u);
-	default:;
+	default:		return mapLin(u);
 	}
 }
 
@@ -0,0 +1,524 @@
+#ifndef GAMMA_WAVETABLE_H_INC
+#define GAMMA_WAVETABLE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Band-limited mipmapped wavetables and oscillators to play them
+*/
+
+#include <cmath>
+#include <string>
+#include <vector>
+#include "Gamma/Containers.h"
+#include "Gamma/FFT.h"
+#include "Gamma/Oscillator.h"
+#include "Gamma/TableCache.h"
+
+namespace gam{
+
+/// Band-limited wavetable with one table per octave
+
+/// This holds a single-cycle waveform as a set of tables, or levels, of the
+/// same size. Level 0 holds all harmonics of the source and each higher level
+/// holds half the harmonics of the one below it, down to a pure fundamental.
+/// The levels are computed once with an FFT and can be shared by any number
+/// of MipmapOsc instances.
+///
+/// \tparam Tv	Value (sample) type
+/// \ingroup Oscillator
+template <class Tv = gam::real>
+class MipmapTable{
+public:
+
+	/// Construct a silent table
+	MipmapTable(){ build(0,2); }
+
+	/// \param[in] src		single cycle of waveform
+	/// \param[in] size		size of cycle; must be a power of two
+	MipmapTable(const Tv * src, unsigned size){ build(src, size); }
+
+	~MipmapTable(){ clear(); }
+
+
+	/// Get number of levels
+	unsigned levels() const { return unsigned(mLevels.size()); }
+
+	/// Get size of each level
+	unsigned size() const { return mLevels[0]->size(); }
+
+	/// Get table of a level
+
+	/// Level k holds harmonics 1 through size()/2^(k+1).
+	///
+	const ArrayPow2<Tv>& level(unsigned k) const { return *mLevels[k]; }
+
+	/// Get continuous level for playback at a unit frequency
+
+	/// The integer part is the richest level that does not alias from the
+	/// fractional part onwards; the fractional part is the amount of the next
+	/// level to crossfade to.
+	float levelFor(float freqUnit) const {
+		float l = std::log2(std::fabs(freqUnit) * size()) + 1.f;
+		float lmax = float(levels()-1);
+		return l <= 0.f ? 0.f : (l >= lmax ? lmax : l);
+	}
+
+
+	/// Build levels from a single cycle of a waveform
+
+	/// This allocates memory and so should not be done on the audio thread.
+	/// \param[in] src		single cycle of waveform or 0 for silence
+	/// \param[in] size		size of cycle; must be a power of two
+	void build(const Tv * src, unsigned size){
+		clear();
+		unsigned numLevels = 1;
+		while((size>>(numLevels+1)) >= 1) ++numLevels;
+
+		RFFT<Tv> fft(size);
+		std::vector<Tv> spec(size), buf(size);
+		if(src) for(unsigned i=0; i<size; ++i) spec[i] = src[i];
+		fft.forward(&spec[0], false, true);
+
+		// format is [r0, r1, i1, ..., r(n/2)]
+		for(unsigned k=0; k<numLevels; ++k){
+			unsigned hmax = (size/2)>>k;
+			for(unsigned i=0; i<size; ++i) buf[i] = Tv(0);
+			buf[0] = spec[0];
+			for(unsigned h=1; h<=hmax && h<size/2; ++h){
+				buf[2*h-1] = spec[2*h-1];
+				buf[2*h  ] = spec[2*h  ];
+			}
+			if(0 == k) buf[size-1] = spec[size-1];
+			fft.inverse(&buf[0], false);
+
+			ArrayPow2<Tv> * lev = new ArrayPow2<Tv>(size);
+			for(unsigned i=0; i<size; ++i) (*lev)[i] = buf[i];
+			mLevels.push_back(lev);
+		}
+	}
+
+	/// Build levels from an array holding a single cycle of a waveform
+	void build(const ArrayPow2<Tv>& src){ build(src.elems(), src.size()); }
+
+private:
+	std::vector<ArrayPow2<Tv> *> mLevels;
+
+	void clear(){
+		for(unsigned k=0; k<mLevels.size(); ++k) delete mLevels[k];
+		mLevels.clear();
+	}
+
+	MipmapTable(const MipmapTable&);
+	MipmapTable& operator=(const MipmapTable&);
+};
+
+
+
+/// Band-limited wavetable oscillator
+
+/// This plays a MipmapTable by crossfading between the two levels whose
+/// harmonics stay below the Nyquist frequency at the current frequency. The
+/// result is free of aliasing for any frequency at the cost of two table
+/// lookups per sample. The levels are chosen whenever the frequency changes,
+/// so frequency modulation should be applied with freq() at control rate.
+///
+/// \tparam Tv	Value (sample) type
+/// \tparam Si	Table interpolation strategy
+/// \tparam Sp	Phase increment strategy (e.g., phsInc::Loop, phsInc::Oneshot)
+/// \tparam Td	Domain type
+/// \ingroup Oscillator
+/// \sa Osc, MipmapTable
+template<
+	class Tv = gam::real,
+	template<class> class Si = ipl::Linear,
+	class Sp = phsInc::Loop,
+	class Td = DomainObserver
+>
+class MipmapOsc : public Accum<Sp,Td>{
+public:
+
+	/// Default constructor references a silent table
+	MipmapOsc()
+	:	mTable(&silentTable()), mLevelFreqI(0xffffffff), mLevel(0), mFade(0)
+	{}
+
+	/// \param[in] src		table to reference; must persist with the oscillator
+	/// \param[in] frq		Frequency
+	/// \param[in] phs		Phase in [0, 1)
+	MipmapOsc(const MipmapTable<Tv>& src, float frq=440, float phs=0)
+	:	Accum<Sp,Td>(frq, phs), mTable(&src), mLevelFreqI(0xffffffff), mLevel(0), mFade(0)
+	{}
+
+
+	/// Set table to reference
+	void table(const MipmapTable<Tv>& src){ mTable = &src; mLevelFreqI = ~this->freqI(); }
+
+	/// Get referenced table
+	const MipmapTable<Tv>& table() const { return *mTable; }
+
+
+	/// Generate next sample
+	Tv operator()(){
+		updateLevel();
+		Tv r = atPhaseI(this->phaseI());
+		this->nextPhase();
+		return r;
+	}
+
+	/// Generate a block of n samples
+	void operator()(Tv * dst, unsigned n){
+		updateLevel();
+		uint32_t phs[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, m);
+			for(unsigned i=0; i<m; ++i) dst[i] = atPhaseI(phs[i]);
+			dst += m; n -= m;
+		}
+	}
+
+	/// Get table value at fixed-point phase using the current levels
+	Tv atPhaseI(uint32_t v) const {
+		const Tv a = mIpol(mTable->level(mLevel), v);
+		if(mFade == 0.f) return a;
+		const Tv b = mIpol(mTable->level(mLevel+1), v);
+		return a + (b - a) * mFade;
+	}
+
+private:
+	const MipmapTable<Tv> * mTable;
+	uint32_t mLevelFreqI;	// frequency levels were chosen for
+	unsigned mLevel;		// richer level
+	float mFade;			// amount of next level
+	Si<Tv> mIpol;
+
+	void updateLevel(){
+		if(this->freqI() == mLevelFreqI) return;
+		mLevelFreqI = this->freqI();
+		float l = mTable->levelFor(float(int32_t(mLevelFreqI)) / 4294967296.f);
+		mLevel = unsigned(l);
+		mFade = l - float(mLevel);
+		if(mLevel+1 >= mTable->levels()){ mLevel = mTable->levels()-1; mFade = 0.f; }
+	}
+
+	static const MipmapTable<Tv>& silentTable(){
+		static MipmapTable<Tv> t;
+		return t;
+	}
+};
+
+
+
+/// Set of band-limited wavetables, or frames, to morph between
+
+/// This holds a sequence of single-cycle waveforms, each band-limited into
+/// levels as by MipmapTable, in one contiguous block. The frames of a level
+/// are adjacent, so morphing between neighboring frames reads nearby memory,
+/// and each table is followed by a copy of its first sample, so lookups need
+/// no wrapping. A set can be built once in a TableCache and shared by any
+/// number of WavetableOsc instances.
+///
+/// \tparam Tv	Value (sample) type
+/// \ingroup Oscillator
+template <class Tv = gam::real>
+class WavetableSet{
+public:
+
+	/// Construct a silent set of one frame
+	WavetableSet(){ build(0,1,2); }
+
+	/// \param[in] src		frames, one cycle after another
+	/// \param[in] frames	number of frames
+	/// \param[in] size		size of each cycle; must be a power of two
+	WavetableSet(const Tv * src, unsigned frames, unsigned size){ build(src, frames, size); }
+
+	/// Reference set in a table cache, building it on first use
+
+	/// The set is keyed by name, number of frames and size; the source is
+	/// only read when the set is not yet cached, e.g. loaded with
+	/// TableCache::load.
+	///
+	/// \param[in] cache		table cache to hold the set
+	/// \param[in] name		name identifying the frames
+	/// \param[in] src		frames, one cycle after another
+	/// \param[in] frames	number of frames
+	/// \param[in] size		size of each cycle; must be a power of two
+	WavetableSet(TableCache<Tv>& cache, const char * name, const Tv * src, unsigned frames, unsigned size){
+		build(cache, name, src, frames, size);
+	}
+
+
+	unsigned frames() const { return mFrames; }		///< Get number of frames
+	unsigned size() const { return mSize; }			///< Get size of each table
+	unsigned levels() const { return mLevels; }		///< Get number of levels
+	unsigned stride() const { return mSize+1; }		///< Get distance between tables, in elements
+	unsigned phaseShift() const { return mShift; }	///< Get right shift of fixed-point phase to table index
+
+	/// Get table of a frame at a level
+
+	/// Level k holds harmonics 1 through size()/2^(k+1). The table has
+	/// size()+1 elements, the last repeating the first.
+	const Tv * table(unsigned frame, unsigned k) const {
+		return mData + (size_t(k)*mFrames + frame)*stride();
+	}
+
+	/// Get continuous level for playback at a unit frequency, as MipmapTable::levelFor
+	float levelFor(float freqUnit) const {
+		float l = std::log2(std::fabs(freqUnit) * size()) + 1.f;
+		float lmax = float(levels()-1);
+		return l <= 0.f ? 0.f : (l >= lmax ? lmax : l);
+	}
+
+
+	/// Build set from frames of single cycles
+
+	/// This allocates memory and so should not be done on the audio thread.
+	/// \param[in] src		frames, one cycle after another, or 0 for silence
+	/// \param[in] frames	number of frames
+	/// \param[in] size		size of each cycle; must be a power of two
+	void build(const Tv * src, unsigned frames, unsigned size){
+		dims(frames, size);
+		mOwn.assign(elements(), Tv(0));
+		fill(&mOwn[0], src);
+		mData = &mOwn[0];
+	}
+
+	/// Reference set in a table cache, building it on first use
+	void build(TableCache<Tv>& cache, const char * name, const Tv * src, unsigned frames, unsigned size){
+		dims(frames, size);
+		std::vector<Tv>().swap(mOwn);
+		const double key[2] = {double(frames), double(size)};
+		const std::string cacheName = std::string("wavetable:") + name;
+		mData = cache.tableWith(cacheName.c_str(), elements(),
+			[this, src](Tv * dst, unsigned){ fill(dst, src); },
+			key, 2
+		).elems();
+	}
+
+private:
+	std::vector<Tv> mOwn;	// elements, if not in a cache
+	const Tv * mData;
+	unsigned mFrames, mSize, mLevels, mShift;
+
+	void dims(unsigned frames, unsigned size){
+		mFrames = frames ? frames : 1;
+		mSize = size;
+		mLevels = 1;
+		while((size>>(mLevels+1)) >= 1) ++mLevels;
+		mShift = 32;
+		while(size > 1){ size >>= 1; --mShift; }
+	}
+
+	// One more table so the last frame can be read with a next frame of zero weight
+	unsigned elements() const { return (mLevels*mFrames + 1)*stride(); }
+
+	void fill(Tv * dst, const Tv * src) const {
+		RFFT<Tv> fft(mSize);
+		std::vector<Tv> spec(mSize), buf(mSize);
+
+		for(unsigned f=0; f<mFrames; ++f){
+			for(unsigned i=0; i<mSize; ++i) spec[i] = src ? src[f*mSize + i] : Tv(0);
+			fft.forward(&spec[0], false, true);
+
+			// format is [r0, r1, i1, ..., r(n/2)]
+			for(unsigned k=0; k<mLevels; ++k){
+				unsigned hmax = (mSize/2)>>k;
+				for(unsigned i=0; i<mSize; ++i) buf[i] = Tv(0);
+				buf[0] = spec[0];
+				for(unsigned h=1; h<=hmax && h<mSize/2; ++h){
+					buf[2*h-1] = spec[2*h-1];
+					buf[2*h  ] = spec[2*h  ];
+				}
+				if(0 == k) buf[mSize-1] = spec[mSize-1];
+				fft.inverse(&buf[0], false);
+
+				Tv * t = dst + (size_t(k)*mFrames + f)*stride();
+				for(unsigned i=0; i<mSize; ++i) t[i] = buf[i];
+				t[mSize] = t[0];
+			}
+		}
+	}
+
+	WavetableSet(const WavetableSet&);
+	WavetableSet& operator=(const WavetableSet&);
+};
+
+
+
+/// Band-limited wavetable oscillator morphing between frames
+
+/// This plays a WavetableSet at a continuous frame position, interpolating
+/// linearly within tables and between the two frames around the position.
+/// Levels are crossfaded as by MipmapOsc, so a sample takes two table
+/// lookups per level. The block generators look up a block of phases at
+/// once in loops free of dependencies, which compilers turn into SIMD
+/// gathers, and all voices playing a set share its memory.
+///
+/// \tparam Tv	Value (sample) type
+/// \tparam Sp	Phase increment strategy (e.g., phsInc::Loop, phsInc::Oneshot)
+/// \tparam Td	Domain type
+/// \ingroup Oscillator
+/// \sa WavetableSet, MipmapOsc
+template<
+	class Tv = gam::real,
+	class Sp = phsInc::Loop,
+	class Td = DomainObserver
+>
+class WavetableOsc : public Accum<Sp,Td>{
+public:
+
+	/// Default constructor references a silent set
+	WavetableOsc()
+	:	mSet(&silentSet()), mLevelFreqI(0xffffffff), mLevel(0), mFade(0), mFrame(0)
+	{}
+
+	/// \param[in] src		set to reference; must persist with the oscillator
+	/// \param[in] frq		Frequency
+	/// \param[in] frame	Frame position in [0, frames-1]
+	WavetableOsc(const WavetableSet<Tv>& src, float frq=440, float frame=0)
+	:	Accum<Sp,Td>(frq), mSet(&src), mLevelFreqI(0xffffffff), mLevel(0), mFade(0), mFrame(0)
+	{
+		this->frame(frame);
+	}
+
+
+	/// Set frame set to reference
+	void table(const WavetableSet<Tv>& src){
+		mSet = &src; mLevelFreqI = ~this->freqI(); frame(mFrame);
+	}
+
+	/// Get referenced frame set
+	const WavetableSet<Tv>& table() const { return *mSet; }
+
+	/// Set frame position, clipped to [0, frames-1]
+	void frame(float v){
+		const float fmax = float(mSet->frames()-1);
+		mFrame = v < 0.f ? 0.f : (v > fmax ? fmax : v);
+	}
+
+	/// Get frame position
+	float frame() const { return mFrame; }
+
+
+	/// Generate next sample
+	Tv operator()(){
+		updateLevel();
+		Tv r = atPhaseI(this->phaseI(), mFrame);
+		this->nextPhase();
+		return r;
+	}
+
+	/// Generate a block of n samples at the current frame position
+	void operator()(Tv * dst, unsigned n){
+		updateLevel();
+		unsigned f0; Tv morph;
+		frames(f0, morph, mFrame);
+		uint32_t phs[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, m);
+			lookup(dst, phs, f0, morph, m);
+			dst += m; n -= m;
+		}
+	}
+
+	/// Generate a block of n samples with per-sample frame positions
+	void operator()(Tv * dst, const float * frame, unsigned n){
+		updateLevel();
+		uint32_t phs[64];
+		unsigned f0[64]; Tv morph[64];
+		while(n){
+			unsigned m = n < 64 ? n : 64;
+			this->nextPhases(phs, m);
+			for(unsigned i=0; i<m; ++i) frames(f0[i], morph[i], clip(frame[i]));
+			lookup(dst, phs, f0, morph, m);
+			dst += m; frame += m; n -= m;
+		}
+	}
+
+	/// Get table value at fixed-point phase and frame position
+	Tv atPhaseI(uint32_t v, float frame) const {
+		unsigned f0; Tv morph;
+		frames(f0, morph, clip(frame));
+		Tv r;
+		lookup(&r, &v, f0, morph, 1);
+		return r;
+	}
+
+private:
+	const WavetableSet<Tv> * mSet;
+	uint32_t mLevelFreqI;	// frequency levels were chosen for
+	unsigned mLevel;		// richer level
+	float mFade;			// amount of next level
+	float mFrame;
+
+	float clip(float v) const {
+		const float fmax = float(mSet->frames()-1);
+		return v < 0.f ? 0.f : (v > fmax ? fmax : v);
+	}
+
+	// Get first frame and amount of next one
+	void frames(unsigned& f0, Tv& morph, float pos) const {
+		f0 = unsigned(pos);
+		if(f0+1 >= mSet->frames()){ f0 = mSet->frames()-1; morph = Tv(0); }
+		else morph = Tv(pos - float(f0));
+	}
+
+	// Offset of frame f0 and amount of frame f0+1, given once or per sample
+	static unsigned at(unsigned f0, unsigned){ return f0; }
+	static unsigned at(const unsigned * f0, unsigned i){ return f0[i]; }
+	static Tv at(Tv morph, unsigned){ return morph; }
+	static Tv at(const Tv * morph, unsigned i){ return morph[i]; }
+
+	template <class F, class M>
+	void lookup(Tv * dst, const uint32_t * phs, F f0, M morph, unsigned n) const {
+		const WavetableSet<Tv>& s = *mSet;
+		const unsigned shift = s.phaseShift();
+		const Tv * lo = s.table(0, mLevel);
+		const unsigned stride = s.stride();
+
+		// Index and fraction in one loop, lookups in another, so both vectorize
+		unsigned idx[64]; Tv frac[64];
+		for(unsigned i=0; i<n; ++i){
+			idx[i] = (phs[i] >> shift) + at(f0,i)*stride;
+			frac[i] = Tv(int32_t((phs[i] << (32-shift)) >> 1)) * Tv(1./2147483648.);
+		}
+		for(unsigned i=0; i<n; ++i){
+			const Tv * t = lo + idx[i];
+			Tv a = t[0] + (t[1] - t[0])*frac[i];
+			Tv b = t[stride] + (t[stride+1] - t[stride])*frac[i];
+			dst[i] = a + (b - a)*at(morph,i);
+		}
+		if(mFade == 0.f) return;
+
+		const Tv * hi = s.table(0, mLevel+1);
+		const Tv fade = Tv(mFade);
+		for(unsigned i=0; i<n; ++i){
+			const Tv * t = hi + idx[i];
+			Tv a = t[0] + (t[1] - t[0])*frac[i];
+			Tv b = t[stride] + (t[stride+1] - t[stride])*frac[i];
+			Tv c = a + (b - a)*at(morph,i);
+			dst[i] += (c - dst[i])*fade;
+		}
+	}
+
+	void updateLevel(){
+		if(this->freqI() == mLevelFreqI) return;
+		mLevelFreqI = this->freqI();
+		float l = mSet->levelFor(float(int32_t(mLevelFreqI)) / 4294967296.f);
+		mLevel = unsigned(l);
+		mFade = l - float(mLevel);
+		if(mLevel+1 >= mSet->levels()){ mLevel = mSet->levels()-1; mFade = 0.f; }
+	}
+
+	static const WavetableSet<Tv>& silentSet(){
+		static WavetableSet<Tv> s;
+		return s;
+	}
+};
+
+} // gam::
+
+#endif
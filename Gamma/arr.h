@@ -8,6 +8,7 @@
 	Functions for processing arrays of data.
 */
 
+#include <algorithm>
 #include "Gamma/mem.h"
 #include "Gamma/scl.h"
 
@@ -45,6 +46,55 @@ inline T sumSquares(const T * src, unsigned len, unsigned str=1){
 	return dot(src,src,len,str);
 }
 
+// Float versions of numeric reductions. With a unit stride, these use AVX2,
+// SSE2 or NEON when available, but may round differently than the generic
+// versions as the order of summation differs. Other strides use the generic
+// versions.
+
+/// Returns dot-product of two float arrays
+float dot(const float * src1, const float * src2, unsigned len, unsigned str=1);
+
+/// Returns sum of float values squared
+float sumSquares(const float * src, unsigned len, unsigned str=1);
+
+/// Returns mean norm of float array values
+float meanNorm(const float * src, unsigned len, unsigned str=1);
+
+/// Returns unnormalized Nyquist value of float array for use with DFT
+float nyquist(const float * src, unsigned len, unsigned str=1);
+
+/// Get indices of first minimum and maximum values of float array
+void extrema(const float * src, unsigned len, unsigned& indexMin, unsigned& indexMax);
+
+/// Locates strict local maxima of float array and writes their indices into 'dst'
+
+/// Returns number of maxima found. With a unit stride, neighbors are compared
+/// several at a time.
+unsigned maxima(unsigned * dst, const float * src, unsigned len, unsigned str=1);
+
+/// Writes indices of float array elements at or above a threshold into 'dst'
+
+/// Returns number of indices written. Elements are compared several at a
+/// time and the indices packed without branching on each element.
+unsigned above(unsigned * dst, const float * src, unsigned len, float thresh);
+
+/// Compute histogram of float array
+
+/// This tallies the same bins as the generic version. Long arrays are split
+/// into blocks that are tallied on separate threads into private bins, which
+/// are then added to 'bins'. The threads are started when first needed and
+/// wait for the next call in between. While one call uses them, calls from
+/// other threads tally on their own thread.
+void histogram(const float * src, unsigned len, unsigned * bins, unsigned numBins, float scale=1);
+
+void histogram(const float * src, unsigned len, unsigned * bins, unsigned numBins, float scale, float offset);
+
+/// Set maximum number of threads, including the caller's, tallying a histogram
+
+/// The default, also set by 0, is the number of hardware threads.
+///
+void histogramThreads(unsigned n);
+
 
 
 
@@ -70,6 +120,213 @@ unsigned addToRing(T * ring, unsigned ringSize, unsigned ringTap, const T * src,
 /// Clip array values between [-1, 1].
 void clip1(float * arr, unsigned len, unsigned str=1);
 
+/// Apply linearly ramped gain, zero NaNs and clip to [-1, 1] in one pass.
+
+/// Element i is multiplied by gain + i*dgain, set to zero if it is NaN and
+/// then clipped. NaNs are passed through unchanged if not zeroed. This uses
+/// AVX-512, AVX2, SSE or NEON as chosen at runtime (see simdPath()) and is
+/// otherwise scalar.
+/// The source and destination may be the same array.
+///
+/// \param[out] dst		destination array
+/// \param[in]  src		source array
+/// \param[in]  len		number of elements
+/// \param[in]  gain		gain of first element
+/// \param[in]  dgain		gain increment per element
+/// \param[in]  zeroNaNs	whether to set NaNs to zero
+/// \param[in]  clip		whether to clip values between [-1, 1]
+void gainNaNClip(
+	float * dst, const float * src, unsigned len,
+	float gain=1.f, float dgain=0.f, bool zeroNaNs=true, bool clip=true
+);
+
+/// Add several source arrays into destination array in one pass
+
+/// Sources are added in order, so the result does not depend on the
+/// position of a source in memory. This uses AVX-512, AVX2, SSE or NEON as
+/// chosen at runtime (see simdPath()).
+///
+/// \param[in,out] dst		destination array
+/// \param[in]  srcs		source arrays
+/// \param[in]  numSrcs	number of source arrays
+/// \param[in]  len		number of elements in each array
+void mix(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len);
+
+/// Add sums of products of complex arrays into destination array in one pass
+
+/// Element i of the destination is incremented by the sum over k of
+/// a[k][i] * b[k][i]. Complex numbers are interleaved real and imaginary
+/// values. This uses AVX2, SSE or NEON as chosen at runtime (see simdPath()).
+///
+/// \param[in,out] dst	destination complex array
+/// \param[in]  a		first factors of each product
+/// \param[in]  b		second factors of each product
+/// \param[in]  num		number of products
+/// \param[in]  len		number of complex elements in each array
+void mulAddComplex(float * dst, const float * const * a, const float * const * b, unsigned num, unsigned len);
+
+/// Run a block of input through a bank of complex one-pole resonators
+
+/// For each input sample x, each resonator state z[k] = zr[k] + i zi[k] is
+/// updated as z[k] = z[k] * w[k] + x, where w[k] = wr[k] + i wi[k].
+/// Resonators are processed in SIMD vectors (AVX2, SSE or NEON as chosen at
+/// runtime) with states kept in registers across the block.
+///
+/// \param[in,out] zr	real parts of resonator states
+/// \param[in,out] zi	imaginary parts of resonator states
+/// \param[in]  wr		real parts of resonator coefficients
+/// \param[in]  wi		imaginary parts of resonator coefficients
+/// \param[in]  num		number of resonators
+/// \param[in]  src		input block
+/// \param[in]  len		number of input samples
+void resonate(
+	float * zr, float * zi, const float * wr, const float * wi, unsigned num,
+	const float * src, unsigned len
+);
+
+/// Add the outputs of a bank of two-pole resonators to a block
+
+/// For each sample j, each resonator k is updated as
+/// y0 = c1[k] * y1[k] + c2[k] * y2[k], y2[k] = y1[k], y1[k] = y0 and the
+/// sum of y0 over all resonators is added to dst[j]. With c1 = 2 r cos(w)
+/// and c2 = -r^2, each one is a (decaying) sinusoid, as gen::RSin2.
+/// Resonators are processed in SIMD vectors (AVX2, SSE or NEON as chosen at
+/// runtime) with states kept in registers across the block.
+///
+/// \param[in,out] dst	block to add outputs to
+/// \param[in,out] y1	previous outputs of resonators
+/// \param[in,out] y2	second previous outputs of resonators
+/// \param[in]  c1		first feedback coefficients
+/// \param[in]  c2		second feedback coefficients
+/// \param[in]  num		number of resonators
+/// \param[in]  len		number of samples in block
+void addTwoPoleBank(
+	float * dst, float * y1, float * y2, const float * c1, const float * c2,
+	unsigned num, unsigned len
+);
+
+/// Add the outputs of a bank of driven complex one-pole resonators to a block
+
+/// For each input sample x, each resonator state z[k] = zr[k] + i zi[k] is
+/// updated as z[k] = z[k] * w[k] + g[k] x and the sum of the imaginary parts
+/// over all resonators is added to dst. This is arr::resonate with per
+/// resonator input gains and an output.
+///
+/// \param[in,out] dst	block to add outputs to
+/// \param[in,out] zr	real parts of resonator states
+/// \param[in,out] zi	imaginary parts of resonator states
+/// \param[in]  wr		real parts of resonator coefficients
+/// \param[in]  wi		imaginary parts of resonator coefficients
+/// \param[in]  g		input gains
+/// \param[in]  num		number of resonators
+/// \param[in]  src		input block or 0 for no input
+/// \param[in]  len		number of samples in block
+void addResonatorBank(
+	float * dst, float * zr, float * zi, const float * wr, const float * wi,
+	const float * g, unsigned num, const float * src, unsigned len
+);
+
+/// Filter a block through two chains of six first-order all-pass sections
+
+/// Each section is the first-order all-pass filter of AllPass1 and both
+/// chains filter the same input. The sections
+/// are run as a wavefront, each one sample behind the one before it, so that
+/// all twelve are updated at once in SIMD registers instead of as two
+/// chains of six dependent steps. This is the core of the Hilbert transform.
+///
+/// \param[out] dst0		output of first chain; may equal src
+/// \param[out] dst1		output of second chain; may equal src
+/// \param[in]  src		input block
+/// \param[in]  len		number of samples in block
+/// \param[in]  coef		coefficients of first chain, then second chain
+/// \param[in,out] state	delays of first chain, then second chain
+void allPassChains(
+	float * dst0, float * dst1, const float * src, unsigned len,
+	const float * coef, float * state
+);
+
+/// Convert complex values to magnitude and phase
+
+/// Complex values are interleaved real and imaginary values. Output pairs
+/// are magnitude and phase, in [-pi, pi]. This uses AVX2, SSE2 or NEON when
+/// available.
+///
+/// \param[out] dst		destination array of magnitude/phase pairs
+/// \param[in]  src		source array of complex values; may equal dst
+/// \param[in]  len		number of complex values
+/// \param[in]  precise	if true, phase error is within a few ulp; if false,
+///						it is within about 0.01 radians, as scl::atan2Fast
+void cartToPolar(float * dst, const float * src, unsigned len, bool precise=false);
+
+/// Convert magnitude and phase pairs to complex values
+
+/// \param[out] dst		destination array of complex values
+/// \param[in]  src		source array of magnitude/phase pairs; may equal dst
+/// \param[in]  len		number of complex values
+/// \param[in]  precise	if true, error is within a few ulp; if false, within
+///						about 4e-6, as scl::cosT8 and scl::sinT9. Phases
+///						need not be wrapped, but accuracy drops beyond about
+///						1e4 radians.
+/// \see cartToPolar
+void polarToCart(float * dst, const float * src, unsigned len, bool precise=false);
+
+/// Convert interleaved 16-bit integer samples to float and deinterleave
+
+/// Samples are scaled by 1/32768 into [-1, 1). Mono and stereo use SSE2
+/// or NEON when available. For plain conversion of interleaved samples,
+/// pass one destination with numChans=1 and numFrames as the sample count.
+///
+/// \param[out] dst			destination array for each channel
+/// \param[in]  src			interleaved source samples
+/// \param[in]  numFrames	number of frames
+/// \param[in]  numChans	number of channels
+void fromPCM16(float * const * dst, const int16_t * src, unsigned numFrames, unsigned numChans=1);
+
+/// Convert interleaved packed little-endian 24-bit samples to float and deinterleave
+
+/// Samples are scaled by 1/8388608 into [-1, 1).
+///
+void fromPCM24(float * const * dst, const uint8_t * src, unsigned numFrames, unsigned numChans=1);
+
+/// Convert interleaved 32-bit integer samples to float and deinterleave
+
+/// Samples are scaled by 1/2147483648 into [-1, 1).
+///
+void fromPCM32(float * const * dst, const int32_t * src, unsigned numFrames, unsigned numChans=1);
+
+/// Interleave float samples and convert to 16-bit integers
+
+/// Samples are scaled by 32767, rounded and saturated. NaNs become zero.
+/// If a dither state is given, triangular (TPDF) dither of 1 LSB peak
+/// amplitude is added before rounding and the state is advanced. Mono and
+/// stereo use SSE2 or NEON when available.
+///
+/// \param[out] dst			interleaved destination samples
+/// \param[in]  src			source array for each channel
+/// \param[in]  numFrames	number of frames
+/// \param[in]  numChans	number of channels
+/// \param[in,out] dither	state of dither noise generator or NULL for no dither
+void toPCM16(int16_t * dst, const float * const * src, unsigned numFrames, unsigned numChans=1, uint32_t * dither=0);
+
+/// Interleave float samples and convert to packed little-endian 24-bit integers
+
+/// Samples are scaled by 8388607, rounded and saturated. NaNs become zero.
+///
+void toPCM24(uint8_t * dst, const float * const * src, unsigned numFrames, unsigned numChans=1);
+
+/// Interleave float samples and convert to 32-bit integers
+
+/// Samples are scaled by 2147483648, rounded and saturated. NaNs become zero.
+///
+void toPCM32(int32_t * dst, const float * const * src, unsigned numFrames, unsigned numChans=1);
+
+/// Writes indices of elements at or above a threshold into 'dst'
+
+/// Returns number of indices written. Indices are in ascending order.
+///
+template <class Index, class T>
+unsigned above(Index * dst, const T * src, unsigned len, T thresh);
+
 /// Finds elements that are within a threshold of their nearest neighbors.
 
 /// \param[in]  src			Source array of elements
@@ -130,6 +387,20 @@ void indicesComplement(Index * indices, unsigned numIndices, unsigned maxNumIndi
 template <class T1, class T2, class T3>
 void lineFit(const T1 * src, unsigned len, T2& slope, T3& inter);
 
+/// Evaluates a Chebyshev series at each array value
+
+/// This writes the sum of coef[k] T_k(src[i]), for k in [0, num), into dst[i],
+/// where T_k is the kth Chebyshev polynomial of the first kind. The sum is
+/// found with Clenshaw's recurrence. 'dst' may equal 'src'.
+template <class T>
+void chebyshev(T * dst, const T * src, unsigned len, const T * coef, unsigned num);
+
+/// Evaluates a Chebyshev series at each float array value
+
+/// Several vectors of values are summed at once to hide the latency of the
+/// recurrence.
+void chebyshev(float * dst, const float * src, unsigned len, const float * coef, unsigned num);
+
 /// Mapping from linear range [-1, 1] to normalized dB range [-1, 1].
 void linToDB(float * arr, unsigned len, float minDB);
 
@@ -258,17 +529,22 @@ unsigned slopeAbsMax(const T * src, unsigned len);
 template <class T>
 unsigned slopeMax(const T * src, unsigned len);
 
+/// Longest array sorted by insertion in sortInsertion()
+static const unsigned sortInsertionMax = 64;
+
 /// Insertion sort of elements.
 
 /// Elements are sorted from lowest to highest.
 /// This sort is fastest for small length arrays and mostly sorted sets.
+/// Arrays longer than sortInsertionMax are sorted in O(n log n) time instead.
 template <class T>
 void sortInsertion(T * arr, unsigned len);
 
 /// Insertion sort of indexed elements.
 
-/// Elements are sorted from lowest to highest.
+/// Elements are sorted from lowest to highest. Equal elements keep their order.
 /// This sort is fastest for small length arrays and mostly sorted sets.
+/// Arrays longer than sortInsertionMax are sorted in O(n log n) time instead.
 template <class T, class Index>
 void sortInsertion(const T * src, Index * indices, unsigned numIndices);
 
@@ -303,6 +579,13 @@ unsigned zeroCount(const T * src, unsigned len, unsigned str=1);
 
 /// 'prev' is the last value from the previous buffer.
 ///
+template <class T>
+unsigned zeroCross(const T * src, unsigned len, T prev);
+
+/// Returns number of zero-crossings in float array.
+
+/// 'prev' is the last value from the previous buffer. Signs of several
+/// values are compared at a time.
 unsigned zeroCross(const float * src, unsigned len, float prev);
 
 template <class T, class Index>
@@ -314,6 +597,26 @@ unsigned zeroCrossFirst(const float * src, unsigned len);
 template <class T>
 unsigned zeroCrossMax(const T * src, unsigned len);
 
+/// Returns number of values at start of array with magnitude less than 'thresh'
+template <class T>
+unsigned headBelowNorm(const T * src, unsigned len, T thresh);
+
+/// Returns number of values at start of float array with magnitude less than 'thresh'
+
+/// Values are compared several at a time, up to the first vector holding a
+/// value of at least 'thresh'.
+unsigned headBelowNorm(const float * src, unsigned len, float thresh);
+
+/// Returns number of values at end of array with magnitude less than 'thresh'
+template <class T>
+unsigned tailBelowNorm(const T * src, unsigned len, T thresh);
+
+/// Returns number of values at end of float array with magnitude less than 'thresh'
+
+/// Values are compared several at a time, from the end back to the first
+/// vector holding a value of at least 'thresh'.
+unsigned tailBelowNorm(const float * src, unsigned len, float thresh);
+
 /// Returns # of negative slope zero-crossings.
 
 /// 'prev' is the last value from the previous buffer.
@@ -409,6 +712,16 @@ double normalize(T * arr, unsigned len, double scale){
 	return normFactor;
 }
 
+template <class Index, class T>
+unsigned above(Index * dst, const T * src, unsigned len, T thresh){
+	unsigned num = 0;
+	for(unsigned i=0; i<len; ++i){
+		dst[num] = i;
+		num += !(src[i] < thresh);
+	}
+	return num;
+}
+
 template <class T, class Index>
 void cluster(const T * src, Index * indices, unsigned& numIndices, T threshold){
 
@@ -728,6 +1041,10 @@ unsigned slopeMax(const T * src, unsigned len){
 
 template <class T>
 void sortInsertion(T * arr, unsigned len){
+	if(len > sortInsertionMax){
+		std::sort(arr, arr+len, [](const T& a, const T& b){ return b > a; });
+		return;
+	}
 	for(unsigned i = 1; i < len; i++){
 		T val = arr[i];
 		unsigned j = i - 1;
@@ -740,6 +1057,11 @@ void sortInsertion(T * arr, unsigned len){
 
 template <class T, class Index>
 void sortInsertion(const T * src, Index * indices, unsigned numIndices){
+	if(numIndices > sortInsertionMax){
+		std::stable_sort(indices, indices+numIndices,
+			[src](const Index& a, const Index& b){ return src[a] < src[b]; });
+		return;
+	}
 	for(unsigned i = 1; i < numIndices; i++)
 	{
 		Index index = indices[i];
@@ -816,6 +1138,45 @@ inline unsigned zeroCount(const T * src, unsigned len, unsigned str){
 	return r;
 }
 
+template <class T>
+unsigned zeroCross(const T * src, unsigned len, T prev){
+	unsigned count = 0;
+	for(unsigned i=0; i<len; ++i){
+		const T curr = src[i];
+		count += unsigned((curr > T(0) && prev <= T(0)) || (curr < T(0) && prev >= T(0)));
+		prev = curr;
+	}
+	return count;
+}
+
+template <class T>
+void chebyshev(T * dst, const T * src, unsigned len, const T * coef, unsigned num){
+	for(unsigned i=0; i<len; ++i){
+		T x2 = T(2) * src[i];
+		T b1 = T(0), b2 = T(0);
+		for(unsigned k=num; k-->1;){
+			T b0 = x2*b1 + (coef[k] - b2);
+			b2 = b1;
+			b1 = b0;
+		}
+		dst[i] = num ? coef[0] + T(0.5)*x2*b1 - b2 : T(0);
+	}
+}
+
+template <class T>
+unsigned headBelowNorm(const T * src, unsigned len, T thresh){
+	unsigned i = 0;
+	while(i<len && scl::abs(src[i]) < thresh) ++i;
+	return i;
+}
+
+template <class T>
+unsigned tailBelowNorm(const T * src, unsigned len, T thresh){
+	unsigned i = len;
+	while(i && scl::abs(src[i-1]) < thresh) --i;
+	return len - i;
+}
+
 template <class T, class Index>
 void zeroCross(const T * src, unsigned len, Index& nzc, Index& pzc){
 	pzc = 0;
@@ -10,6 +10,9 @@
 
 namespace gam{
 
+struct Half;
+struct Sample16;
+
 /// Interpolation functions.
 
 /// The naming convention for values is that their alphabetical order is
@@ -26,7 +29,8 @@ enum Type{
 	MEAN2,		/**< Mean of two nearest neighbors */
 	LINEAR,		/**< Linear interpolation */
 	CUBIC,		/**< Cubic interpolation */
-	ALLPASS		/**< Allpass interpolation */
+	ALLPASS,	/**< Allpass interpolation */
+	SINC		/**< Windowed-sinc interpolation */
 };
 
 
@@ -101,6 +105,37 @@ template <class Tf, class Tv>
 Tv quadratic(Tf frac, const Tv& x, const Tv& y, const Tv& z); 
 
 
+// Block interpolation at a stream of positions. For each i, these read 'src'
+// at fraction frac[i] past element idx[i] and write the result to dst[i].
+// Positions may be in any order, but all elements read must be in bounds.
+
+/// Linear interpolation at a stream of positions; reads idx[i] and idx[i]+1
+template <class T, class Tf>
+void linear(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len);
+
+/// Cubic interpolation at a stream of positions; reads idx[i]-1 to idx[i]+2
+template <class T, class Tf>
+void cubic(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len);
+
+/// Third order Lagrange interpolation at a stream of positions; reads idx[i]-1 to idx[i]+2
+template <class T, class Tf>
+void lagrange3(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len);
+
+// Float versions of the block kernels. These gather and interpolate several
+// positions at a time using AVX2, SSE2 or NEON when available.
+void linear(float * dst, const float * src, const int * idx, const float * frac, unsigned len);
+void cubic(float * dst, const float * src, const int * idx, const float * frac, unsigned len);
+void lagrange3(float * dst, const float * src, const int * idx, const float * frac, unsigned len);
+
+// Versions reading samples stored as 16-bit storage types (Half and Sample16
+// in Conversion.h). The conversion to float is done in the kernel, using
+// AVX2 and F16C when available.
+void linear(float * dst, const Sample16 * src, const int * idx, const float * frac, unsigned len);
+void linear(float * dst, const Half * src, const int * idx, const float * frac, unsigned len);
+void cubic(float * dst, const Sample16 * src, const int * idx, const float * frac, unsigned len);
+void cubic(float * dst, const Half * src, const int * idx, const float * frac, unsigned len);
+
+
 
 
 // Implementation_______________________________________________________________
@@ -156,6 +191,14 @@ void cubic(T * dst, const T * xm1s, const T * xs, const T * xp1s, const T * xp2s
 	for(unsigned i=0; i<len; ++i) dst[i] = cubic(f, xm1s[i], xs[i], xp1s[i], xp2s[i]);
 }
 
+template <class T, class Tf>
+void cubic(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const T * s = src + idx[i];
+		dst[i] = cubic(frac[i], s[-1], s[0], s[1], s[2]);
+	}
+}
+
 
 template <class T> void lagrange(T * a, T delay, unsigned order){
 	for(unsigned i=0; i<=order; ++i){
@@ -195,6 +238,16 @@ template <class T> inline void lagrange3(T * h, T d){
 	h[3] =  d * d1 * d2      * T(1./6.);
 }
 
+template <class T, class Tf>
+void lagrange3(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const T * s = src + idx[i];
+		Tf h[4];
+		lagrange3(h, Tf(1) + frac[i]);
+		dst[i] = s[-1]*h[0] + s[0]*h[1] + s[1]*h[2] + s[2]*h[3];
+	}
+}
+
 /*
 x1 (1 - d) + x0 d
 x1 - x1 d + x0 d
@@ -223,6 +276,14 @@ void linear(T * dst, const T * xs, const T * xp1s, unsigned len, T f){
 	for(unsigned i=0; i<len; ++i) dst[i] = linear(f, xs[i], xp1s[i]);
 }
 
+template <class T, class Tf>
+void linear(T * dst, const T * src, const int * idx, const Tf * frac, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const T * s = src + idx[i];
+		dst[i] = linear(frac[i], s[0], s[1]);
+	}
+}
+
 
 template <class Tf, class Tv>
 inline Tv nearest(Tf f, const Tv& x, const Tv& y){
@@ -7,6 +7,7 @@
 #include <cstring> // memcpy, memmove, etc.
 #include <cstdlib> // free, realloc
 #include "Gamma/Access.h" // indexLast
+#include "Gamma/Allocator.h" // allocAligned
 
 #define LOOP(n,s) for(unsigned i=0; i<n; i+=s)
 
@@ -84,6 +85,15 @@ void deinterleave(T * dst, const T * src, unsigned numFrames, unsigned numChanne
 template <class T>
 void deinterleave2(T * dst, const T * src, unsigned numFrames);
 
+/// Deinterleave float samples with any number of channels
+
+/// Two channels and multiples of four channels are transposed with SSE or
+/// NEON when available.
+void deinterleave(float * dst, const float * src, unsigned numFrames, unsigned numChannels);
+
+/// Deinterleave float samples with 2 channels
+void deinterleave2(float * dst, const float * src, unsigned numFrames);
+
 /// Expands elements from 'src' to 'dst'.
 
 /// Elements are copied contiguously from 'src' to strided locations in 'dst'.
@@ -121,6 +131,15 @@ void interleave(T * dst, const T * src, unsigned numFrames, unsigned numChannels
 template <class T>
 void interleave2(T * dst, const T * src, unsigned numFrames);
 
+/// Interleave float samples with any number of channels
+
+/// Two channels and multiples of four channels are transposed with SSE or
+/// NEON when available.
+void interleave(float * dst, const float * src, unsigned numFrames, unsigned numChannels);
+
+/// Interleave float samples with 2 channels
+void interleave2(float * dst, const float * src, unsigned numFrames);
+
 /// Keeps every Nth element; the rest are zeroed.
 
 /// \param[in]	arr		Array to operate on.
@@ -181,6 +200,17 @@ void replace(const T * val, const T * with, unsigned num, T * arr, unsigned len,
 template <class T>
 bool resize(T *& arr, unsigned sizeNow, unsigned sizeNew);
 
+/// Resizes array aligned to a boundary.  Returns true if resized, false otherwise.
+
+/// This is as resize(), but for arrays from allocAligned(), which must be
+/// released with freeAligned(). Elements are copied as by realloc().
+template <class T>
+bool resizeAligned(T *& arr, unsigned sizeNow, unsigned sizeNew, std::size_t align=64);
+
+/// Frees memory from resizeAligned() and sets pointer to NULL.
+template <class T>
+void freeAligned(T *& ptr);
+
 /// Reverse elements' order in array.
 
 ///	Example: 1234 -> 4321
@@ -480,6 +510,27 @@ bool resize(T *& arr, unsigned sizeNow, unsigned sizeNew){
 	return false;
 }
 
+template <class T>
+bool resizeAligned(T *& arr, unsigned sizeNow, unsigned sizeNew, std::size_t align){
+	if((sizeNow != sizeNew) && (0 != sizeNew)){
+		T * ptr = static_cast<T *>(gam::allocAligned(sizeNew * sizeof(T), align));
+		if(0 != ptr){
+			if(arr){
+				std::memcpy(ptr, arr, (sizeNow < sizeNew ? sizeNow : sizeNew) * sizeof(T));
+				gam::freeAligned(arr);
+			}
+			arr = ptr;
+			return true;
+		}
+	}
+	return false;
+}
+
+template <class T>
+inline void freeAligned(T *& ptr){
+	if(ptr){ gam::freeAligned(static_cast<void *>(ptr)); ptr=0; }
+}
+
 template <class T>
 inline void reverse(T * arr, unsigned len, unsigned str){
 	unsigned end = indexLast(len,str);
@@ -607,8 +658,8 @@ template <class T>
 inline void deinterleave2(T * dst, const T * src, unsigned numFrames){
 	T * dst2 = dst + numFrames;
 	LOOP(numFrames, 1){
-		*dst2++ = *src++;
 		*dst++  = *src++;
+		*dst2++ = *src++;
 	}
 }
 
@@ -626,8 +677,8 @@ template <class T>
 inline void interleave2(T * dst, const T * src, unsigned numFrames){
 	const T * src2 = src + numFrames;
 	LOOP(numFrames, 1){
-		*dst++ = *src2++;
 		*dst++ = *src++;
+		*dst++ = *src2++;
 	}
 }
 
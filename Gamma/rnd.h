@@ -9,6 +9,8 @@
 */
 
 #include <stdio.h>
+#include <atomic>
+#include <cmath>
 #include <ctime> // time()
 #include "Gamma/gen.h"
 #include "Gamma/mem.h"
@@ -19,14 +21,16 @@ namespace gam{
 
 namespace rnd{	
 	/// Get a random seed
-	static uint32_t getSeed(){
-		static gen::RMulAdd<uint32_t> seedGen(1664525, 1013904223);
-		static bool initSeed = true;
-		if(initSeed){
-			seedGen.val = uint32_t(std::time(NULL));
-			initSeed = false;
-		} 
-		return seedGen();
+
+	/// Seeds are scrambled from the start time and a count of calls, so that
+	/// calls from different threads at the same time get different seeds.
+	inline uint32_t getSeed(){
+		static const uint32_t start = uint32_t(std::time(NULL));
+		static std::atomic<uint32_t> calls(0);
+		uint32_t v = start + calls.fetch_add(1, std::memory_order_relaxed) * 0x9E3779B9;
+		v = (v ^ (v >> 16)) * 0x85EBCA6B;
+		v = (v ^ (v >> 13)) * 0xC2B2AE35;
+		return v ^ (v >> 16);
 	}
 } // rnd::
 
@@ -115,6 +119,64 @@ private:
 
 
 
+/// Counter-based uniform pseudo-random number generator
+
+/// This generator computes the number at each index of a stream directly
+/// from a key, using the Philox4x32-10 bijection of Salmon et al.,
+/// "Parallel Random Numbers: As Easy as 1, 2, 3" (SC 2011). The key is made
+/// of a seed and a stream id, so that each voice or thread can draw from its
+/// own stream and get the same numbers on every run, independently of the
+/// order generators are used in. Seeking to any index takes constant time.
+/// Each counter gives four numbers, so sequential calls only compute the
+/// bijection every fourth number.
+class RNGCounter{
+public:
+	RNGCounter(){ seed(rnd::getSeed()); }
+
+	/// \param[in] seed		seed value
+	/// \param[in] stream	stream id
+	RNGCounter(uint32_t seed, uint32_t stream=0){ this->seed(seed, stream); }
+
+	uint32_t operator()();				///< Generates uniform random unsigned integer in [0, 2^32)
+	void operator = (uint32_t seed);	///< Set seed, keeping stream, and go to start
+
+	/// Set seed and stream id and go to start of stream
+	RNGCounter& seed(uint32_t seed, uint32_t stream=0);
+
+	/// Set stream id, keeping seed, and go to start of stream
+	RNGCounter& stream(uint32_t v){ return seed(mKey[0], v); }
+
+	uint32_t seed() const { return mKey[0]; }	///< Get seed
+	uint32_t stream() const { return mKey[1]; }	///< Get stream id
+
+	/// Go to an index within the stream
+	RNGCounter& seek(uint64_t index){ mPos = index; return *this; }
+
+	/// Skip over a number of values
+	RNGCounter& skip(uint64_t n){ mPos += n; return *this; }
+
+	/// Get index of next value within the stream
+	uint64_t position() const { return mPos; }
+
+	/// Returns value at an index of the stream without changing the position
+	uint32_t at(uint64_t index) const;
+
+	/// Compute four values of a counter of a key
+
+	/// \param[out] out		values
+	/// \param[in]  ctr		four words of counter
+	/// \param[in]  key		two words of key
+	static void philox(uint32_t * out, const uint32_t * ctr, const uint32_t * key);
+
+private:
+	uint64_t mPos;		// index of next value
+	uint64_t mBlock;	// counter of values in buffer
+	uint32_t mKey[2];
+	uint32_t mBuf[4];
+};
+
+
+
 /// Random number functions
 
 /// Unless specified, these operations use an internal Tausworthe RNG, favoring
@@ -134,8 +196,14 @@ private:
 ///
 /// // Copies random elements from 'src' to 'dst'.
 /// void distr(T * dst, uint32_t len, T * src, uint32_t srcLen);
+///
+/// // Fills array with random numbers in [0, 1) drawn from 'rng'
+/// void distr_float(RNG& rng, float * dst, unsigned len);
 ///\endcode
 ///
+/// The array forms draw the random integers of each run of values at once,
+/// with rnd::uints, and transform them in loops the compiler vectorizes.
+///
 /// where "distr" is one of the following random number distributions:\n\n
 /// tri   - triangular distribution in [-1,1]
 /// add2  - sum of 2 uniform values (triangle) \n
@@ -187,7 +255,8 @@ namespace rnd{
 	template <class T> void name(T * dst, uint32_t len);\
 	template <class T> void name(T * dst, uint32_t len, T bound2, T bound1 = 0);\
 	template <class T> void name(T * dst, uint32_t len, T * src, uint32_t srcLen);\
-	template <class T> float name##_float(T & rng);
+	template <class T> float name##_float(T & rng);\
+	template <class RNG> void name##_float(RNG & rng, float * dst, unsigned len);
 	//template <class Tv, class Tr> Tv name(Tr & rng);
 
 	FUNCS(tri) FUNCS(add2) FUNCS(add2I) FUNCS(add3) FUNCS(binS) FUNCS(lin) FUNCS(mul2)
@@ -196,6 +265,26 @@ namespace rnd{
 	#undef FUNCS
 	#endif
 
+	/// Fill array with uniform random unsigned integers from a generator
+
+	/// This gives the same numbers as calling the generator n times.
+	/// Linear congruential generators are run as eight interleaved streams,
+	/// each jumping eight steps ahead of its last number, so that the compiler
+	/// maps the streams onto SIMD registers.
+	template <class RNG> void uints(RNG& rng, uint32_t * dst, unsigned n);
+	void uints(RNGLinCon& rng, uint32_t * dst, unsigned n);
+	void uints(RNGMulLinCon& rng, uint32_t * dst, unsigned n);
+	void uints(RNGCounter& rng, uint32_t * dst, unsigned n);
+
+	/// Fill array with standard normal random numbers
+
+	/// This uses the ziggurat method of Marsaglia and Tsang, "The Ziggurat
+	/// Method for Generating Random Variables" (2000). About 99% of values
+	/// take one random integer and a table lookup, in a loop over the array;
+	/// the rest are then fixed up one by one.
+	template <class RNG> void gaussian(RNG& rng, float * dst, unsigned len);
+	void gaussian(float * dst, uint32_t len);
+
 	/// Push current RNG state onto stack (stack size = 1).
 	
 	/// After pushing, the current RNG is seeded with 'seed' unless 'seed' = 0.
@@ -212,7 +301,7 @@ namespace rnd{
 	/// Returns value in [o, 2*o) quantized by q divisions.
 	template <class T> T quanOct(uint32_t q, T o);
 
-	/// Seed global PRNG. If seed is 0, then the system time (in seconds) is used.
+	/// Seed RNG of calling thread. If seed is 0, then a new random seed is used.
 	void seed(uint32_t value=0);
 
 	/// Randomly set a certain amount of elements to a value.
@@ -230,7 +319,17 @@ namespace rnd{
 	/// be passed in.
 	template <class T> uint32_t weighted(T * weights, uint32_t num, T weightsSum=(T)1);
 	
-	static RNGTaus gen(rnd::getSeed());	///< Shared RNG
+	/// Returns RNG of calling thread
+
+	/// Each thread has its own generator, seeded from getSeed() on first use,
+	/// so that functions using it can be called from many threads without
+	/// sharing state. A thread may seed its generator with seed().
+	inline RNGTaus& threadGen(){
+		thread_local RNGTaus g(getSeed());
+		return g;
+	}
+
+	static thread_local RNGTaus& gen = threadGen();	///< RNG of calling thread
 }
 
 
@@ -268,6 +367,50 @@ inline void RNGTaus::iterate(){
 }
 
 
+//---- RNGCounter
+
+inline RNGCounter& RNGCounter::seed(uint32_t sd, uint32_t strm){
+	mKey[0] = sd; mKey[1] = strm;
+	mPos = 0;
+	mBlock = ~uint64_t(0);
+	return *this;
+}
+
+inline void RNGCounter::operator=(uint32_t s){ seed(s, mKey[1]); }
+
+inline void RNGCounter::philox(uint32_t * out, const uint32_t * ctr, const uint32_t * key){
+	uint32_t c0 = ctr[0], c1 = ctr[1], c2 = ctr[2], c3 = ctr[3];
+	uint32_t k0 = key[0], k1 = key[1];
+	for(int r=0; r<10; ++r){
+		const uint64_t p0 = uint64_t(0xD2511F53) * c0;
+		const uint64_t p1 = uint64_t(0xCD9E8D57) * c2;
+		c0 = uint32_t(p1>>32) ^ c1 ^ k0;
+		c1 = uint32_t(p1);
+		c2 = uint32_t(p0>>32) ^ c3 ^ k1;
+		c3 = uint32_t(p0);
+		k0 += 0x9E3779B9; k1 += 0xBB67AE85;
+	}
+	out[0] = c0; out[1] = c1; out[2] = c2; out[3] = c3;
+}
+
+inline uint32_t RNGCounter::at(uint64_t i) const {
+	const uint32_t ctr[4] = { uint32_t(i>>2), uint32_t(i>>34), 0, 0 };
+	uint32_t out[4];
+	philox(out, ctr, mKey);
+	return out[i&3];
+}
+
+inline uint32_t RNGCounter::operator()(){
+	const uint64_t b = mPos>>2;
+	if(b != mBlock){
+		const uint32_t ctr[4] = { uint32_t(b), uint32_t(b>>32), 0, 0 };
+		philox(mBuf, ctr, mKey);
+		mBlock = b;
+	}
+	return mBuf[(mPos++)&3];
+}
+
+
 //---- rnd
 namespace rnd{
 
@@ -286,6 +429,57 @@ template <class T> inline float add2I_float(T & rng){
 }
 #undef R
 
+template <class RNG> inline void uints(RNG& rng, uint32_t * dst, unsigned n){
+	for(unsigned i=0; i<n; ++i) dst[i] = rng();
+}
+
+// Run x = x*mul + add as interleaved streams stepping a multiple of lanes
+inline void uintsLinCon(uint32_t& val, uint32_t mul, uint32_t add, uint32_t * dst, unsigned n){
+	enum{ L = 8 };
+	unsigned i = 0;
+	if(n >= 2*L){
+		uint32_t s[L], mulL = 1, addL = 0, v = val;
+		for(unsigned k=0; k<L; ++k){
+			s[k] = v = v*mul + add;
+			mulL *= mul;
+			addL = addL*mul + add;
+		}
+		for(; i+L<=n; i+=L){
+			for(unsigned k=0; k<L; ++k){
+				dst[i+k] = s[k];
+				s[k] = s[k]*mulL + addL;
+			}
+		}
+		val = dst[i-1];
+	}
+	for(; i<n; ++i) dst[i] = val = val*mul + add;
+}
+
+inline void uints(RNGLinCon& rng, uint32_t * dst, unsigned n){
+	uintsLinCon(rng.val, rng.mul, rng.add, dst, n);
+}
+
+inline void uints(RNGMulLinCon& rng, uint32_t * dst, unsigned n){
+	uintsLinCon(rng.val, rng.mul, 0, dst, n);
+}
+
+inline void uints(RNGCounter& rng, uint32_t * dst, unsigned n){
+	unsigned i = 0;
+
+	// Whole counters are written straight to the output
+	while(i<n && (rng.position()&3)) dst[i++] = rng();
+	if(n-i >= 4){
+		const uint32_t key[2] = { rng.seed(), rng.stream() };
+		uint64_t b = rng.position()>>2;
+		for(; i+4<=n; i+=4, ++b){
+			const uint32_t ctr[4] = { uint32_t(b), uint32_t(b>>32), 0, 0 };
+			RNGCounter::philox(dst+i, ctr, key);
+		}
+		rng.seek(b<<2);
+	}
+	for(; i<n; ++i) dst[i] = rng();
+}
+
 template <class T> inline float uni_float(T& rng){ return uintToUnit<float>(rng()); }
 template <class T> inline float uniS_float(T& rng){ return uintToUnitS<float>(rng()); }
 
@@ -294,6 +488,34 @@ template <class T> inline float binS_float(T & rng){
 	return punUF(r);
 }
 
+// Block forms of distributions; r points to the K random integers of a value
+#define U(k) uintToUnit<float>(r[k])
+#define DEF(fnc, K, expr)\
+	template <class RNG> inline void fnc##_float(RNG& rng, float * dst, unsigned n){\
+		uint32_t u[K*64];\
+		for(unsigned i=0; i<n; i+=64){\
+			const unsigned m = n-i < 64 ? n-i : 64;\
+			uints(rng, u, K*m);\
+			for(unsigned j=0; j<m; ++j){\
+				const uint32_t * r = u + K*j;\
+				dst[i+j] = expr;\
+			}\
+		}\
+	}
+	DEF(tri, 2, U(0) - U(1))
+	DEF(add2, 2, (U(0) + U(1)) * 0.5f)
+	DEF(add2I, 2, (U(0) + U(1)) * 0.5f < 0.5f ? (U(0) + U(1)) * 0.5f + 0.5f : (U(0) + U(1)) * 0.5f - 0.5f)
+	DEF(add3, 3, (U(0) + U(1) + U(2)) * 0.33333333333f)
+	DEF(lin, 2, U(0) < U(1) ? U(0) : U(1))
+	DEF(mul2, 2, U(0) * U(1))
+	DEF(pow2, 1, U(0) * U(0))
+	DEF(pow3, 1, U(0) * U(0) * U(0))
+	DEF(uni, 1, U(0))
+	DEF(uniS, 1, uintToUnitS<float>(r[0]))
+	DEF(binS, 1, punUF((r[0] & MaskSign<float>()) | Expo1<float>()))
+#undef DEF
+#undef U
+
 template <class T> inline T & cond(T& v, const T& va, const T& vb, float pab, float pba){
 	     if(v == va) v = pick(vb, va, pba);
 	else if(v == vb) v = pick(va, vb, pab);
@@ -316,6 +538,87 @@ float gaussian(RNG& rng = rnd::gen){
 	return y1;
 }
 
+// Tables of the 128 strips of the ziggurat of the normal density
+struct GaussianZiggurat{
+	uint32_t kn[128];	// magnitude limits of fast path
+	float wn[128];		// widths, per unit of magnitude
+	float fn[128];		// densities at strip edges
+
+	GaussianZiggurat(){
+		const double m1 = 2147483648.0, vn = 9.91256303526217e-3;
+		double dn = 3.442619855899, tn = dn;
+		const double q = vn / std::exp(-0.5*dn*dn);
+		kn[0] = uint32_t((dn/q)*m1); kn[1] = 0;
+		wn[0] = float(q/m1); wn[127] = float(dn/m1);
+		fn[0] = 1.f; fn[127] = float(std::exp(-0.5*dn*dn));
+		for(int i=126; i>=1; --i){
+			dn = std::sqrt(-2.*std::log(vn/dn + std::exp(-0.5*dn*dn)));
+			kn[i+1] = uint32_t((dn/tn)*m1);
+			tn = dn;
+			fn[i] = float(std::exp(-0.5*dn*dn));
+			wn[i] = float(dn/m1);
+		}
+	}
+
+	static const GaussianZiggurat& get(){
+		static const GaussianZiggurat z;
+		return z;
+	}
+
+	// Candidate from signed random integer, and whether it is accepted
+	float value(int32_t hz) const { return float(hz) * wn[hz & 127]; }
+	bool fast(int32_t hz) const {
+		const uint32_t a = hz < 0 ? uint32_t(-int64_t(hz)) : uint32_t(hz);
+		return a < kn[hz & 127];
+	}
+
+	// Value in (0,1), avoiding the logarithm of zero
+	template <class RNG>
+	static float open(RNG& rng){ return (float(rng()>>8) + 0.5f) * (1.f/16777216.f); }
+
+	// Value for a candidate rejected by the fast path
+	template <class RNG>
+	float fix(RNG& rng, int32_t hz) const {
+		const float r = 3.442620f; // start of the tail
+		for(;;){
+			const int iz = hz & 127;
+			const float x = value(hz);
+			if(0 == iz){
+				float xt, y;
+				do{
+					xt = -std::log(open(rng)) * 0.2904764f;
+					y = -std::log(open(rng));
+				} while(y+y < xt*xt);
+				return hz > 0 ? r+xt : -r-xt;
+			}
+			if(fn[iz] + open(rng)*(fn[iz-1] - fn[iz]) < std::exp(-0.5f*x*x)) return x;
+			hz = int32_t(rng());
+			if(fast(hz)) return value(hz);
+		}
+	}
+};
+
+template <class RNG> void gaussian(RNG& rng, float * dst, unsigned n){
+	const GaussianZiggurat& z = GaussianZiggurat::get();
+	uint32_t u[64];
+	for(unsigned i=0; i<n; i+=64){
+		const unsigned m = n-i < 64 ? n-i : 64;
+		uints(rng, u, m);
+		bool slow = false;
+		for(unsigned j=0; j<m; ++j){
+			dst[i+j] = z.value(int32_t(u[j]));
+			slow |= !z.fast(int32_t(u[j]));
+		}
+		if(slow){
+			for(unsigned j=0; j<m; ++j){
+				if(!z.fast(int32_t(u[j]))) dst[i+j] = z.fix(rng, int32_t(u[j]));
+			}
+		}
+	}
+}
+
+inline void gaussian(float * dst, uint32_t len){ gaussian(gen, dst, len); }
+
 template <class T> inline T geom(int n, T mul, T start, float p){
 	for(; n>0; --n){
 		if(prob(p)) break;
@@ -364,11 +667,21 @@ template <class T> inline T uniExc(const T& exc, const T& max, const T& min){
 		return b1 + T(fnc##_##rnd_t(gen) * (b2-b1));\
 	}\
 	template <class T> inline void fnc(T * dst, uint32_t len){\
-		LOOP(len){ dst[i] = (T) fnc##_##rnd_t(gen); }\
+		float r[64];\
+		for(uint32_t j=0; j<len; j+=64){\
+			const uint32_t m = len-j < 64 ? len-j : 64;\
+			fnc##_##rnd_t(gen, r, m);\
+			LOOP(m){ dst[j+i] = (T) r[i]; }\
+		}\
 	}\
 	template <class T> inline void fnc(T * dst, uint32_t len, T b2, T b1){\
 		T df = b2 - b1;\
-		LOOP(len){ dst[i] = b1 + T(fnc##_##rnd_t(gen) * df); }\
+		float r[64];\
+		for(uint32_t j=0; j<len; j+=64){\
+			const uint32_t m = len-j < 64 ? len-j : 64;\
+			fnc##_##rnd_t(gen, r, m);\
+			LOOP(m){ dst[j+i] = b1 + T(r[i] * df); }\
+		}\
 	}\
 	template <class T> inline void fnc(T * dst, uint32_t len, T * src, uint32_t srcLen){\
 		LOOP(len){ dst[i] = src[rnd::fnc(srcLen)]; }\
@@ -381,7 +694,7 @@ template <class T> inline T uniExc(const T& exc, const T& max, const T& min){
 #undef LOOP
 
 namespace{
-	static uint32_t mSeedPush[4];
+	static thread_local uint32_t mSeedPush[4];
 }
 
 inline void push(uint32_t seedA){
@@ -174,6 +174,13 @@ uint32_t log2(uint32_t v);
 /// Fast base-2 logarithm. For value <= 0, behavior is undefined.
 float log2Fast(float v);
 
+/// Fast base-2 exponential, the inverse of log2Fast
+
+/// The fraction of the argument is mapped linearly onto the mantissa, so
+/// the relative error is under 6.2% and pow2Fast(log2Fast(v)) equals v to
+/// within rounding. The argument is clamped to [-126, 127].
+float pow2Fast(float v);
+
 /// Maps value from [-1,1] to [depth, 1].
 template<class T>
 T mapDepth(T v, T depth){ return (v - T(1)) * T(0.5) * depth + T(1);  }
@@ -458,6 +465,30 @@ template<class T> T welch(T nphase);									///< Welch window function. nphase
 
 
 
+//---- ARRAY FUNCTIONS
+
+// These apply the scalar approximations above to arrays, with the same input
+// domains and accuracy. The loops are branch-free so that they vectorize;
+// on x86-64 Linux with GCC, AVX2 versions are also compiled and selected at
+// load time. The destination may equal the source.
+
+void sinFast(float * dst, const float * src, unsigned len);	///< Array version of sinFast
+void sinP7(float * dst, const float * src, unsigned len);	///< Array version of sinP7
+void sinP9(float * dst, const float * src, unsigned len);	///< Array version of sinP9
+void cosP3(float * dst, const float * src, unsigned len);	///< Array version of cosP3
+void log2Fast(float * dst, const float * src, unsigned len);	///< Array version of log2Fast
+void pow2Fast(float * dst, const float * src, unsigned len);	///< Array version of pow2Fast
+
+/// Array version of atan2Fast
+
+/// \param[out] dst		destination; may equal y or x
+/// \param[in]  y		ordinates
+/// \param[in]  x		abscissas
+/// \param[in]  len		number of values
+void atan2Fast(float * dst, const float * y, const float * x, unsigned len);
+
+
+
 //---- NOTE-BASED FUNCTIONS
 
 /// Returns frequency in Hz from a 12-TET note string.
@@ -614,6 +645,12 @@ inline float log2Fast(float v){
 	return (float)((u.i - int32_t(Expo1<float>()))) * 0.0000001192092896f;// / 8388608.f;
 }
 
+inline float pow2Fast(float v){
+	v = v < -126.f ? -126.f : (v > 127.f ? 127.f : v);
+	Twiddle<float> u(int32_t(v * 8388608.f) + int32_t(Expo1<float>()));
+	return u.f;
+}
+
 template<class T> inline T mapInvPow2(T v){ return v*(T(2)-v); }
 
 template<class T>
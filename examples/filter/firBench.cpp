@@ -0,0 +1,64 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+Example:	FIR Benchmark
+Author:		Gamma contributors, 2026
+
+Description:
+This times an FIR filter on kernels of increasing length using the direct
+form alone and using the FFT path with the best head length. It prints the
+kernel length above which the FFT path is faster; passing this length as the
+threshold to FIR gives the fastest filter on this machine.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Gamma/Convolver.h"
+#include "Gamma/Timer.h"
+using namespace gam;
+
+// Seconds to filter 'len' samples in blocks of B with a kernel of L taps
+double timeFIR(unsigned L, unsigned threshold, unsigned B, unsigned len){
+	std::vector<float> h(L), buf(B);
+	for(unsigned i=0; i<L; ++i) h[i] = std::sin(i*0.37f) * std::exp(-3.f*i/L);
+	FIR fir(L, threshold);
+	fir.kernel(&h[0], L);
+	nsec_t t0 = timeNow();
+	for(unsigned n=0; n<len; n+=B){
+		for(unsigned i=0; i<B; ++i) buf[i] = std::sin((n+i)*0.01f);
+		fir(&buf[0], &buf[0], B);
+	}
+	return toSec(timeNow() - t0);
+}
+
+int main(){
+
+	const unsigned B = 64;				// Audio block size
+	const unsigned len = 48000*5;		// 5 s of audio
+	unsigned crossover = 0;
+
+	printf("Block size %u, %u samples per kernel\n", B, len);
+	printf("%8s %10s %10s %6s\n", "taps", "direct", "FFT", "head");
+
+	for(unsigned L=16; L<=4096; L*=2){
+		for(unsigned l=L; l<2*L && l<=4096; l+=L/2){
+			double tDirect = timeFIR(l, l, B, len);
+
+			// Try every power-of-two head shorter than the kernel
+			double tFFT = 1e9;
+			unsigned bestHead = 0;
+			for(unsigned head=16; head<l; head*=2){
+				double t = timeFIR(l, head, B, len);
+				if(t < tFFT){ tFFT = t; bestHead = head; }
+			}
+
+			if(bestHead) printf("%8u %10.4f %10.4f %6u\n", l, tDirect, tFFT, bestHead);
+			else printf("%8u %10.4f %10s %6s\n", l, tDirect, "-", "-");
+			if(!crossover && tFFT < tDirect) crossover = l;
+		}
+	}
+
+	if(crossover) printf("FFT path is faster from %u taps\n", crossover);
+	else printf("Direct form is faster for all kernel lengths tested\n");
+}
@@ -0,0 +1,93 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+Example:	Filter Glide Benchmark
+Author:		Gamma contributors, 2026
+
+Description:
+This times the formant filter bank of synthesis/subtractiveSing.cpp with its
+center frequencies following a smoothed vowel sequence. The first run sets
+the frequencies of the biquads every sample; the others glide the filters to
+new frequencies once per control block, which only ramps coefficients, and
+also run the glide through the block filter method. It prints the time of
+each and the largest difference from the per-sample output.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Gamma/Domain.h"
+#include "Gamma/Filter.h"
+#include "Gamma/FormantData.h"
+#include "Gamma/Timer.h"
+using namespace gam;
+
+enum{ N = 3 };							// Number of formants
+const unsigned B = 32;					// Control block size
+const unsigned len = 48000*10;			// 10 s of audio
+
+// Target formant frequencies, changing vowel every half second
+float target(unsigned i, unsigned k){
+	int v = (i / 24000) % Vowel::NUM_PHONEMES;
+	return Vowel::freq(Vowel::WOMAN, Vowel::Phoneme(v), k);
+}
+
+// Filter a pulse train; mode 0 sets frequencies every sample, mode 1 glides
+// per sample and mode 2 glides through the block method
+double run(int mode, std::vector<float>& out){
+	Biquad<> filters[N];
+	OnePole<> smooth[N];
+	for(int k=0; k<N; ++k){
+		filters[k].set(target(0,k), 1./0.08, BAND_PASS);
+		smooth[k].lag(0.1);
+		smooth[k].reset(target(0,k));
+	}
+	float src[B], tmp[B];
+
+	nsec_t t0 = timeNow();
+	for(unsigned n=0; n<len; n+=B){
+		for(unsigned i=0; i<B; ++i){ src[i] = ((n+i) % 200) ? 0.f : 1.f; out[n+i] = 0.f; }
+		for(int k=0; k<N; ++k){
+			smooth[k] = target(n,k);
+			if(mode == 0){
+				for(unsigned i=0; i<B; ++i){
+					filters[k].freq(smooth[k]());
+					out[n+i] += filters[k](src[i]);
+				}
+			}
+			else{
+				float f = 0;
+				for(unsigned i=0; i<B; ++i) f = smooth[k]();
+				filters[k].freq(f, B);
+				if(mode == 1){
+					for(unsigned i=0; i<B; ++i) out[n+i] += filters[k](src[i]);
+				}
+				else{
+					filters[k](tmp, src, B);
+					for(unsigned i=0; i<B; ++i) out[n+i] += tmp[i];
+				}
+			}
+		}
+	}
+	return toSec(timeNow() - t0);
+}
+
+int main(){
+	Domain::master().spu(48000);
+
+	std::vector<float> ref(len), out(len);
+	double tSet = run(0, ref);
+	printf("%-28s %8.4f s\n", "freq() every sample", tSet);
+
+	const char * names[] = {"", "glide, per sample", "glide, block"};
+	for(int mode=1; mode<=2; ++mode){
+		double t = run(mode, out);
+		double err = 0, peak = 0;
+		for(unsigned i=0; i<len; ++i){
+			err = std::max(err, double(std::fabs(out[i]-ref[i])));
+			peak = std::max(peak, double(std::fabs(ref[i])));
+		}
+		printf("%-28s %8.4f s (%.1fx), max diff %.2g of peak\n", names[mode], t, tSet/t, err/peak);
+	}
+}
@@ -0,0 +1,91 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+Example:	Higher-order Ambisonics
+Author:		Gamma contributors, 2026
+
+Description:
+This encodes a group of sources moving around the listener into a third-order
+Ambisonics bus and decodes the bus to a ring of speakers. The cost of the
+encoder grows with the number of sources and that of the decoder with the
+number of speakers, so many sources can be played over many speakers.
+*/
+
+#include "../AudioApp.h"
+#include "Gamma/Ambisonics.h"
+#include "Gamma/Oscillator.h"
+using namespace gam;
+
+class MyApp : public AudioApp{
+public:
+
+	static const int Nsrc = 16;	// Number of sources
+	static const int Nspk = 2;	// Number of speakers, on a ring around listener
+	static const int Nch = 16;	// Number of bus channels at third order
+
+	SineD<> srcs[Nsrc];			// Decaying sine wave grains
+	Accum<> tmr;				// Timer for firing grains
+	unsigned seed;				// RNG seed
+	float angle;				// Angle of source group
+	AmbiEncoder encoder;
+	AmbiDecoder decoder;
+	std::vector<float> in, bus, out;
+
+	MyApp()
+	:	seed(1), angle(0), encoder(3, Nsrc), decoder(3, Nspk)
+	{
+		initAudio(44100, 128, Nspk);
+		tmr.freq(8);
+
+		// Place speakers on a ring at ear height, starting at the left
+		for(int i=0; i<Nspk; ++i){
+			float a = M_PI/2 - 2*M_PI*i/Nspk;
+			decoder.speaker(i, std::cos(a), std::sin(a), 0);
+		}
+
+		// Narrow the spread of sources between the speakers
+		decoder.maxRE(true);
+	}
+
+	void onAudio(AudioIOData& io){
+		const int N = io.framesPerBuffer();
+		in.resize(Nsrc*N); bus.assign(Nch*N, 0.f); out.resize(Nspk*N);
+
+		const float * inputs[Nsrc];
+		float * channels[Nch];
+		float * speakers[Nspk];
+		for(int j=0; j<Nsrc; ++j) inputs[j] = &in[j*N];
+		for(int c=0; c<Nch; ++c) channels[c] = &bus[c*N];
+		for(int l=0; l<Nspk; ++l) speakers[l] = &out[l*N];
+
+		for(int i=0; i<N; ++i){
+			// Trigger a new random grain on a timer
+			if(tmr()){
+				seed *= 69069;
+				float f = (seed>>20) + 200;
+				srcs[seed%Nsrc].set(f, 0.2, 0.5);
+			}
+			for(int j=0; j<Nsrc; ++j) in[j*N + i] = srcs[j]();
+		}
+
+		// Spread sources over a spiral turning slowly around the listener
+		angle += 0.2 * N / io.framesPerSecond();
+		for(int j=0; j<Nsrc; ++j){
+			float a = angle + 2*M_PI*j/Nsrc;
+			float z = float(j)/Nsrc - 0.5;
+			encoder.dir(j, std::cos(a), std::sin(a), z);
+		}
+
+		encoder.process(inputs, channels, N);
+		decoder.process(channels, speakers, N);
+
+		while(io()){
+			int i = io.frame();
+			for(int l=0; l<Nspk; ++l) io.out(l) = out[l*N + i];
+		}
+	}
+};
+
+int main(){
+	MyApp().start();
+}
@@ -0,0 +1,77 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+	
+Example:	Feedback Delay Network Reverb
+Author:		Gamma contributors, 2026
+
+Description:
+This demonstrates a feedback delay network (FDN) reverberator. Several delay
+lines feed each other through an orthogonal matrix, which builds up a dense
+tail quickly. The reverb is run a whole buffer at a time, which is much faster
+than filtering one sample at a time.
+*/
+
+#include "../AudioApp.h"
+#include "Gamma/Oscillator.h"
+#include "Gamma/Spatial.h"
+using namespace gam;
+
+class MyApp : public AudioApp{
+public:
+
+	SineD<> src;		// Decaying sine wave grain
+	Accum<> tmr;		// Timer for firing grains
+	unsigned seed;		// RNG seed
+	ReverbFDN<float, 16> reverb; // 16-line feedback delay network
+	std::vector<float> dry, wetL, wetR;
+
+	MyApp(){
+		seed = 1;
+		tmr.period(2);
+		tmr.finish();
+
+		// Set range of delays, in seconds
+		reverb.delays(0.03, 0.11);
+
+		// Set decay length, in seconds
+		reverb.decay(6);
+
+		// Set high-frequency damping factor in [0, 1]
+		reverb.damping(0.3);
+
+		// Slowly sweep the delays by up to 0.5 ms to soften resonances
+		reverb.modulate(0.0005, 0.6);
+
+		//reverb.matrix(HOUSEHOLDER); // Sparser, slower building tail
+	}
+
+	void onAudio(AudioIOData& io){
+		const int N = io.framesPerBuffer();
+		dry.resize(N); wetL.resize(N); wetR.resize(N);
+
+		for(int i=0; i<N; ++i){
+
+			// Trigger a new random grain on a timer
+			if(tmr()){
+				seed *= 69069;
+				float f = (seed%4000) + 200;
+				src.set(f, 1, 16./f);				
+			}
+
+			dry[i] = src();
+		}
+
+		// Pass a whole buffer of grains through the reverberator
+		reverb.process(&dry[0], &wetL[0], &wetR[0], N);
+
+		while(io()){
+			int i = io.frame();
+			io.out(0) = dry[i] + wetL[i] * 0.2;
+			io.out(1) = dry[i] + wetR[i] * 0.2;
+		}
+	}
+};
+
+int main(){
+	MyApp().start();
+}
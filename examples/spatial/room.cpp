@@ -11,7 +11,8 @@ a third models the "walls" of the room.
 The late reverb is delayed and low-pass filtered according to the size of the 
 room. Assuming the sound and listener are both in the center of the room, then
 the minimum distance the echoes must travel is twice the distance to the nearest
-wall.
+wall. The early reflections off the walls, floor and ceiling are added by an
+image-source model of the room that follows the source a block at a time.
 */
 
 #include "../AudioApp.h"
@@ -27,6 +28,8 @@ public:
 	LFO<> pathx, pathy;		// Path of sound source in space
 	Dist<3> dist;			// Filters source at 3 destinations based on distance cues
 	ReverbMS<> reverb[2]; 	// One reverb for each ear
+	EarlyReflections early;	// Reflections of the room up to second order
+	std::vector<float> in, refl[2];
 
 	MyApp(){
 		play.load("../../sounds/count.wav");
@@ -44,6 +47,10 @@ public:
 			// High-frequency damping due to air absorption
 			reverb[i].damping(0.25);		
 		}
+
+		// The room is 32 m wide and deep and 8 m high and the listener is in
+		// the center, at ear height
+		early.room(32, 32, 8).listener(16, 16, 1.5).wallGain(0.7);
 	}
 
 	void onAudio(AudioIOData& io){
@@ -51,14 +58,19 @@ public:
 		// The second parameter is the diameter of the room
 		dist.dist(2, 32);
 
+		const int N = io.framesPerBuffer();
+		in.resize(N); refl[0].assign(N, 0.f); refl[1].assign(N, 0.f);
+		float x = 0, y = 0;
+
 		while(io()){
 
 			// Generate sound source sample
 			float s = play(); play.loop();
+			in[io.frame()] = s;
 
 			// Position of source w.r.t. origin
-			float x = pathx.cos()*16;
-			float y = pathy.cos()*16;
+			x = pathx.cos()*16;
+			y = pathy.cos()*16;
 
 			// Set distances from source to destinations (ears)
 			// The ears are set to be 20 cm apart---the average for a human head
@@ -83,6 +95,17 @@ public:
 			io.out(0) = ear[0];
 			io.out(1) = ear[1];
 		}
+
+		// Add the early reflections of the block. The paths of the source
+		// glide to its position at the end of the block.
+		early.pos(0, 16 + x, 16 + y, 1.5);
+		const float * src = &in[0];
+		early.process(&src, &refl[0][0], &refl[1][0], N);
+		io.frame(0);
+		while(io()){
+			io.out(0) += refl[0][io.frame()];
+			io.out(1) += refl[1][io.frame()];
+		}
 	}
 };
 
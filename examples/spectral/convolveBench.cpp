@@ -0,0 +1,62 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+Example:	Convolution Benchmark
+Author:		Gamma contributors, 2026
+
+Description:
+This compares the cost of convolving with a long impulse response using a
+uniformly partitioned Convolver and a NonUniformConvolver. The non-uniform
+convolver does most of its work on a background thread, so both the time
+spent on the audio (calling) thread and the total time are shown.
+*/
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "Gamma/Convolver.h"
+#include "Gamma/Timer.h"
+using namespace gam;
+
+int main(){
+
+	const unsigned B = 64;					// Audio block size
+	const unsigned L = 4 * 48000;			// Impulse response of 4 s at 48 kHz
+	const unsigned blocks = 48000*10 / B;	// 10 s of audio
+
+	std::vector<float> h(L), buf(B);
+	for(unsigned i=0; i<L; ++i) h[i] = std::sin(i*0.37f) * std::exp(-3.f*i/L);
+
+	Convolver uni(B, L);
+	NonUniformConvolver nonUni(B, L);
+	uni.ir(&h[0], L);
+	nonUni.ir(&h[0], L);
+
+	printf("Block size %u, IR %u samples, tail block %u\n", B, L, nonUni.tailBlockSize());
+
+	// Uniform: all work is on the calling thread
+	nsec_t t0 = timeNow();
+	for(unsigned b=0; b<blocks; ++b){
+		for(unsigned i=0; i<B; ++i) buf[i] = std::sin((b*B+i)*0.01f);
+		uni.process(&buf[0], &buf[0]);
+	}
+	double tUni = toSec(timeNow() - t0);
+
+	// Non-uniform: time the calling thread alone
+	double tAudio = 0;
+	t0 = timeNow();
+	for(unsigned b=0; b<blocks; ++b){
+		for(unsigned i=0; i<B; ++i) buf[i] = std::sin((b*B+i)*0.01f);
+		nsec_t t = timeNow();
+		nonUni.process(&buf[0], &buf[0]);
+		tAudio += toSec(timeNow() - t);
+	}
+	double tNonUni = toSec(timeNow() - t0);
+
+	printf("uniform:     %8.3f s\n", tUni);
+	printf("non-uniform: %8.3f s total, %8.3f s on audio thread, %u missed deadlines\n",
+		tNonUni, tAudio, nonUni.misses());
+	// Running faster than real time, the audio thread catches up with the
+	// background thread, so nearly every tail block is counted as missed
+	printf("audio is 10 s long\n");
+}
@@ -29,6 +29,12 @@ public:
 	:	stft(4096, 4096/4, 0, HANN, MAG_PHASE)
 	{
 		saw.freq(220);
+
+		// Bins with magnitudes less than the threshold are zeroed after each
+		// forward transform. The remaining, active bins are listed, and only
+		// they are converted to and from polar form. The assumption here is
+		// that noisy bins will have a relatively small magnitude.
+		stft.activeThreshold(0.0004);
 	}
 
 	void onAudio(AudioIOData& io){
@@ -38,18 +44,12 @@ public:
 
 			if(stft(s)){
 
-				for(unsigned k=0; k<stft.numBins(); ++k){
-
-					// Get the bin magnitude (the first bin element)
-					float mag = stft.bin(k)[0];
+				// Further processing need only visit the active bins
+				for(unsigned j=0; j<stft.numActiveBins(); ++j){
+					unsigned k = stft.activeBins()[j];
 
-					// If the bin magnitude is less than our threshold, then we
-					// zero its magnitude. The assumption here is that noisy bins
-					// will have a relatively small magnitude.
-					if(mag < 0.0004) stft.bin(k)[0] = 0;
-				
-					// If we flip the comparison, then we keep only the noise.
-					//if(mag > 0.0001) stft.bin(k)[0] = 0;
+					// Soften the magnitude (the first bin element)
+					stft.bin(k)[0] *= 0.9;
 				}
 			}
 		
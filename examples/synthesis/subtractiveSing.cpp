@@ -21,13 +21,20 @@ using namespace gam;
 
 struct VowelFilter{
 
-	VowelFilter(){ params.lag(1); }
+	VowelFilter(): count(0){ params.lag(1); }
 
 	float operator()(float v){
 		Vec<N*2, float> frqAmp = params();
+
+		// Glide filters to the smoothed frequencies once per control block
+		// rather than computing their coefficients every sample
+		if(0 == count){
+			for(int i=0; i<N; ++i) filters[i].freq(frqAmp[2*i+0], BLOCK);
+		}
+		count = (count+1) % BLOCK;
+
 		float r=0;
 		for(int i=0; i<N; ++i){
-			filters[i].freq(frqAmp[2*i+0]);
 			r += filters[i](v)*frqAmp[2*i+1];
 		}
 		return r;
@@ -42,9 +49,10 @@ struct VowelFilter{
 	
 	int size() const { return N; }
 	
-	enum{N=3};
+	enum{N=3, BLOCK=32};
 	Biquad<> filters[N];
 	OnePole<Vec<N*2, float> > params; // array of (cfreq, amp) pairs
+	int count;
 };
 
 class MyApp : public AudioApp{
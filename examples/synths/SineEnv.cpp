@@ -5,61 +5,7 @@
 	Description:	
 */
 
-#include "examples.h"
-
-class SineEnv : public Process<AudioIOData> {
-public:
-
-	SineEnv(double startTime=0)
-	{
-		dt(startTime);
-		set (6.5, 260, 0.3, 1, 2);
-		mAmpEnv.curve(0); // make segments lines
-		mAmpEnv.levels(0,1,1,0);
-	}
-
-	SineEnv& freq(float v){ mOsc.freq(v); return *this; }
-	SineEnv& amp(float v){ mAmp=v; return *this; }
-	SineEnv& attack(float v){
-		mAmpEnv.lengths()[0] = v;
-		return *this;
-	}
-	SineEnv& decay(float v){
-		mAmpEnv.lengths()[2] = v;
-		return *this;
-	}
-	SineEnv& dur(float v){ mDur=v; return *this; }
-	SineEnv& pan(float v){ mPan.pos(v); return *this; }
-	SineEnv& set(
-		float a, float b, float c, float d, float e, float f=0
-	){
-		return dur(a).freq(b).amp(c).attack(d).decay(e).pan(f);
-	}
-
-	//
-	void onProcess(AudioIOData& io){
-
-		mAmpEnv.totalLength(mDur, 1);
-
-		while(io()){
-			float s1 = mOsc() * mAmpEnv() * mAmp;
-			float s2;
-			mPan(s1, s1,s2);
-			io.out(0) += s1;
-			io.out(1) += s2;
-		}
-		if(mAmpEnv.done()) free();
-	}
-
-protected:
-	float mAmp;
-	float mDur;
-	Pan<> mPan;
-	Sine<> mOsc;
-	Env<3> mAmpEnv;
-};
-
-
+#include "SineEnv.h"
 
 int main(){
 
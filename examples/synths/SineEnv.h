@@ -0,0 +1,69 @@
+#ifndef GAMMA_EXAMPLES_SYNTHS_SINEENV_H_INC
+#define GAMMA_EXAMPLES_SYNTHS_SINEENV_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	Instrument of SineEnv.cpp, shared with tests/stressVoices.cpp
+*/
+
+#include "examples.h"
+
+class SineEnv : public Process<AudioIOData> {
+public:
+
+	SineEnv(double startTime=0)
+	{
+		dt(startTime);
+		set (6.5, 260, 0.3, 1, 2);
+		mAmpEnv.curve(0); // make segments lines
+		mAmpEnv.levels(0,1,1,0);
+
+		// Free the voice once its envelope is done
+		idleWhenDone(mAmpEnv);
+	}
+
+	SineEnv& freq(float v){ mOsc.freq(v); return *this; }
+	SineEnv& amp(float v){ mAmp=v; return *this; }
+	SineEnv& attack(float v){
+		mAmpEnv.lengths()[0] = v;
+		return *this;
+	}
+	SineEnv& decay(float v){
+		mAmpEnv.lengths()[2] = v;
+		return *this;
+	}
+	SineEnv& dur(float v){ mDur=v; return *this; }
+	SineEnv& pan(float v){ mPan.pos(v); return *this; }
+	SineEnv& set(
+		float a, float b, float c, float d, float e, float f=0
+	){
+		return dur(a).freq(b).amp(c).attack(d).decay(e).pan(f);
+	}
+
+	// Restart the envelope when reused by a VoicePool
+	void onReset(){ mAmpEnv.reset(); }
+
+	//
+	void onProcess(AudioIOData& io){
+
+		mAmpEnv.totalLength(mDur, 1);
+
+		while(io()){
+			float s1 = mOsc() * mAmpEnv() * mAmp;
+			float s2;
+			mPan(s1, s1,s2);
+			io.out(0) += s1;
+			io.out(1) += s2;
+		}
+	}
+
+protected:
+	float mAmp;
+	float mDur;
+	Pan<> mPan;
+	Sine<> mOsc;
+	Env<3> mAmpEnv;
+};
+
+#endif
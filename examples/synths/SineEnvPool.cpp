@@ -0,0 +1,34 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+	
+	Example:		Voice pool
+	Description:	Plays an arpeggio faster than its notes decay using a
+					fixed pool of SineEnv voices. Once all voices are
+					playing, each new note steals the oldest one, so no
+					memory is allocated and the graph does not change.
+*/
+
+#include <cmath>
+#include "SineEnv.h"
+
+int main(){
+
+	Scheduler s;
+	typedef VoicePool<SineEnv, 16> Voices;
+	Voices voices(s, Voices::STEAL_OLDEST);
+
+	// Notes are started from a function run by the audio thread
+	unsigned step = 0;
+	s.add([&]{
+		static const float intervals[] = {0, 3, 7, 10, 12, 15, 19, 22};
+		float key = 48 + intervals[step % 8] + 12*((step/8) % 2);
+		++step;
+		voices.noteOn(key)->set(1.5, 440*std::pow(2., (key-69)/12.), 0.1, 0.01, 1);
+	}, 0, 0.08);
+
+	AudioIO io(256, 44100., Scheduler::audioCB, &s);
+	gam::sampleRate(io.fps());
+	io.start();
+	printf("\nPress 'enter' to quit...\n"); getchar();
+	printf("%u of %u notes stole a voice\n", voices.steals(), step);
+}
@@ -0,0 +1,68 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+	
+Example:	Grain Cloud
+
+Description:
+A dense cloud of several thousand grains read from a few seconds of a
+synthesized tone. Onsets are drawn from a Poisson process and placed at
+their exact sample within each block.
+*/
+#include <cmath>
+#include <vector>
+#include "../AudioApp.h"
+#include "Gamma/Granular.h"
+#include "Gamma/Oscillator.h"
+#include "Gamma/rnd.h"
+using namespace gam;
+
+class MyApp : public AudioApp{
+public:
+
+	std::vector<float> buf;
+	GrainCloud cloud;
+	float scan;			// source position scanned, in [0, 1)
+	float density;		// grains per second
+
+	MyApp(): cloud(8192), scan(0), density(20000)
+	{
+		// Source: a buzz gliding over an octave
+		buf.resize(44100*4);
+		Buzz<> src(110, 0, 16);
+		for(unsigned i=0; i<buf.size(); ++i){
+			src.freq(110 * (1 + float(i)/buf.size()));
+			buf[i] = src();
+		}
+		cloud.source(&buf[0], buf.size());
+	}
+
+	void onAudio(AudioIOData& io){
+		const unsigned n = io.framesPerBuffer();
+
+		// Expected onsets this block, spread uniformly
+		float expected = density * n / io.framesPerSecond();
+		unsigned count = unsigned(expected);
+		if(rnd::prob(expected - count)) ++count;
+
+		// Scan forward and back through the source every 30 seconds
+		scan += n / (30 * io.framesPerSecond());
+		if(scan >= 1) scan -= 1;
+		float center = (1 - std::fabs(2*scan - 1)) * (buf.size() - 44100);
+		for(unsigned i=0; i<count; ++i){
+			cloud.grain(
+				center + rnd::uni(22050.f),			// position
+				rnd::uni(0.3f, 0.1f),				// duration
+				rnd::pick(1.f, 0.5f) * rnd::uni(1.01f, 0.99f), // rate
+				0.004,								// amplitude
+				rnd::uniS(1.f),						// pan
+				rnd::uni(n)							// onset in block
+			);
+		}
+
+		cloud.render(io.outBuffer(0), io.outBuffer(1), n);
+	}
+};
+
+int main(){
+	MyApp().start();
+}
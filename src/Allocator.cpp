@@ -0,0 +1,196 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cstdint>
+#include <cstring>
+#include "Gamma/Allocator.h"
+
+#if defined(__unix__) || defined(__APPLE__)
+	#include <sys/mman.h>
+	#define GAM_ALLOCATOR_MMAP
+	#if !defined(MAP_ANONYMOUS) && defined(MAP_ANON)
+		#define MAP_ANONYMOUS MAP_ANON
+	#endif
+#endif
+
+namespace gam{
+
+namespace{
+	// Stored just before each aligned block
+	struct Header{
+		void * base;			// start of allocation
+		std::size_t mapped;		// bytes mapped from system or 0 if from heap
+		std::size_t bytes;		// bytes requested
+		unsigned tag;			// memory tag ID or 0 if not recorded
+	};
+
+	char * alignUp(char * p, std::size_t align){
+		const std::uintptr_t a = reinterpret_cast<std::uintptr_t>(p);
+		return p + (((a + align-1) & ~std::uintptr_t(align-1)) - a);
+	}
+
+	// Statistics of a tag. Tags are found by open addressing on a hash of
+	// their name and are never removed, so recording never locks.
+	struct TagSlot{
+		std::atomic<const char *> tag;
+		std::atomic<unsigned long long> allocs, frees, bytes;
+		std::atomic<long long> live, peak;
+	};
+
+	enum{ NUM_SLOTS = GAM_MEMORY_TAGS };
+	TagSlot gSlots[NUM_SLOTS];
+	const char * const cUntagged = "untagged";
+	const char * const cOther = "(other)";	// tags that did not fit
+
+	unsigned hash(const char * s){
+		unsigned h = 2166136261u;
+		for(; *s; ++s) h = (h ^ (unsigned char)*s) * 16777619u;
+		return h;
+	}
+
+	// Get ID (slot + 1) of a tag, adding it if new
+	unsigned tagID(const char * name){
+		const unsigned last = NUM_SLOTS-1; // reserved for cOther
+		unsigned i = hash(name) % last;
+		for(unsigned n=0; n<last; ++n, i = (i+1) % last){
+			const char * t = gSlots[i].tag.load(std::memory_order_acquire);
+			if(!t){
+				if(gSlots[i].tag.compare_exchange_strong(t, name, std::memory_order_acq_rel)) return i+1;
+			}
+			if(t == name || 0 == std::strcmp(t, name)) return i+1;
+		}
+		gSlots[last].tag.store(cOther, std::memory_order_relaxed);
+		return last+1;
+	}
+
+	int findSlot(const char * name){
+		for(unsigned i=0; i<NUM_SLOTS; ++i){
+			const char * t = gSlots[i].tag.load(std::memory_order_acquire);
+			if(t && 0 == std::strcmp(t, name)) return i;
+		}
+		return -1;
+	}
+
+	MemoryStats statsOf(unsigned i){
+		const TagSlot& s = gSlots[i];
+		MemoryStats r = {
+			s.tag.load(std::memory_order_acquire),
+			s.allocs.load(std::memory_order_relaxed), s.frees.load(std::memory_order_relaxed),
+			s.bytes.load(std::memory_order_relaxed),
+			s.live.load(std::memory_order_relaxed), s.peak.load(std::memory_order_relaxed)
+		};
+		return r;
+	}
+}
+
+
+void memoryTrackingStart(){ memoryTrackingState().store(true, std::memory_order_relaxed); }
+
+void memoryTrackingStop(){ memoryTrackingState().store(false, std::memory_order_relaxed); }
+
+void memoryTrackingClear(){
+	for(unsigned i=0; i<NUM_SLOTS; ++i){
+		TagSlot& s = gSlots[i];
+		s.allocs = 0; s.frees = 0; s.bytes = 0; s.live = 0; s.peak = 0;
+	}
+}
+
+unsigned memoryRecordAlloc(std::size_t bytes){
+	const char * name = MemoryTag::current();
+	const unsigned id = tagID(name ? name : cUntagged);
+	TagSlot& s = gSlots[id-1];
+	s.allocs.fetch_add(1, std::memory_order_relaxed);
+	s.bytes.fetch_add(bytes, std::memory_order_relaxed);
+	const long long live = s.live.fetch_add(bytes, std::memory_order_relaxed) + (long long)bytes;
+	long long p = s.peak.load(std::memory_order_relaxed);
+	while(live > p && !s.peak.compare_exchange_weak(p, live, std::memory_order_relaxed)){}
+	return id;
+}
+
+void memoryRecordFree(unsigned id, std::size_t bytes){
+	if(!id || id > NUM_SLOTS) return;
+	TagSlot& s = gSlots[id-1];
+	s.frees.fetch_add(1, std::memory_order_relaxed);
+	s.live.fetch_sub(bytes, std::memory_order_relaxed);
+}
+
+void memoryRecordFree(std::size_t bytes){
+	if(!memoryTracking()) return;
+	const char * name = MemoryTag::current();
+	memoryRecordFree(tagID(name ? name : cUntagged), bytes);
+}
+
+unsigned memoryStats(MemoryStats * stats, unsigned max){
+	unsigned n = 0;
+	for(unsigned i=0; i<NUM_SLOTS && n<max; ++i){
+		const MemoryStats r = statsOf(i);
+		if(r.tag && (r.allocations || r.deallocations)) stats[n++] = r;
+	}
+	return n;
+}
+
+MemoryStats memoryStats(const char * tag){
+	const int i = findSlot(tag);
+	if(i >= 0) return statsOf(i);
+	const MemoryStats r = {tag, 0, 0, 0, 0, 0};
+	return r;
+}
+
+void memoryReport(FILE * fp){
+	MemoryStats stats[NUM_SLOTS];
+	const unsigned n = memoryStats(stats, NUM_SLOTS);
+	fprintf(fp, "%-24s %12s %12s %14s %14s %14s\n", "tag", "allocs", "frees", "bytes", "live", "peak");
+	for(unsigned i=0; i<n; ++i){
+		const MemoryStats& s = stats[i];
+		fprintf(fp, "%-24s %12llu %12llu %14llu %14lld %14lld\n",
+			s.tag, s.allocations, s.deallocations, s.bytes, s.live, s.peak);
+	}
+}
+
+std::size_t hugePageSize(){ return std::size_t(2)<<20; }
+
+void * allocAligned(std::size_t bytes, std::size_t align, bool hugePages){
+	if(align < alignof(std::max_align_t)) align = alignof(std::max_align_t);
+	const std::size_t len = bytes + align + sizeof(Header);
+	Header h = { 0, 0, bytes, 0 };
+
+	#ifdef GAM_ALLOCATOR_MMAP
+	if(hugePages && bytes >= hugePageSize()){
+		void * m = mmap(0, len, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if(m != MAP_FAILED){
+			#ifdef MADV_HUGEPAGE
+			madvise(m, len, MADV_HUGEPAGE);
+			#endif
+			h.base = m;
+			h.mapped = len;
+		}
+	}
+	#else
+	(void)hugePages;
+	#endif
+
+	if(!h.base){
+		h.base = ::operator new(len, std::nothrow);
+		if(!h.base) return 0;
+	}
+
+	if(memoryTracking()) h.tag = memoryRecordAlloc(bytes);
+	char * p = alignUp(static_cast<char *>(h.base) + sizeof(Header), align);
+	reinterpret_cast<Header *>(p)[-1] = h;
+	return p;
+}
+
+void freeAligned(void * p){
+	if(!p) return;
+	const Header h = static_cast<Header *>(p)[-1];
+	memoryRecordFree(h.tag, h.bytes);
+	#ifdef GAM_ALLOCATOR_MMAP
+	if(h.mapped){
+		munmap(h.base, h.mapped);
+		return;
+	}
+	#endif
+	::operator delete(h.base);
+}
+
+} // gam::
@@ -0,0 +1,337 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm> // swap
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/Ambisonics.h"
+
+namespace gam{
+
+/*
+The harmonics are evaluated from the direction vector without trig
+functions. With r = (x, y, z) of unit length, (x + iy)^m gives cos(m phi) and
+sin(m phi) scaled by cos(theta)^m, which is the factor the associated
+Legendre functions have in common, so only the polynomial parts in z are
+left, and these follow the usual recurrence over the degree. There is no
+Condon-Shortley phase, as is the convention in Ambisonics.
+*/
+void sphericalHarmonics(float * Y, unsigned order, float x, float y, float z){
+	const unsigned N = order;
+	for(unsigned c=0; c<ambiChannels(N); ++c) Y[c] = 0.f;
+	Y[0] = 1.f;
+
+	double r = std::sqrt(double(x)*x + double(y)*y + double(z)*z);
+	if(r <= 0.) return;
+	const double X = x/r, Yv = y/r, Z = z/r;
+
+	double cm = 1, sm = 0;	// (x + iy)^m
+	double qmm = 1;			// (2m-1)!!
+	for(unsigned m=0; m<=N; ++m){
+		if(m){
+			const double c = cm*X - sm*Yv;
+			sm = sm*X + cm*Yv;
+			cm = c;
+			qmm *= 2*m - 1;
+		}
+
+		// Q_n^m for n = m, m+1, ...
+		double q2 = 0, q1 = qmm;
+		double norm = m ? 2 : 1;	// (2 - delta_m) (n-m)!/(n+m)! for n = m
+		for(unsigned k=2; k<=2*m; ++k) norm /= k;
+		for(unsigned n=m; n<=N; ++n){
+			if(n > m){
+				const double q = ((2*n - 1)*Z*q1 - (n + m - 1)*q2) / (n - m);
+				q2 = q1; q1 = q;
+				norm *= double(n - m) / (n + m);
+			}
+			const double a = std::sqrt(norm) * q1;
+			Y[n*n + n + m] = float(a * cm);
+			if(m) Y[n*n + n - m] = float(a * sm);
+		}
+	}
+}
+
+
+namespace{
+
+	// Add gains times inputs to a buffer, gains moving by d per sample
+	template <unsigned K>
+	void mixGlide(float * dst, const float * const * src, const float * g, const float * d, unsigned n){
+		const float * x[K]; float g0[K], d0[K];
+		for(unsigned k=0; k<K; ++k){ x[k] = src[k]; g0[k] = g[k]; d0[k] = d[k]; }
+		for(unsigned i=0; i<n; ++i){
+			const float t = float(i+1);
+			float s = dst[i];
+			for(unsigned k=0; k<K; ++k) s += (g0[k] + d0[k]*t) * x[k][i];
+			dst[i] = s;
+		}
+	}
+
+	// Add or write gains times inputs to a buffer
+	template <unsigned K>
+	void mix(float * dst, const float * const * src, const float * g, unsigned n, bool add){
+		const float * x[K]; float g0[K];
+		for(unsigned k=0; k<K; ++k){ x[k] = src[k]; g0[k] = g[k]; }
+		if(add){
+			for(unsigned i=0; i<n; ++i){
+				float s = dst[i];
+				for(unsigned k=0; k<K; ++k) s += g0[k] * x[k][i];
+				dst[i] = s;
+			}
+		}
+		else{
+			for(unsigned i=0; i<n; ++i){
+				float s = 0.f;
+				for(unsigned k=0; k<K; ++k) s += g0[k] * x[k][i];
+				dst[i] = s;
+			}
+		}
+	}
+
+	// Legendre polynomial of degree n
+	double legendre(unsigned n, double x){
+		double p0 = 1, p1 = x;
+		if(!n) return p0;
+		for(unsigned k=2; k<=n; ++k){
+			const double p = ((2*k - 1)*x*p1 - (k - 1)*p0) / k;
+			p0 = p1; p1 = p;
+		}
+		return p1;
+	}
+
+	// Get degree of a channel
+	unsigned degree(unsigned ch){
+		unsigned n = 0;
+		while((n+1)*(n+1) <= ch) ++n;
+		return n;
+	}
+}
+
+
+//---- AmbiEncoder
+AmbiEncoder::AmbiEncoder(unsigned ord, unsigned numSrc)
+:	mOrder(ord), mNumSrc(0)
+{
+	numSources(numSrc);
+}
+
+AmbiEncoder& AmbiEncoder::order(unsigned v){
+	mOrder = v;
+	const unsigned C = channels();
+	mGain.resize(mNumSrc*C); mTarget.resize(mNumSrc*C);
+	for(unsigned i=0; i<mNumSrc; ++i){
+		const float * d = &mDir[3*i];
+		sphericalHarmonics(&mTarget[i*C], mOrder, d[0], d[1], d[2]);
+		for(unsigned c=0; c<C; ++c) mGain[i*C + c] = mTarget[i*C + c];
+		mGlide[i] = 0;
+	}
+	return *this;
+}
+
+AmbiEncoder& AmbiEncoder::numSources(unsigned n){
+	const unsigned C = channels();
+	const unsigned S = mNumSrc;
+	mGain.resize(n*C); mTarget.resize(n*C); mGlide.resize(n, 0);
+	mDir.resize(3*n, 0.f);
+	mNumSrc = n;
+	for(unsigned i=S; i<n; ++i){
+		mDir[3*i] = 1.f;
+		sphericalHarmonics(&mTarget[i*C], mOrder, 1, 0, 0);
+		for(unsigned c=0; c<C; ++c) mGain[i*C + c] = mTarget[i*C + c];
+	}
+	return *this;
+}
+
+AmbiEncoder& AmbiEncoder::dir(unsigned i, float x, float y, float z){
+	mDir[3*i] = x; mDir[3*i+1] = y; mDir[3*i+2] = z;
+	sphericalHarmonics(&mTarget[i*channels()], mOrder, x, y, z);
+	mGlide[i] = 1;
+	return *this;
+}
+
+/*
+The block is split in spans that keep the bus spans in the L1 cache, and
+sources are taken eight at a time, so that each span of a channel is read
+and written once per eight sources.
+*/
+void AmbiEncoder::process(const float * const * src, float * const * bus, unsigned n){
+	if(!n) return;
+	enum{ B = 64, K = 8 };
+	const unsigned C = channels(), S = mNumSrc;
+	const float r = 1.f/n;
+
+	for(unsigned i=0; i<n; i+=B){
+		const unsigned m = n-i < B ? n-i : B;
+		for(unsigned s=0; s<S; s+=K){
+			const unsigned k = S-s < K ? S-s : K;
+			const float * x[K];
+			bool glide = false;
+			for(unsigned j=0; j<k; ++j){
+				x[j] = src[s+j] + i;
+				glide |= mGlide[s+j] != 0;
+			}
+			float g[K], d[K];
+			for(unsigned c=0; c<C; ++c){
+				for(unsigned j=0; j<k; ++j){
+					const unsigned q = (s+j)*C + c;
+					d[j] = mGlide[s+j] ? (mTarget[q] - mGain[q]) * r : 0.f;
+					g[j] = mGain[q] + d[j]*i;
+				}
+				float * b = bus[c] + i;
+				if(!glide){
+					unsigned j = 0;
+					for(; j+4<=k; j+=4) mix<4>(b, x+j, g+j, m, true);
+					for(; j<k; ++j) mix<1>(b, x+j, g+j, m, true);
+					continue;
+				}
+				switch(k){
+				case 8: mixGlide<8>(b, x, g, d, m); break;
+				case 7: mixGlide<7>(b, x, g, d, m); break;
+				case 6: mixGlide<6>(b, x, g, d, m); break;
+				case 5: mixGlide<5>(b, x, g, d, m); break;
+				case 4: mixGlide<4>(b, x, g, d, m); break;
+				case 3: mixGlide<3>(b, x, g, d, m); break;
+				case 2: mixGlide<2>(b, x, g, d, m); break;
+				default:mixGlide<1>(b, x, g, d, m);
+				}
+			}
+		}
+	}
+
+	for(unsigned s=0; s<S; ++s){
+		if(mGlide[s]){
+			for(unsigned c=0; c<C; ++c) mGain[s*C + c] = mTarget[s*C + c];
+			mGlide[s] = 0;
+		}
+	}
+}
+
+
+//---- AmbiDecoder
+AmbiDecoder::AmbiDecoder(unsigned ord, unsigned numSpk)
+:	mOrder(ord), mNumSpk(0), mMethod(SAMPLING), mMaxRE(false), mDirty(true)
+{
+	numSpeakers(numSpk);
+}
+
+AmbiDecoder& AmbiDecoder::order(unsigned v){
+	mOrder = v;
+	mDirty = true;
+	return *this;
+}
+
+AmbiDecoder& AmbiDecoder::numSpeakers(unsigned n){
+	mX.resize(n, 1.f); mY.resize(n, 0.f); mZ.resize(n, 0.f);
+	mNumSpk = n;
+	mDirty = true;
+	return *this;
+}
+
+AmbiDecoder& AmbiDecoder::speaker(unsigned i, float x, float y, float z){
+	mX[i] = x; mY[i] = y; mZ[i] = z;
+	mDirty = true;
+	return *this;
+}
+
+/*
+With E the C x L matrix of harmonics in the speaker directions, a decoder D
+that reproduces the harmonics satisfies E D = I. Mode matching takes the
+least-squares solution D = E^T (E E^T)^-1, with a little regularization for
+layouts that do not resolve all harmonics. For regular layouts E E^T is
+diag(L / (2n+1)) with SN3D, which makes sampling, D = E^T diag((2n+1) / L),
+the same decoder.
+
+The max-rE weights are those of Zotter and Frank (2012), scaled to keep the
+energy of the speaker gains.
+*/
+void AmbiDecoder::update(){
+	mDirty = false;
+	const unsigned C = channels(), L = mNumSpk, N = mOrder;
+	mCoef.assign(L*C, 0.f);
+	if(!L) return;
+
+	std::vector<float> E(L*C);	// by speaker, then channel
+	for(unsigned l=0; l<L; ++l) sphericalHarmonics(&E[l*C], N, mX[l], mY[l], mZ[l]);
+
+	std::vector<double> w(N+1, 1.);
+	if(mMaxRE){
+		const double x = std::cos(137.9 * M_PI/180. / (N + 1.51));
+		double e = 0;
+		for(unsigned n=0; n<=N; ++n){
+			w[n] = legendre(n, x);
+			e += (2*n + 1) * w[n]*w[n];
+		}
+		const double s = std::sqrt(ambiChannels(N) / e);
+		for(unsigned n=0; n<=N; ++n) w[n] *= s;
+	}
+
+	if(mMethod == MODE_MATCHING){
+		// Invert Gram matrix E E^T with Gauss-Jordan elimination
+		std::vector<double> G(C*C, 0.), I(C*C, 0.);
+		double tr = 0;
+		for(unsigned i=0; i<C; ++i){
+			for(unsigned j=0; j<C; ++j){
+				double s = 0;
+				for(unsigned l=0; l<L; ++l) s += double(E[l*C + i]) * E[l*C + j];
+				G[i*C + j] = s;
+			}
+			tr += G[i*C + i];
+			I[i*C + i] = 1;
+		}
+		for(unsigned i=0; i<C; ++i) G[i*C + i] += 1e-6 * tr / C;
+
+		for(unsigned col=0; col<C; ++col){
+			unsigned piv = col;
+			for(unsigned r=col+1; r<C; ++r){
+				if(std::abs(G[r*C + col]) > std::abs(G[piv*C + col])) piv = r;
+			}
+			if(piv != col){
+				for(unsigned j=0; j<C; ++j){
+					std::swap(G[col*C + j], G[piv*C + j]);
+					std::swap(I[col*C + j], I[piv*C + j]);
+				}
+			}
+			const double p = 1. / G[col*C + col];
+			for(unsigned j=0; j<C; ++j){ G[col*C + j] *= p; I[col*C + j] *= p; }
+			for(unsigned r=0; r<C; ++r){
+				if(r == col) continue;
+				const double f = G[r*C + col];
+				if(f == 0.) continue;
+				for(unsigned j=0; j<C; ++j){
+					G[r*C + j] -= f * G[col*C + j];
+					I[r*C + j] -= f * I[col*C + j];
+				}
+			}
+		}
+
+		for(unsigned l=0; l<L; ++l){
+			for(unsigned c=0; c<C; ++c){
+				double s = 0;
+				for(unsigned j=0; j<C; ++j) s += E[l*C + j] * I[j*C + c];
+				mCoef[l*C + c] = float(s * w[degree(c)]);
+			}
+		}
+	}
+	else{
+		for(unsigned l=0; l<L; ++l){
+			for(unsigned c=0; c<C; ++c){
+				const unsigned n = degree(c);
+				mCoef[l*C + c] = float(E[l*C + c] * w[n] * (2*n + 1) / L);
+			}
+		}
+	}
+}
+
+void AmbiDecoder::process(const float * const * bus, float * const * out, unsigned n){
+	if(mDirty) update();
+	const unsigned C = channels();
+	for(unsigned l=0; l<mNumSpk; ++l){
+		const float * g = &mCoef[l*C];
+		unsigned c = 0;
+		for(; c+4<=C; c+=4) mix<4>(out[l], bus+c, g+c, n, c!=0);
+		for(; c<C; ++c) mix<1>(out[l], bus+c, g+c, n, c!=0);
+	}
+}
+
+} // gam::
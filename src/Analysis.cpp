@@ -0,0 +1,745 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include "Gamma/Analysis.h"
+
+namespace gam{
+
+namespace{
+	// Follow envelopes of L channels over n samples starting at i
+	template <unsigned L>
+	void follow(
+		const float * in, float * out, unsigned stride, unsigned i, unsigned n,
+		float * env, const float * ca, const float * cr, float * peak
+	){
+		float y[L], a[L], r[L], p[L];
+		for(unsigned k=0; k<L; ++k){
+			y[k] = env[k]; a[k] = ca[k]; r[k] = cr[k]; p[k] = peak[k];
+		}
+		const unsigned end = i + n;
+		for(; i<end; ++i){
+			for(unsigned k=0; k<L; ++k){
+				const float x = std::fabs(in[k*stride + i]);
+				const float c = x > y[k] ? a[k] : r[k];
+				y[k] = x + (y[k] - x) * c;
+				p[k] = p[k] > y[k] ? p[k] : y[k];
+				if(out) out[k*stride + i] = y[k];
+			}
+		}
+		for(unsigned k=0; k<L; ++k){ env[k] = y[k]; peak[k] = p[k]; }
+	}
+
+	// Loudness in LUFS of a mean square power
+	float loudness(double pow){
+		return pow > 0. ? float(-0.691 + 10.*std::log10(pow)) : -std::numeric_limits<float>::infinity();
+	}
+
+	// Magnitudes of current frame, in contiguous loops the compiler vectorizes
+	void magnitudes(float * m, const STFT& stft){
+		const unsigned N = stft.numBins();
+		const bool polar = COMPLEX != stft.spectrumType();
+		if(stft.splitBins()){
+			const float * c0 = stft.binComp(0);
+			const float * c1 = stft.binComp(1);
+			if(polar)	for(unsigned k=0; k<N; ++k) m[k] = c0[k];
+			else		for(unsigned k=0; k<N; ++k) m[k] = std::sqrt(c0[k]*c0[k] + c1[k]*c1[k]);
+		}
+		else{
+			const Complex<float> * b = stft.bins();
+			if(polar)	for(unsigned k=0; k<N; ++k) m[k] = b[k][0];
+			else		for(unsigned k=0; k<N; ++k) m[k] = std::sqrt(b[k][0]*b[k][0] + b[k][1]*b[k][1]);
+		}
+	}
+
+	float lagCoef(float time, double spu){
+		const double len = time * spu;
+		return len > 0. ? float(scl::t60(len)) : 0.f;
+	}
+}
+
+EnvFollowBank::EnvFollowBank(unsigned n, float atk, float rel, unsigned decim)
+:	mChannels(0), mDecim(1), mPhase(0), mMeterCount(0)
+{
+	channels(n);
+	attack(atk);
+	release(rel);
+	decimation(decim);
+}
+
+EnvFollowBank& EnvFollowBank::channels(unsigned n){
+	const float a = mAtk.empty() ? 0.001f : mAtk.back();
+	const float r = mRel.empty() ? 0.3f : mRel.back();
+	const unsigned padded = (n + LANES-1) / LANES * LANES;
+	mChannels = n;
+	mAtk.resize(padded, a); mRel.resize(padded, r);
+	mCAtk.resize(padded); mCRel.resize(padded);
+	mEnv.resize(padded); mPeak.resize(padded);
+	std::vector<std::atomic<float> >(n).swap(mMeter);
+	onDomainChange(1);
+	reset();
+	return *this;
+}
+
+EnvFollowBank& EnvFollowBank::attack(unsigned c, float v){
+	mAtk[c] = v;
+	mCAtk[c] = lagCoef(v, spu());
+	return *this;
+}
+
+EnvFollowBank& EnvFollowBank::attack(float v){
+	for(unsigned c=0; c<channels(); ++c) attack(c, v);
+	return *this;
+}
+
+EnvFollowBank& EnvFollowBank::release(unsigned c, float v){
+	mRel[c] = v;
+	mCRel[c] = lagCoef(v, spu());
+	return *this;
+}
+
+EnvFollowBank& EnvFollowBank::release(float v){
+	for(unsigned c=0; c<channels(); ++c) release(c, v);
+	return *this;
+}
+
+void EnvFollowBank::reset(){
+	for(unsigned c=0; c<mEnv.size(); ++c) mEnv[c] = mPeak[c] = 0.f;
+	for(unsigned c=0; c<channels(); ++c) mMeter[c].store(0.f, std::memory_order_relaxed);
+	mPhase = 0;
+}
+
+void EnvFollowBank::onDomainChange(double /*r*/){
+	for(unsigned c=0; c<mAtk.size(); ++c){
+		mCAtk[c] = lagCoef(mAtk[c], spu());
+		mCRel[c] = lagCoef(mRel[c], spu());
+	}
+}
+
+void EnvFollowBank::publish(){
+	for(unsigned c=0; c<channels(); ++c){
+		mMeter[c].store(mPeak[c], std::memory_order_relaxed);
+		mPeak[c] = 0.f;
+	}
+	mMeterCount.fetch_add(1, std::memory_order_release);
+}
+
+void EnvFollowBank::process(const float * in, float * out, unsigned n){
+	const unsigned full = channels() / LANES * LANES;
+
+	// Split block at ends of decimation periods
+	for(unsigned i=0; i<n;){
+		unsigned m = mDecim - mPhase;
+		if(m > n-i) m = n-i;
+
+		unsigned c=0;
+		for(; c<full; c+=LANES){
+			follow<LANES>(
+				in + c*n, out ? out + c*n : 0, n, i, m,
+				&mEnv[c], &mCAtk[c], &mCRel[c], &mPeak[c]
+			);
+		}
+		for(; c<channels(); ++c){
+			follow<1>(
+				in + c*n, out ? out + c*n : 0, n, i, m,
+				&mEnv[c], &mCAtk[c], &mCRel[c], &mPeak[c]
+			);
+		}
+
+		i += m;
+		mPhase += m;
+		if(mPhase == mDecim){
+			publish();
+			mPhase = 0;
+		}
+	}
+}
+
+
+
+PitchYIN::PitchYIN(unsigned winSize, unsigned hopSize)
+:	mWin(winSize, hopSize),
+	mMinFreq(50), mMaxFreq(2000), mThresh(0.15), mFreq(0), mClarity(0)
+{
+	resize(winSize, hopSize);
+}
+
+PitchYIN& PitchYIN::resize(unsigned winSize, unsigned hopSize){
+	mWin.resize(winSize, hopSize);
+	mFFT.resize(winSize);
+	mX.assign(winSize, 0.f);
+	mA.resize(winSize);
+	mS.resize(winSize);
+	mD.resize(winSize/2 + 1);
+	return *this;
+}
+
+float PitchYIN::analyze(const float * win){
+	const unsigned W = sizeWin();
+	const unsigned N = W/2;
+
+	// Lags searched; one past the last is needed to interpolate
+	unsigned tauMin = unsigned(spu() / mMaxFreq);
+	unsigned tauMax = unsigned(std::ceil(spu() / mMinFreq));
+	if(tauMin < 2) tauMin = 2;
+	if(tauMax > N-2) tauMax = N-2;
+
+	mFreq = 0.f;
+	mClarity = 0.f;
+	if(tauMin > tauMax) return mFreq;
+
+	// Cross-correlation of the first half of the window with all of it,
+	// c(t) = sum_{j<N} x_j x_{j+t}. As j+t < W for t < N, the circular
+	// correlation is free of wrapping.
+	float * a = &mA[0];
+	float * x = &mS[0];
+	for(unsigned i=0; i<N; ++i) a[i] = win[i];
+	for(unsigned i=N; i<W; ++i) a[i] = 0.f;
+	for(unsigned i=0; i<W; ++i) x[i] = win[i];
+	mFFT.forward(a, false, true);	// include 1/W of inverse
+	mFFT.forward(x, false, false);
+	a[0] *= x[0];
+	a[W-1] *= x[W-1];
+	for(unsigned i=1; i<W-1; i+=2){ // conj(A) X
+		const float ar = a[i], ai = a[i+1];
+		a[i  ] = ar*x[i] + ai*x[i+1];
+		a[i+1] = ar*x[i+1] - ai*x[i];
+	}
+	mFFT.inverse(a);
+
+	// d(t) = sum_{j<N} (x_j - x_{j+t})^2 expands into two energies minus
+	// twice the correlation. The second energy slides along the window.
+	float e1 = 0.f;
+	for(unsigned i=0; i<N; ++i) e1 += win[i]*win[i];
+	float e2 = e1;
+	float sum = 0.f;
+	float * d = &mD[0];
+	d[0] = 1.f;
+	for(unsigned t=1; t<=tauMax+1; ++t){
+		e2 += win[t+N-1]*win[t+N-1] - win[t-1]*win[t-1];
+		float v = e1 + e2 - 2.f*a[t];
+		if(v < 0.f) v = 0.f;
+		sum += v;
+		d[t] = sum > 0.f ? v * t / sum : 1.f;	// cumulative mean normalized
+	}
+
+	// First dip below threshold, followed to its minimum
+	unsigned tau = tauMin;
+	while(tau <= tauMax && d[tau] >= mThresh) ++tau;
+	if(tau > tauMax){
+		float m = d[tauMin];
+		for(unsigned t=tauMin+1; t<=tauMax; ++t) if(d[t] < m) m = d[t];
+		mClarity = m < 1.f ? 1.f - m : 0.f;
+		return mFreq;
+	}
+	while(tau < tauMax && d[tau+1] < d[tau]) ++tau;
+
+	float period = tau;
+	const float dl = d[tau-1], dc = d[tau], dr = d[tau+1];
+	const float den = dl - 2.f*dc + dr;
+	if(den > 0.f) period += 0.5f * (dl - dr) / den;
+
+	mClarity = 1.f - dc;
+	mFreq = float(spu() / period);
+	return mFreq;
+}
+
+
+
+OnsetDetector::OnsetDetector(unsigned medianLen, float ratio_, float offset_)
+:	mHistTap(0), mRatio(ratio_), mOffset(offset_), mGamma(100)
+{
+	medianLength(medianLen);
+}
+
+OnsetDetector& OnsetDetector::medianLength(unsigned v){
+	mHist.resize(v ? v : 1);
+	mSort.resize(mHist.size());
+	reset();
+	return *this;
+}
+
+void OnsetDetector::reset(){
+	for(auto& v : mPrev) v = 0.f;
+	for(auto& v : mHist) v = 0.f;
+	mHistTap = 0;
+	mFlux[0] = mFlux[1] = mFlux[2] = 0.f;
+	mThresh = 0.f;
+	mFrames = 0;
+	mTime = 0.;
+	mStrength = 0.f;
+}
+
+float OnsetDetector::median(){
+	std::copy(mHist.begin(), mHist.end(), mSort.begin());
+	auto mid = mSort.begin() + mSort.size()/2;
+	std::nth_element(mSort.begin(), mid, mSort.end());
+	return *mid;
+}
+
+bool OnsetDetector::operator()(const STFT& stft){
+	const unsigned N = stft.numBins();
+	if(mMag.size() != N){
+		mMag.assign(N, 0.f);
+		mPrev.assign(N, 0.f);
+		reset();
+	}
+
+	float * m = &mMag[0];
+	magnitudes(m, stft);
+
+	// Flux of compressed magnitudes
+	const float g = mGamma;
+	const float * p = &mPrev[0];
+	float sum = 0.f;
+	for(unsigned k=0; k<N; ++k){
+		m[k] = g > 0.f ? std::log1p(g * m[k]) : m[k];
+		const float d = m[k] - p[k];
+		sum += d > 0.f ? d : 0.f;
+	}
+	mMag.swap(mPrev);
+	const float flux = mFrames ? sum / N : 0.f; // first frame rises from nothing
+
+	mFlux[0] = mFlux[1];
+	mFlux[1] = mFlux[2];
+	mFlux[2] = flux;
+	const float thresh = mThresh;	// of middle frame, from frames before it
+	mThresh = mOffset + mRatio * median();
+	mHist[mHistTap] = flux;
+	if(++mHistTap == mHist.size()) mHistTap = 0;
+	++mFrames;
+
+	// Is middle frame a peak over its threshold?
+	const float fl = mFlux[0], fc = mFlux[1], fr = mFlux[2];
+	if(mFrames < 3 || !(fc > thresh && fc > fl && fc >= fr)) return false;
+
+	double frame = double(mFrames - 2);	// index of middle frame
+	const float den = fl - 2.f*fc + fr;
+	if(den < 0.f) frame += 0.5f * (fl - fr) / den;
+
+	// Window of frame j ends after (j+1) hops
+	const double samples = (frame + 1.) * stft.sizeHop() - 0.5 * stft.sizeWin();
+	mTime = samples * stft.ups();
+	mStrength = fc - thresh;
+	return true;
+}
+
+
+
+PartialTracker::PartialTracker(unsigned n)
+:	mThresh(1e-4), mMaxDev(2)
+{
+	maxPartials(n);
+}
+
+PartialTracker& PartialTracker::maxPartials(unsigned n){
+	mFrq.assign(n, 0.f);
+	mAmp.assign(n, 0.f);
+	mAge.assign(n, 0);
+	mOrder.resize(n);
+	return *this;
+}
+
+void PartialTracker::reset(){
+	for(unsigned i=0; i<size(); ++i){ mAmp[i] = 0.f; mAge[i] = 0; }
+}
+
+void PartialTracker::operator()(const STFT& stft){
+	const unsigned N = stft.numBins();
+	if(mMag.size() != N){
+		mMag.resize(N);
+		mIdx.resize(N/2 + 1);
+		mPeaks.reserve(N/2 + 1);
+	}
+	float * m = &mMag[0];
+	magnitudes(m, stft);
+
+	// A sinusoid of amplitude A peaks at A/2 times the summed window over
+	// the transform size
+	const float ampMul = 2.f * stft.sizeDFT() / (stft.sizeWin() * stft.windowMean());
+	const float binFreq = float(stft.binFreq());
+	const float thresh = mThresh / ampMul;
+
+	// Peaks, refined by parabolas through log magnitudes
+	const unsigned numMax = arr::maxima(&mIdx[0], m, N);
+	mPeaks.clear();
+	for(unsigned j=0; j<numMax; ++j){
+		const unsigned k = mIdx[j];
+		if(m[k] < thresh) continue;
+		const float l0 = std::log(m[k-1] + 1e-20f), l1 = std::log(m[k]), l2 = std::log(m[k+1] + 1e-20f);
+		const float d = ipl::parabolic(l0, l1, l2);
+		const float a = std::exp(l1 - 0.25f*(l0 - l2)*d) * ampMul;
+		mPeaks.push_back(Peak{(k + d) * binFreq, a, false});
+	}
+
+	// Keep only the largest peaks, in order of frequency
+	if(mPeaks.size() > size()){
+		auto byAmp = [](const Peak& a, const Peak& b){ return a.amp > b.amp; };
+		std::nth_element(mPeaks.begin(), mPeaks.begin() + size(), mPeaks.end(), byAmp);
+		mPeaks.resize(size());
+		std::sort(mPeaks.begin(), mPeaks.end(), [](const Peak& a, const Peak& b){ return a.frq < b.frq; });
+	}
+
+	// Continue partials, loudest first, with the nearest free peak
+	for(unsigned i=0; i<size(); ++i) mOrder[i] = i;
+	std::sort(mOrder.begin(), mOrder.end(), [this](unsigned a, unsigned b){ return mAmp[a] > mAmp[b]; });
+	const float maxDev = mMaxDev * binFreq;
+	for(unsigned i : mOrder){
+		if(!active(i)) break;
+		const float f = mFrq[i];
+		auto it = std::lower_bound(mPeaks.begin(), mPeaks.end(), f,
+			[](const Peak& p, float v){ return p.frq < v; });
+		Peak * best = 0;
+		float bestDev = maxDev;
+		for(auto r = it; r != mPeaks.end() && r->frq - f <= bestDev; ++r){
+			if(!r->claimed){ best = &*r; bestDev = r->frq - f; break; }
+		}
+		for(auto l = it; l != mPeaks.begin();){
+			--l;
+			if(f - l->frq > bestDev) break;
+			if(!l->claimed){ best = &*l; break; }
+		}
+		if(best){
+			best->claimed = true;
+			mFrq[i] = best->frq; mAmp[i] = best->amp; ++mAge[i];
+		}
+		else{
+			mAmp[i] = 0.f; mAge[i] = 0;
+		}
+	}
+
+	// Start partials from unclaimed peaks in free slots
+	unsigned slot = 0;
+	for(auto& p : mPeaks){
+		if(p.claimed) continue;
+		while(slot < size() && active(slot)) ++slot;
+		if(slot == size()) break;
+		mFrq[slot] = p.frq; mAmp[slot] = p.amp; mAge[slot] = 1;
+	}
+}
+
+
+ThresholdBank::ThresholdBank(unsigned n, float thresh, float holdTime, unsigned queueSize)
+:	mEvents(queueSize), mTime(0), mRelease(0.5), mHoldTime(holdTime), mHold(1)
+{
+	channels(n);
+	threshold(thresh);
+	onDomainChange(1);
+}
+
+ThresholdBank& ThresholdBank::channels(unsigned n){
+	const float t = mThresh.empty() ? 0.1f : mThresh.back();
+	mThresh.resize(n, t);
+	mQuiet.assign(n, 0);
+	mOpen.assign(n, 0);
+	return *this;
+}
+
+ThresholdBank& ThresholdBank::threshold(float v){
+	for(auto& t : mThresh) t = v;
+	return *this;
+}
+
+void ThresholdBank::reset(){
+	for(auto& v : mOpen) v = 0;
+	for(auto& v : mQuiet) v = 0;
+	Event e;
+	while(mEvents.pop(e)){}
+	mTime = 0;
+}
+
+void ThresholdBank::onDomainChange(double /*r*/){
+	const double len = mHoldTime * spu();
+	mHold = len > 1. ? unsigned(len + 0.5) : 1;
+}
+
+void ThresholdBank::process(const float * in, unsigned n){
+	for(unsigned c=0; c<channels(); ++c){
+		const float * x = in + c*n;
+		const float thresh = mThresh[c];
+		const float low = thresh * mRelease;
+		unsigned i = 0;
+		while(i < n){
+			if(!mOpen[c]){
+				i += arr::headBelowNorm(x+i, n-i, thresh);
+				if(i == n) break;
+				mOpen[c] = 1;
+				mQuiet[c] = 0;
+				mEvents.push(Event{mTime + i, std::fabs(x[i]), c, true});
+				++i;
+			}
+			else{
+				unsigned q = mQuiet[c];
+				for(; i<n; ++i){
+					if(std::fabs(x[i]) >= low){ q = 0; continue; }
+					if(++q >= mHold){
+						mOpen[c] = 0;
+						mEvents.push(Event{mTime + i, std::fabs(x[i]), c, false});
+						++i;
+						break;
+					}
+				}
+				mQuiet[c] = q;
+			}
+		}
+	}
+	mTime += n;
+}
+
+
+LoudnessMeter::LoudnessMeter(unsigned n)
+:	mStep(1), mPhase(0), mBinCount(BINS), mBinPow(BINS),
+	mMomentary(0.f), mShortTerm(0.f), mIntegrated(0.f), mMeterCount(0)
+{
+	channels(n);
+}
+
+LoudnessMeter& LoudnessMeter::channels(unsigned n){
+	mKWeight.resize(n);
+	mWeight.assign(n, 1.f);
+	mAcc.resize(n);
+	onDomainChange(1);
+	reset();
+	return *this;
+}
+
+void LoudnessMeter::reset(){
+	for(auto& f : mKWeight) f.zero();
+	for(auto& v : mAcc) v = 0.;
+	for(auto& v : mPow) v = 0.;
+	for(auto& v : mBinCount) v = 0;
+	for(auto& v : mBinPow) v = 0.;
+	mSumM = mSumS = 0.;
+	mPhase = mTap = mSteps = 0;
+	const float none = loudness(0.);
+	mMomentary.store(none, std::memory_order_relaxed);
+	mShortTerm.store(none, std::memory_order_relaxed);
+	mIntegrated.store(none, std::memory_order_relaxed);
+}
+
+void LoudnessMeter::onDomainChange(double /*r*/){
+	// K-weighting of BS.1770: a high shelf modeling the head followed by
+	// a high-pass, designed from their analog prototypes for this rate
+	const double rate = spu();
+	double K = std::tan(M_PI * 1681.974450955533 / rate);
+	double Q = 0.7071752369554196;
+	const double Vh = std::pow(10., 3.999843853973347/20.);
+	const double Vb = std::pow(Vh, 0.4996667741545416);
+	double a0 = 1. + K/Q + K*K;
+	const float shelf[5] = {
+		float((Vh + Vb*K/Q + K*K)/a0), float(2.*(K*K - Vh)/a0), float((Vh - Vb*K/Q + K*K)/a0),
+		float(2.*(K*K - 1.)/a0), float((1. - K/Q + K*K)/a0)
+	};
+	K = std::tan(M_PI * 38.13547087602444 / rate);
+	Q = 0.5003270373238773;
+	a0 = 1. + K/Q + K*K;
+	const float highPass[5] = {
+		1.f, -2.f, 1.f, float(2.*(K*K - 1.)/a0), float((1. - K/Q + K*K)/a0)
+	};
+	for(auto& f : mKWeight){
+		f.coef(0, shelf[0], shelf[1], shelf[2], shelf[3], shelf[4]);
+		f.coef(1, highPass[0], highPass[1], highPass[2], highPass[3], highPass[4]);
+	}
+
+	mStep = unsigned(rate * 0.1 + 0.5);
+	if(!mStep) mStep = 1;
+	if(mPhase >= mStep) mPhase = 0;
+}
+
+void LoudnessMeter::process(const float * in, unsigned n){
+	enum{ CHUNK = 256 };
+	float buf[CHUNK];
+
+	// Split block at ends of steps and into chunks that stay in cache
+	for(unsigned i=0; i<n;){
+		unsigned m = mStep - mPhase;
+		if(m > n-i) m = n-i;
+		if(m > CHUNK) m = CHUNK;
+		for(unsigned c=0; c<channels(); ++c){
+			mKWeight[c](buf, in + c*n + i, m);
+			mAcc[c] += arr::sumSquares(buf, m);
+		}
+		i += m;
+		mPhase += m;
+		if(mPhase == mStep){
+			endStep();
+			mPhase = 0;
+		}
+	}
+}
+
+void LoudnessMeter::endStep(){
+	double pow = 0.;
+	for(unsigned c=0; c<channels(); ++c){
+		pow += mWeight[c] * mAcc[c];
+		mAcc[c] = 0.;
+	}
+	pow /= mStep;
+
+	// Steps STEPS_M and STEPS_S ago leave the sliding sums
+	mSumM += pow - mPow[(mTap + STEPS_S - STEPS_M) % STEPS_S];
+	mSumS += pow - mPow[mTap];
+	mPow[mTap] = pow;
+	if(++mTap == STEPS_S){
+		// Resum once per lap so rounding errors do not accumulate
+		mTap = 0;
+		mSumM = mSumS = 0.;
+		for(unsigned i=0; i<STEPS_S; ++i) mSumS += mPow[i];
+		for(unsigned i=STEPS_S-STEPS_M; i<STEPS_S; ++i) mSumM += mPow[i];
+	}
+	++mSteps;
+
+	const float none = loudness(0.);
+	if(mSteps >= STEPS_M){
+		const double block = mSumM > 0. ? mSumM / STEPS_M : 0.;
+		const float l = loudness(block);
+		if(l >= -70.f){ // absolute gate
+			int bin = int((l + 70.f) * 10.f);
+			if(bin >= BINS) bin = BINS-1;
+			++mBinCount[bin];
+			mBinPow[bin] += block;
+		}
+		mMomentary.store(l, std::memory_order_relaxed);
+		mIntegrated.store(gated(), std::memory_order_relaxed);
+	}
+	if(mSteps >= STEPS_S){
+		mShortTerm.store(loudness(mSumS > 0. ? mSumS / STEPS_S : 0.), std::memory_order_relaxed);
+	}
+	else{
+		mShortTerm.store(none, std::memory_order_relaxed);
+	}
+	mMeterCount.fetch_add(1, std::memory_order_release);
+}
+
+float LoudnessMeter::gated() const {
+	// Relative gate is 10 LU below loudness of blocks over absolute gate
+	double sum = 0.; uint64_t count = 0;
+	for(unsigned b=0; b<BINS; ++b){ sum += mBinPow[b]; count += mBinCount[b]; }
+	if(!count) return loudness(0.);
+	const float rel = loudness(sum / count) - 10.f;
+	int first = int(std::ceil((rel + 70.f) * 10.f));
+	if(first < 0) first = 0;
+	sum = 0.; count = 0;
+	for(unsigned b=first; b<BINS; ++b){ sum += mBinPow[b]; count += mBinCount[b]; }
+	return count ? loudness(sum / count) : loudness(0.);
+}
+
+
+
+SweepMeasure::SweepMeasure(float freq1, float freq2, float length, float tail, float amp)
+:	mPos(0)
+{
+	resize(freq1, freq2, length, tail, amp);
+}
+
+SweepMeasure& SweepMeasure::resize(float freq1, float freq2, float length, float tail, float amp){
+	mFreq1 = freq1; mFreq2 = freq2; mLength = length; mTail = tail; mAmp = amp;
+
+	const double sr = spu();
+	const unsigned S = unsigned(length * sr + 0.5);
+	const unsigned R = S + unsigned(tail * sr + 0.5);
+	unsigned N = 2;
+	while(N < R) N <<= 1;
+
+	// x(t) = sin(2 pi f1 L (e^(t/L) - 1)), where L is the time to rise by e
+	const double L = length / std::log(double(freq2) / freq1) * sr;
+	const double w1 = M_2PI * freq1 / sr;
+	mRate = float(L);
+	mSweep.resize(S);
+	for(unsigned i=0; i<S; ++i){
+		mSweep[i] = float(amp * std::sin(w1 * L * (std::exp(i / L) - 1.)));
+	}
+
+	// Fade over the first and last twelfth of an octave to limit ripple at
+	// the band edges
+	const unsigned fade = std::min(unsigned(L * M_LN2 / 12.), S/2);
+	for(unsigned i=0; i<fade; ++i){
+		const float g = 0.5f - 0.5f * float(std::cos(M_PI * (i + 0.5) / fade));
+		mSweep[i] *= g;
+		mSweep[S-1-i] *= g;
+	}
+
+	mRec.assign(R, 0.f);
+	mBuf.assign(N+2, 0.f);
+	mInv.assign(N+2, 0.f);
+	mFFT.resize(N);
+	mPos.store(R, std::memory_order_release);
+	if(!S) return *this;
+
+	// The sweep's spectrum falls by 3 dB per octave, so the inverse filter is
+	// the reversed sweep with amplitude in proportion to its frequency
+	float * X = mBuf.data();
+	float * H = mInv.data();
+	for(unsigned i=0; i<S; ++i){
+		X[1+i] = mSweep[i];
+		H[1+i] = mSweep[S-1-i] * float(std::exp(-double(i) / L));
+	}
+	mFFT.forward(X, true, false);
+	mFFT.forward(H, true, false);
+
+	// Normalize to unit gain, averaged over the middle of the band
+	unsigned k1 = unsigned(2. * freq1 * N / sr), k2 = unsigned(0.5 * freq2 * N / sr);
+	k2 = std::min(k2, N/2);
+	if(k2 <= k1){ k1 = 1; k2 = N/2; }
+	double sum = 0;
+	for(unsigned k=k1; k<k2; ++k){
+		const float * x = X + 2*k, * h = H + 2*k;
+		sum += std::sqrt(double(x[0]*x[0] + x[1]*x[1]) * double(h[0]*h[0] + h[1]*h[1]));
+	}
+	const float gain = float((k2 - k1) / (sum * N));
+	for(unsigned i=0; i<N+2; ++i) H[i] *= gain;
+
+	return *this;
+}
+
+void SweepMeasure::start(){
+	std::fill(mRec.begin(), mRec.end(), 0.f);
+	mPos.store(0, std::memory_order_release);
+}
+
+bool SweepMeasure::process(float * out, const float * in, unsigned n){
+	const unsigned S = sweepSize(), R = recordSize();
+	unsigned pos = mPos.load(std::memory_order_relaxed);
+	unsigned i = 0;
+	for(; i<n && pos<R; ++i, ++pos){
+		mRec[pos] = in[i];
+		out[i] = pos < S ? mSweep[pos] : 0.f;
+	}
+	for(; i<n; ++i) out[i] = 0.f;
+	mPos.store(pos, std::memory_order_release);
+	return pos < R;
+}
+
+// The recording is circularly convolved with the inverse filter. The
+// transform size is at least recordSize(), so the linear response, from
+// sweepSize()-1 to recordSize()-1 of the full convolution, is not aliased.
+const float * SweepMeasure::deconvolve(const float * rec, unsigned len){
+	const unsigned N = mFFT.size();
+	const unsigned R = recordSize();
+	if(len > R) len = R;
+	float * X = mBuf.data();
+	const float * H = mInv.data();
+	std::copy(rec, rec+len, X+1);
+	std::fill(X+1+len, X+N+2, 0.f);
+	X[0] = 0.f;
+
+	mFFT.forward(X, true, false);
+	for(unsigned k=0; k<=N/2; ++k){
+		float * x = X + 2*k;
+		const float * h = H + 2*k;
+		const float re = x[0]*h[0] - x[1]*h[1];
+		const float im = x[0]*h[1] + x[1]*h[0];
+		x[0] = re; x[1] = im;
+	}
+	mFFT.inverse(X, true);
+
+	return X + sweepSize();
+}
+
+void SweepMeasure::onDomainChange(double /*r*/){
+	resize(mFreq1, mFreq2, mLength, mTail, mAmp);
+}
+
+} // gam::
@@ -0,0 +1,130 @@
+#include <chrono>
+#include <cstring> // memcpy
+#include <thread> // yield, sleep_for
+#include "Gamma/AsyncSTFT.h"
+#include "Gamma/Denormal.h"
+
+namespace gam{
+
+AsyncSTFT::AsyncSTFT(
+	unsigned winSize, unsigned hopSize, unsigned padSize,
+	WindowType winType, SpectralType specType, unsigned numAux
+)
+:	mSTFT(winSize, hopSize, padSize, winType, specType, numAux),
+	mHop(0), mTapW(0), mHopCnt(0),
+	mPosted(0), mDone(0), mMisses(0), mRunning(false)
+{
+	reset();
+}
+
+AsyncSTFT::~AsyncSTFT(){
+	stop();
+}
+
+AsyncSTFT& AsyncSTFT::resize(unsigned winSize, unsigned padSize){
+	stop();
+	mSTFT.resize(winSize, padSize);
+	reset();
+	return *this;
+}
+
+AsyncSTFT& AsyncSTFT::sizeHop(unsigned size){
+	stop();
+	mSTFT.sizeHop(size);
+	reset();
+	return *this;
+}
+
+void AsyncSTFT::reset(){
+	const unsigned W = mSTFT.sizeWin();
+	mHop = mSTFT.sizeHop();
+	mRing.assign(W, 0.f);
+	mFrameIn.assign(W, 0.f);
+	mFrameOut.assign(W, 0.f);
+	mPlay.assign(mHop, 0.f);
+	mTapW = mHopCnt = 0;
+	mPosted = mDone = 0;
+}
+
+bool AsyncSTFT::start(){
+	if(mRunning) return true;
+	mRunning = true;
+	if(!mThread.start(cWorkerFunc, this)){
+		mRunning = false;
+		return false;
+	}
+	return true;
+}
+
+void AsyncSTFT::stop(){
+	if(mRunning){
+		mRunning = false;
+		mThread.join();
+		if(mDone.load() != mPosted.load()){ // finish frame posted before stop
+			processFrame();
+			mDone.store(mPosted.load());
+		}
+	}
+}
+
+float AsyncSTFT::operator()(float input){
+	mRing[mTapW] = input;
+	if(++mTapW == mRing.size()) mTapW = 0;
+	if(++mHopCnt == mHop){
+		mHopCnt = 0;
+		hop();
+	}
+	return mPlay[mHopCnt];
+}
+
+void AsyncSTFT::operator()(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = (*this)(src[i]);
+}
+
+void AsyncSTFT::hop(){
+	// Take output of frame handed off one hop ago
+	unsigned posted = mPosted.load(std::memory_order_relaxed);
+	if(mDone.load(std::memory_order_acquire) != posted){
+		mMisses.store(misses()+1, std::memory_order_relaxed);
+		while(mDone.load(std::memory_order_acquire) != posted){
+			std::this_thread::yield();
+		}
+	}
+	std::memcpy(&mPlay[0], &mFrameOut[0], mHop*sizeof(float));
+
+	// Hand off current window, oldest sample first
+	mem::copyAllFromRing(&mRing[0], mRing.size(), mTapW, &mFrameIn[0]);
+	if(mRunning.load(std::memory_order_relaxed)){
+		mPosted.store(posted+1, std::memory_order_release);
+	}
+	else{
+		processFrame();
+	}
+}
+
+void AsyncSTFT::processFrame(){
+	mSTFT.forward(&mFrameIn[0]);
+	onFrame(mSTFT);
+	mSTFT.inverse(&mFrameOut[0]);
+}
+
+void * AsyncSTFT::cWorkerFunc(void * user){
+	AsyncSTFT& s = *(AsyncSTFT*)user;
+	DenormalGuard denormals;
+	unsigned spins = 0;
+	while(s.mRunning.load(std::memory_order_relaxed)){
+		unsigned posted = s.mPosted.load(std::memory_order_acquire);
+		if(posted != s.mDone.load(std::memory_order_relaxed)){
+			spins = 0;
+			s.processFrame();
+			s.mDone.store(posted, std::memory_order_release);
+		}
+		else if(++spins > 1000){
+			// Frames are a hop apart, so idle without spinning
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	return NULL;
+}
+
+} // gam::
@@ -3,11 +3,26 @@
 
 #include <stdio.h>
 #include <algorithm>
+#include <atomic>
 #include <cstring> // memset
 #include <cmath>
+#include <thread>
 
 #include "portaudio.h"
+#ifdef GAM_AUDIO_IO_JACK
+	#include <jack/jack.h>
+#endif
+#ifdef GAM_AUDIO_IO_ALSA
+	#include <alsa/asoundlib.h>
+#endif
+#include "Gamma/arr.h"
 #include "Gamma/AudioIO.h"
+#include "Gamma/Denormal.h"
+#include "Gamma/Print.h"
+#include "Gamma/RTCheck.h"
+#include "Gamma/Thread.h"
+#include "Gamma/Timer.h"
+#include "Gamma/Trace.h"
 
 namespace gam{
 
@@ -20,10 +35,6 @@ static void err(const char * msg, const char * src, bool exits){
 }
 */
 
-static void warn(const char * msg, const char * src){
-	fprintf(stderr, "%s%swarning: %s\n", src, src[0]?" ":"", msg);
-}
-
 template <class T>
 static void deleteBuf(T *& buf){ delete[] buf; buf=0; }
 
@@ -37,24 +48,12 @@ static int resize(T *& buf, int n){
 template <class T>
 static inline void zero(T * buf, int n){ std::memset(buf, 0, n*sizeof(T)); }
 
-template <class T>
-static void deinterleave(T * dst, const T * src, int numFrames, int numChannels){
-	int numSamples = numFrames * numChannels;
-	for(int c=0; c < numChannels; c++){
-		for(int i=c; i < numSamples; i+=numChannels){
-			*dst++ = src[i];
-		}
-	}
-}
-
-template <class T>
-static void interleave(T * dst, const T * src, int numFrames, int numChannels){
-	int numSamples = numFrames * numChannels;
-	for(int c=0; c < numChannels; c++){
-		for(int i=c; i < numSamples; i+=numChannels){
-			dst[i] = *src++;
-		}
+// Whether per-channel buffers are laid out back to back
+static bool contiguous(const float * const * bufs, int numChannels, int numFrames){
+	for(int c=1; c<numChannels; ++c){
+		if(bufs[c] != bufs[0] + c*numFrames) return false;
 	}
+	return true;
 }
 
 
@@ -158,7 +157,739 @@ void AudioDevice::printAll(){
 //==============================================================================
 class AudioIOData::Impl{
 public:
-	Impl(): mStream(0), mErrNum(0), mIsOpen(false), mIsRunning(false){}
+	Impl(): mStream(0), mErrNum(0), mIsOpen(false), mIsRunning(false), mNonInterleaved(false),
+		mFormat(AudioIO::FLOAT32), mDither(1),
+		mCallbacks(0), mNumJobs(0), mGeneration(0), mJobNext(0), mJobsDone(0), mWorkersRunning(false), mFlushDenormals(true),
+		mJobFrames(0), mJobOuts(0), mJobBuses(0),
+		mBlocks(0), mLate(0), mInUnder(0), mInOver(0), mOutUnder(0), mOutOver(0),
+		mTelemetrySeq(0), mTelemetryReset(false), mPrevStart(0),
+		mBackend(AudioIO::DEVICE), mHeadlessRun(false), mFrames(0), mLoad(0),
+		mNativeIn(0), mNativeOut(0), mNativeFlags(0), mNativeDead(false)
+		#ifdef GAM_AUDIO_IO_JACK
+		, mJack(0)
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		, mPcmIn(0), mPcmOut(0), mAlsaFormat(SND_PCM_FORMAT_FLOAT), mAlsaLinked(false), mNativeRun(false)
+		#endif
+		{}
+
+	// Start threads to run appended callbacks in parallel
+	void parallel(unsigned numThreads, bool pin){
+		mWorkersRunning = false;
+		for(unsigned i=0; i<mWorkers.size(); ++i){
+			mWorkers[i]->join();
+			delete mWorkers[i];
+		}
+		mWorkers.clear();
+		clearJobs();
+
+		if(numThreads > 1){
+			unsigned cores = std::thread::hardware_concurrency();
+			mWorkersRunning = true;
+			for(unsigned i=1; i<numThreads; ++i){
+				Thread * t = new Thread(cWorkerFunc, this);
+				t->realtime();
+				if(pin && cores >= numThreads) t->affinity(i);
+				mWorkers.push_back(t);
+			}
+		}
+	}
+
+	void clearJobs(){
+		for(unsigned i=0; i<mJobIO.size(); ++i) delete mJobIO[i];
+		mJobIO.clear();
+		mJobFrames = 0;
+	}
+
+	void resizeJobs(AudioIOData& io, unsigned numJobs){
+		// This allocates, but only when the callbacks or audio format change
+		clearJobs();
+		const int outSize = io.channelsOut() * io.framesPerBuffer();
+		const int busSize = io.channelsBus() * io.framesPerBuffer();
+		mJobBufs.assign(numJobs * (outSize + busSize), 0.f);
+		mMixSrcs.resize(numJobs);
+		for(unsigned i=0; i<numJobs; ++i){
+			float * buf = &mJobBufs[i * (outSize + busSize)];
+			AudioIOData * v = new AudioIOData(io, buf);
+			v->mBufB = busSize ? buf + outSize : 0;
+			mJobIO.push_back(v);
+		}
+		mJobFrames = io.framesPerBuffer();
+		mJobOuts = io.channelsOut();
+		mJobBuses = io.channelsBus();
+	}
+
+	// Run callbacks on private buffers using all threads, then sum them
+	void processParallel(AudioIOData& io, const std::vector<AudioCallback *>& cbs){
+		const unsigned numJobs = cbs.size();
+
+		if(numJobs != mJobIO.size() || io.framesPerBuffer() != mJobFrames
+			|| io.channelsOut() != mJobOuts || io.channelsBus() != mJobBuses
+		){
+			resizeJobs(io, numJobs);
+		}
+
+		// Input may point at host memory, so update it each block
+		for(unsigned i=0; i<numJobs; ++i) mJobIO[i]->mBufI = io.mBufI;
+
+		// Release jobs to workers and help out until all are done
+		mCallbacks.store(&cbs, std::memory_order_relaxed);
+		mFlushDenormals.store(DenormalGuard::flushToZero(), std::memory_order_relaxed);
+		mNumJobs.store(numJobs, std::memory_order_relaxed);
+		mJobsDone.store(0, std::memory_order_relaxed);
+		mJobNext.store(0, std::memory_order_release);
+		mGeneration.fetch_add(1, std::memory_order_release);
+		runJobs();
+		while(mJobsDone.load(std::memory_order_acquire) < numJobs){}
+
+		// Sum in callback order for determinism
+		const int fpb = io.framesPerBuffer();
+		for(unsigned i=0; i<numJobs; ++i) mMixSrcs[i] = mJobIO[i]->mBufO;
+		arr::mix(io.mBufO, &mMixSrcs[0], numJobs, io.channelsOut() * fpb);
+		if(io.channelsBus()){
+			for(unsigned i=0; i<numJobs; ++i) mMixSrcs[i] = mJobIO[i]->mBufB;
+			arr::mix(io.mBufB, &mMixSrcs[0], numJobs, io.channelsBus() * fpb);
+		}
+	}
+
+	void runJobs(){
+		// The job count is read after claiming since a late worker may 
+		// claim a job from the next block
+		while(true){
+			unsigned i = mJobNext.fetch_add(1, std::memory_order_acquire);
+			if(i >= mNumJobs.load(std::memory_order_relaxed)) break;
+			AudioIOData& v = *mJobIO[i];
+			v.zeroOut();
+			v.zeroBus();
+			v.frame(0);
+			(*mCallbacks.load(std::memory_order_relaxed))[i]->onAudio(v);
+			mJobsDone.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	template <class T>
+	static void inc(std::atomic<T>& v, T d = 1){
+		v.store(v.load(std::memory_order_relaxed) + d, std::memory_order_relaxed);
+	}
+
+	// Histogram written only by the audio thread and read under mTelemetrySeq
+	struct AtomicHistogram{
+		std::atomic<uint64_t> count, total, max;
+		std::atomic<uint32_t> bins[AudioTimeHistogram::NUM_BINS];
+
+		AtomicHistogram(){ reset(); }
+
+		void reset(){
+			count.store(0, std::memory_order_relaxed);
+			total.store(0, std::memory_order_relaxed);
+			max.store(0, std::memory_order_relaxed);
+			for(auto& b : bins) b.store(0, std::memory_order_relaxed);
+		}
+
+		void add(uint64_t dt){
+			inc(bins[AudioTimeHistogram::bin(dt)], 1u);
+			inc(count, uint64_t(1));
+			inc(total, dt);
+			if(dt > max.load(std::memory_order_relaxed)) max.store(dt, std::memory_order_relaxed);
+		}
+
+		void copy(AudioTimeHistogram& h) const {
+			h.count = count.load(std::memory_order_relaxed);
+			h.total = total.load(std::memory_order_relaxed);
+			h.max = max.load(std::memory_order_relaxed);
+			for(int i=0; i<AudioTimeHistogram::NUM_BINS; ++i) h.bins[i] = bins[i].load(std::memory_order_relaxed);
+		}
+	};
+
+	// Add timing and status of a callback to the telemetry. Readers retry
+	// while the sequence number is odd or has changed.
+	void record(nsec_t start, nsec_t end, nsec_t period, PaStreamCallbackFlags flags){
+		unsigned seq = mTelemetrySeq.load(std::memory_order_relaxed);
+		mTelemetrySeq.store(seq+1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		if(mTelemetryReset.exchange(false, std::memory_order_acquire)){
+			mJitter.reset(); mDuration.reset(); mMargin.reset();
+			for(auto * c : {&mBlocks, &mLate, &mInUnder, &mInOver, &mOutUnder, &mOutOver}){
+				c->store(0, std::memory_order_relaxed);
+			}
+		}
+
+		if(mPrevStart){
+			nsec_t d = start - mPrevStart - period;
+			mJitter.add(d < 0 ? -d : d);
+		}
+		mPrevStart = start;
+
+		nsec_t dur = end - start;
+		mDuration.add(dur);
+		double load = mLoad.load(std::memory_order_relaxed);
+		mLoad.store(load + 0.1*(double(dur)/period - load), std::memory_order_relaxed);
+		if(dur > period){
+			inc(mLate, uint64_t(1));
+			mMargin.add(0);
+		}
+		else{
+			mMargin.add(period - dur);
+		}
+		inc(mBlocks, uint64_t(1));
+
+		if(flags & paInputUnderflow)	inc(mInUnder, uint64_t(1));
+		if(flags & paInputOverflow)		inc(mInOver, uint64_t(1));
+		if(flags & paOutputUnderflow)	inc(mOutUnder, uint64_t(1));
+		if(flags & paOutputOverflow)	inc(mOutOver, uint64_t(1));
+
+		mTelemetrySeq.store(seq+2, std::memory_order_release);
+	}
+
+	void telemetry(AudioTelemetry& dst) const {
+		unsigned s1, s2;
+		do{
+			s1 = mTelemetrySeq.load(std::memory_order_acquire);
+			mJitter.copy(dst.jitter);
+			mDuration.copy(dst.duration);
+			mMargin.copy(dst.margin);
+			dst.blocks = mBlocks.load(std::memory_order_relaxed);
+			dst.late = mLate.load(std::memory_order_relaxed);
+			dst.inputUnderflows = mInUnder.load(std::memory_order_relaxed);
+			dst.inputOverflows = mInOver.load(std::memory_order_relaxed);
+			dst.outputUnderflows = mOutUnder.load(std::memory_order_relaxed);
+			dst.outputOverflows = mOutOver.load(std::memory_order_relaxed);
+			std::atomic_thread_fence(std::memory_order_acquire);
+			s2 = mTelemetrySeq.load(std::memory_order_relaxed);
+		} while((s1 & 1) || s1 != s2);
+	}
+
+	static void * cWorkerFunc(void * user){
+		Impl& m = *(Impl *)user;
+		unsigned gen = m.mGeneration.load(std::memory_order_acquire);
+		unsigned spins = 0;
+		while(m.mWorkersRunning.load(std::memory_order_relaxed)){
+			unsigned g = m.mGeneration.load(std::memory_order_acquire);
+			if(g != gen){
+				gen = g;
+				spins = 0;
+				// Match the denormal mode of the callback thread
+				DenormalGuard::flushToZero(m.mFlushDenormals.load(std::memory_order_relaxed));
+				RTScope rt;
+				m.runJobs();
+			}
+			else if(++spins > 1000){
+				std::this_thread::yield();
+			}
+		}
+		return NULL;
+	}
+
+	bool headless() const { return AudioIO::OFFLINE == mBackend || AudioIO::SIMULATED == mBackend; }
+	bool native() const { return AudioIO::JACK == mBackend || AudioIO::ALSA == mBackend; }
+
+	// Process blocks of a headless stream, or until stopped if numBlocks is 0
+	void runHeadless(AudioIO& io, uint64_t numBlocks){
+		const int fpb = io.framesPerBuffer();
+		const nsec_t period = toNSec(io.secondsPerBuffer());
+		const bool sim = AudioIO::SIMULATED == mBackend;
+		if(io.channelsIn()) std::memset(io.mBufI, 0, io.channelsIn()*fpb*sizeof(float));
+		nsec_t deadline = timeNow();
+
+		for(uint64_t b=0; numBlocks ? b<numBlocks : mHeadlessRun.load(std::memory_order_relaxed); ++b){
+			if(sim) sleepUntil(deadline);
+			const nsec_t start = timeNow();
+			DenormalGuard denormals(io.flushDenormals());
+			RTScope rt;
+
+			if(io.autoZeroOut()) io.zeroOut();
+			io.processAudio();
+
+			float gain = io.mGainPrev;
+			float dgain = (io.mGain-io.mGainPrev) / fpb;
+			if(io.usingGain() || io.zeroNANs() || io.clipOut()){
+				for(int j=0; j<io.channelsOut(); ++j){
+					float * o = io.outBuffer(j);
+					arr::gainNaNClip(o, o, fpb, gain, dgain, io.zeroNANs(), io.clipOut());
+				}
+			}
+			io.mGainPrev = io.mGain;
+
+			const nsec_t end = timeNow();
+			PaStreamCallbackFlags flags = 0;
+			if(sim){
+				deadline += period;
+				// A device would have run out of output, so start over from now
+				if(end > deadline){
+					flags = paOutputUnderflow;
+					deadline = end;
+				}
+			}
+			record(start, end, period, flags);
+			mFrames.store(mFrames.load(std::memory_order_relaxed) + fpb, std::memory_order_relaxed);
+		}
+	}
+
+	static void * cHeadlessFunc(void * user){
+		AudioIO& io = *(AudioIO *)user;
+		io.mImpl->runHeadless(io, 0);
+		return NULL;
+	}
+
+	bool startHeadless(AudioIO& io){
+		mHeadlessRun = true;
+		if(!mHeadless.start(cHeadlessFunc, &io)){
+			mHeadlessRun = false;
+			return false;
+		}
+		// Only a simulated device has a deadline worth the priority
+		if(AudioIO::SIMULATED == mBackend) mHeadless.realtime();
+		return true;
+	}
+
+	// Channels of native backends are all device channels, up to what the
+	// device has. Host buffers are passed to processHost() as they are, with
+	// pointers per channel when non-interleaved.
+	bool openNative(AudioIO& io){
+		mNativeIn = mNativeOut = 0;
+		mNativeFlags.store(0, std::memory_order_relaxed);
+		mNativeDead.store(false, std::memory_order_relaxed);
+		bool ok = false;
+		#ifdef GAM_AUDIO_IO_JACK
+		if(AudioIO::JACK == mBackend) ok = openJack(io);
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		if(AudioIO::ALSA == mBackend) ok = openAlsa(io);
+		#endif
+		if(!ok){
+			if(!nativeBuilt()) warn("backend was not enabled in this build", "AudioIO");
+			mNativeIn = mNativeOut = 0;
+			return false;
+		}
+		mPtrs.resize(std::max(mNativeIn, mNativeOut));
+		mHostIn.resize(mNativeIn);
+		mHostOut.resize(mNativeOut);
+		mIsOpen = true;
+		return true;
+	}
+
+	bool nativeBuilt() const {
+		#ifdef GAM_AUDIO_IO_JACK
+		if(AudioIO::JACK == mBackend) return true;
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		if(AudioIO::ALSA == mBackend) return true;
+		#endif
+		return false;
+	}
+
+	bool startNative(AudioIO& io){
+		#ifdef GAM_AUDIO_IO_JACK
+		if(AudioIO::JACK == mBackend) return startJack();
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		if(AudioIO::ALSA == mBackend) return startAlsa(io);
+		#endif
+		return false;
+	}
+
+	void stopNative(){
+		#ifdef GAM_AUDIO_IO_JACK
+		if(AudioIO::JACK == mBackend && mJack && !mNativeDead.load()) jack_deactivate(mJack);
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		if(AudioIO::ALSA == mBackend){
+			mNativeRun = false;
+			mNativeThread.join();
+			if(mPcmOut) snd_pcm_drop(mPcmOut);
+			if(mPcmIn) snd_pcm_drop(mPcmIn);
+		}
+		#endif
+	}
+
+	void closeNative(){
+		#ifdef GAM_AUDIO_IO_JACK
+		// A client shut down by the server must not be closed
+		if(mJack){ if(!mNativeDead.load()) jack_client_close(mJack); mJack = 0; }
+		mJackIn.clear(); mJackOut.clear();
+		#endif
+		#ifdef GAM_AUDIO_IO_ALSA
+		if(mPcmIn){ snd_pcm_close(mPcmIn); mPcmIn = 0; }
+		if(mPcmOut){ snd_pcm_close(mPcmOut); mPcmOut = 0; }
+		#endif
+		mNativeIn = mNativeOut = 0;
+	}
+
+	// Take the block size or rate of a server or device when it differs
+	static void adopt(AudioIO& io, int fpb, double fps){
+		if(fpb != io.framesPerBuffer()){
+			warn("using block size of audio server or device", "AudioIO");
+			io.framesPerBuffer(fpb);
+		}
+		if(fps != io.framesPerSecond()){
+			warn("using frame rate of audio server or device", "AudioIO");
+			io.mFramesPerSecond = fps;
+		}
+	}
+
+	#ifdef GAM_AUDIO_IO_JACK
+	bool openJack(AudioIO& io){
+		jack_status_t status;
+		const char * name = mNativeName.empty() ? "Gamma" : mNativeName.c_str();
+		mJack = jack_client_open(name, JackNoStartServer, &status);
+		if(!mJack){
+			warn("could not connect to JACK server", "AudioIO");
+			return false;
+		}
+		adopt(io, jack_get_buffer_size(mJack), jack_get_sample_rate(mJack));
+
+		char portName[32];
+		for(int i=0; i<io.channelsIn(); ++i){
+			snprintf(portName, sizeof portName, "in_%d", i+1);
+			jack_port_t * p = jack_port_register(mJack, portName, JACK_DEFAULT_AUDIO_TYPE, JackPortIsInput, 0);
+			if(!p) break;
+			mJackIn.push_back(p);
+		}
+		for(int i=0; i<io.channelsOut(); ++i){
+			snprintf(portName, sizeof portName, "out_%d", i+1);
+			jack_port_t * p = jack_port_register(mJack, portName, JACK_DEFAULT_AUDIO_TYPE, JackPortIsOutput, 0);
+			if(!p) break;
+			mJackOut.push_back(p);
+		}
+		mNativeIn = mJackIn.size();
+		mNativeOut = mJackOut.size();
+
+		jack_set_process_callback(mJack, jackProcess, &io);
+		jack_set_xrun_callback(mJack, jackXrun, this);
+		jack_on_shutdown(mJack, jackShutdown, this);
+		return true;
+	}
+
+	bool startJack(){
+		if(jack_activate(mJack)){
+			warn("could not activate JACK client", "AudioIO");
+			return false;
+		}
+		// Connect to physical ports in order
+		connectJack(mJackOut, JackPortIsPhysical | JackPortIsInput, true);
+		connectJack(mJackIn, JackPortIsPhysical | JackPortIsOutput, false);
+		return true;
+	}
+
+	void connectJack(const std::vector<jack_port_t *>& ports, unsigned long flags, bool isOut){
+		const char ** phys = jack_get_ports(mJack, NULL, JACK_DEFAULT_AUDIO_TYPE, flags);
+		if(!phys) return;
+		for(unsigned i=0; i<ports.size() && phys[i]; ++i){
+			const char * ours = jack_port_name(ports[i]);
+			if(isOut)	jack_connect(mJack, ours, phys[i]);
+			else		jack_connect(mJack, phys[i], ours);
+		}
+		jack_free(phys);
+	}
+
+	static int jackProcess(jack_nframes_t frames, void * user){
+		AudioIO& io = *(AudioIO *)user;
+		Impl& m = *io.mImpl;
+		for(int c=0; c<m.mNativeOut; ++c) m.mHostOut[c] = jack_port_get_buffer(m.mJackOut[c], frames);
+
+		// The block size can only change by way of the server
+		if(int(frames) != io.framesPerBuffer()){
+			for(int c=0; c<m.mNativeOut; ++c) std::memset(m.mHostOut[c], 0, frames*sizeof(float));
+			return 0;
+		}
+
+		for(int c=0; c<m.mNativeIn; ++c) m.mHostIn[c] = jack_port_get_buffer(m.mJackIn[c], frames);
+		processHost(io, m.mHostIn.data(), m.mHostOut.data(), m.mNativeFlags.exchange(0, std::memory_order_relaxed), true);
+		return 0;
+	}
+
+	static int jackXrun(void * user){
+		Impl& m = *(Impl *)user;
+		m.mNativeFlags.fetch_or(paOutputUnderflow, std::memory_order_relaxed);
+		return 0;
+	}
+
+	// Called on a JACK thread; the control thread sees the flag on start()
+	static void jackShutdown(void * user){
+		Impl& m = *(Impl *)user;
+		m.mNativeDead.store(true);
+	}
+	#endif
+
+	#ifdef GAM_AUDIO_IO_ALSA
+	snd_pcm_format_t alsaFormat() const {
+		switch(mFormat){
+		case AudioIO::INT16: return SND_PCM_FORMAT_S16;
+		case AudioIO::INT24: return SND_PCM_FORMAT_S24_3LE;
+		case AudioIO::INT32: return SND_PCM_FORMAT_S32;
+		default:			 return SND_PCM_FORMAT_FLOAT;
+		}
+	}
+
+	// Open a PCM for mmap transfers of whole blocks in a ring of 2 blocks
+	snd_pcm_t * openPcm(AudioIO& io, snd_pcm_stream_t dir, int& chans){
+		const char * name = mNativeName.empty() ? "default" : mNativeName.c_str();
+		snd_pcm_t * pcm = 0;
+		if(snd_pcm_open(&pcm, name, dir, 0) < 0){
+			warn("could not open ALSA device", "AudioIO");
+			return 0;
+		}
+
+		snd_pcm_hw_params_t * hw;
+		snd_pcm_hw_params_malloc(&hw);
+		snd_pcm_hw_params_any(pcm, hw);
+		unsigned ch = chans;
+		unsigned rate = (unsigned)io.framesPerSecond();
+		unsigned periods = 2;
+		snd_pcm_uframes_t period = io.framesPerBuffer();
+		int dirn = 0;
+		bool ok =
+			snd_pcm_hw_params_set_access(pcm, hw, mNonInterleaved ? SND_PCM_ACCESS_MMAP_NONINTERLEAVED : SND_PCM_ACCESS_MMAP_INTERLEAVED) >= 0
+			&& snd_pcm_hw_params_set_format(pcm, hw, mAlsaFormat) >= 0
+			&& snd_pcm_hw_params_set_channels_near(pcm, hw, &ch) >= 0
+			&& snd_pcm_hw_params_set_rate_near(pcm, hw, &rate, &dirn) >= 0
+			&& snd_pcm_hw_params_set_period_size_near(pcm, hw, &period, &dirn) >= 0
+			&& snd_pcm_hw_params_set_periods_near(pcm, hw, &periods, &dirn) >= 0
+			&& snd_pcm_hw_params(pcm, hw) >= 0;
+		snd_pcm_hw_params_free(hw);
+
+		// Channels beyond those requested would have no buffers
+		if(!ok || int(ch) > chans){
+			warn("ALSA device does not support stream settings", "AudioIO");
+			snd_pcm_close(pcm);
+			return 0;
+		}
+
+		// A second PCM must match the block size and rate of the first
+		if(mPcmOut && (int(period) != io.framesPerBuffer() || double(rate) != io.framesPerSecond())){
+			warn("ALSA capture and playback settings differ", "AudioIO");
+			snd_pcm_close(pcm);
+			return 0;
+		}
+		adopt(io, period, rate);
+
+		// Start explicitly and wake for each block
+		snd_pcm_sw_params_t * sw;
+		snd_pcm_uframes_t boundary;
+		snd_pcm_sw_params_malloc(&sw);
+		snd_pcm_sw_params_current(pcm, sw);
+		snd_pcm_sw_params_get_boundary(sw, &boundary);
+		snd_pcm_sw_params_set_start_threshold(pcm, sw, boundary);
+		snd_pcm_sw_params_set_avail_min(pcm, sw, period);
+		snd_pcm_sw_params(pcm, sw);
+		snd_pcm_sw_params_free(sw);
+
+		chans = ch;
+		return pcm;
+	}
+
+	bool openAlsa(AudioIO& io){
+		mAlsaFormat = alsaFormat();
+		if(io.channelsOut()){
+			mNativeOut = io.channelsOut();
+			mPcmOut = openPcm(io, SND_PCM_STREAM_PLAYBACK, mNativeOut);
+			if(!mPcmOut) return false;
+		}
+		if(io.channelsIn()){
+			mNativeIn = io.channelsIn();
+			mPcmIn = openPcm(io, SND_PCM_STREAM_CAPTURE, mNativeIn);
+			if(!mPcmIn){ closeNative(); return false; }
+		}
+		if(mPcmIn && mPcmOut) mAlsaLinked = 0 == snd_pcm_link(mPcmIn, mPcmOut);
+		return mPcmIn || mPcmOut;
+	}
+
+	bool startAlsa(AudioIO& io){
+		if(!restartAlsa()) return false;
+		mNativeRun = true;
+		if(!mNativeThread.start(cAlsaFunc, &io)){
+			mNativeRun = false;
+			return false;
+		}
+		mNativeThread.realtime();
+		return true;
+	}
+
+	// Prepare, fill output with silence and start
+	bool restartAlsa(){
+		if(mPcmOut){
+			snd_pcm_drop(mPcmOut);
+			snd_pcm_prepare(mPcmOut);
+			const snd_pcm_channel_area_t * areas;
+			snd_pcm_uframes_t offset, frames = snd_pcm_avail_update(mPcmOut);
+			if(snd_pcm_mmap_begin(mPcmOut, &areas, &offset, &frames) < 0) return false;
+			snd_pcm_areas_silence(areas, offset, mNativeOut, frames, mAlsaFormat);
+			snd_pcm_mmap_commit(mPcmOut, offset, frames);
+		}
+		if(mPcmIn && !mAlsaLinked){
+			snd_pcm_drop(mPcmIn);
+			snd_pcm_prepare(mPcmIn);
+		}
+		if(mPcmOut && snd_pcm_start(mPcmOut) < 0) return false;
+		if(mPcmIn && !mAlsaLinked && snd_pcm_start(mPcmIn) < 0) return false;
+		return true;
+	}
+
+	// Wait until a block can be transferred. Returns false after an xrun.
+	bool waitPcm(snd_pcm_t * pcm, snd_pcm_uframes_t frames){
+		while(mNativeRun.load(std::memory_order_relaxed)){
+			snd_pcm_sframes_t avail = snd_pcm_avail_update(pcm);
+			if(avail < 0) return false;
+			if(snd_pcm_uframes_t(avail) >= frames) return true;
+			if(snd_pcm_wait(pcm, 1000) < 0) return false;
+		}
+		return false;
+	}
+
+	// Map the next block of a PCM's ring buffer as a processHost() argument
+	void * beginPcm(snd_pcm_t * pcm, std::vector<void *>& ptrs, snd_pcm_uframes_t& offset, snd_pcm_uframes_t frames){
+		const snd_pcm_channel_area_t * areas;
+		snd_pcm_uframes_t got = frames;
+		if(snd_pcm_mmap_begin(pcm, &areas, &offset, &got) < 0) return 0;
+		// Blocks are aligned to the ring, so they are never split
+		if(got != frames){
+			snd_pcm_mmap_commit(pcm, offset, 0);
+			return 0;
+		}
+		for(unsigned c=0; c<ptrs.size(); ++c){
+			ptrs[c] = (char *)areas[c].addr + (areas[c].first + offset*areas[c].step)/8;
+		}
+		return mNonInterleaved ? (void *)ptrs.data() : ptrs[0];
+	}
+
+	static void * cAlsaFunc(void * user){
+		AudioIO& io = *(AudioIO *)user;
+		io.mImpl->runAlsa(io);
+		return NULL;
+	}
+
+	void runAlsa(AudioIO& io){
+		const snd_pcm_uframes_t fpb = io.framesPerBuffer();
+		while(mNativeRun.load(std::memory_order_relaxed)){
+			snd_pcm_uframes_t offI = 0, offO = 0;
+			void * input = 0, * output = 0;
+			bool ok = (!mPcmIn  || waitPcm(mPcmIn , fpb))
+				&&    (!mPcmOut || waitPcm(mPcmOut, fpb))
+				&&    (!mPcmIn  || (input  = beginPcm(mPcmIn , mHostIn , offI, fpb)))
+				&&    (!mPcmOut || (output = beginPcm(mPcmOut, mHostOut, offO, fpb)));
+
+			if(ok){
+				processHost(io, input, output, mNativeFlags.exchange(0, std::memory_order_relaxed));
+				ok =  (!mPcmIn  || snd_pcm_mmap_commit(mPcmIn , offI, fpb) == snd_pcm_sframes_t(fpb))
+					&&(!mPcmOut || snd_pcm_mmap_commit(mPcmOut, offO, fpb) == snd_pcm_sframes_t(fpb));
+			}
+			if(!ok && mNativeRun.load(std::memory_order_relaxed)){
+				// Count the xrun with the next block
+				PaStreamCallbackFlags f = 0;
+				if(mPcmIn  && snd_pcm_state(mPcmIn ) == SND_PCM_STATE_XRUN) f |= paInputOverflow;
+				if(mPcmOut && snd_pcm_state(mPcmOut) == SND_PCM_STATE_XRUN) f |= paOutputUnderflow;
+				mNativeFlags.fetch_or(f, std::memory_order_relaxed);
+				if(!restartAlsa()){
+					warnRT("AudioIO", "could not restart ALSA device");
+					mNativeDead.store(true);
+					break;
+				}
+			}
+		}
+	}
+	#endif
+
+	PaSampleFormat sampleFormat() const {
+		PaSampleFormat f = paFloat32;
+		switch(mFormat){
+		case AudioIO::INT16: f = paInt16; break;
+		case AudioIO::INT24: f = paInt24; break;
+		case AudioIO::INT32: f = paInt32; break;
+		default:;
+		}
+		return mNonInterleaved ? (f | paNonInterleaved) : f;
+	}
+
+	// Convert integer host input into the input buffers
+	void convertIn(AudioIOData& io, const void * input){
+		int fpb = io.framesPerBuffer();
+		int chans = std::min(io.channelsInDevice(), int(mPtrs.size()));
+		for(int c=0; c<chans; ++c) mPtrs[c] = const_cast<float *>(&io.in(c,0));
+
+		if(mNonInterleaved){
+			const void * const * host = (const void * const *)input;
+			for(int c=0; c<chans; ++c) fromPCM(&mPtrs[c], host[c], fpb, 1);
+		}
+		else{
+			fromPCM(&mPtrs[0], input, fpb, chans);
+		}
+	}
+
+	// Convert the output buffers into integer host output
+	void convertOut(AudioIOData& io, void * output){
+		int fpb = io.framesPerBuffer();
+		int chans = std::min(io.channelsOutDevice(), int(mPtrs.size()));
+		for(int c=0; c<chans; ++c) mPtrs[c] = io.outBuffer(c);
+
+		if(mNonInterleaved){
+			void * const * host = (void * const *)output;
+			for(int c=0; c<chans; ++c) toPCM(host[c], &mPtrs[c], fpb, 1);
+		}
+		else{
+			toPCM(output, &mPtrs[0], fpb, chans);
+		}
+	}
+
+	void fromPCM(float * const * dst, const void * src, int frames, int chans){
+		switch(mFormat){
+		case AudioIO::INT16: arr::fromPCM16(dst, (const int16_t *)src, frames, chans); break;
+		case AudioIO::INT24: arr::fromPCM24(dst, (const uint8_t *)src, frames, chans); break;
+		case AudioIO::INT32: arr::fromPCM32(dst, (const int32_t *)src, frames, chans); break;
+		default:;
+		}
+	}
+
+	void toPCM(void * dst, const float * const * src, int frames, int chans){
+		switch(mFormat){
+		case AudioIO::INT16: arr::toPCM16((int16_t *)dst, src, frames, chans, &mDither); break;
+		case AudioIO::INT24: arr::toPCM24((uint8_t *)dst, src, frames, chans); break;
+		case AudioIO::INT32: arr::toPCM32((int32_t *)dst, src, frames, chans); break;
+		default:;
+		}
+	}
+
+	// Map host's non-interleaved input buffers into the I/O data, pointing 
+	// at them directly if possible. Returns whether pointers were changed.
+	static bool mapIn(AudioIOData& io, const float * const * host){
+		int fpb = io.framesPerBuffer();
+		int chans = io.channelsInDevice();
+		if(0 == chans || 0 == host) return false;
+		if(chans == io.channelsIn() && contiguous(host, chans, fpb)){
+			io.mBufI = const_cast<float *>(host[0]);
+			return true;
+		}
+		for(int c=0; c<chans; ++c){
+			std::memcpy(io.mBufI + c*fpb, host[c], fpb*sizeof(float));
+		}
+		return false;
+	}
+
+	// Point output buffer at host's if possible
+	static bool mapOut(AudioIOData& io, float * const * host){
+		int chans = io.channelsOutDevice();
+		if(chans == io.channelsOut() && chans && host && contiguous(host, chans, io.framesPerBuffer())){
+			io.mBufO = host[0];
+			return true;
+		}
+		return false;
+	}
+
+	static int paCallback(
+		const void *input,
+		void *output,
+		unsigned long frameCount,
+		const PaStreamCallbackTimeInfo* timeInfo,
+		PaStreamCallbackFlags statusFlags,
+		void *userData
+	);
+
+	// Process a block of host buffers laid out as set for the stream, or as
+	// non-interleaved floats if 'planarFloat' is true
+	static void processHost(
+		AudioIO& io, const void * input, void * output,
+		PaStreamCallbackFlags statusFlags, bool planarFloat = false
+	);
 
 	bool error() const { return mErrNum != paNoError; }
 
@@ -171,6 +902,8 @@ public:
 	bool supportsFPS(double fps) const {
 		const PaStreamParameters * pi = mInParams.channelCount  == 0 ? 0 : &mInParams;
 		const PaStreamParameters * po = mOutParams.channelCount == 0 ? 0 : &mOutParams;	
+		// Any rate will do without a device; native backends settle on open
+		if(AudioIO::DEVICE != mBackend || (!pi && !po)) return true;
 		mErrNum = Pa_IsFormatSupported(pi, po, fps);
 		printError("AudioIO::Impl::supportsFPS");
 		return paFormatIsSupported == mErrNum;
@@ -183,6 +916,12 @@ public:
 
 	bool close(){
 		mErrNum = paNoError;
+		if(headless() || native()){
+			stop();
+			if(native()) closeNative();
+			mIsOpen = false;
+			return true;
+		}
 		if(mIsOpen) mErrNum = Pa_CloseStream(mStream);
 		if(paNoError == mErrNum){
 			mIsOpen = false;
@@ -193,6 +932,17 @@ public:
 
 	bool stop(){
 		mErrNum = paNoError;
+		if(headless() || native()){
+			if(mIsRunning){
+				if(native()) stopNative();
+				else{
+					mHeadlessRun = false;
+					mHeadless.join();
+				}
+				mIsRunning = false;
+			}
+			return true;
+		}
 		if(mIsRunning)				mErrNum = Pa_StopStream(mStream);
 		if(paNoError == mErrNum)	mIsRunning = false;
 		return paNoError == mErrNum;
@@ -203,6 +953,53 @@ public:
 	mutable PaError mErrNum;			// Most recent error number
 	bool mIsOpen;						// An audio device is open
 	bool mIsRunning;					// An audio stream is running
+	bool mNonInterleaved;				// Host buffers are non-interleaved
+	AudioIO::SampleFormat mFormat;		// Sample format of host buffers
+	uint32_t mDither;					// Dither state for 16-bit output
+	std::vector<float *> mPtrs;			// Channel pointers for format conversion
+
+	std::vector<Thread *> mWorkers;		// Threads running appended callbacks
+	std::vector<AudioIOData *> mJobIO;	// Views with private output and bus per callback
+	std::vector<float> mJobBufs;		// Private output and bus buffers
+	std::vector<const float *> mMixSrcs;
+	std::atomic<const std::vector<AudioCallback *> *> mCallbacks;
+	std::atomic<unsigned> mNumJobs;
+	std::atomic<unsigned> mGeneration;	// Incremented for each new block of jobs
+	std::atomic<unsigned> mJobNext;		// Index of next job to claim
+	std::atomic<unsigned> mJobsDone;
+	std::atomic<bool> mWorkersRunning;
+	std::atomic<bool> mFlushDenormals;	// Denormal mode of callback thread
+	int mJobFrames, mJobOuts, mJobBuses;
+
+	AtomicHistogram mJitter, mDuration, mMargin;
+	std::atomic<uint64_t> mBlocks, mLate;
+	std::atomic<uint64_t> mInUnder, mInOver, mOutUnder, mOutOver;
+	std::atomic<unsigned> mTelemetrySeq;	// Odd while telemetry is written
+	std::atomic<bool> mTelemetryReset;	// Request from other thread to reset
+	nsec_t mPrevStart;					// Start time of previous callback
+
+	AudioIO::Backend mBackend;
+	Thread mHeadless;					// Thread running a started headless stream
+	std::atomic<bool> mHeadlessRun;
+	std::atomic<uint64_t> mFrames;		// Frames processed
+	std::atomic<double> mLoad;			// Smoothed load of callbacks
+
+	std::string mNativeName;			// JACK client or ALSA device name
+	int mNativeIn, mNativeOut;			// Device channels of native backend
+	std::vector<void *> mHostIn, mHostOut;	// Host buffers per channel
+	std::atomic<PaStreamCallbackFlags> mNativeFlags;	// Xruns since last block
+	std::atomic<bool> mNativeDead;		// Set by backend thread when stream died
+	#ifdef GAM_AUDIO_IO_JACK
+	jack_client_t * mJack;
+	std::vector<jack_port_t *> mJackIn, mJackOut;
+	#endif
+	#ifdef GAM_AUDIO_IO_ALSA
+	snd_pcm_t * mPcmIn, * mPcmOut;
+	snd_pcm_format_t mAlsaFormat;
+	bool mAlsaLinked;					// Capture starts with playback
+	Thread mNativeThread;				// Thread transferring blocks
+	std::atomic<bool> mNativeRun;
+	#endif
 };
 
 AudioIOData::AudioIOData(void * userData)
@@ -210,14 +1007,29 @@ AudioIOData::AudioIOData(void * userData)
 	mUser(userData),
 	mFramesPerBuffer(0), mFramesPerSecond(0),
 	mBufI(0), mBufO(0), mBufB(0), mBufT(0), mNumI(0), mNumO(0), mNumB(0),
+	mIsView(false),
 	mGain(1), mGainPrev(1)
 {}
 
+AudioIOData::AudioIOData(const AudioIOData& src, float * bufOut)
+:	mImpl(src.mImpl),
+	mUser(src.mUser),
+	mFrame(0),
+	mFramesPerBuffer(src.mFramesPerBuffer), mFramesPerSecond(src.mFramesPerSecond),
+	mBufI(src.mBufI), mBufO(bufOut), mBufB(src.mBufB), mBufT(0),
+	mNumI(src.mNumI), mNumO(src.mNumO), mNumB(src.mNumB),
+	mIsView(true),
+	mGain(1), mGainPrev(1)
+{
+	resize(mBufT, mFramesPerBuffer);
+}
+
 AudioIOData::~AudioIOData(){
+	deleteBuf(mBufT);
+	if(mIsView) return;
 	deleteBuf(mBufI);
 	deleteBuf(mBufO);
 	deleteBuf(mBufB);
-	deleteBuf(mBufT);
 }
 
 void AudioIOData::zeroBus(){ zero(mBufB, framesPerBuffer() * mNumB); }
@@ -226,31 +1038,31 @@ void AudioIOData::zeroOut(){ zero(mBufO, channelsOut() * framesPerBuffer()); }
 int AudioIOData::channelsIn () const { return mNumI; }
 int AudioIOData::channelsOut() const { return mNumO; }
 int AudioIOData::channelsBus() const { return mNumB; }
-int AudioIOData::channelsInDevice() const { return (int)mImpl->mInParams.channelCount; }
-int AudioIOData::channelsOutDevice() const { return (int)mImpl->mOutParams.channelCount; }
+int AudioIOData::channelsInDevice() const {
+	return mImpl->native() ? mImpl->mNativeIn : (int)mImpl->mInParams.channelCount;
+}
+int AudioIOData::channelsOutDevice() const {
+	return mImpl->native() ? mImpl->mNativeOut : (int)mImpl->mOutParams.channelCount;
+}
 
 double AudioIOData::framesPerSecond() const { return mFramesPerSecond; }
-double AudioIOData::time() const { return Pa_GetStreamTime(mImpl->mStream); }
+double AudioIOData::time() const {
+	if(AudioIO::DEVICE != mImpl->mBackend) return double(mImpl->mFrames.load(std::memory_order_relaxed)) / framesPerSecond();
+	return Pa_GetStreamTime(mImpl->mStream);
+}
 double AudioIOData::time(int frame) const { return (double)frame / framesPerSecond() + time(); }
 int AudioIOData::framesPerBuffer() const { return mFramesPerBuffer; }
 double AudioIOData::secondsPerBuffer() const { return (double)framesPerBuffer() / framesPerSecond(); }
 
 
 //==============================================================================
-static int paCallback(	const void *input,
-						void *output,
-						unsigned long frameCount,
-						const PaStreamCallbackTimeInfo* timeInfo,
-						PaStreamCallbackFlags statusFlags,
-						void *userData );
-
 AudioIO::AudioIO(
 	int framesPerBuf, double framesPerSec, void (* callbackA)(AudioIOData &), void * userData,
 	int outChansA, int inChansA)
 :	AudioIOData(userData),
 	callback(callbackA),
 	mInDevice(AudioDevice::defaultInput()), mOutDevice(AudioDevice::defaultOutput()),
-	mZeroNANs(true), mClipOut(true), mAutoZeroOut(true)
+	mZeroNANs(true), mClipOut(true), mAutoZeroOut(true), mFlushDenormals(true)
 {
 	init();
 	this->framesPerBuffer(framesPerBuf);
@@ -262,6 +1074,7 @@ AudioIO::AudioIO(
 		
 AudioIO::~AudioIO(){
 	close();
+	mImpl->parallel(1, false);
 }
 
 
@@ -315,7 +1128,7 @@ void AudioIO::deviceIn(const AudioDevice& v){
 		mImpl->inDevice(v.id());
 		const PaDeviceInfo * dInfo = Pa_GetDeviceInfo(mImpl->mInParams.device);	
 		if(dInfo) mImpl->mInParams.suggestedLatency = dInfo->defaultLowInputLatency; // for RT
-		mImpl->mInParams.sampleFormat = paFloat32;// | paNonInterleaved;
+		mImpl->mInParams.sampleFormat = mImpl->sampleFormat();
 		//mInParams.sampleFormat = paInt16;
 		mImpl->mInParams.hostApiSpecificStreamInfo = NULL;
 	}
@@ -330,7 +1143,7 @@ void AudioIO::deviceOut(const AudioDevice& v){
 		mImpl->outDevice(v.id());
 		const PaDeviceInfo * dInfo = Pa_GetDeviceInfo(mImpl->mOutParams.device);
 		if(dInfo) mImpl->mOutParams.suggestedLatency = dInfo->defaultLowOutputLatency; // for RT
-		mImpl->mOutParams.sampleFormat = paFloat32;// | paNonInterleaved;
+		mImpl->mOutParams.sampleFormat = mImpl->sampleFormat();
 		mImpl->mOutParams.hostApiSpecificStreamInfo = NULL;
 	}
 	else{
@@ -346,7 +1159,7 @@ void AudioIO::device(const AudioDevice& v){
 void AudioIO::channelsBus(int num){
 
 	if(mImpl->mIsOpen){
-		warn("the number of channels cannnot be set with the stream open", "AudioIO");
+		warn("the number of channels cannot be set with the stream open", "AudioIO");
 		return;
 	}
 
@@ -358,7 +1171,7 @@ void AudioIO::channelsBus(int num){
 void AudioIO::channels(int num, bool forOutput){
 
 	if(mImpl->mIsOpen){
-		warn("the number of channels cannnot be set with the stream open", "AudioIO");
+		warn("the number of channels cannot be set with the stream open", "AudioIO");
 		return;
 	}
 
@@ -370,16 +1183,16 @@ void AudioIO::channels(int num, bool forOutput){
 		return;
 	}
 
+	// Without a device, e.g. for a headless backend, all channels are virtual
 	const PaDeviceInfo * info = Pa_GetDeviceInfo(params->device);
-	if(0 == info){
+	if(0 == info && !mImpl->headless() && !mImpl->native()){
 		if(forOutput)	warn("attempt to set number of channels on invalid output device", "AudioIO");
 		else			warn("attempt to set number of channels on invalid input device", "AudioIO");
 		return;	// this particular device is not open, so return
 	}
 
-
 	// compute number of channels to give PortAudio
-	int maxChans = 
+	int maxChans = !info ? 0 :
 		(int)(forOutput ? info->maxOutputChannels : info->maxInputChannels);
 	
 	// -1 means open all channels
@@ -405,6 +1218,15 @@ bool AudioIO::open(){
 
 	i.mErrNum = paNoError;
 
+	if(i.headless()){
+		i.mIsOpen = true;
+		return true;
+	}
+
+	if(i.native()){
+		return i.mIsOpen || i.openNative(*this);
+	}
+
 	if(!(i.mIsOpen || i.mIsRunning)){
 		
 		PaStreamParameters * inParams = &i.mInParams;
@@ -415,6 +1237,8 @@ bool AudioIO::open(){
 		if((paNoDevice ==  inParams->device) || (0 ==  inParams->channelCount)) inParams  = 0;
 		if((paNoDevice == outParams->device) || (0 == outParams->channelCount)) outParams = 0;
 
+		i.mPtrs.resize(std::max(channelsInDevice(), channelsOutDevice()));
+
 		i.mErrNum = Pa_OpenStream(
 			&i.mStream,			// PortAudioStream **
 			inParams,			// PaStreamParameters * in
@@ -422,7 +1246,7 @@ bool AudioIO::open(){
 			mFramesPerSecond,	// frames/sec (double)
 			mFramesPerBuffer,	// frames/buffer (unsigned long)
 			paNoFlag,			// paNoFlag, paClipOff, paDitherOff
-			paCallback,			// static callback function (PaStreamCallback *)
+			Impl::paCallback,	// static callback function (PaStreamCallback *)
 			this
 		);
 
@@ -433,8 +1257,13 @@ bool AudioIO::open(){
 	return paNoError == i.mErrNum;
 }
 
+bool AudioIO::open(Backend b){
+	backend(b);
+	return backend() == b && open();
+}
+
 
-int paCallback(
+int AudioIOData::Impl::paCallback(
 	const void *input,
 	void *output,
 	unsigned long frameCount,
@@ -442,16 +1271,34 @@ int paCallback(
 	PaStreamCallbackFlags statusFlags,
 	void * userData
 ){
-	AudioIO& io = *(AudioIO *)userData;
-
-	const float * paI = (const float *)input;
-	float * paO = (float *)output;
-
-	bool bDeinterleave = true;
+	processHost(*(AudioIO *)userData, input, output, statusFlags);
+	return 0;
+}
 
-	if(bDeinterleave){
-		deinterleave(const_cast<float *>(&io.in(0,0)),  paI, io.framesPerBuffer(), io.channelsInDevice() );
-		//deinterleave(&io.out(0,0), paO, io.framesPerBuffer(), io.channelsOutDevice());
+void AudioIOData::Impl::processHost(
+	AudioIO& io, const void * input, void * output, PaStreamCallbackFlags statusFlags, bool planarFloat
+){
+	const nsec_t start = timeNow();
+	DenormalGuard denormals(io.flushDenormals());
+	RTScope rt;
+	const int fpb = io.framesPerBuffer();
+	const bool bConvert = !planarFloat && AudioIO::FLOAT32 != io.mImpl->mFormat;
+	const bool bDeinterleave = !planarFloat && !io.nonInterleaved() && !bConvert;
+
+	// Internal buffers to restore if host buffers are mapped
+	float * bufI = io.mBufI;
+	float * bufO = io.mBufO;
+	bool directI = false, directO = false;
+
+	if(bConvert){
+		if(input) io.mImpl->convertIn(io, input);
+	}
+	else if(bDeinterleave){
+		mem::deinterleave(const_cast<float *>(&io.in(0,0)), (const float *)input, fpb, io.channelsInDevice());
+	}
+	else{
+		directI = mapIn(io, (const float * const *)input);
+		directO = mapOut(io, (float * const *)output);
 	}
 	
 	if(io.autoZeroOut()) io.zeroOut();
@@ -460,46 +1307,40 @@ int paCallback(
 	io.processAudio();	// call callback
 
 
-	// apply smoothly-ramped gain to all output channels
-	if(io.usingGain()){
-	
-		float dgain = (io.mGain-io.mGainPrev) / io.framesPerBuffer();
-	
-		for(int j=0; j<io.channelsOutDevice(); ++j){
-			float * out = io.outBuffer(j);
-			float gain = io.mGainPrev;
-			
-			for(int i=0; i<io.framesPerBuffer(); ++i){
-				out[i] *= gain;
-				gain += dgain;
-			}
-		}
-		
-		io.mGainPrev = io.mGain;
+	// Apply smoothly-ramped gain, kill pesky nans so we don't hurt anyone's 
+	// ears and clip, all in one pass over each output channel. Output that
+	// is not mapped to the host is written to it in the same pass.
+	float gain = io.mGainPrev;
+	float dgain = (io.mGain-io.mGainPrev) / fpb;
+	bool post = io.usingGain() || io.zeroNANs() || io.clipOut();
+	float * const * paO = (float * const *)output;
+
+	for(int j=0; j<io.channelsOutDevice(); ++j){
+		float * src = io.outBuffer(j);
+		float * dst = (bDeinterleave || bConvert || directO) ? src : paO[j];
+		if(post)			arr::gainNaNClip(dst, src, fpb, gain, dgain, io.zeroNANs(), io.clipOut());
+		else if(dst != src)	std::memcpy(dst, src, fpb*sizeof(float));
 	}
+	io.mGainPrev = io.mGain;
 
-	// kill pesky nans so we don't hurt anyone's ears
-	if(io.zeroNANs()){
-		for(int i=0; i<io.framesPerBuffer()*io.channelsOutDevice(); ++i){
-			float& s = (&io.out(0,0))[i];
-			//if(isnan(s)) s = 0.f;
-			if(s != s) s = 0.f; // portable isnan; only nans do not equal themselves
-		}
+	if(bConvert){
+		if(output) io.mImpl->convertOut(io, output);
 	}
-	
-	if(io.clipOut()){
-		for(int i=0; i<io.framesPerBuffer()*io.channelsOutDevice(); ++i){
-			float& s = (&io.out(0,0))[i];
-			if		(s<-1.f) s =-1.f;
-			else if	(s> 1.f) s = 1.f;
-		}		
+	else if(bDeinterleave){
+		mem::interleave((float *)output, &io.out(0,0), fpb, io.channelsOutDevice());
 	}
 
-	if(bDeinterleave){
-		interleave(paO, &io.out(0,0), io.framesPerBuffer(), io.channelsOutDevice());
-	}
+	if(directI) io.mBufI = bufI;
+	if(directO) io.mBufO = bufO;
 
-	return 0;
+	const nsec_t end = timeNow();
+	if(tracing()){
+		traceThread("audio");
+		traceSpan("audio callback", start, end, &io);
+		if(statusFlags) traceInstant("xrun", &io);
+	}
+	io.mImpl->record(start, end, toNSec(io.secondsPerBuffer()), statusFlags);
+	io.mImpl->mFrames.store(io.mImpl->mFrames.load(std::memory_order_relaxed) + fpb, std::memory_order_relaxed);
 }
 
 
@@ -533,7 +1374,7 @@ void AudioIO::framesPerSecond(double v){	//printf("AudioIO::fps(%f)\n", v);
 
 void AudioIO::framesPerBuffer(int n){
 	if(mImpl->mIsOpen){
-		warn("the number of frames/buffer cannnot be set with the stream open", "AudioIO");
+		warn("the number of frames/buffer cannot be set with the stream open", "AudioIO");
 		return;
 	}
 
@@ -550,8 +1391,25 @@ void AudioIO::framesPerBuffer(int n){
 bool AudioIO::start(){
 	Impl& i = *mImpl;
 	i.mErrNum = paNoError;
-	if(!i.mIsOpen) open();
-	if(i.mIsOpen && !i.mIsRunning)	i.mErrNum = Pa_StartStream(i.mStream);
+	// A native stream that died on its own thread is reopened
+	if(i.native() && i.mNativeDead.load()) i.close();
+	if(!i.mIsOpen && !open()) return false;
+	if(!i.mIsRunning){
+		logStart(); // prints messages queued by the callback
+		i.mPrevStart = 0; // callback is not running, so jitter restarts
+		if(i.headless()){
+			if(!i.startHeadless(*this)){
+				warn("could not start headless stream thread", "AudioIO");
+				return false;
+			}
+		}
+		else if(i.native()){
+			if(!i.startNative(*this)) return false;
+		}
+		else{
+			i.mErrNum = Pa_StartStream(i.mStream);
+		}
+	}
 	if(paNoError == i.mErrNum)	mImpl->mIsRunning = true;
 	i.printError("Error in AudioIO::start()");
 	return paNoError == i.mErrNum;
@@ -586,6 +1444,11 @@ void AudioIO::print(){
 void AudioIO::processAudio(){ 
 	frame(0); 
 	if(callback) callback(*this); 
+
+	if(!mImpl->mWorkers.empty() && !mAudioCallbacks.empty()){
+		mImpl->processParallel(*this, mAudioCallbacks);
+		return;
+	}
 	
 	std::vector<AudioCallback *>::iterator iter = mAudioCallbacks.begin(); 
 	while(iter != mAudioCallbacks.end()){
@@ -595,7 +1458,121 @@ void AudioIO::processAudio(){
 }
 
 int AudioIO::channels(bool forOutput) const { return forOutput ? channelsOut() : channelsIn(); }
-double AudioIO::cpu() const { return Pa_GetStreamCpuLoad(mImpl->mStream); }
+double AudioIO::cpu() const {
+	if(DEVICE != mImpl->mBackend) return mImpl->mLoad.load(std::memory_order_relaxed);
+	return Pa_GetStreamCpuLoad(mImpl->mStream);
+}
 bool AudioIO::zeroNANs() const { return mZeroNANs; }
+bool AudioIO::nonInterleaved() const { return mImpl->mNonInterleaved; }
+
+void AudioIO::nonInterleaved(bool v){
+	if(mImpl->mIsOpen){
+		warn("the sample layout cannot be set with the stream open", "AudioIO");
+		return;
+	}
+	mImpl->mNonInterleaved = v;
+	mImpl->mInParams.sampleFormat = mImpl->sampleFormat();
+	mImpl->mOutParams.sampleFormat = mImpl->sampleFormat();
+}
+
+AudioIO& AudioIO::parallel(unsigned numThreads, bool pin){
+	if(mImpl->mIsRunning){
+		warn("the number of threads cannot be set with the stream running", "AudioIO");
+		return *this;
+	}
+	mImpl->parallel(numThreads, pin);
+	return *this;
+}
+
+AudioIO::Backend AudioIO::backend() const { return mImpl->mBackend; }
+
+void AudioIO::backend(Backend v){
+	if(mImpl->mIsOpen){
+		warn("the backend cannot be set with the stream open", "AudioIO");
+		return;
+	}
+	mImpl->mBackend = v;
+}
+
+void AudioIO::nativeDevice(const std::string& name){
+	if(mImpl->mIsOpen){
+		warn("the native device cannot be set with the stream open", "AudioIO");
+		return;
+	}
+	mImpl->mNativeName = name;
+}
+
+bool AudioIO::render(uint64_t numBlocks){
+	Impl& i = *mImpl;
+	if(!i.headless() || i.mIsRunning){
+		warn("blocks can only be rendered by a headless stream that is not running", "AudioIO");
+		return false;
+	}
+	if(!i.mIsOpen) open();
+	i.mPrevStart = 0;
+	i.runHeadless(*this, numBlocks);
+	return true;
+}
+
+unsigned AudioIO::threads() const { return mImpl->mWorkers.size() + 1; }
+
+void AudioIO::telemetry(AudioTelemetry& dst) const {
+	mImpl->telemetry(dst);
+	dst.period = secondsPerBuffer();
+}
+
+void AudioIO::resetTelemetry(){ mImpl->mTelemetryReset.store(true, std::memory_order_release); }
+
+
+void AudioTimeHistogram::reset(){
+	count = total = max = 0;
+	for(unsigned i=0; i<NUM_BINS; ++i) bins[i] = 0;
+}
+
+double AudioTimeHistogram::percentile(double frac) const {
+	if(!count) return 0;
+	uint64_t target = uint64_t(frac * count + 0.5);
+	uint64_t sum = 0;
+	for(unsigned i=0; i<NUM_BINS-1; ++i){
+		sum += bins[i];
+		if(sum >= target){
+			uint64_t edge = binStart(i+1);
+			return double(edge < max ? edge : max);
+		}
+	}
+	return double(max);
+}
+
+void AudioTelemetry::reset(){
+	jitter.reset(); duration.reset(); margin.reset();
+	blocks = late = 0;
+	inputUnderflows = inputOverflows = outputUnderflows = outputOverflows = 0;
+	period = 0;
+}
+
+void AudioTelemetry::print() const {
+	printf("%llu blocks of %.3f ms, %llu late, %llu xruns (in: %llu under, %llu over; out: %llu under, %llu over)\n",
+		(unsigned long long)blocks, period*1e3, (unsigned long long)late, (unsigned long long)xruns(),
+		(unsigned long long)inputUnderflows, (unsigned long long)inputOverflows,
+		(unsigned long long)outputUnderflows, (unsigned long long)outputOverflows);
+	printf("duration: mean %8.1f us, 99%% <= %8.1f us, max %8.1f us\n",
+		duration.mean()*1e-3, duration.percentile(0.99)*1e-3, duration.max*1e-3);
+	printf("jitter:   mean %8.1f us, 99%% <= %8.1f us, max %8.1f us\n",
+		jitter.mean()*1e-3, jitter.percentile(0.99)*1e-3, jitter.max*1e-3);
+	printf("margin:   mean %8.1f us,  1%% <= %8.1f us\n",
+		margin.mean()*1e-3, margin.percentile(0.01)*1e-3);
+}
+
+AudioIO::SampleFormat AudioIO::deviceFormat() const { return mImpl->mFormat; }
+
+void AudioIO::deviceFormat(SampleFormat v){
+	if(mImpl->mIsOpen){
+		warn("the sample format cannot be set with the stream open", "AudioIO");
+		return;
+	}
+	mImpl->mFormat = v;
+	mImpl->mInParams.sampleFormat = mImpl->sampleFormat();
+	mImpl->mOutParams.sampleFormat = mImpl->sampleFormat();
+}
 
 } // gam::
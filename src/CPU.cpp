@@ -0,0 +1,162 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <stdlib.h>
+#include <string.h>
+#include "Gamma/CPU.h"
+
+#if defined(GAM_CPU_X86)
+	#if defined(_MSC_VER)
+		#include <intrin.h>
+	#else
+		#include <cpuid.h>
+	#endif
+#endif
+
+namespace gam{
+
+namespace{
+
+	#if defined(GAM_CPU_X86)
+	void cpuid(unsigned leaf, unsigned sub, unsigned r[4]){
+		#if defined(_MSC_VER)
+		int v[4];
+		__cpuidex(v, int(leaf), int(sub));
+		for(int i=0; i<4; ++i) r[i] = unsigned(v[i]);
+		#else
+		__cpuid_count(leaf, sub, r[0], r[1], r[2], r[3]);
+		#endif
+	}
+
+	// Register state enabled by the OS (XCR0)
+	unsigned long long xgetbv0(){
+		#if defined(_MSC_VER)
+		return _xgetbv(0);
+		#else
+		unsigned lo, hi;
+		__asm__ volatile(".byte 0x0f, 0x01, 0xd0" : "=a"(lo), "=d"(hi) : "c"(0));
+		return (unsigned long long)hi << 32 | lo;
+		#endif
+	}
+	#endif
+
+	unsigned detect(){
+		unsigned f = 0;
+
+		#if defined(GAM_CPU_X86)
+		unsigned r[4];
+		cpuid(0, 0, r);
+		const unsigned maxLeaf = r[0];
+		if(maxLeaf < 1) return f;
+
+		cpuid(1, 0, r);
+		if(r[3] & (1u<<26)) f |= CPU_SSE2;
+		if(r[2] & (1u<<19)) f |= CPU_SSE41;
+
+		// AVX needs the OS to save YMM state (XCR0 bits 1,2) and AVX-512 also
+		// the opmask and ZMM state (bits 5,6,7)
+		const bool osxsave = r[2] & (1u<<27);
+		const bool fma = r[2] & (1u<<12);
+		const bool f16c = r[2] & (1u<<29);
+		unsigned long long xcr0 = osxsave ? xgetbv0() : 0;
+		const bool ymm = (xcr0 & 0x6) == 0x6;
+		const bool zmm = (xcr0 & 0xe6) == 0xe6;
+		if(ymm && (r[2] & (1u<<28))) f |= CPU_AVX;
+
+		if(maxLeaf >= 7){
+			cpuid(7, 0, r);
+			if((f & CPU_AVX) && fma && f16c && (r[1] & (1u<<5))) f |= CPU_AVX2;
+			if((f & CPU_AVX2) && zmm && (r[1] & (1u<<16))) f |= CPU_AVX512;
+		}
+
+		#elif defined(GAM_CPU_NEON)
+		f |= CPU_NEON;
+		#endif
+
+		return f;
+	}
+
+	std::atomic<int> gPath(-1);
+
+	// Best supported path at or below p
+	SIMDPath supportedBelow(SIMDPath p){
+		while(!simdSupported(p)) p = p == SIMD_NEON ? SIMD_SCALAR : SIMDPath(p-1);
+		return p;
+	}
+
+	SIMDPath initialPath(){
+		const char * env = getenv("GAMMA_SIMD");
+		SIMDPath p;
+		if(env && simdPathFromName(p, env)) return supportedBelow(p);
+		return simdBest();
+	}
+}
+
+
+unsigned cpuFeatures(){
+	static const unsigned f = detect();
+	return f;
+}
+
+bool simdSupported(SIMDPath p){
+	const unsigned f = cpuFeatures();
+	switch(p){
+	#if defined(GAM_CPU_X86)
+	case SIMD_SSE2:		return f & CPU_SSE2;
+	case SIMD_AVX2:		return f & CPU_AVX2;
+	case SIMD_AVX512:	return f & CPU_AVX512;
+	#elif defined(GAM_CPU_NEON)
+	case SIMD_NEON:		return f & CPU_NEON;
+	#endif
+	case SIMD_SCALAR:	return true;
+	default:			return false;
+	}
+}
+
+SIMDPath simdBest(){
+	static const SIMDPath order[] = {SIMD_AVX512, SIMD_AVX2, SIMD_SSE2, SIMD_NEON};
+	for(SIMDPath p : order){ if(simdSupported(p)) return p; }
+	return SIMD_SCALAR;
+}
+
+SIMDPath simdPath(){
+	int p = gPath.load(std::memory_order_acquire);
+	if(p < 0){
+		int expected = -1;
+		gPath.compare_exchange_strong(expected, initialPath());
+		p = gPath.load(std::memory_order_acquire);
+	}
+	return SIMDPath(p);
+}
+
+SIMDPath simdPath(SIMDPath p){
+	p = supportedBelow(p);
+	gPath.store(p, std::memory_order_release);
+	simdEpoch().fetch_add(1, std::memory_order_acq_rel);
+	return p;
+}
+
+std::atomic<unsigned>& simdEpoch(){
+	static std::atomic<unsigned> e(0);
+	return e;
+}
+
+const char * simdPathName(SIMDPath p){
+	switch(p){
+	case SIMD_SSE2:		return "sse2";
+	case SIMD_AVX2:		return "avx2";
+	case SIMD_AVX512:	return "avx512";
+	case SIMD_NEON:		return "neon";
+	default:			return "scalar";
+	}
+}
+
+bool simdPathFromName(SIMDPath& p, const char * name){
+	static const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+	for(SIMDPath q : paths){
+		if(0 == strcmp(name, simdPathName(q))){ p = q; return true; }
+	}
+	return false;
+}
+
+} // gam::
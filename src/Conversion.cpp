@@ -2,10 +2,84 @@
 	See COPYRIGHT file for authors and license information */
 
 #include "Gamma/Conversion.h"
-#include <cstring> // strlen
+#include <cstring> // strlen, memcpy
+
+// Compile AVX2 clones of the array functions, dispatched through ifuncs
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+	#define GAM_CONV_ARRAY __attribute__((target_clones("avx2","default")))
+#else
+	#define GAM_CONV_ARRAY
+#endif
 
 namespace gam{
 
+namespace{
+	// The low word of the sum with the magic number is the rounded value,
+	// as castIntRound; memcpy punning vectorizes where unions do not.
+	inline int32_t roundMagicLow(double v){
+		v += roundMagic;
+		uint64_t b;
+		std::memcpy(&b, &v, 8);
+		return int32_t(uint32_t(b));
+	}
+}
+
+GAM_CONV_ARRAY void castIntRound(int32_t * dst, const double * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = roundMagicLow(src[i]);
+}
+
+GAM_CONV_ARRAY void castIntRound(int32_t * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = roundMagicLow(src[i]);
+}
+
+GAM_CONV_ARRAY void castIntTrunc(int32_t * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const float v = src[i];
+		const float e = v > 0.f ? -roundEps<float>() : roundEps<float>();
+		dst[i] = roundMagicLow(v + e);
+	}
+}
+
+GAM_CONV_ARRAY void floatToUInt(uint32_t * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		uint32_t u;
+		std::memcpy(&u, src+i, 4);
+		u += 0x800000;
+		uint32_t shift = (u >> 23) & 0x7F;
+		shift = shift < 23 ? shift : 23;
+		const uint32_t r = (1u<<shift) | ((u & MaskFrac<float>()) >> (23 - shift));
+		dst[i] = u & 0x40000000 ? r : 0;
+	}
+}
+
+void punUF(float * dst, const uint32_t * src, unsigned len){
+	std::memmove(dst, src, len*4);
+}
+
+GAM_CONV_ARRAY void uintToUnit(float * dst, const uint32_t * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const uint32_t b = src[i] >> 9 | Expo1<float>();
+		float f;
+		std::memcpy(&f, &b, 4);
+		dst[i] = f - 1.f;
+	}
+}
+
+GAM_CONV_ARRAY void uintToUnitS(float * dst, const uint32_t * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		const uint32_t b = src[i] >> 9 | 0x40000000;
+		float f;
+		std::memcpy(&f, &b, 4);
+		dst[i] = f - 3.f;
+	}
+}
+
+GAM_CONV_ARRAY void unitToPhase(uint32_t * dst, const double * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = uint32_t(roundMagicLow(src[i] * 4294967296.));
+}
+
+#undef GAM_CONV_ARRAY
+
 uint32_t bits(const char * string){
 	uint32_t v=0; int n = std::strlen(string);
 	for(int i=0; i<n; ++i) if(string[i] == '1') v |= 1<<(n-1-i);
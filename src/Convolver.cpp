@@ -0,0 +1,365 @@
+#include <algorithm> // fill
+#include <chrono>
+#include <thread> // yield, sleep_for
+#include <cstring> // memcpy, memset
+#include "Gamma/arr.h"
+#include "Gamma/Convolver.h"
+#include "Gamma/Denormal.h"
+
+namespace gam{
+
+Convolver::Convolver(unsigned blockSize, unsigned maxIRSize)
+:	mShared(0), mBlockSize(0), mMaxParts(0), mParts(0), mHead(0)
+{
+	resize(blockSize, maxIRSize);
+}
+
+void Convolver::resize(unsigned blockSize, unsigned maxIRSize){
+	mBlockSize = blockSize;
+	mMaxParts = blockSize ? (maxIRSize + blockSize - 1) / blockSize : 0;
+	mParts = 0;
+	mHead = 0;
+
+	if(!mBlockSize){
+		mFFT.resize(0);
+		mH.clear(); mX.clear(); mPrev.clear(); mBuf.clear();
+		mHs.clear(); mXs.clear();
+		return;
+	}
+
+	mFFT.resize(2*mBlockSize);
+	mH.assign(mMaxParts * specSize(), 0.f);
+	mX.assign(mMaxParts * specSize(), 0.f);
+	mPrev.assign(mBlockSize, 0.f);
+	mBuf.assign(specSize(), 0.f);
+	mHs.assign(mMaxParts, 0);
+	mXs.assign(mMaxParts, 0);
+	for(unsigned p=0; p<mMaxParts; ++p) mHs[p] = &mH[p*specSize()];
+}
+
+bool Convolver::ir(const float * src, unsigned len, float gain){
+	const unsigned B = mBlockSize;
+	const bool fits = len <= maxIRSize();
+	if(!fits) len = maxIRSize();
+
+	mParts = B ? (len + B - 1) / B : 0;
+
+	// Zero-padded partition spectra, with the 1/N of the inverse folded in
+	for(unsigned p=0; p<mParts; ++p){
+		float * H = &mH[p*specSize()];
+		unsigned n = len - p*B < B ? len - p*B : B;
+		std::memcpy(H+1, src + p*B, n*sizeof(float));
+		std::memset(H+1+n, 0, (2*B-n)*sizeof(float));
+		mFFT.forward(H, true, true, gain);
+	}
+	return fits;
+}
+
+void Convolver::process(float * dst, const float * src){
+	const unsigned B = mBlockSize;
+	const Convolver& h = mShared ? *mShared : *this;
+	const unsigned parts = h.mParts < mMaxParts ? h.mParts : mMaxParts;
+	if(!parts){
+		std::memcpy(mPrev.data(), src, B*sizeof(float));
+		std::memset(dst, 0, B*sizeof(float));
+		return;
+	}
+
+	// Transform the last two input blocks into the newest delay line slot
+	float * X = &mX[mHead*specSize()];
+	std::memcpy(X+1, mPrev.data(), B*sizeof(float));
+	std::memcpy(X+1+B, src, B*sizeof(float));
+	std::memcpy(mPrev.data(), src, B*sizeof(float));
+	mFFT.forward(X, true, false);
+
+	// Pair partition p of the IR with the input spectrum from p blocks ago
+	for(unsigned p=0; p<parts; ++p){
+		unsigned i = mHead >= p ? mHead - p : mHead + mMaxParts - p;
+		mXs[p] = &mX[i*specSize()];
+	}
+	if(++mHead == mMaxParts) mHead = 0;
+
+	std::memset(mBuf.data(), 0, specSize()*sizeof(float));
+	arr::mulAddComplex(mBuf.data(), mXs.data(), h.mHs.data(), parts, B+1);
+	mFFT.inverse(mBuf.data(), true);
+
+	// The second half is free of circular wrap-around
+	std::memcpy(dst, &mBuf[1+B], B*sizeof(float));
+}
+
+void Convolver::reset(){
+	mHead = 0;
+	std::fill(mX.begin(), mX.end(), 0.f);
+	std::fill(mPrev.begin(), mPrev.end(), 0.f);
+}
+
+
+
+
+NonUniformConvolver::NonUniformConvolver(
+	unsigned blockSize, unsigned maxIRSize, unsigned tailBlockSize, bool background
+)
+:	mPos(0), mSlot(0), mJobSlot(0),
+	mPosted(0), mDone(0), mMisses(0), mRunning(false)
+{
+	resize(blockSize, maxIRSize, tailBlockSize, background);
+}
+
+NonUniformConvolver::~NonUniformConvolver(){
+	stopThread();
+}
+
+void NonUniformConvolver::resize(unsigned B, unsigned maxIRSize, unsigned T, bool background){
+	stopThread();
+
+	if(B && !T){
+		// Minimize head and tail partitions per sample, 2T/B + L/T
+		T = B;
+		while(2*T <= maxIRSize && 4*T/B + maxIRSize/(2*T) < 2*T/B + maxIRSize/T) T *= 2;
+		if(T == B) T = 2*B; // only worthwhile with a tail longer than the head
+	}
+	else if(B){
+		T = (T + B - 1) / B * B;
+	}
+
+	unsigned headSize = maxIRSize < 2*T ? maxIRSize : 2*T;
+	mHead.resize(B, headSize);
+	mTail.resize(maxIRSize > headSize ? T : 0, maxIRSize - headSize);
+	mTailIn.assign(2*mTail.blockSize(), 0.f);
+	mTailOut.assign(2*mTail.blockSize(), 0.f);
+	mPos = mSlot = mJobSlot = 0;
+	mPosted = mDone = 0;
+	mMisses = 0;
+
+	if(background && mTail.blockSize()){
+		mRunning = true;
+		mThread.start(cTailFunc, this);
+	}
+}
+
+bool NonUniformConvolver::ir(const float * src, unsigned len, float gain){
+	const unsigned headSize = mHead.maxIRSize();
+	waitTail();
+	mHead.ir(src, len < headSize ? len : headSize, gain);
+	if(mTail.blockSize()){
+		return mTail.ir(src + headSize, len > headSize ? len - headSize : 0, gain);
+	}
+	return len <= headSize;
+}
+
+void NonUniformConvolver::process(float * dst, const float * src){
+	const unsigned B = mHead.blockSize();
+	const unsigned T = mTail.blockSize();
+
+	if(!T){
+		mHead.process(dst, src);
+		return;
+	}
+
+	if(0 == mPos){
+		// The tail block posted one tail block ago is due now
+		if(waitTail()) mMisses.store(misses()+1, std::memory_order_relaxed);
+		mJobSlot = mSlot;
+		mSlot ^= 1;
+		if(mRunning.load(std::memory_order_relaxed)){
+			mPosted.store(mPosted.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+		}
+		else{
+			runTail();
+		}
+	}
+
+	float * tailIn  = &mTailIn [mSlot*T + mPos];
+	float * tailOut = &mTailOut[mSlot*T + mPos];
+	std::memcpy(tailIn, src, B*sizeof(float));
+	mHead.process(dst, src);
+	for(unsigned i=0; i<B; ++i) dst[i] += tailOut[i];
+
+	mPos += B;
+	if(mPos >= T) mPos = 0;
+}
+
+void NonUniformConvolver::reset(){
+	waitTail();
+	mHead.reset();
+	mTail.reset();
+	std::fill(mTailIn.begin(), mTailIn.end(), 0.f);
+	std::fill(mTailOut.begin(), mTailOut.end(), 0.f);
+	mPos = mSlot = 0;
+}
+
+void NonUniformConvolver::runTail(){
+	const unsigned T = mTail.blockSize();
+	mTail.process(&mTailOut[mJobSlot*T], &mTailIn[mJobSlot*T]);
+}
+
+bool NonUniformConvolver::waitTail(){
+	unsigned posted = mPosted.load(std::memory_order_relaxed);
+	if(mDone.load(std::memory_order_acquire) == posted) return false;
+	while(mDone.load(std::memory_order_acquire) != posted){
+		std::this_thread::yield();
+	}
+	return true;
+}
+
+void NonUniformConvolver::stopThread(){
+	if(mRunning){
+		mRunning = false;
+		mThread.join();
+	}
+}
+
+void * NonUniformConvolver::cTailFunc(void * user){
+	NonUniformConvolver& c = *(NonUniformConvolver*)user;
+	DenormalGuard denormals;
+	unsigned spins = 0;
+	while(c.mRunning.load(std::memory_order_relaxed)){
+		unsigned posted = c.mPosted.load(std::memory_order_acquire);
+		if(posted != c.mDone.load(std::memory_order_relaxed)){
+			spins = 0;
+			c.runTail();
+			c.mDone.store(posted, std::memory_order_release);
+		}
+		else if(++spins > 1000){
+			// Tail blocks are far apart, so idle without spinning
+			std::this_thread::sleep_for(std::chrono::microseconds(100));
+		}
+	}
+	return NULL;
+}
+
+
+
+
+FIR::FIR(unsigned maxSize, unsigned threshold)
+:	mMaxSize(0), mThreshold(0), mLen(0), mDirect(0), mHead(0), mPos(0), mTailPos(0)
+{
+	resize(maxSize, threshold);
+}
+
+void FIR::resize(unsigned maxSize, unsigned threshold){
+	mMaxSize = maxSize;
+	mThreshold = threshold ? threshold : 1;
+	mLen = mDirect = 0;
+
+	// Head of FFT path is a power of two not longer than the threshold
+	mHead = 1;
+	while(2*mHead <= mThreshold) mHead *= 2;
+
+	unsigned maxDirect = maxSize < mThreshold ? maxSize : mThreshold;
+	if(maxDirect < 1) maxDirect = 1;
+	mRev.assign(maxDirect, 0.f);
+	mHist.assign(maxDirect-1 + BLOCK, 0.f);
+	mPos = maxDirect-1;
+
+	if(maxSize > mThreshold){
+		mTail.resize(mHead, maxSize - mHead);
+		mTailIn.assign(mHead, 0.f);
+		mTailOut.assign(mHead, 0.f);
+	}
+	else{
+		mTail.resize(0, 0);
+		mTailIn.clear();
+		mTailOut.clear();
+	}
+	mTailPos = 0;
+}
+
+bool FIR::kernel(const float * h, unsigned len){
+	const bool fits = len <= mMaxSize;
+	if(!fits) len = mMaxSize;
+	mLen = len;
+	mDirect = len > mThreshold ? mHead : len;
+
+	for(unsigned j=0; j<mDirect; ++j) mRev[mDirect-1-j] = h[j];
+
+	if(mTail.blockSize()){
+		mTail.ir(h + mDirect, len > mDirect ? len - mDirect : 0);
+	}
+	return fits;
+}
+
+void FIR::shift(){
+	const unsigned H = unsigned(mRev.size()) - 1;
+	std::memmove(&mHist[0], &mHist[mPos-H], H*sizeof(float));
+	mPos = H;
+}
+
+/*
+The history always holds the inputs needed by the longest direct form
+kernel, so a new kernel can be set without a reset. The newest input is at
+the end of the window of each output, paired with h[0] at the end of the
+reversed kernel.
+*/
+float FIR::operator()(float in){
+	float y;
+	(*this)(&y, &in, 1);
+	return y;
+}
+
+void FIR::operator()(float * dst, const float * src, unsigned n){
+	const unsigned R = mDirect;
+	const float * g = &mRev[0];
+	const bool tail = usesFFT();
+
+	while(n){
+		if(!room()) shift();
+		unsigned m = room();
+		if(m > n) m = n;
+		if(tail && m > mHead - mTailPos) m = mHead - mTailPos;
+
+		float * x = &mHist[mPos];
+		std::memcpy(x, src, m*sizeof(float));
+		const float * w = x + 1 - R;	// start of window of first output
+
+		if(1 == m){
+			// Independent partial sums vectorize without reordering
+			enum{ P = 8 };
+			float acc[P] = {0,0,0,0,0,0,0,0};
+			unsigned j = 0;
+			for(; j+P<=R; j+=P){
+				for(unsigned k=0; k<P; ++k) acc[k] += g[j+k] * w[j+k];
+			}
+			float y = 0.f;
+			for(; j<R; ++j) y += g[j] * w[j];
+			for(unsigned k=0; k<P; ++k) y += acc[k];
+			dst[0] = y;
+		}
+		else{
+			float acc[BLOCK];
+			for(unsigned i=0; i<m; ++i) acc[i] = 0.f;
+			for(unsigned j=0; j<R; ++j){
+				const float gj = g[j];
+				const float * wj = w + j;
+				for(unsigned i=0; i<m; ++i) acc[i] += gj * wj[i];
+			}
+			std::memcpy(dst, acc, m*sizeof(float));
+		}
+
+		if(tail){
+			// The tail output for this block was computed one block ago
+			float * tin = &mTailIn[mTailPos], * tout = &mTailOut[mTailPos];
+			std::memcpy(tin, src, m*sizeof(float));
+			for(unsigned i=0; i<m; ++i) dst[i] += tout[i];
+			mTailPos += m;
+			if(mTailPos == mHead){
+				mTail.process(&mTailOut[0], &mTailIn[0]);
+				mTailPos = 0;
+			}
+		}
+
+		mPos += m;
+		src += m; dst += m; n -= m;
+	}
+}
+
+void FIR::reset(){
+	std::fill(mHist.begin(), mHist.end(), 0.f);
+	mPos = unsigned(mRev.size()) - 1;
+	mTail.reset();
+	std::fill(mTailIn.begin(), mTailIn.end(), 0.f);
+	std::fill(mTailOut.begin(), mTailOut.end(), 0.f);
+	mTailPos = 0;
+}
+
+} // gam::
@@ -0,0 +1,177 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include "Gamma/CPU.h"
+#include "Gamma/Crossover.h"
+#include "Gamma/FilterDesign.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE2__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_XO_SSE
+#endif
+
+namespace gam{
+
+namespace{
+	const unsigned LANES = 8; // as Crossover
+
+	// Kernels run one section, in transposed direct form II, over m frames
+	// of eight lane-interleaved samples, with coefficients c (a0, a1, a2,
+	// b1, b2) and states s (eight s1, then eight s2). The compiler does not
+	// vectorize the recursion across lanes, so the SIMD ones are explicit.
+	typedef void (*SectionKernel)(float * x, unsigned m, const float * c, float * s);
+
+	void sectionScalar(float * x, unsigned m, const float * c, float * s){
+		float s1[LANES], s2[LANES];
+		for(unsigned l=0; l<LANES; ++l){ s1[l] = s[l]; s2[l] = s[LANES+l]; }
+		for(unsigned i=0; i<m; ++i){
+			float * v = x + i*LANES;
+			for(unsigned l=0; l<LANES; ++l){
+				const float y = c[0]*v[l] + s1[l];
+				s1[l] = c[1]*v[l] - c[3]*y + s2[l];
+				s2[l] = c[2]*v[l] - c[4]*y;
+				v[l] = y;
+			}
+		}
+		for(unsigned l=0; l<LANES; ++l){ s[l] = s1[l]; s[LANES+l] = s2[l]; }
+	}
+
+	#if defined(GAM_XO_SSE)
+	void sectionSSE2(float * x, unsigned m, const float * c, float * s){
+		const __m128 a0 = _mm_set1_ps(c[0]), a1 = _mm_set1_ps(c[1]), a2 = _mm_set1_ps(c[2]);
+		const __m128 b1 = _mm_set1_ps(c[3]), b2 = _mm_set1_ps(c[4]);
+		for(unsigned h=0; h<LANES; h+=4){
+			__m128 s1 = _mm_loadu_ps(s+h), s2 = _mm_loadu_ps(s+LANES+h);
+			for(unsigned i=0; i<m; ++i){
+				float * v = x + i*LANES + h;
+				const __m128 xi = _mm_loadu_ps(v);
+				const __m128 y = _mm_add_ps(_mm_mul_ps(a0, xi), s1);
+				s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(a1, xi), _mm_mul_ps(b1, y)), s2);
+				s2 = _mm_sub_ps(_mm_mul_ps(a2, xi), _mm_mul_ps(b2, y));
+				_mm_storeu_ps(v, y);
+			}
+			_mm_storeu_ps(s+h, s1); _mm_storeu_ps(s+LANES+h, s2);
+		}
+	}
+
+	GAM_TARGET_AVX2 void sectionAVX2(float * x, unsigned m, const float * c, float * s){
+		const __m256 a0 = _mm256_set1_ps(c[0]), a1 = _mm256_set1_ps(c[1]), a2 = _mm256_set1_ps(c[2]);
+		const __m256 b1 = _mm256_set1_ps(c[3]), b2 = _mm256_set1_ps(c[4]);
+		__m256 s1 = _mm256_loadu_ps(s), s2 = _mm256_loadu_ps(s+LANES);
+		for(unsigned i=0; i<m; ++i){
+			float * v = x + i*LANES;
+			const __m256 xi = _mm256_loadu_ps(v);
+			const __m256 y = _mm256_fmadd_ps(a0, xi, s1);
+			s1 = _mm256_add_ps(_mm256_fnmadd_ps(b1, y, _mm256_mul_ps(a1, xi)), s2);
+			s2 = _mm256_fnmadd_ps(b2, y, _mm256_mul_ps(a2, xi));
+			_mm256_storeu_ps(v, y);
+		}
+		_mm256_storeu_ps(s, s1); _mm256_storeu_ps(s+LANES, s2);
+	}
+	#define GAM_SSE_KERNEL(f) f
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_SSE_KERNEL(f) 0
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+}
+
+
+Crossover::Crossover(unsigned bandsA, unsigned chans)
+:	mChannels(chans), mSections(0)
+{
+	bands(bandsA);
+}
+
+Crossover& Crossover::bands(unsigned n){
+	const unsigned splits = n > 1 ? n-1 : 0;
+	while(mFreq.size() < splits) mFreq.push_back(mFreq.empty() ? 1000.f : mFreq.back()*2.f);
+	mFreq.resize(splits);
+	mSplit.resize(splits);
+	for(unsigned k=0; k<splits; ++k) design(k);
+	resize();
+	return *this;
+}
+
+Crossover& Crossover::channels(unsigned n){
+	mChannels = n; resize(); return *this;
+}
+
+Crossover& Crossover::freq(unsigned k, float hz){
+	mFreq[k] = hz; design(k); return *this;
+}
+
+void Crossover::onDomainChange(double /*r*/){
+	for(unsigned k=0; k<mFreq.size(); ++k) design(k);
+}
+
+void Crossover::design(unsigned k){
+	Split& s = mSplit[k];
+	biquadCoefs(s.lo, &mFreq[k], NULL, NULL, 1, LOW_PASS, ups());
+	biquadCoefs(s.hi, &mFreq[k], NULL, NULL, 1, HIGH_PASS, ups());
+	biquadCoefs(s.ap, &mFreq[k], NULL, NULL, 1, ALL_PASS, ups());
+}
+
+void Crossover::resize(){
+	const unsigned S = unsigned(mFreq.size());
+	mSections = 4*S + S*(S-1)/2;
+	const unsigned groups = (mChannels + LANES-1) / LANES;
+	mState.assign(groups * mSections * 2*LANES, 0.f);
+}
+
+void Crossover::reset(){
+	std::fill(mState.begin(), mState.end(), 0.f);
+}
+
+// Band k is the low part of split k of the high part of splits below it,
+// then the all-passes of splits above. The all-pass of the last split is
+// the sum of its bands; by induction all bands sum to the product of all
+// all-passes.
+void Crossover::process(float * const * dst, const float * const * src, unsigned n){
+	static SIMDDispatch<SectionKernel> kernel(sectionScalar,
+		GAM_SSE_KERNEL(sectionSSE2), GAM_AVX_KERNEL(sectionAVX2));
+	const SectionKernel section = kernel();
+	const unsigned S = unsigned(mFreq.size());
+	const unsigned C = mChannels;
+	for(unsigned b=0; b<n; b+=BLOCK){
+		const unsigned m = n-b < BLOCK ? n-b : unsigned(BLOCK);
+
+		for(unsigned c0=0; c0<C; c0+=LANES){
+			const unsigned L = C-c0 < LANES ? C-c0 : unsigned(LANES);
+			float * st = &mState[c0/LANES * mSections * 2*LANES];
+
+			// Transpose input so lanes are adjacent
+			for(unsigned l=0; l<L; ++l){
+				const float * x = src[c0+l] + b;
+				for(unsigned i=0; i<m; ++i) mRem[i*LANES + l] = x[i];
+			}
+			for(unsigned l=L; l<LANES; ++l){
+				for(unsigned i=0; i<m; ++i) mRem[i*LANES + l] = 0.f;
+			}
+
+			for(unsigned k=0; k<S; ++k){
+				const Split& s = mSplit[k];
+				std::copy(mRem, mRem + m*LANES, mLow);
+				section(mLow, m, s.lo, st); st += 2*LANES;
+				section(mLow, m, s.lo, st); st += 2*LANES;
+				section(mRem, m, s.hi, st); st += 2*LANES;
+				section(mRem, m, s.hi, st); st += 2*LANES;
+				for(unsigned j=k+1; j<S; ++j){
+					section(mLow, m, mSplit[j].ap, st); st += 2*LANES;
+				}
+				for(unsigned l=0; l<L; ++l){
+					float * y = dst[k*C + c0+l] + b;
+					for(unsigned i=0; i<m; ++i) y[i] = mLow[i*LANES + l];
+				}
+			}
+
+			for(unsigned l=0; l<L; ++l){
+				float * y = dst[S*C + c0+l] + b;
+				for(unsigned i=0; i<m; ++i) y[i] = mRem[i*LANES + l];
+			}
+		}
+	}
+}
+
+} // gam::
@@ -1,47 +1,35 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <map>
+#include <mutex>
+#include <tuple>
+#include <utility> // pair
+#include <vector>
 #include "Gamma/DFT.h"
 #include "Gamma/arr.h"
 #include "Gamma/scl.h"
 
+// Convert all bins except DC and Nyquist, which are real
 #define CART_TO_POL(bins)\
-	if(mPrecise){\
-		for(unsigned i=1; i<numBins()-1; ++i){\
-			Complex<float> &c = bins[i];\
-			c(c.mag(), c.phase());\
-		}\
-	}\
-	else{\
-		for(unsigned i=1; i<numBins()-1; ++i){\
-			Complex<float> &c = bins[i];\
-			float m = c.normSqr();\
-			float p = scl::atan2Fast(c.i,c.r);\
-			c(scl::sqrt<1>(m), p);\
-		}\
+	if(numBins() > 2){\
+		float * b = (float *)((bins)+1);\
+		arr::cartToPolar(b, b, numBins()-2, mPrecise);\
 	}
 
 #define POL_TO_CART(bins)\
-	if(mPrecise){\
-		for(unsigned i=1; i<numBins()-1; ++i){\
-			Complex<float> &c = bins[i];\
-			c(c[0]*cos(c[1]), c[0]*sin(c[1]));\
-		}\
-	}\
-	else{\
-		for(unsigned i=1; i<numBins()-1; ++i){\
-			Complex<float> &c = bins[i];\
-			float p = scl::wrapPhase(c[1]);\
-			c(c[0]*scl::cosT8(p), c[0]*scl::sinT9(p));\
-		}\
-	}\
+	if(numBins() > 2){\
+		float * b = (float *)((bins)+1);\
+		arr::polarToCart(b, b, numBins()-2, mPrecise);\
+	}
 
 namespace gam{
 
 DFT::DFT(unsigned winSize, unsigned padSize, SpectralType specT, unsigned numAuxA)
-:	mSizeWin(0), mSizeHop(0),
+:	mSizeWin(0), mSizeHop(0), mCapWin(0), mCapPad(0),
 	mFFT(0),
-	mPadOA(0), mTapW(0), mTapR(0), mPrecise(false)
+	mPadOA(0), mTapW(0), mTapR(0), mPrecise(false),
+	mActiveThresh(0), mNumActive(0)
 {
 	//printf("DFT::DFT\n");
 	resize(winSize, padSize);
@@ -50,7 +38,13 @@ DFT::DFT(unsigned winSize, unsigned padSize, SpectralType specT, unsigned numAux
 }
 
 DFT::~DFT(){ //printf("~DFT\n");
-	mem::free(mPadOA);
+	mem::freeAligned(mPadOA);
+}
+
+std::size_t DFT::sizeInBytes() const {
+	const std::size_t pad = mPadOA ? scl::max(mCapPad, sizePad())*sizeof(float) : 0;
+	const std::size_t active = mActive.capacity()*sizeof(unsigned) + mLevels.capacity()*sizeof(float);
+	return DFTBase<float>::sizeInBytes() + pad + active;
 }
 
 void DFT::resize(unsigned newWinSize, unsigned newPadSize){ //printf("DFT::resize()\n");
@@ -59,28 +53,57 @@ void DFT::resize(unsigned newWinSize, unsigned newPadSize){ //printf("DFT::resiz
 
 	unsigned oldDFTSize = sizeDFT();
 	unsigned newDFTSize = newWinSize + newPadSize;
-	unsigned oldFrqSize = oldDFTSize+2;		// 2 extra for DC/Nyquist imaginary
-	unsigned newFrqSize = newDFTSize+2;		// "
 
-	if(mem::resize(mBuf, oldFrqSize*2, newFrqSize*2)){
-		mBufInv = bufInvPos();
-		if(mNumAux) mem::resize(mAux, oldFrqSize*mNumAux, newFrqSize*mNumAux);
+	// Buffers are only reallocated when they differ from the reserved sizes
+	unsigned oldFrqSize = scl::max(mCapDFT, oldDFTSize)+2;	// 2 extra for DC/Nyquist imaginary
+	unsigned newFrqSize = scl::max(mCapDFT, newDFTSize)+2;	// "
+
+	if(mem::resizeAligned(mBuf, oldFrqSize*2, newFrqSize*2)){
+		if(mNumAux) mem::resizeAligned(mAux, oldFrqSize*mNumAux, newFrqSize*mNumAux);
+		if(mSplit) mem::resizeAligned(mSplit, oldFrqSize, newFrqSize);
+	}
+
+	if(newDFTSize != oldDFTSize){
 		mFFT.resize(newDFTSize);
-		mem::deepZero(mBuf, newFrqSize*2);
+		mem::deepZero(mBuf, (newDFTSize+2)*2);
+		if(mSplit) mem::deepZero(mSplit, newDFTSize+2);
 	}
-	
-	mem::resize(mPadOA, sizePad(), newPadSize);
+
+	mem::resizeAligned(mPadOA, scl::max(mCapPad, sizePad()), scl::max(mCapPad, newPadSize));
 	mem::deepZero(mPadOA, newPadSize);
 	
 	mSizeDFT = newDFTSize;
 	mSizeWin = newWinSize;
 	mSizeHop = mSizeWin;
+	mBufInv = bufInvPos();
 	
 	mTapW = mTapR = 0;
+	mNumActive = 0;
+	if(mActiveThresh > 0.f) resizeActive();
 
 	onDomainChange(1);
 }
 
+void DFT::reserve(unsigned maxWinSize, unsigned maxPadSize){
+	unsigned oldFrqSize = scl::max(mCapDFT, sizeDFT())+2;
+	unsigned oldPadSize = scl::max(mCapPad, sizePad());
+	mCapWin = scl::max(maxWinSize, sizeWin());
+	mCapPad = scl::max(maxPadSize, sizePad());
+	mCapDFT = scl::max(mCapWin + mCapPad, sizeDFT());
+	unsigned newFrqSize = mCapDFT+2;
+
+	if(mem::resizeAligned(mBuf, oldFrqSize*2, newFrqSize*2)){
+		if(mNumAux) mem::resizeAligned(mAux, oldFrqSize*mNumAux, newFrqSize*mNumAux);
+		if(mSplit) mem::resizeAligned(mSplit, oldFrqSize, newFrqSize);
+		mBufInv = bufInvPos();
+	}
+	mem::resizeAligned(mPadOA, oldPadSize, mCapPad);
+
+	// Hold plans and grow the FFT work buffer ahead of time
+	mFFT.reserve(mCapDFT);
+	if(mActiveThresh > 0.f) resizeActive();
+}
+
 void DFT::onDomainChange(double r){
 	DFTBase<float>::onDomainChange(r);
 	domainHop().ups((double)sizeHop() * ups());
@@ -88,12 +111,20 @@ void DFT::onDomainChange(double r){
 }
 
 void DFT::forward(const float * src){ //printf("DFT::forward(const float *)\n");
-
 	if(src) mem::deepCopy(bufFwdPos(), src, sizeWin());
 	mem::deepZero(bufFwdPos() + sizeWin(), sizePad());	// zero pad
+	forwardBins();
+	splitFrame();
+}
 
+void DFT::forwardBins(){
 	mFFT.forward(bufFwdFrq(), true, true); // complex buffer and normalize
 
+	if(mActiveThresh > 0.f){
+		forwardActive();
+		return;
+	}
+
 	switch(mSpctFormat){
 	case COMPLEX: break;
 	case MAG_PHASE:
@@ -107,19 +138,25 @@ void DFT::forward(const float * src){ //printf("DFT::forward(const float *)\n");
 void DFT::inverse(float * dst){
 	//printf("DFT::inverse(float *)\n");
 
-	// operate on copy of bins
-	if(MAG_FREQ != mSpctFormat){
-		mem::deepCopy(bufInvFrq(), bufFwdFrq(), sizeDFT()+2);
+	if(mActiveThresh > 0.f && MAG_FREQ != mSpctFormat){
+		inverseActive();
 	}
+	else{
+		// operate on copy of bins
+		if(MAG_FREQ != mSpctFormat){
+			if(mSplit)	mem::interleave2(bufInvFrq(), mSplit, numBins());
+			else		mem::deepCopy(bufInvFrq(), bufFwdFrq(), sizeDFT()+2);
+		}
 
-	switch(mSpctFormat){
-	case COMPLEX: break;
-	case MAG_PHASE:
-	case MAG_FREQ:
-		{	Complex<float> * bins = mBins+numBins();
-			POL_TO_CART(bins)
+		switch(mSpctFormat){
+		case COMPLEX: break;
+		case MAG_PHASE:
+		case MAG_FREQ:
+			{	Complex<float> * bins = mBins+numBins();
+				POL_TO_CART(bins)
+			}
+			break;
 		}
-		break;
 	}
 
 	mFFT.inverse(bufInvFrq(), true);
@@ -146,9 +183,111 @@ void DFT::inverse(float * dst){
 	if(dst) mem::deepCopy(dst, bufInvPos(), sizeWin());
 }
 
+DFT& DFT::activeThreshold(float v){
+	mActiveThresh = v > 0.f ? v : 0.f;
+	if(mActiveThresh > 0.f) resizeActive();
+	else mNumActive = 0;
+	return *this;
+}
+
+void DFT::resizeActive(){
+	const unsigned bins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
+	if(mActive.size() < bins){
+		mActive.resize(bins);
+		mLevels.resize(bins*2);
+	}
+}
+
+void DFT::forwardActive(){
+	const unsigned nb = numBins();
+	float * b = mBuf;
+	float * lev = &mLevels[0];
+	unsigned * act = &mActive[0];
+
+	for(unsigned k=0; k<nb; ++k) lev[k] = b[2*k]*b[2*k] + b[2*k+1]*b[2*k+1];
+	const unsigned n = arr::above(act, lev, nb, mActiveThresh*mActiveThresh);
+	mNumActive = n;
+
+	if(MAG_FREQ == mSpctFormat){
+		CART_TO_POL(mBins)
+		for(unsigned k=0; k<nb; ++k){
+			if(lev[k] < mActiveThresh*mActiveThresh) b[2*k] = 0.f;
+		}
+		return;
+	}
+
+	// Pack active bins, except DC and Nyquist, over the levels no longer
+	// needed, zero the frame, then convert and unpack
+	float * p = lev;
+	const float ends[4] = {b[0], b[1], b[2*nb-2], b[2*nb-1]};
+	unsigned m = 0;
+	for(unsigned j=0; j<n; ++j){
+		const unsigned k = act[j];
+		p[2*m  ] = b[2*k  ];
+		p[2*m+1] = b[2*k+1];
+		m += (k-1 < nb-2);
+	}
+	mem::deepZero(b, 2*nb);
+	if(MAG_PHASE == mSpctFormat) arr::cartToPolar(p, p, m, mPrecise);
+
+	m = 0;
+	for(unsigned j=0; j<n; ++j){
+		const unsigned k = act[j];
+		if(k-1 < nb-2){
+			b[2*k  ] = p[2*m  ];
+			b[2*k+1] = p[2*m+1];
+			++m;
+		}
+		else{
+			const unsigned e = k ? 2 : 0;
+			b[2*k  ] = ends[e  ];
+			b[2*k+1] = ends[e+1];
+		}
+	}
+}
+
+void DFT::inverseActive(){
+	const unsigned nb = numBins();
+	unsigned str;
+	const float * c0 = frameComp(0, str);
+	const float * c1 = frameComp(1, str);
+	const unsigned * act = &mActive[0];
+	const unsigned n = mNumActive;
+	float * p = &mLevels[0];
+
+	unsigned m = 0;
+	for(unsigned j=0; j<n; ++j){
+		const unsigned k = act[j];
+		p[2*m  ] = c0[k*str];
+		p[2*m+1] = c1[k*str];
+		m += (k-1 < nb-2);
+	}
+	if(MAG_PHASE == mSpctFormat) arr::polarToCart(p, p, m, mPrecise);
+
+	float * b = bufInvFrq();
+	mem::deepZero(b, 2*nb);
+	m = 0;
+	for(unsigned j=0; j<n; ++j){
+		const unsigned k = act[j];
+		if(k-1 < nb-2){
+			b[2*k  ] = p[2*m  ];
+			b[2*k+1] = p[2*m+1];
+			++m;
+		}
+		else{
+			b[2*k  ] = c0[k*str];
+			b[2*k+1] = c1[k*str];
+		}
+	}
+}
+
 void DFT::spctToRect(){
 	switch(mSpctFormat){
-	case MAG_PHASE: POL_TO_CART(mBins) break;
+	case MAG_PHASE:
+		if(mSplit) mem::interleave2(mBuf, mSplit, numBins());
+		POL_TO_CART(mBins)
+		splitFrame();
+		break;
 	default:;
 	}
 	mSpctFormat = COMPLEX;
@@ -156,12 +295,32 @@ void DFT::spctToRect(){
 
 void DFT::spctToPolar(){
 	switch(mSpctFormat){
-	case COMPLEX:	CART_TO_POL(mBins) break;
+	case COMPLEX:
+		if(mSplit) mem::interleave2(mBuf, mSplit, numBins());
+		CART_TO_POL(mBins)
+		splitFrame();
+		break;
 	default:;
 	}
 	mSpctFormat = MAG_PHASE;
 }
 
+DFT& DFT::splitBins(bool v){
+	if(v && !mSplit){
+		mem::resizeAligned(mSplit, 0, scl::max(mCapDFT, sizeDFT()) + 2);
+		splitFrame();
+	}
+	else if(!v && mSplit){
+		mem::interleave2(mBuf, mSplit, numBins());
+		mem::freeAligned(mSplit);
+	}
+	return *this;
+}
+
+void DFT::splitFrame(){
+	if(mSplit) mem::deinterleave2(mSplit, mBuf, numBins());
+}
+
 
 static const char * toString(SpectralType v){
 	switch(v){
@@ -200,11 +359,19 @@ STFT::STFT(unsigned winSize, unsigned hopSize, unsigned padSize, WindowType winT
 
 STFT::~STFT(){ //printf("~STFT\n");
 	mem::free(mBufInv);
-	mem::free(mFwdWin);
 	mem::free(mPhases);
 	mem::free(mAccums);
 }
 
+std::size_t STFT::sizeInBytes() const {
+	const std::size_t bins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
+	std::size_t n = DFT::sizeInBytes() + mSlide.sizeInBytes();
+	if(mBufInv) n += scl::max(mCapWin, sizeWin())*sizeof(float);
+	if(mPhases) n += bins*sizeof(float);
+	if(mAccums) n += bins*sizeof(double);
+	return n;
+}
+
 
 void STFT::computeInvWinMul(){
 
@@ -227,12 +394,52 @@ void STFT::computeInvWinMul(){
 }
 
 
+namespace{
+
+	struct WindowTable{
+		std::vector<float> samples;
+		float mean;
+	};
+
+	// Get forward window shared by all STFTs, building it on first use
+	const WindowTable& windowTable(WindowType type, unsigned size){
+		static std::mutex mutex;
+		static std::map<std::pair<int, unsigned>, WindowTable> tables;
+		std::lock_guard<std::mutex> lock(mutex);
+		WindowTable& t = tables[std::make_pair(int(type), size)];
+		if(t.samples.size() != size){
+			t.samples.resize(size);
+			tbl::window(t.samples.data(), size, type);
+			t.mean = size ? arr::mean(t.samples.data(), size) : 1.f;
+		}
+		return t;
+	}
+
+}
+
 STFT& STFT::windowType(WindowType v){
 	mWinType = v;
-	tbl::window(mFwdWin, sizeWin(), mWinType);
+
+	// Use a window held by reserve(), if any, to avoid locking
+	const float * samples = 0;
+	float mean = 1.f;
+	for(unsigned i=0; i<mWindows.size(); ++i){
+		const Window& w = mWindows[i];
+		if(w.type == v && w.size == sizeWin()){
+			samples = w.samples;
+			mean = w.mean;
+			break;
+		}
+	}
+	if(!samples){
+		const WindowTable& win = windowTable(mWinType, sizeWin());
+		samples = win.samples.data();
+		mean = win.mean;
+	}
+	mFwdWin = samples;
 	
 	// compute forward normalization factor
-	mFwdWinMul = 1.f / arr::mean(mFwdWin, sizeWin());
+	mFwdWinMul = 1.f / mean;
 	
 	// scale forward window?
 	//slice(mFwdWin, sizeWin()) *= mFwdWinMul;
@@ -243,9 +450,10 @@ STFT& STFT::windowType(WindowType v){
 
 
 void STFT::resize(unsigned winSize, unsigned padSize){
+	if(0 == winSize && 0 == padSize) return;
 	auto * origBufInv = mBufInv;
-	unsigned oldWinSize = sizeWin();
-	unsigned oldNumBins = numBins();
+	unsigned oldWinSize = scl::max(mCapWin, sizeWin());
+	unsigned oldNumBins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
 	
 	// resize DFT buffers
 	DFT::resize(winSize, padSize);
@@ -255,10 +463,10 @@ void STFT::resize(unsigned winSize, unsigned padSize){
 	
 	// resize STFT-specific buffers
 	mSlide.sizeWin(winSize);
-	mem::resize(mFwdWin, oldWinSize, winSize);
-	mem::resize(mBufInv, oldWinSize, winSize);
-	mem::resize(mPhases, oldNumBins, numBins());
-	mem::resize(mAccums, oldNumBins, numBins());
+	unsigned newNumBins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
+	mem::resize(mBufInv, oldWinSize, scl::max(mCapWin, winSize));
+	mem::resize(mPhases, oldNumBins, newNumBins);
+	mem::resize(mAccums, oldNumBins, newNumBins);
 
 	mem::deepZero(mBufInv, winSize);
 	mem::deepZero(mPhases, numBins());
@@ -269,6 +477,33 @@ void STFT::resize(unsigned winSize, unsigned padSize){
 }
 
 
+void STFT::reserve(unsigned maxWinSize, unsigned maxPadSize){
+	auto * origBufInv = mBufInv;
+	unsigned oldWinSize = scl::max(mCapWin, sizeWin());
+	unsigned oldNumBins = (scl::max(mCapDFT, sizeDFT()) + 2)>>1;
+
+	DFT::reserve(maxWinSize, maxPadSize);
+	mBufInv = origBufInv;			// DFT::reserve changes this, so change it back
+
+	unsigned newNumBins = (mCapDFT + 2)>>1;
+	mSlide.reserve(mCapWin);
+	mem::resize(mBufInv, oldWinSize, mCapWin);
+	mem::resize(mPhases, oldNumBins, newNumBins);
+	mem::resize(mAccums, oldNumBins, newNumBins);
+
+	auto hold = [this](unsigned n){
+		for(unsigned i=0; i<mWindows.size(); ++i){
+			if(mWindows[i].type == mWinType && mWindows[i].size == n) return;
+		}
+		const WindowTable& t = windowTable(mWinType, n);
+		Window w = { mWinType, n, t.samples.data(), t.mean };
+		mWindows.push_back(w);
+	};
+	for(unsigned n=2; n<=mCapWin; n<<=1) hold(n);
+	hold(mCapWin);
+}
+
+
 STFT& STFT::sizeHop(unsigned size){
 	// Note that this call will not trigger any memory reallocation
 	mSlide.sizeHop(size); // sets member var only
@@ -294,8 +529,10 @@ STFT& STFT::resetPhases(){
 	double expdp1 = double(sizeHop())/sizeWin() * M_2PI;
 	double fund = binFreq();
 
-	bin(0)[1] = 0.;
-	bin(numBins()-1)[1] = spu() * 0.5;
+	unsigned str;
+	float * frqs = frameComp(1, str);
+	frqs[0] = 0.;
+	frqs[(numBins()-1)*str] = spu() * 0.5;
 
 	for(unsigned k=1; k<numBins()-1; ++k){
 		double t = mPhases[k];		// the phase diff is simply the analysis phase
@@ -303,24 +540,39 @@ STFT& STFT::resetPhases(){
 		t = scl::wrapPhase(t);		// wrap back into [-pi, pi)
 		t *= factor;				// convert phase diff to freq deviation
 		t += k*fund;				// freq deviation to freq
-		bin(k)[1] = t;
+		frqs[k*str] = t;
 	}
 
 	return *this;
 }
 
 // input is sizeWin
-void STFT::forward(const float * src){ //printf("STFT::forward(float *)\n");
+void STFT::windowFrame(const float * src){
+	float * dst = bufFwdPos();
+	const float * win = mFwdWin;
+	const unsigned W = sizeWin(), D = sizeDFT();
+
+	// Zero-phase rotation moves the second half of the window to the start
+	// and the first half to the end, with the zero-padding between
+	const unsigned h = mRotateForward ? W/2 : 0;
+	for(unsigned i=h; i<W; ++i) dst[i-h] = src[i] * win[i];
+	mem::deepZero(dst + W-h, D-W);
+	dst += D-h;
+	for(unsigned i=0; i<h; ++i) dst[i] = src[i] * win[i];
+}
 
-	if(src) mem::deepCopy(bufFwdPos(), src, sizeWin());
+void STFT::forward(const float * src){ //printf("STFT::forward(float *)\n");
 
-	// apply forward window
-	arr::mul(bufFwdPos(), mFwdWin, sizeWin());
-	
-	// do zero-phase windowing rotation?
-	if(mRotateForward) mem::rotateLeft(sizeWin()/2, bufFwdPos(), sizeDFT());
+	if(src && src != bufFwdPos()){
+		windowFrame(src);
+	}
+	else{	// samples are in forward buffer
+		arr::mul(bufFwdPos(), mFwdWin, sizeWin());
+		mem::deepZero(bufFwdPos() + sizeWin(), sizePad());
+		if(mRotateForward) mem::rotateLeft(sizeWin()/2, bufFwdPos(), sizeDFT());
+	}
 
-	DFT::forward();
+	forwardBins();
 	
 	// compute frequency estimates?
 	if(MAG_FREQ == mSpctFormat){
@@ -346,6 +598,8 @@ void STFT::forward(const float * src){ //printf("STFT::forward(float *)\n");
 			bin(k)[1] = t;
 		}
 	}
+
+	splitFrame();
 }
 
 
@@ -359,19 +613,23 @@ void STFT::inverse(float * dst){
 		double expdp1 = double(sizeHop())/sizeWin() * M_2PI;
 		double fund = binFreq();
 
+		unsigned str;
+		const float * mags = frameComp(0, str);
+		const float * frqs = frameComp(1, str);
+
 		for(unsigned k=1; k<numBins()-1; ++k){
-			double t = bin(k)[1];		// freq
+			double t = frqs[k*str];		// freq
 			t -= k*fund;				// freq to freq deviation
 			t *= factor;				// freq deviation to phase diff
 			t += k*expdp1;				// add expected phase diff due to overlap
 			mAccums[k] += t;			// accumulate phase diff
 			//bin(k)[1] = mAccums[k];		// copy accum phase for inverse xfm
-			bufInvFrq()[2*k] = bin(k)[0];
+			bufInvFrq()[2*k] = mags[k*str];
 			bufInvFrq()[2*k+1] = mAccums[k];
 		}
 
-		bufInvFrq()[0] = bin(0)[0];
-		bufInvFrq()[2*(numBins()-1)] = bin(numBins()-1)[0];
+		bufInvFrq()[0] = mags[0];
+		bufInvFrq()[2*(numBins()-1)] = mags[(numBins()-1)*str];
 	}
 
 	DFT::inverse();	// result goes into bufInvPos()
@@ -411,6 +669,188 @@ void STFT::print(FILE * f, const char * a){
 	fprintf(f, "%s", a);
 }
 
+
+
+// Spectral kernels of all bins of a constant-Q transform. Bin k correlates
+// FFT bins [first[k], first[k] + length[k]) with the run of coefficients
+// starting at offset[k].
+struct ConstantQ::Kernel{
+	unsigned sizeFFT;
+	std::vector<unsigned> first, length, offset;
+	std::vector<float> re, im;
+
+	Kernel(double minFreq, unsigned numBins, unsigned binsPerOctave, double spu, float thresh){
+		const double Q = 1. / (::pow(2., 1./binsPerOctave) - 1.);
+		const unsigned maxLen = unsigned(::ceil(Q * spu / minFreq));
+		sizeFFT = 1;
+		while(sizeFFT < maxLen) sizeFFT <<= 1;
+
+		RFFT<float> fft(sizeFFT);
+		std::vector<float> t(sizeFFT), u(sizeFFT);
+		first.resize(numBins); length.resize(numBins); offset.resize(numBins);
+
+		for(unsigned k=0; k<numBins; ++k){
+			first[k] = length[k] = 0;
+			offset[k] = unsigned(re.size());
+			const double f = minFreq * ::pow(2., double(k)/binsPerOctave);
+			if(f >= spu*0.5) continue;
+			const unsigned N = unsigned(::ceil(Q * spu / f));
+			const unsigned start = (sizeFFT - N)/2;
+
+			// Windowed complex sinusoid, scaled so a real sinusoid at f of
+			// amplitude A correlates to magnitude A. Spectra of its real and
+			// imaginary parts are found by separate real FFTs.
+			double wsum = 0.;
+			for(unsigned n=0; n<N; ++n) wsum += 0.5 - 0.5*::cos(M_2PI*(n+0.5)/N);
+			for(unsigned n=0; n<sizeFFT; ++n) t[n] = u[n] = 0.f;
+			for(unsigned n=0; n<N; ++n){
+				const double w = (1. - ::cos(M_2PI*(n+0.5)/N)) / wsum;
+				const double p = M_2PI * f * (double(n) - 0.5*N) / spu;
+				t[start+n] = float(w * ::cos(p));
+				u[start+n] = float(w * ::sin(p));
+			}
+			fft.forward(&t[0], false, false);
+			fft.forward(&u[0], false, false);
+
+			// Bins of the kernel spectrum K = T + iU at positive frequencies.
+			// The transform is a correlation, sum_n x[n] conj(k[n]), which
+			// is sum_j X[j] conj(K[j]) / sizeFFT over the spectrum.
+			const unsigned H = sizeFFT/2;
+			std::vector<float> kr(H+1), ki(H+1);
+			float peak = 0.f;
+			for(unsigned j=0; j<=H; ++j){
+				float tr, ti, ur, ui;
+				if(0 == j){ tr = t[0]; ti = 0.f; ur = u[0]; ui = 0.f; }
+				else if(H == j){ tr = t[sizeFFT-1]; ti = 0.f; ur = u[sizeFFT-1]; ui = 0.f; }
+				else{ tr = t[2*j-1]; ti = t[2*j]; ur = u[2*j-1]; ui = u[2*j]; }
+				kr[j] = tr - ui;
+				ki[j] = ti + ur;
+				const float m = kr[j]*kr[j] + ki[j]*ki[j];
+				if(m > peak) peak = m;
+			}
+			const float floor = peak * thresh * thresh;
+			unsigned lo = 0, hi = H+1;
+			while(lo < hi && kr[lo]*kr[lo] + ki[lo]*ki[lo] < floor) ++lo;
+			while(hi > lo && kr[hi-1]*kr[hi-1] + ki[hi-1]*ki[hi-1] < floor) --hi;
+
+			// The kernel is analytic, so the negative frequencies it drops
+			// hold almost nothing
+			first[k] = lo;
+			length[k] = hi - lo;
+			for(unsigned j=lo; j<hi; ++j){
+				re.push_back( kr[j] / sizeFFT);
+				im.push_back(-ki[j] / sizeFFT);	// conjugate
+			}
+		}
+	}
+};
+
+namespace{
+
+	// Kernels shared by all transforms of a configuration. The cache holds
+	// weak references, so kernels are freed with the last transform using
+	// them and the cache only grows with the configurations in use.
+	struct ConstantQKernels{
+		typedef std::tuple<double, unsigned, unsigned, double, float> Key;
+		std::mutex mutex;
+		std::map<Key, std::weak_ptr<const ConstantQ::Kernel> > kernels;
+
+		// Remove kernels no longer in use; call with mutex locked
+		void prune(){
+			for(auto it = kernels.begin(); it != kernels.end(); ){
+				if(it->second.expired()) it = kernels.erase(it);
+				else ++it;
+			}
+		}
+
+		static ConstantQKernels& get(){
+			static ConstantQKernels c;
+			return c;
+		}
+	};
+
+	std::shared_ptr<const ConstantQ::Kernel> constantQKernel(
+		double minFreq, unsigned numBins, unsigned binsPerOctave, double spu, float thresh
+	){
+		ConstantQKernels& c = ConstantQKernels::get();
+		std::lock_guard<std::mutex> lock(c.mutex);
+		c.prune();
+		auto& w = c.kernels[ConstantQKernels::Key(minFreq, numBins, binsPerOctave, spu, thresh)];
+		auto k = w.lock();
+		if(!k){
+			k = std::make_shared<const ConstantQ::Kernel>(minFreq, numBins, binsPerOctave, spu, thresh);
+			w = k;
+		}
+		return k;
+	}
+
+}
+
+unsigned ConstantQ::cachedKernels(){
+	ConstantQKernels& c = ConstantQKernels::get();
+	std::lock_guard<std::mutex> lock(c.mutex);
+	c.prune();
+	return unsigned(c.kernels.size());
+}
+
+ConstantQ::ConstantQ(float minFreq, unsigned numBins, unsigned binsPerOctave, unsigned hopSize)
+:	mSlide(1, hopSize), mMinFreq(minFreq), mNumBins(numBins), mBinsPerOctave(binsPerOctave),
+	mHop(hopSize), mThresh(0.005f)
+{
+	build();
+}
+
+ConstantQ& ConstantQ::set(float minFreq, unsigned numBins, unsigned binsPerOctave){
+	mMinFreq = minFreq;
+	mNumBins = numBins;
+	mBinsPerOctave = binsPerOctave ? binsPerOctave : 1;
+	build();
+	return *this;
+}
+
+void ConstantQ::onDomainChange(double /*r*/){
+	build();
+}
+
+void ConstantQ::build(){
+	mKernel = constantQKernel(mMinFreq, mNumBins, mBinsPerOctave, spu(), mThresh);
+	const unsigned M = mKernel->sizeFFT;
+	if(sizeFFT() != M){
+		mSlide.resize(M, mHop);
+		mFFT.resize(M);
+		mFrame.assign(M, 0.f);
+		mBuf.resize(M);
+		mRe.resize(M/2 + 1);
+		mIm.resize(M/2 + 1);
+	}
+	mBins.assign(mNumBins, Complex<float>(0,0));
+}
+
+void ConstantQ::forward(const float * src){
+	const Kernel& K = *mKernel;
+	const unsigned M = K.sizeFFT, H = M/2;
+
+	// Split spectrum into contiguous real and imaginary parts
+	float * b = &mBuf[0];
+	mem::deepCopy(b, src, M);
+	mFFT.forward(b, false, false);
+	float * xr = &mRe[0], * xi = &mIm[0];
+	xr[0] = b[0]; xi[0] = 0.f;
+	xr[H] = b[M-1]; xi[H] = 0.f;
+	for(unsigned j=1; j<H; ++j){ xr[j] = b[2*j-1]; xi[j] = b[2*j]; }
+
+	// Complex dot product of each kernel with its run of bins
+	for(unsigned k=0; k<mNumBins; ++k){
+		const unsigned j = K.first[k], n = K.length[k];
+		const float * kr = K.re.data() + K.offset[k];
+		const float * ki = K.im.data() + K.offset[k];
+		mBins[k](
+			arr::dot(xr+j, kr, n) - arr::dot(xi+j, ki, n),
+			arr::dot(xr+j, ki, n) + arr::dot(xi+j, kr, n)
+		);
+	}
+}
+
 } // gam::
 
 #undef CART_TO_POL
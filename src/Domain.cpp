@@ -1,35 +1,66 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <thread> // yield
 #include "Gamma/Domain.h"
 
 namespace gam{
 
+// Scoped lock of a domain's observer list. Locks held by a thread are chained
+// so that an observer notified by a domain can attach to or detach from it
+// without deadlocking.
+class Domain::ListLock{
+public:
+	explicit ListLock(const Domain& d)
+	:	mDomain(d), mPrev(tTop), mHeld(held(d))
+	{
+		if(!mHeld){
+			while(d.mListLock.test_and_set(std::memory_order_acquire)){
+				std::this_thread::yield();
+			}
+		}
+		tTop = this;
+	}
+
+	~ListLock(){
+		tTop = mPrev;
+		if(!mHeld) mDomain.mListLock.clear(std::memory_order_release);
+	}
+
+private:
+	const Domain& mDomain;
+	ListLock * mPrev;
+	bool mHeld;
+	static thread_local ListLock * tTop;
+
+	static bool held(const Domain& d){
+		for(ListLock * l = tTop; l; l = l->mPrev){
+			if(&l->mDomain == &d) return true;
+		}
+		return false;
+	}
+};
+
+thread_local Domain::ListLock * Domain::ListLock::tTop = 0;
+
 
 DomainObserver::DomainObserver()
-:	mSubject(0)
+:	mSubject(0), mSyncedSPU(1.), mObserving(false)
 {
 	//printf("DomainObserver::DomainObserver() - %p\n", this);
-	domain(Domain::master());
+	domain(Domain::current());
 }
 
 DomainObserver::DomainObserver(const DomainObserver& rhs)
-:	mSubject(0)
+:	mSubject(0), mSyncedSPU(1.), mObserving(false)
 {
 	//printf("DomainObserver::DomainObserver(const DomainObserver&) - %p\n", this);
-	Domain& s = rhs.mSubject ? *rhs.mSubject : Domain::master();
+	Domain& s = rhs.mSubject ? *rhs.mSubject : Domain::current();
 	domain(s);
 }
 
 DomainObserver::~DomainObserver(){
-	if(mSubject && mSubject->mHeadObserver == this){
-		if(nodeR){
-			mSubject->mHeadObserver = nodeR;
-		}
-		else{
-			mSubject->mHeadObserver = NULL;
-		}
-	}
+	detach();
 }
 
 DomainObserver& DomainObserver::operator= (const DomainObserver& rhs){
@@ -41,32 +72,51 @@ DomainObserver& DomainObserver::operator= (const DomainObserver& rhs){
 	return *this;
 }
 
+void DomainObserver::detach(){
+	if(mObserving){
+		mSubject->detach(*this);
+		mObserving = false;
+	}
+}
+
 void DomainObserver::domain(Domain& newSubject){
 	if(&newSubject != mSubject){
-		if(mSubject){
-			// If head of list, then set head to right node
-			if(mSubject->mHeadObserver == this){
-				mSubject->mHeadObserver = this->nodeR;
-			}
-
-			nodeRemove();
+		detach();
+		if(!newSubject.fixed()){
+			newSubject.attach(*this);
+			mObserving = true;
 		}
-		newSubject.attach(*this);
-		double r = newSubject.spu() / (mSubject ? mSubject->spu() : 1.);
+		double r = newSubject.spu() / mSyncedSPU;
 		mSubject = &newSubject;
+		mSyncedSPU = newSubject.spu();
+		onDomainChange(r);
+	}
+}
+
+bool DomainObserver::syncDomain(){
+	if(mSubject && mSubject->spu() != mSyncedSPU){
+		double r = mSubject->spu() / mSyncedSPU;
+		mSyncedSPU = mSubject->spu();
 		onDomainChange(r);
+		return true;
 	}
+	return false;
 }
 
 
 
 Domain::Domain()
-:	mSPU(1.), mUPS(1.), mHeadObserver(NULL), mHasBeenSet(false)
-{}
+:	mSPU(1.), mUPS(1.), mHeadObserver(NULL), mPending(NULL),
+	mHasBeenSet(false), mDeferred(false), mFixed(false)
+{
+	mListLock.clear();
+}
 
 Domain::Domain(double spuA)
-:	mHeadObserver(NULL)
+:	mSPU(1.), mUPS(1.), mHeadObserver(NULL), mPending(NULL),
+	mHasBeenSet(false), mDeferred(false), mFixed(false)
 {
+	mListLock.clear();
 	spu(spuA);
 }
 
@@ -85,6 +135,7 @@ Domain& Domain::operator<< (DomainObserver& obs){
 }
 
 void Domain::attach(DomainObserver& obs){
+	ListLock lock(*this);
 	if(mHeadObserver){
 		// insert new observer onto front of list
 		obs.nodeInsertL(*mHeadObserver);
@@ -96,12 +147,31 @@ void Domain::attach(DomainObserver& obs){
 	//printf("%p: ", &obs); mHeadObserver->print();
 }
 
+void Domain::detach(DomainObserver& obs){
+	ListLock lock(*this);
+	if(mHeadObserver == &obs) mHeadObserver = obs.nodeR;
+	if(mPending == &obs) mPending = obs.nodeR;
+	obs.nodeRemove();
+}
+
 void Domain::notifyObservers(double r){
+	ListLock lock(*this);
 	DomainObserver * s = mHeadObserver;
 
 	while(s){	//printf("Domain %p: Notifying %p\n", this, s);
+		DomainObserver * next = s->nodeR; // s may detach itself
+		s->mSyncedSPU = mSPU;
 		s->onDomainChange(r);
-		s = s->nodeR;
+		s = next;
+	}
+}
+
+void Domain::syncObservers(unsigned maxCount){
+	ListLock lock(*this);
+	while(mPending && maxCount){
+		DomainObserver * s = mPending;
+		mPending = s->nodeR; // s may detach itself
+		if(s->syncDomain()) --maxCount;
 	}
 }
 
@@ -111,7 +181,14 @@ void Domain::spu(double v){ //printf("[%p] Domain::spu(%g)\n", this, v);
 		double r = v/mSPU;
 		mSPU = v;
 		mUPS = 1. / v;
-		notifyObservers(r);	// calls onDomainChange() of each observer
+		if(mDeferred || mPending){
+			ListLock lock(*this);
+			mPending = mHeadObserver;	// revisit all, newest first
+			if(!mDeferred) syncObservers(); // some are behind earlier changes
+		}
+		else{
+			notifyObservers(r);	// calls onDomainChange() of each observer
+		}
 	}
 }
 
@@ -119,6 +196,7 @@ void Domain::ups(double val){ spu(1./val); }
 
 void Domain::print(FILE * fp) const {
 	fprintf(fp, "Domain %p:\n\tspu = %f, ups = %f\n", this, spu(), ups());
+	ListLock lock(*this);
 
 	DomainObserver * o = mHeadObserver;
 	unsigned numObs = 0;
@@ -139,11 +217,54 @@ void Domain::print(FILE * fp) const {
 	}
 }
 
+
+
+ControlDomain::ControlDomain(unsigned blockSize_)
+:	mBlockSize(1)
+{
+	blockSize(blockSize_);
+}
+
+ControlDomain::ControlDomain(Domain& parent, unsigned blockSize_)
+:	mBlockSize(1)
+{
+	DomainObserver::domain(parent);
+	blockSize(blockSize_);
+}
+
+ControlDomain& ControlDomain::blockSize(unsigned v){
+	mBlockSize = v ? v : 1;
+	onDomainChange(1);
+	return *this;
+}
+
+void ControlDomain::onDomainChange(double /*r*/){
+	Domain::spu(DomainObserver::spu() / mBlockSize);
+}
+
 /*static*/ Domain& Domain::master(){
 	static Domain * s = new Domain;
 	return *s;
 }
 
+namespace{
+	thread_local Domain * tCurrent = 0; // innermost DomainScope's domain
+}
+
+/*static*/ Domain& Domain::current(){
+	return tCurrent ? *tCurrent : master();
+}
+
+DomainScope::DomainScope(Domain& d)
+:	mPrev(tCurrent)
+{
+	tCurrent = &d;
+}
+
+DomainScope::~DomainScope(){
+	tCurrent = mPrev;
+}
+
 /*static*/ void sampleRate(double samplesPerSecond){
 	Domain::master().spu(samplesPerSecond);
 }
@@ -0,0 +1,442 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cmath>
+#include "Gamma/Effects.h"
+
+namespace gam{
+
+PluckBank::PluckBank(unsigned n, float minFreq)
+:	mMinFreq(minFreq), mSleep(1e-4), mCap(0), mPos(0)
+{
+	strings(n);
+}
+
+PluckBank& PluckBank::strings(unsigned n){
+	mFreq.resize(n, 220); mDecay.resize(n, 4); mBright.resize(n, 0.5);
+	mDelay.resize(n); mFrac.resize(n); mGain.resize(n);
+	mH0.resize(n); mH1.resize(n);
+	mAP.resize(n); mZ.resize(n); mQuiet.resize(n);
+	mAwake.resize(n);
+	mIDs.reserve(n);
+	onDomainChange(1);
+	reset();
+	return *this;
+}
+
+PluckBank& PluckBank::freq(unsigned s, float v){
+	mFreq[s] = v; tune(s); return *this;
+}
+
+PluckBank& PluckBank::decay(unsigned s, float v){
+	mDecay[s] = v; tune(s); return *this;
+}
+
+PluckBank& PluckBank::brightness(unsigned s, float v){
+	mBright[s] = scl::clip(v, 1.f, 0.f); tune(s); return *this;
+}
+
+void PluckBank::tune(unsigned s){
+	// The loop delays by the integer delay, 1.618 - frac samples through the
+	// allpass and (1 - brightness)/2 samples through the loop filter.
+	const double maxPeriod = spu() / mMinFreq;
+	double period = spu() / mFreq[s];
+	if(period > maxPeriod) period = maxPeriod;
+	const double b = mBright[s];
+	const double r = period - 0.5*(1. - b);
+	double d = std::ceil(r - 1.618);
+	if(d < 1.) d = 1.;
+	mDelay[s] = unsigned(d);
+	mFrac[s] = float(scl::clip(1.618 - (r - d), 0.999, 0.));
+	mGain[s] = float(std::pow(scl::t60(mDecay[s] * spu()), period));
+	mH0[s] = float(0.5*(1. + b));
+	mH1[s] = float(0.5*(1. - b));
+}
+
+void PluckBank::clear(unsigned s){
+	std::fill(&mArena[0] + s*mCap, &mArena[0] + (s+1)*mCap, 0.f);
+	mAP[s] = mZ[s] = 0.f;
+	mQuiet[s] = 0;
+	mAwake[s] = 0;
+}
+
+void PluckBank::reset(){
+	for(unsigned s=0; s<strings(); ++s) clear(s);
+}
+
+PluckBank& PluckBank::pluck(unsigned s, float amp){
+	float * line = &mArena[0] + s*mCap;
+	const unsigned len = mDelay[s] + 2;
+	for(unsigned i=1; i<=len; ++i){
+		line[(mPos - i) & (mCap-1)] = mNoise() * amp;
+	}
+	mAP[s] = mZ[s] = 0.f;
+	mQuiet[s] = 0;
+	mAwake[s] = 1;
+	return *this;
+}
+
+unsigned PluckBank::active() const {
+	return unsigned(std::count(mAwake.begin(), mAwake.end(), 1));
+}
+
+void PluckBank::onDomainChange(double /*r*/){
+	const unsigned len = unsigned(std::ceil(spu() / mMinFreq)) + 4;
+	unsigned cap = 1;
+	while(cap < len) cap <<= 1;
+	if(cap != mCap || mArena.size() != cap*strings()){
+		mCap = cap;
+		mArena.assign(mCap * strings(), 0.f);
+		for(unsigned s=0; s<strings(); ++s) clear(s);
+	}
+	for(unsigned s=0; s<strings(); ++s) tune(s);
+}
+
+template <unsigned L>
+void PluckBank::render(const unsigned * ids, float * dst, unsigned n){
+	float * line[L];
+	unsigned D[L];
+	float f[L], g[L], h0[L], h1[L], ap[L], z[L], pk[L];
+	for(unsigned k=0; k<L; ++k){
+		const unsigned s = ids[k];
+		line[k] = &mArena[0] + s*mCap;
+		D[k] = mDelay[s]; f[k] = mFrac[s]; g[k] = mGain[s];
+		h0[k] = mH0[s]*g[k]; h1[k] = mH1[s]*g[k];
+		ap[k] = mAP[s]; z[k] = mZ[s]; pk[k] = 0.f;
+	}
+	const unsigned mask = mCap-1;
+	for(unsigned i=0; i<n; ++i){
+		const unsigned p = mPos + i;
+		float nw[L], od[L];
+		for(unsigned k=0; k<L; ++k){
+			const unsigned j = p - D[k];
+			nw[k] = line[k][j & mask];
+			od[k] = line[k][(j-1) & mask];
+		}
+		float y[L];
+		for(unsigned k=0; k<L; ++k){
+			const float a = ipl::allpass(f[k], od[k], nw[k], ap[k]);
+			y[k] = h0[k]*a + h1[k]*z[k];
+			z[k] = a;
+			pk[k] = pk[k] > std::fabs(y[k]) ? pk[k] : std::fabs(y[k]);
+		}
+		float sum = 0.f;
+		for(unsigned k=0; k<L; ++k){
+			line[k][p & mask] = y[k];
+			sum += y[k];
+		}
+		dst[i] += sum;
+	}
+	for(unsigned k=0; k<L; ++k){
+		const unsigned s = ids[k];
+		mAP[s] = ap[k]; mZ[s] = z[k];
+		if(pk[k] < mSleep){
+			mQuiet[s] += n;
+			if(mQuiet[s] > D[k] + 2) clear(s);
+		}
+		else{
+			mQuiet[s] = 0;
+		}
+	}
+}
+
+void PluckBank::operator()(float * dst, unsigned n){
+	std::fill(dst, dst+n, 0.f);
+	mIDs.clear();
+	for(unsigned s=0; s<strings(); ++s) if(mAwake[s]) mIDs.push_back(s);
+	const unsigned num = unsigned(mIDs.size());
+	const unsigned full = num / LANES * LANES;
+	unsigned c=0;
+	for(; c<full; c+=LANES) render<LANES>(&mIDs[c], dst, n);
+	for(; c<num; ++c) render<1>(&mIDs[c], dst, n);
+	mPos += n;
+}
+
+
+namespace{
+	// Resize to cap, copying the last of the first n values into new ones
+	void grow(std::vector<float>& v, unsigned n, unsigned cap, float init){
+		const float x = n ? v[n-1] : init;
+		v.resize(cap);
+		for(unsigned i=n; i<cap; ++i) v[i] = x;
+	}
+}
+
+const float CompressorBank::cDBToLog2 = 0.166096404744f; // log2(10)/20
+const float CompressorBank::cLog2ToDB = 6.02059991328f;
+
+CompressorBank::CompressorBank(unsigned chans, float thresholdA, float ratioA, float attackA, float releaseA)
+:	mChannels(0), mLink(false)
+{
+	channels(chans);
+	threshold(thresholdA).ratio(ratioA).attack(attackA).release(releaseA);
+}
+
+CompressorBank& CompressorBank::channels(unsigned n){
+	const unsigned cap = (n + LANES-1) / LANES * LANES;
+	const unsigned c = mChannels;
+	grow(mThresh, c, cap, 0.f); grow(mSlope, c, cap, 0.f); grow(mExpand, c, cap, 0.f);
+	grow(mKnee, c, cap, 0.f); grow(mKneeHalf, c, cap, 0.f); grow(mKneeScale, c, cap, 0.f);
+	grow(mRange, c, cap, -1e9f); grow(mMakeup, c, cap, 0.f);
+	grow(mAtk, c, cap, 0.f); grow(mRel, c, cap, 0.f);
+	grow(mCAtk, c, cap, 1.f); grow(mCRel, c, cap, 1.f);
+	mGain.assign(cap, 0.f);
+	mChannels = n;
+	return *this;
+}
+
+CompressorBank& CompressorBank::knee(unsigned c, float dB){
+	const float w = std::fabs(dB) * cDBToLog2;
+	mKnee[c] = w;
+	mKneeHalf[c] = 0.5f*w;
+	mKneeScale[c] = w > 0.f ? 0.5f/w : 0.f;
+	return *this;
+}
+
+CompressorBank& CompressorBank::attack(unsigned c, float v){
+	mAtk[c] = v; mCAtk[c] = coef(v * spu()); return *this;
+}
+
+CompressorBank& CompressorBank::release(unsigned c, float v){
+	mRel[c] = v; mCRel[c] = coef(v * spu()); return *this;
+}
+
+void CompressorBank::onDomainChange(double /*r*/){
+	for(unsigned c=0; c<mChannels; ++c){
+		attack(c, mAtk[c]);
+		release(c, mRel[c]);
+	}
+}
+
+void CompressorBank::reset(){
+	std::fill(mGain.begin(), mGain.end(), 0.f);
+}
+
+// Gains are in log2 units. Above the knee, the gain is slope times the
+// level over threshold. Within the knee, (level - threshold + knee/2)^2
+// over (2 knee) replaces the level over threshold, which is continuous
+// with it in value and derivative at both ends and handles a zero knee
+// without a branch.
+void CompressorBank::process(const float * in, float * out, unsigned n, const float * side){
+	const float * det = side ? side : in;
+	const unsigned C = mChannels;
+	for(unsigned b=0; b<n; b+=BLOCK){
+		const unsigned m = n-b < BLOCK ? n-b : unsigned(BLOCK);
+
+		if(mLink){
+			for(unsigned i=0; i<m; ++i) mPeak[i] = 0.f;
+			for(unsigned c=0; c<C; ++c){
+				const float * x = det + c*n + b;
+				for(unsigned i=0; i<m; ++i){
+					const float a = std::fabs(x[i]);
+					mPeak[i] = a > mPeak[i] ? a : mPeak[i];
+				}
+			}
+		}
+
+		for(unsigned c0=0; c0<C; c0+=LANES){
+			const unsigned L = C-c0 < LANES ? C-c0 : unsigned(LANES);
+			float * v = mBuf + LANES; // after previous gains
+
+			// Detector levels, transposed so lanes are adjacent
+			if(mLink){
+				for(unsigned i=0; i<m; ++i){
+					for(unsigned l=0; l<LANES; ++l) v[i*LANES + l] = mPeak[i];
+				}
+			}
+			else{
+				for(unsigned l=0; l<L; ++l){
+					const float * x = det + (c0+l)*n + b;
+					for(unsigned i=0; i<m; ++i) v[i*LANES + l] = std::fabs(x[i]);
+				}
+				for(unsigned l=L; l<LANES; ++l){
+					for(unsigned i=0; i<m; ++i) v[i*LANES + l] = 0.f;
+				}
+			}
+			for(unsigned j=0; j<m*LANES; ++j) v[j] = v[j] > 1e-30f ? v[j] : 1e-30f;
+			scl::log2Fast(v, v, m*LANES);
+
+			// Static curve; lane parameters are copied so that the compiler
+			// knows they do not alias the buffer
+			float T[LANES], S[LANES], E[LANES], W[LANES], W2[LANES], WS[LANES], R[LANES];
+			float CA[LANES], CR[LANES], M[LANES];
+			for(unsigned l=0; l<LANES; ++l){
+				T[l] = mThresh[c0+l]; S[l] = mSlope[c0+l]; E[l] = mExpand[c0+l];
+				W[l] = mKnee[c0+l]; W2[l] = mKneeHalf[c0+l]; WS[l] = mKneeScale[c0+l];
+				R[l] = mRange[c0+l]; mBuf[l] = mGain[c0+l];
+				CA[l] = mCAtk[c0+l]; CR[l] = mCRel[c0+l]; M[l] = mMakeup[c0+l];
+			}
+			for(unsigned i=0; i<m; ++i){
+				float * x = v + i*LANES;
+				for(unsigned l=0; l<LANES; ++l){
+					const float over = x[l] - T[l];
+					float k = over + W2[l];
+					k = k > 0.f ? k : 0.f;
+					k = k < W[l] ? k : W[l];
+					float above = over - W2[l];
+					above = above > 0.f ? above : 0.f;
+					const float under = over < 0.f ? over : 0.f;
+					const float g = S[l]*(k*k*WS[l] + above) + E[l]*under;
+					x[l] = g > R[l] ? g : R[l];
+				}
+			}
+
+			// Attack and release smoothing; each row follows the previous
+			// one, so the recursion runs across lanes
+			for(unsigned i=0; i<m; ++i){
+				float * x = v + i*LANES;
+				const float * p = x - LANES;
+				for(unsigned l=0; l<LANES; ++l){
+					const float d = x[l] - p[l];
+					const float c = d < 0.f ? CA[l] : CR[l];
+					x[l] = p[l] + d*c;
+				}
+			}
+			for(unsigned l=0; l<LANES; ++l) mGain[c0+l] = v[(m-1)*LANES + l];
+
+			for(unsigned i=0; i<m; ++i){
+				float * x = v + i*LANES;
+				for(unsigned l=0; l<LANES; ++l) x[l] += M[l];
+			}
+			scl::pow2Fast(v, v, m*LANES);
+
+			for(unsigned l=0; l<L; ++l){
+				const float * x = in + (c0+l)*n + b;
+				float * y = out + (c0+l)*n + b;
+				for(unsigned i=0; i<m; ++i) y[i] = x[i] * v[i*LANES + l];
+			}
+		}
+	}
+}
+
+
+Limiter::Limiter(unsigned chans, float threshold, float lookaheadA, float releaseA)
+:	mChannels(chans), mThresh(threshold), mLook(lookaheadA), mRel(releaseA), mCRel(1),
+	mWin(1), mMask(0), mPos(0), mQHead(0), mQSize(0), mIdx(0), mBoxPos(0), mBoxSum(1),
+	mEnv(1), mGain(1)
+{
+	onDomainChange(1);
+}
+
+Limiter& Limiter::channels(unsigned n){
+	mChannels = n; resize(); return *this;
+}
+
+Limiter& Limiter::lookahead(float v){
+	mLook = v; resize(); return *this;
+}
+
+Limiter& Limiter::release(float v){
+	mRel = v;
+	const double samples = v * spu();
+	mCRel = samples > 1. ? float(1. - std::exp(-1. / samples)) : 1.f;
+	return *this;
+}
+
+void Limiter::onDomainChange(double /*r*/){
+	release(mRel);
+	resize();
+}
+
+void Limiter::resize(){
+	const double look = mLook * spu();
+	mWin = (look > 0. ? unsigned(look + 0.5) : 0) + 1;
+	unsigned cap = 1;
+	while(cap < mWin + BLOCK) cap <<= 1;
+	mMask = cap - 1;
+	mDelay.assign(mChannels * cap, 0.f);
+	mQVal.assign(mWin, 1.f);
+	mQIdx.assign(mWin, 0);
+	mBox.assign(mWin, 1.f);
+	reset();
+}
+
+void Limiter::reset(){
+	std::fill(mDelay.begin(), mDelay.end(), 0.f);
+	std::fill(mBox.begin(), mBox.end(), 1.f);
+	mPos = mQHead = mQSize = mBoxPos = 0;
+	mIdx = 0;
+	mBoxSum = mWin;
+	mEnv = mGain = 1.f;
+}
+
+// The gain of output sample n, which is input sample n - (W-1) for a window
+// of W samples, is the mean of the released minima ending at samples
+// n-W+1 ... n. Each of those windows holds input sample n - (W-1), so the
+// gain is at most its required gain.
+void Limiter::process(const float * in, float * out, unsigned n){
+	const unsigned W = mWin;
+	const unsigned cap = mMask + 1;
+	for(unsigned b=0; b<n; b+=BLOCK){
+		const unsigned m = n-b < BLOCK ? n-b : unsigned(BLOCK);
+
+		// Peak across linked channels
+		for(unsigned i=0; i<m; ++i) mPeak[i] = 0.f;
+		for(unsigned c=0; c<mChannels; ++c){
+			const float * x = in + c*n + b;
+			for(unsigned i=0; i<m; ++i){
+				const float a = std::fabs(x[i]);
+				mPeak[i] = a > mPeak[i] ? a : mPeak[i];
+			}
+		}
+
+		for(unsigned i=0; i<m; ++i){
+			const float p = mPeak[i];
+			const float r = p > mThresh ? mThresh / p : 1.f;
+
+			// Sliding minimum: drop the expired front, then larger values at
+			// the back, which can no longer be the minimum
+			if(mQSize && mQIdx[mQHead] + W <= mIdx){
+				if(++mQHead == W) mQHead = 0;
+				--mQSize;
+			}
+			unsigned back = mQHead + mQSize;
+			if(back >= W) back -= W;
+			while(mQSize){
+				const unsigned last = back ? back-1 : W-1;
+				if(mQVal[last] < r) break;
+				back = last;
+				--mQSize;
+			}
+			mQVal[back] = r;
+			mQIdx[back] = mIdx;
+			++mQSize;
+			++mIdx;
+
+			// Instant attack, exponential release
+			const float h = mQVal[mQHead];
+			mEnv = h < mEnv ? h : mEnv + (h - mEnv)*mCRel;
+
+			// Moving average, resummed each window to bound rounding drift
+			mBoxSum += double(mEnv) - mBox[mBoxPos];
+			mBox[mBoxPos] = mEnv;
+			if(++mBoxPos == W){
+				mBoxPos = 0;
+				double sum = 0.;
+				for(unsigned k=0; k<W; ++k) sum += mBox[k];
+				mBoxSum = sum;
+			}
+			mBlockGain[i] = float(mBoxSum / W);
+		}
+		mGain = mBlockGain[m-1];
+
+		// Delay each channel and apply gain
+		const unsigned rd = (mPos + cap - (W-1)) & mMask;
+		for(unsigned c=0; c<mChannels; ++c){
+			float * ring = &mDelay[c*cap];
+			const float * x = in + c*n + b;
+			float * y = out + c*n + b;
+			const unsigned w1 = cap - mPos < m ? cap - mPos : m;
+			std::copy(x, x + w1, ring + mPos);
+			std::copy(x + w1, x + m, ring);
+			const unsigned r1 = cap - rd < m ? cap - rd : m;
+			const float * src = ring + rd;
+			for(unsigned i=0; i<r1; ++i) y[i] = src[i] * mBlockGain[i];
+			for(unsigned i=r1; i<m; ++i) y[i] = ring[i-r1] * mBlockGain[i];
+		}
+		mPos = (mPos + m) & mMask;
+	}
+}
+
+} // gam::
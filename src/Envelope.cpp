@@ -0,0 +1,550 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cmath>
+#include "Gamma/Envelope.h"
+
+namespace gam{
+
+namespace{
+	// Curve with its coefficients exposed, to design segments as Curve::set
+	struct CurveCoefs : public Curve<float,float>{
+		CurveCoefs(float len, float crv, float start, float end)
+		:	Curve<float,float>(len, crv, start, end){}
+		float a() const { return mA; }
+		float b() const { return mB; }
+		float mul() const { return mMul; }
+	};
+
+	enum{ CHUNK = 32 };	// samples scanned at once by banks of channels
+
+	struct EventOrder{
+		template <class E>
+		bool operator()(const E& x, const E& y) const {
+			return x.voice < y.voice || (x.voice == y.voice && x.offset < y.offset);
+		}
+	};
+}
+
+EnvelopeBank::EnvelopeBank(unsigned n)
+:	mMaxGates(0), mDropped(0)
+{
+	voices(n);
+}
+
+EnvelopeBank& EnvelopeBank::voices(unsigned n){
+	mLens.resize(3*n, 0.1f);
+	mSus.resize(n, 0.7f); mAmp.resize(n, 1.f); mCrv.resize(n, -4.f);
+	mA.resize(n, 0.f); mB.resize(n, 0.f); mMul.resize(n, 1.f);
+	mPos.resize(n, 0); mLen.resize(n, 0);
+	mStage.resize(n, 3);
+	mReleased.resize(n, 0);
+	if(mMaxGates < 2*n) maxGates(2*n);
+	return *this;
+}
+
+EnvelopeBank& EnvelopeBank::maxGates(unsigned n){
+	mMaxGates = n;
+	mEvents.reserve(n);
+	return *this;
+}
+
+EnvelopeBank& EnvelopeBank::set(unsigned v, float att, float dec, float sus, float rel, float amp, float crv){
+	mLens[3*v] = att; mLens[3*v+1] = dec; mLens[3*v+2] = rel;
+	mSus[v] = sus; mAmp[v] = amp; mCrv[v] = crv;
+	return *this;
+}
+
+EnvelopeBank& EnvelopeBank::gateOn(unsigned v, unsigned offset){
+	Event e = {offset, v, true};
+	push(e);
+	return *this;
+}
+
+EnvelopeBank& EnvelopeBank::gateOff(unsigned v, unsigned offset){
+	Event e = {offset, v, false};
+	push(e);
+	return *this;
+}
+
+// Insert after gates at the same voice and offset, so they apply in order
+void EnvelopeBank::push(const Event& e){
+	if(mEvents.size() >= mMaxGates){ ++mDropped; return; }
+	mEvents.insert(std::upper_bound(mEvents.begin(), mEvents.end(), e, EventOrder()), e);
+}
+
+// Break-point levels are as ADSR: 0, amp, sustain * amp, 0
+float EnvelopeBank::level(unsigned v, int i) const {
+	return i == 1 ? mAmp[v] : i == 2 ? mSus[v]*mAmp[v] : 0.f;
+}
+
+void EnvelopeBank::segment(unsigned v, float start){
+	const int s = mStage[v];
+	mPos[v] = 0;
+	mLen[v] = unsigned(mLens[3*v + s] * spu());
+	CurveCoefs c(float(mLen[v]), mCrv[v], start, level(v, s+1));
+	mA[v] = c.a(); mB[v] = c.b(); mMul[v] = c.mul();
+}
+
+// As Env::operator()() of an ADSR
+float EnvelopeBank::next(unsigned v){
+	for(;;){
+		const int s = mStage[v];
+		if(s == 2 && !mReleased[v]) return level(v, 2);
+		if(mPos[v] < mLen[v]){
+			++mPos[v];
+			mB[v] *= mMul[v];
+			return mA[v] - mB[v];
+		}
+		if(s == 3) return 0.f;
+		mStage[v] = s+1;
+		if(s+1 == 3) return 0.f;
+		segment(v, level(v, s+1));
+	}
+}
+
+/*
+The samples left in a segment are generated as four independent recurrences,
+as Curve::operator()(Tv *, unsigned), and the stage is only checked between
+runs.
+*/
+void EnvelopeBank::run(unsigned v, float * dst, unsigned n){
+	while(n){
+		const int s = mStage[v];
+		if(s == 3 || (s == 2 && !mReleased[v])){
+			const float l = s == 3 ? 0.f : level(v, 2);
+			for(unsigned i=0; i<n; ++i) dst[i] = l;
+			return;
+		}
+		else if(mPos[v] < mLen[v]){
+			const unsigned m = mLen[v] - mPos[v] < n ? mLen[v] - mPos[v] : n;
+			const float A = mA[v], mul = mMul[v];
+			float b = mB[v];
+			unsigned i = 0;
+			if(m >= 8){
+				const float mul2 = mul*mul, mul4 = mul2*mul2;
+				float b0 = b*mul, b1 = b0*mul, b2 = b1*mul, b3 = b2*mul;
+				for(; i+4<=m; i+=4){
+					dst[i  ] = A - b0;
+					dst[i+1] = A - b1;
+					dst[i+2] = A - b2;
+					dst[i+3] = A - b3;
+					b = b3;
+					b0 *= mul4; b1 *= mul4; b2 *= mul4; b3 *= mul4;
+				}
+			}
+			for(; i<m; ++i){
+				b *= mul;
+				dst[i] = A - b;
+			}
+			mB[v] = b;
+			mPos[v] += m;
+			dst += m; n -= m;
+		}
+		else{
+			*dst++ = next(v);
+			--n;
+		}
+	}
+}
+
+void EnvelopeBank::process(float * out, unsigned n){
+	std::vector<Event>::const_iterator e = mEvents.begin();
+
+	for(unsigned v=0; v<voices(); ++v){
+		float * dst = out + v*n;
+		unsigned i = 0;
+		for(; e != mEvents.end() && e->voice == v; ++e){
+			const unsigned o = e->offset < n ? e->offset : n;
+			run(v, dst + i, o - i);
+			i = o;
+			if(e->on){
+				// As Env::reset()
+				mStage[v] = -1;
+				mPos[v] = mLen[v] = 0;
+				mReleased[v] = 0;
+			}
+			else if(!mReleased[v]){
+				// As Env::release()
+				mReleased[v] = 1;
+				const float cur = value(v);
+				mStage[v] = 2;
+				segment(v, cur);
+			}
+		}
+		run(v, dst + i, n - i);
+	}
+
+	mEvents.clear();
+}
+
+
+
+
+namespace{
+	// Whether a segment is rendered as a line; Curve loses precision in
+	// single precision as its curvature goes to zero
+	bool segmentIsLine(float crv){ return crv < 0.001f && crv > -0.001f; }
+
+	// Level at a normalized position in a segment, as Curve::set
+	float segmentLevel(float start, float end, float crv, double x){
+		if(segmentIsLine(crv)){
+			return float(start + (end - start) * x);
+		}
+		return float(start + (end - start) * (1. - std::exp(crv * x)) / (1. - std::exp(double(crv))));
+	}
+
+	struct PointTimeOrder{
+		template <class P>
+		bool operator()(double t, const P& p) const { return t < p.time; }
+	};
+}
+
+BreakpointEnv::BreakpointEnv()
+:	mLineStart(0), mInc(0), mPos(0), mSeg(0), mRemain(0), mArmed(false), mLine(false)
+{}
+
+BreakpointEnv& BreakpointEnv::add(double time, float level, float crv){
+	Point p = {time, level, crv};
+	// Keep sorted by time; points at the same time keep their order
+	mPoints.insert(
+		std::upper_bound(mPoints.begin(), mPoints.end(), time, PointTimeOrder()),
+		p
+	);
+	mArmed = false;
+	return *this;
+}
+
+BreakpointEnv& BreakpointEnv::clear(){
+	mPoints.clear();
+	mSeg = 0;
+	mArmed = false;
+	return *this;
+}
+
+unsigned BreakpointEnv::find(double t, unsigned hint) const {
+	const unsigned N = size();
+	if(N < 2 || t < mPoints[0].time) return 0;
+
+	// Moving forward usually stays in the same segment or goes to the next
+	if(hint < N && mPoints[hint].time <= t){
+		for(unsigned i=hint; i<hint+2 && i<N; ++i){
+			if(i+1 == N || t < mPoints[i+1].time) return i;
+		}
+	}
+
+	return std::upper_bound(mPoints.begin(), mPoints.end(), t, PointTimeOrder())
+		- mPoints.begin() - 1;
+}
+
+float BreakpointEnv::value(double t) const {
+	if(mPoints.empty()) return 0.f;
+	const unsigned i = find(t);
+	const Point& p = mPoints[i];
+	if(i+1 == size() || t <= p.time) return p.level;
+	const Point& q = mPoints[i+1];
+	return segmentLevel(p.level, q.level, p.curve, (t - p.time) / (q.time - p.time));
+}
+
+BreakpointEnv& BreakpointEnv::seek(double t){
+	mPos = t * spu();
+	mArmed = false;
+	return *this;
+}
+
+void BreakpointEnv::onDomainChange(double r){
+	mPos *= r;	// keep time of next sample
+	mArmed = false;
+}
+
+float BreakpointEnv::operator()(){
+	float v;
+	(*this)(&v, 1);
+	return v;
+}
+
+void BreakpointEnv::operator()(float * dst, unsigned n){
+	if(mPoints.empty()){
+		for(unsigned i=0; i<n; ++i) dst[i] = 0.f;
+		mPos += n;
+		return;
+	}
+
+	const double sp = spu();
+	while(n){
+		if(!mArmed){
+			mSeg = find(mPos / sp, mSeg);
+			const Point& p = mPoints[mSeg];
+			const double s0 = p.time * sp;
+
+			// Before first or after last breakpoint, hold level
+			if(mSeg+1 == size() || mPos < s0){
+				const double s1 = mSeg+1 == size() ? mPos + n : s0;
+				unsigned m = unsigned(std::ceil(s1 - mPos));
+				if(m > n || m == 0) m = n;
+				for(unsigned i=0; i<m; ++i) dst[i] = p.level;
+				mPos += m; dst += m; n -= m;
+				continue;
+			}
+
+			// Position curve one step before the next sample, so that it
+			// gives the value at that sample next
+			const Point& q = mPoints[mSeg+1];
+			const double s1 = q.time * sp, len = s1 - s0;
+			mLine = segmentIsLine(p.curve);
+			if(mLine){
+				mInc = (q.level - p.level) / len;
+				mLineStart = segmentLevel(p.level, q.level, p.curve, (mPos - s0) / len);
+			}
+			else{
+				mCurve.set(len, p.curve, p.level, q.level);
+				mCurve.value(segmentLevel(p.level, q.level, p.curve, (mPos - s0 - 1.) / len));
+			}
+			mRemain = unsigned(std::ceil(s1 - mPos));
+			if(!mRemain) mRemain = 1;
+			mArmed = true;
+		}
+
+		const unsigned m = mRemain < n ? mRemain : n;
+		if(mLine){
+			for(unsigned i=0; i<m; ++i) dst[i] = mLineStart + mInc * float(i);
+			mLineStart += mInc * float(m);
+		}
+		else{
+			mCurve(dst, m);
+		}
+		mPos += m; dst += m; n -= m;
+		mRemain -= m;
+		if(!mRemain) mArmed = false;
+	}
+}
+
+
+
+GateBank::GateBank(unsigned n, float closingDelay, float thresh){
+	channels(n);
+	delay(closingDelay);
+	threshold(thresh);
+}
+
+GateBank& GateBank::channels(unsigned n){
+	const float d = mDelay.empty() ? 0.f : mDelay.back();
+	const float t = mThresh.empty() ? 0.001f : mThresh.back();
+	mDelay.resize(n, d); mThresh.resize(n, t);
+	mLimit.resize(n, d * spu());
+	mRemain.resize(n, d * spu());
+	mGate.resize(n, 1.f);
+	return *this;
+}
+
+GateBank& GateBank::delay(unsigned c, float v){
+	mDelay[c] = v;
+	mLimit[c] = mRemain[c] = v * spu();
+	return *this;
+}
+
+GateBank& GateBank::delay(float v){
+	for(unsigned c=0; c<channels(); ++c) delay(c, v);
+	return *this;
+}
+
+GateBank& GateBank::threshold(float v){
+	for(unsigned c=0; c<channels(); ++c) mThresh[c] = v;
+	return *this;
+}
+
+void GateBank::onDomainChange(double /*r*/){
+	for(unsigned c=0; c<channels(); ++c) mLimit[c] = mDelay[c] * spu();
+}
+
+void GateBank::process(const float * in, float * out, unsigned n){
+	for(unsigned c=0; c<channels(); ++c){
+		const float thr = mThresh[c];
+		float rem = mRemain[c];
+		float gate = mGate[c];
+
+		for(unsigned i=0; i<n; i+=CHUNK){
+			const unsigned m = n-i < CHUNK ? n-i : CHUNK;
+			const float * src = in + c*n + i;
+			float * dst = out + c*n + i;
+			unsigned quiet = 1; // partial chunks take the general path
+			if(m == CHUNK){
+				quiet = 0;
+				for(unsigned k=0; k<CHUNK; ++k) quiet += std::fabs(src[k]) < thr;
+			}
+
+			// Loud samples hold the gate open and restart the closing delay
+			if(0 == quiet){
+				for(unsigned k=0; k<CHUNK; ++k) dst[k] = 1.f;
+				rem = mLimit[c];
+				gate = 1.f;
+			}
+
+			// Quiet samples count down the delay, as Gate::operator() in
+			// samples; the gate is open while the count is above zero
+			else if(CHUNK == quiet){
+				unsigned open = rem > 1.f ? unsigned(std::ceil(rem)) - 1 : 0;
+				if(open > CHUNK) open = CHUNK;
+				for(unsigned k=0; k<open; ++k) dst[k] = 1.f;
+				for(unsigned k=open; k<CHUNK; ++k) dst[k] = 0.f;
+				rem -= float(CHUNK);
+				gate = dst[CHUNK-1];
+			}
+
+			// Threshold crossed within chunk
+			else{
+				for(unsigned k=0; k<m; ++k){
+					if(std::fabs(src[k]) < thr){
+						rem -= 1.f;
+						gate = rem <= 0.f ? 0.f : 1.f;
+					}
+					else{
+						rem = mLimit[c];
+						gate = 1.f;
+					}
+					dst[k] = gate;
+				}
+			}
+		}
+		mRemain[c] = rem;
+		mGate[c] = gate;
+	}
+}
+
+
+
+SegExpBank::SegExpBank(unsigned n, float len, float crv){
+	channels(n);
+	set(len, crv);
+}
+
+SegExpBank& SegExpBank::channels(unsigned n){
+	const unsigned n0 = channels();
+	const float len = n0 ? mLen.back() : 0.01f;
+	const float crv = n0 ? mCrv.back() : -3.f;
+	mLen.resize(n, len); mCrv.resize(n, crv);
+	mA.resize(n); mB0.resize(n); mMul.resize(n); mB.resize(n);
+	mVal1.resize(n, 0.f); mVal0.resize(n, 0.f);
+	for(unsigned c=n0; c<n; ++c){
+		design(c);
+		mB[c] = mB0[c];
+	}
+	return *this;
+}
+
+// As SegExp::set, a curve from 0 to 1 and its reset state
+void SegExpBank::design(unsigned c){
+	CurveCoefs crv(mLen[c] * spu(), mCrv[c], 0.f, 1.f);
+	mA[c] = crv.a();
+	mMul[c] = crv.mul();
+	mB0[c] = mA[c] / mMul[c];
+}
+
+SegExpBank& SegExpBank::set(unsigned c, float len, float crv){
+	mLen[c] = len; mCrv[c] = crv;
+	design(c);
+	mB[c] = mB0[c];
+	return *this;
+}
+
+SegExpBank& SegExpBank::set(float len, float crv){
+	for(unsigned c=0; c<channels(); ++c) set(c, len, crv);
+	return *this;
+}
+
+float SegExpBank::value(unsigned c) const {
+	if(done(c)) return mVal0[c];
+	return ipl::linear(scl::min(mA[c] - mB[c], 1.f), mVal1[c], mVal0[c]);
+}
+
+SegExpBank& SegExpBank::target(unsigned c, float v){
+	mVal1[c] = ipl::linear(scl::min(mA[c] - mB[c], 1.f), mVal1[c], mVal0[c]);
+	mVal0[c] = v;
+	mB[c] = mB0[c];
+	return *this;
+}
+
+void SegExpBank::onDomainChange(double /*r*/){
+	for(unsigned c=0; c<channels(); ++c){
+		// Keep the position along the curve
+		const float x = mA[c] - mB[c];
+		design(c);
+		mB[c] = mA[c] - x;
+	}
+}
+
+// Generate a run of a channel's segment with no change of target
+void SegExpBank::run(unsigned c, float * dst, unsigned n){
+	const float A = mA[c], mul = mMul[c], a = mVal1[c], e = mVal0[c];
+	float b = mB[c];
+	unsigned i = 0;
+	while(i < n){
+		if(A - b >= 1.f){
+			for(; i<n; ++i) dst[i] = e;
+			break;
+		}
+
+		// A chunk of the curve as four recurrences stepping four samples at
+		// a time, as Curve::operator()(Tv *, unsigned). Past its end, the
+		// clipped curve gives the end value exactly, so done is only checked
+		// between chunks.
+		const unsigned m = n-i < CHUNK ? n-i : CHUNK;
+		float * d = dst + i;
+		unsigned k = 0;
+		if(m == CHUNK){
+			const float mul2 = mul*mul, mul4 = mul2*mul2;
+			float b0 = b*mul, b1 = b0*mul, b2 = b1*mul, b3 = b2*mul;
+			for(; k<CHUNK; k+=4){
+				const float x0 = std::min(A - b0, 1.f), x1 = std::min(A - b1, 1.f);
+				const float x2 = std::min(A - b2, 1.f), x3 = std::min(A - b3, 1.f);
+				d[k  ] = e*x0 + (a - a*x0);
+				d[k+1] = e*x1 + (a - a*x1);
+				d[k+2] = e*x2 + (a - a*x2);
+				d[k+3] = e*x3 + (a - a*x3);
+				b = b3;
+				b0 *= mul4; b1 *= mul4; b2 *= mul4; b3 *= mul4;
+			}
+		}
+		for(; k<m; ++k){
+			b *= mul;
+			const float x = std::min(A - b, 1.f);
+			d[k] = e*x + (a - a*x);
+		}
+		i += m;
+	}
+	mB[c] = b;
+}
+
+void SegExpBank::process(const float * targets, float * out, unsigned n){
+	for(unsigned c=0; c<channels(); ++c){
+		float * dst = out + c*n;
+		if(!targets){
+			run(c, dst, n);
+			continue;
+		}
+
+		// Restart the segment where the target changes, as SegExp::operator=,
+		// and run it in between
+		for(unsigned i=0; i<n; i+=CHUNK){
+			const unsigned m = n-i < CHUNK ? n-i : CHUNK;
+			const float * tg = targets + c*n + i;
+			const float e = mVal0[c];
+			unsigned same = 0;
+			if(m == CHUNK){
+				for(unsigned k=0; k<CHUNK; ++k) same += tg[k] == e;
+			}
+			if(CHUNK == same){
+				run(c, dst + i, CHUNK);
+			}
+			else{
+				for(unsigned k=0; k<m; ++k){
+					if(tg[k] != mVal0[c]) target(c, tg[k]);
+					run(c, dst + i + k, 1);
+				}
+			}
+		}
+	}
+}
+
+} // gam::
@@ -1,32 +1,229 @@
+#include <atomic>
+#include <cstring> // memcpy
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "Gamma/Allocator.h"
 #include "Gamma/FFT.h"
 #include "fftpack++.h"
 
+// Use the vectorized radix-4 backend for power-of-two sizes; fftpack is used
+// for all other sizes or for all sizes when this is 0.
+#ifndef GAM_FFT_NATIVE
+#define GAM_FFT_NATIVE 1
+#endif
+
+#if GAM_FFT_NATIVE
+#include "fft_native.h"
+#endif
+
 namespace gam{
 
 
+// Process-wide plans of a type by size and the number ever built
+template <class Plan>
+struct PlanCache{
+	std::mutex mutex;
+	std::map<int, std::shared_ptr<const Plan> > plans;
+	std::atomic<int> built;
+
+	PlanCache(): built(0){}
+
+	static PlanCache& get(){
+		static PlanCache c;
+		return c;
+	}
+};
+
+
+// Immutable data of a complex transform, shared by all transforms of a size
 template <class T>
-class CFFT<T>::Impl{
-public:
-	Impl(int sz): n(0), wsave(0){
-		resize(sz);
+struct CFFTPlan{
+	typedef T value_type;
+
+	CFFTPlan(int size): n(size){
+		++PlanCache<CFFTPlan>::get().built;
+		#if GAM_FFT_NATIVE
+		if(fftnative::CPlan<T>::supports(n)){
+			native.resize(n);
+			return;
+		}
+		#endif
+		wsave.resize(4*n+15);
+		fftpack::cffti(&n, &wsave[0], ifac);
 	}
-	
-	~Impl(){ freeMem(); }
-	
+
+	// Transform in place using a work buffer of 2n elements
+	template <bool Inv>
+	void transform(T * buf, T * work) const {
+		#if GAM_FFT_NATIVE
+		if(wsave.empty()){
+			T * res = native.template transform<Inv>(buf, work, buf);
+			if(res != buf) std::memcpy(buf, res, sizeof(T)*2*n);
+			return;
+		}
+		#endif
+		// fftpack only reads the twiddles and factors
+		int N = n;
+		T * wa = const_cast<T *>(&wsave[2*n]);
+		int * fac = const_cast<int *>(ifac);
+		if(Inv)	fftpack::cfftb(&N, buf, work, wa, fac);
+		else	fftpack::cfftf(&N, buf, work, wa, fac);
+	}
+
+	int n;
+	int ifac[sizeof(int) /*bytes/int*/ * 8 /*bits/byte*/ - 1];
+	std::vector<T> wsave;	// fftpack work array; only twiddles are used
+	#if GAM_FFT_NATIVE
+	fftnative::CPlan<T> native;
+	#endif
+};
+
+
+// Immutable data of a real transform, shared by all transforms of a size
+template <class T>
+struct RFFTPlan{
+	typedef T value_type;
+
+	RFFTPlan(int size): n(size){
+		++PlanCache<RFFTPlan>::get().built;
+		#if GAM_FFT_NATIVE
+		if(fftnative::RPlan<T>::supports(n)){
+			native.resize(n);
+			return;
+		}
+		#endif
+		wsave.resize(2*n+15);
+		fftpack::rffti(&n, &wsave[0], ifac);
+	}
+
+	// Transform in place using a work buffer of 2n elements
+	template <bool Inv>
+	void transform(T * buf, T * work) const {
+		#if GAM_FFT_NATIVE
+		if(wsave.empty()){
+			if(Inv)	native.inverse(buf, work);
+			else	native.forward(buf, work);
+			return;
+		}
+		#endif
+		int N = n;
+		T * wa = const_cast<T *>(&wsave[n]);
+		int * fac = const_cast<int *>(ifac);
+		if(Inv)	fftpack::rfftb(&N, buf, work, wa, fac);
+		else	fftpack::rfftf(&N, buf, work, wa, fac);
+	}
+
+	// Size of work buffer for transformBatch
+	int batchWorkSize() const {
+		#if GAM_FFT_NATIVE
+		if(wsave.empty()) return native.batchWorkSize();
+		#endif
+		return 0;
+	}
+
+	// Transform channels in place, several at once when possible
+	template <bool Inv>
+	void transformBatch(T * const * bufs, int numChans, T * work, T * batchWork) const {
+		int c = 0;
+		#if GAM_FFT_NATIVE
+		if(wsave.empty() && batchWork){
+			c = native.template transformBatch<Inv>(bufs, numChans, batchWork);
+		}
+		#endif
+		for(; c<numChans; ++c) transform<Inv>(bufs[c], work);
+	}
+
+	int n;
+	int ifac[sizeof(int) /*bytes/int*/ * 8 /*bits/byte*/ - 1];
+	std::vector<T> wsave;
+	#if GAM_FFT_NATIVE
+	fftnative::RPlan<T> native;
+	#endif
+};
+
+
+// Get plan of a size from the process-wide cache, building it if needed.
+// Plans are kept for the life of the process.
+template <class Plan>
+std::shared_ptr<const Plan> getPlan(int n){
+	PlanCache<Plan>& c = PlanCache<Plan>::get();
+	std::lock_guard<std::mutex> lock(c.mutex);
+	std::shared_ptr<const Plan>& p = c.plans[n];
+	if(!p) p = std::make_shared<const Plan>(n);
+	return p;
+}
+
+template <class Plan>
+int numPlans(){ return PlanCache<Plan>::get().built.load(); }
+
+
+// An instance holds a shared plan and its own work buffer, and optionally
+// the plans of reserved sizes so resizing to them does not lock
+template <class Plan>
+struct FFTInstance{
+	FFTInstance(int sz): n(0){ resize(sz); }
+
 	void resize(int size){
 		if(size != n){
 			n = size;
-			freeMem();
-			wsave = new T[4*n+15];
-			fftpack::cffti(&n, wsave, ifac);
+			plan = n > 0 ? findPlan(n) : std::shared_ptr<const Plan>();
+			work.resize(2*n);
 		}
 	}
 
-	void freeMem(){ if(wsave){ delete[] wsave; wsave=0;} }
+	void reserve(int maxSize){
+		for(int m=2; m<=maxSize; m<<=1) reservePlan(m);
+		reservePlan(maxSize);
+		if(maxSize > 0) work.reserve(2*maxSize);
+	}
+
+	void reservePlan(int m){
+		for(unsigned i=0; i<reserved.size(); ++i) if(reserved[i]->n == m) return;
+		if(m > 0) reserved.push_back(getPlan<Plan>(m));
+	}
+
+	std::shared_ptr<const Plan> findPlan(int m) const {
+		for(unsigned i=0; i<reserved.size(); ++i) if(reserved[i]->n == m) return reserved[i];
+		return getPlan<Plan>(m);
+	}
+
+	template <bool Inv, class T>
+	void transform(T * buf){
+		if(plan) plan->template transform<Inv>(buf, &work[0]);
+	}
 
 	int n;
-	int ifac[sizeof(int) /*bytes/int*/ * 8 /*bits/byte*/ - 1];
-	T * wsave;				// work array
+	std::shared_ptr<const Plan> plan;
+	std::vector<typename Plan::value_type> work;
+	std::vector<std::shared_ptr<const Plan> > reserved;
+};
+
+
+template <class T>
+class CFFT<T>::Impl : public FFTInstance<CFFTPlan<T> >{
+public:
+	Impl(int sz): FFTInstance<CFFTPlan<T> >(sz){}
+};
+
+
+template <class T>
+class RFFT<T>::Impl : public FFTInstance<RFFTPlan<T> >{
+public:
+	Impl(int sz): FFTInstance<RFFTPlan<T> >(sz){}
+
+	template <bool Inv>
+	void transformBatch(T * const * bufs, int numChans){
+		if(!this->plan) return;
+		size_t size = this->plan->batchWorkSize();
+		if(batchWork.size() < size) batchWork.resize(size);
+		this->plan->template transformBatch<Inv>(bufs, numChans, &this->work[0], size ? &batchWork[0] : 0);
+	}
+
+	// Channels in vector lanes; allocated on first use and aligned for the
+	// vector type the work is cast to
+	std::vector<T, AlignedAllocator<T> > batchWork;
 };
 
 
@@ -43,7 +240,7 @@ CFFT<T>::~CFFT(){
 
 template <class T>
 void CFFT<T>::forward(T * buf, bool normalize, T nrmGain){
-	fftpack::cfftf(&mImpl->n, buf, mImpl->wsave, mImpl->ifac);
+	mImpl->template transform<false>(buf);
 	
 	if(normalize){
 		T m = nrmGain/size();
@@ -53,42 +250,27 @@ void CFFT<T>::forward(T * buf, bool normalize, T nrmGain){
 	
 template <class T>
 void CFFT<T>::inverse(T * buf){
-	fftpack::cfftb(&mImpl->n, buf, mImpl->wsave, mImpl->ifac);
+	mImpl->template transform<true>(buf);
 }
 
 template <class T>
 void CFFT<T>::resize(int n){ mImpl->resize(n); }
 
 template <class T>
-int CFFT<T>::size() const{ return mImpl->n; }
-
+void CFFT<T>::reserve(int maxSize){ mImpl->reserve(maxSize); }
 
+template <class T>
+int CFFT<T>::size() const{ return mImpl->n; }
 
+template <class T>
+void CFFT<T>::prewarm(std::initializer_list<int> sizes){
+	for(int n : sizes) if(n > 0) getPlan<CFFTPlan<T> >(n);
+}
 
 template <class T>
-class RFFT<T>::Impl{
-public:
-	Impl(int sz): n(0), wsave(0){
-		resize(sz);
-	}
-	
-	~Impl(){ freeMem(); }
-	
-	void resize(int size){
-		if(size != n){
-			n = size;
-			freeMem();
-			wsave = new T[2*n+15];
-			fftpack::rffti(&n, wsave, ifac);
-		}
-	}
+int CFFT<T>::plans(){ return numPlans<CFFTPlan<T> >(); }
 
-	void freeMem(){ if(wsave){ delete[] wsave; wsave=0;} }
 
-	int n;
-	int ifac[sizeof(int) /*bytes/int*/ * 8 /*bits/byte*/ - 1];
-	T * wsave;				// work array
-};
 
 
 template <class T>
@@ -107,7 +289,7 @@ void RFFT<T>::forward(T * iobuf, bool complexBuf, bool normalize, T nrmGain){
 
 	T * buf = complexBuf ? iobuf+1 : iobuf;
 
-	fftpack::rfftf(&mImpl->n, buf, mImpl->wsave, mImpl->ifac);
+	mImpl->template transform<false>(buf);
 
 	if(normalize){
 		const T m = nrmGain/size();
@@ -131,15 +313,71 @@ void RFFT<T>::inverse(T * iobuf, bool complexBuf){
 		buf[0] = iobuf[0];
 	}
 
-	fftpack::rfftb(&mImpl->n, buf, mImpl->wsave, mImpl->ifac);
+	mImpl->template transform<true>(buf);
+}
+
+template <class T>
+void RFFT<T>::forwardBatch(T * const * bufs, int numChans, bool complexBuf, bool normalize, T nrmGain){
+	const int N = size();
+	const int G = 16; // channels per group of pointers
+	for(int c0=0; c0<numChans; c0+=G){
+		int nc = numChans-c0 < G ? numChans-c0 : G;
+		T * ptrs[G];
+		for(int c=0; c<nc; ++c) ptrs[c] = complexBuf ? bufs[c0+c]+1 : bufs[c0+c];
+
+		mImpl->template transformBatch<false>(ptrs, nc);
+
+		for(int c=0; c<nc; ++c){
+			T * buf = ptrs[c];
+			if(normalize){
+				const T m = nrmGain/N;
+				for(int i=0; i<N; ++i) buf[i] *= m;
+			}
+			if(complexBuf){
+				T * iobuf = bufs[c0+c];
+				iobuf[  0] = buf[0];
+				iobuf[  1] = T(0);
+				iobuf[N+1] = T(0);
+			}
+		}
+	}
+}
+
+template <class T>
+void RFFT<T>::inverseBatch(T * const * bufs, int numChans, bool complexBuf){
+	const int G = 16;
+	for(int c0=0; c0<numChans; c0+=G){
+		int nc = numChans-c0 < G ? numChans-c0 : G;
+		T * ptrs[G];
+		for(int c=0; c<nc; ++c){
+			T * iobuf = bufs[c0+c];
+			ptrs[c] = iobuf;
+			if(complexBuf){
+				ptrs[c]++;
+				ptrs[c][0] = iobuf[0];
+			}
+		}
+		mImpl->template transformBatch<true>(ptrs, nc);
+	}
 }
 
 template <class T>
 void RFFT<T>::resize(int n){ mImpl->resize(n); }
 
+template <class T>
+void RFFT<T>::reserve(int maxSize){ mImpl->reserve(maxSize); }
+
 template <class T>
 int RFFT<T>::size() const{ return mImpl->n; }
 
+template <class T>
+void RFFT<T>::prewarm(std::initializer_list<int> sizes){
+	for(int n : sizes) if(n > 0) getPlan<RFFTPlan<T> >(n);
+}
+
+template <class T>
+int RFFT<T>::plans(){ return numPlans<RFFTPlan<T> >(); }
+
 
 
 
@@ -0,0 +1,226 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cmath>
+#include "Gamma/FilterDesign.h"
+
+namespace gam{
+
+/*
+The loops below follow the setters of the filters step for step, in single
+precision where the filters use their parameter type, so that the tables give
+the same coefficients as setting a float filter. The biquad loop is
+instantiated per filter type and split in blocks: the first pass evaluates
+the sine and cosine polynomials of scl::sinT7 and scl::cosT8 with selects
+instead of branches, which gives the same values for frequencies in [0, pi),
+so both passes vectorize.
+*/
+namespace{
+template <FilterType type>
+void biquadLoop(
+	float * coefs, const float * frq, const float * res, const float * level,
+	unsigned n, double ups
+){
+	enum{ B = 64 };
+	const float frqToRad = float(M_2PI * ups);
+	const float t71 = scl::t71, t72 = scl::t72, t73 = scl::t73;
+	const float t81 = scl::t81, t82 = scl::t82, t83 = scl::t83, t84 = scl::t84;
+	float RE[B], IM[B], AL[B], LV[B];
+
+	for(unsigned j=0; j<n; j+=B){
+		const unsigned m = n-j < B ? n-j : B;
+
+		for(unsigned i=0; i<m; ++i){
+			const float w = scl::clip(frq[j+i] * frqToRad, 3.13f);
+			const bool near0 = w < float(M_PI_4);
+			const float r = near0 ? w : w - float(M_PI_2);
+			const float rr = r*r;
+			const float S = r * (1.f - t71 * rr * (t72 - rr * (t73 - rr)));
+			const float C = 1.f - rr * t81 * (t82 - rr * (t83 - rr * (t84 - rr)));
+			RE[i] = near0 ? C : -S;
+			IM[i] = near0 ? S : C;
+			AL[i] = IM[i] * (0.5f / (res ? res[j+i] : 0.707f));
+			LV[i] = level ? level[j+i] : 1.f;
+		}
+
+		// Level scaling of bandwidth
+		if(type == PEAKING){
+			for(unsigned i=0; i<m; ++i) AL[i] *= 1.f/LV[i];
+		}
+		else if(type == LOW_SHELF || type == HIGH_SHELF){
+			for(unsigned i=0; i<m; ++i){
+				LV[i] = 2.f*std::pow(LV[i], 0.25f);	// beta
+				AL[i] *= LV[i];
+			}
+		}
+
+		for(unsigned i=0; i<m; ++i){
+			const float re = RE[i], im = IM[i], alpha = AL[i], lev = LV[i];
+			float b0 = 1.f / (1.f + alpha);	// 1/b_0
+			float b1 = -2.f * re * b0;
+			float b2 = (1.f - alpha) * b0;
+			float a0, a1, a2;
+
+			switch(type){
+			case LOW_PASS:
+				a1 = (1.f - re) * b0;
+				a0 = a1 * 0.5f;
+				a2 = a0;
+				break;
+			case HIGH_PASS:
+				a1 = (-1.f - re) * b0;
+				a0 = a1 * -0.5f;
+				a2 = a0;
+				break;
+			case RESONANT:
+				a0 = im * 0.5f * b0;
+				a1 = 0.f;
+				a2 =-a0;
+				break;
+			case BAND_PASS:
+				a0 = alpha * b0;
+				a1 = 0.f;
+				a2 =-a0;
+				break;
+			case BAND_REJECT:
+				a0 = b0;
+				a1 = b1;
+				a2 = b0;
+				break;
+			case ALL_PASS:
+				a0 = b2;
+				a1 = b1;
+				a2 = 1.f;
+				break;
+			case PEAKING:{
+				float alpha_A_b0 = alpha * lev * b0;
+				a0 = b0 + alpha_A_b0;
+				a1 = b1;
+				a2 = b0 - alpha_A_b0;
+				}
+				break;
+			case LOW_SHELF:{
+				float A = lev*lev*0.25f; // sqrt(level)
+				float Ap1 = A + 1.f, Am1 = A - 1.f;
+				b0 =    1.f/(Ap1 + Am1*re + alpha);
+				b1 =  -2.f*(Am1 + Ap1*re        ) * b0;
+				b2 =       (Ap1 + Am1*re - alpha) * b0;
+				a0 =      A*(Ap1 - Am1*re + alpha) * b0;
+				a1 = 2.f*A*(Am1 - Ap1*re        ) * b0;
+				a2 =      A*(Ap1 - Am1*re - alpha) * b0;
+				}
+				break;
+			case HIGH_SHELF:{
+				float A = lev*lev*0.25f; // sqrt(level)
+				float Ap1 = A + 1.f, Am1 = A - 1.f;
+				b0 =    1.f/(Ap1 - Am1*re + alpha);
+				b1 =   2.f*(Am1 - Ap1*re        ) * b0;
+				b2 =       (Ap1 - Am1*re - alpha) * b0;
+				a0 =      A*(Ap1 + Am1*re + alpha) * b0;
+				a1 =-2.f*A*(Am1 + Ap1*re        ) * b0;
+				a2 =      A*(Ap1 + Am1*re - alpha) * b0;
+				}
+				break;
+			default: // no design; pass through
+				a0 = 1.f; a1 = a2 = b1 = b2 = 0.f;
+			}
+
+			float * c = coefs + 5*(j+i);
+			c[0] = a0; c[1] = a1; c[2] = a2; c[3] = b1; c[4] = b2;
+		}
+	}
+}
+}
+
+void biquadCoefs(
+	float * coefs, const float * frq, const float * res, const float * level,
+	unsigned n, FilterType type, double ups
+){
+	#define CS(t) case t: biquadLoop<t>(coefs, frq, res, level, n, ups); break;
+	switch(type){
+	CS(LOW_PASS) CS(HIGH_PASS) CS(BAND_PASS) CS(RESONANT) CS(BAND_REJECT)
+	CS(ALL_PASS) CS(PEAKING) CS(LOW_SHELF) CS(HIGH_SHELF)
+	default: biquadLoop<SMOOTHING>(coefs, frq, res, level, n, ups);
+	}
+	#undef CS
+}
+
+// H(z) = (a0 + a1 z^-1 + a2 z^-2) / (1 + b1 z^-1 + b2 z^-2). Numerators and
+// denominators are multiplied separately, which needs no division per
+// section.
+void biquadResponse(
+	float * mag, float * phs, const float * coefs, unsigned sections,
+	const float * frq, unsigned n, double ups
+){
+	enum{ BLOCK = 64 };
+	float c1[BLOCK], s1[BLOCK], c2[BLOCK], s2[BLOCK];
+	float nr[BLOCK], ni[BLOCK], dr[BLOCK], di[BLOCK];
+	for(unsigned k0=0; k0<n; k0+=BLOCK){
+		const unsigned m = n-k0 < BLOCK ? n-k0 : unsigned(BLOCK);
+		for(unsigned k=0; k<m; ++k){
+			const double w = M_2PI * frq[k0+k] * ups;
+			c1[k] = float(std::cos(w)); s1[k] = float(std::sin(w));
+			c2[k] = 2.f*c1[k]*c1[k] - 1.f; s2[k] = 2.f*s1[k]*c1[k];
+			nr[k] = dr[k] = 1.f; ni[k] = di[k] = 0.f;
+		}
+		for(unsigned j=0; j<sections; ++j){
+			const float * h = coefs + 5*j;
+			for(unsigned k=0; k<m; ++k){
+				// e^-iw = cos w - i sin w
+				const float ar = h[0] + h[1]*c1[k] + h[2]*c2[k], ai = -(h[1]*s1[k] + h[2]*s2[k]);
+				const float br = 1.f + h[3]*c1[k] + h[4]*c2[k], bi = -(h[3]*s1[k] + h[4]*s2[k]);
+				const float tn = nr[k]*ar - ni[k]*ai, td = dr[k]*br - di[k]*bi;
+				ni[k] = nr[k]*ai + ni[k]*ar; nr[k] = tn;
+				di[k] = dr[k]*bi + di[k]*br; dr[k] = td;
+			}
+		}
+		for(unsigned k=0; k<m; ++k){
+			mag[k0+k] = std::sqrt((nr[k]*nr[k] + ni[k]*ni[k]) / (dr[k]*dr[k] + di[k]*di[k]));
+		}
+		if(phs){
+			for(unsigned k=0; k<m; ++k){
+				// arg(N / D) = arg(N conj(D))
+				phs[k0+k] = std::atan2(ni[k]*dr[k] - nr[k]*di[k], nr[k]*dr[k] + ni[k]*di[k]);
+			}
+		}
+	}
+}
+
+namespace{
+	// Compute the two pole or zero coefficients of Filter2 into c[1], c[2]
+	// and return the unit frequency
+	inline float filter2Coefs(float * c, float frq, float wid, double ups){
+		const float f = scl::clip<float>(frq * ups, 0.5f);
+		const float rad = poleRadius(wid, ups);
+		c[1] = 2.f * rad * scl::cosT8<float>(f * M_2PI);
+		c[2] = -rad * rad;
+		return f;
+	}
+}
+
+void resonCoefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups){
+	for(unsigned i=0; i<n; ++i){
+		float * c = coefs + 3*i;
+		const float f = filter2Coefs(c, frq[i], wid[i], ups);
+		const float s = scl::cosP3<float>(scl::foldOnce<float>(f - 0.25f, 0.5f));
+		c[0] = (1.f + c[2]) * s;	// (1 - r^2) sin
+	}
+}
+
+void notchCoefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups){
+	for(unsigned i=0; i<n; ++i){
+		float * c = coefs + 3*i;
+		filter2Coefs(c, frq[i], wid[i], ups);
+		c[0] = 1.f / (1.f + scl::abs(c[1]) - c[2]);
+	}
+}
+
+void allPass2Coefs(float * coefs, const float * frq, const float * wid, unsigned n, double ups){
+	for(unsigned i=0; i<n; ++i){
+		float * c = coefs + 3*i;
+		filter2Coefs(c, frq[i], wid[i], ups);
+		c[0] = 1.f;
+	}
+}
+
+} // gam::
@@ -0,0 +1,230 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include "Gamma/CPU.h"
+#include "Gamma/FilterDesign.h"
+#include "Gamma/FormantBank.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE2__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_FB_SSE
+#endif
+
+namespace gam{
+
+namespace{
+	const unsigned LANES = 8; // as FormantBank
+
+	// Kernels run one formant, in transposed direct form II, over m frames of
+	// eight lane-interleaved samples x and add it to y. The coefficients c
+	// (eight a0, a1, a2, b1, b2 each) step by dc before each sample. States s
+	// are eight s1, then eight s2.
+	typedef void (*FormantKernel)(float * y, const float * x, unsigned m, float * c, const float * dc, float * s);
+
+	void formantScalar(float * y, const float * x, unsigned m, float * c, const float * dc, float * s){
+		float k[5][LANES], dk[5][LANES], s1[LANES], s2[LANES];
+		for(unsigned l=0; l<LANES; ++l){
+			for(unsigned j=0; j<5; ++j){ k[j][l] = c[j*LANES+l]; dk[j][l] = dc[j*LANES+l]; }
+			s1[l] = s[l]; s2[l] = s[LANES+l];
+		}
+		for(unsigned i=0; i<m; ++i){
+			const float * u = x + i*LANES;
+			float * v = y + i*LANES;
+			for(unsigned l=0; l<LANES; ++l){
+				for(unsigned j=0; j<5; ++j) k[j][l] += dk[j][l];
+				const float o = k[0][l]*u[l] + s1[l];
+				s1[l] = k[1][l]*u[l] - k[3][l]*o + s2[l];
+				s2[l] = k[2][l]*u[l] - k[4][l]*o;
+				v[l] += o;
+			}
+		}
+		for(unsigned l=0; l<LANES; ++l){
+			for(unsigned j=0; j<5; ++j) c[j*LANES+l] = k[j][l];
+			s[l] = s1[l]; s[LANES+l] = s2[l];
+		}
+	}
+
+	#if defined(GAM_FB_SSE)
+	void formantSSE2(float * y, const float * x, unsigned m, float * c, const float * dc, float * s){
+		for(unsigned h=0; h<LANES; h+=4){
+			__m128 a0 = _mm_loadu_ps(c+h), a1 = _mm_loadu_ps(c+LANES+h), a2 = _mm_loadu_ps(c+2*LANES+h);
+			__m128 b1 = _mm_loadu_ps(c+3*LANES+h), b2 = _mm_loadu_ps(c+4*LANES+h);
+			const __m128 da0 = _mm_loadu_ps(dc+h), da1 = _mm_loadu_ps(dc+LANES+h), da2 = _mm_loadu_ps(dc+2*LANES+h);
+			const __m128 db1 = _mm_loadu_ps(dc+3*LANES+h), db2 = _mm_loadu_ps(dc+4*LANES+h);
+			__m128 s1 = _mm_loadu_ps(s+h), s2 = _mm_loadu_ps(s+LANES+h);
+			for(unsigned i=0; i<m; ++i){
+				a0 = _mm_add_ps(a0, da0); a1 = _mm_add_ps(a1, da1); a2 = _mm_add_ps(a2, da2);
+				b1 = _mm_add_ps(b1, db1); b2 = _mm_add_ps(b2, db2);
+				const __m128 u = _mm_loadu_ps(x + i*LANES + h);
+				const __m128 o = _mm_add_ps(_mm_mul_ps(a0, u), s1);
+				s1 = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(a1, u), _mm_mul_ps(b1, o)), s2);
+				s2 = _mm_sub_ps(_mm_mul_ps(a2, u), _mm_mul_ps(b2, o));
+				float * v = y + i*LANES + h;
+				_mm_storeu_ps(v, _mm_add_ps(_mm_loadu_ps(v), o));
+			}
+			_mm_storeu_ps(c+h, a0); _mm_storeu_ps(c+LANES+h, a1); _mm_storeu_ps(c+2*LANES+h, a2);
+			_mm_storeu_ps(c+3*LANES+h, b1); _mm_storeu_ps(c+4*LANES+h, b2);
+			_mm_storeu_ps(s+h, s1); _mm_storeu_ps(s+LANES+h, s2);
+		}
+	}
+
+	GAM_TARGET_AVX2 void formantAVX2(float * y, const float * x, unsigned m, float * c, const float * dc, float * s){
+		__m256 a0 = _mm256_loadu_ps(c), a1 = _mm256_loadu_ps(c+LANES), a2 = _mm256_loadu_ps(c+2*LANES);
+		__m256 b1 = _mm256_loadu_ps(c+3*LANES), b2 = _mm256_loadu_ps(c+4*LANES);
+		const __m256 da0 = _mm256_loadu_ps(dc), da1 = _mm256_loadu_ps(dc+LANES), da2 = _mm256_loadu_ps(dc+2*LANES);
+		const __m256 db1 = _mm256_loadu_ps(dc+3*LANES), db2 = _mm256_loadu_ps(dc+4*LANES);
+		__m256 s1 = _mm256_loadu_ps(s), s2 = _mm256_loadu_ps(s+LANES);
+		for(unsigned i=0; i<m; ++i){
+			a0 = _mm256_add_ps(a0, da0); a1 = _mm256_add_ps(a1, da1); a2 = _mm256_add_ps(a2, da2);
+			b1 = _mm256_add_ps(b1, db1); b2 = _mm256_add_ps(b2, db2);
+			const __m256 u = _mm256_loadu_ps(x + i*LANES);
+			const __m256 o = _mm256_fmadd_ps(a0, u, s1);
+			s1 = _mm256_add_ps(_mm256_fnmadd_ps(b1, o, _mm256_mul_ps(a1, u)), s2);
+			s2 = _mm256_fnmadd_ps(b2, o, _mm256_mul_ps(a2, u));
+			float * v = y + i*LANES;
+			_mm256_storeu_ps(v, _mm256_add_ps(_mm256_loadu_ps(v), o));
+		}
+		_mm256_storeu_ps(c, a0); _mm256_storeu_ps(c+LANES, a1); _mm256_storeu_ps(c+2*LANES, a2);
+		_mm256_storeu_ps(c+3*LANES, b1); _mm256_storeu_ps(c+4*LANES, b2);
+		_mm256_storeu_ps(s, s1); _mm256_storeu_ps(s+LANES, s2);
+	}
+	#define GAM_SSE_KERNEL(f) f
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_SSE_KERNEL(f) 0
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+}
+
+
+FormantBank::FormantBank(unsigned numVoices, float q)
+:	mVoices(0), mRes(q)
+{
+	design();
+	voices(numVoices);
+}
+
+FormantBank& FormantBank::voices(unsigned n){
+	mVoices = n;
+	const unsigned groups = (n + LANES-1) / LANES;
+	const Selection s = {Vowel::MAN, Vowel::HEED, Vowel::HEED, 0.f};
+	mSel.assign(n, s);
+	mFresh.assign(n, 1);
+	mCur.assign(groups * GROUP, 0.f);
+	mTar.assign(groups * GROUP, 0.f);
+	mState.assign(groups * FORMANTS * 2*LANES, 0.f);
+	return *this;
+}
+
+FormantBank& FormantBank::res(float q){
+	mRes = q;
+	design();
+	for(unsigned v=0; v<mVoices; ++v) target(v);
+	return *this;
+}
+
+FormantBank& FormantBank::vowel(unsigned v, Vowel::Voice type, Vowel::Phoneme a, Vowel::Phoneme b, float mix){
+	const Selection s = {type, a, b, mix};
+	mSel[v] = s;
+	target(v);
+	if(mFresh[v]){
+		mFresh[v] = 0;
+		const unsigned i = v/LANES * GROUP + v%LANES;
+		for(unsigned j=0; j<5*FORMANTS; ++j) mCur[i + j*LANES] = mTar[i + j*LANES];
+	}
+	return *this;
+}
+
+void FormantBank::reset(){
+	std::fill(mState.begin(), mState.end(), 0.f);
+}
+
+void FormantBank::onDomainChange(double /*r*/){
+	design();
+	for(unsigned v=0; v<mVoices; ++v){
+		target(v);
+		const unsigned i = v/LANES * GROUP + v%LANES;
+		for(unsigned j=0; j<5*FORMANTS; ++j) mCur[i + j*LANES] = mTar[i + j*LANES];
+	}
+}
+
+void FormantBank::design(){
+	const unsigned N = Vowel::NUM_VOICES * Vowel::NUM_PHONEMES * FORMANTS;
+	std::vector<float> frq(N), res(N, mRes);
+	unsigned k = 0;
+	for(int t=0; t<Vowel::NUM_VOICES; ++t){
+	for(int p=0; p<Vowel::NUM_PHONEMES; ++p){
+	for(int f=0; f<FORMANTS; ++f){
+		frq[k++] = Vowel::freq(Vowel::Voice(t), Vowel::Phoneme(p), f);
+	}}}
+	mTable.resize(5*N);
+	biquadCoefs(&mTable[0], &frq[0], &res[0], NULL, N, BAND_PASS, ups());
+
+	k = 0;
+	for(int t=0; t<Vowel::NUM_VOICES; ++t){
+	for(int p=0; p<Vowel::NUM_PHONEMES; ++p){
+	for(int f=0; f<FORMANTS; ++f, ++k){
+		const float amp = Vowel::amp(Vowel::Voice(t), Vowel::Phoneme(p), f);
+		for(int j=0; j<3; ++j) mTable[5*k + j] *= amp;
+	}}}
+}
+
+void FormantBank::target(unsigned v){
+	const Selection& s = mSel[v];
+	const float * a = coefs(s.type, s.a), * b = coefs(s.type, s.b);
+	float * t = &mTar[v/LANES * GROUP + v%LANES];
+	for(unsigned j=0; j<5*FORMANTS; ++j) t[j*LANES] = a[j] + (b[j] - a[j])*s.mix;
+}
+
+void FormantBank::process(float * const * dst, const float * const * src, unsigned n){
+	static SIMDDispatch<FormantKernel> kernel(formantScalar,
+		GAM_SSE_KERNEL(formantSSE2), GAM_AVX_KERNEL(formantAVX2));
+	const FormantKernel formant = kernel();
+	if(!n) return;
+
+	const unsigned V = mVoices;
+	for(unsigned v0=0; v0<V; v0+=LANES){
+		const unsigned L = V-v0 < LANES ? V-v0 : unsigned(LANES);
+		float * cur = &mCur[v0/LANES * GROUP];
+		const float * tar = &mTar[v0/LANES * GROUP];
+		float * st = &mState[v0/LANES * FORMANTS * 2*LANES];
+
+		// Glide to targets over the block
+		float dc[GROUP];
+		const float inv = 1.f/n;
+		bool glide = false;
+		for(unsigned j=0; j<GROUP; ++j){
+			dc[j] = (tar[j] - cur[j]) * inv;
+			glide |= dc[j] != 0.f;
+		}
+
+		for(unsigned b=0; b<n; b+=BLOCK){
+			const unsigned m = n-b < BLOCK ? n-b : unsigned(BLOCK);
+
+			// Transpose input so lanes are adjacent
+			for(unsigned l=0; l<L; ++l){
+				const float * x = src[v0+l] + b;
+				for(unsigned i=0; i<m; ++i) mX[i*LANES + l] = x[i];
+			}
+			for(unsigned l=L; l<LANES; ++l){
+				for(unsigned i=0; i<m; ++i) mX[i*LANES + l] = 0.f;
+			}
+			std::fill(mY, mY + m*LANES, 0.f);
+
+			for(unsigned f=0; f<FORMANTS; ++f){
+				formant(mY, mX, m, cur + f*5*LANES, dc + f*5*LANES, st + f*2*LANES);
+			}
+
+			for(unsigned l=0; l<L; ++l){
+				float * y = dst[v0+l] + b;
+				for(unsigned i=0; i<m; ++i) y[i] = mY[i*LANES + l];
+			}
+		}
+
+		// End exactly on targets
+		if(glide) std::copy(tar, tar + GROUP, cur);
+	}
+}
+
+} // gam::
@@ -0,0 +1,223 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/CPU.h"
+#include "Gamma/GammatoneBank.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE2__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_GT_SSE
+#endif
+
+namespace gam{
+
+namespace{
+	const unsigned LANES = 8; // as GammatoneBank
+	const unsigned MAX_ORDER = GammatoneBank::MAX_ORDER;
+
+	// Kernels run the sections of eight lane-interleaved bands over m samples
+	// of x, writing the gained real parts to y and, if e is not null, the
+	// gained magnitudes to e. The coefficients c are eight pole real parts,
+	// pole imaginary parts and gains. States s are, per section, eight real
+	// then eight imaginary parts.
+	typedef void (*GammatoneKernel)(float * y, float * e, const float * x, unsigned m, const float * c, float * s, unsigned order);
+
+	void gammatoneScalar(float * y, float * e, const float * x, unsigned m, const float * c, float * s, unsigned order){
+		const float * pr = c, * pi = c + LANES, * g = c + 2*LANES;
+		for(unsigned i=0; i<m; ++i){
+			float zr[LANES], zi[LANES];
+			for(unsigned l=0; l<LANES; ++l){ zr[l] = x[i]; zi[l] = 0.f; }
+			for(unsigned k=0; k<order; ++k){
+				float * sr = s + 2*k*LANES, * si = sr + LANES;
+				for(unsigned l=0; l<LANES; ++l){
+					const float r = zr[l] + pr[l]*sr[l] - pi[l]*si[l];
+					const float q = zi[l] + pr[l]*si[l] + pi[l]*sr[l];
+					sr[l] = zr[l] = r;
+					si[l] = zi[l] = q;
+				}
+			}
+			for(unsigned l=0; l<LANES; ++l) y[i*LANES+l] = g[l]*zr[l];
+			if(e){
+				for(unsigned l=0; l<LANES; ++l) e[i*LANES+l] = g[l]*std::sqrt(zr[l]*zr[l] + zi[l]*zi[l]);
+			}
+		}
+	}
+
+	#if defined(GAM_GT_SSE)
+	void gammatoneSSE2(float * y, float * e, const float * x, unsigned m, const float * c, float * s, unsigned order){
+		for(unsigned h=0; h<LANES; h+=4){
+			const __m128 pr = _mm_loadu_ps(c+h), pi = _mm_loadu_ps(c+LANES+h), g = _mm_loadu_ps(c+2*LANES+h);
+			__m128 sr[MAX_ORDER], si[MAX_ORDER];
+			for(unsigned k=0; k<order; ++k){
+				sr[k] = _mm_loadu_ps(s + 2*k*LANES + h);
+				si[k] = _mm_loadu_ps(s + 2*k*LANES + LANES + h);
+			}
+			for(unsigned i=0; i<m; ++i){
+				__m128 zr = _mm_set1_ps(x[i]), zi = _mm_setzero_ps();
+				for(unsigned k=0; k<order; ++k){
+					const __m128 r = _mm_sub_ps(_mm_add_ps(zr, _mm_mul_ps(pr, sr[k])), _mm_mul_ps(pi, si[k]));
+					zi = _mm_add_ps(_mm_add_ps(zi, _mm_mul_ps(pr, si[k])), _mm_mul_ps(pi, sr[k]));
+					zr = r;
+					sr[k] = zr; si[k] = zi;
+				}
+				_mm_storeu_ps(y + i*LANES + h, _mm_mul_ps(g, zr));
+				if(e){
+					const __m128 mag = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(zr, zr), _mm_mul_ps(zi, zi)));
+					_mm_storeu_ps(e + i*LANES + h, _mm_mul_ps(g, mag));
+				}
+			}
+			for(unsigned k=0; k<order; ++k){
+				_mm_storeu_ps(s + 2*k*LANES + h, sr[k]);
+				_mm_storeu_ps(s + 2*k*LANES + LANES + h, si[k]);
+			}
+		}
+	}
+
+	GAM_TARGET_AVX2 void gammatoneAVX2(float * y, float * e, const float * x, unsigned m, const float * c, float * s, unsigned order){
+		const __m256 pr = _mm256_loadu_ps(c), pi = _mm256_loadu_ps(c+LANES), g = _mm256_loadu_ps(c+2*LANES);
+		__m256 sr[MAX_ORDER], si[MAX_ORDER];
+		for(unsigned k=0; k<order; ++k){
+			sr[k] = _mm256_loadu_ps(s + 2*k*LANES);
+			si[k] = _mm256_loadu_ps(s + 2*k*LANES + LANES);
+		}
+		for(unsigned i=0; i<m; ++i){
+			__m256 zr = _mm256_set1_ps(x[i]), zi = _mm256_setzero_ps();
+			for(unsigned k=0; k<order; ++k){
+				const __m256 r = _mm256_fnmadd_ps(pi, si[k], _mm256_fmadd_ps(pr, sr[k], zr));
+				zi = _mm256_fmadd_ps(pi, sr[k], _mm256_fmadd_ps(pr, si[k], zi));
+				zr = r;
+				sr[k] = zr; si[k] = zi;
+			}
+			_mm256_storeu_ps(y + i*LANES, _mm256_mul_ps(g, zr));
+			if(e){
+				const __m256 mag = _mm256_sqrt_ps(_mm256_fmadd_ps(zr, zr, _mm256_mul_ps(zi, zi)));
+				_mm256_storeu_ps(e + i*LANES, _mm256_mul_ps(g, mag));
+			}
+		}
+		for(unsigned k=0; k<order; ++k){
+			_mm256_storeu_ps(s + 2*k*LANES, sr[k]);
+			_mm256_storeu_ps(s + 2*k*LANES + LANES, si[k]);
+		}
+	}
+	#define GAM_SSE_KERNEL(f) f
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_SSE_KERNEL(f) 0
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+}
+
+
+GammatoneBank::GammatoneBank(unsigned numBands, float lo, float hi, unsigned ord)
+:	mOrder(ord < 1 ? 1 : ord > MAX_ORDER ? unsigned(MAX_ORDER) : ord), mDecim(64), mEnvCount(0)
+{
+	bands(numBands, lo, hi);
+}
+
+GammatoneBank& GammatoneBank::bands(unsigned n, float lo, float hi){
+	const unsigned groups = (n + LANES-1) / LANES;
+	mFreqs.resize(n);
+	mCoef.assign(groups * COEFS, 0.f);
+	mState.assign(groups * MAX_ORDER * 2*LANES, 0.f);
+	mEnvSum.assign(groups * LANES, 0.f);
+	mEnvCount = 0;
+
+	// Space evenly in ERB rate
+	const double e0 = std::log(1. + 4.37e-3*lo), e1 = std::log(1. + 4.37e-3*hi);
+	for(unsigned k=0; k<n; ++k){
+		const double e = n > 1 ? e0 + (e1 - e0)*k/(n-1) : e0;
+		mFreqs[k] = float((std::exp(e) - 1.) / 4.37e-3);
+		design(k);
+	}
+	return *this;
+}
+
+GammatoneBank& GammatoneBank::freq(unsigned band, float frq){
+	mFreqs[band] = frq;
+	design(band);
+	return *this;
+}
+
+GammatoneBank& GammatoneBank::order(unsigned n){
+	mOrder = n < 1 ? 1 : n > MAX_ORDER ? unsigned(MAX_ORDER) : n;
+	for(unsigned k=0; k<bands(); ++k) design(k);
+	reset();
+	return *this;
+}
+
+GammatoneBank& GammatoneBank::decimation(unsigned n){
+	mDecim = n < 1 ? 1 : n;
+	std::fill(mEnvSum.begin(), mEnvSum.end(), 0.f);
+	mEnvCount = 0;
+	return *this;
+}
+
+void GammatoneBank::reset(){
+	std::fill(mState.begin(), mState.end(), 0.f);
+	std::fill(mEnvSum.begin(), mEnvSum.end(), 0.f);
+	mEnvCount = 0;
+}
+
+void GammatoneBank::onDomainChange(double /*r*/){
+	for(unsigned k=0; k<bands(); ++k) design(k);
+}
+
+void GammatoneBank::design(unsigned band){
+	const double f = mFreqs[band];
+	const double r = std::exp(-M_2PI * 1.019*erb(f) * ups());
+	const double w = M_2PI * f * ups();
+	float * c = &mCoef[band/LANES * COEFS + band%LANES];
+	c[0] = float(r*std::cos(w));
+	c[LANES] = float(r*std::sin(w));
+	// Unity gain at center; the real part carries half the complex output
+	c[2*LANES] = float(2.*std::pow(1. - r, double(mOrder)));
+}
+
+unsigned GammatoneBank::process(float * const * dst, const float * src, unsigned n, float * const * env){
+	static SIMDDispatch<GammatoneKernel> kernel(gammatoneScalar,
+		GAM_SSE_KERNEL(gammatoneSSE2), GAM_AVX_KERNEL(gammatoneAVX2));
+	const GammatoneKernel gammatone = kernel();
+
+	const unsigned N = bands();
+	unsigned written = 0, count = mEnvCount;
+	for(unsigned b0=0; b0<N; b0+=LANES){
+		const unsigned L = N-b0 < LANES ? N-b0 : unsigned(LANES);
+		const float * c = &mCoef[b0/LANES * COEFS];
+		float * st = &mState[b0/LANES * MAX_ORDER * 2*LANES];
+		float * sum = &mEnvSum[b0];
+		count = mEnvCount;
+		written = 0;
+
+		for(unsigned b=0; b<n; b+=BLOCK){
+			const unsigned m = n-b < BLOCK ? n-b : unsigned(BLOCK);
+			gammatone(mY, env ? mE : NULL, src + b, m, c, st, mOrder);
+
+			if(dst){
+				for(unsigned l=0; l<L; ++l){
+					float * y = dst[b0+l] + b;
+					for(unsigned i=0; i<m; ++i) y[i] = mY[i*LANES + l];
+				}
+			}
+
+			if(env){
+				for(unsigned i=0; i<m; ++i){
+					for(unsigned l=0; l<LANES; ++l) sum[l] += mE[i*LANES + l];
+					if(++count == mDecim){
+						const float norm = 1.f/mDecim;
+						for(unsigned l=0; l<L; ++l) env[b0+l][written] = sum[l] * norm;
+						for(unsigned l=0; l<LANES; ++l) sum[l] = 0.f;
+						++written;
+						count = 0;
+					}
+				}
+			}
+		}
+	}
+	if(env) mEnvCount = count;
+	return written;
+}
+
+} // gam::
@@ -0,0 +1,181 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cmath>
+#include "Gamma/CPU.h"
+#include "Gamma/Granular.h"
+#include "Gamma/Constants.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_GRAIN_AVX
+#endif
+
+namespace gam{
+
+namespace{
+
+	struct GrainRun{
+		const float * src;	// source at grain base
+		const float * win;
+		float pos, rate, phase, phaseInc, gainL, gainR;
+	};
+
+	// Kernels add the first samples of a grain that fill their vectors and
+	// return how many they did; the rest are done by the scalar loop.
+	typedef unsigned (*GrainKernel)(const GrainRun&, float *, float *, unsigned);
+
+	unsigned grainNone(const GrainRun&, float *, float *, unsigned){ return 0; }
+
+	#if defined(GAM_GRAIN_AVX)
+	// All-lane masked forms of AVX-512 conversions and gathers take a zeroed
+	// source, where the plain forms leave one undefined that GCC warns of
+	GAM_TARGET_AVX512 unsigned grainAVX512(const GrainRun& g, float * outL, float * outR, unsigned n){
+		const __m512 ramp = _mm512_setr_ps(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+		const __m512 pos = _mm512_set1_ps(g.pos), rate = _mm512_set1_ps(g.rate);
+		const __m512 phs = _mm512_set1_ps(g.phase), inc = _mm512_set1_ps(g.phaseInc);
+		const __m512 gl = _mm512_set1_ps(g.gainL), gr = _mm512_set1_ps(g.gainR);
+		unsigned j=0;
+		for(; j+16<=n; j+=16){
+			__m512 t = _mm512_add_ps(_mm512_set1_ps(float(j)), ramp);
+			__m512 o = _mm512_fmadd_ps(t, rate, pos);
+			__m512i i = _mm512_maskz_cvttps_epi32(0xFFFF, o);
+			__m512 f = _mm512_sub_ps(o, _mm512_maskz_cvtepi32_ps(0xFFFF, i));
+			__m512 s0 = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, g.src, 4);
+			__m512 s1 = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, g.src+1, 4);
+			__m512i k = _mm512_maskz_cvttps_epi32(0xFFFF, _mm512_fmadd_ps(t, inc, phs));
+			__m512 w = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, k, g.win, 4);
+			__m512 s = _mm512_mul_ps(_mm512_fmadd_ps(f, _mm512_sub_ps(s1, s0), s0), w);
+			_mm512_storeu_ps(outL+j, _mm512_fmadd_ps(s, gl, _mm512_loadu_ps(outL+j)));
+			_mm512_storeu_ps(outR+j, _mm512_fmadd_ps(s, gr, _mm512_loadu_ps(outR+j)));
+		}
+		return j;
+	}
+
+	GAM_TARGET_AVX2 unsigned grainAVX2(const GrainRun& g, float * outL, float * outR, unsigned n){
+		const __m256 ramp = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+		const __m256 pos = _mm256_set1_ps(g.pos), rate = _mm256_set1_ps(g.rate);
+		const __m256 phs = _mm256_set1_ps(g.phase), inc = _mm256_set1_ps(g.phaseInc);
+		const __m256 gl = _mm256_set1_ps(g.gainL), gr = _mm256_set1_ps(g.gainR);
+		unsigned j=0;
+		for(; j+8<=n; j+=8){
+			__m256 t = _mm256_add_ps(_mm256_set1_ps(float(j)), ramp);
+			__m256 o = _mm256_fmadd_ps(t, rate, pos);
+			__m256i i = _mm256_cvttps_epi32(o);
+			__m256 f = _mm256_sub_ps(o, _mm256_cvtepi32_ps(i));
+			__m256 s0 = _mm256_i32gather_ps(g.src, i, 4);
+			__m256 s1 = _mm256_i32gather_ps(g.src+1, i, 4);
+			__m256 w = _mm256_i32gather_ps(g.win, _mm256_cvttps_epi32(_mm256_fmadd_ps(t, inc, phs)), 4);
+			__m256 s = _mm256_mul_ps(_mm256_fmadd_ps(f, _mm256_sub_ps(s1, s0), s0), w);
+			_mm256_storeu_ps(outL+j, _mm256_fmadd_ps(s, gl, _mm256_loadu_ps(outL+j)));
+			_mm256_storeu_ps(outR+j, _mm256_fmadd_ps(s, gr, _mm256_loadu_ps(outR+j)));
+		}
+		return j;
+	}
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+}
+
+
+GrainCloud::GrainCloud(unsigned n, WindowType winType, unsigned winSize)
+:	mSrc(0), mFrames(0), mSrcFPS(0), mWin(winSize+1), mCount(0)
+{
+	maxGrains(n);
+	window(winType);
+}
+
+GrainCloud& GrainCloud::source(const float * src, unsigned frames, double fps){
+	mSrc = src;
+	mFrames = frames;
+	mSrcFPS = fps;
+	reset();
+	return *this;
+}
+
+GrainCloud& GrainCloud::window(WindowType type){
+	const unsigned N = unsigned(mWin.size()) - 1;
+	tbl::window(&mWin[0], N, type);
+	mWin[N] = mWin[0]; // guard point for positions rounding up to the end
+	return *this;
+}
+
+GrainCloud& GrainCloud::maxGrains(unsigned n){
+	mBase.resize(n); mPos.resize(n); mRate.resize(n);
+	mPhase.resize(n); mPhaseInc.resize(n);
+	mGainL.resize(n); mGainR.resize(n);
+	mLeft.resize(n); mOffset.resize(n);
+	reset();
+	return *this;
+}
+
+bool GrainCloud::grain(float pos, float dur, float rate, float amp, float pan, unsigned offset){
+	if(mCount == maxGrains() || mFrames < 2) return false;
+	const float last = float(mFrames - 2); // last position with a next sample
+	if(!(pos >= 0.f && pos <= last)) return false;
+
+	if(mSrcFPS > 0) rate *= float(mSrcFPS * ups());
+	double len = std::floor(dur * spu() + 0.5);
+	if(rate > 0.f)		len = std::min(len, std::floor(double(last - pos)/rate) + 1);
+	else if(rate < 0.f)	len = std::min(len, std::floor(double(pos)/-rate) + 1);
+	if(len < 1) return false;
+
+	const unsigned i = mCount++;
+	const float lowest = rate < 0.f ? pos + float(len-1)*rate : pos;
+	mBase[i] = int(std::max(std::floor(lowest), 0.f));
+	mPos[i] = pos - float(mBase[i]);
+	mRate[i] = rate;
+	mPhase[i] = 0.f;
+	mPhaseInc[i] = float((mWin.size() - 1) / len);
+	const float theta = (scl::clip(pan, 1.f, -1.f) + 1.f) * float(M_PI_4);
+	mGainL[i] = amp * std::cos(theta);
+	mGainR[i] = amp * std::sin(theta);
+	mLeft[i] = unsigned(len);
+	mOffset[i] = offset;
+	return true;
+}
+
+void GrainCloud::remove(unsigned i){
+	const unsigned j = --mCount;
+	mBase[i] = mBase[j]; mPos[i] = mPos[j]; mRate[i] = mRate[j];
+	mPhase[i] = mPhase[j]; mPhaseInc[i] = mPhaseInc[j];
+	mGainL[i] = mGainL[j]; mGainR[i] = mGainR[j];
+	mLeft[i] = mLeft[j]; mOffset[i] = mOffset[j];
+}
+
+void GrainCloud::render(float * outL, float * outR, unsigned n){
+	static SIMDDispatch<GrainKernel> kernel(grainNone,
+		0, GAM_AVX_KERNEL(grainAVX2), GAM_AVX_KERNEL(grainAVX512));
+	const GrainKernel run = kernel();
+
+	for(unsigned k=0; k<mCount;){
+		if(mOffset[k] >= n){ mOffset[k] -= n; ++k; continue; }
+		const unsigned start = mOffset[k];
+		const unsigned m = std::min(mLeft[k], n - start);
+		mOffset[k] = 0;
+
+		const GrainRun g = {
+			mSrc + mBase[k], &mWin[0],
+			mPos[k], mRate[k], mPhase[k], mPhaseInc[k], mGainL[k], mGainR[k]
+		};
+		float * L = outL + start, * R = outR + start;
+		for(unsigned j = run(g, L, R, m); j<m; ++j){
+			const float t = float(j);
+			const float o = t * g.rate + g.pos;
+			const int i = int(o);
+			const float f = o - float(i);
+			const float s = (g.src[i] + f*(g.src[i+1] - g.src[i])) * g.win[int(t * g.phaseInc + g.phase)];
+			L[j] += s * g.gainL;
+			R[j] += s * g.gainR;
+		}
+
+		mLeft[k] -= m;
+		if(!mLeft[k]){ remove(k); continue; }
+		mPos[k] += float(m) * g.rate;
+		mPhase[k] += float(m) * g.phaseInc;
+		++k;
+	}
+}
+
+} // gam::
@@ -0,0 +1,381 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm> // fill
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/FilterDesign.h"
+#include "Gamma/HRFilter.h"
+
+namespace gam{
+
+void HRFilter::earParams(
+	float * frq, float * lvl, float right, float up, float back, unsigned stride
+){
+	const float pinnaStrength = std::abs(right)*0.5f + 0.5f;
+
+	// Projection of source direction onto up-back plane
+	const float len = std::sqrt(up*up + back*back);
+	const float srcUp = len > 0.f ? up/len : 0.f;	// sine of elevation angle
+	const float srcB = len > 0.f ? back/len : 0.f;
+
+	// High-shelf: [0.5, 1] -> [back, front]
+	frq[0] = 4000;
+	lvl[0] = back*-0.25f + 0.75f;
+
+	// Pinna notches, weak above and strong in front following a half-period
+	// raised cosine; first is [6k, 10k] -> [front, above], second is
+	// [9k, 11k] -> [front, above, behind]
+	frq[stride] = srcUp*2000.f + 8000.f;
+	lvl[stride] = (srcUp*srcUp*0.7f + 0.3f - 1.f)*pinnaStrength + 1.f;
+	frq[2*stride] = srcB*1000.f + 10000.f;
+	lvl[2*stride] = (srcUp*srcUp*0.8f + 0.2f - 1.f)*pinnaStrength + 1.f;
+
+	// Second pinna resonance, for above localization
+	frq[3*stride] = 8000;
+	lvl[3*stride] = (srcUp > 0.f ? srcUp : 0.f) + 1.f;
+}
+
+namespace{
+	const float earRes[4] = {0.707, 24, 48, 4};
+	const FilterType earTypes[4] = {HIGH_SHELF, PEAKING, PEAKING, PEAKING};
+}
+
+void HRFilter::update(unsigned n){
+	const float * Ur = mPose, * Uu = mPose + 4, * Ub = mPose + 8; // pose stores back vector since right-handed
+	const float * H = mPose + 12;
+
+	mDist.near(mEarDist);
+	mDist.dist(2, mRoomSize, n); // diameter of room
+
+	for(int i=0; i<2; ++i){
+		auto& e = mEarFilters[i];
+		const float side = i==0 ? -mEarDist : mEarDist;
+		float S[3];	// ear to source
+		for(int k=0; k<3; ++k) S[k] = mSrc[k] - (H[k] + Ur[k]*side);
+		const float dist = std::sqrt(S[0]*S[0] + S[1]*S[1] + S[2]*S[2]) + 1e-8f;
+		mDist.dist(i, dist, n);
+		for(int k=0; k<3; ++k) S[k] /= dist; // ear to source direction
+
+		const float right = S[0]*Ur[0] + S[1]*Ur[1] + S[2]*Ur[2]; // in [-1,1]
+		const float up    = S[0]*Uu[0] + S[1]*Uu[1] + S[2]*Uu[2];
+		const float back  = S[0]*Ub[0] + S[1]*Ub[1] + S[2]*Ub[2];
+
+		if(mTable){
+			const float * c = mTable->coefs(right, up, back);
+			e.backShelf.coefs(c, n);
+			e.pinnaNotch1.coefs(c+5, n);
+			e.pinnaNotch2.coefs(c+10, n);
+			e.pinnaPeak2.coefs(c+15, n);
+		}
+		else{
+			float frq[4], lvl[4];
+			earParams(frq, lvl, right, up, back);
+			e.backShelf.level(lvl[0], n);
+			e.pinnaNotch1.freq(frq[1], n);
+			e.pinnaNotch1.level(lvl[1], n);
+			e.pinnaNotch2.freq(frq[2], n);
+			e.pinnaNotch2.level(lvl[2], n);
+			e.pinnaPeak2.level(lvl[3], n);
+		}
+
+		const float from = e.shadow;
+		e.shadow = (i==0 ? -right : right)*0.25f + 0.75f;
+		e.shadowRamp.start(n, &from, e.shadow);
+	}
+
+	/* Torso filtering (only useful if body orientation available!)
+	mTorsoAmt = al::abs(srcUp)*0.1;
+	mTorsoDelay = 1./1000. * mTorsoAmt/0.3;
+	//*/
+}
+
+
+/*
+The grid includes both poles, where all azimuths share one direction, so
+that the nearest cell is found by rounding the two angles.
+*/
+HRTable::HRTable(unsigned azimuths, unsigned elevations, double ups)
+:	mAz(azimuths < 1 ? 1 : azimuths), mEl(elevations < 2 ? 2 : elevations)
+{
+	const unsigned N = mAz*mEl;
+	std::vector<float> frq(4*N), lvl(4*N), res(4*N), coefs(5*N);
+	for(unsigned j=0; j<mEl; ++j){
+		const double el = M_PI * (double(j)/(mEl-1) - 0.5);
+		for(unsigned i=0; i<mAz; ++i){
+			const double az = M_2PI * double(i)/mAz;	// clockwise from front
+			const unsigned cell = j*mAz + i;
+			const float right = std::cos(el)*std::sin(az);
+			const float back =-std::cos(el)*std::cos(az);
+			HRFilter::earParams(&frq[cell], &lvl[cell], right, std::sin(el), back, N);
+		}
+	}
+
+	mCoefs.resize(20*N);
+	for(unsigned k=0; k<4; ++k){
+		std::fill(res.begin(), res.end(), earRes[k]);
+		biquadCoefs(&coefs[0], &frq[k*N], &res[0], &lvl[k*N], N, earTypes[k], ups);
+		for(unsigned c=0; c<N; ++c){
+			for(unsigned m=0; m<5; ++m) mCoefs[20*c + 5*k + m] = coefs[5*c + m];
+		}
+	}
+}
+
+const float * HRTable::coefs(float right, float up, float back) const {
+	float az = std::atan2(right, -back) * float(1./M_2PI);
+	if(az < 0.f) az += 1.f;
+	const float el = std::asin(scl::clip(up, 1.f, -1.f)) * float(1./M_PI) + 0.5f;
+	unsigned i = unsigned(az*mAz + 0.5f);
+	unsigned j = unsigned(el*(mEl-1) + 0.5f);
+	if(i >= mAz) i -= mAz;
+	if(j >= mEl) j = mEl-1;
+	return &mCoefs[20*(j*mAz + i)];
+}
+
+
+HRBatchScene::HRBatchScene(unsigned numSrc, float maxDelay)
+:	mNumSrc(0), mPad(0), mMaxDelay(maxDelay), mMask(0), mPos(0),
+	mRoomDelay(0), mRoomAmp(0), mRoomA0(0), mRoomB1(0), mRoomLP(0)
+{
+	for(int i=0; i<16; ++i) mPose[i] = i%5 ? 0.f : 1.f;
+	for(int i=0; i<2; ++i){
+		mReverbs[i].resize(gam::JCREVERB, i*2);
+		mReverbs[i].decay(4);
+		mReverbs[i].damping(0.25);
+	}
+	numSources(numSrc);
+}
+
+HRBatchScene& HRBatchScene::numSources(unsigned n){
+	mNumSrc = n;
+	mX.resize(n, 0.f); mY.resize(n, 0.f); mZ.resize(n, 0.f);
+	mPad = (n + 7)/8*8;
+	const unsigned C = 2*mPad;
+	mDist.assign(C, 0.f);
+	mDelay.assign(C, 0.f);
+	mLPA0.assign(C, 0.f); mLPB1.assign(C, 0.f); mLP.assign(C, 0.f);
+	mCoef.assign(SECTIONS*5*C, 0.f);
+	mState.assign(SECTIONS*2*C, 0.f);
+	mFrames.assign(BLOCK*C, 0.f);
+	mParams.assign((3*SECTIONS + 6)*C, 0.f);
+	mArena.clear();
+	mDirty = true;
+	return *this;
+}
+
+HRBatchScene& HRBatchScene::pos(unsigned i, float x, float y, float z){
+	mX[i] = x; mY[i] = y; mZ[i] = z;
+	mDirty = true;
+	return *this;
+}
+
+HRBatchScene& HRBatchScene::pos(const float * x, const float * y, const float * z){
+	for(unsigned i=0; i<mNumSrc; ++i){ mX[i] = x[i]; mY[i] = y[i]; mZ[i] = z[i]; }
+	mDirty = true;
+	return *this;
+}
+
+// As Dist::inverse
+float HRBatchScene::inverse(float dist) const {
+	if(dist <= mNear) return 1.f;
+	const float rollOff = (mNear/0.25 - mNear) / (mFar - mNear);
+	return mNear / (mNear + rollOff * (dist - mNear));
+}
+
+/*
+The parameters follow HRFilter::earParams, computed for all ear channels in one
+loop, and the biquad coefficients of each section are designed together with
+biquadCoefs. The distance gain and head shadow scale the last section.
+*/
+void HRBatchScene::update(){
+	mDirty = false;
+	const float spu = DomainObserver::spu(), ups = DomainObserver::ups();
+	const unsigned S = mNumSrc, P = mPad, C = 2*P;
+
+	// Delay lines; a change of size clears them
+	unsigned M = 1;
+	while(M < mMaxDelay*spu + BLOCK + 2) M <<= 1;
+	if(mArena.size() != (S+1)*(M+ROW_PAD)){
+		mArena.assign((S+1)*(M+ROW_PAD), 0.f);
+		mMask = M-1;
+		mPos = 0;
+	}
+	const float maxDelay = float(M - BLOCK - 2);
+
+	mNear = mEarDist;
+	const float * Ur = mPose, * Uu = mPose + 4, * Ub = mPose + 8, * H = mPose + 12;
+	auto dot = [](const float * a, float x, float y, float z){ return a[0]*x + a[1]*y + a[2]*z; };
+
+	float * frq = &mParams[0];			// SECTIONS x C
+	float * lvl = frq + SECTIONS*C;		// SECTIONS x C
+	float * res = lvl + SECTIONS*C;		// SECTIONS x C
+	float * gain = res + SECTIONS*C;	// C
+	float * coefs = gain + C;			// 5 x C
+
+	for(unsigned j=0; j<SECTIONS; ++j) for(unsigned ch=0; ch<C; ++ch) res[j*C + ch] = earRes[j];
+
+	OnePole<float, float, Domain1> lpf;
+
+	for(unsigned e=0; e<2; ++e){
+		const float side = e==0 ? -mEarDist : mEarDist;
+		const float ex = H[0] + Ur[0]*side, ey = H[1] + Ur[1]*side, ez = H[2] + Ur[2]*side;
+		for(unsigned s=0; s<P; ++s){
+			const unsigned ch = e*P + s;
+			if(s >= S){	// padding; silent
+				for(unsigned j=0; j<SECTIONS; ++j){ frq[j*C + ch] = 1000; lvl[j*C + ch] = 1; }
+				gain[ch] = 0; mDist[ch] = 0; mDelay[ch] = 0; mLPA0[ch] = mLPB1[ch] = 0;
+				continue;
+			}
+
+			float vx = mX[s] - ex, vy = mY[s] - ey, vz = mZ[s] - ez;
+			const float dist = std::sqrt(vx*vx + vy*vy + vz*vz) + 1e-8f;
+			vx /= dist; vy /= dist; vz /= dist;	// ear to source direction
+
+			const float right = dot(Ur, vx, vy, vz);
+			HRFilter::earParams(frq + ch, lvl + ch, right, dot(Uu, vx, vy, vz), dot(Ub, vx, vy, vz), C);
+
+			const float amp = inverse(dist);
+			const float shadow = (e==0 ? -right : right)*0.25f + 0.75f;
+			gain[ch] = amp * shadow;
+			mDist[ch] = dist;
+			mDelay[ch] = std::min(dist / 343.2f * spu, maxDelay);
+			lpf.freq(22000 * amp * ups);
+			mLPA0[ch] = lpf.a0(); mLPB1[ch] = lpf.b1();
+		}
+	}
+
+	for(unsigned j=0; j<SECTIONS; ++j){
+		biquadCoefs(coefs, frq + j*C, res + j*C, lvl + j*C, C, earTypes[j], ups);
+		float * c = &mCoef[j*5*C];
+		for(unsigned k=0; k<5; ++k){
+			for(unsigned ch=0; ch<C; ++ch) c[k*C + ch] = coefs[5*ch + k];
+		}
+		if(j == SECTIONS-1){
+			for(unsigned k=0; k<3; ++k){
+				for(unsigned ch=0; ch<C; ++ch) c[k*C + ch] *= gain[ch];
+			}
+		}
+	}
+
+	// Room is at a fixed distance from all sources, so their sum is sent
+	// through one delay
+	mRoomAmp = inverse(mRoomSize);
+	mRoomDelay = std::min(mRoomSize / 343.2f * spu, maxDelay);
+	lpf.freq(22000 * mRoomAmp * ups);
+	mRoomA0 = lpf.a0(); mRoomB1 = lpf.b1();
+}
+
+void HRBatchScene::render(const float * const * src, unsigned off, float * outL, float * outR, unsigned m){
+	const unsigned S = mNumSrc, P = mPad, C = 2*P;
+	const unsigned M = mMask+1 + ROW_PAD, mask = mMask, w = mPos;
+
+	// Write inputs and their sum
+	float noise[BLOCK], roomIn[BLOCK];
+	mNoise(noise, m);
+	for(unsigned i=0; i<m; ++i) roomIn[i] = 0.f;
+	for(unsigned s=0; s<S; ++s){
+		float * r = &mArena[s*M];
+		const float * x = src[s] + off;
+		for(unsigned i=0; i<m; ++i){
+			const float v = x[i] + noise[i];
+			r[(w + i) & mask] = v;
+			roomIn[i] += v;
+		}
+	}
+	float * room = &mArena[S*M];
+	for(unsigned i=0; i<m; ++i) room[(w + i) & mask] = roomIn[i];
+
+	// Read delayed inputs into frames of ear channels
+	float * X = &mFrames[0];
+	for(unsigned e=0; e<2; ++e){
+		for(unsigned s=0; s<S; ++s){
+			const unsigned ch = e*P + s;
+			const float * r = &mArena[s*M];
+			const float a = mDelay[ch];
+			const unsigned di = unsigned(a);
+			const float f = a - di;
+			for(unsigned i=0; i<m; ++i){
+				const unsigned p = (w + i - di) & mask, q = (p - 1) & mask;
+				X[i*C + ch] = r[p] + (r[q] - r[p])*f;
+			}
+		}
+	}
+
+	// Distance low-pass and ear filters. The channels are filtered 8 at a
+	// time within each frame so that many channels are in flight at once.
+	{
+		const float * a0 = &mLPA0[0], * b1 = &mLPB1[0];
+		float * o1 = &mLP[0];
+		for(unsigned i=0; i<m; ++i){
+			float * v = X + i*C;
+			for(unsigned c0=0; c0<C; c0+=8){
+				float * vk = v + c0, * ok = o1 + c0;
+				const float * ak = a0 + c0, * bk = b1 + c0;
+				for(unsigned k=0; k<8; ++k) vk[k] = ok[k] = ok[k]*bk[k] + vk[k]*ak[k];
+			}
+		}
+	}
+
+	// Direct form II, as Biquad
+	for(unsigned j=0; j<SECTIONS; ++j){
+		const float * c = &mCoef[j*5*C];
+		float * s1 = &mState[j*2*C], * s2 = s1 + C;
+		for(unsigned i=0; i<m; ++i){
+			float * v = X + i*C;
+			for(unsigned c0=0; c0<C; c0+=8){
+				float * vk = v + c0, * s1k = s1 + c0, * s2k = s2 + c0;
+				const float * a0 = c + c0, * a1 = a0 + C, * a2 = a1 + C, * b1 = a2 + C, * b2 = b1 + C;
+				float x[8], p1[8], p2[8];
+				for(unsigned k=0; k<8; ++k){ x[k] = vk[k]; p1[k] = s1k[k]; p2[k] = s2k[k]; }
+				for(unsigned k=0; k<8; ++k){
+					const float i0 = x[k] - p1[k]*b1[k] - p2[k]*b2[k];
+					x[k] = i0*a0[k] + p1[k]*a1[k] + p2[k]*a2[k];
+					p2[k] = p1[k]; p1[k] = i0;
+				}
+				for(unsigned k=0; k<8; ++k){ vk[k] = x[k]; s1k[k] = p1[k]; s2k[k] = p2[k]; }
+			}
+		}
+	}
+
+	// Sum ears
+	for(unsigned i=0; i<m; ++i){
+		const float * v = X + i*C;
+		float l[8] = {0}, r[8] = {0};
+		for(unsigned s=0; s<P; s+=8){
+			const float * vl = v + s, * vr = v + P + s;
+			for(unsigned k=0; k<8; ++k){ l[k] += vl[k]; r[k] += vr[k]; }
+		}
+		outL[i] = ((l[0]+l[1]) + (l[2]+l[3])) + ((l[4]+l[5]) + (l[6]+l[7]));
+		outR[i] = ((r[0]+r[1]) + (r[2]+r[3])) + ((r[4]+r[5]) + (r[6]+r[7]));
+	}
+
+	// Room reflections
+	float wet[BLOCK] = {0}, echo[BLOCK];
+	{
+		const unsigned di = unsigned(mRoomDelay);
+		const float f = mRoomDelay - di;
+		const float g = mRoomAmp * mWallAtten;
+		for(unsigned i=0; i<m; ++i){
+			const unsigned p = (w + i - di) & mask, q = (p - 1) & mask;
+			const float v = room[p] + (room[q] - room[p])*f;
+			mRoomLP = mRoomLP*mRoomB1 + v*mRoomA0;
+			wet[i] = mRoomLP * g;
+		}
+	}
+	mReverbs[0].process(wet, echo, m);
+	for(unsigned i=0; i<m; ++i) outL[i] += echo[i];
+	mReverbs[1].process(wet, echo, m);
+	for(unsigned i=0; i<m; ++i) outR[i] += echo[i];
+
+	mPos = (w + m) & mask;
+}
+
+void HRBatchScene::process(const float * const * src, float * outL, float * outR, unsigned n){
+	if(mDirty) update();
+	for(unsigned off=0; off<n; off+=BLOCK){
+		const unsigned m = n-off < BLOCK ? n-off : BLOCK;
+		render(src, off, outL + off, outR + off, m);
+	}
+}
+
+} // gam::
@@ -0,0 +1,13 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	Explicit instantiations of common unit generators, built into a separate
+	library by 'make instances'. The list of types is in each header under
+	GAM_EXTERN_TEMPLATE.
+*/
+
+#define GAM_INSTANTIATE_TEMPLATES
+#include "Gamma/Delay.h"
+#include "Gamma/Envelope.h"
+#include "Gamma/Filter.h"
+#include "Gamma/Oscillator.h"
@@ -0,0 +1,174 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <chrono>
+#include <cmath>
+#include <thread> // sleep_for
+#include "Gamma/Constants.h"
+#include "Gamma/FilterDesign.h"
+#include "Gamma/LinearPhaseEQ.h"
+#include "Gamma/tbl.h"
+
+namespace gam{
+
+LinearPhaseEQ::LinearPhaseEQ(unsigned channels, unsigned blockSize, unsigned kernelSize, bool background)
+:	mBlockSize(0), mKernelSize(0), mDesigned(0), mApplied(0),
+	mChanges(256), mUps(ups()), mRedesign(false), mRunning(false)
+{
+	for(unsigned k=0; k<MAX_BANDS; ++k){
+		const Band b = {PEAKING, 1000.f, 0.707f, 1.f, k, false};
+		mBands[k] = b;
+	}
+	resize(channels, blockSize, kernelSize, background);
+}
+
+LinearPhaseEQ::~LinearPhaseEQ(){
+	stopThread();
+}
+
+void LinearPhaseEQ::resize(unsigned channels, unsigned blockSize, unsigned kernelSize, bool background){
+	stopThread();
+
+	mBlockSize = blockSize;
+	mKernelSize = blockSize ? kernelSize : 0;
+	std::vector<Convolver>(blockSize ? channels : 0).swap(mChans);
+	for(unsigned c=0; c<mChans.size(); ++c){
+		mChans[c].resize(blockSize, mKernelSize);
+		mChans[c].share(&mKernels[0]);
+	}
+	for(int i=0; i<2; ++i){
+		mKernels[i].resize(blockSize, mKernelSize);
+		mKernel[i].assign(mKernelSize ? mKernelSize : 1, 0.f);
+	}
+	mFFT.resize(mKernelSize);
+	mBuf.assign(mKernelSize + 2, 0.f);
+	mWin.assign(mKernelSize, 0.f);
+	if(mKernelSize) tbl::window(&mWin[0], mKernelSize, HANN);
+
+	// Apply changes made so far to the first kernel
+	collect();
+	mRedesign.store(false);
+	design(0);
+	mDesigned = mApplied = 0;
+
+	if(background && mKernelSize){
+		mRunning = true;
+		mThread.start(cDesignFunc, this);
+	}
+}
+
+bool LinearPhaseEQ::band(unsigned k, FilterType type, float frq, float res, float level){
+	if(k >= MAX_BANDS) return false;
+	const Band b = {type, frq, res, level, k, true};
+	return mChanges.push(b);
+}
+
+bool LinearPhaseEQ::removeBand(unsigned k){
+	if(k >= MAX_BANDS) return false;
+	const Band b = {PEAKING, 0.f, 0.f, 1.f, k, false};
+	return mChanges.push(b);
+}
+
+bool LinearPhaseEQ::pending() const {
+	return !mChanges.empty() || mRedesign.load(std::memory_order_relaxed)
+		|| mDesigned.load(std::memory_order_acquire) != mApplied.load(std::memory_order_relaxed);
+}
+
+void LinearPhaseEQ::onDomainChange(double /*r*/){
+	mUps.store(ups(), std::memory_order_relaxed);
+	mRedesign.store(true, std::memory_order_release);
+}
+
+bool LinearPhaseEQ::collect(){
+	bool changed = mRedesign.exchange(false, std::memory_order_acquire);
+	Band b;
+	while(mChanges.pop(b)){
+		mBands[b.index] = b;
+		changed = true;
+	}
+	return changed;
+}
+
+// The product of the biquads' magnitude responses is sampled at the bins of
+// the kernel size with the phase of a delay of half the kernel size, then
+// transformed and windowed.
+void LinearPhaseEQ::design(unsigned slot){
+	const unsigned N = mKernelSize;
+	if(!N) return;
+	const double ups = mUps.load(std::memory_order_relaxed);
+
+	float c[MAX_BANDS][5];
+	unsigned nb = 0;
+	for(unsigned i=0; i<MAX_BANDS; ++i){
+		const Band& b = mBands[i];
+		if(b.on) biquadCoefs(c[nb++], &b.frq, &b.res, &b.level, 1, b.type, ups);
+	}
+
+	float * buf = &mBuf[0];
+	for(unsigned k=0; k<=N/2; ++k){
+		const double w = M_2PI * k / N;
+		const double c1 = std::cos(w), s1 = std::sin(w);
+		const double c2 = std::cos(2*w), s2 = std::sin(2*w);
+		double mag = 1;
+		for(unsigned i=0; i<nb; ++i){
+			const float * h = c[i];
+			const double nr = h[0] + h[1]*c1 + h[2]*c2, ni = h[1]*s1 + h[2]*s2;
+			const double dr = 1 + h[3]*c1 + h[4]*c2, di = h[3]*s1 + h[4]*s2;
+			mag *= std::sqrt((nr*nr + ni*ni) / (dr*dr + di*di));
+		}
+		buf[2*k] = float(k & 1 ? -mag : mag);
+		buf[2*k+1] = 0.f;
+	}
+	mFFT.inverse(buf, true);
+
+	float * kernel = &mKernel[slot][0];
+	const float norm = 1.f / N;
+	for(unsigned i=0; i<N; ++i) kernel[i] = buf[1+i] * mWin[i] * norm;
+	mKernels[slot].ir(kernel, N);
+}
+
+void LinearPhaseEQ::process(float * const * dst, const float * const * src){
+	const unsigned applied = mApplied.load(std::memory_order_relaxed);
+	if(!mRunning.load(std::memory_order_relaxed) && collect()){
+		design((applied+1) & 1);
+		mDesigned.store(applied+1, std::memory_order_relaxed);
+	}
+
+	// Switch to a new kernel; the designer does not start another until then
+	const unsigned designed = mDesigned.load(std::memory_order_acquire);
+	if(designed != applied){
+		for(unsigned c=0; c<mChans.size(); ++c) mChans[c].share(&mKernels[designed & 1]);
+		mApplied.store(designed, std::memory_order_release);
+	}
+
+	for(unsigned c=0; c<mChans.size(); ++c) mChans[c].process(dst[c], src[c]);
+}
+
+void LinearPhaseEQ::reset(){
+	for(unsigned c=0; c<mChans.size(); ++c) mChans[c].reset();
+}
+
+void LinearPhaseEQ::stopThread(){
+	if(mRunning){
+		mRunning = false;
+		mThread.join();
+	}
+}
+
+void * LinearPhaseEQ::cDesignFunc(void * user){
+	LinearPhaseEQ& q = *(LinearPhaseEQ*)user;
+	while(q.mRunning.load(std::memory_order_relaxed)){
+		const unsigned designed = q.mDesigned.load(std::memory_order_relaxed);
+		if(designed == q.mApplied.load(std::memory_order_acquire) && q.collect()){
+			q.design((designed+1) & 1);
+			q.mDesigned.store(designed+1, std::memory_order_release);
+		}
+		else{
+			// Bands change at control rate, so idle without spinning
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+	return NULL;
+}
+
+} // gam::
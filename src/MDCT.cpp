@@ -0,0 +1,297 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm> // fill
+#include <cmath>
+#include <cstring> // memcpy
+#include "Gamma/MDCT.h"
+
+namespace gam{
+
+namespace{
+	const double kPi = 3.14159265358979323846;
+
+	// Modified Bessel function of the first kind, order zero
+	double besselI0(double x){
+		double sum = 1., term = 1.;
+		const double q = 0.25*x*x;
+		for(int k=1; k<200; ++k){
+			term *= q/(double(k)*k);
+			sum += term;
+			if(term < sum*1e-17) break;
+		}
+		return sum;
+	}
+}
+
+
+template <class T>
+DCT<T>::DCT(unsigned size)
+:	mSize(0)
+{
+	resize(size);
+}
+
+template <class T>
+void DCT<T>::resize(unsigned size){
+	size &= ~1u;
+	mSize = size;
+	mFFT.resize(size);
+	const unsigned h = size/2;
+	mCos.resize(h+1); mSin.resize(h+1);
+	for(unsigned k=0; k<=h; ++k){
+		const double p = kPi*k/(2.*size);
+		mCos[k] = T(std::cos(p));
+		mSin[k] = T(std::sin(p));
+	}
+	mBuf.resize(size);
+}
+
+template <class T>
+void DCT<T>::forward(T * buf){
+	const unsigned N = mSize, h = N/2;
+	if(!N) return;
+	T * v = &mBuf[0];
+
+	// Even samples ascending, then odd samples descending
+	for(unsigned n=0; n<h; ++n){
+		v[n] = buf[2*n];
+		v[N-1-n] = buf[2*n+1];
+	}
+
+	// Spectrum is [r0, r1, i1, ..., r(N/2)]
+	mFFT.forward(v, false, false);
+
+	// X[k] = Re(e^{-i pi k / 2N} V[k]); V[N-k] = conj(V[k]) gives X[N-k]
+	const T * c = &mCos[0];
+	const T * s = &mSin[0];
+	buf[0] = v[0];
+	for(unsigned k=1; k<h; ++k){
+		const T re = v[2*k-1], im = v[2*k];
+		buf[k]   = c[k]*re + s[k]*im;
+		buf[N-k] = s[k]*re - c[k]*im;
+	}
+	buf[h] = c[h]*v[N-1];
+}
+
+template <class T>
+void DCT<T>::inverse(T * buf){
+	const unsigned N = mSize, h = N/2;
+	if(!N) return;
+	T * v = &mBuf[0];
+
+	// Rebuild the spectrum of the shuffled sequence from X[k] and X[N-k]
+	const T * c = &mCos[0];
+	const T * s = &mSin[0];
+	v[0] = buf[0];
+	for(unsigned k=1; k<h; ++k){
+		const T a = buf[k], b = buf[N-k];
+		v[2*k-1] = c[k]*a + s[k]*b;
+		v[2*k]   = s[k]*a - c[k]*b;
+	}
+	v[N-1] = T(2)*c[h]*buf[h];
+
+	mFFT.inverse(v, false);
+
+	const T g = T(1)/N;
+	for(unsigned n=0; n<h; ++n){
+		buf[2*n]   = v[n]*g;
+		buf[2*n+1] = v[N-1-n]*g;
+	}
+}
+
+
+
+template <class T>
+MDCT<T>::MDCT(unsigned numCoefs)
+:	mM(0)
+{
+	resize(numCoefs);
+}
+
+template <class T>
+void MDCT<T>::resize(unsigned numCoefs){
+	const unsigned M = numCoefs & ~1u;
+	const unsigned Q = M/2;
+	mM = M;
+	mFFT.resize(Q);
+
+	mPreCos.resize(Q); mPreSin.resize(Q);
+	mPostCos.resize(Q); mPostSin.resize(Q);
+	for(unsigned n=0; n<Q; ++n){
+		const double pre = -kPi*(4*n+1)/(4.*M);
+		const double post = -kPi*n/M;
+		mPreCos[n] = T(std::cos(pre));
+		mPreSin[n] = T(std::sin(pre));
+		mPostCos[n] = T(std::cos(post));
+		mPostSin[n] = T(std::sin(post));
+	}
+
+	mWin.resize(2*M);
+	mCoefs.resize(M);
+	mIn.resize(2*M);
+	mFrame.resize(2*M);
+	mOLA.resize(M);
+	mOut.resize(M);
+	mRe.resize(Q); mIm.resize(Q);
+	mCpx.resize(M);
+	windowSine();
+	reset();
+}
+
+template <class T>
+MDCT<T>& MDCT<T>::windowSine(){
+	const unsigned N = 2*mM;
+	for(unsigned n=0; n<N; ++n) mWin[n] = T(std::sin(kPi*(n+0.5)/N));
+	return *this;
+}
+
+template <class T>
+MDCT<T>& MDCT<T>::windowKBD(double alpha){
+	const unsigned M = mM;
+	if(!M) return *this;
+	// Cumulative sums of a Kaiser window of M+1 points
+	std::vector<double> cum(M+1);
+	double sum = 0.;
+	for(unsigned j=0; j<=M; ++j){
+		const double r = 2.*j/M - 1.;
+		sum += besselI0(kPi*alpha*std::sqrt(1. - r*r));
+		cum[j] = sum;
+	}
+	for(unsigned n=0; n<M; ++n){
+		const T w = T(std::sqrt(cum[n]/sum));
+		mWin[n] = w;
+		mWin[2*M-1-n] = w;
+	}
+	return *this;
+}
+
+template <class T>
+void MDCT<T>::reset(){
+	std::fill(mIn.begin(), mIn.end(), T(0));
+	std::fill(mOLA.begin(), mOLA.end(), T(0));
+	std::fill(mOut.begin(), mOut.end(), T(0));
+	std::fill(mCoefs.begin(), mCoefs.end(), T(0));
+	mTapIn = 0;
+	mTapOut = mM;
+}
+
+// DCT-IV of M samples via a complex FFT of M/2 points
+template <class T>
+void MDCT<T>::dct4(const T * src, T * dst, T scale){
+	const unsigned M = mM, Q = M/2;
+	T * re = &mRe[0];
+	T * im = &mIm[0];
+	T * z = &mCpx[0];
+
+	// Gather even samples ascending and odd samples descending
+	for(unsigned n=0; n<Q; ++n){
+		re[n] = src[2*n];
+		im[n] = src[M-1-2*n];
+	}
+
+	// Pre-twiddle
+	const T * pc = &mPreCos[0];
+	const T * ps = &mPreSin[0];
+	for(unsigned n=0; n<Q; ++n){
+		z[2*n  ] = re[n]*pc[n] - im[n]*ps[n];
+		z[2*n+1] = re[n]*ps[n] + im[n]*pc[n];
+	}
+
+	mFFT.forward(z, false);
+
+	// Post-twiddle
+	const T * qc = &mPostCos[0];
+	const T * qs = &mPostSin[0];
+	for(unsigned k=0; k<Q; ++k){
+		const T zr = z[2*k], zi = z[2*k+1];
+		re[k] = (zr*qc[k] - zi*qs[k])*scale;
+		im[k] = (zr*qs[k] + zi*qc[k])*scale;
+	}
+
+	// Scatter to even coefficients ascending and odd descending
+	for(unsigned k=0; k<Q; ++k){
+		dst[2*k] = re[k];
+		dst[M-1-2*k] = -im[k];
+	}
+}
+
+template <class T>
+void MDCT<T>::forward(const T * src){
+	const unsigned M = mM, Q = M/2;
+	if(!M) return;
+	if(!src) src = &mIn[0];
+	const T * w = &mWin[0];
+	T * v = &mFrame[0];
+
+	// Fold windowed quarters (a, b, c, d) into (-c_r - d, a - b_r)
+	for(unsigned n=0; n<Q; ++n){
+		v[n]   = -w[3*Q-1-n]*src[3*Q-1-n] - w[3*Q+n]*src[3*Q+n];
+		v[Q+n] =  w[n]*src[n] - w[M-1-n]*src[M-1-n];
+	}
+
+	dct4(v, &mCoefs[0], T(1));
+}
+
+template <class T>
+void MDCT<T>::inverseFrame(T * dst){
+	const unsigned M = mM, Q = M/2;
+	if(!M) return;
+	T * u = &mCpx[0];
+
+	// DCT-IV is its own inverse up to a factor of M/2
+	dct4(&mCoefs[0], u, T(2)/M);
+
+	// Unfold into (u2, -u2_r, -u1_r, -u1)
+	for(unsigned n=0; n<Q; ++n){
+		dst[n]     =  u[Q+n];
+		dst[Q+n]   = -u[M-1-n];
+		dst[M+n]   = -u[Q-1-n];
+		dst[M+Q+n] = -u[n];
+	}
+}
+
+template <class T>
+void MDCT<T>::inverse(T * dst){
+	const unsigned M = mM;
+	if(!M) return;
+	if(!dst) dst = &mOut[0];
+	T * y = &mFrame[0];
+	inverseFrame(y);
+
+	const T * w = &mWin[0];
+	T * ola = &mOLA[0];
+	for(unsigned n=0; n<M; ++n){
+		dst[n] = ola[n] + w[n]*y[n];
+		ola[n] = w[M+n]*y[M+n];
+	}
+}
+
+template <class T>
+bool MDCT<T>::operator()(T input){
+	const unsigned M = mM;
+	mIn[M + mTapIn] = input;
+	if(++mTapIn == M){
+		mTapIn = 0;
+		forward(&mIn[0]);
+		std::memcpy(&mIn[0], &mIn[M], M*sizeof(T));
+		return true;
+	}
+	return false;
+}
+
+template <class T>
+T MDCT<T>::operator()(){
+	if(mTapOut == mM){
+		mTapOut = 0;
+		inverse(&mOut[0]);
+	}
+	return mOut[mTapOut++];
+}
+
+template class DCT<float>;
+template class DCT<double>;
+template class MDCT<float>;
+template class MDCT<double>;
+
+} // gam::
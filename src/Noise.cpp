@@ -0,0 +1,45 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cmath>
+#include <vector>
+#include "Gamma/FFT.h"
+#include "Gamma/Noise.h"
+#include "Gamma/TableCache.h"
+
+namespace gam{
+
+NoiseTable::NoiseTable(Color color, unsigned size, uint32_t seed)
+:	mPhase(rnd::gen()), mInc(0)
+{
+	static const double exponents[] = { 0, -1, -2, 2 };
+	const double p[2] = { exponents[color], double(seed) };
+	mTable.source(TableCache<float>::get().tablePow2("noise", generate, size, p, 2));
+	rate(1);
+}
+
+void NoiseTable::generate(float * dst, unsigned len, const double * p){
+	const unsigned N = len, H = N/2;
+	const double ampExp = p[0] * 0.5;
+	const uint32_t seed = uint32_t(p[1]);
+	RNGCounter rng(seed);
+
+	// Spectrum as [r0, r1, i1, ..., r(n/2)], without DC or Nyquist
+	std::vector<float> buf(N, 0.f);
+	for(unsigned k=1; k<H; ++k){
+		const double amp = std::pow(double(k), ampExp);
+		const double phs = rnd::uni_float(rng) * M_2PI;
+		buf[2*k-1] = float(amp * std::cos(phs));
+		buf[2*k  ] = float(amp * std::sin(phs));
+	}
+
+	RFFT<float> fft(N);
+	fft.inverse(&buf[0]);
+
+	float peak = 0.f;
+	for(unsigned i=0; i<N; ++i) peak = scl::max(peak, scl::abs(buf[i]));
+	const float gain = peak > 0.f ? 1.f/peak : 0.f;
+	for(unsigned i=0; i<N; ++i) dst[i] = buf[i] * gain;
+}
+
+} // gam::
@@ -0,0 +1,123 @@
+#include <algorithm> // fill, copy
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/Oversample.h"
+
+namespace gam{
+
+namespace{
+	// Zeroth-order modified Bessel function of the first kind
+	double besselI0(double x){
+		double sum = 1, term = 1, k = 1;
+		x *= 0.5;
+		do{
+			term *= x/k; term *= x/k;
+			sum += term;
+			++k;
+		} while(term > 1e-12 * sum);
+		return sum;
+	}
+}
+
+HalfBand::HalfBand(unsigned taps){
+	design(taps);
+}
+
+void HalfBand::design(unsigned taps){
+	if(taps < 1) taps = 1;
+
+	// Kaiser window parameter; attenuation grows with the length
+	const double beta = taps < 4 ? 4. : (taps < 8 ? 6. : 8.);
+	const double c = 2*taps - 1;	// center of filter of 4*taps-1 coefficients
+	const double norm = besselI0(beta);
+
+	// Filtering branch holds even-indexed coefficients h[2j]; the odd-indexed
+	// ones are zero except the center at 0.5.
+	mCoef.resize(2*taps);
+	double sum = 0;
+	for(unsigned j=0; j<2*taps; ++j){
+		double t = 2.*j - c;	// odd offset from center
+		double x = t/(c+1);
+		double w = besselI0(beta * std::sqrt(1. - x*x)) / norm;
+		double h = std::sin(M_PI*t*0.5) / (M_PI*t) * w;
+		mCoef[j] = float(h);
+		sum += h;
+	}
+
+	// Normalize so each polyphase branch has a DC gain of 0.5
+	for(unsigned j=0; j<2*taps; ++j) mCoef[j] = float(mCoef[j] * 0.5/sum);
+
+	mUp.assign(2*taps-1 + BLOCK, 0.f);
+	mDnE.assign(2*taps-1 + BLOCK, 0.f);
+	mDnO.assign(2*taps-1 + BLOCK, 0.f);
+}
+
+void HalfBand::reset(){
+	std::fill(mUp.begin(), mUp.end(), 0.f);
+	std::fill(mDnE.begin(), mDnE.end(), 0.f);
+	std::fill(mDnO.begin(), mDnO.end(), 0.f);
+}
+
+/*
+Both directions evaluate the filtering branch as an FIR over a buffer holding
+the last 2*taps-1 inputs followed by the current block. The loop over outputs
+is innermost so it vectorizes without reordering sums.
+*/
+void HalfBand::up(float * dst, const float * src, unsigned n){
+	const unsigned L = mCoef.size(), H = L-1, K = L/2;
+	float * buf = &mUp[0];
+	const float * g = &mCoef[0];
+
+	while(n){
+		const unsigned m = n < BLOCK ? n : BLOCK;
+		std::copy(src, src+m, buf+H);
+
+		float even[BLOCK];
+		for(unsigned i=0; i<m; ++i) even[i] = 0.f;
+		for(unsigned j=0; j<L; ++j){
+			const float gj = 2.f*g[j];
+			const float * x = buf + H - j;
+			for(unsigned i=0; i<m; ++i) even[i] += gj * x[i];
+		}
+
+		// Odd outputs are the center tap: the input delayed by taps-1
+		for(unsigned i=0; i<m; ++i){
+			dst[2*i  ] = even[i];
+			dst[2*i+1] = buf[H - (K-1) + i];
+		}
+
+		std::copy(buf+m, buf+m+H, buf);
+		src += m; dst += 2*m; n -= m;
+	}
+}
+
+void HalfBand::down(float * dst, const float * src, unsigned n){
+	const unsigned L = mCoef.size(), H = L-1, K = L/2;
+	float * bufE = &mDnE[0];
+	float * bufO = &mDnO[0];
+	const float * g = &mCoef[0];
+
+	while(n){
+		const unsigned m = n < BLOCK ? n : BLOCK;
+		for(unsigned i=0; i<m; ++i){
+			bufE[H+i] = src[2*i  ];
+			bufO[H+i] = src[2*i+1];
+		}
+
+		// Center tap: odd inputs delayed by taps
+		float acc[BLOCK];
+		for(unsigned i=0; i<m; ++i) acc[i] = 0.5f * bufO[H - K + i];
+		for(unsigned j=0; j<L; ++j){
+			const float gj = g[j];
+			const float * x = bufE + H - j;
+			for(unsigned i=0; i<m; ++i) acc[i] += gj * x[i];
+		}
+		std::copy(acc, acc+m, dst);
+
+		std::copy(bufE+m, bufE+m+H, bufE);
+		std::copy(bufO+m, bufO+m+H, bufO);
+		src += 2*m; dst += m; n -= m;
+	}
+}
+
+} // gam::
@@ -0,0 +1,325 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cfloat>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include "Gamma/PeakCache.h"
+
+namespace gam{
+
+namespace{
+	const int BINS_PER_BIN = 16; // bins of a level per bin of the next
+	const size_t HEADER_SIZE = 8 + 4 + 4 + 8 + 8*PeakCache::LEVELS;
+
+	int16_t quantize(float v){
+		if(v > 1.f) v = 1.f; else if(v < -1.f) v = -1.f;
+		return int16_t(std::lrint(v * 32767.f));
+	}
+
+	float dequantize(int16_t q){ return q * (1.f/32767.f); }
+
+	// Read header; returns channels or 0 if not a valid peak file. The
+	// counts are checked against each other and the file length, so they
+	// can be used to size buffers.
+	int readHeader(FILE * f, long long& frames, long long * bins){
+		if(fseek(f, 0, SEEK_END)) return 0;
+		const long long length = ftell(f);
+		if(length < (long long)HEADER_SIZE || fseek(f, 0, SEEK_SET)) return 0;
+
+		char buf[HEADER_SIZE];
+		if(fread(buf, 1, HEADER_SIZE, f) != HEADER_SIZE) return 0;
+		if(std::memcmp(buf, "GAMPEAK1", 8)) return 0;
+		uint32_t chans, levels;
+		int64_t n;
+		std::memcpy(&chans, buf+8, 4);
+		std::memcpy(&levels, buf+12, 4);
+		std::memcpy(&n, buf+16, 8);
+		if(levels != PeakCache::LEVELS || chans == 0 || chans > INT32_MAX || n < 0) return 0;
+		frames = n;
+
+		// Each level has its whole bins and, if finished, one partial bin
+		const long long binBytes = (long long)chans * 3 * sizeof(int16_t);
+		long long remain = length - (long long)HEADER_SIZE;
+		for(int l=0; l<PeakCache::LEVELS; ++l){
+			std::memcpy(&n, buf+24+8*l, 8);
+			const long long B = PeakCache::binFrames(l);
+			if(n < frames/B || n > (frames+B-1)/B || n > remain/binBytes) return 0;
+			remain -= n*binBytes;
+			bins[l] = n;
+		}
+		if(remain) return 0;
+		return int(chans);
+	}
+}
+
+
+PeakCache::PeakCache(int channels)
+:	mChans(0)
+{
+	this->channels(channels);
+}
+
+PeakCache& PeakCache::channels(int n){
+	mChans = n;
+	clear();
+	return *this;
+}
+
+void PeakCache::clear(){
+	mFrames = 0;
+	mFinished = false;
+	for(int l=0; l<LEVELS; ++l){
+		mLevels[l].clear();
+		mAcc[l].resize(mChans);
+		for(auto& a : mAcc[l]) resetAcc(a);
+	}
+}
+
+void PeakCache::resetAcc(Acc& a){
+	a.min = FLT_MAX;
+	a.max =-FLT_MAX;
+	a.sumSq = 0.;
+	a.n = 0;
+}
+
+void PeakCache::addAcc(Acc& a, const Acc& b){
+	if(b.min < a.min) a.min = b.min;
+	if(b.max > a.max) a.max = b.max;
+	a.sumSq += b.sumSq;
+	a.n += b.n;
+}
+
+void PeakCache::emit(int level, const Acc * acc){
+	for(int c=0; c<mChans; ++c){
+		const Acc& a = acc[c];
+		Peak p = {a.min, a.max, float(std::sqrt(a.sumSq / a.n))};
+		mLevels[level].push_back(p);
+	}
+}
+
+void PeakCache::write(const float * src, int numFrames){
+	if(mChans <= 0) return;
+	unfinish();
+	const int C = mChans;
+	const int B = binFrames(0);
+	while(numFrames > 0){
+		int m = B - int(mFrames % B);
+		if(m > numFrames) m = numFrames;
+
+		for(int c=0; c<C; ++c){
+			Acc& a = mAcc[0][c];
+			float lo = a.min, hi = a.max;
+			double ss = 0.;
+			const float * s = src + c;
+			for(int i=0; i<m; ++i){
+				const float v = s[i*C];
+				if(v < lo) lo = v;
+				if(v > hi) hi = v;
+				ss += double(v)*v;
+			}
+			a.min = lo; a.max = hi;
+			a.sumSq += ss;
+			a.n += m;
+		}
+		src += m*C;
+		numFrames -= m;
+		mFrames += m;
+
+		// Cascade completed bins up the levels
+		for(int l=0; l<LEVELS && mAcc[l][0].n == binFrames(l); ++l){
+			emit(l, &mAcc[l][0]);
+			for(int c=0; c<C; ++c){
+				if(l+1 < LEVELS) addAcc(mAcc[l+1][c], mAcc[l][c]);
+				resetAcc(mAcc[l][c]);
+			}
+		}
+	}
+}
+
+void PeakCache::finish(){
+	if(mFinished || !mChans) return;
+	// A partial bin of a level also covers the partial bins below it
+	std::vector<Acc> sum(mChans);
+	for(auto& a : sum) resetAcc(a);
+	for(int l=0; l<LEVELS; ++l){
+		for(int c=0; c<mChans; ++c) addAcc(sum[c], mAcc[l][c]);
+		if(sum[0].n) emit(l, &sum[0]);
+	}
+	mFinished = true;
+}
+
+void PeakCache::unfinish(){
+	if(!mFinished) return;
+	long long n = 0;
+	for(int l=0; l<LEVELS; ++l){
+		n += mAcc[l][0].n;
+		if(n) mLevels[l].resize(mLevels[l].size() - mChans);
+	}
+	mFinished = false;
+}
+
+bool PeakCache::append(const PeakCache& src){
+	if(src.mChans != mChans || mFrames % binFrames(LEVELS-1)) return false;
+	for(int l=0; l<LEVELS; ++l){
+		mLevels[l].insert(mLevels[l].end(), src.mLevels[l].begin(), src.mLevels[l].end());
+		mAcc[l] = src.mAcc[l];
+	}
+	mFrames += src.mFrames;
+	mFinished = src.mFinished;
+	return true;
+}
+
+PeakCache::Peak PeakCache::range(long long begin, long long end, int chan) const {
+	Peak r = {0.f, 0.f, 0.f};
+	if(chan < 0 || chan >= mChans) return r;
+
+	// Start from the finest level holding bins, as a loaded cache may have
+	// only some levels
+	int l0 = 0;
+	while(l0 < LEVELS && !bins(l0)) ++l0;
+	if(l0 == LEVELS) return r;
+	long long b0 = begin < 0 ? 0 : begin / binFrames(l0);
+	long long b1 = (end + binFrames(l0)-1) / binFrames(l0);
+	if(b1 > bins(l0)) b1 = bins(l0);
+	if(b0 >= b1) return r;
+
+	Acc a;
+	resetAcc(a);
+	auto take = [&](int l, long long b){
+		const Peak& p = peak(l, int(b), chan);
+		long long n = mFrames - b*binFrames(l);
+		if(n > binFrames(l)) n = binFrames(l);
+		if(p.min < a.min) a.min = p.min;
+		if(p.max > a.max) a.max = p.max;
+		a.sumSq += double(p.rms)*p.rms*n;
+		a.n += n;
+	};
+
+	// Take unaligned bins at the ends, then move up a level
+	for(int l=l0; b0<b1; ++l){
+		if(l == LEVELS-1 || !bins(l+1)){
+			for(long long b=b0; b<b1; ++b) take(l, b);
+			break;
+		}
+		while(b0 < b1 && b0 % BINS_PER_BIN) take(l, b0++);
+		while(b0 < b1 && b1 % BINS_PER_BIN) take(l, --b1);
+		b0 /= BINS_PER_BIN;
+		b1 /= BINS_PER_BIN;
+	}
+
+	r.min = a.min;
+	r.max = a.max;
+	r.rms = float(std::sqrt(a.sumSq / a.n));
+	return r;
+}
+
+int PeakCache::level(double framesPerPixel){
+	int l = 0;
+	while(l+1 < LEVELS && binFrames(l+1) <= framesPerPixel) ++l;
+	return l;
+}
+
+bool PeakCache::save(const std::string& path) const {
+	std::vector<char> buf;
+	auto put = [&buf](const void * src, size_t bytes){
+		const char * c = static_cast<const char *>(src);
+		buf.insert(buf.end(), c, c + bytes);
+	};
+
+	uint32_t chans = mChans, levels = LEVELS;
+	int64_t frames = mFrames;
+	put("GAMPEAK1", 8); put(&chans, 4); put(&levels, 4); put(&frames, 8);
+	for(int l=0; l<LEVELS; ++l){
+		int64_t n = bins(l);
+		put(&n, 8);
+	}
+	for(int l=0; l<LEVELS; ++l){
+		for(const Peak& p : mLevels[l]){
+			int16_t q[3] = {quantize(p.min), quantize(p.max), quantize(p.rms)};
+			put(q, sizeof q);
+		}
+	}
+
+	FILE * f = fopen(path.c_str(), "wb");
+	bool ok = f && fwrite(&buf[0], 1, buf.size(), f) == buf.size();
+	if(f) ok = (fclose(f) == 0) && ok;
+	if(!ok) fprintf(stderr, "gam::PeakCache: couldn't write \"%s\"\n", path.c_str());
+	return ok;
+}
+
+bool PeakCache::load(const std::string& path, int level){
+	FILE * f = fopen(path.c_str(), "rb");
+	if(!f){
+		fprintf(stderr, "gam::PeakCache: couldn't open \"%s\"\n", path.c_str());
+		return false;
+	}
+
+	long long frames, bins[LEVELS];
+	int chans = readHeader(f, frames, bins);
+	bool ok = chans > 0;
+	if(ok){
+		channels(chans);
+		mFrames = frames;
+		std::vector<int16_t> q;
+		for(int l=0; ok && l<LEVELS; ++l){
+			const size_t n = size_t(bins[l]) * chans * 3;
+			if(level >= 0 && l != level){
+				ok = fseek(f, long(n * sizeof(int16_t)), SEEK_CUR) == 0;
+				continue;
+			}
+			q.resize(n);
+			ok = fread(q.data(), sizeof(int16_t), n, f) == n;
+			if(!ok) break;
+			mLevels[l].resize(n/3);
+			for(size_t i=0; i<n/3; ++i){
+				Peak p = {dequantize(q[3*i]), dequantize(q[3*i+1]), dequantize(q[3*i+2])};
+				mLevels[l][i] = p;
+			}
+		}
+		// Partial bins are stored as if finished
+		mFinished = true;
+	}
+	if(!ok) clear();
+	fclose(f);
+
+	if(!ok) fprintf(stderr, "gam::PeakCache: \"%s\" is not a valid peak file\n", path.c_str());
+	return ok;
+}
+
+int PeakCache::read(Peak * dst, const std::string& path, int level, int bin, int numBins){
+	if(level < 0 || level >= LEVELS || bin < 0 || numBins <= 0) return 0;
+	FILE * f = fopen(path.c_str(), "rb");
+	if(!f){
+		fprintf(stderr, "gam::PeakCache: couldn't open \"%s\"\n", path.c_str());
+		return 0;
+	}
+
+	long long frames, bins[LEVELS];
+	int chans = readHeader(f, frames, bins);
+	int n = 0;
+	if(chans && bin < bins[level]){
+		if(numBins > bins[level] - bin) numBins = int(bins[level] - bin);
+		long long offset = HEADER_SIZE;
+		for(int l=0; l<level; ++l) offset += bins[l] * chans * 3 * sizeof(int16_t);
+		offset += (long long)bin * chans * 3 * sizeof(int16_t);
+		std::vector<int16_t> q(size_t(numBins) * chans * 3);
+		if(fseek(f, long(offset), SEEK_SET) == 0
+			&& fread(q.data(), sizeof(int16_t), q.size(), f) == q.size()){
+			for(size_t i=0; i<q.size()/3; ++i){
+				Peak p = {dequantize(q[3*i]), dequantize(q[3*i+1]), dequantize(q[3*i+2])};
+				dst[i] = p;
+			}
+			n = numBins;
+		}
+	}
+	else if(!chans){
+		fprintf(stderr, "gam::PeakCache: \"%s\" is not a valid peak file\n", path.c_str());
+	}
+	fclose(f);
+	return n;
+}
+
+} // gam::
@@ -0,0 +1,245 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cmath>
+#include <cstring>
+#include "Gamma/CPU.h"
+#include "Gamma/Constants.h"
+#include "Gamma/PhaseVocoder.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_PV_AVX
+#endif
+
+namespace gam{
+
+namespace{
+
+	const float c2pi = float(M_2PI);
+	const float c1_2pi = float(M_1_2PI);
+
+	// Wrap phase into [-pi, pi)
+	inline float wrap(float x){ return x - c2pi * std::floor(x * c1_2pi + 0.5f); }
+
+	struct Advance{
+		float * adv;		// phase advance of bin per output hop
+		float * prev;		// previous analysis phases, updated
+		const float * phs;	// analysis phases
+		float expect;		// expected phase advance of bin 1 per input hop
+		float ratio;		// output hop over input hop
+	};
+
+	// Kernels process the first bins that fill their vectors and return how
+	// many they did; the rest are done by the scalar loops.
+	typedef unsigned (*AdvanceKernel)(const Advance&, unsigned);
+	typedef unsigned (*AccumKernel)(float *, const float *, unsigned);
+
+	unsigned advanceNone(const Advance&, unsigned){ return 0; }
+	unsigned accumNone(float *, const float *, unsigned){ return 0; }
+
+	#if defined(GAM_PV_AVX)
+	GAM_TARGET_AVX512 inline __m512 wrapAVX512(__m512 x){
+		const __m512 t = _mm512_fmadd_ps(x, _mm512_set1_ps(c1_2pi), _mm512_set1_ps(0.5f));
+		const __m512 f = _mm512_mask_roundscale_ps(t, 0xffff, t, _MM_FROUND_TO_NEG_INF | _MM_FROUND_NO_EXC);
+		return _mm512_fnmadd_ps(f, _mm512_set1_ps(c2pi), x);
+	}
+
+	GAM_TARGET_AVX512 unsigned advanceAVX512(const Advance& a, unsigned n){
+		const __m512 ramp = _mm512_setr_ps(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+		const __m512 e = _mm512_set1_ps(a.expect), r = _mm512_set1_ps(a.ratio);
+		unsigned k=0;
+		for(; k+16<=n; k+=16){
+			const __m512 ke = _mm512_mul_ps(_mm512_add_ps(_mm512_set1_ps(float(k)), ramp), e);
+			const __m512 p = _mm512_loadu_ps(a.phs+k);
+			const __m512 d = wrapAVX512(_mm512_sub_ps(_mm512_sub_ps(p, _mm512_loadu_ps(a.prev+k)), ke));
+			_mm512_storeu_ps(a.adv+k, _mm512_mul_ps(_mm512_add_ps(ke, d), r));
+			_mm512_storeu_ps(a.prev+k, p);
+		}
+		return k;
+	}
+
+	GAM_TARGET_AVX512 unsigned accumAVX512(float * acc, const float * adv, unsigned n){
+		unsigned k=0;
+		for(; k+16<=n; k+=16){
+			const __m512 s = _mm512_add_ps(_mm512_loadu_ps(acc+k), _mm512_loadu_ps(adv+k));
+			_mm512_storeu_ps(acc+k, wrapAVX512(s));
+		}
+		return k;
+	}
+
+	GAM_TARGET_AVX2 inline __m256 wrapAVX2(__m256 x){
+		const __m256 f = _mm256_floor_ps(
+			_mm256_fmadd_ps(x, _mm256_set1_ps(c1_2pi), _mm256_set1_ps(0.5f)));
+		return _mm256_fnmadd_ps(f, _mm256_set1_ps(c2pi), x);
+	}
+
+	GAM_TARGET_AVX2 unsigned advanceAVX2(const Advance& a, unsigned n){
+		const __m256 ramp = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+		const __m256 e = _mm256_set1_ps(a.expect), r = _mm256_set1_ps(a.ratio);
+		unsigned k=0;
+		for(; k+8<=n; k+=8){
+			const __m256 ke = _mm256_mul_ps(_mm256_add_ps(_mm256_set1_ps(float(k)), ramp), e);
+			const __m256 p = _mm256_loadu_ps(a.phs+k);
+			const __m256 d = wrapAVX2(_mm256_sub_ps(_mm256_sub_ps(p, _mm256_loadu_ps(a.prev+k)), ke));
+			_mm256_storeu_ps(a.adv+k, _mm256_mul_ps(_mm256_add_ps(ke, d), r));
+			_mm256_storeu_ps(a.prev+k, p);
+		}
+		return k;
+	}
+
+	GAM_TARGET_AVX2 unsigned accumAVX2(float * acc, const float * adv, unsigned n){
+		unsigned k=0;
+		for(; k+8<=n; k+=8){
+			const __m256 s = _mm256_add_ps(_mm256_loadu_ps(acc+k), _mm256_loadu_ps(adv+k));
+			_mm256_storeu_ps(acc+k, wrapAVX2(s));
+		}
+		return k;
+	}
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+}
+
+
+PhaseVocoder::PhaseVocoder(unsigned numBinsA)
+:	mPitch(1), mStretch(1), mLocking(LOCK_NONE), mResetPhases(false), mFirst(true)
+{
+	resize(numBinsA);
+}
+
+PhaseVocoder& PhaseVocoder::resize(unsigned n){
+	mMag.assign(n, 0.f); mPhs.assign(n, 0.f);
+	mPrev.assign(n, 0.f); mAdv.assign(n, 0.f);
+	mOutMag.assign(n, 0.f); mOutAdv.assign(n, 0.f); mOutPhs.assign(n, 0.f);
+	mAccum.assign(n, 0.f);
+	mPeaks.reserve(n/2 + 1);
+	mFirst = true;
+	return *this;
+}
+
+// Move bins to k*ratio, summing magnitudes. Bins landing on the same output
+// bin are neighbors, so the loudest of them gives its phase.
+void PhaseVocoder::shift(float ratio, float binAdv){
+	const unsigned N = numBins();
+	if(ratio == 1.f){
+		mOutMag = mMag; mOutAdv = mAdv; mOutPhs = mPhs;
+		return;
+	}
+
+	mem::deepZero(&mOutMag[0], N);
+	mem::deepZero(&mOutPhs[0], N);
+	// Empty bins advance at their center frequency
+	for(unsigned j=0; j<N; ++j) mOutAdv[j] = float(j) * binAdv;
+
+	unsigned last = N;
+	float loudest = 0.f;
+	for(unsigned k=0; k<N; ++k){
+		const unsigned j = unsigned(float(k) * ratio + 0.5f);
+		if(j >= N) break;
+		mOutMag[j] += mMag[k];
+		if(j != last || mMag[k] > loudest){
+			mOutAdv[j] = mAdv[k] * ratio;
+			mOutPhs[j] = mPhs[k];
+			loudest = mMag[k];
+			last = j;
+		}
+	}
+}
+
+// Identity phase locking (Laroche & Dolson, 1999): each bin keeps the
+// phase offset it had in the analysis to the peak whose region it is in.
+// Regions are split at the quietest bin between peaks.
+void PhaseVocoder::lock(){
+	const unsigned N = numBins();
+	const float * m = &mOutMag[0];
+	mPeaks.clear();
+	for(unsigned j=0; j<N; ++j){
+		const float v = m[j];
+		if(v <= 0.f) continue;
+		if(j>=1 && m[j-1] >= v) continue;
+		if(j>=2 && m[j-2] >= v) continue;
+		if(j+1<N && m[j+1] > v) continue;
+		if(j+2<N && m[j+2] > v) continue;
+		mPeaks.push_back(j);
+	}
+
+	unsigned beg = 0;
+	for(unsigned i=0; i<mPeaks.size(); ++i){
+		const unsigned p = mPeaks[i];
+		unsigned end = N;
+		if(i+1 < mPeaks.size()){
+			end = p+1;
+			for(unsigned j=p+1; j<mPeaks[i+1]; ++j){ if(m[j] < m[end]) end = j; }
+		}
+		const float base = mAccum[p] - mOutPhs[p];
+		for(unsigned j=beg; j<end; ++j){
+			if(j != p) mAccum[j] = wrap(base + mOutPhs[j]);
+		}
+		beg = end;
+	}
+}
+
+void PhaseVocoder::operator()(STFT& stft){
+	static SIMDDispatch<AdvanceKernel> advanceKernel(advanceNone,
+		0, GAM_AVX_KERNEL(advanceAVX2), GAM_AVX_KERNEL(advanceAVX512));
+	static SIMDDispatch<AccumKernel> accumKernel(accumNone,
+		0, GAM_AVX_KERNEL(accumAVX2), GAM_AVX_KERNEL(accumAVX512));
+
+	const unsigned N = stft.numBins();
+	if(N != numBins()) resize(N);
+	if(!N) return;
+
+	// Load analysis frame
+	if(stft.splitBins()){
+		std::memcpy(&mMag[0], stft.binComp(0), N*sizeof(float));
+		std::memcpy(&mPhs[0], stft.binComp(1), N*sizeof(float));
+	}
+	else{
+		const Complex<float> * b = stft.bins();
+		for(unsigned k=0; k<N; ++k){ mMag[k] = b[k][0]; mPhs[k] = b[k][1]; }
+	}
+
+	// Unwrap phase differences into phase advances per output hop
+	const float ratio = stretch();
+	const Advance a = {
+		&mAdv[0], &mPrev[0], &mPhs[0],
+		float(M_2PI * stft.sizeHop() / (ratio * stft.sizeDFT())), ratio
+	};
+	for(unsigned k = advanceKernel()(a, N); k<N; ++k){
+		const float ke = float(k) * a.expect;
+		const float d = wrap(a.phs[k] - a.prev[k] - ke);
+		a.adv[k] = (ke + d) * a.ratio;
+		a.prev[k] = a.phs[k];
+	}
+
+	shift(pitch(), a.expect * a.ratio);
+
+	// Accumulate output phases
+	bool reset = mResetPhases.exchange(false, std::memory_order_relaxed);
+	if(mFirst || reset){
+		mAccum = mOutPhs;
+		mFirst = false;
+	}
+	else{
+		float * acc = &mAccum[0];
+		const float * adv = &mOutAdv[0];
+		for(unsigned k = accumKernel()(acc, adv, N); k<N; ++k){
+			acc[k] = wrap(acc[k] + adv[k]);
+		}
+		if(LOCK_IDENTITY == phaseLocking()) lock();
+	}
+
+	// Store synthesis frame
+	if(stft.splitBins()){
+		std::memcpy(stft.binComp(0), &mOutMag[0], N*sizeof(float));
+		std::memcpy(stft.binComp(1), &mAccum[0], N*sizeof(float));
+	}
+	else{
+		Complex<float> * b = stft.bins();
+		for(unsigned k=0; k<N; ++k){ b[k][0] = mOutMag[k]; b[k][1] = mAccum[k]; }
+	}
+}
+
+} // gam::
@@ -2,7 +2,12 @@
 	See COPYRIGHT file for authors and license information */
 
 #include <cstdlib> // exit
+#include <cstring>
+#include <atomic>
+#include <mutex>
 #include "Gamma/Print.h"
+#include "Gamma/Thread.h"
+#include "Gamma/Timer.h"
 
 namespace gam{
 
@@ -88,4 +93,200 @@ void warn(const char * msg, const char * src){
 }
 
 
+namespace{
+
+	// Bounded multi-producer queue after D. Vyukov. The sequence number of a
+	// cell tells whether it is free for the producer at a position or holds
+	// a record for the consumer. Numbers are stored relative to the cell
+	// index so that the zero-initialized queue is empty, making it usable
+	// before any constructor has run.
+	enum{ LOG_SIZE = 1024, LOG_MASK = LOG_SIZE-1 };
+
+	struct LogCell{
+		std::atomic<unsigned> seq;
+		LogRecord rec;
+	};
+
+	LogCell gLogCells[LOG_SIZE];
+	std::atomic<unsigned> gLogTail;		// next position to push
+	std::atomic<unsigned> gLogDropped;
+	std::mutex gLogMutex;				// held by consumers
+	unsigned gLogHead = 0;				// next position to pop
+	unsigned gLogReported = 0;			// drops already reported
+
+	bool logPop(LogRecord& r){
+		const unsigned pos = gLogHead;
+		LogCell& c = gLogCells[pos & LOG_MASK];
+		if(c.seq.load(std::memory_order_acquire) + (pos & LOG_MASK) != pos + 1) return false;
+		r = c.rec;
+		c.seq.store(pos + LOG_SIZE - (pos & LOG_MASK), std::memory_order_release);
+		gLogHead = pos + 1;
+		return true;
+	}
+
+	long long asInt(const LogRecord& r, unsigned i){
+		switch(r.types[i]){
+		case LogRecord::INT:	return r.args[i].i;
+		case LogRecord::UINT:	return (long long)r.args[i].u;
+		case LogRecord::FLOAT:	return (long long)r.args[i].f;
+		default:				return 0;
+		}
+	}
+
+	double asFloat(const LogRecord& r, unsigned i){
+		switch(r.types[i]){
+		case LogRecord::INT:	return double(r.args[i].i);
+		case LogRecord::UINT:	return double(r.args[i].u);
+		case LogRecord::FLOAT:	return r.args[i].f;
+		default:				return 0;
+		}
+	}
+
+	// Print a record, passing each conversion to fprintf with the argument
+	// type stored; length modifiers in the format are ignored.
+	void printRecord(FILE * fp, const LogRecord& r){
+		fprintf(fp, "%s%s%s: ", r.src, r.src[0]?" ":"", r.error ? "error" : "warning");
+		unsigned a = 0;
+		for(const char * c = r.fmt; *c;){
+			if(*c != '%'){
+				const char * e = strchr(c, '%');
+				const size_t n = e ? size_t(e-c) : strlen(c);
+				fwrite(c, 1, n, fp);
+				c += n;
+				continue;
+			}
+			if(c[1] == '%'){ fputc('%', fp); c += 2; continue; }
+
+			const char * start = c;
+			char spec[32] = "%";
+			unsigned k = 1;
+			const char * s = c+1;
+			while(*s && strchr("-+ #0123456789.", *s) && k < sizeof(spec)-4) spec[k++] = *s++;
+			while(*s && strchr("hlLqjzt", *s)) ++s;
+			const char conv = *s;
+			if(!conv) break;
+			c = s+1;
+			if(a == r.numArgs){ fputs("(?)", fp); continue; }
+			const unsigned i = a++;
+
+			switch(conv){
+			case 'c':
+				spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, int(asInt(r,i))); break;
+			case 'd': case 'i':
+				spec[k++] = 'l'; spec[k++] = 'l'; spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, asInt(r,i)); break;
+			case 'o': case 'u': case 'x': case 'X':
+				spec[k++] = 'l'; spec[k++] = 'l'; spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, r.types[i] == LogRecord::UINT ? r.args[i].u : (unsigned long long)asInt(r,i)); break;
+			case 'e': case 'E': case 'f': case 'F': case 'g': case 'G': case 'a': case 'A':
+				spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, asFloat(r,i)); break;
+			case 's':
+				spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, r.types[i] == LogRecord::STRING && r.args[i].s ? r.args[i].s : "(?)"); break;
+			case 'p':
+				spec[k++] = conv; spec[k] = 0;
+				fprintf(fp, spec, r.types[i] >= LogRecord::STRING ? r.args[i].p : (const void *)0); break;
+			default: // unknown conversion, printed as is
+				fwrite(start, 1, size_t(c-start), fp);
+				--a;
+			}
+		}
+		fputc('\n', fp);
+	}
+
+	struct Logger{
+		Thread thread;
+		std::atomic<bool> run;
+		std::atomic<bool> started;
+		std::atomic<double> period;
+
+		Logger(): run(false), started(false), period(0.05){}
+		~Logger(){
+			run.store(false, std::memory_order_release);
+			if(started.load()) thread.join();
+		}
+
+		static void * func(void * user){
+			Logger& l = *(Logger *)user;
+			while(l.run.load(std::memory_order_acquire)){
+				logFlush();
+				sleepSec(l.period.load(std::memory_order_relaxed));
+			}
+			return NULL;
+		}
+	};
+
+	unsigned flushRecords(FILE * fp, bool& fatal){
+		std::lock_guard<std::mutex> lock(gLogMutex);
+		unsigned n = 0;
+		LogRecord r;
+		while(logPop(r)){
+			printRecord(fp, r);
+			++n;
+			if(r.fatal){ fatal = true; break; }
+		}
+		const unsigned dropped = gLogDropped.load(std::memory_order_relaxed);
+		if(dropped != gLogReported){
+			fprintf(fp, "gam::log warning: %u messages dropped; queue full\n", dropped - gLogReported);
+			gLogReported = dropped;
+		}
+		if(n) fflush(fp);
+		return n;
+	}
+
+	// Prints what is left at exit, after the logger thread has stopped. It
+	// is already exiting, so fatal messages are only printed.
+	struct LogExitFlush{
+		~LogExitFlush(){ bool fatal; flushRecords(stderr, fatal); }
+	} gLogExitFlush;
+}
+
+
+bool logPush(const LogRecord& r){
+	unsigned pos = gLogTail.load(std::memory_order_relaxed);
+	for(;;){
+		LogCell& c = gLogCells[pos & LOG_MASK];
+		const unsigned seq = c.seq.load(std::memory_order_acquire) + (pos & LOG_MASK);
+		const int dif = int(seq - pos);
+		if(dif == 0){
+			if(gLogTail.compare_exchange_weak(pos, pos+1, std::memory_order_relaxed)){
+				c.rec = r;
+				c.seq.store(pos + 1 - (pos & LOG_MASK), std::memory_order_release);
+				return true;
+			}
+		}
+		else if(dif < 0){
+			gLogDropped.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else{
+			pos = gLogTail.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+unsigned logFlush(FILE * fp){
+	bool fatal = false;
+	const unsigned n = flushRecords(fp, fatal);
+	if(fatal) std::_Exit(EXIT_FAILURE);
+	return n;
+}
+
+void logStart(double period){
+	static Logger l;
+	l.period.store(period, std::memory_order_relaxed);
+	bool expected = false;
+	if(l.started.compare_exchange_strong(expected, true)){
+		l.run.store(true, std::memory_order_release);
+		l.thread.start(Logger::func, &l);
+	}
+}
+
+unsigned logDropped(){
+	return gLogDropped.load(std::memory_order_relaxed);
+}
+
+
 } // gam::
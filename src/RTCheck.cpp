@@ -0,0 +1,177 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <atomic>
+#include "Gamma/RTCheck.h"
+
+#if defined(__GLIBC__) || defined(__APPLE__)
+	#include <execinfo.h> // backtrace
+	#define GAM_RT_BACKTRACE
+#endif
+
+#if defined(GAM_RT_CHECK) && defined(__GLIBC__)
+	#include <dlfcn.h> // dlsym
+	#include <pthread.h>
+	#define GAM_RT_INTERCEPT
+#endif
+
+// Thread state is read by the interceptors, so it must not be allocated
+// lazily on first access
+#if defined(__GNUC__)
+	#define GAM_RT_TLS thread_local __attribute__((tls_model("initial-exec")))
+#else
+	#define GAM_RT_TLS thread_local
+#endif
+
+namespace gam{
+
+namespace{
+
+	GAM_RT_TLS bool tRealtime = false;
+	GAM_RT_TLS bool tReporting = false;	// in handler; do not report its allocations
+
+	std::atomic<unsigned long long> gCounts[RT_VIOLATIONS];
+	std::atomic<unsigned> gPrinted(0);
+
+	void defaultHandler(RTViolation type, void *){
+		// Print only the first few, since a violation in a callback recurs
+		// every block
+		if(gPrinted.fetch_add(1, std::memory_order_relaxed) < 8){
+			fprintf(stderr, "gam: %s on real-time thread\n", rtViolationName(type));
+			rtPrintStack();
+		}
+	}
+
+	std::atomic<RTViolationHandler> gHandler(defaultHandler);
+	std::atomic<void *> gUser(0);
+
+	inline void check(RTViolation type){
+		if(tRealtime && !tReporting){
+			tReporting = true;
+			gCounts[type].fetch_add(1, std::memory_order_relaxed);
+			gHandler.load(std::memory_order_acquire)(type, gUser.load(std::memory_order_relaxed));
+			tReporting = false;
+		}
+	}
+}
+
+
+RTScope::RTScope(bool realtime): mPrev(tRealtime){ tRealtime = realtime; }
+RTScope::~RTScope(){ tRealtime = mPrev; }
+
+bool rtThread(){ return tRealtime; }
+
+void rtViolation(RTViolation type){ check(type); }
+
+unsigned long long rtViolations(RTViolation type){
+	return type < RT_VIOLATIONS ? gCounts[type].load(std::memory_order_relaxed) : 0;
+}
+
+unsigned long long rtViolations(){
+	unsigned long long n = 0;
+	for(int i=0; i<RT_VIOLATIONS; ++i) n += gCounts[i].load(std::memory_order_relaxed);
+	return n;
+}
+
+void rtViolationsClear(){
+	for(int i=0; i<RT_VIOLATIONS; ++i) gCounts[i].store(0, std::memory_order_relaxed);
+	gPrinted.store(0, std::memory_order_relaxed);
+}
+
+void rtViolationHandler(RTViolationHandler h, void * user){
+	gUser.store(user, std::memory_order_relaxed);
+	gHandler.store(h ? h : defaultHandler, std::memory_order_release);
+}
+
+void rtPrintStack(){
+	#ifdef GAM_RT_BACKTRACE
+	void * frames[32];
+	const int n = backtrace(frames, 32);
+	backtrace_symbols_fd(frames+1, n-1, 2); // skip this frame
+	#endif
+}
+
+bool rtCheckIntercepts(){
+	#ifdef GAM_RT_INTERCEPT
+	return true;
+	#else
+	return false;
+	#endif
+}
+
+const char * rtViolationName(RTViolation type){
+	switch(type){
+	case RT_ALLOC:	return "allocation";
+	case RT_FREE:	return "deallocation";
+	case RT_LOCK:	return "mutex lock";
+	default:		return "unknown";
+	}
+}
+
+} // gam::
+
+
+#ifdef GAM_RT_INTERCEPT
+// These replace the C library's functions in programs linking this file and
+// forward to its implementations. operator new and delete call them.
+extern "C" {
+
+void * __libc_malloc(size_t);
+void * __libc_calloc(size_t, size_t);
+void * __libc_realloc(void *, size_t);
+void * __libc_memalign(size_t, size_t);
+void __libc_free(void *);
+
+void * malloc(size_t n){
+	gam::check(gam::RT_ALLOC);
+	return __libc_malloc(n);
+}
+
+void * calloc(size_t n, size_t size){
+	gam::check(gam::RT_ALLOC);
+	return __libc_calloc(n, size);
+}
+
+void * realloc(void * p, size_t n){
+	gam::check(p ? (n ? gam::RT_ALLOC : gam::RT_FREE) : gam::RT_ALLOC);
+	return __libc_realloc(p, n);
+}
+
+void free(void * p){
+	if(p) gam::check(gam::RT_FREE);
+	__libc_free(p);
+}
+
+void * memalign(size_t align, size_t n){
+	gam::check(gam::RT_ALLOC);
+	return __libc_memalign(align, n);
+}
+
+void * aligned_alloc(size_t align, size_t n){
+	gam::check(gam::RT_ALLOC);
+	return __libc_memalign(align, n);
+}
+
+int posix_memalign(void ** p, size_t align, size_t n){
+	gam::check(gam::RT_ALLOC);
+	if(align % sizeof(void *) || (align & (align-1))) return 22; // EINVAL
+	*p = __libc_memalign(align, n);
+	return *p || !n ? 0 : 12; // ENOMEM
+}
+
+int pthread_mutex_lock(pthread_mutex_t * m){
+	typedef int (*Lock)(pthread_mutex_t *);
+	static std::atomic<Lock> real(0);
+	Lock f = real.load(std::memory_order_relaxed);
+	if(!f){
+		f = (Lock)dlsym(RTLD_NEXT, "pthread_mutex_lock");
+		real.store(f, std::memory_order_relaxed);
+	}
+	gam::check(gam::RT_LOCK);
+	return f(m);
+}
+
+} // extern "C"
+#endif
@@ -5,46 +5,58 @@
 namespace gam{
 
 Recorder::Recorder()
-:	mChans(0), mIW(0), mIR(0)
+:	mChans(0), mIW(0), mIR(0), mDropped(0)
 {}
 
 Recorder::Recorder(int channels, int frames)
-:	mChans(0), mIW(0), mIR(0)
+:	mChans(0), mIW(0), mIR(0), mDropped(0)
 {
 	resize(channels, frames);
 }
 
 int Recorder::write(const float * buf, int numFrames){
 
-	if(numFrames > frames()) numFrames = frames();
+	const int Nr = size();
+	const int iw = mIW.load(std::memory_order_relaxed);
+	const int ir = mIR.load(std::memory_order_acquire);
+
+	// Free samples, keeping one frame empty
+	int avail = (ir > iw ? ir - iw : Nr - iw + ir) - channels();
+	int n = avail / channels();
+	if(numFrames > n){
+		mDropped.store(dropped() + (numFrames - n), std::memory_order_relaxed);
+		numFrames = n;
+	}
 
-	int Nr = mRing.size();
 	int Nw = numFrames * channels();
 	
-	if((mIW+Nw) > Nr){ // need to write across array boundary
-		int N0 = Nr - mIW;
-		int N1 = mIW + Nw - Nr;
-		std::memcpy(&mRing[mIW], buf, N0);
-		std::memcpy(&mRing[  0], buf + N0, N1);
-		mIW = N1;
+	if((iw+Nw) > Nr){ // need to write across array boundary
+		int N0 = Nr - iw;
+		int N1 = iw + Nw - Nr;
+		std::memcpy(&mRing[iw], buf, N0*sizeof(float));
+		std::memcpy(&mRing[ 0], buf + N0, N1*sizeof(float));
+		mIW.store(N1, std::memory_order_release);
 	}
-	else{
-		int newIW = mIW + Nw;		
-		std::memcpy(&mRing[mIW], buf, Nw);
-		if(newIW < Nr)	mIW = newIW;
-		else			mIW = 0;
+	else if(Nw){
+		int newIW = iw + Nw;		
+		std::memcpy(&mRing[iw], buf, Nw*sizeof(float));
+		mIW.store(newIW < Nr ? newIW : 0, std::memory_order_release);
 	}
 
 	return numFrames;
 }
 
-int Recorder::read(float *& buf){
-//printf("read\n");
-	const int iw = mIW;
-	if(iw == mIR) return 0;
+int Recorder::writable() const {
+	if(!channels()) return 0;
+	const int Nr = size();
+	const int iw = mIW.load(std::memory_order_relaxed);
+	const int ir = mIR.load(std::memory_order_acquire);
+	return ((ir > iw ? ir - iw : Nr - iw + ir) - channels()) / channels();
+}
 
-	int N = size();
-	int behind = 0;
+int Recorder::peek(const float *& buf1, int& frames1, const float *& buf2, int& frames2) const {
+	const int iw = mIW.load(std::memory_order_acquire);
+	const int ir = mIR.load(std::memory_order_relaxed);
 
 	/*
 	01234567
@@ -54,38 +66,49 @@ int Recorder::read(float *& buf){
 	w   r---	case 2
 	-w   r--	case 2
 	*/
-	
-	if(mIR < iw){	// case 1: contiguous copy
-		behind = iw - mIR;
-		for(int i=0; i<behind; ++i){
-			mRead[i] = mRing[mIR+i];
-		}
-//		printf("w: %4d, r: %4d, d: %4d\n", (int)mIW, (int)mIR, behind);			
+
+	frames1 = frames2 = 0;
+	if(iw == ir) return 0;
+
+	buf1 = &mRing[ir];
+	if(ir < iw){	// case 1: one contiguous region
+		frames1 = (iw - ir) / channels();
 	}
-	else{			// case 2: two fragment copy
-		int d1 = N - mIR;
-		for(int i=0; i<d1; ++i){
-			mRead[i] = mRing[mIR+i];
-		}
-		
-		int d2 = iw;
-		for(int i=d1; i<d1+d2; ++i){
-			mRead[i] = mRing[i-d1];
-		}
-//		printf("w: %4d, r: %4d, d: %4d + %4d\n", mIW, mIR, d1, d2);
-		behind = d1+d2;
+	else{			// case 2: two regions
+		frames1 = (size() - ir) / channels();
+		buf2 = &mRing[0];
+		frames2 = iw / channels();
 	}
-	mIR += behind;
-	if(mIR >= N) mIR -= N;
-	
+	return frames1 + frames2;
+}
+
+void Recorder::release(int numFrames){
+	int ir = mIR.load(std::memory_order_relaxed) + numFrames * channels();
+	if(ir >= size()) ir -= size();
+	mIR.store(ir, std::memory_order_release);
+}
+
+int Recorder::read(float *& buf){
+	const float * b1, * b2;
+	int n1, n2;
+	int n = peek(b1, n1, b2, n2);
+	if(0 == n) return 0;
+
+	std::memcpy(&mRead[0], b1, n1*channels()*sizeof(float));
+	if(n2) std::memcpy(&mRead[n1*channels()], b2, n2*channels()*sizeof(float));
+	release(n);
+
 	buf = &mRead[0];
-	return behind/channels();
+	return n;
 }
 
 void Recorder::resize(int chans, int frames){
 	mChans = chans;
 	mRing.resize(frames*mChans);
 	mRead.resize(frames*mChans);
+	mIW.store(0);
+	mIR.store(0);
+	mDropped.store(0);
 }
 
 } // gam::
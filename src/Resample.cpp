@@ -0,0 +1,184 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm> // copy, fill
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/Resample.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define GAM_SINC_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_SINC_NEON
+#endif
+
+namespace gam{
+
+namespace{
+	// Zeroth-order modified Bessel function of the first kind
+	double besselI0(double x){
+		double sum = 1, term = 1, k = 1;
+		x *= 0.5;
+		do{
+			term *= x/k; term *= x/k;
+			sum += term;
+			++k;
+		} while(term > 1e-12 * sum);
+		return sum;
+	}
+}
+
+SincBank::SincBank(unsigned zeros, unsigned phases, float cutoff)
+:	mPhases(phases < 1 ? 1 : phases),
+	mCutoff(cutoff <= 0.f ? 0.01f : (cutoff > 1.f ? 1.f : cutoff))
+{
+	if(zeros < 1) zeros = 1;
+
+	// Keep the zero crossings of the stretched kernel; an even number of
+	// taps per side makes the kernels a multiple of 4 long.
+	mHalf = unsigned(std::ceil(zeros / mCutoff));
+	mHalf += mHalf & 1;
+
+	// Interpolators gather inputs into fixed buffers of 2*MAX_HALF
+	if(mHalf > MAX_HALF) mHalf = MAX_HALF;
+	mStride = 2*mHalf;
+
+	const double beta = 8;
+	const double norm = besselI0(beta);
+	const double fc = mCutoff;
+	std::vector<double> row(mStride);
+
+	mRow.resize((mPhases+1) * mStride);
+	for(unsigned p=0; p<=mPhases; ++p){
+		const double frac = double(p) / mPhases;
+		double sum = 0;
+		for(unsigned k=0; k<mStride; ++k){
+			double t = double(k) - mHalf + 1 - frac;	// offset of input from point
+			double x = t / mHalf;
+			double h = 0;
+			if(x > -1 && x < 1){
+				double w = besselI0(beta * std::sqrt(1. - x*x)) / norm;
+				double s = t == 0 ? 1 : std::sin(M_PI*fc*t) / (M_PI*fc*t);
+				h = s * w;
+			}
+			row[k] = h;
+			sum += h;
+		}
+		// Normalize each kernel to unit DC gain
+		for(unsigned k=0; k<mStride; ++k) mRow[p*mStride + k] = float(row[k] / sum);
+	}
+
+	mDiff.resize(mPhases * mStride);
+	for(unsigned i=0; i<mDiff.size(); ++i) mDiff[i] = mRow[i + mStride] - mRow[i];
+}
+
+const SincBank& SincBank::get(){
+	static SincBank * o = new SincBank;
+	return *o;
+}
+
+/*
+The dot product keeps several partial sums over groups of taps. Kernels are a
+multiple of 4 taps long.
+*/
+float SincBank::operator()(const float * src, double frac) const {
+	const float * d; float f;
+	const float * k = kernel(frac, d, f);
+	const unsigned L = mStride;
+	src += 1 - int(mHalf);
+
+	#if defined(__AVX__)
+		__m256 acc8 = _mm256_setzero_ps();
+		const __m256 f8 = _mm256_set1_ps(f);
+		unsigned i = 0;
+		for(; i+8<=L; i+=8){
+			__m256 c = _mm256_add_ps(_mm256_loadu_ps(k+i), _mm256_mul_ps(f8, _mm256_loadu_ps(d+i)));
+			acc8 = _mm256_add_ps(acc8, _mm256_mul_ps(c, _mm256_loadu_ps(src+i)));
+		}
+		__m128 acc = _mm_add_ps(_mm256_castps256_ps128(acc8), _mm256_extractf128_ps(acc8, 1));
+		if(i < L){
+			__m128 c = _mm_add_ps(_mm_loadu_ps(k+i), _mm_mul_ps(_mm256_castps256_ps128(f8), _mm_loadu_ps(d+i)));
+			acc = _mm_add_ps(acc, _mm_mul_ps(c, _mm_loadu_ps(src+i)));
+		}
+		float s[4]; _mm_storeu_ps(s, acc);
+		return (s[0] + s[1]) + (s[2] + s[3]);
+
+	#elif defined(GAM_SINC_SSE)
+		__m128 acc0 = _mm_setzero_ps(), acc1 = _mm_setzero_ps();
+		const __m128 f4 = _mm_set1_ps(f);
+		unsigned i = 0;
+		for(; i+8<=L; i+=8){
+			__m128 c0 = _mm_add_ps(_mm_loadu_ps(k+i  ), _mm_mul_ps(f4, _mm_loadu_ps(d+i  )));
+			__m128 c1 = _mm_add_ps(_mm_loadu_ps(k+i+4), _mm_mul_ps(f4, _mm_loadu_ps(d+i+4)));
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(c0, _mm_loadu_ps(src+i  )));
+			acc1 = _mm_add_ps(acc1, _mm_mul_ps(c1, _mm_loadu_ps(src+i+4)));
+		}
+		if(i < L){
+			__m128 c0 = _mm_add_ps(_mm_loadu_ps(k+i), _mm_mul_ps(f4, _mm_loadu_ps(d+i)));
+			acc0 = _mm_add_ps(acc0, _mm_mul_ps(c0, _mm_loadu_ps(src+i)));
+		}
+		float s[4]; _mm_storeu_ps(s, _mm_add_ps(acc0, acc1));
+		return (s[0] + s[1]) + (s[2] + s[3]);
+
+	#elif defined(GAM_SINC_NEON)
+		float32x4_t acc = vdupq_n_f32(0.f);
+		const float32x4_t f4 = vdupq_n_f32(f);
+		for(unsigned i=0; i<L; i+=4){
+			float32x4_t c = vmlaq_f32(vld1q_f32(k+i), f4, vld1q_f32(d+i));
+			acc = vmlaq_f32(acc, c, vld1q_f32(src+i));
+		}
+		float s[4]; vst1q_f32(s, acc);
+		return (s[0] + s[1]) + (s[2] + s[3]);
+
+	#else
+		float s[4] = {0,0,0,0};
+		for(unsigned i=0; i<L; i+=4){
+			for(unsigned j=0; j<4; ++j) s[j] += src[i+j] * (k[i+j] + f*d[i+j]);
+		}
+		return (s[0] + s[1]) + (s[2] + s[3]);
+	#endif
+}
+
+
+void resample(
+	float * dst, unsigned dstLen, const float * src, unsigned srcLen,
+	double ratio, unsigned zeros
+){
+	if(!dstLen) return;
+	if(!srcLen || ratio <= 0){
+		std::fill(dst, dst+dstLen, 0.f);
+		return;
+	}
+	if(ratio == 1){
+		unsigned n = std::min(dstLen, srcLen);
+		std::copy(src, src+n, dst);
+		std::fill(dst+n, dst+dstLen, 0.f);
+		return;
+	}
+
+	// Lower cutoff by the rate ratio when decimating
+	const SincBank bank(zeros, 256, 0.92f * float(ratio < 1 ? ratio : 1));
+	const unsigned H = bank.half();
+
+	// Pad input with zeros so kernels never read out of bounds
+	std::vector<float> buf(srcLen + 2*H + 1, 0.f);
+	std::copy(src, src+srcLen, buf.begin() + H);
+	const float * x = &buf[H];
+
+	const double inc = 1. / ratio;
+	for(unsigned j=0; j<dstLen; ++j){
+		double pos = j * inc;
+		long i = long(pos);
+		if(i >= long(srcLen)){
+			std::fill(dst+j, dst+dstLen, 0.f);
+			break;
+		}
+		dst[j] = bank(x + i, pos - i);
+	}
+}
+
+} // gam::
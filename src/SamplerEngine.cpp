@@ -0,0 +1,384 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cmath>
+#include "Gamma/CPU.h"
+#include "Gamma/Constants.h"
+#include "Gamma/SamplerEngine.h"
+#include "Gamma/scl.h"
+
+#if defined(GAM_CPU_X86) && (defined(__SSE__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_SAMPLER_AVX
+#endif
+
+namespace gam{
+
+namespace{
+
+	struct VoiceRun{
+		const float * src0, * src1;	// channels at run base
+		float pos, rate, gainL, gainR;
+		ipl::Type ipol;
+		bool stereo;
+	};
+
+	// Kernels add the first samples of a run that fill their vectors and
+	// return how many they did; the rest are done by the scalar loop. Runs
+	// only read inside the sample buffer.
+	typedef unsigned (*VoiceKernel)(const VoiceRun&, float *, float *, unsigned);
+
+	unsigned voiceNone(const VoiceRun&, float *, float *, unsigned){ return 0; }
+
+	template <int Ipol>
+	inline float readScalar(const float * s, int i, float f){
+		if(ipl::TRUNC == Ipol) return s[i];
+		if(ipl::LINEAR == Ipol) return s[i] + f*(s[i+1] - s[i]);
+		return ipl::cubic(f, s[i-1], s[i], s[i+1], s[i+2]);
+	}
+
+	#if defined(GAM_SAMPLER_AVX)
+	// Gathers and conversions use all-lane masks with zeroed sources, as the
+	// unmasked intrinsics pass GCC an undefined source it warns about
+	template <int Ipol>
+	GAM_TARGET_AVX512 inline __m512 readAVX512(const float * s, __m512i i, __m512 f){
+		const __m512 x = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, s, 4);
+		if(ipl::TRUNC == Ipol) return x;
+		const __m512 y = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, s+1, 4);
+		if(ipl::LINEAR == Ipol) return _mm512_fmadd_ps(f, _mm512_sub_ps(y, x), x);
+		const __m512 w = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, s-1, 4);
+		const __m512 z = _mm512_mask_i32gather_ps(_mm512_setzero_ps(), 0xFFFF, i, s+2, 4);
+		const __m512 c1 = _mm512_mul_ps(_mm512_sub_ps(y, w), _mm512_set1_ps(0.5f));
+		const __m512 c3 = _mm512_fmadd_ps(_mm512_sub_ps(x, y), _mm512_set1_ps(1.5f),
+			_mm512_mul_ps(_mm512_sub_ps(z, w), _mm512_set1_ps(0.5f)));
+		const __m512 c2 = _mm512_sub_ps(_mm512_add_ps(c1, _mm512_sub_ps(w, x)), c3);
+		return _mm512_fmadd_ps(_mm512_fmadd_ps(_mm512_fmadd_ps(c3, f, c2), f, c1), f, x);
+	}
+
+	template <int Ipol, bool Stereo>
+	GAM_TARGET_AVX512 unsigned voiceAVX512(const VoiceRun& v, float * outL, float * outR, unsigned n){
+		const __m512 ramp = _mm512_setr_ps(0,1,2,3,4,5,6,7,8,9,10,11,12,13,14,15);
+		const __m512 pos = _mm512_set1_ps(v.pos), rate = _mm512_set1_ps(v.rate);
+		const __m512 gl = _mm512_set1_ps(v.gainL), gr = _mm512_set1_ps(v.gainR);
+		unsigned j=0;
+		for(; j+16<=n; j+=16){
+			__m512 o = _mm512_fmadd_ps(_mm512_add_ps(_mm512_set1_ps(float(j)), ramp), rate, pos);
+			__m512i i = _mm512_maskz_cvttps_epi32(0xFFFF, o);
+			__m512 f = _mm512_sub_ps(o, _mm512_maskz_cvtepi32_ps(0xFFFF, i));
+			__m512 a = readAVX512<Ipol>(v.src0, i, f);
+			__m512 b = Stereo ? readAVX512<Ipol>(v.src1, i, f) : a;
+			_mm512_storeu_ps(outL+j, _mm512_fmadd_ps(a, gl, _mm512_loadu_ps(outL+j)));
+			_mm512_storeu_ps(outR+j, _mm512_fmadd_ps(b, gr, _mm512_loadu_ps(outR+j)));
+		}
+		return j;
+	}
+
+	GAM_TARGET_AVX512 unsigned voiceAVX512(const VoiceRun& v, float * outL, float * outR, unsigned n){
+		switch(v.ipol){
+		case ipl::TRUNC:	return v.stereo ? voiceAVX512<ipl::TRUNC, true>(v, outL, outR, n) : voiceAVX512<ipl::TRUNC, false>(v, outL, outR, n);
+		case ipl::CUBIC:	return v.stereo ? voiceAVX512<ipl::CUBIC, true>(v, outL, outR, n) : voiceAVX512<ipl::CUBIC, false>(v, outL, outR, n);
+		default:			return v.stereo ? voiceAVX512<ipl::LINEAR, true>(v, outL, outR, n) : voiceAVX512<ipl::LINEAR, false>(v, outL, outR, n);
+		}
+	}
+
+	template <int Ipol>
+	GAM_TARGET_AVX2 inline __m256 readAVX2(const float * s, __m256i i, __m256 f){
+		const __m256 x = _mm256_i32gather_ps(s, i, 4);
+		if(ipl::TRUNC == Ipol) return x;
+		const __m256 y = _mm256_i32gather_ps(s+1, i, 4);
+		if(ipl::LINEAR == Ipol) return _mm256_fmadd_ps(f, _mm256_sub_ps(y, x), x);
+		const __m256 w = _mm256_i32gather_ps(s-1, i, 4);
+		const __m256 z = _mm256_i32gather_ps(s+2, i, 4);
+		const __m256 c1 = _mm256_mul_ps(_mm256_sub_ps(y, w), _mm256_set1_ps(0.5f));
+		const __m256 c3 = _mm256_fmadd_ps(_mm256_sub_ps(x, y), _mm256_set1_ps(1.5f),
+			_mm256_mul_ps(_mm256_sub_ps(z, w), _mm256_set1_ps(0.5f)));
+		const __m256 c2 = _mm256_sub_ps(_mm256_add_ps(c1, _mm256_sub_ps(w, x)), c3);
+		return _mm256_fmadd_ps(_mm256_fmadd_ps(_mm256_fmadd_ps(c3, f, c2), f, c1), f, x);
+	}
+
+	template <int Ipol, bool Stereo>
+	GAM_TARGET_AVX2 unsigned voiceAVX2(const VoiceRun& v, float * outL, float * outR, unsigned n){
+		const __m256 ramp = _mm256_setr_ps(0,1,2,3,4,5,6,7);
+		const __m256 pos = _mm256_set1_ps(v.pos), rate = _mm256_set1_ps(v.rate);
+		const __m256 gl = _mm256_set1_ps(v.gainL), gr = _mm256_set1_ps(v.gainR);
+		unsigned j=0;
+		for(; j+8<=n; j+=8){
+			__m256 o = _mm256_fmadd_ps(_mm256_add_ps(_mm256_set1_ps(float(j)), ramp), rate, pos);
+			__m256i i = _mm256_cvttps_epi32(o);
+			__m256 f = _mm256_sub_ps(o, _mm256_cvtepi32_ps(i));
+			__m256 a = readAVX2<Ipol>(v.src0, i, f);
+			__m256 b = Stereo ? readAVX2<Ipol>(v.src1, i, f) : a;
+			_mm256_storeu_ps(outL+j, _mm256_fmadd_ps(a, gl, _mm256_loadu_ps(outL+j)));
+			_mm256_storeu_ps(outR+j, _mm256_fmadd_ps(b, gr, _mm256_loadu_ps(outR+j)));
+		}
+		return j;
+	}
+
+	GAM_TARGET_AVX2 unsigned voiceAVX2(const VoiceRun& v, float * outL, float * outR, unsigned n){
+		switch(v.ipol){
+		case ipl::TRUNC:	return v.stereo ? voiceAVX2<ipl::TRUNC, true>(v, outL, outR, n) : voiceAVX2<ipl::TRUNC, false>(v, outL, outR, n);
+		case ipl::CUBIC:	return v.stereo ? voiceAVX2<ipl::CUBIC, true>(v, outL, outR, n) : voiceAVX2<ipl::CUBIC, false>(v, outL, outR, n);
+		default:			return v.stereo ? voiceAVX2<ipl::LINEAR, true>(v, outL, outR, n) : voiceAVX2<ipl::LINEAR, false>(v, outL, outR, n);
+		}
+	}
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+
+	template <int Ipol>
+	void voiceScalar(const VoiceRun& v, float * outL, float * outR, unsigned j, unsigned n){
+		for(; j<n; ++j){
+			const float o = float(j) * v.rate + v.pos;
+			const int i = int(o);
+			const float f = o - float(i);
+			const float a = readScalar<Ipol>(v.src0, i, f);
+			const float b = v.stereo ? readScalar<Ipol>(v.src1, i, f) : a;
+			outL[j] += a * v.gainL;
+			outR[j] += b * v.gainR;
+		}
+	}
+
+	inline float at(const float * s, int i, int last){ return s[scl::clip(i, last, 0)]; }
+
+	// Read at any position, clamping neighbors to the ends of the buffer
+	float readClamped(const float * s, int frames, double pos, ipl::Type ipol){
+		const int i = int(std::floor(pos));
+		const float f = float(pos - i);
+		const int L = frames-1;
+		switch(ipol){
+		case ipl::TRUNC:	return at(s,i,L);
+		case ipl::CUBIC:	return ipl::cubic(f, at(s,i-1,L), at(s,i,L), at(s,i+1,L), at(s,i+2,L));
+		default:			return at(s,i,L) + f*(at(s,i+1,L) - at(s,i,L));
+		}
+	}
+
+	// Margin of positions kept from the ends of buffers by vector runs, for
+	// rounding of positions relative to run bases
+	const double cMargin = 1./64;
+}
+
+
+SamplerEngine::SamplerEngine(unsigned maxVoices, unsigned maxSamples)
+:	mSamples(0), mIpol(ipl::LINEAR), mCount(0)
+{
+	resize(maxVoices, maxSamples);
+}
+
+SamplerEngine& SamplerEngine::resize(unsigned maxVoices, unsigned maxSamples){
+	std::vector<Array<float> >(maxSamples).swap(mData);
+	mFrames.assign(maxSamples, 0); mChans.assign(maxSamples, 1);
+	mFPS.assign(maxSamples, 0.); mSrcInc.assign(maxSamples, 0.f);
+	mSamples = 0;
+
+	mPos.resize(maxVoices); mBegin.resize(maxVoices); mEnd.resize(maxVoices);
+	mRate.resize(maxVoices); mGainL.resize(maxVoices); mGainR.resize(maxVoices);
+	mSmp.resize(maxVoices); mOffset.resize(maxVoices); mLoop.resize(maxVoices);
+	mId.resize(maxVoices); mSlot.resize(maxVoices); mFree.resize(maxVoices);
+	reset();
+	return *this;
+}
+
+SamplerEngine& SamplerEngine::ipolType(ipl::Type v){
+	switch(v){
+	case ipl::TRUNC: case ipl::ROUND:	mIpol = ipl::TRUNC; break;
+	case ipl::CUBIC:					mIpol = ipl::CUBIC; break;
+	default:							mIpol = ipl::LINEAR;
+	}
+	return *this;
+}
+
+unsigned SamplerEngine::sample(Array<float>& src, double frmRate, int chans){
+	if(mSamples == maxSamples() || chans < 1) return maxSamples();
+	const unsigned i = mSamples++;
+	mData[i].source(src);
+	mFrames[i] = src.size() / chans;
+	mChans[i] = chans;
+	mFPS[i] = frmRate;
+	mSrcInc[i] = float(frmRate * ups());
+	return i;
+}
+
+unsigned SamplerEngine::play(unsigned smp, float rate, float amp, float pan, bool loop, unsigned offset){
+	if(mCount == maxVoices() || smp >= mSamples || !mFrames[smp]) return maxVoices();
+	const unsigned k = mCount++;
+	const unsigned id = mFree[maxVoices() - mCount];
+	mId[k] = id;
+	mSlot[id] = k;
+
+	mSmp[k] = smp;
+	mBegin[k] = 0.;
+	mEnd[k] = mFrames[smp];
+	mPos[k] = rate < 0.f ? mEnd[k] - 1. : 0.;
+	mRate[k] = rate;
+	mLoop[k] = loop;
+	mOffset[k] = offset;
+	gain(id, amp, pan);
+	return id;
+}
+
+void SamplerEngine::stop(unsigned id){
+	if(active(id)) remove(mSlot[id]);
+}
+
+void SamplerEngine::reset(){
+	mCount = 0;
+	const unsigned N = maxVoices();
+	for(unsigned i=0; i<N; ++i){
+		mSlot[i] = NONE;
+		mFree[i] = N-1-i; // lowest identifiers are taken first
+	}
+}
+
+SamplerEngine& SamplerEngine::rate(unsigned id, float v){
+	if(active(id)) mRate[mSlot[id]] = v;
+	return *this;
+}
+
+SamplerEngine& SamplerEngine::gain(unsigned id, float amp, float pan){
+	if(active(id)){
+		const unsigned k = mSlot[id];
+		const float theta = (scl::clip(pan, 1.f, -1.f) + 1.f) * float(M_PI_4);
+		mGainL[k] = amp * std::cos(theta);
+		mGainR[k] = amp * std::sin(theta);
+	}
+	return *this;
+}
+
+SamplerEngine& SamplerEngine::loop(unsigned id, bool v){
+	if(active(id)) mLoop[mSlot[id]] = v;
+	return *this;
+}
+
+SamplerEngine& SamplerEngine::interval(unsigned id, double begin, double end){
+	if(active(id)){
+		const unsigned k = mSlot[id];
+		const double frames = mFrames[mSmp[k]];
+		mBegin[k] = std::max(begin, 0.);
+		mEnd[k] = std::min(end, frames);
+	}
+	return *this;
+}
+
+SamplerEngine& SamplerEngine::pos(unsigned id, double v){
+	if(active(id)) mPos[mSlot[id]] = v;
+	return *this;
+}
+
+void SamplerEngine::onDomainChange(double /*r*/){
+	for(unsigned i=0; i<mSamples; ++i) mSrcInc[i] = float(mFPS[i] * ups());
+}
+
+void SamplerEngine::remove(unsigned k){
+	const unsigned id = mId[k];
+	mSlot[id] = NONE;
+	mFree[maxVoices() - mCount] = id;
+	const unsigned j = --mCount;
+	if(k != j){
+		mPos[k] = mPos[j]; mBegin[k] = mBegin[j]; mEnd[k] = mEnd[j];
+		mRate[k] = mRate[j]; mGainL[k] = mGainL[j]; mGainR[k] = mGainR[j];
+		mSmp[k] = mSmp[j]; mOffset[k] = mOffset[j]; mLoop[k] = mLoop[j];
+		mId[k] = mId[j];
+		mSlot[mId[k]] = k;
+	}
+}
+
+// Render n samples of a voice whose positions stay in its interval. The
+// middle of the run that reads only inside the buffer goes to the kernels.
+void SamplerEngine::renderRun(unsigned k, double pos, double inc, float * outL, float * outR, unsigned n){
+	static SIMDDispatch<VoiceKernel> kernel(voiceNone,
+		0, GAM_AVX_KERNEL(voiceAVX2), GAM_AVX_KERNEL(voiceAVX512));
+
+	const unsigned smp = mSmp[k];
+	const int frames = int(mFrames[smp]);
+	const float * src0 = mData[smp].elems();
+	const float * src1 = mChans[smp] > 1 ? src0 + frames : src0;
+	const ipl::Type ipol = mIpol;
+	const float gl = mGainL[k], gr = mGainR[k];
+
+	// Positions read inside the buffer are in [lo, hi)
+	const double lo = (ipl::CUBIC == ipol ? 1 : 0) + cMargin;
+	const double hi = frames - (ipl::CUBIC == ipol ? 2 : ipl::LINEAR == ipol ? 1 : 0) - cMargin;
+	double j0 = 0, j1 = 0;
+	if(inc > 0.){
+		j0 = pos >= lo ? 0 : std::ceil((lo - pos) / inc);
+		j1 = pos >= hi ? 0 : std::ceil((hi - pos) / inc);
+	}
+	else if(inc < 0.){
+		j0 = pos < hi ? 0 : std::floor((pos - hi) / -inc) + 1;
+		j1 = pos < lo ? 0 : std::floor((pos - lo) / -inc) + 1;
+	}
+	else if(pos >= lo && pos < hi){
+		j1 = n;
+	}
+	const unsigned b = unsigned(std::min(j0, double(n)));
+	const unsigned e = std::max(b, unsigned(std::min(j1, double(n))));
+
+	for(unsigned j=0; j<b; ++j){
+		const double p = pos + j*inc;
+		const float a = readClamped(src0, frames, p, ipol);
+		outL[j] += a * gl;
+		outR[j] += (src1 != src0 ? readClamped(src1, frames, p, ipol) : a) * gr;
+	}
+
+	if(e > b){
+		const double p0 = pos + b*inc, p1 = pos + (e-1)*inc;
+		const int base = int(std::min(p0, p1));
+		const VoiceRun v = {
+			src0 + base, src1 + base,
+			float(p0 - base), float(inc), gl, gr, ipol, mChans[smp] > 1
+		};
+		float * L = outL + b, * R = outR + b;
+		const unsigned m = e - b;
+		const unsigned j = kernel()(v, L, R, m);
+		switch(ipol){
+		case ipl::TRUNC:	voiceScalar<ipl::TRUNC>(v, L, R, j, m); break;
+		case ipl::CUBIC:	voiceScalar<ipl::CUBIC>(v, L, R, j, m); break;
+		default:			voiceScalar<ipl::LINEAR>(v, L, R, j, m);
+		}
+	}
+
+	for(unsigned j=e; j<n; ++j){
+		const double p = pos + j*inc;
+		const float a = readClamped(src0, frames, p, ipol);
+		outL[j] += a * gl;
+		outR[j] += (src1 != src0 ? readClamped(src1, frames, p, ipol) : a) * gr;
+	}
+}
+
+void SamplerEngine::render(float * outL, float * outR, unsigned n){
+	for(unsigned k=0; k<mCount;){
+		if(mOffset[k] >= n){ mOffset[k] -= n; ++k; continue; }
+		unsigned j = mOffset[k];
+		mOffset[k] = 0;
+
+		const double inc = double(mRate[k]) * mSrcInc[mSmp[k]];
+		const double begin = mBegin[k], end = mEnd[k], len = end - begin;
+		double p = mPos[k];
+		bool alive = true;
+
+		// Split block into runs where voice stays in its interval
+		while(alive && j < n){
+			if(p >= end || p < begin){
+				if(!mLoop[k] || len <= 0.){ alive = false; break; }
+				p = begin + std::fmod(p - begin, len);
+				if(p < begin) p += len;
+			}
+			double m = n - j;
+			if(inc > 0.)		m = std::min(m, std::ceil((end - p) / inc));
+			else if(inc < 0.)	m = std::min(m, std::floor((p - begin) / -inc) + 1);
+			const unsigned mi = std::max(unsigned(m), 1u);
+			renderRun(k, p, inc, outL + j, outR + j, mi);
+			p += mi * inc;
+			j += mi;
+		}
+
+		if(alive && !mLoop[k] && (p >= end || p < begin)) alive = false;
+		if(!alive){ remove(k); continue; }
+		mPos[k] = p;
+		++k;
+	}
+}
+
+} // gam::
@@ -1,7 +1,18 @@
+#include <algorithm> // push_heap, pop_heap, sort
+#include <cstdlib> // free
 #include <cstring> // memset
+#include <thread> // yield
+#include <typeinfo>
+#if defined(__GNUC__)
+	#include <cxxabi.h>
+	#define GAM_DEMANGLE
+#endif
+#include "Gamma/Denormal.h"
+#include "Gamma/RTCheck.h"
 #include "Gamma/Scheduler.h"
 #include "Gamma/SoundFile.h"
 #include "Gamma/Timer.h"
+#include "Gamma/Trace.h"
 
 /*
 The audio thread reads through the event list and calls back into objects to
@@ -83,27 +94,49 @@ s.set(synth, &MySynth::freq, 330);
 namespace gam{
 
 ProcessNode::ProcessNode(double delay)
-:	mStatus(ACTIVE), mDelay(delay), mDeletable(false)
+:	mStatus(ACTIVE), mDelay(delay), mFrameOffset(0), mOrderIndex(0), mNumBuses(0), mIO(0),
+	mDeletable(false), mPool(0), mIdleObj(0), mIdleTest(0), mFreeOnIdle(true), mPriority(0),
+	mBlockGroup(0)
 {}
 
 ProcessNode::~ProcessNode(){
 	removeFromParent();
-	
-	// delete children
-	if(child){
-	
-		// remove all child's siblings first...
-		while(child->sibling){
-			if(child->sibling->deletable()) delete child->sibling;
-			else child->sibling->removeFromParent();
-		}
-		
-		// then remove the child
-		if(child->deletable()) delete child;
+
+	// Delete children, detaching those not owned by the scheduler
+	while(child){
+		if(child->deletable()) destroyTree(child);
 		else child->removeFromParent();
 	}
 }
 
+void ProcessNode::destroy(ProcessNode * v){
+	if(v->mPool){
+		MemoryPool * p = v->mPool;
+		v->~ProcessNode();
+		p->deallocate(v);
+	}
+	else{
+		delete v;
+	}
+}
+
+void ProcessNode::destroyTree(ProcessNode * root){
+	// Destroy leaves first so no destructor recurses into descendents. Each
+	// node is descended into once per child, so this takes linear time.
+	ProcessNode * n = root;
+	for(;;){
+		while(n->child){
+			if(n->child->deletable())	n = n->child;
+			else						n->child->removeFromParent();
+		}
+		if(n == root) break;
+		ProcessNode * p = n->parent;
+		destroy(n);
+		n = p;
+	}
+	destroy(root);
+}
+
 ProcessNode& ProcessNode::free(){
 	mStatus = DONE;
 	return *this;
@@ -113,46 +146,370 @@ ProcessNode& ProcessNode::active(bool v){ mStatus = v ? ACTIVE : INACTIVE; retur
 
 ProcessNode& ProcessNode::reset(){ onReset(); return *this; }
 
-ProcessNode * ProcessNode::update(const ProcessNode * top, SchedulerAudioIOData& io){
+ProcessNode& ProcessNode::useBus(unsigned id){
+	if(mNumBuses < MAX_BUSES) mBuses[mNumBuses++] = id;
+	return *this;
+}
+
+ProcessNode& ProcessNode::sleep(){
+	if(ACTIVE==mStatus) mStatus = SLEEPING;
+	return *this;
+}
+
+ProcessNode& ProcessNode::wake(){
+	if(SLEEPING==mStatus) mStatus = ACTIVE;
+	return *this;
+}
+
+bool ProcessNode::update(SchedulerAudioIOData& io, bool profile){
+	if(mFrameOffset){	// started part way into block by Scheduler
+		unsigned frame = mFrameOffset;
+		mFrameOffset = 0;
+		if(frame >= io.framesPerBuffer) return false;
+		return process(io, frame, profile);
+	}
+
 	double dt = io.framesPerBuffer / io.framesPerSecond;
 	unsigned frame = 0;
 	if(mDelay >= dt){
 		mDelay -= dt;
-		return nextBreadth(top);
+		return false;
 	}
 	else if(mDelay > 0){	// 0 < delay <= delta
 		frame = mDelay * io.framesPerSecond;
 		mDelay=0;
-		if(frame >= io.framesPerBuffer) return nextBreadth(top);
+		if(frame >= io.framesPerBuffer) return false;
 	}
-	return process(top, io, frame);
+	return process(io, frame, profile);
 }
 
-ProcessNode * ProcessNode::process(const ProcessNode * top, SchedulerAudioIOData& io, int frameStart){
+bool ProcessNode::process(SchedulerAudioIOData& io, int frameStart, bool profile){
 	if(active()){
 		io.startFrame = frameStart;
-		onProcessNode(io);
-		if(active()) return next(top);
+		mIO = &io;
+		const bool trace = tracingNodes();
+		if(io.skipping && onSkip(io)){}
+		else if(profile || trace){
+			const nsec_t beg = timeNow();
+			onProcessNode(io);
+			const nsec_t end = timeNow();
+			if(profile) mProfile.add(end > beg ? end - beg : 0);
+			if(trace) traceSpan("node", beg, end, this);
+		}
+		else{
+			onProcessNode(io);
+		}
+		mIO = 0;
+		if(mIdleTest && active() && mIdleTest(mIdleObj)){
+			if(mFreeOnIdle) free();
+			else sleep();
+		}
+		return active();
 	}
-	return nextBreadth(top);
+	return false;
 }
 
 void ProcessNode::print(){ printf("%p: %g sec, stat=%d\n", this, mDelay, mStatus); }
 
 
+BlockGroup::BlockGroup(unsigned factor, unsigned phase)
+:	mFactor(factor ? factor : 1), mPhase(phase < mFactor ? phase : mFactor-1),
+	mCount(0), mPlaying(false)
+{
+	mBlockGroup = this;
+}
+
+void BlockGroup::onReset(){
+	mCount = 0;
+	mPlaying = false;
+	std::fill(mIn.begin(), mIn.end(), 0.f);
+}
+
+// Group block g collects input in scheduler blocks [gN, gN+N), is processed
+// in block gN+N+phase and is played over blocks [gN+N+phase, gN+2N+phase).
+bool BlockGroup::begin(const SchedulerAudioIOData& io){
+	const unsigned F = io.framesPerBuffer;
+	const unsigned B = F * mFactor;
+	const unsigned ci = io.buffersIn ? io.channelsIn : 0;
+	const unsigned co = io.buffersOut ? io.channelsOut : 0;
+	if(mGroupIO.framesPerBuffer != B || mGroupIO.channelsIn != ci || mGroupIO.channelsOut != co){
+		mIn.assign(2*B*ci, 0.f);
+		mOut.assign(B*co, 0.f);
+		mGroupIO.framesPerBuffer = B;
+		mGroupIO.channelsIn = ci;
+		mGroupIO.channelsOut = co;
+		mGroupIO.buffersOut = co ? &mOut[0] : 0;
+		mGroupIO.userData<void>(0);
+		mCount = 0;
+		mPlaying = false;
+	}
+	mGroupIO.framesPerSecond = io.framesPerSecond;
+	mGroupIO.skipping = io.skipping;
+
+	const unsigned k = mCount % mFactor;
+	const unsigned fill = (mCount / mFactor) & 1;
+	for(unsigned c=0; c<ci; ++c){
+		std::memcpy(&mIn[(fill*ci + c)*B + k*F], io.buffersIn + c*F, F*sizeof(float));
+	}
+
+	if(k != mPhase || mCount < mFactor) return false;
+	mGroupIO.buffersIn = ci ? &mIn[(fill^1)*ci*B] : 0;
+	mGroupIO.startFrame = 0;
+	std::fill(mOut.begin(), mOut.end(), 0.f);
+	mPlaying = true;
+	return true;
+}
+
+void BlockGroup::end(SchedulerAudioIOData& io){
+	if(mPlaying){
+		const unsigned F = io.framesPerBuffer;
+		const unsigned B = mGroupIO.framesPerBuffer;
+		const unsigned j = unsigned((mCount + mFactor - mPhase) % mFactor);
+		for(unsigned c=0; c<mGroupIO.channelsOut; ++c){
+			float * dst = io.buffersOut + c*F;
+			const float * src = &mOut[c*B + j*F];
+			for(unsigned i=0; i<F; ++i) dst[i] += src[i];
+		}
+	}
+	++mCount;
+}
+
+void BlockGroup::skip(SchedulerAudioIOData& io){
+	const unsigned F = io.framesPerBuffer;
+	const unsigned B = mGroupIO.framesPerBuffer;
+	const unsigned ci = mGroupIO.channelsIn;
+	if(B == F*mFactor && ci == (io.buffersIn ? io.channelsIn : 0)){
+		const unsigned k = mCount % mFactor;
+		const unsigned fill = (mCount / mFactor) & 1;
+		for(unsigned c=0; c<ci; ++c){
+			std::fill_n(&mIn[(fill*ci + c)*B + k*F], F, 0.f);
+		}
+		// A group block due now is not processed, so it plays silence
+		if(k == mPhase) std::fill(mOut.begin(), mOut.end(), 0.f);
+		end(io);
+	}
+	// else the format changed or no group block was begun, so begin()
+	// restarts the count
+}
+
+
+void ProcessProfile::reset(){
+	calls = total = max = 0;
+	for(unsigned i=0; i<NUM_BINS; ++i) bins[i] = 0;
+}
+
+double ProcessProfile::percentile(double frac) const {
+	if(!calls) return 0;
+	uint64_t target = uint64_t(frac * calls + 0.5);
+	uint64_t sum = 0;
+	for(unsigned i=0; i<NUM_BINS-1; ++i){
+		sum += bins[i];
+		if(sum >= target){
+			uint64_t edge = binStart(i+1);
+			return double(edge < max ? edge : max);
+		}
+	}
+	return double(max);
+}
+
+
+uint64_t ProfileSnapshot::total() const {
+	uint64_t r = 0;
+	for(unsigned i=0; i<mEntries.size(); ++i) r += mEntries[i].profile.total;
+	return r;
+}
+
+ProfileSnapshot& ProfileSnapshot::sort(){
+	struct ByTotal{
+		bool operator()(const Entry& a, const Entry& b) const {
+			return a.profile.total > b.profile.total;
+		}
+	};
+	std::stable_sort(mEntries.begin(), mEntries.end(), ByTotal());
+	return *this;
+}
+
+void ProfileSnapshot::print(unsigned topN) const {
+	std::vector<const Entry *> top(mEntries.size());
+	for(unsigned i=0; i<top.size(); ++i) top[i] = &mEntries[i];
+	struct ByTotal{
+		bool operator()(const Entry * a, const Entry * b) const {
+			return a->profile.total > b->profile.total;
+		}
+	};
+	if(topN > top.size()) topN = top.size();
+	std::partial_sort(top.begin(), top.begin()+topN, top.end(), ByTotal());
+
+	double sum = double(total());
+	printf("Profile of %u nodes%s, %g ms total\n",
+		unsigned(mEntries.size()), mTruncated ? " (truncated)" : "", sum*1e-6);
+	printf("%8s %6s %10s %10s %10s %10s  %s\n",
+		"ms", "%", "calls", "mean us", "p99 us", "max us", "node");
+	for(unsigned i=0; i<topN; ++i){
+		const Entry& e = *top[i];
+		const ProcessProfile& p = e.profile;
+		const char * name = e.type;
+		#ifdef GAM_DEMANGLE
+		int status;
+		char * dm = abi::__cxa_demangle(e.type, 0, 0, &status);
+		if(0 == status) name = dm;
+		#endif
+		printf("%8.3f %6.2f %10llu %10.2f %10.2f %10.2f  %s %p\n",
+			p.total*1e-6, sum > 0 ? p.total*100./sum : 0., (unsigned long long)p.calls,
+			p.mean()*1e-3, p.percentile(0.99)*1e-3, p.max*1e-3,
+			name, (const void *)e.node
+		);
+		#ifdef GAM_DEMANGLE
+		std::free(dm);
+		#endif
+	}
+}
+
+
+
+
+void GraphSnapshot::print() const {
+	static const char * statuses[] = {"inactive", "active", "done", "sleeping"};
+	printf("Graph %llu at frame %llu, %u nodes%s\n",
+		(unsigned long long)mVersion, (unsigned long long)mFrame,
+		mSize, mTruncated ? " (truncated)" : "");
+	for(unsigned i=0; i<mSize; ++i){
+		const Entry& e = mEntries[i];
+		const char * name = e.type;
+		#ifdef GAM_DEMANGLE
+		int status;
+		char * dm = abi::__cxa_demangle(e.type, 0, 0, &status);
+		if(0 == status) name = dm;
+		#endif
+		printf("%*s%s %p%s%s\n", int(2*e.depth), "", name, (const void *)e.node,
+			ACTIVE == e.status ? "" : " ",
+			ACTIVE == e.status ? "" : statuses[e.status & 3]
+		);
+		#ifdef GAM_DEMANGLE
+		std::free(dm);
+		#endif
+	}
+}
+
+
+GraphReader::GraphReader(Scheduler& s)
+:	mScheduler(s), mSlot(-1), mSnapshot(NULL)
+{
+	// Announce epoch before loading the snapshot, so the LPT keeps every
+	// snapshot retired after it
+	for(int i=0; i<GAM_SCHEDULER_GRAPH_READERS; ++i){
+		uint64_t none = 0;
+		if(s.mGraphReaders[i].compare_exchange_strong(none, s.mGraphEpoch.load())){
+			mSlot = i;
+			mSnapshot = s.mGraph.load();
+			return;
+		}
+	}
+}
+
+GraphReader::~GraphReader(){
+	if(mSlot >= 0) mScheduler.mGraphReaders[mSlot].store(0, std::memory_order_release);
+}
+
+
 
 Scheduler::Scheduler()
-:	mPeriod(1./10), mTime(0), mRunning(false)
+:	mAddCommands(GAM_SCHEDULER_QUEUE_SIZE), mFreeList(GAM_SCHEDULER_QUEUE_SIZE),
+	mFuncPool(sizeof(ControlFunc), GAM_SCHEDULER_QUEUE_SIZE),
+	mAddFuncs(GAM_SCHEDULER_QUEUE_SIZE), mNumPending(0),
+	mMessages(GAM_SCHEDULER_QUEUE_SIZE), mMessageCount(0),
+	mPeriod(1./10), mTime(0), mFrame(0), mRunning(false), mMaxNodes(0), mOrderChanged(true), mOrderFull(false),
+	mBusFrames(0), mBusPoolChannels(0),
+	mGeneration(0), mJobNext(0), mJobsDone(0), mWorkersRunning(false),
+	mBudget(0), mBlockStart(0), mBudgetNSec(0),
+	mBlocks(0), mLate(0), mShedBlocks(0), mShedNodes(0), mLoad(0), mShedding(false),
+	mProfiling(false), mProfileState(PROFILE_IDLE), mProfileCount(0), mProfileTruncated(false),
+	mGraphFree(GRAPH_SNAPSHOTS), mGraphRetired(GRAPH_SNAPSHOTS), mGraph(NULL), mGraphEpoch(1),
+	mGraphPublishing(false), mGraphChanged(true), mGraphVersion(0),
+	mStateState(STATE_IDLE), mStatesSaved(0), mStateFailures(0),
+	mViewSource(0), mViewCreate(0), mViewMap(0), mViewDestroy(0)
 {
 	mDeletable = false;
+	for(unsigned i=0; i<GAM_SCHEDULER_GRAPH_READERS; ++i) mGraphReaders[i] = 0;
+	mEvents.reserve(GAM_SCHEDULER_QUEUE_SIZE);
+	mTimedMessages.reserve(GAM_SCHEDULER_QUEUE_SIZE);
+	maxNodes(GAM_SCHEDULER_QUEUE_SIZE);
 }
 
 Scheduler::~Scheduler(){
+	stopWorkers();
+	for(unsigned i=0; i<mJobs.size(); ++i){
+		if(mJobs[i].view) mViewDestroy(mJobs[i].view);
+	}
+
 	stop();
+
+	// Nodes must be destroyed before the pools holding their memory
+	Command * c;
+	while((c = mAddCommands.front())){ destroy(c->other); mAddCommands.pop(); }
+	for(unsigned i=0; i<mPendingCommands.size(); ++i) destroy(mPendingCommands[i].other);
+	for(unsigned i=0; i<mEvents.size(); ++i) destroy(mEvents[i].command.other);
+	ControlFunc * f;
+	while(mAddFuncs.pop(f)) destroy(f);
+	for(unsigned i=0; i<mPendingFuncs.size(); ++i) destroy(mPendingFuncs[i]);
+	while(mFuncWheel.size()){
+		f = mFuncWheel.advance();
+		while(f){ ControlFunc * n = f->mNext; destroy(f); f = n; }
+	}
+	reclaim();
+	while(child){
+		if(child->deletable()) destroyTree(child);
+		else child->removeFromParent();
+	}
+
+	for(Pools::iterator it = mPools.begin(); it != mPools.end(); ++it){
+		delete it->second;
+	}
+	for(unsigned i=0; i<mGraphSnapshots.size(); ++i) delete mGraphSnapshots[i];
 }
 
 bool Scheduler::empty() const {
-	return (0==child) && mFreeList.empty() && mAddCommands.empty();
+	return (0==child) && mFreeList.empty() && mAddCommands.empty()
+		&& 0==mNumPending.load(std::memory_order_acquire) && mEvents.empty()
+		&& mAddFuncs.empty() && 0==mFuncWheel.size()
+		&& mMessages.empty() && mTimedMessages.empty();
+}
+
+Scheduler& Scheduler::queueSize(unsigned n){
+	mAddCommands.resize(n);
+	mFreeList.resize(n);
+	mEvents.reserve(n);
+	return *this;
+}
+
+unsigned Scheduler::addBus(unsigned channels){
+	mBusChannels.push_back(channels);
+	mBusPtrs.push_back(0);
+	mBusRanges.reserve(mBusChannels.size());
+	mBusSorted.reserve(mBusChannels.size());
+	mBusBuffers.reserve(mBusChannels.size());
+	mBusClears.reserve(mBusChannels.size());
+	mIO.mBuses = &mBusPtrs[0];
+	mIO.mNumBuses = mBusPtrs.size();
+	mOrderChanged = true;
+	return mBusChannels.size()-1;
+}
+
+Scheduler& Scheduler::maxNodes(unsigned n){
+	mMaxNodes = n;
+	mOrder.reserve(n+1);
+	mRoots.reserve(n);
+	mRootJoined.reserve(n);
+	mBusClearStart.reserve(n+2);
+	mOrderChanged = true;
+	return *this;
+}
+
+Scheduler& Scheduler::controlQueueSize(unsigned n){
+	mMessages.resize(n);
+	mTimedMessages.clear();
+	mTimedMessages.reserve(mMessages.capacity());
+	return *this;
 }
 
 bool Scheduler::check(){
@@ -160,48 +517,66 @@ bool Scheduler::check(){
 }
 
 int Scheduler::reclaim(){
+	TraceScope trace("Scheduler::reclaim");
 	int r=0;
-	while(!mFreeList.empty()){
-		FreeList::value_type& v = mFreeList.front();
-		
-		Funcs::iterator it = mFuncs.begin();
-		while(it != mFuncs.end()){
-			const void * funcObj = it->mFunc.obj();
-			if(funcObj == v){
-				fprintf(stderr, "gam::Scheduler: reclaiming ProcessNode with active functions assigned\n");
-				//printf("does %p == %p ?\n", (void *)v, funcObj);
-				//it->mObjDel = 1;
-				//while(it->mObjDel != 2){}
-			}
-			++it;
-		}
-		
+	ProcessNode * v;
+	while(mFreeList.pop(v)){
 		//printf("Scheduler: reclaiming %p\n", v);
-		delete v;
-		mFreeList.pop();
+		destroyTree(v);
 		++r;
 	}
+	if(mNumPending.load(std::memory_order_acquire)){
+		std::lock_guard<std::mutex> lock(mPendingMutex);
+		lpFlushPending();
+	}
+	lpReclaimGraph();
+	lpWriteState();
 	return r;
 }
 
 
 void Scheduler::update(){
+	RTScope rt;
+	TraceScope trace("Scheduler::update");
 
 	double blockPeriod = io().framesPerBuffer / io().framesPerSecond;
+	const nsec_t periodNSec = toNSec(blockPeriod);
+	mBlockStart = timeNow();
+	mBudgetNSec = nsec_t(mBudget.load(std::memory_order_relaxed) * periodNSec);
+	mShedding.store(false, std::memory_order_relaxed);
 
+	hpUpdateMessages();
 	hpUpdateTree();
 	hpUpdateControlFuncs(blockPeriod);
+	hpUpdateOrder();
 
-	// traverse tree
-	ProcessNode * v = this;
-	do{
-		v = v->update(this, io());
-	} while(v);
+	if(mWorkers.empty() || mJobs.empty()){
+		TraceScope trace("process");
+		hpRun(0, mOrder.size(), io(), profiling());
+	}
+	else if(active()){
+		TraceScope trace("process");
+		hpProcessParallel();
+	}
+
+	hpUpdateProfile();
+	hpUpdateGraph();
+	hpCaptureState();
 	
 	// put nodes marked as 'done' into free list
 	hpUpdateFreeList();
+
+	const nsec_t elapsed = timeNow() - mBlockStart;
+	mBlocks.fetch_add(1, std::memory_order_relaxed);
+	if(elapsed > periodNSec) mLate.fetch_add(1, std::memory_order_relaxed);
+	if(mShedding.load(std::memory_order_relaxed)){
+		mShedBlocks.fetch_add(1, std::memory_order_relaxed);
+		if(tracing()) traceInstant("shed", this);
+	}
+	mLoad.store(periodNSec ? float(double(elapsed)/periodNSec) : 0.f, std::memory_order_relaxed);
 	
 	mTime += blockPeriod;
+	mFrame += io().framesPerBuffer;
 }
 
 Scheduler& Scheduler::period(float v){
@@ -210,8 +585,149 @@ Scheduler& Scheduler::period(float v){
 }
 
 
+Scheduler& Scheduler::parallel(unsigned numThreads, unsigned numJobs){
+	stopWorkers();
+	for(unsigned i=0; i<mJobs.size(); ++i){
+		if(mJobs[i].view) mViewDestroy(mJobs[i].view);
+	}
+	mJobs.clear();
+	mViewSource = 0;
+
+	mOrderChanged = true; // buses are not shared when parallel
+
+	if(numThreads > 1){
+		if(0 == numJobs) numJobs = 4*numThreads;
+		Job j = { SchedulerAudioIOData(), 0, 0, 0 };
+		mJobs.assign(numJobs, j);
+
+		mWorkersRunning = true;
+		for(unsigned i=1; i<numThreads; ++i){
+			Thread * t = new Thread(cWorkerFunc, this);
+			t->realtime(); // workers share the audio thread's deadline
+			mWorkers.push_back(t);
+		}
+	}
+	return *this;
+}
+
+void Scheduler::stopWorkers(){
+	mWorkersRunning = false;
+	for(unsigned i=0; i<mWorkers.size(); ++i){
+		mWorkers[i]->join();
+		delete mWorkers[i];
+	}
+	mWorkers.clear();
+}
+
+void * Scheduler::cWorkerFunc(void * user){
+	Scheduler& s = *(Scheduler*)user;
+	DenormalGuard denormals;
+	traceThread("gam::Scheduler worker");
+	// Spin for the next block, then yield, then sleep once idle
+	const nsec_t idle = toNSec(GAM_SCHEDULER_WORKER_IDLE);
+	unsigned gen = s.mGeneration.load(std::memory_order_acquire);
+	unsigned spins = 0;
+	nsec_t last = timeNow();
+	while(s.mWorkersRunning.load(std::memory_order_relaxed)){
+		unsigned g = s.mGeneration.load(std::memory_order_acquire);
+		if(g != gen){
+			gen = g;
+			spins = 0;
+			{	RTScope rt;
+				s.hpRunJobs();
+			}
+			last = timeNow();
+		}
+		else if(++spins > 1000){
+			if(timeNow() - last > idle)	sleepSec(0.001);
+			else						std::this_thread::yield();
+		}
+	}
+	return NULL;
+}
+
+void Scheduler::hpResizeJobs(){
+	// This allocates, but only when the audio format or I/O data changes
+	unsigned busSize = io().channelsOut * io().framesPerBuffer;
+	mBuses.assign(busSize * mJobs.size(), 0.f);
+	mViewSource = io().userData();
+
+	for(unsigned i=0; i<mJobs.size(); ++i){
+		Job& j = mJobs[i];
+		if(j.view) mViewDestroy(j.view);
+		j.view = 0;
+		if(mViewCreate && mViewSource && busSize){
+			j.view = mViewCreate(mViewSource, &mBuses[i*busSize]);
+		}
+	}
+}
+
+void Scheduler::hpProcessParallel(){
+	const unsigned busSize = io().channelsOut * io().framesPerBuffer;
+	const unsigned numJobs = mJobs.size();
+
+	if(busSize * numJobs != mBuses.size() || io().userData() != mViewSource){
+		hpResizeJobs();
+	}
+
+	const unsigned numRoots = mRoots.size();
+
+	// Partition subtrees contiguously among jobs, never separating subtrees
+	// that share a bus
+	const bool joins = mRootJoined.size() == numRoots;
+	auto boundary = [&](unsigned r){
+		if(joins) while(r < numRoots && mRootJoined[r]) ++r;
+		return r;
+	};
+	for(unsigned i=0; i<numJobs; ++i){
+		Job& j = mJobs[i];
+		j.io = io();
+		j.io.buffersOut = busSize ? &mBuses[i*busSize] : 0;
+		if(j.view)	mViewMap(j.io, j.view, mViewSource);
+		else		j.io.userData<void>(0);
+		j.begin = boundary((i * numRoots) / numJobs);
+		j.end = boundary(((i+1) * numRoots) / numJobs);
+	}
+
+	// Release jobs to workers and help out until all are done
+	mJobsDone.store(0, std::memory_order_relaxed);
+	mJobNext.store(0, std::memory_order_release);
+	mGeneration.fetch_add(1, std::memory_order_release);
+	hpRunJobs();
+	while(mJobsDone.load(std::memory_order_acquire) < numJobs){}
+
+	// Mix buses in fixed order for determinism
+	float * out = io().buffersOut;
+	for(unsigned i=0; i<numJobs; ++i){
+		const float * bus = &mBuses[i*busSize];
+		for(unsigned k=0; k<busSize; ++k) out[k] += bus[k];
+	}
+}
+
+void Scheduler::hpRunJobs(){
+	const unsigned numJobs = mJobs.size();
+	unsigned i;
+	while((i = mJobNext.fetch_add(1, std::memory_order_acquire)) < numJobs){
+		runJob(mJobs[i]);
+		mJobsDone.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void Scheduler::runJob(Job& j){
+	if(j.io.buffersOut){
+		std::memset(j.io.buffersOut, 0, j.io.channelsOut*j.io.framesPerBuffer*sizeof(float));
+	}
+	bool prof = profiling();
+	for(unsigned i=j.begin; i<j.end; ++i){
+		const unsigned root = mRoots[i];
+		hpRun(root, mOrder[root].end, j.io, prof);
+	}
+}
+
+
 void * Scheduler::cLPThreadFunc(void * user){
 	Scheduler& s = *(Scheduler*)user;
+	traceThread("gam::Scheduler LPT");
 	while(s.mRunning){
 		//double t = gam::toSec(gam::timeNow());
 		s.reclaim();
@@ -223,13 +739,19 @@ void * Scheduler::cLPThreadFunc(void * user){
 }
 
 void Scheduler::start(){
+	if(mRunning.exchange(true)) return;
+	logStart();
 	mLPThread.joinOnDestroy(true);
-	mRunning = true;
 	mLPThread.start(cLPThreadFunc, this);
 }
 
 void Scheduler::stop(){
-	mRunning=false;
+	// Joining makes the thread's last reclaim() finish before the caller
+	// reclaims or destroys what it touches
+	if(mRunning.exchange(false)){
+		mLPThread.join();
+		mLPThread.joinOnDestroy(false);
+	}
 }
 
 
@@ -240,119 +762,1141 @@ void Scheduler::cmdAdd(ProcessNode * v){
 void Scheduler::pushCommand(Command::Type type, ProcessNode * object, ProcessNode * other){
 	other->mDeletable=true;
 	Command c = { type, object, other };
-	mAddCommands.push(c);
+
+	std::lock_guard<std::mutex> lock(mPendingMutex);
+	lpFlushPending();
+	if(!mPendingCommands.empty() || !mAddCommands.push(c)){
+		if(mPendingCommands.empty()){
+			warn("command queue full; consider increasing queueSize()", "gam::Scheduler::pushCommand()");
+		}
+		mPendingCommands.push_back(c);
+		mNumPending.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void Scheduler::lpFlushPending(){
+	unsigned numSent = 0;
+	while(numSent < mPendingCommands.size() && mAddCommands.push(mPendingCommands[numSent])){
+		++numSent;
+	}
+	mPendingCommands.erase(mPendingCommands.begin(), mPendingCommands.begin()+numSent);
+
+	unsigned numSentFuncs = 0;
+	while(numSentFuncs < mPendingFuncs.size() && mAddFuncs.push(mPendingFuncs[numSentFuncs])){
+		++numSentFuncs;
+	}
+	mPendingFuncs.erase(mPendingFuncs.begin(), mPendingFuncs.begin()+numSentFuncs);
+
+	// Items are queued before the count drops, so empty() never misses them
+	mNumPending.fetch_sub(numSent + numSentFuncs, std::memory_order_release);
+}
+
+void Scheduler::add(Func func){
+	add(std::move(func), 0, 0);
+}
+
+void Scheduler::add(Func func, double delay, double period){
+	void * mem = mFuncPool.allocate();
+	ControlFunc * f = mem ? new(mem) ControlFunc(std::move(func)) : new ControlFunc(std::move(func));
+	f->mPooled = mem != 0;
+	f->dt(delay).period(period);
+
+	std::lock_guard<std::mutex> lock(mPendingMutex);
+	lpFlushPending();
+	if(!mPendingFuncs.empty() || !mAddFuncs.push(f)){
+		mPendingFuncs.push_back(f);
+		mNumPending.fetch_add(1, std::memory_order_release);
+	}
+}
+
+void Scheduler::destroy(ControlFunc * f){
+	if(f->mPooled){
+		f->~ControlFunc();
+		mFuncPool.deallocate(f);
+	}
+	else{
+		delete f;
+	}
 }
 
 void Scheduler::hpUpdateControlFuncs(double dt){
-	Funcs::iterator it = mFuncs.begin();
-	while(it != mFuncs.end()){
-		Funcs::value_type& f = *it;
-		if(f.mDelay >= 0){
-			f.mDelay -= dt;
-			if(f.mDelay < 0){
-				f();
-				f.mDelay += f.mPeriod;
-			}
-			//printf("%g\n", f.mDelay);
-			++it;
+	TraceScope trace("hpUpdateControlFuncs");
+
+	const uint64_t now = mFuncWheel.tick();
+
+	// Schedule newly added functions
+	ControlFunc * f;
+	while(mAddFuncs.pop(f)){
+		if(f->mDelay < 0){ destroy(f); continue; }
+		f->mTime = mTime + f->mDelay;
+		f->mTick = now + uint64_t(f->mDelay / dt);
+		mFuncWheel.insert(f);
+	}
+
+	// Call expired functions and reschedule periodic ones
+	f = mFuncWheel.advance();
+	while(f){
+		ControlFunc * next = f->mNext;
+		(*f)();
+		if(f->mPeriod > 0){
+			f->mTime += f->mPeriod;
+			double ticks = (f->mTime - mTime) / dt;
+			f->mTick = now + (ticks >= 1. ? uint64_t(ticks) : 1);
+			mFuncWheel.insert(f);
 		}
 		else{
-			//printf("remove %p\n", &f);
-			mFuncs.erase(it++);
+			destroy(f);
 		}
+		f = next;
 	}
 }
 
+void Scheduler::hpUpdateMessages(){
+	TraceScope trace("hpUpdateMessages");
+
+	const uint64_t blockEnd = mFrame + io().framesPerBuffer;
+	const unsigned cap = mTimedMessages.capacity();
+	TimedMessage::Later later;
+
+	// Receive into the time-ordered heap while it has room. If it fills,
+	// due messages are applied to make room and receiving continues.
+	for(;;){
+		TimedMessage t;
+		while(mTimedMessages.size() < cap && mMessages.pop(t.message)){
+			const double f = t.message.time * io().framesPerSecond + 0.5;
+			t.frame = f > double(mFrame) ? uint64_t(f) : mFrame;
+			t.order = mMessageCount++;
+			mTimedMessages.push_back(t);
+			std::push_heap(mTimedMessages.begin(), mTimedMessages.end(), later);
+		}
+		const bool full = mTimedMessages.size() >= cap;
+
+		if(mTimedMessages.empty() || mTimedMessages.front().frame >= blockEnd) break;
+		do{
+			std::pop_heap(mTimedMessages.begin(), mTimedMessages.end(), later);
+			ControlMessage& m = mTimedMessages.back().message;
+			m.frame = unsigned(mTimedMessages.back().frame - mFrame);
+			if(m.handler) m.handler(m.target, m);
+			mTimedMessages.pop_back();
+		} while(!mTimedMessages.empty() && mTimedMessages.front().frame < blockEnd);
+
+		if(!full) break;
+	}
+}
+
+
+ControlFuncWheel::ControlFuncWheel()
+:	mTick(0), mSize(0)
+{
+	for(int i=0; i<SIZE0; ++i) mLevel0[i] = 0;
+	for(int j=0; j<LEVELS-1; ++j){
+		for(int i=0; i<SIZE; ++i) mLevels[j][i] = 0;
+	}
+}
+
+void ControlFuncWheel::insert(ControlFunc * f){
+	uint64_t t = f->mTick;
+	if(t < mTick) t = mTick;
+	uint64_t delta = t - mTick;
+
+	// Functions beyond the wheel's range are parked in the last slot
+	// reachable and reinserted when cascaded
+	if(delta >= (uint64_t(1)<<RANGE_BITS)){
+		t = mTick + (uint64_t(1)<<RANGE_BITS) - 1;
+		delta = t - mTick;
+	}
+
+	ControlFunc ** slot;
+	if(delta < SIZE0){
+		slot = &mLevel0[t & (SIZE0-1)];
+	}
+	else{
+		int level = 0;
+		while(delta >= (uint64_t(1) << (BITS0 + BITS*(level+1)))) ++level;
+		slot = &mLevels[level][(t >> (BITS0 + BITS*level)) & (SIZE-1)];
+	}
+	f->mNext = *slot;
+	*slot = f;
+	++mSize;
+}
+
+void ControlFuncWheel::cascade(int level){
+	// Redistribute one higher level slot into lower levels
+	ControlFunc ** slot = &mLevels[level][(mTick >> (BITS0 + BITS*level)) & (SIZE-1)];
+	ControlFunc * f = *slot;
+	*slot = 0;
+	while(f){
+		ControlFunc * next = f->mNext;
+		--mSize;
+		insert(f);
+		f = next;
+	}
+}
+
+ControlFunc * ControlFuncWheel::advance(){
+	// Cascade from coarsest level down when lower levels wrap
+	if(0 == (mTick & (SIZE0-1))){
+		int top = 0;
+		while(top < LEVELS-2 && 0 == ((mTick >> (BITS0 + BITS*top)) & (SIZE-1))) ++top;
+		for(int l=top; l>=0; --l) cascade(l);
+	}
+
+	ControlFunc ** slot = &mLevel0[mTick & (SIZE0-1)];
+	ControlFunc * expired = 0;
+	ControlFunc * parked = 0;
+	ControlFunc * f = *slot;
+	*slot = 0;
+	while(f){
+		ControlFunc * next = f->mNext;
+		if(f->mTick > mTick){	f->mNext = parked; parked = f; }
+		else{					f->mNext = expired; expired = f; }
+		--mSize;
+		f = next;
+	}
+	++mTick;
+
+	// Reinsert functions that were parked beyond the wheel's range
+	while(parked){
+		ControlFunc * next = parked->mNext;
+		insert(parked);
+		parked = next;
+	}
+	return expired;
+}
+
 void Scheduler::hpUpdateTree(){
+	TraceScope trace("hpUpdateTree");
 
-	/* TODO:
-	The tree should only contain processes that are active during the 
-	current block. ProcessNodes still in the future should be kept in a 
-	separate list and added to the tree when their time comes.
-	In order to avoid scanning the whole list of future events, the events
-	should be sorted according to their activation time. It is probably
-	better to use absolute times rather than delta times so we don't
-	have to perform any arithmetic to update timing status of the events.
-	
-	We should also avoid allocating memory for future ProcessNodes until when they
-	are actually used. This will also allow us to use memory pools.
+	/*
+	The tree only contains processes that are active during the current 
+	block. ProcessNodes still in the future are kept in a heap sorted by their
+	absolute activation frame and added to the tree when their time comes.
+	A node starting part way into the block begins processing at its exact
+	frame offset.
 	*/
 
-	while(!mAddCommands.empty()){
-		Command& c = mAddCommands.front();
-		
-		switch(c.type){
-		case Command::ADD_FIRST_CHILD:
-			c.object->addFirstChild(c.other);
-			break;
-		case Command::ADD_LAST_CHILD:
+	const double fps = io().framesPerSecond;
+	const uint64_t blockEnd = mFrame + io().framesPerBuffer;
+
+	// Move new commands into the time-ordered event queue
+	Command * pc;
+	while((pc = mAddCommands.front())){
+		Command& c = *pc;
+		double delay = c.other->mDelay;
+
+		if(delay > 0 && mEvents.size() < mEvents.capacity()){
+			c.other->mDelay = 0;
+			Event e = { mFrame + uint64_t(delay*fps + 0.5), c };
+			mEvents.push_back(e);
+			std::push_heap(mEvents.begin(), mEvents.end(), Event::Later());
+		}
+		else{
+			// Event queue full: node counts down its own delay in the tree
+			hpExecute(c, 0);
+		}
+		mAddCommands.pop();
+	}
+
+	// Execute all events falling within the current block
+	while(!mEvents.empty() && mEvents.front().frame < blockEnd){
+		std::pop_heap(mEvents.begin(), mEvents.end(), Event::Later());
+		Event& e = mEvents.back();
+		unsigned offset = e.frame > mFrame ? unsigned(e.frame - mFrame) : 0;
+		hpExecute(e.command, offset);
+		mEvents.pop_back();
+	}
+}
+
+void Scheduler::hpCancelEvents(){
+	// A delayed child of a node about to be removed is attached to it now,
+	// so it is freed along with it rather than added to freed memory later
+	unsigned n = 0;
+	for(unsigned i=0; i<mEvents.size(); ++i){
+		Command& c = mEvents[i].command;
+		bool removed = false;
+		for(const ProcessNode * p = c.object; p && p != this && !removed; p = p->parent){
+			removed = p->done();
+		}
+		if(removed){
 			c.object->addLastChild(c.other);
+			mOrderChanged = true;
+		}
+		else{
+			mEvents[n++] = mEvents[i];
+		}
+	}
+	if(n < mEvents.size()){
+		mEvents.resize(n);
+		std::make_heap(mEvents.begin(), mEvents.end(), Event::Later());
+	}
+}
+
+void Scheduler::hpCompileOrder(){
+	TraceScope trace("hpCompileOrder");
+
+	// Memory is reserved by maxNodes(). Once it is full, the partly added
+	// subtree of the root and those after it are left out.
+	mOrder.clear();
+	mRoots.clear();
+	unsigned rootBegin = 0;
+	bool full = false;
+	for(ProcessNode * v = this; v; v = v->next(this)){
+		if(v->parent == this) rootBegin = mOrder.size();
+		if(mOrder.size() > mMaxNodes){
+			full = true;
+			mOrder.resize(rootBegin);
+			if(!mRoots.empty() && mRoots.back() == rootBegin) mRoots.pop_back();
 			break;
-		default:;
 		}
-		mAddCommands.pop();
-	}	
+		v->mOrderIndex = mOrder.size();
+		if(v->parent == this) mRoots.push_back(v->mOrderIndex);
+		Step s = { v, 0 };
+		mOrder.push_back(s);
+	}
+	if(full && !mOrderFull){
+		warnRT("gam::Scheduler", "tree has more than %u nodes; increase maxNodes()", mMaxNodes);
+	}
+	mOrderFull = full;
+
+	// A node left out may hold a stale index
+	const unsigned n = mOrder.size();
+	mOrder[0].end = n;
+	for(unsigned i=1; i<n; ++i){
+		const ProcessNode * b = mOrder[i].node->nextBreadth(this);
+		const bool in = b && b->mOrderIndex < n && mOrder[b->mOrderIndex].node == b;
+		mOrder[i].end = in ? b->mOrderIndex : n;
+	}
+	mOrderChanged = false;
+	mGraphChanged = true;
+	if(!mBusChannels.empty()) hpAssignBuses();
+}
+
+void Scheduler::hpAssignBuses(){
+	const unsigned numBuses = mBusChannels.size();
+	const unsigned numSteps = mOrder.size();
+	const unsigned frames = io().framesPerBuffer;
+
+	// Live range of each bus is from its first to last step, inclusive
+	BusRange unused = { numSteps, 0, 0 };
+	mBusRanges.assign(numBuses, unused);
+	for(unsigned i=0; i<numSteps; ++i){
+		const ProcessNode& v = *mOrder[i].node;
+		for(unsigned k=0; k<v.mNumBuses; ++k){
+			const unsigned id = v.mBuses[k];
+			if(id >= numBuses) continue;
+			BusRange& r = mBusRanges[id];
+			if(i < r.first) r.first = i;
+			r.last = i;
+		}
+	}
+
+	mBusSorted.clear();
+	for(unsigned id=0; id<numBuses; ++id){
+		mBusPtrs[id] = 0;
+		if(mBusRanges[id].first < numSteps) mBusSorted.push_back(id);
+	}
+	struct ByFirst{
+		const BusRange * ranges;
+		bool operator()(unsigned a, unsigned b) const {
+			return ranges[a].first < ranges[b].first;
+		}
+	};
+	ByFirst byFirst = { &mBusRanges[0] };
+	std::sort(mBusSorted.begin(), mBusSorted.end(), byFirst);
+
+	// When parallel, subtrees of the root spanning the live range of a bus
+	// are joined into one job
+	const bool share = mWorkers.empty() || mJobs.empty();
+	mRootJoined.clear();
+	if(!share){
+		const unsigned numRoots = mRoots.size();
+		mRootJoined.assign(numRoots, 0);
+		for(unsigned j=0; j<mBusSorted.size(); ++j){
+			const BusRange& r = mBusRanges[mBusSorted[j]];
+			const unsigned first = std::upper_bound(mRoots.begin(), mRoots.end(), r.first) - mRoots.begin();
+			const unsigned last = std::upper_bound(mRoots.begin(), mRoots.end(), r.last) - mRoots.begin();
+			for(unsigned k=first; k<last; ++k) mRootJoined[k] = 1;
+		}
+	}
+
+	// Linear scan: a buffer is reused by a bus with the same number of
+	// channels starting after the buffer's last use
+	unsigned channels = 0;
+	mBusBuffers.clear();
+	for(unsigned j=0; j<mBusSorted.size(); ++j){
+		BusRange& r = mBusRanges[mBusSorted[j]];
+		const unsigned chans = mBusChannels[mBusSorted[j]];
+		unsigned b = 0;
+		if(share){
+			while(b < mBusBuffers.size()
+				&& !(mBusBuffers[b].channels == chans && mBusBuffers[b].last < r.first)
+			) ++b;
+		}
+		else{
+			b = mBusBuffers.size();
+		}
+		if(b == mBusBuffers.size()){
+			BusBuffer buf = { chans, 0, channels };
+			mBusBuffers.push_back(buf);
+			channels += chans;
+		}
+		mBusBuffers[b].last = r.last;
+		r.buffer = b;
+	}
+
+	// This allocates only when more channels are live than ever before or
+	// the block size grows
+	if(mBusPool.size() < channels * frames) mBusPool.resize(channels * frames);
+	mBusPoolChannels = channels;
+	mBusFrames = frames;
+
+	// Zero each bus before its first step
+	mBusClears.clear();
+	mBusClearStart.clear();
+	for(unsigned j=0; j<mBusSorted.size(); ++j){
+		const unsigned id = mBusSorted[j];
+		const BusRange& r = mBusRanges[id];
+		const BusBuffer& buf = mBusBuffers[r.buffer];
+		while(mBusClearStart.size() <= r.first) mBusClearStart.push_back(mBusClears.size());
+		BusClear c = { buf.offset * frames, buf.channels * frames };
+		mBusClears.push_back(c);
+		mBusPtrs[id] = &mBusPool[0] + c.offset;
+	}
+	while(mBusClearStart.size() <= numSteps) mBusClearStart.push_back(mBusClears.size());
+}
+
+void Scheduler::hpClearBuses(unsigned begin, unsigned end){
+	for(unsigned i=begin; i<end; ++i){
+		const BusClear& c = mBusClears[i];
+		std::memset(&mBusPool[c.offset], 0, c.size*sizeof(float));
+	}
+}
+
+bool Scheduler::hpShed(ProcessNode& n, SchedulerAudioIOData& io){
+	// Nodes waiting to start are left to count down their delay
+	if(n.mPriority >= 0 || !n.active() || n.mFrameOffset || n.mDelay > 0) return false;
+	const unsigned halvings = -1-n.mPriority < 62 ? -1-n.mPriority : 62;
+	if(timeNow() - mBlockStart <= (mBudgetNSec >> halvings)) return false;
+	io.startFrame = 0;
+	n.mIO = &io;
+	n.onShed(io);
+	n.mIO = 0;
+	mShedNodes.fetch_add(1, std::memory_order_relaxed);
+	mShedding.store(true, std::memory_order_relaxed);
+	return true;
+}
+
+void Scheduler::hpRunGroup(BlockGroup& g, unsigned i, SchedulerAudioIOData& io, bool profile){
+	const unsigned end = mOrder[i].end;
+	if(g.begin(io)) hpRun(i+1, end, g.mGroupIO, profile);
+	else if(!mBusClears.empty()){
+		const unsigned * clear = &mBusClearStart[0];
+		hpClearBuses(clear[i+1], clear[end]);
+	}
+	g.end(io);
+}
+
+void Scheduler::hpRun(unsigned begin, unsigned end, SchedulerAudioIOData& io, bool profile){
+	const Step * order = &mOrder[0];
+	const bool shed = mBudgetNSec > 0;
+	if(mBusClears.empty()){
+		for(unsigned i=begin; i<end;){
+			#if defined(__GNUC__)
+			if(i + 4 < end) __builtin_prefetch(order[i+4].node);
+			#endif
+			ProcessNode& n = *order[i].node;
+			if((shed && hpShed(n, io)) || !n.update(io, profile)){
+				if(n.mBlockGroup) n.mBlockGroup->skip(io);
+				i = order[i].end;
+			}
+			else if(n.mBlockGroup){
+				hpRunGroup(*n.mBlockGroup, i, io, profile);
+				i = order[i].end;
+			}
+			else ++i;
+		}
+		return;
+	}
+
+	// Buses starting within skipped subtrees are zeroed for later steps
+	const unsigned * clear = &mBusClearStart[0];
+	for(unsigned i=begin; i<end;){
+		#if defined(__GNUC__)
+		if(i + 4 < end) __builtin_prefetch(order[i+4].node);
+		#endif
+		hpClearBuses(clear[i], clear[i+1]);
+		ProcessNode& n = *order[i].node;
+		if(!(shed && hpShed(n, io)) && n.update(io, profile)){
+			if(n.mBlockGroup){
+				hpRunGroup(*n.mBlockGroup, i, io, profile);
+				i = order[i].end;
+			}
+			else ++i;
+		}
+		else{
+			if(n.mBlockGroup) n.mBlockGroup->skip(io);
+			hpClearBuses(clear[i+1], clear[order[i].end]);
+			i = order[i].end;
+		}
+	}
+}
+
+void Scheduler::hpExecute(Command& c, unsigned frameOffset){
+	mOrderChanged = true;
+	switch(c.type){
+	case Command::ADD_FIRST_CHILD:
+		c.object->addFirstChild(c.other);
+		break;
+	case Command::ADD_LAST_CHILD:
+		c.object->addLastChild(c.other);
+		break;
+	default:;
+	}
+	c.other->mFrameOffset = frameOffset;
+}
+
+void Scheduler::overload(SchedulerOverload& dst) const {
+	dst.blocks = mBlocks.load(std::memory_order_relaxed);
+	dst.late = mLate.load(std::memory_order_relaxed);
+	dst.shedBlocks = mShedBlocks.load(std::memory_order_relaxed);
+	dst.shedNodes = mShedNodes.load(std::memory_order_relaxed);
+	dst.load = mLoad.load(std::memory_order_relaxed);
+}
+
+void Scheduler::resetOverload(){
+	mBlocks = mLate = mShedBlocks = mShedNodes = 0;
+	mLoad = 0.f;
+}
+
+Scheduler& Scheduler::profile(bool v, unsigned maxNodes){
+	// Resize only while the HPT is not filling the buffer
+	if(mProfileState.load(std::memory_order_acquire) != PROFILE_REQUESTED){
+		mProfileEntries.resize(maxNodes);
+		mProfileState.store(PROFILE_IDLE, std::memory_order_relaxed);
+	}
+	mProfiling.store(v, std::memory_order_relaxed);
+	return *this;
+}
+
+bool Scheduler::profile(ProfileSnapshot& dst){
+	int state = mProfileState.load(std::memory_order_acquire);
+	if(PROFILE_REQUESTED == state) return false;
+	bool ready = PROFILE_READY == state;
+	if(ready){
+		dst.mEntries.assign(mProfileEntries.begin(), mProfileEntries.begin() + mProfileCount);
+		dst.mTruncated = mProfileTruncated;
+	}
+	if(mProfileEntries.size()){
+		mProfileState.store(PROFILE_REQUESTED, std::memory_order_release);
+	}
+	return ready;
+}
+
+void Scheduler::hpUpdateProfile(){
+	if(mProfileState.load(std::memory_order_acquire) != PROFILE_REQUESTED) return;
+	unsigned n = 0;
+	unsigned N = mProfileEntries.size();
+	hpUpdateOrder();
+	unsigned i = 1;
+	for(; i<mOrder.size() && n < N; ++i){
+		const ProcessNode * v = mOrder[i].node;
+		ProfileSnapshot::Entry& e = mProfileEntries[n++];
+		e.node = v;
+		e.type = typeid(*v).name();
+		e.profile = v->mProfile;
+	}
+	mProfileCount = n;
+	mProfileTruncated = i < mOrder.size();
+	mProfileState.store(PROFILE_READY, std::memory_order_release);
+}
+
+Scheduler& Scheduler::graphSnapshots(bool v, unsigned maxNodes){
+	mGraphPublishing.store(false, std::memory_order_relaxed);
+	mGraph.store(NULL);
+	for(unsigned i=0; i<mGraphSnapshots.size(); ++i) delete mGraphSnapshots[i];
+	mGraphSnapshots.clear();
+	mGraphReclaim.clear();
+	mGraphFree.resize(GRAPH_SNAPSHOTS);
+	mGraphRetired.resize(GRAPH_SNAPSHOTS);
+	if(v){
+		mGraphReclaim.reserve(GRAPH_SNAPSHOTS);
+		for(unsigned i=0; i<GRAPH_SNAPSHOTS; ++i){
+			mGraphSnapshots.push_back(new GraphSnapshot(maxNodes));
+			mGraphFree.push(mGraphSnapshots.back());
+		}
+	}
+	mGraphChanged = true;
+	mGraphPublishing.store(v, std::memory_order_relaxed);
+	return *this;
+}
+
+void Scheduler::hpUpdateGraph(){
+	if(!mGraphPublishing.load(std::memory_order_relaxed)) return;
+	hpUpdateOrder();
+
+	// Order is unchanged since the current snapshot, so compare statuses
+	const GraphSnapshot * cur = mGraph.load(std::memory_order_relaxed);
+	if(cur && !mGraphChanged){
+		for(unsigned i=0; i<cur->mSize; ++i){
+			const ProcessNode& v = *mOrder[i+1].node;
+			const GraphSnapshot::Entry& e = cur->mEntries[i];
+			if(e.status != v.mStatus || e.priority != v.mPriority){
+				mGraphChanged = true;
+				break;
+			}
+		}
+	}
+	if(!mGraphChanged) return;
+
+	// If readers hold all other snapshots, try again next block
+	GraphSnapshot * g;
+	if(!mGraphFree.pop(g)) return;
+
+	const unsigned N = mOrder.size() - 1;
+	const unsigned n = N < g->mEntries.size() ? N : unsigned(g->mEntries.size());
+	for(unsigned i=0; i<n; ++i){
+		const ProcessNode * v = mOrder[i+1].node;
+		GraphSnapshot::Entry& e = g->mEntries[i];
+		e.node = v;
+		e.type = typeid(*v).name();
+		e.parent = v->parent == this ? -1 : int(v->parent->mOrderIndex) - 1;
+		e.end = mOrder[i+1].end - 1 < n ? mOrder[i+1].end - 1 : n;
+		e.depth = e.parent < 0 ? 0 : g->mEntries[e.parent].depth + 1;
+		e.status = v->mStatus;
+		e.priority = v->mPriority;
+	}
+	g->mSize = n;
+	g->mTruncated = n < N;
+	g->mVersion = ++mGraphVersion;
+	g->mFrame = mFrame;
+
+	// Readers announcing an epoch after the increment cannot see the old
+	// snapshot, so it is retired at that epoch
+	GraphSnapshot * old = mGraph.exchange(g);
+	const uint64_t epoch = mGraphEpoch.fetch_add(1) + 1;
+	if(old){
+		old->mRetired = epoch;
+		mGraphRetired.push(old);
+	}
+	mGraphChanged = false;
+}
+
+void Scheduler::lpReclaimGraph(){
+	GraphSnapshot * g;
+	while(mGraphRetired.pop(g)) mGraphReclaim.push_back(g);
+	if(mGraphReclaim.empty()) return;
+
+	uint64_t oldest = ~uint64_t(0);
+	for(unsigned i=0; i<GAM_SCHEDULER_GRAPH_READERS; ++i){
+		const uint64_t e = mGraphReaders[i].load();
+		if(e && e < oldest) oldest = e;
+	}
+	for(unsigned i=0; i<mGraphReclaim.size();){
+		if(mGraphReclaim[i]->mRetired <= oldest){
+			mGraphFree.push(mGraphReclaim[i]);
+			mGraphReclaim[i] = mGraphReclaim.back();
+			mGraphReclaim.pop_back();
+		}
+		else{
+			++i;
+		}
+	}
+}
+
+Scheduler& Scheduler::stateCapacity(size_t bytes){
+	mStateBuf = StateWriter(bytes);
+	return *this;
+}
+
+bool Scheduler::saveState(const std::string& path){
+	if(0 == mStateBuf.capacity()) return false;
+	if(STATE_IDLE != mStateState.load(std::memory_order_acquire)) return false;
+	mStatePath = path;
+	mStateState.store(STATE_REQUESTED, std::memory_order_release);
+	return true;
+}
+
+/* State files start with a magic and node count followed by a record per
+node, in depth-first order:
+	uint32 nameLen, char name[nameLen], uint32 depth,
+	int32 status, int32 priority, uint64 stateLen, char state[stateLen]
+*/
+static const char stateMagic[8] = {'G','A','M','S','T','A','T','1'};
+
+void Scheduler::hpCaptureState(){
+	if(STATE_REQUESTED != mStateState.load(std::memory_order_acquire)) return;
+	TraceScope trace("hpCaptureState");
+	hpUpdateOrder();
+
+	StateWriter& w = mStateBuf;
+	w.clear();
+	w.bytes(stateMagic, sizeof stateMagic);
+	const size_t countPos = w.size();
+	uint32_t count = 0;
+	w(count);
+
+	for(unsigned i=1; i<mOrder.size() && w.ok();){
+		ProcessNode * v = mOrder[i].node;
+		const std::map<std::type_index, std::string>::const_iterator it
+			= mStateNames.find(std::type_index(typeid(*v)));
+		// Unregistered and done nodes are left out with their descendents
+		if(it == mStateNames.end() || v->done()){
+			i = mOrder[i].end;
+			continue;
+		}
+		uint32_t depth = 0;
+		for(const ProcessNode * p = v->parent; p != this; p = p->parent) ++depth;
+		const std::string& name = it->second;
+		w(uint32_t(name.size())).bytes(name.data(), name.size());
+		w(depth)(int32_t(v->mStatus))(int32_t(v->mPriority));
+		const size_t lenPos = w.size();
+		w(uint64_t(0));
+		v->onSaveState(w);
+		w.patch(lenPos, uint64_t(w.size() - lenPos - sizeof(uint64_t)));
+		++count;
+		++i;
+	}
+	w.patch(countPos, count);
+	mStateState.store(w.ok() ? STATE_CAPTURED : STATE_FAILED, std::memory_order_release);
+}
+
+void Scheduler::lpWriteState(){
+	switch(mStateState.load(std::memory_order_acquire)){
+	case STATE_CAPTURED:
+		if(mStateBuf.save(mStatePath))	mStatesSaved.fetch_add(1, std::memory_order_relaxed);
+		else							mStateFailures.fetch_add(1, std::memory_order_relaxed);
+		break;
+	case STATE_FAILED:
+		fprintf(stderr, "gam::Scheduler: state exceeds capacity of %u bytes; \"%s\" not written\n",
+			unsigned(mStateBuf.capacity()), mStatePath.c_str());
+		mStateFailures.fetch_add(1, std::memory_order_relaxed);
+		break;
+	default: return;
+	}
+	mStateState.store(STATE_IDLE, std::memory_order_release);
+}
+
+int Scheduler::loadState(const std::string& path){
+	StateReader r;
+	if(!r.map(path)) return -1;
+	const void * magic = r.view(sizeof stateMagic);
+	uint32_t count = 0;
+	r(count);
+	if(!r.ok() || std::memcmp(magic, stateMagic, sizeof stateMagic)){
+		fprintf(stderr, "gam::Scheduler: \"%s\" is not a state file\n", path.c_str());
+		return -1;
+	}
+
+	std::vector<ProcessNode *> stack, roots;
+	std::string name;
+	int restored = 0;
+	uint32_t skipDepth = ~uint32_t(0); // depth of unknown node being skipped
+
+	for(uint32_t k=0; k<count; ++k){
+		uint32_t nameLen = 0, depth = 0;
+		int32_t status = 0, priority = 0;
+		uint64_t len = 0;
+		r(nameLen);
+		const char * s = static_cast<const char *>(r.view(nameLen));
+		r(depth)(status)(priority)(len).check(len <= r.remaining());
+		const void * blob = r.view(size_t(len));
+		if(!r.ok()) break;
+
+		if(depth > skipDepth) continue;
+		skipDepth = ~uint32_t(0);
+		name.assign(s, nameLen);
+		const std::map<std::string, StateFactory>::const_iterator it = mStateFactories.find(name);
+		if(it == mStateFactories.end() || depth > stack.size()){
+			skipDepth = depth;
+			continue;
+		}
+
+		// A node whose state does not load is dropped along with its subtree
+		ProcessNode * v = it->second(*this);
+		StateReader sub(blob, size_t(len));
+		v->onLoadState(sub);
+		if(!sub.ok()){
+			fprintf(stderr, "gam::Scheduler: state of \"%s\" in \"%s\" is not valid\n", name.c_str(), path.c_str());
+			destroy(v);
+			skipDepth = depth;
+			continue;
+		}
+		v->mStatus = status;
+		v->mPriority = priority;
+		v->mDeletable = true;
+		stack.resize(depth);
+		if(depth)	stack[depth-1]->addLastChild(v);
+		else		roots.push_back(v);
+		stack.push_back(v);
+		++restored;
+	}
+
+	if(!r.ok()) fprintf(stderr, "gam::Scheduler: \"%s\" is truncated\n", path.c_str());
+
+	// Adding as first children, so reverse to keep saved order
+	for(unsigned i=roots.size(); i>0; --i) cmdAdd(roots[i-1]);
+	return restored;
 }
 
 void Scheduler::hpUpdateFreeList(){
-	
-	ProcessNode * p = this;
-	ProcessNode * v = p->next(this);
+	TraceScope trace("hpUpdateFreeList");
 
-	while(v){
-		if(v->done()){
+	hpUpdateOrder();
+	if(!mEvents.empty()){
+		for(unsigned i=1; i<mOrder.size(); ++i){
+			if(mOrder[i].node->done()){ hpCancelEvents(); break; }
+		}
+	}
+	for(unsigned i=1; i<mOrder.size();){
+		ProcessNode * v = mOrder[i].node;
+		// If the free list is full, done nodes stay (inactive) in the tree 
+		// until the next block. A node is only pushed after it is unlinked,
+		// since the LPT may destroy it as soon as it is in the free list.
+		if(v->done() && (!v->deletable() || !mFreeList.full())){
 			v->removeFromParent();
-			if(v->deletable()){	mFreeList.push(v); }
-			v=p; // backtrack one node in traversal
+			if(v->deletable()) mFreeList.push(v);
+			mOrderChanged = true;
+			i = mOrder[i].end; // subtree goes with node
 		}
 		else{
-			p=v;
-			v=v->next(this);
+			++i;
+		}
+	}
+}
+
+
+namespace{
+
+// Double-buffered hand-off between two stages of the NRT render pipeline.
+// A block with zero frames marks the end of the stream.
+struct NRTLink{
+	std::vector<char> buf[2];
+	unsigned frames[2];
+	std::atomic<unsigned> written, read;	// number of blocks passed through
+
+	NRTLink(unsigned bytes): written(0), read(0){
+		buf[0].resize(bytes); buf[1].resize(bytes);
+	}
+
+	// Get next block to fill, waiting until one is free
+	unsigned acquireWrite(){
+		unsigned w = written.load(std::memory_order_relaxed);
+		while(w - read.load(std::memory_order_acquire) >= 2) std::this_thread::yield();
+		return w&1;
+	}
+	void commitWrite(unsigned numFrames){
+		unsigned w = written.load(std::memory_order_relaxed);
+		frames[w&1] = numFrames;
+		written.store(w+1, std::memory_order_release);
+	}
+
+	// Get next block to consume, waiting until one is available
+	unsigned acquireRead(){
+		unsigned r = read.load(std::memory_order_relaxed);
+		while(r == written.load(std::memory_order_acquire)) std::this_thread::yield();
+		return r&1;
+	}
+	void commitRead(){
+		read.store(read.load(std::memory_order_relaxed)+1, std::memory_order_release);
+	}
+};
+
+template <class T>
+void nrtInterleave(T * dst, const float * src, unsigned frames, unsigned chans, float mul, bool clip){
+	for(unsigned j=0; j<chans; ++j){
+		const float * s = src + j*frames;
+		T * d = dst + j;
+		for(unsigned i=0; i<frames; ++i){
+			float v = s[i];
+			if(clip){
+				v = v > 1.f ? 1.f : (v < -1.f ? -1.f : v);
+			}
+			d[i*chans] = T(v * mul);
 		}
-	}		
+	}
 }
 
+struct NRTRender{
+	NRTLink raw;	// non-interleaved float blocks
+	NRTLink pcm;	// interleaved blocks in file sample type
+	SoundFile * sf;
+	unsigned chans;
+	unsigned bufFrames;	// frames in one scheduler block
+	unsigned sampleSize;
+	SoundFile::EncodingType encoding;
+
+	NRTRender(unsigned rawBytes, unsigned pcmBytes): raw(rawBytes), pcm(pcmBytes){}
+
+	static void * convert(void * user){
+		NRTRender& r = *(NRTRender*)user;
+		unsigned frames;
+		do{
+			unsigned ir = r.raw.acquireRead();
+			unsigned ip = r.pcm.acquireWrite();
+			frames = r.raw.frames[ir];
+			const float * src = (const float *)&r.raw.buf[ir][0];
+			char * dst = &r.pcm.buf[ip][0];
+
+			// Raw blocks are a sequence of non-interleaved scheduler buffers
+			for(unsigned k=0; k<frames; k+=r.bufFrames){
+				unsigned n = r.bufFrames;
+				const float * s = src + k*r.chans;
+				char * d = dst + k*r.chans*r.sampleSize;
+				switch(r.encoding){
+				case SoundFile::PCM_16:
+					nrtInterleave((short *)d, s, n, r.chans, 32767.f, true); break;
+				case SoundFile::PCM_24:
+				case SoundFile::PCM_32:
+					// 2^31-128 is the largest float below 2^31
+					nrtInterleave((int *)d, s, n, r.chans, 2147483520.f, true); break;
+				default:
+					nrtInterleave((float *)d, s, n, r.chans, 1.f, false);
+				}
+			}
+			r.raw.commitRead();
+			r.pcm.commitWrite(frames);
+		} while(frames);
+		return NULL;
+	}
+
+	static void * write(void * user){
+		NRTRender& r = *(NRTRender*)user;
+		unsigned frames;
+		do{
+			unsigned i = r.pcm.acquireRead();
+			frames = r.pcm.frames[i];
+			if(frames){
+				const char * src = &r.pcm.buf[i][0];
+				switch(r.sampleSize){
+				case sizeof(short):	r.sf->write((const short *)src, frames); break;
+				default:
+					if(r.encoding == SoundFile::PCM_24 || r.encoding == SoundFile::PCM_32)
+						r.sf->write((const int *)src, frames);
+					else
+						r.sf->write((const float *)src, frames);
+				}
+			}
+			r.pcm.commitRead();
+		} while(frames);
+		return NULL;
+	}
+};
+
+} // anonymous namespace
 
-void Scheduler::recordNRT(const char * soundFilePath, double durationSec){
-	int numFrames = io().framesPerBuffer;
-	int numChans  = io().channelsOut;
+double Scheduler::recordNRT(const char * soundFilePath, double durationSec, SoundFile::EncodingType encoding){
+	unsigned numFrames = io().framesPerBuffer;
+	unsigned numChans  = io().channelsOut;
 
 	SoundFile sf(soundFilePath);
-	sf	.encoding(SoundFile::FLOAT)
+	sf	.encoding(encoding)
 		.channels(numChans)
 		.frameRate(io().framesPerSecond)
 	;
-	if(sf.openWrite()){
-		double  t = 0;
-		double dt = io().secondsPerBuffer();
-		
-		// create buffer for interleaved samples
-		float * buf = new float[numFrames*numChans];
-		
-		while(t < durationSec){
-
-			//io.zeroOut();
+	if(!sf.openWrite()) return 0;
+
+	unsigned sampleSize;
+	switch(encoding){
+	case SoundFile::PCM_16: sampleSize = sizeof(short); break;
+	case SoundFile::PCM_24:
+	case SoundFile::PCM_32: sampleSize = sizeof(int); break;
+	default: sampleSize = sizeof(float); // libsndfile converts to other encodings
+	}
+
+	// Each pipeline block holds a whole number of scheduler buffers
+	unsigned bufsPerBlock = (GAM_SCHEDULER_NRT_BLOCK_FRAMES + numFrames - 1) / numFrames;
+	unsigned blockFrames = bufsPerBlock * numFrames;
+	NRTRender r(blockFrames*numChans*sizeof(float), blockFrames*numChans*sampleSize);
+	r.sf = &sf;
+	r.chans = numChans;
+	r.bufFrames = numFrames;
+	r.sampleSize = sampleSize;
+	r.encoding = encoding;
+
+	Thread convertThread(NRTRender::convert, &r);
+	Thread writeThread(NRTRender::write, &r);
+
+	DenormalGuard denormals;
+	// Rendering has no deadline, so nothing is shed
+	const float budget = overloadBudget();
+	overloadBudget(0.f);
+	nsec_t startTime = timeNow();
+	double  t = 0;
+	double dt = io().secondsPerBuffer();
+	unsigned frames;
+
+	do{
+		unsigned i = r.raw.acquireWrite();
+		float * dst = (float *)&r.raw.buf[i][0];
+		frames = 0;
+
+		while(frames < blockFrames && t < durationSec){
 			std::memset(io().buffersOut, 0, numChans*numFrames*sizeof(float));
 			update();
-			
-			// interleave channel data
-			for(int j=0; j<numChans; ++j){
-				float * dst = buf + j;
-				const float * src = io().buffersOut + j*numFrames;
-				for(int i=0; i<numFrames; ++i){
-					//printf("%d\n", i*numChans + j);
-					dst[i*numChans] = src[i];
-				}
-			}
-
-			// write to file
-			sf.write(buf, numFrames);
-			
+			std::memcpy(dst + frames*numChans, io().buffersOut, numChans*numFrames*sizeof(float));
+			frames += numFrames;
 			t += dt;
 		}
-		
-		delete[] buf;
+
+		// Without a running LPT, done processes would fill the free list
+		if(!mRunning) reclaim();
+
+		r.raw.commitWrite(frames);
+	} while(frames);
+
+	convertThread.join();
+	writeThread.join();
+	overloadBudget(budget);
+
+	double elapsed = toSec(timeNow() - startTime);
+	return elapsed > 0 ? t / elapsed : 0;
+}
+
+double Scheduler::skipNRT(double durationSec){
+	const unsigned numFrames = io().framesPerBuffer;
+	const unsigned numChans  = io().channelsOut;
+	const unsigned bufsPerBlock = (GAM_SCHEDULER_NRT_BLOCK_FRAMES + numFrames - 1) / numFrames;
+
+	DenormalGuard denormals;
+	const float budget = overloadBudget();
+	overloadBudget(0.f);
+	io().skipping = true;
+	double t = 0;
+	double dt = io().secondsPerBuffer();
+
+	for(unsigned b=1; t < durationSec; ++b){
+		if(io().buffersOut) std::memset(io().buffersOut, 0, numChans*numFrames*sizeof(float));
+		update();
+		t += dt;
+		// Without a running LPT, done processes would fill the free list
+		if(!mRunning && 0 == b % bufsPerBlock) reclaim();
+	}
+	if(!mRunning) reclaim();
+
+	io().skipping = false;
+	overloadBudget(budget);
+	return t;
+}
+
+
+namespace{
+
+template <class T>
+bool nrtCopy(SoundFile& dst, SoundFile& src){
+	std::vector<T> buf(GAM_SCHEDULER_NRT_BLOCK_FRAMES * src.channels());
+	int n;
+	while((n = src.read(&buf[0], GAM_SCHEDULER_NRT_BLOCK_FRAMES)) > 0){
+		if(dst.write(&buf[0], n) != n) return false;
+	}
+	return true;
+}
+
+struct NRTSegments{
+	const SchedulerAudioIOData * io;
+	Scheduler::NRTScore score;
+	void * user;
+	std::string path;
+	SoundFile::EncodingType encoding;
+	std::vector<unsigned> firstBlock;	// first block of each segment and end
+	std::vector<std::atomic<int> > status;	// 0 pending, 1 recorded, -1 failed
+	std::atomic<unsigned> next;
+
+	NRTSegments(unsigned n): firstBlock(n+1), status(n), next(0){
+		for(auto& s : status) s = 0;
+	}
+
+	unsigned size() const { return unsigned(status.size()); }
+
+	std::string segmentPath(unsigned k) const {
+		return path + ".seg" + std::to_string(k);
+	}
+
+	static void * record(void * user){
+		NRTSegments& r = *static_cast<NRTSegments *>(user);
+		unsigned k;
+		while((k = r.next.fetch_add(1)) < r.size()){
+			Scheduler s;
+			SchedulerAudioIOData& io = s.io();
+			io.framesPerSecond = r.io->framesPerSecond;
+			io.framesPerBuffer = r.io->framesPerBuffer;
+			io.channelsIn = r.io->channelsIn;
+			io.channelsOut = r.io->channelsOut;
+			r.score(s, r.user);
+			std::vector<float> in(io.framesPerBuffer * io.channelsIn, 0.f);
+			std::vector<float> out(io.framesPerBuffer * io.channelsOut, 0.f);
+			io.buffersIn = in.empty() ? NULL : &in[0];
+			io.buffersOut = out.empty() ? NULL : &out[0];
+
+			// Half a block short of the boundaries so time sums round the same
+			const double dt = io.secondsPerBuffer();
+			const unsigned beg = r.firstBlock[k], end = r.firstBlock[k+1];
+			if(beg) s.skipNRT((beg - 0.5)*dt);
+			bool ok = end == beg || s.recordNRT(r.segmentPath(k).c_str(), (end - beg - 0.5)*dt, r.encoding) > 0;
+			r.status[k].store(ok ? 1 : -1, std::memory_order_release);
+		}
+		return NULL;
+	}
+};
+
+} // anon::
+
+double Scheduler::recordNRT(const char * soundFilePath, double durationSec,
+	NRTScore score, void * user, unsigned threads, SoundFile::EncodingType encoding
+){
+	SoundFile sf(soundFilePath);
+	sf	.encoding(encoding)
+		.channels(io().channelsOut)
+		.frameRate(io().framesPerSecond)
+	;
+	if(!sf.openWrite()) return 0;
+
+	// Count blocks as the single-threaded recordNRT does
+	const double dt = io().secondsPerBuffer();
+	unsigned blocks = 0;
+	for(double t=0; t<durationSec; t+=dt) ++blocks;
+
+	if(threads < 1) threads = 1;
+	if(threads > blocks) threads = blocks ? blocks : 1;
+	NRTSegments r(threads);
+	r.io = &io();
+	r.score = score;
+	r.user = user;
+	r.path = soundFilePath;
+	r.encoding = encoding;
+	for(unsigned k=0; k<=threads; ++k) r.firstBlock[k] = uint64_t(blocks) * k / threads;
+
+	nsec_t startTime = timeNow();
+	std::vector<Thread> workers(threads);
+	for(auto& w : workers) w.start(NRTSegments::record, &r);
+
+	// Join segments in order, reading them in the file's sample type
+	bool ok = true;
+	for(unsigned k=0; k<threads && ok; ++k){
+		int status;
+		while(0 == (status = r.status[k].load(std::memory_order_acquire))) sleepSec(0.005);
+		if(r.firstBlock[k] == r.firstBlock[k+1]) continue;
+		SoundFile seg(r.segmentPath(k));
+		ok = status > 0 && seg.openRead();
+		if(ok){
+			switch(encoding){
+			case SoundFile::FLOAT:	ok = nrtCopy<float>(sf, seg); break;
+			case SoundFile::DOUBLE:	ok = nrtCopy<double>(sf, seg); break;
+			default:				ok = nrtCopy<int>(sf, seg);
+			}
+			seg.close();
+		}
+	}
+	if(!ok) r.next = threads; // stop starting segments
+	for(auto& w : workers) w.join();
+	for(unsigned k=0; k<threads; ++k) remove(r.segmentPath(k).c_str());
+	sf.close();
+
+	if(!ok){
+		fprintf(stderr, "gam::Scheduler: couldn't record \"%s\" in segments\n", soundFilePath);
+		return 0;
 	}
+	double elapsed = toSec(timeNow() - startTime);
+	return elapsed > 0 ? blocks * dt / elapsed : 0;
 }
 
 
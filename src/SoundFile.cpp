@@ -1,11 +1,27 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <algorithm>
 #include <cctype> // tolower
+#include <cstring> // memcmp
 #include <string>
 #include <stdio.h>
 #include "sndfile.h"
+#include "Gamma/arr.h"
+#include "Gamma/Config.h"
+#include "Gamma/PeakCache.h"
 #include "Gamma/SoundFile.h"
+#include "Gamma/Timer.h"
+
+#if GAM_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
 
 namespace gam{
 using std::string;
@@ -369,14 +385,503 @@ void SoundFile::print(){
 	int SoundFile::write<type>(const type * src, int numFrames){\
 		return mImpl->write(src, numFrames);\
 	}
-	DEF_SPECIAL(float)
 	DEF_SPECIAL(short)
 	DEF_SPECIAL(int)
 	DEF_SPECIAL(double)
 #undef DEF_SPECIAL
 
+template<>
+int SoundFile::read<float>(float * dst, int numFrames){
+	return mImpl->read(dst, numFrames);
+}
+
+template<>
+int SoundFile::write<float>(const float * src, int numFrames){
+	// libsndfile truncates floats to 16 bits, so convert here with dither
+	const int chans = channels();
+	const int N = 4096; // samples per block
+	if(!mDither || PCM_16 != encoding() || chans > N){
+		return mImpl->write(src, numFrames);
+	}
+
+	short buf[N];
+	const int blockFrames = N / chans;
+	int written = 0;
+	while(written < numFrames){
+		int n = std::min(blockFrames, numFrames - written);
+		const float * s = src + written*chans;
+		arr::toPCM16((int16_t *)buf, &s, n*chans, 1, &mDitherState);
+		int w = mImpl->write(buf, n);
+		if(w > 0) written += w;
+		if(w < n) break;
+	}
+	return written;
+}
+
+int SoundFile::readAllD(float * dst){
+	const EncodingType enc = encoding();
+	const bool i16 = PCM_16 == enc;
+	const bool i32 = PCM_24 == enc || PCM_32 == enc; // read as left-justified 32-bit
+	if(!(i16 || i32)) return readAllD<float>(dst);
+
+	const int chans = channels();
+	const int frms = frames();
+	const int N = 4096; // frames per block
+	std::vector<short> b16(i16 ? N*chans : 0);
+	std::vector<int> b32(i32 ? N*chans : 0);
+	std::vector<float *> d(chans);
+
+	seek(0, SEEK_SET);
+	int pos = 0;
+	while(pos < frms){
+		int n = std::min(N, frms - pos);
+		n = i16 ? read(&b16[0], n) : read(&b32[0], n);
+		if(n <= 0) break;
+		for(int c=0; c<chans; ++c) d[c] = dst + c*frms + pos;
+		if(i16)	arr::fromPCM16(&d[0], (const int16_t *)&b16[0], n, chans);
+		else	arr::fromPCM32(&d[0], (const int32_t *)&b32[0], n, chans);
+		pos += n;
+	}
+	return pos;
+}
+
 void SoundFile::seek(int pos, int mode){
 	mImpl->seek(pos, mode);
 }
 
+
+
+namespace{
+	uint32_t readLE32(const unsigned char * p){
+		return uint32_t(p[0]) | (uint32_t(p[1])<<8) | (uint32_t(p[2])<<16) | (uint32_t(p[3])<<24);
+	}
+	uint16_t readLE16(const unsigned char * p){
+		return uint16_t(p[0] | (p[1]<<8));
+	}
+	bool littleEndian(){
+		const uint16_t v = 1;
+		return 1 == *(const unsigned char *)&v;
+	}
+}
+
+bool SoundFileMap::open(const std::string& path, Access access){
+	close();
+
+	// Samples are exposed in native byte order, which must match the file's
+	if(!littleEndian()) return false;
+
+	#if GAM_WINDOWS
+		HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL,
+			OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+		if(INVALID_HANDLE_VALUE == file) return false;
+		LARGE_INTEGER size;
+		if(!GetFileSizeEx(file, &size)){ CloseHandle(file); return false; }
+		HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_WRITECOPY, 0, 0, NULL);
+		CloseHandle(file);
+		if(!mapping) return false;
+		void * mem = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+		if(!mem){ CloseHandle(mapping); return false; }
+		mHandle = mapping;
+		mMapping = mem;
+		mMapSize = size_t(size.QuadPart);
+	#else
+		int fd = ::open(path.c_str(), O_RDONLY);
+		if(fd < 0) return false;
+		struct stat st;
+		if(fstat(fd, &st) != 0 || st.st_size <= 0){ ::close(fd); return false; }
+		void * mem = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		::close(fd); // the mapping keeps the file open
+		if(MAP_FAILED == mem) return false;
+		mMapping = mem;
+		mMapSize = st.st_size;
+	#endif
+
+	// Parse RIFF chunks for format and sample data. This only reads the 
+	// header pages; sample pages are loaded on access.
+	const unsigned char * b = (const unsigned char *)mMapping;
+	const size_t N = mMapSize;
+	if(N < 12 || memcmp(b, "RIFF", 4) || memcmp(b+8, "WAVE", 4)){ close(); return false; }
+
+	int format = 0, bits = 0;
+	size_t pos = 12;
+	while(pos + 8 <= N){
+		const unsigned char * c = b + pos;
+		size_t size = readLE32(c+4);
+		if(!memcmp(c, "fmt ", 4) && size >= 16 && pos + 8 + size <= N){
+			format = readLE16(c+8);
+			mChans = readLE16(c+10);
+			mFrameRate = readLE32(c+12);
+			bits = readLE16(c+22);
+			if(0xFFFE == format && size >= 40) format = readLE16(c+32); // extensible
+		}
+		else if(!memcmp(c, "data", 4)){
+			if(pos + 8 + size > N) size = N - pos - 8; // truncated file
+			if(1 == format && 16 == bits)		mEncoding = SoundFile::PCM_16;
+			else if(3 == format && 32 == bits)	mEncoding = SoundFile::FLOAT;
+			else break;
+			if(mChans <= 0 || (pos + 8) % (bits/8)) break; // misaligned samples
+			mFrames = int(size / (mChans * (bits/8)));
+			mData = (void *)(c+8);
+			break;
+		}
+		pos += 8 + size + (size & 1); // chunks are padded to even sizes
+	}
+
+	if(!mData){ close(); return false; }
+	advise(access);
+	return true;
+}
+
+void SoundFileMap::close(){
+	if(mMapping){
+		#if GAM_WINDOWS
+			UnmapViewOfFile(mMapping);
+			CloseHandle((HANDLE)mHandle);
+		#else
+			munmap(mMapping, mMapSize);
+		#endif
+	}
+	mData = mMapping = mHandle = 0;
+	mMapSize = 0;
+	mChans = mFrames = 0;
+	mFrameRate = 0;
+}
+
+bool SoundFileMap::advise(Access access, int frame, int numFrames){
+	if(!opened()) return false;
+	#if GAM_WINDOWS
+		return false;
+	#else
+		int advice;
+		switch(access){
+		case SEQUENTIAL:	advice = MADV_SEQUENTIAL; break;
+		case RANDOM:		advice = MADV_RANDOM; break;
+		case WILLNEED:		advice = MADV_WILLNEED; break;
+		case DONTNEED:		advice = MADV_DONTNEED; break;
+		default:			advice = MADV_NORMAL;
+		}
+		if(numFrames < 0 || frame + numFrames > mFrames) numFrames = mFrames - frame;
+		if(frame < 0 || numFrames <= 0) return false;
+
+		// Range must start on a page boundary
+		const size_t frameSize = (SoundFile::FLOAT == mEncoding ? 4 : 2) * mChans;
+		const size_t page = sysconf(_SC_PAGESIZE);
+		size_t beg = ((char *)mData - (char *)mMapping) + frame * frameSize;
+		size_t end = beg + numFrames * frameSize;
+		beg -= beg % page;
+		return 0 == madvise((char *)mMapping + beg, end - beg, advice);
+	#endif
+}
+
+
+SoundFileStreamWriter::SoundFileStreamWriter(int bufferFrames, int chunkFrames)
+:	mPeaks(NULL), mRunning(false), mWritten(0), mBufferFrames(0), mChunkFrames(0)
+{
+	buffering(bufferFrames, chunkFrames);
+}
+
+SoundFileStreamWriter::~SoundFileStreamWriter(){
+	close();
+}
+
+SoundFileStreamWriter& SoundFileStreamWriter::buffering(int bufferFrames, int chunkFrames){
+	if(opened()){
+		fprintf(stderr, "SoundFileStreamWriter warning: buffering cannot be set with the file open\n");
+		return *this;
+	}
+	if(chunkFrames < 1) chunkFrames = 1;
+	// Round up to whole chunks, at least two
+	int chunks = (bufferFrames + chunkFrames - 1) / chunkFrames;
+	if(chunks < 2) chunks = 2;
+	mChunkFrames = chunkFrames;
+	mBufferFrames = chunks * chunkFrames;
+	return *this;
+}
+
+SoundFileStreamWriter& SoundFileStreamWriter::peaks(PeakCache * cache){
+	if(opened()){
+		fprintf(stderr, "SoundFileStreamWriter warning: peaks cannot be set with the file open\n");
+		return *this;
+	}
+	mPeaks = cache;
+	return *this;
+}
+
+bool SoundFileStreamWriter::open(const std::string& path){
+	mFile.path(path);
+	return open();
+}
+
+bool SoundFileStreamWriter::open(){
+	if(opened()) return true;
+	if(!mFile.openWrite()) return false;
+	mRing.resize(mFile.channels(), mBufferFrames);
+	if(mPeaks) mPeaks->channels(mFile.channels());
+	mWritten = 0;
+	mRunning = true;
+	mThread.start(cDiskFunc, this);
+	return true;
+}
+
+bool SoundFileStreamWriter::close(){
+	if(!opened()) return true;
+	mRunning = false;
+	mThread.join();
+	drain(true);
+	if(mPeaks) mPeaks->finish();
+	return mFile.close();
+}
+
+int SoundFileStreamWriter::write(const float * src, int numFrames){
+	return mRing.write(src, numFrames);
+}
+
+int SoundFileStreamWriter::writeNonInterleaved(const float * src, int numFrames){
+	const int chans = mRing.channels();
+	int n = numFrames;
+	for(int i=0; i<numFrames; ++i){
+		for(int c=0; c<chans; ++c) mRing.overwrite(src[c*numFrames + i], c);
+		if(!mRing.advance()) --n;
+	}
+	return n;
+}
+
+int SoundFileStreamWriter::drain(bool all){
+	const float * buf[2];
+	int frames[2];
+	mRing.peek(buf[0], frames[0], buf[1], frames[1]);
+
+	int total = 0;
+	for(int k=0; k<2; ++k){
+		int n = frames[k];
+		if(!all) n -= n % mChunkFrames;	// whole chunks only
+		if(n <= 0) break;
+		mFile.write(buf[k], n);
+		if(mPeaks) mPeaks->write(buf[k], n);
+		total += n;
+		if(n != frames[k]) break;
+	}
+	if(total){
+		mRing.release(total);
+		mWritten.store(framesWritten() + total, std::memory_order_relaxed);
+	}
+	return total;
+}
+
+void * SoundFileStreamWriter::cDiskFunc(void * user){
+	SoundFileStreamWriter& w = *static_cast<SoundFileStreamWriter *>(user);
+	// Poll at a fraction of the time it takes to fill a chunk
+	double period = w.mChunkFrames / (w.mFile.frameRate() > 0 ? w.mFile.frameRate() : 44100.) * 0.25;
+	while(w.mRunning.load(std::memory_order_acquire)){
+		if(0 == w.drain(false)) sleepSec(period);
+	}
+	return NULL;
+}
+
+
+namespace{
+	struct PeakSegment{
+		std::string path;
+		int begin, end;	// frames
+		PeakCache peaks;
+		bool ok;
+
+		static void * read(void * user){
+			PeakSegment& s = *static_cast<PeakSegment *>(user);
+			SoundFile sf(s.path);
+			s.ok = sf.openRead();
+			if(!s.ok) return NULL;
+			s.peaks.channels(sf.channels());
+			sf.seek(s.begin, SEEK_SET);
+			const int block = PeakCache::binFrames(1);
+			std::vector<float> buf(block * sf.channels());
+			for(int i=s.begin; i<s.end; i+=block){
+				int n = sf.read(&buf[0], std::min(block, s.end - i));
+				if(n <= 0){ s.ok = false; break; }
+				s.peaks.write(&buf[0], n);
+			}
+			sf.close();
+			return NULL;
+		}
+	};
+}
+
+bool readPeaks(PeakCache& dst, const std::string& path, int threads){
+	SoundFile sf(path);
+	if(!sf.openRead()) return false;
+	const int frames = sf.frames();
+	sf.close();
+
+	// Segments must fill whole bins of the last level to be joined
+	const int align = PeakCache::binFrames(PeakCache::LEVELS-1);
+	if(threads < 1) threads = 1;
+	int seg = (frames + threads-1) / threads;
+	seg = (seg + align-1) / align * align;
+	if(seg < align) seg = align;
+
+	std::vector<PeakSegment> segs;
+	for(int i=0; i<frames || segs.empty(); i+=seg){
+		segs.emplace_back();
+		segs.back().path = path;
+		segs.back().begin = i;
+		segs.back().end = std::min(i + seg, frames);
+	}
+	{	std::vector<Thread> workers(segs.size() - 1);
+		for(unsigned i=1; i<segs.size(); ++i) workers[i-1].start(PeakSegment::read, &segs[i]);
+		PeakSegment::read(&segs[0]);
+		for(auto& t : workers) t.join();
+	}
+
+	bool ok = segs[0].ok;
+	if(ok) dst = segs[0].peaks;
+	for(unsigned i=1; i<segs.size() && ok; ++i){
+		ok = segs[i].ok && dst.append(segs[i].peaks);
+	}
+	if(ok) dst.finish();
+	else fprintf(stderr, "gam::readPeaks: couldn't read \"%s\"\n", path.c_str());
+	return ok;
+}
+
+
+namespace{
+	// Chunks being processed are held in a window of slots; chunk k uses slot
+	// k % window, which is free once chunk k - window has been written.
+	struct ChunkPipeline{
+		std::string path;
+		const FileProcessor * proc;
+		FileProcessor::Handoff handoff;
+		int frames, chans, chunkFrames, overlap, numChunks, window;
+
+		struct Slot{
+			std::vector<float> buf;
+			int offset, count;			// frames of chunk (and tail) in buffer
+			std::atomic<int> ready;		// 1 + index of chunk in buffer
+			Slot(): offset(0), count(0), ready(0){}
+		};
+		std::vector<Slot> slots;
+		std::atomic<int> next;			// next chunk to claim
+		std::atomic<int> written;		// number of chunks written
+		std::atomic<bool> failed;
+
+		ChunkPipeline(): next(0), written(0), failed(false){}
+
+		static void wait(){ sleepSec(0.0005); }
+
+		bool process(SoundFile& sf, int k){
+			Slot& s = slots[k % window];
+			const int begin = k * chunkFrames;
+			const int len = std::min(chunkFrames, frames - begin);
+			const int warm = FileProcessor::WARM_UP == handoff ? std::min(overlap, begin) : 0;
+			const int tail = FileProcessor::OVERLAP_ADD == handoff ? overlap : 0;
+			const int count = warm + len + tail;
+			s.buf.resize(size_t(overlap + chunkFrames) * chans);
+
+			sf.seek(begin - warm, SEEK_SET);
+			for(int i=0; i<warm+len;){
+				int n = sf.read(&s.buf[i*chans], warm + len - i);
+				if(n <= 0) return false;
+				i += n;
+			}
+			std::fill(s.buf.begin() + (warm+len)*chans, s.buf.begin() + count*chans, 0.f);
+
+			FileProcessor * p = proc->clone();
+			p->onProcess(&s.buf[0], count, chans);
+			delete p;
+
+			s.offset = warm;
+			s.count = len + tail;
+			s.ready.store(k+1, std::memory_order_release);
+			return true;
+		}
+
+		static void * work(void * user){
+			ChunkPipeline& c = *static_cast<ChunkPipeline *>(user);
+			SoundFile sf(c.path);
+			if(!sf.openRead()){ c.failed = true; return NULL; }
+			int k;
+			while(!c.failed && (k = c.next.fetch_add(1)) < c.numChunks){
+				while(k - c.written.load(std::memory_order_acquire) >= c.window){
+					if(c.failed) return NULL;
+					wait();
+				}
+				if(!c.process(sf, k)) c.failed = true;
+			}
+			sf.close();
+			return NULL;
+		}
+	};
+}
+
+bool processFile(
+	const std::string& dst, const std::string& src, const FileProcessor& proc,
+	int overlap, FileProcessor::Handoff handoff, int threads, int chunkFrames
+){
+	SoundFile sf(src);
+	if(!sf.openRead()){
+		fprintf(stderr, "gam::processFile: couldn't read \"%s\"\n", src.c_str());
+		return false;
+	}
+	const int frames = sf.frames(), chans = sf.channels();
+	SoundFileStreamWriter writer;
+	writer.file().info(sf);
+	sf.close();
+	if(!writer.open(dst)){
+		fprintf(stderr, "gam::processFile: couldn't write \"%s\"\n", dst.c_str());
+		return false;
+	}
+
+	if(threads < 1) threads = 1;
+	ChunkPipeline c;
+	c.path = src;
+	c.proc = &proc;
+	c.handoff = handoff;
+	c.frames = frames;
+	c.chans = chans;
+	c.chunkFrames = std::max(chunkFrames, 1);
+	c.overlap = std::max(overlap, 0);
+	c.numChunks = (c.frames + c.chunkFrames-1) / c.chunkFrames;
+	c.window = 2*threads;
+	std::vector<ChunkPipeline::Slot> slots(c.window);
+	c.slots.swap(slots);
+
+	std::vector<Thread> workers(std::min(threads, c.numChunks));
+	for(auto& t : workers) t.start(ChunkPipeline::work, &c);
+
+	// Tails of chunks yet to be added to following chunks
+	std::vector<float> carry(size_t(c.overlap) * c.chans, 0.f);
+
+	for(int k=0; k<c.numChunks && !c.failed; ++k){
+		ChunkPipeline::Slot& s = c.slots[k % c.window];
+		while(s.ready.load(std::memory_order_acquire) != k+1){
+			if(c.failed) break;
+			ChunkPipeline::wait();
+		}
+		if(c.failed) break;
+
+		float * frames = &s.buf[s.offset * c.chans];
+		const int len = std::min(c.chunkFrames, c.frames - k*c.chunkFrames);
+		if(FileProcessor::OVERLAP_ADD == handoff){
+			const int N = int(carry.size());
+			const int M = std::min(len * c.chans, N);
+			for(int i=0; i<M; ++i) frames[i] += carry[i];
+			std::copy(carry.begin() + M, carry.end(), carry.begin());
+			std::fill(carry.end() - M, carry.end(), 0.f);
+			for(int i=0; i<N; ++i) carry[i] += frames[len * c.chans + i];
+		}
+
+		for(int i=0; i<len;){
+			int n = writer.write(frames + i*c.chans, std::min(len - i, writer.writable()));
+			if(0 == n) ChunkPipeline::wait();
+			i += n;
+		}
+		c.written.store(k+1, std::memory_order_release);
+	}
+
+	for(auto& t : workers) t.join();
+	bool ok = !c.failed;
+	ok = writer.close() && ok;
+	if(!ok) fprintf(stderr, "gam::processFile: couldn't process \"%s\"\n", src.c_str());
+	return ok;
+}
+
 } // gam::
@@ -0,0 +1,676 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cmath>
+#include "Gamma/Constants.h"
+#include "Gamma/Spatial.h"
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+#elif defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define GAM_LANES_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_LANES_NEON
+#endif
+
+namespace gam{
+
+/*
+Each group of 8 lanes keeps its coefficients and states in registers while it
+steps through the frames. The operations are done in the same order as the
+scalar loop so that they give the same results.
+*/
+void combLoopLanes(
+	float * X, unsigned L, const float * in, unsigned n,
+	const float * coefs, float * state
+){
+	const float * c0 = coefs, * c1 = c0 + L, * c2 = c1 + L;
+	float * x1 = state, * y1 = x1 + L;
+
+	#if defined(__AVX__)
+		for(unsigned k=0; k<L; k+=8){
+			const __m256 b0 = _mm256_loadu_ps(c0+k), b1 = _mm256_loadu_ps(c1+k), b2 = _mm256_loadu_ps(c2+k);
+			__m256 px = _mm256_loadu_ps(x1+k), py = _mm256_loadu_ps(y1+k);
+			for(unsigned i=0; i<n; ++i){
+				float * v = X + i*L + k;
+				const __m256 u = _mm256_loadu_ps(v);
+				py = _mm256_add_ps(
+					_mm256_mul_ps(_mm256_add_ps(u, _mm256_mul_ps(b1, px)), b0),
+					_mm256_mul_ps(py, b2)
+				);
+				px = u;
+				_mm256_storeu_ps(v, _mm256_add_ps(_mm256_set1_ps(in[i]), py));
+			}
+			_mm256_storeu_ps(x1+k, px); _mm256_storeu_ps(y1+k, py);
+		}
+
+	#elif defined(GAM_LANES_SSE)
+		for(unsigned k=0; k<L; k+=8){
+			const __m128 b0a = _mm_loadu_ps(c0+k), b0b = _mm_loadu_ps(c0+k+4);
+			const __m128 b1a = _mm_loadu_ps(c1+k), b1b = _mm_loadu_ps(c1+k+4);
+			const __m128 b2a = _mm_loadu_ps(c2+k), b2b = _mm_loadu_ps(c2+k+4);
+			__m128 pxa = _mm_loadu_ps(x1+k), pxb = _mm_loadu_ps(x1+k+4);
+			__m128 pya = _mm_loadu_ps(y1+k), pyb = _mm_loadu_ps(y1+k+4);
+			for(unsigned i=0; i<n; ++i){
+				float * v = X + i*L + k;
+				const __m128 ua = _mm_loadu_ps(v), ub = _mm_loadu_ps(v+4);
+				const __m128 xi = _mm_set1_ps(in[i]);
+				pya = _mm_add_ps(_mm_mul_ps(_mm_add_ps(ua, _mm_mul_ps(b1a, pxa)), b0a), _mm_mul_ps(pya, b2a));
+				pyb = _mm_add_ps(_mm_mul_ps(_mm_add_ps(ub, _mm_mul_ps(b1b, pxb)), b0b), _mm_mul_ps(pyb, b2b));
+				pxa = ua; pxb = ub;
+				_mm_storeu_ps(v  , _mm_add_ps(xi, pya));
+				_mm_storeu_ps(v+4, _mm_add_ps(xi, pyb));
+			}
+			_mm_storeu_ps(x1+k, pxa); _mm_storeu_ps(x1+k+4, pxb);
+			_mm_storeu_ps(y1+k, pya); _mm_storeu_ps(y1+k+4, pyb);
+		}
+
+	#elif defined(GAM_LANES_NEON)
+		for(unsigned k=0; k<L; k+=4){
+			const float32x4_t b0 = vld1q_f32(c0+k), b1 = vld1q_f32(c1+k), b2 = vld1q_f32(c2+k);
+			float32x4_t px = vld1q_f32(x1+k), py = vld1q_f32(y1+k);
+			for(unsigned i=0; i<n; ++i){
+				float * v = X + i*L + k;
+				const float32x4_t u = vld1q_f32(v);
+				py = vaddq_f32(vmulq_f32(vaddq_f32(u, vmulq_f32(b1, px)), b0), vmulq_f32(py, b2));
+				px = u;
+				vst1q_f32(v, vaddq_f32(vdupq_n_f32(in[i]), py));
+			}
+			vst1q_f32(x1+k, px); vst1q_f32(y1+k, py);
+		}
+
+	#else
+		combLoopLanes<float>(X, L, in, n, coefs, state);
+	#endif
+}
+
+
+namespace{
+	#if defined(__AVX__) || defined(GAM_LANES_SSE)
+	// Filter G groups of 4 rows from row k, with the groups interleaved to
+	// hide the latency of the recursions
+	template <unsigned G>
+	void rowsSSE(
+		float * Y, unsigned S, unsigned n, unsigned k,
+		const float * c0, const float * c1, const float * c2, float * x1, float * y1
+	){
+		__m128 b0[G], b1[G], b2[G], px[G], py[G];
+		for(unsigned g=0; g<G; ++g){
+			const unsigned j = k + 4*g;
+			b0[g] = _mm_loadu_ps(c0+j); b1[g] = _mm_loadu_ps(c1+j); b2[g] = _mm_loadu_ps(c2+j);
+			px[g] = _mm_loadu_ps(x1+j); py[g] = _mm_loadu_ps(y1+j);
+		}
+		unsigned i = 0;
+		for(; i+4<=n; i+=4){
+			for(unsigned g=0; g<G; ++g){
+				float * r = Y + (k + 4*g)*S + i;
+				__m128 f0 = _mm_loadu_ps(r), f1 = _mm_loadu_ps(r+S), f2 = _mm_loadu_ps(r+2*S), f3 = _mm_loadu_ps(r+3*S);
+				_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+				#define STEP(f)\
+					py[g] = _mm_add_ps(_mm_mul_ps(_mm_add_ps(f, _mm_mul_ps(b1[g], px[g])), b0[g]), _mm_mul_ps(py[g], b2[g]));\
+					px[g] = f; f = py[g];
+				STEP(f0) STEP(f1) STEP(f2) STEP(f3)
+				#undef STEP
+				_MM_TRANSPOSE4_PS(f0, f1, f2, f3);
+				_mm_storeu_ps(r, f0); _mm_storeu_ps(r+S, f1); _mm_storeu_ps(r+2*S, f2); _mm_storeu_ps(r+3*S, f3);
+			}
+		}
+		for(unsigned g=0; g<G; ++g){
+			const unsigned j = k + 4*g;
+			_mm_storeu_ps(x1+j, px[g]); _mm_storeu_ps(y1+j, py[g]);
+		}
+		// Remaining samples
+		for(unsigned j=k; j<k+4*G; ++j){
+			for(unsigned t=i; t<n; ++t){
+				float& v = Y[j*S + t];
+				const float y = (v + c1[j]*x1[j])*c0[j] + y1[j]*c2[j];
+				x1[j] = v;
+				y1[j] = v = y;
+			}
+		}
+	}
+	#endif
+}
+
+void loopFilterRows(
+	float * Y, unsigned S, unsigned R, unsigned n,
+	const float * coefs, float * state
+){
+	#if defined(__AVX__) || defined(GAM_LANES_SSE)
+		const float * c0 = coefs, * c1 = c0 + R, * c2 = c1 + R;
+		float * x1 = state, * y1 = x1 + R;
+		unsigned k = 0;
+		for(; k+8<=R; k+=8) rowsSSE<2>(Y, S, n, k, c0, c1, c2, x1, y1);
+		if(k < R) rowsSSE<1>(Y, S, n, k, c0, c1, c2, x1, y1);
+	#else
+		loopFilterRows<float>(Y, S, R, n, coefs, state);
+	#endif
+}
+
+EarlyReflections::EarlyReflections(unsigned numSrc, unsigned order)
+:	mNumSrc(0), mOrder(order), mGlide(BLOCK),
+	mSpeed(343.2), mNear(1), mEarDist(0.07),
+	mRoomDirty(true), mAllDirty(true), mSize(0), mPos(0)
+{
+	room(8, 6, 3);
+	listener(4, 3, 1.5);
+	wallGain(0.8);
+	numSources(numSrc);
+}
+
+EarlyReflections& EarlyReflections::numSources(unsigned n){
+	mNumSrc = n;
+	mX.resize(n, 0.f); mY.resize(n, 0.f); mZ.resize(n, 0.f);
+	mDirty.assign(n, 1);
+	mFresh.assign(n, 1);
+	mRemain.assign(n, 0);
+	mRoomDirty = true;
+	return *this;
+}
+
+EarlyReflections& EarlyReflections::room(float x, float y, float z){
+	mRoom[0] = x; mRoom[1] = y; mRoom[2] = z;
+	mRoomDirty = true;
+	return *this;
+}
+
+EarlyReflections& EarlyReflections::wallGain(float v){
+	for(int i=0; i<6; ++i) mWallGain[i] = v;
+	mRoomDirty = true;
+	return *this;
+}
+
+EarlyReflections& EarlyReflections::listener(float x, float y, float z){
+	mLis[0] = x; mLis[1] = y; mLis[2] = z;
+	mAllDirty = true;
+	return *this;
+}
+
+EarlyReflections& EarlyReflections::pos(unsigned i, float x, float y, float z){
+	mX[i] = x; mY[i] = y; mZ[i] = z;
+	mDirty[i] = 1;
+	return *this;
+}
+
+/*
+Along an axis of length L, image q of a source at x is at q L + x for even q
+and at (q+1) L - x for odd q. It has hit the high wall ceil(q/2) and the low
+wall floor(q/2) times for q > 0, and the other way around for q < 0.
+*/
+void EarlyReflections::images(){
+	const int N = mOrder;
+	mImgSign.clear(); mImgOff.clear(); mImgGain.clear();
+	std::vector<float> sign[3], off[3];
+
+	for(int qx=-N; qx<=N; ++qx){
+	for(int qy=-N; qy<=N; ++qy){
+	for(int qz=-N; qz<=N; ++qz){
+		const int q[3] = {qx, qy, qz};
+		const int order = scl::abs(qx) + scl::abs(qy) + scl::abs(qz);
+		if(!order || order > N) continue;
+		float g = 1.f;
+		for(int a=0; a<3; ++a){
+			const int m = scl::abs(q[a]);
+			const int hi = q[a] > 0 ? (m+1)/2 : m/2;
+			const int lo = m - hi;
+			for(int k=0; k<lo; ++k) g *= mWallGain[2*a];
+			for(int k=0; k<hi; ++k) g *= mWallGain[2*a+1];
+			const bool odd = q[a] & 1;
+			sign[a].push_back(odd ? -1.f : 1.f);
+			off[a].push_back((odd ? q[a]+1 : q[a]) * mRoom[a]);
+		}
+		mImgGain.push_back(g);
+	}}}
+
+	for(int a=0; a<3; ++a){
+		mImgSign.insert(mImgSign.end(), sign[a].begin(), sign[a].end());
+		mImgOff.insert(mImgOff.end(), off[a].begin(), off[a].end());
+	}
+}
+
+void EarlyReflections::updatePaths(unsigned s){
+	mDirty[s] = 0;
+	const unsigned P = paths();
+	const float toSamples = DomainObserver::spu() / mSpeed;
+	const float maxDelay = mSize - BLOCK - 2;
+	const float pos[3] = {mX[s], mY[s], mZ[s]};
+
+	for(unsigned e=0; e<2; ++e){
+		const float ear[3] = {mLis[0] + (e ? mEarDist : -mEarDist), mLis[1], mLis[2]};
+		float * tap = &mTarget[tapIndex(s, 0, e)];
+		for(unsigned k=0; k<P; ++k){
+			float dd = 0.f;
+			for(int a=0; a<3; ++a){
+				const float d = mImgSign[a*P + k]*pos[a] + mImgOff[a*P + k] - ear[a];
+				dd += d*d;
+			}
+			const float r = std::sqrt(dd);
+			const float dly = r * toSamples;
+			tap[2*k  ] = dly < maxDelay ? dly : maxDelay;
+			tap[2*k+1] = mImgGain[k] * mNear / (r > mNear ? r : mNear);
+		}
+	}
+
+	if(mFresh[s]){
+		mFresh[s] = 0;
+		const unsigned i = tapIndex(s, 0, 0), m = 4*P;
+		std::copy(&mTarget[i], &mTarget[i] + m, &mCurrent[i]);
+		mRemain[s] = 0;
+	}
+	else{
+		mRemain[s] = mGlide;
+	}
+}
+
+void EarlyReflections::update(){
+	if(mRoomDirty){
+		mRoomDirty = false;
+		images();
+
+		// Longest path is shorter than order+1 room diagonals
+		const float diag = std::sqrt(mRoom[0]*mRoom[0] + mRoom[1]*mRoom[1] + mRoom[2]*mRoom[2]);
+		const float maxDelay = (mOrder+1) * diag / mSpeed * DomainObserver::spu();
+		unsigned M = 1;
+		while(M < maxDelay + BLOCK + 2) M <<= 1;
+		const unsigned T = 4*paths()*mNumSrc;
+		if(M != mSize || mBuffers.size() != 2*M*mNumSrc || mTarget.size() != T){
+			mSize = M;
+			mPos = 0;
+			mBuffers.assign(2*M*mNumSrc, 0.f);
+			mCurrent.assign(T, 0.f);
+			mTarget.assign(T, 0.f);
+			mFresh.assign(mNumSrc, 1);
+		}
+		mAllDirty = true;
+	}
+
+	if(mAllDirty){
+		mAllDirty = false;
+		mDirty.assign(mNumSrc, 1);
+	}
+
+	for(unsigned s=0; s<mNumSrc; ++s){
+		if(mDirty[s]) updatePaths(s);
+	}
+}
+
+/*
+Each chunk of input is written to the buffers first, at the write position and
+one size after it, so that a tap reads a contiguous span of any chunk. Taps
+not gliding read with a fixed offset and fractional weight over the chunk.
+*/
+void EarlyReflections::render(const float * const * src, unsigned off, float * outL, float * outR, unsigned n){
+	const unsigned M = mSize, mask = M-1, P = paths();
+
+	for(unsigned s=0; s<mNumSrc; ++s){
+		float * buf = &mBuffers[2*M*s];
+		const float * in = src[s] + off;
+		for(unsigned i=0; i<n; ++i){
+			const unsigned j = (mPos + i) & mask;
+			buf[j] = buf[j + M] = in[i];
+		}
+
+		const unsigned g = mRemain[s] < n ? mRemain[s] : n;
+
+		for(unsigned e=0; e<2; ++e){
+			float * out = e ? outR : outL;
+			float * cur = &mCurrent[tapIndex(s, 0, e)];
+			const float * tar = &mTarget[tapIndex(s, 0, e)];
+
+			for(unsigned k=0; k<P; ++k){
+				float dly = cur[2*k], amp = cur[2*k+1];
+				unsigned i = 0;
+
+				// Glide a sample at a time
+				if(g){
+					const float inc = 1.f / mRemain[s];
+					const float ddly = (tar[2*k] - dly)*inc, damp = (tar[2*k+1] - amp)*inc;
+					for(; i<g; ++i){
+						dly += ddly; amp += damp;
+						const unsigned D = unsigned(dly);
+						const float f = dly - D;
+						const float * x = buf + ((mPos + i + M - D - 1) & mask);
+						out[i] += amp * (x[1] + f*(x[0] - x[1]));
+					}
+					if(g == mRemain[s]){ dly = tar[2*k]; amp = tar[2*k+1]; }
+					cur[2*k] = dly; cur[2*k+1] = amp;
+				}
+
+				// Fixed tap
+				if(i < n){
+					const unsigned D = unsigned(dly);
+					const float f = dly - D;
+					const float * x = buf + ((mPos + i + M - D - 1) & mask);
+					for(unsigned t=0; t<n-i; ++t){
+						out[i+t] += amp * (x[t+1] + f*(x[t] - x[t+1]));
+					}
+				}
+			}
+		}
+
+		mRemain[s] -= g;
+	}
+
+	mPos = (mPos + n) & mask;
+}
+
+void EarlyReflections::process(const float * const * src, float * outL, float * outR, unsigned n){
+	update();
+	for(unsigned off=0; off<n; off+=BLOCK){
+		const unsigned m = n-off < BLOCK ? n-off : BLOCK;
+		render(src, off, outL + off, outR + off, m);
+	}
+}
+
+
+namespace{
+	inline float dot3(const float * a, const float * b){
+		return a[0]*b[0] + a[1]*b[1] + a[2]*b[2];
+	}
+
+	// Unit vector of azimuth and elevation, in degrees
+	inline void dirVec(float * v, float az, float el){
+		const float a = az * float(M_PI/180), e = el * float(M_PI/180);
+		v[0] =-std::sin(a)*std::cos(e);
+		v[1] = std::cos(a)*std::cos(e);
+		v[2] = std::sin(e);
+	}
+
+	const float cHullEps = 1e-4f;
+}
+
+VBAP::VBAP(unsigned numSrc)
+:	mNumReal(0), mLayoutDirty(true), mNumSrc(0), mGlide(64)
+{
+	numSources(numSrc);
+}
+
+VBAP& VBAP::numSources(unsigned n){
+	mNumSrc = n;
+	mDir.resize(3*n, 0.f);
+	for(unsigned s=0; s<n; ++s){
+		if(0.f == dot3(&mDir[3*s], &mDir[3*s])) mDir[3*s+1] = 1.f;
+	}
+	mDirty.assign(n, 1);
+	mFresh.assign(n, 1);
+	mLast.assign(n, 0);
+	mSlots.assign(n, 0);
+	mSlotSpk.assign(SLOTS*n, 0);
+	mCur.assign(SLOTS*n, 0.f);
+	mTar.assign(SLOTS*n, 0.f);
+	mRemain.assign(n, 0);
+	return *this;
+}
+
+VBAP& VBAP::addSpeaker(float az, float el){
+	mSpk.resize(3*mNumReal);	// drops imaginary speakers
+	mSpk.resize(3*mNumReal + 3);
+	dirVec(&mSpk[3*mNumReal], az, el);
+	++mNumReal;
+	mLayoutDirty = true;
+	return *this;
+}
+
+VBAP& VBAP::clearSpeakers(){
+	mSpk.clear();
+	mNumReal = 0;
+	mLayoutDirty = true;
+	return *this;
+}
+
+VBAP& VBAP::pos(unsigned s, float x, float y, float z){
+	const float m = std::sqrt(x*x + y*y + z*z);
+	if(m > 0.f){
+		mDir[3*s] = x/m; mDir[3*s+1] = y/m; mDir[3*s+2] = z/m;
+		mDirty[s] = 1;
+	}
+	return *this;
+}
+
+VBAP& VBAP::direction(unsigned s, float az, float el){
+	dirVec(&mDir[3*s], az, el);
+	mDirty[s] = 1;
+	return *this;
+}
+
+float VBAP::gain(unsigned s, unsigned spk) const {
+	float g = 0.f;
+	for(unsigned k=0; k<mSlots[s]; ++k){
+		if(mSlotSpk[SLOTS*s + k] == spk) g += mTar[SLOTS*s + k];
+	}
+	return g;
+}
+
+/*
+A plane through three speakers bounds a face of the hull when no speaker is
+outside of it. Faces through or behind the origin leave directions unenclosed
+and faces with more than three speakers have no unique triangulation; both
+get an imaginary speaker along the face's normal, which is outside of the
+hull, and the speakers are triangulated again.
+*/
+void VBAP::triangulate(){
+	mSpk.resize(3*mNumReal);
+	mTri.clear();
+	if(mNumReal < 3) return;
+
+	for(int iter=0; ; ++iter){
+		const unsigned N = mSpk.size()/3;
+		const float * P = &mSpk[0];
+		std::vector<float> add;
+		mTri.clear();
+
+		for(unsigned i=0;   i<N; ++i){
+		for(unsigned j=i+1; j<N; ++j){
+		for(unsigned k=j+1; k<N; ++k){
+			const float * a = P+3*i, * b = P+3*j, * c = P+3*k;
+			const float u[3] = {b[0]-a[0], b[1]-a[1], b[2]-a[2]};
+			const float v[3] = {c[0]-a[0], c[1]-a[1], c[2]-a[2]};
+			float nrm[3] = {u[1]*v[2]-u[2]*v[1], u[2]*v[0]-u[0]*v[2], u[0]*v[1]-u[1]*v[0]};
+			const float len = std::sqrt(dot3(nrm, nrm));
+			if(len < cHullEps) continue; // collinear
+			for(int d=0; d<3; ++d) nrm[d] /= len;
+
+			for(int side=0; side<2; ++side){
+				if(side) for(int d=0; d<3; ++d) nrm[d] = -nrm[d];
+				const float off = dot3(nrm, a);
+				unsigned on = 0;
+				bool face = true;
+				for(unsigned m=0; m<N; ++m){
+					const float h = dot3(nrm, P+3*m) - off;
+					if(h > cHullEps){ face = false; break; }
+					if(h > -cHullEps) ++on;
+				}
+				if(!face) continue;
+
+				if(on > 3 || off <= cHullEps){
+					bool dup = false;
+					for(unsigned m=0; m<add.size(); m+=3){
+						if(dot3(&add[m], nrm) > 1.f - cHullEps){ dup = true; break; }
+					}
+					if(!dup) add.insert(add.end(), nrm, nrm+3);
+				}
+				else{
+					mTri.push_back(i); mTri.push_back(j); mTri.push_back(k);
+				}
+			}
+		}}}
+
+		if(add.empty() || iter == 7) break;
+		mSpk.insert(mSpk.end(), add.begin(), add.end());
+	}
+
+	// Inverses of matrices with speaker directions as rows
+	const unsigned T = triangles();
+	mInv.resize(9*T);
+	for(unsigned t=0; t<T; ++t){
+		const float * a = &mSpk[3*mTri[3*t]], * b = &mSpk[3*mTri[3*t+1]], * c = &mSpk[3*mTri[3*t+2]];
+		const double m[9] = {a[0],a[1],a[2], b[0],b[1],b[2], c[0],c[1],c[2]};
+		const double adj[9] = {
+			m[4]*m[8]-m[5]*m[7], m[2]*m[7]-m[1]*m[8], m[1]*m[5]-m[2]*m[4],
+			m[5]*m[6]-m[3]*m[8], m[0]*m[8]-m[2]*m[6], m[2]*m[3]-m[0]*m[5],
+			m[3]*m[7]-m[4]*m[6], m[1]*m[6]-m[0]*m[7], m[0]*m[4]-m[1]*m[3]
+		};
+		const double det = m[0]*adj[0] + m[1]*adj[3] + m[2]*adj[6];
+		for(int k=0; k<9; ++k) mInv[9*t+k] = float(adj[k]/det);
+	}
+
+	// Triangle of center of each grid cell
+	mGrid.assign(GRID_AZ*GRID_EL, 0);
+	for(unsigned e=0; e<GRID_EL; ++e){
+	for(unsigned a=0; a<GRID_AZ; ++a){
+		float v[3], g[3];
+		dirVec(v, (a+0.5f)*360.f/GRID_AZ - 180.f, (e+0.5f)*180.f/GRID_EL - 90.f);
+		mGrid[e*GRID_AZ + a] = findTriangle(v, T, g);
+	}}
+}
+
+// Get smallest gain of a direction in a triangle; it is in it if not negative
+float VBAP::tryTriangle(unsigned t, const float * v, float * g) const {
+	const float * M = &mInv[9*t];
+	for(int k=0; k<3; ++k) g[k] = v[0]*M[k] + v[1]*M[3+k] + v[2]*M[6+k];
+	return scl::min(g[0], g[1], g[2]);
+}
+
+unsigned VBAP::findTriangle(const float * v, unsigned hint, float * g) const {
+	const unsigned T = triangles();
+	if(hint < T && tryTriangle(hint, v, g) >= -cHullEps) return hint;
+
+	if(mGrid.size() == GRID_AZ*GRID_EL){
+		const float az = std::atan2(-v[0], v[1]) * float(180/M_PI);
+		const float el = std::asin(scl::clip(v[2], 1.f, -1.f)) * float(180/M_PI);
+		const unsigned a = scl::min(unsigned((az + 180.f) * (GRID_AZ/360.f)), unsigned(GRID_AZ-1));
+		const unsigned e = scl::min(unsigned((el +  90.f) * (GRID_EL/180.f)), unsigned(GRID_EL-1));
+		const unsigned t = mGrid[e*GRID_AZ + a];
+		if(t < T && tryTriangle(t, v, g) >= -cHullEps) return t;
+	}
+
+	// Search all, keeping the nearest in case of rounding
+	unsigned best = 0;
+	float bestMin = -1e30f;
+	for(unsigned t=0; t<T; ++t){
+		const float m = tryTriangle(t, v, g);
+		if(m >= -cHullEps) return t;
+		if(m > bestMin){ bestMin = m; best = t; }
+	}
+	if(T) tryTriangle(best, v, g);
+	return best;
+}
+
+// Jump to target gains and drop speakers faded out
+void VBAP::settle(unsigned s){
+	unsigned * spk = &mSlotSpk[SLOTS*s];
+	float * cur = &mCur[SLOTS*s], * tar = &mTar[SLOTS*s];
+	unsigned n = 0;
+	for(unsigned k=0; k<mSlots[s]; ++k){
+		if(tar[k] != 0.f){
+			spk[n] = spk[k]; cur[n] = tar[n] = tar[k];
+			++n;
+		}
+	}
+	mSlots[s] = n;
+	mRemain[s] = 0;
+}
+
+void VBAP::updateSource(unsigned s){
+	mDirty[s] = 0;
+	unsigned * spk = &mSlotSpk[SLOTS*s];
+	float * cur = &mCur[SLOTS*s], * tar = &mTar[SLOTS*s];
+	for(unsigned k=0; k<mSlots[s]; ++k) tar[k] = 0.f;
+	if(!triangles()){
+		settle(s);
+		return;
+	}
+
+	float g[3];
+	const unsigned t = findTriangle(&mDir[3*s], mLast[s], g);
+	mLast[s] = t;
+
+	// Constant power, then discard imaginary speakers
+	float sum = 0.f;
+	for(int k=0; k<3; ++k){
+		if(g[k] < 0.f) g[k] = 0.f;
+		sum += g[k]*g[k];
+	}
+	const float norm = sum > 0.f ? 1.f/std::sqrt(sum) : 0.f;
+
+	for(int k=0; k<3; ++k){
+		const unsigned i = mTri[3*t+k];
+		if(i >= mNumReal || g[k] == 0.f) continue;
+		unsigned j = 0;
+		while(j < mSlots[s] && spk[j] != i) ++j;
+		if(j == mSlots[s]){
+			if(j == SLOTS){ settle(s); j = mSlots[s]; }
+			spk[j] = i; cur[j] = 0.f;
+			++mSlots[s];
+		}
+		tar[j] = g[k] * norm;
+	}
+
+	if(mFresh[s]){
+		mFresh[s] = 0;
+		settle(s);
+	}
+	else{
+		mRemain[s] = mGlide;
+	}
+}
+
+void VBAP::update(){
+	if(mLayoutDirty){
+		mLayoutDirty = false;
+		triangulate();
+		mLast.assign(mNumSrc, 0);
+		mSlots.assign(mNumSrc, 0);
+		mRemain.assign(mNumSrc, 0);
+		mFresh.assign(mNumSrc, 1);
+		mDirty.assign(mNumSrc, 1);
+	}
+
+	for(unsigned s=0; s<mNumSrc; ++s){
+		if(mDirty[s]) updateSource(s);
+	}
+}
+
+void VBAP::process(const float * const * src, float * const * out, unsigned n){
+	update();
+
+	for(unsigned s=0; s<mNumSrc; ++s){
+		const float * in = src[s];
+		const unsigned g = mRemain[s] < n ? mRemain[s] : n;
+		unsigned * spk = &mSlotSpk[SLOTS*s];
+		float * cur = &mCur[SLOTS*s];
+		const float * tar = &mTar[SLOTS*s];
+
+		for(unsigned k=0; k<mSlots[s]; ++k){
+			float * o = out[spk[k]];
+			float amp = cur[k];
+			unsigned i = 0;
+
+			// Glide a sample at a time
+			if(g){
+				const float inc = (tar[k] - amp) / mRemain[s];
+				for(; i<g; ++i){
+					amp += inc;
+					o[i] += amp * in[i];
+				}
+				if(g == mRemain[s]) amp = tar[k];
+				cur[k] = amp;
+			}
+
+			// Fixed gain
+			if(amp != 0.f){
+				for(; i<n; ++i) o[i] += amp * in[i];
+			}
+		}
+
+		if(g){
+			mRemain[s] -= g;
+			if(!mRemain[s]) settle(s);
+		}
+	}
+}
+
+
+} // gam::
@@ -0,0 +1,120 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <algorithm>
+#include <cstdio>
+#include "Gamma/Config.h"
+#include "Gamma/State.h"
+
+#if GAM_WINDOWS
+	#define WIN32_LEAN_AND_MEAN
+	#include <windows.h>
+#else
+	#include <fcntl.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
+	#include <unistd.h>
+#endif
+
+namespace gam{
+
+StateWriter::StateWriter(size_t capacity)
+:	mBuf(capacity), mSize(0), mFixed(capacity != 0), mOk(true)
+{}
+
+StateWriter& StateWriter::bytes(const void * src, size_t n){
+	if(!mOk) return *this;
+	if(mSize + n > mBuf.size()){
+		if(mFixed){ mOk = false; return *this; }
+		mBuf.resize(std::max(mSize + n, mBuf.size()*2));
+	}
+	if(n) std::memcpy(&mBuf[mSize], src, n);
+	mSize += n;
+	return *this;
+}
+
+bool StateWriter::save(const std::string& path) const {
+	const std::string tmp = path + ".tmp";
+	FILE * f = fopen(tmp.c_str(), "wb");
+	bool ok = mOk && f && fwrite(mBuf.data(), 1, mSize, f) == mSize;
+	if(f) ok = (fclose(f) == 0) && ok;
+	#if GAM_WINDOWS
+	ok = ok && MoveFileExA(tmp.c_str(), path.c_str(), MOVEFILE_REPLACE_EXISTING);
+	#else
+	ok = ok && rename(tmp.c_str(), path.c_str()) == 0;
+	#endif
+	if(!ok){
+		remove(tmp.c_str());
+		fprintf(stderr, "gam::StateWriter: couldn't write \"%s\"\n", path.c_str());
+	}
+	return ok;
+}
+
+
+StateReader::StateReader()
+:	mData(NULL), mSize(0), mPos(0), mOk(true), mMap(NULL), mMapSize(0)
+{}
+
+StateReader::StateReader(const void * src, size_t size)
+:	mData(static_cast<const char *>(src)), mSize(size), mPos(0), mOk(true), mMap(NULL), mMapSize(0)
+{}
+
+StateReader::~StateReader(){
+	unmap();
+}
+
+void StateReader::unmap(){
+	if(!mMap) return;
+	#if GAM_WINDOWS
+	UnmapViewOfFile(mMap);
+	#else
+	munmap(mMap, mMapSize);
+	#endif
+	mMap = NULL;
+	mMapSize = 0;
+}
+
+bool StateReader::map(const std::string& path){
+	unmap();
+	mData = NULL; mSize = mPos = 0; mOk = false;
+
+	#if GAM_WINDOWS
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file != INVALID_HANDLE_VALUE){
+		LARGE_INTEGER size;
+		if(GetFileSizeEx(file, &size) && size.QuadPart > 0){
+			HANDLE mapping = CreateFileMapping(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if(mapping){
+				mMap = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				CloseHandle(mapping);
+				if(mMap) mMapSize = size_t(size.QuadPart);
+			}
+		}
+		CloseHandle(file);
+	}
+	#else
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd >= 0){
+		struct stat st;
+		if(fstat(fd, &st) == 0 && st.st_size > 0){
+			void * m = mmap(0, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+			if(m != MAP_FAILED){
+				mMap = m;
+				mMapSize = size_t(st.st_size);
+			}
+		}
+		close(fd);
+	}
+	#endif
+
+	if(!mMap){
+		fprintf(stderr, "gam::StateReader: couldn't map \"%s\"\n", path.c_str());
+		return false;
+	}
+	mData = static_cast<const char *>(mMap);
+	mSize = mMapSize;
+	mOk = true;
+	return true;
+}
+
+} // gam::
@@ -0,0 +1,213 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <mutex>
+#include <vector>
+#include "Gamma/Trace.h"
+
+namespace gam{
+
+namespace{
+
+	enum{ MASK = GAM_TRACE_BUFFER_SIZE-1 };
+
+	// Ring of the last events of one thread. Only the owning thread writes;
+	// readers copy it and then discard events that may have been overwritten
+	// while copying.
+	struct TraceBuffer{
+		std::vector<TraceEvent> events;
+		std::atomic<unsigned long long> written;	// events written ever
+		std::atomic<unsigned long long> cleared;	// events before last clear
+		std::atomic<const char *> name;
+		TraceBuffer * next;							// next reserved buffer
+		unsigned tid;
+
+		explicit TraceBuffer(unsigned id)
+		:	events(GAM_TRACE_BUFFER_SIZE), written(0), cleared(0), name(0), next(0), tid(id)
+		{}
+
+		void push(const TraceEvent& e){
+			const unsigned long long i = written.load(std::memory_order_relaxed);
+			events[i & MASK] = e;
+			written.store(i+1, std::memory_order_release);
+		}
+
+		// Copy events still in the ring. While event 'written' is being
+		// pushed, its slot still holds event written - SIZE, which is
+		// therefore never copied; at most SIZE-1 events are kept.
+		void copy(std::vector<TraceEvent>& dst) const {
+			const unsigned long long end = written.load(std::memory_order_acquire);
+			unsigned long long beg = cleared.load(std::memory_order_relaxed);
+			if(end - beg > GAM_TRACE_BUFFER_SIZE-1) beg = end - (GAM_TRACE_BUFFER_SIZE-1);
+			const size_t first = dst.size();
+			for(unsigned long long i=beg; i<end; ++i) dst.push_back(events[i & MASK]);
+			// Events before now+1-SIZE were overwritten while copying
+			const unsigned long long now = written.load(std::memory_order_acquire);
+			if(now + 1 - beg > GAM_TRACE_BUFFER_SIZE){
+				const unsigned long long lost = now + 1 - beg - GAM_TRACE_BUFFER_SIZE;
+				dst.erase(dst.begin() + first, dst.begin() + first + size_t(lost < end-beg ? lost : end-beg));
+			}
+		}
+	};
+
+	// Buffers are never freed, so events of finished threads are kept and
+	// threads may record while the program exits
+	struct TraceBuffers{
+		std::mutex mutex;
+		std::vector<TraceBuffer *> buffers;
+		std::atomic<TraceBuffer *> reserved;	// stack of unclaimed buffers
+		TraceBuffers(): reserved(0){}
+	};
+
+	TraceBuffers& traceBuffers(){
+		static TraceBuffers * b = new TraceBuffers;
+		return *b;
+	}
+
+	struct TraceThread{
+		TraceBuffer * buffer;
+		const char * name;
+	};
+
+	TraceThread& traceThreadLocal(){
+		thread_local TraceThread t = {0, 0};
+		return t;
+	}
+
+	// Reserved buffers are only ever popped, so the stack has no ABA problem
+	TraceBuffer * popReserved(TraceBuffers& b){
+		TraceBuffer * r = b.reserved.load(std::memory_order_acquire);
+		while(r && !b.reserved.compare_exchange_weak(r, r->next,
+			std::memory_order_acquire, std::memory_order_acquire)){}
+		return r;
+	}
+
+	TraceBuffer& traceBuffer(){
+		TraceThread& t = traceThreadLocal();
+		if(!t.buffer){
+			TraceBuffers& b = traceBuffers();
+			t.buffer = popReserved(b);
+			if(!t.buffer){
+				std::lock_guard<std::mutex> lock(b.mutex);
+				t.buffer = new TraceBuffer(unsigned(b.buffers.size()) + 1);
+				b.buffers.push_back(t.buffer);
+			}
+			t.buffer->name.store(t.name, std::memory_order_relaxed);
+		}
+		return *t.buffer;
+	}
+
+	void writeString(FILE * fp, const char * s){
+		fputc('"', fp);
+		for(; *s; ++s){
+			const unsigned char c = *s;
+			if(c == '"' || c == '\\')	fprintf(fp, "\\%c", c);
+			else if(c < 0x20)			fprintf(fp, "\\u%04x", c);
+			else						fputc(c, fp);
+		}
+		fputc('"', fp);
+	}
+}
+
+
+void traceStart(bool nodes){
+	traceState().store(TRACE_ON | (nodes ? TRACE_NODES : 0), std::memory_order_relaxed);
+}
+
+void traceStop(){
+	traceState().store(0, std::memory_order_relaxed);
+}
+
+void traceReserve(unsigned threads){
+	TraceBuffers& b = traceBuffers();
+	std::lock_guard<std::mutex> lock(b.mutex);
+	unsigned n = 0;
+	for(TraceBuffer * r = b.reserved.load(std::memory_order_acquire); r; r = r->next) ++n;
+	for(; n < threads; ++n){
+		TraceBuffer * r = new TraceBuffer(unsigned(b.buffers.size()) + 1);
+		b.buffers.push_back(r);
+		r->next = b.reserved.load(std::memory_order_relaxed);
+		while(!b.reserved.compare_exchange_weak(r->next, r,
+			std::memory_order_release, std::memory_order_relaxed)){}
+	}
+}
+
+void traceClear(){
+	TraceBuffers& b = traceBuffers();
+	std::lock_guard<std::mutex> lock(b.mutex);
+	for(unsigned i=0; i<b.buffers.size(); ++i){
+		TraceBuffer& t = *b.buffers[i];
+		t.cleared.store(t.written.load(std::memory_order_acquire), std::memory_order_relaxed);
+	}
+}
+
+void traceThread(const char * name){
+	TraceThread& t = traceThreadLocal();
+	t.name = name;
+	if(t.buffer) t.buffer->name.store(name, std::memory_order_relaxed);
+}
+
+void traceSpan(const char * name, nsec_t begin, nsec_t end, const void * id){
+	if(!tracing()) return;
+	const TraceEvent e = {name, id, begin, end - begin};
+	traceBuffer().push(e);
+}
+
+void traceInstant(const char * name, const void * id){
+	if(!tracing()) return;
+	const TraceEvent e = {name, id, timeNow(), -1};
+	traceBuffer().push(e);
+}
+
+unsigned traceWrite(FILE * fp){
+	TraceBuffers& b = traceBuffers();
+	std::lock_guard<std::mutex> lock(b.mutex);
+
+	std::vector<std::vector<TraceEvent> > events(b.buffers.size());
+	nsec_t t0 = 0;
+	bool any = false;
+	for(unsigned i=0; i<b.buffers.size(); ++i){
+		b.buffers[i]->copy(events[i]);
+		for(unsigned j=0; j<events[i].size(); ++j){
+			if(!any || events[i][j].begin < t0) t0 = events[i][j].begin;
+			any = true;
+		}
+	}
+
+	unsigned n = 0;
+	const char * sep = "\n";
+	fprintf(fp, "{\"displayTimeUnit\":\"ns\",\"traceEvents\":[");
+	for(unsigned i=0; i<b.buffers.size(); ++i){
+		const TraceBuffer& t = *b.buffers[i];
+		const char * name = t.name.load(std::memory_order_relaxed);
+		if(name){
+			fprintf(fp, "%s{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%u,\"args\":{\"name\":", sep, t.tid);
+			writeString(fp, name);
+			fprintf(fp, "}}");
+			sep = ",\n";
+		}
+		for(unsigned j=0; j<events[i].size(); ++j){
+			const TraceEvent& e = events[i][j];
+			fprintf(fp, "%s{\"name\":", sep);
+			writeString(fp, e.name ? e.name : "");
+			fprintf(fp, ",\"cat\":\"gam\",\"pid\":1,\"tid\":%u,\"ts\":%.3f", t.tid, double(e.begin - t0) * 1e-3);
+			if(e.dur >= 0)	fprintf(fp, ",\"ph\":\"X\",\"dur\":%.3f", double(e.dur) * 1e-3);
+			else			fprintf(fp, ",\"ph\":\"i\",\"s\":\"t\"");
+			if(e.id)		fprintf(fp, ",\"args\":{\"id\":\"%p\"}", e.id);
+			fprintf(fp, "}");
+			sep = ",\n";
+			++n;
+		}
+	}
+	fprintf(fp, "\n]}\n");
+	return n;
+}
+
+bool traceWrite(const char * path){
+	FILE * fp = fopen(path, "w");
+	if(!fp) return false;
+	traceWrite(fp);
+	return 0 == fclose(fp);
+}
+
+} // gam::
@@ -1,36 +1,44 @@
 /*	Gamma - Generic processing library
 	See COPYRIGHT file for authors and license information */
 
+#include <atomic>
 #include <cmath>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
 #include "Gamma/arr.h"
+#include "Gamma/CPU.h"
 #include "Gamma/Constants.h"
 
+#if defined(GAM_CPU_X86)
+	#include <immintrin.h>
+#endif
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#define GAM_GAIN_SSE
+	#define GAM_GAIN_AVX // compiled per function and dispatched at runtime
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_GAIN_NEON
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GAM_PCM_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_PCM_NEON
+	#if defined(__aarch64__)
+		#define GAM_PCM_NEON_OUT // round-to-nearest conversion is ARMv8 only
+	#endif
+#endif
+
 #define LOOP(n,s) for(unsigned i=0; i<n; i+=s)
 
 namespace gam{
 namespace arr{
 
-void linToDB(float * arr, unsigned len, float minDB){
-	float normFactor = 20.f / minDB;
-
-	LOOP(len,1){
-		uint32_t * arrI = (uint32_t *)arr;
-		uint32_t sign = (*arrI) & MaskSign<float>();
-		
-		float val = std::fabs(*arr);
-		
-		if(val == 0.f){
-			*arr++ = 0.f;
-		}
-		else{
-			val = 1.f - normFactor * log10(val);
-			if(val < 0.f) val = 0.f;
-			*arr++ = val;
-			*arrI |= sign;
-		}
-	}
-}
-
 //inline T scl::linToDB(T v){ return (T)log10(v) * (T)20; }
 //inline T scl::dBToLin(T v){ return pow(10., v * 0.05); }
 
@@ -46,6 +54,1541 @@ void clip1(float * arr, unsigned len, unsigned str){
 	}
 }
 
+namespace{
+
+	// SIMD kernels process as many samples (or partials) as fit their vectors
+	// and return how many they did; the caller finishes the rest in scalar
+	// code. The scalar kernels do nothing.
+	typedef unsigned (*GainKernel)(float *, const float *, unsigned, float, float, bool, bool);
+	typedef unsigned (*MixKernel)(float *, const float * const *, unsigned, unsigned);
+	typedef unsigned (*MulAddComplexKernel)(float *, const float * const *, const float * const *, unsigned, unsigned);
+	typedef unsigned (*ResonateKernel)(float *, float *, const float *, const float *, unsigned, const float *, unsigned);
+
+	unsigned gainNaNClipNone(float *, const float *, unsigned, float, float, bool, bool){ return 0; }
+	unsigned mixNone(float *, const float * const *, unsigned, unsigned){ return 0; }
+	unsigned mulAddComplexNone(float *, const float * const *, const float * const *, unsigned, unsigned){ return 0; }
+	unsigned resonateNone(float *, float *, const float *, const float *, unsigned, const float *, unsigned){ return 0; }
+
+	// Vector versions of gainNaNClip compute each gain directly from the start
+	// to avoid accumulating error. Max/min are ordered so that NaNs pass through.
+	// Mixing and complex multiply-adds accumulate each vector over all sources
+	// while it is in registers.
+
+	#if defined(GAM_GAIN_AVX)
+	GAM_TARGET_AVX512 unsigned gainNaNClipAVX512(
+		float * dst, const float * src, unsigned len,
+		float gain, float dgain, bool zeroNaNs, bool clip
+	){
+		unsigned i=0;
+		const __m512 lo = _mm512_set1_ps(-1.f), hi = _mm512_set1_ps(1.f);
+		const __m512 ramp = _mm512_set_ps(15,14,13,12,11,10,9,8,7,6,5,4,3,2,1,0);
+		const __m512 vdg = _mm512_set1_ps(dgain);
+		for(; i+16<=len; i+=16){
+			__m512 g = _mm512_add_ps(_mm512_set1_ps(gain + dgain*float(i)), _mm512_mul_ps(ramp, vdg));
+			__m512 v = _mm512_mul_ps(_mm512_loadu_ps(src+i), g);
+			if(zeroNaNs) v = _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(v, v, _CMP_ORD_Q), v);
+			// Masked with all lanes, as unmasked min/max warn of an undefined source
+			if(clip) v = _mm512_maskz_min_ps(0xFFFF, hi, _mm512_maskz_max_ps(0xFFFF, lo, v));
+			_mm512_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	GAM_TARGET_AVX2 unsigned gainNaNClipAVX2(
+		float * dst, const float * src, unsigned len,
+		float gain, float dgain, bool zeroNaNs, bool clip
+	){
+		unsigned i=0;
+		const __m256 lo = _mm256_set1_ps(-1.f), hi = _mm256_set1_ps(1.f);
+		const __m256 ramp = _mm256_set_ps(7,6,5,4,3,2,1,0);
+		const __m256 vdg = _mm256_set1_ps(dgain);
+		for(; i+8<=len; i+=8){
+			__m256 g = _mm256_add_ps(_mm256_set1_ps(gain + dgain*float(i)), _mm256_mul_ps(ramp, vdg));
+			__m256 v = _mm256_mul_ps(_mm256_loadu_ps(src+i), g);
+			if(zeroNaNs) v = _mm256_and_ps(v, _mm256_cmp_ps(v, v, _CMP_ORD_Q));
+			if(clip) v = _mm256_min_ps(hi, _mm256_max_ps(lo, v));
+			_mm256_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	GAM_TARGET_AVX512 unsigned mixAVX512(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len){
+		unsigned i=0;
+		for(; i+16<=len; i+=16){
+			__m512 v = _mm512_loadu_ps(dst+i);
+			for(unsigned k=0; k<numSrcs; ++k) v = _mm512_add_ps(v, _mm512_loadu_ps(srcs[k]+i));
+			_mm512_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	GAM_TARGET_AVX2 unsigned mixAVX2(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len){
+		unsigned i=0;
+		for(; i+8<=len; i+=8){
+			__m256 v = _mm256_loadu_ps(dst+i);
+			for(unsigned k=0; k<numSrcs; ++k) v = _mm256_add_ps(v, _mm256_loadu_ps(srcs[k]+i));
+			_mm256_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	GAM_TARGET_AVX2 unsigned mulAddComplexAVX2(float * dst, const float * const * a, const float * const * b, unsigned num, unsigned len){
+		unsigned i=0;
+		for(; i+8<=len; i+=8){
+			__m256 v = _mm256_loadu_ps(dst+i);
+			for(unsigned k=0; k<num; ++k){
+				__m256 x = _mm256_loadu_ps(a[k]+i);
+				__m256 y = _mm256_loadu_ps(b[k]+i);
+				__m256 xs = _mm256_permute_ps(x, _MM_SHUFFLE(2,3,0,1));
+				__m256 p = _mm256_addsub_ps(
+					_mm256_mul_ps(x, _mm256_moveldup_ps(y)),
+					_mm256_mul_ps(xs, _mm256_movehdup_ps(y))
+				);
+				v = _mm256_add_ps(v, p);
+			}
+			_mm256_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	GAM_TARGET_AVX2 unsigned resonateAVX2(
+		float * zr, float * zi, const float * wr, const float * wi, unsigned num,
+		const float * src, unsigned len
+	){
+		unsigned k=0;
+		for(; k+8<=num; k+=8){
+			__m256 r = _mm256_loadu_ps(zr+k), i = _mm256_loadu_ps(zi+k);
+			const __m256 cr = _mm256_loadu_ps(wr+k), ci = _mm256_loadu_ps(wi+k);
+			for(unsigned j=0; j<len; ++j){
+				__m256 x = _mm256_set1_ps(src[j]);
+				__m256 t = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r, cr), _mm256_mul_ps(i, ci)), x);
+				i = _mm256_add_ps(_mm256_mul_ps(r, ci), _mm256_mul_ps(i, cr));
+				r = t;
+			}
+			_mm256_storeu_ps(zr+k, r); _mm256_storeu_ps(zi+k, i);
+		}
+		return k;
+	}
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+
+	#if defined(GAM_GAIN_SSE)
+	unsigned gainNaNClipSSE(
+		float * dst, const float * src, unsigned len,
+		float gain, float dgain, bool zeroNaNs, bool clip
+	){
+		unsigned i=0;
+		const __m128 lo = _mm_set1_ps(-1.f), hi = _mm_set1_ps(1.f);
+		const __m128 ramp = _mm_set_ps(3,2,1,0);
+		const __m128 vdg = _mm_set1_ps(dgain);
+		for(; i+4<=len; i+=4){
+			__m128 g = _mm_add_ps(_mm_set1_ps(gain + dgain*float(i)), _mm_mul_ps(ramp, vdg));
+			__m128 v = _mm_mul_ps(_mm_loadu_ps(src+i), g);
+			if(zeroNaNs) v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+			if(clip) v = _mm_min_ps(hi, _mm_max_ps(lo, v));
+			_mm_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned mixSSE(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len){
+		unsigned i=0;
+		for(; i+4<=len; i+=4){
+			__m128 v = _mm_loadu_ps(dst+i);
+			for(unsigned k=0; k<numSrcs; ++k) v = _mm_add_ps(v, _mm_loadu_ps(srcs[k]+i));
+			_mm_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned mulAddComplexSSE(float * dst, const float * const * a, const float * const * b, unsigned num, unsigned len){
+		unsigned i=0;
+		const __m128 sign = _mm_setr_ps(-0.f, 0.f, -0.f, 0.f);
+		for(; i+4<=len; i+=4){
+			__m128 v = _mm_loadu_ps(dst+i);
+			for(unsigned k=0; k<num; ++k){
+				__m128 x = _mm_loadu_ps(a[k]+i);
+				__m128 y = _mm_loadu_ps(b[k]+i);
+				__m128 yr = _mm_shuffle_ps(y, y, _MM_SHUFFLE(2,2,0,0));
+				__m128 yi = _mm_shuffle_ps(y, y, _MM_SHUFFLE(3,3,1,1));
+				__m128 xs = _mm_shuffle_ps(x, x, _MM_SHUFFLE(2,3,0,1));
+				v = _mm_add_ps(v, _mm_mul_ps(x, yr));
+				v = _mm_add_ps(v, _mm_xor_ps(_mm_mul_ps(xs, yi), sign));
+			}
+			_mm_storeu_ps(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned resonateSSE(
+		float * zr, float * zi, const float * wr, const float * wi, unsigned num,
+		const float * src, unsigned len
+	){
+		unsigned k=0;
+		for(; k+4<=num; k+=4){
+			__m128 r = _mm_loadu_ps(zr+k), i = _mm_loadu_ps(zi+k);
+			const __m128 cr = _mm_loadu_ps(wr+k), ci = _mm_loadu_ps(wi+k);
+			for(unsigned j=0; j<len; ++j){
+				__m128 x = _mm_set1_ps(src[j]);
+				__m128 t = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r, cr), _mm_mul_ps(i, ci)), x);
+				i = _mm_add_ps(_mm_mul_ps(r, ci), _mm_mul_ps(i, cr));
+				r = t;
+			}
+			_mm_storeu_ps(zr+k, r); _mm_storeu_ps(zi+k, i);
+		}
+		return k;
+	}
+	#define GAM_SSE_KERNEL(f) f
+	#else
+	#define GAM_SSE_KERNEL(f) 0
+	#endif
+
+	#if defined(GAM_GAIN_NEON)
+	unsigned gainNaNClipNEON(
+		float * dst, const float * src, unsigned len,
+		float gain, float dgain, bool zeroNaNs, bool clip
+	){
+		unsigned i=0;
+		const float32x4_t lo = vdupq_n_f32(-1.f), hi = vdupq_n_f32(1.f);
+		const float rampA[4] = {0,1,2,3};
+		const float32x4_t ramp = vmulq_n_f32(vld1q_f32(rampA), dgain);
+		for(; i+4<=len; i+=4){
+			float32x4_t g = vaddq_f32(vdupq_n_f32(gain + dgain*float(i)), ramp);
+			float32x4_t v = vmulq_f32(vld1q_f32(src+i), g);
+			if(zeroNaNs){
+				v = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vceqq_f32(v, v)));
+			}
+			if(clip){	// NEON min/max propagate NaNs
+				v = vminq_f32(hi, vmaxq_f32(lo, v));
+			}
+			vst1q_f32(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned mixNEON(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len){
+		unsigned i=0;
+		for(; i+4<=len; i+=4){
+			float32x4_t v = vld1q_f32(dst+i);
+			for(unsigned k=0; k<numSrcs; ++k) v = vaddq_f32(v, vld1q_f32(srcs[k]+i));
+			vst1q_f32(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned mulAddComplexNEON(float * dst, const float * const * a, const float * const * b, unsigned num, unsigned len){
+		unsigned i=0;
+		const float signs[4] = {-1.f, 1.f, -1.f, 1.f};
+		const float32x4_t sign = vld1q_f32(signs);
+		for(; i+4<=len; i+=4){
+			float32x4_t v = vld1q_f32(dst+i);
+			for(unsigned k=0; k<num; ++k){
+				float32x4_t x = vld1q_f32(a[k]+i);
+				float32x4_t y = vld1q_f32(b[k]+i);
+				float32x4x2_t yri = vtrnq_f32(y, y);
+				v = vmlaq_f32(v, x, yri.val[0]);
+				v = vmlaq_f32(v, vmulq_f32(vrev64q_f32(x), sign), yri.val[1]);
+			}
+			vst1q_f32(dst+i, v);
+		}
+		return i;
+	}
+
+	unsigned resonateNEON(
+		float * zr, float * zi, const float * wr, const float * wi, unsigned num,
+		const float * src, unsigned len
+	){
+		unsigned k=0;
+		for(; k+4<=num; k+=4){
+			float32x4_t r = vld1q_f32(zr+k), i = vld1q_f32(zi+k);
+			const float32x4_t cr = vld1q_f32(wr+k), ci = vld1q_f32(wi+k);
+			for(unsigned j=0; j<len; ++j){
+				float32x4_t t = vmlsq_f32(vmlaq_f32(vdupq_n_f32(src[j]), r, cr), i, ci);
+				i = vmlaq_f32(vmulq_f32(r, ci), i, cr);
+				r = t;
+			}
+			vst1q_f32(zr+k, r); vst1q_f32(zi+k, i);
+		}
+		return k;
+	}
+	#define GAM_NEON_KERNEL(f) f
+	#else
+	#define GAM_NEON_KERNEL(f) 0
+	#endif
+}
+
+void gainNaNClip(
+	float * dst, const float * src, unsigned len,
+	float gain, float dgain, bool zeroNaNs, bool clip
+){
+	static SIMDDispatch<GainKernel> kernel(gainNaNClipNone,
+		GAM_SSE_KERNEL(gainNaNClipSSE), GAM_AVX_KERNEL(gainNaNClipAVX2),
+		GAM_AVX_KERNEL(gainNaNClipAVX512), GAM_NEON_KERNEL(gainNaNClipNEON));
+
+	for(unsigned i = kernel()(dst, src, len, gain, dgain, zeroNaNs, clip); i<len; ++i){
+		float v = src[i] * (gain + dgain*float(i));
+		if(zeroNaNs && v != v) v = 0.f; // only NaNs do not equal themselves
+		if(clip){
+			if		(v<-1.f) v =-1.f;
+			else if	(v> 1.f) v = 1.f;
+		}
+		dst[i] = v;
+	}
+}
+
+void mix(float * dst, const float * const * srcs, unsigned numSrcs, unsigned len){
+	static SIMDDispatch<MixKernel> kernel(mixNone,
+		GAM_SSE_KERNEL(mixSSE), GAM_AVX_KERNEL(mixAVX2),
+		GAM_AVX_KERNEL(mixAVX512), GAM_NEON_KERNEL(mixNEON));
+
+	for(unsigned i = kernel()(dst, srcs, numSrcs, len); i<len; ++i){
+		float v = dst[i];
+		for(unsigned k=0; k<numSrcs; ++k) v += srcs[k][i];
+		dst[i] = v;
+	}
+}
+
+void mulAddComplex(float * dst, const float * const * a, const float * const * b, unsigned num, unsigned len){
+	static SIMDDispatch<MulAddComplexKernel> kernel(mulAddComplexNone,
+		GAM_SSE_KERNEL(mulAddComplexSSE), GAM_AVX_KERNEL(mulAddComplexAVX2),
+		0, GAM_NEON_KERNEL(mulAddComplexNEON));
+
+	len *= 2;
+	for(unsigned i = kernel()(dst, a, b, num, len); i<len; i+=2){
+		float vr = dst[i], vi = dst[i+1];
+		for(unsigned k=0; k<num; ++k){
+			float xr = a[k][i], xi = a[k][i+1];
+			float yr = b[k][i], yi = b[k][i+1];
+			vr += xr*yr - xi*yi;
+			vi += xr*yi + xi*yr;
+		}
+		dst[i] = vr;
+		dst[i+1] = vi;
+	}
+}
+
+void resonate(
+	float * zr, float * zi, const float * wr, const float * wi, unsigned num,
+	const float * src, unsigned len
+){
+	static SIMDDispatch<ResonateKernel> kernel(resonateNone,
+		GAM_SSE_KERNEL(resonateSSE), GAM_AVX_KERNEL(resonateAVX2),
+		0, GAM_NEON_KERNEL(resonateNEON));
+
+	for(unsigned k = kernel()(zr, zi, wr, wi, num, src, len); k<num; ++k){
+		float r = zr[k], i = zi[k];
+		const float cr = wr[k], ci = wi[k];
+		for(unsigned j=0; j<len; ++j){
+			float t = r*cr - i*ci + src[j];
+			i = r*ci + i*cr;
+			r = t;
+		}
+		zr[k] = r; zi[k] = i;
+	}
+}
+
+namespace{
+
+	// Bank kernels run vectors of partials over sub-blocks while their sums
+	// are kept per sample; one horizontal add per sample finishes the
+	// sub-block. Resonators sum their imaginary parts. They return the number
+	// of partials done.
+	typedef unsigned (*TwoPoleBankKernel)(float *, float *, float *, const float *, const float *, unsigned, unsigned);
+	typedef unsigned (*ResonatorBankKernel)(float *, float *, float *, const float *, const float *, const float *, unsigned, const float *, unsigned);
+
+	unsigned twoPoleBankNone(float *, float *, float *, const float *, const float *, unsigned, unsigned){ return 0; }
+	unsigned resonatorBankNone(float *, float *, float *, const float *, const float *, const float *, unsigned, const float *, unsigned){ return 0; }
+
+	const float cSilence[64] = {0};
+
+	#if defined(GAM_GAIN_AVX)
+	GAM_TARGET_AVX2 inline float sumAVX2(__m256 a){
+		__m128 v = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+		v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+		return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+	}
+
+	GAM_TARGET_AVX2 unsigned twoPoleBankAVX2(
+		float * dst, float * y1, float * y2, const float * c1, const float * c2,
+		unsigned num, unsigned len
+	){
+		const unsigned k0 = num & ~7u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			__m256 acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = _mm256_setzero_ps();
+			unsigned k=0;
+			for(; k+16<=num; k+=16){
+				__m256 a1 = _mm256_loadu_ps(y1+k), a2 = _mm256_loadu_ps(y2+k);
+				__m256 b1 = _mm256_loadu_ps(y1+k+8), b2 = _mm256_loadu_ps(y2+k+8);
+				const __m256 ca1 = _mm256_loadu_ps(c1+k), ca2 = _mm256_loadu_ps(c2+k);
+				const __m256 cb1 = _mm256_loadu_ps(c1+k+8), cb2 = _mm256_loadu_ps(c2+k+8);
+				for(unsigned j=0; j<m; ++j){
+					__m256 a0 = _mm256_add_ps(_mm256_mul_ps(ca1, a1), _mm256_mul_ps(ca2, a2));
+					__m256 b0 = _mm256_add_ps(_mm256_mul_ps(cb1, b1), _mm256_mul_ps(cb2, b2));
+					acc[j] = _mm256_add_ps(acc[j], _mm256_add_ps(a0, b0));
+					a2 = a1; a1 = a0;
+					b2 = b1; b1 = b0;
+				}
+				_mm256_storeu_ps(y1+k, a1); _mm256_storeu_ps(y2+k, a2);
+				_mm256_storeu_ps(y1+k+8, b1); _mm256_storeu_ps(y2+k+8, b2);
+			}
+			for(; k<k0; k+=8){
+				__m256 a1 = _mm256_loadu_ps(y1+k), a2 = _mm256_loadu_ps(y2+k);
+				const __m256 ca1 = _mm256_loadu_ps(c1+k), ca2 = _mm256_loadu_ps(c2+k);
+				for(unsigned j=0; j<m; ++j){
+					__m256 a0 = _mm256_add_ps(_mm256_mul_ps(ca1, a1), _mm256_mul_ps(ca2, a2));
+					acc[j] = _mm256_add_ps(acc[j], a0);
+					a2 = a1; a1 = a0;
+				}
+				_mm256_storeu_ps(y1+k, a1); _mm256_storeu_ps(y2+k, a2);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumAVX2(acc[j]);
+		}
+		return k0;
+	}
+
+	GAM_TARGET_AVX2 unsigned resonatorBankAVX2(
+		float * dst, float * zr, float * zi, const float * wr, const float * wi,
+		const float * g, unsigned num, const float * src, unsigned len
+	){
+		const unsigned k0 = num & ~7u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			const float * x = src ? src+j0 : cSilence;
+			__m256 acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = _mm256_setzero_ps();
+			for(unsigned k=0; k<k0; k+=8){
+				__m256 r = _mm256_loadu_ps(zr+k), i = _mm256_loadu_ps(zi+k);
+				const __m256 cr = _mm256_loadu_ps(wr+k), ci = _mm256_loadu_ps(wi+k);
+				const __m256 cg = _mm256_loadu_ps(g+k);
+				for(unsigned j=0; j<m; ++j){
+					__m256 gx = _mm256_mul_ps(cg, _mm256_set1_ps(x[j]));
+					__m256 t = _mm256_add_ps(_mm256_sub_ps(_mm256_mul_ps(r, cr), _mm256_mul_ps(i, ci)), gx);
+					i = _mm256_add_ps(_mm256_mul_ps(r, ci), _mm256_mul_ps(i, cr));
+					r = t;
+					acc[j] = _mm256_add_ps(acc[j], i);
+				}
+				_mm256_storeu_ps(zr+k, r); _mm256_storeu_ps(zi+k, i);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumAVX2(acc[j]);
+		}
+		return k0;
+	}
+	#endif
+
+	#if defined(GAM_GAIN_SSE)
+	inline float sumSSE(__m128 a){
+		__m128 v = _mm_add_ps(a, _mm_movehl_ps(a, a));
+		return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+	}
+
+	unsigned twoPoleBankSSE(
+		float * dst, float * y1, float * y2, const float * c1, const float * c2,
+		unsigned num, unsigned len
+	){
+		const unsigned k0 = num & ~3u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			__m128 acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = _mm_setzero_ps();
+			unsigned k=0;
+			for(; k+8<=num; k+=8){
+				__m128 a1 = _mm_loadu_ps(y1+k), a2 = _mm_loadu_ps(y2+k);
+				__m128 b1 = _mm_loadu_ps(y1+k+4), b2 = _mm_loadu_ps(y2+k+4);
+				const __m128 ca1 = _mm_loadu_ps(c1+k), ca2 = _mm_loadu_ps(c2+k);
+				const __m128 cb1 = _mm_loadu_ps(c1+k+4), cb2 = _mm_loadu_ps(c2+k+4);
+				for(unsigned j=0; j<m; ++j){
+					__m128 a0 = _mm_add_ps(_mm_mul_ps(ca1, a1), _mm_mul_ps(ca2, a2));
+					__m128 b0 = _mm_add_ps(_mm_mul_ps(cb1, b1), _mm_mul_ps(cb2, b2));
+					acc[j] = _mm_add_ps(acc[j], _mm_add_ps(a0, b0));
+					a2 = a1; a1 = a0;
+					b2 = b1; b1 = b0;
+				}
+				_mm_storeu_ps(y1+k, a1); _mm_storeu_ps(y2+k, a2);
+				_mm_storeu_ps(y1+k+4, b1); _mm_storeu_ps(y2+k+4, b2);
+			}
+			for(; k<k0; k+=4){
+				__m128 a1 = _mm_loadu_ps(y1+k), a2 = _mm_loadu_ps(y2+k);
+				const __m128 ca1 = _mm_loadu_ps(c1+k), ca2 = _mm_loadu_ps(c2+k);
+				for(unsigned j=0; j<m; ++j){
+					__m128 a0 = _mm_add_ps(_mm_mul_ps(ca1, a1), _mm_mul_ps(ca2, a2));
+					acc[j] = _mm_add_ps(acc[j], a0);
+					a2 = a1; a1 = a0;
+				}
+				_mm_storeu_ps(y1+k, a1); _mm_storeu_ps(y2+k, a2);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumSSE(acc[j]);
+		}
+		return k0;
+	}
+
+	unsigned resonatorBankSSE(
+		float * dst, float * zr, float * zi, const float * wr, const float * wi,
+		const float * g, unsigned num, const float * src, unsigned len
+	){
+		const unsigned k0 = num & ~3u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			const float * x = src ? src+j0 : cSilence;
+			__m128 acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = _mm_setzero_ps();
+			for(unsigned k=0; k<k0; k+=4){
+				__m128 r = _mm_loadu_ps(zr+k), i = _mm_loadu_ps(zi+k);
+				const __m128 cr = _mm_loadu_ps(wr+k), ci = _mm_loadu_ps(wi+k);
+				const __m128 cg = _mm_loadu_ps(g+k);
+				for(unsigned j=0; j<m; ++j){
+					__m128 gx = _mm_mul_ps(cg, _mm_set1_ps(x[j]));
+					__m128 t = _mm_add_ps(_mm_sub_ps(_mm_mul_ps(r, cr), _mm_mul_ps(i, ci)), gx);
+					i = _mm_add_ps(_mm_mul_ps(r, ci), _mm_mul_ps(i, cr));
+					r = t;
+					acc[j] = _mm_add_ps(acc[j], i);
+				}
+				_mm_storeu_ps(zr+k, r); _mm_storeu_ps(zi+k, i);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumSSE(acc[j]);
+		}
+		return k0;
+	}
+	#endif
+
+	#if defined(GAM_GAIN_NEON)
+	inline float sumNEON(float32x4_t a){
+		float32x2_t v = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+		return vget_lane_f32(vpadd_f32(v, v), 0);
+	}
+
+	unsigned twoPoleBankNEON(
+		float * dst, float * y1, float * y2, const float * c1, const float * c2,
+		unsigned num, unsigned len
+	){
+		const unsigned k0 = num & ~3u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			float32x4_t acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = vdupq_n_f32(0.f);
+			unsigned k=0;
+			for(; k+8<=num; k+=8){
+				float32x4_t a1 = vld1q_f32(y1+k), a2 = vld1q_f32(y2+k);
+				float32x4_t b1 = vld1q_f32(y1+k+4), b2 = vld1q_f32(y2+k+4);
+				const float32x4_t ca1 = vld1q_f32(c1+k), ca2 = vld1q_f32(c2+k);
+				const float32x4_t cb1 = vld1q_f32(c1+k+4), cb2 = vld1q_f32(c2+k+4);
+				for(unsigned j=0; j<m; ++j){
+					float32x4_t a0 = vmlaq_f32(vmulq_f32(ca1, a1), ca2, a2);
+					float32x4_t b0 = vmlaq_f32(vmulq_f32(cb1, b1), cb2, b2);
+					acc[j] = vaddq_f32(acc[j], vaddq_f32(a0, b0));
+					a2 = a1; a1 = a0;
+					b2 = b1; b1 = b0;
+				}
+				vst1q_f32(y1+k, a1); vst1q_f32(y2+k, a2);
+				vst1q_f32(y1+k+4, b1); vst1q_f32(y2+k+4, b2);
+			}
+			for(; k<k0; k+=4){
+				float32x4_t a1 = vld1q_f32(y1+k), a2 = vld1q_f32(y2+k);
+				const float32x4_t ca1 = vld1q_f32(c1+k), ca2 = vld1q_f32(c2+k);
+				for(unsigned j=0; j<m; ++j){
+					float32x4_t a0 = vmlaq_f32(vmulq_f32(ca1, a1), ca2, a2);
+					acc[j] = vaddq_f32(acc[j], a0);
+					a2 = a1; a1 = a0;
+				}
+				vst1q_f32(y1+k, a1); vst1q_f32(y2+k, a2);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumNEON(acc[j]);
+		}
+		return k0;
+	}
+
+	unsigned resonatorBankNEON(
+		float * dst, float * zr, float * zi, const float * wr, const float * wi,
+		const float * g, unsigned num, const float * src, unsigned len
+	){
+		const unsigned k0 = num & ~3u;
+		if(!k0) return 0;
+		for(unsigned j0=0; j0<len; j0+=64){
+			const unsigned m = len-j0 < 64 ? len-j0 : 64;
+			const float * x = src ? src+j0 : cSilence;
+			float32x4_t acc[64];
+			for(unsigned j=0; j<m; ++j) acc[j] = vdupq_n_f32(0.f);
+			for(unsigned k=0; k<k0; k+=4){
+				float32x4_t r = vld1q_f32(zr+k), i = vld1q_f32(zi+k);
+				const float32x4_t cr = vld1q_f32(wr+k), ci = vld1q_f32(wi+k);
+				const float32x4_t cg = vld1q_f32(g+k);
+				for(unsigned j=0; j<m; ++j){
+					float32x4_t t = vmlsq_f32(vmlaq_f32(vmulq_n_f32(cg, x[j]), r, cr), i, ci);
+					i = vmlaq_f32(vmulq_f32(r, ci), i, cr);
+					r = t;
+					acc[j] = vaddq_f32(acc[j], i);
+				}
+				vst1q_f32(zr+k, r); vst1q_f32(zi+k, i);
+			}
+			for(unsigned j=0; j<m; ++j) dst[j0+j] += sumNEON(acc[j]);
+		}
+		return k0;
+	}
+	#endif
+
+} // anonymous::
+
+void addTwoPoleBank(
+	float * dst, float * y1, float * y2, const float * c1, const float * c2,
+	unsigned num, unsigned len
+){
+	static SIMDDispatch<TwoPoleBankKernel> kernel(twoPoleBankNone,
+		GAM_SSE_KERNEL(twoPoleBankSSE), GAM_AVX_KERNEL(twoPoleBankAVX2),
+		0, GAM_NEON_KERNEL(twoPoleBankNEON));
+
+	for(unsigned k = kernel()(dst, y1, y2, c1, c2, num, len); k<num; ++k){
+		float a1 = y1[k], a2 = y2[k];
+		const float ca1 = c1[k], ca2 = c2[k];
+		for(unsigned j=0; j<len; ++j){
+			float a0 = ca1*a1 + ca2*a2;
+			dst[j] += a0;
+			a2 = a1; a1 = a0;
+		}
+		y1[k] = a1; y2[k] = a2;
+	}
+}
+
+void addResonatorBank(
+	float * dst, float * zr, float * zi, const float * wr, const float * wi,
+	const float * g, unsigned num, const float * src, unsigned len
+){
+	static SIMDDispatch<ResonatorBankKernel> kernel(resonatorBankNone,
+		GAM_SSE_KERNEL(resonatorBankSSE), GAM_AVX_KERNEL(resonatorBankAVX2),
+		0, GAM_NEON_KERNEL(resonatorBankNEON));
+
+	for(unsigned k = kernel()(dst, zr, zi, wr, wi, g, num, src, len); k<num; ++k){
+		float r = zr[k], i = zi[k];
+		const float cr = wr[k], ci = wi[k], cg = g[k];
+		for(unsigned j=0; j<len; ++j){
+			float t = r*cr - i*ci + (src ? cg*src[j] : 0.f);
+			i = r*ci + i*cr;
+			r = t;
+			dst[j] += i;
+		}
+		zr[k] = r; zi[k] = i;
+	}
+}
+
+void allPassChains(
+	float * dst0, float * dst1, const float * src, unsigned len,
+	const float * coef, float * state
+){
+	enum{ S = 6, L = 2*S };
+
+	// Section j of both chains is in lanes 2j and 2j+1; y holds the output of
+	// each section from the last step
+	float c[L], d[L], y[L];
+	for(unsigned j=0; j<S; ++j){
+		c[2*j] = coef[j]; c[2*j+1] = coef[S+j];
+		d[2*j] = state[j]; d[2*j+1] = state[S+j];
+		y[2*j] = y[2*j+1] = 0.f;
+	}
+
+	// At step t, section j filters sample t-j; sections are updated from last
+	// to first so each reads its predecessor's output from the step before
+	const unsigned T = len + S-1;
+	auto edgeStep = [&](unsigned t){
+		const float x = t<len ? src[t] : 0.f;
+		for(unsigned j=S; j-->0;){
+			if(t >= j && t-j < len){
+				for(unsigned b=0; b<2; ++b){
+					unsigned k = 2*j+b;
+					float i0 = (j ? y[k-2] : x) - d[k]*c[k];
+					y[k] = i0*c[k] + d[k];
+					d[k] = i0;
+				}
+			}
+		}
+		if(t >= S-1){ dst0[t-(S-1)] = y[L-2]; dst1[t-(S-1)] = y[L-1]; }
+	};
+
+	unsigned t = 0;
+	for(; t<S-1 && t<T; ++t) edgeStep(t);
+
+	// All sections have a sample from step S-1 to len-1
+	#if defined(__AVX__) || defined(GAM_GAIN_SSE)
+	if(t < len){
+		__m128 y0 = _mm_loadu_ps(y), y1 = _mm_loadu_ps(y+4), y2 = _mm_loadu_ps(y+8);
+		__m128 d0 = _mm_loadu_ps(d), d1 = _mm_loadu_ps(d+4), d2 = _mm_loadu_ps(d+8);
+		const __m128 c0 = _mm_loadu_ps(c), c1 = _mm_loadu_ps(c+4), c2 = _mm_loadu_ps(c+8);
+		for(; t<len; ++t){
+			// Shift outputs up by one section, feeding the input to the first
+			__m128 x0 = _mm_movelh_ps(_mm_set1_ps(src[t]), y0);
+			__m128 x1 = _mm_shuffle_ps(y0, y1, _MM_SHUFFLE(1,0,3,2));
+			__m128 x2 = _mm_shuffle_ps(y1, y2, _MM_SHUFFLE(1,0,3,2));
+			x0 = _mm_sub_ps(x0, _mm_mul_ps(d0, c0));
+			x1 = _mm_sub_ps(x1, _mm_mul_ps(d1, c1));
+			x2 = _mm_sub_ps(x2, _mm_mul_ps(d2, c2));
+			y0 = _mm_add_ps(_mm_mul_ps(x0, c0), d0);
+			y1 = _mm_add_ps(_mm_mul_ps(x1, c1), d1);
+			y2 = _mm_add_ps(_mm_mul_ps(x2, c2), d2);
+			d0 = x0; d1 = x1; d2 = x2;
+			_mm_store_ss(dst0+t-(S-1), _mm_movehl_ps(y2, y2));
+			_mm_store_ss(dst1+t-(S-1), _mm_shuffle_ps(y2, y2, _MM_SHUFFLE(3,3,3,3)));
+		}
+		_mm_storeu_ps(y, y0); _mm_storeu_ps(y+4, y1); _mm_storeu_ps(y+8, y2);
+		_mm_storeu_ps(d, d0); _mm_storeu_ps(d+4, d1); _mm_storeu_ps(d+8, d2);
+	}
+
+	#elif defined(GAM_GAIN_NEON)
+	if(t < len){
+		float32x4_t y0 = vld1q_f32(y), y1 = vld1q_f32(y+4), y2 = vld1q_f32(y+8);
+		float32x4_t d0 = vld1q_f32(d), d1 = vld1q_f32(d+4), d2 = vld1q_f32(d+8);
+		const float32x4_t c0 = vld1q_f32(c), c1 = vld1q_f32(c+4), c2 = vld1q_f32(c+8);
+		for(; t<len; ++t){
+			float32x4_t x0 = vextq_f32(vdupq_n_f32(src[t]), y0, 2);
+			float32x4_t x1 = vextq_f32(y0, y1, 2);
+			float32x4_t x2 = vextq_f32(y1, y2, 2);
+			x0 = vmlsq_f32(x0, d0, c0);
+			x1 = vmlsq_f32(x1, d1, c1);
+			x2 = vmlsq_f32(x2, d2, c2);
+			y0 = vmlaq_f32(d0, x0, c0);
+			y1 = vmlaq_f32(d1, x1, c1);
+			y2 = vmlaq_f32(d2, x2, c2);
+			d0 = x0; d1 = x1; d2 = x2;
+			dst0[t-(S-1)] = vgetq_lane_f32(y2, 2);
+			dst1[t-(S-1)] = vgetq_lane_f32(y2, 3);
+		}
+		vst1q_f32(y, y0); vst1q_f32(y+4, y1); vst1q_f32(y+8, y2);
+		vst1q_f32(d, d0); vst1q_f32(d+4, d1); vst1q_f32(d+8, d2);
+	}
+	#endif
+
+	for(; t<len; ++t) edgeStep(t);
+	for(; t<T; ++t) edgeStep(t);
+
+	for(unsigned j=0; j<S; ++j){ state[j] = d[2*j]; state[S+j] = d[2*j+1]; }
+}
+
+
+namespace{
+
+	// Vector operations for polar conversion and reduction kernels. Masks
+	// pick lanes in sel(); integer vectors carry quadrant, sign and exponent
+	// bits.
+	struct VecScalar{
+		typedef float V; typedef int32_t I; typedef bool M;
+		enum{ W = 1 };
+		static V set(float v){ return v; }
+		static V load(const float * p){ return *p; }
+		static void store(float * p, V v){ *p = v; }
+		static float sum(V a){ return a; }
+		static void load2(const float * p, V& re, V& im){ re = p[0]; im = p[1]; }
+		static void store2(float * p, V re, V im){ p[0] = re; p[1] = im; }
+		static V add(V a, V b){ return a + b; }
+		static V sub(V a, V b){ return a - b; }
+		static V mul(V a, V b){ return a * b; }
+		static V div(V a, V b){ return a / b; }
+		static V sqrt(V a){ return std::sqrt(a); }
+		static V abs(V a){ return std::fabs(a); }
+		static V min(V a, V b){ return a < b ? a : b; }
+		static V max(V a, V b){ return a > b ? a : b; }
+		static M lt(V a, V b){ return a < b; }
+		static unsigned bitmask(M m){ return m; }
+		static V sel(M m, V a, V b){ return m ? a : b; }
+		static I signBit(V a){ union{ float f; int32_t i; } u = {a}; return u.i & int32_t(0x80000000); }
+		static V xorSign(V a, I s){ union{ float f; int32_t i; } u = {a}; u.i ^= s; return u.f; }
+		static I round(V a){ return int32_t(std::lrint(a)); }
+		static V toFloat(I a){ return float(a); }
+		static I addi(I a, int32_t b){ return a + b; }
+		static I andi(I a, int32_t b){ return a & b; }
+		static I shl30(I a){ return int32_t(uint32_t(a) << 30); }
+		static M odd(I a){ return (a & 1) != 0; }
+		static I ori(I a, int32_t b){ return a | b; }
+		static I shr23(I a){ return int32_t(uint32_t(a) >> 23); }
+		static I bits(V a){ union{ float f; int32_t i; } u = {a}; return u.i; }
+		static V fromBits(I a){ union{ int32_t i; float f; } u = {a}; return u.f; }
+	};
+
+	#if defined(GAM_PCM_SSE2)
+	struct VecSSE2{
+		typedef __m128 V; typedef __m128i I; typedef __m128 M;
+		enum{ W = 4 };
+		static V set(float v){ return _mm_set1_ps(v); }
+		static V load(const float * p){ return _mm_loadu_ps(p); }
+		static void store(float * p, V v){ _mm_storeu_ps(p, v); }
+		static float sum(V a){
+			a = _mm_add_ps(a, _mm_movehl_ps(a, a));
+			return _mm_cvtss_f32(_mm_add_ss(a, _mm_shuffle_ps(a, a, 1)));
+		}
+		static void load2(const float * p, V& re, V& im){
+			V a = _mm_loadu_ps(p), b = _mm_loadu_ps(p+4);
+			re = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+			im = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+		}
+		static void store2(float * p, V re, V im){
+			_mm_storeu_ps(p  , _mm_unpacklo_ps(re, im));
+			_mm_storeu_ps(p+4, _mm_unpackhi_ps(re, im));
+		}
+		static V add(V a, V b){ return _mm_add_ps(a, b); }
+		static V sub(V a, V b){ return _mm_sub_ps(a, b); }
+		static V mul(V a, V b){ return _mm_mul_ps(a, b); }
+		static V div(V a, V b){ return _mm_div_ps(a, b); }
+		static V sqrt(V a){ return _mm_sqrt_ps(a); }
+		static V abs(V a){ return _mm_andnot_ps(set(-0.f), a); }
+		static V min(V a, V b){ return _mm_min_ps(a, b); }
+		static V max(V a, V b){ return _mm_max_ps(a, b); }
+		static M lt(V a, V b){ return _mm_cmplt_ps(a, b); }
+		static unsigned bitmask(M m){ return _mm_movemask_ps(m); }
+		static V sel(M m, V a, V b){ return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+		static I signBit(V a){ return _mm_castps_si128(_mm_and_ps(a, set(-0.f))); }
+		static V xorSign(V a, I s){ return _mm_xor_ps(a, _mm_castsi128_ps(s)); }
+		static I round(V a){ return _mm_cvtps_epi32(a); }
+		static V toFloat(I a){ return _mm_cvtepi32_ps(a); }
+		static I addi(I a, int32_t b){ return _mm_add_epi32(a, _mm_set1_epi32(b)); }
+		static I andi(I a, int32_t b){ return _mm_and_si128(a, _mm_set1_epi32(b)); }
+		static I shl30(I a){ return _mm_slli_epi32(a, 30); }
+		static M odd(I a){ I one = _mm_set1_epi32(1); return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(a, one), one)); }
+		static I ori(I a, int32_t b){ return _mm_or_si128(a, _mm_set1_epi32(b)); }
+		static I shr23(I a){ return _mm_srli_epi32(a, 23); }
+		static I bits(V a){ return _mm_castps_si128(a); }
+		static V fromBits(I a){ return _mm_castsi128_ps(a); }
+	};
+	#define GAM_VEC_SSE_KERNEL(f) f
+	#else
+	#define GAM_VEC_SSE_KERNEL(f) 0
+	#endif
+
+	#if defined(GAM_PCM_NEON)
+	struct VecNEON{
+		typedef float32x4_t V; typedef int32x4_t I; typedef uint32x4_t M;
+		enum{ W = 4 };
+		static V set(float v){ return vdupq_n_f32(v); }
+		static V load(const float * p){ return vld1q_f32(p); }
+		static void store(float * p, V v){ vst1q_f32(p, v); }
+		static float sum(V a){
+			float32x2_t v = vadd_f32(vget_low_f32(a), vget_high_f32(a));
+			return vget_lane_f32(vpadd_f32(v, v), 0);
+		}
+		static void load2(const float * p, V& re, V& im){
+			float32x4x2_t v = vld2q_f32(p); re = v.val[0]; im = v.val[1];
+		}
+		static void store2(float * p, V re, V im){
+			float32x4x2_t v = {{re, im}}; vst2q_f32(p, v);
+		}
+		static V add(V a, V b){ return vaddq_f32(a, b); }
+		static V sub(V a, V b){ return vsubq_f32(a, b); }
+		static V mul(V a, V b){ return vmulq_f32(a, b); }
+		#if defined(__aarch64__)
+		static V div(V a, V b){ return vdivq_f32(a, b); }
+		static V sqrt(V a){ return vsqrtq_f32(a); }
+		#else
+		static V div(V a, V b){
+			V r = vrecpeq_f32(b);
+			r = vmulq_f32(r, vrecpsq_f32(b, r));
+			r = vmulq_f32(r, vrecpsq_f32(b, r));
+			return vmulq_f32(a, r);
+		}
+		static V sqrt(V a){
+			V r = vrsqrteq_f32(a);
+			r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+			r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+			return sel(vceqq_f32(a, set(0.f)), a, vmulq_f32(a, r));
+		}
+		#endif
+		static V abs(V a){ return vabsq_f32(a); }
+		static V min(V a, V b){ return vminq_f32(a, b); }
+		static V max(V a, V b){ return vmaxq_f32(a, b); }
+		static M lt(V a, V b){ return vcltq_f32(a, b); }
+		static unsigned bitmask(M m){
+			static const uint32_t bit[4] = {1,2,4,8};
+			uint32x4_t b = vandq_u32(m, vld1q_u32(bit));
+			uint32x2_t v = vadd_u32(vget_low_u32(b), vget_high_u32(b));
+			return vget_lane_u32(vpadd_u32(v, v), 0);
+		}
+		static V sel(M m, V a, V b){ return vbslq_f32(m, a, b); }
+		static I signBit(V a){ return vandq_s32(vreinterpretq_s32_f32(a), vdupq_n_s32(int32_t(0x80000000))); }
+		static V xorSign(V a, I s){ return vreinterpretq_f32_s32(veorq_s32(vreinterpretq_s32_f32(a), s)); }
+		static I round(V a){
+			// Round half away from zero, as ARMv7 has only truncation
+			V half = xorSign(set(0.5f), signBit(a));
+			return vcvtq_s32_f32(vaddq_f32(a, half));
+		}
+		static V toFloat(I a){ return vcvtq_f32_s32(a); }
+		static I addi(I a, int32_t b){ return vaddq_s32(a, vdupq_n_s32(b)); }
+		static I andi(I a, int32_t b){ return vandq_s32(a, vdupq_n_s32(b)); }
+		static I shl30(I a){ return vshlq_n_s32(a, 30); }
+		static M odd(I a){ return vtstq_s32(a, vdupq_n_s32(1)); }
+		static I ori(I a, int32_t b){ return vorrq_s32(a, vdupq_n_s32(b)); }
+		static I shr23(I a){ return vreinterpretq_s32_u32(vshrq_n_u32(vreinterpretq_u32_s32(a), 23)); }
+		static I bits(V a){ return vreinterpretq_s32_f32(a); }
+		static V fromBits(I a){ return vreinterpretq_f32_s32(a); }
+	};
+	#define GAM_VEC_NEON_KERNEL(f) f
+	#else
+	#define GAM_VEC_NEON_KERNEL(f) 0
+	#endif
+
+	// Kernels compiled for the instruction set of the build
+	namespace vec{
+		#include "arr_vec.h"
+	}
+
+} // anonymous::
+
+// Kernels compiled for AVX2, as are all functions up to the matching pop
+#if defined(GAM_GAIN_AVX)
+	#if defined(__clang__)
+		#pragma clang attribute push (__attribute__((target("avx2,fma,f16c"))), apply_to = function)
+	#elif defined(__GNUC__)
+		#pragma GCC push_options
+		#pragma GCC target("avx2,fma,f16c")
+	#endif
+
+namespace{
+	struct VecAVX2{
+		typedef __m256 V; typedef __m256i I; typedef __m256 M;
+		enum{ W = 8 };
+		static V set(float v){ return _mm256_set1_ps(v); }
+		static V load(const float * p){ return _mm256_loadu_ps(p); }
+		static void store(float * p, V v){ _mm256_storeu_ps(p, v); }
+		static float sum(V a){
+			__m128 v = _mm_add_ps(_mm256_castps256_ps128(a), _mm256_extractf128_ps(a, 1));
+			v = _mm_add_ps(v, _mm_movehl_ps(v, v));
+			return _mm_cvtss_f32(_mm_add_ss(v, _mm_shuffle_ps(v, v, 1)));
+		}
+		static void load2(const float * p, V& re, V& im){
+			// Lanes are permuted, but store2() undoes the permutation
+			V a = _mm256_loadu_ps(p), b = _mm256_loadu_ps(p+8);
+			re = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+			im = _mm256_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+		}
+		static void store2(float * p, V re, V im){
+			_mm256_storeu_ps(p  , _mm256_unpacklo_ps(re, im));
+			_mm256_storeu_ps(p+8, _mm256_unpackhi_ps(re, im));
+		}
+		static V add(V a, V b){ return _mm256_add_ps(a, b); }
+		static V sub(V a, V b){ return _mm256_sub_ps(a, b); }
+		static V mul(V a, V b){ return _mm256_mul_ps(a, b); }
+		static V div(V a, V b){ return _mm256_div_ps(a, b); }
+		static V sqrt(V a){ return _mm256_sqrt_ps(a); }
+		static V abs(V a){ return _mm256_andnot_ps(set(-0.f), a); }
+		static V min(V a, V b){ return _mm256_min_ps(a, b); }
+		static V max(V a, V b){ return _mm256_max_ps(a, b); }
+		static M lt(V a, V b){ return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+		static unsigned bitmask(M m){ return _mm256_movemask_ps(m); }
+		static V sel(M m, V a, V b){ return _mm256_blendv_ps(b, a, m); }
+		static I signBit(V a){ return _mm256_castps_si256(_mm256_and_ps(a, set(-0.f))); }
+		static V xorSign(V a, I s){ return _mm256_xor_ps(a, _mm256_castsi256_ps(s)); }
+		static I round(V a){ return _mm256_cvtps_epi32(a); }
+		static V toFloat(I a){ return _mm256_cvtepi32_ps(a); }
+		static I addi(I a, int32_t b){ return _mm256_add_epi32(a, _mm256_set1_epi32(b)); }
+		static I andi(I a, int32_t b){ return _mm256_and_si256(a, _mm256_set1_epi32(b)); }
+		static I shl30(I a){ return _mm256_slli_epi32(a, 30); }
+		static M odd(I a){ I one = _mm256_set1_epi32(1); return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(a, one), one)); }
+		static I ori(I a, int32_t b){ return _mm256_or_si256(a, _mm256_set1_epi32(b)); }
+		static I shr23(I a){ return _mm256_srli_epi32(a, 23); }
+		static I bits(V a){ return _mm256_castps_si256(a); }
+		static V fromBits(I a){ return _mm256_castsi256_ps(a); }
+	};
+
+	namespace vecavx2{
+		#include "arr_vec.h"
+	}
+} // anonymous::
+
+	#if defined(__clang__)
+		#pragma clang attribute pop
+	#elif defined(__GNUC__)
+		#pragma GCC pop_options
+	#endif
+#endif
+
+namespace{
+
+	// Dispatched vector kernels; the scalar kernels do nothing
+	typedef unsigned (*ConvertKernel)(float *, const float *, unsigned);
+	typedef unsigned (*DotKernel)(float&, const float *, const float *, unsigned);
+	typedef unsigned (*SumKernel)(float&, const float *, unsigned);
+	typedef unsigned (*ExtremaKernel)(const float *, unsigned, unsigned&, unsigned&);
+	typedef unsigned (*ChebyshevKernel)(float *, const float *, unsigned, const float *, unsigned);
+	typedef unsigned (*LinToDBKernel)(float *, unsigned, float);
+	typedef unsigned (*MaximaKernel)(unsigned *, unsigned&, const float *, unsigned);
+	typedef unsigned (*AboveKernel)(unsigned *, unsigned&, const float *, unsigned, float);
+	typedef unsigned (*ZeroCrossKernel)(unsigned&, const float *, unsigned, float);
+	typedef unsigned (*BelowNormKernel)(const float *, unsigned, float);
+
+	unsigned convertNone(float *, const float *, unsigned){ return 0; }
+	unsigned dotNone(float& r, const float *, const float *, unsigned){ r = 0.f; return 0; }
+	unsigned sumNone(float& r, const float *, unsigned){ r = 0.f; return 0; }
+	unsigned extremaNone(const float *, unsigned, unsigned&, unsigned&){ return 0; }
+	unsigned chebyshevNone(float *, const float *, unsigned, const float *, unsigned){ return 0; }
+	unsigned linToDBNone(float *, unsigned, float){ return 0; }
+	unsigned maximaNone(unsigned *, unsigned&, const float *, unsigned){ return 0; }
+	unsigned aboveNone(unsigned *, unsigned&, const float *, unsigned, float){ return 0; }
+	unsigned zeroCrossNone(unsigned&, const float *, unsigned, float){ return 0; }
+	unsigned belowNormNone(const float *, unsigned, float){ return 0; }
+
+	template <bool Precise, bool Polar>
+	void convertComplex(float * dst, const float * src, unsigned len){
+		static SIMDDispatch<ConvertKernel> kernel(convertNone,
+			GAM_VEC_SSE_KERNEL((vec::convertComplex<VecSSE2,Precise,Polar>)),
+			GAM_AVX_KERNEL((vecavx2::convertComplex<VecAVX2,Precise,Polar>)),
+			0, GAM_VEC_NEON_KERNEL((vec::convertComplex<VecNEON,Precise,Polar>)));
+		unsigned i = kernel()(dst, src, len);
+		for(; i<len; ++i){
+			float re, im;
+			VecScalar::load2(src + 2*i, re, im);
+			if(Polar)	vec::toPolar<VecScalar,Precise>(re, im);
+			else		vec::toRect<VecScalar,Precise>(re, im);
+			VecScalar::store2(dst + 2*i, re, im);
+		}
+	}
+
+} // anonymous::
+
+void cartToPolar(float * dst, const float * src, unsigned len, bool precise){
+	if(precise)	convertComplex<true , true>(dst, src, len);
+	else		convertComplex<false, true>(dst, src, len);
+}
+
+void polarToCart(float * dst, const float * src, unsigned len, bool precise){
+	if(precise)	convertComplex<true , false>(dst, src, len);
+	else		convertComplex<false, false>(dst, src, len);
+}
+
+float dot(const float * src1, const float * src2, unsigned len, unsigned str){
+	if(str != 1) return dot<float>(src1, src2, len, str);
+	static SIMDDispatch<DotKernel> kernel(dotNone,
+		GAM_VEC_SSE_KERNEL(vec::dot<VecSSE2>), GAM_AVX_KERNEL(vecavx2::dot<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::dot<VecNEON>));
+	float r;
+	unsigned i = kernel()(r, src1, src2, len);
+	for(; i<len; ++i) r += src1[i]*src2[i];
+	return r;
+}
+
+float sumSquares(const float * src, unsigned len, unsigned str){
+	return dot(src, src, len, str);
+}
+
+float meanNorm(const float * src, unsigned len, unsigned str){
+	if(str != 1) return meanNorm<float>(src, len, str);
+	static SIMDDispatch<SumKernel> kernel(sumNone,
+		GAM_VEC_SSE_KERNEL(vec::sumNorm<VecSSE2>), GAM_AVX_KERNEL(vecavx2::sumNorm<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::sumNorm<VecNEON>));
+	float r;
+	unsigned i = kernel()(r, src, len);
+	for(; i<len; ++i) r += std::fabs(src[i]);
+	return r / float(len);
+}
+
+float nyquist(const float * src, unsigned len, unsigned str){
+	if(str != 1) return nyquist<float>(src, len, str);
+	static SIMDDispatch<SumKernel> kernel(sumNone,
+		GAM_VEC_SSE_KERNEL(vec::sumAlternating<VecSSE2>), GAM_AVX_KERNEL(vecavx2::sumAlternating<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::sumAlternating<VecNEON>));
+	float r;
+	unsigned i = kernel()(r, src, len);
+	for(; i<(len & ~1U); ++i) r += i&1 ? -src[i] : src[i];
+	return r;
+}
+
+void extrema(const float * src, unsigned len, unsigned& idxMin, unsigned& idxMax){
+	idxMin = 0;
+	idxMax = 0;
+	if(!len) return;
+	static SIMDDispatch<ExtremaKernel> kernel(extremaNone,
+		GAM_VEC_SSE_KERNEL(vec::extrema<VecSSE2>), GAM_AVX_KERNEL(vecavx2::extrema<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::extrema<VecNEON>));
+	unsigned i = kernel()(src, len, idxMin, idxMax);
+	if(!i) i = 1;
+	float min = src[idxMin], max = src[idxMax];
+	for(; i<len; ++i){
+		float v = src[i];
+		if(v < min){ min = v; idxMin = i; }
+		if(v > max){ max = v; idxMax = i; }
+	}
+}
+
+void chebyshev(float * dst, const float * src, unsigned len, const float * coef, unsigned num){
+	if(!num){ for(unsigned i=0; i<len; ++i) dst[i] = 0.f; return; }
+	static SIMDDispatch<ChebyshevKernel> kernel(chebyshevNone,
+		GAM_VEC_SSE_KERNEL(vec::chebyshev<VecSSE2>), GAM_AVX_KERNEL(vecavx2::chebyshev<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::chebyshev<VecNEON>));
+	unsigned i = kernel()(dst, src, len, coef, num);
+	for(; i<len; ++i) vec::chebyshevSum<VecScalar,1>(dst+i, src+i, coef, num);
+}
+
+void linToDB(float * arr, unsigned len, float minDB){
+	float normFactor = 20.f / minDB;
+	static SIMDDispatch<LinToDBKernel> kernel(linToDBNone,
+		GAM_VEC_SSE_KERNEL(vec::linToDB<VecSSE2>), GAM_AVX_KERNEL(vecavx2::linToDB<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::linToDB<VecNEON>));
+	unsigned i = kernel()(arr, len, normFactor);
+	for(; i<len; ++i) arr[i] = vec::normDB<VecScalar>(arr[i], normFactor);
+}
+
+unsigned maxima(unsigned * dst, const float * src, unsigned len, unsigned str){
+	if(str != 1) return maxima<unsigned, float>(dst, src, len, str);
+	static SIMDDispatch<MaximaKernel> kernel(maximaNone,
+		GAM_VEC_SSE_KERNEL(vec::maxima<VecSSE2>), GAM_AVX_KERNEL(vecavx2::maxima<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::maxima<VecNEON>));
+	unsigned num = 0;
+	unsigned i = 1 + kernel()(dst, num, src, len);
+	for(; i+1 < len; ++i){
+		if(src[i] > src[i-1] && src[i] > src[i+1]) dst[num++] = i;
+	}
+	return num;
+}
+
+unsigned above(unsigned * dst, const float * src, unsigned len, float thresh){
+	static SIMDDispatch<AboveKernel> kernel(aboveNone,
+		GAM_VEC_SSE_KERNEL(vec::above<VecSSE2>), GAM_AVX_KERNEL(vecavx2::above<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::above<VecNEON>));
+	unsigned num = 0;
+	unsigned i = kernel()(dst, num, src, len, thresh);
+	for(; i<len; ++i){
+		dst[num] = i;
+		num += !(src[i] < thresh);
+	}
+	return num;
+}
+
+void histogram(const float * src, unsigned len, unsigned * bins, unsigned numBins, float scale){
+	histogram(src, len, bins, numBins, scale, 0.f);
+}
+
+namespace{
+
+	unsigned hardwareThreads(){
+		unsigned n = std::thread::hardware_concurrency();
+		return n ? n : 1;
+	}
+
+	std::atomic<unsigned> histogramMaxThreads(hardwareThreads());
+
+	// Block of a histogram tallied by a thread into its own bins
+	struct HistogramJob{
+		const float * src; unsigned len, block, numBlocks;
+		unsigned * bins; unsigned numBins; float scale, offset;
+
+		void tally(unsigned k) const {
+			unsigned beg = k*block;
+			unsigned num = k+1 == numBlocks ? len-beg : block;
+			histogram<float, unsigned>(src+beg, num, bins + k*numBins, numBins, scale, offset);
+		}
+	};
+
+	// Threads tallying blocks 1 and up of a histogram. They wait on a
+	// condition variable between jobs and are joined on exit.
+	class HistogramWorkers{
+	public:
+		std::mutex busy;	// held by the thread handing out a job
+
+		HistogramWorkers(): mGeneration(0), mDone(0), mNumWorkers(0), mStop(false){}
+
+		~HistogramWorkers(){
+			{	std::lock_guard<std::mutex> lock(mMutex);
+				mStop = true;
+			}
+			mWake.notify_all();
+			for(auto& t : mThreads) t.join();
+		}
+
+		// Run blocks of a job, with block 0 on the calling thread; busy
+		// must be held
+		void run(const HistogramJob& job){
+			while(mThreads.size()+1 < job.numBlocks){
+				const unsigned k = mThreads.size()+1, seen = mGeneration;
+				mThreads.emplace_back([this, k, seen]{ work(k, seen); });
+			}
+			{	std::lock_guard<std::mutex> lock(mMutex);
+				mJob = job;
+				mDone = 0;
+				mNumWorkers = mThreads.size();
+				++mGeneration;
+			}
+			mWake.notify_all();
+			job.tally(0);
+			std::unique_lock<std::mutex> lock(mMutex);
+			mFinished.wait(lock, [this]{ return mDone == mNumWorkers; });
+		}
+
+	private:
+		std::vector<std::thread> mThreads;
+		std::mutex mMutex;
+		std::condition_variable mWake, mFinished;
+		HistogramJob mJob;
+		unsigned mGeneration, mDone, mNumWorkers;
+		bool mStop;
+
+		// Tally block k of each job after the one numbered seen
+		void work(unsigned k, unsigned seen){
+			std::unique_lock<std::mutex> lock(mMutex);
+			for(;;){
+				mWake.wait(lock, [&]{ return mStop || mGeneration != seen; });
+				if(mStop) return;
+				seen = mGeneration;
+				const HistogramJob job = mJob;
+				lock.unlock();
+				if(k < job.numBlocks) job.tally(k);
+				lock.lock();
+				if(++mDone == mNumWorkers) mFinished.notify_one();
+			}
+		}
+	};
+
+} // anonymous::
+
+void histogramThreads(unsigned n){
+	histogramMaxThreads.store(n ? n : hardwareThreads());
+}
+
+void histogram(const float * src, unsigned len, unsigned * bins, unsigned numBins, float scale, float offset){
+	// Each thread tallies a contiguous block into its own bins; threads are
+	// only worth using when their blocks are much larger than the bins
+	static const unsigned minBlock = 1<<17;
+	unsigned block = numBins*8 > minBlock ? numBins*8 : minBlock;
+	unsigned numThreads = len/block;
+	if(numThreads > 1){
+		const unsigned maxThreads = histogramMaxThreads.load();
+		if(numThreads > maxThreads) numThreads = maxThreads;
+	}
+
+	static HistogramWorkers workers;
+	std::unique_lock<std::mutex> lock(workers.busy, std::defer_lock);
+	if(numThreads < 2 || !lock.try_lock()){
+		histogram<float, unsigned>(src, len, bins, numBins, scale, offset);
+		return;
+	}
+
+	std::vector<unsigned> local(numThreads*numBins, 0);
+	const HistogramJob job = {src, len, len/numThreads, numThreads, &local[0], numBins, scale, offset};
+	workers.run(job);
+	for(unsigned t=0; t<numThreads; ++t){
+		const unsigned * b = &local[t*numBins];
+		for(unsigned j=0; j<numBins; ++j) bins[j] += b[j];
+	}
+}
+
+namespace{
+
+	// Uniform value in [0,1) from an xorshift32 generator
+	inline float ditherUniform(uint32_t& s){
+		s ^= s << 13; s ^= s >> 17; s ^= s << 5;
+		return punUF((s >> 9) | 0x3f800000) - 1.f;
+	}
+
+	// Scale, round and saturate a float sample; NaNs become zero
+	inline long toPCM(float v, float scale, float lo, float hi, float dither = 0.f){
+		if(v != v) v = 0.f;
+		v = v*scale + dither;
+		if		(v < lo) v = lo;
+		else if	(v > hi) v = hi;
+		return std::lrint(v);
+	}
+
+	// Seed vector dither lanes far apart on the generator's sequence
+	inline void ditherSeeds(uint32_t * lanes, uint32_t s){
+		for(int k=0; k<4; ++k){
+			lanes[k] = s ^ (0x9E3779B9u * uint32_t(k+1));
+			if(0 == lanes[k]) lanes[k] = 0x6D2B79F5u;
+		}
+	}
+
+	#ifdef GAM_PCM_SSE2
+	inline __m128 ditherUniform(__m128i& s){
+		s = _mm_xor_si128(s, _mm_slli_epi32(s, 13));
+		s = _mm_xor_si128(s, _mm_srli_epi32(s, 17));
+		s = _mm_xor_si128(s, _mm_slli_epi32(s, 5));
+		__m128i b = _mm_or_si128(_mm_srli_epi32(s, 9), _mm_set1_epi32(0x3f800000));
+		return _mm_sub_ps(_mm_castsi128_ps(b), _mm_set1_ps(1.f));
+	}
+
+	// Vector version of toPCM; min/max are ordered so that NaNs (zeroed
+	// first) cannot leak through
+	inline __m128i toPCM(__m128 v, __m128 scale, __m128 lo, __m128 hi){
+		v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+		v = _mm_mul_ps(v, scale);
+		return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+	}
+
+	inline __m128i toPCM(__m128 v, __m128 scale, __m128 lo, __m128 hi, __m128i& s){
+		v = _mm_and_ps(v, _mm_cmpord_ps(v, v));
+		v = _mm_mul_ps(v, scale);
+		__m128 d = _mm_add_ps(ditherUniform(s), ditherUniform(s));
+		v = _mm_add_ps(v, _mm_sub_ps(d, _mm_set1_ps(1.f)));
+		return _mm_cvtps_epi32(_mm_min_ps(_mm_max_ps(v, lo), hi));
+	}
+
+	inline __m128 fromPCM16(__m128i v, bool hiHalf, __m128 scale){
+		v = hiHalf ? _mm_unpackhi_epi16(v, v) : _mm_unpacklo_epi16(v, v);
+		return _mm_mul_ps(_mm_cvtepi32_ps(_mm_srai_epi32(v, 16)), scale);
+	}
+	#endif
+
+	#ifdef GAM_PCM_NEON_OUT
+	inline float32x4_t ditherUniform(uint32x4_t& s){
+		s = veorq_u32(s, vshlq_n_u32(s, 13));
+		s = veorq_u32(s, vshrq_n_u32(s, 17));
+		s = veorq_u32(s, vshlq_n_u32(s, 5));
+		uint32x4_t b = vorrq_u32(vshrq_n_u32(s, 9), vdupq_n_u32(0x3f800000));
+		return vsubq_f32(vreinterpretq_f32_u32(b), vdupq_n_f32(1.f));
+	}
+
+	inline int32x4_t toPCM(float32x4_t v, float scale, float32x4_t lo, float32x4_t hi){
+		v = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vceqq_f32(v, v)));
+		v = vmulq_n_f32(v, scale);
+		return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(v, lo), hi));
+	}
+
+	inline int32x4_t toPCM(float32x4_t v, float scale, float32x4_t lo, float32x4_t hi, uint32x4_t& s){
+		v = vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(v), vceqq_f32(v, v)));
+		v = vmulq_n_f32(v, scale);
+		float32x4_t d = vaddq_f32(ditherUniform(s), ditherUniform(s));
+		v = vaddq_f32(v, vsubq_f32(d, vdupq_n_f32(1.f)));
+		return vcvtnq_s32_f32(vminq_f32(vmaxq_f32(v, lo), hi));
+	}
+	#endif
+
+} // anonymous::
+
+void fromPCM16(float * const * dst, const int16_t * src, unsigned numFrames, unsigned numChans){
+	const float scale = 1.f/32768.f;
+	unsigned i=0;
+
+	#if defined(GAM_PCM_SSE2)
+	const __m128 vs = _mm_set1_ps(scale);
+	if(1 == numChans){
+		float * d = dst[0];
+		for(; i+8<=numFrames; i+=8){
+			__m128i v = _mm_loadu_si128((const __m128i *)(src+i));
+			_mm_storeu_ps(d+i  , fromPCM16(v, false, vs));
+			_mm_storeu_ps(d+i+4, fromPCM16(v, true , vs));
+		}
+	}
+	else if(2 == numChans){
+		float * d0 = dst[0], * d1 = dst[1];
+		for(; i+4<=numFrames; i+=4){
+			__m128i v = _mm_loadu_si128((const __m128i *)(src+2*i));
+			__m128 a = fromPCM16(v, false, vs);	// L0 R0 L1 R1
+			__m128 b = fromPCM16(v, true , vs);	// L2 R2 L3 R3
+			_mm_storeu_ps(d0+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)));
+			_mm_storeu_ps(d1+i, _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)));
+		}
+	}
+
+	#elif defined(GAM_PCM_NEON)
+	if(1 == numChans){
+		float * d = dst[0];
+		for(; i+8<=numFrames; i+=8){
+			int16x8_t v = vld1q_s16(src+i);
+			vst1q_f32(d+i  , vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_low_s16 (v))), scale));
+			vst1q_f32(d+i+4, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(vget_high_s16(v))), scale));
+		}
+	}
+	else if(2 == numChans){
+		float * d0 = dst[0], * d1 = dst[1];
+		for(; i+4<=numFrames; i+=4){
+			int16x4x2_t v = vld2_s16(src+2*i);
+			vst1q_f32(d0+i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v.val[0])), scale));
+			vst1q_f32(d1+i, vmulq_n_f32(vcvtq_f32_s32(vmovl_s16(v.val[1])), scale));
+		}
+	}
+	#endif
+
+	for(; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c) dst[c][i] = src[i*numChans + c] * scale;
+	}
+}
+
+void fromPCM24(float * const * dst, const uint8_t * src, unsigned numFrames, unsigned numChans){
+	const float scale = 1.f/8388608.f;
+	for(unsigned i=0; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c){
+			const uint8_t * b = src + 3*(i*numChans + c);
+			// Place in upper bytes so the shift back down extends the sign
+			int32_t v = int32_t(uint32_t(b[0])<<8 | uint32_t(b[1])<<16 | uint32_t(b[2])<<24) >> 8;
+			dst[c][i] = v * scale;
+		}
+	}
+}
+
+void fromPCM32(float * const * dst, const int32_t * src, unsigned numFrames, unsigned numChans){
+	const float scale = 1.f/2147483648.f;
+	unsigned i=0;
+
+	#if defined(GAM_PCM_SSE2)
+	const __m128 vs = _mm_set1_ps(scale);
+	if(1 == numChans){
+		float * d = dst[0];
+		for(; i+4<=numFrames; i+=4){
+			__m128i v = _mm_loadu_si128((const __m128i *)(src+i));
+			_mm_storeu_ps(d+i, _mm_mul_ps(_mm_cvtepi32_ps(v), vs));
+		}
+	}
+	else if(2 == numChans){
+		float * d0 = dst[0], * d1 = dst[1];
+		for(; i+4<=numFrames; i+=4){
+			__m128 a = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src+2*i)));
+			__m128 b = _mm_cvtepi32_ps(_mm_loadu_si128((const __m128i *)(src+2*i+4)));
+			_mm_storeu_ps(d0+i, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0)), vs));
+			_mm_storeu_ps(d1+i, _mm_mul_ps(_mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1)), vs));
+		}
+	}
+
+	#elif defined(GAM_PCM_NEON)
+	if(1 == numChans){
+		float * d = dst[0];
+		for(; i+4<=numFrames; i+=4){
+			vst1q_f32(d+i, vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(src+i)), scale));
+		}
+	}
+	else if(2 == numChans){
+		float * d0 = dst[0], * d1 = dst[1];
+		for(; i+4<=numFrames; i+=4){
+			int32x4x2_t v = vld2q_s32(src+2*i);
+			vst1q_f32(d0+i, vmulq_n_f32(vcvtq_f32_s32(v.val[0]), scale));
+			vst1q_f32(d1+i, vmulq_n_f32(vcvtq_f32_s32(v.val[1]), scale));
+		}
+	}
+	#endif
+
+	for(; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c) dst[c][i] = src[i*numChans + c] * scale;
+	}
+}
+
+void toPCM16(int16_t * dst, const float * const * src, unsigned numFrames, unsigned numChans, uint32_t * dither){
+	const float scale = 32767.f, lo = -32768.f, hi = 32767.f;
+	uint32_t s = dither ? (*dither ? *dither : 0x6D2B79F5u) : 0;
+	unsigned i=0;
+
+	#if defined(GAM_PCM_SSE2)
+	const __m128 vs = _mm_set1_ps(scale), vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+	uint32_t lanes[4];
+	ditherSeeds(lanes, s);
+	__m128i vd = _mm_loadu_si128((const __m128i *)lanes);
+
+	#define CONV(v) (dither ? toPCM(v, vs, vlo, vhi, vd) : toPCM(v, vs, vlo, vhi))
+	if(1 == numChans){
+		const float * s0 = src[0];
+		for(; i+8<=numFrames; i+=8){
+			__m128i a = CONV(_mm_loadu_ps(s0+i));
+			__m128i b = CONV(_mm_loadu_ps(s0+i+4));
+			_mm_storeu_si128((__m128i *)(dst+i), _mm_packs_epi32(a, b));
+		}
+	}
+	else if(2 == numChans){
+		const float * s0 = src[0], * s1 = src[1];
+		for(; i+4<=numFrames; i+=4){
+			__m128 l = _mm_loadu_ps(s0+i), r = _mm_loadu_ps(s1+i);
+			__m128i a = CONV(_mm_unpacklo_ps(l, r));
+			__m128i b = CONV(_mm_unpackhi_ps(l, r));
+			_mm_storeu_si128((__m128i *)(dst+2*i), _mm_packs_epi32(a, b));
+		}
+	}
+	#undef CONV
+	if(i) s ^= uint32_t(_mm_cvtsi128_si32(vd));
+
+	#elif defined(GAM_PCM_NEON_OUT)
+	const float32x4_t vlo = vdupq_n_f32(lo), vhi = vdupq_n_f32(hi);
+	uint32_t lanes[4];
+	ditherSeeds(lanes, s);
+	uint32x4_t vd = vld1q_u32(lanes);
+
+	#define CONV(v) (dither ? toPCM(v, scale, vlo, vhi, vd) : toPCM(v, scale, vlo, vhi))
+	if(1 == numChans){
+		const float * s0 = src[0];
+		for(; i+8<=numFrames; i+=8){
+			int32x4_t a = CONV(vld1q_f32(s0+i));
+			int32x4_t b = CONV(vld1q_f32(s0+i+4));
+			vst1q_s16(dst+i, vcombine_s16(vqmovn_s32(a), vqmovn_s32(b)));
+		}
+	}
+	else if(2 == numChans){
+		const float * s0 = src[0], * s1 = src[1];
+		for(; i+4<=numFrames; i+=4){
+			int16x4x2_t v;
+			v.val[0] = vqmovn_s32(CONV(vld1q_f32(s0+i)));
+			v.val[1] = vqmovn_s32(CONV(vld1q_f32(s1+i)));
+			vst2_s16(dst+2*i, v);
+		}
+	}
+	#undef CONV
+	if(i) s ^= vgetq_lane_u32(vd, 0);
+	#endif
+
+	if(dither && 0 == s) s = 0x6D2B79F5u;
+
+	for(; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c){
+			float d = dither ? ditherUniform(s) + ditherUniform(s) - 1.f : 0.f;
+			dst[i*numChans + c] = int16_t(toPCM(src[c][i], scale, lo, hi, d));
+		}
+	}
+
+	if(dither) *dither = s;
+}
+
+void toPCM24(uint8_t * dst, const float * const * src, unsigned numFrames, unsigned numChans){
+	for(unsigned i=0; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c){
+			uint32_t v = uint32_t(toPCM(src[c][i], 8388607.f, -8388608.f, 8388607.f));
+			*dst++ = uint8_t(v);
+			*dst++ = uint8_t(v >> 8);
+			*dst++ = uint8_t(v >> 16);
+		}
+	}
+}
+
+void toPCM32(int32_t * dst, const float * const * src, unsigned numFrames, unsigned numChans){
+	// The largest float below 2^31 is the top of the range
+	const float scale = 2147483648.f, lo = -2147483648.f, hi = 2147483520.f;
+	unsigned i=0;
+
+	#if defined(GAM_PCM_SSE2)
+	const __m128 vs = _mm_set1_ps(scale), vlo = _mm_set1_ps(lo), vhi = _mm_set1_ps(hi);
+	if(1 == numChans){
+		const float * s0 = src[0];
+		for(; i+4<=numFrames; i+=4){
+			_mm_storeu_si128((__m128i *)(dst+i), toPCM(_mm_loadu_ps(s0+i), vs, vlo, vhi));
+		}
+	}
+	else if(2 == numChans){
+		const float * s0 = src[0], * s1 = src[1];
+		for(; i+4<=numFrames; i+=4){
+			__m128 l = _mm_loadu_ps(s0+i), r = _mm_loadu_ps(s1+i);
+			_mm_storeu_si128((__m128i *)(dst+2*i  ), toPCM(_mm_unpacklo_ps(l, r), vs, vlo, vhi));
+			_mm_storeu_si128((__m128i *)(dst+2*i+4), toPCM(_mm_unpackhi_ps(l, r), vs, vlo, vhi));
+		}
+	}
+
+	#elif defined(GAM_PCM_NEON_OUT)
+	const float32x4_t vlo = vdupq_n_f32(lo), vhi = vdupq_n_f32(hi);
+	if(1 == numChans){
+		const float * s0 = src[0];
+		for(; i+4<=numFrames; i+=4){
+			vst1q_s32(dst+i, toPCM(vld1q_f32(s0+i), scale, vlo, vhi));
+		}
+	}
+	else if(2 == numChans){
+		const float * s0 = src[0], * s1 = src[1];
+		for(; i+4<=numFrames; i+=4){
+			int32x4x2_t v;
+			v.val[0] = toPCM(vld1q_f32(s0+i), scale, vlo, vhi);
+			v.val[1] = toPCM(vld1q_f32(s1+i), scale, vlo, vhi);
+			vst2q_s32(dst+2*i, v);
+		}
+	}
+	#endif
+
+	for(; i<numFrames; ++i){
+		for(unsigned c=0; c<numChans; ++c){
+			dst[i*numChans + c] = int32_t(toPCM(src[c][i], scale, lo, hi));
+		}
+	}
+}
+
 void compact(float * dst, const float * src, unsigned len, unsigned chunkSize){
 
 	if(chunkSize < 2){
@@ -98,16 +1641,38 @@ void compact(float * dst, const float * src, unsigned len, unsigned chunkSize){
 //}
 
 unsigned zeroCross(const float * src, unsigned len, float prevVal){
+	static SIMDDispatch<ZeroCrossKernel> kernel(zeroCrossNone,
+		GAM_VEC_SSE_KERNEL(vec::zeroCross<VecSSE2>), GAM_AVX_KERNEL(vecavx2::zeroCross<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::zeroCross<VecNEON>));
 	unsigned count = 0;
-	float prev = prevVal;
-	LOOP(len,1){
-		float curr = *src++;
+	unsigned i = kernel()(count, src, len, prevVal);
+	float prev = i ? src[i-1] : prevVal;
+	for(; i<len; ++i){
+		float curr = src[i];
 		count += unsigned((curr > 0.f && prev <= 0.f) || (curr < 0.f && prev >= 0.f));
 		prev = curr;
 	}
 	return count;
 }
 
+unsigned headBelowNorm(const float * src, unsigned len, float thresh){
+	static SIMDDispatch<BelowNormKernel> kernel(belowNormNone,
+		GAM_VEC_SSE_KERNEL(vec::headBelowNorm<VecSSE2>), GAM_AVX_KERNEL(vecavx2::headBelowNorm<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::headBelowNorm<VecNEON>));
+	unsigned i = kernel()(src, len, thresh);
+	while(i<len && std::fabs(src[i]) < thresh) ++i;
+	return i;
+}
+
+unsigned tailBelowNorm(const float * src, unsigned len, float thresh){
+	static SIMDDispatch<BelowNormKernel> kernel(belowNormNone,
+		GAM_VEC_SSE_KERNEL(vec::tailBelowNorm<VecSSE2>), GAM_AVX_KERNEL(vecavx2::tailBelowNorm<VecAVX2>),
+		0, GAM_VEC_NEON_KERNEL(vec::tailBelowNorm<VecNEON>));
+	unsigned i = len - kernel()(src, len, thresh);
+	while(i && std::fabs(src[i-1]) < thresh) --i;
+	return len - i;
+}
+
 unsigned zeroCrossFirst(const float * src, unsigned len){
 	uint32_t * srcI = (uint32_t *)src;
 	uint32_t prev = *srcI++;
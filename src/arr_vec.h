@@ -0,0 +1,368 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Vector kernels of arr reductions, analyses and complex conversions
+
+	arr.cpp includes this once compiled for the instruction set of the build
+	and once compiled for AVX2, each time in its own namespace, and picks
+	between them at runtime. The kernels are templated on a vector type (see
+	VecScalar in arr.cpp). They process whole vectors and return how many
+	elements they did, leaving the rest to scalar code. There is no include
+	guard so that the file can be included more than once.
+*/
+
+template <class S, bool Precise>
+inline void toPolar(typename S::V& re, typename S::V& im){
+	typedef typename S::V V;
+	V x = re, y = im;
+	re = S::sqrt(S::add(S::mul(x,x), S::mul(y,y)));
+
+	if(Precise){
+		// Reduce to atan of t in [0, 1], then to [-(sqrt2-1), sqrt2-1]
+		V ax = S::abs(x), ay = S::abs(y);
+		V lo = S::min(ax, ay);
+		V hi = S::max(S::max(ax, ay), S::set(1e-30f));
+		V t = S::div(lo, hi);
+		typename S::M big = S::lt(S::set(0.41421356f), t);
+		t = S::sel(big, S::div(S::sub(t, S::set(1.f)), S::add(t, S::set(1.f))), t);
+		V z = S::mul(t, t);
+		V p = S::set(8.05374449538e-2f);
+		p = S::sub(S::mul(p, z), S::set(1.38776856032e-1f));
+		p = S::add(S::mul(p, z), S::set(1.99777106478e-1f));
+		p = S::sub(S::mul(p, z), S::set(3.33329491539e-1f));
+		V a = S::add(S::mul(S::mul(p, z), t), t);
+		a = S::sel(big, S::add(a, S::set(float(M_PI_4))), a);
+		a = S::sel(S::lt(ax, ay), S::sub(S::set(float(M_PI_2)), a), a);
+		a = S::sel(S::lt(x, S::set(0.f)), S::sub(S::set(float(M_PI)), a), a);
+		im = S::xorSign(a, S::signBit(y));
+	}
+	else{
+		// As scl::atan2Fast
+		V ay = S::add(S::abs(y), S::set(1e-10f));
+		typename S::M neg = S::lt(x, S::set(0.f));
+		V r = S::sel(neg,
+			S::div(S::add(x, ay), S::sub(ay, x)),
+			S::div(S::sub(x, ay), S::add(x, ay))
+		);
+		V a = S::sel(neg, S::set(float(M_3PI_4)), S::set(float(M_PI_4)));
+		a = S::add(a, S::mul(S::sub(S::mul(S::mul(S::set(0.1963f), r), r), S::set(0.9817f)), r));
+		im = S::sel(S::lt(y, S::set(0.f)), S::sub(S::set(0.f), a), a);
+	}
+}
+
+template <class S, bool Precise>
+inline void toRect(typename S::V& re, typename S::V& im){
+	typedef typename S::V V;
+	typedef typename S::I I;
+	V m = re, ph = im;
+
+	// Reduce phase to r in [-pi/4, pi/4] and quadrant q
+	I q = S::round(S::mul(ph, S::set(float(M_2_PI))));
+	V qf = S::toFloat(q);
+	V r = S::sub(ph, S::mul(qf, S::set(1.5703125f))); // pi/2 in three parts
+	r = S::sub(r, S::mul(qf, S::set(4.837512969970703125e-4f)));
+	r = S::sub(r, S::mul(qf, S::set(7.54978995489188216e-8f)));
+
+	// Taylor series of sine and cosine, as scl::sinT9 and scl::cosT8
+	V rr = S::mul(r, r);
+	V s, c;
+	if(Precise){
+		s = S::set(2.7557319224e-6f);
+		s = S::sub(S::mul(s, rr), S::set(1.9841269841e-4f));
+		s = S::add(S::mul(s, rr), S::set(8.3333333333e-3f));
+		s = S::sub(S::mul(s, rr), S::set(1.6666666667e-1f));
+		s = S::add(S::mul(S::mul(s, rr), r), r);
+		c = S::set(2.4801587302e-5f);
+		c = S::sub(S::mul(c, rr), S::set(1.3888888889e-3f));
+		c = S::add(S::mul(c, rr), S::set(4.1666666667e-2f));
+		c = S::sub(S::mul(c, rr), S::set(0.5f));
+		c = S::add(S::mul(c, rr), S::set(1.f));
+	}
+	else{
+		s = S::set(-1.9841269841e-4f);
+		s = S::add(S::mul(s, rr), S::set(8.3333333333e-3f));
+		s = S::sub(S::mul(s, rr), S::set(1.6666666667e-1f));
+		s = S::add(S::mul(S::mul(s, rr), r), r);
+		c = S::set(-1.3888888889e-3f);
+		c = S::add(S::mul(c, rr), S::set(4.1666666667e-2f));
+		c = S::sub(S::mul(c, rr), S::set(0.5f));
+		c = S::add(S::mul(c, rr), S::set(1.f));
+	}
+
+	// Rotate by quadrant
+	typename S::M swap = S::odd(q);
+	V cq = S::xorSign(S::sel(swap, s, c), S::shl30(S::andi(S::addi(q, 1), 2)));
+	V sq = S::xorSign(S::sel(swap, c, s), S::shl30(S::andi(q, 2)));
+	re = S::mul(m, cq);
+	im = S::mul(m, sq);
+}
+
+template <class S, bool Precise, bool Polar>
+unsigned convertComplex(float * dst, const float * src, unsigned len){
+	unsigned i=0;
+	for(; i+S::W<=len; i+=S::W){
+		typename S::V re, im;
+		S::load2(src + 2*i, re, im);
+		if(Polar)	toPolar<S,Precise>(re, im);
+		else		toRect<S,Precise>(re, im);
+		S::store2(dst + 2*i, re, im);
+	}
+	return i;
+}
+
+// Terms of reductions at element i
+template <class S>
+struct ProductTerm{
+	const float * a, * b;
+	typename S::V operator()(unsigned i) const { return S::mul(S::load(a+i), S::load(b+i)); }
+};
+
+template <class S>
+struct NormTerm{
+	const float * a;
+	typename S::V operator()(unsigned i) const { return S::abs(S::load(a+i)); }
+};
+
+template <class S>
+struct AlternatingTerm{
+	const float * a, * sign;
+	typename S::V operator()(unsigned i) const { return S::mul(S::load(a+i), S::load(sign)); }
+};
+
+// Sums terms over vectors, using two vector accumulators to hide add latency
+template <class S, class Term>
+inline unsigned reduce(float& sum, unsigned len, const Term& term){
+	typename S::V a0 = S::set(0.f), a1 = S::set(0.f);
+	unsigned i=0;
+	for(; i+2*S::W<=len; i+=2*S::W){
+		a0 = S::add(a0, term(i));
+		a1 = S::add(a1, term(i+S::W));
+	}
+	for(; i+S::W<=len; i+=S::W) a0 = S::add(a0, term(i));
+	sum = S::sum(S::add(a0, a1));
+	return i;
+}
+
+template <class S>
+unsigned dot(float& sum, const float * src1, const float * src2, unsigned len){
+	const ProductTerm<S> t = {src1, src2};
+	return reduce<S>(sum, len, t);
+}
+
+template <class S>
+unsigned sumNorm(float& sum, const float * src, unsigned len){
+	const NormTerm<S> t = {src};
+	return reduce<S>(sum, len, t);
+}
+
+// Even elements are added and odd elements subtracted
+template <class S>
+unsigned sumAlternating(float& sum, const float * src, unsigned len){
+	static const float sign[] = {1,-1,1,-1,1,-1,1,-1,1,-1,1,-1,1,-1,1,-1};
+	const AlternatingTerm<S> t = {src, sign};
+	return reduce<S>(sum, len & ~1U, t);
+}
+
+// Updates first extreme values of each lane and their indices
+template <class S>
+inline void extremaStep(
+	typename S::V v, typename S::V idx,
+	typename S::V& vmin, typename S::V& imin, typename S::V& vmax, typename S::V& imax
+){
+	typename S::M lo = S::lt(v, vmin), hi = S::lt(vmax, v);
+	vmin = S::sel(lo, v, vmin); imin = S::sel(lo, idx, imin);
+	vmax = S::sel(hi, v, vmax); imax = S::sel(hi, idx, imax);
+}
+
+// Finds first extremes in blocks of two vectors. Values are taken from the
+// first element on, so NaNs are never taken.
+template <class S>
+unsigned extrema(const float * src, unsigned len, unsigned& idxMin, unsigned& idxMax){
+	typedef typename S::V V;
+	const unsigned W = S::W;
+	if(len < 2*W || len >= (1U<<24)) return 0; // indices are tracked as floats
+
+	float lane[2*W];
+	for(unsigned k=0; k<2*W; ++k) lane[k] = float(k) - float(2*W);
+	V vmin0 = S::set(src[0]), vmax0 = vmin0, vmin1 = vmin0, vmax1 = vmin0;
+	V imin0 = S::set(0.f), imax0 = imin0, imin1 = imin0, imax1 = imin0;
+	V idx0 = S::load(lane), idx1 = S::load(lane+W);
+	const V inc = S::set(float(2*W));
+	unsigned i=0;
+	for(; i+2*W<=len; i+=2*W){
+		idx0 = S::add(idx0, inc); idx1 = S::add(idx1, inc);
+		extremaStep<S>(S::load(src+i  ), idx0, vmin0, imin0, vmax0, imax0);
+		extremaStep<S>(S::load(src+i+W), idx1, vmin1, imin1, vmax1, imax1);
+	}
+
+	// Reduce lanes, preferring lower indices of equal values
+	float vlo[2*W], vhi[2*W], ilo[2*W], ihi[2*W];
+	S::store(vlo, vmin0); S::store(vlo+W, vmin1);
+	S::store(vhi, vmax0); S::store(vhi+W, vmax1);
+	S::store(ilo, imin0); S::store(ilo+W, imin1);
+	S::store(ihi, imax0); S::store(ihi+W, imax1);
+	float min = vlo[0], max = vhi[0];
+	idxMin = unsigned(ilo[0]); idxMax = unsigned(ihi[0]);
+	for(unsigned k=1; k<2*W; ++k){
+		unsigned jlo = unsigned(ilo[k]), jhi = unsigned(ihi[k]);
+		if(vlo[k] < min || (vlo[k] == min && jlo < idxMin)){ min = vlo[k]; idxMin = jlo; }
+		if(vhi[k] > max || (vhi[k] == max && jhi < idxMax)){ max = vhi[k]; idxMax = jhi; }
+	}
+	return i;
+}
+
+// Sums a Chebyshev series at M vectors of values
+template <class S, unsigned M>
+inline void chebyshevSum(float * dst, const float * src, const float * coef, unsigned num){
+	typedef typename S::V V;
+	V x2[M], b1[M], b2[M];
+	for(unsigned m=0; m<M; ++m){
+		x2[m] = S::mul(S::set(2.f), S::load(src + m*S::W));
+		b1[m] = b2[m] = S::set(0.f);
+	}
+	for(unsigned k=num; k-->1;){
+		const V c = S::set(coef[k]);
+		for(unsigned m=0; m<M; ++m){
+			V b0 = S::add(S::mul(x2[m], b1[m]), S::sub(c, b2[m]));
+			b2[m] = b1[m];
+			b1[m] = b0;
+		}
+	}
+	const V c0 = S::set(coef[0]), h = S::set(0.5f);
+	for(unsigned m=0; m<M; ++m){
+		S::store(dst + m*S::W, S::sub(S::add(c0, S::mul(S::mul(h, x2[m]), b1[m])), b2[m]));
+	}
+}
+
+template <class S>
+unsigned chebyshev(float * dst, const float * src, unsigned len, const float * coef, unsigned num){
+	unsigned i=0;
+	for(; i+4*S::W<=len; i+=4*S::W) chebyshevSum<S,4>(dst+i, src+i, coef, num);
+	return i;
+}
+
+// Log base 10 of positive, normal values
+template <class S>
+inline typename S::V log10Pos(typename S::V x){
+	typedef typename S::V V;
+	typedef typename S::I I;
+
+	// Split into exponent and mantissa in [sqrt(1/2), sqrt(2))
+	I b = S::bits(x);
+	V e = S::toFloat(S::addi(S::shr23(b), -127));
+	V m = S::fromBits(S::ori(S::andi(b, 0x7fffff), 0x3f800000));
+	typename S::M big = S::lt(S::set(1.41421356f), m);
+	m = S::sel(big, S::mul(m, S::set(0.5f)), m);
+	e = S::sel(big, S::add(e, S::set(1.f)), e);
+
+	// Polynomial for log(1+f), as Cephes logf
+	V f = S::sub(m, S::set(1.f));
+	V z = S::mul(f, f);
+	V p = S::set(7.0376836292e-2f);
+	p = S::sub(S::mul(p, f), S::set(1.1514610310e-1f));
+	p = S::add(S::mul(p, f), S::set(1.1676998740e-1f));
+	p = S::sub(S::mul(p, f), S::set(1.2420140846e-1f));
+	p = S::add(S::mul(p, f), S::set(1.4249322787e-1f));
+	p = S::sub(S::mul(p, f), S::set(1.6668057665e-1f));
+	p = S::add(S::mul(p, f), S::set(2.0000714765e-1f));
+	p = S::sub(S::mul(p, f), S::set(2.4999993993e-1f));
+	p = S::add(S::mul(p, f), S::set(3.3333331174e-1f));
+	V y = S::sub(S::mul(S::mul(p, f), z), S::mul(z, S::set(0.5f)));
+	y = S::add(y, f);
+	y = S::add(y, S::mul(e, S::set(0.693147180560f)));
+	return S::mul(y, S::set(0.434294481903f));
+}
+
+// Decibels of v normalized so that minDB (normFactor = 20/minDB) is zero
+template <class S>
+inline typename S::V normDB(typename S::V v, float normFactor){
+	typedef typename S::V V;
+	V a = S::abs(v);
+	V r = S::sub(S::set(1.f), S::mul(S::set(normFactor), log10Pos<S>(S::max(a, S::set(1e-37f)))));
+	r = S::xorSign(S::max(r, S::set(0.f)), S::signBit(v));
+	return S::sel(S::lt(S::set(0.f), a), r, S::set(0.f));
+}
+
+template <class S>
+unsigned linToDB(float * arr, unsigned len, float normFactor){
+	unsigned i=0;
+	for(; i+S::W<=len; i+=S::W) S::store(arr+i, normDB<S>(S::load(arr+i), normFactor));
+	return i;
+}
+
+// Compares each lane with both neighbors, then emits indices of set bits.
+// This starts at element 1 and returns the number of elements after it done.
+template <class S>
+unsigned maxima(unsigned * dst, unsigned& num, const float * src, unsigned len){
+	unsigned i=1;
+	for(; i+S::W < len; i+=S::W){
+		typename S::V curr = S::load(src+i);
+		unsigned m = S::bitmask(S::lt(S::load(src+i-1), curr))
+				   & S::bitmask(S::lt(S::load(src+i+1), curr));
+		for(unsigned k=i; m; ++k, m>>=1){
+			if(m & 1) dst[num++] = k;
+		}
+	}
+	return i-1;
+}
+
+// Emits indices of the set bits of each comparison mask
+template <class S>
+unsigned above(unsigned * dst, unsigned& num, const float * src, unsigned len, float thresh){
+	const typename S::V t = S::set(thresh);
+	const unsigned all = (1u << S::W) - 1;
+	unsigned i=0;
+	for(; i+S::W <= len; i+=S::W){
+		unsigned m = ~S::bitmask(S::lt(S::load(src+i), t)) & all;
+		for(unsigned k=i; m; ++k, m>>=1){
+			dst[num] = k;
+			num += m & 1;
+		}
+	}
+	return i;
+}
+
+// Masks of positive and negative lanes; a lane crosses when it is positive
+// (negative) and the one before it was not
+template <class S>
+unsigned zeroCross(unsigned& count, const float * src, unsigned len, float prevVal){
+	const typename S::V zero = S::set(0.f);
+	unsigned prevP = prevVal > 0.f, prevN = prevVal < 0.f;
+	unsigned i=0;
+	for(; i+S::W<=len; i+=S::W){
+		typename S::V v = S::load(src+i);
+		unsigned p = S::bitmask(S::lt(zero, v));
+		unsigned n = S::bitmask(S::lt(v, zero));
+		unsigned m = (p & ~((p<<1) | prevP)) | (n & ~((n<<1) | prevN));
+		for(; m; m &= m-1) ++count;
+		prevP = p >> (S::W-1);
+		prevN = n >> (S::W-1);
+	}
+	return i;
+}
+
+// Scans forward a vector at a time until one holds a value over threshold
+template <class S>
+unsigned headBelowNorm(const float * src, unsigned len, float thresh){
+	const typename S::V t = S::set(thresh);
+	const unsigned all = (1u<<S::W) - 1;
+	unsigned i=0;
+	for(; i+S::W<=len; i+=S::W){
+		if(S::bitmask(S::lt(S::abs(S::load(src+i)), t)) != all) break;
+	}
+	return i;
+}
+
+// Scans back a vector at a time until one holds a value over threshold;
+// returns number of elements at the end done
+template <class S>
+unsigned tailBelowNorm(const float * src, unsigned len, float thresh){
+	const typename S::V t = S::set(thresh);
+	const unsigned all = (1u<<S::W) - 1;
+	unsigned i=len;
+	for(; i>=S::W; i-=S::W){
+		if(S::bitmask(S::lt(S::abs(S::load(src+i-S::W)), t)) != all) break;
+	}
+	return len - i;
+}
@@ -0,0 +1,638 @@
+#ifndef GAMMA_FFT_NATIVE_H_INC
+#define GAMMA_FFT_NATIVE_H_INC
+
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	File description:
+	Vectorized radix-4 Stockham FFT for power-of-two sizes
+
+	Each pass reads one buffer and writes the other in natural order, so no
+	bit-reversal is needed. Radix-4 passes are applied while possible with a
+	final radix-2 pass for odd powers of two. Passes after the first have
+	strides that are multiples of four complex elements, so their butterflies
+	are vectorized across the stride with a single broadcast twiddle. The
+	first pass (stride one) is vectorized across twiddles instead.
+
+	Transforms are unnormalized and follow fftpack's sign conventions.
+*/
+
+#include <cmath>
+#include <vector>
+
+#if defined(__AVX__)
+	#include <immintrin.h>
+	#define GAM_FFT_AVX
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GAM_FFT_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_FFT_NEON
+#endif
+
+namespace gam{
+namespace fftnative{
+
+// Complex vector operations.
+// Each type holds N interleaved complex numbers and provides:
+//	load/store		unaligned access of N complex numbers
+//	dup				broadcast one complex number
+//	add/sub			element-wise sum and difference
+//	mul				complex product
+//	mulnj/mulpj		product with -j and +j
+//	lo/hi			for N=2, the first/second element of each of two vectors
+
+template <class T>
+struct Scalar{
+	static const int N = 1;
+	struct V{ T r, i; };
+	static V load(const T * p){ V v = {p[0], p[1]}; return v; }
+	static void store(T * p, const V& v){ p[0]=v.r; p[1]=v.i; }
+	static V dup(const T * p){ return load(p); }
+	static V add(const V& a, const V& b){ V v = {a.r+b.r, a.i+b.i}; return v; }
+	static V sub(const V& a, const V& b){ V v = {a.r-b.r, a.i-b.i}; return v; }
+	static V mul(const V& a, const V& w){ V v = {a.r*w.r - a.i*w.i, a.r*w.i + a.i*w.r}; return v; }
+	static V mulnj(const V& a){ V v = { a.i, -a.r}; return v; }
+	static V mulpj(const V& a){ V v = {-a.i,  a.r}; return v; }
+};
+
+#ifdef GAM_FFT_SSE2
+struct SSE{
+	static const int N = 2;
+	typedef __m128 V;
+	static V load(const float * p){ return _mm_loadu_ps(p); }
+	static void store(float * p, V v){ _mm_storeu_ps(p, v); }
+	static V dup(const float * p){ return _mm_castpd_ps(_mm_load1_pd((const double *)p)); }
+	static V add(V a, V b){ return _mm_add_ps(a, b); }
+	static V sub(V a, V b){ return _mm_sub_ps(a, b); }
+	static V mul(V a, V w){
+		V wr = _mm_shuffle_ps(w, w, _MM_SHUFFLE(2,2,0,0));
+		V wi = _mm_shuffle_ps(w, w, _MM_SHUFFLE(3,3,1,1));
+		V as = _mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1));
+		return _mm_add_ps(_mm_mul_ps(a, wr), _mm_xor_ps(_mm_mul_ps(as, wi), signRe()));
+	}
+	static V mulnj(V a){ return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)), signIm()); }
+	static V mulpj(V a){ return _mm_xor_ps(_mm_shuffle_ps(a, a, _MM_SHUFFLE(2,3,0,1)), signRe()); }
+	static V lo(V a, V b){ return _mm_movelh_ps(a, b); }
+	static V hi(V a, V b){ return _mm_movehl_ps(b, a); }
+	static V signRe(){ return _mm_setr_ps(-0.f, 0.f, -0.f, 0.f); }
+	static V signIm(){ return _mm_setr_ps(0.f, -0.f, 0.f, -0.f); }
+};
+
+struct SSEd{
+	static const int N = 1;
+	typedef __m128d V;
+	static V load(const double * p){ return _mm_loadu_pd(p); }
+	static void store(double * p, V v){ _mm_storeu_pd(p, v); }
+	static V dup(const double * p){ return load(p); }
+	static V add(V a, V b){ return _mm_add_pd(a, b); }
+	static V sub(V a, V b){ return _mm_sub_pd(a, b); }
+	static V mul(V a, V w){
+		V wr = _mm_unpacklo_pd(w, w);
+		V wi = _mm_unpackhi_pd(w, w);
+		V as = _mm_shuffle_pd(a, a, 1);
+		return _mm_add_pd(_mm_mul_pd(a, wr), _mm_xor_pd(_mm_mul_pd(as, wi), _mm_setr_pd(-0., 0.)));
+	}
+	static V mulnj(V a){ return _mm_xor_pd(_mm_shuffle_pd(a, a, 1), _mm_setr_pd(0., -0.)); }
+	static V mulpj(V a){ return _mm_xor_pd(_mm_shuffle_pd(a, a, 1), _mm_setr_pd(-0., 0.)); }
+};
+#endif
+
+#ifdef GAM_FFT_AVX
+struct AVX{
+	static const int N = 4;
+	typedef __m256 V;
+	static V load(const float * p){ return _mm256_loadu_ps(p); }
+	static void store(float * p, V v){ _mm256_storeu_ps(p, v); }
+	static V dup(const float * p){ return _mm256_castpd_ps(_mm256_broadcast_sd((const double *)p)); }
+	static V add(V a, V b){ return _mm256_add_ps(a, b); }
+	static V sub(V a, V b){ return _mm256_sub_ps(a, b); }
+	static V mul(V a, V w){
+		V wr = _mm256_moveldup_ps(w);
+		V wi = _mm256_movehdup_ps(w);
+		V as = _mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1));
+		return _mm256_addsub_ps(_mm256_mul_ps(a, wr), _mm256_mul_ps(as, wi));
+	}
+	static V mulnj(V a){ return _mm256_xor_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1)), signIm()); }
+	static V mulpj(V a){ return _mm256_xor_ps(_mm256_permute_ps(a, _MM_SHUFFLE(2,3,0,1)), signRe()); }
+	static V signRe(){ return _mm256_setr_ps(-0.f,0.f,-0.f,0.f,-0.f,0.f,-0.f,0.f); }
+	static V signIm(){ return _mm256_setr_ps(0.f,-0.f,0.f,-0.f,0.f,-0.f,0.f,-0.f); }
+};
+#endif
+
+#ifdef GAM_FFT_NEON
+struct NEON{
+	static const int N = 2;
+	typedef float32x4_t V;
+	static V load(const float * p){ return vld1q_f32(p); }
+	static void store(float * p, V v){ vst1q_f32(p, v); }
+	static V dup(const float * p){ float32x2_t w = vld1_f32(p); return vcombine_f32(w, w); }
+	static V add(V a, V b){ return vaddq_f32(a, b); }
+	static V sub(V a, V b){ return vsubq_f32(a, b); }
+	static V mul(V a, V w){
+		float32x4x2_t t = vtrnq_f32(w, w); // {wr,wr,..}, {wi,wi,..}
+		V as = vrev64q_f32(a);
+		return vaddq_f32(vmulq_f32(a, t.val[0]), vmulq_f32(vmulq_f32(as, t.val[1]), signRe()));
+	}
+	static V mulnj(V a){ return vmulq_f32(vrev64q_f32(a), signIm()); }
+	static V mulpj(V a){ return vmulq_f32(vrev64q_f32(a), signRe()); }
+	static V lo(V a, V b){ return vcombine_f32(vget_low_f32(a), vget_low_f32(b)); }
+	static V hi(V a, V b){ return vcombine_f32(vget_high_f32(a), vget_high_f32(b)); }
+	static V signRe(){ const float s[4] = {-1.f, 1.f,-1.f, 1.f}; return vld1q_f32(s); }
+	static V signIm(){ const float s[4] = { 1.f,-1.f, 1.f,-1.f}; return vld1q_f32(s); }
+};
+#endif
+
+// Vector types used for passes with stride >= 4 (Wide) and stride 1 (Narrow)
+template <class T> struct Arch{
+	typedef Scalar<T> Wide;
+	typedef Scalar<T> Narrow;
+};
+
+#if defined(GAM_FFT_SSE2)
+template<> struct Arch<float>{
+	#ifdef GAM_FFT_AVX
+	typedef AVX Wide;
+	#else
+	typedef SSE Wide;
+	#endif
+	typedef SSE Narrow;
+};
+template<> struct Arch<double>{
+	typedef SSEd Wide;
+	typedef SSEd Narrow;
+};
+#elif defined(GAM_FFT_NEON)
+template<> struct Arch<float>{
+	typedef NEON Wide;
+	typedef NEON Narrow;
+};
+#endif
+
+
+// Four channels of float, one in each lane of a vector
+#if defined(GAM_FFT_SSE2) || defined(GAM_FFT_NEON)
+struct Lanes4{
+	static const int N = 4;
+	#ifdef GAM_FFT_SSE2
+	typedef __m128 V;
+	Lanes4(float x): v(_mm_set1_ps(x)){}
+	Lanes4 operator+(const Lanes4& b) const { return _mm_add_ps(v, b.v); }
+	Lanes4 operator-(const Lanes4& b) const { return _mm_sub_ps(v, b.v); }
+	Lanes4 operator*(const Lanes4& b) const { return _mm_mul_ps(v, b.v); }
+	Lanes4 operator-() const { return _mm_xor_ps(v, _mm_set1_ps(-0.f)); }
+	#else
+	typedef float32x4_t V;
+	Lanes4(float x): v(vdupq_n_f32(x)){}
+	Lanes4 operator+(const Lanes4& b) const { return vaddq_f32(v, b.v); }
+	Lanes4 operator-(const Lanes4& b) const { return vsubq_f32(v, b.v); }
+	Lanes4 operator*(const Lanes4& b) const { return vmulq_f32(v, b.v); }
+	Lanes4 operator-() const { return vnegq_f32(v); }
+	#endif
+	Lanes4(){}
+	Lanes4(V x): v(x){}
+
+	// Load elements [i, i+4) of four channels into out[0..3]
+	static void load(Lanes4 * out, const float * const * src, int i){
+		#ifdef GAM_FFT_SSE2
+		V r0 = _mm_loadu_ps(src[0]+i), r1 = _mm_loadu_ps(src[1]+i);
+		V r2 = _mm_loadu_ps(src[2]+i), r3 = _mm_loadu_ps(src[3]+i);
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		out[0] = r0; out[1] = r1; out[2] = r2; out[3] = r3;
+		#else
+		transpose(out, vld1q_f32(src[0]+i), vld1q_f32(src[1]+i), vld1q_f32(src[2]+i), vld1q_f32(src[3]+i));
+		#endif
+	}
+
+	// Store in[0..3] into elements [i, i+4) of four channels
+	static void store(float * const * dst, int i, const Lanes4 * in){
+		#ifdef GAM_FFT_SSE2
+		V r0 = in[0].v, r1 = in[1].v, r2 = in[2].v, r3 = in[3].v;
+		_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+		_mm_storeu_ps(dst[0]+i, r0); _mm_storeu_ps(dst[1]+i, r1);
+		_mm_storeu_ps(dst[2]+i, r2); _mm_storeu_ps(dst[3]+i, r3);
+		#else
+		Lanes4 t[4];
+		transpose(t, in[0].v, in[1].v, in[2].v, in[3].v);
+		vst1q_f32(dst[0]+i, t[0].v); vst1q_f32(dst[1]+i, t[1].v);
+		vst1q_f32(dst[2]+i, t[2].v); vst1q_f32(dst[3]+i, t[3].v);
+		#endif
+	}
+
+	#ifdef GAM_FFT_NEON
+	static void transpose(Lanes4 * out, V r0, V r1, V r2, V r3){
+		float32x4x2_t t01 = vtrnq_f32(r0, r1);
+		float32x4x2_t t23 = vtrnq_f32(r2, r3);
+		out[0] = vcombine_f32(vget_low_f32 (t01.val[0]), vget_low_f32 (t23.val[0]));
+		out[1] = vcombine_f32(vget_low_f32 (t01.val[1]), vget_low_f32 (t23.val[1]));
+		out[2] = vcombine_f32(vget_high_f32(t01.val[0]), vget_high_f32(t23.val[0]));
+		out[3] = vcombine_f32(vget_high_f32(t01.val[1]), vget_high_f32(t23.val[1]));
+	}
+	#endif
+
+	V v;
+};
+#endif
+
+// Type processing multiple channels at once; N=1 if not supported
+template <class T> struct Lanes{
+	static const int N = 1;
+};
+
+#if defined(GAM_FFT_SSE2) || defined(GAM_FFT_NEON)
+template<> struct Lanes<float>{
+	static const int N = Lanes4::N;
+	typedef Lanes4 type;
+};
+#endif
+
+
+// Radix-4 pass vectorized across the stride; requires s % A::N == 0
+template <class A, bool Inv, class T>
+void pass4Stride(int m, int s, const T * x, T * y, const T * tw){
+	typedef typename A::V V;
+	const T * tw1 = tw;
+	const T * tw2 = tw + 2*m;
+	const T * tw3 = tw + 4*m;
+	for(int p=0; p<m; ++p){
+		V w1 = A::dup(tw1 + 2*p);
+		V w2 = A::dup(tw2 + 2*p);
+		V w3 = A::dup(tw3 + 2*p);
+		const T * x0 = x + 2*s*p;
+		const T * x1 = x0 + 2*s*m;
+		const T * x2 = x1 + 2*s*m;
+		const T * x3 = x2 + 2*s*m;
+		T * y0 = y + 2*s*4*p;
+		T * y1 = y0 + 2*s;
+		T * y2 = y1 + 2*s;
+		T * y3 = y2 + 2*s;
+		for(int q=0; q<2*s; q+=2*A::N){
+			V a = A::load(x0+q), b = A::load(x1+q), c = A::load(x2+q), d = A::load(x3+q);
+			V apc = A::add(a,c), amc = A::sub(a,c);
+			V bpd = A::add(b,d), bmd = A::sub(b,d);
+			V jbmd = Inv ? A::mulpj(bmd) : A::mulnj(bmd);
+			A::store(y0+q, A::add(apc, bpd));
+			A::store(y1+q, A::mul(A::add(amc, jbmd), w1));
+			A::store(y2+q, A::mul(A::sub(apc, bpd), w2));
+			A::store(y3+q, A::mul(A::sub(amc, jbmd), w3));
+		}
+	}
+}
+
+// First radix-4 pass (stride 1) vectorized across twiddles; requires A::N == 2
+// and m even
+template <class A, bool Inv, class T>
+void pass4First(int m, const T * x, T * y, const T * tw){
+	typedef typename A::V V;
+	const T * x1 = x  + 2*m;
+	const T * x2 = x1 + 2*m;
+	const T * x3 = x2 + 2*m;
+	for(int p=0; p<m; p+=2){
+		int i = 2*p;
+		V a = A::load(x+i), b = A::load(x1+i), c = A::load(x2+i), d = A::load(x3+i);
+		V apc = A::add(a,c), amc = A::sub(a,c);
+		V bpd = A::add(b,d), bmd = A::sub(b,d);
+		V jbmd = Inv ? A::mulpj(bmd) : A::mulnj(bmd);
+		V o0 = A::add(apc, bpd);
+		V o1 = A::mul(A::add(amc, jbmd), A::load(tw + i));
+		V o2 = A::mul(A::sub(apc, bpd), A::load(tw + 2*m + i));
+		V o3 = A::mul(A::sub(amc, jbmd), A::load(tw + 4*m + i));
+		T * yp = y + 8*p;
+		A::store(yp   , A::lo(o0, o1));
+		A::store(yp+ 4, A::lo(o2, o3));
+		A::store(yp+ 8, A::hi(o0, o1));
+		A::store(yp+12, A::hi(o2, o3));
+	}
+}
+
+// Selects the first pass for vector types with two complex elements
+template <class A, bool Inv, bool Pair = (A::N == 2)>
+struct First{
+	template <class T>
+	static bool run(int m, const T * x, T * y, const T * tw){
+		if(m & 1) return false;
+		pass4First<A, Inv>(m, x, y, tw);
+		return true;
+	}
+};
+
+template <class A, bool Inv>
+struct First<A, Inv, false>{
+	template <class T>
+	static bool run(int, const T *, T *, const T *){ return false; }
+};
+
+// Radix-4 pass with channels in lanes; each complex element is two values of D
+template <bool Inv, class D, class T>
+void pass4Lanes(int m, int s, const D * x, D * y, const T * tw){
+	const int st = 2*s*m;
+	for(int p=0; p<m; ++p){
+		const D w1r(tw[2*p]), w1i(tw[2*p+1]);
+		const D w2r(tw[2*m+2*p]), w2i(tw[2*m+2*p+1]);
+		const D w3r(tw[4*m+2*p]), w3i(tw[4*m+2*p+1]);
+		for(int q=0; q<s; ++q){
+			const D * a = x + 2*(q + s*p);
+			const D * b = a + st;
+			const D * c = b + st;
+			const D * d = c + st;
+			D apcr = a[0]+c[0], apci = a[1]+c[1];
+			D amcr = a[0]-c[0], amci = a[1]-c[1];
+			D bpdr = b[0]+d[0], bpdi = b[1]+d[1];
+			D bmdr = b[0]-d[0], bmdi = b[1]-d[1];
+			D jr = Inv ? -bmdi : bmdi;
+			D ji = Inv ? bmdr : -bmdr;
+			D * y0 = y + 2*(q + s*4*p);
+			D * y1 = y0 + 2*s;
+			D * y2 = y1 + 2*s;
+			D * y3 = y2 + 2*s;
+			y0[0] = apcr + bpdr; y0[1] = apci + bpdi;
+			D t1r = amcr + jr, t1i = amci + ji;
+			y1[0] = t1r*w1r - t1i*w1i; y1[1] = t1r*w1i + t1i*w1r;
+			D t2r = apcr - bpdr, t2i = apci - bpdi;
+			y2[0] = t2r*w2r - t2i*w2i; y2[1] = t2r*w2i + t2i*w2r;
+			D t3r = amcr - jr, t3i = amci - ji;
+			y3[0] = t3r*w3r - t3i*w3i; y3[1] = t3r*w3i + t3i*w3r;
+		}
+	}
+}
+
+template <class D>
+void pass2Lanes(int s, const D * x, D * y){
+	for(int q=0; q<2*s; ++q){
+		D a = x[q], b = x[2*s+q];
+		y[q] = a + b;
+		y[2*s+q] = a - b;
+	}
+}
+
+template <class A, class T>
+void pass2(int s, const T * x, T * y){
+	typedef typename A::V V;
+	for(int q=0; q<2*s; q+=2*A::N){
+		V a = A::load(x+q), b = A::load(x+2*s+q);
+		A::store(y+q, A::add(a,b));
+		A::store(y+2*s+q, A::sub(a,b));
+	}
+}
+
+
+/// Complex FFT plan for power-of-two sizes >= 4
+template <class T>
+class CPlan{
+public:
+	CPlan(): mN(0) {}
+
+	/// Returns whether this backend supports a size
+	static bool supports(int n){ return n >= 4 && !(n & (n-1)); }
+
+	void resize(int n){
+		if(n == mN) return;
+		mN = n;
+		mFwd.clear();
+		mInv.clear();
+		for(int L=n; L>=4; L>>=2){
+			int m = L/4;
+			for(int k=1; k<=3; ++k){
+				for(int p=0; p<m; ++p){
+					double phs = -2*M_PI*k*p/L;
+					mFwd.push_back(T(std::cos(phs)));
+					mFwd.push_back(T(std::sin(phs)));
+					mInv.push_back(T(std::cos(phs)));
+					mInv.push_back(T(-std::sin(phs)));
+				}
+			}
+		}
+	}
+
+	int size() const { return mN; }
+
+	/// Get number of passes over the data
+	int passes() const {
+		int p = 0;
+		for(int L=mN; L>1; L>>=2) ++p;
+		return p;
+	}
+
+	/// Transform using two buffers of size() complex elements
+
+	/// The first pass reads 'in' and writes 'a', then passes alternate
+	/// between 'a' and 'b'. 'in' may equal 'b', but not 'a'.
+	/// \returns pointer to result, either 'a' or 'b'
+	template <bool Inv>
+	T * transform(const T * in, T * a, T * b) const {
+		typedef typename Arch<T>::Wide W;
+		typedef typename Arch<T>::Narrow Nw;
+		const T * tw = Inv ? &mInv[0] : &mFwd[0];
+		const T * x = in;
+		T * y = a;
+		int s = 1;
+		int L = mN;
+		for(; L>=4; L>>=2){
+			int m = L/4;
+			if(s % W::N == 0)
+				pass4Stride<W, Inv>(m, s, x, y, tw);
+			else if(1 != s || !First<Nw, Inv>::run(m, x, y, tw))
+				pass4Stride<Scalar<T>, Inv>(m, s, x, y, tw);
+			tw += 6*m;
+			s <<= 2;
+			x = y; y = (y == a) ? b : a;
+		}
+		if(2 == L){
+			if(s % W::N == 0)	pass2<W>(s, x, y);
+			else				pass2<Scalar<T> >(s, x, y);
+			x = y;
+		}
+		return const_cast<T *>(x);
+	}
+
+	/// Transform channels held in the lanes of D
+
+	/// \see transform
+	///
+	template <bool Inv, class D>
+	D * transformLanes(const D * in, D * a, D * b) const {
+		const T * tw = Inv ? &mInv[0] : &mFwd[0];
+		const D * x = in;
+		D * y = a;
+		int s = 1;
+		int L = mN;
+		for(; L>=4; L>>=2){
+			int m = L/4;
+			pass4Lanes<Inv>(m, s, x, y, tw);
+			tw += 6*m;
+			s <<= 2;
+			x = y; y = (y == a) ? b : a;
+		}
+		if(2 == L){
+			pass2Lanes(s, x, y);
+			x = y;
+		}
+		return const_cast<D *>(x);
+	}
+
+private:
+	int mN;
+	std::vector<T> mFwd, mInv; // twiddles per pass: [w^p][w^2p][w^3p]
+};
+
+
+// Complex transform of elements or of channels in lanes
+template <bool Inv, class T>
+T * transform(const CPlan<T>& p, const T * in, T * a, T * b){
+	return p.template transform<Inv>(in, a, b);
+}
+
+template <bool Inv, class T, class D>
+D * transform(const CPlan<T>& p, const D * in, D * a, D * b){
+	return p.template transformLanes<Inv>(in, a, b);
+}
+
+
+template <class T> class RPlan;
+
+// Batched real transform of channels in lanes; work is accessed as vectors
+// and must be aligned for them
+template <class T, bool Supported = (Lanes<T>::N > 1)>
+struct RBatch{
+	static const int N = Lanes<T>::N;
+	typedef typename Lanes<T>::type D;
+
+	static int workSize(int n){ return 3*n*N; }
+
+	template <bool Inv>
+	static int run(const RPlan<T>& p, T * const * bufs, int numChans, T * work){
+		const int n = p.size();
+		D * buf = (D *)work;
+		int c = 0;
+		for(; c+N <= numChans; c+=N){
+			for(int i=0; i<n; i+=N) D::load(buf+i, bufs+c, i);
+			if(Inv)	p.inverse(buf, buf+n);
+			else	p.forward(buf, buf+n);
+			for(int i=0; i<n; i+=N) D::store(bufs+c, i, buf+i);
+		}
+		return c;
+	}
+};
+
+template <class T>
+struct RBatch<T, false>{
+	static int workSize(int){ return 0; }
+
+	template <bool Inv>
+	static int run(const RPlan<T>&, T * const *, int, T *){ return 0; }
+};
+
+
+/// Real FFT plan for power-of-two sizes >= 8
+
+/// A real sequence of size n is transformed as a complex sequence of size n/2
+/// followed by a split into even and odd parts. The spectrum is stored as
+/// [r0, r1, i1, ... , r(n/2-1), i(n/2-1), r(n/2)].
+template <class T>
+class RPlan{
+public:
+	RPlan(): mN(0) {}
+
+	static bool supports(int n){ return n >= 8 && !(n & (n-1)); }
+
+	void resize(int n){
+		if(n == mN) return;
+		mN = n;
+		mC.resize(n/2);
+		mTw.resize(n/2 + 2);
+		for(int k=0; k<=n/4; ++k){
+			double phs = -2*M_PI*k/n;
+			mTw[2*k  ] = T(std::cos(phs));
+			mTw[2*k+1] = T(std::sin(phs));
+		}
+	}
+
+	int size() const { return mN; }
+
+	/// Forward transform in place using a work buffer of 2*size() elements
+
+	/// The element type D is either T or holds channels in its lanes.
+	///
+	template <class D>
+	void forward(D * buf, D * work) const {
+		const int h = mN/2;
+		const D half(T(0.5));
+		// Choose buffers so the complex spectrum lands in the work buffer
+		D * w1 = work, * w2 = work + mN;
+		const D * z = (mC.passes() & 1)
+			? transform<false>(mC, buf, w1, w2)
+			: transform<false>(mC, buf, w2, w1);
+
+		buf[0]    = z[0] + z[1];
+		buf[mN-1] = z[0] - z[1];
+
+		for(int k=1; k<=h/2; ++k){
+			// X(k) = E + W^k O, X(h-k) = conj(E) - conj(W^k O)
+			D zr = z[2*k], zi = z[2*k+1];
+			D cr = z[2*(h-k)], ci = z[2*(h-k)+1];
+			D er = half*(zr + cr), ei = half*(zi - ci);		// E
+			D or_ = half*(zi + ci), oi = half*(cr - zr);	// O
+			D wr(mTw[2*k]), wi(mTw[2*k+1]);
+			D tr = wr*or_ - wi*oi, ti = wr*oi + wi*or_;
+			buf[2*k-1] = er + tr;
+			buf[2*k  ] = ei + ti;
+			if(k != h-k){
+				buf[2*(h-k)-1] = er - tr;
+				buf[2*(h-k)  ] = ti - ei;
+			}
+		}
+	}
+
+	/// Inverse transform in place using a work buffer of 2*size() elements
+	template <class D>
+	void inverse(D * buf, D * work) const {
+		const int h = mN/2;
+		D * Z = work;
+		Z[0] = buf[0] + buf[mN-1];
+		Z[1] = buf[0] - buf[mN-1];
+
+		for(int k=1; k<=h/2; ++k){
+			// Z(k) = 2E + 2j W^-k O, where 2E = X(k) + conj X(h-k), 2W^k O = X(k) - conj X(h-k)
+			D xr = buf[2*k-1], xi = buf[2*k];
+			D cr = buf[2*(h-k)-1], ci = buf[2*(h-k)];
+			D er = xr + cr, ei = xi - ci;
+			D dr = xr - cr, di = xi + ci;
+			D wr(mTw[2*k]), wi(-mTw[2*k+1]);
+			D or_ = wr*dr - wi*di, oi = wr*di + wi*dr;
+			Z[2*k  ] = er - oi;
+			Z[2*k+1] = ei + or_;
+			if(k != h-k){
+				Z[2*(h-k)  ] = er + oi;
+				Z[2*(h-k)+1] = or_ - ei;
+			}
+		}
+
+		// Choose buffers so the result lands in the output
+		if(mC.passes() & 1)	transform<true>(mC, Z, buf, Z + mN);
+		else				transform<true>(mC, Z, Z + mN, buf);
+	}
+
+	/// Get size of work buffer needed by transformBatch
+	int batchWorkSize() const { return RBatch<T>::workSize(mN); }
+
+	/// Transform channels in groups that fill the lanes of a vector
+
+	/// \returns number of channels transformed, starting from the first
+	///
+	template <bool Inv>
+	int transformBatch(T * const * bufs, int numChans, T * work) const {
+		return RBatch<T>::template run<Inv>(*this, bufs, numChans, work);
+	}
+
+private:
+	int mN;
+	CPlan<T> mC;
+	std::vector<T> mTw;
+};
+
+} // fftnative::
+} // gam::
+
+#endif
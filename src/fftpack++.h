@@ -184,6 +184,17 @@ void sint2(int *n, double *x, double *wsave, int *ifac);
 /* Initialization routine for (fftpack/sint) */
 void sinti2(int *n, double *wsave, int *ifac);
 
+/* Transforms with separate work (ch) and twiddle (wa) arrays. The twiddles
+   of 'wsave' start at index 2n for complex and n for real transforms. */
+void cfftbw1(int *n, float *c, float *ch, float *wa, int *ifac);
+void cfftfw1(int *n, float *c, float *ch, float *wa, int *ifac);
+void rfftbw1(int *n, float *r, float *ch, float *wa, int *ifac);
+void rfftfw1(int *n, float *r, float *ch, float *wa, int *ifac);
+void cfftbw2(int *n, double *c, double *ch, double *wa, int *ifac);
+void cfftfw2(int *n, double *c, double *ch, double *wa, int *ifac);
+void rfftbw2(int *n, double *r, double *ch, double *wa, int *ifac);
+void rfftfw2(int *n, double *r, double *ch, double *wa, int *ifac);
+
 
 #ifdef __cplusplus
 }
@@ -291,6 +302,18 @@ inline void sint(int *n, double *x, double *wsave, int *ifac){ sint2(n,x,wsave,i
 inline void sinti(int *n, double *wsave, int *ifac){ sinti2(n,wsave,ifac); }
 
 
+/* Transforms with separate work and twiddle arrays */
+
+inline void cfftb(int *n, float *c, float *ch, float *wa, int *ifac){ cfftbw1(n,c,ch,wa,ifac); }
+inline void cfftf(int *n, float *c, float *ch, float *wa, int *ifac){ cfftfw1(n,c,ch,wa,ifac); }
+inline void rfftb(int *n, float *r, float *ch, float *wa, int *ifac){ rfftbw1(n,r,ch,wa,ifac); }
+inline void rfftf(int *n, float *r, float *ch, float *wa, int *ifac){ rfftfw1(n,r,ch,wa,ifac); }
+inline void cfftb(int *n, double *c, double *ch, double *wa, int *ifac){ cfftbw2(n,c,ch,wa,ifac); }
+inline void cfftf(int *n, double *c, double *ch, double *wa, int *ifac){ cfftfw2(n,c,ch,wa,ifac); }
+inline void rfftb(int *n, double *r, double *ch, double *wa, int *ifac){ rfftbw2(n,r,ch,wa,ifac); }
+inline void rfftf(int *n, double *r, double *ch, double *wa, int *ifac){ rfftfw2(n,r,ch,wa,ifac); }
+
+
 }; // fftpack::
 
 
@@ -0,0 +1,288 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include <cstring> // memcpy
+#include "Gamma/Conversion.h"
+#include "Gamma/CPU.h"
+#include "Gamma/ipl.h"
+
+#if defined(__AVX2__)
+	#include <immintrin.h>
+	#define GAM_IPL_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+	#include <emmintrin.h>
+	#define GAM_IPL_SSE2
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_IPL_NEON
+#endif
+
+// Kernels for 16-bit storage types are dispatched at runtime
+#if defined(GAM_CPU_X86) && (defined(__SSE__) || defined(_M_X64))
+	#include <immintrin.h>
+	#define GAM_IPL16_AVX
+#endif
+
+namespace gam{
+namespace ipl{
+
+namespace{
+
+	// Vector operations for the block kernels. taps2() and taps4() gather
+	// the 2 or 4 elements around W positions, one vector per tap.
+	#if defined(GAM_IPL_AVX2)
+	struct Gather{
+		typedef __m256 V;
+		enum{ W = 8 };
+		static V load(const float * p){ return _mm256_loadu_ps(p); }
+		static void store(float * p, V v){ _mm256_storeu_ps(p, v); }
+		static V set(float v){ return _mm256_set1_ps(v); }
+		static V add(V a, V b){ return _mm256_add_ps(a, b); }
+		static V sub(V a, V b){ return _mm256_sub_ps(a, b); }
+		static V mul(V a, V b){ return _mm256_mul_ps(a, b); }
+		static void taps2(const float * s, const int * idx, V& x, V& y){
+			__m256i i = _mm256_loadu_si256((const __m256i *)idx);
+			x = _mm256_i32gather_ps(s  , i, 4);
+			y = _mm256_i32gather_ps(s+1, i, 4);
+		}
+		static void taps4(const float * s, const int * idx, V& w, V& x, V& y, V& z){
+			__m256i i = _mm256_loadu_si256((const __m256i *)idx);
+			w = _mm256_i32gather_ps(s-1, i, 4);
+			x = _mm256_i32gather_ps(s  , i, 4);
+			y = _mm256_i32gather_ps(s+1, i, 4);
+			z = _mm256_i32gather_ps(s+2, i, 4);
+		}
+	};
+	#define GAM_IPL_SIMD
+
+	#elif defined(GAM_IPL_SSE2)
+	// Loading the neighbors of each position and transposing them is faster
+	// than assembling each tap from scalars.
+	struct Gather{
+		typedef __m128 V;
+		enum{ W = 4 };
+		static V load(const float * p){ return _mm_loadu_ps(p); }
+		static void store(float * p, V v){ _mm_storeu_ps(p, v); }
+		static V set(float v){ return _mm_set1_ps(v); }
+		static V add(V a, V b){ return _mm_add_ps(a, b); }
+		static V sub(V a, V b){ return _mm_sub_ps(a, b); }
+		static V mul(V a, V b){ return _mm_mul_ps(a, b); }
+		static V load2(const float * p){	// as one double; p may be unaligned
+			double d;
+			std::memcpy(&d, p, sizeof d);
+			return _mm_castpd_ps(_mm_set_sd(d));
+		}
+		static void taps2(const float * s, const int * idx, V& x, V& y){
+			V ab = _mm_unpacklo_ps(load2(s+idx[0]), load2(s+idx[1]));
+			V cd = _mm_unpacklo_ps(load2(s+idx[2]), load2(s+idx[3]));
+			x = _mm_movelh_ps(ab, cd);
+			y = _mm_movehl_ps(cd, ab);
+		}
+		static void taps4(const float * s, const int * idx, V& w, V& x, V& y, V& z){
+			w = load(s+idx[0]-1); x = load(s+idx[1]-1);
+			y = load(s+idx[2]-1); z = load(s+idx[3]-1);
+			_MM_TRANSPOSE4_PS(w, x, y, z);
+		}
+	};
+	#define GAM_IPL_SIMD
+
+	#elif defined(GAM_IPL_NEON)
+	struct Gather{
+		typedef float32x4_t V;
+		enum{ W = 4 };
+		static V load(const float * p){ return vld1q_f32(p); }
+		static void store(float * p, V v){ vst1q_f32(p, v); }
+		static V set(float v){ return vdupq_n_f32(v); }
+		static V add(V a, V b){ return vaddq_f32(a, b); }
+		static V sub(V a, V b){ return vsubq_f32(a, b); }
+		static V mul(V a, V b){ return vmulq_f32(a, b); }
+		static void taps2(const float * s, const int * idx, V& x, V& y){
+			float32x2x2_t ab = vtrn_f32(vld1_f32(s+idx[0]), vld1_f32(s+idx[1]));
+			float32x2x2_t cd = vtrn_f32(vld1_f32(s+idx[2]), vld1_f32(s+idx[3]));
+			x = vcombine_f32(ab.val[0], cd.val[0]);
+			y = vcombine_f32(ab.val[1], cd.val[1]);
+		}
+		static void taps4(const float * s, const int * idx, V& w, V& x, V& y, V& z){
+			float32x4x2_t ab = vtrnq_f32(load(s+idx[0]-1), load(s+idx[1]-1));
+			float32x4x2_t cd = vtrnq_f32(load(s+idx[2]-1), load(s+idx[3]-1));
+			w = vcombine_f32(vget_low_f32 (ab.val[0]), vget_low_f32 (cd.val[0]));
+			x = vcombine_f32(vget_low_f32 (ab.val[1]), vget_low_f32 (cd.val[1]));
+			y = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+			z = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+		}
+	};
+	#define GAM_IPL_SIMD
+	#endif
+
+	#ifdef GAM_IPL_SIMD
+	typedef Gather S;
+	typedef S::V V;
+
+	// These follow the scalar versions in ipl.h operation for operation
+	inline V linear(V f, V x, V y){
+		return S::add(S::mul(S::sub(y, x), f), x);
+	}
+
+	inline V cubic(V f, V w, V x, V y, V z){
+		V c1 = S::mul(S::sub(y, w), S::set(0.5f));
+		V c3 = S::add(S::mul(S::sub(x, y), S::set(1.5f)), S::mul(S::sub(z, w), S::set(0.5f)));
+		V c2 = S::sub(S::sub(S::add(c1, w), x), c3);
+		return S::add(S::mul(S::add(S::mul(S::add(S::mul(c3, f), c2), f), c1), f), x);
+	}
+
+	inline V lagrange3(V f, V w, V x, V y, V z){
+		V d = S::add(S::set(1.f), f);
+		V d1 = S::sub(d, S::set(1.f));
+		V d2 = S::sub(d, S::set(2.f));
+		V d3 = S::sub(d, S::set(3.f));
+		V h0 = S::mul(S::mul(S::mul(S::sub(S::set(0.f), d1), d2), d3), S::set(float(1./6.)));
+		V h1 = S::mul(S::mul(S::mul(d , d2), d3), S::set(0.5f));
+		V h2 = S::mul(S::mul(S::mul(S::sub(S::set(0.f), d), d1), d3), S::set(0.5f));
+		V h3 = S::mul(S::mul(S::mul(d , d1), d2), S::set(float(1./6.)));
+		return S::add(S::add(S::add(S::mul(w, h0), S::mul(x, h1)), S::mul(y, h2)), S::mul(z, h3));
+	}
+	#endif
+
+
+	// Kernels for samples in 16-bit storage types interpolate the first
+	// positions that fill their vectors and return how many they did; the
+	// rest are done by the scalar loops. A 32-bit gather at a 16-bit element
+	// loads it together with its next neighbor.
+	typedef unsigned (*Kernel16)(float *, const void *, const int *, const float *, unsigned);
+
+	unsigned kernel16None(float *, const void *, const int *, const float *, unsigned){ return 0; }
+
+	#if defined(GAM_IPL16_AVX)
+	// Convert the low and high 16 bits of each gathered element
+	struct Pair16{
+		GAM_TARGET_AVX2 static void split(__m256i p, __m256& lo, __m256& hi){
+			const __m256 s = _mm256_set1_ps(1.f/32768.f);
+			lo = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(p, 16), 16)), s);
+			hi = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(p, 16)), s);
+		}
+	};
+
+	struct PairHalf{
+		GAM_TARGET_AVX2 static void split(__m256i p, __m256& lo, __m256& hi){
+			const __m256i l = _mm256_and_si256(p, _mm256_set1_epi32(0xffff));
+			const __m256i h = _mm256_srli_epi32(p, 16);
+			// pack works within 128-bit lanes, so put the low halves first
+			const __m256i q = _mm256_permute4x64_epi64(_mm256_packus_epi32(l, h), 0xd8);
+			lo = _mm256_cvtph_ps(_mm256_castsi256_si128(q));
+			hi = _mm256_cvtph_ps(_mm256_extracti128_si256(q, 1));
+		}
+	};
+
+	template <class P>
+	GAM_TARGET_AVX2 unsigned linearAVX2(float * dst, const void * src, const int * idx, const float * frac, unsigned len){
+		const int * s = (const int *)src;
+		unsigned i=0;
+		for(; i+8<=len; i+=8){
+			const __m256i k = _mm256_loadu_si256((const __m256i *)(idx+i));
+			__m256 x, y;
+			P::split(_mm256_i32gather_epi32(s, k, 2), x, y);
+			_mm256_storeu_ps(dst+i, _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(y, x), _mm256_loadu_ps(frac+i)), x));
+		}
+		return i;
+	}
+
+	template <class P>
+	GAM_TARGET_AVX2 unsigned cubicAVX2(float * dst, const void * src, const int * idx, const float * frac, unsigned len){
+		const int * sm1 = (const int *)((const int16_t *)src - 1);
+		const int * sp1 = (const int *)((const int16_t *)src + 1);
+		const __m256 half = _mm256_set1_ps(0.5f), oneHalf = _mm256_set1_ps(1.5f);
+		unsigned i=0;
+		for(; i+8<=len; i+=8){
+			const __m256i k = _mm256_loadu_si256((const __m256i *)(idx+i));
+			__m256 w, x, y, z;
+			P::split(_mm256_i32gather_epi32(sm1, k, 2), w, x);
+			P::split(_mm256_i32gather_epi32(sp1, k, 2), y, z);
+			const __m256 f = _mm256_loadu_ps(frac+i);
+			const __m256 c1 = _mm256_mul_ps(_mm256_sub_ps(y, w), half);
+			const __m256 c3 = _mm256_add_ps(_mm256_mul_ps(_mm256_sub_ps(x, y), oneHalf), _mm256_mul_ps(_mm256_sub_ps(z, w), half));
+			const __m256 c2 = _mm256_sub_ps(_mm256_sub_ps(_mm256_add_ps(c1, w), x), c3);
+			_mm256_storeu_ps(dst+i, _mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(_mm256_add_ps(_mm256_mul_ps(c3, f), c2), f), c1), f), x));
+		}
+		return i;
+	}
+	#define GAM_AVX_KERNEL(f) f
+	#else
+	#define GAM_AVX_KERNEL(f) 0
+	#endif
+
+	template <class S>
+	void linear16(Kernel16 kernel, float * dst, const S * src, const int * idx, const float * frac, unsigned len){
+		for(unsigned i = kernel(dst, src, idx, frac, len); i<len; ++i){
+			const S * s = src + idx[i];
+			dst[i] = ipl::linear(frac[i], float(s[0]), float(s[1]));
+		}
+	}
+
+	template <class S>
+	void cubic16(Kernel16 kernel, float * dst, const S * src, const int * idx, const float * frac, unsigned len){
+		for(unsigned i = kernel(dst, src, idx, frac, len); i<len; ++i){
+			const S * s = src + idx[i];
+			dst[i] = ipl::cubic(frac[i], float(s[-1]), float(s[0]), float(s[1]), float(s[2]));
+		}
+	}
+
+} // anonymous::
+
+void linear(float * dst, const float * src, const int * idx, const float * frac, unsigned len){
+	unsigned i=0;
+	#ifdef GAM_IPL_SIMD
+	for(; i+S::W<=len; i+=S::W){
+		V x, y;
+		S::taps2(src, idx+i, x, y);
+		S::store(dst+i, linear(S::load(frac+i), x, y));
+	}
+	#endif
+	linear<float, float>(dst+i, src, idx+i, frac+i, len-i);
+}
+
+void cubic(float * dst, const float * src, const int * idx, const float * frac, unsigned len){
+	unsigned i=0;
+	#ifdef GAM_IPL_SIMD
+	for(; i+S::W<=len; i+=S::W){
+		V w, x, y, z;
+		S::taps4(src, idx+i, w, x, y, z);
+		S::store(dst+i, cubic(S::load(frac+i), w, x, y, z));
+	}
+	#endif
+	cubic<float, float>(dst+i, src, idx+i, frac+i, len-i);
+}
+
+void lagrange3(float * dst, const float * src, const int * idx, const float * frac, unsigned len){
+	unsigned i=0;
+	#ifdef GAM_IPL_SIMD
+	for(; i+S::W<=len; i+=S::W){
+		V w, x, y, z;
+		S::taps4(src, idx+i, w, x, y, z);
+		S::store(dst+i, lagrange3(S::load(frac+i), w, x, y, z));
+	}
+	#endif
+	lagrange3<float, float>(dst+i, src, idx+i, frac+i, len-i);
+}
+
+void linear(float * dst, const Sample16 * src, const int * idx, const float * frac, unsigned len){
+	static SIMDDispatch<Kernel16> kernel(kernel16None, 0, GAM_AVX_KERNEL(linearAVX2<Pair16>));
+	linear16(kernel(), dst, src, idx, frac, len);
+}
+
+void linear(float * dst, const Half * src, const int * idx, const float * frac, unsigned len){
+	static SIMDDispatch<Kernel16> kernel(kernel16None, 0, GAM_AVX_KERNEL(linearAVX2<PairHalf>));
+	linear16(kernel(), dst, src, idx, frac, len);
+}
+
+void cubic(float * dst, const Sample16 * src, const int * idx, const float * frac, unsigned len){
+	static SIMDDispatch<Kernel16> kernel(kernel16None, 0, GAM_AVX_KERNEL(cubicAVX2<Pair16>));
+	cubic16(kernel(), dst, src, idx, frac, len);
+}
+
+void cubic(float * dst, const Half * src, const int * idx, const float * frac, unsigned len){
+	static SIMDDispatch<Kernel16> kernel(kernel16None, 0, GAM_AVX_KERNEL(cubicAVX2<PairHalf>));
+	cubic16(kernel(), dst, src, idx, frac, len);
+}
+
+} // ipl::
+} // gam::
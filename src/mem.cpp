@@ -0,0 +1,138 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information */
+
+#include "Gamma/mem.h"
+
+#if defined(__SSE__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 1)
+	#include <xmmintrin.h>
+	#define GAM_MEM_SSE
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	#include <arm_neon.h>
+	#define GAM_MEM_NEON
+#endif
+
+namespace gam{
+namespace mem{
+
+namespace{
+
+	#if defined(GAM_MEM_SSE)
+	typedef __m128 V4;
+	inline V4 load(const float * p){ return _mm_loadu_ps(p); }
+	inline void store(float * p, V4 v){ _mm_storeu_ps(p, v); }
+	inline void transpose(V4& a, V4& b, V4& c, V4& d){ _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+	// Splits 4 frames of 2 channels into 4 samples of each
+	inline void unzip(V4 a, V4 b, V4& even, V4& odd){
+		even = _mm_shuffle_ps(a, b, _MM_SHUFFLE(2,0,2,0));
+		odd  = _mm_shuffle_ps(a, b, _MM_SHUFFLE(3,1,3,1));
+	}
+
+	// Joins 4 samples of 2 channels into 4 frames
+	inline void zip(V4 even, V4 odd, V4& a, V4& b){
+		a = _mm_unpacklo_ps(even, odd);
+		b = _mm_unpackhi_ps(even, odd);
+	}
+	#define GAM_MEM_SIMD
+
+	#elif defined(GAM_MEM_NEON)
+	typedef float32x4_t V4;
+	inline V4 load(const float * p){ return vld1q_f32(p); }
+	inline void store(float * p, V4 v){ vst1q_f32(p, v); }
+	inline void transpose(V4& a, V4& b, V4& c, V4& d){
+		float32x4x2_t ab = vtrnq_f32(a, b), cd = vtrnq_f32(c, d);
+		a = vcombine_f32(vget_low_f32 (ab.val[0]), vget_low_f32 (cd.val[0]));
+		b = vcombine_f32(vget_low_f32 (ab.val[1]), vget_low_f32 (cd.val[1]));
+		c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+		d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+	}
+	inline void unzip(V4 a, V4 b, V4& even, V4& odd){
+		float32x4x2_t v = vuzpq_f32(a, b); even = v.val[0]; odd = v.val[1];
+	}
+	inline void zip(V4 even, V4 odd, V4& a, V4& b){
+		float32x4x2_t v = vzipq_f32(even, odd); a = v.val[0]; b = v.val[1];
+	}
+	#define GAM_MEM_SIMD
+	#endif
+
+	// Copies samples between frames and channels one frame at a time, so
+	// both arrays are walked sequentially
+	template <bool Interleave>
+	void transposeScalar(float * dst, const float * src, unsigned numFrames, unsigned numChannels, unsigned start){
+		for(unsigned i=start; i<numFrames; ++i){
+			for(unsigned c=0; c<numChannels; ++c){
+				if(Interleave)	dst[i*numChannels + c] = src[c*numFrames + i];
+				else			dst[c*numFrames + i] = src[i*numChannels + c];
+			}
+		}
+	}
+
+} // anonymous::
+
+void deinterleave(float * dst, const float * src, unsigned numFrames, unsigned numChannels){
+	unsigned i=0;
+	#ifdef GAM_MEM_SIMD
+	if(2 == numChannels){
+		float * dst2 = dst + numFrames;
+		for(; i+4<=numFrames; i+=4){
+			V4 a, b;
+			unzip(load(src + 2*i), load(src + 2*i + 4), a, b);
+			store(dst + i, a); store(dst2 + i, b);
+		}
+	}
+	else if(numChannels && 0 == (numChannels & 3)){
+		// Transpose 4x4 blocks of 4 frames by 4 channels
+		for(; i+4<=numFrames; i+=4){
+			const float * s = src + i*numChannels;
+			for(unsigned c=0; c<numChannels; c+=4){
+				V4 a = load(s + c), b = load(s + numChannels + c);
+				V4 d = load(s + 2*numChannels + c), e = load(s + 3*numChannels + c);
+				transpose(a, b, d, e);
+				float * o = dst + c*numFrames + i;
+				store(o, a); store(o + numFrames, b);
+				store(o + 2*numFrames, d); store(o + 3*numFrames, e);
+			}
+		}
+	}
+	#endif
+	transposeScalar<false>(dst, src, numFrames, numChannels, i);
+}
+
+void interleave(float * dst, const float * src, unsigned numFrames, unsigned numChannels){
+	unsigned i=0;
+	#ifdef GAM_MEM_SIMD
+	if(2 == numChannels){
+		const float * src2 = src + numFrames;
+		for(; i+4<=numFrames; i+=4){
+			V4 a, b;
+			zip(load(src + i), load(src2 + i), a, b);
+			store(dst + 2*i, a); store(dst + 2*i + 4, b);
+		}
+	}
+	else if(numChannels && 0 == (numChannels & 3)){
+		for(; i+4<=numFrames; i+=4){
+			float * o = dst + i*numChannels;
+			for(unsigned c=0; c<numChannels; c+=4){
+				const float * s = src + c*numFrames + i;
+				V4 a = load(s), b = load(s + numFrames);
+				V4 d = load(s + 2*numFrames), e = load(s + 3*numFrames);
+				transpose(a, b, d, e);
+				store(o + c, a); store(o + numChannels + c, b);
+				store(o + 2*numChannels + c, d); store(o + 3*numChannels + c, e);
+			}
+		}
+	}
+	#endif
+	transposeScalar<true>(dst, src, numFrames, numChannels, i);
+}
+
+void deinterleave2(float * dst, const float * src, unsigned numFrames){
+	deinterleave(dst, src, numFrames, 2);
+}
+
+void interleave2(float * dst, const float * src, unsigned numFrames){
+	interleave(dst, src, numFrames, 2);
+}
+
+} // mem::
+} // gam::
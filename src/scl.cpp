@@ -2,11 +2,69 @@
 	See COPYRIGHT file for authors and license information */
 
 #include <cctype> // tolower
+#include <cstring> // memcpy
 #include "Gamma/scl.h"
 
+// Compile AVX2 clones of the array functions, dispatched through ifuncs
+#if defined(__GNUC__) && !defined(__clang__) && defined(__x86_64__) && defined(__linux__) && !defined(__AVX2__)
+	#define GAM_SCL_ARRAY __attribute__((target_clones("avx2","default")))
+#else
+	#define GAM_SCL_ARRAY
+#endif
+
 namespace gam{
 namespace scl{
 
+GAM_SCL_ARRAY void sinFast(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = sinFast(src[i]);
+}
+
+GAM_SCL_ARRAY void sinP7(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = sinP7(src[i]);
+}
+
+GAM_SCL_ARRAY void sinP9(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = sinP9(src[i]);
+}
+
+GAM_SCL_ARRAY void cosP3(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i) dst[i] = cosP3(src[i]);
+}
+
+GAM_SCL_ARRAY void log2Fast(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		int32_t b;
+		std::memcpy(&b, src+i, 4); // union punning does not vectorize
+		dst[i] = float(b - int32_t(Expo1<float>())) * 0.0000001192092896f;
+	}
+}
+
+GAM_SCL_ARRAY void pow2Fast(float * dst, const float * src, unsigned len){
+	for(unsigned i=0; i<len; ++i){
+		// Clamping after scaling keeps the selects convertible to min/max
+		float v = src[i] * 8388608.f;
+		v = v > -126.f*8388608.f ? v : -126.f*8388608.f;
+		v = v < 127.f*8388608.f ? v : 127.f*8388608.f;
+		const int32_t b = int32_t(v) + int32_t(Expo1<float>());
+		std::memcpy(dst+i, &b, 4);
+	}
+}
+
+GAM_SCL_ARRAY void atan2Fast(float * dst, const float * y, const float * x, unsigned len){
+	// As the scalar version, with the branches turned into selects
+	for(unsigned i=0; i<len; ++i){
+		float yi = y[i], xi = x[i];
+		float ay = std::fabs(yi) + 1e-10f;
+		float sx = xi < 0.f ? -1.f : 1.f;
+		float r = (xi - sx*ay) / (sx*xi + ay);
+		float angle = float(M_3PI_4) - float(M_PI_4)*(sx + 1.f);
+		angle += (0.1963f*r*r - 0.9817f)*r;
+		dst[i] = yi < 0.f ? -angle : angle;
+	}
+}
+
+#undef GAM_SCL_ARRAY
+
 bool almostEqual(float a, float b, int maxUlps){
 	// Make sure maxUlps is non-negative and small enough that the
 	// default NAN won't compare as equal to anything.
@@ -0,0 +1,122 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	Microbenchmarks of arr::, ipl:: and mem:: primitives. Each float version is timed
+	against the generic version it specializes. Strided functions are called
+	with a unit stride known only at run time.
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <vector>
+#include "../Gamma/arr.h"
+#include "../Gamma/ipl.h"
+
+using namespace gam;
+
+namespace{
+
+	const unsigned N = 4096;	// Elements per call
+	const unsigned E = 80000000;// Elements per measurement
+	volatile float sink;
+	volatile unsigned stride = 1; // Unit stride unknown at compile time
+
+	// Returns nanoseconds per element of a call processing n elements
+	template <class F>
+	double time(F f, unsigned n){
+		const unsigned R = E/n;
+		f(); // warm up
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for(unsigned r=0; r<R; ++r) f();
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double(R)*n);
+	}
+
+	template <class Fg, class Fs>
+	void bench(const char * name, Fg generic, Fs special, unsigned n=N){
+		double tg = time(generic, n), ts = time(special, n);
+		printf("%-20s generic %6.3f ns  float %6.3f ns  speedup %5.2f\n", name, tg, ts, tg/ts);
+	}
+}
+
+int main(){
+	std::vector<float> a(8*1024), b(N), c(8*1024);
+	for(unsigned i=0; i<N; ++i){
+		a[i] = std::sin(0.01f*i);
+		b[i] = std::cos(0.03f*i);
+	}
+	float * pa = &a[0], * pb = &b[0], * pc = &c[0];
+
+	bench("dot",
+		[=]{ sink = arr::dot<float>(pa, pb, N, stride); },
+		[=]{ sink = arr::dot(pa, pb, N, stride); });
+	bench("sumSquares",
+		[=]{ sink = arr::sumSquares<float>(pa, N, stride); },
+		[=]{ sink = arr::sumSquares(pa, N, stride); });
+	bench("rms",
+		[=]{ sink = std::sqrt(arr::dot<float>(pa, pa, N, stride)) / N; },
+		[=]{ sink = arr::rms(pa, N, stride); });
+	bench("meanNorm",
+		[=]{ sink = arr::meanNorm<float>(pa, N, stride); },
+		[=]{ sink = arr::meanNorm(pa, N, stride); });
+	bench("nyquist",
+		[=]{ sink = arr::nyquist<float>(pa, N, stride); },
+		[=]{ sink = arr::nyquist(pa, N, stride); });
+	bench("extrema",
+		[=]{ int lo, hi; arr::extrema(pa, N, lo, hi); sink = lo + hi; },
+		[=]{ unsigned lo, hi; arr::extrema(pa, N, lo, hi); sink = lo + hi; });
+	static unsigned idx[N/2+1], bins[256];
+	bench("maxima",
+		[=]{ sink = arr::maxima<unsigned,float>(idx, pa, N, stride); },
+		[=]{ sink = arr::maxima(idx, pa, N, stride); });
+	bench("histogram",
+		[=]{ arr::histogram<float,unsigned>(pa, N, bins, 256, 128.f, 128.f); },
+		[=]{ arr::histogram(pa, N, bins, 256, 128.f, 128.f); });
+	bench("zeroCross",
+		[=]{ sink = arr::zeroCross<float>(pa, N, 0.f); },
+		[=]{ sink = arr::zeroCross(pa, N, 0.f); });
+	bench("tailBelowNorm",
+		[=]{ sink = arr::tailBelowNorm<float>(pa, N, 2.f); },
+		[=]{ sink = arr::tailBelowNorm(pa, N, 2.f); });
+	static const float cheb[17] = {0, 1, .5f, .33f, .25f, .2f, .17f, .14f, .125f, .11f, .1f, .09f, .083f, .077f, .071f, .067f, .062f};
+	bench("chebyshev",
+		[=]{ arr::chebyshev<float>(pc, pa, N, cheb, 17); },
+		[=]{ arr::chebyshev(pc, pa, N, cheb, 17); });
+	bench("linToDB",
+		[=]{ for(unsigned i=0; i<N; ++i){ float v = std::fabs(pa[i]); pc[i] = v ? std::copysign(std::fmax(1.f + std::log10(v)/6.f, 0.f), pa[i]) : 0.f; } },
+		[=]{ std::copy(pa, pa+N, pc); arr::linToDB(pc, N, -120.f); });
+
+	// Fractional reads of a modulated delay line
+	static int pos[N]; static float frac[N];
+	for(unsigned i=0; i<N; ++i){
+		double p = 100 + 0.9*i + 50*std::sin(0.01*i);
+		pos[i] = int(p); frac[i] = float(p - pos[i]);
+	}
+	bench("ipl::linear",
+		[=]{ ipl::linear<float,float>(pc, pa, pos, frac, N); },
+		[=]{ ipl::linear(pc, pa, pos, frac, N); });
+	bench("ipl::cubic",
+		[=]{ ipl::cubic<float,float>(pc, pa, pos, frac, N); },
+		[=]{ ipl::cubic(pc, pa, pos, frac, N); });
+	bench("ipl::lagrange3",
+		[=]{ ipl::lagrange3<float,float>(pc, pa, pos, frac, N); },
+		[=]{ ipl::lagrange3(pc, pa, pos, frac, N); });
+
+	const unsigned chans[] = {2, 4, 8};
+	for(unsigned frames = 64; frames <= 1024; frames *= 4){
+		for(unsigned k=0; k<3; ++k){
+			const unsigned C = chans[k], n = frames*C;
+			char name[32];
+			snprintf(name, sizeof name, "deinterleave %ux%u", C, frames);
+			bench(name,
+				[=]{ mem::deinterleave<float>(pc, pa, frames, C); },
+				[=]{ mem::deinterleave(pc, pa, frames, C); }, n);
+			snprintf(name, sizeof name, "interleave %ux%u", C, frames);
+			bench(name,
+				[=]{ mem::interleave<float>(pc, pa, frames, C); },
+				[=]{ mem::interleave(pc, pa, frames, C); }, n);
+		}
+	}
+}
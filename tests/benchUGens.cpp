@@ -0,0 +1,206 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	Benchmarks of unit generators. Each one is timed sample by sample and,
+	where it has a block API, in blocks of several sizes. Results are printed
+	as nanoseconds per sample and multiples of real time at 44.1 kHz, and are
+	written as JSON to the file named by the first argument (default
+	bench.json in the working directory, which is build/bin/ when run by
+	'make bench') for tracking across releases.
+*/
+
+#include <stdio.h>
+#include <chrono>
+#include <cmath>
+#include <string>
+#include <vector>
+#include "../Gamma/Chain.h"
+#include "../Gamma/Delay.h"
+#include "../Gamma/DFT.h"
+#include "../Gamma/Effects.h"
+#include "../Gamma/Envelope.h"
+#include "../Gamma/Filter.h"
+#include "../Gamma/Granular.h"
+#include "../Gamma/Noise.h"
+#include "../Gamma/Oscillator.h"
+#include "../Gamma/SamplePlayer.h"
+#include "../Gamma/Spatial.h"
+
+using namespace gam;
+
+namespace{
+
+	const double SPU = 44100;
+	const unsigned N = 4096;		// Samples per call
+	const unsigned E = 4000000;		// Samples per measurement
+	const unsigned blocks[] = {16, 64, 256, 1024};
+
+	struct Result{
+		std::string name;
+		unsigned block;				// 0 for per-sample API
+		double ns;					// nanoseconds per sample
+	};
+	std::vector<Result> results;
+
+	float in[N], out[N];
+	volatile float sink;
+
+	// Returns nanoseconds per sample of a call processing N samples
+	template <class F>
+	double time(F f){
+		const unsigned R = E/N;
+		f(); // warm up
+		std::chrono::steady_clock::time_point t0 = std::chrono::steady_clock::now();
+		for(unsigned r=0; r<R; ++r){ f(); sink = out[r & (N-1)]; }
+		std::chrono::steady_clock::time_point t1 = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(t1 - t0).count() / (double(R)*N);
+	}
+
+	void report(const char * name, unsigned block, double ns){
+		char api[24];
+		if(block) snprintf(api, sizeof api, "block %u", block);
+		else snprintf(api, sizeof api, "sample");
+		printf("%-16s %-10s %8.3f ns %10.1fx\n", name, api, ns, 1e9/SPU/ns);
+		results.push_back({name, block, ns});
+	}
+
+	// Time a per-sample function, called as s(i) for each sample i
+	template <class S>
+	void benchSample(const char * name, S s){
+		report(name, 0, time([&]{ for(unsigned i=0; i<N; ++i) out[i] = s(i); }));
+	}
+
+	// Time a block function, called as b(dst, src, n) on each block of N samples
+	template <class B>
+	void benchBlock(const char * name, B b){
+		for(unsigned len : blocks){
+			report(name, len, time([&]{ for(unsigned i=0; i<N; i+=len) b(out+i, in+i, len); }));
+		}
+	}
+
+	template <class S, class B>
+	void bench(const char * name, S s, B b){
+		benchSample(name, s);
+		benchBlock(name, b);
+	}
+
+	bool writeJSON(const char * path){
+		FILE * fp = fopen(path, "w");
+		if(!fp) return false;
+		fprintf(fp, "{\n\t\"spu\": %g,\n\t\"results\": [\n", SPU);
+		for(unsigned i=0; i<results.size(); ++i){
+			const Result& r = results[i];
+			fprintf(fp, "\t\t{\"name\": \"%s\", \"block\": %u, \"ns_per_sample\": %.4f, \"x_realtime\": %.2f}%s\n",
+				r.name.c_str(), r.block, r.ns, 1e9/SPU/r.ns, i+1<results.size() ? "," : "");
+		}
+		fprintf(fp, "\t]\n}\n");
+		fclose(fp);
+		return true;
+	}
+}
+
+int main(int argc, char ** argv){
+	Domain::master().spu(SPU);
+	for(unsigned i=0; i<N; ++i) in[i] = 0.5f*std::sin(0.01f*i) + 0.1f*std::sin(0.37f*i);
+
+	// Generators
+	{	Sine<> s(440);
+		benchSample("Sine", [&](unsigned){ return s(); }); }
+	{	Osc<> o1(440), o2(440); o1.addSine(1); o2.addSine(1);
+		bench("Osc", [&](unsigned){ return o1(); }, [&](float * d, const float *, unsigned n){ o2(d, n); }); }
+	{	Saw<> s1(440), s2(440);
+		bench("Saw", [&](unsigned){ return s1(); }, [&](float * d, const float *, unsigned n){ s2(d, n); }); }
+	{	Buzz<> b1(220, 0, 20), b2(220, 0, 20);
+		bench("Buzz", [&](unsigned){ return b1(); }, [&](float * d, const float *, unsigned n){ b2(d, n); }); }
+	{	DSF<> d1(220, 1, 12, 0.7), d2(220, 1, 12, 0.7);
+		bench("DSF", [&](unsigned){ return d1(); }, [&](float * d, const float *, unsigned n){ d2(d, n); }); }
+	{	SineBank<> sb(64);
+		for(unsigned k=0; k<64; ++k) sb.set(k, 100*(k+1), 1./(k+1));
+		benchBlock("SineBank 64", [&](float * d, const float *, unsigned n){ sb(d, n); }); }
+	{	NoiseWhite<> n1, n2;
+		bench("NoiseWhite", [&](unsigned){ return n1(); }, [&](float * d, const float *, unsigned n){ n2(d, n); }); }
+	{	NoisePink<> n1, n2;
+		bench("NoisePink", [&](unsigned){ return n1(); }, [&](float * d, const float *, unsigned n){ n2(d, n); }); }
+	{	Env<3> e1(0, 0.01, 1, 0.2, 0.5, 0.5, 0), e2(e1);
+		e1.loop(true); e2.loop(true);
+		bench("Env<3>", [&](unsigned){ return e1(); }, [&](float * d, const float *, unsigned n){ e2(d, n); }); }
+	{	Array<float> buf(44100);
+		for(unsigned i=0; i<buf.size(); ++i) buf[i] = std::sin(0.05*i);
+		SamplePlayer<> sp(buf, SPU, 1.3);
+		benchSample("SamplePlayer", [&](unsigned){ float v = sp(); sp.advance(); if(sp.done()) sp.reset(); return v; }); }
+	{	std::vector<float> buf(44100*4);
+		for(unsigned i=0; i<buf.size(); ++i) buf[i] = std::sin(0.05*i);
+		GrainCloud gc(1000);
+		gc.source(&buf[0], buf.size());
+		float R[1024];
+		unsigned seed = 1;
+		benchBlock("GrainCloud 1k", [&](float * d, const float *, unsigned n){
+			while(gc.size() < 1000){
+				seed = seed*1664525 + 1013904223;
+				gc.grain(float(seed>>16)*2, 0.1, 0.5 + (seed & 255)/256.f, 1e-3, 0, seed % n);
+			}
+			for(unsigned i=0; i<n; ++i) d[i] = R[i] = 0;
+			gc.render(d, R, n);
+		}); }
+
+	// Filters
+	{	Biquad<> b1(1000, 4), b2(1000, 4);
+		bench("Biquad", [&](unsigned i){ return b1(in[i]); }, [&](float * d, const float * s, unsigned n){ b2(d, s, n); }); }
+	{	OnePole<> o1(1000), o2(1000);
+		bench("OnePole", [&](unsigned i){ return o1(in[i]); }, [&](float * d, const float * s, unsigned n){ o2(d, s, n); }); }
+	{	AllPass1<> a1(1000), a2(1000);
+		bench("AllPass1", [&](unsigned i){ return a1(in[i]); }, [&](float * d, const float * s, unsigned n){ a2(d, s, n); }); }
+	{	MovingAvg<> m1(32), m2(32);
+		bench("MovingAvg", [&](unsigned i){ return m1(in[i]); }, [&](float * d, const float * s, unsigned n){ m2(d, s, n); }); }
+	{	Hilbert<> h1, h2; float im[1024];
+		bench("Hilbert", [&](unsigned i){ return h1(in[i]).r; }, [&](float * d, const float * s, unsigned n){ h2(d, im, s, n); }); }
+
+	// Delays and reverbs
+	{	Delay<float, ipl::Linear> d1(0.1, 0.0123), d2(0.1, 0.0123);
+		bench("Delay", [&](unsigned i){ return d1(in[i]); }, [&](float * d, const float * s, unsigned n){ d2.process(s, d, n); }); }
+	{	Comb<float, ipl::Linear> c1(0.1, 0.0123, 0.5, 0.4), c2(c1);
+		bench("Comb", [&](unsigned i){ return c1(in[i]); }, [&](float * d, const float * s, unsigned n){ c2.process(s, d, n); }); }
+	{	ReverbMS<> r1, r2;
+		r1.resize(JCREVERB).decay(2); r2.resize(JCREVERB).decay(2);
+		bench("ReverbMS", [&](unsigned i){ return r1(in[i]); }, [&](float * d, const float * s, unsigned n){ r2.process(s, d, n); }); }
+	{	ReverbFDN<> r1, r2;
+		bench("ReverbFDN", [&](unsigned i){ return r1(in[i]); }, [&](float * d, const float * s, unsigned n){ r2.process(s, d, n); }); }
+	{	Chorus<> c1, c2;
+		bench("Chorus", [&](unsigned i){ return c1(in[i]); }, [&](float * d, const float * s, unsigned n){ c2.process(s, d, n); }); }
+
+	// Effects
+	{	FreqShift<> f1(100), f2(100);
+		bench("FreqShift", [&](unsigned i){ return f1(in[i]); }, [&](float * d, const float * s, unsigned n){ f2(d, s, n); }); }
+	{	Quantizer<> q1(SPU, 1./256), q2(q1);
+		bench("Quantizer", [&](unsigned i){ return q1(in[i]); }, [&](float * d, const float * s, unsigned n){ q2(d, s, n); }); }
+	{	ChebyN<16> c;
+		for(unsigned k=0; k<16; ++k) c.c[k] = 1.f/(k+1);
+		bench("ChebyN<16>", [&](unsigned i){ return c(in[i]); }, [&](float * d, const float * s, unsigned n){ c(d, s, n); }); }
+	{	PluckBank pb(64);
+		for(unsigned s=0; s<64; ++s) pb.freq(s, 80 + 10*s).decay(s, 1e6).pluck(s);
+		benchBlock("PluckBank 64", [&](float * d, const float *, unsigned n){ pb(d, n); }); }
+
+	// Saw >> Biquad * Env: hand-chained per sample, fused in blocks and split into
+	// one block call per unit
+	{	Saw<> s1(220), s2(220), s3(220);
+		Biquad<> b1(1000, 4), b2(1000, 4), b3(1000, 4);
+		Env<3> e1(0, 0.01, 1, 0.2, 0.5, 0.5, 0), e2(e1), e3(e1);
+		e1.loop(true); e2.loop(true); e3.loop(true);
+		auto voice = s2 >> b2 * e2;
+		float env[1024];
+		bench("Chain",
+			[&](unsigned){ return b1(s1()) * e1(); },
+			[&](float * d, const float *, unsigned n){ generate(voice, d, n); });
+		benchBlock("Chain split", [&](float * d, const float *, unsigned n){
+			s3(d, n); b3(d, d, n); e3(env, n);
+			for(unsigned i=0; i<n; ++i) d[i] *= env[i];
+		}); }
+
+	// Spectral
+	{	STFT stft(1024, 256, 0, HANN, MAG_PHASE);
+		benchSample("STFT 1024/256", [&](unsigned i){ return float(stft(in[i])); }); }
+
+	const char * path = argc > 1 ? argv[1] : "bench.json";
+	if(writeJSON(path)) printf("Wrote %s\n", path);
+	else printf("Could not write %s\n", path);
+}
@@ -0,0 +1,97 @@
+/*	Gamma - Generic processing library
+	See COPYRIGHT file for authors and license information
+
+	Voice-count stress test of the instruments in examples/synths. Each
+	instrument is added to a Scheduler a growing number of times and rendered
+	by the offline backend of AudioIO at a fixed block size. A voice count is
+	sustainable when no more than 1% of its blocks take longer than the block
+	period. The count is doubled until it fails and then refined by
+	bisection, giving the maximum polyphony of one core. The block size may
+	be given as the first argument (default 256).
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "../examples/synths/FM.h"
+#include "../examples/synths/PluckedString.h"
+#include "../examples/synths/SineEnv.h"
+#include "../examples/synths/Sub.h"
+
+namespace{
+
+	const double SPU = 44100;
+	const double SECONDS = 1;		// audio rendered per measurement
+	const unsigned MAX_VOICES = 1<<16;
+
+	struct Trial{
+		double worst;	// longest block, as fraction of block period
+		double mean;	// mean block, as fraction of block period
+		bool ok;
+	};
+
+	// Render 'voices' instances of T with the offline backend of 'io'
+	template <class T>
+	Trial run(AudioIO& io, unsigned voices){
+		Scheduler s;
+		s.queueSize(voices < 1024 ? 1024 : voices*2);
+		s.reserve<T>(voices);
+		for(unsigned i=0; i<voices; ++i){
+			s.add<T>(0).dur(SECONDS*60).freq(110 + (i % 64)*7.3).amp(1./voices);
+		}
+		io.user(&s);
+
+		// Blocks in which the voices start are not counted
+		io.render(1);
+		io.resetTelemetry();
+
+		const uint64_t numBlocks = uint64_t(SECONDS*SPU/io.framesPerBuffer());
+		const uint64_t maxMisses = numBlocks/100;
+		AudioTelemetry t;
+		do{
+			io.render(8);
+			io.telemetry(t);
+		} while(t.blocks < numBlocks && t.late <= maxMisses);
+
+		double period = t.period * 1e9;
+		return Trial{t.duration.max / period, t.duration.mean() / period, t.late <= maxMisses};
+	}
+
+	template <class T>
+	void stress(const char * name, AudioIO& io){
+		unsigned lo = 0, hi = 1;
+		Trial best = {0,0,true};
+
+		// Double until unsustainable, then bisect
+		for(; hi<=MAX_VOICES; hi*=2){
+			Trial t = run<T>(io, hi);
+			if(!t.ok) break;
+			lo = hi; best = t;
+		}
+		while(hi <= MAX_VOICES && hi - lo > 1){
+			unsigned mid = (lo + hi)/2;
+			Trial t = run<T>(io, mid);
+			if(t.ok){ lo = mid; best = t; }
+			else hi = mid;
+		}
+
+		double nsPerVoice = lo ? best.mean * 1e9/SPU / lo : 0;
+		printf("%-14s %8u%s %12.2f %9.0f%% %9.0f%%\n",
+			name, lo, hi>MAX_VOICES ? "+" : " ", nsPerVoice, best.mean*100, best.worst*100);
+	}
+}
+
+int main(int argc, char ** argv){
+	int block = argc > 1 ? atoi(argv[1]) : 256;
+	if(block <= 0) block = 256;
+	gam::sampleRate(SPU);
+
+	AudioIO io(block, SPU, Scheduler::audioCB, 0, 2, 0);
+	if(!io.open(AudioIO::OFFLINE)) return -1;
+
+	printf("Block size %d at %g Hz, one core\n", block, SPU);
+	printf("%-14s %9s %12s %10s %10s\n", "instrument", "voices", "ns/voice", "mean load", "max load");
+	stress<SineEnv>("SineEnv", io);
+	stress<FM>("FM", io);
+	stress<PluckedString>("PluckedString", io);
+	stress<Sub>("Sub", io);
+}
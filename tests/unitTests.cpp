@@ -1,10 +1,23 @@
 #undef NDEBUG
 #include <assert.h>
 #include <stdio.h>
+#include <stdlib.h>
 #include <math.h>
+#include <algorithm>
+#include <chrono>
 #include <complex>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <type_traits>
+#ifndef _WIN32
+#include <unistd.h> // gethostname
+#endif
 #define GAMMA_H_INC_ALL
 #include "../Gamma/Gamma.h"
+#include "../Gamma/HRFilter.h"
 
 using namespace gam;
 
@@ -53,6 +66,31 @@ int main(int argc, char* argv[]){
 		assert(ft(1.5/N) == 1.5);
 	}
 
+	// UnitMapper tables
+	{
+		UnitMapper<float> um(8000, 20, 3, UnitMapper<float>::MAP_POW);
+		UnitMapper<float> ut(um);
+		ut.table(256);
+		assert(256 == ut.tableSize());
+		float in[100], out[100];
+		for(int i=0; i<100; ++i) in[i] = i/80.f - 0.1f;
+		ut.map(out, in, 100);
+		for(int i=0; i<100; ++i){
+			assert(out[i] == ut.map(in[i]));
+			assert(near(out[i], um.map(in[i]), 8000*1e-4));
+		}
+		assert(ut.map(1.5f) == 8000 && ut.map(-1.f) == 20); // clipped
+		ut.set(10, 4, 1, UnitMapper<float>::MAP_EXP2); // 2^4 to 2^10
+		assert(256 == ut.tableSize() && near(ut.map(0.5f), 128, 0.01));
+		// Linear mappings are not tabulated, but keep the size for later types
+		ut.set(10, 4, 1, UnitMapper<float>::MAP_LIN);
+		assert(256 == ut.tableSize() && ut.map(0.5f) == 7);
+		ut.set(8000, 20, 3, UnitMapper<float>::MAP_POW);
+		assert(256 == ut.tableSize() && ut.map(0.3f) != um.map(0.3f) && near(ut.map(0.3f), um.map(0.3f), 8000*1e-4));
+		ut.table(0);
+		assert(0 == ut.tableSize() && ut.map(0.3f) == um.map(0.3f));
+	}
+
 	#include "ut/utTypes.cpp"
 	#include "ut/utConversion.cpp"
 	#include "ut/utContainers.cpp"
@@ -72,6 +110,9 @@ int main(int argc, char* argv[]){
 	#include "ut/utEnvelope.cpp"
 	#include "ut/utFilter.cpp"
 	#include "ut/utGenerators.cpp"
+	#include "ut/utScheduler.cpp"
+
+	#include "ut/utPerf.cpp"
 
 //	printf("Unit testing succeeded.\n");
 
@@ -15,6 +15,35 @@
 		assert(Clip::map(3,2,1) == 2);
 	}
 
+	// Slices with unit and non-unit strides
+	{
+		float a[8] = {1,2,3,4,5,6,7,8};
+		double b[4] = {1,1,1,1};
+		Slice<float> s(a, 4, 2), c(a, 8);
+		s += slice(b, 4);				// mixed element types
+		assert(a[0] == 2 && a[1] == 2 && a[6] == 8 && a[7] == 8);
+		c *= 2.f;
+		assert(a[0] == 4 && a[7] == 16 && c.sum() == 80);
+		c /= a[0];						// value is read before the loop
+		assert(a[0] == 1 && a[7] == 4);
+		s.copy(slice(a, 4, 1, 4));
+		assert(a[0] == 3 && a[2] == 3 && a[4] == 4 && a[6] == 4);
+		assert(s.reversed()[0] == a[6]);
+	}
+
+	// Index maps over arrays of positions
+	{
+		IndexMap<float> m(8, 2.f);
+		float x[3] = {0.f, 0.3f, 1.9f}, f[3];
+		index_t i[3];
+		m(i, f, x, 3);
+		for(int k=0; k<3; ++k){
+			float fk; assert(i[k] == m(x[k], fk) && near(f[k], fk, 1e-6));
+		}
+		m(i, x, 3);
+		assert(i[0] == 0 && i[1] == 1 && i[2] == 7);
+	}
+
 	#undef ASSERT
 	#undef SET
 	#undef PRINT
@@ -36,40 +36,49 @@
 		for(unsigned i=0; i<a->size(); ++i) assert((*a)[i] == 123);
 		assert(a->elems() == b->elems());
 		assert(a->size() == b->size());
-		assert(array_t::references(a->elems()) == 2);
+		assert(a->references() == 2);
 
 		a->clear();
 		assert(a->size() == 0);
 		assert(a->elems() == 0);
+		assert(a->references() == 0);
 
 		delete a;
-		assert(array_t::references(b->elems()) == 1);
-		
+		assert(b->references() == 1 && b->isSoleOwner());
+
+		// Raw pointers are referenced externally
 		array_t * c = new array_t(b->elems(), b->size());
-		assert(array_t::references(b->elems()) == 2);
+		assert(c->references() == 0 && c->usingExternalSource());
+		assert(b->references() == 1);
+		delete c;
+
+		c = new array_t;
+		c->source(*b);
+		assert(b->references() == 2);
 
 		delete b;
-		assert(array_t::references(c->elems()) == 1);
-		
-		t * elemsC = c->elems();
+		assert(c->references() == 1);
 		delete c;
-		assert(array_t::references(elemsC) == 0);
 		
 		a = new array_t(N, 123);
 		b = new array_t(*a);
 		
 		b->own();
 		assert(a->elems() != b->elems());
-		assert(array_t::references(a->elems()) == 1);
-		assert(array_t::references(b->elems()) == 1);
+		assert(a->references() == 1);
+		assert(b->references() == 1);
 		for(unsigned i=0; i<a->size(); ++i) assert((*b)[i] == 123);
 		
-		t * elemsA = a->elems();
 		t * elemsB = b->elems();
 		a->source(*b);
-		assert(a->elems() == b->elems());
-		assert(array_t::references(elemsA) == 0);
-		assert(array_t::references(elemsB) == 2);
+		assert(a->elems() == elemsB);
+		assert(b->references() == 2);
+
+		// Owning copies externally referenced elements
+		c = new array_t(elemsB, N);
+		c->own();
+		assert(c->elems() != elemsB && c->isSoleOwner() && (*c)[N-1] == 123);
+		delete c; delete b; delete a;
 	}
 
 
@@ -85,8 +94,410 @@
 		assert(d(5) == 3);
 	}
 	
+	{
+		SPSCQueue<int> q(3);
+		assert(q.capacity() == 4);
+		assert(q.empty());
+		assert(q.front() == 0);
+
+		for(int i=0; i<4; ++i) assert(q.push(i));
+		assert(q.full());
+		assert(!q.push(4));
+		assert(q.overflows() == 1);
+
+		int v;
+		assert(q.pop(v) && v == 0);
+		assert(*q.front() == 1);
+		q.pop();
+		assert(q.size() == 2);
+
+		// wrap around end of buffer
+		assert(q.push(5) && q.push(6));
+		for(int i : {2,3,5,6}){ assert(q.pop(v) && v == i); }
+		assert(!q.pop(v));
+	}
+
+	{
+		MPSCQueue<int> q(3);
+		assert(q.capacity() == 4);
+		assert(q.empty());
+
+		for(int i=0; i<4; ++i) assert(q.push(i));
+		assert(q.size() == 4);
+		assert(!q.push(4));
+		assert(q.overflows() == 1);
+
+		int v;
+		assert(q.pop(v) && v == 0);
+		assert(q.pop(v) && v == 1);
+
+		// wrap around end of buffer
+		assert(q.push(5) && q.push(6));
+		for(int i : {2,3,5,6}){ assert(q.pop(v) && v == i); }
+		assert(!q.pop(v));
+		assert(q.empty());
+	}
+
+	// Table cache shares generated tables and restores them from a file
+	{
+		TableCache<float> c;
+		ArrayPow2<float>& w1 = c.wave(SAW, 64, 8);
+		ArrayPow2<float>& w2 = c.wave(SAW, 64, 8);
+		Array<float>& h = c.window(HANN, 33);
+		assert(&w1 == &w2);
+		assert(&w1 != &c.wave(SAW, 64, 4));
+		assert(c.size() == 3);
+
+		float ref[64] = {0}, win[33];
+		addWave(ref, 64, SAW, 8);
+		tbl::window(win, 33, HANN);
+		for(int i=0;i<64;++i) assert(w1[i] == ref[i]);
+		for(int i=0;i<33;++i) assert(h[i] == win[i]);
+
+		// Arrays sourced from the cache share its memory
+		Osc<> o(1, 0, w1);
+		assert(o.elems() == w1.elems());
+
+		const char * path = "tableCache.bin";
+		assert(c.save(path));
+		TableCache<float> d;
+		assert(d.load(path));
+		remove(path);
+		assert(d.size() == 3);
+		const double params[] = {double(SAW), 8.};
+		ArrayPow2<float>& w3 = d.tablePow2("wave", 0, 64, params, 2);
+		for(int i=0;i<64;++i) assert(w3[i] == ref[i]);
+		assert(d.size() == 3);
+
+		// Sizes past the end of the file and power-of-two tables of other
+		// sizes are rejected
+		auto writeTable = [path](uint32_t len, uint32_t size, uint8_t pow2){
+			FILE * f = fopen(path, "wb");
+			const char magic[8] = {'G','A','M','T','B','L','1', char(sizeof(float))};
+			const uint32_t n = 1, np = 0;
+			const float v[3] = {1,2,3};
+			fwrite(magic, 1, 8, f); fwrite(&n, 4, 1, f);
+			fwrite(&len, 4, 1, f); fwrite("t", 1, 1, f);
+			fwrite(&size, 4, 1, f); fwrite(&pow2, 1, 1, f); fwrite(&np, 4, 1, f);
+			fwrite(v, sizeof(float), 3, f);
+			fclose(f);
+		};
+		TableCache<float> e;
+		writeTable(0xffffffff, 3, 0); assert(!e.load(path));
+		writeTable(1, 0x40000000, 0); assert(!e.load(path));
+		writeTable(1, 3, 1); assert(!e.load(path));
+		assert(e.size() == 0);
+		writeTable(1, 3, 0); assert(e.load(path) && e.size() == 1);
+		remove(path);
+	}
+
 //	{ Array<t> a(N); }
 //	{ ArrayPow2<t> a(N); }
 //	{ Ring<t> a(N); }
 //	{ DoubleRing<t> a(N); a.copy(); }
+
+	// Aligned allocators
+	{
+		Array<float, AlignedAllocator<float> > a(13, 1.f);
+		Ring<double, AlignedAllocator<double, 128> > r(7);
+		assert((uintptr_t(a.elems()) & 63) == 0 && (uintptr_t(r.elems()) & 127) == 0);
+		a.resize(1000, 2.f);
+		assert((uintptr_t(a.elems()) & 63) == 0 && a[12] == 1.f && a[999] == 2.f);
+
+		const unsigned N = (hugePageSize() * 2) / sizeof(float);
+		ArrayPow2<float, HugePageAllocator<float> > h(N, 0.5f);
+		assert((uintptr_t(h.elems()) & 63) == 0 && h[0] == 0.5f && h[N-1] == 0.5f);
+
+		float * m = 0;
+		assert(mem::resizeAligned(m, 0, 5) && (uintptr_t(m) & 63) == 0);
+		for(int i=0; i<5; ++i) m[i] = i;
+		assert(mem::resizeAligned(m, 5, 9) && m[4] == 4);
+		mem::freeAligned(m);
+		assert(0 == m);
+	}
+
+	// Memory pool counts blocks in use, its peak and failed allocations
+	{
+		MemoryPool pool(3, 4);
+		assert(pool.capacity() == 4 && pool.blockSize() >= sizeof(unsigned));
+		assert(0 == pool.used() && 0 == pool.peak() && 0 == pool.failures());
+		void * b[5];
+		for(int i=0; i<4; ++i){
+			b[i] = pool.allocate();
+			assert(b[i] && pool.owns(b[i]));
+			assert(pool.used() == unsigned(i+1) && pool.peak() == unsigned(i+1));
+		}
+		b[4] = pool.allocate();
+		assert(!b[4] && 1 == pool.failures() && 4 == pool.used());
+		pool.deallocate(b[1]);
+		pool.deallocate(b[3]);
+		assert(2 == pool.used() && 4 == pool.peak());
+		void * c = pool.allocate();
+		assert((c == b[1] || c == b[3]) && 3 == pool.used() && 4 == pool.peak());
+		pool.deallocate(c);
+		pool.deallocate(b[0]);
+		pool.deallocate(b[2]);
+		assert(0 == pool.used() && 4 == pool.peak() && 1 == pool.failures());
+		int x;
+		assert(!pool.owns(&x));
+	}
+
+	// Arena allocator
+	{
+		MemoryArena arena(4096);
+		typedef Array<float, ArenaAllocator<float> > ArenaArray;
+		ArenaArray * a;
+		{	MemoryArena::Scope s(arena);
+			assert(MemoryArena::current() == &arena);
+			a = new ArenaArray(100, 1.f);
+			DelayN<float, ArenaAllocator<float> > d(64);
+			assert(arena.owns(a->elems()) && arena.owns(&d[0]));
+			assert((uintptr_t(a->elems()) & 63) == 0);
+			ArenaArray big(4096);
+			assert(!big.valid() && arena.failures() == 1);
+		}
+		assert(0 == MemoryArena::current());
+		ArenaArray h(10, 2.f);
+		assert(!arena.owns(h.elems()) && h[9] == 2.f);
+		assert((*a)[99] == 1.f);
+		delete a;
+		arena.reset();
+		assert(0 == arena.used());
+
+		// Containers may outlive a reset that hands their memory out again
+		{	MemoryArena::Scope s(arena);
+			a = new ArenaArray(16, 1.f);
+			arena.reset();
+			ArenaArray b(32, 0.f);
+			assert(b.elems() == a->elems());
+			delete a;
+			assert(b[0] == 0.f && b[31] == 0.f);
+		}
+		assert(MemoryArena::ownedByAny(arena.allocate(1)));
+		assert(!MemoryArena::ownedByAny(h.elems()));
+	}
+
+	// Allocation accounting
+	{
+		memoryTrackingStart();
+		memoryTrackingClear();
+		float * m = 0;
+		std::size_t bytes;
+		{	MemoryTag t1("utAlloc");
+			Array<float> a(100);
+			bytes = a.sizeInBytes();
+			assert(bytes >= 400);
+			{	MemoryTag t2("utAllocInner");
+				mem::resizeAligned(m, 0, 32);
+			}
+			MemoryStats s = memoryStats("utAlloc");
+			assert(s.allocations == 1 && s.live == (long long)bytes && s.bytes == bytes);
+		}
+		MemoryStats s = memoryStats("utAlloc");
+		assert(s.allocations == 1 && s.deallocations == 1 && s.live == 0 && s.peak == (long long)bytes);
+		assert(memoryStats("utAllocInner").live == 32*4);
+		mem::freeAligned(m);	// credited to tag allocated under
+		assert(memoryStats("utAllocInner").live == 0);
+
+		MemoryStats all[GAM_MEMORY_TAGS];
+		unsigned n = memoryStats(all, GAM_MEMORY_TAGS);
+		assert(n >= 2);
+		FILE * fp = tmpfile();
+		if(fp){
+			memoryReport(fp);
+			assert(ftell(fp) > 0);
+			fclose(fp);
+		}
+		memoryTrackingStop();
+		assert(!memoryTracking());
+		assert(memoryStats("none").allocations == 0);
+
+		Delay<float> d(0.1, 0.05);
+		assert(d.sizeInBytes() >= d.size()*sizeof(float));
+		STFT stft(1024, 256, 0, HANN, MAG_FREQ);
+		assert(stft.sizeInBytes() >= (4*1024 + 2*513)*sizeof(float));
+		ReverbMS<> rv;
+		rv.resize(JCREVERB);
+		assert(rv.sizeInBytes() > 4500*sizeof(float));
+		ReverbFDN<float, 4, LoopGain, ipl::Linear, Domain1> fdn;
+		fdn.delays(100, 400);
+		assert(fdn.sizeInBytes() >= 4*100*sizeof(float) && fdn.sizeInBytes() < 8*400*sizeof(float));
+	}
+
+	// Real-time checks
+	{
+		struct Counter{
+			static void handler(RTViolation t, void * u){ ++((unsigned *)u)[t]; }
+		};
+		unsigned counts[RT_VIOLATIONS] = {0};
+		rtViolationHandler(Counter::handler, counts);
+		rtViolationsClear();
+		rtViolation(RT_ALLOC);
+		assert(!rtThread() && 0 == rtViolations());
+		{	RTScope rt;
+			assert(rtThread());
+			rtViolation(RT_LOCK);
+			{	RTScope off(false);
+				assert(!rtThread());
+				rtViolation(RT_LOCK);
+			}
+			assert(rtThread());
+			if(rtCheckIntercepts()){
+				// Called through pointers so they are not elided
+				void * (* volatile alloc)(size_t) = malloc;
+				void (* volatile dealloc)(void *) = free;
+				dealloc(alloc(16));
+				std::mutex m;
+				m.lock(); m.unlock();
+			}
+		}
+		assert(!rtThread());
+		if(rtCheckIntercepts()){
+			assert(1 == rtViolations(RT_ALLOC) && 1 == rtViolations(RT_FREE));
+			assert(2 == rtViolations(RT_LOCK) && 2 == counts[RT_LOCK]);
+		}
+		else{
+			assert(1 == rtViolations() && 1 == counts[RT_LOCK]);
+		}
+		rtViolationHandler(0);
+		rtViolationsClear();
+	}
+
+	// Move and view
+	{
+		Array<int> a(8, 3);
+		const int * e = a.elems();
+		Array<int> b(std::move(a));
+		assert(b.elems() == e && b.size() == 8 && b.isSoleOwner());
+		assert(!a.valid() && a.size() == 0);
+		Array<int> c(4);
+		c = std::move(b);
+		assert(c.elems() == e && c[7] == 3 && c.references() == 1);
+
+		ArrayView<int> v(c);
+		assert(v.elems() == e && v.size() == 8);
+		v[0] = 2;
+		assert(c[0] == 2);
+		ArrayView<const int> s = v.slice(6, 4);
+		assert(s.size() == 2 && s[1] == 3);
+		std::vector<float> w(5);
+		assert(ArrayView<float>(w).size() == 5 && ArrayView<const float>(w).elems() == &w[0]);
+	}
+
+	// Block writes and mirrored ring
+	{
+		int src[23];
+		for(int i=0; i<23; ++i) src[i] = i;
+		for(unsigned len=0; len<23; ++len){
+			Ring<int> r1(7, -1), r2(7, -1);
+			MirrorRing<int> m(7, -1);
+			r1.pos(4); r2.pos(4);
+			for(unsigned i=0; i<len; ++i){ r1(src[i]); m(src[i]); }
+			r2.write(src, len);
+			assert(r1.pos() == r2.pos());
+			for(unsigned i=0; i<7; ++i) assert(r1[i] == r2[i]);
+
+			MirrorRing<int> m2(7, -1);
+			m2.write(src, 3); if(len >= 3) m2.write(src+3, len-3);
+			const int * w = m.latest(7);
+			for(unsigned i=0; i<7; ++i) assert(w[i] == r1.read(6-i) && m.read(i) == r1.read(i));
+			if(len >= 4) assert(m2.readFront() == src[len-1] && m2.latest(4)[0] == src[len-4]);
+			if(len >= 3) assert(m2.read()[0] == m.read()[0]);
+		}
+	}
+
+	// Node3 links back to left siblings, and from the first to the last child
+	{
+		struct N : public Node3<N>{};
+
+		// Check parent and prev links of children of all nodes in a tree
+		auto linked = [](N& root){
+			for(N * n = &root; n; n = n->next(&root)){
+				N * last = 0;
+				for(N * c = n->child; c; c = c->sibling){
+					if(c->parent != n) return false;
+					if(last && c->prev != last) return false;
+					last = c;
+				}
+				if(n->child && n->child->prev != last) return false;
+				if(n->lastChild() != last) return false;
+			}
+			return true;
+		};
+
+		N r, a, b, c, d, a1, a2;
+		r.addLastChild(&b);
+		r.addFirstChild(&a);
+		r.addLastChild(&c);
+		a.addLastChild(&a1);
+		a.addLastChild(&a2);
+		assert(linked(r) && r.child == &a && a.sibling == &b && r.lastChild() == &c);
+
+		// Depth-first order
+		N * order[] = {&a, &a1, &a2, &b, &c};
+		N * n = &r;
+		for(N * o : order){ n = n->next(&r); assert(n == o); }
+		assert(n->next(&r) == 0);
+
+		// Remove middle, last and first children
+		b.removeFromParent();
+		assert(linked(r) && a.sibling == &c && c.prev == &a);
+		assert(!b.parent && !b.sibling && !b.prev);
+		c.removeFromParent();
+		assert(linked(r) && r.lastChild() == &a && a.prev == &a);
+		r.addLastChild(&c);
+		a.removeFromParent();
+		assert(linked(r) && r.child == &c && c.prev == &c);
+		assert(a.child == &a1 && linked(a));	// subtree kept
+
+		// Moving a subtree removes it from its old parent
+		r.addLastChild(&d);
+		d.addFirstChild(&a2);
+		assert(linked(r) && linked(a) && a.child == &a1 && a1.prev == &a1);
+		r.addFirstChild(&a);
+		assert(linked(r) && r.child == &a && r.lastChild() == &d);
+		c.removeFromParent(); d.removeFromParent(); a.removeFromParent();
+		assert(!r.child && !r.lastChild());
+	}
+
+	// Recorder
+	{
+		// 4 stereo frames; one is kept free, so 3 can be buffered
+		Recorder rec(2, 4);
+		float src[2*8];
+		for(int i=0; i<8; ++i){ src[2*i] = i; src[2*i+1] = -i; }
+		float * buf = 0;
+		auto frameIs = [](const float * f, int i){ return f[0] == i && f[1] == -i; };
+
+		assert(rec.frames() == 4 && rec.writable() == 3 && rec.read(buf) == 0 && !buf);
+
+		// Overflow drops the newest frames, not the unread ones
+		assert(rec.write(src, 5) == 3);
+		assert(rec.dropped() == 2 && rec.writable() == 0);
+		assert(rec.read(buf) == 3);
+		for(int i=0; i<3; ++i) assert(frameIs(buf+2*i, i));
+		assert(rec.writable() == 3);
+
+		// Wrap across the end of the ring
+		assert(rec.write(src+2*4, 2) == 2);
+		const float * b1, * b2; int n1, n2;
+		assert(rec.peek(b1,n1, b2,n2) == 2 && n1 == 1 && n2 == 1);
+		assert(frameIs(b1, 4) && frameIs(b2, 5));
+
+		// Per-frame writes drop once full
+		rec.write(6.f, -6.f);
+		assert(!rec.writable());
+		rec.overwrite(7.f, 0); rec.overwrite(-7.f, 1);
+		assert(!rec.advance() && rec.dropped() == 3);
+		assert(rec.read(buf) == 3);
+		for(int i=0; i<3; ++i) assert(frameIs(buf+2*i, 4+i));
+		float * prev = buf;
+		assert(rec.read(buf) == 0 && buf == prev);
+
+		// Partial release
+		assert(rec.write(src, 3) == 3);
+		rec.release(2);
+		assert(rec.writable() == 2);
+		assert(rec.read(buf) == 1 && frameIs(buf, 2));
+	}
 }
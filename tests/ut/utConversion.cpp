@@ -71,4 +71,51 @@
 	#define T(x, y) assert(unitToUInt8(x) == y);
 	T(0, 0) T(1./4, 64) T(1./2, 128) T(3./4, 192)
 	#undef T
+
+	#define T(x, y) assert(unitToInt(x) == y);
+	T(0, 0) T(-1, -32768) T(0.5, 16384) T(1, 32767) T(-2, -32768) T(1./65536, 0)
+	#undef T
+
+	#define T(x, y) assert(floatToHalf(x) == y && halfToFloat(y) == x);
+	T(0.f, 0) T(-0.f, 0x8000) T(1.f, 0x3c00) T(-2.f, 0xc000) T(65504.f, 0x7bff)
+	T(0.5f, 0x3800) T(6.103515625e-05f, 0x0400) T(5.9604644775390625e-08f, 0x0001)
+	#undef T
+	assert(floatToHalf(1e6f) == 0x7c00 && floatToHalf(-1.f/0.f) == 0xfc00);
+	assert(floatToHalf(1.f + 1.f/2048) == 0x3c00);	// ties round to even
+	assert(floatToHalf(1.f + 3.f/2048) == 0x3c02);
+	assert(halfToFloat(floatToHalf(0.f/0.f)) != halfToFloat(floatToHalf(0.f/0.f)));
+	for(int i=0; i<0x7c00; ++i){ // all finite halves round trip
+		assert(floatToHalf(halfToFloat(uint16_t(i))) == i);
+	}
+	assert(near(float(Half(0.1f)), 0.1f, 1e-4) && float(Sample16(0.25f)) == 0.25f);
+
+	// Array versions match scalar ones
+	{
+		const unsigned N = 37;
+		float f[N]; double d[N]; uint32_t u[N], ru[N]; int32_t ri[N]; float rf[N];
+		for(unsigned i=0; i<N; ++i){
+			f[i] = (float(i) - 18.f) * 3.37f;
+			d[i] = (double(i) - 18.) * 0.137;
+			u[i] = uint32_t(i) * 0x9e3779b9u;
+		}
+		castIntRound(ri, d, N);
+		for(unsigned i=0; i<N; ++i) assert(ri[i] == castIntRound(d[i]));
+		castIntRound(ri, f, N);
+		for(unsigned i=0; i<N; ++i) assert(ri[i] == castIntRound(f[i]));
+		castIntTrunc(ri, f, N);
+		for(unsigned i=0; i<N; ++i) assert(ri[i] == castIntTrunc(f[i]));
+		floatToUInt(ru, f, N);
+		for(unsigned i=0; i<N; ++i) assert(ru[i] == floatToUInt(f[i]));
+		uintToUnit(rf, u, N);
+		for(unsigned i=0; i<N; ++i) assert(rf[i] == uintToUnit<float>(u[i]));
+		uintToUnitS(rf, u, N);
+		for(unsigned i=0; i<N; ++i) assert(rf[i] == uintToUnitS<float>(u[i]));
+		punUF(rf, u, N);
+		for(unsigned i=0; i<N; ++i) assert(punFU(rf[i]) == u[i]);
+		unitToPhase(ru, d, N);
+		for(unsigned i=0; i<N; ++i) assert(ru[i] == uint32_t(castIntRound(d[i] * 4294967296.)));
+		const double p[] = {1.25, -0.75, 0.5};
+		unitToPhase(ru, p, 3);
+		assert(ru[0] == 1u<<30 && ru[1] == 1u<<30 && ru[2] == 1u<<31);
+	}
 }
@@ -17,3 +17,229 @@
 	assert(4 == delay.read(3));
 	assert(3 == delay.read(4));
 }
+
+// Block processing matches per-sample filtering
+{
+	const unsigned M = 100;
+	float x[M], y[M], dly[M];
+	for(unsigned i=0; i<M; ++i){ x[i] = float(i+1); dly[i] = 3.f + 0.07f*i; }
+
+	const float delays[] = {0.f, 1.f, 5.f, 31.f, 7.25f};
+	for(float d : delays){
+		Delay<float, ipl::Cubic, Domain1> dl1(31.f, d), dl2(31.f, d);
+		for(unsigned b=0; b<3; ++b){
+			for(unsigned i=0; i<M; ++i) y[i] = x[i];
+			dl1.process(y, y, M);	// in place
+			for(unsigned i=0; i<M; ++i) assert(near(y[i], dl2(x[i])));
+		}
+	}
+
+	Delay<float, ipl::Linear, Domain1> dl1(32.f, 4.f), dl2(32.f, 4.f);
+	dl1.process(x, y, dly, M);
+	for(unsigned i=0; i<M; ++i){
+		dl2.delay(dly[i]);
+		assert(near(y[i], dl2(x[i]), 1e-4));
+	}
+	assert(dl1.delay() == 4.f);
+
+	// Interpolators with state or mixing neighbors also apply at whole delays
+	{
+		Delay<float, ipl::AllPass, Domain1> da(32.f, 10.f), dap(32.f, 10.f);
+		Delay<float, ipl::Mean2, Domain1> dm(32.f, 10.f), dmp(32.f, 10.f);
+		for(unsigned b=0; b<2; ++b){
+			da.process(x, y, M);
+			for(unsigned i=0; i<M; ++i) assert(near(y[i], dap(x[i]), 1e-5));
+			dm.process(x, y, M);
+			for(unsigned i=0; i<M; ++i) assert(near(y[i], dmp(x[i]), 1e-5));
+		}
+	}
+
+	// Switchable interpolation gives the output of the selected strategy
+	const ipl::Type types[] = {ipl::TRUNC, ipl::ROUND, ipl::LINEAR, ipl::CUBIC, ipl::ALLPASS};
+	for(ipl::Type t : types) for(float d : {7.25f, 7.f}){
+		Delay<float, ipl::Switchable, Domain1> ds(32.f, d), dsp(32.f, d);
+		ds.ipolType(t); dsp.ipolType(t);
+		ds.process(x, y, M);
+		for(unsigned i=0; i<M; ++i) assert(y[i] == dsp(x[i]));
+		ds.process(x, y, dly, M);
+		for(unsigned i=0; i<M; ++i){
+			dsp.delay(dly[i]);
+			assert(y[i] == dsp(x[i]));
+		}
+	}
+}
+
+// Delays take their buffers from an arena and new ones after it is reset
+{
+	MemoryArena a(4096);
+	Delay<float, ipl::Linear, Domain1> d1, d2, ref(32.f, 5.f);
+	d1.arena(&a);
+	d1.maxDelay(32.f, false);
+	d1.delay(5.f);
+	d2.arena(&a);
+	d2.maxDelay(100.f);
+	assert(a.owns(d1.elems()) && a.owns(d2.elems()));
+	assert(d1.size() == 32 && d2.size() == 128);
+	assert(d2.elems() == d1.elems() + 32);
+	assert((reinterpret_cast<std::size_t>(d1.elems()) & 63) == 0);
+	assert(a.used() == 160*sizeof(float));
+
+	for(unsigned i=0; i<100; ++i){ float x = float(i); assert(d1(x) == ref(x)); }
+
+	const float * p = d1.elems();
+	d1.maxDelay(32.f, false);
+	assert(d1.elems() == p);
+
+	// Back on the heap with the same elements
+	d1.arena(NULL);
+	assert(!a.owns(d1.elems()) && d1.size() == 32);
+	for(unsigned i=0; i<100; ++i){ float x = float(i); assert(d1(x) == ref(x)); }
+
+	a.reset();
+	assert(a.used() == 0 && a.generation() == 1);
+	d2.maxDelay(100.f);
+	assert(d2.elems() == p && d2.size() == 128);
+	for(unsigned i=0; i<128; ++i) assert(d2[i] == 0.f);
+
+
+	// Exhausted arena falls back on the heap
+	MemoryArena b(64);
+	Comb<float, ipl::Linear, float, Domain1> c;
+	c.arena(&b);
+	c.maxDelay(64.f);
+	assert(!b.owns(c.elems()) && c.size() == 64 && b.failures() == 1);
+}
+
+// Block processing of multitap gives the same rows as reading each sample
+{
+	const unsigned T = 4, N = 24;
+	const float dlys[][T] = {{1.5f, 7.25f, 40.f, 63.5f}, {0.5f, 3.f, 20.f, 50.f}};
+	for(int j=0; j<2; ++j){
+		Multitap<float, ipl::Linear, Domain1> a(64.f, T), b(64.f, T);
+		Multitap<float, ipl::Trunc, Domain1> c(64.f, T), d(64.f, T);
+		for(unsigned t=0; t<T; ++t){
+			a.delay(dlys[j][t], t); b.delay(dlys[j][t], t);
+			c.delay(dlys[j][t], t); d.delay(dlys[j][t], t);
+		}
+		float in[N], outA[T*N], outC[T*N];
+		for(int k=0; k<10; ++k){
+			for(unsigned i=0; i<N; ++i) in[i] = float(k*N + i + 1);
+			a.process(in, outA, N);
+			c.process(in, outC, N);
+			for(unsigned i=0; i<N; ++i){
+				for(unsigned t=0; t<T; ++t){
+					assert(near(outA[t*N + i], b.read(t), 1e-4));
+					assert(outC[t*N + i] == d.read(t));
+				}
+				b.write(in[i]);
+				d.write(in[i]);
+			}
+		}
+	}
+}
+
+// Multichannel delay matches a delay per channel, per frame and in blocks of
+// interleaved frames or channels
+{
+	const unsigned C = 4, N = 100;
+	float in[N*C], out[N*C], outP[C][N];
+	const float * inP[C];
+	float * outPP[C];
+	std::vector<float> planar(N*C);
+	for(unsigned i=0; i<N*C; ++i) in[i] = float((i*7919)%13) - 6.f;
+	for(unsigned c=0; c<C; ++c){
+		for(unsigned i=0; i<N; ++i) planar[c*N+i] = in[i*C+c];
+		inP[c] = &planar[c*N];
+		outPP[c] = outP[c];
+	}
+
+	const float lens[][C] = {{3.f, 3.f, 3.f, 3.f}, {37.f, 37.f, 37.f, 37.f}, {2.f, 5.25f, 37.f, 60.5f}};
+	for(int j=0; j<3; ++j){
+		DelayMC<C, float, Domain1> a(64.f, 1.f), b(a), p(a);
+		Delay<float, ipl::Linear, Domain1> ref[C];
+		for(unsigned c=0; c<C; ++c){
+			a.delay(lens[j][c], c); b.delay(lens[j][c], c); p.delay(lens[j][c], c);
+			ref[c].maxDelay(64.f); ref[c].delay(lens[j][c]);
+		}
+		assert(a.sizeFrames() == 128 && a.delays()[3] == lens[j][3]);
+
+		std::copy(in, in+N*C, out);
+		a.process(out, out, N);
+		p.process(inP, outPP, N);
+		for(unsigned i=0; i<N; ++i){
+			float frame[C];
+			b(frame, in + i*C);
+			for(unsigned c=0; c<C; ++c){
+				const float r = ref[c](in[i*C+c]);
+				assert(near(frame[c], r, 1e-5));
+				assert(near(out[i*C+c], r, 1e-5));
+				assert(near(outP[c][i], r, 1e-5));
+			}
+		}
+		assert(near(b.read(3, lens[j][3]), ref[3].read(lens[j][3]), 1e-5));
+	}
+}
+
+// Block processing of comb, echo and chorus matches filtering each sample,
+// including delays shorter than the block
+{
+	const unsigned N = 100;
+	float in[N], out[N], dlys[N];
+	for(unsigned i=0; i<N; ++i){
+		in[i] = i ? float((i*7919)%13) - 6.f : 1.f;
+		dlys[i] = 4.5f + 3.f*std::sin(i*0.1f);
+	}
+
+	const float lens[] = {2.f, 5.25f, 37.f, 120.5f};
+	for(int j=0; j<4; ++j){
+		Comb<float, ipl::Cubic, float, Domain1> a(128.f, lens[j], 0.5f, -0.7f), b(a);
+		a.process(in, out, N);
+		for(unsigned i=0; i<N; ++i) assert(near(out[i], b(in[i]), 1e-5));
+
+		Echo<float, ipl::Linear, Loop1P, Domain1> c, d;
+		c.maxDelay(128.f); c.delay(lens[j]); c.decay(40.f); c.damping(0.3f);
+		d.maxDelay(128.f); d.delay(lens[j]); d.decay(40.f); d.damping(0.3f);
+		c.process(in, out, N);
+		for(unsigned i=0; i<N; ++i) assert(near(out[i], d(in[i]), 1e-5));
+	}
+
+	Comb<float, ipl::Linear, float, Domain1> a(16.f, 8.f, 0.3f, 0.6f), b(a);
+	a.process(in, out, dlys, N);
+	for(unsigned i=0; i<N; ++i){ b.delay(dlys[i]); assert(near(out[i], b(in[i]), 1e-5)); }
+	assert(a.delay() == 8.f);
+
+	double spu = Domain::master().spu();
+	Domain::master().spu(44100);
+	{
+		Chorus<float> c, d;
+		float in2[N], out2[N];
+		for(int k=0; k<3; ++k){
+			std::copy(in, in+N, out);
+			c.process(out, out, N);
+			for(unsigned i=0; i<N; ++i) assert(near(out[i], d(in[i]), 1e-5));
+		}
+		for(unsigned i=0; i<N; ++i) in2[i] = -in[i];
+		c.process(in, in2, out, out2, N);
+		for(unsigned i=0; i<N; ++i){
+			float o1, o2; d(in[i], in2[i], o1, o2);
+			assert(near(out[i], o1, 1e-5) && near(out2[i], o2, 1e-5));
+		}
+	}
+
+	// Plucked strings repeat with their periods and sleep once decayed
+	{
+		Domain dom(44100);
+		PluckBank pb(9);
+		dom << pb;
+		for(unsigned s=0; s<9; ++s) pb.freq(s, 441).decay(s, 1e6).brightness(s, 1).pluck(s);
+		float y[300];
+		pb(y, 300);
+		for(unsigned i=0; i<200; ++i) assert(near(y[i+100], y[i], 1e-3));
+		assert(9 == pb.active());
+		pb.freq(0, 1000).decay(0, 0.01).brightness(0, 0.2);
+		for(unsigned s=1; s<9; ++s) pb.decay(s, 0.05);
+		for(unsigned b=0; b<100; ++b) pb(y, 300);
+		assert(0 == pb.active() && 0 == y[299]);
+	}
+	Domain::master().spu(spu);
+}
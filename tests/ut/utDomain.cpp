@@ -42,4 +42,103 @@
 	assert(200 == obs1.checkSPU);
 	assert(200 == obs2.checkSPU);
 	assert(10 == obs3.checkSPU);
+
+	// Control domain follows its parent at a fraction of its rate
+	{
+		ControlDomain ctl(domA, 5);
+		TestObserver obs4;
+		ctl << obs4;
+		assert(2 == ctl.spu() && 2 == obs4.checkSPU);
+		domA.spu(40);
+		assert(8 == ctl.spu() && 8 == obs4.checkSPU);
+		ctl.blockSize(4);
+		assert(10 == obs4.checkSPU);
+
+		// Ramp reaches each target in a block, per sample and per block
+		ControlRamp<double> r1(4, 1), r2(4, 1);
+		double b[6];
+		r1.target(3); r2.target(3);
+		r2(b, 6);
+		for(int i=0; i<6; ++i) assert(near(r1(), b[i]));
+		assert(b[3] == 3 && b[5] == 3 && r2.done());
+	}
+
+	// Observers attach and detach concurrently on several threads
+	{
+		struct Counter : DomainObserver{
+			std::atomic<int> * count;
+			Counter(Domain& d, std::atomic<int> * c): count(c){ domain(d); }
+			void onDomainChange(double r){ ++*count; }
+		};
+		Domain dom(1);
+		std::atomic<int> count(0);
+		std::vector<std::thread> threads;
+		for(int t=0; t<4; ++t){
+			threads.emplace_back([&]{
+				for(int i=0; i<2000; ++i){ Counter c(dom, &count); }
+				static thread_local Counter keep(dom, &count); (void)keep;
+			});
+		}
+		for(auto& t : threads) t.join();
+		Counter c(dom, &count);
+		count = 0;
+		dom.spu(2); // thread_local observers were destroyed with their threads
+		assert(1 == count);
+
+		// Observers of a fixed domain take its rate, but are not notified
+		dom.fixed(true);
+		Counter f(dom, &count);
+		count = 0;
+		assert(!f.observing() && c.observing() && 2 == f.spu());
+		dom.spu(4);
+		assert(1 == count && 4 == f.spu());
+	}
+
+	// Scoped current domain is per thread
+	{
+		Domain d48(48000), d96(96000);
+		double got48=0, got96=0;
+		std::thread t1([&]{ DomainScope s(d48); TestObserver o; got48 = o.spu(); });
+		std::thread t2([&]{ DomainScope s(d96); TestObserver o; got96 = o.spu(); });
+		t1.join(); t2.join();
+		assert(48000 == got48 && 96000 == got96);
+		{
+			DomainScope s1(d48);
+			{ DomainScope s2(d96); assert(&Domain::current() == &d96); }
+			TestObserver o, o2(o);
+			assert(48000 == o.spu() && 48000 == o2.spu());
+		}
+		assert(&Domain::current() == &Domain::master());
+	}
+
+	// Deferred changes are applied in batches, once per observer
+	{
+		Domain d(10);
+		d.deferred(true);
+		TestObserver o[5];
+		for(auto& x : o) d << x;
+		d.spu(20); d.spu(40);
+		assert(d.pending() && 10 == o[0].checkSPU);
+		d.syncObservers(2);
+		assert(d.pending() && 40 == o[4].checkSPU && 10 == o[0].checkSPU);
+		assert(o[0].syncDomain() && 40 == o[0].checkSPU && !o[0].syncDomain());
+		d.syncObservers();
+		assert(!d.pending());
+		for(auto& x : o) assert(40 == x.checkSPU);
+		d.spu(80);
+		d.deferred(false).spu(160);
+		assert(!d.pending());
+		for(auto& x : o) assert(160 == x.checkSPU);
+	}
+
+	// Compile-time domain needs no observer state
+	{
+		typedef FixedDomain<48000> D48;
+		static_assert(D48::spu() == 48000 && D48::ups() == 1./48000, "");
+		static_assert(sizeof(Sine<float, D48>) < sizeof(Sine<float>), "");
+		Sine<float, D48> s(480);
+		assert(near(s.freq(), 480.f));
+		s(); float v = s();
+		assert(near(v, float(sin(M_2PI*0.01)), 1e-5));
+	}
 }
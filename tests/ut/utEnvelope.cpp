@@ -96,4 +96,207 @@
 		assert(near(e.levels()[1][1], 3.0));
 		assert(near(e.levels()[2][1], 0.0));
 	}
+	// Block generation gives the same values as generating each sample
+	{
+		Curve<float,float> c1(101, -3, 0.2, 1.5), c2(c1);
+		float buf[101];
+		c1(buf, 101);
+		for(int i=0; i<101; ++i) assert(near(buf[i], c2(), 1e-5));
+		assert(near(c1.value(), c2.value(), 1e-5));
+	}
+
+	{
+		ADSR<float,float,Domain1> a(37, 50, 0.5, 23), b(a);
+		AD<float,float,Domain1> c(10, 45), d(c);
+		Env<3,float,float,Domain1> e(0, 17, 1, 9, 0.3, 11, 0.8), f(e);
+		e.loop(true);
+		f.loop(true);
+		float buf[40];
+		for(int k=0; k<10; ++k){
+			const unsigned n = 5 + 7*k % 40;
+			if(k == 6){ a.release(); b.release(); }
+			a(buf, n);
+			for(unsigned i=0; i<n; ++i) assert(near(buf[i], b(), 1e-5));
+			c(buf, n);
+			for(unsigned i=0; i<n; ++i) assert(near(buf[i], d(), 1e-5));
+			e(buf, n);
+			for(unsigned i=0; i<n; ++i) assert(near(buf[i], f(), 1e-5));
+		}
+		assert(a.done() && b.done() && c.done());
+	}
+	// Envelope bank gives the same values as an ADSR per voice, with gates
+	// at sample offsets
+	{
+		const double spu = Domain::master().spu();
+		Domain::master().spu(44100);
+		{
+			const unsigned V = 3, N = 64;
+			EnvelopeBank bank(V);
+			ADSR<float,float> ref[V];
+			for(unsigned v=0; v<V; ++v){
+				const float att = 0.0005*(v+1), dec = 0.001, sus = 0.5, rel = 0.0007, amp = 1 + v;
+				bank.set(v, att, dec, sus, rel, amp, -4.f + v);
+				ref[v].attack(att).decay(dec).sustain(sus).release(rel).amp(amp).curve(-4.f + v);
+				ref[v].finish();
+			}
+			float out[V*N];
+			for(unsigned k=0; k<8; ++k){
+				unsigned on = V, off = V, offset = (k*23) % N;
+				if(k == 1){ on = 0; bank.gateOn(0, offset); }
+				if(k == 2){ on = 1; bank.gateOn(1, offset); bank.gateOn(2, offset); }
+				if(k == 4){ off = 0; bank.gateOff(0, offset); bank.gateOff(1, offset); }
+				bank.process(out, N);
+				for(unsigned v=0; v<V; ++v){
+					for(unsigned i=0; i<N; ++i){
+						if(i == offset){
+							if(on == v || (on == 1 && v == 2)) ref[v].reset();
+							if(off == v || (off == 0 && v == 1)) ref[v].release();
+						}
+						assert(near(out[v*N + i], ref[v](), 1e-4));
+					}
+				}
+			}
+			assert(bank.done(0) && bank.done(1) && !bank.done(2));
+			assert(bank.released(0) && !bank.released(2));
+
+			// Gates beyond the queue size are dropped
+			bank.maxGates(2);
+			bank.gateOn(2, 5).gateOn(0, 3).gateOff(0, 4);
+			assert(1 == bank.gatesDropped());
+			bank.process(out, N);
+			assert(out[0*N + 2] == 0.f && out[0*N + 4] > 0.f);
+			assert(!bank.released(0) && bank.stage(2) == 0);
+		}
+		Domain::master().spu(spu);
+	}
+	// Advancing gives the same state as stepping
+	{
+		Curve<double,double> a(1000, -3, 1, 0), b = a;
+		for(int i=0; i<700; ++i) a();
+		b.advance(700);
+		assert(near(a.value(), b.value(), 1e-10));
+
+		Decay<double> c(300), d = c;
+		for(int i=0; i<500; ++i) c();
+		d.advance(500);
+		assert(near(c.value(), d.value(), 1e-12));
+
+		SegExp<double> e(400, -2), f = e;
+		for(int i=0; i<100; ++i) e();
+		f.advance(100);
+		assert(near(e(), f(), 1e-10));
+
+		Seg<double> g(400), h = g;
+		for(int i=0; i<100; ++i) g();
+		h.advance(100);
+		assert(near(g(), h(), 1e-5)); // phase is float
+
+		Env<3,double,double> ea(0, 100, 1, 200, 0.5, 300, 0), eb = ea;
+		ea.sustainPoint(2); eb.sustainPoint(2);
+		for(int i=0; i<250; ++i) ea();
+		eb.advance(250);
+		assert(near(ea(), eb(), 1e-10) && ea.stage() == eb.stage());
+		for(int i=0; i<1000; ++i) ea();
+		eb.advance(1000);
+		assert(eb.sustained() && near(ea(), eb(), 1e-10));
+	}
+	// Gate and segment banks give the same values as a gate and segment per
+	// channel, with targets from the gates
+	{
+		const double spu = Domain::master().spu();
+		Domain::master().spu(44100);
+		{
+			const unsigned C = 5, N = 100;
+			GateBank gates(C, 0.0005, 0.1);
+			SegExpBank segs(C, 0.0004, -3);
+			Gate<float> gref[C];
+			SegExp<float> sref[C] = {
+				SegExp<float>(0.0004, -3, 0, 0), SegExp<float>(0.0004, -3, 0, 0),
+				SegExp<float>(0.0004, -3, 0, 0), SegExp<float>(0.0004, -3, 0, 0),
+				SegExp<float>(0.0004, -3, 0, 0)
+			};
+			float in[C*N], g[C*N], out[C*N], end[C] = {0};
+			for(unsigned c=0; c<C; ++c){
+				gates.delay(c, 0.0005 + 0.0001*c);
+				gref[c] = Gate<float>(0.0005 + 0.0001*c, 0.1);
+			}
+			for(unsigned k=0; k<3; ++k){
+				for(unsigned c=0; c<C; ++c)
+					for(unsigned i=0; i<N; ++i)
+						in[c*N + i] = ((i + 17*c + k*N) % 90) < 30 ? 0.5f : 0.01f;
+				gates.process(in, g, N);
+				segs.process(g, out, N);
+				for(unsigned c=0; c<C; ++c){
+					for(unsigned i=0; i<N; ++i){
+						const float gv = gref[c](in[c*N + i]);
+						assert(gv == g[c*N + i]);
+						if(gv != end[c]) sref[c] = end[c] = gv;
+						assert(near(out[c*N + i], sref[c](), 1e-5));
+					}
+					assert(gates.done(c) == gref[c].done());
+				}
+			}
+		}
+		Domain::master().spu(spu);
+	}
+	// Breakpoint envelope renders its closed form, from the start or from
+	// any seek position
+	{
+		BreakpointEnv e;
+		e.add(10.5, 1, -3).add(2, 0).add(40, 0.25, 2).add(25, -1).add(60, 0.5);
+		assert(e.size() == 5 && e.time(0) == 2 && e.time(4) == 60);
+		assert(e.find(1) == 0 && e.find(2) == 0 && e.find(12) == 1 && e.find(70) == 4);
+		assert(near(e.value(0), 0) && near(e.value(10.5), 1) && near(e.value(100), 0.5));
+		assert(near(e.value(32.5), -0.375));
+
+		const unsigned N = 70;
+		float a[N], b[N];
+		e(a, N);
+		assert(e.done());
+		for(unsigned i=0; i<N; ++i) assert(near(a[i], e.value(i), 1e-4));
+
+		e.seek(33.2);
+		e(b, 10);
+		e.seek(43);
+		e(b+10, 3); for(unsigned i=0; i<7; ++i) b[13+i] = e();
+		for(unsigned i=0; i<10; ++i) assert(near(b[i], e.value(33.2 + i), 1e-4));
+		for(unsigned i=10; i<20; ++i) assert(near(b[i], a[33 + i], 1e-4));
+	}
+
+	// Smoothed parameter; per sample, per block and through a setter
+	{
+		Domain dom(100);
+		SmoothedParam<double, DomainObserver> a(0, 0.04), b(0, 0.04), c(1, 0.04);
+		dom << a << b << c;
+		c.mode(c.EXPONENTIAL);
+		double buf[6];
+		a = 8; b = 8; c = 0.5;
+		assert(a.target() == 8 && a.value() == 0);
+		for(int i=0; i<6; ++i) buf[i] = a();
+		assert(near(buf[0], 2) && near(buf[2], 6) && buf[3] == 8 && buf[5] == 8);
+		assert(!a.ramping() && near(b.next(2), 4) && b.next(7) == 8);
+		c(buf, 4);
+		assert(near(buf[3], 0.5 + 0.5*0.001) && near(c.next(0), buf[3]));
+		assert(near(c.next(8), 0.5 + 0.5*0.001*0.001*0.001));
+		while(c.ramping()) c();
+		assert(c.value() == 0.5);
+
+		struct Gain{ double v; Gain(): v(0){} Gain& gain(double g){ v=g; return *this; } } g;
+		a = -2; g.gain(a.next(2));
+		assert(near(g.v, 3));
+	}
+
+	// Retriggering with kept segment shapes matches a fresh envelope
+	{
+		Domain dom(100);
+		Env<3, float, float, DomainObserver> a(0, 0.2, 1, 0.3, 0.5, 0.1, 0), b(a);
+		dom << a << b;
+		a.curves(-3, 2, 0);
+		float x[70], y[70];
+		a(x, 70); a.reset();
+		a.lengths(0.1, 0.3, 0.25).curves(-3, 4, 0);
+		b.lengths(0.1, 0.3, 0.25).curves(-3, 4, 0);
+		a(x, 70); b(y, 70);
+		for(int i=0; i<70; ++i) assert(x[i] == y[i]);
+	}
 }
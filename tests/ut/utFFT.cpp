@@ -107,3 +107,568 @@
 	}
 }
 
+
+// Sliding window holds the last samples, oldest first, on each hop
+{
+	const unsigned N = 12, H = 5;
+	SlidingWindow<float> sw(N, H);
+	float w[N], dst[N], dstW[N];
+	for(unsigned i=0; i<N; ++i) w[i] = float(i+1);
+	SlidingWindow<float> swW(N, H);
+	unsigned hops = 0;
+	for(unsigned t=0; t<50; ++t){
+		const bool a = sw(dst, float(t)), b = swW(dstW, float(t), w);
+		assert(a == b && a == ((t+1) % H == 0));
+		if(a){
+			++hops;
+			for(unsigned i=0; i<N; ++i){
+				const float x = int(t+1+i) >= int(N) ? float(t+1+i-N) : 0.f;
+				assert(dst[i] == x && sw.window()[i] == x);
+				assert(dstW[i] == x * w[i]);
+			}
+		}
+	}
+	assert(hops == 10);
+}
+
+// Zero-phase rotation puts window halves at the ends of a padded frame
+{
+	const unsigned N = 16, P = 16;
+	STFT a(N, N, P, RECTANGLE, COMPLEX), b(2*N, 2*N, 0, RECTANGLE, COMPLEX);
+	a.rotateForward(true);
+	float x[N], y[2*N] = {0};
+	for(unsigned i=0; i<N; ++i) x[i] = std::sin(0.9f*i) + 0.1f*i;
+	for(unsigned i=0; i<N/2; ++i){ y[i] = x[i+N/2]; y[2*N-N/2+i] = x[i]; }
+	for(unsigned i=0; i<N; ++i) a(x[i]);
+	b.forward(y);
+	for(unsigned k=0; k<a.numBins(); ++k){
+		assert(near(a.bin(k)[0], b.bin(k)[0], 1e-5));
+		assert(near(a.bin(k)[1], b.bin(k)[1], 1e-5));
+	}
+}
+
+// Resizing within reserved sizes keeps buffers and matches a fresh STFT
+{
+	const int N = 32;
+	STFT stft(64, 16, 0, HANN, MAG_PHASE), ref(N, N/4, 0, HANN, MAG_PHASE);
+	stft.reserve(128, 32);
+	const Complex<float> * bins = stft.bins();
+	rtViolationsClear();
+	{	RTScope rt; // reports allocations and locks in RT_CHECK builds
+		stft.resize(128, 32);
+		stft.resize(32, 32);
+		stft.resize(N, 0);
+	}
+	assert(0 == rtViolations());
+	stft.sizeHop(N/4);
+	assert(stft.bins() == bins && stft.numBins() == ref.numBins());
+
+	for(int i=0; i<N*4; ++i){
+		float s = std::cos(float(i)/N * 2*M_PI) + 0.3f*std::sin(0.7f*i);
+		bool a = stft(s), b = ref(s);
+		assert(a == b);
+		if(a){
+			for(unsigned k=0; k<ref.numBins(); ++k){
+				assert(near(stft.bin(k)[0], ref.bin(k)[0], 1e-6));
+			}
+		}
+		assert(near(stft(), ref(), 1e-6));
+	}
+}
+
+// Frames split into component arrays match interleaved frames
+{
+	const int N = 32;
+	STFT a(N, N/4, 0, HANN, MAG_FREQ, 1), b(N, N/4, 0, HANN, MAG_FREQ, 1);
+	b.splitBins(true);
+	assert(b.splitBins() && !a.splitBins());
+
+	for(int i=0; i<N*4; ++i){
+		float s = std::cos(float(i)/N * 2*M_PI) + 0.3f*std::sin(0.7f*i);
+		if(a(s) & b(s)){
+			for(unsigned k=0; k<a.numBins(); ++k){
+				assert(a.bin(k)[0] == b.binComp(0)[k]);
+				assert(a.bin(k)[1] == b.binComp(1)[k]);
+			}
+
+			// halve magnitudes through aux buffer and directly
+			a.copyBinsToAux(0, 0);
+			b.copyBinsToAux(0, 0);
+			for(unsigned k=0; k<a.numBins(); ++k){
+				assert(a.aux(0)[k] == b.aux(0)[k]);
+				a.aux(0)[k] *= 0.5f;
+				b.binComp(0)[k] *= 0.5f;
+			}
+			a.copyAuxToBins(0, 0);
+		}
+		assert(a() == b());
+	}
+}
+
+// Active bins are those at or above the threshold; resynthesis from them
+// matches zeroing the other bins of a full spectrum
+{
+	const int N = 256;
+	const float thresh = 0.02f;
+	const SpectralType types[] = {COMPLEX, MAG_PHASE, MAG_FREQ};
+	for(int c=0; c<6; ++c){
+		const SpectralType type = types[c/2];
+		STFT a(N, N/4, 0, HANN, type), b(N, N/4, 0, HANN, type);
+		a.splitBins(c & 1);
+		a.activeThreshold(thresh);
+		assert(a.activeThreshold() == thresh && b.numActiveBins() == 0);
+		unsigned framesActive = 0;
+
+		for(int i=0; i<N*6; ++i){
+			float s = 0.5f*std::cos(0.3f*i) + 0.2f*std::sin(1.1f*i) + 0.01f*std::sin(0.05f*i*i);
+			if(a(s) & b(s)){
+				unsigned j = 0;
+				for(unsigned k=0; k<b.numBins(); ++k){
+					float mag = type == COMPLEX ? b.bin(k).mag() : b.bin(k)[0];
+					if(k == 0 || k == b.numBins()-1) mag = scl::abs(mag);
+					if(mag >= thresh){
+						assert(j < a.numActiveBins() && a.activeBins()[j++] == k);
+					}
+					else{
+						b.bin(k)[0] = 0.f;
+						if(type == COMPLEX) b.bin(k)[1] = 0.f;
+					}
+				}
+				assert(j == a.numActiveBins() && j < a.numBins()/4);
+				framesActive += j > 0;
+			}
+			assert(near(a(), b(), 1e-5));
+		}
+		assert(framesActive >= 20);
+	}
+}
+
+// Sizes handled by each backend agree with the DFT
+{
+	const int sizes[] = {8, 32, 128, 512, 24};
+	for(int n : sizes){
+		std::vector<float> c(2*n), r(n);
+		for(int i=0; i<n; ++i){
+			r[i] = c[2*i] = std::sin(0.3f*i*i) + 0.25f;
+			c[2*i+1] = std::cos(0.7f*i);
+		}
+		std::vector<float> c0 = c, r0 = r;
+
+		CFFT<float> cfft(n);
+		RFFT<float> rfft(n);
+		cfft.forward(&c[0], false);
+		rfft.forward(&r[0], false, false);
+
+		for(int k=0; k<=n/2; ++k){
+			double cr=0, ci=0, rr=0, ri=0;
+			for(int i=0; i<n; ++i){
+				double p = -M_2PI*k*i/n;
+				cr += c0[2*i]*std::cos(p) - c0[2*i+1]*std::sin(p);
+				ci += c0[2*i]*std::sin(p) + c0[2*i+1]*std::cos(p);
+				rr += r0[i]*std::cos(p);
+				ri += r0[i]*std::sin(p);
+			}
+			double eps = 1e-4*n;
+			assert(near(c[2*k], cr, eps) && near(c[2*k+1], ci, eps));
+			if(0 == k)			assert(near(r[0], rr, eps));
+			else if(n/2 == k)	assert(near(r[n-1], rr, eps));
+			else				assert(near(r[2*k-1], rr, eps) && near(r[2*k], ri, eps));
+		}
+
+		cfft.inverse(&c[0]);
+		rfft.inverse(&r[0]);
+		for(int i=0; i<n; ++i){
+			assert(near(c[2*i]/n, c0[2*i], 1e-5) && near(c[2*i+1]/n, c0[2*i+1], 1e-5));
+			assert(near(r[i]/n, r0[i], 1e-5));
+		}
+	}
+}
+
+// Transforms of a size share a plan, but not their work buffers
+{
+	RFFT<float>::prewarm({64, 48});
+	CFFT<double>::prewarm({64});
+	const int rPlans = RFFT<float>::plans(), cPlans = CFFT<double>::plans();
+	RFFT<float> a(64), b(48);
+	b.resize(64);
+	CFFT<double> c(64), d(64);
+	assert(RFFT<float>::plans() == rPlans && CFFT<double>::plans() == cPlans);
+	RFFT<float> e(1000);
+	const int ePlans = RFFT<float>::plans();
+	RFFT<float> f(1000);
+	assert(ePlans >= rPlans && RFFT<float>::plans() == ePlans);
+	float x[64], y[64];
+	for(int i=0; i<64; ++i) x[i] = y[i] = float(i%7) - 3.f;
+	a.forward(x);
+	b.forward(y);
+	for(int i=0; i<64; ++i) assert(x[i] == y[i]);
+}
+
+// Batched transforms match per-channel transforms
+{
+	const int N = 32, K = 5; // channels use both batched and single paths
+	float a[K][N+2], b[K][N+2];
+	float * pa[K], * pb[K];
+	for(int c=0; c<K; ++c){
+		for(int i=0; i<N+2; ++i) a[c][i] = b[c][i] = std::sin(0.1f*(c+1)*i*i);
+		pa[c] = a[c]; pb[c] = b[c];
+	}
+
+	RFFT<float> rfft(N);
+	rfft.forwardBatch(pa, K, true);
+	for(int c=0; c<K; ++c) rfft.forward(pb[c], true);
+	for(int c=0; c<K; ++c) for(int i=0; i<N+2; ++i) assert(near(a[c][i], b[c][i], 1e-6));
+
+	rfft.inverseBatch(pa, K, true);
+	for(int c=0; c<K; ++c) rfft.inverse(pb[c], true);
+	for(int c=0; c<K; ++c) for(int i=1; i<N+1; ++i) assert(near(a[c][i], b[c][i], 1e-5));
+}
+
+// Partitioned convolution matches direct convolution
+{
+	const unsigned B = 16, L = 70, M = 10*B;
+	float h[L], x[M], y[M];
+	for(unsigned i=0; i<L; ++i) h[i] = std::cos(0.3f*i) * (1.f - float(i)/L);
+	for(unsigned i=0; i<M; ++i) x[i] = y[i] = std::sin(0.05f*i*i);
+
+	Convolver conv(B, 100);
+	bool fits = conv.ir(h, L, 0.5f);
+	assert(fits);
+	assert(conv.partitions() == 5);
+	for(unsigned i=0; i<M; i+=B) conv.process(y+i, y+i);
+
+	for(unsigned n=0; n<M; ++n){
+		float v = 0.f;
+		for(unsigned k=0; k<L && k<=n; ++k) v += h[k]*x[n-k];
+		assert(near(y[n], 0.5f*v, 1e-4));
+	}
+}
+
+// Non-uniform convolution matches uniform convolution
+{
+	const unsigned B = 8, L = 300, M = 64*B;
+	float h[L], x[M], y1[M], y2[M], y3[M];
+	for(unsigned i=0; i<L; ++i) h[i] = std::cos(0.2f*i) * (1.f - float(i)/L);
+	for(unsigned i=0; i<M; ++i) x[i] = std::sin(0.05f*i*i);
+
+	Convolver uni(B, L);
+	NonUniformConvolver sync(B, L, 4*B, false), bg(B, L, 0, true);
+	assert(sync.tailBlockSize() == 4*B);
+	assert(bg.tailBlockSize() > B && bg.tailBlockSize() % B == 0);
+	uni.ir(h, L); sync.ir(h, L); bg.ir(h, L);
+	{	// Too long responses are truncated and reported
+		float hl[2*L] = {0};
+		Convolver shortUni(B, L);
+		NonUniformConvolver shortSync(B, L, 4*B, false);
+		bool fits = shortUni.ir(hl, 2*L);
+		assert(!fits);
+		fits = shortSync.ir(hl, 2*L);
+		assert(!fits);
+		fits = shortSync.ir(hl, L);
+		assert(fits);
+	}
+	for(unsigned i=0; i<M; i+=B){
+		uni.process(y1+i, x+i);
+		sync.process(y2+i, x+i);
+		bg.process(y3+i, x+i);
+	}
+	for(unsigned n=0; n<M; ++n){
+		assert(near(y1[n], y2[n], 1e-4));
+		assert(near(y1[n], y3[n], 1e-4));
+	}
+}
+
+// Convolvers sharing a response match one with its own copy
+{
+	const unsigned B = 16, L = 70, M = 10*B;
+	float h[L], x[M], y1[M], y2[M];
+	for(unsigned i=0; i<L; ++i) h[i] = std::cos(0.3f*i) * (1.f - float(i)/L);
+	for(unsigned i=0; i<M; ++i) x[i] = std::sin(0.05f*i*i);
+
+	Convolver own(B, L), src(B, L), shared(B, L);
+	own.ir(h, L); src.ir(h, L);
+	shared.share(&src);
+	for(unsigned i=0; i<M; i+=B){
+		own.process(y1+i, x+i);
+		shared.process(y2+i, x+i);
+	}
+	for(unsigned n=0; n<M; ++n) assert(y1[n] == y2[n]);
+}
+
+// Linear-phase EQ has the magnitude response of its bands' biquads and a
+// symmetric kernel
+{
+	const unsigned B = 64, N = 2048, C = 2;
+	Domain dom(48000);
+	for(int bg=0; bg<2; ++bg){
+		LinearPhaseEQ eq(0, 0, 0, false);
+		dom << eq;
+		eq.resize(C, B, N, bg);
+		assert(eq.latency() == N/2);
+		for(unsigned i=0; i<N; ++i) assert(eq.kernel()[i] == (i==N/2 ? 1.f : 0.f));
+
+		assert(eq.band(0, PEAKING, 2000, 2, 4));
+		assert(eq.band(1, HIGH_SHELF, 8000, 0.707, 0.25));
+		assert(eq.band(3, LOW_SHELF, 100, 0.707, 0.5));
+		assert(eq.removeBand(3));
+		assert(!eq.band(LinearPhaseEQ::MAX_BANDS, PEAKING, 100));
+
+		std::vector<float> x(C*B), y(C*B);
+		float * xs[C] = {&x[0], &x[B]}, * ys[C] = {&y[0], &y[B]};
+		while(eq.pending()) eq.process(ys, xs);
+		assert(eq.designs() >= 1);
+
+		const float * k = eq.kernel();
+		for(unsigned i=1; i<N/2; ++i) assert(near(k[N/2-i], k[N/2+i], 1e-6));
+
+		Biquad<> b1(2000, 2, PEAKING), b2(8000, 0.707, HIGH_SHELF);
+		dom << b1 << b2;
+		b1.level(4); b2.level(0.25);
+		for(double f : {200., 2000., 5000., 16000.}){
+			const double w = M_2PI*f/48000.;
+			double re=0, im=0;
+			for(unsigned i=0; i<N; ++i){ re += k[i]*cos(w*i); im -= k[i]*sin(w*i); }
+			double mag = 1;
+			for(const Biquad<> * b : {&b1, &b2}){
+				const float * a = b->a(), * d = b->b();
+				std::complex<double> z = std::polar(1., -w);
+				mag *= std::abs((double(a[0]) + (double(a[1]) + double(a[2])*z)*z) / (1. + (double(d[1]) + double(d[2])*z)*z));
+			}
+			assert(near(sqrt(re*re + im*im), mag, 0.02*mag));
+		}
+
+		// Channels are filtered by the kernel delayed by the latency
+		for(unsigned i=0; i<B; ++i){ x[i] = i==0; x[B+i] = i==1; }
+		eq.reset();
+		std::vector<float> out0, out1;
+		for(unsigned j=0; j<N/B; ++j){
+			eq.process(ys, xs);
+			out0.insert(out0.end(), &y[0], &y[B]);
+			out1.insert(out1.end(), &y[B], &y[2*B]);
+			std::fill(x.begin(), x.end(), 0.f);
+		}
+		for(unsigned i=0; i<N-1; ++i){
+			assert(near(out0[i], k[i], 1e-5));
+			assert(near(out1[i+1], k[i], 1e-5));
+		}
+	}
+}
+
+// FIR filter matches direct convolution on both paths
+{
+	const unsigned L = 90, M = 400;
+	float h[L], x[M], y1[M], y2[M];
+	for(unsigned i=0; i<L; ++i) h[i] = std::cos(0.4f*i) * (1.f - float(i)/L);
+	for(unsigned i=0; i<M; ++i) x[i] = std::sin(0.05f*i*i);
+
+	FIR direct(L, L), fft(L, 20);
+	direct.kernel(h, L); fft.kernel(h, L);
+	assert(!direct.usesFFT() && fft.usesFFT());
+	{	// Too long kernels are truncated and reported
+		FIR shortFIR(L/2, 20);
+		bool fits = shortFIR.kernel(h, L);
+		assert(!fits);
+		fits = shortFIR.kernel(h, L/2);
+		assert(fits);
+	}
+	for(unsigned i=0; i<M; ){
+		unsigned m = 1 + (i*7) % 37; if(i+m > M) m = M-i;
+		direct(y1+i, x+i, m);
+		fft(y2+i, x+i, m);
+		i += m;
+	}
+
+	for(unsigned n=0; n<M; ++n){
+		float v = 0.f;
+		for(unsigned k=0; k<L && k<=n; ++k) v += h[k]*x[n-k];
+		assert(near(y1[n], v, 1e-4));
+		assert(near(y2[n], v, 1e-4));
+	}
+	fft.reset();
+	for(unsigned i=0; i<M; ++i) assert(near(fft(x[i]), y2[i], 1e-4));
+}
+
+// Block sliding DFT matches per-sample sliding DFT
+{
+	const unsigned N = 32, M = 100;
+	SlidingDFT<float> a(N, 1, 13), b(N, 1, 13);
+	SlidingDFT<double> c(N, 1, 13);
+	float x[M];
+	for(unsigned i=0; i<M; ++i) x[i] = std::sin(0.3f*i) + 0.1f*(i%7);
+	for(unsigned i=0; i<M; ++i){
+		// Per-sample input copies to the bins only when a frame completes
+		bool frame = a.forward(x[i]);
+		assert(frame == (i%N == N-1));
+		c.forward(double(x[i]));
+		if(i == 3*N-1){
+			b.forward(x, 3*N);
+			for(unsigned k=1; k<13; ++k){
+				assert(a.bin(k).r == a.binComp(0)[k] && a.bin(k).i == a.binComp(1)[k]);
+				assert(near(a.bin(k).r, b.bin(k).r, 1e-6) && near(a.bin(k).i, b.bin(k).i, 1e-6));
+			}
+		}
+	}
+	b.forward(x+3*N, M-3*N);
+	for(unsigned k=1; k<13; ++k){
+		assert(near(a.binComp(0)[k], b.bin(k).r, 1e-6) && near(a.binComp(1)[k], b.bin(k).i, 1e-6));
+		assert(near(a.binComp(0)[k], c.binComp(0)[k], 1e-5) && near(a.binComp(1)[k], c.binComp(1)[k], 1e-5));
+		assert(b.binComp(0)[k] == b.bin(k).r && b.binComp(1)[k] == b.bin(k).i);
+	}
+}
+
+// Asynchronous STFT is a synchronous STFT delayed by one hop
+{
+	const unsigned N = 64, H = 16, M = N*8;
+	struct Halve : public AsyncSTFT{
+		Halve(): AsyncSTFT(N, H, 0, HANN, MAG_PHASE){}
+		~Halve(){ stop(); }
+		void onFrame(STFT& s){ for(unsigned k=0; k<s.numBins(); ++k) s.bin(k)[0] *= 0.5f; }
+	};
+
+	for(int bg=0; bg<2; ++bg){
+		STFT ref(N, H, 0, HANN, MAG_PHASE);
+		Halve as;
+		assert(as.latency() == N-1+H);
+		if(bg) assert(as.start());
+		float y[M];
+		for(unsigned i=0; i<M; ++i){
+			float s = std::sin(0.21f*i) + 0.3f*std::cos(0.05f*i*i);
+			if(ref(s)) for(unsigned k=0; k<ref.numBins(); ++k) ref.bin(k)[0] *= 0.5f;
+			y[i] = ref();
+			float a = as(s);
+			if(i >= H) assert(near(a, y[i-H], 1e-6));
+			else assert(a == 0.f);
+		}
+	}
+}
+
+// Constant-Q bins measure the amplitude of sinusoids at their centers
+{
+	Domain dom(8000);
+	ConstantQ cq(100, 36, 12, 256), cq2(100, 36, 12, 128);
+	dom << cq << cq2;
+	assert(cq.sizeFFT() == 2048 && cq2.sizeFFT() == cq.sizeFFT());
+	for(unsigned k : {0u, 13u, 35u}){
+		const double f = cq.freq(k);
+		unsigned frames = 0;
+		for(unsigned i=0; i<4096; ++i) frames += cq(float(0.5*sin(M_2PI*f*i/8000.)));
+		assert(16 == frames);
+		assert(near(cq.bin(k).mag(), 0.5f, 0.01));
+		if(k+3 < cq.numBins()) assert(cq.bin(k+3).mag() < 0.01f);
+		if(k>=3) assert(cq.bin(k-3).mag() < 0.01f);
+	}
+
+	// Kernels are shared and freed with the last transform using them
+	const unsigned kernels = ConstantQ::cachedKernels();
+	{
+		ConstantQ a(50, 10, 12), b(50, 10, 12);
+		assert(ConstantQ::cachedKernels() == kernels+1);
+		a.kernelThreshold(0.01f);
+		assert(ConstantQ::cachedKernels() == kernels+2);
+		b.kernelThreshold(0.01f);
+		assert(ConstantQ::cachedKernels() == kernels+1);
+	}
+	assert(ConstantQ::cachedKernels() == kernels);
+}
+
+// Phase vocoder moves a sinusoid by the pitch ratio and keeps its frequency
+// when time stretched
+{
+	const unsigned N = 1024, H = 256, M = N*16;
+	const double f = 40.3/N;
+	// Amplitude at frequency f (cycles/sample) of x over [b,e)
+	auto amp = [](const std::vector<float>& x, unsigned b, unsigned e, double f){
+		double re=0, im=0;
+		for(unsigned i=b; i<e; ++i){
+			double w = 1. - cos(M_2PI*(i-b)/(e-b));
+			re += w*x[i]*cos(M_2PI*f*i); im += w*x[i]*sin(M_2PI*f*i);
+		}
+		return 2.*sqrt(re*re + im*im)/(e-b);
+	};
+	std::vector<float> src(M);
+	for(unsigned i=0; i<M; ++i) src[i] = 0.5*sin(M_2PI*f*i);
+
+	for(int lock=0; lock<2; ++lock){
+		const PhaseVocoder::PhaseLocking locking = lock ? PhaseVocoder::LOCK_IDENTITY : PhaseVocoder::LOCK_NONE;
+
+		STFT stft(N, H, 0, HANN, MAG_PHASE);
+		PhaseVocoder pv;
+		pv.pitch(1.5).phaseLocking(locking);
+		AsyncPhaseVocoder as(N, H);
+		as.vocoder().pitch(1.5).phaseLocking(locking);
+		std::vector<float> y(M);
+		for(unsigned i=0; i<M; ++i){
+			if(stft(src[i])) pv(stft);
+			y[i] = stft();
+			float a = as(src[i]);
+			if(i >= H) assert(near(a, y[i-H], 1e-5));
+		}
+		assert(amp(y, M/2, M, 1.5*f) > 0.25);
+		assert(amp(y, M/2, M, f) < 0.001);
+
+		STFT st(N, H, 0, HANN, MAG_PHASE);
+		PhaseVocoder pv2;
+		pv2.stretch(2).phaseLocking(locking);
+		std::vector<float> out, hop(N);
+		for(unsigned pos=0; pos+N<=M; pos+=H/2){
+			st.forward(&src[pos]);
+			pv2(st);
+			st.inverse(&hop[0]);
+			out.insert(out.end(), hop.begin(), hop.begin()+H);
+		}
+		assert(out.size() == 2*(M-N)+H);
+		assert(amp(out, out.size()/4, out.size()*3/4, f) > 0.45);
+	}
+}
+
+// DCT and MDCT match their direct sums; MDCT frames overlap-add back to
+// the input
+{
+	for(unsigned N : {8u, 64u, 24u}){
+		DCT<double> dct(N);
+		std::vector<double> x(N), X(N);
+		for(unsigned n=0; n<N; ++n) x[n] = sin(1.3*n) + 0.1*n;
+		X = x;
+		dct.forward(&X[0]);
+		for(unsigned k=0; k<N; ++k){
+			double s = 0;
+			for(unsigned n=0; n<N; ++n) s += x[n]*cos(M_PI/N*(n+0.5)*k);
+			assert(near(X[k], s, 1e-10));
+		}
+		dct.inverse(&X[0]);
+		for(unsigned n=0; n<N; ++n) assert(near(X[n], x[n], 1e-12));
+	}
+
+	for(unsigned M : {4u, 32u, 12u}){
+		MDCT<double> mdct(M);
+		const unsigned N = mdct.sizeWin();
+		assert(N == 2*M && mdct.sizeHop() == M);
+		std::vector<double> x(N), y(N);
+		for(unsigned n=0; n<N; ++n) x[n] = sin(1.3*n) + 0.1*n;
+		mdct.forward(&x[0]);
+		for(unsigned k=0; k<M; ++k){
+			double s = 0;
+			for(unsigned n=0; n<N; ++n) s += mdct.window()[n]*x[n]*cos(M_PI/M*(n+0.5+M/2.)*(k+0.5));
+			assert(near(mdct.coefs()[k], s, 1e-10));
+		}
+		mdct.inverseFrame(&y[0]);
+		for(unsigned n=0; n<N; ++n){
+			double s = 0;
+			for(unsigned k=0; k<M; ++k) s += mdct.coefs()[k]*cos(M_PI/M*(n+0.5+M/2.)*(k+0.5));
+			assert(near(y[n], s*2./M, 1e-12));
+		}
+
+		for(int kbd=0; kbd<2; ++kbd){
+			if(kbd) mdct.windowKBD(4); else mdct.windowSine();
+			mdct.reset();
+			unsigned frames = 0;
+			for(unsigned t=0; t<20*M; ++t){
+				frames += mdct(sin(0.37*t) + 0.3*cos(1.9*t));
+				const double out = mdct();
+				const double in = t<N ? 0. : sin(0.37*(t-N)) + 0.3*cos(1.9*(t-N));
+				assert(near(out, in, 1e-12));
+			}
+			assert(frames == 20);
+		}
+	}
+}
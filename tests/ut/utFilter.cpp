@@ -4,6 +4,279 @@
 		
 }
 
+// Multichannel biquad matches a biquad per channel
+{
+	const unsigned N = 4, M = 50;
+	Biquad<float, float, Domain1> ref[N];
+	BiquadN<N, Domain1> bank;
+	const FilterType types[N] = {LOW_PASS, HIGH_PASS, BAND_PASS, PEAKING};
+	for(unsigned k=0; k<N; ++k){
+		ref[k].set(0.01f + 0.05f*k, 1.f + k, types[k]);
+		bank.set(k, 0.01f + 0.05f*k, 1.f + k, types[k]);
+	}
+	ref[3].level(2.f); bank.level(3, 2.f);
+
+	float frames[M*N], planar[N][M];
+	float * chans[N] = {planar[0], planar[1], planar[2], planar[3]};
+	for(unsigned j=0; j<M*N; ++j) frames[j] = (j%7) * 0.1f - 0.3f;
+	for(unsigned j=0; j<M; ++j) for(unsigned k=0; k<N; ++k) planar[k][j] = frames[j*N + k];
+
+	bank(frames, frames, M);
+	for(unsigned j=0; j<M; ++j) for(unsigned k=0; k<N; ++k){
+		assert(near(frames[j*N + k], ref[k](planar[k][j]), 1e-5));
+	}
+
+	bank.zero();
+	bank(chans, chans, M);
+	for(unsigned j=0; j<M; ++j) for(unsigned k=0; k<N; ++k){
+		assert(near(planar[k][j], frames[j*N + k], 1e-6));
+	}
+}
+
+// Compact biquad state matches a biquad with the same coefficients
+{
+	const unsigned M = 100;
+	Biquad<float, float, Domain1> ref(0.07f, 3.f, PEAKING);
+	ref.level(2.f);
+	BiquadState<> st[2];
+	st[0].coefs(ref);
+	st[1].coefs(ref);
+	assert(sizeof(st[0]) == 7*sizeof(float));
+	float x[M], y[M];
+	for(unsigned i=0; i<M; ++i) x[i] = (i%9) * 0.1f - 0.4f;
+	st[1](y, x, M);
+	for(unsigned i=0; i<M; ++i){
+		float r = ref(x[i]);
+		assert(near(st[0](x[i]), r, 1e-6) && near(y[i], r, 1e-6));
+	}
+}
+
+// Biquad cascade matches a chain of biquads
+{
+	const unsigned N = 5, M = 600;
+	Biquad<float, float, Domain1> ref[N];
+	BiquadCascade<N, Domain1> cas;
+	const FilterType types[N] = {LOW_PASS, HIGH_PASS, PEAKING, LOW_SHELF, BAND_PASS};
+	for(unsigned k=0; k<N; ++k){
+		ref[k].set(0.02f + 0.04f*k, 0.7f + k, types[k]);
+		cas.set(k, 0.02f + 0.04f*k, 0.7f + k, types[k]);
+	}
+	ref[2].level(2.f); cas.level(2, 2.f);
+
+	float buf[M], x[M];
+	for(unsigned i=0; i<M; ++i) x[i] = buf[i] = (i%11) * 0.1f - 0.5f;
+
+	cas(buf, 100);
+	cas(buf+100, buf+100, M-100);
+	for(unsigned i=0; i<M; ++i){
+		float y = x[i];
+		for(unsigned k=0; k<N; ++k) y = ref[k](y);
+		assert(near(buf[i], y, 1e-4));
+	}
+
+	cas.zero();
+	for(unsigned i=0; i<M; ++i) assert(near(cas(x[i]), buf[i], 1e-5));
+}
+
+// Block frequency sweeps track per-sample frequency updates
+{
+	const unsigned M = 32;
+	Biquad<float, float, Domain1> bq(0.05f, 4.f), bqRef(0.05f, 4.f);
+	Reson<float, float, Domain1> rs(0.05f, 0.01f), rsRef(0.05f, 0.01f);
+	float x[M], y1[M], y2[M];
+	for(unsigned i=0; i<M; ++i) x[i] = (i%5) * 0.2f - 0.4f;
+
+	for(unsigned b=0; b<4; ++b){
+		float f0 = 0.05f + 0.004f*b, f1 = f0 + 0.004f;
+		bq(y1, x, M, f1);
+		rs(y2, x, M, f1);
+		for(unsigned i=0; i<M; ++i){
+			float f = f0 + (f1-f0)*(i+1.f)/M;
+			bqRef.freq(f); rsRef.freq(f);
+			assert(near(y1[i], bqRef(x[i]), 2e-3));
+			assert(near(y2[i], rsRef(x[i]), 2e-3));
+		}
+	}
+	for(unsigned k=0; k<3; ++k) assert(near(bq.a()[k], bqRef.a()[k], 1e-5));
+
+	// Glides run per sample match block glides and end on the targets
+	Biquad<float, float, Domain1> bq2(0.05f, 4.f), bq3(0.05f, 4.f);
+	Notch<float, float, Domain1> nt(0.05f, 0.01f), nt2(0.05f, 0.01f);
+	bq2.freq(0.08f, M/2); bq2(y1, x, M);
+	bq3.freq(0.08f, M/2);
+	nt.width(0.02f, M/2); nt(y2, x, M);
+	nt2.width(0.02f, M/2);
+	for(unsigned i=0; i<M; ++i){
+		assert(near(y1[i], bq3(x[i]), 1e-5));
+		assert(near(y2[i], nt2(x[i]), 1e-5));
+	}
+	bqRef.freq(0.08f);
+	for(unsigned k=0; k<3; ++k) assert(bq2.a()[k] == bqRef.a()[k] && bq3.a()[k] == bqRef.a()[k]);
+}
+
+// Batched designs match the filters' setters
+{
+	const unsigned M = 6;
+	const float frq[M] = {0.001f, 0.01f, 0.05f, 0.13f, 0.3f, 0.45f};
+	const float res[M] = {0.5f, 0.707f, 1.f, 3.f, 8.f, 20.f};
+	const float lev[M] = {0.1f, 0.5f, 1.f, 2.f, 4.f, 8.f};
+	float c[5*M];
+
+	const FilterType types[] = {LOW_PASS, HIGH_PASS, BAND_PASS, RESONANT, BAND_REJECT, ALL_PASS, PEAKING, LOW_SHELF, HIGH_SHELF};
+	for(FilterType t : types){
+		biquadCoefs(c, frq, res, lev, M, t, 1.);
+		for(unsigned i=0; i<M; ++i){
+			Biquad<float, float, Domain1> bq(frq[i], res[i], t);
+			bq.level(lev[i]);
+			for(unsigned k=0; k<3; ++k) assert(near(c[5*i+k], bq.a()[k], 1e-6));
+			for(unsigned k=1; k<3; ++k) assert(near(c[5*i+2+k], bq.b()[k], 1e-6));
+		}
+	}
+
+	// Loading a table gives the same output as setting the filter
+	Biquad<float, float, Domain1> bq1(0.1f, 2.f, BAND_PASS), bq2;
+	biquadCoefs(c, frq+2, res+2, 0, 1, BAND_PASS, 1.);
+	bq1.freq(frq[2]); bq1.res(res[2]);
+	bq2.coefs(c);
+	for(unsigned i=0; i<16; ++i){ float x = (i%3)*0.5f; assert(near(bq1(x), bq2(x))); }
+
+	Reson<float, float, Domain1> rs(0.1f, 0.01f);
+	Notch<float, float, Domain1> nt(0.1f, 0.01f);
+	AllPass2<float, float, Domain1> ap(0.1f, 0.01f);
+	resonCoefs(c, frq, res, M, 0.01);
+	for(unsigned i=0; i<M; ++i){
+		rs.set(frq[i]*0.01f, res[i]*0.01f);
+		for(unsigned k=0; k<3; ++k) assert(near(c[3*i+k], rs.coefs()[k]));
+	}
+	notchCoefs(c, frq, res, M, 0.01);
+	for(unsigned i=0; i<M; ++i){
+		nt.width(res[i]*0.01f); nt.freq(frq[i]*0.01f);
+		for(unsigned k=0; k<3; ++k) assert(near(c[3*i+k], nt.coefs()[k]));
+	}
+	allPass2Coefs(c, frq, res, M, 0.01);
+	for(unsigned i=0; i<M; ++i){
+		ap.width(res[i]*0.01f); ap.freq(frq[i]*0.01f);
+		for(unsigned k=0; k<3; ++k) assert(near(c[3*i+k], ap.coefs()[k]));
+	}
+}
+
+// Batched frequency responses
+{
+	const unsigned N = 301;
+	const float frq[2] = {0.1f, 0.3f}, lev[2] = {1.f, 4.f};
+	float c[10], f[N], mag[N], phs[N], mag1[N], mag2[N];
+	biquadCoefs(c, frq, NULL, lev, 1, LOW_PASS, 1.);
+	biquadCoefs(c+5, frq+1, NULL, lev+1, 1, PEAKING, 1.);
+	for(unsigned k=0; k<N; ++k) f[k] = 0.5f*k/(N-1);
+
+	TransferFunc tf;
+	tf.addX(c[0], 0).addX(c[1], -1).addX(c[2], -2).addY(-c[3], -1).addY(-c[4], -2);
+	std::vector<TransferFunc::Complex> H(N);
+	tf(&H[0], 0, 0.5/(N-1), N);
+	biquadResponse(mag, phs, c, 1, f, N, 1.);
+	for(unsigned k=0; k<N; ++k){
+		const TransferFunc::Complex h = tf(0.5*k/(N-1));
+		assert(near(H[k].real(), h.real(), 1e-9) && near(H[k].imag(), h.imag(), 1e-9));
+		assert(near(mag[k], float(std::abs(h)), 1e-4));
+		assert(near(mag[k]*std::cos(phs[k]), float(h.real()), 1e-4));
+		assert(near(mag[k]*std::sin(phs[k]), float(h.imag()), 1e-4));
+	}
+	assert(near(mag[0], 1.f, 1e-5) && near(mag[60], 0.707f, 1e-3)); // unity at DC, -3 dB at cutoff
+
+	// Sections in series multiply
+	biquadResponse(mag1, NULL, c+5, 1, f, N, 1.);
+	biquadResponse(mag2, NULL, c, 2, f, N, 1.);
+	for(unsigned k=0; k<N; ++k) assert(near(mag2[k], mag[k]*mag1[k], 1e-4));
+	assert(near(mag1[180], 4.f, 1e-3)); // peak level at center
+}
+
+// Block first-order filters match their per-sample versions
+{
+	const unsigned M = 40;
+	float x[M], y[M];
+	for(unsigned i=0; i<M; ++i) x[i] = (i%6) * 0.2f - 0.5f;
+
+	OnePole<float, float, Domain1> op1(0.05f), op2(0.05f);
+	AllPass1<float, float, Domain1> ap1(0.1f), ap2(0.1f);
+	BlockDC<float, float, Domain1> dc1(0.01f), dc2(0.01f);
+	BlockNyq<float, float, Domain1> ny1(0.01f), ny2(0.01f);
+	Integrator<float, float> in1(0.9f), in2(0.9f);
+	Differencer<float> df1, df2;
+
+	op1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], op2(x[i])));
+	ap1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], ap2(x[i])));
+	dc1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], dc2(x[i])));
+	ny1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], ny2(x[i])));
+	in1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], in2(x[i])));
+	df1(y, x, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], df2(x[i])));
+
+	op1 = 1.f; op2 = 1.f;
+	op1(y, M); for(unsigned i=0; i<M; ++i) assert(near(y[i], op2()));
+
+	// Lanes of a bank smooth towards their own stored values
+	const unsigned N = 4;
+	OnePoleN<N, Domain1> bank;
+	OnePole<float, float, Domain1> ref[N];
+	for(unsigned k=0; k<N; ++k){
+		bank.freq(k, 0.01f*(k+1)); ref[k].freq(0.01f*(k+1));
+		bank.stored(k, k+1.f); ref[k] = k+1.f;
+	}
+	float frames[M*N], in[M*N];
+	for(unsigned j=0; j<M*N; ++j) in[j] = x[j % M];
+	bank(frames, M/2);
+	bank(frames + M/2*N, in + M/2*N, M/2);
+	for(unsigned j=0; j<M; ++j) for(unsigned k=0; k<N; ++k){
+		float r = j < M/2 ? ref[k]() : ref[k](in[j*N + k]);
+		assert(near(frames[j*N + k], r));
+	}
+}
+
+// Block Hilbert transform and frequency shifter match per-sample versions
+{
+	const unsigned M = 300;
+	float x[M], re[M], im[M], y[M];
+	for(unsigned i=0; i<M; ++i) x[i] = std::sin(0.05f*i*i) + 0.2f*(i%4);
+
+	Hilbert<> h1, h2;
+	Hilbert<double, double> h3;
+	for(unsigned i=0; i<M; ){
+		unsigned m = 1 + (i*5) % 23; if(i+m > M) m = M-i;
+		h1(re+i, im+i, x+i, m);
+		i += m;
+	}
+	double xd[M], red[M], imd[M];
+	for(unsigned i=0; i<M; ++i) xd[i] = x[i];
+	h3(red, imd, xd, 100); h3(red+100, imd+100, xd+100, M-100);
+	for(unsigned i=0; i<M; ++i){
+		Complex<float> c = h2(x[i]);
+		assert(near(re[i], c.r) && near(im[i], c.i));
+		assert(near(red[i], c.r, 1e-5) && near(imd[i], c.i, 1e-5));
+	}
+
+	FreqShift<> fs1(100), fs2(100);
+	fs1(y, x, 150); fs1(y+150, x+150, M-150);
+	for(unsigned i=0; i<M; ++i) assert(near(y[i], fs2(x[i]), 1e-4));
+
+	// Output stages by block match their per-sample versions
+	Quantizer<float> q1(44100, 1./64), q2(q1);
+	q1.gain(1.7); q2.gain(1.7); q1.clip(0.75); q2.clip(0.75);
+	q1(y, x, M);
+	for(unsigned i=0; i<M; ++i) assert(y[i] == q2(x[i]) && scl::abs(y[i]) <= 0.75f);
+	q1.freq(300); q2.freq(300);
+	q1(y, x, 100); q1(y+100, x+100, M-100);
+	for(unsigned i=0; i<M; ++i) assert(y[i] == q2(x[i]));
+
+	AM<float> am(0.5);
+	am(y, x, re, M);
+	for(unsigned i=0; i<M; ++i) assert(near(y[i], am(x[i], re[i])));
+	am.ring(y, x, re, M);
+	for(unsigned i=0; i<M; ++i) assert(near(y[i], 0.5f*re[i]*x[i]));
+
+	Biquad3 b1(500, 1000, 2000), b2(b1);
+	b1(y, x, 100); b1(y+100, x+100, M-100);
+	for(unsigned i=0; i<M; ++i) assert(near(y[i], b2(x[i]), 1e-5));
+}
+
 {
 	MovingAvg<> fil(4);
 	assert(near(fil(1), 0.25));
@@ -13,4 +286,1073 @@
 	assert(near(fil(1), 1.  ));
 }
 
+// Block moving averages match their per-sample versions
+{
+	const unsigned M = 50, N = 4, L = 7;
+	float x[M], y[M];
+	for(unsigned i=0; i<M; ++i) x[i] = (i%9) * 0.1f - 0.3f;
+
+	MovingAvg<float> ma1(L), ma2(L);
+	ma1(y, x, 10);
+	ma1(y+10, x+10, M-10);
+	for(unsigned i=0; i<M; ++i) assert(near(y[i], ma2(x[i])));
+
+	// Each channel of a cascade is a chain of moving averages
+	MovingAvgN<N, 3> bank(L);
+	MovingAvg<float> ref[N][3];
+	for(unsigned k=0; k<N; ++k) for(unsigned s=0; s<3; ++s) ref[k][s].resize(L);
+	float frames[M*N];
+	for(unsigned j=0; j<M*N; ++j) frames[j] = x[(j*3) % M];
+	float in[M*N];
+	for(unsigned j=0; j<M*N; ++j) in[j] = frames[j];
+	bank(frames, frames, 20);
+	bank(frames + 20*N, frames + 20*N, M-20);
+	for(unsigned j=0; j<M; ++j) for(unsigned k=0; k<N; ++k){
+		float r = in[j*N + k];
+		for(unsigned s=0; s<3; ++s) r = ref[k][s](r);
+		assert(near(frames[j*N + k], r, 1e-5));
+	}
+}
+
+// Denormal flushing keeps reverb tails cheap
+{
+	ReverbMS<float, Loop1P, ipl::Trunc, Domain1> rv;
+	rv.resize(JCREVERB).decay(200).damping(0.2);
+
+	// Without flushing, the decaying tail passes through denormals which 
+	// are slow to compute on most FPUs.
+	bool wasFlushing = DenormalGuard::flushToZero();
+	{
+		DenormalGuard denormals;
+		if(DenormalGuard::flushToZero()){
+			int subnormals = 0;
+			float v = 1;
+			for(int i=0; i<400000; ++i){
+				v = rv(i==0 ? 1.f : 0.f);
+				subnormals += std::fpclassify(v) == FP_SUBNORMAL;
+			}
+			assert(0 == subnormals);
+			assert(0.f == v);
+		}
+	}
+	assert(DenormalGuard::flushToZero() == wasFlushing);
+}
+
+// Reverb rings and comb lanes give the same output as delay line objects,
+// both per sample and per block
+{
+	typedef ReverbMS<float, Loop1P, ipl::Trunc, Domain1> Reverb;
+	Reverb rv1, rv2;
+	rv1.resize(FREEVERB).decay(4000).damping(0.3);
+	rv2.resize(FREEVERB).decay(4000).damping(0.3);
+
+	Echo<float, ipl::Trunc, Loop1P, Domain1> combs[8];
+	Comb<float, ipl::Trunc, float, Domain1> allpasses[4];
+	for(unsigned i=0; i<8; ++i){
+		unsigned d = rv1.combDelay(i);
+		combs[i].maxDelay(d); combs[i].delay(d);
+		combs[i].damping(0.3); combs[i].decay(4000);
+	}
+	for(unsigned i=0; i<4; ++i){
+		unsigned d = rv1.allpassDelay(i);
+		allpasses[i].maxDelay(d); allpasses[i].delay(d);
+		allpasses[i].allPass(0.71);
+	}
+
+	const unsigned N = 4000;
+	std::vector<float> x(N), y(N);
+	for(unsigned i=0; i<N; ++i) x[i] = std::sin(i*i*0.001f);
+	rv2.process(&x[0], &y[0], 100);
+	rv2.process(&x[100], &y[100], N-100);
+
+	for(unsigned i=0; i<N; ++i){
+		float v = x[i];
+		for(auto& a : allpasses) v = a(v);
+		float r = 0;
+		for(auto& c : combs) r += c(v);
+		float s = rv1(x[i]);
+		assert(near(s, r, 1e-5));
+		assert(near(y[i], s, 1e-5));
+	}
+	assert(rv1.read({1,1,1,1,1,1,1,1}) == rv2.read({1,1,1,1,1,1,1,1}));
+}
+
+// Archived state continues filters, delays, phases and reverb tails
+{
+	typedef ReverbMS<float, Loop1P, ipl::Trunc, Domain1> Reverb;
+	Biquad<float, float, Domain1> bq1(0.05, 4), bq2;
+	Delay<float, ipl::Linear, Domain1> dl1(400, 173.3), dl2(400, 10);
+	Accum<phsInc::Loop, Domain1> ac1(0.013), ac2;
+	Reverb rv1, rv2;
+	rv1.resize(JCREVERB).decay(4000).damping(0.3);
+	for(unsigned i=0; i<5000; ++i){
+		float x = std::sin(i*i*0.001f);
+		bq1(x); dl1(x); ac1(); rv1(x);
+	}
+
+	StateWriter w;
+	bq1.state(w); dl1.state(w); ac1.state(w); rv1.state(w);
+	assert(w.ok());
+	const char * path = "state.bin";
+	assert(w.save(path));
+
+	StateReader r;
+	assert(r.map(path) && r.size() == w.size());
+	bq2.state(r); dl2.state(r); ac2.state(r); rv2.state(r);
+	assert(r.ok() && 0 == r.remaining());
+	for(unsigned i=0; i<5000; ++i){
+		float x = std::sin(i*0.01f);
+		assert(bq1(x) == bq2(x));
+		assert(dl1(x) == dl2(x));
+		assert(ac1() == ac2());
+		assert(rv1(x) == rv2(x));
+	}
+
+	// Mismatched sizes fail without touching the destination
+	Delay<float, ipl::Linear, Domain1> dl3(800, 10);
+	StateReader r2(w.data(), w.size());
+	bq2.state(r2); dl3.state(r2);
+	assert(!r2.ok() && dl3.delay() == 10);
+
+	// A truncated or inconsistent reverb state leaves the reverb unchanged
+	{
+		StateWriter wr;
+		rv1.state(wr);
+		std::vector<char> bytes((const char *)wr.data(), (const char *)wr.data() + wr.size());
+		Reverb rv3, rv4;
+		rv3.resize(FREEVERB).decay(1000);
+		rv4.resize(FREEVERB).decay(1000);
+		StateReader rt(&bytes[0], bytes.size()-4);
+		rv3.state(rt);
+		assert(!rt.ok());
+		unsigned nc;
+		std::memcpy(&nc, &bytes[2*sizeof(float)], sizeof nc);
+		++nc;
+		std::memcpy(&bytes[2*sizeof(float)], &nc, sizeof nc);
+		StateReader rc(&bytes[0], bytes.size());
+		rv3.state(rc);
+		assert(!rc.ok());
+		assert(rv3.numCombs() == rv4.numCombs());
+		for(unsigned i=0; i<1000; ++i){
+			float x = std::sin(i*0.01f);
+			assert(rv3(x) == rv4(x));
+		}
+	}
+
+	// Fixed capacity never grows
+	StateWriter wf(16);
+	rv1.state(wf);
+	assert(!wf.ok() && wf.capacity() == 16);
+	remove(path);
+}
+
+// Feedback delay network decays by 60 dB over the decay length
+{
+	ReverbFDN<float, 8, LoopGain, ipl::Linear, Domain1> rv1, rv2;
+	rv1.delays(300, 900).decay(12000);
+	rv2.delays(300, 900).decay(12000);
+	for(unsigned k=1; k<rv1.size(); ++k) assert(rv1.delay(k) > rv1.delay(k-1));
+
+	const unsigned N = 24000;
+	std::vector<float> x(N, 0.f), y(N);
+	x[0] = 1;
+	rv2.process(&x[0], &y[0], N);
+
+	double e0 = 0, e1 = 0;
+	for(unsigned i=0; i<N; ++i){
+		float s = rv1(x[i]);
+		assert(near(s, y[i], 1e-6));
+		if(i>=1000 && i<3000) e0 += s*s;
+		if(i>=13000 && i<15000) e1 += s*s;
+	}
+	assert(near(10*std::log10(e1/e0), -60, 1.5));
+
+	// Householder feedback and modulation also decay
+	rv2.zero();
+	rv2.matrix(HOUSEHOLDER).modulate(10, 1);
+	rv2.process(&x[0], &y[0], N);
+	double e2 = 0;
+	for(unsigned i=20000; i<N; ++i) e2 += y[i]*y[i];
+	assert(e2 > 0 && e2 < 1e-4);
+}
+
+// Head-related filter with a control period glides to the same filters as
+// setting them at once; a table gives the designed filters on its grid
+{
+	const double spu = Domain::master().spu();
+	Domain::master().spu(44100);
+	{
+		const float pose[16] = {1,0,0,0, 0,1,0,0, 0,0,1,0, 0,0,0,1};
+		const Vec<3,float> src(1.5, 0.5, -1);
+		HRFilter f1, f2;
+		f2.controlPeriod(32);
+		f1.pos(src, pose);
+		f2.pos(src, pose);
+		for(unsigned i=0; i<4000; ++i){
+			float x = std::sin(i*0.1f);
+			float3 y1 = f1(x), y2 = f2(x);
+			if(i >= 3000){
+				for(int k=0; k<3; ++k) assert(near(y1[k], y2[k], 1e-5));
+			}
+		}
+
+		HRTable tab(36, 19, 1./44100);
+		float frq[4], lvl[4];
+		HRFilter::earParams(frq, lvl, 0.5, 0, -std::sqrt(0.75f));	// 30 deg right
+		const float res[4] = {0.707, 24, 48, 4};
+		const FilterType types[4] = {HIGH_SHELF, PEAKING, PEAKING, PEAKING};
+		const float * c = tab.coefs(0.5, 0, -std::sqrt(0.75f));
+		for(int k=0; k<4; ++k){
+			float ref[5];
+			biquadCoefs(ref, frq+k, res+k, lvl+k, 1, types[k], 1./44100);
+			for(int m=0; m<5; ++m) assert(near(c[5*k+m], ref[m], 1e-6));
+		}
+	}
+	Domain::master().spu(spu);
+}
+
+// Batched spatial scene places sources between the ears and renders the
+// same in blocks of any size
+{
+	const double spu = Domain::master().spu();
+	Domain::master().spu(44100);
+	{
+		const unsigned S = 3, N = 300;
+		HRBatchScene sc1(S), sc2(S);
+		const float x[S] = { 2, -2, 8}, y[S] = {0.5, 0.5, 0.5}, z[S] = {0, 0, 0};
+		sc1.pos(x, y, z).wallAtten(0);
+		sc2.pos(x, y, z).wallAtten(0);
+		sc1.update();
+		assert(sc1.dist(0,1) < sc1.dist(0,0));
+		assert(sc1.dist(1,0) < sc1.dist(1,1));
+		assert(near(sc1.dist(2,1), std::sqrt(8.f*8.f + 0.25f) - 0.07, 0.01));
+
+		std::vector<float> in(N, 0.f), zero(N, 0.f), l1(N), r1(N), l2(N), r2(N);
+		for(unsigned i=0; i<N; ++i) in[i] = std::sin(i*0.05f);
+
+		// Each source alone: right source is louder on right, far source quieter
+		double eL[S], eR[S];
+		for(unsigned k=0; k<S; ++k){
+			const float * src[S] = {&zero[0], &zero[0], &zero[0]};
+			src[k] = &in[0];
+			HRBatchScene sc(S);
+			sc.pos(x, y, z).wallAtten(0);
+			sc.process(src, &l1[0], &r1[0], N);
+			eL[k] = eR[k] = 0;
+			for(unsigned i=0; i<N; ++i){ eL[k] += l1[i]*l1[i]; eR[k] += r1[i]*r1[i]; }
+		}
+		assert(eR[0] > eL[0] && eL[1] > eR[1]);
+		assert(eR[2] < eR[0]);
+
+		const float * src[S] = {&in[0], &in[0], &in[0]};
+		sc1.process(src, &l1[0], &r1[0], N);
+		for(unsigned i=0; i<N; i+=70){
+			unsigned m = std::min(70u, N-i);
+			const float * s[S] = {&in[i], &in[i], &in[i]};
+			sc2.process(s, &l2[i], &r2[i], m);
+		}
+		for(unsigned i=0; i<N; ++i){
+			assert(near(l1[i], l2[i], 1e-5));
+			assert(near(r1[i], r2[i], 1e-5));
+		}
+	}
+
+	// Ear filters are designed at the sampling rate, so the pinna notch of
+	// a source in front is at the same frequency at any rate
+	for(double rate : {48000., 96000.}){
+		Domain::master().spu(rate);
+		const unsigned N = unsigned(rate/4), S = 1;
+		double rms[2];
+		for(int t=0; t<2; ++t){
+			HRBatchScene sc(S);
+			const float x[S] = {0}, y[S] = {0}, z[S] = {-1};
+			sc.pos(x, y, z).wallAtten(0);
+			std::vector<float> in(N), l(N), r(N);
+			const double f = t ? 8000 : 6500;
+			for(unsigned i=0; i<N; ++i) in[i] = std::sin(M_2PI*f*i/rate);
+			const float * src[S] = {&in[0]};
+			sc.process(src, &l[0], &r[0], N);
+			rms[t] = 0;
+			for(unsigned i=N/2; i<N; ++i) rms[t] += l[i]*l[i];
+		}
+		assert(std::sqrt(rms[1]/rms[0]) < 0.65);
+	}
+	Domain::master().spu(spu);
+}
+
+
+// Ambisonics harmonics follow SN3D, and decoding a source encoded in a
+// speaker direction of a regular layout gives the projection gains
+{
+	const float x = 1/std::sqrt(14.f), y = 2/std::sqrt(14.f), z = 3/std::sqrt(14.f);
+	float Y[36];
+	sphericalHarmonics(Y, 5, 1, 2, 3);
+	const float s3 = std::sqrt(3.f);
+	assert(near(Y[0], 1, 1e-6));
+	assert(near(Y[1], y, 1e-6) && near(Y[2], z, 1e-6) && near(Y[3], x, 1e-6));
+	assert(near(Y[4], s3*x*y, 1e-6));
+	assert(near(Y[5], s3*y*z, 1e-6));
+	assert(near(Y[6], 0.5f*(3*z*z - 1), 1e-6));
+	assert(near(Y[7], s3*x*z, 1e-6));
+	assert(near(Y[8], 0.5f*s3*(x*x - y*y), 1e-6));
+	for(unsigned n=0; n<=5; ++n){	// sum over degree is P_n(1) = 1
+		float e = 0;
+		for(unsigned c=n*n; c<(n+1)*(n+1); ++c) e += Y[c]*Y[c];
+		assert(near(e, 1, 1e-5));
+	}
+
+	const float spk[6][3] = {{1,0,0},{-1,0,0},{0,1,0},{0,-1,0},{0,0,1},{0,0,-1}};
+	AmbiDecoder dec1(1, 6), dec2(1, 6);
+	for(int l=0; l<6; ++l){
+		dec1.speaker(l, spk[l][0], spk[l][1], spk[l][2]);
+		dec2.speaker(l, spk[l][0], spk[l][1], spk[l][2]);
+	}
+	dec2.method(AmbiDecoder::MODE_MATCHING);
+	dec1.update(); dec2.update();
+	for(int l=0; l<6; ++l){
+		for(unsigned c=0; c<4; ++c) assert(near(dec1.coef(l,c), dec2.coef(l,c), 1e-5));
+	}
+
+	const unsigned N = 64;
+	AmbiEncoder enc(1, 2);
+	enc.dir(0, 1, 0, 0).dir(1, 0, 0, 2);
+	std::vector<float> in(N, 1.f), zero(N, 0.f), bus(4*N, 0.f), out(6*N);
+	const float * src[2] = {&in[0], &zero[0]};
+	float * busp[4] = {&bus[0], &bus[N], &bus[2*N], &bus[3*N]};
+	float * outp[6];
+	for(int l=0; l<6; ++l) outp[l] = &out[l*N];
+	enc.process(src, busp, N);
+	dec1.process(busp, outp, N);
+	const float g[6] = {4./6, -2./6, 1./6, 1./6, 1./6, 1./6};
+	for(int l=0; l<6; ++l) assert(near(out[l*N + N-1], g[l], 1e-6));
+
+	// Gains glide to a new direction over the next block
+	enc.dir(0, 0, 1, 0);
+	std::fill(bus.begin(), bus.end(), 0.f);
+	enc.process(src, busp, N);
+	assert(near(bus[1*N + 0], 1.f/N, 1e-6));	// Y channel
+	assert(near(bus[3*N + 0], 1 - 1.f/N, 1e-6));	// X channel
+	assert(near(bus[1*N + N-1], 1, 1e-6) && near(bus[3*N + N-1], 0, 1e-6));
+}
+
+// Half-band resampling passes low frequencies with a fixed delay and
+// oversampling rejects components above the base Nyquist frequency
+{
+	const int N = 300;
+	float x[N], u[2*N], y[N];
+	for(int i=0;i<N;++i) x[i] = std::sin(0.05*i);
+	HalfBand hb(12);
+	hb.up(u, x, N);
+	hb.down(y, u, N);
+	const int D = hb.latency();
+	for(int i=100;i<N;++i) assert(near(y[i], x[i-D], 1e-4));
+
+	Oversample<4> ovs;
+
+	// A "generator" at 0.35 of the oversampled rate, above base Nyquist
+	struct Cos{ double p, w; float operator()(){ p += w; return std::cos(p); } };
+	Cos hi = {0, M_2PI*0.35}, lo = {0, M_2PI*0.01};
+	float out[N];
+	ovs(out, N, hi);
+	for(int i=100;i<N;++i) assert(std::fabs(out[i]) < 1e-3);
+	ovs.reset();
+	ovs(out, N, lo);
+	float peak = 0;
+	for(int i=100;i<N;++i) peak = scl::max(peak, std::fabs(out[i]));
+	assert(near(peak, 1, 2e-3));
+
+	// Chebyshev waveshaping by block, by table and oversampled
+	ChebyN<16, float> cheb;
+	for(unsigned k=0; k<16; ++k) cheb.c[k] = 1.f/(k+1);
+	float w[N];
+	cheb(w, x, N);
+	for(int i=0;i<N;++i) assert(near(w[i], cheb(x[i]), 1e-4));
+	cheb.bake(4096);
+	cheb(y, x, N);
+	for(int i=0;i<N;++i) assert(near(y[i], w[i], 2e-3));
+	ovs.reset();
+	ovs.block(y, x, N, cheb);
+	peak = 0;
+	for(int i=100;i<N;++i) peak = scl::max(peak, std::fabs(y[i]));
+	assert(peak > 1 && cheb.baked() && !cheb.bake(0).baked());
+}
+
+// Early reflections follow the images of sources and render as their taps
+{
+	const double spu = Domain::master().spu();
+	Domain::master().spu(44100);
+	{
+		EarlyReflections er(2, 1);
+		er.room(5, 4, 3).listener(2, 2, 1.5).earDist(0.1).wallGain(0.5);
+		er.wallGain(EarlyReflections::FLOOR, 0.25);
+		er.pos(0, 3, 1, 1).pos(1, 1, 3, 2);
+		er.update();
+		assert(er.paths() == 6);
+
+		// Floor reflection of source 0 to left ear, from image at (3,1,-1)
+		const float r = std::sqrt(1.1f*1.1f + 1.f + 2.5f*2.5f);
+		int found = 0;
+		for(unsigned k=0; k<6; ++k){
+			if(near(er.pathDelay(0,k,0), r/343.2*44100, 1e-2)){
+				++found;
+				assert(near(er.pathGain(0,k,0), 0.25/r, 1e-5));
+			}
+		}
+		assert(found == 1);
+
+		// Moving a source only changes its own paths
+		const float d0 = er.pathDelay(0,0,1), d1 = er.pathDelay(1,0,1);
+		er.pos(0, 2.5, 1, 1).update();
+		assert(er.pathDelay(0,0,1) != d0 && er.pathDelay(1,0,1) == d1);
+
+		// Render an impulse of source 0 in blocks of odd sizes
+		EarlyReflections er2(2, 1);
+		er2.room(5, 4, 3).listener(2, 2, 1.5).earDist(0.1).wallGain(0.5);
+		er2.pos(0, 3, 1, 1).pos(1, 1, 3, 2);
+		const unsigned N = 2048;
+		std::vector<float> imp(N, 0.f), zero(N, 0.f), out[2], ref[2];
+		imp[0] = 1;
+		for(int e=0; e<2; ++e){ out[e].assign(N, 0.f); ref[e].assign(N, 0.f); }
+		for(unsigned i=0; i<N;){
+			const unsigned m = i+77 < N ? 77 : N-i;
+			const float * src[2] = {&imp[i], &zero[i]};
+			er2.process(src, &out[0][i], &out[1][i], m);
+			i += m;
+		}
+		for(int e=0; e<2; ++e){
+			for(unsigned k=0; k<er2.paths(); ++k){
+				const float d = er2.pathDelay(0,k,e), g = er2.pathGain(0,k,e);
+				const unsigned D = unsigned(d);
+				ref[e][D] += g*(1 - (d-D));
+				ref[e][D+1] += g*(d-D);
+			}
+			for(unsigned i=0; i<N; ++i) assert(near(out[e][i], ref[e][i], 1e-5));
+		}
+	}
+	Domain::master().spu(spu);
+}
+
+// Vector-base panning between triangles of speakers
+{
+	// Octahedron: front, left, back, right, top, bottom
+	VBAP oct(3);
+	oct.addSpeaker(0).addSpeaker(90).addSpeaker(180).addSpeaker(270);
+	oct.addSpeaker(0, 90).addSpeaker(0, -90);
+	oct.direction(0, 0).direction(1, 45).pos(2, -1, 1, 1);
+	oct.update();
+	assert(oct.triangles() == 8 && oct.numImaginary() == 0);
+	assert(near(oct.gain(0,0), 1) && near(oct.gain(0,1), 0));
+	assert(near(oct.gain(1,0), M_SQRT1_2) && near(oct.gain(1,1), M_SQRT1_2) && near(oct.gain(1,4), 0));
+	for(unsigned k=0; k<6; ++k) assert(near(oct.gain(2,k), k==0 || k==1 || k==4 ? 1./std::sqrt(3.) : 0, 1e-5));
+
+	// Horizontal ring pans between pairs through imaginary poles
+	VBAP ring(1);
+	for(int k=0; k<8; ++k) ring.addSpeaker(45*k);
+	ring.direction(0, 45+22.5).update();
+	assert(ring.numImaginary() == 2 && ring.triangles() == 16);
+	assert(near(ring.gain(0,1), ring.gain(0,2)) && near(ring.gain(0,1), M_SQRT1_2));
+
+	// Dome without top speaker gets a top and a bottom
+	VBAP dome(40);
+	for(int k=0; k<8; ++k) dome.addSpeaker(45*k);
+	for(int k=0; k<4; ++k) dome.addSpeaker(90*k + 45, 45);
+	dome.update();
+	assert(dome.numImaginary() == 2 && dome.triangles() == 24);
+	for(unsigned s=0; s<40; ++s) dome.direction(s, s*37.f, s*2.f);
+	dome.update();
+	for(unsigned s=0; s<40; ++s){
+		float pow = 0;
+		for(unsigned k=0; k<dome.numSpeakers(); ++k) pow += dome.gain(s,k)*dome.gain(s,k);
+		assert(s*2 >= 45 || near(pow, 1, 1e-4)); // below top ring
+	}
+
+	// Gains glide after a move and hold in between
+	const unsigned N = 20;
+	float in[N], o[6][N] = {{0}};
+	for(unsigned i=0; i<N; ++i) in[i] = 1;
+	oct.numSources(1);
+	oct.direction(0, 0).glide(8);
+	for(unsigned i=0, m=5; i<N; i+=m, m=m*3%7+3){ // blocks of 5, 8, 6, 1
+		if(m > N-i) m = N-i;
+		const float * src[1] = {in + i};
+		float * out[6];
+		for(int k=0; k<6; ++k) out[k] = o[k] + i;
+		oct.process(src, out, m);
+		if(!i) oct.direction(0, 90);
+	}
+	for(unsigned i=0; i<5; ++i) assert(o[0][i] == 1 && o[1][i] == 0);
+	for(unsigned i=5; i<N; ++i){
+		const float g = i < 13 ? (i-4)/8.f : 1.f;
+		assert(near(o[0][i], 1-g, 1e-5) && near(o[1][i], g, 1e-5));
+	}
+	for(unsigned k=2; k<6; ++k) for(unsigned i=0; i<N; ++i) assert(o[k][i] == 0);
+}
+
+
+// Envelope followers of many channels with meters
+{
+	Domain dom(1000);
+	const unsigned C = 10, N = 25;
+	EnvFollowBank b(C, 0.002, 0.01, 10);
+	dom << b;
+	b.attack(9, 0);
+	float in[C*N], out[C*N];
+	for(unsigned i=0; i<C*N; ++i) in[i] = ((i*7919) % 13) / 6.f - 1.f;
+	uint32_t count = b.meterCount();
+	b.process(in, out, N);
+	assert(b.meterCount() == count + 2);
+	const float ca = scl::t60(2.), cr = scl::t60(10.);
+	for(unsigned c=0; c<C; ++c){
+		float y = 0, peak = 0;
+		for(unsigned i=0; i<N; ++i){
+			const float x = scl::abs(in[c*N + i]);
+			y = x + (y - x) * (x > y ? (c==9 ? 0.f : ca) : cr);
+			assert(near(out[c*N + i], y, 1e-6));
+			if(i >= 10 && i < 20) peak = y > peak ? y : peak;
+		}
+		assert(near(b.value(c), y, 1e-6) && b.meter(c) == peak);
+	}
+}
+
+// Lookahead limiter
+{
+	Domain dom(1000);
+	const unsigned C = 3, N = 300;
+	Limiter l1(C, 0.5, 0.016, 0.05), l2(C, 0.5, 0.016, 0.05);
+	dom << l1 << l2;
+	assert(16 == l1.latency());
+	std::vector<float> in(C*N), out1(C*N), out2(C*N);
+	for(unsigned i=0; i<N; ++i){
+		in[0*N + i] = 0.3f * float(sin(0.1*i));
+		in[1*N + i] = (i >= 100 && i < 110) || i == 200 ? 3.f : 0.2f;
+		in[2*N + i] = i & 1 ? -0.1f : 0.1f;
+	}
+	l1.process(&in[0], &out1[0], N);
+	// Any block size gives the same output
+	std::vector<float> blk(C*7);
+	for(unsigned b=0; b<N; b+=7){
+		const unsigned m = N-b < 7 ? N-b : 7;
+		for(unsigned c=0; c<C; ++c) for(unsigned i=0; i<m; ++i) blk[c*m+i] = in[c*N+b+i];
+		l2.process(&blk[0], &blk[0], m);
+		for(unsigned c=0; c<C; ++c) for(unsigned i=0; i<m; ++i) out2[c*N+b+i] = blk[c*m+i];
+	}
+	for(unsigned i=0; i<C*N; ++i){
+		assert(near(out1[i], out2[i], 1e-6));
+		assert(scl::abs(out1[i]) <= 0.5f*(1.f + 1e-6f));
+	}
+	for(unsigned i=0; i<16; ++i) assert(out1[i] == 0.f);
+	// Quiet input passes at unity gain; loud input is limited to the
+	// threshold with one gain for all channels
+	for(unsigned i=16; i<80; ++i) assert(near(out1[i], in[i-16], 1e-6));
+	assert(near(out1[N + 116], 0.5f, 1e-5) && near(out1[N + 216], 0.5f, 1e-5));
+	assert(near(out1[2*N + 116] / in[2*N + 100], 0.5f/3.f, 1e-5));
+	assert(l1.gain() > 0.8f && l1.gain() < 0.9f); // recovering after last peak
+}
+
+// Compressor bank
+{
+	Domain dom(1000);
+	const unsigned C = 10, N = 200;
+	const float dB = 6.0205999f; // per octave, where the fast curves are exact
+	CompressorBank cb(C, -4*dB, 4, 0.002, 0.002);
+	dom << cb;
+	cb.threshold(1, -2*dB).ratio(1, 1).expandRatio(1, 2);
+	cb.threshold(2, -2*dB).ratio(2, 1).expandRatio(2, 2).range(2, dB).makeup(2, dB);
+	cb.threshold(3, 0).ratio(3, 1e9).knee(3, 8*dB);
+	std::vector<float> in(C*N, 1.f), out(C*N);
+	for(unsigned i=0; i<N; ++i){
+		in[1*N + i] = in[2*N + i] = 1.f/16;
+		in[4*N + i] = 1.f/32; // below threshold
+	}
+	cb.process(&in[0], &out[0], N);
+	const unsigned e = N-1;
+	assert(near(out[0*N + e], 1.f/8, 1e-4));		// 4 octaves over, 3 reduced
+	assert(near(out[1*N + e], 1.f/64, 1e-4));		// 2 under, 2 more expanded
+	assert(near(out[2*N + e], 1.f/16, 1e-4));		// expansion limited to 1, made up
+	assert(near(out[3*N + e], 1.f/2, 1e-4));		// reduced at threshold by knee
+	assert(near(out[4*N + e], 1.f/32, 1e-6));		// unity
+	assert(near(out[9*N + e], 1.f/8, 1e-4));		// second group of lanes
+	assert(near(cb.gain(0), -3*dB, 1e-2) && near(cb.gain(2), -dB, 1e-2));
+	assert(out[0] > 0.25f && out[0] < 1.f); // attack is smoothed
+
+	// Linked channels follow the loudest peak; a sidechain drives its channel
+	cb.channels(2).threshold(-4*dB).ratio(4).knee(0).expandRatio(1).range(96).makeup(0);
+	cb.reset();
+	cb.link(true);
+	cb.process(&in[4*N], &out[0], N);
+	assert(near(out[e] / in[4*N + e], 1.f/8, 1e-4) && near(out[N + e], 1.f/8, 1e-4));
+	cb.reset();
+	cb.link(false);
+	std::vector<float> quiet(2*N, 1.f/32);
+	cb.process(&quiet[0], &out[0], N, &in[0]);
+	assert(near(out[e], 1.f/256, 1e-5) && near(out[N + e], 1.f/32, 1e-5));
+}
+
+// Linkwitz-Riley crossover
+{
+	Domain dom(48000);
+	const unsigned B = 4, C = 10, N = 4800;
+	Crossover xo(B, C);
+	dom << xo;
+	xo.freq(0, 200).freq(1, 1000).freq(2, 5000);
+	std::vector<float> in(C*N), out(B*C*N);
+	std::vector<const float *> src(C);
+	std::vector<float *> dst(B*C);
+	for(unsigned c=0; c<C; ++c){
+		for(unsigned i=0; i<N; ++i) in[c*N + i] = c==1 ? float(sin(M_2PI*50*i/48000.)) : (i==c ? 1.f : 0.f);
+		src[c] = &in[c*N];
+	}
+	for(unsigned k=0; k<B*C; ++k) dst[k] = &out[k*N];
+	xo.process(&dst[0], &src[0], 1000);
+	xo.reset(); // as new
+	xo.process(&dst[0], &src[0], N);
+
+	// Bands sum to the all-passes of the splits
+	Biquad<> ap[3] = {Biquad<>(200, 0.707, ALL_PASS), Biquad<>(1000, 0.707, ALL_PASS), Biquad<>(5000, 0.707, ALL_PASS)};
+	for(unsigned k=0; k<3; ++k) dom << ap[k];
+	for(unsigned i=0; i<N; ++i){
+		const float y = ap[2](ap[1](ap[0](in[i])));
+		float sum = 0.f;
+		for(unsigned k=0; k<B; ++k){
+			sum += out[(k*C + 0)*N + i];
+			assert(i+9 >= N || out[(k*C + 9)*N + i + 9] == out[(k*C + 0)*N + i]); // lanes agree
+		}
+		assert(near(sum, y, 1e-4));
+	}
+	// Low tone is in the low band
+	float peak[B] = {0};
+	for(unsigned k=0; k<B; ++k){
+		for(unsigned i=N/2; i<N; ++i) peak[k] = scl::max(peak[k], scl::abs(out[(k*C + 1)*N + i]));
+	}
+	assert(peak[0] > 0.99f && peak[1] < 0.01f && peak[3] < 1e-4f);
+}
+
+// Formant bank matches band-passes per formant and glides between vowels
+{
+	Domain dom(44100);
+	const unsigned V = 10, N = 300, F = FormantBank::FORMANTS; // two groups of voices
+	FormantBank fb(V);
+	dom << fb;
+
+	// Table holds band-passes scaled by amplitudes
+	Biquad<> bp(Vowel::freq(Vowel::CHILD, Vowel::HUD, 1), 12.5, BAND_PASS);
+	dom << bp;
+	const float * c = fb.coefs(Vowel::CHILD, Vowel::HUD) + 5;
+	const float amp = Vowel::amp(Vowel::CHILD, Vowel::HUD, 1);
+	for(unsigned j=0; j<3; ++j) assert(near(c[j], bp.a()[j]*amp, 1e-6));
+	for(unsigned j=1; j<3; ++j) assert(near(c[2+j], bp.b()[j], 1e-6));
+
+	std::vector<float> in(V*N), out(V*N);
+	std::vector<const float *> src(V);
+	std::vector<float *> dst(V);
+	for(unsigned v=0; v<V; ++v){
+		for(unsigned i=0; i<N; ++i) in[v*N + i] = i==v ? 1.f : (float((i*7 + v) % 13) - 6.f) * 0.01f;
+		src[v] = &in[v*N]; dst[v] = &out[v*N];
+	}
+
+	const SIMDPath prev = simdPath();
+	const SIMDPath paths[] = {SIMD_SCALAR, simdBest()};
+	for(SIMDPath q : paths){
+		simdPath(q);
+		fb.voices(V);
+		for(unsigned v=0; v<V; ++v){
+			fb.vowel(v, Vowel::Voice(v%3), Vowel::Phoneme(v), Vowel::Phoneme((v+4)%10), v%2 ? 0.3f : 0.f);
+		}
+		fb.process(&dst[0], &src[0], 100);
+		for(unsigned v=0; v<V; ++v){ src[v] += 100; dst[v] += 100; }
+		fb.process(&dst[0], &src[0], N-100);
+		for(unsigned v=0; v<V; ++v){ src[v] -= 100; dst[v] -= 100; }
+
+		for(unsigned v=0; v<V; ++v){
+			const float * a = fb.coefs(Vowel::Voice(v%3), Vowel::Phoneme(v));
+			const float * b = fb.coefs(Vowel::Voice(v%3), Vowel::Phoneme((v+4)%10));
+			const float mix = v%2 ? 0.3f : 0.f;
+			Biquad<float, float, Domain1> ref[F];
+			for(unsigned f=0; f<F; ++f){
+				float k[5];
+				for(unsigned j=0; j<5; ++j) k[j] = a[5*f+j] + (b[5*f+j] - a[5*f+j])*mix;
+				ref[f].coef(k[0], k[1], k[2], k[3], k[4]);
+			}
+			for(unsigned i=0; i<N; ++i){
+				float y = 0;
+				for(unsigned f=0; f<F; ++f) y += ref[f](in[v*N + i]);
+				assert(near(out[v*N + i], y, 1e-4));
+			}
+		}
+
+		// Gliding to another vowel ends on it
+		FormantBank g1(1), g2(1);
+		dom << g1 << g2;
+		float zero[50] = {0}, imp[50] = {1}, y1[50], y2[50];
+		const float * s[1] = {zero};
+		float * d[1] = {y1};
+		g1.vowel(0, Vowel::MAN, Vowel::HEED);
+		g1.process(d, s, 50);
+		g1.vowel(0, Vowel::MAN, Vowel::HOD);
+		g1.process(d, s, 50);
+		s[0] = imp;
+		g1.process(d, s, 50);
+		g2.vowel(0, Vowel::MAN, Vowel::HOD);
+		d[0] = y2;
+		g2.process(d, s, 50);
+		for(unsigned i=0; i<50; ++i) assert(near(y1[i], y2[i], 1e-6));
+	}
+	simdPath(prev);
+}
+
+// Gammatone bank matches cascaded complex one-poles and tracks its band
+{
+	Domain dom(16000);
+	const unsigned B = 12, N = 2000; // two groups of bands
+	GammatoneBank gb(B, 100, 4000);
+	dom << gb;
+	assert(near(gb.freq(0), 100.f, 1e-3) && near(gb.freq(B-1), 4000.f, 0.1));
+
+	std::vector<float> x(N), out(B*N), env(B*N);
+	std::vector<float *> dst(B), ev(B);
+	for(unsigned k=0; k<B; ++k){ dst[k] = &out[k*N]; ev[k] = &env[k*N]; }
+
+	// Reference of one band in double precision
+	const unsigned K = 7;
+	const double r = exp(-M_2PI * 1.019*GammatoneBank::erb(gb.freq(K)) / 16000.);
+	const std::complex<double> p = std::polar(r, M_2PI * gb.freq(K) / 16000.);
+	std::complex<double> s[4];
+
+	const SIMDPath prev = simdPath();
+	const SIMDPath paths[] = {SIMD_SCALAR, simdBest()};
+	for(SIMDPath q : paths){
+		simdPath(q);
+		gb.reset();
+		gb.decimation(50);
+		for(unsigned i=0; i<N; ++i) x[i] = float(sin(M_2PI * gb.freq(K) * i / 16000.));
+		const unsigned w1 = gb.process(&dst[0], &x[0], 130, &ev[0]);
+		for(unsigned k=0; k<B; ++k){ dst[k] += 130; ev[k] += w1; }
+		const unsigned w = w1 + gb.process(&dst[0], &x[130], N-130, &ev[0]);
+		for(unsigned k=0; k<B; ++k){ dst[k] -= 130; ev[k] -= w1; }
+		assert(w1 == 2 && w == N/50);
+
+		for(auto& v : s) v = 0;
+		for(unsigned i=0; i<N; ++i){
+			std::complex<double> z = x[i];
+			for(auto& v : s) z = v = z + p*v;
+			assert(near(out[K*N + i], float(2.*pow(1.-r, 4)*z.real()), 1e-4));
+		}
+
+		// Settled envelope is unity in the band and small elsewhere
+		assert(near(env[K*N + w-1], 1.f, 0.02));
+		assert(env[0*N + w-1] < 0.01f && env[(B-1)*N + w-1] < 0.01f);
+	}
+	simdPath(prev);
+}
+
+// Fundamental frequency estimation
+{
+	Domain dom(44100);
+	PitchYIN p(2048, 512);
+	dom << p;
+	unsigned hops = 0;
+	for(unsigned i=0; i<4096; ++i){
+		double ph = M_2PI * 220.5 * i / 44100.;
+		hops += p(float(sin(ph) + 0.5*sin(2*ph) + 0.3*sin(3*ph + 1)));
+	}
+	assert(8 == hops && p.voiced() && near(p.freq(), 220.5f, 0.1) && p.clarity() > 0.9f);
+
+	float silent[2048] = {0};
+	assert(0 == p.analyze(silent) && !p.voiced());
+}
+
+// Partial tracking keeps each partial in one slot
+{
+	Domain dom(48000);
+	STFT stft(2048, 512, 0, HANN, MAG_PHASE);
+	dom << stft;
+	PartialTracker pt(4);
+	SineBank<> bank;
+	dom << bank;
+	double ph1 = 0, ph2 = 0;
+	unsigned frames = 0;
+	int slot1 = -1;
+	for(unsigned i=0; i<48000; ++i){
+		const double f1 = 440 + 60.*i/48000; // glides a little each frame
+		ph1 += M_2PI * f1/48000; ph2 += M_2PI * 3000./48000;
+		if(stft(float(0.5*sin(ph1) + 0.1*sin(ph2))) && ++frames > 4){
+			pt(stft);
+			pt.apply(bank);
+			unsigned n = 0;
+			for(unsigned k=0; k<pt.size(); ++k){
+				if(!pt.active(k)) continue;
+				++n;
+				if(pt.freq(k) < 1000){
+					if(slot1 < 0) slot1 = k;
+					assert(int(k) == slot1 && near(pt.amp(k), 0.5f, 0.02) && scl::abs(pt.freq(k) - f1) < 10);
+				}
+				else assert(near(pt.freq(k), 3000.f, 0.5) && near(pt.amp(k), 0.1f, 0.005));
+			}
+			assert(2 == n && bank.freq(slot1) == pt.freq(slot1) && bank.amp(slot1) == pt.amp(slot1));
+		}
+	}
+	assert(pt.age(slot1) == frames - 4);
+}
+
+// Loudness of a stereo 1 kHz tone at -23 dBFS is -23 LUFS, as in EBU Tech 3341
+{
+	Domain dom(48000);
+	LoudnessMeter lm(2);
+	dom << lm;
+	const unsigned N = 480;
+	float in[2*N];
+	const double amp = pow(10., -23./20);
+	unsigned t = 0;
+	for(unsigned b=0; b<400; ++b){ // 4 s
+		for(unsigned i=0; i<N; ++i, ++t) in[i] = in[N+i] = float(amp * sin(M_2PI*1000.*t/48000.));
+		lm.process(in, N);
+		if(b == 99) assert(lm.momentary() > -23.1f && lm.shortTerm() < -200.f);
+	}
+	assert(40 == lm.meterCount());
+	assert(near(lm.momentary(), -23.f, 0.05) && near(lm.shortTerm(), -23.f, 0.05));
+	assert(near(lm.integrated(), -23.f, 0.05));
+
+	// Silence is gated out of integrated loudness, but not the fade into it
+	for(unsigned i=0; i<2*N; ++i) in[i] = 0.f;
+	for(unsigned b=0; b<500; ++b) lm.process(in, N);
+	assert(lm.momentary() < -200.f && lm.shortTerm() < -200.f);
+	assert(lm.integrated() < -23.f && lm.integrated() > -23.3f);
+}
+
+// Sweep measurement of a two-tap system through a loopback of one block
+{
+	Domain dom(44100);
+	SweepMeasure m(50, 16000, 1, 0.25);
+	dom << m;
+	const unsigned B = 64;
+	std::vector<float> played;
+	float out[B], in[B] = {0};
+	m.start();
+	while(m.process(out, in, B)){
+		played.insert(played.end(), out, out+B);
+		for(unsigned i=0; i<B; ++i){
+			const unsigned t = played.size()-B+i;
+			in[i] = (t>=10 ? 0.5f*played[t-10] : 0.f) - (t>=40 ? 0.25f*played[t-40] : 0.f);
+		}
+	}
+	assert(m.done());
+
+	// Taps are band-limited to 16 kHz, so peaks are 16/22.05 of them
+	const float * ir = m.deconvolve();
+	assert(near(ir[B+10], 0.5f*0.726f, 0.02));
+	assert(near(ir[B+40], -0.5f*ir[B+10], 2e-3));
+	for(unsigned i=0; i<m.irSize(); ++i){
+		if(i < B-10 || i > B+60) assert(std::abs(ir[i]) < 0.01f);
+	}
+
+	// Second harmonic lands before linear response
+	std::vector<float> rec(m.sweep(), m.sweep() + m.sweepSize());
+	for(float& v : rec) v += 0.5f*v*v;
+	ir = m.deconvolve(&rec[0], rec.size());
+	const int h = -int(m.harmonicOffset(2) + 0.5f);
+	assert(std::abs(ir[h]) > 0.05f && std::abs(ir[h/2]) < 0.01f);
+}
+
+// Block zero-crossing rate and silence detection match per-sample
+{
+	const unsigned N = 500;
+	float x[N];
+	for(unsigned i=0; i<N; ++i) x[i] = i < 300 ? float(sin(0.1*i*i/N)) : 0.0001f;
+	ZeroCrossRate<float> z1(64), z2(64);
+	SilenceDetect s1(150), s2(150);
+	for(unsigned i=0; i<N; i+=50){
+		float r = 0; bool q = false;
+		for(unsigned j=i; j<i+50; ++j){ r = z1(x[j]); q = s1(x[j]); }
+		assert(z2(x+i, 50) == r && s2(x+i, 50) == q);
+	}
+	assert(s2.done());
+}
+
+// Peak cache levels match direct min/max/rms and survive joining and saving
+{
+	const int N = 70000, C = 2;
+	std::vector<float> x(N*C);
+	for(int i=0; i<N*C; ++i) x[i] = float(sin(0.0137*i*(1 + i%C))) * (0.5f + 0.4f*float(i%7)/7.f);
+
+	auto direct = [&](long long b, long long e, int c){
+		PeakCache::Peak p = {x[b*C+c], x[b*C+c], 0.f};
+		double ss = 0;
+		for(long long i=b; i<e; ++i){
+			const float v = x[i*C+c];
+			p.min = std::min(p.min, v); p.max = std::max(p.max, v); ss += v*v;
+		}
+		p.rms = float(sqrt(ss/(e-b)));
+		return p;
+	};
+	auto same = [](const PeakCache::Peak& a, const PeakCache::Peak& b, float eps){
+		return near(a.min, b.min, eps) && near(a.max, b.max, eps) && near(a.rms, b.rms, eps);
+	};
+
+	// Streamed in odd block sizes, finished part way and continued
+	PeakCache pc(C);
+	for(int i=0; i<N; ){
+		int n = std::min(N-i, 1000 + i%333);
+		pc.write(&x[i*C], n);
+		i += n;
+		if(i > 5000 && i < 7000) pc.finish();
+	}
+	pc.finish();
+	assert(pc.frames() == N);
+	for(int l=0; l<PeakCache::LEVELS; ++l){
+		const int B = PeakCache::binFrames(l);
+		assert(pc.bins(l) == (N + B-1)/B);
+		for(int b=0; b<pc.bins(l); ++b){
+		for(int c=0; c<C; ++c){
+			assert(same(pc.peak(l,b,c), direct(b*B, std::min(b*B+B, N), c), 1e-5));
+		}}
+	}
+	assert(same(pc.range(1000, 69000, 1), direct(768, 69120, 1), 1e-5));
+	assert(same(pc.range(0, N, 0), direct(0, N, 0), 1e-5));
+	assert(PeakCache::level(100) == 0 && PeakCache::level(5000) == 1 && PeakCache::level(1e6) == 2);
+
+	// Segments built separately join to the same cache
+	PeakCache a(C), b(C);
+	a.write(&x[0], 65536);
+	b.write(&x[65536*C], N-65536);
+	b.finish();
+	assert(!b.append(a) && a.append(b));
+	for(int l=0; l<PeakCache::LEVELS; ++l){
+		assert(a.bins(l) == pc.bins(l));
+		for(int i=0; i<pc.bins(l)*C; ++i) assert(same(a.peak(l,i/C,i%C), pc.peak(l,i/C,i%C), 1e-6));
+	}
+
+	// Sidecar file holds quantized peaks and can be read in part
+	const char * path = "peakCache.bin";
+	assert(pc.save(path));
+	PeakCache d;
+	assert(d.load(path) && d.channels() == C && d.frames() == N);
+	for(int l=0; l<PeakCache::LEVELS; ++l){
+		for(int i=0; i<pc.bins(l)*C; ++i) assert(same(d.peak(l,i/C,i%C), pc.peak(l,i/C,i%C), 1.f/32767));
+	}
+	PeakCache::Peak p[4*C];
+	assert(PeakCache::read(p, path, 0, 270, 4) == 4);
+	assert(PeakCache::read(p, path, 0, 272, 4) == 2);
+	assert(same(p[1*C+1], pc.peak(0,273,1), 1.f/32767));
+	assert(PeakCache::read(p, path, 1, 17, 4) == 1);
+	assert(same(p[1], pc.peak(1,17,1), 1.f/32767));
+
+	// Ranges use the finest level loaded
+	PeakCache d1;
+	assert(d1.load(path, 1) && d1.bins(0) == 0 && d1.bins(2) == 0);
+	assert(same(d1.range(1000, 69000, 1), direct(0, N, 1), 2.f/32767));
+	assert(same(d1.range(5000, 9000, 0), direct(4096, 12288, 0), 2.f/32767));
+
+	// Files whose counts disagree with their length are rejected
+	{	FILE * f = fopen(path, "r+b");
+		fseek(f, 0, SEEK_END);
+		const long length = ftell(f);
+		fclose(f);
+		assert(0 == truncate(path, length-2));
+		assert(!d1.load(path) && d1.frames() == 0);
+		assert(PeakCache::read(p, path, 0, 0, 1) == 0);
+	}
+	remove(path);
+
+	// Nothing is written without channels
+	PeakCache none(0);
+	none.write(&x[0], 1000);
+	none.finish();
+	assert(none.frames() == 0 && none.bins(0) == 0);
+}
+
+// Onset detection from frames of an STFT
+{
+	Domain dom(44100);
+	STFT stft(1024, 256, 0, HANN, MAG_PHASE);
+	dom << stft;
+	OnsetDetector od;
+	const int on[] = {10000, 30000, 31500, 50000};
+	int found = 0;
+	for(int i=0; i<60000; ++i){
+		double x = 0;
+		for(int o : on) if(i >= o) x += exp(-(i-o)/2000.) * sin(0.05*i*(1 + o/30000.));
+		if(stft(float(x)) && od(stft)){
+			assert(found < 4 && scl::abs(od.time()*44100 - on[found]) < 256);
+			++found;
+		}
+	}
+	assert(4 == found);
+}
+
+// Gates of many channels queue their crossings
+{
+	Domain dom(1000);
+	ThresholdBank tb(3, 0.5, 0.01);
+	dom << tb;
+	const unsigned n = 64;
+	float in[3*n] = {0};
+	in[0*n + 10] = 1; in[0*n + 15] = -0.3; // release threshold holds gate open
+	in[1*n + 60] = 0.7; // gate closes in next block
+	in[2*n + 40] = 0.6;
+	tb.process(in, n);
+	assert(tb.open(1) && !tb.open(2));
+	in[1*n + 60] = 0;
+	tb.process(in, n);
+	ThresholdBank::Event e[10];
+	unsigned k = 0;
+	while(k<10 && tb.pop(e[k])) ++k;
+	assert(10 == k);
+	const unsigned chan[] = {0,0,1,2,2, 0,0,1,2,2};
+	const unsigned time[] = {10,25,60,40,50, 74,89,70,104,114};
+	const bool open[] = {1,0,1,1,0, 1,0,0,1,0};
+	for(unsigned i=0; i<k; ++i){
+		assert(chan[i] == e[i].channel && time[i] == e[i].time && open[i] == e[i].open);
+	}
+	assert(1 == e[0].level && 0.7f == e[2].level);
+	assert(!tb.open(0) && !tb.open(1) && 0 == tb.events().overflows());
+}
+
+// Units take blocks through one generic interface
+{
+	static_assert(BLOCK_CALL == ProcessMethod<Biquad<>, float>::value, "");
+	static_assert(BLOCK_PROCESS == ProcessMethod<Delay<>, float>::value, "");
+	auto gain = [](float x){ return 0.5f*x; };
+	static_assert(BLOCK_PER_SAMPLE == ProcessMethod<decltype(gain), float>::value, "");
+	static_assert(BLOCK_CALL == GenerateMethod<Saw<>, float>::value, "");
+	static_assert(BLOCK_PER_SAMPLE == GenerateMethod<Sine<>, float>::value, "");
+
+	Domain dom(1000);
+	Sine<> s1(10), s2(10);
+	Biquad<> b1(100), b2(100);
+	Delay<> l1(0.01, 0.003), l2(0.01, 0.003);
+	dom << s1 << s2 << b1 << b2 << l1 << l2;
+	const unsigned n = 40;
+	float blk[n], ref[n];
+	generateSeries(blk, n, s1, b1, gain, l1);
+	for(unsigned i=0; i<n; ++i) ref[i] = l2(gain(b2(s2())));
+	for(unsigned i=0; i<n; ++i) assert(near(blk[i], ref[i], 1e-6));
+}
+
+// Unit expressions fuse chains into one loop
+{
+	Domain dom(1000);
+	Saw<> s1(10), s2(10);
+	Biquad<> b1(100), b2(100);
+	Env<2> e1(0, 0.01, 1, 0.02, 0), e2(e1);
+	Pan<> p1(0.3), p2(0.3);
+	dom << s1 << s2 << b1 << b2 << e1 << e2;
+	auto voice = s1 >> (b1 * e1 * 0.5f + 0.1f) >> p1;
+	static_assert(BLOCK_PROCESS == GenerateMethod<decltype(voice), Vec<2,float>>::value, "");
+	const unsigned n = 100; // more than one internal block
+	Vec<2,float> blk[n];
+	generate(voice, blk, n);
+	for(unsigned i=0; i<n; ++i){
+		Vec<2,float> ref = p2((b2(s2()) * e2()) * 0.5f + 0.1f);
+		assert(near(blk[i][0], ref[0], 1e-6) && near(blk[i][1], ref[1], 1e-6));
+	}
+
+	Biquad<> b3(100), b4(100);
+	dom << b3 << b4;
+	auto lpf = b1 >> b3;
+	float io[n];
+	for(unsigned i=0; i<n; ++i) io[i] = s1();
+	for(unsigned i=0; i<n; ++i) blk[i][0] = b4(b2(s2()));
+	process(lpf, io, io, n);
+	for(unsigned i=0; i<n; ++i) assert(near(io[i], blk[i][0], 1e-6));
+}
 }
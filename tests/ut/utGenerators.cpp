@@ -19,6 +19,246 @@
 		assert(g() == 0);
 	}
 
+	// Advancing phase matches stepping it
+	{
+		Accum<> a(0.0123, 0.3), b = a;
+		for(int i=0; i<1000; ++i) a.nextPhase();
+		b.advance(1000);
+		assert(a.phaseI() == b.phaseI());
+
+		Accum<phsInc::OneShot> c(0.0123), d = c;
+		for(int i=0; i<50; ++i) c.nextPhase();
+		d.advance(50);
+		assert(c.phaseI() == d.phaseI());
+		d.advance(100);
+		assert(d.done());
+	}
+
+	// Block phases report the samples that cycled and hard-sync to them
+	{
+		const int M = 300;
+		uint32_t phs[M];
+		unsigned cyc[M];
+		for(float f : {0.013f, 0.25f, -0.031f, 0.9f}){
+			Accum<> a(f, 0.7), b(f, 0.7);
+			unsigned n = a.nextPhases(phs, M, cyc), k = 0;
+			for(int i=0;i<M;++i){
+				assert(phs[i] == b.phaseI());
+				if(b.cycle()) assert(k < n && cyc[k++] == unsigned(i));
+			}
+			assert(k == n && a.phaseI() == b.phaseI());
+		}
+
+		Accum<> sync(0.017);
+		unsigned n = sync.nextPhases(phs, M, cyc);
+		Osc<> o1(0.05, 0, 64), o2(0.05, 0, 64);
+		o1.addSine(1); o2.addSine(1);
+		float a[M], b[M];
+		o1(a, M, cyc, n);
+		for(int i=0, k=0;i<M;++i){
+			if(k < int(n) && cyc[k] == unsigned(i)){ o2.phase(0); ++k; }
+			b[i] = o2();
+		}
+		for(int i=0;i<M;++i) assert(a[i] == b[i]);
+	}
+
+	// Block generation matches per-sample generation
+	{
+		const int M = 150; // spans several internal chunks
+		float a[M], b[M], fm[M];
+		for(int i=0;i<M;++i) fm[i] = 0.01f*(i%7);
+
+		Osc<> o1(0.013, 0.2, 64), o2(0.013, 0.2, 64);
+		o1.addSine(1); o2.addSine(1);
+		for(int i=0;i<M;++i) a[i] = o1();
+		o2(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i]));
+		for(int i=0;i<M;++i) a[i] = o1.atPhaseI(o1.nextPhase(fm[i]));
+		o2(b, fm, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i]));
+
+		// Compact state shares the table and steps as the oscillator
+		OscState<> os[2];
+		os[0].set(o1); os[1].set(o1);
+		assert(sizeof(os[0]) == 8);
+		for(int i=0;i<M;++i) a[i] = o1();
+		os[1](b, M, o1.table());
+		for(int i=0;i<M;++i) assert(near(a[i], os[0](o1.table())) && near(a[i], b[i]));
+		os[0].freq(0.013f, 1.);
+		assert(os[0].inc == o1.freqI());
+
+		Sweep<> s1(0.07), s2(0.07);
+		for(int i=0;i<M;++i) a[i] = s1();
+		s2(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i]));
+
+		LFO<> l1(0.03, 0, 0.3), l2(0.03, 0, 0.3);
+		for(int i=0;i<M;++i) a[i] = l1.pulse();
+		l2.pulse(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i]));
+
+		// decimated blocks are exact every K samples and close in between
+		LFO<phsInc::Loop, DomainObserver, ctlRate::Decimate<8> > l3(0.003);
+		LFO<phsInc::Loop, DomainObserver, ctlRate::Decimate<8, iplSeq::Cubic> > l4(0.003);
+		LFO<> l0(0.003);
+		for(int i=0;i<M;++i) a[i] = l0.cos();
+		l3.cos(b, 70); l3.cos(b+70, M-70);
+		l4.cos(fm, M);
+		for(int i=0;i<M;++i){
+			if(i%8 == 0) assert(near(a[i], b[i]) && near(a[i], fm[i]));
+			assert(near(a[i], b[i], 4e-3));
+			assert(near(a[i], fm[i], 1.5e-3));
+		}
+
+		// closed forms use different sine approximations per sample and block
+		Buzz<> z1(0.011, 0, 12), z2(0.011, 0, 12);
+		for(int i=0;i<M;++i) a[i] = z1();
+		z2(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i], 1e-3));
+
+		Saw<> w1(0.011), w2(0.011);
+		for(int i=0;i<M;++i) a[i] = w1();
+		w2(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i], 1e-3));
+
+		DSF<> d1(0.011, 1.5, 0.7, 8), d2(0.011, 1.5, 0.7, 8);
+		for(int i=0;i<M;++i) a[i] = d1();
+		d2(b, M);
+		for(int i=0;i<M;++i) assert(near(a[i], b[i], 1e-3));
+	}
+
+	// Mipmapped wavetable playback is band-limited
+	{
+		const int M = 256;
+		float saw[M], out[M], blk[M];
+		for(int i=0;i<M;++i) saw[i] = 2.f*i/M - 1.f;
+		MipmapTable<float> tbl(saw, M);
+		assert(tbl.levels() == 8);
+		for(int i=0;i<M;++i) assert(near(tbl.level(0)[i], saw[i], 1e-5));
+
+		// 10 cycles per transform so harmonics fall on multiples of bin 10
+		MipmapOsc<float> o1(tbl, 10./M), o2(tbl, 10./M);
+		for(int i=0;i<M;++i) out[i] = o1();
+		o2(blk, M);
+		for(int i=0;i<M;++i) assert(out[i] == blk[i]);
+
+		RFFT<float> fftM(M);
+		fftM.forward(out, false, true);
+		assert(std::hypot(out[2*10-1], out[2*10]) > 0.1);
+		for(int k=1;k<M/2;++k){
+			if(k%10) assert(std::hypot(out[2*k-1], out[2*k]) < 1e-3);
+		}
+	}
+
+	// Wavetable oscillator plays frames as mipmaps and morphs between them
+	{
+		const int M = 256, F = 3;
+		float src[F*M], a[M], b[M], out[M], blk[M];
+		for(int i=0;i<M;++i){
+			src[i] = 2.f*i/M - 1.f;
+			src[M+i] = i < M/2 ? 1.f : -1.f;
+			src[2*M+i] = std::sin(M_2PI*i/M);
+		}
+		WavetableSet<float> set(src, F, M);
+		assert(set.frames() == F && set.levels() == 8);
+		MipmapTable<float> saw(src, M), sqr(src+M, M);
+
+		MipmapOsc<float, ipl::Linear, phsInc::Loop, Domain1> m1(saw, 10./M), m2(sqr, 10./M);
+		WavetableOsc<float, phsInc::Loop, Domain1> w1(set, 10./M, 0.25), w2(set, 10./M, 0.25);
+		for(int i=0;i<M;++i){ a[i] = m1(); b[i] = m2(); out[i] = w1(); }
+		w2(blk, M);
+		for(int i=0;i<M;++i){
+			assert(near(out[i], a[i] + (b[i]-a[i])*0.25f, 1e-5));
+			assert(out[i] == blk[i]);
+		}
+
+		// Per-sample frame positions, clipped to the last frame
+		float pos[M];
+		for(int i=0;i<M;++i) pos[i] = i < M/2 ? 0.f : 5.f;
+		w1.phase(0); w2.phase(0); w2.frame(0);
+		w1(blk, pos, M);
+		for(int i=0;i<M;++i){
+			if(i == M/2) w2.frame(2);
+			assert(near(blk[i], w2(), 1e-6));
+		}
+
+		// Sets from a table cache share one block of memory
+		TableCache<float> cache;
+		WavetableSet<float> c1(cache, "frames", src, F, M), c2(cache, "frames", 0, F, M);
+		assert(cache.size() == 1 && c1.table(1,2) == c2.table(1,2));
+		for(int i=0;i<=M;++i) assert(c2.table(2,0)[i] == set.table(2,0)[i]);
+	}
+
+	// Sine bank matches individual sinusoids and retunes without resetting
+	{
+		const int P = 19, M = 100; // partials use both vector and scalar paths
+		SineBank<> bank(P), bank2(P);
+		SineD<double> sines[P];
+		for(int k=0;k<P;++k){
+			float f = 0.01f + 0.021f*k, a = 0.1f, d = k%2 ? 50.f : -1.f, p = 0.05f*k;
+			bank.set(k, f, a, d, p);
+			bank2.set(k, f, a, d, p);
+			sines[k].set(f, a, d, p);
+		}
+		float blk[M];
+		bank2(blk, M);
+		for(int i=0;i<M;++i){
+			double sum = 0;
+			for(int k=0;k<P;++k) sum += sines[k]();
+			float v = bank();
+			assert(near(v, sum, 1e-4));
+			assert(near(v, blk[i], 1e-5));
+		}
+
+		SineBank<> one(1);
+		one.set(0, 0.05f, 1.f);
+		for(int i=0;i<10;++i) one();
+		one.freq(0, 0.125f);
+		double pow = 0; // mean square of whole cycles is amp^2/2
+		for(int i=0;i<8;++i){ float v = one(); pow += v*v; }
+		assert(near(pow/8, 0.5, 1e-4));
+
+		SineBank<> none;
+		assert(none() == 0.f);
+		none(blk, M);
+		assert(blk[0] == 0.f && blk[M-1] == 0.f);
+	}
+
+	// Complex resonator bank rings as decaying sines and sleeps when decayed
+	{
+		const int P = 11, M = 100; // modes use both vector and scalar paths
+		CSineBank<> bank(P);
+		SineD<double> sines[P];
+		for(int k=0;k<P;++k){
+			float f = 0.01f + 0.021f*k, a = 0.1f, d = k%2 ? 50.f : 20.f, p = 0.05f*k;
+			bank.set(k, f, a, d);
+			bank.excite(k, p);
+			sines[k].set(f, a, d, p);
+		}
+		assert(!bank.asleep());
+		float blk[M];
+		bank(blk, M);
+		for(int i=0;i<M;++i){
+			double sum = 0;
+			for(int k=0;k<P;++k) sum += sines[k]();
+			assert(near(blk[i], sum, 1e-4));
+		}
+		for(int i=0;i<10 && !bank.asleep();++i) bank(blk, M);
+		assert(bank.asleep());
+
+		// An input impulse wakes it and starts each mode at zero phase
+		float in[M] = {1};
+		bank(blk, in, M);
+		assert(!bank.asleep());
+		assert(near(blk[0], 0));
+		for(int k=0;k<P;++k) sines[k].set(bank.freq(k), bank.amp(k), bank.decay(k));
+		for(int i=0;i<M;++i){
+			double sum = 0;
+			for(int k=0;k<P;++k) sum += sines[k]();
+			assert(near(blk[i], sum, 1e-4));
+		}
+	}
+
 	/*
 	NOTE: Amplitudes of oscillators are multiplied by 2 before being fed to
 	FFT so that magnitudes fall in a more intuitive range. The real-to-complex
@@ -78,6 +318,13 @@
 
 		{ SamplePlayer<> p; SamplePlayer<> q(p); }
 		{ Array<float> a; SamplePlayer<> p(a, 1); }
+		{	Array<float> a(16, 1.f); const float * e = a.elems();
+			SamplePlayer<> p; p.buffer(std::move(a), 1, 2);
+			assert(p.elems() == e && p.frames() == 8 && !a.valid());
+			float b[4] = {0};
+			p.buffer(ArrayView<float>(b, 4), 1, 1);
+			assert(p.elems() == b && p.frames() == 4 && p.usingExternalSource());
+		}
 		//{ SamplePlayer<> p("path/to/soundfile.wav"); }
 		
 		{
@@ -106,8 +353,316 @@
 			p.reset();
 			assert(p.pos() == 0);
 		}
+
+		// Advancing ends where stepping does in each playback mode
+		{
+			const int M = 32;
+			const double SR = Sync::master().spu();
+			Array<float> a(M);
+			#define CHECK_ADVANCE(Sp, rate)\
+			{	SamplePlayer<float, ipl::Linear, Sp> p(a, SR, rate), q(a, SR, rate);\
+				p.min(3); p.max(23); p.reset(); q.min(3); q.max(23); q.reset();\
+				const unsigned steps[] = {0, 1, 5, 16, 40, 7, 200};\
+				for(unsigned n : steps){\
+					for(unsigned i=0; i<n; ++i) p.advance();\
+					q.advance(n);\
+					assert(near(p.pos(), q.pos(), 1e-9));\
+				}\
+			}
+			CHECK_ADVANCE(phsInc::Loop, 0.83)
+			CHECK_ADVANCE(phsInc::OneShot, 0.83)
+			CHECK_ADVANCE(phsInc::OneShot, -0.83)
+			CHECK_ADVANCE(phsInc::NShot, 0.83)
+			CHECK_ADVANCE(phsInc::PingPong, 0.83)
+			CHECK_ADVANCE(phsInc::PingPong, 1.7)
+			#undef CHECK_ADVANCE
+
+			// Across several repeats and in reverse
+			for(double inc : {0.7, 1.3, -0.7}){
+				phsInc::NShot a, b;
+				a.repeats(4); b.repeats(4);
+				double pa = 2, pb = 2;
+				const unsigned steps[] = {3, 20, 1, 12, 30, 50};
+				for(unsigned n : steps){
+					for(unsigned i=0; i<n; ++i) pa = a(pa, inc, 10., 0.);
+					pb = b.skip(pb, inc, n, 10., 0.);
+					assert(near(pa, pb, 1e-9));
+				}
+				assert(pa != 2 && a.done(0xffffffff) && b.done(0xffffffff));
+			}
+		}
+
+		// Samples in storage types play as float
+		{
+			const int M = 32;
+			Array<float> a(M); Array<Sample16> b(M); Array<Half> c(M);
+			for(int i=0; i<M; ++i){ a[i] = std::sin(i*0.3f)*0.5f; b[i] = a[i]; c[i] = a[i]; }
+			SamplePlayer<float, ipl::Linear> pa(a, 1, 0.7);
+			SamplePlayer<Sample16, ipl::Linear> pb(b, 1, 0.7);
+			SamplePlayer<Half, ipl::Cubic> pc(c, 1, 0.7);
+			for(int i=0; i<40; ++i){
+				const float v = pa();
+				assert(near(pb(), v, 1./32768) && near(pc(), v, 2e-3));
+			}
+		}
+
+		// Block reads give the per-sample reads, also across the loop
+		{
+			const int M = 200, C = 2;
+			Array<float> a(M*C); Array<Sample16> b(M*C); Array<Half> c(M*C);
+			for(int i=0; i<M*C; ++i){ a[i] = std::sin(i*0.3f)*0.5f; b[i] = a[i]; c[i] = a[i]; }
+			float x[300], y[300];
+			#define CHECK_BLOCK(T, Si, Sp, arr, r)\
+			{	SamplePlayer<T, Si, Sp> p, q;\
+				p.buffer(arr, 1, C); q.buffer(arr, 1, C);\
+				p.rate(r); q.rate(r);\
+				for(int i=0; i<300; ++i) x[i] = p(1);\
+				for(int i=0, m=1; i<300; i+=m, m=m*5%71+1) q(&y[i], i+m<300 ? m : 300-i, 1);\
+				assert(q.pos() == p.pos());\
+				for(int i=0; i<300; ++i) assert(near(x[i], y[i], 1e-6));\
+			}
+			CHECK_BLOCK(float, ipl::Linear, phsInc::Loop, a, 0.83)
+			CHECK_BLOCK(float, ipl::Cubic, phsInc::Loop, a, 1.37)
+			CHECK_BLOCK(float, ipl::Cubic, phsInc::PingPong, a, 2.11)
+			CHECK_BLOCK(float, ipl::Round, phsInc::Loop, a, 0.83)
+			CHECK_BLOCK(Sample16, ipl::Linear, phsInc::Loop, b, 0.83)
+			CHECK_BLOCK(Half, ipl::Cubic, phsInc::OneShot, c, 0.77)
+			#undef CHECK_BLOCK
+		}
+
+		// Interleaved frames play as deinterleaved ones, also across the loop
+		{
+			const int M = 24, C = 3;
+			Array<float> a(M*C);
+			for(int i=0; i<M*C; ++i) a[i] = std::sin(i*0.7f);
+			#define CHECK_INTERLEAVED(Si)\
+			{	SamplePlayer<float, Si, phsInc::Loop> p(a, 1, 0.83), q;\
+				p.buffer(a, 1, C); q.buffer(p); q.rate(0.83); q.interleaved(true);\
+				assert(q.interleaved() && q.elems() != a.elems() && q.frames() == M);\
+				assert(q.elems()[1] == a[M] && q.elems()[C] == a[1]);\
+				float fp[C], fq[C];\
+				for(int i=0; i<60; ++i){\
+					p.readFrame(fp); q.readFrame(fq);\
+					for(int c=0; c<C; ++c) assert(near(fp[c], fq[c], 1e-6) && near(q.read(c), fp[c], 1e-6));\
+					p.advance(); q.advance();\
+				}\
+				q.interleaved(false);\
+				for(int i=0; i<M*C; ++i) assert(q.elems()[i] == a[i]);\
+			}
+			CHECK_INTERLEAVED(ipl::Trunc)
+			CHECK_INTERLEAVED(ipl::Round)
+			CHECK_INTERLEAVED(ipl::Linear)
+			CHECK_INTERLEAVED(ipl::Cubic)
+			CHECK_INTERLEAVED(ipl::Sinc)
+			#undef CHECK_INTERLEAVED
+
+			// Resampling keeps layout
+			SamplePlayer<float, ipl::Linear> p, q;
+			p.buffer(a, 1, C); q.buffer(a, 1, C);
+			assert(q.interleaved(true) && q.interleaved(true));
+			p.resample(1.5); q.resample(1.5);
+			assert(p.frames() == q.frames() && q.interleaved());
+			for(int i=0; i<p.frames(); ++i){
+				for(int c=0; c<C; ++c) assert(near(p.elems()[c*p.frames() + i], q.elems()[i*C + c], 1e-6));
+			}
+		}
+	}
+
+	// Block noise gives the same values as per-sample noise
+	{
+		const unsigned N = 4500;
+		std::vector<float> a(N), b(N);
+		#define CHECK_NOISE(T, ...)\
+		{	T x(__VA_ARGS__), y(__VA_ARGS__);\
+			for(unsigned i=0; i<N; ++i) a[i] = x();\
+			for(unsigned i=0, m=1; i<N; i+=m, m=m*3%97+1) y(&b[i], i+m<N ? m : N-i);\
+			for(unsigned i=0; i<N; ++i) assert(a[i] == b[i]);\
+		}
+		CHECK_NOISE(NoiseWhite<>, 17)
+		CHECK_NOISE(NoiseWhite<RNGMulLinCon>, 17)
+		CHECK_NOISE(NoiseWhite<RNGTaus>, 17)
+		CHECK_NOISE(NoisePink<>, 17)
+		CHECK_NOISE(NoiseBrown<>, 0, 0.04, -1, 1, 17)
+		CHECK_NOISE(NoiseViolet<>, 17)
+		CHECK_NOISE(NoiseBinary<RNGMulLinCon>, 0.5, 17)
+		CHECK_NOISE(NoiseWhite<RNGCounter>, 17)
+		#undef CHECK_NOISE
 	}
-}
 
+	// Counter-based RNG
+	{
+		// Known answers of Philox4x32-10
+		const uint32_t ctr[4] = {0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344};
+		const uint32_t key[2] = {0xa4093822, 0x299f31d0};
+		uint32_t out[4];
+		RNGCounter::philox(out, ctr, key);
+		assert(out[0] == 0xd16cfe09 && out[1] == 0x94fdcceb && out[2] == 0x5001e420 && out[3] == 0x24126ea1);
 
+		// Sequential, random access, seeking and blocks agree
+		RNGCounter a(7, 3), b(7, 3), c(7, 4);
+		uint32_t u[23];
+		for(unsigned i=0; i<23; ++i) u[i] = a();
+		for(unsigned i=0; i<23; ++i) assert(u[i] == b.at(i));
+		assert(a.position() == 23 && b.position() == 0);
+		b.seek(5);
+		uint32_t v[18];
+		rnd::uints(b, v, 18);
+		for(unsigned i=0; i<18; ++i) assert(v[i] == u[5+i]);
+		assert(b.position() == 23 && b() == a());
+		assert(c() != u[0] && c.at(1) != u[1]);
+		b.skip(uint64_t(1)<<40);
+		assert(b() == a.at((uint64_t(1)<<40) + 24));
+	}
 
+	// Block distributions
+	{
+		const unsigned N = 20000;
+		std::vector<float> a(N), b(N);
+		RNGLinCon r1(3), r2(3);
+		rnd::uni_float(r1, &a[0], 100);
+		for(unsigned i=0; i<100; ++i) assert(a[i] == rnd::uni_float(r2));
+		rnd::tri_float(r1, &a[0], N);
+		for(unsigned i=0; i<N; ++i) assert(a[i] > -1 && a[i] < 1);
+
+		// Moments of ziggurat normal values
+		rnd::gaussian(r1, &b[0], N);
+		double m1=0, m2=0, m4=0;
+		for(unsigned i=0; i<N; ++i){
+			const double x = b[i];
+			m1 += x; m2 += x*x; m4 += x*x*x*x;
+		}
+		m1 /= N; m2 /= N; m4 /= N;
+		assert(near(m1, 0, 0.03) && near(m2, 1, 0.05) && near(m4, 3, 0.3));
+	}
+
+	// Each thread has its own shared RNG
+	{
+		rnd::seed(11);
+		const float a = rnd::uni(1.f), b = rnd::uni(1.f);
+		float t[2];
+		rnd::seed(11);
+		rnd::uni(1.f);
+		std::thread th([&t](){
+			rnd::seed(11);
+			for(int i=0; i<2; ++i) t[i] = rnd::uni(1.f);
+			for(int i=0; i<100; ++i) rnd::uni(1.f);
+		});
+		th.join();
+		assert(t[0] == a && t[1] == b && rnd::uni(1.f) == b);
+	}
+
+	// Noise tables
+	{
+		const unsigned N = 1<<12;
+		NoiseTable a(NoiseTable::PINK, N, 5), b(NoiseTable::PINK, N, 5);
+		NoiseTable w(NoiseTable::WHITE, N, 5), r(NoiseTable::BROWN, N, 5);
+		assert(a.table().elems() == b.table().elems());
+		assert(a.table().elems() != r.table().elems() && a.table().size() == N);
+
+		// Zero mean, unit peak and correlation of neighbors rising with slope
+		double corr[3];
+		const NoiseTable * t[3] = {&w, &a, &r};
+		for(int k=0; k<3; ++k){
+			const float * x = t[k]->table().elems();
+			double sum=0, peak=0, xx=0, xy=0;
+			for(unsigned i=0; i<N; ++i){
+				sum += x[i]; peak = scl::max(peak, double(scl::abs(x[i])));
+				xx += x[i]*x[i]; xy += x[i]*x[(i+1)%N];
+			}
+			assert(near(sum/N, 0, 1e-6) && near(peak, 1, 1e-6));
+			corr[k] = xy/xx;
+		}
+		assert(scl::abs(corr[0]) < 0.1 && corr[1] > corr[0] + 0.3 && corr[2] > 0.99);
+
+		// Playback wraps around table
+		float y[20];
+		a.offset(0.999).rate(1);
+		a(y, 10); for(int i=10; i<20; ++i) y[i] = a();
+		const float * x = a.table().elems();
+		for(unsigned i=0; i<20; ++i) assert(y[i] == x[(N - 5 + i) % N]);
+
+		// Negative rates play backwards, also across the wrap
+		a.offset(2./N).rate(-1);
+		for(unsigned i=0; i<5; ++i) assert(a() == x[(N + 2 - i) % N]);
+		a.offset(0).rate(-1e9f);	// clipped to half the table
+		assert(a() == x[0] && a() == x[N/2]);
+	}
+
+	// Grain clouds read windowed excerpts at sample-accurate onsets
+	{
+		Domain dom(1000);
+		const unsigned N = 200;
+		float src[N];
+		for(unsigned i=0; i<N; ++i) src[i] = float(i);
+		GrainCloud gc(4, RECTANGLE, 64);
+		dom << gc;
+		gc.source(src, N);
+
+		const SIMDPath prev = simdPath();
+		const SIMDPath paths[] = {SIMD_SCALAR, simdBest()};
+		for(SIMDPath q : paths){
+			simdPath(q);
+			float L[3][40] = {{0}}, R[3][40] = {{0}};
+			assert(gc.grain(10.5, 0.05, 0.75, 1, -1, 53)); // starts in 2nd block
+			assert(gc.grain(150, 0.1, -2, 0.5, 1));
+			assert(!gc.grain(-1, 1) && !gc.grain(198.5, 1));
+			for(int b=0; b<3; ++b) gc.render(L[b], R[b], 40);
+			assert(0 == gc.size());
+			for(unsigned t=0; t<120; ++t){
+				float l = L[t/40][t%40], r = R[t/40][t%40];
+				float el = t >= 53 && t < 103 ? 10.5f + 0.75f*(t-53) : 0.f;
+				float er = t <= 75 ? 0.5f*(150.f - 2.f*t) : 0.f; // stops at source start
+				assert(near(l, el, 1e-3) && near(r, er, 1e-3));
+			}
+		}
+		simdPath(prev);
+	}
+
+	// Sampler voices play, loop and end in batches
+	{
+		Domain dom(1000);
+		const unsigned N = 200;
+		Array<float> mono(N), stereo(2*N);
+		for(unsigned i=0; i<N; ++i){ mono[i] = stereo[i] = float(i); stereo[N+i] = -float(i); }
+		SamplerEngine se(4, 2);
+		dom << se;
+		const unsigned sm = se.sample(mono, 1000), ss = se.sample(stereo, 1000, 2);
+		assert(0 == sm && 1 == ss && 2 == se.sample(mono, 1000));
+
+		const SIMDPath prev = simdPath();
+		const SIMDPath paths[] = {SIMD_SCALAR, simdBest()};
+		const ipl::Type ipols[] = {ipl::LINEAR, ipl::CUBIC};
+		for(SIMDPath q : paths){
+		for(ipl::Type ip : ipols){
+			simdPath(q);
+			se.ipolType(ip);
+			float L[120] = {0}, R[120] = {0};
+			const unsigned a = se.play(sm, 0.75, 1, -1, false, 53); // starts in 2nd block
+			se.pos(a, 1); // clear of clamped neighbors
+			const unsigned b = se.play(ss, 2, 2, 0, true);
+			se.interval(b, 100, 110).pos(b, 100);
+			const unsigned c = se.play(sm, -2, 1, 1);
+			assert(3 == se.voices() && a != b && b != c);
+			for(int k=0; k<3; ++k) se.render(L + 40*k, R + 40*k, 40);
+			assert(!se.active(c) && se.active(a) && se.active(b));
+			for(unsigned t=0; t<120; ++t){
+				const float pb = 100.f + float((2*t) % 10);
+				const float el = (t >= 53 ? 1.f + 0.75f*(t-53) : 0.f) + pb*float(M_SQRT2);
+				const float er = (t < 100 ? 199.f - 2.f*t : 0.f) - pb*float(M_SQRT2);
+				assert(near(L[t], el, 1e-3) && near(R[t], er, 1e-3));
+			}
+			se.stop(a); se.stop(b);
+			assert(0 == se.voices() && !se.active(a) && 0. == se.pos(a));
+		}}
+		simdPath(prev);
+
+		// Players must hold deinterleaved frames
+		SamplerEngine se2(4, 2);
+		SamplePlayer<> p;
+		p.buffer(stereo, 1000, 2);
+		p.interleaved(true);
+		assert(se2.maxSamples() == se2.sample(p));
+		p.interleaved(false);
+		assert(0 == se2.sample(p) && N == se2.frames(0));
+	}
+}
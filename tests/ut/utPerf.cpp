@@ -0,0 +1,158 @@
+// Throughput gate
+//
+// Unless GAMMA_PERF is set, nothing is measured. With GAMMA_PERF=record, the
+// throughput of selected objects is measured and written to this machine's
+// baseline file; with GAMMA_PERF=check, it is measured again and the test
+// fails if any drops more than GAMMA_PERF_TOL (default 0.25) below its
+// baseline. The baseline file is GAMMA_PERF_BASELINE, if set, or else
+// perf_<host name>.txt in the working directory.
+{
+	const char * mode = getenv("GAMMA_PERF");
+	const bool record = mode && std::string(mode) == "record";
+	const bool check = mode && std::string(mode) == "check";
+
+	if(record || check){
+		std::string path;
+		if(getenv("GAMMA_PERF_BASELINE")){
+			path = getenv("GAMMA_PERF_BASELINE");
+		}
+		else{
+			char host[256] = "unknown";
+			#ifdef _WIN32
+			if(getenv("COMPUTERNAME")) snprintf(host, sizeof(host), "%s", getenv("COMPUTERNAME"));
+			#else
+			gethostname(host, sizeof(host)-1);
+			#endif
+			path = std::string("perf_") + host + ".txt";
+		}
+		const double tol = getenv("GAMMA_PERF_TOL") ? atof(getenv("GAMMA_PERF_TOL")) : 0.25;
+
+		// Throughputs from baseline file, one "name value" per line
+		std::map<std::string, double> base;
+		if(check){
+			FILE * f = fopen(path.c_str(), "r");
+			if(!f){
+				printf("perf: no baseline \"%s\"; run with GAMMA_PERF=record first\n", path.c_str());
+				assert(false);
+			}
+			char name[128]; double v;
+			while(2 == fscanf(f, "%127s %lf", name, &v)) base[name] = v;
+			fclose(f);
+		}
+
+		std::map<std::string, double> meas;
+		unsigned slower = 0;
+
+		// Measures items per microsecond of a call processing 'items' items,
+		// as the best of several trials to reject interruptions
+		auto measure = [&](const char * name, double items, std::function<void()> call){
+			typedef std::chrono::steady_clock clock;
+			call(); // warm up
+			double best = 0;
+			for(int trial=0; trial<5; ++trial){
+				unsigned calls = 0;
+				const clock::time_point t0 = clock::now();
+				double us;
+				do{
+					for(int i=0; i<16; ++i) call();
+					calls += 16;
+					us = std::chrono::duration<double, std::micro>(clock::now() - t0).count();
+				} while(us < 20000);
+				best = std::max(best, items*calls/us);
+			}
+			meas[name] = best;
+
+			if(record){
+				printf("perf: %-24s %10.2f items/us\n", name, best);
+			}
+			else if(base.count(name)){
+				const double ref = base[name];
+				const bool slow = best < ref*(1. - tol);
+				slower += slow;
+				printf("perf: %-24s %10.2f items/us, baseline %10.2f (%+5.1f%%)%s\n",
+					name, best, ref, 100.*(best/ref - 1.), slow ? "  SLOWER" : "");
+			}
+			else{
+				printf("perf: %-24s %10.2f items/us, no baseline\n", name, best);
+			}
+		};
+
+		// Transform pairs; items are samples
+		for(int n : {256, 4096}){
+			RFFT<float> fft(n);
+			std::vector<float> buf(n);
+			for(int i=0; i<n; ++i) buf[i] = sin(0.1*i);
+			const std::string name = "RFFT<float>/" + std::to_string(n);
+			measure(name.c_str(), n, [&]{ fft.forward(&buf[0]); fft.inverse(&buf[0]); });
+		}
+		{
+			const int n = 1024;
+			CFFT<float> fft(n);
+			std::vector<float> buf(2*n);
+			for(int i=0; i<2*n; ++i) buf[i] = sin(0.1*i);
+			measure("CFFT<float>/1024", n, [&]{ fft.forward(&buf[0]); fft.inverse(&buf[0]); });
+		}
+
+		// Blocks of filters and delays; items are samples
+		const unsigned B = 256;
+		std::vector<float> in(B), out(B), delays(B);
+		for(unsigned i=0; i<B; ++i){
+			in[i] = sin(0.1*i);
+			delays[i] = 0.01f + 0.001f*sin(0.05*i);
+		}
+		{
+			Biquad<> bq(1000, 2, LOW_PASS);
+			measure("Biquad/256", B, [&]{ bq(&out[0], &in[0], B); });
+		}
+		{
+			Delay<float, ipl::Linear> dl(0.05f, 0.01f);
+			measure("Delay/256", B, [&]{ dl.process(&in[0], &out[0], B); });
+			measure("Delay/256/modulated", B, [&]{ dl.process(&in[0], &out[0], &delays[0], B); });
+		}
+
+		{
+			// 1000 nodes; items are node-samples
+			struct Node : public ProcessNode{
+				float phs, inc;
+				Node(float frq): phs(0), inc(frq){}
+				void onProcessNode(SchedulerAudioIOData& io){
+					float * o = io.buffersOut;
+					for(unsigned i=io.startFrame; i<io.framesPerBuffer; ++i){
+						o[i] += phs*0.001f;
+						phs += inc;
+						if(phs >= 1.f) phs -= 2.f;
+					}
+				}
+			};
+
+			const unsigned N = 1000;
+			Scheduler s;
+			s.io().framesPerSecond = 44100;
+			s.io().framesPerBuffer = B;
+			s.io().channelsOut = 1;
+			s.io().buffersOut = &out[0];
+			for(unsigned k=0; k<N; ++k){
+				s.add<Node>(0.001f*(k+1));
+				if(k % 256 == 255) s.update();
+			}
+			s.update();
+			measure("Scheduler/1000nodes/256", double(N)*B, [&]{
+				std::fill(out.begin(), out.end(), 0.f);
+				s.update();
+			});
+		}
+
+		if(record){
+			FILE * f = fopen(path.c_str(), "w");
+			assert(f);
+			for(auto& m : meas) fprintf(f, "%s %.6g\n", m.first.c_str(), m.second);
+			fclose(f);
+			printf("perf: wrote baseline \"%s\"\n", path.c_str());
+		}
+		else{
+			printf("perf: %u of %u slower than baseline by more than %g%%\n",
+				slower, unsigned(meas.size()), 100.*tol);
+			assert(0 == slower);
+		}
+	}
+}
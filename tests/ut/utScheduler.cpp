@@ -0,0 +1,718 @@
+// Real-time log queue
+//
+// This runs before any Scheduler starts the logger thread, so only the test
+// thread flushes the queue.
+{
+	FILE * fp = tmpfile();
+	assert(fp);
+	auto flushed = [fp](){
+		fflush(fp);
+		std::string res(std::size_t(ftell(fp)), 0);
+		rewind(fp);
+		if(res.size()) fread(&res[0], 1, res.size(), fp);
+		rewind(fp);
+		return res;
+	};
+
+	assert(0 == logFlush(fp));
+	assert(warnRT("ut", "%d %u %.1f %s %%", -3, 7u, 0.25, "str"));
+	assert(errRT("ut", "no args"));
+	assert(2 == logFlush(fp));
+	assert(flushed() ==
+		"ut warning: -3 7 0.2 str %\n"
+		"ut error: no args\n"
+	);
+
+	// A full queue drops and counts messages without blocking
+	const unsigned dropped = logDropped();
+	unsigned pushed = 0;
+	while(warnRT("ut", "%u", pushed)) ++pushed;
+	assert(pushed > 0 && logDropped() == dropped+1);
+	assert(!warnRT("ut", "dropped"));
+	assert(logDropped() == dropped+2);
+	assert(pushed == logFlush(fp));
+	std::string out = flushed();
+	assert(0 == out.find("ut warning: 0\n"));
+	assert(out.npos != out.find("2 messages dropped"));
+
+	// Messages from several threads all arrive once
+	const unsigned T = 4, M = 100;
+	std::vector<std::thread> threads;
+	for(unsigned t=0; t<T; ++t){
+		threads.emplace_back([=](){ for(unsigned i=0;i<M;++i) warnRT("ut", "%u", t*M+i); });
+	}
+	for(auto& t : threads) t.join();
+	assert(T*M == logFlush(fp));
+	out = flushed();
+	for(unsigned i=0; i<T*M; ++i){
+		char line[32];
+		snprintf(line, sizeof(line), "ut warning: %u\n", i);
+		assert(out.npos != out.find(line));
+	}
+	fclose(fp);
+}
+
+// Deferrable functions store small callables inside, large ones in the
+// shared pool or, once it is exhausted, the heap
+{
+	struct Probe{
+		static int & alive(){ static int n = 0; return n; }
+		int * hits;
+		Probe(int * h): hits(h){ ++alive(); }
+		Probe(const Probe& p): hits(p.hits){ ++alive(); }
+		Probe(Probe&& p) noexcept : hits(p.hits){ ++alive(); }
+		~Probe(){ --alive(); }
+		void operator()(){ ++*hits; }
+	};
+	struct Large : public Probe{
+		char pad[GAM_FUNC_MAX_DATA_SIZE];
+		Large(int * h): Probe(h){}
+	};
+	int hits = 0;
+	MemoryPool& pool = Func::pool();
+	const std::size_t used = pool.used();
+
+	{	// Internal
+		Func f{Probe(&hits)}, g;
+		assert(!f.empty() && !f.external() && f.copyable() && 1 == Probe::alive());
+		f();
+		assert(1 == hits);
+		Func c(f);
+		assert(2 == Probe::alive());
+		g = std::move(f);
+		assert(f.empty() && !g.empty() && 2 == Probe::alive());
+		g(); c();
+		assert(3 == hits);
+	}
+	assert(0 == Probe::alive() && used == pool.used());
+
+	{	// External, in the pool
+		Func f{Large(&hits)};
+		assert(f.external() && 1 == Probe::alive() && used+1 == pool.used());
+		Func c(f);
+		assert(c.external() && 2 == Probe::alive() && used+2 == pool.used());
+		const char * data = f.data();
+		Func g(std::move(f));
+		assert(f.empty() && g.data() == data && used+2 == pool.used());
+		g();
+		assert(4 == hits && 2 == Probe::alive());
+	}
+	assert(0 == Probe::alive() && used == pool.used());
+
+	{	// External, on the heap once the pool is exhausted
+		const std::size_t failures = pool.failures();
+		const std::size_t n = pool.capacity() - used + 1;
+		std::vector<Func> fs;
+		fs.reserve(n);
+		for(std::size_t i=0; i<n; ++i) fs.emplace_back(Large(&hits));
+		assert(n == std::size_t(Probe::alive()) && pool.capacity() == pool.used());
+		assert(failures+1 == pool.failures());
+		for(auto& f : fs) f();
+		assert(4+int(n) == hits);
+		fs.clear();
+		assert(0 == Probe::alive() && used == pool.used());
+	}
+
+	{	// Move-only
+		std::unique_ptr<Probe> p(new Probe(&hits));
+		Func f([q = std::move(p)]{ (*q)(); });
+		assert(!f.external() && !f.copyable() && 1 == Probe::alive());
+		FILE * fp = tmpfile();
+		Func c(f);	// warns and stays empty
+		assert(c.empty() && 1 == logFlush(fp));
+		fclose(fp);
+		Func g(std::move(f));
+		assert(f.empty() && 1 == Probe::alive());
+		const int h = hits;
+		g();
+		assert(h+1 == hits);
+		g.clear();
+		assert(g.empty() && 0 == Probe::alive());
+	}
+}
+
+// Scheduler
+//
+// Blocks are processed by calling update() directly, so the test thread is
+// both the thread adding nodes and the audio thread.
+{
+	const unsigned B = 8;
+	std::vector<float> out(B);
+
+	// Appends an ID to a log each time it is processed
+	struct Logger : public ProcessNode{
+		std::vector<int> * log;
+		int id;
+		Logger(std::vector<int> * l=0, int i=0): log(l), id(i){}
+		void onProcessNode(SchedulerAudioIOData& io){ log->push_back(id); }
+	};
+
+	// Writes a ramp of one increment per frame, from the start frame on
+	struct Ramp : public ProcessNode{
+		float phs, inc;
+		Ramp(float frq=0.01f): phs(0), inc(frq){}
+		void onProcessNode(SchedulerAudioIOData& io){
+			for(unsigned i=io.startFrame; i<io.framesPerBuffer; ++i){
+				io.buffersOut[i] += phs;
+				phs += inc;
+				if(phs >= 1.f) phs -= 1.f;
+			}
+		}
+		bool onSkip(SchedulerAudioIOData& io){
+			for(unsigned i=io.startFrame; i<io.framesPerBuffer; ++i){
+				phs += inc;
+				if(phs >= 1.f) phs -= 1.f;
+			}
+			return true;
+		}
+		void onSaveState(StateWriter& w){ w(phs)(inc); }
+		void onLoadState(StateReader& r){
+			float p, i;
+			r(p)(i);
+			if(r.ok()){ phs = p; inc = i; }
+		}
+	};
+
+	auto setup = [&](Scheduler& s){
+		s.io().framesPerSecond = 1000;
+		s.io().framesPerBuffer = B;
+		s.io().channelsOut = 1;
+		s.io().buffersOut = &out[0];
+	};
+
+	auto block = [&](Scheduler& s){
+		std::fill(out.begin(), out.end(), 0.f);
+		s.update();
+	};
+
+	// Execution order is depth-first; inactive subtrees are skipped
+	{
+		Scheduler s; setup(s);
+		std::vector<int> log;
+		// Nodes are added as first children, so add in reverse order
+		Logger& c = s.add<Logger>(&log, 3);
+		Logger& a = s.add<Logger>(&log, 1);
+		Logger& a1 = s.add<Logger>(a);
+		a1.log = &log; a1.id = 2;
+		block(s);
+		assert(log == std::vector<int>({1,2,3}));
+
+		log.clear();
+		a.active(false);
+		block(s);
+		assert(log == std::vector<int>({3}));
+
+		log.clear();
+		a.active(true);
+		c.free();
+		block(s);
+		assert(log == std::vector<int>({1,2}));
+		s.reclaim();
+	}
+
+	// Subtrees of the root not fitting in maxNodes() are left out until
+	// there is room
+	{
+		Scheduler s; setup(s);
+		s.maxNodes(3);
+		std::vector<int> log;
+		Logger& a = s.add<Logger>(&log, 1);
+		s.add<Logger>(a, &log, 2);
+		s.add<Logger>(&log, 3);
+		Logger& d = s.add<Logger>(&log, 4);
+		block(s);
+		assert(log == std::vector<int>({4,3}));
+
+		// A freed node is removed at the end of the block
+		log.clear();
+		d.free();
+		block(s);
+		assert(log == std::vector<int>({3}));
+		log.clear();
+		block(s);
+		assert(log == std::vector<int>({3,1,2}));
+
+		log.clear();
+		s.maxNodes(4);
+		s.add<Logger>(&log, 5);
+		block(s);
+		assert(log == std::vector<int>({5,3,1,2}));
+		s.reclaim();
+	}
+
+	// A group skips blocks without losing its phase, and its output is
+	// delayed by its latency
+	{
+		Scheduler s; setup(s);
+		std::vector<int> log;
+		BlockGroup& g = s.add<BlockGroup>(4);
+		s.add<Logger>(g, &log, 1);
+		s.add<Ramp>(g, 1.f/64);
+		std::vector<int> ran;
+		for(int k=0; k<16; ++k){
+			g.active(k < 6 || k > 8);
+			log.clear();
+			block(s);
+			if(!log.empty()) ran.push_back(k);
+			if(k == 4) assert(out[0] == 0.f && out[1] == 1.f/64);
+			if(k == 5) assert(out[0] == 8.f/64);
+		}
+		assert(ran == std::vector<int>({4,12}));
+		assert(g.latency(B) == 4*B);
+		s.reclaim();
+	}
+
+	// Freeing a tree destroys the scheduler's nodes and detaches the others,
+	// leaving the links of the detached subtrees intact
+	{
+		struct Counted : public ProcessNode{
+			static int & alive(){ static int n = 0; return n; }
+			Counted(){ ++alive(); }
+			~Counted(){ --alive(); }
+		};
+		Scheduler s; setup(s);
+		Counted& p = s.add<Counted>();
+		Counted& q = s.add<Counted>();
+		s.add<Counted>(p);
+		s.add<Counted>(s.add<Counted>(p));
+		block(s);
+		ProcessNode x, x1, x2;	// owned elsewhere
+		x.addLastChild(&x1);
+		x.addLastChild(&x2);
+		p.addLastChild(&x);
+		assert(5 == Counted::alive() && p.lastChild() == &x);
+		p.free();
+		block(s);
+		assert(1 == s.reclaim() && 1 == Counted::alive());
+		assert(!x.parent && !x.sibling && !x.prev);
+		assert(x.child == &x1 && x1.sibling == &x2 && x1.prev == &x2 && x2.prev == &x1);
+		assert(s.child == &q && q.prev == &q && !q.sibling);
+		q.free();
+		block(s);
+		s.reclaim();
+	}
+
+	// A delayed child of a node freed before it starts is freed with it
+	{
+		struct Counted : public ProcessNode{
+			static int & alive(){ static int n = 0; return n; }
+			Counted(){ ++alive(); }
+			~Counted(){ --alive(); }
+		};
+		Scheduler s; setup(s);
+		Counted& a = s.add<Counted>();
+		s.add<Counted>(a).dt(0.05);
+		block(s);
+		assert(2 == Counted::alive() && 0 == a.child);
+		a.free();
+		block(s);
+		assert(1 == s.reclaim() && 0 == Counted::alive());
+		for(int k=0; k<10; ++k) block(s);
+		assert(s.empty());
+	}
+
+	// Profile snapshots are taken a block after being requested, are
+	// truncated to the capacity and only grow while profiling
+	{
+		Scheduler s; setup(s);
+		std::vector<int> log;
+		Logger& c = s.add<Logger>(&log, 3);
+		Logger& b = s.add<Logger>(&log, 2);
+		Logger& a = s.add<Logger>(&log, 1);
+		ProfileSnapshot snap;
+		block(s);
+		assert(!s.profiling() && !s.profile(snap));	// no capacity, no request
+		block(s);
+		assert(!s.profile(snap) && snap.entries().empty());
+
+		s.profile(true, 2);
+		assert(s.profiling());
+		assert(!s.profile(snap));	// request
+		assert(!s.profile(snap));	// still pending
+		block(s);
+		assert(s.profile(snap) && snap.truncated());
+		assert(2 == snap.entries().size());
+		assert(snap.entries()[0].node == &a && snap.entries()[1].node == &b);
+		for(auto& e : snap.entries()) assert(1 == e.profile.calls);
+
+		block(s);	// fill request made by last call before resizing
+		s.profile(true, 4);
+		assert(!s.profile(snap));
+		block(s);
+		assert(s.profile(snap) && !snap.truncated());
+		assert(3 == snap.entries().size() && snap.entries()[2].node == &c);
+		for(auto& e : snap.entries()) assert(3 == e.profile.calls);
+
+		s.profile(false);
+		assert(!s.profiling());
+		block(s);
+		assert(s.profile(snap));
+		for(auto& e : snap.entries()) assert(3 == e.profile.calls);
+		s.reclaim();
+	}
+
+	// Nodes are only reclaimed once removed from the tree, also while the
+	// low-priority thread reclaims during blocks
+	{
+		struct Counted : public ProcessNode{
+			static std::atomic<int> & alive(){ static std::atomic<int> n(0); return n; }
+			Counted(){ ++alive(); }
+			~Counted(){ --alive(); }
+		};
+		Scheduler s; setup(s);
+		s.period(0.0001);
+		s.start();
+		std::vector<Counted *> prev;
+		for(int k=0; k<2000; ++k){
+			std::vector<Counted *> next;
+			for(int i=0; i<4; ++i){
+				Counted& p = s.add<Counted>();
+				s.add<Counted>(p);
+				next.push_back(&p);
+			}
+			for(auto * p : prev) p->free();
+			prev.swap(next);
+			block(s);
+		}
+		for(auto * p : prev) p->free();
+		for(int k=0; k<4 && Counted::alive(); ++k){
+			block(s);
+			sleepSec(0.01);
+		}
+		assert(0 == Counted::alive());
+
+		// Stopping waits for the thread, so nodes freed after it are left
+		// for the caller to reclaim, and the scheduler can be restarted
+		s.stop(); s.stop();
+		s.add<Counted>().free();
+		block(s);
+		block(s);
+		assert(1 == s.reclaim() && 0 == Counted::alive());
+		s.start();
+		s.add<Counted>();
+		block(s);
+		s.stop();
+		assert(1 == Counted::alive());
+	}
+
+	// Nodes added while the queue is full are resubmitted by reclaim()
+	// without further adds
+	{
+		Scheduler s; setup(s);
+		s.queueSize(2);
+		std::vector<int> log;
+		for(int i=5; i>0; --i) s.add<Logger>(&log, i);
+		assert(!s.empty());
+		for(int k=0; k<6; ++k){ block(s); s.reclaim(); }
+		log.clear();
+		block(s);
+		assert(log == std::vector<int>({1,2,3,4,5}));
+	}
+
+	// Functions are called after their delay and then every period
+	{
+		Scheduler s; setup(s);
+		std::vector<int> calls;
+		unsigned k = 0;
+		s.add([&]{ calls.push_back(k); });
+		s.add([&]{ calls.push_back(100+k); }, 0.020);
+		s.add([&]{ calls.push_back(200+k); }, 0.010, 0.016);
+		for(; k<6; ++k) block(s);
+		assert(calls == std::vector<int>({0, 201, 102, 203, 205}));
+		assert(!s.empty());
+	}
+
+	// Pooled voices sleep until started, are stolen by policy and go back to
+	// sleep when done
+	{
+		struct Note : public ProcessNode{
+			struct Count{
+				unsigned left;
+				bool done() const { return 0==left; }
+			} count;
+			float lev;
+			Note(): lev(1){ count.left = 0; idleWhenDone(count); }
+			void onReset(){ count.left = 3; }
+			void onProcessNode(SchedulerAudioIOData& io){ if(count.left) --count.left; }
+			float level() const { return lev; }
+		};
+		typedef VoicePool<Note, 3> Pool;
+		Scheduler s; setup(s);
+		{
+			Pool p(s);
+			block(s);
+			// Done on construction, but asleep rather than freed
+			assert(0 == p.playing() && 3 == s.pool<Note>()->used());
+			for(unsigned i=0; i<Pool::size(); ++i) assert(p[i].sleeping());
+
+			Note * a = p.noteOn(60), * b = p.noteOn(62), * c = p.noteOn(64);
+			assert(3 == p.playing() && a != b && b != c && a != c);
+			assert(p.noteOn(65) == a && 1 == p.steals());
+			assert(!p.voice(60) && p.voice(65) == a && 65 == p.key(0));
+
+			p.steal(Pool::STEAL_SAME_PITCH);
+			assert(p.noteOn(62) == b && 1 == p.steals());
+
+			p.steal(Pool::STEAL_QUIETEST);
+			c->lev = 0.1f;
+			assert(p.noteOn(67) == c && 2 == p.steals());
+
+			p.steal(Pool::STEAL_NONE);
+			assert(!p.noteOn(70) && 1 == p.drops());
+
+			for(int k=0; k<3; ++k) block(s);
+			assert(0 == p.playing() && 3 == s.pool<Note>()->used());
+			assert(p.noteOn(72) && 1 == p.playing());
+			assert(3 == s.pool<Note>()->peak() && 0 == s.pool<Note>()->failures());
+		}
+		block(s);
+		s.reclaim();
+		assert(0 == s.pool<Note>()->used() && s.empty());
+	}
+
+	// Control messages are applied in time order with their frame in the block
+	{
+		Scheduler s; setup(s);
+		struct Rec{ double block; unsigned frame; float arg; };
+		static std::vector<Rec> recs;
+		static unsigned blockCount;
+		recs.clear();
+		blockCount = 0;
+		auto handler = [](void *, const ControlMessage& m){
+			Rec r = { double(blockCount), m.frame, m.args[0] };
+			recs.push_back(r);
+		};
+
+		s.send(ControlMessage(handler, 0, 0.020).arg(3)); // block 2, frame 4
+		s.send(ControlMessage(handler, 0, 0.012).arg(2)); // block 1, frame 4
+		s.send(ControlMessage(handler).arg(1));				// next block
+		for(; blockCount<4; ++blockCount) block(s);
+		assert(recs.size() == 3);
+		assert(recs[0].arg == 1 && recs[0].block == 0 && recs[0].frame == 0);
+		assert(recs[1].arg == 2 && recs[1].block == 1 && recs[1].frame == 4);
+		assert(recs[2].arg == 3 && recs[2].block == 2 && recs[2].frame == 4);
+
+		// Many senders at once
+		static std::atomic<int> sum;
+		sum = 0;
+		auto add = [](void *, const ControlMessage& m){ sum += int(m.args[0]); };
+		std::vector<std::thread> senders;
+		for(int t=0; t<4; ++t){
+			senders.emplace_back([&]{
+				for(int i=0; i<100; ++i) assert(s.send(ControlMessage(add).arg(1)));
+			});
+		}
+		for(auto& t : senders) t.join();
+		block(s);
+		assert(400 == sum && 0 == s.controlOverflows());
+	}
+
+	// Nodes of negative priority are shed once a block runs over budget
+	{
+		struct Busy : public ProcessNode{
+			void onProcessNode(SchedulerAudioIOData& io){
+				const nsec_t t = timeNow();
+				while(timeNow() - t < 200000){}
+			}
+		};
+		struct Pad : public ProcessNode{
+			int processed, shed;
+			Pad(int prio): processed(0), shed(0){ priority(prio); }
+			void onProcessNode(SchedulerAudioIOData& io){ ++processed; }
+			void onShed(SchedulerAudioIOData& io){ ++shed; }
+		};
+
+		Scheduler s; setup(s);
+		s.overloadBudget(0.01f); // 80 us of 8 ms
+		Pad& keep = s.add<Pad>(0);
+		Pad& pad = s.add<Pad>(-1);
+		s.add<Busy>();
+		block(s);
+		assert(1 == keep.processed && 0 == keep.shed);
+		assert(0 == pad.processed && 1 == pad.shed);
+		SchedulerOverload o;
+		s.overload(o);
+		assert(1 == o.blocks && 1 == o.shedBlocks && 1 == o.shedNodes);
+
+		s.overloadBudget(0);
+		block(s);
+		assert(1 == pad.processed && 1 == pad.shed);
+	}
+
+	// Graph snapshots reflect structure and status
+	{
+		Scheduler s; setup(s);
+		s.graphSnapshots(true, 16);
+		{ GraphReader g(s); assert(!g); }
+		std::vector<int> log;
+		Logger& b = s.add<Logger>(&log, 2);
+		Logger& a = s.add<Logger>(&log, 0);
+		Logger& a1 = s.add<Logger>(a);
+		a1.log = &log; a1.id = 1;
+		block(s);
+		uint64_t version;
+		{
+			GraphReader g(s);
+			assert(g && 3 == g->size() && !g->truncated());
+			assert(&a == (*g)[0].node && -1 == (*g)[0].parent && 2 == (*g)[0].end);
+			assert(0 == (*g)[1].parent && 1 == (*g)[1].depth);
+			assert(&b == (*g)[2].node && 0 == (*g)[2].depth);
+			version = g->version();
+		}
+		block(s); // unchanged, so nothing is published
+		{ GraphReader g(s); assert(version == g->version()); }
+		b.sleep();
+		block(s);
+		s.reclaim();
+		{
+			GraphReader g(s);
+			assert(g->version() > version);
+			assert(GraphSnapshot::SLEEPING == (*g)[2].status);
+		}
+	}
+
+	// State is saved and restored for a warm restart
+	{
+		const char * path = "utScheduler.state";
+		std::vector<float> ref(B);
+		{
+			Scheduler s; setup(s);
+			s.stateType<Ramp>("ramp").stateCapacity(1024);
+			Ramp& r = s.add<Ramp>(0.125f);
+			s.add<Ramp>(r).priority(-2);
+			block(s); block(s);
+			assert(s.saveState(path));
+			block(s);
+			s.reclaim(); // writes file
+			assert(1 == s.statesSaved());
+			block(s);
+			ref = out;
+		}
+		{
+			Scheduler s; setup(s);
+			s.stateType<Ramp>("ramp");
+			assert(2 == s.loadState(path));
+			block(s); // adds restored nodes
+			assert(s.child && s.child->child);
+			assert(-2 == s.child->child->priority());
+			for(unsigned i=0; i<B; ++i) assert(out[i] == ref[i]);
+		}
+		{
+			Scheduler s; setup(s);
+			assert(-1 == s.loadState("utScheduler.none"));
+		}
+
+		// A node whose state fails to load is dropped with its subtree
+		{
+			struct Greedy : public ProcessNode{
+				void onSaveState(StateWriter& w){ w(1.f); }
+				void onLoadState(StateReader& r){ float a, b; r(a)(b); }
+			};
+			{
+				Scheduler s; setup(s);
+				s.stateType<Ramp>("ramp").stateType<Greedy>("greedy").stateCapacity(1024);
+				s.add<Ramp>();
+				Greedy& g = s.add<Greedy>();
+				s.add<Ramp>(g);
+				block(s);
+				assert(s.saveState(path));
+				block(s);
+				s.reclaim();
+			}
+			Scheduler s; setup(s);
+			s.stateType<Ramp>("ramp").stateType<Greedy>("greedy");
+			assert(1 == s.loadState(path));
+			block(s);
+			assert(s.child && !s.child->child && !s.child->sibling);
+		}
+		remove(path);
+	}
+
+	// Skipping to a block renders on exactly as if it had been processed,
+	// as the segments of a time-parallel recordNRT do
+	{
+		const unsigned blocks = 20, skip = 9;
+		std::vector<float> ref;
+		{
+			Scheduler s; setup(s);
+			s.add<Ramp>(0.01f);
+			s.add<Ramp>(0.037f).dt(0.0305);
+			for(unsigned k=0; k<blocks; ++k){
+				block(s);
+				if(k >= skip) ref.insert(ref.end(), out.begin(), out.end());
+			}
+		}
+		{
+			Scheduler s; setup(s);
+			s.add<Ramp>(0.01f);
+			s.add<Ramp>(0.037f).dt(0.0305);
+			const double dt = s.io().secondsPerBuffer();
+			assert(near(s.skipNRT((skip - 0.5)*dt), skip*dt));
+			std::vector<float> seg;
+			for(unsigned k=skip; k<blocks; ++k){
+				block(s);
+				seg.insert(seg.end(), out.begin(), out.end());
+			}
+			assert(seg == ref);
+		}
+	}
+
+	// Subtrees sharing a bus run in one job when processing in parallel
+	{
+		struct Send : public ProcessNode{
+			unsigned bus;
+			Send(unsigned b=0): bus(b){ useBus(b); }
+			void onProcessNode(SchedulerAudioIOData& io){
+				float * b = io.bus(bus);
+				for(unsigned i=io.startFrame; i<io.framesPerBuffer; ++i) b[i] += 1.f;
+				std::this_thread::sleep_for(std::chrono::microseconds(20)); // let workers run
+			}
+		};
+		struct Return : public ProcessNode{
+			unsigned bus;
+			Return(unsigned b=0): bus(b){ useBus(b); }
+			void onProcessNode(SchedulerAudioIOData& io){
+				const float * b = io.bus(bus);
+				for(unsigned i=io.startFrame; i<io.framesPerBuffer; ++i) io.buffersOut[i] += b[i];
+			}
+		};
+		Scheduler s; setup(s);
+		const unsigned bus = s.addBus();
+		s.parallel(4, 8);
+		s.add<Return>(bus);
+		for(int i=0; i<31; ++i) s.add<Send>(bus);
+		for(int k=0; k<50; ++k){
+			block(s);
+			for(unsigned i=0; i<B; ++i) assert(out[i] == 31.f);
+		}
+		s.parallel(1);
+	}
+
+	// Traces keep the last events of each thread, from a reserved buffer
+	{
+		const unsigned N = GAM_TRACE_BUFFER_SIZE;
+		traceReserve(1);
+		traceClear();
+		traceStart();
+		std::thread([&]{
+			for(unsigned i=0; i<N+10; ++i) traceInstant("ut", (const void *)(uintptr_t(i+1)));
+		}).join();
+		traceStop();
+		const char * path = "utScheduler.trace";
+		FILE * fp = fopen(path, "w");
+		assert(N-1 == traceWrite(fp));
+		fclose(fp);
+		// First event kept is N+10 - (N-1), with ID one greater
+		std::string json;
+		fp = fopen(path, "r");
+		for(int c; (c = fgetc(fp)) != EOF;) json += char(c);
+		fclose(fp);
+		remove(path);
+		char first[32], lost[32];
+		snprintf(first, sizeof(first), "\"%p\"", (const void *)uintptr_t(12));
+		snprintf(lost, sizeof(lost), "\"%p\"", (const void *)uintptr_t(11));
+		assert(json.find(first) != std::string::npos);
+		assert(json.find(lost) == std::string::npos);
+		traceClear();
+	}
+}
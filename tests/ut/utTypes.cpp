@@ -51,6 +51,10 @@
 		c.fromPolar(4, 0.2);
 			assert(almostEqual(sqrt(c).norm(), 2));
 			assert(almostEqual(sqrt(c).arg(), 0.1));
+
+		// Packed arrays copy as plain memory
+		assert(std::is_trivially_copyable<Complex>::value);
+		assert(std::is_trivially_copyable<gam::Complex<float> >::value);
 	}
 
 	// Vec
@@ -64,5 +68,7 @@
 		v /= 2;						assert(v == 1);
 		v.set(1,2,3).normalize();	assert(scl::almostEqual(v.mag(),1));
 		v.set(1,2,3);				assert(v.normalized() == v.normalize());
+		assert(std::is_trivially_copyable<Vec3>::value);
+		assert(std::is_trivially_copyable<float4>::value);
 	}
 }
@@ -25,6 +25,310 @@
 	#undef PRINT
 }
 
+// fused gain, NaN zeroing and clipping
+{
+	const unsigned N=11;
+	float src[N], dst[N];
+	for(unsigned i=0;i<N;++i) src[i] = float(i)*0.25f - 1.f;
+	src[2] = src[2] - src[2] + 0.f/0.f; // NaN
+
+	arr::gainNaNClip(dst, src, N, 2.f, -0.5f);
+	for(unsigned i=0;i<N;++i){
+		float v = src[i] * (2.f - 0.5f*i);
+		if(v != v) v = 0.f;
+		v = v < -1.f ? -1.f : (v > 1.f ? 1.f : v);
+		assert(dst[i] == v);
+	}
+
+	arr::gainNaNClip(src, src, N, 1.f, 0.f, false, false);
+	assert(src[2] != src[2]);
+	assert(src[N-1] == 1.5f);
+}
+
+// SIMD paths agree with scalar code
+{
+	assert(simdSupported(SIMD_SCALAR) && simdSupported(simdBest()));
+	SIMDPath p;
+	assert(simdPathFromName(p, "avx2") && SIMD_AVX2 == p && !simdPathFromName(p, "mmx"));
+	const SIMDPath prev = simdPath();
+
+	const unsigned N=37; // leaves a scalar tail on every path
+	float src[N], a0[2*N], a1[2*N], b0[2*N], b1[2*N];
+	for(unsigned i=0;i<N;++i) src[i] = std::sin(0.3f*i)*1.5f;
+	for(unsigned i=0;i<2*N;++i){ a0[i] = std::cos(0.2f*i); b0[i] = std::sin(0.7f*i); }
+	src[5] = src[5] - src[5] + 0.f/0.f; // NaN
+	const float * srcs[] = {a0, b0, a1};
+	const float * as[] = {a0, a1}, * bs[] = {b0, b1};
+	for(unsigned i=0;i<2*N;++i){ a1[i] = -b0[i]; b1[i] = a0[i]*0.5f; }
+
+	// Stable two-pole and resonator banks; partials leave a scalar tail and
+	// blocks span two sub-blocks
+	float c1[N], c2[N], wr[N], wi[N], g[N];
+	for(unsigned k=0;k<N;++k){
+		c1[k] = 1.9f*std::cos(0.1f*k); c2[k] = -0.9025f;
+		wr[k] = 0.95f*std::cos(0.1f*k); wi[k] = 0.95f*std::sin(0.1f*k); g[k] = 0.1f*k;
+	}
+
+	float ref[6][2*N], zr[N], zi[N];
+	const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+	for(SIMDPath q : paths){
+		if(!simdSupported(q)) continue;
+		assert(q == simdPath(q) && q == simdPath());
+		float r[6][2*N];
+		arr::gainNaNClip(r[0], src, N, 0.9f, 0.01f);
+		for(unsigned i=0;i<N;++i) r[1][i] = src[i];
+		arr::mix(r[1], srcs, 3, N);
+		for(unsigned i=0;i<2*N;++i) r[2][i] = 0.1f;
+		arr::mulAddComplex(r[2], as, bs, 2, N);
+		for(unsigned k=0;k<N;++k){ zr[k] = 0; zi[k] = 0; }
+		arr::resonate(zr, zi, a0, b0, N, a1, 4);
+		for(unsigned k=0;k<N;++k){ r[3][k] = zr[k]; r[3][N+k] = zi[k]; }
+		for(unsigned k=0;k<N;++k){ zr[k] = a0[k]; zi[k] = b0[k]; }
+		for(unsigned i=0;i<2*N;++i) r[4][i] = 0.f;
+		arr::addTwoPoleBank(r[4], zr, zi, c1, c2, N, 2*N);
+		for(unsigned k=0;k<N;++k){ zr[k] = a0[k]; zi[k] = b0[k]; }
+		for(unsigned i=0;i<2*N;++i) r[5][i] = 0.f;
+		arr::addResonatorBank(r[5], zr, zi, wr, wi, g, N, a1, 2*N);
+		arr::addResonatorBank(r[5]+N, zr, zi, wr, wi, g, N, 0, N);
+		for(unsigned j=0;j<6;++j){
+			const unsigned n = j>=2 ? 2*N : N;
+			for(unsigned i=0;i<n;++i){
+				if(SIMD_SCALAR == q) ref[j][i] = r[j][i];
+				else if(j==1 && i==5) assert(r[j][i] != r[j][i]);
+				else assert(near(r[j][i], ref[j][i], j>=4 ? 1e-4 : 1e-5)); // banks sum in another order
+			}
+		}
+	}
+	simdPath(prev);
+}
+
+// PCM conversion with (de)interleaving
+{
+	const unsigned N=11, C=2; // frames use both vector and scalar paths
+	int16_t s16[N*C];
+	int32_t s32[N*C];
+	uint8_t s24[N*C*3];
+	float L[N], R[N];
+	float * dst[C] = {L, R};
+	const float * src[C] = {L, R};
+
+	for(unsigned i=0;i<N*C;++i) s16[i] = int16_t(int(i)*5000 - 32768);
+	arr::fromPCM16(dst, s16, N, C);
+	for(unsigned i=0;i<N;++i){
+		assert(L[i] == s16[i*C  ]/32768.f);
+		assert(R[i] == s16[i*C+1]/32768.f);
+	}
+
+	for(unsigned i=0;i<N*C;++i) s32[i] = s16[i] * 65536;
+	arr::fromPCM32(dst, s32, N, C);
+	for(unsigned i=0;i<N;++i) assert(L[i] == s16[i*C]/32768.f);
+
+	for(unsigned i=0;i<N;++i){ L[i] = float(i)*0.3f - 1.6f; R[i] = -L[i]; }
+	L[3] = L[3] - L[3] + 0.f/0.f; // NaN
+	arr::toPCM16(s16, src, N, C);
+	for(unsigned i=0;i<N*C;++i){
+		float v = src[i%C][i/C] * 32767.f;
+		if(v != v) v = 0.f;
+		v = v < -32768.f ? -32768.f : (v > 32767.f ? 32767.f : v);
+		assert(s16[i] == int16_t(std::lrint(v)));
+	}
+
+	arr::toPCM32(s32, src, N, C);
+	assert(s32[3*C] == 0);
+	assert(s32[0] == int32_t(-2147483647-1));
+	assert(s32[1] == 2147483520);
+
+	arr::toPCM24(s24, src, N, C);
+	assert(s24[0] == 0x00 && s24[1] == 0x00 && s24[2] == 0x80);
+	arr::fromPCM24(dst, s24, N, C);
+	for(unsigned i=0;i<N;++i){
+		assert(L[i] >= -1.f && L[i] < 1.f);
+		assert(R[i] >= -1.f && R[i] < 1.f);
+	}
+	assert(L[3] == 0.f);
+
+	// Dithered output stays within 1.5 LSB of the exact value and varies
+	const unsigned M=64;
+	float ramp[M];
+	int16_t d16[M];
+	const float * rampSrc = ramp;
+	for(unsigned i=0;i<M;++i) ramp[i] = float(i)/M * 0.01f;
+	uint32_t seed = 1;
+	arr::toPCM16(d16, &rampSrc, M, 1, &seed);
+	unsigned differ = 0;
+	for(unsigned i=0;i<M;++i){
+		float exact = ramp[i] * 32767.f;
+		assert(std::fabs(d16[i] - exact) <= 1.5f);
+		differ += std::lrint(exact) != d16[i];
+	}
+	assert(differ > 0);
+	assert(seed != 1);
+
+	// Channel order of 2-channel (de)interleaving
+	float il[4] = {0,1,2,3}, dl[4];
+	mem::deinterleave2(dl, il, 2);
+	assert(dl[0]==0 && dl[1]==2 && dl[2]==1 && dl[3]==3);
+	mem::interleave2(il, dl, 2);
+	assert(il[0]==0 && il[1]==1 && il[2]==2 && il[3]==3);
+}
+
+// Polar conversion kernels, on every SIMD path
+{
+	const SIMDPath prev = simdPath();
+	const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+	for(SIMDPath path : paths){
+		if(!simdSupported(path)) continue;
+		simdPath(path);
+		const unsigned N=11; // values use both vector and scalar paths
+		float c[2*N], p[2*N], r[2*N];
+		for(unsigned i=0;i<N;++i){ c[2*i] = std::cos(1.3f*i)*i; c[2*i+1] = std::sin(2.1f*i)*(5.f-i); }
+
+		for(int precise=0; precise<2; ++precise){
+			const float eps = precise ? 1e-5f : 1.1e-2f;
+			arr::cartToPolar(p, c, N, precise);
+			for(unsigned i=1;i<N;++i){
+				assert(std::fabs(p[2*i  ] - std::hypot(c[2*i], c[2*i+1])) < 1e-5f*(1+i));
+				assert(std::fabs(p[2*i+1] - std::atan2(c[2*i+1], c[2*i])) < eps);
+			}
+			for(unsigned i=0;i<N;++i){ p[2*i] = 1.f; p[2*i+1] = 7.f*i - 30.f; }
+			arr::polarToCart(r, p, N, precise);
+			for(unsigned i=0;i<N;++i){
+				assert(std::fabs(r[2*i  ] - std::cos(p[2*i+1])) < 1e-5f);
+				assert(std::fabs(r[2*i+1] - std::sin(p[2*i+1])) < 1e-5f);
+			}
+		}
+	}
+	simdPath(prev);
+}
+
+// Float numeric primitives, on every SIMD path
+{
+	const SIMDPath prev = simdPath();
+	const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+	for(SIMDPath path : paths){
+		if(!simdSupported(path)) continue;
+		simdPath(path);
+		const unsigned N=37; // values use both vector and scalar paths
+		float a[N], b[N], d[N];
+		for(unsigned i=0;i<N;++i){ a[i] = std::sin(1.7f*i)*(i+1); b[i] = std::cos(0.3f*i) - 0.2f; }
+		a[23] = -50.f; a[30] = 50.f; a[31] = 50.f;
+
+		for(unsigned str=1; str<3; ++str){
+			assert(near(arr::dot(a,b,N,str), arr::dot<float>(a,b,N,str), 1e-4));
+			assert(near(arr::rms(a,N,str), arr::rms<float>(a,N,str), 1e-4));
+			assert(near(arr::meanNorm(a,N,str), arr::meanNorm<float>(a,N,str), 1e-4));
+			assert(near(arr::nyquist(a,N-1,str), arr::nyquist<float>(a,N-1,str), 1e-4));
+		}
+
+		unsigned imin, imax;
+		arr::extrema(a, N, imin, imax);
+		assert(imin == 23 && imax == 30);
+
+		for(unsigned i=0;i<N;++i) d[i] = a[i] * 0.01f;
+		d[0] = 0.f; d[1] = -1e-9f;
+		arr::linToDB(d, N, -60.f);
+		for(unsigned i=2;i<N;++i){
+			float v = std::fabs(a[i]*0.01f);
+			float r = v > 1e-3f ? 1.f + std::log10(v)/3.f : 0.f;
+			assert(near(d[i], a[i] < 0 ? -r : r, 1e-5));
+		}
+		assert(d[0] == 0.f && d[1] == 0.f);
+	}
+	simdPath(prev);
+}
+
+// Analysis primitives, on every SIMD path
+{
+	const SIMDPath prev = simdPath();
+	const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+	for(SIMDPath path : paths){
+		if(!simdSupported(path)) continue;
+		simdPath(path);
+		const unsigned N=301;
+		float a[N]; unsigned ia[N], ib[N], ja[N], jb[N];
+		for(unsigned i=0;i<N;++i) a[i] = std::floor(4.f*std::sin(0.37f*i*i)); // with plateaus
+
+		for(unsigned str=1; str<3; ++str){
+			unsigned na = arr::maxima(ia, a, N, str);
+			unsigned nb = arr::maxima<unsigned,float>(ib, a, N, str);
+			assert(na == nb);
+			for(unsigned i=0;i<na;++i) assert(ia[i] == ib[i]);
+		}
+
+		for(float t : {-5.f, 0.f, 1.5f, 9.f}){
+			unsigned na = arr::above(ja, a, N, t);
+			unsigned nb = arr::above<unsigned,float>(jb, a, N, t);
+			unsigned nc = 0;
+			for(unsigned i=0;i<N;++i) nc += a[i] >= t;
+			assert(na == nb && na == nc);
+			for(unsigned i=0;i<na;++i) assert(ja[i] == jb[i] && a[ja[i]] >= t);
+		}
+
+		unsigned binsA[9] = {0}, binsB[9] = {0};
+		arr::histogram(a, N, binsA, 8, 1.f, 4.f);
+		arr::histogram<float,unsigned>(a, N, binsB, 8, 1.f, 4.f);
+		for(unsigned i=0;i<9;++i) assert(binsA[i] == binsB[i]);
+
+		// Long arrays are split across the worker threads, which are reused
+		// by the second call
+		{	arr::histogramThreads(4);
+			const unsigned L = 1<<19;
+			std::vector<float> h(L);
+			for(unsigned i=0;i<L;++i) h[i] = float((i*7919u) % 1000u) * 0.01f - 1.f;
+			for(int pass=0; pass<2; ++pass){
+				unsigned hA[12] = {0}, hB[12] = {0};
+				arr::histogram(&h[0], L, hA, 12, 1.f, 1.f);
+				arr::histogram<float,unsigned>(&h[0], L, hB, 12, 1.f, 1.f);
+				unsigned total = 0;
+				for(unsigned i=0;i<12;++i){ assert(hA[i] == hB[i]); total += hA[i]; }
+				assert(total == L);
+			}
+			arr::histogramThreads(0);
+		}
+
+		for(unsigned n=0; n<N; n+=37){
+			assert(arr::zeroCross(a, n, -1.f) == arr::zeroCross<float>(a, n, -1.f));
+			assert(arr::zeroCross(a, n, 0.f) == arr::zeroCross<float>(a, n, 0.f));
+		}
+		float q[N];
+		for(unsigned i=0;i<N;++i) q[i] = i%50 == 7 ? -1.f : 0.01f;
+		for(unsigned n=0; n<N; n+=19){
+			assert(arr::tailBelowNorm(q, n, 0.5f) == arr::tailBelowNorm<float>(q, n, 0.5f));
+		}
+		assert(arr::tailBelowNorm(q, N, 2.f) == N && arr::tailBelowNorm(q, N, 0.f) == 0);
+		for(unsigned n=0; n<N; n+=19){
+			assert(arr::headBelowNorm(q+n, N-n, 0.5f) == arr::headBelowNorm<float>(q+n, N-n, 0.5f));
+		}
+		assert(arr::headBelowNorm(q, N, 2.f) == N && arr::headBelowNorm(q, N, 0.f) == 0);
+
+		{
+			const float coef[] = {0.5f, -1.f, 0.25f, 2.f, 0.125f};
+			float c1[N], c2[N];
+			for(unsigned i=0;i<N;++i) c2[i] = std::cos(0.1*i);
+			arr::chebyshev(c1, c2, N-3, coef, 5);
+			for(unsigned i=0;i<N-3;++i){
+				double t = 0.1*i;
+				double v = 0.5 - cos(t) + 0.25*cos(2*t) + 2*cos(3*t) + 0.125*cos(4*t);
+				assert(near(c1[i], v, 1e-5));
+			}
+			arr::chebyshev<float>(c2, c2, N-3, coef, 5);
+			for(unsigned i=0;i<N-3;++i) assert(near(c1[i], c2[i], 1e-5));
+		}
+
+		// Long arrays are sorted stably by a different algorithm
+		for(unsigned i=0;i<N;++i) ja[i] = jb[i] = i;
+		arr::sortInsertion(a, ja, N);
+		arr::sortInsertion(a, jb, arr::sortInsertionMax);
+		for(unsigned i=1;i<N;++i) assert(a[ja[i-1]] < a[ja[i]] || (a[ja[i-1]] == a[ja[i]] && ja[i-1] < ja[i]));
+		for(unsigned i=1;i<arr::sortInsertionMax;++i) assert(a[jb[i-1]] <= a[jb[i]]);
+		float c[N];
+		for(unsigned i=0;i<N;++i) c[i] = a[ja[i]];
+		arr::sortInsertion(a, N);
+		for(unsigned i=0;i<N;++i) assert(a[i] == c[i]);
+	}
+	simdPath(prev);
+}
+
 //{
 //	const unsigned lenE = 8;
 //	const unsigned lenO = lenE + 1;
@@ -10,4 +10,105 @@
 		assert(ipl::Linear<double>()(acc::Clip(), a,   0, 0.5, N-1,0) == 0.5);
 		assert(ipl::Linear<double>()(acc::Clip(), a, N-1, 0.5, N-1,0) == (N-1));
 	}
+
+	// Windowed-sinc interpolation
+	{
+		const int N = 256;
+		float a[N];
+		for(int i=0; i<N; ++i) a[i] = std::sin(i * M_2PI * 5./N); // periodic
+
+		ipl::Sinc<float> ip;
+		for(int i=0; i<N; i+=37){
+			double x = i + 0.3;
+			float e = std::sin(x * M_2PI * 5./N);
+			assert(near(ip(a, i, 0.3, N-1, 0), e, 5e-4));	// interior and wrapped
+		}
+		assert(near(ip(a, 10, 0., N-1, 0), a[10], 5e-4));
+
+		// Long kernels are truncated to fit the gathering buffers
+		SincBank wide(100, 16, 0.5f);
+		assert(wide.half() == SincBank::MAX_HALF);
+		ip.bank(wide);
+		assert(near(ip(a, 3, 0.5, N-1, 0), std::sin(3.5 * M_2PI * 5./N), 5e-3));
+		ip.bank(SincBank::get());
+
+		// Convert rate of a sine; lower rate bands-limits first
+		const int M = 4800;
+		std::vector<float> x(M), y(resampleLength(M, 44100./48000));
+		for(int i=0; i<M; ++i) x[i] = std::sin(i * M_2PI * 1000./48000);
+		resample(&y[0], y.size(), &x[0], M, 44100./48000);
+		assert(y.size() == 4410);
+		for(int i=100; i<4300; i+=71){
+			assert(near(y[i], std::sin(i * M_2PI * 1000./44100), 2e-3));
+		}
+	}
+
+	// Block kernels at a stream of positions
+	{
+		const int N = 64, M = 19; // both vector and scalar paths
+		float a[N], frac[M], d[M], dl[M], ref[M];
+		int idx[M];
+		for(int i=0; i<N; ++i) a[i] = std::sin(i*0.7f) + 0.1f*i;
+		for(int i=0; i<M; ++i){ idx[i] = 1 + (i*29)%(N-3); frac[i] = (i%5)*0.2f + 0.05f; }
+
+		ipl::linear(d, a, idx, frac, M);
+		for(int i=0; i<M; ++i) assert(near(d[i], ipl::linear(frac[i], a[idx[i]], a[idx[i]+1]), 1e-6));
+		ipl::Linear<float>()(dl, a, idx, frac, M);
+		for(int i=0; i<M; ++i) assert(dl[i] == d[i]);
+
+		ipl::cubic(d, a, idx, frac, M);
+		ipl::cubic<float,float>(ref, a, idx, frac, M);
+		for(int i=0; i<M; ++i){
+			const float * s = a + idx[i];
+			assert(near(d[i], ipl::cubic(frac[i], s[-1], s[0], s[1], s[2]), 1e-5));
+			assert(near(d[i], ref[i], 1e-5));
+		}
+
+		// Third order Lagrange passes through the points and matches its FIR
+		ipl::lagrange3(d, a, idx, frac, M);
+		for(int i=0; i<M; ++i){
+			const float * s = a + idx[i];
+			float h[4]; ipl::lagrange3(h, 1.f + frac[i]);
+			assert(near(d[i], s[-1]*h[0] + s[0]*h[1] + s[1]*h[2] + s[2]*h[3], 1e-5));
+		}
+		float zero[M] = {0};
+		ipl::lagrange3(d, a, idx, zero, M);
+		for(int i=0; i<M; ++i) assert(near(d[i], a[idx[i]], 1e-5));
+	}
+
+	// Block kernels reading 16-bit storage types, on every SIMD path
+	{
+		const int N = 64, M = 19;
+		Sample16 a16[N]; Half ah[N];
+		float frac[M], d[M], dh[M];
+		int idx[M];
+		for(int i=0; i<N; ++i){ a16[i] = 0.9f*std::sin(i*0.7f); ah[i] = 0.9f*std::sin(i*0.7f); }
+		for(int i=0; i<M; ++i){ idx[i] = 1 + (i*29)%(N-3); frac[i] = (i%5)*0.2f + 0.05f; }
+
+		const SIMDPath prev = simdPath();
+		const SIMDPath paths[] = {SIMD_SCALAR, SIMD_SSE2, SIMD_AVX2, SIMD_AVX512, SIMD_NEON};
+		for(SIMDPath q : paths){
+			if(!simdSupported(q)) continue;
+			simdPath(q);
+			ipl::linear(d, a16, idx, frac, M);
+			ipl::Linear<float>()(dh, ah, idx, frac, M);
+			for(int i=0; i<M; ++i){
+				const int j = idx[i];
+				assert(near(d[i], ipl::linear(frac[i], float(a16[j]), float(a16[j+1])), 1e-6));
+				assert(near(dh[i], ipl::linear(frac[i], float(ah[j]), float(ah[j+1])), 1e-6));
+			}
+			ipl::cubic(d, a16, idx, frac, M);
+			ipl::cubic(dh, ah, idx, frac, M);
+			for(int i=0; i<M; ++i){
+				const int j = idx[i];
+				assert(near(d[i], ipl::cubic(frac[i], float(a16[j-1]), float(a16[j]), float(a16[j+1]), float(a16[j+2])), 1e-5));
+				assert(near(dh[i], ipl::cubic(frac[i], float(ah[j-1]), float(ah[j]), float(ah[j+1]), float(ah[j+2])), 1e-5));
+			}
+		}
+		simdPath(prev);
+
+		// Random-access strategies convert as they read
+		assert(ipl::Linear<float>()(a16, 3, 0.5, N-1) == ipl::linear(0.5f, float(a16[3]), float(a16[4])));
+		assert(ipl::Cubic<float>()(ah, 3, 0.25, N-1) == ipl::cubic(0.25f, float(ah[2]), float(ah[3]), float(ah[4]), float(ah[5])));
+	}
 }
@@ -169,3 +169,26 @@
 //	PRINT_EVEN ASSERT_GUARDS
 
 }
+
+// Float (de)interleaving
+{
+	const unsigned M=13*9;
+	float src[M], dst[M], ref[M];
+	for(unsigned i=0; i<M; ++i) src[i] = float(i);
+	for(unsigned c=1; c<=9; ++c){
+		for(unsigned n=0; n<=13; ++n){
+			mem::deinterleave(dst, src, n, c);
+			mem::deinterleave<float>(ref, src, n, c);
+			assert(mem::deepEqual(dst, ref, n*c));
+			mem::interleave(dst, src, n, c);
+			mem::interleave<float>(ref, src, n, c);
+			assert(mem::deepEqual(dst, ref, n*c));
+		}
+	}
+	mem::deinterleave2(dst, src, 13);
+	mem::deinterleave2<float>(ref, src, 13);
+	assert(mem::deepEqual(dst, ref, 26));
+	mem::interleave2(dst, src, 13);
+	mem::interleave2<float>(ref, src, 13);
+	assert(mem::deepEqual(dst, ref, 26));
+}
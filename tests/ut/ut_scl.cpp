@@ -102,6 +102,38 @@
 				T(-1.,-1.) T(-M_PI,-M_PI) T(-M_PI-1,  M_PI-1) T(-7*M_PI+1, -M_PI+1)
 	#undef T
 
+	// Array versions match scalar versions
+	{
+		const unsigned N = 37; // uses vector and scalar paths
+		float x[N], y[N], r[N];
+		for(unsigned i=0; i<N; ++i){ x[i] = float(i)/(N-1)*2.f - 1.f; y[i] = 0.7f - x[i]*x[i]; }
+
+		#define T(f, g)\
+			scl::f(r, x, N);\
+			for(unsigned i=0; i<N; ++i) assert(near(r[i], scl::f(g), 1e-6));
+		T(sinP7, x[i]) T(sinP9, x[i])
+		#undef T
+		for(unsigned i=0; i<N; ++i) r[i] = x[i]*2.f;
+		scl::sinFast(r, r, N);
+		for(unsigned i=0; i<N; ++i) assert(near(r[i], scl::sinFast(x[i]*2.f), 1e-6));
+		for(unsigned i=0; i<N; ++i) r[i] = x[i]*0.25f + 0.25f;
+		scl::cosP3(r, r, N);
+		for(unsigned i=0; i<N; ++i) assert(near(r[i], scl::cosP3(x[i]*0.25f + 0.25f), 1e-6));
+		for(unsigned i=0; i<N; ++i) r[i] = 3.f + 2.f*x[i];
+		scl::log2Fast(r, r, N);
+		for(unsigned i=0; i<N; ++i) assert(r[i] == scl::log2Fast(3.f + 2.f*x[i]));
+		scl::pow2Fast(r, r, N);
+		for(unsigned i=0; i<N; ++i) assert(near(r[i], 3.f + 2.f*x[i], 1e-5));
+		for(unsigned i=0; i<N; ++i) r[i] = 20.f*x[i];
+		scl::pow2Fast(r, r, N);
+		for(unsigned i=0; i<N; ++i){
+			assert(r[i] == scl::pow2Fast(20.f*x[i]));
+			assert(near(r[i] / exp2f(20.f*x[i]), 1.f, 0.062));
+		}
+		scl::atan2Fast(r, y, x, N);
+		for(unsigned i=0; i<N; ++i) assert(near(r[i], scl::atan2Fast(y[i], x[i]), 1e-6));
+	}
+
 //	for(int i=0; i<36; ++i){
 //		printf("%2d -> %f\n", i, scl::nearest<float>(i, "a2"));
 //	}